@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+/**
+ * The file names which are looked up by the "albumart" command, in
+ * order of preference.
+ */
+inline constexpr std::array cover_art_names{
+	"cover.png",
+	"cover.jpg",
+	"cover.jxl",
+	"cover.webp",
+};
+
+/**
+ * @return the position of the given file name in #cover_art_names
+ * (lower is better) or cover_art_names.size() if it is not a cover
+ * art file name
+ */
+[[gnu::pure]]
+constexpr std::size_t
+GetCoverArtPreference(std::string_view name) noexcept
+{
+	std::size_t i = 0;
+	for (const std::string_view n : cover_art_names) {
+		if (name == n)
+			break;
+		++i;
+	}
+
+	return i;
+}
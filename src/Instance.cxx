@@ -8,7 +8,11 @@
 #include "StateFile.hxx"
 #include "Stats.hxx"
 #include "client/List.hxx"
+#include "client/Thread.hxx"
 #include "input/cache/Manager.hxx"
+#include "MusicBufferPool.hxx"
+#include "metrics/Server.hxx"
+#include "decoder/SongAnalysis.hxx"
 
 #ifdef ENABLE_CURL
 #include "RemoteTagCache.hxx"
@@ -16,6 +20,7 @@
 #endif
 
 #ifdef ENABLE_DATABASE
+#include "db/Count.hxx"
 #include "db/DatabaseError.hxx"
 #include "db/Interface.hxx"
 #include "db/update/Service.hxx"
@@ -34,6 +39,11 @@
 #include "sticker/SongSticker.hxx"
 #include "sticker/TagSticker.hxx"
 #include "sticker/CleanupService.hxx"
+#include "sticker/AnalysisService.hxx"
+#ifdef ENABLE_CHROMAPRINT
+#include "sticker/FingerprintService.hxx"
+#endif
+#include "Log.hxx"
 #endif
 
 #endif
@@ -42,12 +52,29 @@ Instance::Instance() = default;
 
 Instance::~Instance() noexcept
 {
+	/* stop the client threads before their clients get
+	   deleted */
+	for (auto &i : client_threads)
+		i.Stop();
+
 #ifdef ENABLE_SQLITE
 	if (sticker_cleanup)
 		sticker_cleanup.reset();
+
+	song_analysis_service.reset();
+
+#ifdef ENABLE_CHROMAPRINT
+	song_fingerprint_service.reset();
+#endif
 #endif
 
 #ifdef ENABLE_DATABASE
+	/* delete all clients before the database, because they may
+	   be running a query in a thread (see RunDatabaseQuery()) */
+	for (auto &partition : partitions)
+		partition.clients.clear();
+	client_list.reset();
+
 	delete update;
 
 	if (database != nullptr) {
@@ -66,6 +93,28 @@ Instance::OnStateModified() noexcept
 		state_file->CheckModified();
 }
 
+void
+Instance::StartClientThreads(unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		client_threads.emplace_front(event_loop).Start();
+
+	next_client_thread = client_threads.begin();
+}
+
+ClientThread *
+Instance::NextClientThread() noexcept
+{
+	if (client_threads.empty())
+		return nullptr;
+
+	ClientThread &thread = *next_client_thread;
+	if (++next_client_thread == client_threads.end())
+		next_client_thread = client_threads.begin();
+
+	return &thread;
+}
+
 Partition *
 Instance::FindPartition(const char *name) noexcept
 {
@@ -126,13 +175,19 @@ Instance::OnDatabaseModified() noexcept
 	/* propagate the change to all subsystems */
 
 	stats_invalidate();
+	song_count_invalidate();
 
 	for (auto &partition : partitions)
 		partition.DatabaseModified(*database);
 
 #ifdef ENABLE_SQLITE
-	if (sticker_database)
+	if (sticker_database) {
 		StartStickerCleanup();
+		StartSongAnalysis();
+#ifdef ENABLE_CHROMAPRINT
+		StartSongFingerprint();
+#endif
+	}
 #endif
 }
 
@@ -155,6 +210,25 @@ Instance::OnDatabaseSongRemoved(const char *uri) noexcept
 		partition.StaleSong(uri);
 }
 
+void
+Instance::OnDatabaseSongsMoved(std::span<const std::pair<std::string, std::string>> moved) noexcept
+{
+	assert(database != nullptr);
+
+#ifdef ENABLE_SQLITE
+	if (HasStickerDatabase()) {
+		try {
+			sticker_song_move(*sticker_database, moved);
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+#endif
+
+	for (auto &partition : partitions)
+		partition.SongsMoved(moved);
+}
+
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
@@ -269,4 +343,78 @@ Instance::StartStickerCleanup()
 	sticker_cleanup->Start();
 }
 
+void
+Instance::OnSongAnalysisDone() noexcept
+{
+	assert(event_loop.IsInside());
+
+	song_analysis_service.reset();
+
+	if (need_song_analysis)
+		StartSongAnalysis();
+}
+
+void
+Instance::StartSongAnalysis()
+{
+	if (song_analysis == nullptr || sticker_database == nullptr ||
+	    database == nullptr || storage == nullptr)
+		return;
+
+	if (song_analysis_service) {
+		/* still runnning, start a new one when that one
+		   finishes*/
+		need_song_analysis = true;
+		return;
+	}
+
+	need_song_analysis = false;
+
+	song_analysis_service =
+		std::make_unique<SongAnalysisService>(*this,
+						      *sticker_database,
+						      *database, *storage,
+						      *song_analysis);
+	song_analysis_service->Start();
+}
+
+#ifdef ENABLE_CHROMAPRINT
+
+void
+Instance::OnSongFingerprintDone() noexcept
+{
+	assert(event_loop.IsInside());
+
+	song_fingerprint_service.reset();
+
+	if (need_song_fingerprint)
+		StartSongFingerprint();
+}
+
+void
+Instance::StartSongFingerprint()
+{
+	if (fingerprint_threads == 0 || sticker_database == nullptr ||
+	    database == nullptr || storage == nullptr)
+		return;
+
+	if (song_fingerprint_service) {
+		/* still runnning, start a new one when that one
+		   finishes*/
+		need_song_fingerprint = true;
+		return;
+	}
+
+	need_song_fingerprint = false;
+
+	song_fingerprint_service =
+		std::make_unique<SongFingerprintService>(*this,
+							 *sticker_database,
+							 *database, *storage,
+							 fingerprint_threads);
+	song_fingerprint_service->Start();
+}
+
+#endif // ENABLE_CHROMAPRINT
+
 #endif // ENABLE_SQLITE
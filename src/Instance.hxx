@@ -34,17 +34,24 @@ class InotifyUpdate;
 #endif
 #endif
 
+#include <forward_list>
 #include <memory>
 #include <list>
 
 class ClientList;
+class ClientThread;
 struct Partition;
 class AudioOutputControl;
 class StateFile;
 class RemoteTagCache;
 class StickerDatabase;
 class StickerCleanupService;
+class SongAnalysisService;
+class SongFingerprintService;
+class SongAnalysisStore;
 class InputCacheManager;
+class MusicBufferPool;
+class MetricsServer;
 
 /**
  * A utility class which, when used as the first base class, ensures
@@ -91,6 +98,20 @@ struct Instance final
 
 	std::unique_ptr<InputCacheManager> input_cache;
 
+	/**
+	 * MixRamp/ReplayGain values calculated by the background
+	 * analyzer; nullptr if the "background_analyzer" option is
+	 * disabled.
+	 */
+	std::unique_ptr<SongAnalysisStore> song_analysis;
+
+	/**
+	 * The chunk budget shared by the #MusicBuffer of all
+	 * partitions; nullptr if the "audio_buffer_pool_size" option
+	 * is not set.
+	 */
+	std::unique_ptr<MusicBufferPool> buffer_pool;
+
 	/**
 	 * Monitor for global idle events to be broadcasted to all
 	 * partitions.
@@ -121,18 +142,52 @@ struct Instance final
 	std::unique_ptr<RemoteTagCache> remote_tag_cache;
 #endif
 
+	/**
+	 * Threads which handle client sockets (setting
+	 * "client_threads").  Empty if the main thread handles all
+	 * clients.
+	 */
+	std::forward_list<ClientThread> client_threads;
+
+	/**
+	 * The #ClientThread which gets the next connection.
+	 */
+	std::forward_list<ClientThread>::iterator next_client_thread;
+
 	std::unique_ptr<ClientList> client_list;
 
 	std::list<Partition> partitions;
 
 	std::unique_ptr<StateFile> state_file;
 
+	/**
+	 * The HTTP server for Prometheus (setting "metrics_port");
+	 * nullptr if disabled.
+	 */
+	std::unique_ptr<MetricsServer> metrics_server;
+
 #ifdef ENABLE_SQLITE
 	std::unique_ptr<StickerDatabase> sticker_database;
 
 	std::unique_ptr<StickerCleanupService> sticker_cleanup;
 
 	bool need_sticker_cleanup = false;
+
+	std::unique_ptr<SongAnalysisService> song_analysis_service;
+
+	bool need_song_analysis = false;
+
+#ifdef ENABLE_CHROMAPRINT
+	/**
+	 * The number of threads of the background fingerprint job;
+	 * 0 if the "background_fingerprint" option is disabled.
+	 */
+	unsigned fingerprint_threads = 0;
+
+	std::unique_ptr<SongFingerprintService> song_fingerprint_service;
+
+	bool need_song_fingerprint = false;
+#endif
 #endif
 
 	Instance();
@@ -162,6 +217,18 @@ struct Instance final
 	 */
 	void OnStateModified() noexcept;
 
+	/**
+	 * Start the given number of #ClientThread instances.
+	 */
+	void StartClientThreads(unsigned n);
+
+	/**
+	 * Returns the #ClientThread which shall handle the next new
+	 * connection (round robin), or nullptr if the main thread
+	 * handles all clients.
+	 */
+	ClientThread *NextClientThread() noexcept;
+
 	/**
 	 * Find a #Partition with the given name.  Returns nullptr if
 	 * no such partition was found.
@@ -209,6 +276,24 @@ struct Instance final
 
 	void OnStickerCleanupDone(bool changed) noexcept;
 	void StartStickerCleanup();
+
+	void OnSongAnalysisDone() noexcept;
+
+	/**
+	 * Start the background analyzer if it is enabled and the
+	 * music database is local.
+	 */
+	void StartSongAnalysis();
+
+#ifdef ENABLE_CHROMAPRINT
+	void OnSongFingerprintDone() noexcept;
+
+	/**
+	 * Start the background fingerprint job if it is enabled and
+	 * the music database is local.
+	 */
+	void StartSongFingerprint();
+#endif
 #endif
 
 	void BeginShutdownUpdate() noexcept;
@@ -230,6 +315,7 @@ private:
 	/* virtual methods from class DatabaseListener */
 	void OnDatabaseModified() noexcept override;
 	void OnDatabaseSongRemoved(const char *uri) noexcept override;
+	void OnDatabaseSongsMoved(std::span<const std::pair<std::string, std::string>> moved) noexcept override;
 #endif
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
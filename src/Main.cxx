@@ -7,6 +7,7 @@
 #include "CommandLine.hxx"
 #include "PlaylistFile.hxx"
 #include "MusicChunk.hxx"
+#include "MusicBufferPool.hxx"
 #include "StateFile.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
@@ -22,6 +23,8 @@
 #include "input/Init.hxx"
 #include "input/cache/Config.hxx"
 #include "input/cache/Manager.hxx"
+#include "metrics/Server.hxx"
+#include "decoder/SongAnalysis.hxx"
 #include "event/Loop.hxx"
 #include "event/Call.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -29,9 +32,14 @@
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/Glue.hxx"
 #include "decoder/DecoderList.hxx"
+#ifdef ENABLE_PRERENDER
+#include "decoder/Prerender.hxx"
+#endif
 #include "pcm/Convert.hxx"
 #include "unix/SignalHandlers.hxx"
 #include "thread/Slack.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
 #include "net/Init.hxx"
 #include "lib/icu/Init.hxx"
 #include "config/Check.hxx"
@@ -44,6 +52,7 @@
 #include "config/Parser.hxx"
 #include "config/PartitionConfig.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/Domain.hxx"
 
 #ifdef __linux__
 #include "io/linux/ProcStatus.hxx"
@@ -102,7 +111,9 @@
 #include <systemd/sd-daemon.h>
 #endif
 
+#include <chrono>
 #include <climits>
+#include <exception>
 
 #ifndef ANDROID
 #include <clocale>
@@ -115,6 +126,106 @@ LogListener *logListener;
 
 Instance *global_instance;
 
+static constexpr Domain startup_domain("startup");
+
+/**
+ * Logs the duration of each startup phase (in verbose mode), to find
+ * out what delays the startup.
+ */
+class StartupProfile {
+	using Clock = std::chrono::steady_clock;
+
+	const Clock::time_point start = Clock::now();
+
+	Clock::time_point last = start;
+
+public:
+	void Phase(const char *name) noexcept {
+		const auto now = Clock::now();
+		FmtDebug(startup_domain, "{}: {} ms", name,
+			 std::chrono::duration_cast<std::chrono::milliseconds>(now - last).count());
+		last = now;
+	}
+
+	void Finish() noexcept {
+		Phase("ready");
+
+		FmtDebug(startup_domain, "Startup took {} ms",
+			 std::chrono::duration_cast<std::chrono::milliseconds>(last - start).count());
+	}
+};
+
+/**
+ * Initializes the decoder plugins in a separate thread.  Some of
+ * them take a long time (e.g. loading sample banks or ROM images),
+ * and they do not depend on the database, which is loaded by the
+ * main thread meanwhile.  Nobody may use the decoder plugins before
+ * Wait() has returned.
+ */
+class AsyncDecoderPluginsInit {
+	const ConfigData &config;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	std::exception_ptr error;
+
+	bool initialized = false;
+
+public:
+	explicit AsyncDecoderPluginsInit(const ConfigData &_config)
+		:config(_config)
+	{
+		try {
+			thread.Start();
+		} catch (...) {
+			/* no thread: initialize in Wait() */
+			LogError(std::current_exception(),
+				 "Failed to start decoder initialization thread");
+		}
+	}
+
+	~AsyncDecoderPluginsInit() noexcept {
+		if (thread.IsDefined())
+			thread.Join();
+
+		if (initialized)
+			decoder_plugin_deinit_all();
+	}
+
+	AsyncDecoderPluginsInit(const AsyncDecoderPluginsInit &) = delete;
+	AsyncDecoderPluginsInit &operator=(const AsyncDecoderPluginsInit &) = delete;
+
+	/**
+	 * Wait for the initialization to finish.
+	 *
+	 * Throws on error.
+	 */
+	void Wait() {
+		if (thread.IsDefined())
+			thread.Join();
+		else if (!initialized && !error)
+			Init();
+
+		if (error)
+			std::rethrow_exception(std::exchange(error, {}));
+	}
+
+private:
+	void Init() noexcept {
+		try {
+			decoder_plugin_init_all(config);
+			initialized = true;
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	void Run() noexcept {
+		SetThreadName("decoder_init");
+		Init();
+	}
+};
+
 #ifdef ENABLE_DAEMON
 
 static void
@@ -336,6 +447,8 @@ MainConfigured(const CommandLineOptions &options,
 
 	log_init(raw_config, options.verbose, options.log_stderr);
 
+	StartupProfile profile;
+
 	Instance instance;
 	global_instance = &instance;
 
@@ -353,16 +466,36 @@ MainConfigured(const CommandLineOptions &options,
 		raw_config.GetPositive(ConfigOption::MAX_CONN, 100);
 	instance.client_list = std::make_unique<ClientList>(max_clients);
 
+	const unsigned client_threads =
+		raw_config.GetUnsigned(ConfigOption::CLIENT_THREADS, 0);
+
 	const auto *input_cache_config = raw_config.GetBlock(ConfigBlockOption::INPUT_CACHE);
 	if (input_cache_config != nullptr) {
 		const InputCacheConfig c(*input_cache_config);
 		instance.input_cache = std::make_unique<InputCacheManager>(c);
 	}
 
+	if (raw_config.GetBool(ConfigOption::BACKGROUND_ANALYZER, false))
+		instance.song_analysis = std::make_unique<SongAnalysisStore>();
+
+	if (partition_config.player.pool_chunks > 0)
+		instance.buffer_pool =
+			std::make_unique<MusicBufferPool>(partition_config.player.pool_chunks);
+
+#if defined(ENABLE_SQLITE) && defined(ENABLE_CHROMAPRINT)
+	if (raw_config.GetBool(ConfigOption::BACKGROUND_FINGERPRINT, false))
+		instance.fingerprint_threads =
+			raw_config.GetPositive(ConfigOption::FINGERPRINT_THREADS, 1);
+#endif
+
 	initialize_decoder_and_player(instance,
 				      raw_config, partition_config);
 
 	listen_global_init(raw_config, *instance.partitions.front().listener);
+	instance.metrics_server = CreateMetricsServer(raw_config,
+						      instance.event_loop,
+						      instance);
+	profile.Phase("listen");
 
 #ifdef ENABLE_DAEMON
 	daemonize_set_user();
@@ -382,15 +515,27 @@ MainConfigured(const CommandLineOptions &options,
 #endif
 
 	pcm_convert_global_init(raw_config);
+	profile.Phase("configuration");
 
-	const ScopeDecoderPluginsInit decoder_plugins_init(raw_config);
+	/* initialize the decoder plugins while the database is being
+	   loaded */
+	AsyncDecoderPluginsInit decoder_plugins_init(raw_config);
 
 #ifdef ENABLE_DATABASE
 	const bool create_db = InitDatabaseAndStorage(instance, raw_config);
+	profile.Phase("database");
 #endif
 
 #ifdef ENABLE_SQLITE
 	instance.sticker_database = LoadStickerDatabase(raw_config);
+	profile.Phase("sticker database");
+#endif
+
+	decoder_plugins_init.Wait();
+	profile.Phase("decoder plugins");
+
+#ifdef ENABLE_PRERENDER
+	prerender_global_init(raw_config);
 #endif
 
 	command_init();
@@ -403,13 +548,17 @@ MainConfigured(const CommandLineOptions &options,
 		partition.UpdateEffectiveReplayGainMode();
 	}
 
+	profile.Phase("outputs");
+
 	raw_config.WithEach(ConfigBlockOption::PARTITION, [&](const auto &block){
 		const char *name = block.GetBlockValue("name");
 		if (name == nullptr)
 			throw std::runtime_error("Missing 'name'");
 
-		instance.partitions.emplace_back(instance, name,
-						 partition_config);
+		PartitionConfig config{partition_config};
+		config.player.ApplyPartitionBlock(block);
+
+		instance.partitions.emplace_back(instance, name, config);
 	});
 
 	client_manager_init(raw_config);
@@ -417,6 +566,7 @@ MainConfigured(const CommandLineOptions &options,
 						       instance.io_thread.GetEventLoop());
 
 	const ScopePlaylistPluginsInit playlist_plugins_init(raw_config);
+	profile.Phase("input and playlist plugins");
 
 #ifdef ENABLE_DAEMON
 	daemonize_commit();
@@ -433,6 +583,7 @@ MainConfigured(const CommandLineOptions &options,
 
 	instance.io_thread.Start();
 	instance.rtio_thread.Start();
+	instance.StartClientThreads(client_threads);
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance.neighbors != nullptr)
@@ -474,7 +625,21 @@ MainConfigured(const CommandLineOptions &options,
 	}
 #endif
 
+#ifdef ENABLE_SQLITE
+	/* load the MixRamp/ReplayGain values calculated
+	   previously and analyze songs which are still missing */
+	instance.StartSongAnalysis();
+
+#ifdef ENABLE_CHROMAPRINT
+	/* continue the fingerprint job where it stopped */
+	instance.StartSongFingerprint();
+#endif
+#endif
+
+	profile.Phase("neighbors and zeroconf");
+
 	glue_state_file_init(instance, raw_config);
+	profile.Phase("state file");
 
 #ifdef ENABLE_DATABASE
 	if (raw_config.GetBool(ConfigOption::AUTO_UPDATE, false)) {
@@ -506,6 +671,8 @@ MainConfigured(const CommandLineOptions &options,
 	for (auto &partition : instance.partitions)
 		partition.pc.LockUpdateAudio();
 
+	profile.Finish();
+
 #ifdef _WIN32
 	win32_app_started();
 #endif
@@ -518,6 +685,17 @@ MainConfigured(const CommandLineOptions &options,
 	sd_notify(0, "READY=1");
 #endif
 
+#ifdef HAVE_URING
+	/* receive from clients with io_uring (see class
+	   BufferedSocket) */
+	try {
+		instance.event_loop.EnableUring(256, 0);
+	} catch (...) {
+		Log(LogLevel::INFO, std::current_exception(),
+		    "Failed to initialize io_uring");
+	}
+#endif
+
 	/* run the main loop */
 	instance.event_loop.Run();
 
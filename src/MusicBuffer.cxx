@@ -2,21 +2,157 @@
 // Copyright The Music Player Daemon Project
 
 #include "MusicBuffer.hxx"
+#include "MusicBufferPool.hxx"
 #include "MusicChunk.hxx"
+#include "system/Probe.hxx"
 
+#include <algorithm> // for std::min()
 #include <cassert>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks)
+MusicBuffer::MusicBuffer(unsigned num_chunks, std::size_t _chunk_size,
+			 bool hugetlb,
+			 MusicBufferPool *_pool, unsigned _base_chunks)
+	:buffer(num_chunks),
+	 /* the capacity of #buffer may be rounded up, and each
+	    chunk needs its slice of #data */
+	 data(std::size_t{buffer.GetCapacity()} * _chunk_size, hugetlb),
+	 chunk_size(_chunk_size),
+	 pool(_pool),
+	 base_chunks(_pool != nullptr
+		     ? std::min(_base_chunks, num_chunks)
+		     : num_chunks),
+	 max_borrowed(_pool != nullptr
+		      ? _pool->GetBorrowLimit()
+		      : 0)
 {
+	assert(chunk_size >= CHUNK_SIZE);
+	assert(chunk_size <= MAX_CHUNK_SIZE);
+
 	buffer.SetName("MusicBuffer");
+	data.ForkCow(false);
+	data.SetName("MusicBuffer");
+}
+
+MusicBuffer::~MusicBuffer() noexcept
+{
+	ReturnBorrowed();
+}
+
+bool
+MusicBuffer::IsFull() const noexcept
+{
+	if (buffer.IsFull())
+		return true;
+
+	if (pool == nullptr)
+		return false;
+
+	/* all chunks which are ours are in use, and we can't borrow
+	   more */
+	const unsigned n_borrowed_now = GetBorrowedCount();
+	return GetAllocatedCount() >= base_chunks + n_borrowed_now &&
+		(n_borrowed_now >= max_borrowed || pool->IsExhausted());
+}
+
+inline std::span<std::byte>
+MusicBuffer::GetResidentData() noexcept
+{
+	return std::span<std::byte>{data}.first(std::size_t{base_chunks} * chunk_size);
+}
+
+void
+MusicBuffer::PopulateMemory() noexcept
+{
+	buffer.PopulateMemory();
+	HugePopulate(GetResidentData());
+}
+
+bool
+MusicBuffer::LockMemory() noexcept
+{
+	if (locked)
+		return true;
+
+	if (!buffer.LockMemory())
+		return false;
+
+	if (!HugeLock(GetResidentData())) {
+		buffer.UnlockMemory();
+		return false;
+	}
+
+	locked = true;
+	return true;
+}
+
+void
+MusicBuffer::UnlockMemory() noexcept
+{
+	if (!locked)
+		return;
+
+	buffer.UnlockMemory();
+	HugeUnlock(GetResidentData());
+	locked = false;
+}
+
+inline void
+MusicBuffer::ReturnBorrowed() noexcept
+{
+	if (const unsigned n = n_borrowed.exchange(0, std::memory_order_relaxed);
+	    n > 0)
+		pool->Return(n);
+}
+
+void
+MusicBuffer::DiscardMemory() noexcept
+{
+	/* locked pages cannot be discarded */
+	UnlockMemory();
+
+	buffer.DiscardMemory();
+	data.Discard();
+
+	ReturnBorrowed();
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
-	const std::lock_guard protect{mutex};
-	return {buffer.Allocate(), MusicChunkDeleter(*this)};
+	/* reusing a freed slice or initializing one within the base
+	   quota is free; initializing any other slice commits more
+	   memory, which needs to be borrowed from the pool first */
+	const unsigned n_initialized = buffer.GetInitializedCount();
+	const bool borrow = pool != nullptr &&
+		n_initialized >= base_chunks &&
+		n_initialized < buffer.GetCapacity() &&
+		!buffer.HasAvailable();
+	if (borrow && (GetBorrowedCount() >= max_borrowed ||
+		       !pool->TryBorrow())) {
+		MPD_PROBE(buffer_allocate, static_cast<MusicChunk *>(nullptr),
+			  buffer.GetAllocatedCount());
+		return {nullptr, MusicChunkDeleter(*this)};
+	}
+
+	MusicChunk *chunk = buffer.Allocate();
+
+	if (borrow) {
+		if (buffer.GetInitializedCount() > n_initialized)
+			n_borrowed.fetch_add(1, std::memory_order_relaxed);
+		else
+			/* another thread has freed a slice
+			   meanwhile, which was reused instead */
+			pool->Return(1);
+	}
+
+	if (chunk != nullptr)
+		chunk->data = std::span<std::byte>{data}
+			.subspan(buffer.GetIndex(chunk) * chunk_size,
+				 chunk_size);
+
+	MPD_PROBE(buffer_allocate, chunk, buffer.GetAllocatedCount());
+
+	return {chunk, MusicChunkDeleter(*this)};
 }
 
 void
@@ -24,14 +160,12 @@ MusicBuffer::Return(MusicChunk *chunk) noexcept
 {
 	assert(chunk != nullptr);
 
-	/* these attributes need to be cleared before locking the
-	   mutex, because they might recursively call this method,
-	   causing a deadlock */
+	/* these attributes need to be cleared before the chunk is
+	   freed; they may recursively call this method */
 	chunk->next.reset();
+	chunk->published_next.store(nullptr, std::memory_order_relaxed);
 	chunk->other.reset();
 
-	const std::lock_guard protect{mutex};
-
 	assert(!chunk->other || !chunk->other->other);
 
 	buffer.Free(chunk);
@@ -5,17 +5,60 @@
 
 #include "MusicChunk.hxx"
 #include "MusicChunkPtr.hxx"
-#include "memory/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "memory/AtomicSliceBuffer.hxx"
+#include "memory/HugeArray.hxx"
+
+#include <atomic>
+#include <cstddef>
+
+class MusicBufferPool;
 
 /**
- * An allocator for #MusicChunk objects.
+ * An allocator for #MusicChunk objects.  It is lock-free: chunks may
+ * be returned by any thread, but only one thread (the decoder
+ * thread) allocates them.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	mutable Mutex mutex;
+	AtomicSliceBuffer<MusicChunk> buffer;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The PCM data of all chunks; each #MusicChunk owns a slice of
+	 * #chunk_size bytes, depending on its index in #buffer.
+	 */
+	HugeArray<std::byte> data;
+
+	const std::size_t chunk_size;
+
+	/**
+	 * The instance-wide pool which chunks beyond #base_chunks are
+	 * borrowed from; nullptr if all chunks can be used without
+	 * asking.
+	 */
+	MusicBufferPool *const pool;
+
+	/**
+	 * The number of chunks which may be used without borrowing
+	 * from the #pool.
+	 */
+	const unsigned base_chunks;
+
+	/**
+	 * The maximum number of chunks which may be borrowed from
+	 * the #pool, see MusicBufferPool::GetBorrowLimit().
+	 */
+	const unsigned max_borrowed;
+
+	/**
+	 * The number of chunks currently borrowed from the #pool.
+	 * Written only by Allocate() and DiscardMemory(), but read by
+	 * IsFull() in other threads.
+	 */
+	std::atomic<unsigned> n_borrowed{0};
+
+	/**
+	 * Has LockMemory() succeeded?
+	 */
+	bool locked = false;
 
 public:
 	/**
@@ -23,53 +66,117 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the PCM capacity of each #MusicChunk
+	 * @param hugetlb try to allocate the PCM data from explicit
+	 * huge pages
+	 * @param pool if not nullptr, then only the first
+	 * #base_chunks chunks are guaranteed, and the rest (up to
+	 * num_chunks and the pool's borrow limit) must be borrowed
+	 * from this pool
+	 * @param base_chunks the number of chunks which can be used
+	 * without borrowing (ignored if there is no pool)
 	 */
-	explicit MusicBuffer(unsigned num_chunks);
+	explicit MusicBuffer(unsigned num_chunks,
+			     std::size_t chunk_size=CHUNK_SIZE,
+			     bool hugetlb=false,
+			     MusicBufferPool *pool=nullptr,
+			     unsigned base_chunks=0);
+
+	~MusicBuffer() noexcept;
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
 #ifndef NDEBUG
 	/**
 	 * Check whether the buffer is empty.
 	 *
-	 * This call is not protected with the #mutex, and may only be
-	 * used while this object is inaccessible to other threads.
+	 * This call may only be used while this object is
+	 * inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
 		return buffer.empty();
 	}
 #endif
 
-	bool IsFull() const noexcept {
-		const std::lock_guard protect{mutex};
-		return buffer.IsFull();
-	}
+	/**
+	 * Is it impossible to allocate another chunk right now,
+	 * either because all chunks are in use or because the ones
+	 * which are not would have to be borrowed from an exhausted
+	 * pool (or beyond the borrow limit)?  This may be called by
+	 * any thread.
+	 */
+	[[gnu::pure]]
+	bool IsFull() const noexcept;
 
 	/**
-	 * Returns the total number of reserved chunks in this buffer.  This
-	 * is the same value which was passed to the constructor.
+	 * Returns the total number of reserved chunks in this buffer
+	 * (including those which need to be borrowed from the pool).
+	 * This is the same value which was passed to the constructor.
 	 */
 	[[gnu::pure]]
 	unsigned GetSize() const noexcept {
 		return buffer.GetCapacity();
 	}
 
-	void PopulateMemory() noexcept {
-		buffer.PopulateMemory();
+	/**
+	 * Returns the number of chunks currently in use.  This may be
+	 * called by any thread.
+	 */
+	unsigned GetAllocatedCount() const noexcept {
+		return buffer.GetAllocatedCount();
 	}
 
 	/**
-	 * Give all memory allocations back to the kernel.
-	 *
-	 * This call is not protected with the #mutex, and may only be
-	 * used while this object is inaccessible to other threads.
+	 * Returns the PCM capacity of each chunk in bytes.
 	 */
-	void DiscardMemory() noexcept {
-		buffer.DiscardMemory();
+	std::size_t GetChunkSize() const noexcept {
+		return chunk_size;
 	}
 
+	/**
+	 * Returns the number of chunks currently borrowed from the
+	 * pool.  This may be called by any thread.
+	 */
+	unsigned GetBorrowedCount() const noexcept {
+		return n_borrowed.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Allocate physical memory for all chunks which are
+	 * guaranteed to be usable, i.e. the whole buffer or, with a
+	 * pool, only the base quota.
+	 */
+	void PopulateMemory() noexcept;
+
+	/**
+	 * Lock all memory allocations into RAM, so the decoder and
+	 * the outputs never have to wait for a page fault.  With a
+	 * pool, only the base quota is locked, because locking
+	 * faults in all pages.  Does nothing if the memory is already
+	 * locked.  The lock is released by DiscardMemory().
+	 *
+	 * @return true on success, false on error (with errno set,
+	 * e.g. because RLIMIT_MEMLOCK is too small)
+	 */
+	bool LockMemory() noexcept;
+
+	/**
+	 * Give all memory allocations back to the kernel, and all
+	 * borrowed chunks back to the pool.
+	 *
+	 * This call may only be used while this object is
+	 * inaccessible to other threads.
+	 */
+	void DiscardMemory() noexcept;
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
 	 *
+	 * This method must not be called by more than one thread at
+	 * a time.
+	 *
 	 * @return an empty chunk or nullptr if there are no chunks
 	 * available
 	 */
@@ -77,7 +184,18 @@ public:
 
 	/**
 	 * Returns a chunk to the buffer.  It can be reused by
-	 * Allocate() then.
+	 * Allocate() then.  This method may be called by any thread.
 	 */
 	void Return(MusicChunk *chunk) noexcept;
+
+private:
+	/**
+	 * Returns the portion of #data which is populated and locked,
+	 * see PopulateMemory().
+	 */
+	std::span<std::byte> GetResidentData() noexcept;
+
+	void UnlockMemory() noexcept;
+
+	void ReturnBorrowed() noexcept;
 };
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+
+/**
+ * An instance-wide budget of #MusicChunk objects shared by the
+ * #MusicBuffer instances of all partitions
+ * ("audio_buffer_pool_size").  Each #MusicBuffer may always commit
+ * its base quota ("audio_buffer_min_size"); every chunk beyond that
+ * (up to its "audio_buffer_size") must be borrowed from this pool,
+ * and is given back when the #MusicBuffer discards its memory
+ * (i.e. when the partition stops playing), not when the chunk is
+ * freed, because its memory stays committed until then.  See
+ * GetBorrowLimit().
+ *
+ * This class only does the accounting; the memory itself is
+ * reserved by each #MusicBuffer, but it is faulted in only on
+ * demand.
+ *
+ * All methods are lock-free and may be called by any thread.
+ */
+class MusicBufferPool {
+	const unsigned capacity;
+
+	/**
+	 * The number of chunks currently borrowed by all
+	 * #MusicBuffer instances.
+	 */
+	std::atomic<unsigned> n_borrowed{0};
+
+public:
+	/**
+	 * @param _capacity the number of chunks which may be
+	 * borrowed
+	 */
+	explicit MusicBufferPool(unsigned _capacity) noexcept
+		:capacity(_capacity) {}
+
+	~MusicBufferPool() noexcept {
+		/* all chunks must be returned explicitly, and this
+		   assertion checks for leaks */
+		assert(n_borrowed == 0);
+	}
+
+	MusicBufferPool(const MusicBufferPool &) = delete;
+	MusicBufferPool &operator=(const MusicBufferPool &) = delete;
+
+	unsigned GetCapacity() const noexcept {
+		return capacity;
+	}
+
+	unsigned GetBorrowedCount() const noexcept {
+		return n_borrowed.load(std::memory_order_relaxed);
+	}
+
+	bool IsExhausted() const noexcept {
+		return GetBorrowedCount() >= capacity;
+	}
+
+	/**
+	 * Returns the maximum number of chunks one #MusicBuffer may
+	 * borrow.  Borrowed chunks are only given back when the
+	 * #MusicBuffer discards its memory, so without this limit,
+	 * one partition which plays for a long time could keep the
+	 * whole pool; this way, at least half of it is left for the
+	 * others.
+	 */
+	unsigned GetBorrowLimit() const noexcept {
+		return (capacity + 1) / 2;
+	}
+
+	/**
+	 * Borrow one chunk.
+	 *
+	 * @return false if the pool is exhausted
+	 */
+	bool TryBorrow() noexcept {
+		unsigned n = n_borrowed.load(std::memory_order_relaxed);
+		do {
+			if (n >= capacity)
+				return false;
+		} while (!n_borrowed.compare_exchange_weak(n, n + 1,
+							   std::memory_order_relaxed));
+
+		return true;
+	}
+
+	/**
+	 * Give back chunks obtained by TryBorrow().
+	 */
+	void Return(unsigned n) noexcept {
+		assert(n <= GetBorrowedCount());
+
+		n_borrowed.fetch_sub(n, std::memory_order_relaxed);
+	}
+};
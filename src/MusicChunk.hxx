@@ -12,13 +12,25 @@
 #endif
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <span>
 
+/**
+ * The default (and minimum) size of the PCM buffer of a
+ * #MusicChunk.  The #MusicBuffer may choose larger chunks for
+ * high-resolution formats.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
+/**
+ * The maximum size of the PCM buffer of a #MusicChunk.
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
+
 struct AudioFormat;
 struct Tag;
 struct MusicChunk;
@@ -27,9 +39,20 @@ struct MusicChunk;
  * Meta information for #MusicChunk.
  */
 struct MusicChunkInfo {
-	/** the next chunk in a linked list */
+	/**
+	 * The next chunk in a linked list.  This owning pointer is
+	 * only used by the #MusicPipe (with its mutex locked);
+	 * everybody else shall use GetNext().
+	 */
 	MusicChunkPtr next;
 
+	/**
+	 * A copy of #next which is published with release semantics
+	 * by MusicPipe::Push(), so consumers can walk the list
+	 * without locking.
+	 */
+	std::atomic<const MusicChunk *> published_next{nullptr};
+
 	/**
 	 * An optional chunk which should be mixed into this chunk.
 	 * This is used for cross-fading.
@@ -49,7 +72,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -57,6 +80,14 @@ struct MusicChunkInfo {
 	/** the time stamp within the song */
 	SignedSongTime time;
 
+	/**
+	 * When was this chunk submitted to the decoder's #MusicPipe?
+	 * This is used to measure the latency of the audio path (see
+	 * #AudioOutputResidencyHistogram); it is not set for chunks
+	 * which were not produced by a decoder.
+	 */
+	std::chrono::steady_clock::time_point submit_time{};
+
 	/**
 	 * Replay gain information associated with this chunk.
 	 * Only valid if the serial is not 0.
@@ -78,8 +109,18 @@ struct MusicChunkInfo {
 	~MusicChunkInfo() noexcept;
 
 	MusicChunkInfo(const MusicChunkInfo &) = delete;
+
 	MusicChunkInfo &operator=(const MusicChunkInfo &) = delete;
 
+	/**
+	 * Returns the next chunk in the #MusicPipe or nullptr if this
+	 * is the tail.  This may be called from any thread.
+	 */
+	[[gnu::pure]]
+	const MusicChunk *GetNext() const noexcept {
+		return published_next.load(std::memory_order_acquire);
+	}
+
 	bool IsEmpty() const {
 		return length == 0 && tag == nullptr;
 	}
@@ -99,8 +140,19 @@ struct MusicChunkInfo {
  * MusicPipe::Push() caller.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
-	std::byte data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
+	/**
+	 * The data (probably PCM).  This buffer is owned by the
+	 * #MusicBuffer and is assigned by MusicBuffer::Allocate().
+	 */
+	std::span<std::byte> data;
+
+	/**
+	 * The maximum number of bytes which can be stored in this
+	 * chunk.
+	 */
+	std::size_t GetCapacity() const noexcept {
+		return data.size();
+	}
 
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
@@ -129,8 +181,6 @@ struct MusicChunk : MusicChunkInfo {
 	bool Expand(AudioFormat af, size_t length) noexcept;
 
 	std::span<const std::byte> ReadData() const noexcept {
-		return {data, length};
+		return data.first(length);
 	}
 };
-
-static_assert(sizeof(MusicChunk) == CHUNK_SIZE, "Wrong size");
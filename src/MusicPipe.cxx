@@ -32,13 +32,17 @@ MusicPipe::Shift() noexcept
 		assert(!chunk->IsEmpty());
 
 		head = std::move(chunk->next);
+		chunk->published_next.store(nullptr, std::memory_order_relaxed);
+		published_head.store(head.get(), std::memory_order_release);
 		--size;
 
 		if (head == nullptr) {
 			assert(size == 0);
 			assert(tail_r == &chunk->next);
+			assert(tail == chunk.get());
 
 			tail_r = &head;
+			tail = nullptr;
 		} else {
 			assert(size > 0);
 			assert(tail_r != &chunk->next);
@@ -77,8 +81,93 @@ MusicPipe::Push(MusicChunkPtr chunk) noexcept
 #endif
 
 	chunk->next.reset();
+	chunk->published_next.store(nullptr, std::memory_order_relaxed);
+
+	MusicChunk *const new_tail = chunk.get();
 	*tail_r = std::move(chunk);
-	tail_r = &(*tail_r)->next;
+	tail_r = &new_tail->next;
+
+	/* publish the new chunk to lock-free readers; this release
+	   store makes its contents visible to them */
+	if (tail == nullptr)
+		published_head.store(new_tail, std::memory_order_release);
+	else
+		tail->published_next.store(new_tail, std::memory_order_release);
+
+	tail = new_tail;
+
+	size.fetch_add(1, std::memory_order_release);
+}
+
+void
+MusicPipe::PushFront(MusicChunkPtr chunk) noexcept
+{
+	assert(!chunk->IsEmpty());
+
+	const std::lock_guard protect{mutex};
+
+	assert(!audio_format.IsDefined() ||
+	       chunk->CheckFormat(audio_format));
+
+#ifndef NDEBUG
+	if (!audio_format.IsDefined() && chunk->length > 0)
+		audio_format = chunk->audio_format;
+#endif
+
+	MusicChunk *const new_head = chunk.get();
+	new_head->next = std::move(head);
+	new_head->published_next.store(new_head->next.get(),
+				       std::memory_order_relaxed);
+
+	if (tail == nullptr) {
+		tail = new_head;
+		tail_r = &new_head->next;
+	}
+
+	head = std::move(chunk);
+	published_head.store(new_head, std::memory_order_release);
+
+	size.fetch_add(1, std::memory_order_release);
+}
+
+void
+MusicPipe::PushFront(MusicPipe &other) noexcept
+{
+	assert(&other != this);
+
+	const std::scoped_lock protect{mutex, other.mutex};
+
+	if (other.head == nullptr)
+		return;
+
+	assert(!audio_format.IsDefined() ||
+	       !other.audio_format.IsDefined() ||
+	       audio_format == other.audio_format);
+
+#ifndef NDEBUG
+	if (!audio_format.IsDefined())
+		audio_format = other.audio_format;
+	other.audio_format.Clear();
+#endif
+
+	MusicChunk *const other_tail = other.tail;
+	*other.tail_r = std::move(head);
+	other_tail->published_next.store(other_tail->next.get(),
+					 std::memory_order_relaxed);
+
+	if (tail == nullptr) {
+		tail = other_tail;
+		tail_r = &other_tail->next;
+	}
+
+	head = std::move(other.head);
+	published_head.store(head.get(), std::memory_order_release);
+
+	size.fetch_add(other.size.load(std::memory_order_relaxed),
+		       std::memory_order_release);
 
-	++size;
+	other.tail_r = &other.head;
+	other.tail = nullptr;
+	other.published_head.store(nullptr, std::memory_order_relaxed);
+	other.size.store(0, std::memory_order_relaxed);
 }
@@ -7,6 +7,8 @@
 #include "MusicChunkPtr.hxx"
 #include "thread/Mutex.hxx"
 
+#include <atomic>
+
 #ifndef NDEBUG
 #include "pcm/AudioFormat.hxx"
 #endif
@@ -14,6 +16,11 @@
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * Push() and Shift() are serialized with a mutex, but readers
+ * (Peek(), GetSize() and MusicChunkInfo::GetNext()) do not lock;
+ * they see each new chunk after it has been published with release
+ * semantics.  Any number of threads may read concurrently.
  */
 class MusicPipe {
 	/** the first chunk */
@@ -22,10 +29,18 @@ class MusicPipe {
 	/** a pointer to the tail of the chunk */
 	MusicChunkPtr *tail_r = &head;
 
+	/** the last chunk; nullptr if the pipe is empty */
+	MusicChunk *tail = nullptr;
+
+	/**
+	 * A copy of #head for lock-free readers.
+	 */
+	std::atomic<const MusicChunk *> published_head{nullptr};
+
 	/** the current number of chunks */
-	unsigned size = 0;
+	std::atomic<unsigned> size{0};
 
-	/** a mutex which protects #head and #tail_r */
+	/** a mutex which protects #head, #tail_r and #tail */
 	mutable Mutex mutex;
 
 #ifndef NDEBUG
@@ -61,8 +76,7 @@ public:
 	 */
 	[[gnu::pure]]
 	const MusicChunk *Peek() const noexcept {
-		const std::lock_guard protect{mutex};
-		return head.get();
+		return published_head.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -80,13 +94,24 @@ public:
 	 */
 	void Push(MusicChunkPtr chunk) noexcept;
 
+	/**
+	 * Inserts a chunk at the head of the pipe.  Only the
+	 * consumer may call this.
+	 */
+	void PushFront(MusicChunkPtr chunk) noexcept;
+
+	/**
+	 * Moves all chunks of another pipe to the head of this one,
+	 * preserving their order.  Only the consumer may call this.
+	 */
+	void PushFront(MusicPipe &other) noexcept;
+
 	/**
 	 * Returns the number of chunks currently in this pipe.
 	 */
 	[[gnu::pure]]
 	unsigned GetSize() const noexcept {
-		const std::lock_guard protect{mutex};
-		return size;
+		return size.load(std::memory_order_acquire);
 	}
 
 	[[gnu::pure]]
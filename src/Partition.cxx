@@ -4,17 +4,26 @@
 #include "config.h"
 #include "Partition.hxx"
 #include "Instance.hxx"
-#include "Log.hxx"
 #include "config/PartitionConfig.hxx"
-#include "lib/fmt/ExceptionFormatter.hxx"
 #include "song/DetachedSong.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "client/Listener.hxx"
 #include "client/Client.hxx"
+#include "output/Control.hxx"
+#include "output/Filtered.hxx"
 #include "input/cache/Manager.hxx"
-#include "util/Domain.hxx"
+#include "input/cache/Prefetcher.hxx"
+#include "Log.hxx"
 
-static constexpr Domain cache_domain("cache");
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseSong.hxx"
+#include "db/RandomFill.hxx"
+#include "db/update/Service.hxx"
+#endif
+
+#include <cassert>
+#include <utility>
+#include <vector>
 
 Partition::Partition(Instance &_instance,
 		     const char *_name,
@@ -24,13 +33,20 @@ Partition::Partition(Instance &_instance,
 	 config(_config),
 	 listener(new ClientListener(instance.event_loop, *this)),
 	 idle_monitor(instance.event_loop, BIND_THIS_METHOD(OnIdleMonitor)),
+	 idle_coalesce_timer(instance.event_loop,
+			     BIND_THIS_METHOD(OnIdleCoalesceTimer)),
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
 	 playlist(config.queue.max_length, *this),
 	 outputs(pc, *this),
 	 pc(*this, outputs,
 	    instance.input_cache.get(),
+	    instance.song_analysis.get(),
+	    instance.buffer_pool.get(),
 	    config.player)
 {
+	if (instance.input_cache)
+		prefetcher = std::make_unique<InputCachePrefetcher>(*instance.input_cache);
+
 	UpdateEffectiveReplayGainMode();
 }
 
@@ -43,42 +59,38 @@ Partition::BeginShutdown() noexcept
 	listener.reset();
 }
 
-static void
-PrefetchSong(InputCacheManager &cache, const char *uri) noexcept
+inline void
+Partition::PrefetchQueue() noexcept
 {
-	if (cache.Contains(uri))
+	if (!prefetcher)
 		return;
 
-	FmtDebug(cache_domain, "Prefetch {:?}", uri);
+	/* collect the songs which are going to be played next (in
+	   queue order, which is the shuffled order in "random"
+	   mode); the prefetcher decides which of them fit */
+	std::vector<const char *> uris;
 
-	try {
-		cache.Prefetch(uri);
-	} catch (...) {
-		FmtError(cache_domain,
-			 "Prefetch {:?} failed: {}",
-			 uri, std::current_exception());
-	}
-}
+	if (const int next = playlist.GetNextPosition(); next >= 0) {
+		const auto &queue = playlist.queue;
+		const unsigned max_songs = instance.input_cache->GetPrefetchSongs();
 
-static void
-PrefetchSong(InputCacheManager &cache, const DetachedSong &song) noexcept
-{
-	PrefetchSong(cache, song.GetURI());
-}
+		uris.push_back(queue.Get(next).GetRealURI());
 
-inline void
-Partition::PrefetchQueue() noexcept
-{
-	if (!instance.input_cache)
-		return;
+		int order = queue.PositionToOrder(next);
+		while (uris.size() < max_songs) {
+			const int next_order = queue.GetNextOrder(order);
+			if (next_order < 0 || next_order == order ||
+			    next_order == playlist.current)
+				/* end of queue, or wrapped around */
+				break;
 
-	auto &cache = *instance.input_cache;
+			order = next_order;
 
-	int next = playlist.GetNextPosition();
-	if (next >= 0)
-		PrefetchSong(cache, playlist.queue.Get(next));
+			uris.push_back(queue.GetOrder(order).GetRealURI());
+		}
+	}
 
-	// TODO: prefetch more songs
+	prefetcher->Update(uris);
 }
 
 void
@@ -95,6 +107,97 @@ Partition::UpdateEffectiveReplayGainMode() noexcept
 	outputs.SetReplayGainMode(mode);
 }
 
+void
+Partition::MoveOutputHere(AudioOutputControl &output) noexcept
+{
+	const bool was_enabled = output.IsEnabled();
+
+	auto *existing_output = outputs.FindByName(output.GetName());
+	if (existing_output != nullptr) {
+		/* move the output back where it once was */
+		existing_output->SetLinkPartition({});
+		existing_output->ReplaceDummy(output.Steal(), was_enabled);
+	} else
+		/* copy the AudioOutputControl and add it to the
+		   output list */
+		outputs.AddMoveFrom(std::move(output), was_enabled);
+}
+
+void
+Partition::Link(Partition &leader) noexcept
+{
+	assert(&leader != this);
+	assert(link_leader == nullptr);
+	assert(leader.link_leader == nullptr);
+	assert(n_link_followers == 0);
+
+	Stop();
+
+	for (std::size_t i = 0; i < outputs.Size(); ++i) {
+		auto &ao = outputs.Get(i);
+		if (ao.IsDummy())
+			continue;
+
+		std::string output_name = ao.GetName();
+		leader.MoveOutputHere(ao);
+
+		auto *moved = leader.outputs.FindByName(output_name);
+		assert(moved != nullptr);
+		moved->SetLinkPartition(name);
+
+		linked_outputs.emplace_back(std::move(output_name));
+	}
+
+	link_leader = &leader;
+	++leader.n_link_followers;
+
+	leader.EmitIdle(IDLE_MIXER);
+}
+
+void
+Partition::Unlink() noexcept
+{
+	assert(link_leader != nullptr);
+	assert(link_leader->n_link_followers > 0);
+
+	for (const auto &output_name : linked_outputs) {
+		auto *ao = link_leader->outputs.FindByName(output_name);
+		if (ao == nullptr || ao->IsDummy() ||
+		    ao->GetLinkPartition() != name)
+			/* the output has been moved elsewhere in the
+			   meantime */
+			continue;
+
+		MoveOutputHere(*ao);
+	}
+
+	linked_outputs.clear();
+
+	--link_leader->n_link_followers;
+	link_leader->EmitIdle(IDLE_MIXER);
+	link_leader = nullptr;
+
+	EmitIdle(IDLE_MIXER);
+}
+
+int
+Partition::GetVolume() noexcept
+{
+	if (link_leader != nullptr)
+		return link_leader->outputs.GetVolume(name);
+
+	return mixer_memento.GetVolume(outputs);
+}
+
+void
+Partition::SetVolume(unsigned volume)
+{
+	if (link_leader != nullptr)
+		link_leader->outputs.SetVolume(volume, name);
+	else
+		mixer_memento.SetVolume(outputs, volume);
+}
+
 #ifdef ENABLE_DATABASE
 
 const Database *
@@ -116,6 +219,49 @@ Partition::DatabaseModified(const Database &db) noexcept
 	EmitIdle(IDLE_DATABASE);
 }
 
+void
+Partition::SetRandomFill(std::unique_ptr<RandomFill> &&_random_fill) noexcept
+{
+	random_fill = std::move(_random_fill);
+	EmitIdle(IDLE_OPTIONS);
+
+	AutoFill();
+}
+
+void
+Partition::AutoFill() noexcept
+{
+	if (!random_fill)
+		return;
+
+	const Database *db = GetDatabase();
+	if (db == nullptr)
+		return;
+
+	const auto &queue = playlist.queue;
+
+	try {
+		while (!queue.IsFull()) {
+			const unsigned ahead = playlist.current >= 0
+				? queue.GetLength() - playlist.current - 1
+				: queue.GetLength();
+			if (ahead >= RandomFill::AHEAD)
+				break;
+
+			const auto uri = random_fill->Pick(*db);
+			if (uri.empty())
+				/* no matching song */
+				break;
+
+			playlist.AppendSong(pc,
+					    DatabaseDetachSong(*db, instance.storage,
+							       uri));
+		}
+	} catch (...) {
+		LogError(std::current_exception(), "Failed to fill the queue");
+	}
+}
+
 #endif
 
 void
@@ -132,6 +278,26 @@ Partition::TagModified(const std::string_view uri, const Tag &tag) noexcept
 	playlist.TagModified(uri, tag);
 }
 
+void
+Partition::DurationDetected() noexcept
+{
+	const auto uri = pc.LockReadDurationDetectedURI();
+
+#ifdef ENABLE_DATABASE
+	if (uri.empty() || instance.update == nullptr)
+		return;
+
+	/* the decoder plugin has remembered the duration, and its
+	   scan_file() method will report it */
+	try {
+		instance.update->Enqueue(uri, true);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to update the database");
+	}
+#endif
+}
+
 void
 Partition::SyncWithPlayer() noexcept
 {
@@ -152,6 +318,9 @@ void
 Partition::OnQueueModified() noexcept
 {
 	EmitIdle(IDLE_PLAYLIST);
+
+	/* the songs to be played next may have changed */
+	PrefetchQueue();
 }
 
 void
@@ -164,6 +333,10 @@ void
 Partition::OnQueueSongStarted() noexcept
 {
 	EmitIdle(IDLE_PLAYER);
+
+#ifdef ENABLE_DATABASE
+	AutoFill();
+#endif
 }
 
 void
@@ -200,6 +373,12 @@ Partition::OnPlayerTagModified() noexcept
 	EmitIdle(IDLE_PLAYER);
 }
 
+void
+Partition::OnPlayerDurationDetected() noexcept
+{
+	EmitGlobalEvent(DURATION_DETECTED);
+}
+
 void
 Partition::OnBorderPause() noexcept
 {
@@ -225,13 +404,25 @@ Partition::OnMixerChanged() noexcept
 void
 Partition::OnIdleMonitor(unsigned mask) noexcept
 {
+	/* don't reschedule the timer if it is already pending, to
+	   limit the latency of the first event */
+	pending_idle |= mask;
+	if (!idle_coalesce_timer.IsPending())
+		idle_coalesce_timer.Schedule(IDLE_COALESCE_DELAY);
+
+	if (mask & (IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OUTPUT))
+		instance.OnStateModified();
+}
+
+void
+Partition::OnIdleCoalesceTimer() noexcept
+{
+	const unsigned mask = std::exchange(pending_idle, 0U);
+
 	/* send "idle" notifications to all subscribed
 	   clients */
 	for (auto &client : clients)
 		client.IdleAdd(mask);
-
-	if (mask & (IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OUTPUT))
-		instance.OnStateModified();
 }
 
 void
@@ -245,4 +436,7 @@ Partition::OnGlobalEvent(unsigned mask) noexcept
 
 	if ((mask & BORDER_PAUSE) != 0)
 		BorderPause();
+
+	if ((mask & DURATION_DETECTED) != 0)
+		DurationDetected();
 }
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "event/MaskMonitor.hxx"
+#include "event/FineTimerEvent.hxx"
 #include "queue/Playlist.hxx"
 #include "queue/Listener.hxx"
 #include "output/MultipleOutputs.hxx"
@@ -18,17 +19,20 @@
 #include "SingleMode.hxx"
 #include "ConsumeMode.hxx"
 #include "Chrono.hxx"
+#include "config/PartitionConfig.hxx"
 
 #include <string>
 #include <memory>
+#include <vector>
 
-struct PartitionConfig;
 struct Instance;
 struct RangeArg;
 class MultipleOutputs;
 class SongLoader;
 class ClientListener;
 class Client;
+class InputCachePrefetcher;
+class RandomFill;
 struct ClientPerPartitionListHook;
 
 /**
@@ -39,12 +43,17 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	static constexpr unsigned TAG_MODIFIED = 0x1;
 	static constexpr unsigned SYNC_WITH_PLAYER = 0x2;
 	static constexpr unsigned BORDER_PAUSE = 0x4;
+	static constexpr unsigned DURATION_DETECTED = 0x8;
 
 	Instance &instance;
 
 	const std::string name;
 
-	const PartitionConfig &config;
+	/**
+	 * A copy of the global configuration, possibly with settings
+	 * from this partition's "partition" block.
+	 */
+	const PartitionConfig config;
 
 	std::unique_ptr<ClientListener> listener;
 
@@ -55,6 +64,28 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 */
 	MaskMonitor idle_monitor;
 
+	/**
+	 * Idle events are collected for this duration before they are
+	 * sent to the clients.  This merges bursts of events (e.g.
+	 * from many "add" commands) into one notification per client,
+	 * and all clients are notified in the same #EventLoop
+	 * iteration.
+	 */
+	static constexpr Event::Duration IDLE_COALESCE_DELAY =
+		std::chrono::milliseconds{20};
+
+	/**
+	 * Sends #pending_idle to the clients, see
+	 * #IDLE_COALESCE_DELAY.
+	 */
+	FineTimerEvent idle_coalesce_timer;
+
+	/**
+	 * Idle events received by #idle_monitor which have not yet
+	 * been sent to the clients.
+	 */
+	unsigned pending_idle = 0;
+
 	MaskMonitor global_events;
 
 	struct playlist playlist;
@@ -65,8 +96,40 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	PlayerControl pc;
 
+	/**
+	 * Holds the songs prefetched into the #InputCacheManager;
+	 * nullptr if there is no input cache.
+	 */
+	std::unique_ptr<InputCachePrefetcher> prefetcher;
+
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * If this partition has been linked to another one (see
+	 * Link()), then this is the partition whose player feeds our
+	 * outputs; nullptr otherwise.
+	 */
+	Partition *link_leader = nullptr;
+
+	/**
+	 * The names of the outputs which were moved to #link_leader
+	 * by Link().
+	 */
+	std::vector<std::string> linked_outputs;
+
+	/**
+	 * The number of partitions which are linked to this one.
+	 */
+	unsigned n_link_followers = 0;
+
+#ifdef ENABLE_DATABASE
+	/**
+	 * If set, then AutoFill() keeps appending random songs from
+	 * the database to the queue (command "autofill").
+	 */
+	std::unique_ptr<RandomFill> random_fill;
+#endif
+
 	Partition(Instance &_instance,
 		  const char *_name,
 		  const PartitionConfig &_config) noexcept;
@@ -90,7 +153,8 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	/**
 	 * Populate the #InputCacheManager with soon-to-be-played song
-	 * files.
+	 * files, and cancel prefetching songs which are no longer
+	 * going to be played soon.
 	 *
 	 * Errors will be logged.
 	 */
@@ -127,6 +191,10 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 		playlist.StaleSong(pc, uri);
 	}
 
+	void SongsMoved(std::span<const std::pair<std::string, std::string>> moved) noexcept {
+		playlist.SongsMoved(pc, moved);
+	}
+
 	void Shuffle(RangeArg range) {
 		playlist.Shuffle(pc, range);
 	}
@@ -218,6 +286,43 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 */
 	void UpdateEffectiveReplayGainMode() noexcept;
 
+	/**
+	 * Move the given output (which currently belongs to another
+	 * partition) to this partition.
+	 */
+	void MoveOutputHere(AudioOutputControl &output) noexcept;
+
+	/**
+	 * Stop playback in this partition and move all of its
+	 * outputs to the given partition, so they play its stream
+	 * with only one decoder.  The outputs keep their filters and
+	 * mixers, and their volume is still controlled by this
+	 * partition.
+	 */
+	void Link(Partition &leader) noexcept;
+
+	/**
+	 * Undo Link(): move the outputs back to this partition.
+	 */
+	void Unlink() noexcept;
+
+	/**
+	 * Returns the volume of this partition's outputs (even if
+	 * they are linked to another partition) or -1 if no mixer
+	 * can be queried.
+	 */
+	[[gnu::pure]]
+	int GetVolume() noexcept;
+
+	/**
+	 * Set the volume of this partition's outputs.
+	 *
+	 * Throws on error.
+	 *
+	 * Note: the caller is responsible for emitting #IDLE_MIXER.
+	 */
+	void SetVolume(unsigned volume);
+
 #ifdef ENABLE_DATABASE
 	/**
 	 * Returns the global #Database instance.  May return nullptr
@@ -233,6 +338,21 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 * all subsystems.
 	 */
 	void DatabaseModified(const Database &db) noexcept;
+
+	/**
+	 * Enable (or disable if nullptr) the #random_fill source and
+	 * fill the queue.
+	 */
+	void SetRandomFill(std::unique_ptr<RandomFill> &&_random_fill) noexcept;
+
+	/**
+	 * If #random_fill is set, append random songs to the queue
+	 * until there are RandomFill::AHEAD songs after the current
+	 * one.
+	 *
+	 * Errors will be logged.
+	 */
+	void AutoFill() noexcept;
 #endif
 
 	/**
@@ -247,6 +367,12 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 */
 	void TagModified(std::string_view uri, const Tag &tag) noexcept;
 
+	/**
+	 * The decoder has found out the real duration of a database
+	 * song.  Rescan it, so the database learns it, too.
+	 */
+	void DurationDetected() noexcept;
+
 	/**
 	 * Synchronize the player with the play queue.
 	 */
@@ -269,6 +395,7 @@ private:
 	void OnPlayerStateChanged() noexcept override;
 	void OnPlayerSync() noexcept override;
 	void OnPlayerTagModified() noexcept override;
+	void OnPlayerDurationDetected() noexcept override;
 	void OnBorderPause() noexcept override;
 	void OnPlayerOptionsChanged() noexcept override;
 
@@ -279,6 +406,9 @@ private:
 	/* callback for #idle_monitor */
 	void OnIdleMonitor(unsigned mask) noexcept;
 
+	/* callback for #idle_coalesce_timer */
+	void OnIdleCoalesceTimer() noexcept;
+
 	/* callback for #global_events */
 	void OnGlobalEvent(unsigned mask) noexcept;
 };
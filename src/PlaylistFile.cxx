@@ -30,6 +30,8 @@
 
 #include <cassert>
 #include <cstring>
+#include <list>
+#include <optional>
 
 using std::string_view_literals::operator""sv;
 
@@ -181,9 +183,138 @@ SavePlaylistFile(Path path_fs, const PlaylistFileContents &contents)
 	fos.Commit();
 }
 
+namespace {
+
+/**
+ * The parsed contents of a stored playlist file, which are kept in
+ * memory after an edit, so the next edit doesn't need to load and
+ * parse the file again.
+ */
+struct CachedPlaylistFile {
+	AllocatedPath path;
+
+	/**
+	 * The modification time and size of the file after it was
+	 * written by us.  If they differ, then the file was modified
+	 * by somebody else and this entry is stale.
+	 */
+	std::chrono::system_clock::time_point mtime;
+	uint_least64_t size;
+
+	PlaylistFileContents contents;
+
+	bool IsValid() const noexcept {
+		FileInfo info;
+		return GetFileInfo(path, info) && info.IsRegular() &&
+			info.GetModificationTime() == mtime &&
+			info.GetSize() == size;
+	}
+
+	/**
+	 * Remember the current modification time and size after
+	 * the file was written.
+	 *
+	 * @return false if the file cannot be accessed
+	 */
+	bool Update() noexcept {
+		FileInfo info;
+		if (!GetFileInfo(path, info))
+			return false;
+
+		mtime = info.GetModificationTime();
+		size = info.GetSize();
+		return true;
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * The most recently edited playlist files, most recent first.  This
+ * is only accessed by the main thread.
+ */
+static std::list<CachedPlaylistFile> playlist_file_cache;
+
+static constexpr std::size_t PLAYLIST_FILE_CACHE_SIZE = 8;
+
+/**
+ * Look up a valid cache entry and mark it as the most recently used
+ * one.
+ */
+static CachedPlaylistFile *
+FindCachedPlaylistFile(const AllocatedPath &path_fs) noexcept
+{
+	for (auto i = playlist_file_cache.begin();
+	     i != playlist_file_cache.end(); ++i) {
+		if (i->path != path_fs)
+			continue;
+
+		if (!i->IsValid()) {
+			playlist_file_cache.erase(i);
+			return nullptr;
+		}
+
+		playlist_file_cache.splice(playlist_file_cache.begin(),
+					   playlist_file_cache, i);
+		return &playlist_file_cache.front();
+	}
+
+	return nullptr;
+}
+
+/**
+ * Remove the contents of the specified file from the cache and
+ * return them.
+ */
+static std::optional<PlaylistFileContents>
+TakeCachedPlaylistFile(const AllocatedPath &path_fs) noexcept
+{
+	auto *cached = FindCachedPlaylistFile(path_fs);
+	if (cached == nullptr)
+		return std::nullopt;
+
+	auto contents = std::move(cached->contents);
+	playlist_file_cache.pop_front();
+	return contents;
+}
+
+/**
+ * Add the contents of a file which was just written to the cache.
+ */
+static void
+CachePlaylistFile(const AllocatedPath &path_fs,
+		  PlaylistFileContents &&contents) noexcept
+try {
+	spl_invalidate_cache(path_fs);
+
+	auto &cached = playlist_file_cache.emplace_front(path_fs);
+	if (!cached.Update()) {
+		playlist_file_cache.pop_front();
+		return;
+	}
+
+	cached.contents = std::move(contents);
+
+	if (playlist_file_cache.size() > PLAYLIST_FILE_CACHE_SIZE)
+		playlist_file_cache.pop_back();
+} catch (...) {
+	/* out of memory: don't cache */
+}
+
+void
+spl_invalidate_cache(const AllocatedPath &path_fs) noexcept
+{
+	playlist_file_cache.remove_if([&path_fs](const auto &i){
+		return i.path == path_fs;
+	});
+}
+
 static PlaylistFileContents
-LoadPlaylistFile(Path path_fs)
+LoadPlaylistFile(const AllocatedPath &path_fs)
 try {
+	if (auto cached = TakeCachedPlaylistFile(path_fs))
+		return std::move(*cached);
+
 	PlaylistFileContents contents;
 
 	assert(!path_fs.IsNull());
@@ -241,7 +372,8 @@ try {
 }
 
 static PlaylistFileContents
-MaybeLoadPlaylistFile(Path path_fs, PlaylistFileEditor::LoadMode load_mode)
+MaybeLoadPlaylistFile(const AllocatedPath &path_fs,
+		      PlaylistFileEditor::LoadMode load_mode)
 try {
 	if (load_mode == PlaylistFileEditor::LoadMode::NO)
 		return {};
@@ -344,7 +476,10 @@ PlaylistFileEditor::RemoveRange(RangeArg range)
 void
 PlaylistFileEditor::Save()
 {
+	spl_invalidate_cache(path);
 	SavePlaylistFile(path, contents);
+	CachePlaylistFile(path, std::move(contents));
+	contents.clear();
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -354,6 +489,8 @@ spl_clear(std::string_view utf8path)
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	spl_invalidate_cache(path_fs);
+
 	try {
 		TruncateFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -373,6 +510,8 @@ spl_delete(std::string_view name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	spl_invalidate_cache(path_fs);
+
 	try {
 		RemoveFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -392,6 +531,10 @@ try {
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	/* look it up before the file is modified, while it can
+	   still be validated */
+	auto *cached = FindCachedPlaylistFile(path_fs);
+
 	FileOutputStream fos(path_fs, FileOutputStream::Mode::APPEND_OR_CREATE);
 
 	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length)
@@ -405,6 +548,16 @@ try {
 	bos.Flush();
 	fos.Commit();
 
+	if (cached != nullptr) {
+		/* keep the cache entry up to date, just like
+		   PlaylistFileEditor::Insert() */
+		cached->contents.emplace_back(playlist_saveAbsolutePaths
+					      ? song.GetRealURI()
+					      : song.GetURI());
+		if (!cached->Update())
+			spl_invalidate_cache(path_fs);
+	}
+
 	idle_add(IDLE_STORED_PLAYLIST);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
@@ -420,12 +573,16 @@ spl_append_uri(std::string_view utf8file,
 }
 
 static void
-spl_rename_internal(Path from_path_fs, Path to_path_fs)
+spl_rename_internal(const AllocatedPath &from_path_fs,
+		    const AllocatedPath &to_path_fs)
 {
 	if (FileExists(to_path_fs))
 		throw PlaylistError(PlaylistResult::LIST_EXISTS,
 				    "Playlist exists already");
 
+	spl_invalidate_cache(from_path_fs);
+	spl_invalidate_cache(to_path_fs);
+
 	try {
 		RenameFile(from_path_fs, to_path_fs);
 	} catch (const std::system_error &e) {
@@ -47,6 +47,11 @@ public:
 	void RemoveIndex(unsigned i);
 	void RemoveRange(RangeArg range);
 
+	/**
+	 * Write the contents to the file.  Afterwards, this object
+	 * is empty, because the contents have been moved to the
+	 * playlist file cache for the next editor.
+	 */
 	void Save();
 
 private:
@@ -71,6 +76,14 @@ spl_valid_name(std::string_view name_utf8) noexcept;
 AllocatedPath
 spl_map_to_fs(std::string_view name_utf8);
 
+/**
+ * Discard the cached contents of the specified playlist file.  This
+ * must be called after the file was modified without using the
+ * functions in this library.
+ */
+void
+spl_invalidate_cache(const AllocatedPath &path_fs) noexcept;
+
 /**
  * Returns a list of stored_playlist_info struct pointers.
  */
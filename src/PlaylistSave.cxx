@@ -82,6 +82,8 @@ spl_save_queue(const char *name_utf8, PlaylistSaveMode save_mode, const Queue &q
 		throw PlaylistError(PlaylistResult::NO_SUCH_LIST, "No such playlist");
 	}
 
+	spl_invalidate_cache(path_fs);
+
 	FileOutputStream fos(path_fs,
 			     save_mode == PlaylistSaveMode::APPEND
 			     ? FileOutputStream::Mode::APPEND_EXISTING
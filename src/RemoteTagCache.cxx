@@ -10,6 +10,8 @@
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <cassert>
+
 static constexpr Domain remote_tag_cache_domain("remote_tag_cache");
 
 RemoteTagCache::RemoteTagCache(EventLoop &event_loop,
@@ -33,48 +35,81 @@ RemoteTagCache::Lookup(const std::string_view uri) noexcept
 	if (value) {
 		auto item = new Item(*this, uri);
 		map.insert_commit(tag, *item);
-		waiting_list.push_back(*item);
-		lock.unlock();
-
-		try {
-			item->scanner = InputScanTags(uri, *item);
-			if (!item->scanner) {
-				/* unsupported */
-				lock.lock();
-				ItemResolved(*item);
-				return;
-			}
-
-			item->scanner->Start();
-		} catch (...) {
-			FmtError(remote_tag_cache_domain,
-				 "Failed to scan tags of {:?}: {}",
-				 uri, std::current_exception());
-
-			item->scanner.reset();
-
-			lock.lock();
-			ItemResolved(*item);
+
+		if (waiting_list.size() >= MAX_SCANNERS) {
+			/* too many scanners already; start this one
+			   later */
+			pending_list.push_back(*item);
 			return;
 		}
-	} else if (tag->scanner) {
-		/* already scanning this one - no-op */
-	} else {
+
+		item->state = Item::State::WAITING;
+		waiting_list.push_back(*item);
+		StartScanner(lock, *item);
+	} else if (tag->state == Item::State::IDLE) {
 		/* already finished: re-invoke the handler */
 
-		idle_list.erase(waiting_list.iterator_to(*tag));
+		idle_list.erase(idle_list.iterator_to(*tag));
+		tag->state = Item::State::INVOKE;
 		invoke_list.push_back(*tag);
 
 		ScheduleInvokeHandlers();
+	} else {
+		/* already scanning this one (or about to) - no-op */
+	}
+}
+
+void
+RemoteTagCache::StartScanner(std::unique_lock<Mutex> &lock, Item &item) noexcept
+{
+	assert(item.state == Item::State::WAITING);
+
+	const ScopeUnlock unlock{lock};
+
+	try {
+		item.scanner = InputScanTags(item.uri, item);
+		if (!item.scanner) {
+			/* unsupported */
+			const std::scoped_lock relock{mutex};
+			ItemResolved(item);
+			return;
+		}
+
+		item.scanner->Start();
+	} catch (...) {
+		FmtError(remote_tag_cache_domain,
+			 "Failed to scan tags of {:?}: {}",
+			 item.uri, std::current_exception());
+
+		item.scanner.reset();
+
+		const std::scoped_lock relock{mutex};
+		ItemResolved(item);
+	}
+}
+
+void
+RemoteTagCache::StartPending(std::unique_lock<Mutex> &lock) noexcept
+{
+	while (!pending_list.empty() && waiting_list.size() < MAX_SCANNERS) {
+		auto &item = pending_list.pop_front();
+		item.state = Item::State::WAITING;
+		waiting_list.push_back(item);
+		StartScanner(lock, item);
 	}
 }
 
 void
 RemoteTagCache::ItemResolved(Item &item) noexcept
 {
+	assert(item.state == Item::State::WAITING);
+
 	waiting_list.erase(waiting_list.iterator_to(item));
+	item.state = Item::State::INVOKE;
 	invoke_list.push_back(item);
 
+	/* this also starts pending scanners in the EventLoop
+	   thread */
 	ScheduleInvokeHandlers();
 }
 
@@ -83,8 +118,11 @@ RemoteTagCache::InvokeHandlers() noexcept
 {
 	std::unique_lock lock{mutex};
 
+	StartPending(lock);
+
 	while (!invoke_list.empty()) {
 		auto &item = invoke_list.pop_front();
+		item.state = Item::State::IDLE;
 		idle_list.push_back(item);
 
 		const ScopeUnlock unlock{lock};
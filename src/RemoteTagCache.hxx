@@ -11,6 +11,7 @@
 #include "util/IntrusiveHashSet.hxx"
 
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -24,6 +25,14 @@ class RemoteTagCacheHandler;
 class RemoteTagCache final {
 	static constexpr size_t MAX_SIZE = 4096;
 
+	/**
+	 * The maximum number of #RemoteTagScanner instances running
+	 * at a time; more lookups are queued in #pending_list, so
+	 * adding hundreds of remote songs doesn't open hundreds of
+	 * connections at once.
+	 */
+	static constexpr size_t MAX_SCANNERS = 8;
+
 	RemoteTagCacheHandler &handler;
 
 	InjectEvent defer_invoke_handler;
@@ -39,6 +48,17 @@ class RemoteTagCache final {
 
 		const std::string uri;
 
+		/**
+		 * Which list is this item in?  Protected by
+		 * RemoteTagCache::mutex.
+		 */
+		enum class State : uint_least8_t {
+			PENDING,
+			WAITING,
+			INVOKE,
+			IDLE,
+		} state = State::PENDING;
+
 		std::unique_ptr<RemoteTagScanner> scanner;
 
 		Tag tag;
@@ -59,7 +79,8 @@ class RemoteTagCache final {
 		};
 	};
 
-	using ItemList = IntrusiveList<Item>;
+	using ItemList = IntrusiveList<Item, IntrusiveListBaseHookTraits<Item>,
+				       IntrusiveListOptions{.constant_time_size = true}>;
 
 	/**
 	 * These items have been resolved completely (successful or
@@ -69,6 +90,12 @@ class RemoteTagCache final {
 	 */
 	ItemList idle_list;
 
+	/**
+	 * These items wait for a #RemoteTagScanner to be started,
+	 * because #MAX_SCANNERS are already running (oldest first).
+	 */
+	ItemList pending_list;
+
 	/**
 	 * A #RemoteTagScanner instances is currently busy on fetching
 	 * information, and we're waiting for our #RemoteTagHandler
@@ -105,5 +132,17 @@ private:
 		defer_invoke_handler.Schedule();
 	}
 
+	/**
+	 * Start a #RemoteTagScanner for an item which was just added
+	 * to #waiting_list.  The mutex gets unlocked temporarily.
+	 */
+	void StartScanner(std::unique_lock<Mutex> &lock, Item &item) noexcept;
+
+	/**
+	 * Start scanners for items from #pending_list until
+	 * #MAX_SCANNERS are running.
+	 */
+	void StartPending(std::unique_lock<Mutex> &lock) noexcept;
+
 	void ItemResolved(Item &item) noexcept;
 };
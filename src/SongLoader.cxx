@@ -73,19 +73,24 @@ SongLoader::LoadSong(const LocatedUri &located_uri) const
 	std::unreachable();
 }
 
-DetachedSong
-SongLoader::LoadSong(const char *uri_utf8) const
+LocatedUri
+SongLoader::Locate(const char *uri_utf8) const
 {
 #if !CLANG_CHECK_VERSION(3,6)
 	/* disabled on clang due to -Wtautological-pointer-compare */
 	assert(uri_utf8 != nullptr);
 #endif
 
-	const auto located_uri = LocateUri(UriPluginKind::INPUT,
-					   uri_utf8, client
+	return LocateUri(UriPluginKind::INPUT,
+			 uri_utf8, client
 #ifdef ENABLE_DATABASE
-					   , storage
+			 , storage
 #endif
-					   );
-	return LoadSong(located_uri);
+			 );
+}
+
+DetachedSong
+SongLoader::LoadSong(const char *uri_utf8) const
+{
+	return LoadSong(Locate(uri_utf8));
 }
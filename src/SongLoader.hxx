@@ -45,11 +45,24 @@ public:
 #endif
 
 #ifdef ENABLE_DATABASE
+	const Database *GetDatabase() const noexcept {
+		return db;
+	}
+
 	Storage *GetStorage() const noexcept {
 		return storage;
 	}
 #endif
 
+	/**
+	 * Locate the given URI (including the security checks), but
+	 * don't load the song.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	[[gnu::nonnull]]
+	LocatedUri Locate(const char *uri_utf8) const;
+
 	DetachedSong LoadSong(const LocatedUri &uri) const;
 
 	/**
@@ -23,6 +23,7 @@
 
 #define SONG_MTIME "mtime"
 #define SONG_ADDED "added"
+#define SONG_FILE_ID "FileId"
 #define SONG_END "song_end"
 
 static void
@@ -59,6 +60,10 @@ song_save(BufferedOutputStream &os, const Song &song)
 	if (!IsNegative(song.added))
 		os.Fmt(SONG_ADDED ": {}\n",
 		       std::chrono::system_clock::to_time_t(song.added));
+
+	if (song.file_id != 0)
+		os.Fmt(SONG_FILE_ID ": {:x}\n", song.file_id);
+
 	os.Write(SONG_END "\n");
 }
 
@@ -83,7 +88,8 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 
 DetachedSong
 song_load(LineReader &file, const char *uri,
-	  std::string *target_r, bool *in_playlist_r)
+	  std::string *target_r, bool *in_playlist_r,
+	  uint64_t *file_id_r)
 {
 	DetachedSong song(uri);
 
@@ -133,6 +139,9 @@ song_load(LineReader &file, const char *uri,
 		} else if (StringIsEqual(line, "InPlaylist")) {
 			if (in_playlist_r != nullptr)
 				*in_playlist_r = StringIsEqual(value, "yes");
+		} else if (StringIsEqual(line, SONG_FILE_ID)) {
+			if (file_id_r != nullptr)
+				*file_id_r = strtoull(value, nullptr, 16);
 		} else {
 			throw FmtRuntimeError("unknown line in db: {}", line);
 		}
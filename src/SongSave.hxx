@@ -4,6 +4,7 @@
 #ifndef MPD_SONG_SAVE_HXX
 #define MPD_SONG_SAVE_HXX
 
+#include <cstdint>
 #include <memory>
 
 #define SONG_BEGIN "song_begin: "
@@ -28,6 +29,7 @@ song_save(BufferedOutputStream &os, const DetachedSong &song);
  */
 DetachedSong
 song_load(LineReader &file, const char *uri,
-	  std::string *target_r=nullptr, bool *in_playlist_r=nullptr);
+	  std::string *target_r=nullptr, bool *in_playlist_r=nullptr,
+	  uint64_t *file_id_r=nullptr);
 
 #endif
@@ -85,6 +85,7 @@ Song::UpdateFile(Storage &storage, const StorageFileInfo &info)
 	}
 
 	mtime = info.mtime;
+	file_id = info.GetFileId();
 	audio_format = new_audio_format;
 	tag_builder.Commit(tag);
 	return true;
@@ -8,11 +8,14 @@
 #include "io/FileLineReader.hxx"
 #include "io/FileOutputStream.hxx"
 #include "io/BufferedOutputStream.hxx"
+#include "io/StringOutputStream.hxx"
 #include "storage/StorageState.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "SongLoader.hxx"
+#include "thread/Name.hxx"
 #include "util/Domain.hxx"
+#include "util/SpanCast.hxx"
 #include "Log.hxx"
 
 #include <exception>
@@ -23,10 +26,16 @@ StateFile::StateFile(StateFileConfig &&_config,
 		     Partition &_partition, EventLoop &_loop)
 	:config(std::move(_config)), path_utf8(config.path.ToUTF8()),
 	 timer_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+	 write_done_event(_loop, BIND_THIS_METHOD(OnWriteDone)),
 	 partition(_partition)
 {
 }
 
+StateFile::~StateFile() noexcept
+{
+	JoinWriter();
+}
+
 void
 StateFile::RememberVersions() noexcept
 {
@@ -62,27 +71,51 @@ StateFile::Write(BufferedOutputStream &os)
 	storage_state_save(os, partition.instance);
 #endif
 
-	playlist_state_save(os, partition.playlist, partition.pc);
+	playlist_state_save(os, partition.playlist, partition.pc,
+			    queue_cache);
 }
 
-inline void
-StateFile::Write(OutputStream &os)
+std::string
+StateFile::Serialize()
 {
-	BufferedOutputStream bos(os);
+	StringOutputStream sos;
+	BufferedOutputStream bos(sos);
 	Write(bos);
 	bos.Flush();
+	return std::move(sos).GetValue();
+}
+
+void
+StateFile::WriteData(std::string_view data) const noexcept
+try {
+	FileOutputStream fos(config.path);
+	fos.Write(AsBytes(data));
+	fos.Commit();
+} catch (...) {
+	LogError(std::current_exception());
+}
+
+void
+StateFile::JoinWriter() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	thread.Join();
+	write_done_event.Cancel();
+	pending_data = {};
 }
 
 void
 StateFile::Write()
 {
+	JoinWriter();
+
 	FmtDebug(state_file_domain,
 		 "Saving state file {}", path_utf8);
 
 	try {
-		FileOutputStream fos(config.path);
-		Write(fos);
-		fos.Commit();
+		WriteData(Serialize());
 	} catch (...) {
 		LogError(std::current_exception());
 	}
@@ -138,5 +171,49 @@ StateFile::CheckModified() noexcept
 void
 StateFile::OnTimeout() noexcept
 {
-	Write();
+	if (thread.IsDefined()) {
+		/* the previous write is still running; try again
+		   later */
+		timer_event.Schedule(std::chrono::seconds{1});
+		return;
+	}
+
+	FmtDebug(state_file_domain,
+		 "Saving state file {}", path_utf8);
+
+	/* only formatting happens in the main thread; the file is
+	   written by #thread */
+	try {
+		pending_data = Serialize();
+	} catch (...) {
+		LogError(std::current_exception());
+		return;
+	}
+
+	RememberVersions();
+
+	try {
+		thread.Start();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start the state file thread");
+		WriteData(pending_data);
+		pending_data = {};
+	}
+}
+
+void
+StateFile::RunWriter() noexcept
+{
+	SetThreadName("state_file");
+
+	WriteData(pending_data);
+
+	write_done_event.Schedule();
+}
+
+void
+StateFile::OnWriteDone() noexcept
+{
+	JoinWriter();
 }
@@ -6,11 +6,14 @@
 #include "StateFileConfig.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #include "event/FarTimerEvent.hxx"
+#include "event/InjectEvent.hxx"
+#include "queue/Save.hxx"
+#include "thread/Thread.hxx"
 
 #include <string>
+#include <string_view>
 
 struct Partition;
-class OutputStream;
 class BufferedOutputStream;
 
 class StateFile final {
@@ -20,6 +23,25 @@ class StateFile final {
 
 	FarTimerEvent timer_event;
 
+	/**
+	 * Notifies the main thread that #thread has finished.
+	 */
+	InjectEvent write_done_event;
+
+	/**
+	 * Writes #pending_data to the file, so the main thread
+	 * doesn't block on disk I/O.
+	 */
+	Thread thread{BIND_THIS_METHOD(RunWriter)};
+
+	/**
+	 * The serialized state which is being written by #thread.
+	 * It is owned by #thread while that is running.
+	 */
+	std::string pending_data;
+
+	QueueSaveCache queue_cache;
+
 	Partition &partition;
 
 	/**
@@ -37,7 +59,14 @@ public:
 	StateFile(StateFileConfig &&_config,
 		  Partition &partition, EventLoop &loop);
 
+	~StateFile() noexcept;
+
 	void Read();
+
+	/**
+	 * Write the state file synchronously (after waiting for a
+	 * background write to finish).
+	 */
 	void Write();
 
 	/**
@@ -46,9 +75,24 @@ public:
 	void CheckModified() noexcept;
 
 private:
-	void Write(OutputStream &os);
 	void Write(BufferedOutputStream &os);
 
+	/**
+	 * Format the current state.
+	 */
+	std::string Serialize();
+
+	/**
+	 * Write the given serialized state to the file and log
+	 * errors.  This may be called by any thread.
+	 */
+	void WriteData(std::string_view data) const noexcept;
+
+	/**
+	 * Wait for #thread to finish (if it is running).
+	 */
+	void JoinWriter() noexcept;
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
@@ -63,4 +107,10 @@ private:
 
 	/* callback for #timer_event */
 	void OnTimeout() noexcept;
+
+	/* the #thread function */
+	void RunWriter() noexcept;
+
+	/* callback for #write_done_event */
+	void OnWriteDone() noexcept;
 };
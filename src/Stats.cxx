@@ -12,11 +12,17 @@
 #include "db/Stats.hxx"
 #include "Log.hxx"
 #include "time/ChronoUtil.hxx"
+#include "config.h" // for ENABLE_CURL
 
 #ifdef _WIN32
 #include "system/Clock.hxx"
 #endif
 
+#ifdef ENABLE_CURL
+#include "lib/curl/Global.hxx"
+#include "lib/curl/Init.hxx"
+#endif
+
 #include <fmt/format.h>
 
 #include <chrono>
@@ -118,4 +124,11 @@ stats_print(Response &r, const Partition &partition)
 	if (db != nullptr)
 		db_stats_print(r, *db);
 #endif
+
+#ifdef ENABLE_CURL
+	if (CurlStats curl_stats; CurlInit::GetStats(curl_stats))
+		r.Fmt("http_requests: {}\n"
+		      "http_connections: {}\n",
+		      curl_stats.requests, curl_stats.connections);
+#endif
 }
@@ -12,6 +12,7 @@
 #include "input/LocalOpen.hxx"
 
 #include <cassert>
+#include <string>
 
 class TagFileScan {
 	const Path path_fs;
@@ -37,23 +38,61 @@ public:
 		if (plugin.scan_stream == nullptr)
 			return false;
 
-		/* open the InputStream (if not already open) */
-		if (is == nullptr) {
-			is = OpenLocalInputStream(path_fs, mutex);
-		} else {
-			is->LockRewind();
-		}
-
 		/* now try the stream_tag() method */
-		return plugin.ScanStream(*is, handler);
+		return plugin.ScanStream(GetInputStream(), handler);
 	}
 
 	bool Scan(const DecoderPlugin &plugin) {
 		return plugin.SupportsSuffix(suffix) &&
 			(ScanFile(plugin) || ScanStream(plugin));
 	}
+
+	bool ScanAll() {
+		for (const auto &plugin : GetEnabledDecoderPlugins()) {
+			if (Scan(plugin))
+				return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Scan APE and ID3 tags, reusing the #InputStream which was
+	 * opened by ScanStream() (if any).
+	 */
+	bool ScanGeneric() {
+		return ScanGenericTags(GetInputStream(), handler);
+	}
+
+private:
+	/**
+	 * Open the #InputStream (if not already open) or rewind it.
+	 */
+	InputStream &GetInputStream() {
+		if (is == nullptr) {
+			is = OpenLocalInputStream(path_fs, mutex);
+		} else {
+			is->LockRewind();
+		}
+
+		return *is;
+	}
 };
 
+/**
+ * Returns the filename suffix of the given path in UTF-8 or an empty
+ * string if there is none.
+ */
+static std::string
+GetSuffixUTF8(Path path_fs)
+{
+	const auto *suffix = path_fs.GetExtension();
+	if (suffix == nullptr)
+		return {};
+
+	return Path::FromFS(suffix).ToUTF8();
+}
+
 bool
 ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 {
@@ -61,32 +100,34 @@ ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 
 	/* check if there's a suffix and a plugin */
 
-	const auto *suffix = path_fs.GetExtension();
-	if (suffix == nullptr)
+	const auto suffix_utf8 = GetSuffixUTF8(path_fs);
+	if (suffix_utf8.empty())
 		return false;
 
-	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
-
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
-	for (const auto &plugin : GetEnabledDecoderPlugins()) {
-		if (tfs.Scan(plugin))
-			return true;
-	}
-
-	return false;
+	return tfs.ScanAll();
 }
 
 bool
 ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
 			AudioFormat *audio_format)
 {
+	assert(!path.IsNull());
+
+	const auto suffix_utf8 = GetSuffixUTF8(path);
+	if (suffix_utf8.empty())
+		return false;
+
 	FullTagHandler h(builder, audio_format);
 
-	if (!ScanFileTagsNoGeneric(path, h))
+	/* one TagFileScan for both passes, so the file is opened
+	   only once */
+	TagFileScan tfs(path, suffix_utf8.c_str(), h);
+	if (!tfs.ScanAll())
 		return false;
 
 	if (builder.empty())
-		ScanGenericTags(path, h);
+		tfs.ScanGeneric();
 
 	return true;
 }
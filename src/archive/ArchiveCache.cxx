@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ArchiveCache.hxx"
+#include "ArchivePlugin.hxx"
+#include "ArchiveFile.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <algorithm> // for std::copy_n()
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+ * The maximum number of archives kept open.
+ */
+static constexpr std::size_t ARCHIVE_CACHE_MAX_FILES = 8;
+
+/**
+ * Entries larger than this are not copied to memory.
+ */
+static constexpr std::size_t ARCHIVE_CACHE_MAX_ENTRY_SIZE = 1024 * 1024;
+
+/**
+ * The maximum total size of all entries kept in memory.
+ */
+static constexpr std::size_t ARCHIVE_CACHE_MAX_ENTRIES_SIZE = 16 * 1024 * 1024;
+
+[[gnu::pure]]
+static bool
+IsSamePath(Path a, Path b) noexcept
+{
+	return PathTraitsFS::string_view{a.c_str()} == b.c_str();
+}
+
+namespace {
+
+/**
+ * Describes the version of an archive file.  A cached object is only
+ * used if it was made from an archive file with the same attributes.
+ */
+struct ArchiveVersion {
+	uint_least64_t size;
+	std::chrono::system_clock::time_point mtime;
+
+	explicit ArchiveVersion(const FileInfo &fi) noexcept
+		:size(fi.GetSize()), mtime(fi.GetModificationTime()) {}
+
+	bool operator==(const ArchiveVersion &) const noexcept = default;
+};
+
+using EntryBuffer = AllocatedArray<std::byte>;
+
+/**
+ * An #InputStream reading from a shared in-memory copy of an archive
+ * entry.
+ */
+class ArchiveEntryInputStream final : public InputStream {
+	const std::shared_ptr<const EntryBuffer> buffer;
+
+public:
+	ArchiveEntryInputStream(const char *_uri, Mutex &_mutex,
+				std::shared_ptr<const EntryBuffer> _buffer) noexcept
+		:InputStream(_uri, _mutex), buffer(std::move(_buffer))
+	{
+		size = buffer->size();
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+
+	[[nodiscard]] bool IsEOF() const noexcept override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(std::unique_lock<Mutex> &,
+		    std::span<std::byte> dest) override {
+		const auto src = GetContiguous().subspan(offset);
+		const std::size_t nbytes = std::min(dest.size(), src.size());
+		std::copy_n(src.begin(), nbytes, dest.begin());
+		offset += nbytes;
+		return nbytes;
+	}
+
+	void Seek(std::unique_lock<Mutex> &,
+		  offset_type new_offset) override {
+		if (std::cmp_greater(new_offset, buffer->size()))
+			throw std::runtime_error{"Bad offset"};
+
+		offset = new_offset;
+	}
+
+	std::span<const std::byte> GetContiguous() const noexcept override {
+		return {buffer->data(), buffer->size()};
+	}
+};
+
+class ArchiveCache {
+	struct File {
+		AllocatedPath path;
+		ArchiveVersion version;
+		std::shared_ptr<ArchiveFile> file;
+	};
+
+	struct Entry {
+		AllocatedPath archive_path;
+		ArchiveVersion version;
+		std::string inside;
+		std::shared_ptr<const EntryBuffer> buffer;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used one first.
+	 */
+	std::list<File> files;
+
+	/**
+	 * The most recently used one first.
+	 */
+	std::list<Entry> entries;
+
+	/**
+	 * The total size of all #entries.
+	 */
+	std::size_t entries_size = 0;
+
+public:
+	InputStreamPtr OpenStream(const ArchivePlugin &plugin,
+				  Path archive_path, const char *inside,
+				  Mutex &stream_mutex);
+
+private:
+	std::shared_ptr<ArchiveFile> OpenFile(const ArchivePlugin &plugin,
+					      Path path,
+					      const ArchiveVersion &version);
+
+	std::shared_ptr<const EntryBuffer> FindEntry(Path archive_path,
+						     const ArchiveVersion &version,
+						     std::string_view inside) noexcept;
+
+	void AddEntry(Path archive_path, const ArchiveVersion &version,
+		      std::string_view inside,
+		      std::shared_ptr<const EntryBuffer> buffer) noexcept;
+};
+
+} // anonymous namespace
+
+std::shared_ptr<ArchiveFile>
+ArchiveCache::OpenFile(const ArchivePlugin &plugin, Path path,
+		       const ArchiveVersion &version)
+{
+	{
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = files.begin(); i != files.end(); ++i) {
+			if (!IsSamePath(i->path, path))
+				continue;
+
+			if (i->version == version) {
+				files.splice(files.begin(), files, i);
+				return i->file;
+			}
+
+			/* the archive has been modified */
+			files.erase(i);
+			break;
+		}
+	}
+
+	/* parsing the directory may take a while; don't hold the
+	   lock meanwhile */
+	std::shared_ptr<ArchiveFile> file = archive_file_open(&plugin, path);
+
+	const std::scoped_lock lock{mutex};
+
+	if (files.size() >= ARCHIVE_CACHE_MAX_FILES)
+		files.pop_back();
+
+	files.push_front({AllocatedPath{path}, version, file});
+	return file;
+}
+
+std::shared_ptr<const EntryBuffer>
+ArchiveCache::FindEntry(Path archive_path, const ArchiveVersion &version,
+			std::string_view inside) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	for (auto i = entries.begin(); i != entries.end(); ++i) {
+		if (!IsSamePath(i->archive_path, archive_path) ||
+		    i->inside != inside)
+			continue;
+
+		if (i->version != version) {
+			/* the archive has been modified */
+			entries_size -= i->buffer->size();
+			entries.erase(i);
+			return nullptr;
+		}
+
+		entries.splice(entries.begin(), entries, i);
+		return i->buffer;
+	}
+
+	return nullptr;
+}
+
+void
+ArchiveCache::AddEntry(Path archive_path, const ArchiveVersion &version,
+		       std::string_view inside,
+		       std::shared_ptr<const EntryBuffer> buffer) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	while (!entries.empty() &&
+	       entries_size + buffer->size() > ARCHIVE_CACHE_MAX_ENTRIES_SIZE) {
+		entries_size -= entries.back().buffer->size();
+		entries.pop_back();
+	}
+
+	entries_size += buffer->size();
+	entries.push_front({AllocatedPath{archive_path}, version,
+			    std::string{inside}, std::move(buffer)});
+}
+
+inline InputStreamPtr
+ArchiveCache::OpenStream(const ArchivePlugin &plugin, Path archive_path,
+			 const char *inside, Mutex &stream_mutex)
+{
+	FileInfo fi{archive_path};
+	const ArchiveVersion version{fi};
+
+	if (auto buffer = FindEntry(archive_path, version, inside))
+		return std::make_unique<ArchiveEntryInputStream>(inside,
+								 stream_mutex,
+								 std::move(buffer));
+
+	auto is = OpenFile(plugin, archive_path, version)
+		->OpenStream(inside, stream_mutex);
+
+	/* no need to lock: archive streams are always ready */
+	if (!is->KnownSize() || is->GetSize() > ARCHIVE_CACHE_MAX_ENTRY_SIZE ||
+	    /* already in memory (e.g. a stored ZIP entry) */
+	    !is->GetContiguous().empty())
+		return is;
+
+	/* small entry: decompress it completely and keep a copy */
+
+	auto buffer = std::make_shared<EntryBuffer>(is->GetSize());
+	is->LockReadFull(*buffer);
+	is.reset();
+
+	AddEntry(archive_path, version, inside, buffer);
+
+	return std::make_unique<ArchiveEntryInputStream>(inside, stream_mutex,
+							 std::move(buffer));
+}
+
+static ArchiveCache archive_cache;
+
+InputStreamPtr
+archive_cache_open_stream(const ArchivePlugin &plugin, Path archive_path,
+			  const char *inside, Mutex &mutex)
+{
+	return archive_cache.OpenStream(plugin, archive_path, inside, mutex);
+}
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "input/Ptr.hxx"
+#include "thread/Mutex.hxx"
+
+struct ArchivePlugin;
+class Path;
+
+/**
+ * Open a file inside an archive.  Unlike
+ * archive_file_open()+ArchiveFile::OpenStream(), this keeps the most
+ * recently used archives open, so their directory doesn't need to be
+ * parsed again for each song, and it keeps copies of small
+ * (decompressed) entries in memory.
+ *
+ * This function is thread-safe.
+ *
+ * Throws on error.
+ *
+ * @param archive_path the path of the archive file
+ * @param inside the path inside the archive
+ */
+InputStreamPtr
+archive_cache_open_stream(const ArchivePlugin &plugin, Path archive_path,
+			  const char *inside, Mutex &mutex);
@@ -9,6 +9,12 @@
 
 class ArchiveVisitor;
 
+/**
+ * An opened archive.  Instances may be shared by several threads
+ * (see ArchiveCache.hxx), therefore all methods must be thread-safe,
+ * and the streams returned by OpenStream() must be usable
+ * concurrently.
+ */
 class ArchiveFile {
 public:
 	virtual ~ArchiveFile() noexcept = default;
@@ -19,7 +25,8 @@ public:
 	virtual void Visit(ArchiveVisitor &visitor) = 0;
 
 	/**
-	 * Opens an InputStream of a file within the archive.
+	 * Opens an InputStream of a file within the archive.  This
+	 * may be called any number of times.
 	 *
 	 * Throws std::runtime_error on error.
 	 *
@@ -11,6 +11,7 @@
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
 #include "thread/ScopeUnlock.hxx"
@@ -20,13 +21,33 @@
 #include <stdexcept>
 #include <utility>
 
+/**
+ * The #Mutex for all #InputStream instances reading the compressed
+ * files.
+ */
+static Mutex bz2_input_mutex;
+
 class Bzip2ArchiveFile final : public ArchiveFile {
+	const AllocatedPath path;
+
 	std::string name;
-	std::shared_ptr<InputStream> istream;
+
+	/**
+	 * Protects #istream.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The stream which was opened by bz2_open() and has not been
+	 * used yet.  All subsequent OpenStream() calls open a new
+	 * one, because each #Bzip2InputStream consumes its input.
+	 */
+	InputStreamPtr istream;
 
 public:
-	Bzip2ArchiveFile(Path path, InputStreamPtr &&_is)
-		:name(NarrowPath(path.GetBase())),
+	Bzip2ArchiveFile(Path _path, InputStreamPtr &&_is)
+		:path(_path),
+		 name(NarrowPath(_path.GetBase())),
 		 istream(std::move(_is)) {
 		// remove .bz2 suffix
 		const size_t len = name.length();
@@ -75,8 +96,7 @@ private:
 static std::unique_ptr<ArchiveFile>
 bz2_open(Path pathname)
 {
-	static Mutex mutex;
-	auto is = OpenLocalInputStream(pathname, mutex);
+	auto is = OpenLocalInputStream(pathname, bz2_input_mutex);
 	return std::make_unique<Bzip2ArchiveFile>(pathname, std::move(is));
 }
 
@@ -103,10 +123,20 @@ Bzip2InputStream::~Bzip2InputStream() noexcept
 }
 
 InputStreamPtr
-Bzip2ArchiveFile::OpenStream(const char *path,
-			     Mutex &mutex)
+Bzip2ArchiveFile::OpenStream(const char *uri,
+			     Mutex &_mutex)
 {
-	return std::make_unique<Bzip2InputStream>(istream, path, mutex);
+	InputStreamPtr input;
+
+	{
+		const std::scoped_lock lock{mutex};
+		input = std::move(istream);
+	}
+
+	if (!input)
+		input = OpenLocalInputStream(path, bz2_input_mutex);
+
+	return std::make_unique<Bzip2InputStream>(std::move(input), uri, _mutex);
 }
 
 inline bool
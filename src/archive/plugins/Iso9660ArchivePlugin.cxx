@@ -13,6 +13,7 @@
 #include "fs/Path.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
 #include "thread/ScopeUnlock.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UTF8.hxx"
@@ -29,6 +30,14 @@
 struct Iso9660 {
 	iso9660_t *const iso;
 
+	/**
+	 * Protects all libiso9660 calls on #iso, because they share
+	 * the file position.  An #Iso9660 may be used by several
+	 * threads at a time because the archive cache shares
+	 * #ArchiveFile instances.
+	 */
+	mutable Mutex mutex;
+
 	explicit Iso9660(Path path)
 		:iso(iso9660_open(path.c_str())) {
 		if (iso == nullptr)
@@ -44,6 +53,7 @@ struct Iso9660 {
 	Iso9660 &operator=(const Iso9660 &) = delete;
 
 	long SeekRead(void *ptr, lsn_t start, long int i_size) const {
+		const std::scoped_lock lock{mutex};
 		return iso9660_iso_seek_read(iso, ptr, start, i_size);
 	}
 };
@@ -126,6 +136,8 @@ iso9660_archive_open(Path pathname)
 void
 Iso9660ArchiveFile::Visit(ArchiveVisitor &visitor)
 {
+	const std::scoped_lock lock{iso->mutex};
+
 	char path[4096] = "/";
 	Visit(path, 1, sizeof(path), visitor);
 }
@@ -222,7 +234,13 @@ InputStreamPtr
 Iso9660ArchiveFile::OpenStream(const char *pathname,
 			       Mutex &mutex)
 {
-	auto statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
+	iso9660_stat_t *statbuf;
+
+	{
+		const std::scoped_lock lock{iso->mutex};
+		statbuf = iso9660_ifs_stat_translate(iso->iso, pathname);
+	}
+
 	if (statbuf == nullptr)
 		throw FmtRuntimeError("not found in the ISO file: {:?}",
 				      pathname);
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ZipStoredIndex.hxx"
+#include "io/FileDescriptor.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/PackedLittleEndian.hxx"
+#include "util/SpanCast.hxx"
+
+#include <algorithm> // for std::min()
+
+#include <string.h> // for memcpy()
+
+namespace {
+
+struct ZipEndOfCentralDirectory {
+	static constexpr uint32_t SIGNATURE = 0x06054b50;
+
+	PackedLE32 signature;
+	PackedLE16 disk_number, directory_disk;
+	PackedLE16 disk_entries, total_entries;
+	PackedLE32 directory_size, directory_offset;
+	PackedLE16 comment_length;
+};
+
+static_assert(sizeof(ZipEndOfCentralDirectory) == 22);
+
+struct ZipCentralDirectoryHeader {
+	static constexpr uint32_t SIGNATURE = 0x02014b50;
+
+	PackedLE32 signature;
+	PackedLE16 version_made_by, version_needed;
+	PackedLE16 flags, method;
+	PackedLE16 mtime, mdate;
+	PackedLE32 crc32, compressed_size, uncompressed_size;
+	PackedLE16 name_length, extra_length, comment_length;
+	PackedLE16 disk_start, internal_attributes;
+	PackedLE32 external_attributes, local_header_offset;
+};
+
+static_assert(sizeof(ZipCentralDirectoryHeader) == 46);
+
+struct ZipLocalFileHeader {
+	static constexpr uint32_t SIGNATURE = 0x04034b50;
+
+	PackedLE32 signature;
+	PackedLE16 version_needed, flags, method;
+	PackedLE16 mtime, mdate;
+	PackedLE32 crc32, compressed_size, uncompressed_size;
+	PackedLE16 name_length, extra_length;
+};
+
+static_assert(sizeof(ZipLocalFileHeader) == 30);
+
+/**
+ * The "encrypted" bit in the "flags" field.
+ */
+static constexpr unsigned ZIP_FLAG_ENCRYPTED = 0x1;
+
+/**
+ * The value of the "method" field for stored entries.
+ */
+static constexpr unsigned ZIP_METHOD_STORED = 0;
+
+/**
+ * Signals a ZIP64 archive in 32 bit fields.
+ */
+static constexpr uint32_t ZIP64_MARKER = 0xffffffff;
+
+/**
+ * Don't load central directories larger than this.
+ */
+static constexpr std::size_t MAX_DIRECTORY_SIZE = 64 * 1024 * 1024;
+
+} // anonymous namespace
+
+template<typename T>
+static bool
+ReadStruct(FileDescriptor fd, off_t offset, T &dest) noexcept
+{
+	return fd.ReadAt(offset, ReferenceAsWritableBytes(dest)) == sizeof(dest);
+}
+
+/**
+ * Find the "end of central directory" record, which is at the end
+ * of the file, followed by a comment of up to 64 kB.
+ */
+static bool
+FindEndOfCentralDirectory(FileDescriptor fd,
+			  ZipEndOfCentralDirectory &eocd) noexcept
+{
+	const off_t file_size = fd.GetSize();
+	if (file_size < off_t(sizeof(eocd)))
+		return false;
+
+	const std::size_t tail_size =
+		std::min<off_t>(file_size, sizeof(eocd) + 0xffff);
+	const off_t tail_offset = file_size - tail_size;
+
+	AllocatedArray<std::byte> tail{tail_size};
+	if (fd.ReadAt(tail_offset, tail) != ssize_t(tail_size))
+		return false;
+
+	for (std::size_t i = tail_size - sizeof(eocd);; --i) {
+		memcpy(&eocd, tail.data() + i, sizeof(eocd));
+		if (eocd.signature == ZipEndOfCentralDirectory::SIGNATURE &&
+		    i + sizeof(eocd) + eocd.comment_length == tail_size)
+			return true;
+
+		if (i == 0)
+			return false;
+	}
+}
+
+ZipStoredIndex::ZipStoredIndex(FileDescriptor fd) noexcept
+{
+	ZipEndOfCentralDirectory eocd;
+	if (!FindEndOfCentralDirectory(fd, eocd) ||
+	    eocd.directory_offset == ZIP64_MARKER ||
+	    eocd.directory_size > MAX_DIRECTORY_SIZE)
+		return;
+
+	AllocatedArray<std::byte> buffer{eocd.directory_size};
+	if (fd.ReadAt(eocd.directory_offset, buffer) != ssize_t(buffer.size()))
+		return;
+
+	std::span<const std::byte> directory{buffer.data(), buffer.size()};
+	while (directory.size() >= sizeof(ZipCentralDirectoryHeader)) {
+		ZipCentralDirectoryHeader header;
+		memcpy(&header, directory.data(), sizeof(header));
+		if (header.signature != ZipCentralDirectoryHeader::SIGNATURE)
+			break;
+
+		directory = directory.subspan(sizeof(header));
+		const std::size_t variable_size = header.name_length +
+			header.extra_length + header.comment_length;
+		if (directory.size() < variable_size)
+			break;
+
+		const auto name = ToStringView(directory.first(header.name_length));
+		directory = directory.subspan(variable_size);
+
+		if (header.method == ZIP_METHOD_STORED &&
+		    (header.flags & ZIP_FLAG_ENCRYPTED) == 0 &&
+		    header.compressed_size == header.uncompressed_size &&
+		    header.compressed_size > 0 &&
+		    header.compressed_size != ZIP64_MARKER &&
+		    header.local_header_offset != ZIP64_MARKER)
+			entries.emplace(name, Entry{
+					header.local_header_offset,
+					header.compressed_size,
+				});
+	}
+}
+
+std::optional<ZipStoredIndex::Slice>
+ZipStoredIndex::Find(FileDescriptor fd, std::string_view name) const noexcept
+{
+	const auto i = entries.find(std::string{name});
+	if (i == entries.end())
+		return std::nullopt;
+
+	const auto &entry = i->second;
+
+	/* the local header may have a different "extra" field, so
+	   it needs to be read to find the contents */
+	ZipLocalFileHeader header;
+	if (!ReadStruct(fd, entry.local_header_offset, header) ||
+	    header.signature != ZipLocalFileHeader::SIGNATURE)
+		return std::nullopt;
+
+	const uint_least64_t offset = uint_least64_t(entry.local_header_offset) +
+		sizeof(header) + header.name_length + header.extra_length;
+	if (offset + entry.size > uint_least64_t(fd.GetSize()))
+		return std::nullopt;
+
+	return Slice{offset, entry.size};
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class FileDescriptor;
+
+/**
+ * An index of the "stored" (i.e. uncompressed, method 0) entries of
+ * a ZIP file, obtained by parsing its central directory.  Their
+ * contents can be read directly from the ZIP file, without going
+ * through zziplib.
+ *
+ * Only plain (non-ZIP64, unencrypted) archives are supported; for
+ * all others, the index is empty.
+ */
+class ZipStoredIndex {
+	struct Entry {
+		uint_least32_t local_header_offset;
+		uint_least32_t size;
+	};
+
+	std::unordered_map<std::string, Entry> entries;
+
+public:
+	/**
+	 * A range of bytes inside the ZIP file.
+	 */
+	struct Slice {
+		uint_least64_t offset, size;
+	};
+
+	ZipStoredIndex() noexcept = default;
+
+	/**
+	 * Parse the central directory.  Errors are not fatal; they
+	 * just leave the index empty.
+	 */
+	explicit ZipStoredIndex(FileDescriptor fd) noexcept;
+
+	/**
+	 * Look up a stored entry and determine the location of its
+	 * contents.
+	 *
+	 * @return the contents or std::nullopt if the entry does not
+	 * exist or is compressed
+	 */
+	std::optional<Slice> Find(FileDescriptor fd,
+				  std::string_view name) const noexcept;
+};
@@ -10,26 +10,63 @@
 #include "../ArchiveFile.hxx"
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
+#ifndef _WIN32
+#include "ZipStoredIndex.hxx"
+#include "input/MemoryMappedInputStream.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#endif
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
 #include "lib/fmt/SystemError.hxx"
+#include "thread/Mutex.hxx"
 #include "thread/ScopeUnlock.hxx"
 #include "util/UTF8.hxx"
 
 #include <zzip/zzip.h>
 
+#include <string>
 #include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h> // for sysconf()
+#endif
 
 struct ZzipDir {
 	ZZIP_DIR *const dir;
 
+	/**
+	 * Protects all zziplib calls on #dir and its files, because
+	 * they share the file descriptor and its position.  A
+	 * #ZzipDir may be used by several threads at a time because
+	 * the archive cache shares #ArchiveFile instances.
+	 */
+	Mutex mutex;
+
+#ifndef _WIN32
+	/**
+	 * Our own file descriptor for reading stored entries; it is
+	 * only used with pread() and mmap(), which do not depend on
+	 * the file position, therefore no locking is needed.
+	 */
+	UniqueFileDescriptor fd;
+
+	ZipStoredIndex stored;
+#endif
+
 	explicit ZzipDir(Path path)
 		:dir(zzip_dir_open(NarrowPath(path), nullptr)) {
 		if (dir == nullptr)
 			throw FmtRuntimeError("Failed to open ZIP file {:?}",
 					      path);
+
+#ifndef _WIN32
+		if (fd.OpenReadOnly(path.c_str()))
+			stored = ZipStoredIndex{fd};
+#endif
 	}
 
 	~ZzipDir() noexcept {
@@ -65,6 +102,8 @@ zzip_archive_open(Path pathname)
 inline void
 ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 {
+	const std::scoped_lock lock{dir->mutex};
+
 	zzip_rewinddir(dir->dir);
 
 	ZZIP_DIRENT dirent;
@@ -77,9 +116,36 @@ ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 /* single archive handling */
 
 class ZzipInputStream final : public InputStream {
+	/**
+	 * The maximum number of #seek_points.
+	 */
+	static constexpr std::size_t MAX_SEEK_POINTS = 4;
+
 	std::shared_ptr<ZzipDir> dir;
 
-	ZZIP_FILE *const file;
+	/**
+	 * The path of this entry inside the archive; needed to open
+	 * additional handles.
+	 */
+	const std::string name;
+
+	ZZIP_FILE *file;
+
+	/**
+	 * Additional handles on this entry, left behind by Seek().
+	 * zziplib can seek backwards in a deflated entry only by
+	 * decompressing everything from the beginning again; resuming
+	 * from the closest one of these instead saves most of that
+	 * work, e.g. when a decoder returns from reading tags at the
+	 * end of the file.
+	 */
+	std::vector<ZZIP_FILE *> seek_points;
+
+	/**
+	 * Is this entry compressed?  Seeking in a stored entry is
+	 * cheap and doesn't need #seek_points.
+	 */
+	bool compressed;
 
 public:
 	template<typename D>
@@ -87,18 +153,23 @@ public:
 			Mutex &_mutex,
 			ZZIP_FILE *_file)
 		:InputStream(_uri, _mutex),
-		 dir(std::forward<D>(_dir)), file(_file) {
+		 dir(std::forward<D>(_dir)), name(_uri), file(_file) {
 		//we are seekable (but its not recommendent to do so)
 		seekable = true;
 
 		ZZIP_STAT z_stat;
 		zzip_file_stat(file, &z_stat);
 		size = z_stat.st_size;
+		compressed = z_stat.d_compr != 0;
 
 		SetReady();
 	}
 
 	~ZzipInputStream() noexcept override {
+		const std::scoped_lock lock{dir->mutex};
+
+		for (auto *i : seek_points)
+			zzip_file_close(i);
 		zzip_file_close(file);
 	}
 
@@ -110,12 +181,66 @@ public:
 	size_t Read(std::unique_lock<Mutex> &lock,
 		    std::span<std::byte> dest) override;
 	void Seek(std::unique_lock<Mutex> &lock, offset_type offset) override;
+
+private:
+	/**
+	 * Replace #file with the handle which is closest to (but not
+	 * after) the given offset; the old #file is kept as a seek
+	 * point.
+	 *
+	 * Caller must lock ZzipDir::mutex.
+	 */
+	void RewindTo(offset_type new_offset);
 };
 
+#ifndef _WIN32
+
+/**
+ * Map the contents of a stored entry into memory.
+ *
+ * @return the new stream or nullptr on failure
+ */
+static InputStreamPtr
+OpenStoredStream(FileDescriptor fd, ZipStoredIndex::Slice slice,
+		 const char *uri, Mutex &mutex) noexcept
+{
+	/* mmap() wants a page-aligned offset */
+	static const uint_least64_t page_size = sysconf(_SC_PAGESIZE);
+	const uint_least64_t map_offset = slice.offset & ~(page_size - 1);
+	const std::size_t skip = slice.offset - map_offset;
+	const std::size_t map_size = skip + slice.size;
+
+	void *const p = mmap(nullptr, map_size, PROT_READ, MAP_SHARED,
+			     fd.Get(), map_offset);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	madvise(p, map_size, MADV_SEQUENTIAL);
+
+	const std::span<const std::byte> contents{static_cast<const std::byte *>(p) + skip,
+						  std::size_t(slice.size)};
+	return std::make_unique<MemoryMappedInputStream>(uri, mutex,
+							 p, map_size, contents);
+}
+
+#endif
+
 InputStreamPtr
 ZzipArchiveFile::OpenStream(const char *pathname,
 			    Mutex &mutex)
 {
+#ifndef _WIN32
+	/* stored (uncompressed) entries are read directly from a
+	   memory mapping, bypassing zziplib */
+	if (dir->fd.IsDefined())
+		if (const auto slice = dir->stored.Find(dir->fd, pathname))
+			if (auto is = OpenStoredStream(dir->fd, *slice,
+						       pathname, mutex))
+				return is;
+#endif
+
+	const std::scoped_lock lock{dir->mutex};
+
 	ZZIP_FILE *_file = zzip_file_open(dir->dir, pathname, 0);
 	if (_file == nullptr) {
 		const auto error = (zzip_error_t)zzip_error(dir->dir);
@@ -141,6 +266,7 @@ ZzipInputStream::Read(std::unique_lock<Mutex> &lock, std::span<std::byte> dest)
 {
 	assert(lock.mutex() == &mutex);
 	const ScopeUnlock unlock{lock};
+	const std::scoped_lock dir_lock{dir->mutex};
 
 	zzip_ssize_t nbytes = zzip_file_read(file, dest.data(), dest.size());
 	if (nbytes < 0)
@@ -160,10 +286,49 @@ ZzipInputStream::IsEOF() const noexcept
 	return offset_type(zzip_tell(file)) == size;
 }
 
+inline void
+ZzipInputStream::RewindTo(offset_type new_offset)
+{
+	auto best = seek_points.end();
+	offset_type best_offset = 0;
+	for (auto i = seek_points.begin(); i != seek_points.end(); ++i) {
+		const offset_type i_offset = zzip_tell(*i);
+		if (i_offset <= new_offset &&
+		    (best == seek_points.end() || i_offset > best_offset)) {
+			best = i;
+			best_offset = i_offset;
+		}
+	}
+
+	ZZIP_FILE *next;
+	if (best != seek_points.end()) {
+		next = *best;
+		seek_points.erase(best);
+	} else {
+		next = zzip_file_open(dir->dir, name.c_str(), 0);
+		if (next == nullptr)
+			/* fall back to letting zziplib rewind this
+			   handle */
+			return;
+	}
+
+	if (seek_points.size() >= MAX_SEEK_POINTS) {
+		/* evict the oldest one */
+		zzip_file_close(seek_points.front());
+		seek_points.erase(seek_points.begin());
+	}
+
+	seek_points.push_back(std::exchange(file, next));
+}
+
 void
 ZzipInputStream::Seek(std::unique_lock<Mutex> &, offset_type new_offset)
 {
 	const ScopeUnlock unlock(mutex);
+	const std::scoped_lock dir_lock{dir->mutex};
+
+	if (compressed && new_offset < offset_type(zzip_tell(file)))
+		RewindTo(new_offset);
 
 	zzip_off_t ofs = zzip_seek(file, new_offset, SEEK_SET);
 	if (ofs < 0)
@@ -26,6 +26,14 @@ public:
 	 * #Client's #EventLoop thread.
 	 */
 	virtual void Cancel() noexcept = 0;
+
+	/**
+	 * The client's output buffer has been sent to the socket
+	 * completely.  It will be called from the #Client's
+	 * #EventLoop thread; the implementation must not write to
+	 * the client from inside this method.
+	 */
+	virtual void OnClientOutputEmpty() noexcept {}
 };
 
 #endif
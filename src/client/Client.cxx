@@ -6,6 +6,8 @@
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "BackgroundCommand.hxx"
+#include "Offload.hxx"
+#include "event/Loop.hxx"
 #include "protocol/IdleFlags.hxx"
 #include "config.h"
 
@@ -20,6 +22,44 @@ Client::~Client() noexcept
 	}
 }
 
+bool
+Client::IsOffloadExpired() const noexcept
+{
+	assert(offload);
+
+	if (FullyBufferedSocket::GetEventLoop().IsInside())
+		return !FullyBufferedSocket::IsDefined();
+
+	return offload->IsExpired();
+}
+
+bool
+Client::IsOutputEmpty() const noexcept
+{
+	if (offload)
+		return offload->IsOutputEmpty();
+
+	return FullyBufferedSocket::IsOutputEmpty();
+}
+
+void
+Client::ScheduleTimeout() noexcept
+{
+	if (offload)
+		offload->ScheduleTimeout();
+	else
+		timeout_event.Schedule(client_timeout);
+}
+
+void
+Client::CancelTimeout() noexcept
+{
+	if (offload)
+		offload->CancelTimeout();
+	else
+		timeout_event.Cancel();
+}
+
 void
 Client::SetBackgroundCommand(std::unique_ptr<BackgroundCommand> _bc) noexcept
 {
@@ -29,7 +69,7 @@ Client::SetBackgroundCommand(std::unique_ptr<BackgroundCommand> _bc) noexcept
 	background_command = std::move(_bc);
 
 	/* disable timeouts while in "idle" */
-	timeout_event.Cancel();
+	CancelTimeout();
 }
 
 void
@@ -39,6 +79,12 @@ Client::OnBackgroundCommandFinished() noexcept
 
 	background_command.reset();
 
+	if (offload) {
+		/* let the ClientThread resume input */
+		offload->Finish(CommandResult::OK);
+		return;
+	}
+
 	/* just in case OnSocketInput() has returned
 	   InputResult::PAUSE meanwhile */
 	ResumeInput();
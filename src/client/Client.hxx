@@ -34,12 +34,21 @@ struct playlist;
 class Database;
 class Storage;
 class BackgroundCommand;
+class ClientOffload;
 
 class Client final
 	: public IClient, FullyBufferedSocket
 {
 	friend struct ClientPerPartitionListHook;
 	friend class ClientList;
+	friend class ClientOffload;
+
+	/**
+	 * The #EventLoop which executes commands.  This is the
+	 * socket's #EventLoop unless the socket is handled by a
+	 * #ClientThread.
+	 */
+	EventLoop &command_loop;
 
 	const std::string name;
 
@@ -66,6 +75,9 @@ class Client final
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/** is a command list being executed right now? */
+	bool in_command_list = false;
+
 public:
 	// TODO: make this attribute "private"
 	/**
@@ -125,19 +137,44 @@ private:
 	 */
 	StringNormalization string_normalization = StringNormalization::None();
 
+	/**
+	 * Only set if the socket is handled by a #ClientThread.
+	 */
+	std::unique_ptr<ClientOffload> offload;
+
 public:
-	Client(EventLoop &loop, Partition &partition,
+	/**
+	 * @param loop the #EventLoop which handles the socket
+	 * @param command_loop the #EventLoop which executes commands
+	 * (the main thread's); if this differs from the first one,
+	 * the constructor must be called inside the first one
+	 */
+	Client(EventLoop &loop, EventLoop &command_loop,
+	       Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
 	       unsigned _permission,
 	       std::string &&_name) noexcept;
 
 	~Client() noexcept;
 
-	using FullyBufferedSocket::GetEventLoop;
+	/**
+	 * Returns the #EventLoop which executes this client's
+	 * commands (and where its #BackgroundCommand finishes).
+	 */
+	EventLoop &GetEventLoop() const noexcept {
+		return command_loop;
+	}
+
 	using FullyBufferedSocket::GetOutputMaxSize;
 
+	[[gnu::pure]]
+	bool IsOutputEmpty() const noexcept;
+
 	[[gnu::pure]]
 	bool IsExpired() const noexcept {
+		if (offload) [[unlikely]]
+			return IsOffloadExpired();
+
 		return !FullyBufferedSocket::IsDefined();
 	}
 
@@ -226,6 +263,15 @@ public:
 	void IdleAdd(unsigned flags) noexcept;
 	bool IdleWait(unsigned flags) noexcept;
 
+	/**
+	 * Is the current command part of a command list?  Commands
+	 * after it would be lost if it returned
+	 * CommandResult::BACKGROUND.
+	 */
+	bool IsInCommandList() const noexcept {
+		return in_command_list;
+	}
+
 	/**
 	 * Called by a command handler to defer execution to a
 	 * #BackgroundCommand.
@@ -304,6 +350,12 @@ public:
 #endif // ENABLE_DATABASE
 
 private:
+	[[gnu::pure]]
+	bool IsOffloadExpired() const noexcept;
+
+	void ScheduleTimeout() noexcept;
+	void CancelTimeout() noexcept;
+
 	CommandResult ProcessCommandList(bool list_ok,
 					 std::list<std::string> &&list) noexcept;
 
@@ -314,6 +366,9 @@ private:
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputEmpty() noexcept override;
+
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
 };
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "CompactResponse.hxx"
+#include "Client.hxx"
+#include "Response.hxx"
+#include "util/SpanCast.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "lib/zlib/GzipOutputStream.hxx"
+#endif
+
+#include <algorithm>
+
+CompactResponse::CompactResponse([[maybe_unused]] bool _gzip)
+{
+#ifdef ENABLE_ZLIB
+	if (_gzip)
+		gzip = std::make_unique<GzipOutputStream>(compressed_appender);
+#endif
+}
+
+CompactResponse::~CompactResponse() noexcept = default;
+
+static void
+WriteChunks(Response &r, std::span<const std::byte> src) noexcept
+{
+	const std::size_t binary_limit = r.GetClient().binary_limit;
+
+	while (!src.empty()) {
+		const auto chunk = src.first(std::min(src.size(), binary_limit));
+		r.WriteBinary(chunk);
+		src = src.subspan(chunk.size());
+	}
+}
+
+void
+CompactResponse::Send(Response &r, std::string_view text, bool finish)
+{
+	encoder.Encode(text, encoded);
+
+#ifdef ENABLE_ZLIB
+	if (gzip) {
+		gzip->Write(AsBytes(encoded));
+		encoded.clear();
+
+		/* flush so the client can decode this batch
+		   without waiting for the next one */
+		if (finish)
+			gzip->Finish();
+		else
+			gzip->SyncFlush();
+
+		WriteChunks(r, AsBytes(compressed));
+		compressed.clear();
+		return;
+	}
+#else
+	(void)finish;
+#endif
+
+	WriteChunks(r, AsBytes(encoded));
+	encoded.clear();
+}
@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "config.h"
+#include "protocol/CompactEncoder.hxx"
+#include "io/OutputStream.hxx"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+class Response;
+class GzipOutputStream;
+
+/**
+ * Sends a text response converted to the "compact" encoding (see
+ * #CompactEncoder), optionally compressed with gzip, in "binary"
+ * chunks.  All chunks of a response form one stream; the key table
+ * and the gzip stream are shared by all of them.
+ */
+class CompactResponse final {
+	CompactEncoder encoder;
+
+	/**
+	 * The encoded data to be sent (or compressed).
+	 */
+	std::string encoded;
+
+	/**
+	 * An #OutputStream which appends to a std::string.
+	 */
+	class StringAppender final : public OutputStream {
+		std::string &dest;
+
+	public:
+		explicit StringAppender(std::string &_dest) noexcept
+			:dest(_dest) {}
+
+		/* virtual methods from class OutputStream */
+		void Write(std::span<const std::byte> src) override {
+			dest.append((const char *)src.data(), src.size());
+		}
+	};
+
+#ifdef ENABLE_ZLIB
+	std::string compressed;
+	StringAppender compressed_appender{compressed};
+	std::unique_ptr<GzipOutputStream> gzip;
+#endif
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit CompactResponse(bool gzip);
+	~CompactResponse() noexcept;
+
+	CompactResponse(const CompactResponse &) = delete;
+	CompactResponse &operator=(const CompactResponse &) = delete;
+
+	/**
+	 * Convert the given text lines and send them to the client.
+	 *
+	 * Throws on error.
+	 *
+	 * @param finish is this the end of the response?
+	 */
+	void Send(Response &r, std::string_view text, bool finish);
+};
@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
+#include "BackgroundCommand.hxx"
+#include "Offload.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "Log.hxx"
@@ -19,3 +21,12 @@ Client::OnSocketClosed() noexcept
 {
 	SetExpired();
 }
+
+void
+Client::OnSocketOutputEmpty() noexcept
+{
+	if (offload)
+		offload->OnSocketOutputEmpty();
+	else if (background_command)
+		background_command->OnClientOutputEmpty();
+}
@@ -3,6 +3,7 @@
 
 #include "Client.hxx"
 #include "BackgroundCommand.hxx"
+#include "Offload.hxx"
 #include "Domain.hxx"
 #include "Log.hxx"
 
@@ -12,7 +13,10 @@ Client::SetExpired() noexcept
 	if (IsExpired())
 		return;
 
-	if (background_command) {
+	if (offload) {
+		/* the main thread cancels the BackgroundCommand */
+		offload->SetExpired();
+	} else if (background_command) {
 		background_command->Cancel();
 		background_command.reset();
 	}
@@ -25,8 +29,10 @@ void
 Client::OnTimeout() noexcept
 {
 	if (!IsExpired()) {
-		assert(!idle_waiting);
-		assert(!background_command);
+		/* these belong to the main thread if there is a
+		   ClientOffload */
+		assert(offload || !idle_waiting);
+		assert(offload || !background_command);
 
 		FmtDebug(client_domain, "[{}] timeout", name);
 	}
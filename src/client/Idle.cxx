@@ -36,7 +36,7 @@ Client::IdleNotify() noexcept
 	Response r(*this, 0);
 	WriteIdleResponse(r, flags);
 
-	timeout_event.Schedule(client_timeout);
+	ScheduleTimeout();
 }
 
 void
@@ -63,7 +63,7 @@ Client::IdleWait(unsigned flags) noexcept
 		return true;
 	} else {
 		/* disable timeouts while in "idle" */
-		timeout_event.Cancel();
+		CancelTimeout();
 		return false;
 	}
 }
@@ -30,6 +30,10 @@ public:
 		return list.end();
 	}
 
+	std::size_t size() const noexcept {
+		return list.size();
+	}
+
 	bool IsFull() const noexcept {
 		return list.size() >= max_size;
 	}
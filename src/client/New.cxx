@@ -6,6 +6,8 @@
 #include "Domain.hxx"
 #include "List.hxx"
 #include "BackgroundCommand.hxx"
+#include "Offload.hxx"
+#include "Thread.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "lib/fmt/SocketAddressFormatter.hxx"
@@ -25,22 +27,28 @@ using std::string_view_literals::operator""sv;
 
 static constexpr auto GREETING = "OK MPD " PROTOCOL_VERSION "\n"sv;
 
-Client::Client(EventLoop &_loop, Partition &_partition,
+Client::Client(EventLoop &_loop, EventLoop &_command_loop,
+	       Partition &_partition,
 	       UniqueSocketDescriptor _fd,
 	       int _uid, unsigned _permission,
 	       std::string &&_name) noexcept
 	:FullyBufferedSocket(_fd.Release(), _loop,
 			     16384, client_max_output_buffer_size),
+	 command_loop(_command_loop),
 	 name(std::move(_name)),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
 	 partition(&_partition),
 	 permission(_permission),
 	 uid(_uid),
-	 last_album_art(_loop)
+	 last_album_art(_command_loop)
 {
 	FmtInfo(client_domain, "[{}] client connected", name);
 
 	timeout_event.Schedule(client_timeout);
+
+	if (&_command_loop != &_loop)
+		offload = std::make_unique<ClientOffload>(*this, _command_loop,
+							  _loop);
 }
 
 [[gnu::pure]]
@@ -75,7 +83,13 @@ client_new(EventLoop &loop, Partition &partition,
 
 	const int uid = cred.IsDefined() ? static_cast<int>(cred.GetUid()) : -1;
 
-	auto *client = new Client(loop, partition, std::move(fd), uid,
+	if (auto *thread = partition.instance.NextClientThread()) {
+		thread->Add(partition, std::move(fd), uid, permission,
+			    MakeClientName(remote_address, cred));
+		return;
+	}
+
+	auto *client = new Client(loop, loop, partition, std::move(fd), uid,
 				  permission,
 				  MakeClientName(remote_address, cred));
 
@@ -86,6 +100,13 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close() noexcept
 {
+	if (offload) {
+		/* the ClientThread deletes this object after the
+		   main thread has unregistered it */
+		offload->Close();
+		return;
+	}
+
 	partition->instance.client_list->Remove(*this);
 	partition->clients.erase(partition->clients.iterator_to(*this));
 
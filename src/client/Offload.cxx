@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Offload.hxx"
+#include "Client.hxx"
+#include "Config.hxx"
+#include "Domain.hxx"
+#include "List.hxx"
+#include "BackgroundCommand.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "event/Loop.hxx"
+#include "Log.hxx"
+
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+ClientOffload::ClientOffload(Client &_client,
+			     EventLoop &command_loop,
+			     EventLoop &socket_loop) noexcept
+	:client(_client),
+	 command_event(command_loop, BIND_THIS_METHOD(OnCommandEvent)),
+	 socket_event(socket_loop, BIND_THIS_METHOD(OnSocketEvent))
+{
+	to_command.add = true;
+	command_event.Schedule();
+}
+
+void
+ClientOffload::SubmitCommand(std::string_view line) noexcept
+{
+	assert(!busy);
+	assert(!closing);
+
+	busy = true;
+
+	/* no timeout while the main thread is executing the
+	   command */
+	client.timeout_event.Cancel();
+
+	{
+		const std::scoped_lock lock{mutex};
+		to_command.command = line;
+		to_command.command_pending = true;
+	}
+
+	command_event.Schedule();
+}
+
+void
+ClientOffload::SetExpired() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		expired = true;
+
+		if (!busy)
+			return;
+
+		to_command.cancel = true;
+	}
+
+	command_event.Schedule();
+}
+
+void
+ClientOffload::OnSocketOutputEmpty() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		socket_output_empty = true;
+
+		if (!busy)
+			return;
+
+		to_command.output_empty = true;
+	}
+
+	command_event.Schedule();
+}
+
+void
+ClientOffload::Close() noexcept
+{
+	if (client.FullyBufferedSocket::IsDefined())
+		client.FullyBufferedSocket::Close();
+
+	SetExpired();
+	client.timeout_event.Cancel();
+
+	if (busy) {
+		/* wait for the main thread to finish the command */
+		close_pending = true;
+		return;
+	}
+
+	if (closing)
+		return;
+
+	closing = true;
+
+	FmtInfo(client_domain, "[{}] disconnected", client.name);
+
+	{
+		const std::scoped_lock lock{mutex};
+		to_command.remove = true;
+	}
+
+	command_event.Schedule();
+}
+
+bool
+ClientOffload::IsExpired() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return expired;
+}
+
+bool
+ClientOffload::IsOutputEmpty() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return socket_output_empty && to_socket.output.empty();
+}
+
+bool
+ClientOffload::Write(const void *data, std::size_t length) noexcept
+{
+	bool success = true;
+
+	{
+		const std::scoped_lock lock{mutex};
+		if (expired)
+			return false;
+
+		if (to_socket.output.size() + length > client_max_output_buffer_size) {
+			expired = true;
+			to_socket.overflow = true;
+			success = false;
+		} else
+			to_socket.output.append((const char *)data, length);
+	}
+
+	socket_event.Schedule();
+	return success;
+}
+
+void
+ClientOffload::RequestTimeout(TimeoutRequest request) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		to_socket.timeout = request;
+	}
+
+	socket_event.Schedule();
+}
+
+void
+ClientOffload::Finish(CommandResult result) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		to_socket.result = result;
+
+		/* decide about the timeout together with the result,
+		   or else an older request could be applied after
+		   it */
+		to_socket.timeout = client.idle_waiting
+			? TimeoutRequest::CANCEL
+			: TimeoutRequest::SCHEDULE;
+	}
+
+	socket_event.Schedule();
+}
+
+void
+ClientOffload::OnCommandEvent() noexcept
+{
+	std::string command;
+	bool add, command_pending, cancel, output_empty, remove;
+
+	{
+		const std::scoped_lock lock{mutex};
+		add = std::exchange(to_command.add, false);
+		command_pending = std::exchange(to_command.command_pending, false);
+		if (command_pending)
+			command = std::move(to_command.command);
+		cancel = std::exchange(to_command.cancel, false);
+		output_empty = std::exchange(to_command.output_empty, false);
+		remove = std::exchange(to_command.remove, false);
+	}
+
+	Partition &partition = *client.partition;
+
+	if (add) {
+		partition.instance.client_list->Add(client);
+		partition.clients.push_back(client);
+	}
+
+	if (command_pending) {
+		const auto result = client.ProcessLine(command.data());
+		if (result == CommandResult::KILL)
+			partition.instance.Break();
+
+		if (result != CommandResult::BACKGROUND)
+			Finish(result);
+	}
+
+	if (cancel && client.background_command) {
+		client.background_command->Cancel();
+		client.background_command.reset();
+		Finish(CommandResult::CLOSE);
+	}
+
+	if (output_empty && client.background_command)
+		client.background_command->OnClientOutputEmpty();
+
+	if (remove) {
+		partition.instance.client_list->Remove(client);
+		partition.clients.erase(partition.clients.iterator_to(client));
+
+		if (client.background_command) {
+			client.background_command->Cancel();
+			client.background_command.reset();
+		}
+
+		client.last_album_art.Close();
+
+		{
+			const std::scoped_lock lock{mutex};
+			to_socket.removed = true;
+		}
+
+		/* this must be the last access to the Client, because
+		   the ClientThread may delete it right away */
+		socket_event.Schedule();
+	}
+}
+
+void
+ClientOffload::OnSocketEvent() noexcept
+{
+	std::string output;
+	std::optional<CommandResult> result;
+	TimeoutRequest timeout;
+	bool overflow, removed;
+
+	{
+		const std::scoped_lock lock{mutex};
+
+		removed = to_socket.removed;
+		output = std::move(to_socket.output);
+		to_socket.output.clear();
+		if (!output.empty())
+			socket_output_empty = false;
+
+		result = std::exchange(to_socket.result, std::nullopt);
+		timeout = std::exchange(to_socket.timeout, TimeoutRequest::NONE);
+		overflow = std::exchange(to_socket.overflow, false);
+	}
+
+	if (removed) {
+		/* the main thread has forgotten this client */
+		assert(closing);
+		delete &client;
+		return;
+	}
+
+	/* each of these steps may close the socket (but it does not
+	   delete the Client while #busy is set) */
+
+	if (!output.empty() && client.FullyBufferedSocket::IsDefined())
+		client.FullyBufferedSocket::Write(output.data(), output.size());
+
+	if (overflow && client.FullyBufferedSocket::IsDefined())
+		client.OnSocketError(std::make_exception_ptr(std::runtime_error("Output buffer is full")));
+
+	if (client.FullyBufferedSocket::IsDefined()) {
+		switch (timeout) {
+		case TimeoutRequest::NONE:
+			break;
+
+		case TimeoutRequest::SCHEDULE:
+			client.timeout_event.Schedule(client_timeout);
+			break;
+
+		case TimeoutRequest::CANCEL:
+			client.timeout_event.Cancel();
+			break;
+		}
+	}
+
+	if (result) {
+		busy = false;
+
+		if (close_pending || !client.FullyBufferedSocket::IsDefined())
+			client.Close();
+		else
+			OnResult(*result);
+	}
+}
+
+inline void
+ClientOffload::OnResult(CommandResult result) noexcept
+{
+	switch (result) {
+	case CommandResult::OK:
+	case CommandResult::IDLE:
+	case CommandResult::BACKGROUND:
+	case CommandResult::ERROR:
+		break;
+
+	case CommandResult::FINISH:
+		if (client.Flush())
+			client.Close();
+		return;
+
+	case CommandResult::KILL:
+	case CommandResult::CLOSE:
+		client.Close();
+		return;
+	}
+
+	/* read the next command */
+	client.ResumeInput();
+}
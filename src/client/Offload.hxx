@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "command/CommandResult.hxx"
+#include "event/InjectEvent.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class Client;
+class EventLoop;
+
+/**
+ * The glue between a #Client whose socket is handled by a
+ * #ClientThread and the main thread which executes its commands.
+ *
+ * The socket, the timeout and the input buffer belong to the
+ * #ClientThread; everything else (command lists, "idle" state,
+ * subscriptions, the #BackgroundCommand) belongs to the main thread,
+ * so commands can access the player, the queue and the database just
+ * like before.  The two threads never touch each other's part of the
+ * #Client; they only exchange messages through the two mailboxes in
+ * this class, each one with an #InjectEvent which wakes up the
+ * receiving thread.
+ *
+ * The #Client is deleted by its #ClientThread, but only after the
+ * main thread has unregistered it.
+ */
+class ClientOffload final {
+	Client &client;
+
+	/**
+	 * Wakes up the main thread to handle #to_command.
+	 */
+	InjectEvent command_event;
+
+	/**
+	 * Wakes up the #ClientThread to handle #to_socket.
+	 */
+	InjectEvent socket_event;
+
+	/**
+	 * Protects #to_command and #to_socket.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * Messages from the #ClientThread to the main thread.
+	 */
+	struct {
+		/**
+		 * The command line to be executed (only valid if
+		 * #command_pending is set).
+		 */
+		std::string command;
+
+		/**
+		 * Add the #Client to the #ClientList and its
+		 * #Partition.
+		 */
+		bool add = false;
+
+		bool command_pending = false;
+
+		/**
+		 * The socket has been closed; cancel the
+		 * #BackgroundCommand.
+		 */
+		bool cancel = false;
+
+		/**
+		 * The socket's output buffer has become empty.
+		 */
+		bool output_empty = false;
+
+		/**
+		 * Remove the #Client from the #ClientList and its
+		 * #Partition; the #ClientThread is going to delete
+		 * it.
+		 */
+		bool remove = false;
+	} to_command;
+
+	enum class TimeoutRequest : uint_least8_t {
+		NONE,
+		SCHEDULE,
+		CANCEL,
+	};
+
+	/**
+	 * Messages from the main thread to the #ClientThread.
+	 */
+	struct {
+		/**
+		 * Response data to be written to the socket.
+		 */
+		std::string output;
+
+		/**
+		 * The result of the submitted command; this means
+		 * the main thread is done with it and the
+		 * #ClientThread may read the next one.
+		 */
+		std::optional<CommandResult> result;
+
+		TimeoutRequest timeout = TimeoutRequest::NONE;
+
+		/**
+		 * The response was larger than
+		 * "max_output_buffer_size".
+		 */
+		bool overflow = false;
+
+		/**
+		 * The main thread has unregistered the #Client; it
+		 * may be deleted now.
+		 */
+		bool removed = false;
+	} to_socket;
+
+	/**
+	 * Has the socket been closed (or will it be closed because of
+	 * #overflow)?  This is the main thread's view of
+	 * Client::IsExpired().  Protected by #mutex.
+	 */
+	bool expired = false;
+
+	/**
+	 * Is the socket's output buffer empty?  This is the main
+	 * thread's view of Client::IsOutputEmpty().  Protected by
+	 * #mutex.
+	 */
+	bool socket_output_empty = true;
+
+	/* the following attributes are only used by the
+	   #ClientThread */
+
+	/**
+	 * Has a command been submitted to the main thread whose
+	 * result has not arrived yet?
+	 */
+	bool busy = false;
+
+	/**
+	 * Has Close() been called while #busy was set?  It will be
+	 * repeated as soon as the result arrives.
+	 */
+	bool close_pending = false;
+
+	/**
+	 * Has the #ClientThread asked the main thread to remove the
+	 * #Client?
+	 */
+	bool closing = false;
+
+public:
+	/**
+	 * Must be called in the #ClientThread.  Asks the main thread
+	 * to register the #Client.
+	 */
+	ClientOffload(Client &_client,
+		      EventLoop &command_loop, EventLoop &socket_loop) noexcept;
+
+	ClientOffload(const ClientOffload &) = delete;
+	ClientOffload &operator=(const ClientOffload &) = delete;
+
+	/* methods for the #ClientThread */
+
+	bool IsBusy() const noexcept {
+		return busy;
+	}
+
+	/**
+	 * Pass one command line to the main thread.  Input must be
+	 * paused until the result arrives.
+	 */
+	void SubmitCommand(std::string_view line) noexcept;
+
+	/**
+	 * The socket has been closed.
+	 */
+	void SetExpired() noexcept;
+
+	void OnSocketOutputEmpty() noexcept;
+
+	/**
+	 * Unregister and delete the #Client (asynchronously).
+	 */
+	void Close() noexcept;
+
+	/* methods for the main thread */
+
+	[[gnu::pure]]
+	bool IsExpired() const noexcept;
+
+	[[gnu::pure]]
+	bool IsOutputEmpty() const noexcept;
+
+	bool Write(const void *data, std::size_t length) noexcept;
+
+	void ScheduleTimeout() noexcept {
+		RequestTimeout(TimeoutRequest::SCHEDULE);
+	}
+
+	void CancelTimeout() noexcept {
+		RequestTimeout(TimeoutRequest::CANCEL);
+	}
+
+	/**
+	 * The main thread is done with the submitted command.
+	 */
+	void Finish(CommandResult result) noexcept;
+
+private:
+	void RequestTimeout(TimeoutRequest request) noexcept;
+
+	/**
+	 * Called in the main thread.
+	 */
+	void OnCommandEvent() noexcept;
+
+	/**
+	 * Called in the #ClientThread.
+	 */
+	void OnSocketEvent() noexcept;
+
+	void OnResult(CommandResult result) noexcept;
+};
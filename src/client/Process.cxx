@@ -8,6 +8,7 @@
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
 #include "util/CharUtil.hxx"
+#include "util/ScopeExit.hxx"
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
@@ -17,6 +18,11 @@ inline CommandResult
 Client::ProcessCommandList(bool list_ok,
 			   std::list<std::string> &&list) noexcept
 {
+	/* streaming commands must not go to the background, because
+	   that would end the command list */
+	in_command_list = true;
+	AtScopeExit(this) { in_command_list = false; };
+
 	unsigned n = 0;
 
 	for (auto &&i : list) {
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "ProtocolFeature.hxx"
 #include "Client.hxx"
 #include "Response.hxx"
@@ -18,6 +19,8 @@ struct feature_type_table {
 
 static constexpr struct feature_type_table protocol_feature_names_init[] = {
 	{"hide_playlists_in_root", PF_HIDE_PLAYLISTS_IN_ROOT},
+	{"compact", PF_COMPACT},
+	{"gzip", PF_GZIP},
 };
 
 /**
@@ -44,12 +47,29 @@ MakeProtocolFeatureNames() noexcept
 
 constinit const std::array<const char *, PF_NUM_OF_ITEM_TYPES> protocol_feature_names = MakeProtocolFeatureNames();
 
+/**
+ * Was support for this feature compiled into MPD?
+ */
+static constexpr bool
+IsAvailable(ProtocolFeatureType type) noexcept
+{
+#ifndef ENABLE_ZLIB
+	if (type == PF_GZIP)
+		return false;
+#else
+	(void)type;
+#endif
+
+	return true;
+}
+
 void
 protocol_features_print(Client &client, Response &r) noexcept
 {
 	const auto protocol_feature = client.GetProtocolFeatures();
 	for (unsigned i = 0; i < PF_NUM_OF_ITEM_TYPES; i++)
-		if (protocol_feature.Test(ProtocolFeatureType(i)))
+		if (protocol_feature.Test(ProtocolFeatureType(i)) &&
+		    IsAvailable(ProtocolFeatureType(i)))
 			r.Fmt("feature: {}\n", protocol_feature_names[i]);
 }
 
@@ -57,7 +77,8 @@ void
 protocol_features_print_all(Response &r) noexcept
 {
 	for (unsigned i = 0; i < PF_NUM_OF_ITEM_TYPES; i++)
-		r.Fmt("feature: {}\n", protocol_feature_names[i]);
+		if (IsAvailable(ProtocolFeatureType(i)))
+			r.Fmt("feature: {}\n", protocol_feature_names[i]);
 }
 
 ProtocolFeatureType
@@ -66,7 +87,8 @@ protocol_feature_parse_i(const char *name) noexcept
 	for (unsigned i = 0; i < PF_NUM_OF_ITEM_TYPES; ++i) {
 		assert(protocol_feature_names[i] != nullptr);
 
-		if (StringIsEqualIgnoreCase(name, protocol_feature_names[i]))
+		if (StringIsEqualIgnoreCase(name, protocol_feature_names[i]) &&
+		    IsAvailable(ProtocolFeatureType(i)))
 			return (ProtocolFeatureType)i;
 	}
 
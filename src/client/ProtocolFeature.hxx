@@ -15,6 +15,16 @@ class Response;
 enum ProtocolFeatureType : uint8_t {
 	PF_HIDE_PLAYLISTS_IN_ROOT,
 
+	/**
+	 * Send bulk song lists in the "compact" binary encoding.
+	 */
+	PF_COMPACT,
+
+	/**
+	 * Compress "compact" responses with gzip.
+	 */
+	PF_GZIP,
+
 	PF_NUM_OF_ITEM_TYPES
 };
 
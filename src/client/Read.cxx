@@ -5,6 +5,7 @@
 #include "Config.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
+#include "Offload.hxx"
 #include "util/StringStrip.hxx"
 
 #include <cstring>
@@ -12,7 +13,7 @@
 BufferedSocket::InputResult
 Client::OnSocketInput(std::span<std::byte> src) noexcept
 {
-	if (background_command)
+	if (offload ? offload->IsBusy() : background_command != nullptr)
 		return InputResult::PAUSE;
 
 	char *p = (char *)src.data();
@@ -30,6 +31,13 @@ Client::OnSocketInput(std::span<std::byte> src) noexcept
 	/* terminate the string at the end of the line */
 	*end = 0;
 
+	if (offload) {
+		/* the main thread executes the command and then
+		   resumes input */
+		offload->SubmitCommand(p);
+		return InputResult::PAUSE;
+	}
+
 	CommandResult result = ProcessLine(p);
 	switch (result) {
 	case CommandResult::OK:
@@ -6,6 +6,8 @@
 
 #include <fmt/format.h>
 
+#include <cstring>
+
 TagMask
 Response::GetTagMask() const noexcept
 {
@@ -15,12 +17,20 @@ Response::GetTagMask() const noexcept
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
+	if (capture != nullptr) [[unlikely]] {
+		capture->append((const char *)data, length);
+		return true;
+	}
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data) noexcept
 {
+	if (capture != nullptr) [[unlikely]]
+		return Write(data, std::strlen(data));
+
 	return client.Write(data);
 }
 
@@ -9,6 +9,7 @@
 
 #include <cstddef>
 #include <span>
+#include <string>
 
 class Client;
 class TagMask;
@@ -27,6 +28,12 @@ class Response {
 	 */
 	const char *command = "";
 
+	/**
+	 * If not nullptr, then all output is appended to this string
+	 * instead of being sent to the client.
+	 */
+	std::string *capture = nullptr;
+
 public:
 	Response(Client &_client, unsigned _list_index) noexcept
 		:client(_client), list_index(_list_index) {}
@@ -55,6 +62,19 @@ public:
 		command = _command;
 	}
 
+	const char *GetCommand() const noexcept {
+		return command;
+	}
+
+	/**
+	 * Redirect all output to the given string (or back to the
+	 * client if nullptr is passed).  This allows converting the
+	 * text response to a different encoding.
+	 */
+	void SetCapture(std::string *_capture) noexcept {
+		capture = _capture;
+	}
+
 	bool Write(const void *data, size_t length) noexcept;
 	bool Write(const char *data) noexcept;
 
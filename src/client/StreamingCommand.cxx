@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StreamingCommand.hxx"
+#include "Client.hxx"
+#include "CompactResponse.hxx"
+#include "Response.hxx"
+#include "command/CommandError.hxx"
+
+StreamingCommand::StreamingCommand(Client &_client)
+	:defer_produce(_client.GetEventLoop(),
+		       BIND_THIS_METHOD(OnDeferredProduce)),
+	 client(_client)
+{
+	if (client.ProtocolFeatureEnabled(PF_COMPACT))
+		compact = std::make_unique<CompactResponse>(
+			client.ProtocolFeatureEnabled(PF_GZIP));
+}
+
+StreamingCommand::~StreamingCommand() noexcept = default;
+
+void
+StreamingCommand::Cancel() noexcept
+{
+	defer_produce.Cancel();
+}
+
+void
+StreamingCommand::OnClientOutputEmpty() noexcept
+{
+	defer_produce.Schedule();
+}
+
+inline bool
+StreamingCommand::ProduceCompact(Response &r)
+{
+	std::string text;
+	r.SetCapture(&text);
+
+	bool done;
+	try {
+		done = Produce(r);
+	} catch (...) {
+		/* send what has been generated before the error */
+		r.SetCapture(nullptr);
+		compact->Send(r, text, true);
+		throw;
+	}
+
+	r.SetCapture(nullptr);
+	compact->Send(r, text, done);
+	return done;
+}
+
+void
+StreamingCommand::OnDeferredProduce() noexcept
+{
+	/* copy the reference, because Client::SetExpired() (e.g. on
+	   a socket error) deletes this object */
+	Client &c = client;
+
+	if (!c.IsOutputEmpty())
+		/* wait for OnClientOutputEmpty() */
+		return;
+
+	Response response(c, 0);
+
+	bool done, error = false;
+	try {
+		done = compact
+			? ProduceCompact(response)
+			: Produce(response);
+	} catch (...) {
+		PrintError(response, std::current_exception());
+		done = error = true;
+	}
+
+	if (c.IsExpired())
+		return;
+
+	if (!done) {
+		if (c.IsOutputEmpty())
+			/* this batch was empty; continue with the
+			   next one */
+			defer_produce.Schedule();
+		return;
+	}
+
+	if (!error)
+		c.WriteOK();
+
+	/* delete this object */
+	c.OnBackgroundCommandFinished();
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "BackgroundCommand.hxx"
+#include "event/DeferEvent.hxx"
+
+#include <memory>
+
+class Client;
+class Response;
+class CompactResponse;
+
+/**
+ * A #BackgroundCommand which generates a large response in batches
+ * inside the #Client's #EventLoop thread.  The next batch is
+ * generated only after the previous one has been sent to the socket,
+ * so the response never fills the client's output buffer, and locks
+ * (e.g. the database lock) are held only while one batch is being
+ * generated.
+ *
+ * If the client has enabled the "compact" protocol feature, the
+ * response is converted to that encoding and sent in "binary"
+ * chunks.
+ */
+class StreamingCommand : public BackgroundCommand {
+	DeferEvent defer_produce;
+
+	/**
+	 * Converts the response to the "compact" encoding; nullptr if
+	 * the client has not enabled #PF_COMPACT.
+	 */
+	std::unique_ptr<CompactResponse> compact;
+
+protected:
+	Client &client;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit StreamingCommand(Client &_client);
+	~StreamingCommand() noexcept override;
+
+	/**
+	 * Schedule the first batch.  Call this after passing the
+	 * object to Client::SetBackgroundCommand().
+	 */
+	void Start() noexcept {
+		defer_produce.Schedule();
+	}
+
+	/* virtual methods from class BackgroundCommand */
+	void Cancel() noexcept final;
+	void OnClientOutputEmpty() noexcept final;
+
+protected:
+	/**
+	 * Generate the next batch of the response.  Throws on error;
+	 * the exception will be converted to a MPD response, and the
+	 * command is finished.
+	 *
+	 * @return true if the response is complete
+	 */
+	virtual bool Produce(Response &r) = 0;
+
+private:
+	/**
+	 * Call Produce() and convert its output with #compact.
+	 */
+	bool ProduceCompact(Response &r);
+
+	void OnDeferredProduce() noexcept;
+};
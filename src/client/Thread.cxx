@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Thread.hxx"
+#include "Client.hxx"
+
+ClientThread::ClientThread(EventLoop &_command_loop) noexcept
+	:command_loop(_command_loop),
+	 add_event(thread.GetEventLoop(), BIND_THIS_METHOD(OnAdd))
+{
+}
+
+ClientThread::~ClientThread() noexcept
+{
+	Stop();
+}
+
+void
+ClientThread::Add(Partition &partition, UniqueSocketDescriptor &&fd,
+		  int uid, unsigned permission, std::string &&name) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		pending.push_back({partition, std::move(fd), uid, permission,
+				   std::move(name)});
+	}
+
+	add_event.Schedule();
+}
+
+void
+ClientThread::OnAdd() noexcept
+{
+	decltype(pending) clients;
+
+	{
+		const std::scoped_lock lock{mutex};
+		clients.swap(pending);
+	}
+
+	auto &loop = thread.GetEventLoop();
+
+	/* the Client registers itself in the main thread (see
+	   ClientOffload) and deletes itself when the connection is
+	   closed */
+	for (auto &i : clients)
+		new Client(loop, command_loop, i.partition, std::move(i.fd),
+			   i.uid, i.permission, std::move(i.name));
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/Thread.hxx"
+#include "event/InjectEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "thread/Mutex.hxx"
+
+#include <string>
+#include <vector>
+
+struct Partition;
+
+/**
+ * An #EventThread which handles the sockets of some of the clients
+ * (setting "client_threads").  Connections are still accepted in the
+ * main thread and then handed over with Add(); commands are executed
+ * in the main thread, too (see #ClientOffload).  This moves reading,
+ * parsing and sending responses away from the main thread.
+ */
+class ClientThread final {
+	EventThread thread;
+
+	/**
+	 * The main thread's #EventLoop which executes the commands.
+	 */
+	EventLoop &command_loop;
+
+	InjectEvent add_event;
+
+	struct PendingClient {
+		Partition &partition;
+		UniqueSocketDescriptor fd;
+		int uid;
+		unsigned permission;
+		std::string name;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Accepted connections which have not yet been passed to
+	 * the #ClientThread.  Protected by #mutex.
+	 */
+	std::vector<PendingClient> pending;
+
+public:
+	explicit ClientThread(EventLoop &_command_loop) noexcept;
+	~ClientThread() noexcept;
+
+	ClientThread(const ClientThread &) = delete;
+	ClientThread &operator=(const ClientThread &) = delete;
+
+	void Start() {
+		thread.Start();
+	}
+
+	void Stop() noexcept {
+		thread.Stop();
+	}
+
+	/**
+	 * Create a new #Client for the given connection inside this
+	 * thread.  May be called from any thread.
+	 */
+	void Add(Partition &partition, UniqueSocketDescriptor &&fd,
+		 int uid, unsigned permission, std::string &&name) noexcept;
+
+private:
+	void OnAdd() noexcept;
+};
@@ -38,8 +38,7 @@ ThreadBackgroundCommand::DeferredFinish() noexcept
 
 	if (error) {
 		PrintError(response, error);
-	} else {
-		SendResponse(response);
+	} else if (SendResponse(response)) {
 		client.WriteOK();
 	}
 
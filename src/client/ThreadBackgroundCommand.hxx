@@ -51,11 +51,14 @@ protected:
 	virtual void Run() = 0;
 
 	/**
-	 * Send the response after Run() has finished.  Note that you
-	 * must not send errors here; if an error occurs, Run() should
-	 * throw an exception instead.
+	 * Send the response after Run() has finished.  Errors should
+	 * usually be thrown by Run(), but if this method sends an
+	 * "ACK" line (e.g. one collected by Run()), it must return
+	 * false.
+	 *
+	 * @return true if the final "OK" shall be sent
 	 */
-	virtual void SendResponse(Response &response) noexcept = 0;
+	virtual bool SendResponse(Response &response) noexcept = 0;
 
 	virtual void CancelThread() noexcept = 0;
 };
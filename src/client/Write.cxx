@@ -2,12 +2,17 @@
 // Copyright The Music Player Daemon Project
 
 #include "Client.hxx"
+#include "Offload.hxx"
 
 #include <string.h>
 
 bool
 Client::Write(const void *data, size_t length) noexcept
 {
+	if (offload)
+		/* the socket belongs to a ClientThread */
+		return offload->Write(data, length);
+
 	/* if the client is going to be closed, do nothing */
 	return !IsExpired() && FullyBufferedSocket::Write(data, length);
 }
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "AllCommands.hxx"
 #include "CommandError.hxx"
+#include "HotCommands.hxx"
 #include "Request.hxx"
 #include "QueueCommands.hxx"
 #include "TagCommands.hxx"
@@ -19,6 +20,7 @@
 #include "PartitionCommands.hxx"
 #include "FingerprintCommands.hxx"
 #include "OtherCommands.hxx"
+#include "CommandStats.hxx"
 #include "Permission.hxx"
 #include "tag/Type.hxx"
 #include "Partition.hxx"
@@ -26,6 +28,8 @@
 #include "client/Client.hxx"
 #include "client/Response.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
+#include "system/Probe.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/StaticVector.hxx"
 #include "util/StringAPI.hxx"
@@ -36,8 +40,11 @@
 
 #include <fmt/format.h>
 
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <iterator>
+#include <string_view>
 
 #include <string.h>
 
@@ -73,8 +80,12 @@ handle_not_commands(Client &client, Request request, Response &response);
 static constexpr struct command commands[] = {
 	{ "add", PERMISSION_ADD, 1, 2, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
+	{ "addmulti", PERMISSION_ADD, 1, -1, handle_addmulti },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
 	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+#ifdef ENABLE_DATABASE
+	{ "autofill", PERMISSION_ADD, 1, -1, handle_autofill },
+#endif
 	{ "binarylimit", PERMISSION_NONE, 1, 1, handle_binary_limit },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_PLAYER, 0, 0, handle_clear },
@@ -90,11 +101,13 @@ static constexpr struct command commands[] = {
 	{ "crossfade", PERMISSION_PLAYER, 1, 1, handle_crossfade },
 	{ "currentsong", PERMISSION_READ, 0, 0, handle_currentsong },
 	{ "decoders", PERMISSION_READ, 0, 0, handle_decoders },
+	{ "decoderstatus", PERMISSION_READ, 0, 0, handle_decoderstatus },
 	{ "delete", PERMISSION_PLAYER, 1, 1, handle_delete },
 	{ "deleteid", PERMISSION_PLAYER, 1, 1, handle_deleteid },
 	{ "delpartition", PERMISSION_ADMIN, 1, 1, handle_delpartition },
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
 	{ "enableoutput", PERMISSION_ADMIN, 1, 1, handle_enableoutput },
+	{ "eventloopstats", PERMISSION_READ, 0, 1, handle_eventloopstats },
 #ifdef ENABLE_DATABASE
 	{ "find", PERMISSION_READ, 1, -1, handle_find },
 	{ "findadd", PERMISSION_ADD, 1, -1, handle_findadd},
@@ -105,6 +118,7 @@ static constexpr struct command commands[] = {
 	{ "getvol", PERMISSION_READ, 0, 0, handle_getvol },
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
+	{ "linkpartition", PERMISSION_ADMIN, 1, 1, handle_linkpartition },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
 	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
@@ -123,6 +137,7 @@ static constexpr struct command commands[] = {
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 3, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "memory", PERMISSION_READ, 0, 0, handle_memory },
 	{ "mixrampdb", PERMISSION_PLAYER, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_PLAYER, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -136,6 +151,7 @@ static constexpr struct command commands[] = {
 	{ "notcommands", PERMISSION_NONE, 0, 0, handle_not_commands },
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
 	{ "outputset", PERMISSION_ADMIN, 3, 3, handle_outputset },
+	{ "outputstats", PERMISSION_READ, 0, 0, handle_outputstats },
 	{ "partition", PERMISSION_READ, 1, 1, handle_partition },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_PLAYER, 0, 1, handle_pause },
@@ -201,6 +217,7 @@ static constexpr struct command commands[] = {
 	{ "swapid", PERMISSION_PLAYER, 2, 2, handle_swapid },
 	{ "tagtypes", PERMISSION_NONE, 0, -1, handle_tagtypes },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
+	{ "unlinkpartition", PERMISSION_ADMIN, 0, 0, handle_unlinkpartition },
 #ifdef ENABLE_DATABASE
 	{ "unmount", PERMISSION_ADMIN, 1, 1, handle_unmount },
 #endif
@@ -212,6 +229,30 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = std::size(commands);
 
+/**
+ * Performance counters for each #commands entry (same order).  This
+ * is only accessed by the main thread.
+ */
+static std::array<CommandDurationHistogram, num_commands> command_stats;
+
+/**
+ * The #commands entries of #hot_command_names (same order).
+ */
+static constexpr auto hot_commands = []{
+	std::array<const struct command *, hot_command_names.size()> result{};
+
+	for (std::size_t i = 0; i < hot_command_names.size(); ++i) {
+		for (const auto &c : commands)
+			if (std::string_view{c.cmd} == hot_command_names[i])
+				result[i] = &c;
+
+		if (result[i] == nullptr)
+			throw "Hot command not registered";
+	}
+
+	return result;
+}();
+
 [[gnu::pure]]
 static bool
 command_available([[maybe_unused]] const Partition &partition,
@@ -305,6 +346,10 @@ command_init() noexcept
 static const struct command *
 command_lookup(const char *name) noexcept
 {
+	if (const std::size_t hot = FindHotCommand(name);
+	    hot < hot_commands.size())
+		return hot_commands[hot];
+
 	unsigned a = 0, b = num_commands, i;
 
 	/* binary search */
@@ -433,9 +478,26 @@ command_process(Client &client, unsigned num, char *line) noexcept
 		if (cmd == nullptr)
 			return CommandResult::ERROR;
 
-		return cmd->handler(client, args, r);
+		MPD_PROBE(command_start, cmd->cmd, args.size());
+
+		const auto start = std::chrono::steady_clock::now();
+		AtScopeExit(cmd, start) {
+			command_stats[cmd - commands].Add(std::chrono::steady_clock::now() - start);
+		};
+
+		const auto result = cmd->handler(client, args, r);
+		MPD_PROBE(command_finish, cmd->cmd, unsigned(result));
+		return result;
 	} catch (...) {
 		PrintError(r, std::current_exception());
 		return CommandResult::ERROR;
 	}
 }
+
+void
+ForEachCommandStats(const VisitCommandStats &visit)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_stats[i].calls > 0)
+			visit(commands[i].cmd, command_stats[i]);
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "time/DurationHistogram.hxx"
+
+#include <array>
+#include <chrono>
+#include <functional>
+
+inline constexpr std::array<std::chrono::microseconds, 12> command_duration_limits{
+	std::chrono::microseconds{100},
+	std::chrono::microseconds{250},
+	std::chrono::microseconds{500},
+	std::chrono::milliseconds{1},
+	std::chrono::milliseconds{2},
+	std::chrono::milliseconds{5},
+	std::chrono::milliseconds{10},
+	std::chrono::milliseconds{25},
+	std::chrono::milliseconds{50},
+	std::chrono::milliseconds{100},
+	std::chrono::milliseconds{500},
+	std::chrono::seconds{1},
+};
+
+/**
+ * A histogram of the time needed by a command handler.  For
+ * commands which run in the background (see #BackgroundCommand),
+ * this only includes the synchronous part.
+ */
+using CommandDurationHistogram =
+	DurationHistogram<command_duration_limits.size(),
+			  command_duration_limits>;
+
+using VisitCommandStats =
+	std::function<void(const char *name,
+			   const CommandDurationHistogram &duration)>;
+
+/**
+ * Invoke the callback for each command which has been executed at
+ * least once since MPD was started.
+ *
+ * This must be called from the main thread (which executes all
+ * commands).
+ */
+void
+ForEachCommandStats(const VisitCommandStats &visit);
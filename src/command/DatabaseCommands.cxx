@@ -1,19 +1,28 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "DatabaseCommands.hxx"
+#include "DatabaseQuery.hxx"
 #include "PositionArg.hxx"
+#include "StickerCommands.hxx"
 #include "Request.hxx"
 #include "Partition.hxx"
+#include "BulkEdit.hxx"
 #include "client/StringNormalization.hxx"
 #include "db/DatabaseQueue.hxx"
+#include "db/RandomFill.hxx"
 #include "db/DatabasePlaylist.hxx"
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/Interface.hxx"
+#include "db/LightDirectory.hxx"
 #include "protocol/RangeArg.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/StreamingCommand.hxx"
 #include "tag/Names.hxx"
 #include "tag/ParseName.hxx"
 #include "util/Exception.hxx"
@@ -23,7 +32,9 @@
 
 #include <fmt/format.h>
 
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <limits.h> // for UINT_MAX
@@ -99,7 +110,7 @@ ParseInsertPosition(Request &args, const playlist &playlist)
  * @param filter a buffer to be used for DatabaseSelection::filter
  */
 static DatabaseSelection
-ParseDatabaseSelection(Request args, bool fold_case, bool strip_diacritics, SongFilter &filter)
+ParseDatabaseSelection(Client &client, Request args, bool fold_case, bool strip_diacritics, SongFilter &filter)
 {
 	RangeArg window = RangeArg::All();
 	if (args.size() >= 2 && StringIsEqual(args[args.size() - 2], "window")) {
@@ -132,6 +143,10 @@ ParseDatabaseSelection(Request args, bool fold_case, bool strip_diacritics, Song
 	}
 	filter.Optimize();
 
+#ifdef ENABLE_SQLITE
+	LoadFilterStickers(client, filter);
+#endif
+
 	DatabaseSelection selection{""sv, true, &filter};
 	selection.window = window;
 	selection.sort = sort;
@@ -143,7 +158,7 @@ static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case, bool strip_diacritics)
 {
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, filter);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, strip_diacritics, filter);
 
 	db_selection_print(r, client.GetPartition(),
 			   selection, true, false);
@@ -153,14 +168,18 @@ handle_match(Client &client, Request args, Response &r, bool fold_case, bool str
 CommandResult
 handle_find(Client &client, Request args, Response &r)
 {
-	return handle_match(client, args, r, false, false);
+	return RunDatabaseQuery(client, args, r, [](Client &c, Request a, Response &r2){
+		return handle_match(c, a, r2, false, false);
+	});
 }
 
 CommandResult
 handle_search(Client &client, Request args, Response &r)
 {
-	auto strip_diacritics = client.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
-	return handle_match(client, args, r, true, strip_diacritics);
+	return RunDatabaseQuery(client, args, r, [](Client &c, Request a, Response &r2){
+		auto strip_diacritics = c.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
+		return handle_match(c, a, r2, true, strip_diacritics);
+	});
 }
 
 static CommandResult
@@ -172,9 +191,12 @@ handle_match_add(Client &client, Request args, bool fold_case, bool strip_diacri
 		ParseInsertPosition(args, partition.playlist);
 
 	SongFilter filter;
-	const auto selection = ParseDatabaseSelection(args, fold_case, strip_diacritics, filter);
+	const auto selection = ParseDatabaseSelection(client, args, fold_case, strip_diacritics, filter);
 
-	AddFromDatabase(partition, selection);
+	{
+		const ScopeBulkEdit bulk_edit(partition);
+		AddFromDatabase(partition, selection);
+	}
 
 	if (position < queue_length) {
 		const auto new_queue_length =
@@ -204,6 +226,46 @@ handle_searchadd(Client &client, Request args, Response &)
 	return handle_match_add(client, args, true,  strip_diacritics);
 }
 
+CommandResult
+handle_autofill(Client &client, Request args, Response &r)
+{
+	auto &partition = client.GetPartition();
+
+	const char *const mode = args.shift();
+	if (StringIsEqual(mode, "off") && args.empty()) {
+		partition.SetRandomFill(nullptr);
+		return CommandResult::OK;
+	}
+
+	if (!StringIsEqual(mode, "on")) {
+		r.Error(ACK_ERROR_ARG, "\"on\" or \"off\" expected");
+		return CommandResult::ERROR;
+	}
+
+	/* fail early if there is no database */
+	client.GetDatabaseOrThrow();
+
+	SongFilter filter;
+	if (!args.empty()) {
+		try {
+			filter.Parse(args, false);
+		} catch (...) {
+			r.Error(ACK_ERROR_ARG,
+				GetFullMessage(std::current_exception()).c_str());
+			return CommandResult::ERROR;
+		}
+
+		filter.Optimize();
+
+#ifdef ENABLE_SQLITE
+		LoadFilterStickers(client, filter);
+#endif
+	}
+
+	partition.SetRandomFill(std::make_unique<RandomFill>(std::move(filter)));
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_searchaddpl(Client &client, Request args, Response &)
 {
@@ -213,7 +275,7 @@ handle_searchaddpl(Client &client, Request args, Response &)
 
 	SongFilter filter;
 	auto strip_diacritics = client.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
-	const auto selection = ParseDatabaseSelection(args, true, strip_diacritics, filter);
+	const auto selection = ParseDatabaseSelection(client, args, true, strip_diacritics, filter);
 
 	const Database &db = client.GetDatabaseOrThrow();
 
@@ -255,6 +317,10 @@ handle_count_internal(Client &client, Request args, Response &r, bool fold_case,
 		}
 
 		filter.Optimize();
+
+#ifdef ENABLE_SQLITE
+		LoadFilterStickers(client, filter);
+#endif
 	}
 
 	PrintSongCount(r, client.GetPartition(), ""sv, &filter, group);
@@ -264,28 +330,133 @@ handle_count_internal(Client &client, Request args, Response &r, bool fold_case,
 CommandResult
 handle_count(Client &client, Request args, Response &r)
 {
-	return handle_count_internal(client, args, r, false, false);
+	return RunDatabaseQuery(client, args, r, [](Client &c, Request a, Response &r2){
+		return handle_count_internal(c, a, r2, false, false);
+	});
 }
 
 CommandResult
 handle_searchcount(Client &client, Request args, Response &r)
 {
-	auto strip_diacritics = client.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
-	return handle_count_internal(client, args, r, true, strip_diacritics);
+	return RunDatabaseQuery(client, args, r, [](Client &c, Request a, Response &r2){
+		auto strip_diacritics = c.StringNormalizationEnabled(SN_STRIP_DIACRITICS);
+		return handle_count_internal(c, a, r2, true, strip_diacritics);
+	});
 }
 
-CommandResult
-handle_listall(Client &client, Request args, Response &r)
+namespace {
+
+/**
+ * Implementation of "listall" and "listallinfo" which sends the
+ * response one batch of directories at a time, so a large database
+ * neither needs to fit into the output buffer nor is locked during
+ * the whole transfer.
+ */
+class ListAllCommand final : public StreamingCommand {
+	/**
+	 * Print at least this number of songs per batch (unless the
+	 * end is reached).
+	 */
+	static constexpr unsigned BATCH_SONGS = 1024;
+
+	struct Item {
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	const std::string uri;
+
+	/**
+	 * All directories in walk order, collected by Collect().
+	 * Empty if #uri does not refer to a directory.
+	 */
+	std::vector<Item> directories;
+
+	std::size_t next = 0;
+
+	const bool full;
+
+public:
+	ListAllCommand(Client &_client, std::string_view _uri, bool _full)
+		:StreamingCommand(_client), uri(_uri), full(_full) {}
+
+	/**
+	 * Collect the directory names.  Throws on error.
+	 */
+	void Collect(const Database &db) {
+		const auto d = [this](const LightDirectory &directory){
+			directories.push_back({directory.GetPath(),
+					       directory.mtime});
+		};
+
+		db.Visit(DatabaseSelection{uri, true}, d, VisitSong());
+	}
+
+protected:
+	bool Produce(Response &r) override {
+		if (directories.empty()) {
+			/* not a directory: print it the classic way
+			   */
+			db_selection_print(r, client.GetPartition(),
+					   DatabaseSelection(uri, true),
+					   full, false);
+			return true;
+		}
+
+		const Database &db = client.GetPartition().GetDatabaseOrThrow();
+
+		unsigned n_songs = 0;
+		while (n_songs < BATCH_SONGS && next < directories.size()) {
+			const auto &i = directories[next++];
+
+			try {
+				n_songs += db_directory_print(r, db,
+							      {i.uri.c_str(), i.mtime},
+							      full);
+			} catch (const DatabaseError &e) {
+				/* the directory has been deleted
+				   meanwhile */
+				if (e.GetCode() != DatabaseErrorCode::NOT_FOUND)
+					throw;
+			}
+		}
+
+		return next == directories.size();
+	}
+};
+
+} // anonymous namespace
+
+static CommandResult
+handle_listall_internal(Client &client, Request args, Response &r, bool full)
 {
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
+	if (!client.IsInCommandList()) {
+		const Database &db = client.GetPartition().GetDatabaseOrThrow();
+
+		auto cmd = std::make_unique<ListAllCommand>(client, uri, full);
+		cmd->Collect(db);
+
+		auto &c = *cmd;
+		client.SetBackgroundCommand(std::move(cmd));
+		c.Start();
+		return CommandResult::BACKGROUND;
+	}
+
 	db_selection_print(r, client.GetPartition(),
 			   DatabaseSelection(uri, true),
-			   false, false);
+			   full, false);
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_listall(Client &client, Request args, Response &r)
+{
+	return handle_listall_internal(client, args, r, false);
+}
+
 static CommandResult
 handle_list_file(Client &client, Request args, Response &r)
 {
@@ -301,14 +472,18 @@ handle_list_file(Client &client, Request args, Response &r)
 			return CommandResult::ERROR;
 		}
 		filter->Optimize();
+
+#ifdef ENABLE_SQLITE
+		LoadFilterStickers(client, *filter);
+#endif
 	}
 
 	PrintSongUris(r, client.GetPartition(), filter.get());
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_list(Client &client, Request args, Response &r)
+static CommandResult
+handle_list_internal(Client &client, Request args, Response &r)
 {
 	const char *tag_name = args.shift();
 	if (StringEqualsCaseASCII(tag_name, "file") ||
@@ -384,6 +559,10 @@ handle_list(Client &client, Request args, Response &r)
 			return CommandResult::ERROR;
 		}
 		filter->Optimize();
+
+#ifdef ENABLE_SQLITE
+		LoadFilterStickers(client, *filter);
+#endif
 	}
 
 	PrintUniqueTags(r, client.GetPartition(),
@@ -394,13 +573,13 @@ handle_list(Client &client, Request args, Response &r)
 }
 
 CommandResult
-handle_listallinfo(Client &client, Request args, Response &r)
+handle_list(Client &client, Request args, Response &r)
 {
-	/* default is root directory */
-	const auto uri = args.GetOptional(0, "");
+	return RunDatabaseQuery(client, args, r, handle_list_internal);
+}
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+CommandResult
+handle_listallinfo(Client &client, Request args, Response &r)
+{
+	return handle_listall_internal(client, args, r, true);
 }
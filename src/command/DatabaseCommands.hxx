@@ -23,6 +23,9 @@ handle_find(Client &client, Request request, Response &response);
 CommandResult
 handle_findadd(Client &client, Request request, Response &response);
 
+CommandResult
+handle_autofill(Client &client, Request request, Response &response);
+
 CommandResult
 handle_search(Client &client, Request request, Response &response);
 
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DatabaseQuery.hxx"
+#include "CommandError.hxx"
+#include "client/Client.hxx"
+#include "client/Response.hxx"
+#include "client/ThreadBackgroundCommand.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/Interface.hxx"
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+class DatabaseQueryCommand final : public ThreadBackgroundCommand {
+	Client &client;
+
+	CommandResult (*const handler)(Client &client, Request args,
+				       Response &r);
+
+	/**
+	 * The command name for error messages; points to the
+	 * command table.
+	 */
+	const char *const command;
+
+	/**
+	 * A copy of the arguments, because the client's input buffer
+	 * may be modified while this command runs.
+	 */
+	const std::vector<std::string> args;
+
+	/**
+	 * The response collected by Run().
+	 */
+	std::string output;
+
+	bool failed = false;
+
+public:
+	DatabaseQueryCommand(Client &_client, const char *_command,
+			     Request _args,
+			     CommandResult (*_handler)(Client &, Request,
+						       Response &))
+		:ThreadBackgroundCommand(_client),
+		 client(_client), handler(_handler), command(_command),
+		 args(_args.begin(), _args.end()) {}
+
+protected:
+	void Run() override {
+		std::vector<const char *> argv;
+		argv.reserve(args.size());
+		for (const auto &i : args)
+			argv.push_back(i.c_str());
+
+		Response r(client, 0);
+		r.SetCommand(command);
+		r.SetCapture(&output);
+
+		try {
+			const auto result = handler(client, Request{argv}, r);
+			assert(result == CommandResult::OK ||
+			       result == CommandResult::ERROR);
+			failed = result != CommandResult::OK;
+		} catch (...) {
+			PrintError(r, std::current_exception());
+			failed = true;
+		}
+	}
+
+	bool SendResponse(Response &r) noexcept override {
+		r.Write(output.data(), output.size());
+		return !failed;
+	}
+
+	void CancelThread() noexcept override {
+		/* the query cannot be interrupted; Cancel() waits for
+		   it to finish */
+	}
+};
+
+} // anonymous namespace
+
+[[gnu::pure]]
+static bool
+IsDatabaseThreadSafe(const Client &client) noexcept
+{
+	const Database *db = client.GetDatabase();
+	return db != nullptr && db->GetPlugin().IsThreadSafe();
+}
+
+CommandResult
+RunDatabaseQuery(Client &client, Request args, Response &r,
+		 CommandResult (*handler)(Client &client, Request args,
+					  Response &r))
+{
+	if (client.IsInCommandList() || !IsDatabaseThreadSafe(client))
+		return handler(client, args, r);
+
+	auto cmd = std::make_unique<DatabaseQueryCommand>(client,
+							  r.GetCommand(),
+							  args, handler);
+	cmd->Start();
+	client.SetBackgroundCommand(std::move(cmd));
+	return CommandResult::BACKGROUND;
+}
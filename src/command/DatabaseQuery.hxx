@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "CommandResult.hxx"
+#include "Request.hxx"
+
+class Client;
+class Response;
+
+/**
+ * Run a read-only database command in a new thread (see
+ * #ThreadBackgroundCommand), so a slow query does not block other
+ * clients.  The response is collected in a buffer and sent by the
+ * client's #EventLoop thread.
+ *
+ * Inside command lists and if the database plugin is not
+ * thread-safe, the handler is invoked directly.
+ *
+ * @param handler the command handler; it must not modify anything
+ * but the #Response
+ */
+CommandResult
+RunDatabaseQuery(Client &client, Request args, Response &r,
+		 CommandResult (*handler)(Client &client, Request args,
+					  Response &r));
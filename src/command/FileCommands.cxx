@@ -24,6 +24,7 @@
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
 #include "LocateUri.hxx"
+#include "CoverArt.hxx"
 #include "TimePrint.hxx"
 #include "thread/Mutex.hxx"
 #include "Log.hxx"
@@ -32,7 +33,8 @@
 
 #include <algorithm>
 #include <cassert>
-#include <array>
+#include <optional>
+#include <string>
 
 using std::string_view_literals::operator""sv;
 
@@ -130,38 +132,48 @@ handle_read_comments(Client &client, Request args, Response &r)
 }
 
 /**
- * Searches for the files listed in #artnames in the UTF8 folder
- * URI #directory. This can be a local path or protocol-based
+ * Open the file with the given name in the UTF8 folder URI
+ * #directory.  Returns #nullptr on failure.
+ */
+static InputStreamPtr
+open_stream_art(std::string_view directory, std::string_view name,
+		Mutex &mutex)
+{
+	std::string art_file = PathTraitsUTF8::Build(directory, name);
+
+	try {
+		return InputStream::OpenReady(art_file, mutex);
+	} catch (...) {
+		auto e = std::current_exception();
+		if (!IsFileNotFound(e))
+			LogError(e);
+		return nullptr;
+	}
+}
+
+/**
+ * Searches for the files listed in #cover_art_names in the UTF8
+ * folder URI #directory. This can be a local path or protocol-based
  * URI that #InputStream supports. Returns the first successfully
  * opened file or #nullptr on failure.
  */
 static InputStreamPtr
 find_stream_art(std::string_view directory, Mutex &mutex)
 {
-	static constexpr auto art_names = std::array {
-		"cover.png",
-		"cover.jpg",
-		"cover.jxl",
-		"cover.webp",
-	};
-
-	for(const auto name : art_names) {
-		std::string art_file = PathTraitsUTF8::Build(directory, name);
-
-		try {
-			return InputStream::OpenReady(art_file, mutex);
-		} catch (...) {
-			auto e = std::current_exception();
-			if (!IsFileNotFound(e))
-				LogError(e);
-		}
-	}
+	for (const auto name : cover_art_names)
+		if (auto is = open_stream_art(directory, name, mutex))
+			return is;
+
 	return nullptr;
 }
 
+/**
+ * @param cover_name the name of the album art file if the database
+ * knows it; nullptr to search for it
+ */
 static CommandResult
 read_stream_art(Response &r, const std::string_view art_directory,
-		size_t offset)
+		const char *cover_name, size_t offset)
 {
 	// TODO: eliminate this const_cast
 	auto &client = const_cast<Client &>(r.GetClient());
@@ -169,9 +181,11 @@ read_stream_art(Response &r, const std::string_view art_directory,
 	/* to avoid repeating the search for each chunk request by the
 	   same client, use the #LastInputStream class to cache the
 	   #InputStream instance */
-	auto *is = client.last_album_art.Open(art_directory, [](std::string_view directory,
-								Mutex &mutex){
-		return find_stream_art(directory, mutex);
+	auto *is = client.last_album_art.Open(art_directory, [cover_name](std::string_view directory,
+									  Mutex &mutex){
+		return cover_name != nullptr
+			? open_stream_art(directory, cover_name, mutex)
+			: find_stream_art(directory, mutex);
 	});
 
 	if (is == nullptr) {
@@ -194,6 +208,16 @@ read_stream_art(Response &r, const std::string_view art_directory,
 		std::min<offset_type>(art_file_size - offset,
 				      r.GetClient().binary_limit);
 
+	if (const auto contents = is->LockGetContiguous();
+	    contents.size() == art_file_size) {
+		/* the file is mapped into memory (see
+		   LazyFileMapping): send the chunk without copying
+		   it to a buffer first */
+		r.Fmt("size: {}\n", art_file_size);
+		r.WriteBinary(contents.subspan(offset, buffer_size));
+		return CommandResult::OK;
+	}
+
 	auto buffer = std::make_unique_for_overwrite<std::byte[]>(buffer_size);
 
 	std::size_t read_size = 0;
@@ -228,39 +252,74 @@ read_stream_art(Response &r, const std::string_view art_directory,
  * Attempt to locate the "real" directory where the given song is
  * stored.  This attempts to resolve "virtual" directories/songs,
  * e.g. expanded CUE sheet contents.
+ *
+ * @return the number of levels the "real" directory is above the
+ * song's directory
  */
 [[gnu::pure]]
-static std::string_view
-RealDirectoryOfSong(Client &client, const std::string_view song_uri,
-		    std::string_view directory_uri) noexcept
+static unsigned
+RealDirectoryOfSong(Client &client, const std::string_view song_uri) noexcept
 try {
 	const auto *db = client.GetDatabase();
 	if (db == nullptr)
-		return directory_uri;
+		return 0;
 
 	const auto *song = db->GetSong(song_uri);
 	if (song == nullptr)
-		return directory_uri;
+		return 0;
 
 	AtScopeExit(db, song) { db->ReturnSong(song); };
 
 	if (song->real_uri == nullptr)
-		return directory_uri;
+		return 0;
 
 	const char *real_uri = song->real_uri;
 
 	/* this is a simplification which is just enough for CUE
 	   sheets (but may be incomplete): for each "../", go one
 	   level up */
+	unsigned levels = 0;
 	while ((real_uri = StringAfterPrefix(real_uri, "../")) != nullptr)
-		directory_uri = PathTraitsUTF8::GetParent(directory_uri);
+		++levels;
 
-	return directory_uri;
+	return levels;
 } catch (...) {
 	/* ignore all exceptions from Database::GetSong() */
+	return 0;
+}
+
+[[gnu::pure]]
+static std::string_view
+GetAncestor(std::string_view directory_uri, unsigned levels) noexcept
+{
+	for (; levels > 0; --levels)
+		directory_uri = PathTraitsUTF8::GetParent(directory_uri);
 	return directory_uri;
 }
 
+/**
+ * Ask the database which album art file the given directory
+ * contains.
+ *
+ * @return the file name, an empty string if there is none, or
+ * std::nullopt if unknown
+ */
+static std::optional<std::string>
+GetDatabaseCover(Client &client, std::string_view directory_uri) noexcept
+try {
+	const auto *db = client.GetDatabase();
+	if (db == nullptr)
+		return std::nullopt;
+
+	if (directory_uri == PathTraitsUTF8::CURRENT_DIRECTORY)
+		directory_uri = {};
+
+	return db->GetDirectoryCover(directory_uri);
+} catch (...) {
+	/* ignore all exceptions, just search the directory */
+	return std::nullopt;
+}
+
 static CommandResult
 read_db_art(Client &client, Response &r, std::string_view uri, const uint64_t offset)
 {
@@ -271,12 +330,23 @@ read_db_art(Client &client, Response &r, std::string_view uri, const uint64_t of
 	}
 	std::string uri2 = storage->MapUTF8(uri);
 
+	const unsigned levels = RealDirectoryOfSong(client, uri);
+
+	/* the update has recorded which album art file exists (if
+	   any), which saves probing for all candidates */
+	const auto cover = GetDatabaseCover(client,
+					    GetAncestor(PathTraitsUTF8::GetParent(uri), levels));
+	if (cover && cover->empty()) {
+		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+		return CommandResult::ERROR;
+	}
+
 	std::string_view directory_uri =
-		RealDirectoryOfSong(client,
-				    uri,
-				    PathTraitsUTF8::GetParent(uri2.c_str()));
+		GetAncestor(PathTraitsUTF8::GetParent(uri2.c_str()), levels);
 
-	return read_stream_art(r, directory_uri, offset);
+	return read_stream_art(r, directory_uri,
+			       cover ? cover->c_str() : nullptr,
+			       offset);
 }
 #endif
 
@@ -299,7 +369,7 @@ handle_album_art(Client &client, Request args, Response &r)
 	case LocatedUri::Type::PATH:
 		return read_stream_art(r,
 				       PathTraitsUTF8::GetParent(located_uri.canonical_uri),
-				       offset);
+				       nullptr, offset);
 
 	case LocatedUri::Type::RELATIVE:
 #ifdef ENABLE_DATABASE
@@ -45,9 +45,10 @@ public:
 protected:
 	void Run() override;
 
-	void SendResponse(Response &r) noexcept override {
+	bool SendResponse(Response &r) noexcept override {
 		r.Fmt("chromaprint: {}\n",
 		      GetFingerprint());
+		return true;
 	}
 
 	void CancelThread() noexcept override {
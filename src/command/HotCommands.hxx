@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * The commands which are sent most often: status polling, the idle
+ * loop and simple playback control.  They are looked up with a
+ * perfect hash (see FindHotCommand()) before the binary search over
+ * the whole command registry.
+ */
+inline constexpr std::array hot_command_names{
+	"currentsong",
+	"idle",
+	"ping",
+	"playid",
+	"setvol",
+	"status",
+};
+
+inline constexpr std::size_t HOT_COMMAND_TABLE_SIZE = 8;
+
+/**
+ * A hash function which is collision-free for #hot_command_names
+ * (verified at compile time below).  The name must not be empty.
+ */
+[[gnu::pure]]
+constexpr std::size_t
+HotCommandHash(std::string_view name) noexcept
+{
+	return (name.size() + static_cast<uint8_t>(name.front()) +
+		5 * static_cast<uint8_t>(name.back())) % HOT_COMMAND_TABLE_SIZE;
+}
+
+/**
+ * Maps the hash to the index in #hot_command_names; unused slots
+ * contain hot_command_names.size().
+ */
+inline constexpr auto hot_command_table = []{
+	std::array<uint8_t, HOT_COMMAND_TABLE_SIZE> table;
+	table.fill(hot_command_names.size());
+
+	for (std::size_t i = 0; i < hot_command_names.size(); ++i) {
+		auto &slot = table[HotCommandHash(hot_command_names[i])];
+		if (slot != hot_command_names.size())
+			throw "Hash collision in hot_command_names";
+
+		slot = i;
+	}
+
+	return table;
+}();
+
+/**
+ * @return the index of the given command name in
+ * #hot_command_names or hot_command_names.size() if it is not a hot
+ * command
+ */
+[[gnu::pure]]
+constexpr std::size_t
+FindHotCommand(std::string_view name) noexcept
+{
+	if (name.empty())
+		return hot_command_names.size();
+
+	const std::size_t i = hot_command_table[HotCommandHash(name)];
+	if (i < hot_command_names.size() && name != hot_command_names[i])
+		return hot_command_names.size();
+
+	return i;
+}
+
+static_assert(FindHotCommand("status") < hot_command_names.size());
+static_assert(FindHotCommand("stats") == hot_command_names.size());
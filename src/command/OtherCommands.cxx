@@ -14,6 +14,9 @@
 #include "TagPrint.hxx"
 #include "TagStream.hxx"
 #include "tag/Handler.hxx"
+#include "tag/Pool.hxx"
+#include "input/cache/Manager.hxx"
+#include "MusicBufferPool.hxx"
 #include "TimePrint.hxx"
 #include "decoder/DecoderPrint.hxx"
 #include "ls.hxx"
@@ -35,8 +38,14 @@
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #ifdef ENABLE_DATABASE
 #include "DatabaseCommands.hxx"
+#include "DatabaseQuery.hxx"
 #include "db/Interface.hxx"
 #include "db/update/Service.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#endif
+
+#ifdef ENABLE_SQLITE
+#include "sticker/Database.hxx"
 #endif
 
 #include <fmt/format.h>
@@ -192,8 +201,8 @@ handle_lsinfo_path(Client &, Response &r,
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_lsinfo(Client &client, Request args, Response &r)
+static CommandResult
+handle_lsinfo_internal(Client &client, Request args, Response &r)
 {
 	/* default is root directory */
 	auto uri = args.GetOptional(0, "");
@@ -228,6 +237,16 @@ handle_lsinfo(Client &client, Request args, Response &r)
 	std::unreachable();
 }
 
+CommandResult
+handle_lsinfo(Client &client, Request args, Response &r)
+{
+#ifdef ENABLE_DATABASE
+	return RunDatabaseQuery(client, args, r, handle_lsinfo_internal);
+#else
+	return handle_lsinfo_internal(client, args, r);
+#endif
+}
+
 #ifdef ENABLE_DATABASE
 
 static CommandResult
@@ -308,7 +327,7 @@ handle_getvol(Client &client, Request, Response &r)
 {
 	auto &partition = client.GetPartition();
 
-	const auto volume = partition.mixer_memento.GetVolume(partition.outputs);
+	const auto volume = partition.GetVolume();
 	if (volume >= 0)
 		r.Fmt("volume: {}\n", volume);
 
@@ -321,7 +340,7 @@ handle_setvol(Client &client, Request args, Response &)
 	unsigned level = args.ParseUnsigned(0, 100);
 
 	auto &partition = client.GetPartition();
-	partition.mixer_memento.SetVolume(partition.outputs, level);
+	partition.SetVolume(level);
 	partition.EmitIdle(IDLE_MIXER);
 	return CommandResult::OK;
 }
@@ -332,10 +351,8 @@ handle_volume(Client &client, Request args, Response &r)
 	int relative = args.ParseInt(0, -100, 100);
 
 	auto &partition = client.GetPartition();
-	auto &outputs = partition.outputs;
-	auto &mixer_memento = partition.mixer_memento;
 
-	const int old_volume = mixer_memento.GetVolume(outputs);
+	const int old_volume = partition.GetVolume();
 	if (old_volume < 0) {
 		r.Error(ACK_ERROR_SYSTEM, "No mixer");
 		return CommandResult::ERROR;
@@ -348,7 +365,7 @@ handle_volume(Client &client, Request args, Response &r)
 		new_volume = 100;
 
 	if (new_volume != old_volume) {
-		mixer_memento.SetVolume(outputs, new_volume);
+		partition.SetVolume(new_volume);
 		partition.EmitIdle(IDLE_MIXER);
 	}
 
@@ -362,6 +379,124 @@ handle_stats(Client &client, [[maybe_unused]] Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_eventloopstats(Client &client, Request args, Response &r)
+{
+	using FloatSeconds = std::chrono::duration<double>;
+
+	bool reset = false;
+	if (!args.empty()) {
+		if (!StringIsEqual(args.front(), "reset")) {
+			r.Error(ACK_ERROR_ARG, "Unrecognized argument");
+			return CommandResult::ERROR;
+		}
+
+		reset = true;
+	}
+
+	/* this is the main thread's EventLoop */
+	auto &event_loop = client.GetInstance().event_loop;
+	const auto &stats = event_loop.GetStats();
+
+	r.Fmt("iterations: {}\n"
+	      "busy_time: {:1.3f}\n"
+	      "max_iteration_time: {:1.6f}\n"
+	      "defer_yields: {}\n",
+	      stats.iterations,
+	      std::chrono::duration_cast<FloatSeconds>(stats.busy_time).count(),
+	      std::chrono::duration_cast<FloatSeconds>(stats.max_iteration_time).count(),
+	      stats.defer_yields);
+
+	for (std::size_t i = 0; i < EventLoopStats::N_CATEGORIES; ++i) {
+		const auto category = static_cast<EventLoopStats::Category>(i);
+		const auto &c = stats.categories[i];
+		const char *name = EventLoopStats::GetCategoryName(category);
+		r.Fmt("{}_count: {}\n"
+		      "{}_time: {:1.3f}\n",
+		      name, c.count,
+		      name, std::chrono::duration_cast<FloatSeconds>(c.time).count());
+	}
+
+	if (stats.max_callback_time.count() > 0) {
+		r.Fmt("max_callback_time: {:1.6f}\n"
+		      "max_callback_category: {}\n",
+		      std::chrono::duration_cast<FloatSeconds>(stats.max_callback_time).count(),
+		      EventLoopStats::GetCategoryName(stats.max_callback_category));
+
+		if (stats.max_callback != nullptr)
+			r.Fmt("max_callback: {}\n", stats.max_callback);
+	}
+
+	if (reset)
+		event_loop.ResetStats();
+
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_memory(Client &client, [[maybe_unused]] Request args, Response &r)
+{
+	const auto tag_pool = tag_pool_get_stats();
+	r.Fmt("tag_pool_items: {}\n"
+	      "tag_pool_bytes: {}\n",
+	      tag_pool.items, tag_pool.bytes);
+
+	auto &instance = client.GetInstance();
+
+#ifdef ENABLE_DATABASE
+	if (const auto *db = dynamic_cast<const SimpleDatabase *>(instance.GetDatabase())) {
+		const auto stats = db->GetMemoryStats();
+		r.Fmt("db_directories: {}\n"
+		      "db_songs: {}\n"
+		      "db_bytes: {}\n",
+		      stats.directories, stats.songs, stats.bytes);
+	}
+#endif
+
+	if (instance.input_cache) {
+		const auto stats = instance.input_cache->GetStats();
+		r.Fmt("input_cache_items: {}\n"
+		      "input_cache_bytes: {}\n"
+		      "input_cache_max_bytes: {}\n",
+		      stats.items, stats.bytes, stats.max_bytes);
+	}
+
+	if (instance.buffer_pool)
+		r.Fmt("buffer_pool_chunks: {}\n"
+		      "buffer_pool_chunks_borrowed: {}\n",
+		      instance.buffer_pool->GetCapacity(),
+		      instance.buffer_pool->GetBorrowedCount());
+
+	auto &partition = client.GetPartition();
+
+	if (const auto stats = partition.pc.LockGetBufferStats();
+	    stats.chunks > 0) {
+		r.Fmt("buffer_chunks: {}\n"
+		      "buffer_chunks_used: {}\n"
+		      "buffer_bytes: {}\n",
+		      stats.chunks, stats.chunks_used,
+		      std::size_t{stats.chunks} * stats.chunk_size);
+
+		if (instance.buffer_pool)
+			r.Fmt("buffer_chunks_borrowed: {}\n",
+			      stats.chunks_borrowed);
+	}
+
+	const auto &queue = partition.playlist.queue;
+	r.Fmt("queue_songs: {}\n"
+	      "queue_song_bytes: {}\n"
+	      "queue_table_bytes: {}\n",
+	      queue.GetLength(), queue.GetSongMemoryUsage(),
+	      queue.GetTableSize());
+
+#ifdef ENABLE_SQLITE
+	if (instance.HasStickerDatabase())
+		r.Fmt("sticker_bytes: {}\n", StickerDatabase::GetMemoryUsage());
+#endif
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, [[maybe_unused]] Request args, Response &r)
 {
@@ -43,6 +43,12 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_eventloopstats(Client &client, Request request, Response &response);
+
+CommandResult
+handle_memory(Client &client, Request request, Response &response);
+
 CommandResult
 handle_config(Client &client, Request request, Response &response);
 
@@ -113,3 +113,12 @@ handle_devices(Client &client, [[maybe_unused]] Request args, Response &r)
 	printAudioDevices(r, client.GetPartition().outputs);
 	return CommandResult::OK;
 }
+
+CommandResult
+handle_outputstats(Client &client, [[maybe_unused]] Request args, Response &r)
+{
+	assert(args.empty());
+
+	printAudioOutputStats(r, client.GetPartition().outputs);
+	return CommandResult::OK;
+}
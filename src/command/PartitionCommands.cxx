@@ -117,6 +117,13 @@ handle_delpartition(Client &client, Request request, Response &response)
 		return CommandResult::ERROR;
 	}
 
+	if (partition->link_leader != nullptr ||
+	    partition->n_link_followers > 0) {
+		response.Error(ACK_ERROR_UNKNOWN,
+			       "partition still has links");
+		return CommandResult::ERROR;
+	}
+
 	if (!partition->outputs.IsDummy()) {
 		response.Error(ACK_ERROR_UNKNOWN,
 			       "partition still has outputs");
@@ -152,17 +159,65 @@ handle_moveoutput(Client &client, Request request, Response &response)
 		return CommandResult::ERROR;
 	}
 
-	const bool was_enabled = output->IsEnabled();
+	dest_partition.MoveOutputHere(*output);
+
+	instance.EmitIdle(IDLE_OUTPUT);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_linkpartition(Client &client, Request request, Response &response)
+{
+	const char *name = request.front();
+
+	auto &instance = client.GetInstance();
+	auto *leader = instance.FindPartition(name);
+	if (leader == nullptr) {
+		response.Error(ACK_ERROR_NO_EXIST, "no such partition");
+		return CommandResult::ERROR;
+	}
+
+	auto &follower = client.GetPartition();
+	if (leader == &follower) {
+		response.Error(ACK_ERROR_ARG,
+			       "cannot link a partition to itself");
+		return CommandResult::ERROR;
+	}
+
+	if (follower.link_leader != nullptr) {
+		response.Error(ACK_ERROR_UNKNOWN, "partition is already linked");
+		return CommandResult::ERROR;
+	}
+
+	if (follower.n_link_followers > 0) {
+		response.Error(ACK_ERROR_UNKNOWN,
+			       "partition has linked partitions");
+		return CommandResult::ERROR;
+	}
+
+	if (leader->link_leader != nullptr) {
+		response.Error(ACK_ERROR_UNKNOWN,
+			       "cannot link to a linked partition");
+		return CommandResult::ERROR;
+	}
 
-	if (existing_output != nullptr)
-		/* move the output back where it once was */
-		existing_output->ReplaceDummy(output->Steal(),
-					      was_enabled);
-	else
-		/* copy the AudioOutputControl and add it to the output list */
-		dest_partition.outputs.AddMoveFrom(std::move(*output),
-						   was_enabled);
+	follower.Link(*leader);
 
 	instance.EmitIdle(IDLE_OUTPUT);
 	return CommandResult::OK;
 }
+
+CommandResult
+handle_unlinkpartition(Client &client, Request, Response &response)
+{
+	auto &partition = client.GetPartition();
+	if (partition.link_leader == nullptr) {
+		response.Error(ACK_ERROR_UNKNOWN, "partition is not linked");
+		return CommandResult::ERROR;
+	}
+
+	partition.Unlink();
+
+	client.GetInstance().EmitIdle(IDLE_OUTPUT);
+	return CommandResult::OK;
+}
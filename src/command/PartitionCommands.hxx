@@ -25,4 +25,10 @@ handle_delpartition(Client &client, Request request, Response &response);
 CommandResult
 handle_moveoutput(Client &client, Request request, Response &response);
 
+CommandResult
+handle_linkpartition(Client &client, Request request, Response &response);
+
+CommandResult
+handle_unlinkpartition(Client &client, Request request, Response &response);
+
 #endif
@@ -20,10 +20,13 @@
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
+#include "db/RandomFill.hxx"
 #endif
 
 #include <fmt/format.h>
 
+#include <chrono>
+
 #define COMMAND_STATUS_STATE            "state"
 #define COMMAND_STATUS_REPEAT           "repeat"
 #define COMMAND_STATUS_SINGLE           "single"
@@ -42,6 +45,8 @@
 #define COMMAND_STATUS_MIXRAMPDB	"mixrampdb"
 #define COMMAND_STATUS_MIXRAMPDELAY	"mixrampdelay"
 #define COMMAND_STATUS_AUDIO		"audio"
+#define COMMAND_STATUS_BUFFER_BEFORE_PLAY "bufferbeforeplay"
+#define COMMAND_STATUS_FILL_RATE	"fillrate"
 #define COMMAND_STATUS_UPDATING_DB	"updating_db"
 #define COMMAND_STATUS_LOADED_PLAYLIST  "lastloadedplaylist"
 
@@ -108,7 +113,7 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 	const char *state = nullptr;
 	int song;
 
-	const auto player_status = pc.LockGetStatus();
+	const auto player_status = pc.GetStatus();
 
 	switch (player_status.state) {
 	case PlayerState::STOP:
@@ -124,7 +129,7 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 
 	const auto &playlist = partition.playlist;
 
-	const auto volume = partition.mixer_memento.GetVolume(partition.outputs);
+	const auto volume = partition.GetVolume();
 	if (volume >= 0)
 		r.Fmt("volume: {}\n", volume);
 
@@ -149,6 +154,14 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 	      state,
 	      playlist.GetLastLoadedPlaylist());
 
+#ifdef ENABLE_DATABASE
+	if (partition.random_fill)
+		r.Write("autofill: 1\n");
+#endif
+
+	if (partition.link_leader != nullptr)
+		r.Fmt("link: {}\n", partition.link_leader->name);
+
 	if (pc.GetCrossFade() > FloatDuration::zero())
 		r.Fmt(COMMAND_STATUS_CROSSFADE ": {}\n",
 		      std::lround(pc.GetCrossFade().count()));
@@ -182,6 +195,14 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 		if (player_status.audio_format.IsDefined())
 			r.Fmt(COMMAND_STATUS_AUDIO ": {}\n",
 			      player_status.audio_format);
+
+		if (player_status.buffer_before_play > FloatDuration::zero())
+			r.Fmt(COMMAND_STATUS_BUFFER_BEFORE_PLAY ": {:1.3f}\n",
+			      player_status.buffer_before_play.count());
+
+		if (player_status.fill_rate > 0)
+			r.Fmt(COMMAND_STATUS_FILL_RATE ": {:1.2f}\n",
+			      player_status.fill_rate);
 	}
 
 #ifdef ENABLE_DATABASE
@@ -195,11 +216,13 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 	}
 #endif
 
-	try {
-		pc.LockCheckRethrowError();
-	} catch (...) {
-		r.Fmt(COMMAND_STATUS_ERROR ": {}\n",
-		      GetFullMessage(std::current_exception()));
+	if (player_status.error) {
+		try {
+			pc.LockCheckRethrowError();
+		} catch (...) {
+			r.Fmt(COMMAND_STATUS_ERROR ": {}\n",
+			      GetFullMessage(std::current_exception()));
+		}
 	}
 
 	song = playlist.GetNextPosition();
@@ -211,6 +234,48 @@ handle_status(Client &client, [[maybe_unused]] Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_decoderstatus(Client &client, [[maybe_unused]] Request args,
+		     Response &r)
+{
+	using FloatSeconds = std::chrono::duration<double>;
+
+	const auto stats = client.GetPartition().pc.LockGetDecoderStats();
+	if (stats.plugin == nullptr)
+		return CommandResult::OK;
+
+	r.Fmt("plugin: {}\n"
+	      "frames: {}\n"
+	      "render_time: {:1.3f}\n"
+	      "submit_time: {:1.3f}\n",
+	      stats.plugin,
+	      stats.frames,
+	      std::chrono::duration_cast<FloatSeconds>(stats.render_time).count(),
+	      std::chrono::duration_cast<FloatSeconds>(stats.submit_time).count());
+
+	if (const double factor = stats.GetRealtimeFactor(); factor > 0)
+		r.Fmt("realtime_factor: {:1.2f}\n", factor);
+
+	if (stats.convert_time.count() > 0)
+		r.Fmt("convert_time: {:1.3f}\n"
+		      "max_convert_time: {:1.6f}\n",
+		      std::chrono::duration_cast<FloatSeconds>(stats.convert_time).count(),
+		      std::chrono::duration_cast<FloatSeconds>(stats.max_convert_time).count());
+
+	r.Fmt("underruns: {}\n"
+	      "seeks: {}\n"
+	      "seek_time: {:1.3f}\n"
+	      "max_seek_time: {:1.3f}\n"
+	      "restarts: {}\n",
+	      stats.underruns,
+	      stats.seeks,
+	      std::chrono::duration_cast<FloatSeconds>(stats.seek_time).count(),
+	      std::chrono::duration_cast<FloatSeconds>(stats.max_seek_time).count(),
+	      stats.restarts);
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_next(Client &client, [[maybe_unused]] Request args, [[maybe_unused]] Response &r)
 {
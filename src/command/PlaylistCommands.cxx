@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "PlaylistCommands.hxx"
 #include "PositionArg.hxx"
+#include "StickerCommands.hxx"
 #include "Request.hxx"
 #include "Instance.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
@@ -181,6 +183,10 @@ handle_searchplaylist(Client &client, Request args, Response &r)
 	}
 	filter.Optimize();
 
+#ifdef ENABLE_SQLITE
+	LoadFilterStickers(client, filter);
+#endif
+
 	playlist_file_print(r, client.GetPartition(), SongLoader(client),
 				   name, window.start, window.end, true, &filter);
 	return CommandResult::OK;
@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "QueueCommands.hxx"
 #include "PositionArg.hxx"
+#include "StickerCommands.hxx"
 #include "Request.hxx"
 #include "protocol/RangeArg.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
@@ -16,8 +18,11 @@
 #include "queue/Playlist.hxx"
 #include "queue/Selection.hxx"
 #include "PlaylistPrint.hxx"
+#include "PlaylistError.hxx"
+#include "queue/Print.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/StreamingCommand.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "BulkEdit.hxx"
@@ -27,7 +32,10 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <limits>
+#include <memory>
+#include <vector>
 
 static void
 AddUri(Client &client, const LocatedUri &uri)
@@ -144,6 +152,45 @@ handle_addid(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_addmulti(Client &client, Request args, Response &r)
+{
+	auto &partition = client.GetPartition();
+	const Queue &queue = partition.playlist.queue;
+
+	/* resolve all songs before modifying the queue, so an error
+	   leaves it unmodified */
+	const SongLoader loader(client);
+	std::vector<DetachedSong> songs;
+	songs.reserve(args.size());
+	for (const char *uri : args)
+		songs.push_back(loader.LoadSong(uri));
+
+	if (songs.size() > queue.max_length - queue.GetLength())
+		throw PlaylistError(PlaylistResult::TOO_LARGE,
+				    "Playlist is too large");
+
+	const unsigned start = queue.GetLength();
+
+	{
+		/* only one queue version, idle event and prefetch
+		   update for all songs */
+		const ScopeBulkEdit bulk_edit(partition);
+
+		for (auto &song : songs)
+			partition.playlist.AppendSong(partition.pc,
+						      std::move(song));
+	}
+
+	for (const char *uri : args)
+		partition.instance.LookupRemoteTag(uri);
+
+	for (unsigned i = 0; i < songs.size(); ++i)
+		r.Fmt("Id: {}\n", queue.PositionToId(start + i));
+
+	return CommandResult::OK;
+}
+
 /**
  * Parse a string in the form "START:END", both being (optional)
  * fractional non-negative time offsets in seconds.  Returns both in
@@ -248,11 +295,63 @@ handle_plchangesposid(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+namespace {
+
+/**
+ * Implementation of "playlistinfo" for large queues which sends the
+ * response one batch of songs at a time, so it does not need to fit
+ * into the output buffer.  The position cursor is checked against
+ * the current queue length in each batch, because the queue may be
+ * modified by other clients meanwhile.
+ */
+class PlaylistInfoCommand final : public StreamingCommand {
+	unsigned position;
+	const unsigned end;
+
+public:
+	static constexpr unsigned BATCH_SONGS = 1024;
+
+	PlaylistInfoCommand(Client &_client, RangeArg range) noexcept
+		:StreamingCommand(_client),
+		 position(range.start), end(range.end) {}
+
+protected:
+	bool Produce(Response &r) override {
+		const Queue &queue = client.GetPlaylist().queue;
+
+		const unsigned batch_end =
+			std::min({end, queue.GetLength(),
+				  position + BATCH_SONGS});
+		if (position < batch_end) {
+			queue_print_info(r, queue, position, batch_end);
+			position = batch_end;
+		}
+
+		return position >= std::min(end, queue.GetLength());
+	}
+};
+
+} // anonymous namespace
+
 CommandResult
 handle_playlistinfo(Client &client, Request args, Response &r)
 {
 	RangeArg range = args.ParseOptional(0, RangeArg::All());
 
+	const Queue &queue = client.GetPlaylist().queue;
+	if (!range.CheckClip(queue.GetLength()))
+		throw PlaylistError::BadRange();
+
+	if ((range.Count() > PlaylistInfoCommand::BATCH_SONGS ||
+	     client.ProtocolFeatureEnabled(PF_COMPACT)) &&
+	    !client.IsInCommandList()) {
+		auto cmd = std::make_unique<PlaylistInfoCommand>(client, range);
+		auto &c = *cmd;
+		client.SetBackgroundCommand(std::move(cmd));
+		c.Start();
+		return CommandResult::BACKGROUND;
+	}
+
 	playlist_print_info(r, client.GetPlaylist(), range);
 	return CommandResult::OK;
 }
@@ -326,6 +425,10 @@ handle_playlist_match(Client &client, Request args, Response &r,
 	}
 	filter.Optimize();
 
+#ifdef ENABLE_SQLITE
+	LoadFilterStickers(client, filter);
+#endif
+
 	QueueSelection selection;
 	selection.filter = &filter;
 	selection.window = window;
@@ -29,6 +29,11 @@
 #include "db/DatabaseLock.hxx"
 #include <fmt/format.h>
 #include "song/Filter.hxx"
+#include "protocol/Ack.hxx"
+
+#include <span>
+#include <utility> // for std::exchange()
+#include <vector>
 
 namespace {
 
@@ -59,6 +64,43 @@ public:
 		return CommandResult::OK;
 	}
 
+	/**
+	 * Set many stickers in one transaction.
+	 *
+	 * @param args a list of URI/name/value triples
+	 */
+	CommandResult SetMany(std::span<const char *const> args) {
+		assert(args.size() % 3 == 0);
+
+		std::vector<StickerDatabase::StoreItem> items;
+		items.reserve(args.size() / 3);
+
+		for (std::size_t i = 0; i < args.size(); i += 3)
+			items.push_back({ValidateUri(args[i]), args[i + 1], args[i + 2]});
+
+		sticker_database.StoreValues(sticker_type, items);
+
+		return CommandResult::OK;
+	}
+
+	/**
+	 * Print the value of one sticker for each of the given URIs
+	 * which has it.
+	 */
+	CommandResult GetMany(const char *name, std::span<const char *const> uris) {
+		auto data = CallbackContext{
+			.name = name,
+			.sticker_type = sticker_type,
+			.response = response,
+			.is_song = StringIsEqual("song", sticker_type)
+		};
+
+		sticker_database.LoadValues(sticker_type, name, uris,
+					    PrintFound, &data);
+
+		return CommandResult::OK;
+	}
+
 	virtual CommandResult Inc(const char *uri, const char *name, const char *value) {
 		sticker_database.IncValue(sticker_type,
 					  ValidateUri(uri).c_str(),
@@ -108,19 +150,12 @@ public:
 			.is_song = StringIsEqual("song", sticker_type)
 		};
 
-		auto callback = [](const char *found_uri, const char *found_value, void *user_data) {
-			auto context = reinterpret_cast<CallbackContext *>(user_data);
-			context->response.Fmt("{}: {}\n",
- 					      context->is_song ? "file" : context->sticker_type, found_uri);
-			sticker_print_value(context->response, context->name, found_value);
-		};
-
 		sticker_database.Find(sticker_type,
 				      uri,
 				      name,
 				      op, value,
 					  sort, descending, window,
-				      callback, &data);
+				      PrintFound, &data);
 
 		return CommandResult::OK;
 	}
@@ -196,6 +231,14 @@ private:
 		Response &response;
 		const bool is_song;
 	};
+
+	static void PrintFound(const char *found_uri, const char *found_value,
+			       void *user_data) {
+		auto context = reinterpret_cast<CallbackContext *>(user_data);
+		context->response.Fmt("{}: {}\n",
+				      context->is_song ? "file" : context->sticker_type, found_uri);
+		sticker_print_value(context->response, context->name, found_value);
+	}
 };
 
 /**
@@ -231,6 +274,11 @@ public:
 
 protected:
 	std::string ValidateUri(const char *uri) override {
+		if (song != nullptr) {
+			/* "sticker set" with many songs */
+			database.ReturnSong(std::exchange(song, nullptr));
+		}
+
 		// will throw if song uri not found
 		song = database.GetSong(uri);
 		assert(song != nullptr);
@@ -344,7 +392,7 @@ private:
 	std::string ValidateUri(const char *uri) override {
 		PlaylistVector playlists = ListPlaylistFiles();
 
-		const ScopeDatabaseLock protect;
+		const ScopeDatabaseReadLock protect;
 		if (!playlists.exists(uri))
 			throw std::invalid_argument(fmt::format("no such playlist: {:?}", uri));
 
@@ -456,12 +504,23 @@ handle_sticker(Client &client, Request args, Response &r)
 	if (args.size() == 3 && StringIsEqual(cmd, "list"))
 		return handler->List(uri);
 
+	/* getmany */
+	if (args.size() >= 4 && StringIsEqual(cmd, "getmany"))
+		return handler->GetMany(args[2], std::span{args}.subspan(3));
+
 	/* set */
-	if (args.size() == 5 && StringIsEqual(cmd, "set")) {
-		if (StringIsEmpty(sticker_name)) {
-			r.FmtError(ACK_ERROR_ARG, "empty sticker name");
-			return CommandResult::ERROR;
+	if (args.size() >= 5 && (args.size() - 2) % 3 == 0 &&
+	    StringIsEqual(cmd, "set")) {
+		for (std::size_t i = 3; i < args.size(); i += 3) {
+			if (StringIsEmpty(args[i])) {
+				r.FmtError(ACK_ERROR_ARG, "empty sticker name");
+				return CommandResult::ERROR;
+			}
 		}
+
+		if (args.size() > 5)
+			return handler->SetMany(std::span{args}.subspan(2));
+
 		return handler->Set(uri, sticker_name, args[4]);
 	}
 
@@ -569,3 +628,17 @@ handle_sticker_types(Client &client, Request args, Response &r)
 			r.Fmt("stickertype: {}\n", tag_item_names[i]);
 	return CommandResult::OK;
 }
+
+void
+LoadFilterStickers(Client &client, SongFilter &filter)
+{
+	if (filter.GetStickerFilters().empty())
+		return;
+
+	auto &instance = client.GetInstance();
+	if (!instance.HasStickerDatabase())
+		throw ProtocolError(ACK_ERROR_UNKNOWN,
+				    "sticker database is disabled");
+
+	sticker_song_load_filter(*instance.sticker_database, filter);
+}
@@ -9,6 +9,7 @@
 class Client;
 class Request;
 class Response;
+class SongFilter;
 
 CommandResult
 handle_sticker(Client &client, Request request, Response &response);
@@ -19,4 +20,15 @@ handle_sticker_types(Client &client, Request request, Response &response);
 CommandResult
 handle_sticker_names_types(Client &client, Request request, Response &response);
 
+/**
+ * Look up the songs matching the sticker items of the filter in the
+ * sticker database.  Call this after parsing the filter, before it
+ * is passed to the database.
+ *
+ * Throws if the filter has sticker items, but the sticker database
+ * is disabled.
+ */
+void
+LoadFilterStickers(Client &client, SongFilter &filter);
+
 #endif
@@ -26,6 +26,8 @@ enum class ConfigOption {
 	GROUP,
 	BIND_TO_ADDRESS,
 	PORT,
+	METRICS_BIND_TO_ADDRESS,
+	METRICS_PORT,
 	LOG_LEVEL,
 	ZEROCONF_NAME,
 	ZEROCONF_ENABLED,
@@ -41,7 +43,9 @@ enum class ConfigOption {
 	REPLAYGAIN_LIMIT,
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
+	FLOAT_DITHER,
 	AUDIO_BUFFER_SIZE,
+	SEEK_BUFFER_SIZE,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -52,6 +56,7 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	CLIENT_THREADS,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -59,8 +64,21 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	UPDATE_THREADS,
+	UPDATE_PARANOID,
 
 	MIXRAMP_ANALYZER,
+	BACKGROUND_ANALYZER,
+	BACKGROUND_FINGERPRINT,
+	FINGERPRINT_THREADS,
+
+	PLAYER_CPU_AFFINITY,
+	DECODER_CPU_AFFINITY,
+	DECODER_REALTIME,
+	AUDIO_BUFFER_LOCK,
+	AUDIO_BUFFER_HUGETLB,
+	AUDIO_BUFFER_POOL_SIZE,
+	AUDIO_BUFFER_MIN_SIZE,
 
 	MAX
 };
@@ -3,6 +3,7 @@
 
 #include "PartitionConfig.hxx"
 #include "Data.hxx"
+#include "Block.hxx"
 #include "Domain.hxx"
 #include "Parser.hxx"
 #include "pcm/AudioParser.hxx"
@@ -14,44 +15,188 @@ static constexpr
 size_t MIN_BUFFER_SIZE = std::max(CHUNK_SIZE * 32,
 				  64 * KILOBYTE);
 
-static unsigned
-GetBufferChunks(const ConfigData &config)
+static size_t
+ParseBufferSize(const char *s)
+{
+	size_t result = ParseSize(s, KILOBYTE);
+	if (result <= 0)
+		throw FmtRuntimeError("buffer size {:?} is not a "
+				      "positive integer", s);
+
+	if (result < MIN_BUFFER_SIZE) {
+		FmtWarning(config_domain, "buffer size {} is too small, using {} bytes instead",
+			   result, MIN_BUFFER_SIZE);
+		result = MIN_BUFFER_SIZE;
+	}
+
+	return result;
+}
+
+static size_t
+GetBufferSize(const ConfigData &config)
 {
 	size_t buffer_size = PlayerConfig::DEFAULT_BUFFER_SIZE;
-	if (auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE)) {
-		buffer_size = param->With([](const char *s){
+	if (auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_SIZE))
+		buffer_size = param->With(ParseBufferSize);
+
+	return buffer_size;
+}
+
+/**
+ * Convert a buffer size to a number of chunks.
+ *
+ * Throws if it is too big.
+ */
+static unsigned
+BufferSizeToChunks(size_t buffer_size, size_t chunk_size)
+{
+	const size_t n = buffer_size / chunk_size;
+	if (n >= 1 << 15)
+		throw FmtRuntimeError("buffer size {} is too big",
+				      buffer_size);
+
+	return n;
+}
+
+/**
+ * Determine the base quota ("audio_buffer_min_size") in chunks.  By
+ * default, a quarter of the buffer is guaranteed, and the rest must
+ * be borrowed from the pool.
+ */
+static unsigned
+GetBaseChunks(const char *s, unsigned buffer_chunks, size_t chunk_size)
+{
+	const unsigned base_chunks = s != nullptr
+		? BufferSizeToChunks(ParseBufferSize(s), chunk_size)
+		: std::max<unsigned>(buffer_chunks / 4,
+				     MIN_BUFFER_SIZE / chunk_size);
+	return std::min(base_chunks, buffer_chunks);
+}
+
+/**
+ * Parse "seek_buffer_size".  By default, a quarter of the audio
+ * buffer is kept for seeking backwards; at most half of it may be
+ * used, leaving the rest for the decoder.
+ */
+static size_t
+GetSeekBufferSize(const ConfigData &config, size_t buffer_size)
+{
+	const size_t max_size = buffer_size / 2;
+
+	if (auto *param = config.GetParam(ConfigOption::SEEK_BUFFER_SIZE)) {
+		return param->With([max_size](const char *s){
 			size_t result = ParseSize(s, KILOBYTE);
-			if (result <= 0)
-				throw FmtRuntimeError("buffer size {:?} is not a "
-						      "positive integer", s);
-
-			if (result < MIN_BUFFER_SIZE) {
-				FmtWarning(config_domain, "buffer size {} is too small, using {} bytes instead",
-					   result, MIN_BUFFER_SIZE);
-				result = MIN_BUFFER_SIZE;
+			if (result > max_size) {
+				FmtWarning(config_domain, "seek buffer size {} is too large, using {} bytes instead",
+					   result, max_size);
+				result = max_size;
 			}
 
 			return result;
 		});
 	}
 
-	unsigned buffer_chunks = buffer_size / CHUNK_SIZE;
-	if (buffer_chunks >= 1 << 15)
-		throw FmtRuntimeError("buffer size {:?} is too big",
-				      buffer_size);
+	return buffer_size / 4;
+}
+
+/**
+ * Choose the size of each #MusicChunk.  By default, a chunk holds
+ * 4 kB, i.e. 23 ms of CD audio.  If "audio_output_format" forces a
+ * higher bandwidth (e.g. 384 kHz or DSD512), the chunks grow
+ * proportionally, so the number of chunks per second (and thus the
+ * per-chunk overhead in the decoder, player and output threads)
+ * stays about the same.
+ */
+static size_t
+GetChunkSize(size_t buffer_size, AudioFormat audio_format) noexcept
+{
+	/* undefined (wildcard) attributes are assumed to be CD
+	   quality */
+	constexpr AudioFormat cd_format{44100, SampleFormat::S16, 2};
+	audio_format = cd_format.WithMask(audio_format);
+
+	constexpr std::chrono::seconds one_second{1};
+	const size_t bytes_per_second = audio_format.TimeToSize(one_second);
+	const size_t cd_bytes_per_second = cd_format.TimeToSize(one_second);
 
-	return buffer_chunks;
+	size_t chunk_size = CHUNK_SIZE;
+	if (bytes_per_second > cd_bytes_per_second) {
+		/* round up to a multiple of CHUNK_SIZE */
+		const size_t factor = (bytes_per_second + cd_bytes_per_second - 1)
+			/ cd_bytes_per_second;
+		chunk_size = std::min(CHUNK_SIZE * factor, MAX_CHUNK_SIZE);
+	}
+
+	/* leave enough chunks in the buffer for buffering and
+	   cross-fading */
+	while (chunk_size > CHUNK_SIZE && buffer_size / chunk_size < 256)
+		chunk_size -= CHUNK_SIZE;
+
+	return chunk_size;
+}
+
+static CpuAffinity
+ParseCpuAffinity(const char *s)
+{
+	return s != nullptr ? CpuAffinity::Parse(s) : CpuAffinity{};
 }
 
 PlayerConfig::PlayerConfig(const ConfigData &config)
-	:buffer_chunks(GetBufferChunks(config)),
-	 audio_format(config.With(ConfigOption::AUDIO_OUTPUT_FORMAT, [](const char *s){
+	:audio_format(config.With(ConfigOption::AUDIO_OUTPUT_FORMAT, [](const char *s){
 		 if (s == nullptr)
 			 return AudioFormat::Undefined();
 
 		 return ParseAudioFormat(s, true);
 	 })),
 	 replay_gain(config),
-	 mixramp_analyzer(config.GetBool(ConfigOption::MIXRAMP_ANALYZER, false))
+	 mixramp_analyzer(config.GetBool(ConfigOption::MIXRAMP_ANALYZER, false)),
+	 player_cpus(config.With(ConfigOption::PLAYER_CPU_AFFINITY,
+				 ParseCpuAffinity)),
+	 decoder_cpus(config.With(ConfigOption::DECODER_CPU_AFFINITY,
+				  ParseCpuAffinity)),
+	 decoder_realtime(config.GetBool(ConfigOption::DECODER_REALTIME, false)),
+	 buffer_lock(config.GetBool(ConfigOption::AUDIO_BUFFER_LOCK, false)),
+	 buffer_hugetlb(config.GetBool(ConfigOption::AUDIO_BUFFER_HUGETLB, false))
 {
+	const size_t buffer_size = GetBufferSize(config);
+	chunk_size = GetChunkSize(buffer_size, audio_format);
+	buffer_chunks = BufferSizeToChunks(buffer_size, chunk_size);
+	history_chunks = GetSeekBufferSize(config, buffer_size) / chunk_size;
+
+	if (const auto *param = config.GetParam(ConfigOption::AUDIO_BUFFER_POOL_SIZE))
+		pool_chunks = BufferSizeToChunks(param->With(ParseBufferSize),
+						 chunk_size);
+
+	base_chunks = config.With(ConfigOption::AUDIO_BUFFER_MIN_SIZE,
+				  [this](const char *s){
+		return GetBaseChunks(s, buffer_chunks, chunk_size);
+	});
+}
+
+void
+PlayerConfig::ApplyPartitionBlock(const ConfigBlock &block)
+{
+	if (const auto *param = block.GetBlockParam("player_cpu_affinity"))
+		player_cpus = param->With(ParseCpuAffinity);
+
+	if (const auto *param = block.GetBlockParam("decoder_cpu_affinity"))
+		decoder_cpus = param->With(ParseCpuAffinity);
+
+	decoder_realtime = block.GetBlockValue("decoder_realtime",
+					       decoder_realtime);
+	buffer_lock = block.GetBlockValue("audio_buffer_lock", buffer_lock);
+
+	/* the chunk size is global, because all partitions share
+	   the pool; only the number of chunks may differ */
+	if (const auto *param = block.GetBlockParam("audio_buffer_size")) {
+		buffer_chunks = BufferSizeToChunks(param->With(ParseBufferSize),
+						   chunk_size);
+		history_chunks = std::min(history_chunks, buffer_chunks / 2);
+		base_chunks = std::min(base_chunks, buffer_chunks);
+	}
+
+	if (const auto *param = block.GetBlockParam("audio_buffer_min_size"))
+		base_chunks = param->With([this](const char *s){
+			return GetBaseChunks(s, buffer_chunks, chunk_size);
+		});
 }
@@ -5,8 +5,11 @@
 
 #include "pcm/AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
+#include "MusicChunk.hxx"
+#include "thread/Affinity.hxx"
 
 struct ConfigData;
+struct ConfigBlock;
 
 static constexpr size_t KILOBYTE = 1024;
 static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
@@ -14,7 +17,36 @@ static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
 struct PlayerConfig {
 	static constexpr size_t DEFAULT_BUFFER_SIZE = 8 * MEGABYTE;
 
-	unsigned buffer_chunks = DEFAULT_BUFFER_SIZE;
+	unsigned buffer_chunks = DEFAULT_BUFFER_SIZE / CHUNK_SIZE;
+
+	/**
+	 * The PCM capacity of each #MusicChunk in bytes, derived from
+	 * "audio_output_format".
+	 */
+	size_t chunk_size = CHUNK_SIZE;
+
+	/**
+	 * The number of chunks each partition may use without
+	 * borrowing from the instance-wide pool
+	 * ("audio_buffer_min_size").  Only used if #pool_chunks is
+	 * non-zero.
+	 */
+	unsigned base_chunks = buffer_chunks;
+
+	/**
+	 * The size of the instance-wide #MusicBufferPool shared by
+	 * all partitions in chunks ("audio_buffer_pool_size"); 0
+	 * means there is no pool, and each partition may always use
+	 * all of its #buffer_chunks.
+	 */
+	unsigned pool_chunks = 0;
+
+	/**
+	 * The number of played chunks kept for seeking backwards
+	 * without the decoder ("seek_buffer_size").  They are taken
+	 * from #buffer_chunks.
+	 */
+	unsigned history_chunks = 0;
 
 	/**
 	 * The "audio_output_format" setting.
@@ -25,7 +57,45 @@ struct PlayerConfig {
 
 	bool mixramp_analyzer = false;
 
+	/**
+	 * The CPUs the player thread may run on
+	 * ("player_cpu_affinity").
+	 */
+	CpuAffinity player_cpus;
+
+	/**
+	 * The CPUs the decoder thread may run on
+	 * ("decoder_cpu_affinity").
+	 */
+	CpuAffinity decoder_cpus;
+
+	/**
+	 * Run the decoder thread with real-time scheduling
+	 * ("decoder_realtime")?
+	 */
+	bool decoder_realtime = false;
+
+	/**
+	 * Lock the audio buffer into RAM while playing
+	 * ("audio_buffer_lock")?
+	 */
+	bool buffer_lock = false;
+
+	/**
+	 * Allocate the audio buffer from explicit huge pages
+	 * ("audio_buffer_hugetlb")?
+	 */
+	bool buffer_hugetlb = false;
+
 	PlayerConfig() = default;
 
 	explicit PlayerConfig(const ConfigData &config);
+
+	/**
+	 * Override the thread and buffer settings with those from a
+	 * "partition" block.
+	 *
+	 * Throws on error.
+	 */
+	void ApplyPartitionBlock(const ConfigBlock &block);
 };
@@ -24,6 +24,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "group" },
 	{ "bind_to_address", true },
 	{ "port" },
+	{ "metrics_bind_to_address", true },
+	{ "metrics_port" },
 	{ "log_level" },
 	{ "zeroconf_name" },
 	{ "zeroconf_enabled" },
@@ -39,7 +41,9 @@ const ConfigTemplate config_param_templates[] = {
 	{ "replaygain_limit" },
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
+	{ "float_dither" },
 	{ "audio_buffer_size" },
+	{ "seek_buffer_size" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -50,6 +54,7 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "client_threads" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
@@ -57,7 +62,19 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback", false, true },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "update_threads" },
+	{ "update_paranoid" },
 	{ "mixramp_analyzer" },
+	{ "background_analyzer" },
+	{ "background_fingerprint" },
+	{ "fingerprint_threads" },
+	{ "player_cpu_affinity" },
+	{ "decoder_cpu_affinity" },
+	{ "decoder_realtime" },
+	{ "audio_buffer_lock" },
+	{ "audio_buffer_hugetlb" },
+	{ "audio_buffer_pool_size" },
+	{ "audio_buffer_min_size" },
 };
 
 static constexpr unsigned n_config_param_templates =
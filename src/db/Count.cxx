@@ -6,6 +6,7 @@
 #include "Interface.hxx"
 #include "Partition.hxx"
 #include "client/Response.hxx"
+#include "song/Filter.hxx"
 #include "song/LightSong.hxx"
 #include "tag/Tag.hxx"
 #include "tag/VisitFallback.hxx"
@@ -13,8 +14,11 @@
 
 #include <fmt/format.h>
 
+#include <array>
 #include <functional>
 #include <map>
+#include <memory>
+#include <optional>
 
 struct SearchStats {
 	unsigned n_songs{0};
@@ -27,6 +31,22 @@ struct SearchStats {
 class TagCountMap : public std::map<std::string, SearchStats, std::less<>> {
 };
 
+/**
+ * The results of "count" over the whole database without a filter
+ * (which clients tend to poll), until the database gets modified.
+ */
+static std::optional<SearchStats> count_cache;
+static std::array<std::unique_ptr<const TagCountMap>, TAG_NUM_OF_ITEM_TYPES> count_group_cache;
+
+void
+song_count_invalidate() noexcept
+{
+	count_cache.reset();
+
+	for (auto &i : count_group_cache)
+		i.reset();
+}
+
 static void
 PrintSearchStats(Response &r, const SearchStats &stats) noexcept
 {
@@ -84,11 +104,19 @@ PrintSongCount(Response &r, const Partition &partition, const std::string_view n
 {
 	const Database &db = partition.GetDatabaseOrThrow();
 
+	const bool cacheable = name.empty() &&
+		(filter == nullptr || filter->IsEmpty());
+
 	const DatabaseSelection selection(name, true, filter);
 
 	if (group == TAG_NUM_OF_ITEM_TYPES) {
 		/* no grouping */
 
+		if (cacheable && count_cache) {
+			PrintSearchStats(r, *count_cache);
+			return;
+		}
+
 		SearchStats stats;
 
 		const auto f = [&](const auto &song)
@@ -97,17 +125,29 @@ PrintSongCount(Response &r, const Partition &partition, const std::string_view n
 		db.Visit(selection, f);
 
 		PrintSearchStats(r, stats);
+
+		if (cacheable)
+			count_cache = stats;
 	} else {
 		/* group by the specified tag: store counts in a
 		   std::map */
 
-		TagCountMap map;
+		auto &cached = count_group_cache[group];
+		if (cacheable && cached) {
+			Print(r, group, *cached);
+			return;
+		}
 
-		const auto f = [&map,group](const auto &song)
+		auto map = std::make_unique<TagCountMap>();
+
+		const auto f = [&map = *map, group](const auto &song)
 			{ return GroupCountVisitor(map, group, song); };
 
 		db.Visit(selection, f);
 
-		Print(r, group, map);
+		Print(r, group, *map);
+
+		if (cacheable)
+			cached = std::move(map);
 	}
 }
@@ -11,6 +11,13 @@ struct Partition;
 class Response;
 class SongFilter;
 
+/**
+ * Discard the results cached by PrintSongCount().  Call this after
+ * the database has been modified.
+ */
+void
+song_count_invalidate() noexcept;
+
 void
 PrintSongCount(Response &r, const Partition &partition, std::string_view name,
 	       const SongFilter *filter,
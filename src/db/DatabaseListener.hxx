@@ -4,6 +4,10 @@
 #ifndef MPD_DATABASE_CLIENT_HXX
 #define MPD_DATABASE_CLIENT_HXX
 
+#include <span>
+#include <string>
+#include <utility>
+
 struct LightSong;
 
 /**
@@ -25,6 +29,15 @@ public:
 	 * the database because the file has disappeared.
 	 */
 	virtual void OnDatabaseSongRemoved(const char *uri) noexcept = 0;
+
+	/**
+	 * During database update, song files have been found to be
+	 * moved or renamed.  The database entries have been updated
+	 * already.
+	 *
+	 * @param moved pairs of old and new URI
+	 */
+	virtual void OnDatabaseSongsMoved(std::span<const std::pair<std::string, std::string>> moved) noexcept = 0;
 };
 
 #endif
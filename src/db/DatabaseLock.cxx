@@ -3,8 +3,8 @@
 
 #include "DatabaseLock.hxx"
 
-Mutex db_mutex;
+SharedMutex db_mutex;
 
 #ifndef NDEBUG
-ThreadId db_mutex_holder;
+thread_local DatabaseLockMode db_lock_mode = DatabaseLockMode::NONE;
 #endif
@@ -5,38 +5,63 @@
  *
  * Support for locking data structures from the database, for safe
  * multi-threading.
+ *
+ * The lock is a reader/writer lock: code which only reads the tree
+ * (e.g. database queries) obtains it in "shared" mode and may run
+ * concurrently with other readers; modifications (the update thread,
+ * mounting, saving) need "exclusive" mode.
  */
 
 #ifndef MPD_DB_LOCK_HXX
 #define MPD_DB_LOCK_HXX
 
-#include "thread/Mutex.hxx"
+#include "thread/SharedMutex.hxx"
 
 #include <cassert>
+#include <cstdint>
 
-extern Mutex db_mutex;
+extern SharedMutex db_mutex;
 
 #ifndef NDEBUG
 
-#include "thread/Id.hxx"
+enum class DatabaseLockMode : uint_least8_t {
+	NONE,
+	SHARED,
+	EXCLUSIVE,
+};
 
-extern ThreadId db_mutex_holder;
+/**
+ * How does the current thread hold the #db_mutex?
+ */
+extern thread_local DatabaseLockMode db_lock_mode;
 
 /**
- * Does the current thread hold the database lock?
+ * Does the current thread hold the database lock (shared or
+ * exclusive)?
  */
 [[gnu::pure]]
 static inline bool
 holding_db_lock() noexcept
 {
-	return db_mutex_holder.IsInside();
+	return db_lock_mode != DatabaseLockMode::NONE;
+}
+
+/**
+ * Does the current thread hold the database lock in exclusive mode,
+ * i.e. is it allowed to modify the tree?
+ */
+[[gnu::pure]]
+static inline bool
+holding_db_write_lock() noexcept
+{
+	return db_lock_mode == DatabaseLockMode::EXCLUSIVE;
 }
 
 #endif
 
 /**
- * Obtain the global database lock.  This is needed before
- * dereferencing a #song or #directory.  It is not recursive.
+ * Obtain the global database lock in exclusive mode.  This is needed
+ * before modifying a #song or #directory.  It is not recursive.
  */
 static inline void
 db_lock(void)
@@ -45,26 +70,59 @@ db_lock(void)
 
 	db_mutex.lock();
 
-	assert(db_mutex_holder.IsNull());
 #ifndef NDEBUG
-	db_mutex_holder = ThreadId::GetCurrent();
+	db_lock_mode = DatabaseLockMode::EXCLUSIVE;
 #endif
 }
 
 /**
- * Release the global database lock.
+ * Release the global database lock obtained with db_lock().
  */
 static inline void
 db_unlock(void)
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 #ifndef NDEBUG
-	db_mutex_holder = ThreadId::Null();
+	db_lock_mode = DatabaseLockMode::NONE;
 #endif
 
 	db_mutex.unlock();
 }
 
+/**
+ * Obtain the global database lock in shared mode.  This is needed
+ * before dereferencing a #song or #directory.  It is not recursive.
+ */
+static inline void
+db_lock_shared(void)
+{
+	assert(!holding_db_lock());
+
+	db_mutex.lock_shared();
+
+#ifndef NDEBUG
+	db_lock_mode = DatabaseLockMode::SHARED;
+#endif
+}
+
+/**
+ * Release the global database lock obtained with db_lock_shared().
+ */
+static inline void
+db_unlock_shared(void)
+{
+	assert(db_lock_mode == DatabaseLockMode::SHARED);
+#ifndef NDEBUG
+	db_lock_mode = DatabaseLockMode::NONE;
+#endif
+
+	db_mutex.unlock_shared();
+}
+
+/**
+ * Hold the database lock in exclusive mode while in the current
+ * scope.
+ */
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -90,7 +148,35 @@ public:
 };
 
 /**
- * Unlock the database while in the current scope.
+ * Hold the database lock in shared mode while in the current scope.
+ */
+class ScopeDatabaseReadLock {
+	bool locked = true;
+
+public:
+	ScopeDatabaseReadLock() {
+		db_lock_shared();
+	}
+
+	~ScopeDatabaseReadLock() {
+		if (locked)
+			db_unlock_shared();
+	}
+
+	/**
+	 * Unlock the mutex now, making the destructor a no-op.
+	 */
+	void unlock() {
+		assert(locked);
+
+		db_unlock_shared();
+		locked = false;
+	}
+};
+
+/**
+ * Unlock the database (held in exclusive mode) while in the current
+ * scope.
  */
 class ScopeDatabaseUnlock {
 public:
@@ -103,4 +189,19 @@ public:
 	}
 };
 
+/**
+ * Unlock the database (held in shared mode) while in the current
+ * scope.
+ */
+class ScopeDatabaseReadUnlock {
+public:
+	ScopeDatabaseReadUnlock() {
+		db_unlock_shared();
+	}
+
+	~ScopeDatabaseReadUnlock() {
+		db_lock_shared();
+	}
+};
+
 #endif
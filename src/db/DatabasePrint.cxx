@@ -157,6 +157,35 @@ db_selection_print(Response &r, Partition &partition,
 	db.Visit(selection, d, s, p);
 }
 
+unsigned
+db_directory_print(Response &r, const Database &db,
+		   const LightDirectory &directory, bool full)
+{
+	if (full)
+		PrintDirectoryFull(r, false, directory);
+	else
+		PrintDirectoryBrief(r, false, directory);
+
+	unsigned n = 0;
+
+	VisitSong s = [&](const auto &song){
+		++n;
+		return full ?
+			PrintSongFull(r, false, song) :
+			PrintSongBrief(r, false, song);
+	};
+
+	VisitPlaylist p = [&](const auto &playlist, const auto &dir){
+		return full ?
+			PrintPlaylistFull(r, false, playlist, dir) :
+			PrintPlaylistBrief(r, false, playlist, dir);
+	};
+
+	db.Visit(DatabaseSelection{directory.GetPath(), false},
+		 VisitDirectory(), s, p);
+	return n;
+}
+
 static void
 PrintSongURIVisitor(Response &r, const LightSong &song) noexcept
 {
@@ -8,6 +8,8 @@
 
 enum TagType : uint8_t;
 class SongFilter;
+class Database;
+struct LightDirectory;
 struct DatabaseSelection;
 struct Partition;
 class Response;
@@ -22,6 +24,21 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base);
 
+/**
+ * Print one directory, its songs and its playlists (but not its child
+ * directories) like db_selection_print() with a recursive selection
+ * would.  This allows printing a large recursive selection one
+ * directory at a time.
+ *
+ * Throws on error.
+ *
+ * @param full print attributes/tags
+ * @return the number of songs which were printed
+ */
+unsigned
+db_directory_print(Response &r, const Database &db,
+		   const LightDirectory &directory, bool full);
+
 void
 PrintSongUris(Response &r, Partition &partition,
 	      const SongFilter *filter);
@@ -8,6 +8,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <optional>
 #include <span>
 #include <string>
 
@@ -103,6 +104,20 @@ public:
 	 */
 	virtual DatabaseStats GetStats(const DatabaseSelection &selection) const = 0;
 
+	/**
+	 * Look up the name of the album art file in the given
+	 * directory (see #cover_art_names), as seen by the last
+	 * update.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the file name, an empty string if the directory
+	 * has none, or std::nullopt if this is not known
+	 */
+	virtual std::optional<std::string> GetDirectoryCover([[maybe_unused]] std::string_view uri_utf8) const {
+		return std::nullopt;
+	}
+
 	/**
 	 * Update the database.
 	 *
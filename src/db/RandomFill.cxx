@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "RandomFill.hxx"
+#include "Interface.hxx"
+#include "Selection.hxx"
+#include "song/LightSong.hxx"
+
+#include <algorithm> // for std::shuffle()
+#include <cstdint>
+#include <random>
+
+using std::string_view_literals::operator""sv;
+
+void
+RandomFill::SampleBatch(const Database &db)
+{
+	const DatabaseSelection selection{""sv, true,
+		filter.IsEmpty() ? nullptr : &filter};
+
+	rand.AutoCreate();
+
+	batch.clear();
+	batch_stamp = db.GetUpdateStamp();
+
+	/* reservoir sampling (algorithm R): the n-th candidate
+	   replaces a random element of the reservoir with a
+	   probability of BATCH_SIZE/n; only then is its URI
+	   built */
+	uint_least64_t n = 0;
+
+	db.Visit(selection, [this, &n](const LightSong &song){
+		++n;
+		if (batch.size() < BATCH_SIZE) {
+			batch.emplace_back(song.GetURI());
+			return;
+		}
+
+		const auto i = std::uniform_int_distribution<uint_least64_t>{0, n - 1}(rand);
+		if (i < BATCH_SIZE)
+			batch[i] = song.GetURI();
+	});
+
+	/* the first elements of the reservoir are in database
+	   order */
+	std::shuffle(batch.begin(), batch.end(), rand);
+}
+
+std::string
+RandomFill::TakeFromBatch() noexcept
+{
+	while (!batch.empty()) {
+		auto uri = std::move(batch.back());
+		batch.pop_back();
+
+		if (!history_set.contains(uri))
+			return uri;
+	}
+
+	return {};
+}
+
+std::string
+RandomFill::Sample(const Database &db)
+{
+	const DatabaseSelection selection{""sv, true,
+		filter.IsEmpty() ? nullptr : &filter};
+
+	rand.AutoCreate();
+
+	/* reservoir sampling: the n-th candidate replaces the
+	   current pick with a probability of 1/n */
+	std::string result;
+	uint_least64_t n = 0;
+
+	db.Visit(selection, [this, &result, &n](const LightSong &song){
+		auto uri = song.GetURI();
+		if (history_set.contains(uri))
+			return;
+
+		++n;
+		if (std::uniform_int_distribution<uint_least64_t>{0, n - 1}(rand) == 0)
+			result = std::move(uri);
+	});
+
+	return result;
+}
+
+void
+RandomFill::Remember(const std::string &uri) noexcept
+{
+	if (max_history == 0)
+		return;
+
+	if (history.size() >= max_history) {
+		history_set.erase(history.front());
+		history.pop_front();
+	}
+
+	history.push_back(uri);
+	history_set.emplace(history.back());
+}
+
+std::string
+RandomFill::Pick(const Database &db)
+{
+	if (batch_stamp != db.GetUpdateStamp())
+		/* songs may have been removed */
+		batch.clear();
+
+	auto uri = TakeFromBatch();
+	if (uri.empty()) {
+		SampleBatch(db);
+		uri = TakeFromBatch();
+	}
+
+	if (uri.empty())
+		/* the whole batch was in the history (or nothing
+		   matches); this happens only if the history covers
+		   a large part of the matching songs */
+		uri = Sample(db);
+
+	if (uri.empty() && !history.empty()) {
+		/* all matching songs have been played recently:
+		   start over */
+		history_set.clear();
+		history.clear();
+		uri = Sample(db);
+	}
+
+	if (!uri.empty())
+		Remember(uri);
+
+	return uri;
+}
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "song/Filter.hxx"
+#include "util/LazyRandomEngine.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class Database;
+
+/**
+ * Draws random songs matching a filter from the database, one at a
+ * time, so the whole library can be played in random order without
+ * adding all of it to the queue (see Partition::AutoFill()).  The
+ * most recently picked songs are remembered and will not be picked
+ * again.
+ *
+ * Memory usage is proportional to the history size, not to the
+ * number of matching songs: songs are drawn with reservoir
+ * sampling.  Each walk over the database (on the main thread)
+ * draws a whole batch of songs, so only every #BATCH_SIZE-th Pick()
+ * walks the database.
+ */
+class RandomFill {
+	const SongFilter filter;
+
+	const std::size_t max_history;
+
+	/**
+	 * The URIs of the most recently picked songs, the oldest
+	 * first.
+	 */
+	std::deque<std::string> history;
+
+	/**
+	 * Points into #history (std::deque does not move its
+	 * elements on push_back() and pop_front()).
+	 */
+	std::unordered_set<std::string_view> history_set;
+
+	/**
+	 * Songs drawn by the last walk which have not been picked
+	 * yet; Pick() takes them from the back.
+	 */
+	std::vector<std::string> batch;
+
+	/**
+	 * The database's update stamp when #batch was drawn; the
+	 * batch is discarded when the database has been modified.
+	 */
+	std::chrono::system_clock::time_point batch_stamp;
+
+	LazyRandomEngine rand;
+
+public:
+	/**
+	 * The number of songs AutoFill() keeps in the queue after the
+	 * current one.
+	 */
+	static constexpr unsigned AHEAD = 2;
+
+	static constexpr std::size_t DEFAULT_HISTORY = 1024;
+
+	/**
+	 * The number of songs drawn by one walk over the database.
+	 */
+	static constexpr std::size_t BATCH_SIZE = 64;
+
+	explicit RandomFill(SongFilter &&_filter,
+			    std::size_t _max_history=DEFAULT_HISTORY) noexcept
+		:filter(std::move(_filter)), max_history(_max_history) {}
+
+	RandomFill(const RandomFill &) = delete;
+	RandomFill &operator=(const RandomFill &) = delete;
+
+	const SongFilter &GetFilter() const noexcept {
+		return filter;
+	}
+
+	/**
+	 * Pick a random matching song which is not in the history and
+	 * add it to the history.  If all matching songs are in the
+	 * history, the history is cleared.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the song URI or an empty string if no song matches
+	 */
+	std::string Pick(const Database &db);
+
+private:
+	/**
+	 * Walk the database and draw up to #BATCH_SIZE distinct
+	 * matching songs into #batch, in random order.  The history
+	 * is not considered here, because that would require
+	 * building the URI of every song.
+	 */
+	void SampleBatch(const Database &db);
+
+	/**
+	 * Take a song from #batch which is not in the history.
+	 *
+	 * @return the URI or an empty string if #batch is exhausted
+	 */
+	std::string TakeFromBatch() noexcept;
+
+	/**
+	 * Walk the database and draw one song which is not in the
+	 * history.  This is the fallback if (almost) all matching
+	 * songs are in the history.
+	 */
+	std::string Sample(const Database &db);
+
+	void Remember(const std::string &uri) noexcept;
+};
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "song/Filter.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Sort.hxx"
+
+#include <chrono>
+
+/**
+ * The attribute of a #LightSong or #DetachedSong which is used for
+ * sorting a #DatabaseSelection, determined only once per song.
+ */
+struct SongSortKey {
+	/**
+	 * For sorting by a tag.  It points into the tag pool, so it
+	 * remains valid when the #Tag is moved.
+	 */
+	TagSortKey tag;
+
+	/**
+	 * For #SORT_TAG_LAST_MODIFIED and #SORT_TAG_ADDED.
+	 */
+	std::chrono::system_clock::time_point time;
+
+	SongSortKey(TagType sort, const Tag &_tag,
+		    std::chrono::system_clock::time_point mtime,
+		    std::chrono::system_clock::time_point added) noexcept {
+		if (sort == TagType(SORT_TAG_LAST_MODIFIED))
+			time = mtime;
+		else if (sort == TagType(SORT_TAG_ADDED))
+			time = added;
+		else
+			tag = {sort, _tag};
+	}
+
+	SongSortKey(TagType sort, const LightSong &song) noexcept
+		:SongSortKey(sort, song.tag, song.mtime, song.added) {}
+
+	SongSortKey(TagType sort, const DetachedSong &song) noexcept
+		:SongSortKey(sort, song.GetTag(), song.GetLastModified(),
+			     song.GetAdded()) {}
+};
+
+[[gnu::pure]]
+inline bool
+CompareSongSortKeys(TagType sort, bool descending,
+		    const SongSortKey &a, const SongSortKey &b) noexcept
+{
+	if (sort == TagType(SORT_TAG_LAST_MODIFIED) ||
+	    sort == TagType(SORT_TAG_ADDED))
+		return descending
+			? a.time > b.time
+			: a.time < b.time;
+	else
+		return CompareTagSortKeys(descending, a.tag, b.tag);
+}
+
+/**
+ * Returns a strict total order of objects with the attributes "key"
+ * (#SongSortKey) and "serial" (the position in which they were
+ * visited, which breaks ties like std::stable_sort() would).
+ */
+constexpr auto
+MakeCompareSongSortItems(TagType sort, bool descending) noexcept
+{
+	return [sort, descending](const auto &a, const auto &b){
+		if (CompareSongSortKeys(sort, descending, a.key, b.key))
+			return true;
+		if (CompareSongSortKeys(sort, descending, b.key, a.key))
+			return false;
+		return a.serial < b.serial;
+	};
+}
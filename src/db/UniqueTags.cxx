@@ -4,34 +4,241 @@
 #include "UniqueTags.hxx"
 #include "Interface.hxx"
 #include "song/LightSong.hxx"
-#include "tag/VisitFallback.hxx"
+#include "tag/Fallback.hxx"
+#include "tag/Item.hxx"
+#include "tag/Pool.hxx"
+#include "tag/Tag.hxx"
 #include "util/RecursiveMap.hxx"
 
-static void
-CollectUniqueTags(RecursiveMap<std::string> &result,
-		  const Tag &tag,
-		  std::span<const TagType> tag_types) noexcept
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/**
+ * Collects the distinct combinations of tag values of many songs.
+ *
+ * Values are identified by their tag pool index (see
+ * tag_pool_item_index()) instead of their string, therefore each song
+ * costs only a hash lookup of a few integers.  Strings are copied and
+ * sorted only once per distinct combination, in Commit(), which also
+ * merges combinations of different pool items with the same value
+ * (e.g. from fallback tags).
+ *
+ * A reference to each pool item is held until destruction, so its
+ * index cannot be recycled for a different value while the songs
+ * are being visited (#LightSong tags may be temporary).
+ */
+class UniqueTagCollector {
+	/**
+	 * The "index" of the empty string (songs without the tag).
+	 */
+	static constexpr uint32_t EMPTY = ~uint32_t{};
+
+	const std::span<const TagType> tag_types;
+
+	/**
+	 * The "position" of #scratch in #set lookups.
+	 */
+	static constexpr std::size_t SCRATCH = ~std::size_t{};
+
+	/**
+	 * The pool indices of all distinct combinations, one
+	 * combination (tag_types.size() items) after the other.
+	 */
+	std::vector<uint32_t> keys;
+
+	/**
+	 * The combination of the current song being built by Add().
+	 */
+	std::vector<uint32_t> scratch;
+
+	struct KeyHash {
+		const UniqueTagCollector &c;
+
+		[[gnu::pure]]
+		std::size_t operator()(std::size_t position) const noexcept {
+			std::size_t h = 0;
+			for (const uint32_t i : c.GetKey(position))
+				h = h * 31 + i;
+			return h;
+		}
+	};
+
+	struct KeyEqual {
+		const UniqueTagCollector &c;
+
+		[[gnu::pure]]
+		bool operator()(std::size_t a, std::size_t b) const noexcept {
+			return std::ranges::equal(c.GetKey(a), c.GetKey(b));
+		}
+	};
+
+	/**
+	 * Positions of distinct combinations in #keys.
+	 */
+	std::unordered_set<std::size_t, KeyHash, KeyEqual> set;
+
+	/**
+	 * Pool indices this object holds a reference on.
+	 */
+	std::unordered_set<uint32_t> held;
+
+public:
+	explicit UniqueTagCollector(std::span<const TagType> _tag_types) noexcept
+		:tag_types(_tag_types),
+		 set(0, KeyHash{*this}, KeyEqual{*this}) {
+		assert(!tag_types.empty());
+	}
+
+	~UniqueTagCollector() noexcept {
+		for (const uint32_t i : held)
+			tag_pool_put_item(&tag_pool_item_at(i));
+	}
+
+	UniqueTagCollector(const UniqueTagCollector &) = delete;
+	UniqueTagCollector &operator=(const UniqueTagCollector &) = delete;
+
+	void Add(const Tag &tag) {
+		Add(tag, 0);
+	}
+
+	RecursiveMap<std::string> Commit() const;
+
+private:
+	[[gnu::pure]]
+	std::span<const uint32_t> GetKey(std::size_t position) const noexcept {
+		if (position == SCRATCH)
+			return scratch;
+
+		return std::span{keys}.subspan(position, tag_types.size());
+	}
+
+	[[gnu::pure]]
+	static const char *GetValue(uint32_t i) noexcept {
+		return i == EMPTY ? "" : tag_pool_item_at(i).value;
+	}
+
+	/**
+	 * Append the values of tag_types[level] (and all following
+	 * levels) to #scratch.
+	 */
+	void Add(const Tag &tag, std::size_t level);
+
+	/**
+	 * The #scratch combination is complete: copy it to #keys and
+	 * #set unless it is known already.
+	 */
+	void Insert();
+
+	/**
+	 * Obtain a reference to the pool item with the given index.
+	 *
+	 * @return the index of the referenced item (which may be a
+	 * different one with the same value if the reference counter
+	 * is full)
+	 */
+	uint32_t Hold(uint32_t i);
+};
+
+void
+UniqueTagCollector::Add(const Tag &tag, std::size_t level)
 {
-	if (tag_types.empty())
+	if (level == tag_types.size()) {
+		Insert();
 		return;
+	}
 
-	const auto tag_type = tag_types.front();
-	tag_types = tag_types.subspan(1);
+	const uint8_t *const types = tag.GetTypes();
 
-	VisitTagWithFallbackOrEmpty(tag, tag_type, [&result, &tag, tag_types](const char *value){
-			CollectUniqueTags(result[value], tag, tag_types);
-		});
+	const auto visit_type = [&](TagType type){
+		bool found = false;
+
+		for (unsigned j = 0; j < tag.num_items; ++j) {
+			if (types[j] != type)
+				continue;
+
+			found = true;
+			scratch.push_back(tag.items[j]);
+			Add(tag, level + 1);
+			scratch.pop_back();
+		}
+
+		return found;
+	};
+
+	if (!ApplyTagWithFallback(tag_types[level], visit_type)) {
+		scratch.push_back(EMPTY);
+		Add(tag, level + 1);
+		scratch.pop_back();
+	}
+}
+
+void
+UniqueTagCollector::Insert()
+{
+	if (set.contains(SCRATCH))
+		return;
+
+	/* a new combination: copy it, referencing all of its
+	   items */
+	const std::size_t position = keys.size();
+	for (const uint32_t i : scratch)
+		keys.push_back(i != EMPTY ? Hold(i) : EMPTY);
+
+	if (!set.insert(position).second)
+		/* Hold() has switched to an item which is already
+		   known */
+		keys.resize(position);
+}
+
+uint32_t
+UniqueTagCollector::Hold(uint32_t i)
+{
+	assert(i != EMPTY);
+
+	if (held.contains(i))
+		return i;
+
+	const uint32_t result =
+		tag_pool_item_index(*tag_pool_dup_item(&tag_pool_item_at(i)));
+	if (!held.insert(result).second)
+		/* already holding that other item */
+		tag_pool_put_item(&tag_pool_item_at(result));
+
+	return result;
+}
+
+RecursiveMap<std::string>
+UniqueTagCollector::Commit() const
+{
+	RecursiveMap<std::string> result;
+
+	for (const std::size_t position : set) {
+		auto *map = &result;
+		for (const uint32_t i : GetKey(position))
+			map = &(*map)[GetValue(i)];
+	}
+
+	return result;
 }
 
+} // anonymous namespace
+
 RecursiveMap<std::string>
 CollectUniqueTags(const Database &db, const DatabaseSelection &selection,
 		  std::span<const TagType> tag_types)
 {
-	RecursiveMap<std::string> result;
+	if (tag_types.empty())
+		return {};
+
+	UniqueTagCollector collector{tag_types};
 
-	db.Visit(selection, [&result, tag_types](const LightSong &song){
-			CollectUniqueTags(result, song.tag, tag_types);
+	db.Visit(selection, [&collector](const LightSong &song){
+			collector.Add(song.tag);
 		});
 
-	return result;
+	return collector.Commit();
 }
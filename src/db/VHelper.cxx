@@ -2,15 +2,31 @@
 // Copyright The Music Player Daemon Project
 
 #include "VHelper.hxx"
+#include "SortKey.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
-#include "song/Filter.hxx"
-#include "tag/Sort.hxx"
 
 #include <algorithm>
 #include <cassert>
 #include <utility>
 
+struct DatabaseVisitorHelper::SortItem {
+	DetachedSong song;
+
+	SongSortKey key;
+
+	/**
+	 * The position in which the song was visited; it breaks ties
+	 * between songs with equal sort values, like
+	 * std::stable_sort() would.
+	 */
+	unsigned serial;
+
+	SortItem(const LightSong &_song, TagType sort,
+		 unsigned _serial) noexcept
+		:song(_song), key(sort, song), serial(_serial) {}
+};
+
 DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 					     VisitSong &visit_song) noexcept
 	:selection(std::move(_selection))
@@ -26,9 +42,18 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 		   this std::vector, and then sort it */
 
 		original_visit_song = std::move(visit_song);
-		visit_song = [this](const auto &song){
-			songs.emplace_back(song);
-		};
+
+		if (selection.window.IsOpenEnded())
+			visit_song = [this](const auto &song){
+				AddSorted(song);
+			};
+		else
+			/* songs beyond the end of the window will
+			   never be sent, so there is no need to keep
+			   them */
+			visit_song = [this](const auto &song){
+				AddBounded(song);
+			};
 	} else if (selection.window != RangeArg::All()) {
 		original_visit_song = std::move(visit_song);
 		visit_song = [this](const auto &song){
@@ -40,6 +65,40 @@ DatabaseVisitorHelper::DatabaseVisitorHelper(DatabaseSelection _selection,
 
 DatabaseVisitorHelper::~DatabaseVisitorHelper() noexcept = default;
 
+inline void
+DatabaseVisitorHelper::AddSorted(const LightSong &song)
+{
+	songs.emplace_back(song, selection.sort, counter++);
+}
+
+inline void
+DatabaseVisitorHelper::AddBounded(const LightSong &song)
+{
+	const std::size_t limit = selection.window.end;
+	if (limit == 0)
+		return;
+
+	const auto sort = selection.sort;
+	const auto descending = selection.descending;
+	const auto compare = MakeCompareSongSortItems(sort, descending);
+
+	if (songs.size() >= limit) {
+		/* the heap is full; the new song is only kept if it
+		   sorts before the last one (on equal values, it
+		   doesn't, because it was visited later) */
+		if (!CompareSongSortKeys(sort, descending,
+					 SongSortKey{sort, song},
+					 songs.front().key))
+			return;
+
+		std::pop_heap(songs.begin(), songs.end(), compare);
+		songs.pop_back();
+	}
+
+	songs.emplace_back(song, sort, counter++);
+	std::push_heap(songs.begin(), songs.end(), compare);
+}
+
 void
 DatabaseVisitorHelper::Commit()
 {
@@ -53,28 +112,12 @@ DatabaseVisitorHelper::Commit()
 	const auto sort = selection.sort;
 	const auto descending = selection.descending;
 
-	if (sort == TagType(SORT_TAG_LAST_MODIFIED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetLastModified() > b.GetLastModified()
-						 : a.GetLastModified() < b.GetLastModified();
-				 });
-	else if (sort == TagType(SORT_TAG_ADDED))
-		std::stable_sort(songs.begin(), songs.end(),
-				 [descending](const DetachedSong &a, const DetachedSong &b){
-					 return descending
-						 ? a.GetAdded() > b.GetAdded()
-						 : a.GetAdded() < b.GetAdded();
-				 });
+	const auto compare = MakeCompareSongSortItems(sort, descending);
+
+	if (selection.window.IsOpenEnded())
+		std::sort(songs.begin(), songs.end(), compare);
 	else
-		std::stable_sort(songs.begin(), songs.end(),
-				 [sort, descending](const DetachedSong &a,
-						    const DetachedSong &b){
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
-				 });
+		std::sort_heap(songs.begin(), songs.end(), compare);
 
 	/* apply the "window" */
 	if (selection.window.end < songs.size())
@@ -88,6 +131,6 @@ DatabaseVisitorHelper::Commit()
 		    std::next(songs.begin(), selection.window.start));
 
 	/* now pass all songs to the original visitor callback */
-	for (const auto &song : songs)
-		original_visit_song((LightSong)song);
+	for (const auto &i : songs)
+		original_visit_song((LightSong)i.song);
 }
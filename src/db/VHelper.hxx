@@ -23,17 +23,21 @@ class DetachedSong;
 class DatabaseVisitorHelper {
 	const DatabaseSelection selection;
 
+	struct SortItem;
+
 	/**
 	 * If the plugin can't sort, then this container will collect
 	 * all songs, sort them and report them to the visitor in
-	 * Commit().
+	 * Commit().  If the "window" has an end, then only the first
+	 * "window.end" songs are kept, organized as a max-heap.
 	 */
-	std::vector<DetachedSong> songs;
+	std::vector<SortItem> songs;
 
 	VisitSong original_visit_song;
 
 	/**
-	 * Used to emulate the "window".
+	 * Used to emulate the "window"; while sorting, it numbers the
+	 * songs to keep the sort stable.
 	 */
 	unsigned counter = 0;
 
@@ -49,6 +53,10 @@ public:
 	~DatabaseVisitorHelper() noexcept;
 
 	void Commit();
+
+private:
+	void AddSorted(const LightSong &song);
+	void AddBounded(const LightSong &song);
 };
 
 #endif
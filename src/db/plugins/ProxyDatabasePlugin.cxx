@@ -8,8 +8,13 @@
 #include "db/Selection.hxx"
 #include "db/VHelper.hxx"
 #include "db/DatabaseError.hxx"
+#include "db/DatabaseLock.hxx"
 #include "db/PlaylistInfo.hxx"
 #include "db/LightDirectory.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "db/Stats.hxx"
 #include "song/Filter.hxx"
@@ -22,6 +27,7 @@
 #include "tag/ParseName.hxx"
 #include "tag/WithTagBuffer.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "util/IterableSplitString.hxx"
 #include "util/RecursiveMap.hxx"
 #include "util/ScopeExit.hxx"
 #include "protocol/Ack.hxx"
@@ -32,10 +38,13 @@
 #include <mpd/client.h>
 #include <mpd/async.h>
 
+#include <algorithm>
 #include <cassert>
 #include <list>
+#include <span>
 #include <string>
 #include <utility>
+#include <vector>
 
 class LibmpdclientError final : public std::runtime_error {
 	enum mpd_error code;
@@ -97,6 +106,41 @@ class ProxyDatabase final : public Database {
 	 */
 	bool is_idle;
 
+	/**
+	 * A local copy of the remote database which answers all
+	 * queries (only if "cache_file" is configured).  It is
+	 * synchronized incrementally on each "database" idle event.
+	 */
+	std::unique_ptr<SimpleDatabase> replica;
+
+	/**
+	 * Can queries be answered by the #replica?  This is set after
+	 * it has been loaded from disk or synchronized.
+	 */
+	bool replica_ready = false;
+
+	/**
+	 * The newest song modification time in the #replica; the
+	 * next synchronization asks the other MPD only for songs
+	 * modified since then.
+	 */
+	std::chrono::system_clock::time_point replica_mtime;
+
+	/**
+	 * The song returned by GetSong() from the #replica.
+	 */
+	mutable const LightSong *replica_song = nullptr;
+
+	/**
+	 * While the #replica is used, queries do not connect to the
+	 * other MPD; instead, reconnecting is attempted at most once
+	 * per #REPLICA_RECONNECT_INTERVAL.
+	 */
+	std::chrono::steady_clock::time_point next_reconnect;
+
+	static constexpr std::chrono::steady_clock::duration REPLICA_RECONNECT_INTERVAL =
+		std::chrono::seconds(30);
+
 public:
 	ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 		      const ConfigBlock &block);
@@ -134,6 +178,46 @@ private:
 
 	void Disconnect() noexcept;
 
+	bool UseReplica() const noexcept {
+		return replica_ready;
+	}
+
+	/**
+	 * Reconnect to the other MPD (rate-limited) if the
+	 * connection was lost while queries are answered by the
+	 * #replica.  After reconnecting, the next OnIdle() call
+	 * synchronizes the #replica.
+	 */
+	void CheckReplicaConnection() noexcept;
+
+	/**
+	 * Prepare for a query: reconnect to the other MPD if
+	 * necessary.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if the query shall be answered by the
+	 * #replica
+	 */
+	bool PrepareQuery() const;
+
+	/**
+	 * Download new and modified songs to the #replica and save
+	 * it.  If the number of songs does not match afterwards, it
+	 * is downloaded completely.
+	 *
+	 * Throws on error.
+	 */
+	void SyncReplica();
+
+	/**
+	 * Receive songs modified since the given time into the
+	 * #replica.
+	 *
+	 * Throws on error.
+	 */
+	void ReceiveReplicaSongs(std::chrono::system_clock::time_point since);
+
 	void OnSocketReady(unsigned flags) noexcept;
 	void OnIdle() noexcept;
 };
@@ -396,6 +480,10 @@ ProxyDatabase::ProxyDatabase(EventLoop &_loop, DatabaseListener &_listener,
 	 port(block.GetBlockValue("port", 0U)),
 	 keepalive(block.GetBlockValue("keepalive", false))
 {
+	if (auto cache_file = block.GetPath("cache_file"); !cache_file.IsNull())
+		replica = std::make_unique<SimpleDatabase>(std::move(cache_file),
+							   true, false,
+							   true, true);
 }
 
 DatabasePtr
@@ -411,6 +499,24 @@ ProxyDatabase::Open()
 {
 	update_stamp = std::chrono::system_clock::time_point::min();
 
+	if (replica != nullptr) {
+		replica->Open();
+
+		if (replica->FileExists()) {
+			/* answer queries from the file until the
+			   first synchronization is done */
+			replica_ready = true;
+			update_stamp = replica->GetUpdateStamp();
+
+			replica_mtime = std::chrono::system_clock::time_point::min();
+			replica->Visit(DatabaseSelection{"", true}, {},
+				       [this](const LightSong &song){
+					       replica_mtime = std::max(replica_mtime,
+									song.mtime);
+				       }, {});
+		}
+	}
+
 	try {
 		Connect();
 	} catch (...) {
@@ -425,6 +531,11 @@ ProxyDatabase::Close() noexcept
 {
 	if (connection != nullptr)
 		Disconnect();
+
+	if (replica != nullptr) {
+		replica->Close();
+		replica_ready = false;
+	}
 }
 
 void
@@ -554,8 +665,18 @@ ProxyDatabase::OnIdle() noexcept
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		if (replica != nullptr) {
+			try {
+				SyncReplica();
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to synchronize the database replica");
+			}
+		}
+
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -582,11 +703,197 @@ ProxyDatabase::OnIdle() noexcept
 	socket_event.ScheduleRead();
 }
 
+void
+ProxyDatabase::CheckReplicaConnection() noexcept
+{
+	assert(replica != nullptr);
+
+	if (connection != nullptr)
+		return;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (now < next_reconnect)
+		return;
+
+	next_reconnect = now + REPLICA_RECONNECT_INTERVAL;
+
+	try {
+		Connect();
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+bool
+ProxyDatabase::PrepareQuery() const
+{
+	// TODO: eliminate the const_cast
+	auto &db = const_cast<ProxyDatabase &>(*this);
+
+	if (UseReplica()) {
+		db.CheckReplicaConnection();
+		return true;
+	}
+
+	db.EnsureConnected();
+	return false;
+}
+
+/**
+ * Create the directory with the given path (and all of its parents)
+ * in the replica.  Caller must lock the #db_mutex.
+ */
+static Directory &
+MakeReplicaDirectory(Directory &root, std::string_view path) noexcept
+{
+	Directory *directory = &root;
+	for (const std::string_view name : IterableSplitString(path, '/'))
+		if (!name.empty())
+			directory = directory->MakeChild(name);
+
+	return *directory;
+}
+
+/**
+ * Add a song to the replica, replacing an existing one with the same
+ * URI.  Caller must lock the #db_mutex.
+ */
+static void
+AddReplicaSong(Directory &root, const LightSong &song) noexcept
+{
+	const std::string_view uri = song.uri;
+	const auto slash = uri.rfind('/');
+	const std::string_view name = slash == uri.npos
+		? uri
+		: uri.substr(slash + 1);
+
+	Directory &directory = slash == uri.npos
+		? root
+		: MakeReplicaDirectory(root, uri.substr(0, slash));
+
+	if (Song *old = directory.FindSong(name))
+		directory.RemoveSong(old);
+
+	DetachedSong detached(song);
+	detached.SetURI(name);
+	directory.AddSong(std::make_unique<Song>(std::move(detached),
+						 directory));
+}
+
+/**
+ * Remove everything from the replica.  Caller must lock the
+ * #db_mutex.
+ */
+static void
+ClearReplica(Directory &root) noexcept
+{
+	root.ForEachChildSafe([](Directory &child){
+		child.Delete();
+	});
+
+	root.ForEachSongSafe([&root](Song &song){
+		root.RemoveSong(&song);
+	});
+
+	root.playlists.clear();
+	root.MarkDirty();
+}
+
+void
+ProxyDatabase::ReceiveReplicaSongs(std::chrono::system_clock::time_point since)
+try {
+	assert(replica != nullptr);
+	assert(connection != nullptr);
+
+	Directory &root = replica->GetRoot();
+
+	const time_t since_t = since > std::chrono::system_clock::time_point{}
+		? std::chrono::system_clock::to_time_t(since)
+		: 0;
+
+	/* request only this number of songs at a time to avoid
+	   blowing the server's max_output_buffer_size limit */
+	constexpr unsigned LIMIT = 4096;
+
+	for (unsigned start = 0;; start += LIMIT) {
+		if (!mpd_search_db_songs(connection, true) ||
+		    !mpd_search_add_modified_since_constraint(connection,
+							      MPD_OPERATOR_DEFAULT,
+							      since_t) ||
+		    !mpd_search_add_window(connection, start, start + LIMIT) ||
+		    !mpd_search_commit(connection))
+			ThrowError(connection);
+
+		unsigned n = 0;
+		while (auto *song = mpd_recv_song(connection)) {
+			++n;
+
+			const AllocatedProxySong song2(song);
+			replica_mtime = std::max(replica_mtime, song2.mtime);
+
+			const ScopeDatabaseLock protect;
+			AddReplicaSong(root, song2);
+		}
+
+		if (!mpd_response_finish(connection))
+			ThrowError(connection);
+
+		if (n < LIMIT)
+			/* no more data */
+			break;
+	}
+} catch (...) {
+	if (connection != nullptr)
+		mpd_search_cancel(connection);
+
+	throw;
+}
+
+void
+ProxyDatabase::SyncReplica()
+{
+	assert(replica != nullptr);
+	assert(connection != nullptr);
+	assert(!is_idle);
+
+	if (!replica_ready)
+		replica_mtime = std::chrono::system_clock::time_point::min();
+
+	ReceiveReplicaSongs(replica_mtime);
+
+	struct mpd_stats *stats = mpd_run_stats(connection);
+	if (stats == nullptr)
+		ThrowError(connection);
+
+	AtScopeExit(stats) { mpd_stats_free(stats); };
+
+	update_stamp = std::chrono::system_clock::from_time_t(mpd_stats_get_db_update_time(stats));
+
+	const DatabaseSelection all{"", true};
+	if (replica->GetStats(all).song_count != mpd_stats_get_number_of_songs(stats)) {
+		/* songs have been deleted (or added with an old
+		   modification time) - start over */
+		{
+			const ScopeDatabaseLock protect;
+			ClearReplica(replica->GetRoot());
+		}
+
+		replica_mtime = std::chrono::system_clock::time_point::min();
+		ReceiveReplicaSongs(replica_mtime);
+	}
+
+	replica->RefreshTagIndex();
+	replica->Save();
+	replica_ready = true;
+}
+
 const LightSong *
 ProxyDatabase::GetSong(std::string_view uri) const
 {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	if (PrepareQuery()) {
+		replica_song = replica->GetSong(uri);
+		return replica_song;
+	}
 
 	if (!mpd_send_list_meta(connection, std::string(uri).c_str()))
 		ThrowError(connection);
@@ -610,24 +917,24 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const noexcept
 {
 	assert(_song != nullptr);
 
+	if (_song == replica_song) {
+		replica_song = nullptr;
+		replica->ReturnSong(_song);
+		return;
+	}
+
 	auto *song = (AllocatedProxySong *)
 		const_cast<LightSong *>(_song);
 	delete song;
 }
 
 static void
-Visit(struct mpd_connection *connection, const char *uri,
-      bool recursive, const SongFilter *filter,
-      const VisitDirectory& visit_directory, const VisitSong& visit_song,
-      const VisitPlaylist& visit_playlist);
-
-static void
-Visit(struct mpd_connection *connection,
-      bool recursive, const SongFilter *filter,
-      const struct mpd_directory *directory,
-      const VisitDirectory& visit_directory, const VisitSong& visit_song,
-      const VisitPlaylist& visit_playlist)
+Visit(const struct mpd_directory *directory,
+      const VisitDirectory& visit_directory)
 {
+	if (!visit_directory)
+		return;
+
 	const char *path = mpd_directory_get_path(directory);
 
 	std::chrono::system_clock::time_point mtime =
@@ -636,12 +943,7 @@ Visit(struct mpd_connection *connection,
 	if (_mtime > 0)
 		mtime = std::chrono::system_clock::from_time_t(_mtime);
 
-	if (visit_directory)
-		visit_directory(LightDirectory(path, mtime));
-
-	if (recursive)
-		Visit(connection, path, recursive, filter,
-		      visit_directory, visit_song, visit_playlist);
+	visit_directory(LightDirectory(path, mtime));
 }
 
 [[gnu::pure]]
@@ -707,29 +1009,95 @@ public:
 	}
 };
 
-static std::list<ProxyEntity>
-ReceiveEntities(struct mpd_connection *connection) noexcept
+using ProxyEntityList = std::list<ProxyEntity>;
+
+/**
+ * Send "lsinfo" for all given directories in one command list and
+ * append their responses to #result.  Pipelining these requests
+ * saves one round trip per directory.
+ *
+ * Throws on error.
+ */
+static void
+ListDirectories(struct mpd_connection *connection,
+		std::span<const char *const> paths,
+		std::vector<ProxyEntityList> &result)
+{
+	assert(!paths.empty());
+
+	if (!mpd_command_list_begin(connection, true))
+		ThrowError(connection);
+
+	for (const char *path : paths)
+		if (!mpd_send_list_meta(connection, path))
+			ThrowError(connection);
+
+	if (!mpd_command_list_end(connection))
+		ThrowError(connection);
+
+	for (std::size_t i = 0; i < paths.size(); ++i) {
+		auto &entities = result.emplace_back();
+		while (auto *entity = mpd_recv_entity(connection))
+			entities.emplace_back(entity);
+
+		/* advance to the response of the next command
+		   (fails if this one has failed) */
+		if (i + 1 < paths.size() && !mpd_response_next(connection))
+			break;
+	}
+
+	if (!mpd_response_finish(connection))
+		ThrowError(connection);
+}
+
+/**
+ * Receive the listings of all sub directories of the given
+ * entities, in the order of the entities.
+ *
+ * Throws on error.
+ */
+static std::vector<ProxyEntityList>
+ListChildren(struct mpd_connection *connection,
+	     const ProxyEntityList &entities)
 {
-	std::list<ProxyEntity> entities;
-	struct mpd_entity *entity;
-	while ((entity = mpd_recv_entity(connection)) != nullptr)
-		entities.emplace_back(entity);
+	/* limit the size of one command list to keep the other
+	   MPD's output buffer small */
+	constexpr std::size_t MAX_BATCH = 64;
+
+	std::vector<ProxyEntityList> result;
+	std::vector<const char *> paths;
+
+	for (const auto &entity : entities) {
+		if (mpd_entity_get_type(entity) != MPD_ENTITY_TYPE_DIRECTORY)
+			continue;
+
+		paths.push_back(mpd_directory_get_path(mpd_entity_get_directory(entity)));
+		if (paths.size() == MAX_BATCH) {
+			ListDirectories(connection, paths, result);
+			paths.clear();
+		}
+	}
 
-	mpd_response_finish(connection);
-	return entities;
+	if (!paths.empty())
+		ListDirectories(connection, paths, result);
+
+	return result;
 }
 
 static void
-Visit(struct mpd_connection *connection, const char *uri,
+Visit(struct mpd_connection *connection,
+      const ProxyEntityList &entities,
       bool recursive, const SongFilter *filter,
       const VisitDirectory& visit_directory, const VisitSong& visit_song,
       const VisitPlaylist& visit_playlist)
 {
-	if (!mpd_send_list_meta(connection, uri))
-		ThrowError(connection);
-
-	std::list<ProxyEntity> entities(ReceiveEntities(connection));
-	CheckError(connection);
+	/* fetch the listings of all sub directories at once; this
+	   needs one round trip per level instead of one per
+	   directory */
+	const auto children = recursive
+		? ListChildren(connection, entities)
+		: std::vector<ProxyEntityList>{};
+	auto child = children.begin();
 
 	for (const auto &entity : entities) {
 		switch (mpd_entity_get_type(entity)) {
@@ -737,9 +1105,16 @@ Visit(struct mpd_connection *connection, const char *uri,
 			break;
 
 		case MPD_ENTITY_TYPE_DIRECTORY:
-			Visit(connection, recursive, filter,
-			      mpd_entity_get_directory(entity),
-			      visit_directory, visit_song, visit_playlist);
+			Visit(mpd_entity_get_directory(entity),
+			      visit_directory);
+
+			if (recursive) {
+				assert(child != children.end());
+				Visit(connection, *child++, recursive, filter,
+				      visit_directory, visit_song,
+				      visit_playlist);
+			}
+
 			break;
 
 		case MPD_ENTITY_TYPE_SONG:
@@ -754,6 +1129,21 @@ Visit(struct mpd_connection *connection, const char *uri,
 	}
 }
 
+static void
+Visit(struct mpd_connection *connection, const char *uri,
+      bool recursive, const SongFilter *filter,
+      const VisitDirectory& visit_directory, const VisitSong& visit_song,
+      const VisitPlaylist& visit_playlist)
+{
+	const char *const paths[] = { uri };
+	std::vector<ProxyEntityList> entities;
+	ListDirectories(connection, paths, entities);
+	assert(entities.size() == 1);
+
+	Visit(connection, entities.front(), recursive, filter,
+	      visit_directory, visit_song, visit_playlist);
+}
+
 static void
 SearchSongs(struct mpd_connection *connection,
 	    const DatabaseSelection &selection,
@@ -858,8 +1248,11 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitSong visit_song,
 		     VisitPlaylist visit_playlist) const
 {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	if (PrepareQuery()) {
+		replica->Visit(selection, visit_directory, visit_song,
+			       visit_playlist);
+		return;
+	}
 
 	DatabaseVisitorHelper helper(CheckSelection(selection),
 				     visit_song);
@@ -885,8 +1278,8 @@ RecursiveMap<std::string>
 ProxyDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				 std::span<const TagType> tag_types) const
 try {
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
+	if (PrepareQuery())
+		return replica->CollectUniqueTags(selection, tag_types);
 
 	enum mpd_tag_type tag_type2 = Convert(tag_types.back());
 	if (tag_type2 == MPD_TAG_COUNT)
@@ -945,12 +1338,12 @@ try {
 DatabaseStats
 ProxyDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (PrepareQuery())
+		return replica->GetStats(selection);
+
 	// TODO: match
 	(void)selection;
 
-	// TODO: eliminate the const_cast
-	const_cast<ProxyDatabase *>(this)->EnsureConnected();
-
 	struct mpd_stats *stats2 =
 		mpd_run_stats(connection);
 	if (stats2 == nullptr)
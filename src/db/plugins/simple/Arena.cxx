@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Arena.hxx"
+
+#include <algorithm>
+#include <new>
+
+thread_local DatabaseArena *DatabaseArena::current = nullptr;
+
+enum class ArenaHeader : unsigned char {
+	HEAP,
+	ARENA,
+};
+
+inline void *
+DatabaseArena::Allocate(std::size_t size)
+{
+	size = (size + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1);
+
+	if (std::size_t(end - position) < size) {
+		const std::size_t chunk_size = std::max(size, CHUNK_SIZE);
+		auto &chunk = chunks.emplace_front(new std::byte[chunk_size]);
+		position = chunk.get();
+		end = position + chunk_size;
+	}
+
+	return std::exchange(position, position + size);
+}
+
+void *
+DatabaseArena::AllocateObject(std::size_t size)
+{
+	std::byte *p;
+	ArenaHeader header;
+
+	if (current != nullptr) {
+		p = static_cast<std::byte *>(current->Allocate(HEADER_SIZE + size));
+		header = ArenaHeader::ARENA;
+	} else {
+		p = static_cast<std::byte *>(::operator new(HEADER_SIZE + size));
+		header = ArenaHeader::HEAP;
+	}
+
+	new(p) ArenaHeader{header};
+	return p + HEADER_SIZE;
+}
+
+void
+DatabaseArena::FreeObject(void *_p) noexcept
+{
+	if (_p == nullptr)
+		return;
+
+	std::byte *p = static_cast<std::byte *>(_p) - HEADER_SIZE;
+	if (*reinterpret_cast<const ArenaHeader *>(p) == ArenaHeader::HEAP)
+		::operator delete(p);
+
+	/* memory from an arena is freed by DatabaseArena::Reset() */
+}
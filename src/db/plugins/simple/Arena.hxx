@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <forward_list>
+#include <memory>
+#include <utility>
+
+/**
+ * A bump allocator for the #Song and #Directory objects loaded from
+ * the database file.  They are carved out of big chunks instead of
+ * getting one heap allocation each, which makes loading a large
+ * database faster and leaves a less fragmented heap.
+ *
+ * Deleting such an object only runs its destructor; the memory is
+ * returned by Reset(), after the whole tree has been freed.  Objects
+ * created later (e.g. by the database update) are allocated on the
+ * heap as usual, so only the memory of deleted objects which have
+ * been loaded from disk is kept.
+ *
+ * This class is not thread-safe; only the thread which has
+ * activated the arena with a #Scope allocates from it.
+ */
+class DatabaseArena {
+	static constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+
+	/**
+	 * Each object is preceded by a header which specifies whether
+	 * it was allocated from an arena.  Its size keeps the object
+	 * suitably aligned.
+	 */
+	static constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+	std::forward_list<std::unique_ptr<std::byte[]>> chunks;
+
+	std::byte *position = nullptr, *end = nullptr;
+
+	/**
+	 * The arena which is used by AllocateObject() in this thread.
+	 */
+	static thread_local DatabaseArena *current;
+
+public:
+	DatabaseArena() noexcept = default;
+
+	DatabaseArena(const DatabaseArena &) = delete;
+	DatabaseArena &operator=(const DatabaseArena &) = delete;
+
+	/**
+	 * Free all chunks.  All objects allocated from this arena
+	 * must have been deleted before.
+	 */
+	void Reset() noexcept {
+		chunks.clear();
+		position = end = nullptr;
+	}
+
+	/**
+	 * While an instance of this class exists, #DatabaseArenaObject
+	 * instances created in the current thread are allocated from
+	 * the given arena.
+	 */
+	class Scope {
+		DatabaseArena *const previous;
+
+	public:
+		explicit Scope(DatabaseArena &arena) noexcept
+			:previous(std::exchange(current, &arena)) {}
+
+		~Scope() noexcept {
+			current = previous;
+		}
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+	};
+
+	static void *AllocateObject(std::size_t size);
+	static void FreeObject(void *p) noexcept;
+
+private:
+	void *Allocate(std::size_t size);
+};
+
+/**
+ * A base class for objects which may be allocated from the current
+ * #DatabaseArena.
+ */
+struct DatabaseArenaObject {
+	static void *operator new(std::size_t size) {
+		return DatabaseArena::AllocateObject(size);
+	}
+
+	static void operator delete(void *p) noexcept {
+		DatabaseArena::FreeObject(p);
+	}
+};
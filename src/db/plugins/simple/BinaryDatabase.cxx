@@ -0,0 +1,574 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BinaryDatabase.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/PlaylistVector.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/FileReader.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Settings.hxx"
+#include "tag/Tag.hxx"
+#include "fs/Charset.hxx"
+#include "fs/Path.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "system/Error.hxx"
+#include "time/ChronoUtil.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/SpanCast.hxx"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+/**
+ * A reference to a string in the string table.  The string is not
+ * null-terminated.
+ */
+struct StringRef {
+	uint32_t offset, length;
+};
+
+/**
+ * The beginning of the file.  It is followed by the arrays of
+ * #DirectoryRecord, #SongRecord, #PlaylistRecord and #TagItemRecord
+ * and finally the string table.
+ *
+ * All integers are in host byte order; a file written by a host with
+ * different byte order is rejected (and rebuilt by the next update).
+ */
+struct BinaryHeader {
+	static constexpr std::array<char, 8> MAGIC{'M', 'P', 'D', 'D', 'B', 'B', 'I', 'N'};
+	static constexpr uint32_t FORMAT = 5;
+	static constexpr uint32_t ENDIAN_CHECK = 0x01020304;
+
+	std::array<char, 8> magic;
+
+	uint32_t format;
+
+	uint32_t byte_order;
+
+	/**
+	 * A bit mask of the tags which were enabled when this file
+	 * was written.
+	 */
+	uint64_t tags;
+
+	StringRef fs_charset;
+
+	uint32_t n_directories, n_songs, n_playlists, n_tag_items;
+
+	uint64_t string_table_size;
+};
+
+/**
+ * One directory.  The root directory is the first one; all others
+ * follow their parent in depth-first order.  Songs and playlists are
+ * assigned to directories in the same order as the directories.
+ */
+struct DirectoryRecord {
+	/**
+	 * The value of #cover if Directory::cover is unknown.
+	 */
+	static constexpr StringRef UNKNOWN_COVER{~uint32_t{}, 0};
+
+	StringRef name;
+
+	/**
+	 * The name of the album art file (empty if there is none)
+	 * or #UNKNOWN_COVER.
+	 */
+	StringRef cover;
+
+	/**
+	 * Seconds since the epoch; negative if unknown.
+	 */
+	int64_t mtime;
+
+	uint32_t parent;
+
+	/**
+	 * One of the special values such as #DEVICE_PLAYLIST or 0.
+	 */
+	uint32_t device;
+
+	uint32_t n_songs, n_playlists;
+};
+
+struct SongRecord {
+	static constexpr uint8_t IN_PLAYLIST = 0x1;
+	static constexpr uint8_t HAS_PLAYLIST = 0x2;
+
+	StringRef filename, target;
+
+	int64_t mtime, added;
+
+	uint32_t start_ms, end_ms;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t sample_rate;
+	uint8_t sample_format, channels;
+
+	uint8_t flags;
+
+	uint8_t reserved;
+
+	uint32_t n_tag_items;
+
+	/**
+	 * See Song::file_id.
+	 */
+	uint64_t file_id;
+};
+
+struct PlaylistRecord {
+	StringRef name;
+
+	int64_t mtime;
+};
+
+struct TagItemRecord {
+	uint32_t type;
+
+	StringRef value;
+};
+
+/* all records are naturally aligned when loaded from a mmap()
+   (page aligned) or from a heap allocation */
+static_assert(sizeof(BinaryHeader) % 8 == 0);
+static_assert(sizeof(DirectoryRecord) % 8 == 0);
+static_assert(sizeof(SongRecord) % 8 == 0);
+static_assert(sizeof(PlaylistRecord) % 8 == 0);
+static_assert(TAG_NUM_OF_ITEM_TYPES <= 64);
+
+static uint64_t
+GetEnabledTagMask() noexcept
+{
+	uint64_t mask = 0;
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i))
+			mask |= uint64_t(1) << i;
+	return mask;
+}
+
+static constexpr int64_t
+ExportTime(std::chrono::system_clock::time_point t) noexcept
+{
+	return IsNegative(t)
+		? -1
+		: std::chrono::system_clock::to_time_t(t);
+}
+
+static constexpr std::chrono::system_clock::time_point
+ImportTime(int64_t t) noexcept
+{
+	return t < 0
+		? std::chrono::system_clock::time_point::min()
+		: std::chrono::system_clock::from_time_t(t);
+}
+
+class BinaryDatabaseWriter {
+	std::vector<DirectoryRecord> directories;
+	std::vector<SongRecord> songs;
+	std::vector<PlaylistRecord> playlists;
+	std::vector<TagItemRecord> tag_items;
+
+	/**
+	 * The string table.  Duplicate strings (e.g. artist and
+	 * album names) are stored only once.
+	 */
+	std::string strings;
+	std::unordered_map<std::string_view, StringRef> string_map;
+
+public:
+	void Add(const Directory &directory, uint32_t parent);
+
+	void Write(BufferedOutputStream &os) const;
+
+private:
+	StringRef AddString(std::string_view s);
+	void Add(const Song &song);
+};
+
+inline StringRef
+BinaryDatabaseWriter::AddString(std::string_view s)
+{
+	if (s.empty())
+		return {};
+
+	auto [i, inserted] = string_map.try_emplace(s);
+	if (inserted) {
+		if (strings.size() + s.size() > UINT32_MAX)
+			throw std::runtime_error("Database too large");
+
+		i->second = {uint32_t(strings.size()), uint32_t(s.size())};
+		strings.append(s);
+	}
+
+	return i->second;
+}
+
+inline void
+BinaryDatabaseWriter::Add(const Song &song)
+{
+	const Tag &tag = song.tag;
+
+	SongRecord r{};
+	r.filename = AddString(song.filename);
+	r.target = AddString(song.target);
+	r.mtime = ExportTime(song.mtime);
+	r.added = ExportTime(song.added);
+	r.file_id = song.file_id;
+	r.start_ms = song.start_time.ToMS();
+	r.end_ms = song.end_time.ToMS();
+	r.duration_ms = tag.duration.ToMS();
+	r.sample_rate = song.audio_format.sample_rate;
+	r.sample_format = uint8_t(song.audio_format.format);
+	r.channels = song.audio_format.channels;
+
+	if (song.in_playlist)
+		r.flags |= SongRecord::IN_PLAYLIST;
+	if (tag.has_playlist)
+		r.flags |= SongRecord::HAS_PLAYLIST;
+
+	for (const TagItem &item : tag) {
+		tag_items.push_back({uint32_t(item.type), AddString(item.value)});
+		++r.n_tag_items;
+	}
+
+	songs.push_back(r);
+}
+
+void
+BinaryDatabaseWriter::Add(const Directory &directory, uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	DirectoryRecord r{};
+	if (!directory.IsRoot())
+		r.name = AddString(directory.GetName());
+	r.mtime = ExportTime(directory.mtime);
+	r.parent = parent;
+	r.cover = directory.cover
+		? AddString(*directory.cover)
+		: DirectoryRecord::UNKNOWN_COVER;
+
+	switch (directory.device) {
+	case DEVICE_INARCHIVE:
+	case DEVICE_CONTAINER:
+	case DEVICE_PLAYLIST:
+		r.device = directory.device;
+		break;
+	}
+
+	for (const auto &song : directory.songs) {
+		Add(song);
+		++r.n_songs;
+	}
+
+	for (const PlaylistInfo &pi : directory.playlists) {
+		playlists.push_back({AddString(pi.name), ExportTime(pi.mtime)});
+		++r.n_playlists;
+	}
+
+	directories.push_back(r);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			Add(child, index);
+}
+
+template<typename T>
+static void
+WriteArray(BufferedOutputStream &os, const std::vector<T> &v)
+{
+	os.Write(std::as_bytes(std::span{v}));
+}
+
+inline void
+BinaryDatabaseWriter::Write(BufferedOutputStream &os) const
+{
+	BinaryHeader header{};
+	header.magic = BinaryHeader::MAGIC;
+	header.format = BinaryHeader::FORMAT;
+	header.byte_order = BinaryHeader::ENDIAN_CHECK;
+	header.tags = GetEnabledTagMask();
+	header.n_directories = directories.size();
+	header.n_songs = songs.size();
+	header.n_playlists = playlists.size();
+	header.n_tag_items = tag_items.size();
+
+	/* the charset goes to the end of the string table, it's not
+	   in the #string_map */
+	const std::string_view fs_charset = GetFSCharset();
+	header.fs_charset = {uint32_t(strings.size()), uint32_t(fs_charset.size())};
+	header.string_table_size = strings.size() + fs_charset.size();
+
+	os.WriteT(header);
+	WriteArray(os, directories);
+	WriteArray(os, songs);
+	WriteArray(os, playlists);
+	WriteArray(os, tag_items);
+	os.Write(strings);
+	os.Write(fs_charset);
+}
+
+/**
+ * Sequential access to the arrays of a mapped database file.
+ */
+class BinaryDatabaseReader {
+	std::span<const std::byte> data;
+
+public:
+	explicit BinaryDatabaseReader(std::span<const std::byte> _data) noexcept
+		:data(_data) {}
+
+	template<typename T>
+	std::span<const T> ReadArray(std::size_t n) {
+		if (n > data.size() / sizeof(T))
+			throw std::runtime_error("Database corrupted");
+
+		const std::span<const T> result{
+			reinterpret_cast<const T *>(data.data()),
+			n,
+		};
+		data = data.subspan(n * sizeof(T));
+		return result;
+	}
+
+	std::string_view ReadStringTable(uint64_t size) {
+		if (size != data.size())
+			throw std::runtime_error("Database corrupted");
+
+		return ToStringView(data);
+	}
+};
+
+class BinaryDatabaseLoader {
+	std::span<const DirectoryRecord> directories;
+	std::span<const SongRecord> songs;
+	std::span<const PlaylistRecord> playlists;
+	std::span<const TagItemRecord> tag_items;
+	std::string_view strings;
+
+public:
+	void Open(std::span<const std::byte> data,
+		  bool ignore_config_mismatches);
+
+	void Load(Directory &root) const;
+
+private:
+	std::string_view GetString(StringRef r) const {
+		if (r.offset > strings.size() ||
+		    r.length > strings.size() - r.offset)
+			throw std::runtime_error("Database corrupted");
+
+		return strings.substr(r.offset, r.length);
+	}
+
+	SongPtr LoadSong(const SongRecord &r,
+			 std::span<const TagItemRecord> items,
+			 Directory &parent) const;
+};
+
+inline void
+BinaryDatabaseLoader::Open(std::span<const std::byte> data,
+			   bool ignore_config_mismatches)
+{
+	BinaryDatabaseReader reader{data};
+
+	const auto &header = reader.ReadArray<BinaryHeader>(1).front();
+	if (header.format != BinaryHeader::FORMAT ||
+	    header.byte_order != BinaryHeader::ENDIAN_CHECK)
+		throw std::runtime_error("Database format mismatch, "
+					 "discarding database file");
+
+	directories = reader.ReadArray<DirectoryRecord>(header.n_directories);
+	songs = reader.ReadArray<SongRecord>(header.n_songs);
+	playlists = reader.ReadArray<PlaylistRecord>(header.n_playlists);
+	tag_items = reader.ReadArray<TagItemRecord>(header.n_tag_items);
+	strings = reader.ReadStringTable(header.string_table_size);
+
+	if (directories.empty())
+		throw std::runtime_error("Database corrupted");
+
+	if (ignore_config_mismatches)
+		return;
+
+	const std::string_view new_charset = GetString(header.fs_charset);
+	const std::string_view old_charset = GetFSCharset();
+	if (!old_charset.empty() && new_charset != old_charset)
+		throw FmtRuntimeError("Existing database has charset "
+				      "{:?} instead of {:?}; "
+				      "discarding database file",
+				      new_charset, old_charset);
+
+	const uint64_t enabled_tags = GetEnabledTagMask();
+	if ((enabled_tags & ~header.tags) != 0)
+		throw std::runtime_error("Tag list mismatch, "
+					 "discarding database file");
+}
+
+inline SongPtr
+BinaryDatabaseLoader::LoadSong(const SongRecord &r,
+			       std::span<const TagItemRecord> items,
+			       Directory &parent) const
+{
+	auto song = std::make_unique<Song>(GetString(r.filename), parent);
+	song->target = GetString(r.target);
+	song->mtime = ImportTime(r.mtime);
+	song->added = ImportTime(r.added);
+	song->file_id = r.file_id;
+	song->start_time = SongTime::FromMS(r.start_ms);
+	song->end_time = SongTime::FromMS(r.end_ms);
+	song->in_playlist = (r.flags & SongRecord::IN_PLAYLIST) != 0;
+
+	const AudioFormat audio_format{
+		r.sample_rate,
+		SampleFormat(r.sample_format),
+		r.channels,
+	};
+	if (audio_format.IsValid())
+		song->audio_format = audio_format;
+
+	TagBuilder tag;
+	tag.SetDuration(SignedSongTime::FromMS(r.duration_ms));
+	tag.SetHasPlaylist((r.flags & SongRecord::HAS_PLAYLIST) != 0);
+
+	for (const auto &i : items) {
+		if (i.type >= TAG_NUM_OF_ITEM_TYPES)
+			throw std::runtime_error("Database corrupted");
+
+		tag.AddItemUnchecked(TagType(i.type), GetString(i.value));
+	}
+
+	tag.Commit(song->tag);
+	return song;
+}
+
+inline void
+BinaryDatabaseLoader::Load(Directory &root) const
+{
+	/* maps record indexes to the loaded objects */
+	std::vector<Directory *> loaded;
+	loaded.reserve(directories.size());
+
+	auto next_song = songs.begin();
+	auto next_playlist = playlists.begin();
+	auto next_tag_item = tag_items.begin();
+
+	for (const auto &r : directories) {
+		Directory *directory;
+		if (loaded.empty()) {
+			directory = &root;
+		} else {
+			/* the writer has visited the parent first */
+			if (r.parent >= loaded.size())
+				throw std::runtime_error("Database corrupted");
+
+			directory = loaded[r.parent]->CreateChild(GetString(r.name));
+		}
+
+		directory->mtime = ImportTime(r.mtime);
+		directory->device = r.device;
+		if (r.cover.offset != DirectoryRecord::UNKNOWN_COVER.offset)
+			directory->cover = GetString(r.cover);
+		loaded.push_back(directory);
+
+		if (r.n_songs > std::size_t(songs.end() - next_song) ||
+		    r.n_playlists > std::size_t(playlists.end() - next_playlist))
+			throw std::runtime_error("Database corrupted");
+
+		for (const auto &s : std::span{next_song, r.n_songs}) {
+			if (s.n_tag_items > std::size_t(tag_items.end() - next_tag_item))
+				throw std::runtime_error("Database corrupted");
+
+			const std::span items{next_tag_item, s.n_tag_items};
+			next_tag_item += s.n_tag_items;
+
+			directory->AddSong(LoadSong(s, items, *directory));
+		}
+
+		next_song += r.n_songs;
+
+		for (const auto &p : std::span{next_playlist, r.n_playlists}) {
+			PlaylistInfo pi{std::string{GetString(p.name)}};
+			pi.mtime = ImportTime(p.mtime);
+			directory->playlists.push_back(std::move(pi));
+		}
+
+		next_playlist += r.n_playlists;
+	}
+}
+
+} // anonymous namespace
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root)
+{
+	BinaryDatabaseWriter writer;
+	writer.Add(root, 0);
+	writer.Write(os);
+}
+
+static void
+db_load_binary(std::span<const std::byte> data, Directory &root,
+	       bool ignore_config_mismatches)
+{
+	BinaryDatabaseLoader loader;
+	loader.Open(data, ignore_config_mismatches);
+
+	const ScopeDatabaseLock protect;
+	loader.Load(root);
+}
+
+bool
+db_load_binary(Path path, Directory &root, bool ignore_config_mismatches)
+{
+	FileReader file{path};
+
+	std::array<char, 8> magic;
+	if (file.Read(std::as_writable_bytes(std::span{magic})) != magic.size() ||
+	    magic != BinaryHeader::MAGIC)
+		return false;
+
+	const uint_least64_t size = file.GetSize();
+	if (size > SIZE_MAX)
+		throw std::runtime_error("Database too large");
+
+#ifdef _WIN32
+	AllocatedArray<std::byte> buffer{std::size_t(size)};
+	file.Rewind();
+	file.ReadFull(buffer);
+	db_load_binary(buffer, root, ignore_config_mismatches);
+#else
+	void *const p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			     file.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map database file");
+
+	AtScopeExit(p, size) { munmap(p, size); };
+
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	db_load_binary({static_cast<const std::byte *>(p), std::size_t(size)},
+		       root, ignore_config_mismatches);
+#endif
+
+	return true;
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+struct Directory;
+class BufferedOutputStream;
+class Path;
+
+/**
+ * Write the database in the binary format (#DB_FORMAT 3).  Unlike
+ * the text format, it can be loaded with one mmap() and no parsing;
+ * it is never compressed.
+ *
+ * Throws on error.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &root);
+
+/**
+ * Load a database file written by db_save_binary().
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param ignore_config_mismatches if true, then configuration
+ * mismatches (e.g. enabled tags or filesystem charset) are ignored
+ * @return false if this is not a binary database file (i.e. the
+ * caller shall try db_load_internal())
+ */
+bool
+db_load_binary(Path path, Directory &root,
+	       bool ignore_config_mismatches=false);
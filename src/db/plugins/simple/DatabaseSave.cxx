@@ -25,8 +25,9 @@
 #define DIRECTORY_MPD_VERSION "mpd_version: "
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
+#define DB_JOURNAL_HEADER "mpd_journal: 1"
 
-static constexpr unsigned DB_FORMAT = 2;
+static constexpr unsigned DB_FORMAT = 4;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -123,3 +124,28 @@ db_load_internal(LineReader &file, Directory &music_root,
 	const ScopeDatabaseLock protect;
 	directory_load(file, music_root);
 }
+
+void
+db_save_journal(BufferedOutputStream &os, const Directory &music_root,
+		bool new_file)
+{
+	if (new_file)
+		os.Write(DB_JOURNAL_HEADER "\n");
+
+	directory_save_journal(os, music_root);
+}
+
+void
+db_load_journal(LineReader &file, Directory &music_root)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr)
+		/* empty */
+		return;
+
+	if (strcmp(line, DB_JOURNAL_HEADER) != 0)
+		throw std::runtime_error("Database journal format mismatch");
+
+	const ScopeDatabaseLock protect;
+	directory_load_journal(file, music_root);
+}
@@ -21,4 +21,24 @@ void
 db_load_internal(LineReader &file, Directory &root,
 		 bool ignore_config_mismatches=false);
 
+/**
+ * Append the directories which were modified since the last save to
+ * the database journal.
+ *
+ * @param new_file true if this is the beginning of the journal file
+ * (i.e. the header needs to be written)
+ */
+void
+db_save_journal(BufferedOutputStream &os, const Directory &root,
+		bool new_file);
+
+/**
+ * Apply a database journal to a tree which was just loaded with
+ * db_load_internal().
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+db_load_journal(LineReader &file, Directory &root);
+
 #endif
@@ -6,6 +6,7 @@
 #include "SongSort.hxx"
 #include "Song.hxx"
 #include "Mount.hxx"
+#include "SimpleDatabasePlugin.hxx"
 #include "db/LightDirectory.hxx"
 #include "db/Uri.hxx"
 #include "db/DatabaseLock.hxx"
@@ -13,6 +14,7 @@
 #include "db/Selection.hxx"
 #include "song/Filter.hxx"
 #include "lib/icu/Collate.hxx"
+#include "thread/Mutex.hxx"
 #include "fs/Traits.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/SortList.hxx"
@@ -20,12 +22,55 @@
 #include "util/StringSplit.hxx"
 
 #include <cassert>
+#include <functional> // for std::hash
 
 #include <string.h>
 #include <stdlib.h>
 
 using std::string_view_literals::operator""sv;
 
+/**
+ * Create a hash index on a list as soon as a lookup had to scan at
+ * least this number of items.
+ */
+static constexpr std::size_t INDEX_THRESHOLD = 256;
+
+/**
+ * Protects creating #Directory::child_index and
+ * #Directory::song_index, which is done by readers holding the
+ * #db_mutex only in shared mode.  Once created, an index is modified
+ * only by writers, i.e. with the #db_mutex held exclusively.
+ */
+static Mutex index_mutex;
+
+struct GetDirectoryName {
+	std::string_view operator()(const Directory &directory) const noexcept {
+		return directory.GetName();
+	}
+};
+
+struct GetSongFilename {
+	std::string_view operator()(const Song &song) const noexcept {
+		return song.filename;
+	}
+};
+
+struct Directory::ChildIndex
+	: IntrusiveHashSet<Directory, 4093,
+			   IntrusiveHashSetOperators<Directory, GetDirectoryName,
+						     std::hash<std::string_view>,
+						     std::equal_to<std::string_view>>,
+			   IntrusiveHashSetMemberHookTraits<&Directory::index_hook>> {};
+
+struct Directory::SongIndex
+	: IntrusiveHashSet<Song, 4093,
+			   IntrusiveHashSetOperators<Song, GetSongFilename,
+						     std::hash<std::string_view>,
+						     std::equal_to<std::string_view>>,
+			   IntrusiveHashSetMemberHookTraits<&Song::index_hook>> {};
+
+std::atomic_uint_least64_t Directory::generation{0};
+
 Directory::Directory(std::string &&_path_utf8, Directory *_parent) noexcept
 	:parent(_parent),
 	 path(std::move(_path_utf8))
@@ -39,6 +84,7 @@ Directory::~Directory() noexcept
 		mounted_database.reset();
 	}
 
+	/* the items unlink themselves from the indexes */
 	songs.clear_and_dispose(DeleteDisposer());
 	children.clear_and_dispose(DeleteDisposer());
 }
@@ -46,9 +92,10 @@ Directory::~Directory() noexcept
 void
 Directory::Delete() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(parent != nullptr);
 
+	parent->MarkDirty();
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -72,7 +119,7 @@ Directory::GetName() const noexcept
 Directory *
 Directory::CreateChild(std::string_view name_utf8) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(!name_utf8.empty());
 
 	std::string path_utf8 = IsRoot()
@@ -81,6 +128,9 @@ Directory::CreateChild(std::string_view name_utf8) noexcept
 
 	auto *child = new Directory(std::move(path_utf8), this);
 	children.push_back(*child);
+	if (child_index)
+		child_index->insert(*child);
+	MarkDirty();
 	return child;
 }
 
@@ -89,11 +139,41 @@ Directory::FindChild(std::string_view name) const noexcept
 {
 	assert(holding_db_lock());
 
-	for (const auto &child : children)
-		if (child.GetName() == name)
-			return &child;
+	const ChildIndex *index;
+	{
+		const std::scoped_lock lock{index_mutex};
+		index = child_index.get();
+	}
 
-	return nullptr;
+	if (index != nullptr) {
+		auto i = index->find(name);
+		return i != index->end() ? &*i : nullptr;
+	}
+
+	std::size_t n = 0;
+	const Directory *result = nullptr;
+	for (const auto &child : children) {
+		if (child.GetName() == name) {
+			result = &child;
+			break;
+		}
+
+		++n;
+	}
+
+	if (n >= INDEX_THRESHOLD) {
+		/* this is a large directory: the next lookup will
+		   use an index (the index is an internal cache, so
+		   breaking "const" is fine) */
+		const std::scoped_lock lock{index_mutex};
+		if (!child_index) {
+			child_index = std::make_unique<ChildIndex>();
+			for (auto &child : const_cast<Directory *>(this)->children)
+				child_index->insert(child);
+		}
+	}
+
+	return result;
 }
 
 Song *
@@ -114,28 +194,63 @@ Directory::LookupTargetSong(std::string_view target) noexcept
 void
 Directory::ClearInPlaylist() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	for (auto &child : children)
 		child.ClearInPlaylist();
 
-	for (auto &song : songs)
-		song.in_playlist = false;
+	for (auto &song : songs) {
+		if (song.in_playlist) {
+			song.in_playlist = false;
+			MarkDirty();
+		}
+	}
 }
 
 void
-Directory::PruneEmpty() noexcept
+Directory::CollectMemoryStats(SimpleDatabaseMemoryStats &stats) const noexcept
 {
 	assert(holding_db_lock());
 
+	++stats.directories;
+	stats.bytes += sizeof(*this) + path.capacity();
+
+	for (const auto &playlist : playlists)
+		stats.bytes += sizeof(playlist) + playlist.name.capacity();
+
+	for (const auto &song : songs) {
+		++stats.songs;
+		stats.bytes += sizeof(song) + song.filename.capacity() +
+			song.target.capacity() + song.tag.GetItemsSize();
+	}
+
+	for (const auto &child : children)
+		child.CollectMemoryStats(stats);
+}
+
+void
+Directory::ClearDirty() noexcept
+{
+	dirty = false;
+
+	for (auto &child : children)
+		child.ClearDirty();
+}
+
+void
+Directory::PruneEmpty() noexcept
+{
+	assert(holding_db_write_lock());
+
 	for (auto child = children.begin(), end = children.end();
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty() && !child->IsMount())
+		if (child->IsEmpty() && !child->IsMount()) {
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+			MarkDirty();
+		} else
 			++child;
 	}
 }
@@ -172,21 +287,28 @@ Directory::LookupDirectory(std::string_view _uri) noexcept
 void
 Directory::AddSong(SongPtr song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
+	if (song_index)
+		song_index->insert(*song);
+
 	songs.push_back(*song.release());
+	MarkDirty();
 }
 
 SongPtr
 Directory::RemoveSong(Song *song) noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 	assert(song != nullptr);
 	assert(&song->parent == this);
 
 	songs.erase(songs.iterator_to(*song));
+	if (song->index_hook.is_linked())
+		song->index_hook.unlink();
+	MarkDirty();
 	return SongPtr(song);
 }
 
@@ -195,14 +317,41 @@ Directory::FindSong(std::string_view name_utf8) const noexcept
 {
 	assert(holding_db_lock());
 
+	const SongIndex *index;
+	{
+		const std::scoped_lock lock{index_mutex};
+		index = song_index.get();
+	}
+
+	if (index != nullptr) {
+		auto i = index->find(name_utf8);
+		return i != index->end() ? &*i : nullptr;
+	}
+
+	std::size_t n = 0;
+	const Song *result = nullptr;
 	for (auto &song : songs) {
 		assert(&song.parent == this);
 
-		if (song.filename == name_utf8)
-			return &song;
+		if (song.filename == name_utf8) {
+			result = &song;
+			break;
+		}
+
+		++n;
 	}
 
-	return nullptr;
+	if (n >= INDEX_THRESHOLD) {
+		/* see FindChild() */
+		const std::scoped_lock lock{index_mutex};
+		if (!song_index) {
+			song_index = std::make_unique<SongIndex>();
+			for (auto &song : const_cast<Directory *>(this)->songs)
+				song_index->insert(song);
+		}
+	}
+
+	return result;
 }
 
 [[gnu::pure]]
@@ -215,7 +364,7 @@ directory_cmp(const Directory &a, const Directory &b) noexcept
 void
 Directory::Sort() noexcept
 {
-	assert(holding_db_lock());
+	assert(holding_db_write_lock());
 
 	SortList(children, directory_cmp);
 	song_list_sort(songs);
@@ -236,7 +385,7 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
-		const ScopeDatabaseUnlock unlock;
+		const ScopeDatabaseReadUnlock unlock;
 		WalkMount(GetPath(), *mounted_database,
 			  "", DatabaseSelection{""sv, recursive, filter},
 			  visit_directory, visit_song,
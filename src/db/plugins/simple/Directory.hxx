@@ -5,12 +5,17 @@
 #define MPD_DIRECTORY_HXX
 
 #include "Ptr.hxx"
+#include "Arena.hxx"
 #include "Song.hxx" // TODO eliminate this include, forward-declare only
 #include "db/Visitor.hxx"
 #include "db/PlaylistVector.hxx"
 #include "db/Ptr.hxx"
+#include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <atomic>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -34,8 +39,9 @@ static constexpr unsigned DEVICE_CONTAINER = -2;
 static constexpr unsigned DEVICE_PLAYLIST = -3;
 
 class SongFilter;
+struct SimpleDatabaseMemoryStats;
 
-struct Directory : IntrusiveListHook<> {
+struct Directory : IntrusiveListHook<>, DatabaseArenaObject {
 	/* Note: the #IntrusiveListHook is protected with the global
 	   #db_mutex.  Read access in the update thread does not need
 	   protection. */
@@ -69,6 +75,17 @@ struct Directory : IntrusiveListHook<> {
 
 	const std::string path;
 
+	/**
+	 * The name of the album art file in this directory (one of
+	 * #cover_art_names) as seen by the last update, an empty
+	 * string if there is none, or std::nullopt if that is
+	 * unknown (e.g. database files from older MPD versions).
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 * Read access in the update thread does not need protection.
+	 */
+	std::optional<std::string> cover;
+
 	/**
 	 * If this is not nullptr, then this directory does not really
 	 * exist, but is a mount point for another #Database.
@@ -81,6 +98,45 @@ struct Directory : IntrusiveListHook<> {
 	 */
 	bool mark;
 
+	/**
+	 * Have the attributes, the songs, the playlists or the list
+	 * of children of this directory been modified since the
+	 * database was saved last time?  The database journal
+	 * records only these directories.
+	 */
+	bool dirty = true;
+
+	/**
+	 * Links this object into the parent's #child_index (if it has
+	 * one).
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> index_hook;
+
+	struct ChildIndex;
+	struct SongIndex;
+
+	/**
+	 * Hash indexes on #children and #songs by name.  They are
+	 * created by FindChild() and FindSong() as soon as they have
+	 * scanned a long list, and are maintained from then on;
+	 * small directories don't pay for them.
+	 *
+	 * Protected with the global #db_mutex; because readers
+	 * holding it in shared mode may create them, creating and
+	 * dereferencing the pointers is additionally protected by a
+	 * private mutex (see Directory.cxx).
+	 */
+	mutable std::unique_ptr<ChildIndex> child_index;
+	mutable std::unique_ptr<SongIndex> song_index;
+
+	/**
+	 * Incremented by MarkDirty(), i.e. by every modification of
+	 * any #Directory tree.  Caches derived from a tree (e.g.
+	 * #SongTagIndex) compare it to find out whether they are
+	 * stale.
+	 */
+	static std::atomic_uint_least64_t generation;
+
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent) noexcept;
 	~Directory() noexcept;
@@ -271,6 +327,25 @@ public:
 	 */
 	void ClearInPlaylist() noexcept;
 
+	/**
+	 * Recursively count the directories and songs and add up
+	 * their approximate memory usage (without the strings in the
+	 * tag pool and without mounted databases).
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void CollectMemoryStats(SimpleDatabaseMemoryStats &stats) const noexcept;
+
+	void MarkDirty() noexcept {
+		dirty = true;
+		generation.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Recursively clear the #dirty flag.
+	 */
+	void ClearDirty() noexcept;
+
 	/**
 	 * Caller must lock the #db_mutex.
 	 */
@@ -14,6 +14,8 @@
 #include "util/StringAPI.hxx"
 #include "util/StringCompare.hxx"
 #include "util/CNumberParser.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "util/StringSplit.hxx"
 
 #include <fmt/format.h>
 
@@ -25,8 +27,13 @@
 #define DIRECTORY_DIR "directory: "
 #define DIRECTORY_TYPE "type: "
 #define DIRECTORY_MTIME "mtime: "
+#define DIRECTORY_COVER "cover: "
+#define DIRECTORY_NO_COVER "no_cover"
 #define DIRECTORY_BEGIN "begin: "
 #define DIRECTORY_END "end: "
+#define DIRECTORY_JOURNAL_BEGIN "journal_begin: "
+#define DIRECTORY_JOURNAL_CHILD "child: "
+#define DIRECTORY_JOURNAL_END "journal_end"
 
 [[gnu::const]]
 static const char *
@@ -61,18 +68,32 @@ ParseTypeString(const char *type) noexcept
 		return 0;
 }
 
+static void
+directory_save_attributes(BufferedOutputStream &os,
+			  const Directory &directory)
+{
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Fmt(DIRECTORY_TYPE "{}\n", type);
+
+	if (!IsNegative(directory.mtime))
+		os.Fmt(DIRECTORY_MTIME "{}\n",
+		       std::chrono::system_clock::to_time_t(directory.mtime));
+
+	if (!directory.cover)
+		/* unknown */
+		;
+	else if (directory.cover->empty())
+		os.Write(DIRECTORY_NO_COVER "\n");
+	else
+		os.Fmt(DIRECTORY_COVER "{}\n", *directory.cover);
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
 	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Fmt(DIRECTORY_TYPE "{}\n", type);
-
-		if (!IsNegative(directory.mtime))
-			os.Fmt(DIRECTORY_MTIME "{}\n",
-			       std::chrono::system_clock::to_time_t(directory.mtime));
-
+		directory_save_attributes(os, directory);
 		os.Fmt(DIRECTORY_BEGIN "{}\n", directory.GetPath());
 	}
 
@@ -103,6 +124,10 @@ ParseLine(Directory &directory, const char *line)
 			directory.mtime = std::chrono::system_clock::from_time_t(mtime);
 	} else if ((p = StringAfterPrefix(line, DIRECTORY_TYPE))) {
 		directory.device = ParseTypeString(p);
+	} else if ((p = StringAfterPrefix(line, DIRECTORY_COVER))) {
+		directory.cover = p;
+	} else if (StringIsEqual(line, DIRECTORY_NO_COVER)) {
+		directory.cover.emplace();
 	} else
 		return false;
 
@@ -159,13 +184,16 @@ directory_load(LineReader &file, Directory &directory)
 
 			std::string target;
 			bool in_playlist = false;
+			uint64_t file_id = 0;
 			auto detached_song = song_load(file, name,
-						       &target, &in_playlist);
+						       &target, &in_playlist,
+						       &file_id);
 
 			auto song = std::make_unique<Song>(std::move(detached_song),
 							   directory);
 			song->target = std::move(target);
 			song->in_playlist = in_playlist;
+			song->file_id = file_id;
 
 			if (!songs.emplace(song->filename).second)
 				throw FmtRuntimeError("Duplicate song {:?}",
@@ -180,3 +208,142 @@ directory_load(LineReader &file, Directory &directory)
 		}
 	}
 }
+
+/**
+ * Write one journal record: a snapshot of the directory without its
+ * children's contents.
+ */
+static void
+directory_save_snapshot(BufferedOutputStream &os, const Directory &directory)
+{
+	os.Fmt(DIRECTORY_JOURNAL_BEGIN "{}\n", directory.GetPath());
+
+	if (!directory.IsRoot())
+		directory_save_attributes(os, directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			os.Fmt(DIRECTORY_JOURNAL_CHILD "{}\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Write(DIRECTORY_JOURNAL_END "\n");
+}
+
+void
+directory_save_journal(BufferedOutputStream &os, const Directory &directory)
+{
+	if (directory.dirty)
+		directory_save_snapshot(os, directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			directory_save_journal(os, child);
+}
+
+/**
+ * Look up a directory by its path, creating all missing path
+ * segments.
+ */
+static Directory &
+MakeDirectory(Directory &root, std::string_view path)
+{
+	const auto r = root.LookupDirectory(path);
+	Directory *directory = r.directory;
+	std::string_view rest = r.rest;
+
+	while (rest.data() != nullptr) {
+		const auto [name, next] = Split(rest, '/');
+		if (name.empty())
+			throw FmtRuntimeError("Malformed path: {:?}", path);
+
+		directory = directory->CreateChild(name);
+		rest = next;
+	}
+
+	return *directory;
+}
+
+/**
+ * Apply one journal record; it replaces the previous contents of
+ * the directory.
+ */
+static void
+directory_load_snapshot(LineReader &file, Directory &directory)
+{
+	std::set<std::string, std::less<>> children;
+
+	directory.songs.clear_and_dispose(DeleteDisposer());
+	directory.playlists.clear();
+
+	if (!directory.IsRoot()) {
+		directory.mtime = std::chrono::system_clock::time_point::min();
+		directory.device = 0;
+		directory.cover.reset();
+	}
+
+	while (true) {
+		const char *line = file.ReadLine();
+		if (line == nullptr)
+			throw std::runtime_error("Unexpected end of file");
+
+		if (StringIsEqual(line, DIRECTORY_JOURNAL_END))
+			break;
+
+		const char *p;
+		if ((p = StringAfterPrefix(line, DIRECTORY_JOURNAL_CHILD))) {
+			const std::string_view name = p;
+			if (name.empty() || name.find('/') != name.npos)
+				throw FmtRuntimeError("Malformed line: {:?}", line);
+
+			if (directory.FindChild(name) == nullptr)
+				directory.CreateChild(name);
+
+			children.emplace(name);
+		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			const char *name = p;
+
+			std::string target;
+			bool in_playlist = false;
+			uint64_t file_id = 0;
+			auto detached_song = song_load(file, name,
+						       &target, &in_playlist,
+						       &file_id);
+
+			auto song = std::make_unique<Song>(std::move(detached_song),
+							   directory);
+			song->target = std::move(target);
+			song->in_playlist = in_playlist;
+			song->file_id = file_id;
+			directory.AddSong(std::move(song));
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
+			const char *name = p;
+			playlist_metadata_load(file, directory.playlists, name);
+		} else if (directory.IsRoot() || !ParseLine(directory, line)) {
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+		}
+	}
+
+	/* delete the children which are not listed */
+	directory.ForEachChildSafe([&children](Directory &child){
+		if (!child.IsMount() && !children.contains(child.GetName()))
+			child.Delete();
+	});
+}
+
+void
+directory_load_journal(LineReader &file, Directory &root)
+{
+	const char *line;
+
+	while ((line = file.ReadLine()) != nullptr) {
+		const char *p = StringAfterPrefix(line, DIRECTORY_JOURNAL_BEGIN);
+		if (p == nullptr)
+			throw FmtRuntimeError("Malformed line: {:?}", line);
+
+		directory_load_snapshot(file, MakeDirectory(root, p));
+	}
+}
@@ -17,4 +17,19 @@ directory_save(BufferedOutputStream &os, const Directory &directory);
 void
 directory_load(LineReader &file, Directory &directory);
 
+/**
+ * Append a journal record for each directory which has the
+ * #Directory::dirty flag.
+ */
+void
+directory_save_journal(BufferedOutputStream &os, const Directory &directory);
+
+/**
+ * Apply all journal records to the given (already loaded) tree.
+ *
+ * Throws #std::runtime_error on error.
+ */
+void
+directory_load_journal(LineReader &file, Directory &root);
+
 #endif
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ParallelWalk.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+struct ParallelWalkPool::Task {
+	const Directory *directory;
+
+	/**
+	 * If false, then only the songs of #directory are filtered;
+	 * its children are separate tasks.
+	 */
+	bool recursive;
+
+	/**
+	 * Has the worker finished this task?  Protected by
+	 * ParallelWalkPool::mutex.
+	 */
+	bool done = false;
+
+	struct Match {
+		/**
+		 * The matching song or nullptr if this is a mount
+		 * point.
+		 */
+		const Song *song;
+
+		/**
+		 * The mount point which needs to be walked by the
+		 * calling thread (only if #song is nullptr).
+		 */
+		const Directory *mount;
+	};
+
+	/**
+	 * The result in walk order.
+	 */
+	std::vector<Match> matches;
+
+	Task(const Directory &_directory, bool _recursive) noexcept
+		:directory(&_directory), recursive(_recursive) {}
+
+	void Run(const SongFilter &filter, bool hide_playlist_targets) {
+		Collect(*directory, recursive, filter, hide_playlist_targets);
+	}
+
+private:
+	void Collect(const Directory &d, bool _recursive,
+		     const SongFilter &filter, bool hide_playlist_targets) {
+		if (d.IsMount()) {
+			matches.push_back({nullptr, &d});
+			return;
+		}
+
+		for (const auto &song : d.songs) {
+			if (hide_playlist_targets && song.in_playlist)
+				continue;
+
+			if (filter.Match(song.Export()))
+				matches.push_back({&song, nullptr});
+		}
+
+		if (_recursive)
+			for (const auto &child : d.children)
+				Collect(child, true, filter,
+					hide_playlist_targets);
+	}
+};
+
+std::vector<ParallelWalkPool::Task>
+ParallelWalkPool::Partition(const Directory &directory, std::size_t n)
+{
+	std::vector<Task> tasks;
+	tasks.emplace_back(directory, true);
+
+	while (tasks.size() < n) {
+		std::vector<Task> next;
+		bool modified = false;
+
+		for (const auto &task : tasks) {
+			if (!task.recursive || task.directory->children.empty()) {
+				next.emplace_back(*task.directory, task.recursive);
+				continue;
+			}
+
+			next.emplace_back(*task.directory, false);
+			for (const auto &child : task.directory->children)
+				next.emplace_back(child, true);
+
+			modified = true;
+		}
+
+		if (!modified)
+			break;
+
+		tasks = std::move(next);
+	}
+
+	return tasks;
+}
+
+ParallelWalkPool::ParallelWalkPool(unsigned _n_threads)
+	:n_threads(_n_threads)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_front(BIND_THIS_METHOD(RunWorker)).Start();
+	} catch (...) {
+		StopThreads();
+		throw;
+	}
+}
+
+ParallelWalkPool::~ParallelWalkPool() noexcept
+{
+	assert(tasks.empty());
+
+	StopThreads();
+}
+
+void
+ParallelWalkPool::StopThreads() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+	}
+
+	work_cond.notify_all();
+
+	for (auto &i : threads)
+		if (i.IsDefined())
+			i.Join();
+
+	threads.clear();
+}
+
+unsigned
+ParallelWalkPool::GetDefaultThreads(unsigned setting) noexcept
+{
+	if (setting > 0)
+		return setting;
+
+	return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+void
+ParallelWalkPool::WaitAll(std::unique_lock<Mutex> &lock) noexcept
+{
+	if (tasks.empty())
+		return;
+
+	done_cond.wait(lock, [this]{
+		return n_started == tasks.size() && n_running == 0;
+	});
+
+	tasks = {};
+}
+
+bool
+ParallelWalkPool::Walk(const Directory &directory, const SongFilter &_filter,
+		       bool _hide_playlist_targets,
+		       const VisitSong &visit_song)
+{
+	const std::unique_lock walk_lock{walk_mutex, std::try_to_lock};
+	if (!walk_lock.owns_lock())
+		return false;
+
+	/* more tasks than threads to compensate for subtrees of
+	   different sizes */
+	auto batch = Partition(directory, n_threads * 8);
+
+	std::unique_lock lock{mutex};
+
+	/* the #walk_mutex serializes all callers */
+	assert(tasks.empty());
+
+	tasks = batch;
+	n_started = 0;
+	filter = &_filter;
+	hide_playlist_targets = _hide_playlist_targets;
+	work_cond.notify_all();
+
+	try {
+		for (auto &task : batch) {
+			done_cond.wait(lock, [&task]{ return task.done; });
+
+			lock.unlock();
+
+			for (const auto &m : task.matches) {
+				if (m.song != nullptr) {
+					visit_song(m.song->Export());
+					continue;
+				}
+
+				/* Directory::Walk() unlocks the
+				   #db_mutex for mounted databases, and
+				   the workers must not read the tree
+				   meanwhile */
+				lock.lock();
+				WaitAll(lock);
+				lock.unlock();
+
+				m.mount->Walk(true, &_filter,
+					      _hide_playlist_targets,
+					      {}, visit_song, {});
+			}
+
+			task.matches.clear();
+			lock.lock();
+		}
+	} catch (...) {
+		if (!lock.owns_lock())
+			lock.lock();
+		WaitAll(lock);
+		throw;
+	}
+
+	WaitAll(lock);
+	return true;
+}
+
+void
+ParallelWalkPool::RunWorker() noexcept
+{
+	SetThreadName("db:walk");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		work_cond.wait(lock, [this]{
+			return quit || n_started < tasks.size();
+		});
+
+		if (quit)
+			break;
+
+		Task &task = tasks[n_started++];
+		++n_running;
+
+		const SongFilter &f = *filter;
+		const bool hide = hide_playlist_targets;
+
+		lock.unlock();
+
+		try {
+			task.Run(f, hide);
+		} catch (...) {
+			/* out of memory; report nothing */
+			task.matches.clear();
+		}
+
+		lock.lock();
+
+		task.done = true;
+		--n_running;
+		done_cond.notify_all();
+	}
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "db/Visitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <forward_list>
+#include <span>
+#include <vector>
+
+struct Directory;
+class SongFilter;
+
+/**
+ * A pool of worker threads which evaluate a #SongFilter on the songs
+ * of a #Directory tree.  The tree is split into subtrees, each one
+ * is filtered by a worker, and the matching songs are passed to the
+ * visitor in the calling thread, in the same order as
+ * Directory::Walk() would.
+ */
+class ParallelWalkPool final {
+	struct Task;
+
+	/**
+	 * Held by the thread which is currently in Walk().  The pool
+	 * serves only one caller at a time; others (which may hold
+	 * the #db_mutex concurrently in shared mode) fall back to
+	 * walking the tree by themselves.
+	 */
+	Mutex walk_mutex;
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up workers when a batch was submitted or when they
+	 * shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Wakes up the calling thread when a task is done.
+	 */
+	Cond done_cond;
+
+	/**
+	 * The tasks of the current Walk() call; empty if there is
+	 * none.
+	 */
+	std::span<Task> tasks;
+
+	/**
+	 * The number of #tasks which have been picked up by a
+	 * worker.
+	 */
+	std::size_t n_started;
+
+	/**
+	 * The number of #tasks which are being run by a worker.
+	 */
+	unsigned n_running = 0;
+
+	const SongFilter *filter;
+	bool hide_playlist_targets;
+
+	bool quit = false;
+
+	const unsigned n_threads;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	explicit ParallelWalkPool(unsigned n_threads);
+
+	~ParallelWalkPool() noexcept;
+
+	ParallelWalkPool(const ParallelWalkPool &) = delete;
+	ParallelWalkPool &operator=(const ParallelWalkPool &) = delete;
+
+	/**
+	 * Determine the number of worker threads from the
+	 * "search_threads" setting; the value 0 means automatic.
+	 */
+	[[gnu::const]]
+	static unsigned GetDefaultThreads(unsigned setting) noexcept;
+
+	/**
+	 * Like Directory::Walk() with "recursive" and a filter, but
+	 * without directory and playlist visitors.
+	 *
+	 * Caller must lock the #db_mutex; the worker threads read
+	 * the tree without locking, relying on the caller's lock.
+	 * Mount points are visited by the calling thread after all
+	 * workers are finished, because this unlocks the #db_mutex
+	 * temporarily.
+	 *
+	 * @return false if the pool is busy with another caller's
+	 * walk (nothing has been visited)
+	 */
+	bool Walk(const Directory &directory, const SongFilter &filter,
+		  bool hide_playlist_targets,
+		  const VisitSong &visit_song);
+
+private:
+	/**
+	 * Split the tree into at least the given number of tasks (if
+	 * it is large enough), one directory level at a time,
+	 * preserving walk order.
+	 */
+	static std::vector<Task> Partition(const Directory &directory,
+					   std::size_t n);
+
+	/**
+	 * Wait until the worker threads have finished all #tasks and
+	 * clear it.
+	 */
+	void WaitAll(std::unique_lock<Mutex> &lock) noexcept;
+
+	void StopThreads() noexcept;
+
+	void RunWorker() noexcept;
+};
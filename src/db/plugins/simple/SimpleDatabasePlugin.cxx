@@ -11,19 +11,27 @@
 #include "db/Stats.hxx"
 #include "db/UniqueTags.hxx"
 #include "db/VHelper.hxx"
+#include "db/SortKey.hxx"
+#include "song/Filter.hxx"
+#include "tag/VisitFallback.hxx"
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
 #include "DatabaseSave.hxx"
+#include "BinaryDatabase.hxx"
+#include "TagIndex.hxx"
+#include "ParallelWalk.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/zlib/AutoGunzipFileLineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
+#include "io/FileLineReader.hxx"
 #include "io/FileOutputStream.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/SystemError.hxx"
 #include "util/CharUtil.hxx"
 #include "util/Domain.hxx"
@@ -34,8 +42,13 @@
 #include "lib/zlib/GzipOutputStream.hxx"
 #endif
 
+#include <algorithm>
+#include <cassert>
 #include <cerrno>
+#include <forward_list>
 #include <memory>
+#include <string>
+#include <vector>
 
 static constexpr Domain simple_db_domain("simple_db");
 
@@ -43,10 +56,16 @@ inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	:Database(simple_db_plugin),
 	 path(block.GetPath("path")),
 	 cache_path(block.GetPath("cache_directory")),
+	 journal_path(block.GetBlockValue("journal", false)
+		      ? AllocatedPath::Concat(path.c_str(), PATH_LITERAL(".journal"))
+		      : nullptr),
 #ifdef ENABLE_ZLIB
 	 compress(block.GetBlockValue("compress", true)),
 #endif
-	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true))
+	 binary(block.GetBlockValue("binary", false)),
+	 hide_playlist_targets(block.GetBlockValue("hide_playlist_targets", true)),
+	 enable_tag_index(block.GetBlockValue("tag_index", true)),
+	 search_threads(ParallelWalkPool::GetDefaultThreads(block.GetBlockValue("search_threads", 1U)))
 {
 	if (path.IsNull())
 		throw std::runtime_error("No \"path\" parameter specified");
@@ -54,24 +73,31 @@ inline SimpleDatabase::SimpleDatabase(const ConfigBlock &block)
 	path_utf8 = path.ToUTF8();
 }
 
-inline
 SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 			       [[maybe_unused]]
 #endif
 			       bool _compress,
-			       bool _hide_playlist_targets) noexcept
+			       bool _binary,
+			       bool _hide_playlist_targets,
+			       bool _enable_tag_index) noexcept
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 	 cache_path(nullptr),
+	 journal_path(nullptr),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
 #endif
-	 hide_playlist_targets(_hide_playlist_targets)
+	 binary(_binary),
+	 hide_playlist_targets(_hide_playlist_targets),
+	 enable_tag_index(_enable_tag_index),
+	 search_threads(1)
 {
 }
 
+SimpleDatabase::~SimpleDatabase() noexcept = default;
+
 DatabasePtr
 SimpleDatabase::Create(EventLoop &, EventLoop &,
 		       [[maybe_unused]] DatabaseListener &listener,
@@ -129,21 +155,65 @@ SimpleDatabase::Check() const
 #endif
 }
 
+inline void
+SimpleDatabase::LoadFile()
+{
+	LogDebug(simple_db_domain, "reading DB");
+
+	if (!db_load_binary(path, *root)) {
+		AutoGunzipFileLineReader file{path};
+		db_load_internal(file, *root);
+	}
+}
+
+inline void
+SimpleDatabase::LoadJournal()
+{
+	if (!::FileExists(journal_path))
+		return;
+
+	LogDebug(simple_db_domain, "reading DB journal");
+
+	try {
+		FileLineReader file{journal_path};
+		db_load_journal(file, *root);
+	} catch (...) {
+		/* probably truncated by a crash while appending; fall
+		   back to the last full save */
+		FmtError(simple_db_domain, "Discarding DB journal: {}",
+			 std::current_exception());
+
+		delete root;
+		arena.Reset();
+		root = Directory::NewRoot();
+		LoadFile();
+
+		RemoveFile(journal_path);
+		return;
+	}
+
+	FileInfo fi;
+	if (GetFileInfo(journal_path, fi) && fi.GetModificationTime() > mtime)
+		mtime = fi.GetModificationTime();
+}
+
 void
 SimpleDatabase::Load()
 {
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	AutoGunzipFileLineReader file{path};
-
-	LogDebug(simple_db_domain, "reading DB");
-
-	db_load_internal(file, *root);
+	LoadFile();
 
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
+
+	if (!journal_path.IsNull())
+		LoadJournal();
+
+	/* everything is on disk now */
+	root->ClearDirty();
 }
 
 void
@@ -159,16 +229,29 @@ SimpleDatabase::Open()
 #endif
 
 	try {
+		const DatabaseArena::Scope arena_scope{arena};
 		Load();
 	} catch (...) {
 		LogError(std::current_exception());
 
 		delete root;
+		arena.Reset();
 
 		Check();
 
 		root = Directory::NewRoot();
 	}
+
+	RefreshTagIndex();
+
+	if (search_threads > 1) {
+		try {
+			walk_pool = std::make_unique<ParallelWalkPool>(search_threads);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start search threads");
+		}
+	}
 }
 
 void
@@ -178,7 +261,34 @@ SimpleDatabase::Close() noexcept
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	walk_pool.reset();
+	tag_index.reset();
 	delete root;
+	arena.Reset();
+}
+
+void
+SimpleDatabase::RefreshTagIndex() noexcept
+try {
+	if (!enable_tag_index)
+		return;
+
+	{
+		const ScopeDatabaseReadLock protect;
+		if (tag_index != nullptr && tag_index->IsValid())
+			return;
+	}
+
+	LogDebug(simple_db_domain, "building tag index");
+
+	/* Build() holds the lock only in shared mode while walking
+	   the tree, so readers are not blocked meanwhile */
+	auto new_index = SongTagIndex::Build(*root, hide_playlist_targets);
+
+	const ScopeDatabaseLock protect;
+	tag_index = std::move(new_index);
+} catch (...) {
+	LogError(std::current_exception(), "Failed to build tag index");
 }
 
 const LightSong *
@@ -188,6 +298,7 @@ SimpleDatabase::GetSong(std::string_view uri) const
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	/* exclusive, because this modifies #exported_song */
 	ScopeDatabaseLock protect;
 
 	auto r = root->LookupDirectory(uri);
@@ -266,7 +377,7 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitSong visit_song,
 		      VisitPlaylist visit_playlist) const
 {
-	ScopeDatabaseLock protect;
+	ScopeDatabaseReadLock protect;
 
 	auto r = root->LookupDirectory(selection.uri);
 
@@ -282,11 +393,33 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 		return;
 	}
 
+	if (r.rest.data() == nullptr &&
+	    selection.sort != TAG_NUM_OF_ITEM_TYPES &&
+	    !visit_directory && !visit_playlist && visit_song &&
+	    VisitSorted(*r.directory, selection, visit_song))
+		return;
+
 	DatabaseVisitorHelper helper(CheckSelection(selection), visit_song);
 
 	if (r.rest.data() == nullptr) {
 		/* it's a directory */
 
+		if (selection.recursive && selection.filter != nullptr &&
+		    !visit_directory && !visit_playlist && visit_song &&
+		    VisitIndexed(*r.directory, *selection.filter, visit_song)) {
+			helper.Commit();
+			return;
+		}
+
+		if (selection.recursive && selection.filter != nullptr &&
+		    !visit_directory && !visit_playlist && visit_song &&
+		    walk_pool != nullptr &&
+		    walk_pool->Walk(*r.directory, *selection.filter,
+				    hide_playlist_targets, visit_song)) {
+			helper.Commit();
+			return;
+		}
+
 		if (selection.recursive && visit_directory)
 			visit_directory(r.directory->Export());
 
@@ -316,19 +449,295 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 			    "No such directory");
 }
 
+[[gnu::pure]]
+static bool
+IsInside(const Directory &directory, const Directory &base) noexcept
+{
+	for (const Directory *i = &directory; i != nullptr; i = i->parent)
+		if (i == &base)
+			return true;
+
+	return false;
+}
+
+bool
+SimpleDatabase::VisitIndexed(const Directory &base, const SongFilter &filter,
+			     const VisitSong &visit_song) const
+{
+	if (tag_index == nullptr || !tag_index->IsValid())
+		return false;
+
+	std::vector<const Song *> candidates;
+	if (!tag_index->FindCandidates(filter, candidates))
+		return false;
+
+	for (const Song *song : candidates) {
+		if (!base.IsRoot() && !IsInside(song->parent, base))
+			continue;
+
+		const auto song2 = song->Export();
+		if (filter.Match(song2))
+			visit_song(song2);
+	}
+
+	return true;
+}
+
+/**
+ * Collect the songs of a directory in the order of Directory::Walk().
+ *
+ * @return false if a mount point was found
+ */
+static bool
+CollectSongs(const Directory &directory, bool recursive,
+	     bool hide_playlist_targets,
+	     std::vector<const Song *> &result) noexcept
+{
+	if (directory.IsMount())
+		return false;
+
+	for (const auto &song : directory.songs)
+		if (!hide_playlist_targets || !song.in_playlist)
+			result.push_back(&song);
+
+	if (recursive)
+		for (const auto &child : directory.children)
+			if (!CollectSongs(child, true, hide_playlist_targets,
+					  result))
+				return false;
+
+	return true;
+}
+
+bool
+SimpleDatabase::VisitSorted(const Directory &base,
+			    const DatabaseSelection &selection,
+			    const VisitSong &visit_song) const
+{
+	assert(selection.sort != TAG_NUM_OF_ITEM_TYPES);
+
+	if (selection.recursive &&
+	    SongTagIndex::CanSortByTime(selection.sort) &&
+	    tag_index != nullptr && tag_index->IsValid()) {
+		VisitSortedByTime(base, selection, visit_song);
+		return true;
+	}
+
+	const SongFilter *const filter = selection.filter;
+
+	std::vector<const Song *> candidates;
+	if (selection.recursive && filter != nullptr &&
+	    tag_index != nullptr && tag_index->IsValid() &&
+	    tag_index->FindCandidates(*filter, candidates)) {
+		if (!base.IsRoot())
+			std::erase_if(candidates, [&base](const Song *song){
+				return !IsInside(song->parent, base);
+			});
+	} else {
+		candidates.clear();
+		if (!CollectSongs(base, selection.recursive,
+				  hide_playlist_targets, candidates))
+			return false;
+	}
+
+	struct Item {
+		const Song *song;
+		SongSortKey key;
+		unsigned serial;
+	};
+
+	std::vector<Item> items;
+
+	/* copies of sort values from merged tags (songs with a
+	   "target"), whose tag pool items may be released together
+	   with the #ExportedSong */
+	std::forward_list<std::string> values;
+
+	const auto sort = selection.sort;
+	const bool sort_tag = sort < TAG_NUM_OF_ITEM_TYPES;
+
+	for (const Song *song : candidates) {
+		const auto song2 = song->Export();
+		if (filter != nullptr && !filter->Match(song2))
+			continue;
+
+		SongSortKey key{sort, song2};
+		if (sort_tag && key.tag.value != nullptr &&
+		    &song2.tag != &song->tag)
+			key.tag.value = values.emplace_front(key.tag.value).c_str();
+
+		items.push_back({song, key, unsigned(items.size())});
+	}
+
+	const std::size_t end = std::min<std::size_t>(selection.window.end,
+						      items.size());
+	if (selection.window.start >= end)
+		return true;
+
+	/* only the songs up to the end of the window need to be in
+	   order */
+	std::partial_sort(items.begin(), std::next(items.begin(), end),
+			  items.end(),
+			  MakeCompareSongSortItems(sort, selection.descending));
+
+	for (std::size_t i = selection.window.start; i < end; ++i)
+		visit_song(items[i].song->Export());
+
+	return true;
+}
+
+void
+SimpleDatabase::VisitSortedByTime(const Directory &base,
+				  const DatabaseSelection &selection,
+				  const VisitSong &visit_song) const
+{
+	assert(tag_index != nullptr);
+
+	const SongFilter *const filter = selection.filter;
+	const auto sort = selection.sort;
+	const bool descending = selection.descending;
+	const auto &window = selection.window;
+
+	if (window.start >= window.end)
+		return;
+
+	/* the unindexed songs are not in the time index; sort them
+	   here and merge them */
+	struct Item {
+		const Song *song;
+		SongSortKey key;
+		unsigned serial;
+	};
+
+	std::vector<Item> extra;
+	tag_index->ForEachUnindexed([&](const Song &song){
+		if (!base.IsRoot() && !IsInside(song.parent, base))
+			return;
+
+		const auto song2 = song.Export();
+		if (filter == nullptr || filter->Match(song2))
+			extra.push_back({&song, SongSortKey{sort, song2},
+					 unsigned(extra.size())});
+	});
+
+	std::sort(extra.begin(), extra.end(),
+		  MakeCompareSongSortItems(sort, descending));
+
+	/* pass songs to the visitor until the end of the window */
+	std::size_t position = 0;
+	const auto emit = [&](const LightSong &song){
+		if (position >= window.start)
+			visit_song(song);
+		return ++position < window.end;
+	};
+
+	auto x = extra.begin();
+
+	bool more = true;
+	tag_index->ForEachByTime(sort, descending, filter, [&](const Song &song){
+		if (!base.IsRoot() && !IsInside(song.parent, base))
+			return true;
+
+		const auto song2 = song.Export();
+		if (filter != nullptr && !filter->Match(song2))
+			return true;
+
+		const SongSortKey key{sort, song2};
+		for (; x != extra.end() &&
+			     CompareSongSortKeys(sort, descending, x->key, key);
+		     ++x)
+			if (!emit(x->song->Export()))
+				return more = false;
+
+		return more = emit(song2);
+	});
+
+	for (; more && x != extra.end(); ++x)
+		more = emit(x->song->Export());
+}
+
 RecursiveMap<std::string>
 SimpleDatabase::CollectUniqueTags(const DatabaseSelection &selection,
 				  std::span<const TagType> tag_types) const
 {
+	if (tag_types.size() == 1 && selection.uri.empty() &&
+	    selection.recursive && selection.filter == nullptr &&
+	    selection.window == RangeArg::All()) {
+		/* a plain "list TYPE": read the distinct values from
+		   the index */
+		const ScopeDatabaseReadLock protect;
+
+		if (tag_index != nullptr && tag_index->IsValid()) {
+			const TagType type = tag_types.front();
+			RecursiveMap<std::string> result;
+
+			tag_index->ForEachValue(type, [&result](const char *value){
+				result[value];
+			});
+
+			tag_index->ForEachUnindexed([&result, type](const Song &song){
+				const auto song2 = song.Export();
+				VisitTagWithFallbackOrEmpty(song2.tag, type,
+							    [&result](const char *value){
+					result[value];
+				});
+			});
+
+			return result;
+		}
+	}
+
 	return ::CollectUniqueTags(*this, selection, tag_types);
 }
 
+std::optional<std::string>
+SimpleDatabase::GetDirectoryCover(std::string_view uri) const
+{
+	ScopeDatabaseReadLock protect;
+
+	const auto r = root->LookupDirectory(uri);
+
+	if (r.directory->IsMount()) {
+		/* pass the request to the mounted database */
+		protect.unlock();
+		return r.directory->mounted_database->GetDirectoryCover(r.rest);
+	}
+
+	if (!r.rest.empty())
+		/* no such directory */
+		return std::nullopt;
+
+	return r.directory->cover;
+}
+
 DatabaseStats
 SimpleDatabase::GetStats(const DatabaseSelection &selection) const
 {
+	if (selection.uri.empty() && selection.recursive &&
+	    selection.filter == nullptr &&
+	    selection.window == RangeArg::All()) {
+		/* the whole database: the index has calculated the
+		   statistics already in the update thread */
+		const ScopeDatabaseReadLock protect;
+
+		if (tag_index != nullptr && tag_index->IsValid())
+			return tag_index->GetStats();
+	}
+
 	return ::GetStats(*this, selection);
 }
 
+SimpleDatabaseMemoryStats
+SimpleDatabase::GetMemoryStats() const noexcept
+{
+	SimpleDatabaseMemoryStats stats;
+
+	const ScopeDatabaseReadLock protect;
+	if (root != nullptr)
+		root->CollectMemoryStats(stats);
+	return stats;
+}
+
 void
 SimpleDatabase::Save()
 {
@@ -342,6 +751,11 @@ SimpleDatabase::Save()
 		root->Sort();
 	}
 
+	if (!journal_path.IsNull() && SaveJournal()) {
+		root->ClearDirty();
+		return;
+	}
+
 	LogDebug(simple_db_domain, "writing DB");
 
 	FileOutputStream fos(path);
@@ -350,7 +764,7 @@ SimpleDatabase::Save()
 
 #ifdef ENABLE_ZLIB
 	std::unique_ptr<GzipOutputStream> gzip;
-	if (compress) {
+	if (compress && !binary) {
 		gzip = std::make_unique<GzipOutputStream>(*os);
 		os = gzip.get();
 	}
@@ -358,7 +772,10 @@ SimpleDatabase::Save()
 
 	BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+	if (binary)
+		db_save_binary(bos, *root);
+	else
+		db_save_internal(bos, *root);
 
 	bos.Flush();
 
@@ -369,13 +786,56 @@ SimpleDatabase::Save()
 	}
 #endif
 
+	/* the new file contains everything; delete the journal
+	   before committing, because replaying it on top of the new
+	   file would revert newer changes */
+	if (!journal_path.IsNull() && ::FileExists(journal_path))
+		RemoveFile(journal_path);
+
 	fos.Commit();
 
+	root->ClearDirty();
+
 	FileInfo fi;
 	if (GetFileInfo(path, fi))
 		mtime = fi.GetModificationTime();
 }
 
+inline bool
+SimpleDatabase::SaveJournal()
+{
+	FileInfo db_info;
+	if (!FileExists() || !GetFileInfo(path, db_info))
+		/* no valid database file which the journal could
+		   be applied to */
+		return false;
+
+	FileInfo journal_info;
+	const uint_least64_t journal_size = GetFileInfo(journal_path, journal_info)
+		? journal_info.GetSize()
+		: 0;
+
+	/* compact: once the journal is larger than the database
+	   file, rewriting the file is cheaper than replaying the
+	   journal on startup */
+	if (journal_size > db_info.GetSize())
+		return false;
+
+	LogDebug(simple_db_domain, "appending to DB journal");
+
+	FileOutputStream fos(journal_path,
+			     FileOutputStream::Mode::APPEND_OR_CREATE);
+	BufferedOutputStream bos(fos);
+	db_save_journal(bos, *root, journal_size == 0);
+	bos.Flush();
+	fos.Commit();
+
+	if (GetFileInfo(journal_path, journal_info))
+		mtime = journal_info.GetModificationTime();
+
+	return true;
+}
+
 void
 SimpleDatabase::Mount(const char *uri, DatabasePtr db)
 {
@@ -429,7 +889,9 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	constexpr bool compress = false;
 #endif
 	auto db = std::make_unique<SimpleDatabase>(cache_path / name_fs,
-						   compress, hide_playlist_targets);
+						   compress, binary,
+						   hide_playlist_targets,
+						   enable_tag_index);
 	db->Open();
 
 	bool exists = db->FileExists();
@@ -467,6 +929,6 @@ SimpleDatabase::Unmount(const char *uri) noexcept
 
 constexpr DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
@@ -4,6 +4,7 @@
 #ifndef MPD_SIMPLE_DATABASE_PLUGIN_HXX
 #define MPD_SIMPLE_DATABASE_PLUGIN_HXX
 
+#include "Arena.hxx"
 #include "ExportedSong.hxx"
 #include "db/Interface.hxx"
 #include "db/Ptr.hxx"
@@ -12,6 +13,8 @@
 #include "config.h"
 
 #include <cassert>
+#include <cstddef>
+#include <memory>
 
 struct ConfigBlock;
 struct Directory;
@@ -19,6 +22,19 @@ struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
 class PrefixedLightSong;
+class SongTagIndex;
+class ParallelWalkPool;
+class SongFilter;
+
+struct SimpleDatabaseMemoryStats {
+	std::size_t directories = 0, songs = 0;
+
+	/**
+	 * The approximate memory occupied by the #Directory and #Song
+	 * objects.
+	 */
+	std::size_t bytes = 0;
+};
 
 class SimpleDatabase : public Database {
 	const AllocatedPath path;
@@ -29,6 +45,19 @@ class SimpleDatabase : public Database {
 	 */
 	const AllocatedPath cache_path;
 
+	/**
+	 * The path of the journal file which records the directories
+	 * modified since the last full save.  It is nulled if the
+	 * journal is disabled.
+	 */
+	const AllocatedPath journal_path;
+
+	/**
+	 * The #Song and #Directory objects loaded by Load() are
+	 * allocated here.
+	 */
+	DatabaseArena arena;
+
 	Directory *root;
 
 	std::chrono::system_clock::time_point mtime;
@@ -52,12 +81,39 @@ class SimpleDatabase : public Database {
 	const bool compress;
 #endif
 
+	/**
+	 * Write the binary database format?  (Both formats can be
+	 * loaded regardless of this setting.)
+	 */
+	const bool binary;
+
 	const bool hide_playlist_targets;
 
+	const bool enable_tag_index;
+
+	/**
+	 * Speeds up filtered Visit() and CollectUniqueTags() calls.
+	 * It is rebuilt by RefreshTagIndex() and it is ignored while
+	 * it is stale.
+	 *
+	 * Protected with the global #db_mutex.
+	 */
+	std::unique_ptr<SongTagIndex> tag_index;
+
+	/**
+	 * The number of threads for filtered Visit() calls which
+	 * cannot use the #tag_index; 1 disables #walk_pool.
+	 */
+	const unsigned search_threads;
+
+	std::unique_ptr<ParallelWalkPool> walk_pool;
+
 public:
 	SimpleDatabase(const ConfigBlock &block);
-	SimpleDatabase(AllocatedPath &&_path, bool _compress,
-		       bool _hide_playlist_targets) noexcept;
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary,
+		       bool _hide_playlist_targets,
+		       bool _enable_tag_index) noexcept;
+	~SimpleDatabase() noexcept override;
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -77,6 +133,21 @@ public:
 
 	void Save();
 
+	/**
+	 * Rebuild the tag index if the tree has been modified since
+	 * it was built.  Must be called from the thread which
+	 * modifies the tree (i.e. the update thread) while it is not
+	 * modifying it.
+	 */
+	void RefreshTagIndex() noexcept;
+
+	/**
+	 * Walk the whole tree to determine its size.  This is
+	 * expensive and meant only for diagnostics.
+	 */
+	[[gnu::pure]]
+	SimpleDatabaseMemoryStats GetMemoryStats() const noexcept;
+
 	/**
 	 * Returns true if there is a valid database file on the disk.
 	 */
@@ -119,6 +190,8 @@ public:
 
 	DatabaseStats GetStats(const DatabaseSelection &selection) const override;
 
+	std::optional<std::string> GetDirectoryCover(std::string_view uri_utf8) const override;
+
 	std::chrono::system_clock::time_point GetUpdateStamp() const noexcept override {
 		return mtime;
 	}
@@ -133,6 +206,62 @@ private:
 	 */
 	void Load();
 
+	/**
+	 * Load the database file, without the journal.
+	 *
+	 * Throws #std::runtime_error on error.
+	 */
+	void LoadFile();
+
+	/**
+	 * Apply the journal (if one exists).  If it is corrupt, it
+	 * is deleted and the database file is reloaded to undo the
+	 * partial replay.
+	 */
+	void LoadJournal();
+
+	/**
+	 * Append the modified directories to the journal.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if the database file needs to be rewritten
+	 * instead (no file yet or the journal has grown too large)
+	 */
+	bool SaveJournal();
+
+	/**
+	 * Try to implement a filtered recursive Visit() with the
+	 * #tag_index.  Caller must lock the #db_mutex.
+	 *
+	 * @return false if the index cannot be used
+	 */
+	bool VisitIndexed(const Directory &base, const SongFilter &filter,
+			  const VisitSong &visit_song) const;
+
+	/**
+	 * Implement a sorted Visit() of songs without copying them:
+	 * only pointers to the matching songs and their sort keys are
+	 * collected, and only the songs inside the "window" are
+	 * exported to the visitor.  Caller must lock the #db_mutex.
+	 *
+	 * @return false if the tree contains mount points
+	 */
+	bool VisitSorted(const Directory &base,
+			 const DatabaseSelection &selection,
+			 const VisitSong &visit_song) const;
+
+	/**
+	 * Implement a recursive Visit() sorted by modification or
+	 * "added" time with the #tag_index: the songs are visited in
+	 * this order until the end of the "window" is reached.
+	 * Caller must lock the #db_mutex and check that the index is
+	 * valid.
+	 */
+	void VisitSortedByTime(const Directory &base,
+			       const DatabaseSelection &selection,
+			       const VisitSong &visit_song) const;
+
 	DatabasePtr LockUmountSteal(const char *uri) noexcept;
 };
 
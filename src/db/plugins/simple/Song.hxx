@@ -4,10 +4,12 @@
 #pragma once
 
 #include "Ptr.hxx"
+#include "Arena.hxx"
 #include "Chrono.hxx"
 #include "archive/Features.h" // for ENABLE_ARCHIVE
 #include "tag/Tag.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <string>
@@ -23,7 +25,7 @@ class ArchiveFile;
  * A song file inside the configured music directory.  Internal
  * #SimpleDatabase class.
  */
-struct Song : IntrusiveListHook<> {
+struct Song : IntrusiveListHook<>, DatabaseArenaObject {
 	/* Note: the #IntrusiveListHook is protected with the global
 	   #db_mutex.  Read access in the update thread does not need
 	   protection. */
@@ -63,6 +65,13 @@ struct Song : IntrusiveListHook<> {
 	std::chrono::system_clock::time_point added =
 		std::chrono::system_clock::time_point::min();
 
+	/**
+	 * See StorageFileInfo::GetFileId(); 0 means unknown.  The
+	 * database update uses it to detect moved and renamed
+	 * files.
+	 */
+	uint64_t file_id = 0;
+
 	/**
 	 * Start of this sub-song within the file.
 	 */
@@ -92,6 +101,12 @@ struct Song : IntrusiveListHook<> {
 	 */
 	bool mark;
 
+	/**
+	 * Links this object into Directory::song_index (if the
+	 * parent has one).
+	 */
+	IntrusiveHashSetHook<IntrusiveHookMode::AUTO_UNLINK> index_hook;
+
 	template<typename F>
 	Song(F &&_filename, Directory &_parent) noexcept
 		:parent(_parent), filename(std::forward<F>(_filename)) {}
@@ -0,0 +1,656 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "TagIndex.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "ExportedSong.hxx"
+#include "db/DatabaseLock.hxx"
+#include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/ModifiedSinceSongFilter.hxx"
+#include "song/AddedSinceSongFilter.hxx"
+#include "tag/Fallback.hxx"
+#include "tag/VisitFallback.hxx"
+#include "thread/Mutex.hxx"
+#include "util/StringAPI.hxx"
+#include "util/StringCompare.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+#include <span>
+#include <string>
+
+#include <string.h>
+
+static_assert(TAG_NUM_OF_ITEM_TYPES <= 64);
+
+static constexpr uint_least64_t
+TagBit(TagType type) noexcept
+{
+	return uint_least64_t(1) << type;
+}
+
+/**
+ * The bit mask of all tag types which VisitTagWithFallback() may
+ * look at.
+ */
+static uint_least64_t
+TagWithFallbackMask(TagType type) noexcept
+{
+	uint_least64_t mask = 0;
+	ApplyTagWithFallback(type, [&mask](TagType t){
+		mask |= TagBit(t);
+		return false;
+	});
+	return mask;
+}
+
+[[gnu::pure]]
+static uint_least64_t
+GetTagMask(const Tag &tag) noexcept
+{
+	uint_least64_t mask = 0;
+	for (const auto &item : tag)
+		mask |= TagBit(item.type);
+	return mask;
+}
+
+bool
+SongTagIndex::Add(const Directory &directory, bool hide_playlist_targets)
+{
+	if (directory.IsMount())
+		return false;
+
+	for (const auto &song : directory.songs) {
+		if (hide_playlist_targets && song.in_playlist)
+			continue;
+
+		if (!song.target.empty())
+			unindexed.push_back(songs.size());
+
+		songs.push_back(&song);
+	}
+
+	for (const auto &child : directory.children)
+		if (!Add(child, hide_playlist_targets))
+			return false;
+
+	return true;
+}
+
+inline void
+SongTagIndex::Build(TagType type, const std::vector<uint_least64_t> &masks)
+{
+	auto &t = tags[type];
+	const uint_least64_t type_mask = TagWithFallbackMask(type);
+
+	std::vector<std::pair<const char *, uint32_t>> pairs;
+
+	auto u = unindexed.begin();
+	for (uint32_t i = 0; i < songs.size(); ++i) {
+		if (u != unindexed.end() && *u == i) {
+			++u;
+			continue;
+		}
+
+		if ((masks[i] & type_mask) == 0) {
+			/* quick path for songs which don't have
+			   this tag */
+			t.has_empty = true;
+			continue;
+		}
+
+		VisitTagWithFallbackOrEmpty(songs[i]->tag, type, [&](const char *value){
+			if (*value == 0)
+				t.has_empty = true;
+			else
+				pairs.emplace_back(value, i);
+		});
+	}
+
+	std::sort(pairs.begin(), pairs.end(), [](const auto &a, const auto &b){
+		const int cmp = strcmp(a.first, b.first);
+		return cmp < 0 || (cmp == 0 && a.second < b.second);
+	});
+
+	t.postings.reserve(pairs.size());
+
+	for (const auto &[value, i] : pairs) {
+		if (t.values.empty() || strcmp(t.values.back().value, value) != 0) {
+			const uint32_t position = t.postings.size();
+			t.values.push_back({value, position, position});
+		}
+
+		auto &v = t.values.back();
+		if (v.end > v.begin && t.postings.back() == i)
+			/* the song has this value twice */
+			continue;
+
+		t.postings.push_back(i);
+		v.end = t.postings.size();
+	}
+
+	t.values.shrink_to_fit();
+	t.postings.shrink_to_fit();
+}
+
+std::unique_ptr<SongTagIndex>
+SongTagIndex::Build(const Directory &root, bool hide_playlist_targets)
+{
+	auto index = std::make_unique<SongTagIndex>();
+
+	{
+		/* the update thread is not the only one which
+		   modifies the tree: Mount() and Unmount() do that in
+		   the main thread; the shared lock excludes them, but
+		   not the readers */
+		const ScopeDatabaseReadLock protect;
+
+		/* remember the generation before reading the tree,
+		   so a later modification makes the snapshot stale */
+		index->generation = Directory::generation.load(std::memory_order_relaxed);
+
+		if (!index->Add(root, hide_playlist_targets) ||
+		    index->songs.size() > UINT32_MAX)
+			return nullptr;
+	}
+
+	/* the remaining steps only access the collected #Song
+	   objects; Unmount() frees only songs of mounted databases,
+	   which are never indexed */
+
+	std::vector<uint_least64_t> masks;
+	masks.reserve(index->songs.size());
+	for (const Song *song : index->songs)
+		masks.push_back(GetTagMask(song->tag));
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		index->Build(TagType(i), masks);
+
+	index->BuildStats();
+	index->BuildTimes();
+
+	return index;
+}
+
+unsigned
+SongTagIndex::CountDistinct(TagType type) const
+{
+	const auto &values = tags[type].values;
+
+	/* values of unindexed songs which are missing in #values */
+	std::set<std::string, std::less<>> extra;
+	for (const uint32_t i : unindexed) {
+		const auto song = songs[i]->Export();
+		VisitTagType(song.tag, type, [&values, &extra](const char *value){
+			if (*value == 0)
+				return;
+
+			const auto j = std::lower_bound(values.begin(), values.end(), value,
+							[](const Value &v, const char *n){
+								return strcmp(v.value, n) < 0;
+							});
+			if (j == values.end() || strcmp(j->value, value) != 0)
+				extra.emplace(value);
+		});
+	}
+
+	return values.size() + extra.size();
+}
+
+inline void
+SongTagIndex::BuildStats()
+{
+	stats.Clear();
+	stats.song_count = songs.size();
+
+	auto u = unindexed.begin();
+	for (uint32_t i = 0; i < songs.size(); ++i) {
+		SignedSongTime duration;
+		if (u != unindexed.end() && *u == i) {
+			++u;
+			duration = songs[i]->Export().tag.duration;
+		} else
+			duration = songs[i]->tag.duration;
+
+		if (!duration.IsNegative())
+			stats.total_duration += duration;
+	}
+
+	stats.artist_count = CountDistinct(TAG_ARTIST);
+	stats.album_count = CountDistinct(TAG_ALBUM);
+}
+
+inline void
+SongTagIndex::BuildTimes()
+{
+	by_mtime.reserve(songs.size() - unindexed.size());
+	by_added.reserve(songs.size() - unindexed.size());
+
+	auto u = unindexed.begin();
+	for (uint32_t i = 0; i < songs.size(); ++i) {
+		if (u != unindexed.end() && *u == i) {
+			++u;
+			continue;
+		}
+
+		by_mtime.push_back({songs[i]->mtime, i});
+		by_added.push_back({songs[i]->added, i});
+	}
+
+	/* the songs are already in tree order, which must be
+	   preserved for equal time stamps */
+	constexpr auto compare = [](const TimeEntry &a, const TimeEntry &b){
+		return a.time < b.time;
+	};
+
+	std::stable_sort(by_mtime.begin(), by_mtime.end(), compare);
+	std::stable_sort(by_added.begin(), by_added.end(), compare);
+}
+
+/**
+ * Returns the entries with a time stamp not older than the given one.
+ */
+template<typename T>
+[[gnu::pure]]
+static std::span<const T>
+Since(std::span<const T> entries,
+      std::chrono::system_clock::time_point since) noexcept
+{
+	const auto i = std::partition_point(entries.begin(), entries.end(),
+					    [since](const T &e){
+						    return e.time < since;
+					    });
+	return {i, entries.end()};
+}
+
+/**
+ * If this is a "modified-since" or "added-since" filter, return the
+ * attribute (#SORT_TAG_LAST_MODIFIED or #SORT_TAG_ADDED) and the
+ * time stamp.
+ */
+[[gnu::pure]]
+static std::optional<std::pair<TagType, std::chrono::system_clock::time_point>>
+GetSince(const ISongFilter &filter) noexcept
+{
+	if (const auto *f = dynamic_cast<const ModifiedSinceSongFilter *>(&filter))
+		return std::pair{TagType(SORT_TAG_LAST_MODIFIED), f->GetValue()};
+
+	if (const auto *f = dynamic_cast<const AddedSinceSongFilter *>(&filter))
+		return std::pair{TagType(SORT_TAG_ADDED), f->GetValue()};
+
+	return std::nullopt;
+}
+
+std::optional<std::span<const SongTagIndex::TimeEntry>>
+SongTagIndex::FindTimeRange(const ISongFilter &filter) const noexcept
+{
+	const auto since = GetSince(filter);
+	if (!since)
+		return std::nullopt;
+
+	return Since(GetTimes(since->first), since->second);
+}
+
+void
+SongTagIndex::ForEachByTime(TagType sort, bool descending,
+			    const SongFilter *filter,
+			    const std::function<bool(const Song &)> &f) const
+{
+	assert(CanSortByTime(sort));
+
+	auto range = GetTimes(sort);
+
+	if (filter != nullptr)
+		for (const auto &i : filter->GetItems())
+			if (const auto since = GetSince(*i);
+			    since && since->first == sort)
+				range = Since(range, since->second);
+
+	if (!descending) {
+		for (const auto &e : range)
+			if (!f(*songs[e.song]))
+				return;
+		return;
+	}
+
+	/* newest first, but songs with the same time stamp in tree
+	   order, just like MakeCompareSongSortItems() */
+	auto end = range.end();
+	while (end != range.begin()) {
+		const auto time = std::prev(end)->time;
+		const auto begin = std::partition_point(range.begin(), end,
+							[time](const TimeEntry &e){
+								return e.time < time;
+							});
+		for (auto i = begin; i != end; ++i)
+			if (!f(*songs[i->song]))
+				return;
+
+		end = begin;
+	}
+}
+
+/**
+ * Returns the range of #Value objects whose value matches the given
+ * (binary, not negated) filter.
+ */
+template<typename V>
+static auto
+FindValueRange(V &values, const StringFilter &filter) noexcept
+{
+	const char *const needle = filter.GetValue().c_str();
+	const std::size_t needle_length = filter.GetValue().length();
+
+	const auto begin = std::lower_bound(values.begin(), values.end(), needle,
+					    [](const auto &v, const char *n){
+						    return strcmp(v.value, n) < 0;
+					    });
+
+	auto end = begin;
+	if (filter.GetPosition() == StringFilter::Position::PREFIX) {
+		while (end != values.end() &&
+		       StringIsEqual(end->value, needle, needle_length))
+			++end;
+	} else if (end != values.end() && strcmp(end->value, needle) == 0)
+		++end;
+
+	return std::pair{begin, end};
+}
+
+#ifdef HAVE_ICU_CANONICALIZE
+
+static constexpr uint32_t
+MakeTrigram(const char *p) noexcept
+{
+	return (uint32_t(uint8_t(p[0])) << 16) |
+		(uint32_t(uint8_t(p[1])) << 8) |
+		uint32_t(uint8_t(p[2]));
+}
+
+/**
+ * Which item of TagTypeIndex::folded is used for the given flags (at
+ * least one of them must be set)?
+ */
+static constexpr std::size_t
+FoldedSlot(bool fold_case, bool strip_diacritics) noexcept
+{
+	return (fold_case ? 1 : 0) + (strip_diacritics ? 2 : 0) - 1;
+}
+
+SongTagIndex::FoldedIndex::FoldedIndex(const TagTypeIndex &t,
+				       bool fold_case, bool strip_diacritics)
+{
+	values.reserve(t.values.size());
+	for (const auto &v : t.values)
+		values.emplace_back(IcuCanonicalize(v.value, fold_case,
+						    strip_diacritics));
+
+	for (uint32_t i = 0; i < values.size(); ++i) {
+		const char *s = values[i].c_str();
+		if (s == nullptr)
+			continue;
+
+		for (; s[0] != 0 && s[1] != 0 && s[2] != 0; ++s)
+			trigrams.push_back({MakeTrigram(s), i});
+	}
+
+	std::sort(trigrams.begin(), trigrams.end(), [](const auto &a, const auto &b){
+		return a.trigram < b.trigram ||
+			(a.trigram == b.trigram && a.value < b.value);
+	});
+
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end(),
+				   [](const auto &a, const auto &b){
+					   return a.trigram == b.trigram &&
+						   a.value == b.value;
+				   }),
+		       trigrams.end());
+	trigrams.shrink_to_fit();
+}
+
+/**
+ * Protects creating TagTypeIndex::folded, which is done by readers
+ * holding the #db_mutex only in shared mode.
+ */
+static Mutex folded_mutex;
+
+const SongTagIndex::FoldedIndex &
+SongTagIndex::GetFolded(const TagTypeIndex &t,
+			bool fold_case, bool strip_diacritics)
+{
+	const std::scoped_lock lock{folded_mutex};
+	auto &folded = t.folded[FoldedSlot(fold_case, strip_diacritics)];
+	if (!folded)
+		folded = std::make_unique<FoldedIndex>(t, fold_case,
+						       strip_diacritics);
+	return *folded;
+}
+
+[[gnu::pure]]
+static bool
+MatchFolded(const char *value, const char *needle,
+	    StringFilter::Position position) noexcept
+{
+	if (value == nullptr)
+		return false;
+
+	switch (position) {
+	case StringFilter::Position::FULL:
+		break;
+
+	case StringFilter::Position::ANYWHERE:
+		return StringFind(value, needle) != nullptr;
+
+	case StringFilter::Position::PREFIX:
+		return StringStartsWith(value, needle);
+	}
+
+	return StringIsEqual(value, needle);
+}
+
+inline void
+SongTagIndex::FindFolded(const TagTypeIndex &t, const StringFilter &filter,
+			 std::vector<ValueMatch> &matches)
+{
+	const auto &c = filter.GetIcuCompare();
+	const auto &folded = GetFolded(t, c.GetFoldCase(),
+				       c.GetStripDiacritics());
+	const char *const needle = c.GetCanonicalNeedle();
+	const auto position = filter.GetPosition();
+
+	if (position == StringFilter::Position::ANYWHERE &&
+	    strlen(needle) >= 3) {
+		/* each matching value contains all trigrams of the
+		   needle; look only at the values containing the
+		   rarest one */
+		std::span<const FoldedIndex::Trigram> best;
+		bool first = true;
+
+		for (const char *p = needle; p[1] != 0 && p[2] != 0; ++p) {
+			const auto r = std::ranges::equal_range(folded.trigrams,
+								MakeTrigram(p), {},
+								&FoldedIndex::Trigram::trigram);
+			if (first || r.size() < best.size()) {
+				best = r;
+				first = false;
+			}
+
+			if (best.empty())
+				return;
+		}
+
+		for (const auto &i : best)
+			if (MatchFolded(folded.values[i.value].c_str(),
+					needle, position))
+				matches.push_back({&t, i.value});
+	} else {
+		for (uint32_t i = 0; i < folded.values.size(); ++i)
+			if (MatchFolded(folded.values[i].c_str(),
+					needle, position))
+				matches.push_back({&t, i});
+	}
+}
+
+#endif
+
+inline bool
+SongTagIndex::CanUse(const TagSongFilter &filter) noexcept
+{
+	const auto &sf = filter.GetFilter();
+	if (sf.IsNegated() || sf.IsRegex() ||
+	    /* the empty string and songs without the tag are not
+	       indexed */
+	    sf.empty())
+		return false;
+
+#ifndef HAVE_ICU_CANONICALIZE
+	/* without ICU, there is no canonical form which could be
+	   indexed */
+	if (!sf.IsBinary())
+		return false;
+#endif
+
+	return true;
+}
+
+inline void
+SongTagIndex::FindValues(const TagTypeIndex &t, const StringFilter &filter,
+			 std::vector<ValueMatch> &matches)
+{
+#ifdef HAVE_ICU_CANONICALIZE
+	if (filter.GetIcuCompare()) {
+		FindFolded(t, filter, matches);
+		return;
+	}
+#endif
+
+	if (filter.GetPosition() == StringFilter::Position::ANYWHERE) {
+		/* no index for binary substring searches, but
+		   scanning the distinct values is still cheaper than
+		   scanning all songs */
+		const char *const needle = filter.GetValue().c_str();
+		for (uint32_t i = 0; i < t.values.size(); ++i)
+			if (StringFind(t.values[i].value, needle) != nullptr)
+				matches.push_back({&t, i});
+		return;
+	}
+
+	const auto [begin, end] = FindValueRange(t.values, filter);
+	for (auto i = begin; i != end; ++i)
+		matches.push_back({&t, uint32_t(std::distance(t.values.begin(), i))});
+}
+
+std::size_t
+SongTagIndex::FindValues(const TagSongFilter &filter,
+			 std::vector<ValueMatch> &matches) const
+{
+	const auto &sf = filter.GetFilter();
+
+	if (filter.GetTagType() == TAG_NUM_OF_ITEM_TYPES) {
+		/* "any": the union of all tag types is a superset
+		   (it includes fallback values, but the caller
+		   applies the filter anyway) */
+		for (const auto &t : tags)
+			FindValues(t, sf, matches);
+	} else
+		FindValues(tags[filter.GetTagType()], sf, matches);
+
+	std::size_t n = 0;
+	for (const auto &m : matches) {
+		const auto &v = m.t->values[m.value];
+		n += v.end - v.begin;
+	}
+
+	return n;
+}
+
+inline void
+SongTagIndex::Collect(const std::vector<ValueMatch> &matches,
+		      std::vector<uint32_t> &result)
+{
+	for (const auto &m : matches) {
+		const auto &v = m.t->values[m.value];
+		result.insert(result.end(),
+			      std::next(m.t->postings.begin(), v.begin),
+			      std::next(m.t->postings.begin(), v.end));
+	}
+}
+
+bool
+SongTagIndex::FindCandidates(const SongFilter &filter,
+			     std::vector<const Song *> &result) const
+{
+	/* pick the most selective indexable item of the "AND"
+	   list */
+	bool found = false;
+	std::vector<ValueMatch> best, matches;
+	std::size_t best_count = 0;
+
+	/* the range of a "modified-since" or "added-since" item, if
+	   it is the most selective one */
+	std::optional<std::span<const TimeEntry>> best_range;
+
+	for (const auto &i : filter.GetItems()) {
+		if (const auto range = FindTimeRange(*i)) {
+			if (!found || range->size() < best_count) {
+				found = true;
+				best.clear();
+				best_range = range;
+				best_count = range->size();
+			}
+
+			continue;
+		}
+
+		const auto *f = dynamic_cast<const TagSongFilter *>(i.get());
+		if (f == nullptr || !CanUse(*f))
+			continue;
+
+		matches.clear();
+		const std::size_t n = FindValues(*f, matches);
+		if (!found || n < best_count) {
+			found = true;
+			best.swap(matches);
+			best_range.reset();
+			best_count = n;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	std::vector<uint32_t> ordinals;
+	ordinals.reserve(best_count + unindexed.size());
+	if (best_range)
+		for (const auto &e : *best_range)
+			ordinals.push_back(e.song);
+	else
+		Collect(best, ordinals);
+	ordinals.insert(ordinals.end(), unindexed.begin(), unindexed.end());
+
+	std::sort(ordinals.begin(), ordinals.end());
+	ordinals.erase(std::unique(ordinals.begin(), ordinals.end()),
+		       ordinals.end());
+
+	result.reserve(ordinals.size());
+	for (const uint32_t i : ordinals)
+		result.push_back(songs[i]);
+
+	return true;
+}
+
+void
+SongTagIndex::ForEachValue(TagType type,
+			   const std::function<void(const char *)> &f) const
+{
+	const auto &t = tags[type];
+
+	for (const auto &v : t.values)
+		f(v.value);
+
+	if (t.has_empty)
+		f("");
+}
@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Directory.hxx"
+#include "db/Stats.hxx"
+#include "song/Filter.hxx"
+#include "tag/Type.hxx"
+#include "lib/icu/Canonicalize.hxx"
+#include "util/AllocatedString.hxx"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+class ISongFilter;
+class StringFilter;
+class TagSongFilter;
+
+/**
+ * An inverted index of the tag values of all songs in a #Directory
+ * tree: for each tag type, a sorted array of distinct values, each
+ * with the list of songs carrying it (with the same fallbacks as
+ * #TagSongFilter, e.g. "AlbumArtist" falls back to "Artist").
+ *
+ * For case-insensitive filters, the values are additionally
+ * available in canonical form (see IcuCanonicalize()) together with
+ * a trigram index, which allows substring searches ("contains") to
+ * look only at values which contain all three-byte sequences of the
+ * needle.
+ *
+ * Additionally, all songs are sorted by their modification and
+ * "added" time stamps, which turns "modified-since" and
+ * "added-since" into range scans and allows sorting by these
+ * attributes without looking at all songs.
+ *
+ * It is a snapshot; it becomes stale with the next modification of
+ * the tree (see Directory::generation) and must not be used after
+ * that.
+ *
+ * All methods must be called with the #db_mutex locked (except for
+ * Build(), see there).
+ */
+class SongTagIndex {
+	struct Value {
+		/**
+		 * Points into a #Tag of a song in the tree.
+		 */
+		const char *value;
+
+		/**
+		 * The range of song ordinals in TagTypeIndex::postings.
+		 */
+		uint32_t begin, end;
+	};
+
+	struct TagTypeIndex;
+
+#ifdef HAVE_ICU_CANONICALIZE
+	/**
+	 * The values of one #TagTypeIndex in canonical form.
+	 */
+	struct FoldedIndex {
+		/**
+		 * The result of IcuCanonicalize() for each item of
+		 * TagTypeIndex::values (same order).
+		 */
+		std::vector<AllocatedString> values;
+
+		struct Trigram {
+			/**
+			 * Three bytes of a value.
+			 */
+			uint32_t trigram;
+
+			/**
+			 * The index of the value in #values.
+			 */
+			uint32_t value;
+		};
+
+		/**
+		 * All three-byte sequences of all #values, sorted by
+		 * trigram and value, without duplicates.
+		 */
+		std::vector<Trigram> trigrams;
+
+		FoldedIndex(const TagTypeIndex &t,
+			    bool fold_case, bool strip_diacritics);
+	};
+#endif
+
+	struct TagTypeIndex {
+		/**
+		 * Sorted by strcmp().
+		 */
+		std::vector<Value> values;
+
+		/**
+		 * Ordinals of #songs; for each value sorted in tree
+		 * order.
+		 */
+		std::vector<uint32_t> postings;
+
+		/**
+		 * Does at least one song have no value (and no
+		 * fallback)?  The empty string is not in #values.
+		 */
+		bool has_empty = false;
+
+#ifdef HAVE_ICU_CANONICALIZE
+		/**
+		 * The values in canonical form, one for each
+		 * combination of the "fold_case" and
+		 * "strip_diacritics" flags (see FoldedSlot()).  They
+		 * are created on demand by GetFolded(), because each
+		 * client uses only one of them.  Creating them is
+		 * protected with a private mutex.
+		 */
+		mutable std::array<std::unique_ptr<FoldedIndex>, 3> folded;
+#endif
+	};
+
+	struct TimeEntry {
+		std::chrono::system_clock::time_point time;
+
+		/**
+		 * The ordinal in #songs.
+		 */
+		uint32_t song;
+	};
+
+	/**
+	 * A value which matches a filter.
+	 */
+	struct ValueMatch {
+		const TagTypeIndex *t;
+
+		/**
+		 * The index of the value in TagTypeIndex::values.
+		 */
+		uint32_t value;
+	};
+
+	std::array<TagTypeIndex, TAG_NUM_OF_ITEM_TYPES> tags;
+
+	/**
+	 * All visible songs in tree order (the order of
+	 * Directory::Walk()).
+	 */
+	std::vector<const Song *> songs;
+
+	/**
+	 * Ordinals of songs which are not in #tags, because their
+	 * exported tags are not their own (songs pointing to a
+	 * "target" which complements them).  They are always
+	 * candidates.
+	 */
+	std::vector<uint32_t> unindexed;
+
+	/**
+	 * All songs except for #unindexed sorted by Song::mtime and
+	 * Song::added (and then in tree order).
+	 */
+	std::vector<TimeEntry> by_mtime, by_added;
+
+	/**
+	 * The statistics of all #songs, as ::GetStats() would
+	 * calculate them.
+	 */
+	DatabaseStats stats;
+
+	/**
+	 * The Directory::generation this snapshot was built from.
+	 */
+	uint_least64_t generation;
+
+public:
+	/**
+	 * Build a new index.  This method locks the #db_mutex in
+	 * shared mode while walking the tree; the caller must not be
+	 * holding it, and it must ensure that no songs are freed
+	 * meanwhile (e.g. by calling it from the update thread).
+	 *
+	 * @param hide_playlist_targets omit songs with
+	 * `Song::in_playlist`, see Directory::Walk()
+	 * @return the index or nullptr if the tree contains mount
+	 * points (their songs cannot be indexed)
+	 */
+	static std::unique_ptr<SongTagIndex> Build(const Directory &root,
+						   bool hide_playlist_targets);
+
+	/**
+	 * Has the tree not been modified since Build()?
+	 */
+	[[gnu::pure]]
+	bool IsValid() const noexcept {
+		return generation == Directory::generation.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Find all songs which may match the given filter, in tree
+	 * order.  This is a superset; the caller needs to apply the
+	 * filter to each of them.
+	 *
+	 * @return false if the index cannot help with this filter
+	 */
+	bool FindCandidates(const SongFilter &filter,
+			    std::vector<const Song *> &result) const;
+
+	/**
+	 * Invoke a function for each distinct value of the given tag
+	 * type (including the empty string for songs which don't have
+	 * it), in no particular order.  Songs returned by
+	 * ForEachUnindexed() are not considered.
+	 */
+	void ForEachValue(TagType type,
+			  const std::function<void(const char *)> &f) const;
+
+	/**
+	 * Return the statistics of the whole tree, which were
+	 * calculated by Build().
+	 */
+	const DatabaseStats &GetStats() const noexcept {
+		return stats;
+	}
+
+	void ForEachUnindexed(const std::function<void(const Song &)> &f) const {
+		for (const uint32_t i : unindexed)
+			f(*songs[i]);
+	}
+
+	/**
+	 * Can ForEachByTime() sort by this attribute?
+	 */
+	static constexpr bool CanSortByTime(TagType sort) noexcept {
+		return sort == TagType(SORT_TAG_LAST_MODIFIED) ||
+			sort == TagType(SORT_TAG_ADDED);
+	}
+
+	/**
+	 * Invoke a function for each song in the order of the given
+	 * time stamp attribute (see CanSortByTime()), ties in tree
+	 * order, until the function returns false.  If the filter
+	 * has a "modified-since" or "added-since" item for this
+	 * attribute, only the songs in this range are passed.  The
+	 * caller still needs to apply the filter.  Songs returned by
+	 * ForEachUnindexed() are not considered.
+	 */
+	void ForEachByTime(TagType sort, bool descending,
+			   const SongFilter *filter,
+			   const std::function<bool(const Song &)> &f) const;
+
+private:
+	/**
+	 * @return false if a mount point was found
+	 */
+	bool Add(const Directory &directory, bool hide_playlist_targets);
+
+	/**
+	 * @param masks a bit mask of tag types present in each song
+	 */
+	void Build(TagType type, const std::vector<uint_least64_t> &masks);
+
+	/**
+	 * Count the distinct values of the given tag type like
+	 * ::GetStats() does: without fallback and without the empty
+	 * string.  Only valid for types without fallback.
+	 */
+	[[gnu::pure]]
+	unsigned CountDistinct(TagType type) const;
+
+	void BuildStats();
+
+	void BuildTimes();
+
+	[[gnu::pure]]
+	std::span<const TimeEntry> GetTimes(TagType sort) const noexcept {
+		return sort == TagType(SORT_TAG_ADDED) ? by_added : by_mtime;
+	}
+
+	/**
+	 * If this is a "modified-since" or "added-since" filter,
+	 * return the range of songs matching it.
+	 */
+	[[gnu::pure]]
+	std::optional<std::span<const TimeEntry>> FindTimeRange(const ISongFilter &filter) const noexcept;
+
+	[[gnu::pure]]
+	static bool CanUse(const TagSongFilter &filter) noexcept;
+
+#ifdef HAVE_ICU_CANONICALIZE
+	static const FoldedIndex &GetFolded(const TagTypeIndex &t,
+					    bool fold_case,
+					    bool strip_diacritics);
+
+	/**
+	 * Find all values matching a case-insensitive filter.
+	 */
+	static void FindFolded(const TagTypeIndex &t,
+			       const StringFilter &filter,
+			       std::vector<ValueMatch> &matches);
+#endif
+
+	/**
+	 * Find all values of the given tag type matching the filter.
+	 */
+	static void FindValues(const TagTypeIndex &t,
+			       const StringFilter &filter,
+			       std::vector<ValueMatch> &matches);
+
+	/**
+	 * Find all values matching the given filter (of all tag
+	 * types if its type is "any").
+	 *
+	 * @return the number of postings of the values
+	 */
+	std::size_t FindValues(const TagSongFilter &filter,
+			       std::vector<ValueMatch> &matches) const;
+
+	static void Collect(const std::vector<ValueMatch> &matches,
+			    std::vector<uint32_t> &result);
+};
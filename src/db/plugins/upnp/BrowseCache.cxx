@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "BrowseCache.hxx"
+#include "Directory.hxx"
+#include "thread/Name.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+static constexpr Domain upnp_cache_domain("upnp_cache");
+
+/**
+ * The "SystemUpdateID" of a server is queried at most this often.
+ */
+static constexpr std::chrono::steady_clock::duration UPDATE_ID_INTERVAL =
+	std::chrono::seconds(5);
+
+/**
+ * The maximum number of child containers scheduled for prefetching
+ * per listed directory.
+ */
+static constexpr std::size_t MAX_PREFETCH_CHILDREN = 32;
+
+/**
+ * The maximum number of pending prefetch requests.
+ */
+static constexpr std::size_t MAX_QUEUE_SIZE = 256;
+
+/**
+ * If a server has more cached containers, expired ones are removed.
+ */
+static constexpr std::size_t MAX_ENTRIES = 4096;
+
+UpnpBrowseCache::UpnpBrowseCache(UpnpClient_Handle _handle,
+				 Clock::duration _ttl)
+	:handle(_handle), ttl(_ttl)
+{
+	thread.Start();
+}
+
+UpnpBrowseCache::~UpnpBrowseCache() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		queue.clear();
+		quit = true;
+	}
+
+	cond.notify_one();
+	thread.Join();
+}
+
+inline void
+UpnpBrowseCache::CheckUpdateID(std::unique_lock<Mutex> &lock,
+			       const ContentDirectoryService &server,
+			       Server &s, Clock::time_point now) noexcept
+{
+	if (now < s.next_update_id_check)
+		return;
+
+	/* don't let other callers query it concurrently */
+	s.next_update_id_check = now + UPDATE_ID_INTERVAL;
+
+	std::optional<unsigned> update_id;
+
+	lock.unlock();
+
+	try {
+		update_id = server.getSystemUpdateID(handle);
+	} catch (...) {
+		/* not implemented by this server; rely on the TTL
+		   only */
+		Log(LogLevel::DEBUG, std::current_exception(),
+		    "GetSystemUpdateID failed");
+	}
+
+	lock.lock();
+
+	if (!update_id) {
+		s.update_id.reset();
+		s.next_update_id_check = now + std::max(ttl, UPDATE_ID_INTERVAL);
+		return;
+	}
+
+	if (s.update_id && *s.update_id != *update_id) {
+		FmtDebug(upnp_cache_domain,
+			 "SystemUpdateID of {:?} has changed",
+			 server.GetFriendlyName());
+		s.entries.clear();
+		++s.generation;
+	}
+
+	s.update_id = update_id;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpBrowseCache::Load(std::unique_lock<Mutex> &lock,
+		      const ContentDirectoryService &server,
+		      Server &s, const char *object_id)
+{
+	const unsigned generation = s.generation;
+
+	lock.unlock();
+
+	std::shared_ptr<const UPnPDirContent> content;
+	try {
+		content = std::make_shared<const UPnPDirContent>(server.readDir(handle, object_id));
+	} catch (...) {
+		lock.lock();
+		throw;
+	}
+
+	const auto now = Clock::now();
+
+	lock.lock();
+
+	if (s.generation != generation)
+		/* the server has changed meanwhile; don't store this
+		   result */
+		return content;
+
+	if (s.entries.size() >= MAX_ENTRIES) {
+		std::erase_if(s.entries, [now](const auto &i){
+			return now >= i.second.expires;
+		});
+
+		if (s.entries.size() >= MAX_ENTRIES)
+			s.entries.clear();
+	}
+
+	s.entries.insert_or_assign(object_id, Entry{content, now + ttl});
+	return content;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpBrowseCache::ReadDir(const ContentDirectoryService &server,
+			 const char *object_id)
+{
+	const auto now = Clock::now();
+
+	std::unique_lock lock{mutex};
+
+	Server &s = servers.try_emplace(server.GetURI()).first->second;
+	CheckUpdateID(lock, server, s, now);
+
+	if (auto i = s.entries.find(object_id);
+	    i != s.entries.end() && now < i->second.expires) {
+		if (i->second.expires - now < ttl / 4)
+			/* about to expire: refresh it in the
+			   background */
+			Enqueue(server, std::string{object_id});
+
+		return i->second.content;
+	}
+
+	return Load(lock, server, s, object_id);
+}
+
+inline void
+UpnpBrowseCache::Enqueue(const ContentDirectoryService &server,
+			 std::string &&object_id) noexcept
+{
+	if (queue.size() >= MAX_QUEUE_SIZE)
+		return;
+
+	queue.push_back({server, std::move(object_id)});
+	cond.notify_one();
+}
+
+void
+UpnpBrowseCache::Prefetch(const ContentDirectoryService &server,
+			  const UPnPDirContent &content) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto &entries = servers.try_emplace(server.GetURI()).first->second.entries;
+
+	std::size_t n = 0;
+	for (const auto &i : content.objects) {
+		if (i.type != UPnPDirObject::Type::CONTAINER ||
+		    entries.contains(i.id))
+			continue;
+
+		Enqueue(server, std::string{i.id});
+
+		if (++n >= MAX_PREFETCH_CHILDREN)
+			break;
+	}
+}
+
+void
+UpnpBrowseCache::Run() noexcept
+{
+	SetThreadName("upnp_cache");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{
+			return quit || !queue.empty();
+		});
+
+		if (quit)
+			break;
+
+		Request request = std::move(queue.front());
+		queue.pop_front();
+
+		const auto now = Clock::now();
+		Server &s = servers.try_emplace(request.server.GetURI()).first->second;
+
+		/* skip the request if the entry has been loaded
+		   (or refreshed) meanwhile */
+		if (auto i = s.entries.find(request.object_id);
+		    i != s.entries.end() && i->second.expires - now >= ttl / 4)
+			continue;
+
+		try {
+			Load(lock, request.server, s,
+			     request.object_id.c_str());
+		} catch (...) {
+			Log(LogLevel::DEBUG, std::current_exception(),
+			    "Failed to prefetch UPnP container");
+		}
+	}
+}
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "lib/upnp/ContentDirectoryService.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <upnp.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+
+class UPnPDirContent;
+
+/**
+ * A cache for the results of "Browse" requests (i.e. the children
+ * of a container) of all UPnP media servers.
+ *
+ * Entries expire after a configurable time; additionally, all
+ * entries of a server are discarded as soon as its "SystemUpdateID"
+ * changes.  Entries which are about to expire are refreshed in the
+ * background, and the child containers of a directory which was
+ * listed are prefetched, because a client is likely to descend into
+ * them next.
+ */
+class UpnpBrowseCache {
+	using Clock = std::chrono::steady_clock;
+
+	const UpnpClient_Handle handle;
+
+	/**
+	 * The lifetime of each entry.
+	 */
+	const Clock::duration ttl;
+
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	Mutex mutex;
+
+	/**
+	 * Signals the prefetch thread that there is new work.
+	 */
+	Cond cond;
+
+	struct Entry {
+		std::shared_ptr<const UPnPDirContent> content;
+
+		Clock::time_point expires;
+	};
+
+	struct Server {
+		/**
+		 * The cached containers by object id.
+		 */
+		std::map<std::string, Entry, std::less<>> entries;
+
+		/**
+		 * The last known "SystemUpdateID" (if the server
+		 * implements it).
+		 */
+		std::optional<unsigned> update_id;
+
+		/**
+		 * When shall the "SystemUpdateID" be queried again?
+		 */
+		Clock::time_point next_update_id_check = Clock::time_point::min();
+
+		/**
+		 * Incremented each time #entries is cleared; a result
+		 * which was requested before that is not stored.
+		 */
+		unsigned generation = 0;
+	};
+
+	/**
+	 * All servers by ContentDirectoryService::GetURI().
+	 * Protected by #mutex.
+	 */
+	std::map<std::string, Server, std::less<>> servers;
+
+	struct Request {
+		ContentDirectoryService server;
+
+		std::string object_id;
+	};
+
+	/**
+	 * Containers to be read by the prefetch thread.  Protected by
+	 * #mutex.
+	 */
+	std::deque<Request> queue;
+
+	/**
+	 * Shall the prefetch thread exit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+public:
+	/**
+	 * Throws on error (if the thread cannot be created).
+	 */
+	UpnpBrowseCache(UpnpClient_Handle _handle, Clock::duration _ttl);
+	~UpnpBrowseCache() noexcept;
+
+	UpnpBrowseCache(const UpnpBrowseCache &) = delete;
+	UpnpBrowseCache &operator=(const UpnpBrowseCache &) = delete;
+
+	/**
+	 * Return the children of the specified container, either
+	 * from the cache or from the server.
+	 *
+	 * Throws on error.
+	 */
+	std::shared_ptr<const UPnPDirContent> ReadDir(const ContentDirectoryService &server,
+						      const char *object_id);
+
+	/**
+	 * Schedule reading the child containers of the given
+	 * (cached) directory in the background.
+	 */
+	void Prefetch(const ContentDirectoryService &server,
+		      const UPnPDirContent &content) noexcept;
+
+private:
+	/**
+	 * Query the "SystemUpdateID" if it has not been checked for
+	 * a while, and discard the cache of this server if it has
+	 * changed.
+	 *
+	 * Caller must lock the #mutex; it is released while the
+	 * request is pending.
+	 */
+	void CheckUpdateID(std::unique_lock<Mutex> &lock,
+			   const ContentDirectoryService &server,
+			   Server &s, Clock::time_point now) noexcept;
+
+	/**
+	 * Read a container from the server and store it in the
+	 * cache.
+	 *
+	 * Caller must lock the #mutex; it is released while the
+	 * request is pending.
+	 */
+	std::shared_ptr<const UPnPDirContent> Load(std::unique_lock<Mutex> &lock,
+						   const ContentDirectoryService &server,
+						   Server &s,
+						   const char *object_id);
+
+	/**
+	 * Add a request to the prefetch #queue.  Caller must lock the
+	 * #mutex.
+	 */
+	void Enqueue(const ContentDirectoryService &server,
+		     std::string &&object_id) noexcept;
+
+	void Run() noexcept;
+};
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "UpnpDatabasePlugin.hxx"
+#include "BrowseCache.hxx"
 #include "Directory.hxx"
 #include "Tags.hxx"
 #include "lib/upnp/ClientInit.hxx"
@@ -27,6 +28,7 @@
 #include <fmt/core.h>
 
 #include <cassert>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -76,16 +78,27 @@ class UpnpDatabase : public Database {
 
 	const char* iface;
 
+	/**
+	 * The lifetime of #browse_cache entries; zero disables the
+	 * cache.
+	 */
+	const std::chrono::steady_clock::duration cache_ttl;
+
+	std::unique_ptr<UpnpBrowseCache> browse_cache;
+
 public:
-	explicit UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block) noexcept
+	explicit UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block)
 		:Database(upnp_db_plugin),
 		 event_loop(_event_loop),
-		 iface(block.GetBlockValue("interface", nullptr)) {}
+		 iface(block.GetBlockValue("interface", nullptr)),
+		 cache_ttl(block.GetDuration("cache_ttl",
+					     std::chrono::seconds(0),
+					     std::chrono::minutes(5))) {}
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
 				  DatabaseListener &listener,
-				  const ConfigBlock &block) noexcept;
+				  const ConfigBlock &block);
 
 	void Open() override;
 	void Close() noexcept override;
@@ -127,6 +140,13 @@ private:
 				   const char *objid,
 				   const DatabaseSelection &selection) const;
 
+	/**
+	 * Read the children of a container, using the
+	 * #browse_cache if enabled.
+	 */
+	std::shared_ptr<const UPnPDirContent> ReadDir(const ContentDirectoryService &server,
+						      const char *objid) const;
+
 	UPnPDirObject Namei(const ContentDirectoryService &server,
 			    std::string_view uri) const;
 
@@ -148,7 +168,7 @@ private:
 DatabasePtr
 UpnpDatabase::Create(EventLoop &, EventLoop &io_event_loop,
 		     [[maybe_unused]] DatabaseListener &listener,
-		     const ConfigBlock &block) noexcept
+		     const ConfigBlock &block)
 {
 	return std::make_unique<UpnpDatabase>(io_event_loop, block);;
 }
@@ -161,6 +181,10 @@ UpnpDatabase::Open()
 	discovery = new UPnPDeviceDirectory(event_loop, handle);
 	try {
 		discovery->Start();
+
+		if (cache_ttl > std::chrono::steady_clock::duration::zero())
+			browse_cache = std::make_unique<UpnpBrowseCache>(handle,
+									 cache_ttl);
 	} catch (...) {
 		delete discovery;
 		UpnpClientGlobalFinish();
@@ -171,6 +195,7 @@ UpnpDatabase::Open()
 void
 UpnpDatabase::Close() noexcept
 {
+	browse_cache.reset();
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
@@ -397,6 +422,16 @@ UpnpDatabase::BuildPath(const ContentDirectoryService &server,
 	return PathTraitsUTF8::Build(server.GetFriendlyName(), path);
 }
 
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid) const
+{
+	if (browse_cache)
+		return browse_cache->ReadDir(server, objid);
+
+	return std::make_shared<const UPnPDirContent>(server.readDir(handle, objid));
+}
+
 // Take server and internal title pathname and return objid and metadata.
 UPnPDirObject
 UpnpDatabase::Namei(const ContentDirectoryService &server,
@@ -410,25 +445,25 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	while (true) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		const auto dirbuf = ReadDir(server, objid.c_str());
 
 		const auto [name, rest] = Split(uri, '/');
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(name);
+		const UPnPDirObject *child = dirbuf->FindObject(name);
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		uri = rest;
 		if (uri.empty())
-			return std::move(*child);
+			return *child;
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -550,8 +585,14 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	const auto contents = server.readDir(handle, tdirent.id.c_str());
-	for (const auto &dirent : contents.objects) {
+	const auto contents = ReadDir(server, tdirent.id.c_str());
+
+	/* the client is likely to descend into one of the
+	   sub-containers next */
+	if (browse_cache && !selection.recursive)
+		browse_cache->Prefetch(server, *contents);
+
+	for (const auto &dirent : contents->objects) {
 		const std::string child_uri = PathTraitsUTF8::Build(base_uri,
 								    dirent.name.c_str());
 		VisitObject(dirent, child_uri.c_str(),
@@ -83,7 +83,8 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 					 "deleting unrecognized file {}/{}",
 					 directory.GetPath(), name);
 				editor.LockDeleteSong(directory, song);
-			}
+			} else
+				directory.MarkDirty();
 		}
 	}
 }
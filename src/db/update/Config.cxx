@@ -7,6 +7,9 @@
 
 UpdateConfig::UpdateConfig(const ConfigData &config)
 {
+	threads = config.GetUnsigned(ConfigOption::UPDATE_THREADS, 0);
+	paranoid = config.GetBool(ConfigOption::UPDATE_PARANOID, true);
+
 #ifndef _WIN32
 	follow_inside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_INSIDE_SYMLINKS,
@@ -15,7 +18,5 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
 }
@@ -15,6 +15,19 @@ struct UpdateConfig {
 	bool follow_outside_symlinks = DEFAULT_FOLLOW_OUTSIDE_SYMLINKS;
 #endif
 
+	/**
+	 * The number of threads which scan files; 0 means
+	 * automatic.
+	 */
+	unsigned threads = 0;
+
+	/**
+	 * List all directories?  If false, then directories whose
+	 * modification time is unchanged are not listed; only their
+	 * known subdirectories are checked.
+	 */
+	bool paranoid = true;
+
 	explicit UpdateConfig(const ConfigData &config);
 };
 
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Walk.hxx"
+#include "FileScanJob.hxx"
 #include "UpdateDomain.hxx"
 #include "song/DetachedSong.hxx"
 #include "db/DatabaseLock.hxx"
@@ -17,7 +18,8 @@
 bool
 UpdateWalk::UpdateContainerFile(Directory &directory,
 				std::string_view name, std::string_view suffix,
-				const StorageFileInfo &info) noexcept
+				const StorageFileInfo &info,
+				FileScanJob &job) noexcept
 {
 	const DecoderPlugin *_plugin = decoder_plugins_find([suffix](const DecoderPlugin &plugin){
 			return plugin.SupportsContainerSuffix(suffix);
@@ -37,7 +39,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 			return true;
 	}
 
-	const auto pathname = storage.MapFS(contdir->GetPath());
+	auto pathname = storage.MapFS(contdir->GetPath());
 	if (pathname.IsNull()) {
 		/* not a local file: skip, because the container API
 		   supports only local files */
@@ -45,36 +47,33 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		return false;
 	}
 
-	try {
-		auto v = plugin.container_scan(pathname);
-		if (v.empty()) {
-			editor.LockDeleteDirectory(contdir);
-			return false;
-		}
-
-		for (auto &vtrack : v) {
-			auto song = std::make_unique<Song>(std::move(vtrack),
-							   *contdir);
+	job.container_plugin = &plugin;
+	job.contdir = contdir;
+	job.container_path = std::move(pathname);
+	return false;
+}
 
-			// shouldn't be necessary but it's there..
-			song->mtime = info.mtime;
+void
+UpdateWalk::AddContainerSongs(Directory &contdir,
+			      std::forward_list<DetachedSong> &&tracks,
+			      const StorageFileInfo &info) noexcept
+{
+	for (auto &vtrack : tracks) {
+		auto song = std::make_unique<Song>(std::move(vtrack),
+						   contdir);
 
-			FmtNotice(update_domain, "added {}/{}",
-				  contdir->GetPath(),
-				  song->filename);
+		// shouldn't be necessary but it's there..
+		song->mtime = info.mtime;
 
-			{
-				const ScopeDatabaseLock protect;
-				contdir->AddSong(std::move(song));
-			}
+		FmtNotice(update_domain, "added {}/{}",
+			  contdir.GetPath(),
+			  song->filename);
 
-			modified = true;
+		{
+			const ScopeDatabaseLock protect;
+			contdir.AddSong(std::move(song));
 		}
-	} catch (...) {
-		LogError(std::current_exception());
-		editor.LockDeleteDirectory(contdir);
-		return false;
-	}
 
-	return true;
+		modified = true;
+	}
 }
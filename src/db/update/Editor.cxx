@@ -18,6 +18,11 @@ DatabaseEditor::DeleteSong(Directory &dir, Song *del)
 	/* first, prevent traversers in main task from getting this */
 	const SongPtr song = dir.RemoveSong(del);
 
+	/* postpone the removal (and keep the tags) until the end
+	   of the update, because the file might have been moved */
+	if (moves.Bury(*song))
+		return;
+
 	/* temporary unlock, because update_remove_song() blocks */
 	const ScopeDatabaseUnlock unlock;
 
@@ -71,6 +76,15 @@ DatabaseEditor::LockDeleteDirectory(Directory *directory)
 	DeleteDirectory(directory);
 }
 
+void
+DatabaseEditor::Finish() noexcept
+{
+	for (auto &uri : moves.TakeBuried())
+		remove.Remove(std::move(uri));
+
+	remove.Move(moves.TakeMoved());
+}
+
 bool
 DatabaseEditor::DeleteNameIn(Directory &parent, std::string_view name)
 {
@@ -91,7 +105,8 @@ DatabaseEditor::DeleteNameIn(Directory &parent, std::string_view name)
 		modified = true;
 	}
 
-	parent.playlists.erase(name);
+	if (parent.playlists.erase(name))
+		parent.MarkDirty();
 
 	return modified;
 }
@@ -5,6 +5,7 @@
 #define MPD_UPDATE_DATABASE_HXX
 
 #include "Remove.hxx"
+#include "Move.hxx"
 
 struct Directory;
 struct Song;
@@ -13,6 +14,12 @@ class DatabaseEditor final {
 	UpdateRemoveService remove;
 
 public:
+	/**
+	 * Songs deleted with DeleteSong() are held here until
+	 * Finish(), in case they have only been moved.
+	 */
+	UpdateMoveDetector moves;
+
 	DatabaseEditor(EventLoop &_loop, DatabaseListener &_listener)
 		:remove(_loop, _listener) {}
 
@@ -45,6 +52,14 @@ public:
 	 */
 	bool DeleteNameIn(Directory &parent, std::string_view name);
 
+	/**
+	 * The update is finished: remove all deleted songs which have
+	 * not reappeared and submit all detected moves.
+	 *
+	 * Caller must NOT lock the #db_mutex.
+	 */
+	void Finish() noexcept;
+
 private:
 	void ClearDirectory(Directory &directory);
 };
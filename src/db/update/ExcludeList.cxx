@@ -18,11 +18,11 @@
 #ifdef HAVE_CLASS_GLOB
 
 inline void
-ExcludeList::ParseLine(char *line) noexcept
+ExcludeList::ParseLine(GlobSet &set, char *line)
 {
 	char *p = Strip(line);
 	if (*p != 0 && *p != '#')
-		patterns.emplace_front(p);
+		set.Add(p);
 }
 
 #endif
@@ -33,9 +33,18 @@ ExcludeList::Load(InputStreamPtr is)
 #ifdef HAVE_CLASS_GLOB
 	TextInputStream tis(std::move(is));
 
+	/* compile a new set containing the inherited patterns and
+	   the ones from this file, so Check() doesn't need to walk
+	   up the directory tree */
+	auto set = patterns != nullptr
+		? std::make_shared<GlobSet>(*patterns)
+		: std::make_shared<GlobSet>();
+
 	char *line;
 	while ((line = tis.ReadLine()) != nullptr)
-		ParseLine(line);
+		ParseLine(*set, line);
+
+	patterns = std::move(set);
 #else
 	/* not implemented */
 	(void)is;
@@ -52,18 +61,12 @@ ExcludeList::Check(Path name_fs) const noexcept
 	/* XXX include full path name in check */
 
 #ifdef HAVE_CLASS_GLOB
-	if (parent != nullptr) {
-		if (parent->Check(name_fs)) {
-			return true;
-		}
-	}
+	if (IsEmpty())
+		return false;
 
-	for (const auto &i : patterns) {
-		try {
-			if (i.Check(NarrowPath(name_fs).c_str()))
-				return true;
-		} catch (...) {
-		}
+	try {
+		return patterns->Check(NarrowPath(name_fs).c_str());
+	} catch (...) {
 	}
 #else
 	/* not implemented */
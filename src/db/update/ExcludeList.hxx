@@ -9,34 +9,40 @@
 #ifndef MPD_EXCLUDE_H
 #define MPD_EXCLUDE_H
 
-#include "fs/Glob.hxx"
+#include "fs/GlobSet.hxx"
 #include "input/Ptr.hxx"
 #include "config.h"
 
 #ifdef HAVE_CLASS_GLOB
-#include <forward_list>
+#include <memory>
 #endif
 
 class Path;
 
 class ExcludeList {
-	const ExcludeList *const parent;
-
 #ifdef HAVE_CLASS_GLOB
-	std::forward_list<Glob> patterns;
+	/**
+	 * The compiled patterns of this list and all of its parents.
+	 * Directories without their own .mpdignore share the object
+	 * with their parent; it is never modified after it has been
+	 * published here.
+	 */
+	std::shared_ptr<const GlobSet> patterns;
 #endif
 
 public:
-	ExcludeList() noexcept
-		:parent(nullptr) {}
+	ExcludeList() noexcept = default;
 
-	ExcludeList(const ExcludeList &_parent) noexcept
-		:parent(&_parent) {}
+	/**
+	 * Construct an (initially empty) list for a subdirectory
+	 * which inherits all patterns of the parent's list.
+	 */
+	ExcludeList(const ExcludeList &_parent) noexcept = default;
 
 	[[gnu::pure]]
 	bool IsEmpty() const noexcept {
 #ifdef HAVE_CLASS_GLOB
-		return ((parent == nullptr) || parent->IsEmpty()) && patterns.empty();
+		return patterns == nullptr || patterns->empty();
 #else
 		/* not implemented */
 		return true;
@@ -57,7 +63,9 @@ public:
 	bool Check(Path name_fs) const noexcept;
 
 private:
-	void ParseLine(char *line) noexcept;
+#ifdef HAVE_CLASS_GLOB
+	static void ParseLine(GlobSet &set, char *line);
+#endif
 };
 
 
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FanotifyUpdate.hxx"
+#include "InotifyQueue.hxx"
+#include "InotifyDomain.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "lib/fmt/ToBuffer.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "Log.hxx"
+
+#include <algorithm> // for std::count()
+#include <array>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h> // for close()
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+
+static constexpr uint64_t FAN_MASK =
+	FAN_CLOSE_WRITE|FAN_CREATE|FAN_DELETE|FAN_MOVED_FROM|FAN_MOVED_TO|
+	FAN_ONDIR;
+
+static UniqueFileDescriptor
+CreateFanotify()
+{
+	int fd = fanotify_init(FAN_CLASS_NOTIF|FAN_REPORT_DFID_NAME|
+			       FAN_CLOEXEC|FAN_NONBLOCK,
+			       O_RDONLY|O_CLOEXEC|O_LARGEFILE);
+	if (fd < 0)
+		throw MakeErrno("fanotify_init() failed");
+
+	return UniqueFileDescriptor{AdoptTag{}, fd};
+}
+
+/**
+ * Determine the path of an open file descriptor.
+ */
+static AllocatedPath
+GetFileDescriptorPath(FileDescriptor fd) noexcept
+{
+	return ReadLink(Path::FromFS(FmtBuffer<32>("/proc/self/fd/{}",
+						   fd.Get())));
+}
+
+/* we don't look at "." / ".." nor files with newlines in their name */
+[[gnu::pure]]
+static bool
+SkipFilename(Path name) noexcept
+{
+	return PathTraitsFS::IsSpecialFilename(name.c_str()) ||
+		name.HasNewline();
+}
+
+[[gnu::pure]]
+static bool
+IsSymlinkAt(FileDescriptor directory_fd, const char *name) noexcept
+{
+	struct stat st;
+	return fstatat(directory_fd.Get(), name, &st,
+		       AT_SYMLINK_NOFOLLOW) == 0 &&
+		S_ISLNK(st.st_mode);
+}
+
+FanotifyUpdate::FanotifyUpdate(EventLoop &loop, InotifyQueue &_queue,
+			       Path _root, unsigned _max_depth)
+	:event(loop, BIND_THIS_METHOD(OnReady)),
+	 queue(_queue),
+	 root([_root, this]{
+		 if (!root_fd.Open(_root.c_str(), O_RDONLY|O_DIRECTORY))
+			 throw FmtErrno("Failed to open {}", _root);
+
+		 /* the canonical path, to be compared with the paths
+		    resolved from file handles */
+		 auto path = GetFileDescriptorPath(root_fd);
+		 if (path.IsNull())
+			 throw FmtErrno("Failed to resolve {}", _root);
+
+		 return path;
+	 }()),
+	 max_depth(_max_depth)
+{
+	auto fd = CreateFanotify();
+
+	/* one mark for the whole file system; events outside the
+	   music directory are filtered in OnEvent() */
+	if (fanotify_mark(fd.Get(), FAN_MARK_ADD|FAN_MARK_FILESYSTEM,
+			  FAN_MASK, AT_FDCWD, root.c_str()) < 0)
+		throw FmtErrno("fanotify_mark({:?}) failed", root);
+
+	event.Open(fd.Release());
+	event.ScheduleRead();
+}
+
+FanotifyUpdate::~FanotifyUpdate() noexcept
+{
+	event.Close();
+}
+
+bool
+FanotifyUpdate::ResolveDirectory(std::span<const std::byte> handle,
+				 UniqueFileDescriptor &directory_fd,
+				 PathTraitsFS::string &relative) const noexcept
+{
+	/* open_by_handle_at() wants a writable pointer, but it
+	   doesn't modify the handle */
+	auto *fh = const_cast<struct file_handle *>(reinterpret_cast<const struct file_handle *>(handle.data()));
+
+	const int fd = open_by_handle_at(root_fd.Get(), fh,
+					 O_PATH|O_DIRECTORY|O_CLOEXEC);
+	if (fd < 0)
+		/* ESTALE: the directory has been deleted already;
+		   its parent receives an event, too */
+		return false;
+
+	directory_fd = UniqueFileDescriptor{AdoptTag{}, fd};
+
+	const auto path = GetFileDescriptorPath(directory_fd);
+	if (path.IsNull())
+		return false;
+
+	const char *r = root.Relative(path);
+	if (r == nullptr)
+		/* outside of the music directory */
+		return false;
+
+	relative = r;
+	return true;
+}
+
+inline void
+FanotifyUpdate::OnEvent(uint64_t mask,
+			std::span<const std::byte> info) noexcept
+{
+	/* look for the "DFID_NAME" record: the file handle of the
+	   parent directory followed by the entry name */
+	const struct fanotify_event_info_fid *fid = nullptr;
+	while (info.size() >= sizeof(struct fanotify_event_info_header)) {
+		const auto &header = *reinterpret_cast<const struct fanotify_event_info_header *>(info.data());
+		if (header.len < sizeof(header) || header.len > info.size())
+			return;
+
+		if (header.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME &&
+		    header.len >= sizeof(*fid) + sizeof(struct file_handle)) {
+			fid = reinterpret_cast<const struct fanotify_event_info_fid *>(info.data());
+			info = info.first(header.len).subspan(sizeof(*fid));
+			break;
+		}
+
+		info = info.subspan(header.len);
+	}
+
+	if (fid == nullptr)
+		return;
+
+	const auto &fh = *reinterpret_cast<const struct file_handle *>(info.data());
+	const std::size_t handle_size = sizeof(fh) + fh.handle_bytes;
+	if (handle_size >= info.size())
+		return;
+
+	const auto name_buffer = info.subspan(handle_size);
+	const char *name = reinterpret_cast<const char *>(name_buffer.data());
+	if (memchr(name, 0, name_buffer.size()) == nullptr)
+		return;
+
+	const Path name_fs = Path::FromFS(name);
+	if (SkipFilename(name_fs))
+		return;
+
+	UniqueFileDescriptor directory_fd;
+	PathTraitsFS::string directory;
+	if (!ResolveDirectory(info.first(handle_size), directory_fd,
+			      directory))
+		return;
+
+	const unsigned depth = directory.empty()
+		? 0
+		: 1 + std::count(directory.begin(), directory.end(),
+				 PathTraitsFS::SEPARATOR);
+	if (depth > max_depth)
+		return;
+
+	if ((mask & FAN_MASK) == FAN_CREATE &&
+	    !IsSymlinkAt(directory_fd, name))
+		/* a regular file has usable content only after
+		   FAN_CLOSE_WRITE (which the kernel may merge into
+		   this event); this check is only interesting for
+		   symlinks */
+		return;
+
+	const auto uri_fs = directory.empty()
+		? AllocatedPath{name_fs}
+		: AllocatedPath::FromFS(std::move(directory)) / name_fs;
+
+	const std::string uri_utf8 = uri_fs.ToUTF8();
+	if (!uri_utf8.empty())
+		queue.Enqueue(uri_utf8.c_str());
+}
+
+void
+FanotifyUpdate::OnReady(unsigned) noexcept
+try {
+	alignas(struct fanotify_event_metadata)
+		std::array<std::byte, 8192> buffer;
+
+	ssize_t nbytes = event.GetFileDescriptor().Read(buffer);
+	if (nbytes <= 0) [[unlikely]] {
+		if (nbytes == 0)
+			throw std::runtime_error{"EOF from fanotify"};
+
+		const int e = errno;
+		if (e == EAGAIN)
+			return;
+
+		throw MakeErrno(e, "Reading fanotify failed");
+	}
+
+	int remaining = nbytes;
+	for (auto *m = reinterpret_cast<const struct fanotify_event_metadata *>(buffer.data());
+	     FAN_EVENT_OK(m, remaining); m = FAN_EVENT_NEXT(m, remaining)) {
+		if (m->vers != FANOTIFY_METADATA_VERSION) [[unlikely]]
+			throw std::runtime_error{"Unsupported fanotify metadata version"};
+
+		if (m->fd >= 0)
+			/* not used with FAN_REPORT_DFID_NAME */
+			close(m->fd);
+
+		if (m->mask & FAN_Q_OVERFLOW) {
+			LogWarning(inotify_domain,
+				   "fanotify queue overflow, updating everything");
+			queue.Enqueue("");
+			continue;
+		}
+
+		const auto *p = reinterpret_cast<const std::byte *>(m);
+		OnEvent(m->mask, {p + m->metadata_len, p + m->event_len});
+	}
+} catch (...) {
+	event.Close();
+	LogError(std::current_exception(),
+		 "Cannot watch the music directory anymore");
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/PipeEvent.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Traits.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <span>
+
+class Path;
+class InotifyQueue;
+
+/**
+ * Watches the whole file system containing the music directory with
+ * one fanotify mark (FAN_MARK_FILESYSTEM, Linux 5.9 or later) and
+ * passes changed paths to the #InotifyQueue.  Unlike #InotifyUpdate,
+ * this needs no watch per directory, but it requires the
+ * CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH capabilities.
+ *
+ * The kernel reports the file handle of the parent directory and the
+ * name of each changed entry; file handles are resolved to paths
+ * only for these entries.
+ */
+class FanotifyUpdate final {
+	PipeEvent event;
+
+	InotifyQueue &queue;
+
+	/**
+	 * The music directory (opened read-only); used for
+	 * open_by_handle_at().
+	 */
+	UniqueFileDescriptor root_fd;
+
+	/**
+	 * The canonical absolute path of the music directory.
+	 */
+	const AllocatedPath root;
+
+	const unsigned max_depth;
+
+public:
+	/**
+	 * Throws on error, e.g. if the kernel is too old or this
+	 * process lacks the required capabilities.
+	 */
+	FanotifyUpdate(EventLoop &loop, InotifyQueue &_queue,
+		       Path _root, unsigned _max_depth);
+
+	~FanotifyUpdate() noexcept;
+
+	FanotifyUpdate(const FanotifyUpdate &) = delete;
+	FanotifyUpdate &operator=(const FanotifyUpdate &) = delete;
+
+private:
+	/**
+	 * Resolve a directory file handle to its path relative to
+	 * the music directory.
+	 *
+	 * @param relative receives the relative path (empty for the
+	 * music directory itself)
+	 * @return false if the directory is outside the music
+	 * directory (or cannot be resolved)
+	 */
+	bool ResolveDirectory(std::span<const std::byte> handle,
+			      UniqueFileDescriptor &directory_fd,
+			      PathTraitsFS::string &relative) const noexcept;
+
+	void OnEvent(uint64_t mask, std::span<const std::byte> info) noexcept;
+
+	/* PipeEvent callback */
+	void OnReady(unsigned flags) noexcept;
+};
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Walk.hxx"
+#include "song/DetachedSong.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/FileInfo.hxx"
+#include "fs/AllocatedPath.hxx"
+
+#include <forward_list>
+#include <string>
+
+struct DecoderPlugin;
+
+/**
+ * Scans one song file or container file (in a worker thread) and
+ * adds or updates the database entries (in the update thread).
+ */
+class UpdateWalk::FileScanJob final : public UpdateScanPool::Job {
+	UpdateWalk &walk;
+
+	Directory &directory;
+
+	const std::string name;
+
+	const StorageFileInfo info;
+
+	/**
+	 * The existing song object, or nullptr if this is a new
+	 * file.  It has been marked already, so it will not be
+	 * purged while this job is pending.
+	 */
+	Song *const song;
+
+public:
+	/**
+	 * If this is a container file: the container plugin, the
+	 * new virtual directory and its local path.  Set up by
+	 * UpdateWalk::UpdateContainerFile().
+	 */
+	const DecoderPlugin *container_plugin = nullptr;
+	Directory *contdir = nullptr;
+	AllocatedPath container_path = nullptr;
+
+private:
+	/* the results of Run() */
+	std::forward_list<DetachedSong> tracks;
+	SongPtr new_song;
+
+public:
+	FileScanJob(UpdateWalk &_walk, Directory &_directory,
+		    std::string_view _name, const StorageFileInfo &_info,
+		    Song *_song) noexcept
+		:walk(_walk), directory(_directory), name(_name),
+		 info(_info), song(_song) {}
+
+	/* virtual methods from class UpdateScanPool::Job */
+	void Run() noexcept override;
+	void Finish() noexcept override;
+
+private:
+	void FinishSong() noexcept;
+};
@@ -5,11 +5,14 @@
 #include "InotifyDomain.hxx"
 #include "Service.hxx"
 #include "UpdateDomain.hxx"
+#include "event/Loop.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "protocol/Ack.hxx" // for class ProtocolError
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 /**
  * Wait this long after the last change before calling
  * UpdateService::Enqueue().  This increases the probability that
@@ -18,39 +21,45 @@
 static constexpr Event::Duration INOTIFY_UPDATE_DELAY =
 	std::chrono::seconds(5);
 
+/**
+ * Don't let a steady stream of changes (e.g. copying a large
+ * collection) postpone the update longer than this after the first
+ * change.
+ */
+static constexpr Event::Duration INOTIFY_UPDATE_MAX_DELAY =
+	std::chrono::minutes(1);
+
 void
 InotifyQueue::OnDelay() noexcept
 {
-	unsigned id;
+	if (queue.empty())
+		return;
 
-	while (!queue.empty()) {
-		const char *uri_utf8 = queue.front().c_str();
+	unsigned id;
 
+	try {
 		try {
-			try {
-				id = update.Enqueue(uri_utf8, false);
-			} catch (const ProtocolError &e) {
-				if (e.GetCode() == ACK_ERROR_UPDATE_ALREADY) {
-					/* retry later */
-					delay_event.Schedule(INOTIFY_UPDATE_DELAY);
-					return;
-				}
-
-				throw;
+			id = update.Enqueue(queue);
+		} catch (const ProtocolError &e) {
+			if (e.GetCode() == ACK_ERROR_UPDATE_ALREADY) {
+				/* retry later */
+				delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+				return;
 			}
-		} catch (...) {
-			FmtError(update_domain,
-				 "Failed to enqueue {:?}: {}",
-				 uri_utf8, std::current_exception());
-			queue.pop_front();
-			continue;
+
+			throw;
 		}
+	} catch (...) {
+		FmtError(update_domain, "Failed to enqueue: {}",
+			 std::current_exception());
+		queue.clear();
+		return;
+	}
 
-		FmtDebug(inotify_domain, "updating {:?} job={}",
-			 uri_utf8, id);
+	FmtDebug(inotify_domain, "updating {} directories job={}",
+		 queue.size(), id);
 
-		queue.pop_front();
-	}
+	queue.clear();
 }
 
 [[gnu::pure]]
@@ -68,7 +77,16 @@ path_in(const char *path, const char *possible_parent) noexcept
 void
 InotifyQueue::Enqueue(const char *uri_utf8) noexcept
 {
-	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+	const auto now = delay_event.GetEventLoop().SteadyNow();
+	if (queue.empty())
+		first_time = now;
+
+	/* wait until the changes have been quiet for a while, but
+	   not beyond the maximum delay */
+	const auto deadline = first_time + INOTIFY_UPDATE_MAX_DELAY;
+	delay_event.Schedule(std::clamp(deadline - now,
+					Event::Duration::zero(),
+					INOTIFY_UPDATE_DELAY));
 
 	for (auto i = queue.begin(), end = queue.end(); i != end;) {
 		const char *current_uri = i->c_str();
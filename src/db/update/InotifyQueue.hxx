@@ -6,18 +6,34 @@
 
 #include "event/CoarseTimerEvent.hxx"
 
-#include <list>
 #include <string>
+#include <vector>
 
 class UpdateService;
 
+/**
+ * Collects the directories reported by #InotifyUpdate and passes
+ * them to the #UpdateService as one batch after they have been quiet
+ * for a while.
+ */
 class InotifyQueue final {
 	UpdateService &update;
 
-	std::list<std::string> queue;
+	/**
+	 * The modified directories; none of them is inside another
+	 * one.
+	 */
+	std::vector<std::string> queue;
 
 	CoarseTimerEvent delay_event;
 
+	/**
+	 * When was the first path of the current batch enqueued?
+	 * This limits how long a steady stream of events can
+	 * postpone the update.
+	 */
+	Event::TimePoint first_time;
+
 public:
 	InotifyQueue(EventLoop &_loop, UpdateService &_update) noexcept
 		:update(_update),
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright The Music Player Daemon Project
 
+#include "config.h"
 #include "InotifyUpdate.hxx"
 #include "InotifyDomain.hxx"
 #include "ExcludeList.hxx"
@@ -18,6 +19,7 @@
 #include "thread/Mutex.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/IntrusiveList.hxx"
+#include "FanotifyUpdate.hxx"
 #include "Log.hxx"
 
 #include <cassert>
@@ -212,6 +214,22 @@ InotifyUpdate::~InotifyUpdate() noexcept = default;
 inline void
 InotifyUpdate::Start(Path path)
 {
+#ifdef ENABLE_FANOTIFY
+	/* one fanotify mark is much cheaper than one inotify watch
+	   per directory, but it needs privileges */
+	try {
+		fanotify = std::make_unique<FanotifyUpdate>(inotify_manager.GetEventLoop(),
+							    queue, path,
+							    max_depth);
+		LogDebug(inotify_domain, "watching music directory with fanotify");
+		return;
+	} catch (...) {
+		FmtDebug(inotify_domain,
+			 "fanotify not available, using inotify: {}",
+			 std::current_exception());
+	}
+#endif
+
 	root = std::make_unique<Directory>(inotify_manager, queue, path, max_depth);
 	root->AddWatch(path.c_str(), IN_MASK);
 	root->LoadExcludeList(path);
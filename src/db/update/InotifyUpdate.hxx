@@ -10,6 +10,7 @@
 
 class Path;
 class Storage;
+class FanotifyUpdate;
 
 /**
  * Glue code between InotifySource and InotifyQueue.
@@ -23,6 +24,12 @@ class InotifyUpdate final {
 	class Directory;
 	std::unique_ptr<Directory> root;
 
+	/**
+	 * If this is set, then the whole music directory is watched
+	 * with one fanotify mark, and #root is not used.
+	 */
+	std::unique_ptr<FanotifyUpdate> fanotify;
+
 public:
 	InotifyUpdate(EventLoop &loop, UpdateService &update,
 		      unsigned _max_depth);
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ListPool.hxx"
+#include "UpdateIO.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/Traits.hxx"
+#include "thread/Name.hxx"
+
+#include <cassert>
+#include <vector>
+
+/**
+ * List the directory and obtain the #StorageFileInfo of each entry.
+ *
+ * Throws on error.
+ */
+static MemoryStorageDirectoryReader::List
+ListDirectory(Storage &storage, std::string_view uri)
+{
+	const auto reader = storage.OpenDirectory(uri);
+
+	MemoryStorageDirectoryReader::List entries;
+	auto tail = entries.before_begin();
+
+	const char *name;
+	while ((name = reader->Read()) != nullptr) {
+		StorageFileInfo info;
+		if (!GetInfo(*reader, info))
+			/* the walker handles this like a deleted
+			   file */
+			continue;
+
+		tail = entries.emplace_after(tail, name);
+		tail->info = info;
+	}
+
+	return entries;
+}
+
+UpdateListPool::UpdateListPool(Storage &_storage, unsigned n_threads)
+	:storage(_storage), max_pending(n_threads * 8)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_front(BIND_THIS_METHOD(RunWorker)).Start();
+	} catch (...) {
+		StopThreads();
+		throw;
+	}
+}
+
+UpdateListPool::~UpdateListPool() noexcept
+{
+	StopThreads();
+}
+
+void
+UpdateListPool::StopThreads() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+	}
+
+	work_cond.notify_all();
+
+	for (auto &i : threads)
+		if (i.IsDefined())
+			i.Join();
+
+	threads.clear();
+}
+
+UpdateListPool::RequestIterator
+UpdateListPool::Find(std::string_view uri) noexcept
+{
+	for (auto i = requests.begin(); i != requests.end(); ++i)
+		if (!i->abandoned && i->uri == uri)
+			return i;
+
+	return requests.end();
+}
+
+UpdateListPool::RequestIterator
+UpdateListPool::FindQueued() noexcept
+{
+	for (auto i = requests.end(); i != requests.begin();) {
+		--i;
+		if (i->state == Request::State::QUEUED)
+			return i;
+	}
+
+	return requests.end();
+}
+
+void
+UpdateListPool::Prefetch(std::string_view uri,
+			 const MemoryStorageDirectoryReader::List &entries) noexcept
+try {
+	if (requests.size() >= max_pending)
+		return;
+
+	std::vector<std::string> children;
+	for (const auto &i : entries) {
+		if (children.size() >= max_pending - requests.size())
+			break;
+
+		if (i.info.IsDirectory())
+			children.emplace_back(PathTraitsUTF8::Build(uri, i.name));
+	}
+
+	if (children.empty())
+		return;
+
+	/* queue in reverse order, because workers pick the most
+	   recently queued request; the first child shall be listed
+	   first */
+	for (auto i = children.rbegin(); i != children.rend(); ++i)
+		requests.emplace_back(std::move(*i), uri);
+
+	work_cond.notify_all();
+} catch (...) {
+	/* out of memory: don't prefetch */
+}
+
+std::unique_ptr<StorageDirectoryReader>
+UpdateListPool::OpenDirectory(std::string_view uri)
+{
+	std::unique_lock lock{mutex};
+
+	MemoryStorageDirectoryReader::List entries;
+
+	if (auto i = Find(uri); i != requests.end() &&
+	    i->state != Request::State::QUEUED) {
+		done_cond.wait(lock, [&i]{
+			return i->state == Request::State::DONE;
+		});
+
+		const auto error = std::move(i->error);
+		entries = std::move(i->entries);
+		requests.erase(i);
+
+		if (error)
+			std::rethrow_exception(error);
+	} else {
+		/* not prefetched (or not yet picked up by a worker):
+		   list it right here */
+		if (i != requests.end())
+			requests.erase(i);
+
+		lock.unlock();
+		entries = ListDirectory(storage, uri);
+		lock.lock();
+	}
+
+	Prefetch(uri, entries);
+
+	return std::make_unique<MemoryStorageDirectoryReader>(std::move(entries));
+}
+
+void
+UpdateListPool::Forget(std::string_view uri) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	for (auto i = requests.begin(); i != requests.end();) {
+		if (i->parent != uri) {
+			++i;
+		} else if (i->state == Request::State::RUNNING) {
+			i->abandoned = true;
+			++i;
+		} else
+			i = requests.erase(i);
+	}
+}
+
+void
+UpdateListPool::RunWorker() noexcept
+{
+	SetThreadName("update:list");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		work_cond.wait(lock, [this]{
+			return quit || FindQueued() != requests.end();
+		});
+
+		if (quit)
+			break;
+
+		const auto i = FindQueued();
+		i->state = Request::State::RUNNING;
+		const std::string uri = i->uri;
+
+		lock.unlock();
+
+		MemoryStorageDirectoryReader::List entries;
+		std::exception_ptr error;
+
+		try {
+			entries = ListDirectory(storage, uri);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		lock.lock();
+
+		if (i->abandoned) {
+			requests.erase(i);
+			continue;
+		}
+
+		i->entries = std::move(entries);
+		i->error = std::move(error);
+		i->state = Request::State::DONE;
+		done_cond.notify_all();
+	}
+}
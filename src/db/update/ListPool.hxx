@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "storage/MemoryDirectoryReader.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstdint>
+#include <exception>
+#include <forward_list>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+class Storage;
+
+/**
+ * Lists directories (Storage::OpenDirectory() and
+ * StorageDirectoryReader::GetInfo() for each entry) in worker
+ * threads ahead of the update walker.  On remote storages, each of
+ * these calls is a round trip, so the walk is latency bound unless
+ * several of them are in flight.
+ *
+ * Whenever the walker opens a directory, its subdirectories are
+ * queued; the workers pick the most recently queued one first, which
+ * approximates the depth-first order of the walk.  The walker
+ * remains the only thread which modifies the database.
+ */
+class UpdateListPool final {
+	Storage &storage;
+
+	struct Request {
+		/**
+		 * The URI of the directory to be listed.
+		 */
+		std::string uri;
+
+		/**
+		 * The URI of its parent directory (for Forget()).
+		 */
+		std::string parent;
+
+		enum class State : uint8_t {
+			QUEUED,
+			RUNNING,
+			DONE,
+		} state = State::QUEUED;
+
+		/**
+		 * Set by Forget() while a worker is listing it; the
+		 * worker shall delete the request.
+		 */
+		bool abandoned = false;
+
+		MemoryStorageDirectoryReader::List entries;
+
+		std::exception_ptr error;
+
+		Request(std::string &&_uri, std::string_view _parent) noexcept
+			:uri(std::move(_uri)), parent(_parent) {}
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up workers when a request was queued or when they
+	 * shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Wakes up the walker when a request is done.
+	 */
+	Cond done_cond;
+
+	/**
+	 * All requests which have not been taken by OpenDirectory()
+	 * yet, in the order they were queued.
+	 */
+	std::list<Request> requests;
+
+	/**
+	 * The maximum size of #requests; more subdirectories are not
+	 * prefetched, but listed by OpenDirectory() when the walker
+	 * gets there.
+	 */
+	const std::size_t max_pending;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	UpdateListPool(Storage &_storage, unsigned n_threads);
+
+	~UpdateListPool() noexcept;
+
+	UpdateListPool(const UpdateListPool &) = delete;
+	UpdateListPool &operator=(const UpdateListPool &) = delete;
+
+	/**
+	 * Like Storage::OpenDirectory(), but take the result of a
+	 * prefetch (waiting for it if a worker is still listing it)
+	 * or list it right now.  Then queue its subdirectories.
+	 *
+	 * Entries whose GetInfo() call failed are omitted (after
+	 * logging the error).
+	 *
+	 * Throws on error.
+	 */
+	std::unique_ptr<StorageDirectoryReader> OpenDirectory(std::string_view uri);
+
+	/**
+	 * Discard all prefetched subdirectories of the given
+	 * directory which have not been opened; call this after the
+	 * walker is finished with it.
+	 */
+	void Forget(std::string_view uri) noexcept;
+
+private:
+	using RequestIterator = std::list<Request>::iterator;
+
+	[[gnu::pure]]
+	RequestIterator Find(std::string_view uri) noexcept;
+
+	/**
+	 * Find the most recently queued request which has not been
+	 * picked up by a worker yet.
+	 */
+	[[gnu::pure]]
+	RequestIterator FindQueued() noexcept;
+
+	/**
+	 * Queue the subdirectories of the given listing (as many as
+	 * #max_pending allows).  Caller must lock the mutex.
+	 */
+	void Prefetch(std::string_view uri,
+		      const MemoryStorageDirectoryReader::List &entries) noexcept;
+
+	void StopThreads() noexcept;
+
+	void RunWorker() noexcept;
+};
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Move.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/FileInfo.hxx"
+#include "time/ChronoUtil.hxx"
+
+bool
+UpdateMoveDetector::IsEligible(const Song &song) noexcept
+{
+	return song.file_id != 0 && !IsNegative(song.mtime) &&
+		song.target.empty() && !song.parent.IsReallyAFile();
+}
+
+bool
+UpdateMoveDetector::Bury(Song &song) noexcept
+{
+	if (!IsEligible(song))
+		return false;
+
+	const Key key{song.file_id, song.mtime};
+
+	if (auto i = added.find(key); i != added.end()) {
+		/* the file has been scanned at its new location
+		   already */
+		Moved(song.GetURI(), std::move(i->second));
+		added.erase(i);
+		return true;
+	}
+
+	/* if there are two songs with the same key (hard links),
+	   only the first one can be matched */
+	return buried.try_emplace(key, song.GetURI(), std::move(song.tag),
+				  song.added, song.audio_format).second;
+}
+
+std::optional<BuriedSong>
+UpdateMoveDetector::Exhume(const StorageFileInfo &info,
+			   std::string &&new_uri) noexcept
+{
+	const uint64_t file_id = info.GetFileId();
+	if (file_id == 0 || IsNegative(info.mtime))
+		return std::nullopt;
+
+	const Key key{file_id, info.mtime};
+
+	auto i = buried.find(key);
+	if (i == buried.end()) {
+		added.insert_or_assign(key, std::move(new_uri));
+		return std::nullopt;
+	}
+
+	auto result = std::move(i->second);
+	buried.erase(i);
+
+	Moved(std::string{result.uri}, std::move(new_uri));
+	return result;
+}
+
+std::vector<std::string>
+UpdateMoveDetector::TakeBuried() noexcept
+{
+	std::vector<std::string> result;
+	result.reserve(buried.size());
+
+	for (auto &[key, song] : buried)
+		result.emplace_back(std::move(song.uri));
+
+	buried.clear();
+	return result;
+}
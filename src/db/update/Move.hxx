@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Tag.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Song;
+struct StorageFileInfo;
+
+/**
+ * The database attributes of a song file which has disappeared
+ * during the update; they are kept until the end of the update, in
+ * case the file shows up at another location.
+ */
+struct BuriedSong {
+	std::string uri;
+
+	Tag tag;
+
+	std::chrono::system_clock::time_point added;
+
+	AudioFormat audio_format;
+};
+
+/**
+ * Detects song files which have been moved or renamed during one
+ * database update, by matching the file identity (see
+ * StorageFileInfo::GetFileId()) and the modification time of deleted
+ * and new files.  Instead of rescanning the tags, the new database
+ * entry gets the attributes of the old one, and the stickers and
+ * queue items referring to the old URI are relinked to the new one.
+ *
+ * This object is only used by the update thread.
+ */
+class UpdateMoveDetector {
+	struct Key {
+		uint64_t file_id;
+		std::chrono::system_clock::time_point mtime;
+
+		constexpr auto operator<=>(const Key &) const noexcept = default;
+	};
+
+	/**
+	 * Songs which were deleted from the database, but have not
+	 * reappeared (yet).
+	 */
+	std::map<Key, BuriedSong> buried;
+
+	/**
+	 * New files which were scanned before the deletion of a
+	 * matching song was noticed.  The value is the new URI.
+	 */
+	std::map<Key, std::string> added;
+
+	/**
+	 * All moves detected so far: pairs of old and new URI.
+	 */
+	std::vector<std::pair<std::string, std::string>> moved;
+
+public:
+	/**
+	 * Can moves of this song be detected?  This is not supported
+	 * for songs without a known file identity, for virtual songs
+	 * (in playlists, archives and containers) and for symlink
+	 * targets.
+	 */
+	[[gnu::pure]]
+	static bool IsEligible(const Song &song) noexcept;
+
+	/**
+	 * A song is being deleted from the database.  If the file
+	 * has already reappeared somewhere else, this records the
+	 * move; else the song is kept in case the file reappears
+	 * later.  The #Tag is moved out of the #Song.
+	 *
+	 * @return false if the song is not eligible (and the caller
+	 * shall remove it immediately)
+	 */
+	bool Bury(Song &song) noexcept;
+
+	/**
+	 * A new file was found.  If it matches a buried song, its
+	 * attributes are returned and the move is recorded; else the
+	 * new URI is remembered for Bury().
+	 */
+	std::optional<BuriedSong> Exhume(const StorageFileInfo &info,
+					 std::string &&new_uri) noexcept;
+
+	/**
+	 * Record a move which was detected by the caller.
+	 */
+	void Moved(std::string &&old_uri, std::string &&new_uri) noexcept {
+		moved.emplace_back(std::move(old_uri), std::move(new_uri));
+	}
+
+	/**
+	 * Returns the URIs of all songs which have not reappeared
+	 * and clears the list.
+	 */
+	std::vector<std::string> TakeBuried() noexcept;
+
+	/**
+	 * Returns all moves and clears the list.
+	 */
+	std::vector<std::pair<std::string, std::string>> TakeMoved() noexcept {
+		added.clear();
+		return std::exchange(moved, {});
+	}
+};
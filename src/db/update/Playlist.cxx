@@ -109,8 +109,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.MarkDirty();
 		modified = true;
+	}
 
 	return true;
 }
@@ -139,7 +141,10 @@ UpdateWalk::PurgeDanglingFromPlaylists(Directory &directory) noexcept
 			} else {
 				/* the target exists: mark it (for
 				   option "hide_playlist_targets") */
-				target->in_playlist = true;
+				if (!target->in_playlist) {
+					target->in_playlist = true;
+					target->parent.MarkDirty();
+				}
 			}
 		}
 	});
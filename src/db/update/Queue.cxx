@@ -3,6 +3,37 @@
 
 #include "Queue.hxx"
 
+#include <algorithm>
+
+/**
+ * Is the given path equal to or inside the given parent?  The empty
+ * string is the root directory.
+ */
+[[gnu::pure]]
+static bool
+IsPathInside(std::string_view path, std::string_view parent) noexcept
+{
+	if (parent.empty())
+		return true;
+
+	return path.starts_with(parent) &&
+		(path.size() == parent.size() || path[parent.size()] == '/');
+}
+
+void
+UpdateQueueItem::AddPath(std::string_view path) noexcept
+{
+	for (const auto &i : paths)
+		if (IsPathInside(path, i))
+			return;
+
+	std::erase_if(paths, [path](const std::string &i){
+		return IsPathInside(i, path);
+	});
+
+	paths.emplace_back(path);
+}
+
 bool
 UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
 		  std::string_view path, bool discard, unsigned id) noexcept
@@ -14,6 +45,26 @@ UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
 	return true;
 }
 
+bool
+UpdateQueue::Push(UpdateQueueItem &&item) noexcept
+{
+	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
+		return false;
+
+	update_queue.emplace_back(std::move(item));
+	return true;
+}
+
+UpdateQueueItem *
+UpdateQueue::FindMergeable(SimpleDatabase &db, Storage &storage) noexcept
+{
+	for (auto &i : update_queue)
+		if (i.db == &db && i.storage == &storage && !i.discard)
+			return &i;
+
+	return nullptr;
+}
+
 UpdateQueueItem
 UpdateQueue::Pop() noexcept
 {
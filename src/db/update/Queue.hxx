@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <list>
+#include <vector>
 
 class SimpleDatabase;
 class Storage;
@@ -15,7 +16,12 @@ struct UpdateQueueItem {
 	SimpleDatabase *db;
 	Storage *storage;
 
-	std::string path_utf8;
+	/**
+	 * The paths to be updated by this job (all with one walk and
+	 * one database save); none of them is inside another one.
+	 */
+	std::vector<std::string> paths;
+
 	unsigned id;
 	bool discard;
 
@@ -25,7 +31,7 @@ struct UpdateQueueItem {
 			Storage &_storage,
 			std::string_view _path, bool _discard,
 			unsigned _id) noexcept
-		:db(&_db), storage(&_storage), path_utf8(_path),
+		:db(&_db), storage(&_storage), paths{std::string{_path}},
 		 id(_id), discard(_discard) {}
 
 	bool IsDefined() const noexcept {
@@ -35,6 +41,13 @@ struct UpdateQueueItem {
 	void Clear() noexcept {
 		id = 0;
 	}
+
+	/**
+	 * Add another path to this job, unless it is inside one of
+	 * the existing paths.  Existing paths inside the new one are
+	 * removed.
+	 */
+	void AddPath(std::string_view path) noexcept;
 };
 
 class UpdateQueue {
@@ -46,6 +59,17 @@ public:
 	bool Push(SimpleDatabase &db, Storage &storage,
 		  std::string_view path, bool discard, unsigned id) noexcept;
 
+	bool Push(UpdateQueueItem &&item) noexcept;
+
+	/**
+	 * Find a queued item for the given database and storage
+	 * which does not discard, i.e. one which more paths can be
+	 * added to.
+	 */
+	[[gnu::pure]]
+	UpdateQueueItem *FindMergeable(SimpleDatabase &db,
+				       Storage &storage) noexcept;
+
 	UpdateQueueItem Pop() noexcept;
 
 	void Clear() noexcept {
@@ -18,10 +18,12 @@ UpdateRemoveService::RunDeferred() noexcept
 	   callbacks */
 
 	std::forward_list<std::string> copy;
+	std::vector<std::pair<std::string, std::string>> moved_copy;
 
 	{
 		const std::lock_guard protect{mutex};
 		std::swap(uris, copy);
+		std::swap(moved, moved_copy);
 	}
 
 	for (const auto &uri : copy) {
@@ -29,6 +31,13 @@ UpdateRemoveService::RunDeferred() noexcept
 		listener.OnDatabaseSongRemoved(uri.c_str());
 	}
 
+	if (!moved_copy.empty()) {
+		for (const auto &[from, to] : moved_copy)
+			FmtNotice(update_domain, "moved {} to {}", from, to);
+
+		listener.OnDatabaseSongsMoved(moved_copy);
+	}
+
 	/* note: if Remove() was called in the meantime, it saw an
 	   empty list, and scheduled another event */
 }
@@ -50,3 +59,22 @@ UpdateRemoveService::Remove(std::string &&uri)
 	if (was_empty)
 		defer.Schedule();
 }
+
+void
+UpdateRemoveService::Move(std::vector<std::pair<std::string, std::string>> &&_moved)
+{
+	if (_moved.empty())
+		return;
+
+	{
+		const std::lock_guard protect{mutex};
+		if (moved.empty())
+			moved = std::move(_moved);
+		else
+			moved.insert(moved.end(),
+				     std::make_move_iterator(_moved.begin()),
+				     std::make_move_iterator(_moved.end()));
+	}
+
+	defer.Schedule();
+}
@@ -9,12 +9,15 @@
 
 #include <forward_list>
 #include <string>
+#include <utility>
+#include <vector>
 
 class DatabaseListener;
 
 /**
- * This class handles #Song removal.  It defers the action to the main
- * thread to ensure that all references to the #Song are gone.
+ * This class handles #Song removal (and moves).  It defers the action
+ * to the main thread to ensure that all references to the #Song are
+ * gone.
  */
 class UpdateRemoveService final {
 	DatabaseListener &listener;
@@ -23,6 +26,11 @@ class UpdateRemoveService final {
 
 	std::forward_list<std::string> uris;
 
+	/**
+	 * Pairs of old and new URI.
+	 */
+	std::vector<std::pair<std::string, std::string>> moved;
+
 	InjectEvent defer;
 
 public:
@@ -38,6 +46,12 @@ public:
 	 */
 	void Remove(std::string &&uri);
 
+	/**
+	 * Sends a list of moved songs to the main thread, which will
+	 * relink their stickers and queue items to the new URIs.
+	 */
+	void Move(std::vector<std::pair<std::string, std::string>> &&_moved);
+
 private:
 	/* InjectEvent callback */
 	void RunDeferred() noexcept;
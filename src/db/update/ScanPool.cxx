@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ScanPool.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+UpdateScanPool::UpdateScanPool(unsigned n_threads)
+	:max_pending(n_threads * 4)
+{
+	assert(n_threads > 0);
+
+	try {
+		for (unsigned i = 0; i < n_threads; ++i)
+			threads.emplace_front(BIND_THIS_METHOD(RunWorker)).Start();
+	} catch (...) {
+		StopThreads();
+		throw;
+	}
+}
+
+UpdateScanPool::~UpdateScanPool() noexcept
+{
+	Flush();
+	StopThreads();
+}
+
+void
+UpdateScanPool::StopThreads() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+	}
+
+	work_cond.notify_all();
+
+	for (auto &i : threads)
+		if (i.IsDefined())
+			i.Join();
+
+	threads.clear();
+}
+
+unsigned
+UpdateScanPool::GetDefaultThreads(unsigned setting) noexcept
+{
+	if (setting > 0)
+		return setting;
+
+	/* scanning is mostly I/O bound for regular files, but
+	   container plugins (emulators) are CPU bound; don't
+	   occupy all cores with an idle-priority "update" */
+	return std::clamp(std::thread::hardware_concurrency(), 1U, 8U);
+}
+
+void
+UpdateScanPool::FinishJobs(std::unique_lock<Mutex> &lock, bool wait) noexcept
+{
+	while (!jobs.empty()) {
+		if (!jobs.front()->done) {
+			if (!wait)
+				break;
+
+			done_cond.wait(lock, [this]{ return jobs.front()->done; });
+		}
+
+		auto job = std::move(jobs.front());
+		jobs.pop_front();
+		assert(n_started > 0);
+		--n_started;
+
+		lock.unlock();
+		job->Finish();
+		job.reset();
+		lock.lock();
+
+		/* only wait for one job */
+		wait = false;
+	}
+}
+
+void
+UpdateScanPool::Submit(std::unique_ptr<Job> job) noexcept
+{
+	std::unique_lock lock{mutex};
+
+	FinishJobs(lock, jobs.size() >= max_pending);
+
+	jobs.emplace_back(std::move(job));
+	work_cond.notify_one();
+}
+
+void
+UpdateScanPool::Flush() noexcept
+{
+	std::unique_lock lock{mutex};
+	while (!jobs.empty())
+		FinishJobs(lock, true);
+}
+
+void
+UpdateScanPool::RunWorker() noexcept
+{
+	SetThreadName("update:scan");
+	SetThreadIdlePriority();
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		work_cond.wait(lock, [this]{
+			return quit || n_started < jobs.size();
+		});
+
+		if (quit)
+			break;
+
+		Job &job = *jobs[n_started++];
+
+		lock.unlock();
+		job.Run();
+		lock.lock();
+
+		job.done = true;
+		done_cond.notify_one();
+	}
+}
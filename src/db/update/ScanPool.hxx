@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstddef>
+#include <deque>
+#include <forward_list>
+#include <memory>
+
+/**
+ * Runs the expensive part of file scans (decoder tag scans,
+ * container scans) of the update walker in worker threads.  The
+ * results are handed back to the update thread in submission
+ * order, so the database is modified in walk order.
+ */
+class UpdateScanPool final {
+public:
+	class Job {
+		friend class UpdateScanPool;
+
+		/**
+		 * Has Run() finished?  Protected by
+		 * UpdateScanPool::mutex.
+		 */
+		bool done = false;
+
+	public:
+		virtual ~Job() noexcept = default;
+
+		/**
+		 * Perform the scan.  This is called in a worker
+		 * thread and must not modify the database.
+		 */
+		virtual void Run() noexcept = 0;
+
+		/**
+		 * Apply the result.  This is called in the update
+		 * thread, in submission order.
+		 */
+		virtual void Finish() noexcept = 0;
+	};
+
+private:
+	Mutex mutex;
+
+	/**
+	 * Wakes up workers when a job was submitted or when they
+	 * shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Wakes up the update thread when a job is done.
+	 */
+	Cond done_cond;
+
+	/**
+	 * All jobs which have not been finished yet, in submission
+	 * order.
+	 */
+	std::deque<std::unique_ptr<Job>> jobs;
+
+	/**
+	 * The number of jobs at the front of #jobs which have been
+	 * picked up by a worker.
+	 */
+	std::size_t n_started = 0;
+
+	/**
+	 * The maximum size of #jobs; Submit() blocks beyond that.
+	 */
+	const std::size_t max_pending;
+
+	bool quit = false;
+
+	std::forward_list<Thread> threads;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param n_threads the number of worker threads; must be
+	 * positive
+	 */
+	explicit UpdateScanPool(unsigned n_threads);
+
+	~UpdateScanPool() noexcept;
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * Determine the number of worker threads from the
+	 * "update_threads" setting; the value 0 means
+	 * automatic.
+	 */
+	[[gnu::const]]
+	static unsigned GetDefaultThreads(unsigned setting) noexcept;
+
+	/**
+	 * Enqueue a job.  Before that, finish all jobs which are done
+	 * already; if there are too many pending jobs, wait for the
+	 * oldest one.
+	 */
+	void Submit(std::unique_ptr<Job> job) noexcept;
+
+	/**
+	 * Wait for all jobs and finish them.
+	 */
+	void Flush() noexcept;
+
+private:
+	/**
+	 * Finish completed jobs at the front of the queue.
+	 *
+	 * @param wait wait for the oldest job to complete if it is
+	 * still running
+	 */
+	void FinishJobs(std::unique_lock<Mutex> &lock, bool wait) noexcept;
+
+	void StopThreads() noexcept;
+
+	void RunWorker() noexcept;
+};
@@ -11,6 +11,7 @@
 #include "storage/CompositeStorage.hxx"
 #include "protocol/Ack.hxx"
 #include "Idle.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "Log.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
@@ -20,7 +21,9 @@
 #include "event/Loop.hxx"
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <list>
 
 UpdateService::UpdateService(const ConfigData &_config,
 			     EventLoop &_loop, SimpleDatabase &_db,
@@ -96,15 +99,19 @@ UpdateService::Task() noexcept
 
 	SetThreadName("update");
 
-	if (!next.path_utf8.empty())
-		FmtDebug(update_domain, "starting: {}", next.path_utf8);
-	else
-		LogDebug(update_domain, "starting");
+	for (const auto &path : next.paths) {
+		if (!path.empty())
+			FmtDebug(update_domain, "starting: {}", path);
+		else
+			LogDebug(update_domain, "starting");
+	}
 
 	SetThreadIdlePriority();
 
-	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
-			      next.discard);
+	for (const auto &path : next.paths)
+		if (walk->Walk(next.db->GetRoot(), path.c_str(),
+			       next.discard))
+			modified = true;
 
 	if (modified || !next.db->FileExists()) {
 		try {
@@ -115,10 +122,14 @@ UpdateService::Task() noexcept
 		}
 	}
 
-	if (!next.path_utf8.empty())
-		FmtDebug(update_domain, "finished: {}", next.path_utf8);
-	else
-		LogDebug(update_domain, "finished");
+	next.db->RefreshTagIndex();
+
+	for (const auto &path : next.paths) {
+		if (!path.empty())
+			FmtDebug(update_domain, "finished: {}", path);
+		else
+			LogDebug(update_domain, "finished");
+	}
 
 	defer.Schedule();
 }
@@ -130,6 +141,7 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	assert(walk == nullptr);
 
 	modified = false;
+	start_time = std::chrono::steady_clock::now();
 
 	next = std::move(i);
 	walk = std::make_unique<UpdateWalk>(config, GetEventLoop(), listener,
@@ -150,13 +162,9 @@ UpdateService::GenerateId() noexcept
 	return id;
 }
 
-unsigned
-UpdateService::Enqueue(std::string_view path, bool discard)
+UpdateService::Target
+UpdateService::Resolve(std::string_view path)
 {
-	assert(GetEventLoop().IsInside());
-
-	/* determine which (mounted) database will be updated and what
-	   storage will be scanned */
 	SimpleDatabase *db2;
 	Storage *storage2;
 
@@ -193,9 +201,15 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 		   happen */
 		throw std::runtime_error("No storage at this path");
 
+	return {db2, storage2, path};
+}
+
+unsigned
+UpdateService::Enqueue(UpdateQueueItem &&item)
+{
 	if (walk != nullptr) {
-		const unsigned id = GenerateId();
-		if (!queue.Push(*db2, *storage2, path, discard, id))
+		const unsigned id = item.id = GenerateId();
+		if (!queue.Push(std::move(item)))
 			throw ProtocolError(ACK_ERROR_UPDATE_ALREADY,
 					    "Update queue is full");
 
@@ -203,14 +217,75 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 		return id;
 	}
 
-	const unsigned id = update_task_id = GenerateId();
-	StartThread(UpdateQueueItem(*db2, *storage2, path, discard, id));
+	const unsigned id = item.id = update_task_id = GenerateId();
+	StartThread(std::move(item));
 
 	idle_add(IDLE_UPDATE);
 
 	return id;
 }
 
+unsigned
+UpdateService::Enqueue(std::string_view path, bool discard)
+{
+	assert(GetEventLoop().IsInside());
+
+	const auto target = Resolve(path);
+	return Enqueue(UpdateQueueItem(*target.db, *target.storage,
+				       target.path, discard, 0));
+}
+
+unsigned
+UpdateService::Enqueue(std::span<const std::string> paths)
+{
+	assert(GetEventLoop().IsInside());
+
+	/* group the paths by database */
+	std::list<UpdateQueueItem> batch;
+
+	for (const auto &path : paths) {
+		Target target;
+
+		try {
+			target = Resolve(path);
+		} catch (...) {
+			FmtError(update_domain,
+				 "Failed to enqueue {:?}: {}",
+				 path, std::current_exception());
+			continue;
+		}
+
+		auto i = std::find_if(batch.begin(), batch.end(),
+				      [&target](const UpdateQueueItem &item){
+					      return item.db == target.db &&
+						      item.storage == target.storage;
+				      });
+		if (i != batch.end())
+			i->AddPath(target.path);
+		else
+			batch.emplace_back(*target.db, *target.storage,
+					   target.path, false, 0);
+	}
+
+	unsigned id = 0;
+
+	for (auto &item : batch) {
+		if (walk != nullptr) {
+			if (auto *queued = queue.FindMergeable(*item.db,
+								*item.storage)) {
+				for (const auto &path : item.paths)
+					queued->AddPath(path);
+				id = queued->id;
+				continue;
+			}
+		}
+
+		id = Enqueue(std::move(item));
+	}
+
+	return id;
+}
+
 /**
  * Called in the main thread after the database update is finished.
  */
@@ -227,6 +302,10 @@ UpdateService::RunDeferred() noexcept
 
 	walk.reset();
 
+	stats.last_duration = std::chrono::steady_clock::now() - start_time;
+	stats.total_duration += stats.last_duration;
+	++stats.jobs;
+
 	next.Clear();
 
 	idle_add(IDLE_UPDATE);
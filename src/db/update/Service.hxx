@@ -9,13 +9,33 @@
 #include "event/InjectEvent.hxx"
 #include "thread/Thread.hxx"
 
+#include <chrono>
 #include <memory>
+#include <span>
+#include <string>
 #include <string_view>
 
 class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
 class CompositeStorage;
+class Storage;
+
+struct UpdateStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The number of update jobs which have finished (or have
+	 * been canceled).
+	 */
+	unsigned jobs = 0;
+
+	/**
+	 * The duration of the most recent job (walk and database
+	 * save) and the sum of all job durations.
+	 */
+	Duration last_duration{}, total_duration{};
+};
 
 /**
  * This class manages the update queue and runs the update thread.
@@ -44,6 +64,13 @@ class UpdateService final {
 
 	std::unique_ptr<UpdateWalk> walk;
 
+	/**
+	 * When was the current job started?
+	 */
+	std::chrono::steady_clock::time_point start_time;
+
+	UpdateStats stats;
+
 public:
 	UpdateService(const ConfigData &_config,
 		      EventLoop &_loop, SimpleDatabase &_db,
@@ -64,6 +91,10 @@ public:
 		return next.id;
 	}
 
+	const UpdateStats &GetStats() const noexcept {
+		return stats;
+	}
+
 	/**
 	 * Add this path to the database update queue.
 	 *
@@ -75,6 +106,20 @@ public:
 	 */
 	unsigned Enqueue(std::string_view path, bool discard);
 
+	/**
+	 * Add several paths to the database update queue.  All paths
+	 * in the same (mounted) database are updated by one job,
+	 * i.e. one walk and one database save, and they are merged
+	 * into a job which is already queued for it.  Paths inside
+	 * other paths are collapsed into their ancestor.  Paths
+	 * which cannot be updated are logged and skipped.
+	 *
+	 * Throws on error (i.e. if the queue is full)
+	 *
+	 * @return the id of the last job (0 if none)
+	 */
+	unsigned Enqueue(std::span<const std::string> paths);
+
 	/**
 	 * Clear the queue and cancel the current update.  Does not
 	 * wait for the thread to exit.
@@ -89,6 +134,31 @@ public:
 	void CancelMount(const char *uri) noexcept;
 
 private:
+	struct Target {
+		SimpleDatabase *db;
+		Storage *storage;
+
+		/**
+		 * The path relative to #db.
+		 */
+		std::string_view path;
+	};
+
+	/**
+	 * Determine which (mounted) database will be updated and
+	 * what storage will be scanned.
+	 *
+	 * Throws on error
+	 */
+	Target Resolve(std::string_view path);
+
+	/**
+	 * Start the item or add it to the queue.
+	 *
+	 * Throws on error
+	 */
+	unsigned Enqueue(UpdateQueueItem &&item);
+
 	/* InjectEvent callback */
 	void RunDeferred() noexcept;
 
@@ -9,40 +9,70 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "FileScanJob.hxx"
 #include "storage/FileInfo.hxx"
+#include "storage/StorageInterface.hxx"
+#include "system/Probe.hxx"
+#include "time/ChronoUtil.hxx"
 #include "Log.hxx"
 
 #include <unistd.h>
 
-inline void
-UpdateWalk::UpdateSongFile2(Directory &directory,
-			    std::string_view name, std::string_view suffix,
-			    const StorageFileInfo &info) noexcept
-try {
-	Song *song;
-	{
-		const ScopeDatabaseLock protect;
-		song = directory.FindSong(name);
+void
+UpdateWalk::FileScanJob::Run() noexcept
+{
+	if (contdir != nullptr) {
+		try {
+			tracks = container_plugin->ContainerScan(container_path);
+			if (!tracks.empty())
+				return;
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+
+		/* not a container after all: scan it as a regular
+		   song file */
 	}
 
-	if (!directory_child_access(storage, directory, name, R_OK)) {
+	try {
+		if (song == nullptr)
+			FmtDebug(update_domain, "reading {}/{}",
+				 directory.GetPath(), name);
+
+		new_song = Song::LoadFile(walk.storage, name, info, directory);
+	} catch (...) {
 		FmtError(update_domain,
-			 "no read permissions on {}/{}",
-			 directory.GetPath(), name);
-		return;
+			 "error reading file {}/{}: {}",
+			 directory.GetPath(), name, std::current_exception());
 	}
+}
 
-	if (!(song != nullptr && info.mtime == song->mtime && !walk_discard) &&
-	    UpdateContainerFile(directory, name, suffix, info)) {
-		return;
+void
+UpdateWalk::FileScanJob::Finish() noexcept
+{
+	if (contdir != nullptr) {
+		if (!tracks.empty()) {
+			walk.AddContainerSongs(*contdir, std::move(tracks), info);
+
+			/* the container replaces the song (if it
+			   existed) */
+			if (song != nullptr)
+				walk.editor.LockDeleteSong(directory, song);
+
+			return;
+		}
+
+		walk.editor.LockDeleteDirectory(contdir);
 	}
 
-	if (song == nullptr) {
-		FmtDebug(update_domain, "reading {}/{}",
-			 directory.GetPath(), name);
+	FinishSong();
+}
 
-		auto new_song = Song::LoadFile(storage, name, info,
-					       directory);
+inline void
+UpdateWalk::FileScanJob::FinishSong() noexcept
+{
+	if (song == nullptr) {
 		if (!new_song) {
 			FmtDebug(update_domain,
 				 "ignoring unrecognized file {}/{}",
@@ -58,24 +88,179 @@ try {
 			directory.AddSong(std::move(new_song));
 		}
 
-		modified = true;
+		walk.modified = true;
 		FmtNotice(update_domain, "added {}/{}",
 			  directory.GetPath(), name);
-	} else if (info.mtime != song->mtime || walk_discard) {
+	} else {
 		FmtNotice(update_domain, "updating {}/{}",
 			  directory.GetPath(), name);
-		if (song->UpdateFile(storage, info))
-			song->mark = true;
-		else
+
+		if (new_song) {
+			const ScopeDatabaseLock protect;
+			song->tag = std::move(new_song->tag);
+			song->mtime = new_song->mtime;
+			song->file_id = new_song->file_id;
+			song->audio_format = new_song->audio_format;
+			directory.MarkDirty();
+		} else {
 			FmtDebug(update_domain,
 				 "deleting unrecognized file {}/{}",
 				 directory.GetPath(), name);
+			walk.editor.LockDeleteSong(directory, song);
+		}
 
-		modified = true;
+		walk.modified = true;
+	}
+}
+
+void
+UpdateWalk::SubmitScan(std::unique_ptr<FileScanJob> job,
+		       bool parallel) noexcept
+{
+	if (scan_pool == nullptr) {
+		job->Run();
+		job->Finish();
+	} else if (parallel) {
+		scan_pool->Submit(std::move(job));
 	} else {
+		/* finish pending jobs first to preserve the walk
+		   order */
+		scan_pool->Flush();
+		job->Run();
+		job->Finish();
+	}
+}
+
+/**
+ * Find a song in the given directory which is not marked (yet) and
+ * whose file has the given identity, but doesn't exist anymore,
+ * i.e. which has been renamed.
+ */
+static Song *
+FindRenamedSong(Storage &storage, Directory &directory,
+		uint64_t file_id,
+		std::chrono::system_clock::time_point mtime) noexcept
+{
+	for (Song &song : directory.songs)
+		if (!song.mark && song.file_id == file_id &&
+		    song.mtime == mtime && song.target.empty() &&
+		    !directory_child_is_regular(storage, directory,
+						song.filename))
+			return &song;
+
+	return nullptr;
+}
+
+inline bool
+UpdateWalk::AddMovedSong(Directory &directory, std::string_view name,
+			 const StorageFileInfo &info) noexcept
+{
+	const uint64_t file_id = info.GetFileId();
+	if (file_id == 0 || IsNegative(info.mtime) ||
+	    directory.IsReallyAFile())
+		return false;
+
+	auto new_song = std::make_unique<Song>(name, directory);
+	new_song->mtime = info.mtime;
+	new_song->file_id = file_id;
+	new_song->mark = true;
+
+	if (Song *old = FindRenamedSong(storage, directory,
+					file_id, info.mtime)) {
+		editor.moves.Moved(old->GetURI(), new_song->GetURI());
+
+		const ScopeDatabaseLock protect;
+		new_song->tag = std::move(old->tag);
+		new_song->added = old->added;
+		new_song->audio_format = old->audio_format;
+
+		/* the old entry is freed right here; its URI has been
+		   passed to the DatabaseEditor, which will relink
+		   stickers and queue items */
+		directory.RemoveSong(old);
+		directory.AddSong(std::move(new_song));
+	} else if (auto buried = editor.moves.Exhume(info,
+						     new_song->GetURI())) {
+		new_song->tag = std::move(buried->tag);
+		new_song->added = buried->added;
+		new_song->audio_format = buried->audio_format;
+
+		const ScopeDatabaseLock protect;
+		directory.AddSong(std::move(new_song));
+	} else
+		return false;
+
+	FmtDebug(update_domain, "found moved file {}/{}",
+		 directory.GetPath(), name);
+	modified = true;
+	return true;
+}
+
+inline void
+UpdateWalk::UpdateSongFile2(Directory &directory,
+			    std::string_view name, std::string_view suffix,
+			    const StorageFileInfo &info) noexcept
+try {
+	Song *song;
+	{
+		const ScopeDatabaseLock protect;
+		song = directory.FindSong(name);
+	}
+
+	if (!directory_child_access(storage, directory, name, R_OK)) {
+		FmtError(update_domain,
+			 "no read permissions on {}/{}",
+			 directory.GetPath(), name);
+		return;
+	}
+
+	const bool song_modified = song == nullptr ||
+		info.mtime != song->mtime || walk_discard;
+	if (!song_modified) {
 		/* not modified */
 		song->mark = true;
+
+		if (const uint64_t file_id = info.GetFileId();
+		    song->file_id != file_id) {
+			/* learn the file identity of songs loaded
+			   from an old database file */
+			const ScopeDatabaseLock protect;
+			song->file_id = file_id;
+			directory.MarkDirty();
+		}
+
+		return;
 	}
+
+	if (song == nullptr && AddMovedSong(directory, name, info))
+		/* this file has been moved or renamed; its tags have
+		   been copied from the old database entry */
+		return;
+
+	auto job = std::make_unique<FileScanJob>(*this, directory, name,
+						 info, song);
+
+	if (UpdateContainerFile(directory, name, suffix, info, *job))
+		/* an unmodified container */
+		return;
+
+	if (song != nullptr)
+		/* keep the song while the job is pending; the job
+		   deletes it if it's not a song anymore */
+		song->mark = true;
+
+	/* remote files are scanned in the update thread, because
+	   the storage plugin may not be thread-safe */
+	const bool local = job->contdir != nullptr ||
+		!storage.MapChildFS(directory.GetPath(), name).IsNull();
+
+	/* so are files of decoder plugins which cannot scan in
+	   more than one thread at a time */
+	const bool serial = job->container_plugin != nullptr
+		? job->container_plugin->serial_scan
+		: decoder_plugins_serial_scan(suffix);
+
+	SubmitScan(std::move(job), local && !serial);
 } catch (...) {
 	FmtError(update_domain,
 		 "error reading file {}/{}: {}",
@@ -90,6 +275,8 @@ UpdateWalk::UpdateSongFile(Directory &directory,
 	if (!decoder_plugins_supports_suffix(suffix))
 		return false;
 
+	MPD_PROBE(update_song_file, name.data(), name.size());
+
 	UpdateSongFile2(directory, name, suffix, info);
 	return true;
 }
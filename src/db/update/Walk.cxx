@@ -11,6 +11,7 @@
 #include "db/plugins/simple/Song.hxx"
 #include "storage/StorageInterface.hxx"
 #include "ExcludeList.hxx"
+#include "CoverArt.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
@@ -21,12 +22,15 @@
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "util/UriExtract.hxx"
+#include "time/ChronoUtil.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <exception>
 #include <memory>
+#include <vector>
 
 #include <string.h>
 #include <stdlib.h>
@@ -123,6 +127,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 		if (!i->mark) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.MarkDirty();
 		} else
 			++i;
 	}
@@ -331,6 +336,37 @@ LoadExcludeListOrLog(Storage &storage, const Directory &directory,
 	}
 }
 
+void
+UpdateWalk::UpdateUnchangedDirectory(Directory &directory,
+				     const ExcludeList &exclude_list) noexcept
+{
+	ExcludeList child_exclude_list(exclude_list);
+	LoadExcludeListOrLog(storage, directory, child_exclude_list);
+
+	std::vector<Directory *> subdirs;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		for (auto &child : directory.children)
+			if (!child.IsMount() && !child.IsReallyAFile())
+				subdirs.push_back(&child);
+	}
+
+	for (Directory *subdir : subdirs) {
+		if (cancel)
+			break;
+
+		StorageFileInfo info;
+		if (!GetInfo(storage, subdir->GetPath(), info) ||
+		    !info.IsDirectory() ||
+		    !UpdateDirectory(*subdir, child_exclude_list, info)) {
+			editor.LockDeleteDirectory(subdir);
+			modified = true;
+		}
+	}
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
@@ -340,10 +376,21 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	directory_set_stat(directory, info);
 
+	if (!config.paranoid && !walk_discard &&
+	    !IsNegative(info.mtime) && directory.mtime == info.mtime) {
+		/* no entries were added, removed or renamed since
+		   the last update */
+		UpdateUnchangedDirectory(directory, exclude_list);
+		directory.mark = true;
+		return true;
+	}
+
 	std::unique_ptr<StorageDirectoryReader> reader;
 
 	try {
-		reader = storage.OpenDirectory(directory.GetPath());
+		reader = list_pool != nullptr
+			? list_pool->OpenDirectory(directory.GetPath())
+			: storage.OpenDirectory(directory.GetPath());
 	} catch (...) {
 		LogError(std::current_exception());
 		return false;
@@ -357,11 +404,18 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 
 	UnmarkAllIn(directory);
 
+	/* the best album art file so far (an index into
+	   #cover_art_names) */
+	std::size_t best_cover = cover_art_names.size();
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
+		best_cover = std::min(best_cover,
+				      GetCoverArtPreference(name_utf8));
+
 		{
 			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
 			if (name_fs.IsNull() || child_exclude_list.Check(name_fs))
@@ -382,9 +436,31 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
 	}
 
+	if (list_pool != nullptr)
+		/* subdirectories which were skipped (excluded,
+		   symlinks, loops) were prefetched needlessly */
+		list_pool->Forget(directory.GetPath());
+
 	PurgeDeletedFromDirectory(directory);
 
-	directory.mtime = info.mtime;
+	if (!cancel) {
+		/* remember the album art file, so the "albumart"
+		   command doesn't need to look for it */
+		const std::string_view cover = best_cover < cover_art_names.size()
+			? cover_art_names[best_cover]
+			: std::string_view{};
+		if (directory.cover != cover) {
+			const ScopeDatabaseLock protect;
+			directory.cover = cover;
+			directory.MarkDirty();
+		}
+	}
+
+	if (directory.mtime != info.mtime) {
+		directory.mtime = info.mtime;
+		directory.MarkDirty();
+	}
+
 	directory.mark = true;
 
 	return true;
@@ -456,26 +532,18 @@ UpdateWalk::DirectoryMakeUriParentChecked(Directory &root,
 	return directory;
 }
 
+/**
+ * Load the .mpdignore files of the specified directory and all of
+ * its parents into one #ExcludeList.
+ */
 static void
-LoadExcludeLists(std::forward_list<ExcludeList> &lists,
+LoadExcludeLists(ExcludeList &list,
 		 Storage &storage, const Directory &directory) noexcept
 {
-	assert(!lists.empty());
-
 	if (!directory.IsRoot())
-		LoadExcludeLists(lists, storage, *directory.parent);
-
-	lists.emplace_front();
-	LoadExcludeListOrLog(storage, directory, lists.front());
-}
+		LoadExcludeLists(list, storage, *directory.parent);
 
-static auto
-LoadExcludeLists(Storage &storage, const Directory &directory) noexcept
-{
-	std::forward_list<ExcludeList> lists;
-	lists.emplace_front();
-	LoadExcludeLists(lists, storage, directory);
-	return lists;
+	LoadExcludeListOrLog(storage, directory, list);
 }
 
 inline void
@@ -498,12 +566,36 @@ try {
 		return;
 	}
 
-	const auto exclude_lists = LoadExcludeLists(storage, *parent);
-	UpdateDirectoryChild(*parent, exclude_lists.front(), name, info);
+	ExcludeList exclude_list;
+	LoadExcludeLists(exclude_list, storage, *parent);
+	UpdateDirectoryChild(*parent, exclude_list, name, info);
 } catch (...) {
 	LogError(std::current_exception());
 }
 
+inline void
+UpdateWalk::StartPools() noexcept
+{
+	const unsigned n_threads =
+		UpdateScanPool::GetDefaultThreads(config.threads);
+	if (n_threads <= 1)
+		return;
+
+	try {
+		scan_pool = std::make_unique<UpdateScanPool>(n_threads);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start scanner threads");
+	}
+
+	try {
+		list_pool = std::make_unique<UpdateListPool>(storage, n_threads);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start directory listing threads");
+	}
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
@@ -511,6 +603,7 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 	modified = false;
 
 	if (path != nullptr && !isRootDirectory(path)) {
+		StartPools();
 		UpdateUri(root, path);
 	} else {
 		StorageFileInfo info;
@@ -525,9 +618,20 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 
 		ExcludeList exclude_list;
 
+		StartPools();
 		UpdateDirectory(root, exclude_list, info);
 	}
 
+	list_pool.reset();
+
+	/* apply all pending scan results before looking up
+	   playlist targets */
+	scan_pool.reset();
+
+	/* remove deleted songs which were not found at another
+	   location */
+	editor.Finish();
+
 	{
 		const ScopeDatabaseLock protect;
 		root.ClearInPlaylist();
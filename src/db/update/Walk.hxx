@@ -5,9 +5,13 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
+#include "ListPool.hxx"
 #include "archive/Features.h" // for ENABLE_ARCHIVE
 
 #include <atomic>
+#include <forward_list>
+#include <memory>
 #include <string_view>
 
 struct StorageFileInfo;
@@ -18,12 +22,15 @@ class SongEnumerator;
 class ArchiveFile;
 class Storage;
 class ExcludeList;
+class DetachedSong;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
 	friend class UpdateArchiveVisitor;
 #endif
 
+	class FileScanJob;
+
 	const UpdateConfig config;
 
 	bool walk_discard;
@@ -40,6 +47,19 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * Worker threads for scanning song and container files.  If
+	 * this is nullptr, files are scanned in the update thread.
+	 */
+	std::unique_ptr<UpdateScanPool> scan_pool;
+
+	/**
+	 * Worker threads which list directories ahead of the walk.
+	 * If this is nullptr, directories are listed in the update
+	 * thread.
+	 */
+	std::unique_ptr<UpdateListPool> list_pool;
+
 public:
 	UpdateWalk(const UpdateConfig &_config,
 		   EventLoop &_loop, DatabaseListener &_listener,
@@ -77,6 +97,17 @@ private:
 	 */
 	void PurgeDanglingFromPlaylists(Directory &directory) noexcept;
 
+	/**
+	 * Check whether this new file is a song which has been moved
+	 * or renamed (see #UpdateMoveDetector), and if so, add it
+	 * with the tags of the old database entry instead of
+	 * scanning it.
+	 *
+	 * @return true if the song has been added
+	 */
+	bool AddMovedSong(Directory &directory, std::string_view name,
+			  const StorageFileInfo &info) noexcept;
+
 	void UpdateSongFile2(Directory &directory,
 			     std::string_view name, std::string_view suffix,
 			     const StorageFileInfo &info) noexcept;
@@ -85,10 +116,31 @@ private:
 			    std::string_view name, std::string_view suffix,
 			    const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Run the scan job in a worker thread, or right now if there
+	 * is no #scan_pool.
+	 *
+	 * @param parallel false if the job must run in the update
+	 * thread
+	 */
+	void SubmitScan(std::unique_ptr<FileScanJob> job,
+			bool parallel) noexcept;
+
+	/**
+	 * Check if the file is a container and prepare its virtual
+	 * directory in the #FileScanJob.
+	 *
+	 * @return true if the file is an unmodified container which
+	 * does not need to be scanned
+	 */
 	bool UpdateContainerFile(Directory &directory,
 				 std::string_view name, std::string_view suffix,
-				 const StorageFileInfo &info) noexcept;
+				 const StorageFileInfo &info,
+				 FileScanJob &job) noexcept;
 
+	void AddContainerSongs(Directory &contdir,
+			       std::forward_list<DetachedSong> &&tracks,
+			       const StorageFileInfo &info) noexcept;
 
 #ifdef ENABLE_ARCHIVE
 	void UpdateArchiveTree(ArchiveFile &archive, Directory &parent,
@@ -131,6 +183,14 @@ private:
 				  const char *name,
 				  const StorageFileInfo &info) noexcept;
 
+	/**
+	 * Update a directory whose modification time has not
+	 * changed without listing it: its files are assumed to be
+	 * unchanged, only its known subdirectories are checked.
+	 */
+	void UpdateUnchangedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list) noexcept;
+
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
 			     const StorageFileInfo &info) noexcept;
@@ -164,4 +224,6 @@ private:
 						 std::string_view uri) noexcept;
 
 	void UpdateUri(Directory &root, const char *uri) noexcept;
+
+	void StartPools() noexcept;
 };
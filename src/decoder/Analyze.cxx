@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Analyze.hxx"
+#include "SongAnalysis.hxx"
+#include "Client.hxx"
+#include "DecoderAPI.hxx"
+#include "DecoderList.hxx"
+#include "DecoderPlugin.hxx"
+#include "pcm/Convert.hxx"
+#include "pcm/MixRampAnalyzer.hxx"
+#include "pcm/MixRampGlue.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "thread/Mutex.hxx"
+#include "fs/Path.hxx"
+#include "util/SpanCast.hxx"
+
+#include <memory>
+
+/**
+ * Songs longer than this are not analyzed; this also protects
+ * against emulated songs which loop forever.
+ */
+static constexpr SongTime max_duration = SongTime::FromS(30u * 60u);
+
+static constexpr AudioFormat analyze_audio_format{
+	ReplayGainAnalyzer::SAMPLE_RATE,
+	SampleFormat::FLOAT,
+	ReplayGainAnalyzer::CHANNELS,
+};
+
+class AnalyzeDecoderClient final : public DecoderClient {
+	const std::atomic_bool &cancel;
+
+	std::unique_ptr<PcmConvert> convert;
+
+	MixRampAnalyzer mix_ramp;
+
+	WindowReplayGainAnalyzer replay_gain;
+
+	bool ready = false;
+
+	/**
+	 * Set if the song cannot be analyzed; this stops the
+	 * decoder.
+	 */
+	bool failed = false;
+
+public:
+	Mutex mutex;
+
+	explicit AnalyzeDecoderClient(const std::atomic_bool &_cancel) noexcept
+		:cancel(_cancel) {}
+
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	std::optional<SongAnalysis> Finish() noexcept;
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override;
+
+	DecoderCommand GetCommand() noexcept override {
+		return failed || cancel
+			? DecoderCommand::STOP
+			: DecoderCommand::NONE;
+	}
+
+	void CommandFinished() noexcept override {}
+
+	SongTime GetSeekTime() noexcept override {
+		return SongTime::zero();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return 0;
+	}
+
+	void SeekError(std::exception_ptr &&) noexcept override {}
+
+	InputStreamPtr OpenUri(std::string_view uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+
+	size_t Read(InputStream &is,
+		    std::span<std::byte> dest) noexcept override;
+
+	void SubmitTimestamp(FloatDuration) noexcept override {}
+
+	DecoderCommand SubmitAudio(InputStream *is,
+				   std::span<const std::byte> audio,
+				   uint16_t kbit_rate) noexcept override;
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) noexcept override {}
+	void SubmitMixRamp(MixRampInfo &&) noexcept override {}
+
+private:
+	void Process(std::span<const std::byte> audio) noexcept {
+		const auto frames =
+			FromBytesStrict<const ReplayGainAnalyzer::Frame>(audio);
+		mix_ramp.Process(frames);
+		replay_gain.Process(frames);
+	}
+};
+
+void
+AnalyzeDecoderClient::Ready(AudioFormat audio_format, bool,
+			    SignedSongTime duration) noexcept
+{
+	ready = true;
+
+	if (duration.IsNegative() || duration > SignedSongTime{max_duration}) {
+		failed = true;
+		return;
+	}
+
+	if (audio_format != analyze_audio_format) {
+		try {
+			convert = std::make_unique<PcmConvert>(audio_format,
+							       analyze_audio_format);
+		} catch (...) {
+			failed = true;
+		}
+	}
+}
+
+DecoderCommand
+AnalyzeDecoderClient::SubmitAudio(InputStream *,
+				  std::span<const std::byte> audio,
+				  uint16_t) noexcept
+{
+	assert(ready);
+
+	if (failed)
+		return DecoderCommand::STOP;
+
+	try {
+		if (convert)
+			audio = convert->Convert(audio);
+	} catch (...) {
+		failed = true;
+		return DecoderCommand::STOP;
+	}
+
+	Process(audio);
+	return GetCommand();
+}
+
+size_t
+AnalyzeDecoderClient::Read(InputStream &is,
+			   std::span<std::byte> dest) noexcept
+{
+	try {
+		return is.LockRead(dest);
+	} catch (...) {
+		failed = true;
+		return 0;
+	}
+}
+
+std::optional<SongAnalysis>
+AnalyzeDecoderClient::Finish() noexcept
+{
+	if (!ready || failed || cancel)
+		return std::nullopt;
+
+	if (convert) {
+		try {
+			Process(convert->Flush());
+		} catch (...) {
+		}
+	}
+
+	replay_gain.Flush();
+
+	const auto total_time = mix_ramp.GetTime();
+	if (total_time <= FloatDuration{})
+		return std::nullopt;
+
+	SongAnalysis result;
+	result.mix_ramp.SetStart(MixRampToString(mix_ramp.GetResult(),
+						 total_time,
+						 MixRampDirection::START));
+	result.mix_ramp.SetEnd(MixRampToString(mix_ramp.GetResult(),
+					       total_time,
+					       MixRampDirection::END));
+	result.track.gain = replay_gain.GetGain();
+	result.track.peak = replay_gain.GetPeak();
+	return result;
+}
+
+std::optional<SongAnalysis>
+AnalyzeSongFile(Path path_fs, std::string_view suffix,
+		const std::atomic_bool &cancel)
+{
+	AnalyzeDecoderClient client{cancel};
+
+	/* this may fail for songs inside a container file; those
+	   are only supported by plugins implementing
+	   file_decode */
+	InputStreamPtr is;
+	try {
+		is = OpenLocalInputStream(path_fs, client.mutex);
+	} catch (...) {
+	}
+
+	try {
+		for (const auto *plugin : decoder_plugins_for_suffix(suffix)) {
+			if (cancel)
+				return std::nullopt;
+
+			if (!plugin->SupportsSuffix(suffix))
+				continue;
+
+			if (plugin->file_decode != nullptr) {
+				plugin->FileDecode(client, path_fs);
+			} else if (plugin->stream_decode != nullptr && is) {
+				/* rewind the stream, so each plugin
+				   gets a fresh start */
+				try {
+					is->LockRewind();
+				} catch (...) {
+				}
+
+				plugin->StreamDecode(client, *is);
+			} else
+				continue;
+
+			if (client.IsReady())
+				break;
+		}
+	} catch (StopDecoder) {
+	}
+
+	return client.Finish();
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string_view>
+
+struct SongAnalysis;
+class Path;
+
+/**
+ * Decode the given file completely and calculate its MixRamp start
+ * and end values and its track ReplayGain with #MixRampAnalyzer and
+ * #ReplayGainAnalyzer.  This may take a long time; it is meant to be
+ * called from a low-priority background thread.
+ *
+ * Throws on error.
+ *
+ * @param suffix the filename suffix used to select the decoder plugin
+ * @param cancel if this becomes true, decoding is stopped as soon as
+ * possible
+ * @return the result or std::nullopt if the file could not be decoded
+ * (or is too long, or was canceled)
+ */
+std::optional<SongAnalysis>
+AnalyzeSongFile(Path path_fs, std::string_view suffix,
+		const std::atomic_bool &cancel);
@@ -18,8 +18,11 @@
 #include "input/cache/Manager.hxx"
 #include "input/cache/Stream.hxx"
 #include "fs/Path.hxx"
+#include "system/Probe.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/StringBuffer.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <stdexcept>
@@ -132,13 +135,65 @@ DecoderBridge::FlushChunk() noexcept
 	assert(current_chunk != nullptr);
 
 	auto chunk = std::move(current_chunk);
-	if (!chunk->IsEmpty())
+	if (!chunk->IsEmpty()) {
+		if (chunk_pushed && dc.pipe->IsEmpty())
+			/* the player has consumed everything we had
+			   produced; it may be about to starve */
+			++stats.underruns;
+
+		MPD_PROBE(decoder_flush_chunk, chunk->length);
+
+		chunk->submit_time = std::chrono::steady_clock::now();
 		dc.pipe->Push(std::move(chunk));
+		chunk_pushed = true;
+	}
 
 	const std::lock_guard protect{dc.mutex};
+	PublishStats();
 	dc.client_cond.notify_one();
 }
 
+void
+DecoderBridge::PublishStats() noexcept
+{
+	dc.stats = stats;
+}
+
+std::chrono::steady_clock::time_point
+DecoderBridge::BeginSubmit() noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (last_submit != std::chrono::steady_clock::time_point{})
+		stats.render_time += now - last_submit;
+	return now;
+}
+
+void
+DecoderBridge::EndSubmit(std::chrono::steady_clock::time_point start) noexcept
+{
+	last_submit = std::chrono::steady_clock::now();
+	stats.submit_time += last_submit - start;
+}
+
+void
+DecoderBridge::FinishSeekStats() noexcept
+{
+	if (seek_start == std::chrono::steady_clock::time_point{})
+		return;
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto duration = now - seek_start;
+	seek_start = {};
+
+	++stats.seeks;
+	stats.seek_time += duration;
+	stats.max_seek_time = std::max(stats.max_seek_time, duration);
+
+	/* the time spent seeking is not render time */
+	last_submit = now;
+	chunk_pushed = false;
+}
+
 bool
 DecoderBridge::PrepareInitialSeek() noexcept
 {
@@ -247,6 +302,33 @@ DecoderBridge::UpdateStreamTag(InputStream *is) noexcept
 	return true;
 }
 
+DecoderCommand
+DecoderBridge::SendStreamTag(InputStream *is) noexcept
+{
+	if (!UpdateStreamTag(is))
+		return DecoderCommand::NONE;
+
+	if (decoder_tag != nullptr)
+		/* merge with tag from decoder plugin */
+		return DoSendTag(Tag::Merge(*decoder_tag, *stream_tag));
+	else
+		/* send only the stream tag */
+		return DoSendTag(*stream_tag);
+}
+
+uint64_t
+DecoderBridge::GetRemainingFrames() const noexcept
+{
+	if (!dc.end_time.IsPositive())
+		return UINT64_MAX;
+
+	const auto end_frame =
+		dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
+	return absolute_frame < end_frame
+		? end_frame - absolute_frame
+		: 0;
+}
+
 void
 DecoderBridge::Ready(const AudioFormat audio_format,
 		     bool seekable, SignedSongTime duration) noexcept
@@ -260,9 +342,13 @@ DecoderBridge::Ready(const AudioFormat audio_format,
 		 audio_format,
 		 seekable);
 
+	stats.sample_rate = audio_format.sample_rate;
+	last_submit = std::chrono::steady_clock::now();
+
 	{
 		const std::lock_guard protect{dc.mutex};
 		dc.SetReady(audio_format, seekable, duration);
+		PublishStats();
 	}
 
 	if (dc.in_audio_format != dc.out_audio_format) {
@@ -278,6 +364,13 @@ DecoderBridge::Ready(const AudioFormat audio_format,
 	}
 }
 
+AudioFormat
+DecoderBridge::GetPreferredAudioFormat() noexcept
+{
+	const std::lock_guard protect{dc.mutex};
+	return dc.GetPreferredAudioFormat();
+}
+
 DecoderCommand
 DecoderBridge::GetCommand() noexcept
 {
@@ -289,6 +382,9 @@ DecoderBridge::CommandFinished() noexcept
 {
 	const std::lock_guard protect{dc.mutex};
 
+	FinishSeekStats();
+	PublishStats();
+
 	assert(dc.command != DecoderCommand::NONE || initial_seek_running);
 	assert(dc.command != DecoderCommand::SEEK ||
 	       initial_seek_running ||
@@ -331,6 +427,9 @@ DecoderBridge::GetSeekTime() noexcept
 {
 	assert(dc.pipe != nullptr);
 
+	if (seek_start == std::chrono::steady_clock::time_point{})
+		seek_start = std::chrono::steady_clock::now();
+
 	if (initial_seek_running)
 		return dc.start_time;
 
@@ -359,6 +458,7 @@ DecoderBridge::SeekError(std::exception_ptr &&_error) noexcept
 		/* d'oh, we can't seek to the sub-song start position,
 		   what now? - no idea, ignoring the problem for now. */
 		initial_seek_running = false;
+		FinishSeekStats();
 
 		if (initial_seek_essential)
 			error = std::move(_error);
@@ -425,12 +525,20 @@ try {
 	size_t nbytes = is.Read(lock, dest);
 	assert(nbytes > 0 || is.IsEOF());
 
+	MPD_PROBE(input_read, is.GetURI(), dest.size(), nbytes);
+
 	return nbytes;
 } catch (...) {
 	error = std::current_exception();
 	return 0;
 }
 
+void
+DecoderBridge::CountRestart() noexcept
+{
+	++stats.restarts;
+}
+
 void
 DecoderBridge::SubmitTimestamp(FloatDuration t) noexcept
 {
@@ -449,6 +557,11 @@ DecoderBridge::SubmitAudio(InputStream *is,
 	assert(dc.pipe != nullptr);
 	assert(audio.size() % dc.in_audio_format.GetFrameSize() == 0);
 
+	MPD_PROBE(decoder_submit_audio, audio.size(), kbit_rate);
+
+	const auto submit_start = BeginSubmit();
+	AtScopeExit(this, submit_start) { EndSubmit(submit_start); };
+
 	DecoderCommand cmd = LockGetVirtualCommand();
 
 	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
@@ -460,47 +573,40 @@ DecoderBridge::SubmitAudio(InputStream *is,
 
 	/* send stream tags */
 
-	if (UpdateStreamTag(is)) {
-		if (decoder_tag != nullptr)
-			/* merge with tag from decoder plugin */
-			cmd = DoSendTag(Tag::Merge(*decoder_tag,
-						   *stream_tag));
-		else
-			/* send only the stream tag */
-			cmd = DoSendTag(*stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
-	}
-
-	cmd = DecoderCommand::NONE;
+	cmd = SendStreamTag(is);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
 
 	const size_t frame_size = dc.in_audio_format.GetFrameSize();
 	size_t data_frames = audio.size() / frame_size;
 
-	if (dc.end_time.IsPositive()) {
-		/* enforce the given end time */
+	/* enforce the given end time */
 
-		const auto end_frame =
-			dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
-		if (absolute_frame >= end_frame)
-			return DecoderCommand::STOP;
+	const uint64_t remaining_frames = GetRemainingFrames();
+	if (remaining_frames == 0)
+		return DecoderCommand::STOP;
 
-		const uint64_t remaining_frames = end_frame - absolute_frame;
-		if (data_frames >= remaining_frames) {
-			/* past the end of the range: truncate this
-			   data submission and stop the decoder */
-			data_frames = remaining_frames;
-			audio = audio.first(data_frames * frame_size);
-			cmd = DecoderCommand::STOP;
-		}
+	if (data_frames >= remaining_frames &&
+	    remaining_frames != UINT64_MAX) {
+		/* past the end of the range: truncate this data
+		   submission and stop the decoder */
+		data_frames = remaining_frames;
+		audio = audio.first(data_frames * frame_size);
+		cmd = DecoderCommand::STOP;
 	}
 
 	if (convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
 
 		try {
+			const auto convert_start = std::chrono::steady_clock::now();
 			audio = convert->Convert(audio);
+
+			const auto duration = std::chrono::steady_clock::now()
+				- convert_start;
+			stats.convert_time += duration;
+			if (duration > stats.max_convert_time)
+				stats.max_convert_time = duration;
 		} catch (...) {
 			/* the PCM conversion has failed - stop
 			   playback, since we have no better way to
@@ -552,6 +658,88 @@ DecoderBridge::SubmitAudio(InputStream *is,
 	}
 
 	absolute_frame += data_frames;
+	stats.frames += data_frames;
+
+	return cmd;
+}
+
+std::span<std::byte>
+DecoderBridge::GetAudioBuffer(InputStream *is, uint16_t kbit_rate) noexcept
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (convert != nullptr)
+		/* the plugin's data needs to be converted first */
+		return {};
+
+	const auto submit_start = BeginSubmit();
+	AtScopeExit(this, submit_start) { EndSubmit(submit_start); };
+
+	if (LockGetVirtualCommand() != DecoderCommand::NONE)
+		/* let SubmitAudio() deal with the command */
+		return {};
+
+	assert(!initial_seek_pending);
+	assert(!initial_seek_running);
+
+	if (SendStreamTag(is) != DecoderCommand::NONE ||
+	    GetRemainingFrames() == 0)
+		return {};
+
+	while (true) {
+		auto *chunk = GetChunk();
+		if (chunk == nullptr)
+			return {};
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::Cast(timestamp) -
+				     dc.song->GetStartTime(),
+				     kbit_rate);
+		if (!dest.empty())
+			return dest;
+
+		/* the chunk is full, flush it */
+		FlushChunk();
+	}
+}
+
+DecoderCommand
+DecoderBridge::CommitAudio(std::size_t nbytes) noexcept
+{
+	assert(current_chunk != nullptr);
+	assert(convert == nullptr);
+
+	const auto submit_start = BeginSubmit();
+	AtScopeExit(this, submit_start) { EndSubmit(submit_start); };
+
+	const size_t frame_size = dc.out_audio_format.GetFrameSize();
+	assert(nbytes % frame_size == 0);
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+
+	uint64_t data_frames = nbytes / frame_size;
+	if (const uint64_t remaining_frames = GetRemainingFrames();
+	    data_frames >= remaining_frames &&
+	    remaining_frames != UINT64_MAX) {
+		/* past the end of the range: truncate and stop the
+		   decoder */
+		data_frames = remaining_frames;
+		nbytes = data_frames * frame_size;
+		cmd = DecoderCommand::STOP;
+	}
+
+	if (current_chunk->Expand(dc.out_audio_format, nbytes))
+		/* the chunk is full, flush it */
+		FlushChunk();
+
+	timestamp += dc.out_audio_format.SizeToTime<FloatDuration>(nbytes);
+	absolute_frame += data_frames;
+	stats.frames += data_frames;
+
+	if (cmd == DecoderCommand::NONE)
+		cmd = LockGetVirtualCommand();
 
 	return cmd;
 }
@@ -629,3 +817,23 @@ DecoderBridge::SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept
 {
 	dc.SetMixRamp(std::move(mix_ramp));
 }
+
+void
+DecoderBridge::SubmitDuration(SongTime duration) noexcept
+{
+	const std::lock_guard protect{dc.mutex};
+	dc.detected_duration = duration;
+}
+
+void
+DecoderBridge::KeepContainer(const DecoderPlugin &plugin, Path path,
+			     std::unique_ptr<DecoderContainerState> &&state) noexcept
+{
+	dc.kept_container.Keep(plugin, path, std::move(state));
+}
+
+std::unique_ptr<DecoderContainerState>
+DecoderBridge::TakeContainer(const DecoderPlugin &plugin, Path path) noexcept
+{
+	return dc.kept_container.Take(plugin, path);
+}
@@ -4,9 +4,11 @@
 #pragma once
 
 #include "Client.hxx"
+#include "Stats.hxx"
 #include "tag/ReplayGainInfo.hxx"
 #include "MusicChunkPtr.hxx"
 
+#include <chrono>
 #include <cstddef>
 #include <exception>
 #include <memory>
@@ -75,7 +77,33 @@ private:
 	 */
 	std::unique_ptr<Tag> song_tag;
 
+	/**
+	 * When did the plugin return from the last audio submission
+	 * (or from Ready())?  The time since then is accounted as
+	 * #DecoderStats::render_time.
+	 */
+	std::chrono::steady_clock::time_point last_submit{};
+
+	/**
+	 * When did the current seek begin?  Unset if no seek is in
+	 * progress.
+	 */
+	std::chrono::steady_clock::time_point seek_start{};
+
+	/**
+	 * Has a chunk been pushed to the #MusicPipe since the
+	 * decoder was started or since the last seek?  Used to count
+	 * #DecoderStats::underruns.
+	 */
+	bool chunk_pushed = false;
+
 public:
+	/**
+	 * Performance counters of this song; they are copied to
+	 * DecoderControl::stats by PublishStats().
+	 */
+	DecoderStats stats;
+
 	/** the last tag received from the stream */
 	std::unique_ptr<Tag> stream_tag;
 
@@ -140,6 +168,13 @@ public:
 			FlushChunk();
 	}
 
+	/**
+	 * Copy #stats to DecoderControl::stats.
+	 *
+	 * Caller must lock the #DecoderControl object.
+	 */
+	void PublishStats() noexcept;
+
 	void CheckRethrowError() {
 		if (error)
 			std::rethrow_exception(error);
@@ -153,11 +188,13 @@ public:
 	/* virtual methods from DecoderClient */
 	void Ready(AudioFormat audio_format,
 		   bool seekable, SignedSongTime duration) noexcept override;
+	AudioFormat GetPreferredAudioFormat() noexcept override;
 	DecoderCommand GetCommand() noexcept override;
 	void CommandFinished() noexcept override;
 	SongTime GetSeekTime() noexcept override;
 	uint64_t GetSeekFrame() noexcept override;
 	void SeekError(std::exception_ptr &&_error) noexcept override;
+	void CountRestart() noexcept override;
 	InputStreamPtr OpenUri(std::string_view uri) override;
 	size_t Read(InputStream &is,
 		    std::span<std::byte> dest) noexcept override;
@@ -165,11 +202,38 @@ public:
 	DecoderCommand SubmitAudio(InputStream *is,
 				   std::span<const std::byte> audio,
 				   uint16_t kbit_rate) noexcept override;
+	std::span<std::byte> GetAudioBuffer(InputStream *is,
+					    uint16_t kbit_rate) noexcept override;
+	DecoderCommand CommitAudio(std::size_t nbytes) noexcept override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) noexcept override;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) noexcept override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept override;
+	void SubmitDuration(SongTime duration) noexcept override;
+	void KeepContainer(const DecoderPlugin &plugin, Path path,
+			   std::unique_ptr<DecoderContainerState> &&state) noexcept override;
+	std::unique_ptr<DecoderContainerState> TakeContainer(const DecoderPlugin &plugin,
+							     Path path) noexcept override;
 
 private:
+	/**
+	 * Called at the beginning of an audio submission; accounts
+	 * the time since the last one as render time.
+	 *
+	 * @return the current time, to be passed to EndSubmit()
+	 */
+	std::chrono::steady_clock::time_point BeginSubmit() noexcept;
+
+	/**
+	 * Called at the end of an audio submission.
+	 */
+	void EndSubmit(std::chrono::steady_clock::time_point start) noexcept;
+
+	/**
+	 * Account the seek which has just been finished (or has
+	 * failed) in #stats.
+	 */
+	void FinishSeekStats() noexcept;
+
 	/**
 	 * Checks if we need an "initial seek".  If so, then the
 	 * initial seek is prepared, and the function returns true.
@@ -191,4 +255,18 @@ private:
 	DecoderCommand DoSendTag(const Tag &tag) noexcept;
 
 	bool UpdateStreamTag(InputStream *is) noexcept;
+
+	/**
+	 * Check for a new stream tag and send it to the #MusicPipe
+	 * (merged with the decoder tag).
+	 */
+	DecoderCommand SendStreamTag(InputStream *is) noexcept;
+
+	/**
+	 * How many frames may still be submitted before the
+	 * configured end time is reached?  Returns UINT64_MAX if
+	 * there is no end time.
+	 */
+	[[gnu::pure]]
+	uint64_t GetRemainingFrames() const noexcept;
 };
@@ -4,18 +4,21 @@
 #pragma once
 
 #include "Command.hxx"
+#include "ContainerState.hxx"
 #include "Chrono.hxx"
 #include "input/Ptr.hxx"
+#include "pcm/AudioFormat.hxx"
 
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <memory>
 #include <span>
 #include <string_view>
 
-struct AudioFormat;
 struct Tag;
 struct ReplayGainInfo;
+struct DecoderPlugin;
 class MixRampInfo;
 
 /**
@@ -37,6 +40,18 @@ public:
 			   bool seekable,
 			   SignedSongTime duration) noexcept = 0;
 
+	/**
+	 * Returns the audio format the outputs would like to receive
+	 * (a mask; attributes which are not known are undefined).
+	 * Plugins which synthesize audio (e.g. emulators) may render
+	 * in this format to avoid conversion.  May be called before
+	 * Ready().
+	 */
+	[[gnu::pure]]
+	virtual AudioFormat GetPreferredAudioFormat() noexcept {
+		return AudioFormat::Undefined();
+	}
+
 	/**
 	 * Determines the pending decoder command.
 	 *
@@ -77,6 +92,13 @@ public:
 	 */
 	virtual void SeekError(std::exception_ptr &&error={}) noexcept = 0;
 
+	/**
+	 * The plugin had to restart decoding at the beginning of the
+	 * song, e.g. an emulator which cannot seek backwards.  This
+	 * is only used for statistics.
+	 */
+	virtual void CountRestart() noexcept {}
+
 	/**
 	 * Open a new #InputStream and wait until it's ready.
 	 *
@@ -145,6 +167,40 @@ public:
 		return SubmitAudio(is, audio_bytes, kbit_rate);
 	}
 
+	/**
+	 * Obtain a writable buffer inside the current #MusicChunk, so
+	 * the plugin can render PCM data into pipe memory without an
+	 * intermediate buffer.  After writing, call CommitAudio().
+	 *
+	 * This is only possible if no sample format conversion is
+	 * necessary.  If this returns an empty span (e.g. because a
+	 * conversion is necessary, a command is pending or the
+	 * client does not support this), the plugin must fall back
+	 * to SubmitAudio().
+	 *
+	 * @param is an input stream which is buffering while we are waiting
+	 * for the player
+	 * @param kbit_rate the current bit rate of the source
+	 * @return a buffer whose size is a multiple of the frame size,
+	 * or an empty span
+	 */
+	virtual std::span<std::byte> GetAudioBuffer([[maybe_unused]] InputStream *is,
+						    [[maybe_unused]] uint16_t kbit_rate) noexcept {
+		return {};
+	}
+
+	/**
+	 * Finish writing to the buffer returned by GetAudioBuffer().
+	 *
+	 * @param nbytes the number of bytes which were written; must
+	 * be a multiple of the frame size
+	 * @return the current command, or DecoderCommand::NONE if there is no
+	 * command pending
+	 */
+	virtual DecoderCommand CommitAudio([[maybe_unused]] std::size_t nbytes) noexcept {
+		return GetCommand();
+	}
+
 	/**
 	 * This function is called by the decoder plugin when it has
 	 * successfully decoded a tag.
@@ -173,4 +229,38 @@ public:
 	 * Store MixRamp tags.
 	 */
 	virtual void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept = 0;
+
+	/**
+	 * The plugin has found out the real duration of a song which
+	 * had none (or a wrong guess) when it called Ready(), e.g.
+	 * by detecting silence at the end of a synthesized song.  The
+	 * player updates the song's tag, and the database is updated
+	 * with a new scan.
+	 */
+	virtual void SubmitDuration([[maybe_unused]] SongTime duration) noexcept {}
+
+	/**
+	 * Keep the state of an open container file after the current
+	 * song has finished, so the next song (if it is another
+	 * subtune of the same file) can reuse it with
+	 * TakeContainer().  The default implementation discards it.
+	 *
+	 * @param plugin the calling plugin
+	 * @param path the local path of the container file
+	 */
+	virtual void KeepContainer([[maybe_unused]] const DecoderPlugin &plugin,
+				   [[maybe_unused]] Path path,
+				   [[maybe_unused]] std::unique_ptr<DecoderContainerState> &&state) noexcept {}
+
+	/**
+	 * Obtain the state passed to KeepContainer() by the previous
+	 * song, if it was kept by the same plugin for the same
+	 * container file.
+	 *
+	 * @return the state or nullptr
+	 */
+	virtual std::unique_ptr<DecoderContainerState> TakeContainer([[maybe_unused]] const DecoderPlugin &plugin,
+								     [[maybe_unused]] Path path) noexcept {
+		return nullptr;
+	}
 };
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "fs/AllocatedPath.hxx"
+
+#include <memory>
+
+struct DecoderPlugin;
+
+/**
+ * The state of an open container file (e.g. a game music file with
+ * many subtunes) which a decoder plugin keeps alive after one of its
+ * songs has finished.  If the next song is another subtune of the
+ * same file, the plugin only needs to switch tracks instead of
+ * opening and parsing the file again.
+ *
+ * Plugins derive from this class; see DecoderClient::KeepContainer()
+ * and DecoderClient::TakeContainer().
+ */
+class DecoderContainerState {
+public:
+	virtual ~DecoderContainerState() noexcept = default;
+};
+
+/**
+ * The one #DecoderContainerState kept by the decoder thread between
+ * two songs.
+ */
+class KeptDecoderContainer {
+	const DecoderPlugin *plugin = nullptr;
+
+	AllocatedPath path = nullptr;
+
+	std::unique_ptr<DecoderContainerState> state;
+
+public:
+	void Keep(const DecoderPlugin &_plugin, Path _path,
+		  std::unique_ptr<DecoderContainerState> &&_state) noexcept {
+		plugin = &_plugin;
+		path = AllocatedPath{_path};
+		state = std::move(_state);
+	}
+
+	/**
+	 * Return the state if it was kept by the given plugin for
+	 * the given container file.  In any case, the slot is empty
+	 * afterwards.
+	 */
+	std::unique_ptr<DecoderContainerState> Take(const DecoderPlugin &_plugin,
+						    Path _path) noexcept {
+		auto result = std::move(state);
+		if (result != nullptr &&
+		    (plugin != &_plugin || path != AllocatedPath{_path}))
+			result.reset();
+
+		Clear();
+		return result;
+	}
+
+	/**
+	 * Free the state unless the given song is (probably) a
+	 * subtune of the kept container, i.e. a "virtual" file
+	 * inside it.  This avoids keeping memory and resources
+	 * allocated while other files are played.
+	 *
+	 * @param song_path the local path of the next song; nullptr
+	 * if it is not a local file
+	 */
+	void DiscardUnlessInside(Path song_path) noexcept {
+		if (state != nullptr &&
+		    (song_path.IsNull() ||
+		     song_path.GetDirectoryName() != path))
+			Clear();
+	}
+
+	void Clear() noexcept {
+		state.reset();
+		path = nullptr;
+		plugin = nullptr;
+	}
+};
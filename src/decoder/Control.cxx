@@ -10,13 +10,18 @@
 
 DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond,
 			       InputCacheManager *_input_cache,
+			       const SongAnalysisStore *_song_analysis,
 			       const AudioFormat _configured_audio_format,
-			       const ReplayGainConfig &_replay_gain_config) noexcept
+			       const ReplayGainConfig &_replay_gain_config,
+			       const CpuAffinity &_cpu_affinity,
+			       bool _realtime) noexcept
 	:thread(BIND_THIS_METHOD(RunThread)),
 	 input_cache(_input_cache),
+	 song_analysis(_song_analysis),
 	 mutex(_mutex), client_cond(_client_cond),
 	 configured_audio_format(_configured_audio_format),
-	 replay_gain_config(_replay_gain_config) {}
+	 replay_gain_config(_replay_gain_config),
+	 cpu_affinity(_cpu_affinity), realtime(_realtime) {}
 
 DecoderControl::~DecoderControl() noexcept
 {
@@ -59,6 +64,23 @@ DecoderControl::IsCurrentSong(const DetachedSong &_song) const noexcept
 	std::unreachable();
 }
 
+AudioFormat
+DecoderControl::GetPreferredAudioFormat() const noexcept
+{
+	AudioFormat result = output_audio_format;
+
+	if (configured_audio_format.sample_rate != 0)
+		result.sample_rate = configured_audio_format.sample_rate;
+
+	if (configured_audio_format.format != SampleFormat::UNDEFINED)
+		result.format = configured_audio_format.format;
+
+	if (configured_audio_format.channels != 0)
+		result.channels = configured_audio_format.channels;
+
+	return result;
+}
+
 void
 DecoderControl::Start(std::unique_lock<Mutex> &lock,
 		      std::unique_ptr<DetachedSong> _song,
@@ -74,6 +96,7 @@ DecoderControl::Start(std::unique_lock<Mutex> &lock,
 	start_time = _start_time;
 	end_time = _end_time;
 	initial_seek_essential = _initial_seek_essential;
+	detected_duration = SignedSongTime::Negative();
 	buffer = &_buffer;
 	pipe = std::move(_pipe);
 
@@ -143,6 +166,8 @@ DecoderControl::Quit() noexcept
 {
 	assert(thread.IsDefined());
 
+	prefetch.Stop();
+
 	quit = true;
 	LockAsynchronousCommand(DecoderCommand::STOP);
 
@@ -5,12 +5,16 @@
 #define MPD_DECODER_CONTROL_HXX
 
 #include "Command.hxx"
+#include "Stats.hxx"
+#include "Prefetch.hxx"
+#include "ContainerState.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "tag/MixRampInfo.hxx"
 #include "input/Handler.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
+#include "thread/Affinity.hxx"
 #include "Chrono.hxx"
 #include "config/ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
@@ -30,6 +34,7 @@ class DetachedSong;
 class MusicBuffer;
 class MusicPipe;
 class InputCacheManager;
+class SongAnalysisStore;
 
 enum class DecoderState : uint8_t {
 	STOP = 0,
@@ -52,8 +57,21 @@ class DecoderControl final : public InputStreamHandler {
 	Thread thread;
 
 public:
+	/**
+	 * Prepares the next song while this decoder is still busy;
+	 * see #DecoderPrefetch.
+	 */
+	DecoderPrefetch prefetch;
+
 	InputCacheManager *const input_cache;
 
+	/**
+	 * Values calculated by the background analyzer which are
+	 * submitted before the song gets decoded; nullptr if
+	 * disabled.
+	 */
+	const SongAnalysisStore *const song_analysis;
+
 	/**
 	 * This lock protects #state and #command.
 	 *
@@ -115,6 +133,14 @@ private:
 	const AudioFormat configured_audio_format;
 
 public:
+	/**
+	 * The configured "format" of the first enabled output (see
+	 * PlayerOutputs::GetPreferredAudioFormat()).  This attribute
+	 * is set by the player thread before it sends
+	 * #DecoderCommand::START.
+	 */
+	AudioFormat output_audio_format = AudioFormat::Undefined();
+
 	/** the format of the song file */
 	AudioFormat in_audio_format;
 
@@ -146,6 +172,15 @@ public:
 
 	SignedSongTime total_time;
 
+	/**
+	 * The real duration of the song found by the decoder plugin
+	 * (see DecoderClient::SubmitDuration()); negative if there is
+	 * none.  The player thread consumes it.
+	 *
+	 * This attribute is reset by Start().
+	 */
+	SignedSongTime detected_duration = SignedSongTime::Negative();
+
 	/** the #MusicChunk allocator */
 	MusicBuffer *buffer;
 
@@ -156,11 +191,37 @@ public:
 	std::shared_ptr<MusicPipe> pipe;
 
 	const ReplayGainConfig replay_gain_config;
+
+	/**
+	 * The CPUs the decoder thread may run on; see
+	 * PlayerConfig::decoder_cpus.
+	 */
+	const CpuAffinity cpu_affinity;
+
+	/**
+	 * Shall the decoder thread use real-time scheduling?
+	 */
+	const bool realtime;
+
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
 	float replay_gain_db = 0;
 	float replay_gain_prev_db = 0;
 
+	/**
+	 * Performance counters of the song currently being decoded
+	 * (or the last one).  Protected by #mutex and updated by the
+	 * decoder thread, see DecoderBridge::PublishStats().
+	 */
+	DecoderStats stats;
+
+	/**
+	 * The container a decoder plugin has kept open after the
+	 * last song, see DecoderClient::KeepContainer().  Only
+	 * accessed by the decoder thread.
+	 */
+	KeptDecoderContainer kept_container;
+
 private:
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
@@ -171,8 +232,11 @@ public:
 	 */
 	DecoderControl(Mutex &_mutex, Cond &_client_cond,
 		       InputCacheManager *_input_cache,
+		       const SongAnalysisStore *_song_analysis,
 		       AudioFormat _configured_audio_format,
-		       const ReplayGainConfig &_replay_gain_config) noexcept;
+		       const ReplayGainConfig &_replay_gain_config,
+		       const CpuAffinity &_cpu_affinity,
+		       bool _realtime) noexcept;
 	~DecoderControl() noexcept;
 
 	/**
@@ -181,6 +245,7 @@ public:
 	void StartThread() {
 		quit = false;
 		thread.Start();
+		prefetch.Start();
 	}
 
 	/**
@@ -405,6 +470,15 @@ public:
 		return mix_ramp.GetStart();
 	}
 
+	/**
+	 * Returns the audio format the outputs would like to receive:
+	 * the "audio_output_format" setting, completed with the
+	 * configured format of the first enabled output.  Attributes
+	 * which are not known are undefined.
+	 */
+	[[gnu::pure]]
+	AudioFormat GetPreferredAudioFormat() const noexcept;
+
 	void SetMixRampStart(std::string &&s) noexcept {
 		mix_ramp.SetStart(std::move(s));
 	}
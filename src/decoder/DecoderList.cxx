@@ -44,6 +44,7 @@
 #include "util/CharUtil.hxx"
 
 #include <algorithm> // for std::any_of()
+#include <chrono>
 #include <iterator>
 #include <string>
 #include <unordered_map>
@@ -231,7 +232,9 @@ decoder_plugin_from_name(const char *name) noexcept
 void
 decoder_plugin_init_all(const ConfigData &config)
 {
-	ConfigBlock empty;
+	/* static because plugins with deferred initialization keep
+	   a pointer to it */
+	static const ConfigBlock empty;
 
 	for (unsigned i = 0; decoder_plugins[i] != nullptr; ++i) {
 		const DecoderPlugin &plugin = *decoder_plugins[i];
@@ -248,9 +251,25 @@ decoder_plugin_init_all(const ConfigData &config)
 		if (param != nullptr)
 			param->SetUsed();
 
+		if (plugin.lazy_init != nullptr) {
+			/* initialize it when it is used for the
+			   first time; until then, assume it is
+			   available */
+			plugin.DeferInit(*param);
+			decoder_plugins_enabled[i] = true;
+			continue;
+		}
+
 		try {
+			const auto start = std::chrono::steady_clock::now();
+
 			if (plugin.Init(*param))
 				decoder_plugins_enabled[i] = true;
+
+			FmtDebug(decoder_domain,
+				 "Decoder plugin {:?} initialized in {} ms",
+				 plugin.name,
+				 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
 		} catch (const PluginUnavailable &e) {
 			FmtError(decoder_domain,
 				 "Decoder plugin {:?} is unavailable: {}",
@@ -282,6 +301,17 @@ decoder_plugins_supports_suffix(std::string_view suffix) noexcept
 	return false;
 }
 
+bool
+decoder_plugins_serial_scan(std::string_view suffix) noexcept
+{
+	for (const auto &plugin : GetEnabledDecoderPlugins()) {
+		if (plugin.serial_scan && plugin.SupportsSuffix(suffix))
+			return true;
+	}
+
+	return false;
+}
+
 std::vector<const DecoderPlugin *>
 decoder_plugins_for_suffix(std::string_view suffix) noexcept
 {
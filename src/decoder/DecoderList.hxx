@@ -73,6 +73,15 @@ decoder_plugins_find(F f) noexcept
 bool
 decoder_plugins_supports_suffix(std::string_view suffix) noexcept;
 
+/**
+ * Is there at least one #DecoderPlugin that supports the specified
+ * file name suffix and whose scan methods are not reentrant (see
+ * DecoderPlugin::serial_scan)?
+ */
+[[gnu::pure]]
+bool
+decoder_plugins_serial_scan(std::string_view suffix) noexcept;
+
 /**
  * Return decoder plugins ordered by per-suffix priority overrides.
  */
@@ -2,12 +2,148 @@
 // Copyright The Music Player Daemon Project
 
 #include "DecoderPlugin.hxx"
+#include "LazyInit.hxx"
+#include "Domain.hxx"
+#include "PluginUnavailable.hxx"
+#include "config/Block.hxx"
+#include "config/Domain.hxx"
+#include "song/DetachedSong.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "fs/Path.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringUtil.hxx"
+#include "Log.hxx"
 
 #include <algorithm>
 #include <cassert>
 
+void
+DecoderPlugin::DeferInit(const ConfigBlock &block) const noexcept
+{
+	assert(lazy_init != nullptr);
+
+	auto &l = *lazy_init;
+	assert(l.state == DecoderLazyInit::State::NONE);
+
+	l.block = &block;
+
+	/* the plugin reads its settings only later; hide them from
+	   the startup Check() and check them in LazyInitialize()
+	   instead */
+	l.unchecked.clear();
+	for (const auto &i : block.block_params) {
+		if (!i.used) {
+			i.used = true;
+			l.unchecked.push_back(&i);
+		}
+	}
+
+	l.state.store(DecoderLazyInit::State::PENDING,
+		      std::memory_order_release);
+}
+
+bool
+DecoderPlugin::LazyInitialize() const noexcept
+{
+	auto &l = *lazy_init;
+
+	switch (l.state.load(std::memory_order_acquire)) {
+	case DecoderLazyInit::State::NONE:
+	case DecoderLazyInit::State::READY:
+		return true;
+
+	case DecoderLazyInit::State::PENDING:
+		break;
+
+	case DecoderLazyInit::State::FAILED:
+		return false;
+	}
+
+	const std::scoped_lock lock{l.mutex};
+
+	/* check again; another thread may have initialized it
+	   meanwhile */
+	if (const auto state = l.state.load(std::memory_order_relaxed);
+	    state != DecoderLazyInit::State::PENDING)
+		return state != DecoderLazyInit::State::FAILED;
+
+	FmtDebug(decoder_domain, "Initializing decoder plugin {:?}", name);
+
+	for (const auto *i : l.unchecked)
+		i->used = false;
+
+	bool success = false;
+
+	try {
+		success = Init(*l.block);
+	} catch (const PluginUnavailable &e) {
+		FmtError(decoder_domain,
+			 "Decoder plugin {:?} is unavailable: {}",
+			 name, std::current_exception());
+	} catch (...) {
+		FmtError(decoder_domain,
+			 "Failed to initialize decoder plugin {:?}: {}",
+			 name, std::current_exception());
+	}
+
+	for (const auto *i : l.unchecked) {
+		if (!i->used) {
+			FmtWarning(config_domain,
+				   "option {:?} on line {} was not recognized",
+				   i->name, i->line);
+			i->used = true;
+		}
+	}
+
+	l.unchecked = {};
+
+	l.state.store(success
+		      ? DecoderLazyInit::State::READY
+		      : DecoderLazyInit::State::FAILED,
+		      std::memory_order_release);
+	return success;
+}
+
+void
+DecoderPlugin::Finish() const noexcept
+{
+	if (finish == nullptr)
+		return;
+
+	if (lazy_init != nullptr) {
+		const auto state = lazy_init->state.load(std::memory_order_acquire);
+		if (state == DecoderLazyInit::State::PENDING ||
+		    state == DecoderLazyInit::State::FAILED)
+			/* init() has never been called or has
+			   failed */
+			return;
+	}
+
+	finish();
+}
+
+std::forward_list<DetachedSong>
+DecoderPlugin::ContainerScan(Path path_fs) const
+{
+	assert(container_scan != nullptr);
+
+	if (!EnsureInitialized())
+		return {};
+
+	return container_scan(path_fs);
+}
+
+void
+DecoderPlugin::Prefetch(Path path_fs,
+			AudioFormat preferred_format) const noexcept
+{
+	assert(prefetch != nullptr);
+
+	if (EnsureInitialized())
+		prefetch(path_fs, preferred_format);
+}
+
 bool
 DecoderPlugin::SupportsUri(const std::string_view uri) const noexcept
 {
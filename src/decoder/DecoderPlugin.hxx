@@ -10,11 +10,13 @@
 #include <string_view>
 
 struct ConfigBlock;
+struct AudioFormat;
 class InputStream;
 class TagHandler;
 class Path;
 class DecoderClient;
 class DetachedSong;
+class DecoderLazyInit;
 
 struct DecoderPlugin {
 	const char *name;
@@ -97,10 +99,40 @@ struct DecoderPlugin {
 	 */
 	std::forward_list<DetachedSong> (*container_scan)(Path path_fs) = nullptr;
 
+	/**
+	 * Prepare decoding a local file which is going to be played
+	 * soon, e.g. load and parse it into a plugin-internal cache,
+	 * so the following file_decode() call can start rendering
+	 * without delay.  This is called on a helper thread while
+	 * another song is playing.  Optional method.
+	 *
+	 * @param path_fs the file name, which may also be a "virtual"
+	 * path inside a container file
+	 * @param preferred_format the value which
+	 * DecoderClient::GetPreferredAudioFormat() is going to return
+	 */
+	void (*prefetch)(Path path_fs,
+			 AudioFormat preferred_format) noexcept = nullptr;
+
 	/* last element in these arrays must always be a nullptr: */
 	const char *const*suffixes = nullptr;
 	const char *const*mime_types = nullptr;
 
+	/**
+	 * If set, then decoder_plugin_init_all() does not call
+	 * init(), but postpones it until the plugin is used for the
+	 * first time.  See WithLazyInit().
+	 */
+	DecoderLazyInit *lazy_init = nullptr;
+
+	/**
+	 * If true, then scan_file(), scan_stream() and
+	 * container_scan() are not reentrant (e.g. because the
+	 * library keeps global state), and the database update does
+	 * not run them in parallel.  See WithSerialScan().
+	 */
+	bool serial_scan = false;
+
 	constexpr DecoderPlugin(const char *_name,
 				void (*_file_decode)(DecoderClient &client,
 						     Path path_fs),
@@ -139,6 +171,32 @@ struct DecoderPlugin {
 		return copy;
 	}
 
+	/**
+	 * Postpone the init() call until the plugin is used for the
+	 * first time, i.e. when the first matching file gets scanned
+	 * or decoded.  This is useful for plugins whose init() is
+	 * expensive (e.g. because it loads large data files).  The
+	 * plugin must provide static #suffixes and #mime_types
+	 * because they are needed before init().
+	 *
+	 * @param state a static object owned by the plugin
+	 */
+	constexpr auto WithLazyInit(DecoderLazyInit &state) const noexcept {
+		auto copy = *this;
+		copy.lazy_init = &state;
+		return copy;
+	}
+
+	/**
+	 * Declare that the scan methods must not be called by more
+	 * than one thread at a time.
+	 */
+	constexpr auto WithSerialScan() const noexcept {
+		auto copy = *this;
+		copy.serial_scan = true;
+		return copy;
+	}
+
 	constexpr auto WithContainer(std::forward_list<DetachedSong> (*_container_scan)(Path path_fs)) const noexcept {
 		auto copy = *this;
 		copy.container_scan = _container_scan;
@@ -171,6 +229,13 @@ struct DecoderPlugin {
 		return copy;
 	}
 
+	constexpr auto WithPrefetch(void (*_prefetch)(Path path_fs,
+						      AudioFormat preferred_format) noexcept) const noexcept {
+		auto copy = *this;
+		copy.prefetch = _prefetch;
+		return copy;
+	}
+
 	/**
 	 * Initialize a decoder plugin.
 	 *
@@ -185,25 +250,42 @@ struct DecoderPlugin {
 	}
 
 	/**
-	 * Deinitialize a decoder plugin which was initialized successfully.
+	 * Remember the configuration block for the first use of a
+	 * plugin with #lazy_init instead of initializing it now.
+	 * The block must remain valid until Finish().
 	 */
-	void Finish() const {
-		if (finish != nullptr)
-			finish();
+	void DeferInit(const ConfigBlock &block) const noexcept;
+
+	/**
+	 * Make sure the plugin has been initialized (if its init()
+	 * was deferred by DeferInit()).  This is called implicitly by
+	 * all the methods below.
+	 *
+	 * @return false if the plugin is not available
+	 */
+	bool EnsureInitialized() const noexcept {
+		return lazy_init == nullptr || LazyInitialize();
 	}
 
+	/**
+	 * Deinitialize a decoder plugin which was initialized successfully.
+	 */
+	void Finish() const noexcept;
+
 	/**
 	 * Decode a stream.
 	 */
 	void StreamDecode(DecoderClient &client, InputStream &is) const {
-		stream_decode(client, is);
+		if (EnsureInitialized())
+			stream_decode(client, is);
 	}
 
 	/**
 	 * Decode an URI which is supported (check SupportsUri()).
 	 */
 	void UriDecode(DecoderClient &client, const char *uri) const {
-		uri_decode(client, uri);
+		if (EnsureInitialized())
+			uri_decode(client, uri);
 	}
 
 	/**
@@ -211,7 +293,8 @@ struct DecoderPlugin {
 	 */
 	template<typename P>
 	void FileDecode(DecoderClient &client, P path_fs) const {
-		file_decode(client, path_fs);
+		if (EnsureInitialized())
+			file_decode(client, path_fs);
 	}
 
 	/**
@@ -219,7 +302,7 @@ struct DecoderPlugin {
 	 */
 	template<typename P>
 	bool ScanFile(P path_fs, TagHandler &handler) const {
-		return scan_file != nullptr
+		return scan_file != nullptr && EnsureInitialized()
 			? scan_file(path_fs, handler)
 			: false;
 	}
@@ -228,11 +311,23 @@ struct DecoderPlugin {
 	 * Read the tag of a stream.
 	 */
 	bool ScanStream(InputStream &is, TagHandler &handler) const {
-		return scan_stream != nullptr
+		return scan_stream != nullptr && EnsureInitialized()
 			? scan_stream(is, handler)
 			: false;
 	}
 
+	/**
+	 * List the "virtual" songs of a container file (see
+	 * #container_scan, which must be set).
+	 */
+	std::forward_list<DetachedSong> ContainerScan(Path path_fs) const;
+
+	/**
+	 * Prepare decoding a local file (see #prefetch, which must be
+	 * set).
+	 */
+	void Prefetch(Path path_fs, AudioFormat preferred_format) const noexcept;
+
 	[[gnu::pure]]
 	bool SupportsUri(std::string_view uri) const noexcept;
 
@@ -251,6 +346,9 @@ struct DecoderPlugin {
 	bool SupportsContainerSuffix(std::string_view suffix) const noexcept {
 		return container_scan != nullptr && SupportsSuffix(suffix);
 	}
+
+private:
+	bool LazyInitialize() const noexcept;
 };
 
 #endif
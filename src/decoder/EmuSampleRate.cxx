@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "EmuSampleRate.hxx"
+#include "Client.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+#include "pcm/CheckAudioFormat.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "util/StringCompare.hxx"
+
+unsigned
+ParseEmuSampleRate(const ConfigBlock &block, unsigned default_value)
+{
+	const auto *param = block.GetBlockParam("sample_rate");
+	if (param == nullptr)
+		return default_value;
+
+	return param->With([default_value](const char *s){
+		if (StringIsEqual(s, "auto"))
+			return 0U;
+
+		if (default_value == EMU_NATIVE_SAMPLE_RATE &&
+		    StringIsEqual(s, "0"))
+			return EMU_NATIVE_SAMPLE_RATE;
+
+		const unsigned value = ParsePositive(s);
+		if (!audio_valid_sample_rate(value))
+			throw FmtRuntimeError("Invalid sample rate: {}",
+					      value);
+		return value;
+	});
+}
+
+unsigned
+GetEmuSampleRate(DecoderClient *client, unsigned configured,
+		 unsigned fallback) noexcept
+{
+	if (configured == EMU_NATIVE_SAMPLE_RATE)
+		return 0;
+
+	if (configured != 0)
+		return configured;
+
+	if (client != nullptr)
+		if (const auto af = client->GetPreferredAudioFormat();
+		    af.sample_rate != 0)
+			return af.sample_rate;
+
+	return fallback;
+}
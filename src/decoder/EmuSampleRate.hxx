@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+struct ConfigBlock;
+class DecoderClient;
+
+/**
+ * A special value for ParseEmuSampleRate()'s default_value for
+ * plugins which can render at the emulator's native rate instead of
+ * resampling; the setting "0" selects it explicitly.
+ */
+static constexpr unsigned EMU_NATIVE_SAMPLE_RATE = ~0U;
+
+/**
+ * Parse the "sample_rate" setting of a decoder plugin which
+ * synthesizes audio at an arbitrary rate.  The value "auto" is
+ * returned as 0.
+ *
+ * Throws on error.
+ *
+ * @param default_value the value if the setting is missing
+ */
+unsigned
+ParseEmuSampleRate(const ConfigBlock &block, unsigned default_value);
+
+/**
+ * Determine the sample rate for synthesizing.
+ *
+ * @param client the decoder client (for "auto"); nullptr when
+ * scanning, where the sample rate does not matter
+ * @param configured the return value of ParseEmuSampleRate()
+ * @param fallback the sample rate if "auto" was configured and the
+ * outputs' sample rate is not known
+ * @return the sample rate or 0 for EMU_NATIVE_SAMPLE_RATE
+ */
+[[gnu::pure]]
+unsigned
+GetEmuSampleRate(DecoderClient *client, unsigned configured,
+		 unsigned fallback) noexcept;
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "EmuSeek.hxx"
+#include "Client.hxx"
+#include "Chrono.hxx"
+
+EmuSeeker::EmuSeeker(EmuSeekHandler &_handler, unsigned _sample_rate,
+		     std::size_t max_bytes) noexcept
+	:handler(_handler),
+	 snapshots(handler.GetEmuState().size(),
+		   uint64_t(SNAPSHOT_INTERVAL_S) * _sample_rate,
+		   max_bytes),
+	 sample_rate(_sample_rate)
+{
+}
+
+void
+EmuSeeker::Advance(uint64_t frames) noexcept
+{
+	position += frames;
+	snapshots.Update(position, handler.GetEmuState());
+}
+
+bool
+EmuSeeker::SeekTo(uint64_t target, DecoderClient *client) noexcept
+{
+	const auto snapshot = snapshots.Find(target);
+
+	if (target >= position && (!snapshot || *snapshot <= position)) {
+		/* continue from the current position */
+	} else if (snapshot) {
+		position = *snapshots.Restore(target, handler.GetEmuState());
+	} else {
+		if (!handler.EmuRestart())
+			return false;
+
+		if (client != nullptr)
+			client->CountRestart();
+
+		position = 0;
+	}
+
+	while (position < target) {
+		const uint64_t n = handler.EmuSkip(target - position);
+		if (n == 0)
+			return false;
+
+		Advance(n);
+	}
+
+	return true;
+}
+
+bool
+EmuSeeker::Seek(DecoderClient &client) noexcept
+{
+	if (!SeekTo(client.GetSeekFrame(), &client)) {
+		client.SeekError();
+		return false;
+	}
+
+	client.CommandFinished();
+	client.SubmitTimestamp(FloatDuration(double(position) / sample_rate));
+	return true;
+}
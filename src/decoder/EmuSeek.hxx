@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "EmuSnapshot.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+class DecoderClient;
+
+/**
+ * The emulator specific part of #EmuSeeker.
+ */
+class EmuSeekHandler {
+public:
+	/**
+	 * Return the emulator to the beginning of the song.
+	 *
+	 * @return false on error
+	 */
+	virtual bool EmuRestart() noexcept = 0;
+
+	/**
+	 * Render and discard audio.
+	 *
+	 * @param max_frames the number of frames which should be
+	 * skipped; the emulator may render more than this
+	 * @return the number of frames which were rendered; 0 on
+	 * error or at the end of the song
+	 */
+	virtual uint64_t EmuSkip(uint64_t max_frames) noexcept = 0;
+
+	/**
+	 * Returns the memory block which contains the complete
+	 * emulator state.  #EmuSeeker copies it to take snapshots
+	 * and overwrites it to restore one.  Returns an empty span if
+	 * the emulator state cannot be saved this way.
+	 */
+	virtual std::span<std::byte> GetEmuState() noexcept {
+		return {};
+	}
+};
+
+/**
+ * A seek implementation for emulator plugins which cannot seek
+ * natively.  It tracks the exact playback position, takes periodic
+ * snapshots of the emulator state (if the #EmuSeekHandler supports
+ * them) and renders only the remainder after restoring the nearest
+ * snapshot.
+ */
+class EmuSeeker {
+	EmuSeekHandler &handler;
+
+	EmuSnapshotPool snapshots;
+
+	const unsigned sample_rate;
+
+	/**
+	 * The current position of the emulator [frames].
+	 */
+	uint64_t position = 0;
+
+public:
+	/**
+	 * Take a snapshot every 30 seconds of playback.
+	 */
+	static constexpr unsigned SNAPSHOT_INTERVAL_S = 30;
+
+	/**
+	 * The default maximum amount of memory occupied by the
+	 * snapshots of one song.
+	 */
+	static constexpr std::size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+	EmuSeeker(EmuSeekHandler &_handler, unsigned _sample_rate,
+		  std::size_t max_bytes=DEFAULT_MAX_BYTES) noexcept;
+
+	EmuSeeker(const EmuSeeker &) = delete;
+	EmuSeeker &operator=(const EmuSeeker &) = delete;
+
+	uint64_t GetPosition() const noexcept {
+		return position;
+	}
+
+	/**
+	 * The emulator has rendered the given number of frames for
+	 * playback.
+	 */
+	void Advance(uint64_t frames) noexcept;
+
+	/**
+	 * Handle #DecoderCommand::SEEK: move the emulator to the seek
+	 * target, finish the command and submit the exact new
+	 * position with DecoderClient::SubmitTimestamp().
+	 *
+	 * @return false if seeking has failed (the error has been
+	 * reported with DecoderClient::SeekError())
+	 */
+	bool Seek(DecoderClient &client) noexcept;
+
+	/**
+	 * Move the emulator to the given position (or slightly
+	 * after it, see EmuSeekHandler::EmuSkip()).
+	 *
+	 * @param client if not nullptr, restarts are reported with
+	 * DecoderClient::CountRestart()
+	 * @return false on error
+	 */
+	bool SeekTo(uint64_t target, DecoderClient *client=nullptr) noexcept;
+};
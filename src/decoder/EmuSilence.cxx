@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "EmuSilence.hxx"
+#include "Client.hxx"
+#include "Domain.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Path.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
+#include "Log.hxx"
+
+#include <cmath>
+#include <cstdlib> // for std::abs()
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+EmuSilenceConfig
+ParseEmuSilenceConfig(const ConfigBlock &block)
+{
+	EmuSilenceConfig config;
+
+	if (const auto *param = block.GetBlockParam("silence_threshold"))
+		config.threshold = param->With([](const char *s){
+			/* in dBFS */
+			const double db = ParseDouble(s);
+			if (db > 0)
+				throw FmtRuntimeError("Invalid silence threshold: {:?}",
+						      s);
+
+			return static_cast<int>(32768 * std::pow(10.0, db / 20));
+		});
+
+	config.duration = block.GetDuration("silence_duration",
+					    std::chrono::steady_clock::duration::zero(),
+					    config.duration);
+
+	return config;
+}
+
+EmuSilenceDetector::EmuSilenceDetector(const EmuSilenceConfig &config,
+				       unsigned _sample_rate,
+				       unsigned _channels) noexcept
+	:threshold(config.threshold),
+	 sample_rate(_sample_rate), channels(_channels),
+	 min_frames(std::chrono::duration_cast<std::chrono::milliseconds>(config.duration).count() *
+		    sample_rate / 1000)
+{
+}
+
+bool
+EmuSilenceDetector::Feed(std::span<const int16_t> samples) noexcept
+{
+	/* search backwards for the last sound; in loud passages,
+	   this returns after the first sample */
+	for (std::size_t i = samples.size(); i > 0; --i) {
+		if (std::abs(samples[i - 1]) > threshold) {
+			silence_start = position + (i - 1) / channels + 1;
+			break;
+		}
+	}
+
+	position += samples.size() / channels;
+
+	return min_frames > 0 && silence_start > 0 &&
+		position - silence_start >= min_frames;
+}
+
+/**
+ * Limit the size of the cache; only songs which are being played
+ * are added, so this is plenty.
+ */
+static constexpr std::size_t EMU_LENGTH_CACHE_MAX_ITEMS = 4096;
+
+namespace {
+
+/**
+ * Identifies the version of a file; a cached length is discarded
+ * when the file is modified.
+ */
+struct EmuLengthValidator {
+	std::chrono::system_clock::time_point mtime;
+	uint_least64_t size;
+
+	bool operator==(const EmuLengthValidator &) const noexcept = default;
+};
+
+struct EmuLengthItem {
+	std::string path;
+	EmuLengthValidator validator;
+	SongTime length;
+};
+
+} // anonymous namespace
+
+static Mutex emu_length_mutex;
+
+/**
+ * All items, the most recently used first.
+ */
+static std::list<EmuLengthItem> emu_length_lru;
+
+/**
+ * An index of #emu_length_lru; the keys point to
+ * EmuLengthItem::path.
+ */
+static std::unordered_map<std::string_view,
+			  std::list<EmuLengthItem>::iterator> emu_length_cache;
+
+/**
+ * Obtain the validator of the given file.  For songs inside a
+ * container, the container file is used.
+ */
+static EmuLengthValidator
+GetEmuLengthValidator(Path path) noexcept
+{
+	FileInfo info;
+	if (GetFileInfo(path, info) ||
+	    GetFileInfo(path.GetDirectoryName(), info))
+		return {info.GetModificationTime(), info.GetSize()};
+
+	return {};
+}
+
+void
+RememberEmuLength(Path path, SongTime length) noexcept
+try {
+	auto key = path.ToUTF8();
+	const auto validator = GetEmuLengthValidator(path);
+
+	const std::scoped_lock lock{emu_length_mutex};
+
+	if (const auto i = emu_length_cache.find(key);
+	    i != emu_length_cache.end()) {
+		i->second->validator = validator;
+		i->second->length = length;
+		emu_length_lru.splice(emu_length_lru.begin(),
+				      emu_length_lru, i->second);
+		return;
+	}
+
+	if (emu_length_lru.size() >= EMU_LENGTH_CACHE_MAX_ITEMS) {
+		/* evict the least recently used item */
+		emu_length_cache.erase(emu_length_lru.back().path);
+		emu_length_lru.pop_back();
+	}
+
+	emu_length_lru.push_front({std::move(key), validator, length});
+	try {
+		emu_length_cache.emplace(emu_length_lru.front().path,
+					 emu_length_lru.begin());
+	} catch (...) {
+		emu_length_lru.pop_front();
+		throw;
+	}
+} catch (...) {
+	/* out of memory: ignore */
+}
+
+void
+SubmitEmuLength(DecoderClient &client, Path path, SongTime length) noexcept
+{
+	FmtDebug(decoder_domain, "detected silence after {}s",
+		 length.ToDoubleS());
+
+	RememberEmuLength(path, length);
+	client.SubmitDuration(length);
+}
+
+SignedSongTime
+LookupEmuLength(Path path) noexcept
+{
+	const auto key = path.ToUTF8();
+	const auto validator = GetEmuLengthValidator(path);
+
+	const std::scoped_lock lock{emu_length_mutex};
+
+	const auto i = emu_length_cache.find(key);
+	if (i == emu_length_cache.end())
+		return SignedSongTime::Negative();
+
+	const auto item = i->second;
+	if (item->validator != validator) {
+		/* the file was modified */
+		emu_length_cache.erase(i);
+		emu_length_lru.erase(item);
+		return SignedSongTime::Negative();
+	}
+
+	emu_length_lru.splice(emu_length_lru.begin(), emu_length_lru, item);
+	return item->length;
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Chrono.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+
+struct ConfigBlock;
+class Path;
+class DecoderClient;
+
+/**
+ * The "silence_threshold" and "silence_duration" settings of a
+ * decoder plugin which synthesizes audio.
+ */
+struct EmuSilenceConfig {
+	/**
+	 * The maximum absolute S16 sample value which is considered
+	 * silence.
+	 */
+	int threshold = 32;
+
+	/**
+	 * How long the silence must last to end the song; zero
+	 * disables the detector.
+	 */
+	std::chrono::steady_clock::duration duration = std::chrono::seconds{5};
+
+	constexpr bool IsEnabled() const noexcept {
+		return duration > std::chrono::steady_clock::duration::zero();
+	}
+};
+
+/**
+ * Parse the "silence_threshold" (dBFS) and "silence_duration"
+ * settings.
+ *
+ * Throws on error.
+ */
+EmuSilenceConfig
+ParseEmuSilenceConfig(const ConfigBlock &block);
+
+/**
+ * Detects the end of a song without length metadata: once the
+ * emulator has rendered some sound followed by silence for the
+ * configured duration, the song is over.  Leading silence is
+ * ignored.
+ */
+class EmuSilenceDetector {
+	const int threshold;
+
+	const unsigned sample_rate, channels;
+
+	/**
+	 * The minimum duration of the final silence [frames].
+	 */
+	const uint64_t min_frames;
+
+	/**
+	 * The number of frames passed to Feed() [frames].
+	 */
+	uint64_t position = 0;
+
+	/**
+	 * The position of the frame after the last sound [frames];
+	 * 0 if there was no sound yet.
+	 */
+	uint64_t silence_start = 0;
+
+public:
+	EmuSilenceDetector(const EmuSilenceConfig &config,
+			   unsigned sample_rate, unsigned _channels) noexcept;
+
+	/**
+	 * Check the audio which was just rendered.
+	 *
+	 * @param samples interleaved samples, a whole number of
+	 * frames
+	 * @return true if the song is over
+	 */
+	bool Feed(std::span<const int16_t> samples) noexcept;
+
+	/**
+	 * Start over at the given position after seeking.
+	 */
+	void Reset(uint64_t _position) noexcept {
+		position = _position;
+		silence_start = 0;
+	}
+
+	/**
+	 * Returns the position where the final silence began, i.e.
+	 * the real length of the song [frames].  Only valid after
+	 * Feed() has returned true.
+	 */
+	uint64_t GetSilenceStart() const noexcept {
+		return silence_start;
+	}
+
+	/**
+	 * Like GetSilenceStart(), but returns a #SongTime.
+	 */
+	SongTime GetLength() const noexcept {
+		return SongTime::FromScale<uint64_t>(silence_start,
+						     sample_rate);
+	}
+};
+
+/**
+ * Remember the song length found by #EmuSilenceDetector, so the
+ * next scan (e.g. the database update) and the next playback of
+ * this song can use it instead of a default length.  This is a
+ * process-wide cache shared by all emulator plugins; the least
+ * recently used items are evicted when it is full, and an item is
+ * discarded when the modification time or the size of the file
+ * changes.
+ *
+ * @param path the path passed to the decoder plugin (including
+ * the subtune suffix of container plugins)
+ */
+void
+RememberEmuLength(Path path, SongTime length) noexcept;
+
+/**
+ * The #EmuSilenceDetector has found the end of the song: remember
+ * its length (see RememberEmuLength()) and pass it to
+ * DecoderClient::SubmitDuration().
+ */
+void
+SubmitEmuLength(DecoderClient &client, Path path, SongTime length) noexcept;
+
+/**
+ * Look up a length which was passed to RememberEmuLength().
+ *
+ * @return the length or a negative value if there is none
+ */
+SignedSongTime
+LookupEmuLength(Path path) noexcept;
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "EmuSnapshot.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+void
+EmuSnapshotPool::Thin() noexcept
+{
+	std::size_t n = 0;
+	for (std::size_t i = 1; i < snapshots.size(); i += 2)
+		snapshots[n++] = std::move(snapshots[i]);
+
+	snapshots.resize(n);
+	interval *= 2;
+}
+
+void
+EmuSnapshotPool::Update(uint64_t frame,
+			std::span<const std::byte> state) noexcept
+{
+	if (max_snapshots == 0 || frame < GetLatestFrame() + interval)
+		return;
+
+	assert(state.size() == state_size);
+
+	if (snapshots.size() >= max_snapshots) {
+		Thin();
+
+		if (frame < GetLatestFrame() + interval)
+			return;
+	}
+
+	std::unique_ptr<std::byte[]> data{new(std::nothrow) std::byte[state_size]};
+	if (data == nullptr)
+		return;
+
+	std::memcpy(data.get(), state.data(), state_size);
+
+	try {
+		snapshots.push_back({frame, std::move(data)});
+	} catch (const std::bad_alloc &) {
+	}
+}
+
+const EmuSnapshotPool::Snapshot *
+EmuSnapshotPool::Lookup(uint64_t frame) const noexcept
+{
+	auto i = std::upper_bound(snapshots.begin(), snapshots.end(), frame,
+				  [](uint64_t f, const Snapshot &s){
+					  return f < s.frame;
+				  });
+	if (i == snapshots.begin())
+		return nullptr;
+
+	return &*std::prev(i);
+}
+
+std::optional<uint64_t>
+EmuSnapshotPool::Find(uint64_t frame) const noexcept
+{
+	const auto *s = Lookup(frame);
+	if (s == nullptr)
+		return std::nullopt;
+
+	return s->frame;
+}
+
+std::optional<uint64_t>
+EmuSnapshotPool::Restore(uint64_t frame,
+			 std::span<std::byte> state) const noexcept
+{
+	const auto *s = Lookup(frame);
+	if (s == nullptr)
+		return std::nullopt;
+
+	assert(state.size() == state_size);
+	std::memcpy(state.data(), s->data.get(), state_size);
+	return s->frame;
+}
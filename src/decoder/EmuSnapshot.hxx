@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * A bounded collection of emulator state snapshots taken at regular
+ * intervals during playback.  A seek restores the nearest snapshot
+ * before the target position, so only the remainder needs to be
+ * rendered.
+ *
+ * This only works for emulators whose complete state lives in one
+ * caller-allocated memory block.
+ */
+class EmuSnapshotPool {
+	struct Snapshot {
+		uint64_t frame;
+		std::unique_ptr<std::byte[]> data;
+	};
+
+	/**
+	 * Snapshots sorted by frame position.
+	 */
+	std::vector<Snapshot> snapshots;
+
+	const std::size_t state_size;
+	const std::size_t max_snapshots;
+
+	/**
+	 * The distance between two snapshots [frames].  Doubled each
+	 * time the pool is full and half of the snapshots are
+	 * discarded.
+	 */
+	uint64_t interval;
+
+public:
+	/**
+	 * @param _interval the distance between two snapshots [frames]
+	 * @param max_bytes the maximum amount of memory occupied by
+	 * all snapshots
+	 */
+	EmuSnapshotPool(std::size_t _state_size, uint64_t _interval,
+			std::size_t max_bytes) noexcept
+		:state_size(_state_size),
+		 max_snapshots(_state_size > 0 ? max_bytes / _state_size : 0),
+		 interval(_interval > 0 ? _interval : 1) {}
+
+	EmuSnapshotPool(const EmuSnapshotPool &) = delete;
+	EmuSnapshotPool &operator=(const EmuSnapshotPool &) = delete;
+
+	/**
+	 * Take a snapshot of the given state if the playback position
+	 * has advanced far enough past the latest one.  Call this
+	 * after each rendered block.
+	 *
+	 * @param frame the current playback position [frames]
+	 */
+	void Update(uint64_t frame, std::span<const std::byte> state) noexcept;
+
+	/**
+	 * Find the latest snapshot at or before the given position.
+	 *
+	 * @return the position of the snapshot or nullopt if there is
+	 * none
+	 */
+	[[gnu::pure]]
+	std::optional<uint64_t> Find(uint64_t frame) const noexcept;
+
+	/**
+	 * Copy the latest snapshot at or before the given position
+	 * into the emulator state.
+	 *
+	 * @return the position of the restored snapshot or nullopt if
+	 * there is none (the caller must restart the emulator)
+	 */
+	std::optional<uint64_t> Restore(uint64_t frame,
+					std::span<std::byte> state) const noexcept;
+
+private:
+	[[gnu::pure]]
+	const Snapshot *Lookup(uint64_t frame) const noexcept;
+
+	uint64_t GetLatestFrame() const noexcept {
+		return snapshots.empty() ? 0 : snapshots.back().frame;
+	}
+
+	/**
+	 * Discard every other snapshot and double the interval.
+	 */
+	void Thin() noexcept;
+};
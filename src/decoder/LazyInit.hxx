@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "thread/Mutex.hxx"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+struct ConfigBlock;
+struct BlockParam;
+
+/**
+ * The runtime state of a #DecoderPlugin whose init() method is
+ * deferred until the plugin is used for the first time (see
+ * DecoderPlugin::WithLazyInit()).  Each such plugin owns one static
+ * instance of this class.
+ */
+class DecoderLazyInit {
+	friend struct DecoderPlugin;
+
+	enum class State : uint_least8_t {
+		/**
+		 * DecoderPlugin::DeferInit() has not been called;
+		 * the plugin was initialized (or not) by calling
+		 * DecoderPlugin::Init() directly.
+		 */
+		NONE,
+
+		/**
+		 * DecoderPlugin::DeferInit() has been called, but
+		 * the plugin has not been used yet.
+		 */
+		PENDING,
+
+		READY,
+
+		/**
+		 * DecoderPlugin::init() has failed; the plugin will
+		 * not be used.
+		 */
+		FAILED,
+	};
+
+	std::atomic<State> state{State::NONE};
+
+	/**
+	 * Serializes concurrent first uses.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The configuration block to be passed to
+	 * DecoderPlugin::init().  It is owned by the global
+	 * #ConfigData.
+	 */
+	const ConfigBlock *block = nullptr;
+
+	/**
+	 * The settings of #block which have been hidden from the
+	 * startup Check(); they are checked after init() instead.
+	 */
+	std::vector<const BlockParam *> unchecked;
+};
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Prefetch.hxx"
+#include "DecoderList.hxx"
+#include "DecoderPlugin.hxx"
+#include "Domain.hxx"
+#include "input/Prefetch.hxx"
+#include "song/DetachedSong.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Traits.hxx"
+#include "thread/Name.hxx"
+#include "thread/ScopeUnlock.hxx"
+#include "Log.hxx"
+
+#include <cassert>
+
+/**
+ * Call DecoderPlugin::prefetch() of all plugins which support the
+ * suffix of the given file.
+ */
+static void
+PrefetchFile(const char *uri_utf8, Path path_fs,
+	     AudioFormat preferred_format) noexcept
+{
+	const char *suffix = PathTraitsUTF8::GetFilenameSuffix(uri_utf8);
+	if (suffix == nullptr)
+		return;
+
+	for (const auto *plugin : decoder_plugins_for_suffix(suffix)) {
+		if (plugin->prefetch == nullptr)
+			continue;
+
+		FmtDebug(decoder_domain, "prefetching {:?} with plugin {:?}",
+			 uri_utf8, plugin->name);
+		plugin->Prefetch(path_fs, preferred_format);
+	}
+}
+
+DecoderPrefetch::~DecoderPrefetch() noexcept
+{
+	assert(!thread.IsDefined());
+}
+
+void
+DecoderPrefetch::Start()
+{
+	quit = false;
+	thread.Start();
+}
+
+void
+DecoderPrefetch::Stop() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	{
+		const std::scoped_lock lock{mutex};
+		quit = true;
+		cond.notify_one();
+	}
+
+	thread.Join();
+}
+
+void
+DecoderPrefetch::Schedule(const DetachedSong &song,
+			  AudioFormat _preferred_format) noexcept
+{
+	const char *uri_utf8 = song.GetRealURI();
+	if (!PathTraitsUTF8::IsAbsolute(uri_utf8)) {
+		/* not a local file; maybe the input plugin can
+		   prepare it */
+		InputPrefetch(uri_utf8);
+		return;
+	}
+
+	const std::scoped_lock lock{mutex};
+	pending = uri_utf8;
+	preferred_format = _preferred_format;
+	cond.notify_one();
+}
+
+void
+DecoderPrefetch::RunThread() noexcept
+{
+	SetThreadName("prefetch");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		cond.wait(lock, [this]{ return quit || !pending.empty(); });
+		if (quit)
+			break;
+
+		const std::string uri_utf8 = std::move(pending);
+		pending.clear();
+		const AudioFormat format = preferred_format;
+
+		const ScopeUnlock unlock{lock};
+
+		try {
+			const auto path_fs = AllocatedPath::FromUTF8Throw(uri_utf8);
+			PrefetchFile(uri_utf8.c_str(), path_fs, format);
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "pcm/AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <string>
+
+class DetachedSong;
+
+/**
+ * A helper thread which calls DecoderPlugin::prefetch() for the song
+ * which is going to be played next, while the decoder thread is
+ * still busy with the current one.  This moves expensive plugin
+ * initialization (e.g. loading and parsing emulator files) out of
+ * the gap between two songs; the decoder thread later picks up the
+ * prepared state from the plugin's cache.
+ */
+class DecoderPrefetch {
+	Thread thread{BIND_THIS_METHOD(RunThread)};
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * The (UTF-8) path of the next file to be prefetched; empty
+	 * if there is none.  Protected by #mutex.
+	 */
+	std::string pending;
+
+	/**
+	 * The preferred #AudioFormat of the #pending song.
+	 * Protected by #mutex.
+	 */
+	AudioFormat preferred_format;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	bool quit = false;
+
+public:
+	DecoderPrefetch() noexcept = default;
+	~DecoderPrefetch() noexcept;
+
+	DecoderPrefetch(const DecoderPrefetch &) = delete;
+	DecoderPrefetch &operator=(const DecoderPrefetch &) = delete;
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Stop the thread and wait for it to exit.
+	 */
+	void Stop() noexcept;
+
+	/**
+	 * Schedule prefetching the given song.  Replaces the song
+	 * which was scheduled previously, unless that one is already
+	 * being prefetched.  Songs which are not local files are
+	 * passed to InputPrefetch() instead.
+	 *
+	 * @param preferred_format see
+	 * DecoderControl::GetPreferredAudioFormat()
+	 */
+	void Schedule(const DetachedSong &song,
+		      AudioFormat preferred_format) noexcept;
+
+private:
+	void RunThread() noexcept;
+};
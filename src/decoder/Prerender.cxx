@@ -0,0 +1,584 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Prerender.hxx"
+#include "Bridge.hxx"
+#include "Control.hxx"
+#include "DecoderList.hxx"
+#include "DecoderPlugin.hxx"
+#include "Domain.hxx"
+#include "plugins/FlacDecoderPlugin.h"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/ToOutputStream.hxx"
+#include "encoder/plugins/FlacEncoderPlugin.hxx"
+#include "config/Block.hxx"
+#include "config/Data.hxx"
+#include "config/Parser.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "io/FileOutputStream.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/glue/StandardDirectory.hxx"
+#include "tag/Tag.hxx"
+#include "lib/fmt/AudioFormatFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <fmt/core.h>
+
+#include <fcntl.h>
+#include <sys/stat.h> // for utimensat()
+#include <unistd.h> // for unlink()
+
+#include <algorithm> // for std::sort()
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint_least64_t PRERENDER_DEFAULT_MAX_SIZE =
+	4ULL * 1024 * 1024 * 1024;
+
+struct PrerenderSettings {
+	AllocatedPath directory;
+
+	/**
+	 * The "prerender_max_size" setting: the least recently used
+	 * files are deleted when the directory grows beyond this.
+	 */
+	uint_least64_t max_size;
+
+	/**
+	 * A hash of all settings of the decoder plugin; it is
+	 * part of the cache key, because changing them may change
+	 * the rendered output.
+	 */
+	uint64_t settings_hash;
+
+	/**
+	 * Was the plugin configured with "sample_rate auto"?  Only
+	 * then does the output depend on the outputs' audio format,
+	 * and only then is it part of the cache key.
+	 */
+	bool auto_sample_rate;
+
+	/**
+	 * The settings of the FLAC encoder ("prerender_compression",
+	 * "prerender_threads").  Recording happens only once per
+	 * song, therefore the default is the highest compression.
+	 */
+	ConfigBlock encoder_settings;
+};
+
+static std::unordered_map<const DecoderPlugin *, PrerenderSettings> prerender_plugins;
+
+static constexpr uint64_t
+Fnv1aHash(std::string_view s, uint64_t hash=0xcbf29ce484222325ULL) noexcept
+{
+	for (const char ch : s) {
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t
+HashBlockSettings(const ConfigBlock &block) noexcept
+{
+	uint64_t hash = Fnv1aHash({});
+	for (const auto &i : block.block_params) {
+		hash = Fnv1aHash(i.name, hash);
+		hash = Fnv1aHash("=", hash);
+		hash = Fnv1aHash(i.value, hash);
+		hash = Fnv1aHash("\n", hash);
+	}
+
+	return hash;
+}
+
+static AllocatedPath
+GetDefaultPrerenderDirectory() noexcept
+{
+	const auto cache_dir = GetAppCacheDir();
+	if (cache_dir.IsNull())
+		return nullptr;
+
+	auto dir = cache_dir / Path::FromFS(PATH_LITERAL("prerender"));
+	CreateDirectoryNoThrow(dir);
+	return dir;
+}
+
+/**
+ * Delete the least recently used files from the pre-render
+ * directory until its size is within the limit.  Cache hits update
+ * the modification time (see DecodePrerendered()).
+ */
+static void
+MakeRoom(Path directory, uint_least64_t max_size) noexcept
+try {
+	struct Entry {
+		AllocatedPath path;
+		uint_least64_t size;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	std::vector<Entry> entries;
+	uint_least64_t total_size = 0;
+
+	DirectoryReader reader{directory};
+	while (reader.ReadEntry()) {
+		const auto name = reader.GetEntry();
+		if (name.c_str()[0] == '.')
+			/* skip special and temporary files */
+			continue;
+
+		const auto extension = name.GetExtension();
+		if (extension == nullptr ||
+		    PathTraitsFS::string_view{extension} != PATH_LITERAL("flac"))
+			continue;
+
+		auto path = directory / name;
+
+		FileInfo fi;
+		if (!GetFileInfo(path, fi, false) || !fi.IsRegular())
+			continue;
+
+		total_size += fi.GetSize();
+		entries.push_back({std::move(path), fi.GetSize(),
+				   fi.GetModificationTime()});
+	}
+
+	if (total_size <= max_size)
+		return;
+
+	/* oldest first */
+	std::sort(entries.begin(), entries.end(),
+		  [](const Entry &a, const Entry &b){
+			  return a.mtime < b.mtime;
+		  });
+
+	for (const auto &i : entries) {
+		if (total_size <= max_size)
+			break;
+
+		if (unlink(i.path.c_str()) < 0)
+			continue;
+
+		FmtDebug(decoder_domain, "Evicted pre-render file {}", i.path);
+		total_size -= i.size;
+	}
+} catch (...) {
+	LogError(std::current_exception(),
+		 "Failed to clean up the pre-render directory");
+}
+
+void
+prerender_global_init(const ConfigData &config)
+{
+	prerender_plugins.clear();
+
+	for (const auto &plugin : GetEnabledDecoderPlugins()) {
+		const auto *block =
+			config.FindBlock(ConfigBlockOption::DECODER, "plugin",
+					 plugin.name);
+		if (block == nullptr || !block->GetBlockValue("prerender", false))
+			continue;
+
+		if (plugin.file_decode == nullptr) {
+			FmtWarning(decoder_domain,
+				   "Decoder plugin {:?} does not support \"prerender\"",
+				   plugin.name);
+			continue;
+		}
+
+		auto directory = block->GetPath("prerender_directory");
+		if (directory.IsNull()) {
+			directory = GetDefaultPrerenderDirectory();
+			if (directory.IsNull())
+				throw FmtRuntimeError("No \"prerender_directory\" in line {}",
+						      block->line);
+		}
+
+		uint_least64_t max_size = PRERENDER_DEFAULT_MAX_SIZE;
+		if (const auto *param = block->GetBlockParam("prerender_max_size"))
+			max_size = param->With([](const char *s){
+				return ParseSize(s);
+			});
+
+		const auto *sample_rate = block->GetBlockParam("sample_rate");
+		const bool auto_sample_rate = sample_rate != nullptr &&
+			sample_rate->value == "auto";
+
+		ConfigBlock encoder_settings;
+		encoder_settings.AddBlockParam("compression",
+					       std::to_string(block->GetBlockValue("prerender_compression", 8U)));
+		encoder_settings.AddBlockParam("threads",
+					       std::to_string(block->GetPositiveValue("prerender_threads", 1U)));
+
+		prerender_plugins.emplace(&plugin,
+					  PrerenderSettings{
+						  std::move(directory),
+						  max_size,
+						  HashBlockSettings(*block),
+						  auto_sample_rate,
+						  std::move(encoder_settings),
+					  });
+	}
+
+	/* enforce the size limits (which may have been lowered
+	   since the last run) */
+	for (const auto &[plugin, settings] : prerender_plugins)
+		MakeRoom(settings.directory, settings.max_size);
+}
+
+/**
+ * Obtain the modification time of the file.  For songs inside a
+ * container, the container file is used.
+ */
+static std::chrono::system_clock::time_point
+GetSongModificationTime(Path path_fs) noexcept
+{
+	FileInfo info;
+	if (GetFileInfo(path_fs, info) ||
+	    GetFileInfo(path_fs.GetDirectoryName(), info))
+		return info.GetModificationTime();
+
+	return {};
+}
+
+AllocatedPath
+PrerenderCachePath(const DecoderPlugin &plugin, Path path_fs,
+		   AudioFormat preferred_format) noexcept
+{
+	const auto i = prerender_plugins.find(&plugin);
+	if (i == prerender_plugins.end())
+		return nullptr;
+
+	const auto &settings = i->second;
+
+	const auto mtime = std::chrono::system_clock::to_time_t(GetSongModificationTime(path_fs));
+
+	uint64_t hash = Fnv1aHash(plugin.name);
+	hash = Fnv1aHash(path_fs.ToUTF8(), hash);
+	hash = Fnv1aHash(fmt::format("\n{}\n{:x}", mtime,
+				     settings.settings_hash),
+			 hash);
+
+	/* only with "sample_rate auto" does the rendered format
+	   depend on the outputs; else changing the outputs would
+	   needlessly re-render everything */
+	if (settings.auto_sample_rate)
+		hash = Fnv1aHash(fmt::format("\n{}", preferred_format), hash);
+
+	return settings.directory /
+		AllocatedPath::FromUTF8(fmt::format("{:016x}.flac", hash));
+}
+
+/**
+ * Set the "total samples" field in the STREAMINFO block of a FLAC
+ * file which was written by #FlacEncoder; the encoder does not know
+ * the total duration while it writes the header.
+ */
+static void
+PatchFlacTotalSamples(Path path, uint64_t total_samples) noexcept
+{
+	/* "fLaC" + the metadata block header; STREAMINFO is
+	   always the first block */
+	static constexpr off_t STREAMINFO_OFFSET = 8;
+
+	/* the 36 bit field starts in the low nibble of byte 13 */
+	static constexpr off_t TOTAL_SAMPLES_OFFSET = STREAMINFO_OFFSET + 13;
+
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path.c_str(), O_RDWR))
+		return;
+
+	std::byte buffer[5];
+	if (fd.ReadAt(TOTAL_SAMPLES_OFFSET, buffer) != sizeof(buffer))
+		return;
+
+	buffer[0] = (buffer[0] & std::byte{0xf0}) |
+		std::byte((total_samples >> 32) & 0xf);
+	buffer[1] = std::byte(total_samples >> 24);
+	buffer[2] = std::byte(total_samples >> 16);
+	buffer[3] = std::byte(total_samples >> 8);
+	buffer[4] = std::byte(total_samples);
+
+	(void)fd.WriteAt(TOTAL_SAMPLES_OFFSET, buffer);
+}
+
+/**
+ * A #DecoderClient which forwards everything to another one, and
+ * records the audio data to a FLAC file.  Recording is abandoned if
+ * the song is not played from start to end without interruption.
+ */
+class PrerenderClient final : public DecoderClient {
+	DecoderClient &next;
+
+	const Path cache_path;
+
+	const PrerenderSettings &settings;
+
+	std::unique_ptr<PreparedEncoder> prepared_encoder;
+	std::unique_ptr<Encoder> encoder;
+	std::unique_ptr<FileOutputStream> os;
+
+	uint64_t n_frames = 0;
+	std::size_t frame_size;
+
+public:
+	PrerenderClient(DecoderClient &_next, Path _cache_path,
+			const PrerenderSettings &_settings) noexcept
+		:next(_next), cache_path(_cache_path),
+		 settings(_settings) {}
+
+	/**
+	 * Call this after the decoder plugin has returned: make the
+	 * recording visible if it is complete.
+	 */
+	void Commit() noexcept;
+
+private:
+	bool IsRecording() const noexcept {
+		return os != nullptr;
+	}
+
+	void Open(AudioFormat audio_format);
+
+	void Abandon() noexcept {
+		encoder.reset();
+		os.reset();
+	}
+
+	DecoderCommand Check(DecoderCommand cmd) noexcept {
+		/* seeking (including the initial seek to a sub-song
+		   start) or stopping means the recording will be
+		   incomplete */
+		if (cmd != DecoderCommand::NONE)
+			Abandon();
+
+		return cmd;
+	}
+
+public:
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override {
+		next.Ready(audio_format, seekable, duration);
+
+		try {
+			Open(audio_format);
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to create pre-render file");
+			Abandon();
+		}
+	}
+
+	AudioFormat GetPreferredAudioFormat() noexcept override {
+		return next.GetPreferredAudioFormat();
+	}
+
+	DecoderCommand GetCommand() noexcept override {
+		return Check(next.GetCommand());
+	}
+
+	void CommandFinished() noexcept override {
+		next.CommandFinished();
+	}
+
+	SongTime GetSeekTime() noexcept override {
+		return next.GetSeekTime();
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return next.GetSeekFrame();
+	}
+
+	void SeekError(std::exception_ptr &&error) noexcept override {
+		next.SeekError(std::move(error));
+	}
+
+	void CountRestart() noexcept override {
+		next.CountRestart();
+	}
+
+	InputStreamPtr OpenUri(std::string_view uri) override {
+		return next.OpenUri(uri);
+	}
+
+	size_t Read(InputStream &is,
+		    std::span<std::byte> dest) noexcept override {
+		return next.Read(is, dest);
+	}
+
+	void SubmitTimestamp(FloatDuration t) noexcept override {
+		next.SubmitTimestamp(t);
+	}
+
+	DecoderCommand SubmitAudio(InputStream *is,
+				   std::span<const std::byte> audio,
+				   uint16_t kbit_rate) noexcept override;
+
+	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) noexcept override {
+		return Check(next.SubmitTag(is, std::move(tag)));
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) noexcept override {
+		next.SubmitReplayGain(replay_gain_info);
+	}
+
+	void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept override {
+		next.SubmitMixRamp(std::move(mix_ramp));
+	}
+
+	void KeepContainer(const DecoderPlugin &plugin, Path path,
+			   std::unique_ptr<DecoderContainerState> &&state) noexcept override {
+		next.KeepContainer(plugin, path, std::move(state));
+	}
+
+	std::unique_ptr<DecoderContainerState> TakeContainer(const DecoderPlugin &plugin,
+							     Path path) noexcept override {
+		return next.TakeContainer(plugin, path);
+	}
+};
+
+void
+PrerenderClient::Open(AudioFormat audio_format)
+{
+	prepared_encoder.reset(encoder_init(flac_encoder_plugin,
+					    settings.encoder_settings));
+
+	/* the FLAC encoder converts unsupported sample formats, but
+	   then the recording would differ from what the plugin
+	   renders; don't cache such songs */
+	AudioFormat encoder_format = audio_format;
+	encoder.reset(prepared_encoder->Open(encoder_format));
+	if (encoder_format != audio_format) {
+		FmtDebug(decoder_domain, "Cannot pre-render format {}",
+			 audio_format);
+		Abandon();
+		return;
+	}
+
+	frame_size = audio_format.GetFrameSize();
+
+	os = std::make_unique<FileOutputStream>(cache_path);
+	EncoderToOutputStream(*os, *encoder);
+}
+
+DecoderCommand
+PrerenderClient::SubmitAudio(InputStream *is,
+			     std::span<const std::byte> audio,
+			     uint16_t kbit_rate) noexcept
+{
+	if (IsRecording()) {
+		try {
+			encoder->Write(audio);
+			EncoderToOutputStream(*os, *encoder);
+			n_frames += audio.size() / frame_size;
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to write pre-render file");
+			Abandon();
+		}
+	}
+
+	return Check(next.SubmitAudio(is, audio, kbit_rate));
+}
+
+void
+PrerenderClient::Commit() noexcept
+{
+	if (!IsRecording() || n_frames == 0) {
+		Abandon();
+		return;
+	}
+
+	try {
+		encoder->End();
+		EncoderToOutputStream(*os, *encoder);
+		os->Commit();
+		os.reset();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to commit pre-render file");
+		Abandon();
+		return;
+	}
+
+	encoder.reset();
+
+	PatchFlacTotalSamples(cache_path, n_frames);
+
+	FmtDebug(decoder_domain, "pre-rendered {:?}", cache_path);
+
+	MakeRoom(settings.directory, settings.max_size);
+}
+
+/**
+ * Attempt to decode the cache file.
+ *
+ * @return true if the cache file was decoded
+ */
+static bool
+DecodePrerendered(DecoderBridge &bridge, Path cache_path)
+{
+	if (!FileExists(cache_path))
+		return false;
+
+	auto is = OpenLocalInputStream(cache_path, bridge.dc.mutex);
+	is->SetHandler(&bridge.dc);
+
+	flac_decoder_plugin.StreamDecode(bridge, *is);
+
+	if (bridge.dc.state != DecoderState::START) {
+#ifndef _WIN32
+		/* mark as recently used for MakeRoom() */
+		utimensat(AT_FDCWD, cache_path.c_str(), nullptr, 0);
+#endif
+		return true;
+	}
+
+	/* the cache file is corrupt; delete and re-render it */
+	FmtWarning(decoder_domain, "Discarding unusable pre-render file {:?}",
+		   cache_path);
+	RemoveFile(cache_path);
+	return false;
+}
+
+void
+PrerenderFileDecode(const DecoderPlugin &plugin, DecoderBridge &bridge,
+		    Path path_fs, Path cache_path)
+{
+	try {
+		if (DecodePrerendered(bridge, cache_path))
+			return;
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to decode pre-render file");
+
+		if (bridge.dc.state != DecoderState::START)
+			/* the decoder has already started;
+			   can't fall back to the plugin */
+			throw;
+	}
+
+	const auto i = prerender_plugins.find(&plugin);
+	assert(i != prerender_plugins.end());
+
+	PrerenderClient client(bridge, cache_path, i->second);
+	plugin.FileDecode(client, path_fs);
+	client.Commit();
+}
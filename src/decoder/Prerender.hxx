@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+/*
+ * "Pre-rendering": the output of expensive decoder plugins (e.g.
+ * emulators) is recorded to a FLAC file while the song plays from
+ * start to end.  Later plays of the same file are served from that
+ * FLAC file by the "flac" decoder plugin.
+ */
+
+struct ConfigData;
+struct DecoderPlugin;
+struct AudioFormat;
+class DecoderBridge;
+class Path;
+class AllocatedPath;
+
+/**
+ * Load the "prerender" settings of all decoder plugins.
+ *
+ * Throws on error.
+ */
+void
+prerender_global_init(const ConfigData &config);
+
+/**
+ * Determine the cache file for the given song file.  It is derived
+ * from the path, the modification time and the plugin settings.
+ *
+ * @param preferred_format the format the plugin is asked to render
+ * (see DecoderClient::GetPreferredAudioFormat()); it is only part of
+ * the key if the plugin is configured with "sample_rate auto",
+ * because only then does it render differently when it changes
+ * @return the cache path or nullptr if the plugin does not use
+ * pre-rendering
+ */
+[[gnu::pure]]
+AllocatedPath
+PrerenderCachePath(const DecoderPlugin &plugin, Path path_fs,
+		   AudioFormat preferred_format) noexcept;
+
+/**
+ * A replacement for DecoderPlugin::FileDecode() for plugins with
+ * pre-rendering.  If the cache file exists, it is decoded instead
+ * of running the plugin; else the plugin runs and its output is
+ * recorded to the cache file.
+ */
+void
+PrerenderFileDecode(const DecoderPlugin &plugin, DecoderBridge &bridge,
+		    Path path_fs, Path cache_path);
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SongAnalysis.hxx"
+
+std::optional<SongAnalysis>
+SongAnalysisStore::Get(std::string_view uri,
+		       time_point mtime) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto i = map.find(std::string{uri});
+	if (i == map.end() || i->second.mtime != mtime ||
+	    !i->second.analysis.IsDefined())
+		return std::nullopt;
+
+	return i->second.analysis;
+}
+
+bool
+SongAnalysisStore::Contains(std::string_view uri,
+			    time_point mtime) const noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto i = map.find(std::string{uri});
+	return i != map.end() && i->second.mtime == mtime;
+}
+
+void
+SongAnalysisStore::Put(std::string_view uri, time_point mtime,
+		       SongAnalysis &&analysis) noexcept
+{
+	const std::scoped_lock lock{mutex};
+	map.insert_or_assign(std::string{uri},
+			     Entry{mtime, std::move(analysis)});
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/MixRampInfo.hxx"
+#include "tag/ReplayGainInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * MixRamp and ReplayGain values calculated by the background
+ * analyzer.
+ */
+struct SongAnalysis {
+	MixRampInfo mix_ramp;
+
+	ReplayGainTuple track = ReplayGainTuple::Undefined();
+
+	[[gnu::pure]]
+	bool IsDefined() const noexcept {
+		return mix_ramp.IsDefined() || track.IsDefined();
+	}
+};
+
+/**
+ * An in-memory index of #SongAnalysis objects by song URI.  It is
+ * filled by the background analyzer (which persists the values as
+ * stickers) and consulted by the decoder thread before a song gets
+ * decoded, so songs without MixRamp/ReplayGain tags don't need to be
+ * analyzed on the player thread.
+ *
+ * Each entry remembers the modification time of the file it was
+ * calculated from; it is ignored once the file has been modified.
+ *
+ * This class is thread-safe.
+ */
+class SongAnalysisStore {
+	using time_point = std::chrono::system_clock::time_point;
+
+	struct Entry {
+		time_point mtime;
+		SongAnalysis analysis;
+	};
+
+	mutable Mutex mutex;
+
+	std::unordered_map<std::string, Entry> map;
+
+public:
+	/**
+	 * Look up the values for the given song.  Returns
+	 * std::nullopt if the song was not analyzed (successfully)
+	 * or if it was modified since.
+	 */
+	[[gnu::pure]]
+	std::optional<SongAnalysis> Get(std::string_view uri,
+					time_point mtime) const noexcept;
+
+	/**
+	 * Has this version of the given song been visited by the
+	 * analyzer already (even if that failed)?
+	 */
+	[[gnu::pure]]
+	bool Contains(std::string_view uri, time_point mtime) const noexcept;
+
+	/**
+	 * Store the values for the given song.  An undefined object
+	 * marks the song as "visited", to avoid analyzing it again.
+	 *
+	 * @param mtime the modification time of the analyzed file
+	 */
+	void Put(std::string_view uri, time_point mtime,
+		 SongAnalysis &&analysis) noexcept;
+};
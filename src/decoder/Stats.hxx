@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Performance counters of the decoder plugin which is currently
+ * running.  They are collected by #DecoderBridge and published in
+ * #DecoderControl.
+ */
+struct DecoderStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The name of the decoder plugin; nullptr if no plugin has
+	 * been started yet.
+	 */
+	const char *plugin = nullptr;
+
+	/**
+	 * The sample rate announced by DecoderClient::Ready(); 0 if
+	 * the plugin is not ready yet.
+	 */
+	unsigned sample_rate = 0;
+
+	/**
+	 * The number of PCM frames submitted by the plugin.
+	 */
+	uint64_t frames = 0;
+
+	/**
+	 * The wall time spent inside the plugin between two audio
+	 * submissions, i.e. decoding or rendering.
+	 */
+	Duration render_time{};
+
+	/**
+	 * The wall time spent in DecoderClient::SubmitAudio() (and
+	 * GetAudioBuffer()/CommitAudio()), most of which is waiting
+	 * for the player to free a buffer chunk.
+	 */
+	Duration submit_time{};
+
+	/**
+	 * The wall time spent converting the plugin's PCM data to the
+	 * configured audio format (resampling, sample format and
+	 * channels), which is part of #submit_time; and the longest
+	 * time needed for one submission.
+	 */
+	Duration convert_time{}, max_convert_time{};
+
+	/**
+	 * How often was a chunk pushed to an empty #MusicPipe, i.e.
+	 * the player had consumed everything the decoder had
+	 * produced?  The first chunk after starting or seeking is
+	 * not counted.
+	 */
+	unsigned underruns = 0;
+
+	/**
+	 * The number of seeks and the total/longest time needed to
+	 * perform them.
+	 */
+	unsigned seeks = 0;
+	Duration seek_time{}, max_seek_time{};
+
+	/**
+	 * How often did the plugin have to restart from the
+	 * beginning of the song (e.g. an emulator seeking
+	 * backwards)?
+	 */
+	unsigned restarts = 0;
+
+	/**
+	 * The duration of the submitted audio divided by the render
+	 * time.  Values below 1 mean the plugin is too slow for
+	 * realtime playback.  Returns 0 if unknown.
+	 */
+	[[gnu::pure]]
+	double GetRealtimeFactor() const noexcept {
+		using FloatSeconds = std::chrono::duration<double>;
+
+		const double render_s =
+			std::chrono::duration_cast<FloatSeconds>(render_time).count();
+		if (sample_rate == 0 || render_s <= 0)
+			return 0;
+
+		return double(frames) / sample_rate / render_s;
+	}
+};
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "Control.hxx"
 #include "Bridge.hxx"
+#include "SongAnalysis.hxx"
 #include "DecoderPlugin.hxx"
 #include "song/DetachedSong.hxx"
 #include "MusicPipe.hxx"
@@ -13,6 +14,7 @@
 #include "input/InputStream.hxx"
 #include "input/Registry.hxx"
 #include "DecoderList.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "thread/ScopeUnlock.hxx"
 #include "system/Error.hxx"
@@ -24,10 +26,15 @@
 #include "util/StringCompare.hxx"
 #include "util/UriQueryParser.hxx"
 #include "thread/Name.hxx"
+#include "thread/Util.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "tag/ReplayGainParser.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_PRERENDER
+#include "Prerender.hxx"
+#endif
+
 #include <stdexcept>
 #include <functional>
 #include <memory>
@@ -88,6 +95,8 @@ DecoderUriDecode(const DecoderPlugin &plugin,
 	if (bridge.dc.command == DecoderCommand::STOP)
 		return DecodeResult::STOP;
 
+	bridge.stats.plugin = plugin.name;
+
 	{
 		const ScopeUnlock unlock(bridge.dc.mutex);
 
@@ -134,6 +143,8 @@ decoder_stream_decode(const DecoderPlugin &plugin,
 	} catch (...) {
 	}
 
+	bridge.stats.plugin = plugin.name;
+
 	{
 		const ScopeUnlock unlock{lock};
 
@@ -173,12 +184,21 @@ decoder_file_decode(const DecoderPlugin &plugin,
 	if (bridge.dc.command == DecoderCommand::STOP)
 		return DecodeResult::STOP;
 
+	bridge.stats.plugin = plugin.name;
+
 	{
 		const ScopeUnlock unlock(bridge.dc.mutex);
 
 		FmtThreadName("decoder:{}", plugin.name);
 
-		plugin.FileDecode(bridge, path);
+#ifdef ENABLE_PRERENDER
+		if (const auto cache_path = PrerenderCachePath(plugin, path,
+							       bridge.GetPreferredAudioFormat());
+		    !cache_path.IsNull())
+			PrerenderFileDecode(plugin, bridge, path, cache_path);
+		else
+#endif
+			plugin.FileDecode(bridge, path);
 
 		SetThreadName("decoder");
 	}
@@ -554,6 +574,28 @@ MakeDecoderError(const DetachedSong &song, const char *msg) noexcept
 	return FmtRuntimeError("Failed to decode {:?}: {}", error_uri, msg);
 }
 
+/**
+ * Submit the values calculated by the background analyzer (if any).
+ * Tags found by the decoder plugin override them.
+ */
+static void
+SubmitSongAnalysis(DecoderBridge &bridge, const SongAnalysisStore &store,
+		   const DetachedSong &song) noexcept
+{
+	auto analysis = store.Get(song.GetURI(), song.GetLastModified());
+	if (!analysis)
+		return;
+
+	if (analysis->track.IsDefined()) {
+		auto rgi = ReplayGainInfo::Undefined();
+		rgi.track = analysis->track;
+		bridge.SubmitReplayGain(&rgi);
+	}
+
+	if (analysis->mix_ramp.IsDefined())
+		bridge.SubmitMixRamp(std::move(analysis->mix_ramp));
+}
+
 /**
  * Decode a song addressed by a #DetachedSong.
  *
@@ -577,6 +619,7 @@ decoder_run_song(DecoderControl &dc,
 				played it*/
 			     !SongHasVolatileTags(song) ? std::make_unique<Tag>(song.GetTag()) : nullptr);
 
+	dc.stats = {};
 	dc.state = DecoderState::START;
 	dc.CommandFinishedLocked();
 
@@ -589,9 +632,13 @@ decoder_run_song(DecoderControl &dc,
 			bridge.CheckFlushChunk();
 		};
 
+		if (dc.song_analysis != nullptr)
+			SubmitSongAnalysis(bridge, *dc.song_analysis, song);
+
 		result = DecoderUnlockedRunUri(bridge, uri, path_fs);
 	}
 
+	bridge.PublishStats();
 	bridge.CheckRethrowError();
 
 	switch (result) {
@@ -634,6 +681,8 @@ try {
 		path_fs = path_buffer;
 	}
 
+	dc.kept_container.DiscardUnlessInside(path_fs);
+
 	decoder_run_song(dc, song, uri_utf8, path_fs);
 } catch (...) {
 	dc.state = DecoderState::ERROR;
@@ -647,6 +696,23 @@ DecoderControl::RunThread() noexcept
 {
 	SetThreadName("decoder");
 
+	try {
+		cpu_affinity.Apply();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to set the decoder thread's CPU affinity");
+	}
+
+	if (realtime) {
+		try {
+			SetThreadRealtime();
+		} catch (...) {
+			FmtInfo(decoder_thread_domain,
+				"Decoder thread could not get realtime scheduling, continuing anyway: {}",
+				std::current_exception());
+		}
+	}
+
 	std::unique_lock lock{mutex};
 
 	do {
@@ -692,4 +758,6 @@ DecoderControl::RunThread() noexcept
 			break;
 		}
 	} while (command != DecoderCommand::NONE || !quit);
+
+	kept_container.Clear();
 }
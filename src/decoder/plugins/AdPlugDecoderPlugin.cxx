@@ -4,19 +4,101 @@
 #include "AdPlugDecoderPlugin.h"
 #include "tag/Handler.hxx"
 #include "../DecoderAPI.hxx"
-#include "pcm/CheckAudioFormat.hxx"
+#include "../EmuSampleRate.hxx"
 #include "fs/Path.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "util/Domain.hxx"
+#include "util/StringAPI.hxx"
 #include "Log.hxx"
 
 #include <adplug/adplug.h>
 #include <adplug/emuopl.h>
+#include <adplug/kemuopl.h>
+#include <adplug/temuopl.h>
 
+#if defined(__has_include)
+#if __has_include(<adplug/nemuopl.h>)
+#include <adplug/nemuopl.h>
+#define HAVE_ADPLUG_NUKED
+#endif
+#if __has_include(<adplug/wemuopl.h>)
+#include <adplug/wemuopl.h>
+#define HAVE_ADPLUG_WOODY
+#endif
+#endif
+
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <memory>
 
 static constexpr Domain adplug_domain("adplug");
 
-static unsigned sample_rate;
+static constexpr unsigned ADPLUG_DEFAULT_SAMPLE_RATE = 48000;
+
+/**
+ * The OPL emulators provided by libadplug.
+ */
+enum class AdPlugOplCore {
+	/**
+	 * Tatsuyuki Satoh's MAME emulator (CEmuopl), the default.
+	 */
+	MAME,
+
+	/**
+	 * Ken Silverman's emulator (CKemuopl), the cheapest one.
+	 */
+	KEN,
+
+	/**
+	 * Tatsuyuki Satoh's emulator as a standalone OPL2 (CTemuopl).
+	 */
+	SATOH,
+
+#ifdef HAVE_ADPLUG_NUKED
+	/**
+	 * Nuked OPL3 (CNemuopl), the most accurate and the most
+	 * expensive one.
+	 */
+	NUKED,
+#endif
+
+#ifdef HAVE_ADPLUG_WOODY
+	/**
+	 * The DOSBox emulator (CWemuopl).
+	 */
+	WOODY,
+#endif
+};
+
+/**
+ * The configured sample rate; 0 means "auto" (see
+ * GetEmuSampleRate()).
+ */
+static unsigned adplug_sample_rate;
+
+static AdPlugOplCore opl_core;
+
+static AdPlugOplCore
+ParseOplCore(const char *s)
+{
+	if (StringIsEqual(s, "mame"))
+		return AdPlugOplCore::MAME;
+	else if (StringIsEqual(s, "ken"))
+		return AdPlugOplCore::KEN;
+	else if (StringIsEqual(s, "satoh"))
+		return AdPlugOplCore::SATOH;
+#ifdef HAVE_ADPLUG_NUKED
+	else if (StringIsEqual(s, "nuked"))
+		return AdPlugOplCore::NUKED;
+#endif
+#ifdef HAVE_ADPLUG_WOODY
+	else if (StringIsEqual(s, "woody"))
+		return AdPlugOplCore::WOODY;
+#endif
+	else
+		throw FmtRuntimeError("Unsupported OPL emulator: {:?}", s);
+}
 
 static bool
 adplug_init(const ConfigBlock &block)
@@ -24,41 +106,238 @@ adplug_init(const ConfigBlock &block)
 	FmtDebug(adplug_domain, "adplug {}",
 		 CAdPlug::get_version());
 
-	sample_rate = block.GetPositiveValue("sample_rate", 48000U);
-	CheckSampleRate(sample_rate);
+	adplug_sample_rate = ParseEmuSampleRate(block,
+						ADPLUG_DEFAULT_SAMPLE_RATE);
+
+	const auto *param = block.GetBlockParam("opl_core");
+	opl_core = param != nullptr
+		? param->With(ParseOplCore)
+		: AdPlugOplCore::MAME;
 
 	return true;
 }
 
+/**
+ * Create an instance of the configured OPL emulator, producing
+ * 16 bit stereo output.
+ */
+static std::unique_ptr<Copl>
+CreateOpl(unsigned sample_rate) noexcept
+{
+	std::unique_ptr<Copl> opl;
+
+	switch (opl_core) {
+	case AdPlugOplCore::MAME:
+		opl = std::make_unique<CEmuopl>(sample_rate, true, true);
+		break;
+
+	case AdPlugOplCore::KEN:
+		opl = std::make_unique<CKemuopl>(sample_rate, true, true);
+		break;
+
+	case AdPlugOplCore::SATOH:
+		opl = std::make_unique<CTemuopl>(sample_rate, true, true);
+		break;
+
+#ifdef HAVE_ADPLUG_NUKED
+	case AdPlugOplCore::NUKED:
+		opl = std::make_unique<CNemuopl>(sample_rate);
+		break;
+#endif
+
+#ifdef HAVE_ADPLUG_WOODY
+	case AdPlugOplCore::WOODY:
+		opl = std::make_unique<CWemuopl>(sample_rate, true, true);
+		break;
+#endif
+	}
+
+	opl->init();
+	return opl;
+}
+
+/**
+ * Tracks the position within the song; each CPlayer::update() call
+ * (a "tick") produces 1/getrefresh() seconds of audio.
+ */
+class AdPlugClock {
+	const double sample_rate;
+
+	/**
+	 * The current position [frames].
+	 */
+	uint64_t position = 0;
+
+	/**
+	 * The number of frames remaining in the current tick.
+	 */
+	double pending = 0;
+
+public:
+	explicit AdPlugClock(unsigned _sample_rate) noexcept
+		:sample_rate(_sample_rate) {}
+
+	uint64_t GetPosition() const noexcept {
+		return position;
+	}
+
+	/**
+	 * Returns the number of whole frames which may be synthesized
+	 * before the next tick.
+	 */
+	unsigned GetPending() const noexcept {
+		return static_cast<unsigned>(pending);
+	}
+
+	/**
+	 * Advance the player by one tick.
+	 *
+	 * @return false if the song has ended
+	 */
+	bool Tick(CPlayer &player) noexcept {
+		if (!player.update())
+			return false;
+
+		const float refresh = player.getrefresh();
+		pending += refresh > 0 ? sample_rate / refresh : sample_rate;
+		return true;
+	}
+
+	void Consume(unsigned frames) noexcept {
+		assert(frames <= pending);
+
+		pending -= frames;
+		position += frames;
+	}
+
+	void Reset() noexcept {
+		position = 0;
+		pending = 0;
+	}
+};
+
+/**
+ * Move the player to the given position by running its ticks
+ * without synthesizing any audio; only the OPL registers are
+ * written.  CPlayer cannot be rewound partially, so seeking backward
+ * restarts the song.
+ *
+ * @return false if the song ends before the given position; the
+ * player is then moved back to where it was
+ */
+static bool
+AdPlugSeek(CPlayer &player, AdPlugClock &clock, uint64_t target) noexcept
+{
+	const uint64_t previous = clock.GetPosition();
+
+	if (target < previous) {
+		player.rewind();
+		clock.Reset();
+	}
+
+	while (clock.GetPosition() + clock.GetPending() < target) {
+		if (!clock.Tick(player)) {
+			/* the player has run to the end; restart and
+			   go back to the old position (which is
+			   before the end, so this succeeds) */
+			player.rewind();
+			clock.Reset();
+			AdPlugSeek(player, clock, previous);
+			return false;
+		}
+	}
+
+	clock.Consume(target - clock.GetPosition());
+	return true;
+}
+
+/**
+ * Synthesize audio into the given buffer, running as many player
+ * ticks as needed to fill it.
+ *
+ * @param[out] end_r set to true if the song has ended
+ * @return the number of frames written
+ */
+static std::size_t
+AdPlugRender(CPlayer &player, Copl &opl, AdPlugClock &clock,
+	     std::span<int16_t> dest, bool &end_r) noexcept
+{
+	std::size_t n_frames = 0;
+	const std::size_t max_frames = dest.size() / 2;
+
+	while (n_frames < max_frames) {
+		if (clock.GetPending() == 0) {
+			if (!clock.Tick(player)) {
+				end_r = true;
+				break;
+			}
+
+			continue;
+		}
+
+		const unsigned n = std::min<std::size_t>(clock.GetPending(),
+							 max_frames - n_frames);
+		opl.update(dest.data() + n_frames * 2, n);
+		clock.Consume(n);
+		n_frames += n;
+	}
+
+	return n_frames;
+}
+
 static void
 adplug_file_decode(DecoderClient &client, Path path_fs)
 {
-	CEmuopl opl(sample_rate, true, true);
-	opl.init();
+	const unsigned sample_rate =
+		GetEmuSampleRate(&client, adplug_sample_rate,
+				 ADPLUG_DEFAULT_SAMPLE_RATE);
+	const auto opl = CreateOpl(sample_rate);
 
-	CPlayer *player = CAdPlug::factory(path_fs.c_str(), &opl);
+	CPlayer *player = CAdPlug::factory(path_fs.c_str(), opl.get());
 	if (player == nullptr)
 		return;
 
 	const AudioFormat audio_format(sample_rate, SampleFormat::S16, 2);
 	assert(audio_format.IsValid());
 
-	client.Ready(audio_format, false,
+	client.Ready(audio_format, true,
 		     SongTime::FromMS(player->songlength()));
 
+	AdPlugClock clock(sample_rate);
 	DecoderCommand cmd;
+	bool end = false;
 
 	do {
-		if (!player->update())
+		/* render directly into the MusicChunk if possible;
+		   one chunk spans several player ticks */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
+		int16_t buffer[4096];
+		const std::span<int16_t> dest = raw.empty()
+			? std::span{buffer}
+			: std::span{reinterpret_cast<int16_t *>(raw.data()),
+				    raw.size() / sizeof(int16_t)};
+
+		const std::size_t n_frames =
+			AdPlugRender(*player, *opl, clock, dest, end);
+		if (n_frames == 0)
 			break;
 
-		int16_t buffer[2048];
-		constexpr unsigned frames_per_buffer = std::size(buffer) / 2;
-		opl.update(buffer, frames_per_buffer);
-		cmd = client.SubmitAudio(nullptr,
-					 std::span{buffer},
-					 0);
-	} while (cmd == DecoderCommand::NONE);
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr,
+					     dest.first(n_frames * 2), 0)
+			: client.CommitAudio(n_frames * 2 * sizeof(int16_t));
+
+		if (cmd == DecoderCommand::SEEK) {
+			if (AdPlugSeek(*player, clock, client.GetSeekFrame())) {
+				client.CommandFinished();
+				end = false;
+			} else
+				/* keep playing from the old position */
+				client.SeekError();
+
+			cmd = DecoderCommand::NONE;
+		}
+	} while (cmd == DecoderCommand::NONE && !end);
 
 	delete player;
 }
@@ -74,7 +353,9 @@ adplug_scan_tag(TagType type, const std::string_view value,
 static bool
 adplug_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
-	CEmuopl opl(sample_rate, true, true);
+	CEmuopl opl(GetEmuSampleRate(nullptr, adplug_sample_rate,
+				     ADPLUG_DEFAULT_SAMPLE_RATE),
+		    true, true);
 	opl.init();
 
 	CPlayer *player = CAdPlug::factory(path_fs.c_str(), &opl);
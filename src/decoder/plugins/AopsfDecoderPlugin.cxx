@@ -2,7 +2,10 @@
 // Copyright The Music Player Daemon Project
 
 #include "AopsfDecoderPlugin.hxx"
+#include "PsfLoader.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSeek.hxx"
+#include "../EmuSilence.hxx"
 #include "Log.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -20,17 +23,8 @@ extern "C" {
 #else
 #include <psf2fs.h>
 #endif
-
-#if __has_include(<psflib.h>)
-#include <psflib.h>
-#elif __has_include(<psflib/psflib.h>)
-#include <psflib/psflib.h>
-#else
-#include <psflib.h>
-#endif
 #else
 #include <psf2fs.h>
-#include <psflib.h>
 #endif
 
 #include <aopsf/psx_external.h>
@@ -40,7 +34,6 @@ extern "C" {
 #include <array>
 #include <climits>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <span>
@@ -58,7 +51,10 @@ static constexpr unsigned AOPSF_SEEK_CHUNK_FRAMES = 8192;
 static constexpr unsigned PSF1_SAMPLE_RATE = 44100;
 static constexpr unsigned PSF2_SAMPLE_RATE = 48000;
 
-static constexpr char psf_separators[] = "\\/:";
+/**
+ * End songs without a "length" tag at silence.
+ */
+static EmuSilenceConfig silence_config;
 
 struct AopsfTags {
 	unsigned length_ms = 0;
@@ -216,52 +212,6 @@ EmitTags(TagHandler &handler, const AopsfTags &tags) noexcept
 		handler.OnTag(TAG_ARTIST, tags.game);
 }
 
-static void *
-Aopsf_fopen(void *, const char *path)
-{
-	return std::fopen(path, "rb");
-}
-
-static size_t
-Aopsf_fread(void *buffer, size_t size, size_t count, void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fread(buffer, size, count, f);
-}
-
-static int
-Aopsf_fseek(void *handle, int64_t offset, int whence)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	if (offset > LONG_MAX || offset < LONG_MIN)
-		return -1;
-	return std::fseek(f, static_cast<long>(offset), whence);
-}
-
-static int
-Aopsf_fclose(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fclose(f);
-}
-
-static long
-Aopsf_ftell(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::ftell(f);
-}
-
-static psf_file_callbacks Aopsf_psf_callbacks = {
-	psf_separators,
-	nullptr,
-	Aopsf_fopen,
-	Aopsf_fread,
-	Aopsf_fseek,
-	Aopsf_fclose,
-	Aopsf_ftell,
-};
-
 static int
 Aopsf_Info(void *context, const char *name, const char *value)
 {
@@ -328,56 +278,68 @@ Aopsf_LoadPsf1(void *context, const uint8_t *exe, size_t exe_size,
 	return 0;
 }
 
-static bool
-AopsfSeek(PSX_STATE *psx, uint32_t version, int64_t seek_ms,
-	  unsigned sample_rate) noexcept
-{
-	if (seek_ms < 0)
-		seek_ms = 0;
+class AopsfSeekHandler final : public EmuSeekHandler {
+	PSX_STATE *const psx;
+	const uint32_t version;
+	const std::span<std::byte> state;
 
-	const uint32_t restart = version == 2
-		? psf2_command(psx, COMMAND_RESTART, 0)
-		: psf_command(psx, COMMAND_RESTART, 0);
-	if (restart != AO_SUCCESS)
-		return false;
+public:
+	AopsfSeekHandler(PSX_STATE *_psx, uint32_t _version,
+			 std::span<std::byte> _state) noexcept
+		:psx(_psx), version(_version), state(_state) {}
 
-	const int64_t target_frames = seek_ms * sample_rate / 1000;
-	if (target_frames <= 0)
-		return true;
+	/* virtual methods from class EmuSeekHandler */
+	bool EmuRestart() noexcept override {
+		const uint32_t result = version == 2
+			? psf2_command(psx, COMMAND_RESTART, 0)
+			: psf_command(psx, COMMAND_RESTART, 0);
+		return result == AO_SUCCESS;
+	}
 
-	std::array<int16_t, AOPSF_SEEK_CHUNK_FRAMES * AOPSF_CHANNELS> buffer{};
-	int64_t frames_skipped = 0;
-	while (frames_skipped < target_frames) {
-		const int64_t remaining = target_frames - frames_skipped;
-		const uint32_t chunk = static_cast<uint32_t>(
-			std::min<int64_t>(remaining, AOPSF_SEEK_CHUNK_FRAMES));
+	uint64_t EmuSkip(uint64_t max_frames) noexcept override {
+		std::array<int16_t, AOPSF_SEEK_CHUNK_FRAMES * AOPSF_CHANNELS> buffer;
+		const uint32_t n = static_cast<uint32_t>(
+			std::min<uint64_t>(max_frames, AOPSF_SEEK_CHUNK_FRAMES));
 		const uint32_t result = version == 2
-			? psf2_gen(psx, buffer.data(), chunk)
-			: psf_gen(psx, buffer.data(), chunk);
-		if (result != AO_SUCCESS)
-			return false;
+			? psf2_gen(psx, buffer.data(), n)
+			: psf_gen(psx, buffer.data(), n);
+		return result == AO_SUCCESS ? n : 0;
+	}
 
-		frames_skipped += chunk;
+	/* the complete PSX state lives in one caller-allocated
+	   block, so it can be copied */
+	std::span<std::byte> GetEmuState() noexcept override {
+		return state;
 	}
+};
 
+static bool
+aopsf_plugin_init(const ConfigBlock &block)
+{
+	silence_config = ParseEmuSilenceConfig(block);
 	return true;
 }
 
 static bool
 aopsf_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
-	const std::string path_utf8 = path_fs.ToUTF8();
-
 	AopsfInfoContext info_ctx;
-	const int version = psf_load(path_utf8.c_str(), &Aopsf_psf_callbacks, 0,
-		nullptr, nullptr, &Aopsf_Info, &info_ctx, 1, nullptr, nullptr);
-	if (version <= 0)
+
+	/* only the tags are needed; don't boot the emulator */
+	try {
+		PsfScan(path_fs, 0, &Aopsf_Info, &info_ctx);
+	} catch (...) {
+		LogError(std::current_exception(), "error loading file");
 		return false;
+	}
 
 	if (handler.WantDuration()) {
 		const unsigned duration_ms = GetPsfDurationMS(info_ctx.tags);
 		if (duration_ms > 0)
 			handler.OnDuration(SongTime::FromMS(duration_ms));
+		else if (const auto detected = LookupEmuLength(path_fs);
+			 !detected.IsNegative())
+			handler.OnDuration(SongTime{detected});
 	}
 
 	if (handler.WantTag() || handler.WantPair())
@@ -389,13 +351,15 @@ aopsf_scan_file(Path path_fs, TagHandler &handler) noexcept
 static void
 aopsf_file_decode(DecoderClient &client, Path path_fs)
 {
-	const std::string path_utf8 = path_fs.ToUTF8();
-
 	AopsfInfoContext info_ctx;
-	const int version = psf_load(path_utf8.c_str(), &Aopsf_psf_callbacks, 0,
-		nullptr, nullptr, &Aopsf_Info, &info_ctx, 1, nullptr, nullptr);
-	if (version <= 0) {
-		LogWarning(aopsf_domain, "error probing file");
+	unsigned version;
+
+	try {
+		/* determine the version (and therefore the state
+		   size) without decompressing anything */
+		version = PsfScan(path_fs, 0, &Aopsf_Info, &info_ctx);
+	} catch (...) {
+		LogError(std::current_exception(), "error probing file");
 		return;
 	}
 
@@ -429,11 +393,11 @@ aopsf_file_decode(DecoderClient &client, Path path_fs)
 
 	if (version == 1) {
 		AopsfLoadContext load_ctx{psx, true};
-		const int ret = psf_load(path_utf8.c_str(), &Aopsf_psf_callbacks, 1,
-			&Aopsf_LoadPsf1, &load_ctx, &Aopsf_Info, &info_ctx,
-			1, nullptr, nullptr);
-		if (ret != 1) {
-			LogWarning(aopsf_domain, "invalid PSF file");
+		try {
+			PsfLoad(path_fs, 1, &Aopsf_LoadPsf1, &load_ctx,
+				&Aopsf_Info, &info_ctx);
+		} catch (...) {
+			LogError(std::current_exception(), "invalid PSF file");
 			return;
 		}
 
@@ -448,11 +412,11 @@ aopsf_file_decode(DecoderClient &client, Path path_fs)
 			return;
 		}
 
-		const int ret = psf_load(path_utf8.c_str(), &Aopsf_psf_callbacks, 2,
-			&psf2fs_load_callback, psf2fs, &Aopsf_Info, &info_ctx,
-			1, nullptr, nullptr);
-		if (ret != 2) {
-			LogWarning(aopsf_domain, "invalid PSF2 file");
+		try {
+			PsfLoad(path_fs, 2, &psf2fs_load_callback, psf2fs,
+				&Aopsf_Info, &info_ctx);
+		} catch (...) {
+			LogError(std::current_exception(), "invalid PSF2 file");
 			return;
 		}
 
@@ -472,8 +436,17 @@ aopsf_file_decode(DecoderClient &client, Path path_fs)
 		? PSF2_SAMPLE_RATE
 		: PSF1_SAMPLE_RATE;
 
-	const unsigned duration_ms = GetPsfDurationMS(info_ctx.tags);
+	/* without a "length" tag, use the length detected by an
+	   earlier playback, or look for silence */
+	unsigned duration_ms = GetPsfDurationMS(info_ctx.tags);
+	if (duration_ms == 0) {
+		if (const auto detected = LookupEmuLength(path_fs);
+		    !detected.IsNegative())
+			duration_ms = detected.ToMS();
+	}
+
 	const bool has_length = duration_ms > 0;
+	const bool detect_silence = !has_length && silence_config.IsEnabled();
 	const SignedSongTime song_len = has_length
 		? SignedSongTime::FromMS(duration_ms)
 		: SignedSongTime::Negative();
@@ -483,9 +456,15 @@ aopsf_file_decode(DecoderClient &client, Path path_fs)
 
 	client.Ready(audio_format, has_length, song_len);
 
-	int64_t frames_played = 0;
-	const int64_t length_frames = has_length
-		? static_cast<int64_t>(duration_ms) * sample_rate / 1000
+	AopsfSeekHandler seek_handler(psx, version, {
+			reinterpret_cast<std::byte *>(psx_storage), psx_size,
+		});
+	EmuSeeker seeker(seek_handler, sample_rate);
+
+	EmuSilenceDetector silence(silence_config, sample_rate, AOPSF_CHANNELS);
+
+	const uint64_t length_frames = has_length
+		? uint64_t(duration_ms) * sample_rate / 1000
 		: 0;
 
 	std::array<int16_t, AOPSF_BUFFER_FRAMES * AOPSF_CHANNELS> buffer{};
@@ -494,40 +473,56 @@ aopsf_file_decode(DecoderClient &client, Path path_fs)
 	do {
 		uint32_t frames = AOPSF_BUFFER_FRAMES;
 		if (has_length) {
-			const int64_t remaining = length_frames - frames_played;
-			if (remaining <= 0)
+			const uint64_t position = seeker.GetPosition();
+			if (position >= length_frames)
 				break;
 			frames = static_cast<uint32_t>(
-				std::min<int64_t>(remaining, AOPSF_BUFFER_FRAMES));
+				std::min<uint64_t>(length_frames - position,
+						   AOPSF_BUFFER_FRAMES));
 		}
 
+		/* render directly into the MusicChunk if possible */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
+		int16_t *const dest = raw.empty()
+			? buffer.data()
+			: reinterpret_cast<int16_t *>(raw.data());
+		if (!raw.empty())
+			frames = std::min<uint32_t>(frames,
+						    raw.size() / (AOPSF_CHANNELS * sizeof(int16_t)));
+
 		const uint32_t result = version == 2
-			? psf2_gen(psx, buffer.data(), frames)
-			: psf_gen(psx, buffer.data(), frames);
+			? psf2_gen(psx, dest, frames)
+			: psf_gen(psx, dest, frames);
 		if (result != AO_SUCCESS) {
 			const char *msg = psx_get_last_error(psx);
 			LogWarning(aopsf_domain, msg != nullptr ? msg : "decode error");
 			break;
 		}
 
-		cmd = client.SubmitAudio(nullptr,
-			std::span{buffer.data(),
-				static_cast<size_t>(frames * AOPSF_CHANNELS)},
-			0);
+		const bool silence_end = detect_silence &&
+			silence.Feed({dest, static_cast<size_t>(frames * AOPSF_CHANNELS)});
+
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr,
+					     std::span{buffer.data(),
+						       static_cast<size_t>(frames * AOPSF_CHANNELS)},
+					     0)
+			: client.CommitAudio(frames * AOPSF_CHANNELS * sizeof(int16_t));
 
-		frames_played += frames;
+		seeker.Advance(frames);
+
+		if (silence_end) {
+			SubmitEmuLength(client, path_fs, silence.GetLength());
+			break;
+		}
 
 		if (cmd == DecoderCommand::SEEK) {
-			const int64_t seek_ms = client.GetSeekTime().ToMS();
-			if (!AopsfSeek(psx, version, seek_ms, sample_rate)) {
+			if (!seeker.Seek(client)) {
 				LogWarning(aopsf_domain, "seek failed");
-				cmd = DecoderCommand::STOP;
-			} else if (has_length) {
-				frames_played = seek_ms * sample_rate / 1000;
-			} else {
-				frames_played = 0;
+				break;
 			}
-			client.CommandFinished();
+
+			silence.Reset(seeker.GetPosition());
 		}
 	} while (cmd != DecoderCommand::STOP);
 }
@@ -540,4 +535,6 @@ static const char *const aopsf_suffixes[] = {
 
 constexpr DecoderPlugin aopsf_decoder_plugin =
 	DecoderPlugin("aopsf", aopsf_file_decode, aopsf_scan_file)
+	.WithInit(aopsf_plugin_init)
+	.WithPrefetch(PsfPrefetch)
 	.WithSuffixes(aopsf_suffixes);
@@ -15,7 +15,7 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "pcm/CheckAudioFormat.hxx"
-#include "util/BitReverse.hxx"
+#include "pcm/DsdKernels.hxx"
 #include "util/PackedBigEndian.hxx"
 #include "util/SpanCast.hxx"
 #include "tag/Handler.hxx"
@@ -335,13 +335,6 @@ dsdiff_read_metadata(DecoderClient *client, InputStream &is,
 	}
 }
 
-static void
-bit_reverse_buffer(std::byte *p, std::byte *end)
-{
-	for (; p < end; ++p)
-		*p = BitReverse(*p);
-}
-
 static offset_type
 FrameToOffset(uint64_t frame, unsigned channels)
 {
@@ -405,7 +398,7 @@ dsdiff_decode_chunk(DecoderClient &client, InputStream &is,
 		remaining_bytes -= nbytes;
 
 		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+			GetPcmDsdKernels().bit_reverse(buffer, nbytes);
 
 		cmd = client.SubmitAudio(is, std::span{buffer, nbytes},
 					 kbit_rate);
@@ -16,7 +16,7 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "pcm/CheckAudioFormat.hxx"
-#include "util/BitReverse.hxx"
+#include "pcm/DsdKernels.hxx"
 #include "util/PackedLittleEndian.hxx"
 #include "util/SpanCast.hxx"
 #include "DsdLib.hxx"
@@ -166,13 +166,6 @@ dsf_read_metadata(DecoderClient *client, InputStream &is,
 	return true;
 }
 
-static void
-bit_reverse_buffer(std::byte *p, std::byte *end)
-{
-	for (; p < end; ++p)
-		*p = BitReverse(*p);
-}
-
 static void
 InterleaveDsfBlockMono(std::byte *gcc_restrict dest,
 		       const std::byte *gcc_restrict src)
@@ -276,7 +269,7 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 			return false;
 
 		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+			GetPcmDsdKernels().bit_reverse(buffer, block_size);
 
 		std::byte interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
 		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
@@ -41,6 +41,7 @@ extern "C" {
 }
 
 #include <cassert>
+#include <vector>
 
 #include <string.h>
 
@@ -51,6 +52,12 @@ using std::string_view_literals::operator""sv;
  */
 static AVDictionary *avformat_options = nullptr;
 
+/**
+ * The number of decoder threads (setting "threads"); 0 lets FFmpeg
+ * choose.
+ */
+static unsigned ffmpeg_threads = 1;
+
 static Ffmpeg::FormatContext
 FfmpegOpenInput(AVIOContext *pb,
 		const char *filename,
@@ -83,6 +90,8 @@ ffmpeg_init(const ConfigBlock &block)
 			av_dict_set(&avformat_options, name, value, 0);
 	}
 
+	ffmpeg_threads = block.GetBlockValue("threads", 1U);
+
 	return true;
 }
 
@@ -193,6 +202,42 @@ PtsToPcmFrame(uint64_t pts, const AVStream &stream,
 	return av_rescale_q(pts, stream.time_base, codec_context.time_base);
 }
 
+/**
+ * Interleave a planar #AVFrame directly into #MusicChunk memory
+ * obtained from DecoderClient::GetAudioBuffer().
+ *
+ * @param offset the number of PCM frames to skip at the beginning;
+ * on return, the number of PCM frames which have been consumed (less
+ * than the #AVFrame contains if the client cannot hand out chunk
+ * memory, or if a command is pending)
+ */
+static DecoderCommand
+FfmpegSendPlanarFrame(DecoderClient &client, InputStream *is,
+		      const AVFrame &frame, std::size_t &offset,
+		      uint16_t kbit_rate) noexcept
+{
+	const auto format = AVSampleFormat(frame.format);
+	const std::size_t frame_size = av_get_bytes_per_sample(format)
+		* frame.ch_layout.nb_channels;
+	const std::size_t n_frames = frame.nb_samples;
+
+	while (offset < n_frames) {
+		const auto dest = client.GetAudioBuffer(is, kbit_rate);
+		if (dest.empty())
+			break;
+
+		const std::size_t n =
+			Ffmpeg::InterleavePlanarFrameTo(frame, offset, dest);
+		offset += n;
+
+		const auto cmd = client.CommitAudio(n * frame_size);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+	}
+
+	return DecoderCommand::NONE;
+}
+
 /**
  * Invoke DecoderClient::SubmitAudio() with the contents of an
  * #AVFrame.
@@ -204,6 +249,33 @@ FfmpegSendFrame(DecoderClient &client, InputStream *is,
 		size_t &skip_bytes,
 		FfmpegBuffer &buffer)
 {
+	const auto format = AVSampleFormat(frame.format);
+	const unsigned channels = frame.ch_layout.nb_channels;
+	if (av_sample_fmt_is_planar(format) && channels > 1) {
+		const std::size_t frame_size =
+			av_get_bytes_per_sample(format) * channels;
+		const std::size_t n_frames = frame.nb_samples;
+
+		if (skip_bytes >= n_frames * frame_size) {
+			skip_bytes -= n_frames * frame_size;
+			return DecoderCommand::NONE;
+		}
+
+		std::size_t offset = skip_bytes / frame_size;
+		skip_bytes = 0;
+
+		const auto cmd = FfmpegSendPlanarFrame(client, is, frame,
+						       offset,
+						       codec_context.bit_rate / 1000);
+		if (cmd != DecoderCommand::NONE || offset == n_frames)
+			return cmd;
+
+		/* the client does not support direct writes (or a
+		   sample format conversion is necessary); submit the
+		   rest the classic way */
+		skip_bytes = offset * frame_size;
+	}
+
 	auto output_buffer = Ffmpeg::InterleaveFrame(frame, buffer);
 
 	if (skip_bytes > 0) {
@@ -495,6 +567,14 @@ FfmpegDecode(DecoderClient &client, InputStream *input,
 
 	Ffmpeg::CodecContext codec_context(*codec);
 	codec_context.FillFromParameters(*av_stream.codecpar);
+
+	if (ffmpeg_threads != 1) {
+		/* frame threading helps codecs which are too
+		   expensive for one core (e.g. APE, TAK, TrueHD) */
+		codec_context->thread_count = ffmpeg_threads;
+		codec_context->thread_type = FF_THREAD_FRAME|FF_THREAD_SLICE;
+	}
+
 	codec_context.Open(*codec, nullptr);
 
 	const SampleFormat sample_format =
@@ -602,17 +682,69 @@ ffmpeg_decode(DecoderClient &client, InputStream &input)
 	FfmpegDecode(client, &input, *format_context);
 }
 
+/**
+ * Does the container header describe the given stream completely,
+ * i.e. is there no need to call avformat_find_stream_info() (which
+ * may decode frames) for scanning it?
+ */
+[[gnu::pure]]
 static bool
-FfmpegScanStream(AVFormatContext &format_context, TagHandler &handler)
+HasScanInfo(const AVFormatContext &format_context,
+	    const AVStream &stream) noexcept
 {
-	const int find_result =
-		avformat_find_stream_info(&format_context, nullptr);
-	if (find_result < 0)
-		return false;
+	const auto &codec_params = *stream.codecpar;
 
-	const int audio_stream = ffmpeg_find_audio_stream(format_context);
-	if (audio_stream < 0)
-		return false;
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 25, 100)
+	const unsigned channels = codec_params.ch_layout.nb_channels;
+#else
+	const unsigned channels = codec_params.channels;
+#endif
+
+	return (format_context.ctx_flags & AVFMTCTX_NOHEADER) == 0 &&
+		(stream.duration != (int64_t)AV_NOPTS_VALUE ||
+		 format_context.duration != (int64_t)AV_NOPTS_VALUE) &&
+		codec_params.sample_rate > 0 && channels > 0 &&
+		codec_params.format >= 0;
+}
+
+/**
+ * Call avformat_find_stream_info() with codec options for a quick
+ * scan: only one thread per codec and #AV_CODEC_FLAG2_FAST, because
+ * the decoded samples are thrown away anyway.
+ */
+static int
+FfmpegFindScanStreamInfo(AVFormatContext &format_context) noexcept
+{
+	std::vector<AVDictionary *> options(format_context.nb_streams);
+	AtScopeExit(&options) {
+		for (auto *&i : options)
+			av_dict_free(&i);
+	};
+
+	for (auto *&i : options) {
+		av_dict_set(&i, "threads", "1", 0);
+		av_dict_set(&i, "flags2", "+fast", 0);
+	}
+
+	return avformat_find_stream_info(&format_context, options.data());
+}
+
+static bool
+FfmpegScanStream(AVFormatContext &format_context, TagHandler &handler)
+{
+	int audio_stream = ffmpeg_find_audio_stream(format_context);
+	if (audio_stream < 0 ||
+	    !HasScanInfo(format_context,
+			 *format_context.streams[audio_stream])) {
+		/* the header is incomplete; let FFmpeg probe the
+		   stream */
+		if (FfmpegFindScanStreamInfo(format_context) < 0)
+			return false;
+
+		audio_stream = ffmpeg_find_audio_stream(format_context);
+		if (audio_stream < 0)
+			return false;
+	}
 
 	const AVStream &stream = *format_context.streams[audio_stream];
 	if (stream.duration != (int64_t)AV_NOPTS_VALUE)
@@ -2,23 +2,56 @@
 // Copyright The Music Player Daemon Project
 
 #include "FluidsynthDecoderPlugin.hxx"
+#include "MidiTempoMap.hxx"
 #include "../DecoderAPI.hxx"
+#include "tag/Handler.hxx"
+#include "io/FileReader.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Domain.hxx"
+#include "util/ScopeExit.hxx"
 #include "Log.hxx"
 
 #include <fluidsynth.h>
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
 static constexpr Domain fluidsynth_domain("fluidsynth");
 
+/**
+ * fluid_player_seek() was added in fluidsynth 2.0.
+ */
+static constexpr bool fluidsynth_can_seek = FLUIDSYNTH_VERSION_MAJOR >= 2;
+
+/**
+ * Larger files are not parsed by LoadTempoMap().
+ */
+static constexpr std::size_t MAX_MIDI_FILE_SIZE = 16 * 1024 * 1024;
+
 static unsigned sample_rate;
 static double gain = 0.0;
 static bool gain_set = false;
 static const char *soundfont_path;
 
+/**
+ * Values for "synth.cpu-cores" and "synth.polyphony"; 0 means
+ * fluidsynth's default.
+ */
+static unsigned cpu_cores, polyphony;
+
+/**
+ * The maximum number of frames rendered by one
+ * fluid_synth_write_float() call.
+ */
+static constexpr std::size_t FLUIDSYNTH_MAX_FRAMES = 1024;
+
 /**
  * Convert a fluidsynth log level to a MPD log level.
  */
@@ -71,6 +104,9 @@ fluidsynth_init(const ConfigBlock &block)
 	soundfont_path = block.GetBlockValue("soundfont",
 					     "/usr/share/sounds/sf2/FluidR3_GM.sf2");
 
+	cpu_cores = block.GetBlockValue("cpu_cores", 0U);
+	polyphony = block.GetBlockValue("polyphony", 0U);
+
 	char *endptr;
 	const char *svalue = block.GetBlockValue("gain");
 	if (svalue != nullptr) {
@@ -88,8 +124,45 @@ fluidsynth_init(const ConfigBlock &block)
 	return true;
 }
 
-static void
-fluidsynth_file_decode(DecoderClient &client, Path path_fs)
+/**
+ * A fluidsynth synthesizer with the SoundFont loaded.  Loading a
+ * large SoundFont takes seconds, therefore idle instances are kept
+ * in #synth_pool and reused for the next song.
+ */
+struct FluidsynthSynth {
+	fluid_settings_t *const settings;
+	fluid_synth_t *const synth;
+
+	FluidsynthSynth(fluid_settings_t *_settings,
+			fluid_synth_t *_synth) noexcept
+		:settings(_settings), synth(_synth) {}
+
+	~FluidsynthSynth() noexcept {
+		delete_fluid_synth(synth);
+		delete_fluid_settings(settings);
+	}
+
+	FluidsynthSynth(const FluidsynthSynth &) = delete;
+	FluidsynthSynth &operator=(const FluidsynthSynth &) = delete;
+};
+
+/**
+ * The maximum number of idle synthesizers kept in #synth_pool.  One
+ * per decoder thread which plays MIDI files at the same time is
+ * enough.
+ */
+static constexpr std::size_t MAX_IDLE_SYNTHS = 2;
+
+static Mutex synth_pool_mutex;
+static std::vector<std::unique_ptr<FluidsynthSynth>> synth_pool;
+
+/**
+ * Create a new synthesizer and load the SoundFont.
+ *
+ * @return nullptr on error
+ */
+static std::unique_ptr<FluidsynthSynth>
+CreateSynth() noexcept
 {
 	char setting_sample_rate[] = "synth.sample-rate";
 	char setting_gain[] = "synth.gain";
@@ -97,59 +170,136 @@ fluidsynth_file_decode(DecoderClient &client, Path path_fs)
 	char setting_verbose[] = "synth.verbose";
 	char setting_yes[] = "yes";
 	*/
-	fluid_settings_t *settings;
-	fluid_synth_t *synth;
-	fluid_player_t *player;
-	int ret;
-
-	auto np = NarrowPath(path_fs);
 
 	/* set up fluid settings */
 
-	settings = new_fluid_settings();
+	fluid_settings_t *settings = new_fluid_settings();
 	if (settings == nullptr)
-		return;
+		return nullptr;
 
 	fluid_settings_setnum(settings, setting_sample_rate, sample_rate);
 	if (gain_set) {
 		fluid_settings_setnum(settings, setting_gain, gain);
 	}
 
+	/* with more than one core, fluidsynth renders the voices
+	   in additional threads */
+	if (cpu_cores > 0)
+		fluid_settings_setint(settings, "synth.cpu-cores", cpu_cores);
+
+	if (polyphony > 0)
+		fluid_settings_setint(settings, "synth.polyphony", polyphony);
+
 	/*
 	fluid_settings_setstr(settings, setting_verbose, setting_yes);
 	*/
 
 	/* create the fluid synth */
 
-	synth = new_fluid_synth(settings);
+	fluid_synth_t *synth = new_fluid_synth(settings);
 	if (synth == nullptr) {
 		delete_fluid_settings(settings);
-		return;
+		return nullptr;
 	}
 
-	ret = fluid_synth_sfload(synth, soundfont_path, true);
-	if (ret < 0) {
+	auto result = std::make_unique<FluidsynthSynth>(settings, synth);
+
+	if (fluid_synth_sfload(synth, soundfont_path, true) < 0) {
 		LogWarning(fluidsynth_domain, "fluid_synth_sfload() failed");
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
-		return;
+		return nullptr;
 	}
 
+	return result;
+}
+
+/**
+ * Obtain an idle synthesizer from #synth_pool or create a new one.
+ *
+ * @return nullptr on error
+ */
+static std::unique_ptr<FluidsynthSynth>
+AcquireSynth() noexcept
+{
+	{
+		const std::scoped_lock lock{synth_pool_mutex};
+		if (!synth_pool.empty()) {
+			auto result = std::move(synth_pool.back());
+			synth_pool.pop_back();
+			return result;
+		}
+	}
+
+	return CreateSynth();
+}
+
+/**
+ * Reset the synthesizer and return it to #synth_pool.
+ */
+static void
+ReleaseSynth(std::unique_ptr<FluidsynthSynth> &&s) noexcept
+{
+	/* forget all notes, controller and program changes of the
+	   previous song, but keep the SoundFont */
+	fluid_synth_system_reset(s->synth);
+
+	const std::scoped_lock lock{synth_pool_mutex};
+	if (synth_pool.size() < MAX_IDLE_SYNTHS)
+		synth_pool.push_back(std::move(s));
+}
+
+/**
+ * Parse the tempo map of the MIDI file, which determines the
+ * duration and allows converting seek times to sequencer ticks.
+ *
+ * Throws on error.
+ */
+static MidiTempoMap
+LoadTempoMap(Path path_fs)
+{
+	FileReader reader{path_fs};
+
+	const auto size = reader.GetSize();
+	if (size > MAX_MIDI_FILE_SIZE)
+		throw std::runtime_error{"MIDI file is too large"};
+
+	std::vector<std::byte> buffer(size);
+	reader.ReadFull(buffer);
+
+	return MidiTempoMap{buffer};
+}
+
+static void
+fluidsynth_finish() noexcept
+{
+	synth_pool.clear();
+}
+
+static void
+fluidsynth_file_decode(DecoderClient &client, Path path_fs)
+{
+	fluid_player_t *player;
+	int ret;
+
+	auto np = NarrowPath(path_fs);
+
+	auto s = AcquireSynth();
+	if (s == nullptr)
+		return;
+
+	AtScopeExit(&s) { ReleaseSynth(std::move(s)); };
+
+	fluid_synth_t *const synth = s->synth;
+
 	/* create the fluid player */
 
 	player = new_fluid_player(synth);
-	if (player == nullptr) {
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
+	if (player == nullptr)
 		return;
-	}
 
 	ret = fluid_player_add(player, np);
 	if (ret != 0) {
 		LogWarning(fluidsynth_domain, "fluid_player_add() failed");
 		delete_fluid_player(player);
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
 		return;
 	}
 
@@ -159,32 +309,66 @@ fluidsynth_file_decode(DecoderClient &client, Path path_fs)
 	if (ret != 0) {
 		LogWarning(fluidsynth_domain, "fluid_player_play() failed");
 		delete_fluid_player(player);
-		delete_fluid_synth(synth);
-		delete_fluid_settings(settings);
 		return;
 	}
 
 	/* initialization complete - announce the audio format to the
 	   MPD core */
 
-	const AudioFormat audio_format(sample_rate, SampleFormat::S16, 2);
-	client.Ready(audio_format, false, SignedSongTime::Negative());
+	std::optional<MidiTempoMap> tempo_map;
+	try {
+		tempo_map.emplace(LoadTempoMap(path_fs));
+	} catch (...) {
+		Log(LogLevel::WARNING, std::current_exception(),
+		    "Failed to parse the MIDI tempo map");
+	}
+
+	static constexpr unsigned channels = 2;
+	const AudioFormat audio_format(sample_rate, SampleFormat::FLOAT,
+				       channels);
+	client.Ready(audio_format, fluidsynth_can_seek && tempo_map,
+		     tempo_map
+		     ? SignedSongTime::FromS(tempo_map->GetDuration())
+		     : SignedSongTime::Negative());
 
 	DecoderCommand cmd;
 	while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING) {
-		int16_t buffer[2048];
-		const unsigned max_frames = std::size(buffer) / 2;
+		/* render directly into the MusicChunk if possible */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
+		float buffer[FLUIDSYNTH_MAX_FRAMES * channels];
+		const std::span<float> dest = raw.empty()
+			? std::span{buffer}
+			: std::span{reinterpret_cast<float *>(raw.data()),
+				    std::min(raw.size(), sizeof(buffer)) / sizeof(float)};
+		const std::size_t n_frames = dest.size() / channels;
 
 		/* read samples from fluidsynth and send them to the
 		   MPD core */
 
-		ret = fluid_synth_write_s16(synth, max_frames,
-					    buffer, 0, 2,
-					    buffer, 1, 2);
+		ret = fluid_synth_write_float(synth, static_cast<int>(n_frames),
+					      dest.data(), 0, channels,
+					      dest.data(), 1, channels);
 		if (ret != 0)
 			break;
 
-		cmd = client.SubmitAudio(nullptr, std::span{buffer}, 0);
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr,
+					     dest.first(n_frames * channels), 0)
+			: client.CommitAudio(n_frames * channels * sizeof(float));
+#if FLUIDSYNTH_VERSION_MAJOR >= 2
+		if (cmd == DecoderCommand::SEEK && tempo_map) {
+			/* the player processes all events up to
+			   the new position without rendering
+			   them */
+			const auto tick = tempo_map->TimeToTick(client.GetSeekTime().ToDoubleS());
+			if (fluid_player_seek(player, static_cast<int>(tick)) == FLUID_OK)
+				client.CommandFinished();
+			else
+				client.SeekError();
+			continue;
+		}
+#endif
+
 		if (cmd != DecoderCommand::NONE)
 			break;
 	}
@@ -195,16 +379,23 @@ fluidsynth_file_decode(DecoderClient &client, Path path_fs)
 	fluid_player_join(player);
 
 	delete_fluid_player(player);
-	delete_fluid_synth(synth);
-	delete_fluid_settings(settings);
 }
 
 static bool
-fluidsynth_scan_file(Path path_fs,
-		     [[maybe_unused]] TagHandler &handler) noexcept
+fluidsynth_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
 	auto np = NarrowPath(path_fs);
-	return fluid_is_midifile(np);
+	if (!fluid_is_midifile(np))
+		return false;
+
+	try {
+		handler.OnDuration(SongTime::FromS(LoadTempoMap(path_fs).GetDuration()));
+	} catch (...) {
+		/* no duration, but fluidsynth may still be able to
+		   play the file */
+	}
+
+	return true;
 }
 
 static constexpr const char *fluidsynth_suffixes[] = {
@@ -215,5 +406,5 @@ static constexpr const char *fluidsynth_suffixes[] = {
 constexpr DecoderPlugin fluidsynth_decoder_plugin =
 	DecoderPlugin("fluidsynth",
 		      fluidsynth_file_decode, fluidsynth_scan_file)
-	.WithInit(fluidsynth_init)
+	.WithInit(fluidsynth_init, fluidsynth_finish)
 	.WithSuffixes(fluidsynth_suffixes);
@@ -3,6 +3,8 @@
 
 #include "GmeDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
+#include "../EmuSilence.hxx"
 #include "config/Block.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "song/DetachedSong.hxx"
@@ -10,10 +12,12 @@
 #include "tag/Builder.hxx"
 #include "fs/Path.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
 #include "fs/FileSystem.hxx"
 #include "fs/NarrowPath.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ScopeExit.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Domain.hxx"
@@ -23,7 +27,11 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <list>
+#include <memory>
 
 #include <stdlib.h>
 
@@ -33,7 +41,7 @@ using std::string_view_literals::operator""sv;
 
 static constexpr Domain gme_domain("gme");
 
-static constexpr unsigned GME_SAMPLE_RATE = 44100;
+static constexpr unsigned GME_DEFAULT_SAMPLE_RATE = 44100;
 static constexpr unsigned GME_CHANNELS = 2;
 static constexpr unsigned GME_BUFFER_FRAMES = 2048;
 static constexpr unsigned GME_BUFFER_SAMPLES =
@@ -47,6 +55,17 @@ struct GmeContainerPath {
 static int gme_accuracy;
 static unsigned gme_default_fade;
 
+/**
+ * The configured sample rate; 0 means "auto", i.e. use the outputs'
+ * sample rate.
+ */
+static unsigned gme_sample_rate;
+
+/**
+ * End songs without a length at silence.
+ */
+static EmuSilenceConfig gme_silence;
+
 static bool
 gme_plugin_init([[maybe_unused]] const ConfigBlock &block)
 {
@@ -60,9 +79,21 @@ gme_plugin_init([[maybe_unused]] const ConfigBlock &block)
 		? fade->GetUnsignedValue() * 1000
 		: 8000;
 
+	gme_sample_rate = ParseEmuSampleRate(block, GME_DEFAULT_SAMPLE_RATE);
+
+	gme_silence = ParseEmuSilenceConfig(block);
+
 	return true;
 }
 
+[[gnu::pure]]
+static unsigned
+GetGmeSampleRate(DecoderClient *client) noexcept
+{
+	return GetEmuSampleRate(client, gme_sample_rate,
+				GME_DEFAULT_SAMPLE_RATE);
+}
+
 [[gnu::pure]]
 static unsigned
 ParseSubtuneName(const char *base) noexcept
@@ -108,17 +139,159 @@ ReplaceSuffix(Path src,
 	return AllocatedPath::FromFS(std::move(s));
 }
 
-static Music_Emu*
-LoadGmeAndM3u(const GmeContainerPath& container) {
+struct GmeEmuDeleter {
+	void operator()(Music_Emu *emu) const noexcept {
+		gme_delete(emu);
+	}
+};
+
+using GmeEmuPtr = std::unique_ptr<Music_Emu, GmeEmuDeleter>;
+
+/**
+ * A small cache of opened #Music_Emu instances.  Loading a file
+ * means parsing (and for VGZ, decompressing) it, which is wasted
+ * effort when scanning subtunes or playing several tracks of one
+ * container in a row.  Instances are handed out exclusively by
+ * Get() and returned by Put().
+ */
+class GmeEmuCache {
+	/**
+	 * NSF/SPC albums are played track by track, so only the
+	 * most recent files are interesting.
+	 */
+	static constexpr std::size_t MAX_ITEMS = 2;
+
+	struct Item {
+		AllocatedPath path;
+		std::chrono::system_clock::time_point mtime;
+		unsigned sample_rate;
+		GmeEmuPtr emu;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<Item> items;
+
+public:
+	/**
+	 * Remove a matching emulator from the cache and return it.
+	 */
+	GmeEmuPtr Get(const AllocatedPath &path,
+		      std::chrono::system_clock::time_point mtime,
+		      unsigned sample_rate) noexcept {
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->path == path && i->mtime == mtime &&
+			    i->sample_rate == sample_rate) {
+				auto emu = std::move(i->emu);
+				items.erase(i);
+				return emu;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void Put(AllocatedPath &&path,
+		 std::chrono::system_clock::time_point mtime,
+		 unsigned sample_rate, GmeEmuPtr &&emu) noexcept {
+		assert(emu);
+
+		const std::scoped_lock lock{mutex};
+
+		/* drop stale instances of this file */
+		std::erase_if(items, [&path](const auto &i){
+			return i.path == path;
+		});
+
+		items.push_front({std::move(path), mtime, sample_rate,
+				  std::move(emu)});
+		if (items.size() > MAX_ITEMS)
+			items.pop_back();
+	}
+
+	void Clear() noexcept {
+		const std::scoped_lock lock{mutex};
+		items.clear();
+	}
+};
+
+static GmeEmuCache gme_emu_cache;
+
+/**
+ * An emulator obtained from LoadGmeAndM3u().  The destructor returns
+ * it to #gme_emu_cache unless Discard() was called.
+ */
+class GmeEmuLease {
+	AllocatedPath path;
+	std::chrono::system_clock::time_point mtime;
+	unsigned sample_rate;
+	GmeEmuPtr emu;
+
+public:
+	GmeEmuLease() noexcept:path(nullptr) {}
+
+	GmeEmuLease(AllocatedPath &&_path,
+		    std::chrono::system_clock::time_point _mtime,
+		    unsigned _sample_rate,
+		    GmeEmuPtr &&_emu) noexcept
+		:path(std::move(_path)), mtime(_mtime),
+		 sample_rate(_sample_rate), emu(std::move(_emu)) {}
+
+	GmeEmuLease(GmeEmuLease &&) noexcept = default;
+
+	~GmeEmuLease() noexcept {
+		if (emu)
+			gme_emu_cache.Put(std::move(path), mtime,
+					  sample_rate, std::move(emu));
+	}
+
+	operator bool() const noexcept {
+		return emu != nullptr;
+	}
+
+	Music_Emu *get() const noexcept {
+		return emu.get();
+	}
+
+	unsigned GetSampleRate() const noexcept {
+		return sample_rate;
+	}
+
+	/**
+	 * The emulator is in an undefined state (e.g. after an
+	 * error); don't return it to the cache.
+	 */
+	void Discard() noexcept {
+		emu.reset();
+	}
+};
+
+static GmeEmuLease
+LoadGmeAndM3u(const GmeContainerPath& container, unsigned sample_rate) {
+
+	std::chrono::system_clock::time_point mtime{};
+	if (FileInfo info; GetFileInfo(container.path, info))
+		mtime = info.GetModificationTime();
+
+	if (auto emu = gme_emu_cache.Get(container.path, mtime, sample_rate))
+		return {AllocatedPath{container.path}, mtime, sample_rate,
+			std::move(emu)};
 
 	Music_Emu *emu;
 	const char *gme_err =
-		gme_open_file(NarrowPath(container.path), &emu, GME_SAMPLE_RATE);
+		gme_open_file(NarrowPath(container.path), &emu, sample_rate);
 	if (gme_err != nullptr) {
 		LogWarning(gme_domain, gme_err);
-		return nullptr;
+		return {};
 	}
 
+	GmeEmuPtr emu_ptr{emu};
+
 	const auto m3u_path = ReplaceSuffix(container.path,
 					    PATH_LITERAL("m3u"));
     /*
@@ -129,21 +302,26 @@ LoadGmeAndM3u(const GmeContainerPath& container) {
 	if (!m3u_path.IsNull() && FileExists(m3u_path))
 		gme_load_m3u(emu, NarrowPath(m3u_path));
 
-	return emu;
+	return {AllocatedPath{container.path}, mtime, sample_rate,
+		std::move(emu_ptr)};
 }
 
+static void
+gme_plugin_finish() noexcept
+{
+	gme_emu_cache.Clear();
+}
 
 static void
 gme_file_decode(DecoderClient &client, Path path_fs)
 {
 	const auto container = ParseContainerPath(path_fs);
 
-	Music_Emu *emu = LoadGmeAndM3u(container);
-	if(emu == nullptr) {
+	auto lease = LoadGmeAndM3u(container, GetGmeSampleRate(&client));
+	if (!lease)
 		return;
-	}
 
-	AtScopeExit(emu) { gme_delete(emu); };
+	Music_Emu *const emu = lease.get();
 
 	FmtDebug(gme_domain, "emulator type {:?}",
 		 gme_type_system(gme_type(emu)));
@@ -166,14 +344,22 @@ gme_file_decode(DecoderClient &client, Path path_fs)
 #endif
 	gme_free_info(ti);
 
+	/* without a length, use the length detected by an earlier
+	   playback, or look for silence */
+	const SignedSongTime detected_len = length > 0
+		? SignedSongTime::Negative()
+		: LookupEmuLength(path_fs);
+	const bool detect_silence = length <= 0 && detected_len.IsNegative() &&
+		gme_silence.IsEnabled();
+
 	const SignedSongTime song_len = length > 0
 		? SignedSongTime::FromMS(length +
 			(fade == -1 ? gme_default_fade : fade))
-		: SignedSongTime::Negative();
+		: detected_len;
 
 	/* initialize the MPD decoder */
 
-	const auto audio_format = CheckAudioFormat(GME_SAMPLE_RATE,
+	const auto audio_format = CheckAudioFormat(lease.GetSampleRate(),
 						   SampleFormat::S16,
 						   GME_CHANNELS);
 
@@ -190,33 +376,71 @@ gme_file_decode(DecoderClient &client, Path path_fs)
 #endif
 			     );
 
+	const unsigned sample_rate = audio_format.sample_rate;
+	const uint64_t end_frames = detected_len.IsNegative()
+		? 0
+		: detected_len.ToScale<uint64_t>(sample_rate);
+	uint64_t position = 0;
+
+	EmuSilenceDetector silence(gme_silence, sample_rate, GME_CHANNELS);
+
 	/* play */
 	DecoderCommand cmd;
 	do {
+		/* render directly into the MusicChunk if possible */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
 		short buf[GME_BUFFER_SAMPLES];
-		gme_err = gme_play(emu, GME_BUFFER_SAMPLES, buf);
+		const std::span<short> dest = raw.empty()
+			? std::span{buf}
+			: std::span{reinterpret_cast<short *>(raw.data()),
+				    std::min<std::size_t>(raw.size() / sizeof(short),
+							  GME_BUFFER_SAMPLES)};
+
+		gme_err = gme_play(emu, static_cast<int>(dest.size()), dest.data());
 		if (gme_err != nullptr) {
 			LogWarning(gme_domain, gme_err);
+			lease.Discard();
 			return;
 		}
 
-		cmd = client.SubmitAudio(nullptr, std::span{buf}, 0);
+		position += dest.size() / GME_CHANNELS;
+
+		const bool silence_end = detect_silence && silence.Feed(dest);
+
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr, dest, 0)
+			: client.CommitAudio(dest.size_bytes());
+
+		if (silence_end) {
+			SubmitEmuLength(client, path_fs, silence.GetLength());
+			break;
+		}
+
 		if (cmd == DecoderCommand::SEEK) {
-			unsigned where = client.GetSeekTime().ToMS();
-			gme_err = gme_seek(emu, where);
+			const auto where = client.GetSeekTime();
+			gme_err = gme_seek(emu, where.ToMS());
 			if (gme_err != nullptr) {
 				client.SeekError(std::make_exception_ptr(FmtRuntimeError("gme_see() failed: {}"sv, gme_err)));
-			} else
+			} else {
+				position = where.ToScale<uint64_t>(sample_rate);
+				silence.Reset(position);
 				client.CommandFinished();
+			}
 		}
 
-		if (gme_track_ended(emu))
+		if (gme_track_ended(emu) ||
+		    (end_frames > 0 && position >= end_frames))
 			break;
 	} while (cmd != DecoderCommand::STOP);
 }
 
+/**
+ * @param path_fs the path of the song (including the subtune suffix),
+ * for looking up a length detected by LookupEmuLength()
+ */
 static void
-ScanGmeInfo(const gme_info_t &info, unsigned song_num, int track_count,
+ScanGmeInfo(Path path_fs, const gme_info_t &info,
+	    unsigned song_num, int track_count,
 	    TagHandler &handler) noexcept
 {
 	if (info.play_length > 0)
@@ -225,6 +449,9 @@ ScanGmeInfo(const gme_info_t &info, unsigned song_num, int track_count,
 			+ (info.fade_length == -1 ? gme_default_fade : info.fade_length)
 #endif
 			));
+	else if (const auto detected = LookupEmuLength(path_fs);
+		 !detected.IsNegative())
+		handler.OnDuration(SongTime{detected});
 
 	if (track_count > 1)
 		handler.OnTag(TAG_TRACK, fmt::format_int{song_num + 1}.c_str());
@@ -255,7 +482,8 @@ ScanGmeInfo(const gme_info_t &info, unsigned song_num, int track_count,
 }
 
 static bool
-ScanMusicEmu(Music_Emu *emu, unsigned song_num, TagHandler &handler) noexcept
+ScanMusicEmu(Path path_fs, Music_Emu *emu, unsigned song_num,
+	     TagHandler &handler) noexcept
 {
 	gme_info_t *ti;
 	const char *gme_err = gme_track_info(emu, &ti, song_num);
@@ -268,7 +496,7 @@ ScanMusicEmu(Music_Emu *emu, unsigned song_num, TagHandler &handler) noexcept
 
 	AtScopeExit(ti) { gme_free_info(ti); };
 
-	ScanGmeInfo(*ti, song_num, gme_track_count(emu), handler);
+	ScanGmeInfo(path_fs, *ti, song_num, gme_track_count(emu), handler);
 	return true;
 }
 
@@ -277,14 +505,11 @@ gme_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
 	const auto container = ParseContainerPath(path_fs);
 
-	Music_Emu *emu = LoadGmeAndM3u(container);
-	if(emu == nullptr) {
+	const auto lease = LoadGmeAndM3u(container, GetGmeSampleRate(nullptr));
+	if (!lease)
 		return false;
-	}
 
-	AtScopeExit(emu) { gme_delete(emu); };
-
-	return ScanMusicEmu(emu, container.track, handler);
+	return ScanMusicEmu(path_fs, lease.get(), container.track, handler);
 }
 
 static std::forward_list<DetachedSong>
@@ -293,12 +518,11 @@ gme_container_scan(Path path_fs)
 	std::forward_list<DetachedSong> list;
 	const auto container = ParseContainerPath(path_fs);
 
-	Music_Emu *emu = LoadGmeAndM3u(container);
-	if(emu == nullptr) {
+	const auto lease = LoadGmeAndM3u(container, GetGmeSampleRate(nullptr));
+	if (!lease)
 		return list;
-	}
 
-	AtScopeExit(emu) { gme_delete(emu); };
+	Music_Emu *const emu = lease.get();
 
 	const unsigned num_songs = gme_track_count(emu);
 	/* if it only contains a single tune, don't treat as container */
@@ -311,11 +535,12 @@ gme_container_scan(Path path_fs)
 
 	auto tail = list.before_begin();
 	for (unsigned i = 0; i < num_songs; ++i) {
-		AddTagHandler h(tag_builder);
-		ScanMusicEmu(emu, i, h);
-
 		auto track_name = fmt::format(SUBTUNE_PREFIX "{:03}.{}",
 					      i + 1, subtune_suffix);
+
+		AddTagHandler h(tag_builder);
+		ScanMusicEmu(AllocatedPath::Build(path_fs, track_name),
+			     emu, i, h);
 		tail = list.emplace_after(tail, std::move(track_name),
 					  tag_builder.Commit());
 	}
@@ -323,6 +548,24 @@ gme_container_scan(Path path_fs)
 	return list;
 }
 
+static void
+gme_prefetch(Path path_fs, AudioFormat preferred_format) noexcept
+try {
+	const auto container = ParseContainerPath(path_fs);
+
+	unsigned sample_rate = gme_sample_rate;
+	if (sample_rate == 0)
+		sample_rate = preferred_format.sample_rate != 0
+			? preferred_format.sample_rate
+			: GME_DEFAULT_SAMPLE_RATE;
+
+	/* the lease destructor puts the emulator into
+	   gme_emu_cache, where gme_file_decode() will find it */
+	LoadGmeAndM3u(container, sample_rate);
+} catch (...) {
+	/* ignore; gme_file_decode() will report the error */
+}
+
 static constexpr const char *gme_suffixes[] = {
 	"ay", "gbs", "gym", "hes", "kss", "nsf",
 	"nsfe", "rsn", "sap", "spc", "vgm", "vgz",
@@ -331,6 +574,7 @@ static constexpr const char *gme_suffixes[] = {
 
 constexpr DecoderPlugin gme_decoder_plugin =
 	DecoderPlugin("gme", gme_file_decode, gme_scan_file)
-	.WithInit(gme_plugin_init)
+	.WithInit(gme_plugin_init, gme_plugin_finish)
 	.WithContainer(gme_container_scan)
+	.WithPrefetch(gme_prefetch)
 	.WithSuffixes(gme_suffixes);
@@ -2,7 +2,11 @@
 // Copyright The Music Player Daemon Project
 
 #include "LazygsfDecoderPlugin.hxx"
+#include "PsfLoader.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
+#include "../EmuSeek.hxx"
+#include "../EmuSilence.hxx"
 #include "Log.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -13,14 +17,6 @@
 
 extern "C" {
 #if defined(__has_include)
-#if __has_include(<psflib/psflib.h>)
-#include <psflib/psflib.h>
-#elif __has_include(<psflib.h>)
-#include <psflib.h>
-#else
-#include <psflib/psflib.h>
-#endif
-
 #if __has_include(<lazygsf/lazygsf.h>)
 #include <lazygsf/lazygsf.h>
 #elif __has_include(<lazygsf.h>)
@@ -29,7 +25,6 @@ extern "C" {
 #include <lazygsf/lazygsf.h>
 #endif
 #else
-#include <psflib/psflib.h>
 #include <lazygsf/lazygsf.h>
 #endif
 }
@@ -37,7 +32,6 @@ extern "C" {
 #include <algorithm>
 #include <climits>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <span>
@@ -53,8 +47,17 @@ static constexpr unsigned GSF_BUFFER_FRAMES = 2048;
 static constexpr unsigned GSF_SEEK_CHUNK_FRAMES = 8192;
 
 static bool gsf_initialized = false;
+/**
+ * The configured sample rate; 0 means "auto" (see
+ * GetEmuSampleRate()).
+ */
 static unsigned configured_sample_rate = GSF_SAMPLE_RATE_DEFAULT;
 
+/**
+ * End songs without a "length" tag at silence.
+ */
+static EmuSilenceConfig silence_config;
+
 struct GsfTagHolder {
 	unsigned length_ms = 0;
 	unsigned fade_ms = 0;
@@ -165,50 +168,6 @@ ParsePsfTimeMS(const char *ts) noexcept
 	}
 }
 
-static void *
-Gsf_fopen(void *, const char *path)
-{
-	return std::fopen(path, "rb");
-}
-
-static size_t
-Gsf_fread(void *buffer, size_t size, size_t count, void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fread(buffer, size, count, f);
-}
-
-static int
-Gsf_fseek(void *handle, int64_t offset, int whence)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fseek(f, static_cast<long>(offset), whence);
-}
-
-static int
-Gsf_fclose(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fclose(f);
-}
-
-static long
-Gsf_ftell(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::ftell(f);
-}
-
-static const psf_file_callbacks gsf_psf_callbacks = {
-	"\\/",
-	nullptr,
-	Gsf_fopen,
-	Gsf_fread,
-	Gsf_fseek,
-	Gsf_fclose,
-	Gsf_ftell,
-};
-
 static int
 GsfLoader(void *context, const uint8_t *exe, size_t exe_size,
 	  const uint8_t *, size_t) noexcept
@@ -291,10 +250,9 @@ gsf_plugin_init(const ConfigBlock &block)
 		gsf_initialized = true;
 	}
 
-	configured_sample_rate = block.GetBlockValue("sample_rate",
-		GSF_SAMPLE_RATE_DEFAULT);
-	if (configured_sample_rate == 0)
-		configured_sample_rate = GSF_SAMPLE_RATE_DEFAULT;
+	configured_sample_rate = ParseEmuSampleRate(block,
+						    GSF_SAMPLE_RATE_DEFAULT);
+	silence_config = ParseEmuSilenceConfig(block);
 
 	return true;
 }
@@ -304,22 +262,14 @@ GsfLoadFile(Path path_fs, GsfTagHolder &holder,
 	    gsf_state_t *state) noexcept
 {
 	holder.Reset();
-	const std::string path_utf8 = path_fs.ToUTF8();
 
-	const int rc = psf_load(path_utf8.c_str(), &gsf_psf_callbacks, 0x22,
-				state != nullptr ? GsfLoader : nullptr, state,
-				GsfInfo, &holder, 1, nullptr, nullptr);
-	if (rc < 0) {
-		LogWarning(gsf_domain, "error loading file");
+	try {
+		PsfLoad(path_fs, 0x22, GsfLoader, state, GsfInfo, &holder);
+	} catch (...) {
+		LogError(std::current_exception(), "error loading file");
 		return false;
 	}
 
-	if (holder.handler != nullptr && holder.handler->WantDuration() &&
-	    holder.length_ms > 0) {
-		holder.handler->OnDuration(
-			SongTime::FromMS(holder.length_ms + holder.fade_ms));
-	}
-
 	return true;
 }
 
@@ -329,7 +279,24 @@ gsf_scan_file(Path path_fs, TagHandler &handler) noexcept
 	GsfTagHolder holder;
 	holder.handler = &handler;
 
-	return GsfLoadFile(path_fs, holder, nullptr);
+	/* only the tags are needed; don't boot the emulator */
+	try {
+		PsfScan(path_fs, 0x22, GsfInfo, &holder);
+	} catch (...) {
+		LogError(std::current_exception(), "error loading file");
+		return false;
+	}
+
+	if (handler.WantDuration()) {
+		if (holder.length_ms > 0)
+			handler.OnDuration(SongTime::FromMS(holder.length_ms +
+							    holder.fade_ms));
+		else if (const auto detected = LookupEmuLength(path_fs);
+			 !detected.IsNegative())
+			handler.OnDuration(SongTime{detected});
+	}
+
+	return true;
 }
 
 [[gnu::pure]]
@@ -375,19 +342,33 @@ ApplyFade(int16_t *samples, size_t frames, unsigned channels,
 	}
 }
 
-static bool
-SkipFrames(gsf_state_t *state, int64_t frames) noexcept
-{
-	while (frames > 0) {
-		const size_t chunk = static_cast<size_t>(std::min<int64_t>(
-			frames, GSF_SEEK_CHUNK_FRAMES));
-		if (gsf_render(state, nullptr, chunk) != 0)
-			return false;
-		frames -= static_cast<int64_t>(chunk);
+/**
+ * lazygsf keeps the GBA core in internal allocations which its API
+ * cannot save, so there are no snapshots; seeking backward restarts
+ * the song.
+ */
+class GsfSeekHandler final : public EmuSeekHandler {
+	gsf_state_t *const state;
+
+public:
+	explicit GsfSeekHandler(gsf_state_t *_state) noexcept
+		:state(_state) {}
+
+	/* virtual methods from class EmuSeekHandler */
+	bool EmuRestart() noexcept override {
+		gsf_restart(state);
+		return true;
 	}
 
-	return true;
-}
+	uint64_t EmuSkip(uint64_t max_frames) noexcept override {
+		const std::size_t n = std::min<uint64_t>(max_frames,
+							 GSF_SEEK_CHUNK_FRAMES);
+		if (gsf_render(state, nullptr, n) != 0)
+			return 0;
+
+		return n;
+	}
+};
 
 static void
 gsf_file_decode(DecoderClient &client, Path path_fs)
@@ -408,18 +389,31 @@ gsf_file_decode(DecoderClient &client, Path path_fs)
 		return;
 
 	const unsigned sample_rate = gsf_set_sample_rate(state.get(),
-		configured_sample_rate);
+		GetEmuSampleRate(&client, configured_sample_rate,
+				 GSF_SAMPLE_RATE_DEFAULT));
+
+	/* without a "length" tag, use the length detected by an
+	   earlier playback, or look for silence */
+	unsigned length_ms = holder.length_ms, fade_ms = holder.fade_ms;
+	if (length_ms == 0) {
+		if (const auto detected = LookupEmuLength(path_fs);
+		    !detected.IsNegative()) {
+			length_ms = detected.ToMS();
+			fade_ms = 0;
+		}
+	}
 
-	const bool has_length = holder.length_ms > 0;
+	const bool has_length = length_ms > 0;
+	const bool detect_silence = !has_length && silence_config.IsEnabled();
 	const int64_t length_frames = has_length
-		? static_cast<int64_t>(holder.length_ms) *
+		? static_cast<int64_t>(length_ms) *
 			sample_rate / 1000
 		: 0;
-	const int64_t fade_total = static_cast<int64_t>(holder.fade_ms) *
+	const int64_t fade_total = static_cast<int64_t>(fade_ms) *
 		sample_rate / 1000;
 
 	const SignedSongTime song_len = has_length
-		? SignedSongTime::FromMS(holder.length_ms + holder.fade_ms)
+		? SignedSongTime::FromMS(length_ms + fade_ms)
 		: SignedSongTime::Negative();
 
 	const auto audio_format = CheckAudioFormat(sample_rate,
@@ -430,6 +424,11 @@ gsf_file_decode(DecoderClient &client, Path path_fs)
 	DecoderCommand cmd = DecoderCommand::NONE;
 	int16_t buf[GSF_BUFFER_FRAMES * GSF_CHANNELS];
 
+	GsfSeekHandler seek_handler(state.get());
+	EmuSeeker seeker(seek_handler, sample_rate);
+
+	EmuSilenceDetector silence(silence_config, sample_rate, GSF_CHANNELS);
+
 	int64_t song_remaining = length_frames;
 	int64_t fade_remaining = fade_total;
 
@@ -439,6 +438,8 @@ gsf_file_decode(DecoderClient &client, Path path_fs)
 			return;
 		}
 
+		seeker.Advance(GSF_BUFFER_FRAMES);
+
 		if (has_length) {
 			const int64_t remaining_before = song_remaining;
 
@@ -462,42 +463,27 @@ gsf_file_decode(DecoderClient &client, Path path_fs)
 		if (has_length && song_remaining <= 0 && fade_remaining <= 0)
 			break;
 
+		if (detect_silence && silence.Feed(buf)) {
+			SubmitEmuLength(client, path_fs, silence.GetLength());
+			break;
+		}
+
 		if (cmd == DecoderCommand::SEEK) {
-			const int64_t seek_ms = client.GetSeekTime().ToMS();
-			const int64_t seek_frames = seek_ms * sample_rate / 1000;
+			if (!seeker.Seek(client)) {
+				LogWarning(gsf_domain, "seek failed");
+				return;
+			}
 
-			gsf_restart(state.get());
-			song_remaining = length_frames;
-			fade_remaining = fade_total;
+			const auto position =
+				static_cast<int64_t>(seeker.GetPosition());
+			silence.Reset(position);
 
 			if (has_length) {
-				const int64_t target_remaining = length_frames - seek_frames;
-				const int64_t to_skip =
-					std::max<int64_t>(song_remaining - target_remaining, 0);
-
-				if (!SkipFrames(state.get(), to_skip)) {
-					LogWarning(gsf_domain, "seek failed");
-					return;
-				}
-
-				if (song_remaining > 0) {
-					const int64_t skipped_in_body =
-						std::min<int64_t>(to_skip, song_remaining);
-					song_remaining -= skipped_in_body;
-				}
-
-				if (target_remaining < 0) {
-					fade_remaining = std::max<int64_t>(fade_total + target_remaining, 0);
-					song_remaining = 0;
-				}
-			} else {
-				if (!SkipFrames(state.get(), seek_frames)) {
-					LogWarning(gsf_domain, "seek failed");
-					return;
-				}
+				song_remaining = std::max<int64_t>(length_frames - position, 0);
+				fade_remaining = position > length_frames
+					? std::max<int64_t>(fade_total - (position - length_frames), 0)
+					: fade_total;
 			}
-
-			client.CommandFinished();
 		}
 	} while (cmd != DecoderCommand::STOP);
 }
@@ -511,4 +497,5 @@ static const char *const gsf_suffixes[] = {
 constexpr DecoderPlugin gsf_decoder_plugin =
 	DecoderPlugin("lazygsf", gsf_file_decode, gsf_scan_file)
 	.WithInit(gsf_plugin_init)
+	.WithPrefetch(PsfPrefetch)
 	.WithSuffixes(gsf_suffixes);
@@ -2,7 +2,11 @@
 // Copyright The Music Player Daemon Project
 
 #include "LazyusfDecoderPlugin.hxx"
+#include "PsfLoader.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
+#include "../EmuSeek.hxx"
+#include "../EmuSilence.hxx"
 #include "Log.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -13,14 +17,6 @@
 
 extern "C" {
 #if defined(__has_include)
-#if __has_include(<psflib/psflib.h>)
-#include <psflib/psflib.h>
-#elif __has_include(<psflib.h>)
-#include <psflib.h>
-#else
-#include <psflib/psflib.h>
-#endif
-
 #if __has_include(<lazyusf/usf.h>)
 #include <lazyusf/usf.h>
 #elif __has_include(<usf.h>)
@@ -29,7 +25,6 @@ extern "C" {
 #include <lazyusf/usf.h>
 #endif
 #else
-#include <psflib/psflib.h>
 #include <lazyusf/usf.h>
 #endif
 }
@@ -37,7 +32,6 @@ extern "C" {
 #include <algorithm>
 #include <climits>
 #include <cstdint>
-#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <span>
@@ -56,10 +50,19 @@ static constexpr unsigned LAZYUSF_SEEK_CHUNK_FRAMES = 8192;
 static constexpr unsigned LAZYUSF_SEEK_CHUNK_SAMPLES =
 	LAZYUSF_SEEK_CHUNK_FRAMES * LAZYUSF_CHANNELS;
 
-static constexpr char lazyusf_separators[] = "\\/:|";
-
 static bool enable_hle = true;
-static int32_t configured_sample_rate = 0;
+
+/**
+ * The configured sample rate; 0 means "auto" (see
+ * GetEmuSampleRate()), EMU_NATIVE_SAMPLE_RATE renders without
+ * resampling.
+ */
+static unsigned configured_sample_rate = EMU_NATIVE_SAMPLE_RATE;
+
+/**
+ * End songs without a "length" tag at silence.
+ */
+static EmuSilenceConfig silence_config;
 
 struct LazyUSFTagHolder {
 	unsigned length_ms = 0;
@@ -184,52 +187,6 @@ ParseUSFTimeMS(const char *ts) noexcept
 	}
 }
 
-static void *
-LazyUSF_fopen(void *, const char *path)
-{
-	return std::fopen(path, "rb");
-}
-
-static size_t
-LazyUSF_fread(void *buffer, size_t size, size_t count, void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fread(buffer, size, count, f);
-}
-
-static int
-LazyUSF_fseek(void *handle, int64_t offset, int whence)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	if (offset > LONG_MAX || offset < LONG_MIN)
-		return -1;
-	return std::fseek(f, static_cast<long>(offset), whence);
-}
-
-static int
-LazyUSF_fclose(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fclose(f);
-}
-
-static long
-LazyUSF_ftell(void *handle)
-{
-	FILE *f = static_cast<FILE *>(handle);
-	return std::ftell(f);
-}
-
-static psf_file_callbacks LazyUSF_psf_callbacks = {
-	lazyusf_separators,
-	nullptr,
-	LazyUSF_fopen,
-	LazyUSF_fread,
-	LazyUSF_fseek,
-	LazyUSF_fclose,
-	LazyUSF_ftell,
-};
-
 static int
 LazyUSF_TagHandler(void *context, const char *name, const char *value)
 {
@@ -292,13 +249,12 @@ LazyUSF_openfile(usf_state_t *usf, Path path_fs, LazyUSFTagHolder &holder)
 	usf_clear(usf);
 	holder.Reset();
 
-	const std::string path_utf8 = path_fs.ToUTF8();
-	if (psf_load(path_utf8.c_str(),
-		     &LazyUSF_psf_callbacks, 0x21,
-		     LazyUSF_Loader, usf,
-		     LazyUSF_TagHandler, &holder, 1,
-		     nullptr, nullptr) < 0) {
-		LogWarning(lazyusf_domain, "error loading file");
+	try {
+		PsfLoad(path_fs, 0x21,
+			LazyUSF_Loader, usf,
+			LazyUSF_TagHandler, &holder);
+	} catch (...) {
+		LogError(std::current_exception(), "error loading file");
 		return false;
 	}
 
@@ -306,13 +262,6 @@ LazyUSF_openfile(usf_state_t *usf, Path path_fs, LazyUSFTagHolder &holder)
 	usf_set_fifo_full(usf, holder.enable_fifo_full);
 	usf_set_hle_audio(usf, enable_hle);
 
-	if (holder.handler != nullptr && holder.handler->WantDuration()) {
-		const unsigned duration_ms = holder.length_ms > 0
-			? holder.length_ms + holder.fade_ms
-			: LAZYUSF_DEFAULT_LENGTH_MS;
-		holder.handler->OnDuration(SongTime::FromMS(duration_ms));
-	}
-
 	return true;
 }
 
@@ -360,9 +309,9 @@ static bool
 lazyusf_plugin_init(const ConfigBlock &block)
 {
 	enable_hle = block.GetBlockValue("hle", true);
-	configured_sample_rate = block.GetBlockValue("sample_rate", 0);
-	if (configured_sample_rate < 0)
-		configured_sample_rate = 0;
+	configured_sample_rate = ParseEmuSampleRate(block,
+						    EMU_NATIVE_SAMPLE_RATE);
+	silence_config = ParseEmuSilenceConfig(block);
 	return true;
 }
 
@@ -372,39 +321,69 @@ lazyusf_scan_file(Path path_fs, TagHandler &handler) noexcept
 	LazyUSFTagHolder holder;
 	holder.handler = &handler;
 
-	UsfState usf;
-	if (!usf) {
-		LogWarning(lazyusf_domain, "out of memory");
+	/* only the tags are needed; don't boot the emulator */
+	try {
+		PsfScan(path_fs, 0x21, LazyUSF_TagHandler, &holder);
+	} catch (...) {
+		LogError(std::current_exception(), "error loading file");
 		return false;
 	}
 
-	return LazyUSF_openfile(usf.get(), path_fs, holder);
+	if (handler.WantDuration()) {
+		if (holder.length_ms > 0)
+			handler.OnDuration(SongTime::FromMS(holder.length_ms +
+							    holder.fade_ms));
+		else if (const auto detected = LookupEmuLength(path_fs);
+			 !detected.IsNegative())
+			handler.OnDuration(SongTime{detected});
+		else
+			handler.OnDuration(SongTime::FromMS(LAZYUSF_DEFAULT_LENGTH_MS));
+	}
+
+	return true;
 }
 
 /**
- * Skip forward by "frames" frames by rendering and discarding output.
- * For resample=true, a scratch buffer is required.
+ * lazyusf keeps the emulated memory in internal allocations which
+ * its API cannot save, so there are no snapshots; seeking backward
+ * restarts the song.
  */
-static bool
-SkipFrames(usf_state_t *usf, bool resample, int32_t &rate,
-	   int64_t frames, int16_t *scratch, size_t scratch_frames) noexcept
-{
-	while (frames > 0) {
-		const int64_t chunk = std::min<int64_t>(frames, static_cast<int64_t>(scratch_frames));
+class UsfSeekHandler final : public EmuSeekHandler {
+	usf_state_t *const usf;
+	const bool resample;
+	int32_t &rate;
+
+	/**
+	 * A scratch buffer for resample=true; usf_render() may
+	 * discard the output.
+	 */
+	int16_t buffer[LAZYUSF_SEEK_CHUNK_SAMPLES];
+
+public:
+	UsfSeekHandler(usf_state_t *_usf, bool _resample,
+		       int32_t &_rate) noexcept
+		:usf(_usf), resample(_resample), rate(_rate) {}
+
+	/* virtual methods from class EmuSeekHandler */
+	bool EmuRestart() noexcept override {
+		usf_restart(usf);
+		return true;
+	}
+
+	uint64_t EmuSkip(uint64_t max_frames) noexcept override {
+		const std::size_t n = std::min<uint64_t>(max_frames,
+							 LAZYUSF_SEEK_CHUNK_FRAMES);
 		const char *err = Render(usf, resample,
-					 resample ? scratch : nullptr,
-					 static_cast<size_t>(chunk),
-					 rate);
+					 resample ? buffer : nullptr,
+					 n, rate);
 		if (err != nullptr) {
 			LogWarning(lazyusf_domain, err);
-			return false;
+			return 0;
 		}
 
-		frames -= chunk;
+		return n;
 	}
-
-	return true;
-}
+};
 
 static void
 lazyusf_file_decode(DecoderClient &client, Path path_fs)
@@ -420,7 +399,10 @@ lazyusf_file_decode(DecoderClient &client, Path path_fs)
 	if (!LazyUSF_openfile(usf.get(), path_fs, holder))
 		return;
 
-	int32_t render_rate = configured_sample_rate;
+	/* 0 (the native rate) if "auto" was configured and the
+	   outputs' sample rate is not known */
+	int32_t render_rate = GetEmuSampleRate(&client,
+					       configured_sample_rate, 0);
 	const bool resample = render_rate > 0;
 	const char *usf_err = nullptr;
 
@@ -438,98 +420,122 @@ lazyusf_file_decode(DecoderClient &client, Path path_fs)
 		return;
 	}
 
-	const bool has_metadata_length = holder.length_ms > 0;
-	const unsigned effective_length_ms = has_metadata_length
-		? holder.length_ms
-		: LAZYUSF_DEFAULT_LENGTH_MS;
+	/* without a "length" tag, use the length detected by an
+	   earlier playback, or play the default length while
+	   looking for silence */
+	unsigned effective_length_ms = holder.length_ms;
+	unsigned fade_ms = holder.fade_ms;
+	bool detect_silence = false;
+	if (effective_length_ms == 0) {
+		if (const auto detected = LookupEmuLength(path_fs);
+		    !detected.IsNegative()) {
+			effective_length_ms = detected.ToMS();
+			fade_ms = 0;
+		} else {
+			effective_length_ms = LAZYUSF_DEFAULT_LENGTH_MS;
+			detect_silence = silence_config.IsEnabled();
+		}
+	}
+
 	const bool has_effective_length = effective_length_ms > 0;
 	const int64_t length_frames =
 		static_cast<int64_t>(effective_length_ms) * render_rate / 1000;
-	const int64_t fade_total = static_cast<int64_t>(holder.fade_ms) *
+	const int64_t fade_total = static_cast<int64_t>(fade_ms) *
 		render_rate / 1000;
 
 	const SignedSongTime song_len = SignedSongTime::FromMS(
-		static_cast<int64_t>(effective_length_ms) + holder.fade_ms);
+		static_cast<int64_t>(effective_length_ms) + fade_ms);
 
 	const auto audio_format = CheckAudioFormat(render_rate,
 		SampleFormat::S16, LAZYUSF_CHANNELS);
 
 	client.Ready(audio_format, true, song_len);
 
+	UsfSeekHandler seek_handler(usf.get(), resample, render_rate);
+	EmuSeeker seeker(seek_handler, render_rate);
+
+	EmuSilenceDetector silence(silence_config, render_rate,
+				   LAZYUSF_CHANNELS);
+
 	DecoderCommand cmd = DecoderCommand::NONE;
-	int16_t buf[LAZYUSF_BUFFER_SAMPLES];
-	int16_t seek_buf[LAZYUSF_SEEK_CHUNK_SAMPLES];
 
 	int64_t song_remaining = length_frames;
 	int64_t fade_remaining = fade_total;
 
 	do {
+		/* render directly into the MusicChunk if possible */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
+		int16_t local_buffer[LAZYUSF_BUFFER_SAMPLES];
+		int16_t *const buf = raw.empty()
+			? local_buffer
+			: reinterpret_cast<int16_t *>(raw.data());
+		const int64_t n_frames = raw.empty()
+			? LAZYUSF_BUFFER_FRAMES
+			: std::min<int64_t>(raw.size() / (LAZYUSF_CHANNELS * sizeof(int16_t)),
+					    LAZYUSF_BUFFER_FRAMES);
+
 		usf_err = Render(usf.get(), resample, buf,
-				 LAZYUSF_BUFFER_FRAMES, render_rate);
+				 n_frames, render_rate);
 		if (usf_err != nullptr) {
 			LogWarning(lazyusf_domain, usf_err);
 			return;
 		}
 
+		seeker.Advance(n_frames);
+
+		/* check for silence before fading */
+		const bool silence_end = detect_silence &&
+			silence.Feed({buf, static_cast<std::size_t>(n_frames * LAZYUSF_CHANNELS)});
+
 		if (has_effective_length) {
 			const int64_t remaining_before = song_remaining;
 
 			if (song_remaining > 0)
-				song_remaining -= LAZYUSF_BUFFER_FRAMES;
+				song_remaining -= n_frames;
 
 			/* Apply fade once we reach/overrun the end of the song body. */
-			if (remaining_before <= LAZYUSF_BUFFER_FRAMES) {
+			if (remaining_before <= n_frames) {
 				const int64_t fade_start =
 					std::max<int64_t>(remaining_before, 0);
-				ApplyFade(buf, LAZYUSF_BUFFER_FRAMES, LAZYUSF_CHANNELS,
+				ApplyFade(buf, n_frames, LAZYUSF_CHANNELS,
 					  fade_start, fade_remaining, fade_total);
 
-				fade_remaining -= (LAZYUSF_BUFFER_FRAMES - fade_start);
+				fade_remaining -= (n_frames - fade_start);
 				if (fade_remaining < 0)
 					fade_remaining = 0;
 			}
 		}
 
-		cmd = client.SubmitAudio(nullptr, std::span{buf}, 0);
+		const std::size_t n_bytes =
+			n_frames * LAZYUSF_CHANNELS * sizeof(int16_t);
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr,
+					     std::span{local_buffer}.first(n_frames * LAZYUSF_CHANNELS), 0)
+			: client.CommitAudio(n_bytes);
 
 		if (song_remaining <= 0 && fade_remaining <= 0)
 			break;
 
-		if (cmd == DecoderCommand::SEEK) {
-			const int64_t seek_ms = client.GetSeekTime().ToMS();
-			const int64_t seek_frames = seek_ms * render_rate / 1000;
-
-			usf_restart(usf.get());
-			song_remaining = length_frames;
-			fade_remaining = fade_total;
-
-		if (has_effective_length) {
-				/* We keep original semantics: seek can extend into fade. */
-				const int64_t target_remaining = length_frames - seek_frames;
-
-				/* Skip up to the target position (into or past the body). */
-				const int64_t to_skip = std::max<int64_t>(song_remaining - target_remaining, 0);
-				if (!SkipFrames(usf.get(), resample, render_rate, to_skip,
-						seek_buf, LAZYUSF_SEEK_CHUNK_FRAMES))
-					return;
-
-				/* Update remaining counters similarly to the original loop. */
-				if (song_remaining > 0) {
-					const int64_t skipped_in_body = std::min<int64_t>(to_skip, song_remaining);
-					song_remaining -= skipped_in_body;
-				}
+		if (silence_end) {
+			SubmitEmuLength(client, path_fs, silence.GetLength());
+			break;
+		}
 
-				if (target_remaining < 0) {
-					fade_remaining = std::max<int64_t>(fade_total + target_remaining, 0);
-					song_remaining = 0;
-				}
-			} else {
-				if (!SkipFrames(usf.get(), resample, render_rate, seek_frames,
-						seek_buf, LAZYUSF_SEEK_CHUNK_FRAMES))
-					return;
+		if (cmd == DecoderCommand::SEEK) {
+			if (!seeker.Seek(client))
+				return;
+
+			const auto position =
+				static_cast<int64_t>(seeker.GetPosition());
+			silence.Reset(position);
+
+			if (has_effective_length) {
+				/* seek can extend into the fade */
+				song_remaining = std::max<int64_t>(length_frames - position, 0);
+				fade_remaining = position > length_frames
+					? std::max<int64_t>(fade_total - (position - length_frames), 0)
+					: fade_total;
 			}
-
-			client.CommandFinished();
 		}
 	} while (cmd != DecoderCommand::STOP);
 }
@@ -542,4 +548,5 @@ static const char *const lazyusf_suffixes[] = {
 constexpr DecoderPlugin lazyusf_decoder_plugin =
 	DecoderPlugin("lazyusf", lazyusf_file_decode, lazyusf_scan_file)
 	.WithInit(lazyusf_plugin_init)
+	.WithPrefetch(PsfPrefetch)
 	.WithSuffixes(lazyusf_suffixes);
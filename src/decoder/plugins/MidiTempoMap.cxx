@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MidiTempoMap.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/**
+ * The default tempo (120 BPM) [microseconds per quarter note].
+ */
+static constexpr unsigned DEFAULT_TEMPO = 500000;
+
+struct TempoChange {
+	uint_least64_t tick;
+	unsigned tempo;
+};
+
+class SmfReader {
+	std::span<const std::byte> src;
+
+public:
+	explicit constexpr SmfReader(std::span<const std::byte> _src) noexcept
+		:src(_src) {}
+
+	bool empty() const noexcept {
+		return src.empty();
+	}
+
+	uint8_t ReadByte() {
+		if (src.empty())
+			throw std::runtime_error{"Truncated MIDI file"};
+
+		const auto value = static_cast<uint8_t>(src.front());
+		src = src.subspan(1);
+		return value;
+	}
+
+	uint_least32_t ReadBE(std::size_t n) {
+		uint_least32_t value = 0;
+		while (n-- > 0)
+			value = (value << 8) | ReadByte();
+		return value;
+	}
+
+	/**
+	 * Read a MIDI "variable length quantity".
+	 */
+	uint_least32_t ReadVariable() {
+		uint_least32_t value = 0;
+		for (unsigned i = 0; i < 4; ++i) {
+			const uint8_t b = ReadByte();
+			value = (value << 7) | (b & 0x7f);
+			if ((b & 0x80) == 0)
+				return value;
+		}
+
+		throw std::runtime_error{"Malformed MIDI variable length value"};
+	}
+
+	std::span<const std::byte> ReadSpan(std::size_t n) {
+		if (n > src.size())
+			throw std::runtime_error{"Truncated MIDI file"};
+
+		const auto result = src.first(n);
+		src = src.subspan(n);
+		return result;
+	}
+
+	void Skip(std::size_t n) {
+		ReadSpan(n);
+	}
+
+	bool ReadChunk(uint_least32_t &id, SmfReader &chunk) {
+		if (src.size() < 8)
+			return false;
+
+		id = ReadBE(4);
+		const auto size = ReadBE(4);
+		chunk = SmfReader{ReadSpan(std::min<std::size_t>(size, src.size()))};
+		return true;
+	}
+};
+
+static constexpr uint_least32_t
+MakeChunkId(const char (&s)[5]) noexcept
+{
+	return (uint_least32_t(uint8_t(s[0])) << 24) |
+		(uint_least32_t(uint8_t(s[1])) << 16) |
+		(uint_least32_t(uint8_t(s[2])) << 8) |
+		uint_least32_t(uint8_t(s[3]));
+}
+
+/**
+ * Walk all events of one track, collecting tempo changes.
+ *
+ * @return the tick of the last event
+ */
+static uint_least64_t
+ParseTrack(SmfReader track, std::vector<TempoChange> &tempo_changes)
+{
+	uint_least64_t tick = 0;
+	uint8_t running_status = 0;
+
+	while (!track.empty()) {
+		tick += track.ReadVariable();
+
+		uint8_t status = track.ReadByte();
+		if (status < 0x80) {
+			/* running status: this is the first data
+			   byte */
+			if (running_status == 0)
+				throw std::runtime_error{"Malformed MIDI track"};
+
+			status = running_status;
+			switch (status >> 4) {
+			case 0xc:
+			case 0xd:
+				break;
+
+			default:
+				track.Skip(1);
+				break;
+			}
+
+			continue;
+		}
+
+		if (status == 0xff) {
+			/* meta event */
+			const uint8_t type = track.ReadByte();
+			const auto length = track.ReadVariable();
+			auto data = SmfReader{track.ReadSpan(length)};
+
+			if (type == 0x2f)
+				/* end of track */
+				break;
+
+			if (type == 0x51 && length == 3)
+				tempo_changes.push_back({tick, data.ReadBE(3)});
+
+			continue;
+		}
+
+		if (status == 0xf0 || status == 0xf7) {
+			/* sysex */
+			track.Skip(track.ReadVariable());
+			continue;
+		}
+
+		if (status >= 0xf0)
+			/* system common/realtime messages are not allowed
+			   in MIDI files; don't know their length */
+			throw std::runtime_error{"Malformed MIDI track"};
+
+		running_status = status;
+
+		switch (status >> 4) {
+		case 0xc:
+		case 0xd:
+			track.Skip(1);
+			break;
+
+		default:
+			track.Skip(2);
+			break;
+		}
+	}
+
+	return tick;
+}
+
+} // anonymous namespace
+
+MidiTempoMap::MidiTempoMap(std::span<const std::byte> smf)
+{
+	SmfReader file{smf};
+
+	uint_least32_t id;
+	SmfReader header{{}};
+	if (!file.ReadChunk(id, header) || id != MakeChunkId("MThd"))
+		throw std::runtime_error{"Not a MIDI file"};
+
+	[[maybe_unused]] const auto format = header.ReadBE(2);
+	[[maybe_unused]] const auto n_tracks = header.ReadBE(2);
+	const auto division = header.ReadBE(2);
+	if (division == 0)
+		throw std::runtime_error{"Malformed MIDI header"};
+
+	std::vector<TempoChange> tempo_changes;
+
+	SmfReader chunk{{}};
+	while (file.ReadChunk(id, chunk))
+		if (id == MakeChunkId("MTrk"))
+			end_tick = std::max(end_tick,
+					    ParseTrack(chunk, tempo_changes));
+
+	if (division & 0x8000) {
+		/* SMPTE: the tempo is constant */
+		const int fps = -int8_t(division >> 8);
+		const unsigned ticks_per_frame = division & 0xff;
+		if (fps <= 0 || ticks_per_frame == 0)
+			throw std::runtime_error{"Malformed MIDI header"};
+
+		points.push_back({0, 0, 1.0 / (fps * ticks_per_frame)});
+		return;
+	}
+
+	/* tempo changes in format 1 files may be in any track */
+	std::stable_sort(tempo_changes.begin(), tempo_changes.end(),
+			 [](const auto &a, const auto &b){
+				 return a.tick < b.tick;
+			 });
+
+	const double ticks_per_quarter = division;
+	auto tick_duration = [ticks_per_quarter](unsigned tempo){
+		return tempo / 1e6 / ticks_per_quarter;
+	};
+
+	points.push_back({0, 0, tick_duration(DEFAULT_TEMPO)});
+
+	for (const auto &i : tempo_changes) {
+		auto &last = points.back();
+		if (i.tick == last.tick) {
+			/* replaces the previous tempo */
+			last.tick_duration = tick_duration(i.tempo);
+			continue;
+		}
+
+		points.push_back({
+			i.tick,
+			last.time + (i.tick - last.tick) * last.tick_duration,
+			tick_duration(i.tempo),
+		});
+	}
+}
+
+double
+MidiTempoMap::TickToTime(uint_least64_t tick) const noexcept
+{
+	auto i = std::upper_bound(points.begin(), points.end(), tick,
+				  [](uint_least64_t t, const Point &p){
+					  return t < p.tick;
+				  });
+	/* the first point is at tick 0 */
+	--i;
+
+	return i->time + (tick - i->tick) * i->tick_duration;
+}
+
+uint_least64_t
+MidiTempoMap::TimeToTick(double time) const noexcept
+{
+	if (time <= 0)
+		return 0;
+
+	auto i = std::upper_bound(points.begin(), points.end(), time,
+				  [](double t, const Point &p){
+					  return t < p.time;
+				  });
+	--i;
+
+	return i->tick + uint_least64_t((time - i->time) / i->tick_duration);
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * The tempo map of a Standard MIDI File, which converts between
+ * song time and sequencer ticks without synthesizing the song.
+ */
+class MidiTempoMap {
+	struct Point {
+		/**
+		 * The tick where this tempo begins.
+		 */
+		uint_least64_t tick;
+
+		/**
+		 * The song time at #tick [s].
+		 */
+		double time;
+
+		/**
+		 * The duration of one tick with this tempo [s].
+		 */
+		double tick_duration;
+	};
+
+	/**
+	 * Sorted by tick; the first point is always at tick 0.
+	 */
+	std::vector<Point> points;
+
+	/**
+	 * The tick of the last "end of track" event of all tracks.
+	 */
+	uint_least64_t end_tick = 0;
+
+public:
+	/**
+	 * Parse the given Standard MIDI File.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	explicit MidiTempoMap(std::span<const std::byte> smf);
+
+	/**
+	 * @return the duration of the song [s]
+	 */
+	[[gnu::pure]]
+	double GetDuration() const noexcept {
+		return TickToTime(end_tick);
+	}
+
+	[[gnu::pure]]
+	double TickToTime(uint_least64_t tick) const noexcept;
+
+	[[gnu::pure]]
+	uint_least64_t TimeToTick(double time) const noexcept;
+};
@@ -4,11 +4,13 @@
 #include "config.h"
 #include "MikmodDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "tag/Handler.hxx"
 #include "fs/NarrowPath.hxx"
 #include "fs/Path.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 #include "Version.h"
@@ -16,12 +18,19 @@
 #include <mikmod.h>
 
 #include <cassert>
+#include <memory>
 
 static constexpr Domain mikmod_domain("mikmod");
 
 /* this is largely copied from alsaplayer */
 
-static constexpr size_t MIKMOD_FRAME_SIZE = 4096;
+static constexpr unsigned MIKMOD_DEFAULT_SAMPLE_RATE = 44100;
+
+/**
+ * The #md_mode flags except for the sample format.
+ */
+static constexpr UWORD MIKMOD_MODE =
+	DMODE_SOFT_MUSIC | DMODE_INTERP | DMODE_STEREO;
 
 static BOOL
 mikmod_mpd_init()
@@ -85,19 +94,37 @@ static MDRIVER drv_mpd = {
 	VC_VoiceRealVolume
 };
 
+static char mikmod_params[] = "";
+
+/**
+ * libmikmod keeps global state (the mixer, its sample table and the
+ * module being played), but it is called by the decoder thread and
+ * by the database update.  This mutex serializes all libmikmod
+ * calls after mikmod_decoder_init().
+ */
+static Mutex mikmod_mutex;
+
 static bool mikmod_loop;
+
+/**
+ * The configured sample rate; 0 means "auto", i.e. use the outputs'
+ * sample rate.
+ */
 static unsigned mikmod_sample_rate;
 
+/**
+ * The number of frames rendered by one VC_WriteBytes() call.
+ */
+static unsigned mikmod_buffer_frames;
+
 static bool
 mikmod_decoder_init(const ConfigBlock &block)
 {
-	static char params[] = "";
-
 	mikmod_loop = block.GetBlockValue("loop", false);
-	mikmod_sample_rate = block.GetPositiveValue("sample_rate", 44100U);
-	if (!audio_valid_sample_rate(mikmod_sample_rate))
-		throw FmtRuntimeError("Invalid sample rate in line {}: {}",
-				      block.line, mikmod_sample_rate);
+
+	mikmod_sample_rate = ParseEmuSampleRate(block, MIKMOD_DEFAULT_SAMPLE_RATE);
+
+	mikmod_buffer_frames = block.GetPositiveValue("buffer_frames", 1024U);
 
 	md_device = 0;
 	md_reverb = 0;
@@ -106,11 +133,12 @@ mikmod_decoder_init(const ConfigBlock &block)
 	MikMod_RegisterAllLoaders();
 
 	md_pansep = 64;
-	md_mixfreq = mikmod_sample_rate;
-	md_mode = (DMODE_SOFT_MUSIC | DMODE_INTERP | DMODE_STEREO |
-		   DMODE_16BITS);
+	md_mixfreq = mikmod_sample_rate != 0
+		? mikmod_sample_rate
+		: MIKMOD_DEFAULT_SAMPLE_RATE;
+	md_mode = MIKMOD_MODE | DMODE_16BITS;
 
-	if (MikMod_Init(params)) {
+	if (MikMod_Init(mikmod_params)) {
 		FmtError(mikmod_domain,
 			 "Could not init MikMod: {}",
 			 MikMod_strerror(MikMod_errno));
@@ -126,6 +154,68 @@ mikmod_decoder_finish() noexcept
 	MikMod_Exit();
 }
 
+/**
+ * Determine the audio format for rendering: the configured sample
+ * rate (or the outputs' one with "auto"), and floating point samples
+ * (if libmikmod supports them) unless the outputs want 16 bit
+ * anyway.
+ */
+[[gnu::pure]]
+static AudioFormat
+GetMikmodAudioFormat(DecoderClient &client) noexcept
+{
+	const auto preferred = client.GetPreferredAudioFormat();
+
+	const unsigned sample_rate =
+		GetEmuSampleRate(&client, mikmod_sample_rate,
+				 MIKMOD_DEFAULT_SAMPLE_RATE);
+
+	SampleFormat format = SampleFormat::S16;
+#ifdef DMODE_FLOAT
+	if (preferred.format != SampleFormat::UNDEFINED &&
+	    preferred.format != SampleFormat::S8 &&
+	    preferred.format != SampleFormat::S16)
+		format = SampleFormat::FLOAT;
+#endif
+
+	return {sample_rate, format, 2};
+}
+
+/**
+ * Reconfigure the libmikmod mixer for the given audio format if it
+ * is different from the current one.
+ *
+ * Caller must lock #mikmod_mutex.
+ *
+ * @return false on error
+ */
+static bool
+ConfigureMikmod(const AudioFormat audio_format) noexcept
+{
+	UWORD mode = MIKMOD_MODE;
+#ifdef DMODE_FLOAT
+	if (audio_format.format == SampleFormat::FLOAT)
+		mode |= DMODE_FLOAT;
+	else
+#endif
+		mode |= DMODE_16BITS;
+
+	if (md_mixfreq == audio_format.sample_rate && md_mode == mode)
+		return true;
+
+	md_mixfreq = audio_format.sample_rate;
+	md_mode = mode;
+
+	if (MikMod_Reset(mikmod_params)) {
+		FmtError(mikmod_domain,
+			 "Could not reset MikMod: {}",
+			 MikMod_strerror(MikMod_errno));
+		return false;
+	}
+
+	return true;
+}
+
 static void
 mikmod_decoder_file_decode(DecoderClient &client, Path path_fs)
 {
@@ -136,9 +226,22 @@ mikmod_decoder_file_decode(DecoderClient &client, Path path_fs)
 
 	MODULE *handle;
 	int ret;
-	SBYTE buffer[MIKMOD_FRAME_SIZE];
 
-	handle = Player_Load(path2, 128, 0);
+	const AudioFormat audio_format = GetMikmodAudioFormat(client);
+	assert(audio_format.IsValid());
+
+	const std::size_t buffer_size =
+		mikmod_buffer_frames * audio_format.GetFrameSize();
+	const auto buffer = std::make_unique<SBYTE[]>(buffer_size);
+
+	{
+		const std::scoped_lock lock{mikmod_mutex};
+
+		if (!ConfigureMikmod(audio_format))
+			return;
+
+		handle = Player_Load(path2, 128, 0);
+	}
 
 	if (handle == nullptr) {
 		FmtError(mikmod_domain, "failed to open mod: {}", path_fs);
@@ -147,21 +250,31 @@ mikmod_decoder_file_decode(DecoderClient &client, Path path_fs)
 
 	handle->loop = mikmod_loop;
 
-	const AudioFormat audio_format(mikmod_sample_rate, SampleFormat::S16, 2);
-	assert(audio_format.IsValid());
-
 	client.Ready(audio_format, false, SignedSongTime::Negative());
 
-	Player_Start(handle);
+	{
+		const std::scoped_lock lock{mikmod_mutex};
+		Player_Start(handle);
+	}
 
 	DecoderCommand cmd = DecoderCommand::NONE;
-	while (cmd == DecoderCommand::NONE && Player_Active()) {
-		ret = VC_WriteBytes(buffer, sizeof(buffer));
+	while (cmd == DecoderCommand::NONE) {
+		{
+			/* lock only while rendering, not while
+			   SubmitAudio() waits for buffer space */
+			const std::scoped_lock lock{mikmod_mutex};
+			if (!Player_Active())
+				break;
+
+			ret = VC_WriteBytes(buffer.get(), buffer_size);
+		}
+
 		cmd = client.SubmitAudio(nullptr,
-					 std::span{buffer, std::size_t(ret)},
+					 std::span{buffer.get(), std::size_t(ret)},
 					 0);
 	}
 
+	const std::scoped_lock lock{mikmod_mutex};
 	Player_Stop();
 	Player_Free(handle);
 }
@@ -174,6 +287,8 @@ mikmod_decoder_scan_file(Path path_fs, TagHandler &handler) noexcept
 	   string pointer */
 	const auto path2 = const_cast<char *>(np.c_str());
 
+	const std::scoped_lock lock{mikmod_mutex};
+
 	MODULE *handle = Player_Load(path2, 128, 0);
 
 	if (handle == nullptr) {
@@ -63,3 +63,21 @@ mod_loadfile(const Domain *domain, DecoderClient *client, InputStream &is)
 	return buffer;
 }
 
+ModFileData
+mod_loadstream(const Domain *domain, DecoderClient *client, InputStream &is)
+{
+	if (const auto contents = is.LockGetContiguous(); !contents.empty()) {
+		if (contents.size() > MOD_FILE_LIMIT) {
+			LogWarning(*domain, "file too large");
+			return {};
+		}
+
+		return ModFileData{contents};
+	}
+
+	auto buffer = mod_loadfile(domain, client, is);
+	if (buffer == nullptr)
+		return {};
+
+	return ModFileData{std::move(buffer)};
+}
@@ -9,6 +9,57 @@
 #include "util/AllocatedArray.hxx"
 #include "util/Domain.hxx"
 
+#include <span>
+#include <utility>
+
 AllocatedArray<std::byte> mod_loadfile(const Domain *domain, DecoderClient *client, InputStream &is);
 
+/**
+ * The raw contents of a module file.  If the #InputStream provides
+ * them in memory (e.g. a memory mapping of a local file, see
+ * InputStream::GetContiguous()), this refers to that memory, which
+ * is valid as long as the #InputStream exists; for everything else,
+ * it is a copy obtained with mod_loadfile().
+ */
+class ModFileData {
+	AllocatedArray<std::byte> buffer;
+
+	std::span<const std::byte> data;
+
+public:
+	ModFileData() noexcept = default;
+
+	explicit ModFileData(AllocatedArray<std::byte> &&_buffer) noexcept
+		:buffer(std::move(_buffer)), data(buffer) {}
+
+	explicit ModFileData(std::span<const std::byte> _data) noexcept
+		:data(_data) {}
+
+	ModFileData(ModFileData &&src) noexcept
+		:buffer(std::move(src.buffer)),
+		 data(std::exchange(src.data, {})) {}
+
+	ModFileData &operator=(ModFileData &&) = delete;
+
+	bool empty() const noexcept {
+		return data.empty();
+	}
+
+	const std::byte *begin() const noexcept {
+		return data.data();
+	}
+
+	std::size_t size() const noexcept {
+		return data.size();
+	}
+};
+
+/**
+ * Load the module from the given #InputStream, without copying if
+ * its contents are already in memory.  Returns an empty object on
+ * error.  The returned object must not outlive the #InputStream.
+ */
+ModFileData
+mod_loadstream(const Domain *domain, DecoderClient *client, InputStream &is);
+
 #endif
@@ -4,6 +4,7 @@
 #include "ModplugDecoderPlugin.hxx"
 #include "ModCommon.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
 #include "input/InputStream.hxx"
 #include "tag/Handler.hxx"
 #include "lib/fmt/RuntimeError.hxx"
@@ -19,14 +20,26 @@
 #include <libmodplug/modplug.h>
 
 #include <cassert>
+#include <memory>
 
 static constexpr Domain modplug_domain("modplug");
 
-static constexpr size_t MODPLUG_FRAME_SIZE = 4096;
+static constexpr unsigned MODPLUG_DEFAULT_SAMPLE_RATE = 44100;
 
 static int modplug_loop_count;
 static unsigned char modplug_resampling_mode;
 
+/**
+ * The configured sample rate; 0 means "auto", i.e. use the outputs'
+ * sample rate.
+ */
+static unsigned modplug_sample_rate;
+
+/**
+ * The number of frames rendered by one ModPlug_Read() call.
+ */
+static unsigned modplug_buffer_frames;
+
 static bool
 modplug_decoder_init(const ConfigBlock &block)
 {
@@ -49,19 +62,49 @@ modplug_decoder_init(const ConfigBlock &block)
 		throw FmtRuntimeError("Invalid loop count in line {}: {}",
 				      block.line, modplug_loop_count);
 
+	modplug_sample_rate = ParseEmuSampleRate(block, MODPLUG_DEFAULT_SAMPLE_RATE);
+
+	modplug_buffer_frames = block.GetPositiveValue("buffer_frames", 1024U);
+
 	return true;
 }
 
+/**
+ * Determine the audio format for rendering: the configured sample
+ * rate (or the outputs' one with "auto"), and 32 bit samples unless
+ * the outputs want 16 bit anyway.  libmodplug cannot render floating
+ * point samples.
+ */
+[[gnu::pure]]
+static AudioFormat
+GetModplugAudioFormat(DecoderClient &client) noexcept
+{
+	const auto preferred = client.GetPreferredAudioFormat();
+
+	const unsigned sample_rate =
+		GetEmuSampleRate(&client, modplug_sample_rate,
+				 MODPLUG_DEFAULT_SAMPLE_RATE);
+
+	const SampleFormat format =
+		preferred.format == SampleFormat::UNDEFINED ||
+		preferred.format == SampleFormat::S8 ||
+		preferred.format == SampleFormat::S16
+		? SampleFormat::S16
+		: SampleFormat::S32;
+
+	return {sample_rate, format, 2};
+}
+
 static ModPlugFile *
 LoadModPlugFile(DecoderClient *client, InputStream &is)
 {
-	const auto buffer = mod_loadfile(&modplug_domain, client, is);
-	if (buffer == nullptr) {
+	const auto buffer = mod_loadstream(&modplug_domain, client, is);
+	if (buffer.empty()) {
 		LogWarning(modplug_domain, "could not load stream");
 		return nullptr;
 	}
 
-	ModPlugFile *f = ModPlug_Load(buffer.data(), buffer.size());
+	ModPlugFile *f = ModPlug_Load(buffer.begin(), buffer.size());
 	return f;
 }
 
@@ -70,14 +113,20 @@ mod_decode(DecoderClient &client, InputStream &is)
 {
 	ModPlug_Settings settings;
 	int ret;
-	char audio_buffer[MODPLUG_FRAME_SIZE];
+
+	const AudioFormat audio_format = GetModplugAudioFormat(client);
+	assert(audio_format.IsValid());
+
+	const std::size_t buffer_size =
+		modplug_buffer_frames * audio_format.GetFrameSize();
+	const auto audio_buffer = std::make_unique<std::byte[]>(buffer_size);
 
 	ModPlug_GetSettings(&settings);
 	/* alter setting */
 	settings.mResamplingMode = modplug_resampling_mode;
-	settings.mChannels = 2;
-	settings.mBits = 16;
-	settings.mFrequency = 44100;
+	settings.mChannels = audio_format.channels;
+	settings.mBits = audio_format.GetSampleSize() * 8;
+	settings.mFrequency = audio_format.sample_rate;
 	settings.mLoopCount = modplug_loop_count;
 	/* insert more setting changes here */
 	ModPlug_SetSettings(&settings);
@@ -88,20 +137,17 @@ mod_decode(DecoderClient &client, InputStream &is)
 		return;
 	}
 
-	static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
-	assert(audio_format.IsValid());
-
 	client.Ready(audio_format, is.IsSeekable(),
 		     SongTime::FromMS(ModPlug_GetLength(f)));
 
 	DecoderCommand cmd;
 	do {
-		ret = ModPlug_Read(f, audio_buffer, MODPLUG_FRAME_SIZE);
+		ret = ModPlug_Read(f, audio_buffer.get(), buffer_size);
 		if (ret <= 0)
 			break;
 
 		cmd = client.SubmitAudio(nullptr,
-					 std::span{audio_buffer, std::size_t(ret)},
+					 std::span{audio_buffer.get(), std::size_t(ret)},
 					 0);
 
 		if (cmd == DecoderCommand::SEEK) {
@@ -142,4 +188,5 @@ static constexpr const char *mod_suffixes[] = {
 constexpr DecoderPlugin modplug_decoder_plugin =
 	DecoderPlugin("modplug", mod_decode, modplug_scan_stream)
 	.WithInit(modplug_decoder_init)
-	.WithSuffixes(mod_suffixes);
+	.WithSuffixes(mod_suffixes)
+	.WithSerialScan();
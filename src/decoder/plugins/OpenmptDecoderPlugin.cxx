@@ -12,7 +12,9 @@
 
 #include <libopenmpt/libopenmpt.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <iostream>
 
 static constexpr Domain openmpt_domain("openmpt");
 
@@ -54,13 +56,13 @@ mod_decode(DecoderClient &client, InputStream &is)
 {
 	int ret;
 
-	const auto buffer = mod_loadfile(&openmpt_domain, &client, is);
-	if (buffer == nullptr) {
+	const auto buffer = mod_loadstream(&openmpt_domain, &client, is);
+	if (buffer.empty()) {
 		LogWarning(openmpt_domain, "could not load stream");
 		return;
 	}
 
-	openmpt::module mod(buffer.data(), buffer.size());
+	openmpt::module mod(buffer.begin(), buffer.size());
 
 	/* alter settings */
 	mod.set_repeat_count(openmpt_repeat_count);
@@ -93,16 +95,24 @@ mod_decode(DecoderClient &client, InputStream &is)
 
 	DecoderCommand cmd;
 	do {
+		/* render directly into the MusicChunk if possible */
+		const auto raw = client.GetAudioBuffer(nullptr, 0);
 		float audio_buffer[OPENMPT_FRAME_SIZE / sizeof(float)];
+		const std::span<float> dest = raw.empty()
+			? std::span{audio_buffer}
+			: std::span{reinterpret_cast<float *>(raw.data()),
+				    std::min(raw.size(), OPENMPT_FRAME_SIZE) / sizeof(float)};
+
 		ret = mod.read_interleaved_stereo(OPENMPT_SAMPLE_RATE,
-						  OPENMPT_FRAME_SIZE / channels / sizeof(float),
-						  audio_buffer);
+						  dest.size() / channels,
+						  dest.data());
 		if (ret <= 0)
 			break;
 
-		cmd = client.SubmitAudio(nullptr,
-					 std::span{audio_buffer, ret * channels},
-					 0);
+		cmd = raw.empty()
+			? client.SubmitAudio(nullptr,
+					     dest.first(ret * channels), 0)
+			: client.CommitAudio(ret * channels * sizeof(float));
 
 		if (cmd == DecoderCommand::SEEK) {
 			mod.set_position_seconds(client.GetSeekTime().ToS());
@@ -115,13 +125,31 @@ mod_decode(DecoderClient &client, InputStream &is)
 static bool
 openmpt_scan_stream(InputStream &is, TagHandler &handler) noexcept
 try {
-	const auto buffer = mod_loadfile(&openmpt_domain, nullptr, is);
-	if (buffer == nullptr) {
+	const auto buffer = mod_loadstream(&openmpt_domain, nullptr, is);
+	if (buffer.empty()) {
 		LogWarning(openmpt_domain, "could not load stream");
 		return false;
 	}
 
-	openmpt::module mod(buffer.data(), buffer.size());
+#if OPENMPT_API_VERSION_AT_LEAST(0,3,0)
+	/* don't bother setting up a module for files libopenmpt
+	   doesn't recognize */
+	if (openmpt::probe_file_header(openmpt::probe_file_header_flags_default,
+				       buffer.begin(), buffer.size(),
+				       buffer.size()) ==
+	    openmpt::probe_file_header_result_failure) {
+		LogWarning(openmpt_domain, "unrecognized module format");
+		return false;
+	}
+#endif
+
+	/* duration and metadata only depend on the header and the
+	   pattern data; skipping the sample data means the pages
+	   holding it (usually most of the file) are never read */
+	openmpt::module mod(buffer.begin(), buffer.size(), std::clog, {
+			{"load.skip_samples", "1"},
+			{"load.skip_plugins", "1"},
+		});
 
 	handler.OnDuration(SongTime::FromS(mod.get_duration_seconds()));
 
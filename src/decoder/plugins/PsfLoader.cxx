@@ -0,0 +1,648 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "PsfLoader.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "lib/zlib/Error.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Path.hxx"
+#include "fs/Traits.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "io/FileReader.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ASCII.hxx"
+#include "util/StringStrip.hxx"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * Refuse to load files larger than this.
+ */
+static constexpr std::size_t PSF_MAX_FILE_SIZE = 64 * 1024 * 1024;
+
+/**
+ * Refuse to decompress program sections larger than this.
+ */
+static constexpr std::size_t PSF_MAX_PROGRAM_SIZE = 64 * 1024 * 1024;
+
+/**
+ * The maximum length of the "[TAG]" section, as specified by the PSF
+ * format.
+ */
+static constexpr std::size_t PSF_MAX_TAG_SIZE = 50000;
+
+/**
+ * The maximum nesting depth of "_lib" references.
+ */
+static constexpr unsigned PSF_MAX_DEPTH = 10;
+
+static constexpr std::size_t PSF_CACHE_MAX_ITEMS = 16;
+static constexpr std::size_t PSF_CACHE_MAX_BYTES = 64 * 1024 * 1024;
+
+/**
+ * Compare two PSF tag names; they are case-insensitive.
+ */
+[[gnu::pure]]
+static bool
+IsSameTagName(std::string_view a, std::string_view b) noexcept
+{
+	return a.size() == b.size() &&
+		StringEqualsCaseASCII(a.data(), b.data(), a.size());
+}
+
+[[gnu::pure]]
+static const char *
+FindTag(const PsfTagList &tags, std::string_view name) noexcept
+{
+	for (const auto &[key, value] : tags)
+		if (IsSameTagName(key, name))
+			return value.c_str();
+	return nullptr;
+}
+
+namespace {
+
+/**
+ * A parsed PSF file with its program section decompressed.
+ */
+struct PsfFile {
+	uint8_t version;
+	std::vector<uint8_t> program;
+	std::vector<uint8_t> reserved;
+	PsfTagList tags;
+
+	std::size_t GetMemorySize() const noexcept {
+		return program.size() + reserved.size();
+	}
+
+	[[gnu::pure]]
+	const char *FindTag(std::string_view name) const noexcept {
+		return ::FindTag(tags, name);
+	}
+};
+
+/**
+ * A LRU cache of #T objects, keyed by path and modification time.
+ */
+template<typename T>
+class PsfCache {
+	struct Item {
+		AllocatedPath path;
+		std::chrono::system_clock::time_point mtime;
+		std::shared_ptr<const T> value;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Most recently used first.
+	 */
+	std::list<Item> items;
+
+	std::size_t total_size = 0;
+
+public:
+	std::shared_ptr<const T> Get(const AllocatedPath &path,
+				     std::chrono::system_clock::time_point mtime) noexcept {
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->path != path)
+				continue;
+
+			if (i->mtime != mtime) {
+				/* modified: reload */
+				Erase(i);
+				return nullptr;
+			}
+
+			items.splice(items.begin(), items, i);
+			return i->value;
+		}
+
+		return nullptr;
+	}
+
+	void Put(const AllocatedPath &path,
+		 std::chrono::system_clock::time_point mtime,
+		 std::shared_ptr<const T> value) noexcept {
+		const std::size_t size = GetMemorySize(*value);
+		if (size > PSF_CACHE_MAX_BYTES)
+			return;
+
+		const std::scoped_lock lock{mutex};
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->path == path) {
+				Erase(i);
+				break;
+			}
+		}
+
+		try {
+			items.push_front({path, mtime, std::move(value)});
+		} catch (...) {
+			return;
+		}
+
+		total_size += size;
+
+		while (items.size() > PSF_CACHE_MAX_ITEMS ||
+		       total_size > PSF_CACHE_MAX_BYTES)
+			Erase(std::prev(items.end()));
+	}
+
+private:
+	void Erase(typename std::list<Item>::iterator i) noexcept {
+		total_size -= GetMemorySize(*i->value);
+		items.erase(i);
+	}
+
+	static std::size_t GetMemorySize(const PsfFile &file) noexcept {
+		return file.GetMemorySize();
+	}
+
+	static std::size_t GetMemorySize(const PsfFileData &data) noexcept {
+		return data.size();
+	}
+};
+
+} // anonymous namespace
+
+static PsfCache<PsfFile> psf_file_cache;
+static PsfCache<PsfFileData> psf_data_cache;
+
+[[gnu::pure]]
+static uint32_t
+ReadLE32(const uint8_t *p) noexcept
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) |
+		(uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static PsfFileData
+ReadWholeFile(Path path)
+{
+	FileReader reader{path};
+
+	const auto size = reader.GetSize();
+	if (size > PSF_MAX_FILE_SIZE)
+		throw std::runtime_error{"File is too large"};
+
+	PsfFileData data(static_cast<std::size_t>(size));
+	reader.ReadFull(std::as_writable_bytes(std::span{data}));
+	return data;
+}
+
+static std::vector<uint8_t>
+Inflate(std::span<const uint8_t> src)
+{
+	z_stream z{};
+	int result = inflateInit(&z);
+	if (result != Z_OK)
+		throw MakeZlibError(result, "inflateInit() failed");
+
+	std::vector<uint8_t> dest;
+	dest.resize(std::min<std::size_t>(std::max<std::size_t>(src.size() * 4,
+								 4096),
+					  PSF_MAX_PROGRAM_SIZE));
+
+	z.next_in = const_cast<Bytef *>(src.data());
+	z.avail_in = static_cast<uInt>(src.size());
+
+	while (true) {
+		z.next_out = dest.data() + z.total_out;
+		z.avail_out = static_cast<uInt>(dest.size() - z.total_out);
+
+		result = inflate(&z, Z_FINISH);
+		if (result == Z_STREAM_END)
+			break;
+
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			inflateEnd(&z);
+			throw MakeZlibError(result, "Failed to decompress PSF program");
+		}
+
+		if (z.avail_out > 0) {
+			/* no progress and no more input */
+			inflateEnd(&z);
+			throw std::runtime_error{"Truncated PSF program"};
+		}
+
+		if (dest.size() >= PSF_MAX_PROGRAM_SIZE) {
+			inflateEnd(&z);
+			throw std::runtime_error{"PSF program is too large"};
+		}
+
+		dest.resize(std::min(dest.size() * 2, PSF_MAX_PROGRAM_SIZE));
+	}
+
+	dest.resize(z.total_out);
+	inflateEnd(&z);
+	return dest;
+}
+
+/**
+ * Parse the "[TAG]" section.  Each line has the form "name=value";
+ * whitespace around names and values is ignored, and values of
+ * repeated names are joined with a newline.
+ */
+static PsfTagList
+ParsePsfTags(std::string_view src)
+{
+	PsfTagList tags;
+
+	while (!src.empty()) {
+		std::string_view line = src;
+		if (const auto newline = src.find('\n');
+		    newline != src.npos) {
+			line = src.substr(0, newline);
+			src = src.substr(newline + 1);
+		} else
+			src = {};
+
+		const auto equals = line.find('=');
+		if (equals == line.npos)
+			continue;
+
+		const auto name = Strip(line.substr(0, equals));
+		const auto value = Strip(line.substr(equals + 1));
+		if (name.empty())
+			continue;
+
+		auto i = std::find_if(tags.begin(), tags.end(),
+				      [name](const auto &p){
+					      return p.first == name;
+				      });
+		if (i != tags.end()) {
+			i->second.push_back('\n');
+			i->second.append(value);
+		} else
+			tags.emplace_back(name, value);
+	}
+
+	return tags;
+}
+
+struct PsfHeader {
+	uint8_t version;
+	uint32_t reserved_size, program_size, program_crc;
+
+	/**
+	 * Parse and check the 16 byte header.
+	 *
+	 * @param file_size the total size of the file
+	 */
+	PsfHeader(std::span<const uint8_t> src, uint_least64_t file_size) {
+		if (src.size() < 16 || file_size < 16 ||
+		    std::memcmp(src.data(), "PSF", 3) != 0)
+			throw std::runtime_error{"Not a PSF file"};
+
+		version = src[3];
+		reserved_size = ReadLE32(src.data() + 4);
+		program_size = ReadLE32(src.data() + 8);
+		program_crc = ReadLE32(src.data() + 12);
+
+		if (uint_least64_t(reserved_size) + program_size > file_size - 16)
+			throw std::runtime_error{"Malformed PSF header"};
+	}
+
+	/**
+	 * The offset of the "[TAG]" section (if any) within the file.
+	 */
+	uint_least64_t GetTagOffset() const noexcept {
+		return 16 + uint_least64_t(reserved_size) + program_size;
+	}
+};
+
+/**
+ * Parse the "[TAG]" section (if there is one) at the end of a PSF
+ * file.
+ */
+static PsfTagList
+ParsePsfTagSection(std::span<const uint8_t> src)
+{
+	if (src.size() < 5 || std::memcmp(src.data(), "[TAG]", 5) != 0)
+		return {};
+
+	src = src.subspan(5);
+	if (src.size() > PSF_MAX_TAG_SIZE)
+		src = src.first(PSF_MAX_TAG_SIZE);
+
+	return ParsePsfTags({reinterpret_cast<const char *>(src.data()), src.size()});
+}
+
+static PsfFile
+ParsePsfFile(std::span<const uint8_t> src)
+{
+	const PsfHeader header{src, src.size()};
+
+	PsfFile file;
+	file.version = header.version;
+
+	src = src.subspan(16);
+	const auto reserved = src.first(header.reserved_size);
+	const auto program = src.subspan(header.reserved_size,
+					 header.program_size);
+	src = src.subspan(header.reserved_size + header.program_size);
+
+	file.reserved.assign(reserved.begin(), reserved.end());
+
+	if (!program.empty()) {
+		if (crc32(0, program.data(), static_cast<uInt>(program.size())) != header.program_crc)
+			throw std::runtime_error{"PSF program CRC mismatch"};
+
+		file.program = Inflate(program);
+	}
+
+	file.tags = ParsePsfTagSection(src);
+	return file;
+}
+
+/**
+ * Read only the header and the "[TAG]" section of a PSF file,
+ * skipping the reserved and program sections.
+ *
+ * @return the PSF version byte
+ */
+static uint8_t
+ReadPsfTags(Path path, PsfTagList &tags)
+{
+	FileReader reader{path};
+	const auto file_size = reader.GetSize();
+
+	uint8_t buffer[16];
+	reader.ReadFull(std::as_writable_bytes(std::span{buffer}));
+
+	const PsfHeader header{buffer, file_size};
+
+	const auto tag_offset = header.GetTagOffset();
+	const auto tag_size = std::min<uint_least64_t>(file_size - tag_offset,
+						       5 + PSF_MAX_TAG_SIZE);
+	if (tag_size < 5) {
+		tags.clear();
+		return header.version;
+	}
+
+	std::vector<uint8_t> tag_buffer(static_cast<std::size_t>(tag_size));
+	reader.Seek(static_cast<off_t>(tag_offset));
+	reader.ReadFull(std::as_writable_bytes(std::span{tag_buffer}));
+
+	tags = ParsePsfTagSection(tag_buffer);
+	return header.version;
+}
+
+std::shared_ptr<const PsfFileData>
+PsfReadFile(Path path, bool cache)
+{
+	if (!cache)
+		return std::make_shared<const PsfFileData>(ReadWholeFile(path));
+
+	FileInfo info;
+	if (!GetFileInfo(path, info))
+		throw FmtRuntimeError("Failed to access {:?}", path.ToUTF8());
+
+	const AllocatedPath key{path};
+	const auto mtime = info.GetModificationTime();
+	if (auto data = psf_data_cache.Get(key, mtime))
+		return data;
+
+	auto data = std::make_shared<const PsfFileData>(ReadWholeFile(path));
+	psf_data_cache.Put(key, mtime, data);
+	return data;
+}
+
+/**
+ * Load a library file, from the cache if possible.
+ */
+static std::shared_ptr<const PsfFile>
+LoadCachedPsfFile(const AllocatedPath &path)
+{
+	FileInfo info;
+	if (!GetFileInfo(path, info))
+		throw FmtRuntimeError("Failed to access PSF library {:?}",
+				      path.ToUTF8());
+
+	const auto mtime = info.GetModificationTime();
+	if (auto file = psf_file_cache.Get(path, mtime))
+		return file;
+
+	auto file = std::make_shared<const PsfFile>(ParsePsfFile(ReadWholeFile(path)));
+	psf_file_cache.Put(path, mtime, file);
+	return file;
+}
+
+namespace {
+
+struct PsfLoadState {
+	uint8_t version;
+
+	PsfLoadCallback load;
+	void *load_ctx;
+
+	/**
+	 * The tags of all files in the chain; the first file which
+	 * defines a tag wins.
+	 */
+	PsfTagList tags;
+
+	void MergeTags(const PsfTagList &src) {
+		for (const auto &i : src) {
+			if (std::none_of(tags.begin(), tags.end(),
+					 [&i](const auto &j){
+						 return IsSameTagName(j.first, i.first);
+					 }))
+				tags.push_back(i);
+		}
+	}
+};
+
+} // anonymous namespace
+
+static void
+PsfLoadChain(PsfLoadState &state, Path path, const PsfFile &file,
+	     unsigned depth);
+
+/**
+ * Resolve a "_lib" tag value relative to the directory of the file
+ * which references it.  Both "\\" (the common case, because most
+ * PSF files are made on Windows) and "/" are accepted as directory
+ * separators.
+ */
+static AllocatedPath
+BuildLibraryPath(Path referrer, std::string_view name) noexcept
+{
+	const auto is_separator = [](char ch){
+		return ch == '\\' || ch == '/';
+	};
+
+	/* the name is always relative */
+	while (!name.empty() && is_separator(name.front()))
+		name.remove_prefix(1);
+
+	std::string fs_name{name};
+	std::replace_if(fs_name.begin(), fs_name.end(), is_separator,
+			char(PathTraitsFS::SEPARATOR));
+
+	return AllocatedPath::Build(referrer.GetDirectoryName(),
+				   AllocatedPath::FromFS(std::move(fs_name)));
+}
+
+static void
+PsfLoadLibrary(PsfLoadState &state, Path referrer, std::string_view name,
+	       unsigned depth)
+{
+	if (depth >= PSF_MAX_DEPTH)
+		throw std::runtime_error{"PSF library nesting is too deep"};
+
+	const auto path = BuildLibraryPath(referrer, name);
+	const auto file = LoadCachedPsfFile(path);
+	if (file->version != state.version)
+		throw FmtRuntimeError("PSF library {:?} has the wrong version",
+				      path.ToUTF8());
+
+	PsfLoadChain(state, path, *file, depth + 1);
+}
+
+static void
+PsfLoadChain(PsfLoadState &state, Path path, const PsfFile &file,
+	     unsigned depth)
+{
+	state.MergeTags(file.tags);
+
+	if (const char *lib = file.FindTag("_lib"sv);
+	    lib != nullptr && *lib != 0)
+		PsfLoadLibrary(state, path, lib, depth);
+
+	if (state.load != nullptr &&
+	    state.load(state.load_ctx,
+		       file.program.data(), file.program.size(),
+		       file.reserved.data(), file.reserved.size()) != 0)
+		throw std::runtime_error{"Failed to load PSF section"};
+
+	for (unsigned n = 2;; ++n) {
+		const auto name = "_lib" + std::to_string(n);
+		const char *lib = file.FindTag(name);
+		if (lib == nullptr || *lib == 0)
+			break;
+
+		PsfLoadLibrary(state, path, lib, depth);
+	}
+}
+
+uint8_t
+PsfLoad(Path path, uint8_t allowed_version,
+	PsfLoadCallback load, void *load_ctx,
+	PsfInfoCallback info, void *info_ctx)
+{
+	/* the file itself is not cached; only its libraries are
+	   likely to be loaded again */
+	const auto file = ParsePsfFile(ReadWholeFile(path));
+	if (allowed_version != 0 && file.version != allowed_version)
+		throw std::runtime_error{"Wrong PSF version"};
+
+	PsfLoadState state{file.version, load, load_ctx, {}};
+	PsfLoadChain(state, path, file, 0);
+
+	if (info != nullptr)
+		for (const auto &[name, value] : state.tags)
+			info(info_ctx, name.c_str(), value.c_str());
+
+	return file.version;
+}
+
+void
+PsfPrefetch(Path path, [[maybe_unused]] AudioFormat preferred_format) noexcept
+try {
+	PsfLoad(path, 0, nullptr, nullptr, nullptr, nullptr);
+} catch (...) {
+	/* ignore; the decoder plugin will report the error */
+}
+
+static void
+PsfScanChain(PsfLoadState &state, Path path, const PsfTagList &tags,
+	     unsigned depth);
+
+static void
+PsfScanLibrary(PsfLoadState &state, Path referrer, std::string_view name,
+	       unsigned depth)
+{
+	if (depth >= PSF_MAX_DEPTH)
+		throw std::runtime_error{"PSF library nesting is too deep"};
+
+	const auto path = BuildLibraryPath(referrer, name);
+
+	uint8_t version;
+	PsfTagList tags;
+
+	/* use the decompressed copy if the library has been
+	   played recently */
+	FileInfo info;
+	std::shared_ptr<const PsfFile> cached;
+	if (GetFileInfo(path, info))
+		cached = psf_file_cache.Get(path, info.GetModificationTime());
+
+	if (cached) {
+		version = cached->version;
+		tags = cached->tags;
+	} else
+		version = ReadPsfTags(path, tags);
+
+	if (version != state.version)
+		throw FmtRuntimeError("PSF library {:?} has the wrong version",
+				      path.ToUTF8());
+
+	PsfScanChain(state, path, tags, depth + 1);
+}
+
+static void
+PsfScanChain(PsfLoadState &state, Path path, const PsfTagList &tags,
+	     unsigned depth)
+{
+	state.MergeTags(tags);
+
+	for (unsigned n = 1;; ++n) {
+		const auto tag_name = n == 1
+			? std::string{"_lib"}
+			: "_lib" + std::to_string(n);
+		const char *lib = FindTag(tags, tag_name);
+		if (lib == nullptr || *lib == 0) {
+			if (n == 1)
+				/* "_lib2" may exist without "_lib" */
+				continue;
+			break;
+		}
+
+		PsfScanLibrary(state, path, lib, depth);
+	}
+}
+
+uint8_t
+PsfScan(Path path, uint8_t allowed_version,
+	PsfInfoCallback info, void *info_ctx)
+{
+	PsfTagList tags;
+	const uint8_t version = ReadPsfTags(path, tags);
+	if (allowed_version != 0 && version != allowed_version)
+		throw std::runtime_error{"Wrong PSF version"};
+
+	PsfLoadState state{version, nullptr, nullptr, {}};
+	PsfScanChain(state, path, tags, 0);
+
+	if (info != nullptr)
+		for (const auto &[name, value] : state.tags)
+			info(info_ctx, name.c_str(), value.c_str());
+
+	return version;
+}
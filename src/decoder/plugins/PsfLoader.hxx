@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * A replacement for psflib's psf_load() which keeps decompressed
+ * library files ("_lib" tags) in a memory cache shared by all PSF
+ * decoder plugins, so a set of mini files referencing the same
+ * library reads and inflates it only once.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Path;
+struct AudioFormat;
+
+/**
+ * Receives the decompressed program section and the reserved section
+ * of each file in the "_lib" chain, in load order.  Returns 0 on
+ * success.  Compatible with psflib's psf_load_callback.
+ */
+using PsfLoadCallback = int (*)(void *ctx,
+				const uint8_t *exe, std::size_t exe_size,
+				const uint8_t *reserved,
+				std::size_t reserved_size);
+
+/**
+ * Receives one tag.  Compatible with psflib's psf_info_callback.
+ */
+using PsfInfoCallback = int (*)(void *ctx,
+				const char *name, const char *value);
+
+using PsfTagList = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * The raw contents of a file.
+ */
+using PsfFileData = std::vector<uint8_t>;
+
+/**
+ * Read the whole file into memory.  If #cache is true, the contents
+ * are looked up in (and added to) the library cache.
+ *
+ * Throws on error.
+ */
+std::shared_ptr<const PsfFileData>
+PsfReadFile(Path path, bool cache);
+
+/**
+ * Load a PSF file and all library files it references.  Tags of the
+ * given file take precedence over tags of its libraries; each tag is
+ * passed to #info exactly once, after all sections have been loaded.
+ *
+ * Throws on error.
+ *
+ * @param allowed_version the expected PSF version byte or 0 to
+ * allow any version
+ * @param load the section callback; may be nullptr
+ * @param info the tag callback; may be nullptr
+ * @return the PSF version byte
+ */
+uint8_t
+PsfLoad(Path path, uint8_t allowed_version,
+	PsfLoadCallback load, void *load_ctx,
+	PsfInfoCallback info, void *info_ctx);
+
+/**
+ * Like PsfLoad() without a section callback, but reads only the
+ * header and the "[TAG]" section of each file in the "_lib" chain.
+ * Nothing is decompressed and no emulator is needed; this is enough
+ * to obtain tags and the song duration.
+ *
+ * Throws on error.
+ *
+ * @return the PSF version byte
+ */
+uint8_t
+PsfScan(Path path, uint8_t allowed_version,
+	PsfInfoCallback info, void *info_ctx);
+
+/**
+ * An implementation of DecoderPlugin::prefetch() for plugins using
+ * PsfLoad(): it loads all library files referenced by the given file
+ * into the cache.  Errors are ignored.
+ */
+void
+PsfPrefetch(Path path, AudioFormat preferred_format) noexcept;
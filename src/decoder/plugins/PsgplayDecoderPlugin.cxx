@@ -4,6 +4,7 @@
 #include "PsgplayDecoderPlugin.hxx"
 #include "decoder/Features.h"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "song/DetachedSong.hxx"
@@ -13,6 +14,8 @@
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "io/FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
 #include "util/AllocatedArray.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
@@ -26,6 +29,12 @@ extern "C" {
 
 #include <fmt/format.h>
 
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
 #define SUBTUNE_PREFIX "tune_"
 
 /*
@@ -36,10 +45,18 @@ extern "C" {
 
 static constexpr Domain psgplay_domain("psgplay");
 
+static constexpr unsigned PSGPLAY_DEFAULT_SAMPLE_RATE = 44100;
+
 struct PsgplayGlobal {
 	unsigned default_songlength;
 	std::string default_genre;
 
+	/**
+	 * The configured sample rate; 0 means "auto" (see
+	 * GetEmuSampleRate()).
+	 */
+	unsigned sample_rate;
+
 	explicit PsgplayGlobal(const ConfigBlock &block);
 };
 
@@ -51,6 +68,8 @@ PsgplayGlobal::PsgplayGlobal(const ConfigBlock &block)
 	default_songlength = block.GetPositiveValue("default_songlength", 0U);
 
 	default_genre = block.GetBlockValue("default_genre", "");
+
+	sample_rate = ParseEmuSampleRate(block, PSGPLAY_DEFAULT_SAMPLE_RATE);
 }
 
 static bool
@@ -60,9 +79,72 @@ psgplay_init(const ConfigBlock &block)
 	return true;
 }
 
+/**
+ * A parsed subtune of a #PsgplayImage.
+ */
+struct PsgplaySubtune {
+	/**
+	 * The subtune name from the SNDH header; empty if none.
+	 */
+	std::string name;
+
+	SignedSongTime duration;
+};
+
+/**
+ * The contents of a SNDH file and its parsed tags, read once and
+ * shared by the container scan, the tag scan and the decoder of all
+ * subtunes.
+ */
+struct PsgplayImage {
+	AllocatedPath path;
+	std::chrono::system_clock::time_point mtime;
+
+	AllocatedArray<std::byte> data;
+
+	std::string title, composer, year;
+
+	/**
+	 * Indexed by track number minus one; never empty.
+	 */
+	std::vector<PsgplaySubtune> subtunes;
+
+	PsgplayImage(Path _path,
+		     std::chrono::system_clock::time_point _mtime) noexcept
+		:path(_path), mtime(_mtime) {}
+
+	unsigned GetTrackCount() const noexcept {
+		return subtunes.size();
+	}
+
+	[[gnu::pure]]
+	const PsgplaySubtune *GetSubtune(unsigned track) const noexcept {
+		return track >= 1 && track <= subtunes.size()
+			? &subtunes[track - 1]
+			: nullptr;
+	}
+};
+
+/**
+ * The number of #PsgplayImage instances kept in #psgplay_image_cache.
+ * A SNDH file is usually scanned as a container, then each of its
+ * subtunes is scanned and played; a few entries are enough to cover
+ * a container scan interleaved with playback of another file.
+ */
+static constexpr std::size_t PSGPLAY_IMAGE_CACHE_SIZE = 4;
+
+/**
+ * The most recently used #PsgplayImage instances, most recent first.
+ * Protected by #psgplay_image_mutex because the database update
+ * scans files in worker threads.
+ */
+static Mutex psgplay_image_mutex;
+static std::list<std::shared_ptr<const PsgplayImage>> psgplay_image_cache;
+
 static void
 psgplay_finish() noexcept
 {
+	psgplay_image_cache.clear();
 	delete psgplay_global;
 }
 
@@ -71,24 +153,6 @@ struct PsgplayContainerPath {
 	unsigned track;
 };
 
-static AllocatedArray<std::byte>
-psgplay_read_file(const Path &path_fs)
-{
-	FileReader file(path_fs);
-
-	const size_t size = file.GetSize();
-
-	if (size > MAX_SNDH_FILE_SIZE)
-		throw FmtRuntimeError("File larger than {} bytes: {}",
-				      MAX_SNDH_FILE_SIZE, path_fs);
-
-	AllocatedArray<std::byte> data(size);
-
-	file.ReadFull(data);
-
-	return data;
-}
-
 [[gnu::pure]]
 static unsigned
 psgplay_subtune_track(const char *base) noexcept
@@ -120,30 +184,131 @@ psgplay_container_from_path(Path path_fs) noexcept
 	return { path_fs.GetDirectoryName(), track };
 }
 
-static SignedSongTime
-psgplay_subtune_duration(int subtune, const AllocatedArray<std::byte> &tune) noexcept
+static std::string
+psgplay_tag_string(bool (*tag)(char *text, size_t length,
+			       const void *data, const size_t size),
+		   std::span<const std::byte> tune) noexcept
 {
-	float duration;
+	char text[256];
 
-	if (sndh_tag_subtune_time(&duration, subtune, tune.data(), tune.size()))
-		return SignedSongTime::FromS(duration);
+	if (tag(text, sizeof(text), tune.data(), tune.size()))
+		return text;
 
-	return SignedSongTime::Negative();
+	return {};
+}
+
+static void
+psgplay_parse_image(PsgplayImage &image) noexcept
+{
+	const std::span<const std::byte> tune = image.data;
+
+	image.title = psgplay_tag_string(sndh_tag_title, tune);
+	image.composer = psgplay_tag_string(sndh_tag_composer, tune);
+	image.year = psgplay_tag_string(sndh_tag_year, tune);
+
+	int n_tracks;
+	if (!sndh_tag_subtune_count(&n_tracks, tune.data(), tune.size()) ||
+	    n_tracks < 1)
+		n_tracks = 1;
+
+	image.subtunes.resize(n_tracks);
+
+	for (int i = 1; i <= n_tracks; ++i) {
+		auto &subtune = image.subtunes[i - 1];
+
+		char text[256];
+		if (sndh_tag_subtune_name(text, sizeof(text), i,
+					  tune.data(), tune.size()))
+			subtune.name = text;
+
+		float duration;
+		subtune.duration = sndh_tag_subtune_time(&duration, i,
+							 tune.data(),
+							 tune.size())
+			? SignedSongTime::FromS(duration)
+			: SignedSongTime::Negative();
+	}
+}
+
+/**
+ * Load a SNDH file, from #psgplay_image_cache if it is still
+ * up to date.
+ *
+ * Throws on error.
+ */
+static std::shared_ptr<const PsgplayImage>
+psgplay_load_image(Path path_fs)
+{
+	const FileInfo info{path_fs};
+	const auto mtime = info.GetModificationTime();
+
+	{
+		const std::scoped_lock lock{psgplay_image_mutex};
+		for (auto i = psgplay_image_cache.begin();
+		     i != psgplay_image_cache.end(); ++i) {
+			if ((*i)->path == AllocatedPath{path_fs} &&
+			    (*i)->mtime == mtime) {
+				psgplay_image_cache.splice(psgplay_image_cache.begin(),
+							   psgplay_image_cache,
+							   i);
+				return psgplay_image_cache.front();
+			}
+		}
+	}
+
+	if (info.GetSize() > MAX_SNDH_FILE_SIZE)
+		throw FmtRuntimeError("File larger than {} bytes: {}",
+				      MAX_SNDH_FILE_SIZE, path_fs);
+
+	auto image = std::make_shared<PsgplayImage>(path_fs, mtime);
+
+	FileReader file(path_fs);
+	image->data = AllocatedArray<std::byte>(file.GetSize());
+	file.ReadFull(image->data);
+
+	psgplay_parse_image(*image);
+
+	const std::scoped_lock lock{psgplay_image_mutex};
+
+	/* drop a stale entry for the same file */
+	psgplay_image_cache.remove_if([&image](const auto &i){
+		return i->path == image->path;
+	});
+
+	psgplay_image_cache.emplace_front(image);
+	if (psgplay_image_cache.size() > PSGPLAY_IMAGE_CACHE_SIZE)
+		psgplay_image_cache.pop_back();
+
+	return image;
+}
+
+[[gnu::pure]]
+static SignedSongTime
+psgplay_subtune_duration(unsigned track, const PsgplayImage &image) noexcept
+{
+	const auto *subtune = image.GetSubtune(track);
+	return subtune != nullptr
+		? subtune->duration
+		: SignedSongTime::Negative();
 }
 
 static void
 psgplay_file_decode(DecoderClient &client, Path path_fs)
 {
-	static constexpr AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	const AudioFormat audio_format(GetEmuSampleRate(&client,
+							psgplay_global->sample_rate,
+							PSGPLAY_DEFAULT_SAMPLE_RATE),
+				       SampleFormat::S16, 2);
 	assert(audio_format.IsValid());
 
 	const auto container = psgplay_container_from_path(path_fs);
 
-	const AllocatedArray<std::byte> tune = psgplay_read_file(container.path);
+	const auto image = psgplay_load_image(container.path);
+	const std::span<const std::byte> tune = image->data;
 	if (tune.empty())
 		return;
 
-	SignedSongTime duration = psgplay_subtune_duration(container.track, tune);
+	SignedSongTime duration = psgplay_subtune_duration(container.track, *image);
 	if (duration.IsNegative() && psgplay_global->default_songlength > 0)
 		duration = SignedSongTime::FromS(psgplay_global->default_songlength);
 
@@ -155,7 +320,10 @@ psgplay_file_decode(DecoderClient &client, Path path_fs)
 	if (!duration.IsNegative())
 		psgplay_stop_at_time(pp, duration.ToDoubleS());
 
-	AtScopeExit(pp) { psgplay_free(pp); };
+	AtScopeExit(&pp) {
+		if (pp != nullptr)
+			psgplay_free(pp);
+	};
 
 	client.Ready(audio_format, true, duration);
 
@@ -191,6 +359,7 @@ psgplay_file_decode(DecoderClient &client, Path path_fs)
 					psgplay_stop_at_time(pp, duration.ToDoubleS());
 
 				t_frames = 0;
+				client.CountRestart();
 			}
 
 			if (s_frames > t_frames) {
@@ -213,68 +382,48 @@ psgplay_file_decode(DecoderClient &client, Path path_fs)
 
 static void
 psgplay_tag(enum TagType tag_type, TagHandler &th,
-	    bool (*tag)(char *text, size_t length,
-			const void *data, const size_t size),
-	    const AllocatedArray<std::byte> &tune) noexcept
+	    const std::string &value) noexcept
 {
-	char text[256];
-
-	if (tag(text, sizeof(text), tune.data(), tune.size()))
-		th.OnTag(tag_type, text);
+	if (!value.empty())
+		th.OnTag(tag_type, value.c_str());
 }
 
 static void
-psgplay_tag_subtune_name(unsigned track, unsigned n_tracks,
-			 TagHandler &th,
-			 const AllocatedArray<std::byte> &tune) noexcept
+psgplay_tag_subtune_name(unsigned track, TagHandler &th,
+			 const PsgplayImage &image) noexcept
 {
-	char text[256];
-
-	if (sndh_tag_subtune_name(text, sizeof(text), track,
-				  tune.data(), tune.size())) {
-		th.OnTag(TAG_TITLE, text);
+	const auto *subtune = image.GetSubtune(track);
+	if (subtune != nullptr && !subtune->name.empty()) {
+		th.OnTag(TAG_TITLE, subtune->name.c_str());
 		return;
 	}
 
-	if (!sndh_tag_title(text, sizeof(text), tune.data(), tune.size()))
-		text[0] = '\0';
-
-	if (n_tracks == 1 && text[0] != '\0') {
-		th.OnTag(TAG_TITLE, text);
+	const unsigned n_tracks = image.GetTrackCount();
+	if (n_tracks == 1 && !image.title.empty()) {
+		th.OnTag(TAG_TITLE, image.title.c_str());
 		return;
 	}
 
 	const auto album_track = fmt::format("{} ({}/{})",
-			                     text, track, n_tracks);
+			                     image.title, track, n_tracks);
 
 	th.OnTag(TAG_TITLE, album_track.c_str());
 }
 
-static int
-psgplay_tracks(const AllocatedArray<std::byte> &tune) noexcept
-{
-	int n_tracks;
-
-	if (sndh_tag_subtune_count(&n_tracks, tune.data(), tune.size()))
-		return n_tracks;
-
-	return 1;
-}
-
 static void
-psgplay_on_tag(unsigned track, unsigned n_tracks, TagHandler &th,
-	       const AllocatedArray<std::byte> &tune) noexcept
+psgplay_on_tag(unsigned track, TagHandler &th,
+	       const PsgplayImage &image) noexcept
 {
-	psgplay_tag(TAG_ALBUM, th, sndh_tag_title, tune);
-	psgplay_tag_subtune_name(track, n_tracks, th, tune);
-	psgplay_tag(TAG_ARTIST, th, sndh_tag_composer, tune);
-	psgplay_tag(TAG_DATE, th, sndh_tag_year, tune);
+	psgplay_tag(TAG_ALBUM, th, image.title);
+	psgplay_tag_subtune_name(track, th, image);
+	psgplay_tag(TAG_ARTIST, th, image.composer);
+	psgplay_tag(TAG_DATE, th, image.year);
 
 	if (!psgplay_global->default_genre.empty())
 		th.OnTag(TAG_GENRE,
 			      psgplay_global->default_genre.c_str());
 
-	const SignedSongTime duration = psgplay_subtune_duration(track, tune);
+	const SignedSongTime duration = psgplay_subtune_duration(track, image);
 	if (!duration.IsNegative())
 		th.OnDuration(SongTime(duration));
 
@@ -286,11 +435,11 @@ psgplay_scan_file(Path path_fs, TagHandler &th)
 {
 	const auto container = psgplay_container_from_path(path_fs);
 
-	const AllocatedArray<std::byte> tune = psgplay_read_file(container.path);
-	if (tune.empty())
+	const auto image = psgplay_load_image(container.path);
+	if (image->data.empty())
 		return false;
 
-	psgplay_on_tag(container.track, psgplay_tracks(tune), th, tune);
+	psgplay_on_tag(container.track, th, *image);
 
 	return true;
 }
@@ -300,17 +449,17 @@ psgplay_container_scan(Path path_fs)
 {
 	std::forward_list<DetachedSong> list;
 
-	const AllocatedArray<std::byte> tune = psgplay_read_file(path_fs);
+	const auto image = psgplay_load_image(path_fs);
 
-	const int n_tracks = psgplay_tracks(tune);
+	const unsigned n_tracks = image->GetTrackCount();
 
 	TagBuilder tag_builder;
 
 	auto tail = list.before_begin();
-	for (int i = 1; i <= n_tracks; ++i) {
+	for (unsigned i = 1; i <= n_tracks; ++i) {
 		AddTagHandler th(tag_builder);
 
-		psgplay_on_tag(i, n_tracks, th, tune);
+		psgplay_on_tag(i, th, *image);
 
 		/* Construct container/tune path names, for example
 		   Delta.sndh/tune_001.sndh */
@@ -322,6 +471,18 @@ psgplay_container_scan(Path path_fs)
 	return list;
 }
 
+static void
+psgplay_prefetch(Path path_fs,
+		 [[maybe_unused]] AudioFormat preferred_format) noexcept
+try {
+	/* load the file into #psgplay_image_cache, where
+	   psgplay_file_decode() will find it */
+	const auto container = psgplay_container_from_path(path_fs);
+	psgplay_load_image(container.path);
+} catch (...) {
+	/* ignore; psgplay_file_decode() will report the error */
+}
+
 static constexpr const char *psgplay_suffixes[] = {
 	"sndh",
 	nullptr
@@ -331,4 +492,5 @@ constexpr DecoderPlugin psgplay_decoder_plugin =
 	DecoderPlugin("psgplay", psgplay_file_decode, psgplay_scan_file)
 	.WithInit(psgplay_init, psgplay_finish)
 	.WithContainer(psgplay_container_scan)
+	.WithPrefetch(psgplay_prefetch)
 	.WithSuffixes(psgplay_suffixes);
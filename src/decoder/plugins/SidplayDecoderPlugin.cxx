@@ -4,6 +4,10 @@
 #include "SidplayDecoderPlugin.hxx"
 #include "decoder/Features.h"
 #include "../DecoderAPI.hxx"
+#include "../EmuSampleRate.hxx"
+#include "../EmuSilence.hxx"
+#include "../ContainerState.hxx"
+#include "../LazyInit.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Builder.hxx"
 #include "song/DetachedSong.hxx"
@@ -13,12 +17,19 @@
 #include "lib/fmt/PathFormatter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "lib/icu/Converter.hxx"
+#include "io/FileLineReader.hxx"
 #include "io/FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Domain.hxx"
 #include "util/AllocatedString.hxx"
 #include "util/CharUtil.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/StringAPI.hxx"
 #include "util/StringCompare.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
 #include "Log.hxx"
 
 #include <sidplayfp/sidplayfp.h>
@@ -28,29 +39,172 @@
 #include <sidplayfp/SidTuneInfo.h>
 #include <sidplayfp/builders/resid.h>
 #include <sidplayfp/builders/residfp.h>
-#include <sidplayfp/SidDatabase.h>
 
 #include <fmt/format.h>
 
+#include <chrono>
+#include <cstring>
 #include <iterator>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #define SUBTUNE_PREFIX "tune_"
 
 static constexpr Domain sidplay_domain("sidplay");
 
+/**
+ * The HVSC songlength database ("Songlengths.md5" or the older
+ * "Songlengths.txt"), loaded into a hash map keyed by the MD5
+ * fingerprint of the tune.
+ */
+class SidSonglengthDatabase {
+	/**
+	 * Song lengths in milliseconds, one per subtune; -1 if the
+	 * entry could not be parsed.
+	 */
+	std::unordered_map<std::string, std::vector<int_least32_t>> map;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit SidSonglengthDatabase(Path path);
+
+	[[gnu::pure]]
+	SignedSongTime Get(const std::string &md5,
+			   unsigned song) const noexcept {
+		const auto i = map.find(md5);
+		if (i == map.end() || song < 1 || song > i->second.size())
+			return SignedSongTime::Negative();
+
+		const auto ms = i->second[song - 1];
+		if (ms < 0)
+			return SignedSongTime::Negative();
+
+		return SignedSongTime::FromMS(ms);
+	}
+};
+
+/**
+ * Parse a song length in the form "m:ss" or "m:ss.SSS", optionally
+ * followed by attributes in parentheses (old format).
+ *
+ * @return the length in milliseconds or -1 on error
+ */
+[[gnu::pure]]
+static int_least32_t
+ParseSonglength(std::string_view s) noexcept
+{
+	if (const auto paren = s.find('('); paren != s.npos)
+		s = s.substr(0, paren);
+
+	const auto [minutes_s, rest] = Split(s, ':');
+	if (minutes_s.empty() || rest.data() == nullptr)
+		return -1;
+
+	const auto [seconds_s, fraction_s] = Split(rest, '.');
+	if (seconds_s.empty())
+		return -1;
+
+	uint_least32_t minutes = 0, seconds = 0, ms = 0;
+
+	for (const char ch : minutes_s) {
+		if (!IsDigitASCII(ch) || minutes > 100000)
+			return -1;
+		minutes = minutes * 10 + (ch - '0');
+	}
+
+	for (const char ch : seconds_s) {
+		if (!IsDigitASCII(ch) || seconds > 1000)
+			return -1;
+		seconds = seconds * 10 + (ch - '0');
+	}
+
+	unsigned digits = 0;
+	for (const char ch : fraction_s) {
+		if (!IsDigitASCII(ch))
+			return -1;
+		if (digits < 3) {
+			ms = ms * 10 + (ch - '0');
+			++digits;
+		}
+	}
+
+	for (; digits < 3; ++digits)
+		ms *= 10;
+
+	return (minutes * 60 + seconds) * 1000 + ms;
+}
+
+SidSonglengthDatabase::SidSonglengthDatabase(Path path)
+{
+	FileLineReader reader{path};
+
+	char *line;
+	while ((line = reader.ReadLine()) != nullptr) {
+		const std::string_view l = Strip(std::string_view{line});
+		if (l.empty() || l.front() == ';' || l.front() == '[')
+			continue;
+
+		const auto [md5, value] = Split(l, '=');
+		if (md5.empty() || value.data() == nullptr)
+			continue;
+
+		std::vector<int_least32_t> lengths;
+		for (std::string_view i : IterableSplitString(value, ' ')) {
+			i = Strip(i);
+			if (!i.empty())
+				lengths.push_back(ParseSonglength(i));
+		}
+
+		std::string key{Strip(md5)};
+		for (auto &ch : key)
+			ch = ToLowerASCII(ch);
+
+		map.insert_or_assign(std::move(key), std::move(lengths));
+	}
+}
+
+static constexpr unsigned SID_DEFAULT_SAMPLE_RATE = 48000;
+
 struct SidplayGlobal {
-	std::unique_ptr<SidDatabase> songlength_database;
+	std::unique_ptr<SidSonglengthDatabase> songlength_database;
 
 	bool all_files_are_containers;
 	unsigned default_songlength;
 	std::string default_genre;
 
+	/**
+	 * End songs which are not in the songlength database at
+	 * silence.
+	 */
+	EmuSilenceConfig silence;
+
 	bool filter_setting;
 
+	/**
+	 * The configured sample rate; 0 means "auto" (see
+	 * GetEmuSampleRate()).
+	 */
+	unsigned sample_rate;
+
+	/**
+	 * Use the classic reSID engine instead of reSIDfp?  It
+	 * needs considerably less CPU.
+	 */
+	bool resid;
+
+	SidConfig::sampling_method_t sampling_method;
+	bool fast_sampling;
+
 	std::unique_ptr<uint8_t[]> kernal, basic;
 
 	explicit SidplayGlobal(const ConfigBlock &block);
+
+private:
+	void ApplyCpuProfile(const ConfigBlock &block);
 };
 
 static SidplayGlobal *sidplay_global;
@@ -65,18 +219,51 @@ static void loadRom(const Path rom_path, uint8_t *dump)
 }
 
 /**
- * Throws on error.
+ * Choose the emulation defaults from the setting "cpu_profile";
+ * the settings "emulation", "sampling_method" and "fast_sampling"
+ * override them.
  */
-static std::unique_ptr<SidDatabase>
-sidplay_load_songlength_db(const Path path)
+inline void
+SidplayGlobal::ApplyCpuProfile(const ConfigBlock &block)
 {
-	auto db = std::make_unique<SidDatabase>();
-	bool error = !db->open(path.c_str());
-	if (error)
-		throw FmtRuntimeError("unable to read songlengths file {:?}: {}",
-				      path, db->error());
+	const char *profile = block.GetBlockValue("cpu_profile", "medium");
+	if (StringIsEqual(profile, "low")) {
+		resid = true;
+		sampling_method = SidConfig::INTERPOLATE;
+		fast_sampling = true;
+	} else if (StringIsEqual(profile, "medium")) {
+		resid = false;
+		sampling_method = SidConfig::INTERPOLATE;
+		fast_sampling = false;
+	} else if (StringIsEqual(profile, "high")) {
+		resid = false;
+		sampling_method = SidConfig::RESAMPLE_INTERPOLATE;
+		fast_sampling = false;
+	} else
+		throw FmtRuntimeError("Invalid cpu_profile in line {}: {:?}",
+				      block.line, profile);
+
+	if (const char *emulation = block.GetBlockValue("emulation")) {
+		if (StringIsEqual(emulation, "residfp"))
+			resid = false;
+		else if (StringIsEqual(emulation, "resid"))
+			resid = true;
+		else
+			throw FmtRuntimeError("Invalid emulation in line {}: {:?}",
+					      block.line, emulation);
+	}
+
+	if (const char *method = block.GetBlockValue("sampling_method")) {
+		if (StringIsEqual(method, "interpolate"))
+			sampling_method = SidConfig::INTERPOLATE;
+		else if (StringIsEqual(method, "resample"))
+			sampling_method = SidConfig::RESAMPLE_INTERPOLATE;
+		else
+			throw FmtRuntimeError("Invalid sampling_method in line {}: {:?}",
+					      block.line, method);
+	}
 
-	return db;
+	fast_sampling = block.GetBlockValue("fast_sampling", fast_sampling);
 }
 
 inline
@@ -85,10 +272,12 @@ SidplayGlobal::SidplayGlobal(const ConfigBlock &block)
 	/* read the songlengths database file */
 	const auto database_path = block.GetPath("songlength_database");
 	if (!database_path.IsNull())
-		songlength_database = sidplay_load_songlength_db(database_path);
+		songlength_database = std::make_unique<SidSonglengthDatabase>(database_path);
 
 	default_songlength = block.GetPositiveValue("default_songlength", 0U);
 
+	silence = ParseEmuSilenceConfig(block);
+
 	default_genre = block.GetBlockValue("default_genre", "");
 
 	all_files_are_containers =
@@ -96,6 +285,10 @@ SidplayGlobal::SidplayGlobal(const ConfigBlock &block)
 
 	filter_setting = block.GetBlockValue("filter", true);
 
+	sample_rate = ParseEmuSampleRate(block, SID_DEFAULT_SAMPLE_RATE);
+
+	ApplyCpuProfile(block);
+
 	/* read kernal rom dump file */
 	const auto kernal_path = block.GetPath("kernal");
 	if (!kernal_path.IsNull())
@@ -113,6 +306,40 @@ SidplayGlobal::SidplayGlobal(const ConfigBlock &block)
 	}
 }
 
+/**
+ * The contents of a PSID/RSID file, read once and shared by all of
+ * its subtunes.
+ */
+struct SidImage {
+	AllocatedPath path;
+	std::chrono::system_clock::time_point mtime;
+
+	std::vector<uint_least8_t> data;
+
+	/**
+	 * MD5 fingerprints for the songlength database: the HVSC#68+
+	 * format and the older format.
+	 */
+	std::string md5, md5_old;
+
+	SidImage(Path _path,
+		 std::chrono::system_clock::time_point _mtime) noexcept
+		:path(_path), mtime(_mtime) {}
+};
+
+/**
+ * The file size limit for #SidImage; PSID/RSID files are never
+ * larger than the C64 memory plus the header.
+ */
+static constexpr uint_least64_t SID_IMAGE_MAX_SIZE = 128 * 1024;
+
+/**
+ * The most recently loaded #SidImage.  The subtunes of one file are
+ * usually scanned and played one after another.
+ */
+static Mutex sid_image_mutex;
+static std::shared_ptr<const SidImage> sid_image_cache;
+
 static bool
 sidplay_init(const ConfigBlock &block)
 {
@@ -123,6 +350,7 @@ sidplay_init(const ConfigBlock &block)
 static void
 sidplay_finish() noexcept
 {
+	sid_image_cache.reset();
 	delete sidplay_global;
 }
 
@@ -162,65 +390,166 @@ ParseContainerPath(Path path_fs) noexcept
 	return { path_fs.GetDirectoryName(), track };
 }
 
+struct SidplayTune {
+	std::unique_ptr<SidTune> tune;
+
+	/**
+	 * @see SidImage::md5
+	 */
+	std::string md5, md5_old;
+};
+
+static void
+CreateFingerprints(SidTune &tune, std::string &md5, std::string &md5_old)
+{
+	if (sidplay_global->songlength_database == nullptr)
+		return;
+
+	char buffer[SidTune::MD5_LENGTH + 1];
+
+	if (const char *p = tune.createMD5(buffer); p != nullptr)
+		md5_old = p;
+
+#if LIBSIDPLAYFP_VERSION_MAJ >= 2
+	if (const char *p = tune.createMD5New(buffer); p != nullptr)
+		md5 = p;
+#endif
+}
+
 /**
- * This is a template, because libsidplay requires SidTuneMod while
- * libsidplayfp requires just a plain Sidtune.
+ * Load a PSID/RSID file into memory, or return the cached copy.
+ * Returns nullptr on error or if the file has a different format
+ * (such as multi-file tunes), which must be loaded by libsidplayfp
+ * from disk.
  */
-template<typename T>
-static SignedSongTime
-get_song_length(T &tune) noexcept
+static std::shared_ptr<const SidImage>
+LoadSidImage(Path path) noexcept
 {
-	assert(tune.getStatus());
+	FileInfo info;
+	if (!GetFileInfo(path, info) || !info.IsRegular() ||
+	    info.GetSize() < 4 || info.GetSize() > SID_IMAGE_MAX_SIZE)
+		return nullptr;
 
-	if (sidplay_global->songlength_database == nullptr)
-		return SignedSongTime::Negative();
+	const auto mtime = info.GetModificationTime();
 
-#if LIBSIDPLAYFP_VERSION_MAJ >= 2
-	const auto lengthms =
-		sidplay_global->songlength_database->lengthMs(tune);
-	/* check for new song length format since HVSC#68 or later */
-	if (lengthms < 0)
 	{
-#endif
-		/* old song lenghth format */
-		const auto length =
-			sidplay_global->songlength_database->length(tune);
-		if (length >= 0)
-			return SignedSongTime::FromS(length);
-		return SignedSongTime::Negative();
+		const std::scoped_lock lock{sid_image_mutex};
+		if (sid_image_cache != nullptr &&
+		    sid_image_cache->path == AllocatedPath{path} &&
+		    sid_image_cache->mtime == mtime)
+			return sid_image_cache;
+	}
 
-#if LIBSIDPLAYFP_VERSION_MAJ >= 2
+	try {
+		auto image = std::make_shared<SidImage>(path, mtime);
+
+		FileReader reader{path};
+		image->data.resize(reader.GetSize());
+		reader.ReadFull(std::as_writable_bytes(std::span{image->data}));
+
+		if (std::memcmp(image->data.data(), "PSID", 4) != 0 &&
+		    std::memcmp(image->data.data(), "RSID", 4) != 0)
+			return nullptr;
+
+		SidTune tune{image->data.data(),
+			     static_cast<uint_least32_t>(image->data.size())};
+		if (!tune.getStatus())
+			return nullptr;
+
+		CreateFingerprints(tune, image->md5, image->md5_old);
+
+		const std::scoped_lock lock{sid_image_mutex};
+		sid_image_cache = image;
+		return image;
+	} catch (...) {
+		return nullptr;
 	}
-	return SignedSongTime::FromMS(lengthms);
-#endif
 }
 
-static void
-sidplay_file_decode(DecoderClient &client, Path path_fs)
+/**
+ * Load a tune, from the in-memory #SidImage if possible.  The caller
+ * must check SidTune::getStatus().
+ */
+static SidplayTune
+LoadSidTune(Path path)
 {
-	int channels;
+	SidplayTune t;
+
+	if (const auto image = LoadSidImage(path)) {
+		t.tune = std::make_unique<SidTune>(image->data.data(),
+						   static_cast<uint_least32_t>(image->data.size()));
+		t.md5 = image->md5;
+		t.md5_old = image->md5_old;
+		return t;
+	}
 
-	/* load the tune */
+	t.tune = std::make_unique<SidTune>(NarrowPath(path));
+	if (t.tune->getStatus())
+		CreateFingerprints(*t.tune, t.md5, t.md5_old);
 
-	const auto container = ParseContainerPath(path_fs);
-	auto np = NarrowPath(container.path);
-	auto tune = SidTune(np);
+	return t;
+}
+
+[[gnu::pure]]
+static SignedSongTime
+get_song_length(const SidplayTune &t, unsigned song) noexcept
+{
+	const auto *db = sidplay_global->songlength_database.get();
+	if (db == nullptr)
+		return SignedSongTime::Negative();
+
+	/* check for new song length format since HVSC#68 or later */
+	if (!t.md5.empty()) {
+		const auto length = db->Get(t.md5, song);
+		if (!length.IsNegative())
+			return length;
+	}
+
+	/* old song length format */
+	return db->Get(t.md5_old, song);
+}
+
+/**
+ * The loaded tune and the configured emulator, kept between
+ * consecutive subtunes of one file (see
+ * DecoderClient::KeepContainer()).
+ */
+struct SidplayContainer final : DecoderContainerState {
+	SidplayTune t;
+
+	sidplayfp player;
+
+	std::unique_ptr<sidbuilder> builder;
+
+	unsigned sample_rate;
+
+	unsigned channels;
+};
+
+/**
+ * Load the tune and set up the emulator for the given subtune.
+ *
+ * @return nullptr on error (which has been logged)
+ */
+static std::unique_ptr<SidplayContainer>
+OpenSidplayContainer(Path path, unsigned song_num, unsigned sample_rate)
+{
+	auto c = std::make_unique<SidplayContainer>();
+	c->t = LoadSidTune(path);
+	c->sample_rate = sample_rate;
+
+	auto &tune = *c->t.tune;
 	if (!tune.getStatus()) {
 		const char *error = tune.statusString();
 		FmtWarning(sidplay_domain, "failed to load file: {}", error);
-		return;
+		return nullptr;
 	}
 
-	const int song_num = container.track;
 	tune.selectSong(song_num);
 
-	auto duration = get_song_length(tune);
-	if (duration.IsNegative() && sidplay_global->default_songlength > 0)
-		duration = SongTime::FromS(sidplay_global->default_songlength);
-
 	/* initialize the player */
 
-	sidplayfp player;
+	auto &player = c->player;
 
 	player.setRoms(sidplay_global->kernal.get(),
 		       sidplay_global->basic.get(),
@@ -228,61 +557,123 @@ sidplay_file_decode(DecoderClient &client, Path path_fs)
 	if (!player.load(&tune)) {
 		FmtWarning(sidplay_domain,
 			   "sidplay2.load() failed: {}", player.error());
-		return;
+		return nullptr;
 	}
 
 	/* initialize the builder */
 
-	ReSIDfpBuilder builder("ReSID");
-	if (!builder.getStatus()) {
+	auto &builder = c->builder;
+	if (sidplay_global->resid)
+		builder = std::make_unique<ReSIDBuilder>("ReSID");
+	else
+		builder = std::make_unique<ReSIDfpBuilder>("ReSIDfp");
+
+	if (!builder->getStatus()) {
 		FmtWarning(sidplay_domain,
-			   "failed to initialize ReSIDfpBuilder: {}",
-			   builder.error());
-		return;
+			   "failed to initialize SID builder: {}",
+			   builder->error());
+		return nullptr;
 	}
 
-	builder.create(player.info().maxsids());
-	if (!builder.getStatus()) {
+	/* one emulated chip per SID of multi-SID tunes */
+	builder->create(player.info().maxsids());
+	if (!builder->getStatus()) {
 		FmtWarning(sidplay_domain,
-			   "ReSIDfpBuilder.create() failed: {}",
-			   builder.error());
-		return;
+			   "SID builder create() failed: {}",
+			   builder->error());
+		return nullptr;
 	}
 
-	builder.filter(sidplay_global->filter_setting);
-	if (!builder.getStatus()) {
+	builder->filter(sidplay_global->filter_setting);
+	if (!builder->getStatus()) {
 		FmtWarning(sidplay_domain,
-			   "ReSIDfpBuilder.filter() failed: {}",
-			   builder.error());
-		return;
+			   "SID builder filter() failed: {}",
+			   builder->error());
+		return nullptr;
 	}
 
 	/* configure the player */
 
 	auto config = player.config();
 
-	config.frequency = 48000;
-	config.sidEmulation = &builder;
-	config.samplingMethod = SidConfig::INTERPOLATE;
-	config.fastSampling = false;
+	config.frequency = sample_rate;
+	config.sidEmulation = builder.get();
+	config.samplingMethod = sidplay_global->sampling_method;
+	config.fastSampling = sidplay_global->fast_sampling;
 
 	if (tune.getInfo()->sidChips() >= 2) {
 		config.playback = SidConfig::STEREO;
-		channels = 2;
+		c->channels = 2;
 	} else {
 		config.playback = SidConfig::MONO;
-		channels = 1;
+		c->channels = 1;
 	}
 
 	if (!player.config(config)) {
 		FmtWarning(sidplay_domain,
 			   "sidplay2.config() failed: {}", player.error());
-		return;
+		return nullptr;
+	}
+
+	return c;
+}
+
+static void
+sidplay_file_decode(DecoderClient &client, Path path_fs)
+{
+	const auto container = ParseContainerPath(path_fs);
+
+	const unsigned sample_rate =
+		GetEmuSampleRate(&client, sidplay_global->sample_rate,
+				 SID_DEFAULT_SAMPLE_RATE);
+
+	/* reuse the emulator of the previous subtune of this file;
+	   this skips loading the tune and creating the SID chips */
+	std::unique_ptr<SidplayContainer> c{
+		static_cast<SidplayContainer *>(client.TakeContainer(sidplay_decoder_plugin,
+								     container.path).release()),
+	};
+	if (c != nullptr && c->sample_rate != sample_rate)
+		c.reset();
+
+	const int song_num = container.track;
+
+	if (c != nullptr) {
+		c->t.tune->selectSong(song_num);
+
+		/* this resets the emulated machine and reinitializes
+		   it for the selected subtune */
+		if (!c->player.load(c->t.tune.get())) {
+			FmtWarning(sidplay_domain,
+				   "sidplay2.load() failed: {}", c->player.error());
+			return;
+		}
+	} else {
+		c = OpenSidplayContainer(container.path, song_num, sample_rate);
+		if (c == nullptr)
+			return;
+	}
+
+	auto &player = c->player;
+	const unsigned channels = c->channels;
+
+	/* if the songlength database doesn't know this song, use
+	   the length detected by an earlier playback, or play the
+	   default length while looking for silence */
+	auto duration = get_song_length(c->t, song_num);
+	bool detect_silence = false;
+	if (duration.IsNegative()) {
+		duration = LookupEmuLength(path_fs);
+		if (duration.IsNegative()) {
+			if (sidplay_global->default_songlength > 0)
+				duration = SongTime::FromS(sidplay_global->default_songlength);
+			detect_silence = sidplay_global->silence.IsEnabled();
+		}
 	}
 
 	/* initialize the MPD decoder */
 
-	const AudioFormat audio_format(48000, SampleFormat::S16, channels);
+	const AudioFormat audio_format(sample_rate, SampleFormat::S16, channels);
 	assert(audio_format.IsValid());
 
 	client.Ready(audio_format, true, duration);
@@ -294,22 +685,44 @@ sidplay_file_decode(DecoderClient &client, Path path_fs)
 		? 0U
 		: duration.ToScale<uint64_t>(timebase);
 
+	/* measure how fast the emulator renders, to help choosing
+	   the "cpu_profile" */
+	std::chrono::steady_clock::duration render_time{};
+	uint_least64_t rendered_samples = 0;
+
+	EmuSilenceDetector silence(sidplay_global->silence, sample_rate,
+				   channels);
+
 	DecoderCommand cmd;
 	do {
 		short buffer[4096];
 
+		const auto render_start = std::chrono::steady_clock::now();
 		const auto result = player.play(buffer, std::size(buffer));
-		if (result <= 0)
+		render_time += std::chrono::steady_clock::now() - render_start;
+		if (result <= 0) {
+			/* emulator failure: don't reuse it */
+			c.reset();
 			break;
+		}
 
 		/* libsidplayfp returns the number of samples */
 		const size_t n_samples = result;
+		rendered_samples += n_samples;
 
 		client.SubmitTimestamp(FloatDuration(player.time()) / timebase);
 
+		const bool silence_end = detect_silence &&
+			silence.Feed({buffer, n_samples});
+
 		cmd = client.SubmitAudio(nullptr, std::span{buffer, n_samples},
 					 0);
 
+		if (silence_end) {
+			SubmitEmuLength(client, path_fs, silence.GetLength());
+			break;
+		}
+
 		if (cmd == DecoderCommand::SEEK) {
 			unsigned data_time = player.time();
 			unsigned target_time =
@@ -319,6 +732,7 @@ sidplay_file_decode(DecoderClient &client, Path path_fs)
 			if(target_time<data_time) {
 				player.stop();
 				data_time=0;
+				client.CountRestart();
 			}
 
 			/* ignore data until target time is reached */
@@ -326,6 +740,7 @@ sidplay_file_decode(DecoderClient &client, Path path_fs)
 			       player.play(buffer, std::size(buffer)) > 0)
 				data_time = player.time();
 
+			silence.Reset(uint64_t(data_time) * sample_rate / timebase);
 			client.CommandFinished();
 		}
 
@@ -333,6 +748,18 @@ sidplay_file_decode(DecoderClient &client, Path path_fs)
 			break;
 
 	} while (cmd != DecoderCommand::STOP);
+
+	if (render_time.count() > 0) {
+		const double rendered_s = double(rendered_samples) /
+			audio_format.sample_rate / channels;
+		FmtDebug(sidplay_domain, "rendered {:.1f}s at {:.1f}x realtime",
+			 rendered_s,
+			 rendered_s / std::chrono::duration<double>(render_time).count());
+	}
+
+	if (c != nullptr)
+		client.KeepContainer(sidplay_decoder_plugin, container.path,
+				     std::move(c));
 }
 
 static AllocatedString
@@ -434,8 +861,8 @@ sidplay_scan_file(Path path_fs, TagHandler &handler) noexcept
 	const auto container = ParseContainerPath(path_fs);
 	const unsigned song_num = container.track;
 
-	auto np = NarrowPath(container.path);
-	auto tune = SidTune(np);
+	const auto t = LoadSidTune(container.path);
+	auto &tune = *t.tune;
 	if (!tune.getStatus())
 		return false;
 
@@ -447,7 +874,9 @@ sidplay_scan_file(Path path_fs, TagHandler &handler) noexcept
 	ScanSidTuneInfo(info, song_num, n_tracks, handler);
 
 	/* time */
-	const auto duration = get_song_length(tune);
+	auto duration = get_song_length(t, song_num);
+	if (duration.IsNegative())
+		duration = LookupEmuLength(path_fs);
 	if (!duration.IsNegative())
 		handler.OnDuration(SongTime(duration));
 
@@ -459,7 +888,8 @@ sidplay_container_scan(Path path_fs)
 {
 	std::forward_list<DetachedSong> list;
 
-	auto tune = SidTune{NarrowPath(path_fs)};
+	const auto t = LoadSidTune(path_fs);
+	auto &tune = *t.tune;
 	if (!tune.getStatus())
 		return list;
 
@@ -480,20 +910,34 @@ sidplay_container_scan(Path path_fs)
 		AddTagHandler h(tag_builder);
 		ScanSidTuneInfo(info, i, n_tracks, h);
 
-		const SignedSongTime duration = get_song_length(tune);
+		/* Construct container/tune path names, eg.
+		   Delta.sid/tune_001.sid */
+		auto name = fmt::format(SUBTUNE_PREFIX "{:03}.sid", i);
+
+		SignedSongTime duration = get_song_length(t, i);
+		if (duration.IsNegative())
+			duration = LookupEmuLength(AllocatedPath::Build(path_fs,
+									name));
 		if (!duration.IsNegative())
 			h.OnDuration(SongTime(duration));
 
-		/* Construct container/tune path names, eg.
-		   Delta.sid/tune_001.sid */
-		tail = list.emplace_after(tail,
-					  fmt::format(SUBTUNE_PREFIX "{:03}.sid", i),
+		tail = list.emplace_after(tail, std::move(name),
 					  tag_builder.Commit());
 	}
 
 	return list;
 }
 
+static void
+sidplay_prefetch(Path path_fs,
+		 [[maybe_unused]] AudioFormat preferred_format) noexcept
+{
+	/* load the file into #sid_image_cache, where
+	   sidplay_file_decode() will find it */
+	const auto container = ParseContainerPath(path_fs);
+	LoadSidImage(container.path);
+}
+
 static constexpr const char *sidplay_suffixes[] = {
 	"sid",
 	"psid",
@@ -504,8 +948,14 @@ static constexpr const char *sidplay_suffixes[] = {
 	nullptr
 };
 
+/* loading the ROMs and the song length database is expensive; only
+   do it when a SID file is seen for the first time */
+static DecoderLazyInit sidplay_lazy_init;
+
 constexpr DecoderPlugin sidplay_decoder_plugin =
 	DecoderPlugin("sidplay", sidplay_file_decode, sidplay_scan_file)
 	.WithInit(sidplay_init, sidplay_finish)
+	.WithLazyInit(sidplay_lazy_init)
 	.WithContainer(sidplay_container_scan)
+	.WithPrefetch(sidplay_prefetch)
 	.WithSuffixes(sidplay_suffixes);
@@ -2,7 +2,9 @@
 // Copyright The Music Player Daemon Project
 
 #include "UpseDecoderPlugin.hxx"
+#include "PsfLoader.hxx"
 #include "../DecoderAPI.hxx"
+#include "../EmuSeek.hxx"
 #include "Log.hxx"
 #include "pcm/CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -20,6 +22,7 @@ extern "C" {
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <string_view>
 
 using std::string_view_literals::operator""sv;
@@ -31,38 +34,83 @@ static constexpr unsigned UPSE_SAMPLE_RATE = 44100;
 
 static bool upse_initialized = false;
 
+/**
+ * An in-memory file handle for upse's I/O callbacks.  Library files
+ * are shared with the other PSF plugins through the PsfLoader cache.
+ */
+struct UpseFile {
+	std::shared_ptr<const PsfFileData> data;
+	std::size_t position = 0;
+};
+
 static void *
-Upse_fopen(const char *path, const char *mode)
+Upse_fopen(const char *path, const char *)
 {
-	return std::fopen(path, mode);
+	try {
+		const bool is_library = StringEndsWithIgnoreCase(path, ".psflib");
+		return new UpseFile{PsfReadFile(Path::FromFS(path), is_library)};
+	} catch (...) {
+		return nullptr;
+	}
 }
 
 static size_t
 Upse_fread(void *buffer, size_t size, size_t count, void *handle)
 {
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fread(buffer, size, count, f);
+	auto &f = *static_cast<UpseFile *>(handle);
+	if (size == 0)
+		return 0;
+
+	const std::size_t available = f.data->size() - f.position;
+	count = std::min(count, available / size);
+	std::memcpy(buffer, f.data->data() + f.position, count * size);
+	f.position += count * size;
+	return count;
 }
 
 static int
 Upse_fseek(void *handle, long offset, int whence)
 {
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fseek(f, offset, whence);
+	auto &f = *static_cast<UpseFile *>(handle);
+
+	long base;
+	switch (whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+
+	case SEEK_CUR:
+		base = static_cast<long>(f.position);
+		break;
+
+	case SEEK_END:
+		base = static_cast<long>(f.data->size());
+		break;
+
+	default:
+		return -1;
+	}
+
+	const long position = base + offset;
+	if (position < 0 || static_cast<std::size_t>(position) > f.data->size())
+		return -1;
+
+	f.position = static_cast<std::size_t>(position);
+	return 0;
 }
 
 static int
 Upse_fclose(void *handle)
 {
-	FILE *f = static_cast<FILE *>(handle);
-	return std::fclose(f);
+	delete static_cast<UpseFile *>(handle);
+	return 0;
 }
 
 static long
 Upse_ftell(void *handle)
 {
-	FILE *f = static_cast<FILE *>(handle);
-	return std::ftell(f);
+	const auto &f = *static_cast<const UpseFile *>(handle);
+	return static_cast<long>(f.position);
 }
 
 static const upse_iofuncs_t upse_io = {
@@ -236,9 +284,7 @@ upse_plugin_init([[maybe_unused]] const ConfigBlock &block)
 static bool
 upse_scan_file(Path path_fs, TagHandler &handler) noexcept
 {
-	const std::string path_utf8 = path_fs.ToUTF8();
-
-	upse_psf_t *meta = upse_get_psf_metadata(path_utf8.c_str(), &upse_io);
+	upse_psf_t *meta = upse_get_psf_metadata(path_fs.c_str(), &upse_io);
 	if (meta == nullptr)
 		return false;
 
@@ -258,17 +304,40 @@ upse_scan_file(Path path_fs, TagHandler &handler) noexcept
 	return true;
 }
 
+/**
+ * libupse has no way to save its state, so seeking backward restarts
+ * the song, but rendering and discarding audio here (instead of
+ * upse_eventloop_seek()) gives us the exact position.
+ */
+class UpseSeekHandler final : public EmuSeekHandler {
+	upse_module_t *const mod;
+
+public:
+	explicit UpseSeekHandler(upse_module_t *_mod) noexcept
+		:mod(_mod) {}
+
+	/* virtual methods from class EmuSeekHandler */
+	bool EmuRestart() noexcept override {
+		upse_eventloop_seek(mod, 0);
+		return true;
+	}
+
+	uint64_t EmuSkip(uint64_t) noexcept override {
+		int16_t *samples = nullptr;
+		const int frames = upse_eventloop_render(mod, &samples);
+		return frames > 0 ? frames : 0;
+	}
+};
+
 static void
 upse_file_decode(DecoderClient &client, Path path_fs)
 {
-	const std::string path_utf8 = path_fs.ToUTF8();
-
 	if (!upse_initialized) {
 		upse_module_init();
 		upse_initialized = true;
 	}
 
-	upse_module_t *mod = upse_module_open(path_utf8.c_str(), &upse_io);
+	upse_module_t *mod = upse_module_open(path_fs.c_str(), &upse_io);
 	if (mod == nullptr) {
 		LogWarning(upse_domain, "error loading file");
 		return;
@@ -301,11 +370,12 @@ upse_file_decode(DecoderClient &client, Path path_fs)
 
 	const bool has_length = meta != nullptr &&
 		GetUpseDurationMS(*meta) > 0;
-	const int64_t length_frames = has_length
-		? static_cast<int64_t>(GetUpseDurationMS(*meta)) *
-			sample_rate / 1000
+	const uint64_t length_frames = has_length
+		? uint64_t(GetUpseDurationMS(*meta)) * sample_rate / 1000
 		: 0;
-	int64_t frames_played = 0;
+
+	UpseSeekHandler seek_handler(mod);
+	EmuSeeker seeker(seek_handler, sample_rate);
 
 	DecoderCommand cmd = DecoderCommand::NONE;
 
@@ -322,20 +392,12 @@ upse_file_decode(DecoderClient &client, Path path_fs)
 			std::span{samples, static_cast<size_t>(frames * UPSE_CHANNELS)},
 			0);
 
-		frames_played += frames;
-		if (has_length && frames_played >= length_frames)
+		seeker.Advance(frames);
+		if (has_length && seeker.GetPosition() >= length_frames)
 			break;
 
-		if (cmd == DecoderCommand::SEEK) {
-			int64_t seek_ms = client.GetSeekTime().ToMS();
-			if (seek_ms < 0)
-				seek_ms = 0;
-
-			upse_eventloop_seek(mod, static_cast<uint32_t>(seek_ms));
-			if (has_length)
-				frames_played = seek_ms * sample_rate / 1000;
-			client.CommandFinished();
-		}
+		if (cmd == DecoderCommand::SEEK && !seeker.Seek(client))
+			break;
 	} while (cmd != DecoderCommand::STOP);
 }
 
@@ -348,4 +410,5 @@ static const char *const upse_suffixes[] = {
 constexpr DecoderPlugin upse_decoder_plugin =
 	DecoderPlugin("upse", upse_file_decode, upse_scan_file)
 	.WithInit(upse_plugin_init)
-	.WithSuffixes(upse_suffixes);
+	.WithSuffixes(upse_suffixes)
+	.WithSerialScan();
@@ -2,6 +2,8 @@
 // Copyright The Music Player Daemon Project
 
 #include "VgmstreamDecoderPlugin.hxx"
+#include "VgmstreamStream.hxx"
+#include "VgmstreamTags.hxx"
 #include "../DecoderAPI.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -121,32 +123,29 @@ VgmstreamScanTagFile(Path path, TagHandler &handler, ReplayGainInfo *rgi) noexce
 {
 	bool found_title = false;
 
-	const auto tags_path = AllocatedPath::Build(path.GetDirectoryName(), "!tags.m3u");
-	const std::string tags_path_utf8 = tags_path.ToUTF8();
-	libstreamfile_t *tags_file =
-		libstreamfile_open_from_stdio(tags_path_utf8.c_str());
-	if (tags_file == nullptr)
+	if (path.IsNull())
+		/* not a local file */
 		return false;
 
-	AtScopeExit(tags_file) { libstreamfile_close(tags_file); };
+	/* the parsed "!tags.m3u" is shared by all songs in this
+	   directory */
+	const auto tag_file = VgmstreamLoadTagFile(path.GetDirectoryName());
+	if (tag_file == nullptr)
+		return false;
 
-	libvgmstream_tags_t *tags = libvgmstream_tags_init(tags_file);
+	const auto *tags = tag_file->Find(path.GetBase().ToUTF8());
 	if (tags == nullptr)
 		return false;
 
-	AtScopeExit(tags) { libvgmstream_tags_free(tags); };
-
-	libvgmstream_tags_find(tags, path.GetBase().c_str());
-
-	while (libvgmstream_tags_next_tag(tags)) {
-		handler.OnPair(tags->key, tags->val);
+	for (const auto &[key, value] : *tags) {
+		handler.OnPair(key, value);
 
 		if (rgi)
-			ParseReplayGainTag(*rgi, tags->key, tags->val);
+			ParseReplayGainTag(*rgi, key.c_str(), value.c_str());
 
-		const TagType type = tag_name_parse_i(tags->key);
+		const TagType type = tag_name_parse_i(key);
 		if (type != TAG_NUM_OF_ITEM_TYPES)
-			handler.OnTag(type, tags->val);
+			handler.OnTag(type, value);
 
 		if (type == TAG_TITLE)
 			found_title = true;
@@ -155,6 +154,10 @@ VgmstreamScanTagFile(Path path, TagHandler &handler, ReplayGainInfo *rgi) noexce
 	return found_title;
 }
 
+/**
+ * @param path the local file path, used to look up "!tags.m3u"; may
+ * be nullptr for remote streams
+ */
 static void
 VgmstreamScanTags(Path path, const libvgmstream_t *lib, TagHandler &handler,
 		  ReplayGainInfo *rgi) noexcept
@@ -169,17 +172,52 @@ VgmstreamScanTags(Path path, const libvgmstream_t *lib, TagHandler &handler,
 		handler.OnTag(TAG_TITLE, lib->format->stream_name);
 }
 
-static void
-VgmstreamFileDecode(DecoderClient &client, Path path_fs)
+/**
+ * Submit packed 24 bit samples.  If possible, they are unpacked
+ * directly into the #MusicChunk; the given buffer is only used as a
+ * fallback if the #DecoderClient cannot hand out chunk memory.
+ */
+static DecoderCommand
+VgmstreamSubmitPcm24(DecoderClient &client, std::span<const uint8_t> src,
+		     std::vector<int32_t> &unpack_buffer) noexcept
 {
-	const auto [path, subsong] = ParseContainerPath(path_fs);
+	DecoderCommand cmd = DecoderCommand::NONE;
 
-	libstreamfile_t *file = libstreamfile_open_from_stdio(path.c_str());
-	if (file == nullptr)
-		return;
+	while (!src.empty()) {
+		const auto dest = client.GetAudioBuffer(nullptr, 0);
+		if (dest.empty())
+			break;
 
-	AtScopeExit(file) { libstreamfile_close(file); };
+		/* both sizes are multiples of the frame size */
+		const std::size_t n_samples = std::min(dest.size() / sizeof(int32_t),
+						       src.size() / 3);
+		const auto chunk = src.first(n_samples * 3);
+		pcm_unpack_24(reinterpret_cast<int32_t *>(dest.data()),
+			      chunk.data(), chunk.data() + chunk.size());
+		src = src.subspan(chunk.size());
+
+		cmd = client.CommitAudio(n_samples * sizeof(int32_t));
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+	}
 
+	if (src.empty())
+		return cmd;
+
+	unpack_buffer.resize(src.size() / 3);
+	pcm_unpack_24(unpack_buffer.data(), src.data(),
+		      src.data() + src.size());
+
+	return client.SubmitAudio(nullptr, std::span{unpack_buffer}, 0);
+}
+
+/**
+ * @param path the local file path (for "!tags.m3u"); may be nullptr
+ */
+static void
+VgmstreamDecode(DecoderClient &client, libstreamfile_t *file, int subsong,
+		Path path)
+{
 	libvgmstream_t *lib = libvgmstream_create(file, subsong, &vgmstream_config);
 	if (lib == nullptr)
 		return;
@@ -220,13 +258,9 @@ VgmstreamFileDecode(DecoderClient &client, Path path_fs)
 			break;
 
 		if (lib->format->sample_format == LIBVGMSTREAM_SFMT_PCM24) {
-			auto *src = static_cast<const uint8_t *>(lib->decoder->buf);
-
-			unpack_buffer.resize(lib->decoder->buf_bytes / 3);
-			pcm_unpack_24(unpack_buffer.data(), src,
-				      src + lib->decoder->buf_bytes);
-
-			cmd = client.SubmitAudio(nullptr, std::span{unpack_buffer}, 0);
+			const std::span src{static_cast<const uint8_t *>(lib->decoder->buf),
+					    static_cast<std::size_t>(lib->decoder->buf_bytes)};
+			cmd = VgmstreamSubmitPcm24(client, src, unpack_buffer);
 		} else {
 			const std::span span(static_cast<std::byte *>(lib->decoder->buf),
 					     lib->decoder->buf_bytes);
@@ -246,6 +280,44 @@ VgmstreamFileDecode(DecoderClient &client, Path path_fs)
 	} while (cmd == DecoderCommand::NONE);
 }
 
+static void
+VgmstreamFileDecode(DecoderClient &client, Path path_fs)
+{
+	const auto [path, subsong] = ParseContainerPath(path_fs);
+
+	libstreamfile_t *file = libstreamfile_open_from_stdio(path.c_str());
+	if (file == nullptr)
+		return;
+
+	AtScopeExit(file) { libstreamfile_close(file); };
+
+	VgmstreamDecode(client, file, subsong, path);
+}
+
+static void
+VgmstreamStreamDecode(DecoderClient &client, InputStream &is)
+{
+	libstreamfile_t *file = VgmstreamOpenInputStream(&client, is);
+	AtScopeExit(file) { libstreamfile_close(file); };
+
+	VgmstreamDecode(client, file, 0, nullptr);
+}
+
+/**
+ * Report the metadata of the subsong which is currently open in the
+ * given #libvgmstream_t instance.
+ */
+static void
+VgmstreamScanLib(Path path, const libvgmstream_t *lib,
+		 TagHandler &handler) noexcept
+{
+	handler.OnDuration(
+		SongTime::FromScale(lib->format->play_samples, lib->format->sample_rate));
+	handler.OnAudioFormat(VgmstreamGetFormat(lib));
+
+	VgmstreamScanTags(path, lib, handler, nullptr);
+}
+
 static bool
 VgmstreamScanSong(Path path, int subsong, TagHandler &handler) noexcept
 {
@@ -261,12 +333,7 @@ VgmstreamScanSong(Path path, int subsong, TagHandler &handler) noexcept
 
 	AtScopeExit(lib) { libvgmstream_free(lib); };
 
-	handler.OnDuration(
-		SongTime::FromScale(lib->format->play_samples, lib->format->sample_rate));
-	handler.OnAudioFormat(VgmstreamGetFormat(lib));
-
-	VgmstreamScanTags(path, lib, handler, nullptr);
-
+	VgmstreamScanLib(path, lib, handler);
 	return true;
 }
 
@@ -277,35 +344,81 @@ VgmstreamScanFile(Path path_fs, TagHandler &handler) noexcept
 	return VgmstreamScanSong(path, subsong, handler);
 }
 
+static bool
+VgmstreamScanStream(InputStream &is, TagHandler &handler) noexcept
+{
+	libstreamfile_t *file = VgmstreamOpenInputStream(nullptr, is);
+	AtScopeExit(file) { libstreamfile_close(file); };
+
+	libvgmstream_t *lib = libvgmstream_create(file, 0, &vgmstream_config);
+	if (lib == nullptr)
+		return false;
+
+	AtScopeExit(lib) { libvgmstream_free(lib); };
+
+	VgmstreamScanLib(nullptr, lib, handler);
+	return true;
+}
+
 static std::forward_list<DetachedSong>
 VgmstreamContainerScan(Path path_fs)
 {
 	std::forward_list<DetachedSong> list;
 	const auto [path, subsong] = ParseContainerPath(path_fs);
 
+	/* open the container file only once and let one
+	   libvgmstream_t instance walk over all subsongs; opening
+	   a stream only parses its header, so this never decodes
+	   audio, and the libstreamfile_t keeps its buffer across
+	   subsongs instead of re-reading the bank from scratch */
 	libstreamfile_t *file = libstreamfile_open_from_stdio(path.c_str());
 	if (file == nullptr)
 		return list;
 
 	AtScopeExit(file) { libstreamfile_close(file); };
 
-	libvgmstream_t *lib = libvgmstream_create(file, subsong, &vgmstream_config);
+	libvgmstream_t *lib = libvgmstream_init();
 	if (lib == nullptr)
 		return list;
 
 	AtScopeExit(lib) { libvgmstream_free(lib); };
 
-	if (lib->format->subsong_count < 2)
+	libvgmstream_setup(lib, &vgmstream_config);
+
+	if (libvgmstream_open_stream(lib, file, subsong) < 0)
+		return list;
+
+	const int subsong_count = lib->format->subsong_count;
+	if (subsong_count < 2)
 		return list;
 
+	/* the default stream (subsong 0) is the first one */
+	int current = lib->format->subsong_index > 0
+		? lib->format->subsong_index
+		: 1;
+
 	const Path subsong_suffix = Path::FromFS(path_fs.GetExtension());
 
 	TagBuilder tag_builder;
 
 	auto tail = list.before_begin();
-	for (int i = 1; i <= lib->format->subsong_count; ++i) {
-		AddTagHandler h(tag_builder);
-		VgmstreamScanSong(path, i, h);
+	for (int i = 1; i <= subsong_count; ++i) {
+		if (i != current) {
+			libvgmstream_close_stream(lib);
+			current = libvgmstream_open_stream(lib, file, i) < 0
+				? 0
+				: i;
+		}
+
+		/* a subsong which cannot be opened is still listed,
+		   just without tags */
+		if (current == i) {
+			AddTagHandler h(tag_builder);
+			VgmstreamScanLib(path, lib, h);
+		} else
+			FmtWarning(vgmstream_domain,
+				   "Failed to open subsong {} of {:?}",
+				   i, path);
 
 		auto track_name =
 			fmt::format(SUBSONG_PREFIX "{:03}.{}", i, subsong_suffix);
@@ -317,7 +430,7 @@ VgmstreamContainerScan(Path path_fs)
 }
 
 static std::set<std::string, std::less<>>
-VgmstreamSuffixes() noexcept
+BuildVgmstreamSuffixes() noexcept
 {
 	std::set<std::string, std::less<>> suffixes;
 
@@ -344,8 +457,18 @@ VgmstreamSuffixes() noexcept
 	return suffixes;
 }
 
+static std::set<std::string, std::less<>>
+VgmstreamSuffixes() noexcept
+{
+	/* the list is built only once, on the first call */
+	static const auto suffixes = BuildVgmstreamSuffixes();
+	return suffixes;
+}
+
 constexpr DecoderPlugin vgmstream_decoder_plugin =
-	DecoderPlugin("vgmstream", VgmstreamFileDecode, VgmstreamScanFile)
+	DecoderPlugin("vgmstream",
+		      VgmstreamStreamDecode, VgmstreamScanStream,
+		      VgmstreamFileDecode, VgmstreamScanFile)
 		.WithInit(VgmstreamInit)
 		.WithContainer(VgmstreamContainerScan)
 		.WithSuffixes(VgmstreamSuffixes);
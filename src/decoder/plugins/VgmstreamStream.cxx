@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "VgmstreamStream.hxx"
+#include "../DecoderAPI.hxx"
+#include "input/InputStream.hxx"
+#include "util/AllocatedArray.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <string>
+
+namespace {
+
+class VgmstreamInputFile {
+	/**
+	 * How much data is read at a time?  vgmstream probes
+	 * headers with many tiny reads all over the file, which
+	 * would be very expensive on network storage.
+	 */
+	static constexpr std::size_t READ_AHEAD = 64 * 1024;
+
+	libstreamfile_t libsf;
+
+	DecoderClient *const client;
+
+	/**
+	 * Only set if this object has opened the stream (for a
+	 * companion file).
+	 */
+	InputStreamPtr owned_is;
+
+	InputStream &is;
+
+	/**
+	 * The name returned by get_name(); vgmstream derives companion
+	 * file names from this, which are then passed to open()
+	 */
+	const std::string name;
+
+	/**
+	 * The logical position of the vgmstream reader.
+	 */
+	offset_type position = 0;
+
+	AllocatedArray<std::byte> buffer{READ_AHEAD};
+
+	/**
+	 * The stream offset of the first byte in #buffer.
+	 */
+	offset_type buffer_offset = 0;
+
+	/**
+	 * The number of valid bytes in #buffer.
+	 */
+	std::size_t buffer_fill = 0;
+
+	VgmstreamInputFile(DecoderClient *_client,
+			   InputStreamPtr &&_owned_is, InputStream &_is) noexcept
+		:client(_client), owned_is(std::move(_owned_is)), is(_is),
+		 name(is.GetURI())
+	{
+		libsf.user_data = this;
+		libsf.read = Read;
+		libsf.seek = Seek;
+		libsf.get_size = GetSize;
+		libsf.get_name = GetName;
+		libsf.open = Open;
+		libsf.close = Close;
+	}
+
+public:
+	static libstreamfile_t *Create(DecoderClient *client,
+				       InputStreamPtr &&owned_is,
+				       InputStream &is) noexcept {
+		auto *file = new VgmstreamInputFile(client,
+						    std::move(owned_is), is);
+		return &file->libsf;
+	}
+
+private:
+	static VgmstreamInputFile &Cast(void *user_data) noexcept {
+		return *static_cast<VgmstreamInputFile *>(user_data);
+	}
+
+	/**
+	 * Read directly from the #InputStream at the given offset.
+	 *
+	 * @return the number of bytes read, 0 on end of file, error
+	 * or decoder command
+	 */
+	std::size_t ReadAt(offset_type offset, std::span<std::byte> dest) noexcept;
+
+	/**
+	 * Discard the buffer and read more data starting at the
+	 * given offset.
+	 */
+	bool Fill(offset_type offset) noexcept;
+
+	int Read(std::span<std::byte> dest) noexcept;
+	int64_t Seek(int64_t offset, int whence) noexcept;
+
+	/* libstreamfile_t callbacks */
+
+	static int Read(void *user_data, uint8_t *dst, int dst_size) noexcept {
+		if (dst_size <= 0)
+			return 0;
+
+		return Cast(user_data).Read({reinterpret_cast<std::byte *>(dst),
+					     static_cast<std::size_t>(dst_size)});
+	}
+
+	static int64_t Seek(void *user_data, int64_t offset, int whence) noexcept {
+		return Cast(user_data).Seek(offset, whence);
+	}
+
+	static int64_t GetSize(void *user_data) noexcept {
+		const auto &is = Cast(user_data).is;
+		return is.KnownSize()
+			? static_cast<int64_t>(is.GetSize())
+			: 0;
+	}
+
+	static const char *GetName(void *user_data) noexcept {
+		return Cast(user_data).name.c_str();
+	}
+
+	static libstreamfile_t *Open(void *user_data,
+				     const char *filename) noexcept;
+
+	static void Close(libstreamfile_t *libsf) noexcept {
+		delete &Cast(libsf->user_data);
+	}
+};
+
+std::size_t
+VgmstreamInputFile::ReadAt(offset_type offset,
+			   std::span<std::byte> dest) noexcept
+{
+	try {
+		if (is.GetOffset() != offset) {
+			if (!is.IsSeekable() && is.GetOffset() > offset)
+				return 0;
+
+			is.LockSeek(offset);
+		}
+	} catch (...) {
+		LogError(std::current_exception(), "vgmstream: seek failed");
+		return 0;
+	}
+
+	std::size_t total = 0;
+	while (!dest.empty()) {
+		const std::size_t nbytes = decoder_read(client, is, dest);
+		if (nbytes == 0)
+			break;
+
+		dest = dest.subspan(nbytes);
+		total += nbytes;
+	}
+
+	return total;
+}
+
+bool
+VgmstreamInputFile::Fill(offset_type offset) noexcept
+{
+	buffer_offset = offset;
+	buffer_fill = ReadAt(offset, buffer);
+	return buffer_fill > 0;
+}
+
+int
+VgmstreamInputFile::Read(std::span<std::byte> dest) noexcept
+{
+	std::size_t total = 0;
+
+	while (!dest.empty()) {
+		if (position < buffer_offset ||
+		    position >= buffer_offset + buffer_fill) {
+			if (dest.size() >= buffer.size()) {
+				/* large read: bypass the buffer */
+				const std::size_t nbytes = ReadAt(position, dest);
+				position += nbytes;
+				total += nbytes;
+				break;
+			}
+
+			if (!Fill(position))
+				break;
+		}
+
+		const std::size_t skip = position - buffer_offset;
+		const std::size_t nbytes = std::min(dest.size(),
+						    buffer_fill - skip);
+		std::memcpy(dest.data(), buffer.data() + skip, nbytes);
+
+		dest = dest.subspan(nbytes);
+		position += nbytes;
+		total += nbytes;
+	}
+
+	return static_cast<int>(total);
+}
+
+int64_t
+VgmstreamInputFile::Seek(int64_t offset, int whence) noexcept
+{
+	switch (whence) {
+	case LIBSTREAMFILE_SEEK_SET:
+		break;
+
+	case LIBSTREAMFILE_SEEK_CUR:
+		offset += position;
+		break;
+
+	case LIBSTREAMFILE_SEEK_END:
+		if (!is.KnownSize())
+			return -1;
+
+		offset += is.GetSize();
+		break;
+
+	default:
+		return -1;
+	}
+
+	if (offset < 0)
+		return -1;
+
+	/* this only moves the logical position; the #InputStream
+	   is seeked lazily by the next read which misses the
+	   buffer */
+	position = offset;
+	return offset;
+}
+
+libstreamfile_t *
+VgmstreamInputFile::Open(void *user_data, const char *filename) noexcept
+{
+	auto &file = Cast(user_data);
+
+	if (file.name == filename)
+		/* reopening the same file: share the stream */
+		return Create(file.client, nullptr, file.is);
+
+	try {
+		auto is = file.client != nullptr
+			? file.client->OpenUri(filename)
+			: InputStream::OpenReady(filename, file.is.mutex);
+
+		auto &r = *is;
+		return Create(file.client, std::move(is), r);
+	} catch (const StopDecoder &) {
+		return nullptr;
+	} catch (...) {
+		LogError(std::current_exception(), "vgmstream: failed to open companion file");
+		return nullptr;
+	}
+}
+
+} // anonymous namespace
+
+libstreamfile_t *
+VgmstreamOpenInputStream(DecoderClient *client, InputStream &is) noexcept
+{
+	return VgmstreamInputFile::Create(client, nullptr, is);
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+extern "C" {
+#include <vgmstream/libvgmstream.h>
+}
+
+class DecoderClient;
+class InputStream;
+
+/**
+ * Wrap an #InputStream in a #libstreamfile_t.  Reads are served from
+ * a read-ahead buffer, which turns the many small header reads
+ * vgmstream does into a few large #InputStream reads.  Companion
+ * files (e.g. the ".awb" belonging to an ".acb") are opened through
+ * the #DecoderClient (or directly if there is none).
+ *
+ * The caller keeps ownership of the #InputStream; the returned
+ * object must be freed with libstreamfile_close().
+ *
+ * @param client the decoder client; may be nullptr while scanning
+ */
+libstreamfile_t *
+VgmstreamOpenInputStream(DecoderClient *client, InputStream &is) noexcept;
@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "VgmstreamTags.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Path.hxx"
+#include "io/FileLineReader.hxx"
+#include "thread/Mutex.hxx"
+#include "util/CharUtil.hxx"
+#include "util/StringStrip.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+
+static std::string
+LowerCaseASCII(std::string_view src) noexcept
+{
+	std::string dest;
+	dest.reserve(src.size());
+	for (const char ch : src)
+		dest.push_back(ToLowerASCII(ch));
+	return dest;
+}
+
+/**
+ * Returns the UTF-8 name of the directory containing the given file
+ * (for "$AUTOALBUM").
+ */
+static std::string
+GetDirectoryName(Path path_fs) noexcept
+{
+	const auto directory = path_fs.GetDirectoryName();
+	if (directory.IsNull())
+		return {};
+
+	const Path base = Path{directory}.GetBase();
+	if (base.IsNull())
+		return {};
+
+	return base.ToUTF8();
+}
+
+/**
+ * Set (or replace) a tag in the given list.
+ */
+static void
+SetTag(VgmstreamTagFile::PairList &list,
+       std::string_view key, std::string_view value) noexcept
+{
+	auto i = std::find_if(list.begin(), list.end(), [key](const auto &p){
+		return p.first == key;
+	});
+
+	if (i != list.end())
+		i->second = value;
+	else
+		list.emplace_back(key, value);
+}
+
+/**
+ * Parse a tag line like "@ALBUM  value" (after the leading '#').
+ *
+ * @return false if this is not a valid tag line
+ */
+static bool
+ParseTagLine(std::string_view line,
+	     std::string_view &key, std::string_view &value) noexcept
+{
+	const auto end = std::find_if(line.begin(), line.end(), [](char ch){
+		return IsWhitespaceOrNull(ch);
+	});
+
+	key = {line.begin(), end};
+	if (key.empty())
+		return false;
+
+	value = Strip(std::string_view{end, line.end()});
+	return true;
+}
+
+VgmstreamTagFile::VgmstreamTagFile(Path path_fs)
+{
+	FileLineReader reader(path_fs);
+
+	/* tags preceded by '@' apply to all following files */
+	PairList global;
+
+	/* tags preceded by '%' apply only to the next file */
+	PairList local;
+
+	bool auto_track = false;
+	unsigned track = 0;
+
+	char *line;
+	while ((line = reader.ReadLine()) != nullptr) {
+		std::string_view s = Strip(std::string_view{line});
+		if (s.empty())
+			continue;
+
+		if (s.front() == '#') {
+			s = StripLeft(s.substr(1));
+			if (s.empty())
+				continue;
+
+			const char type = s.front();
+			std::string_view key, value;
+			if (!ParseTagLine(s.substr(1), key, value))
+				continue;
+
+			switch (type) {
+			case '@':
+				SetTag(global, key, value);
+				break;
+
+			case '%':
+				SetTag(local, key, value);
+				break;
+
+			case '$':
+				if (key == "AUTOTRACK")
+					auto_track = true;
+				else if (key == "AUTOALBUM")
+					SetTag(global, "ALBUM",
+					       GetDirectoryName(path_fs));
+				break;
+			}
+
+			continue;
+		}
+
+		/* this is a file name; vgmstream matches only the
+		   base name */
+		if (const auto slash = s.find_last_of("/\\");
+		    slash != s.npos)
+			s = s.substr(slash + 1);
+
+		++track;
+
+		PairList tags = global;
+		if (auto_track)
+			SetTag(tags, "TRACK", std::to_string(track));
+
+		for (auto &i : local)
+			SetTag(tags, i.first, i.second);
+
+		local.clear();
+
+		files.insert_or_assign(LowerCaseASCII(s), std::move(tags));
+	}
+}
+
+const VgmstreamTagFile::PairList *
+VgmstreamTagFile::Find(std::string_view filename) const noexcept
+{
+	auto i = files.find(LowerCaseASCII(filename));
+	return i != files.end()
+		? &i->second
+		: nullptr;
+}
+
+namespace {
+
+struct CachedTagFile {
+	AllocatedPath path;
+	std::chrono::system_clock::time_point mtime;
+	std::shared_ptr<const VgmstreamTagFile> file;
+};
+
+/**
+ * How many directories are remembered?  The update walker and the
+ * decoder visit one directory at a time, so a few entries are
+ * enough.
+ */
+static constexpr std::size_t MAX_CACHED_TAG_FILES = 4;
+
+static Mutex tag_file_cache_mutex;
+
+/**
+ * The most recently used entry is at the front.
+ */
+static std::list<CachedTagFile> tag_file_cache;
+
+} // anonymous namespace
+
+std::shared_ptr<const VgmstreamTagFile>
+VgmstreamLoadTagFile(Path directory_fs) noexcept
+{
+	auto path = AllocatedPath::Build(directory_fs, "!tags.m3u");
+
+	FileInfo info;
+	if (!GetFileInfo(path, info) || !info.IsRegular())
+		return nullptr;
+
+	const auto mtime = info.GetModificationTime();
+
+	{
+		const std::scoped_lock lock{tag_file_cache_mutex};
+
+		for (auto i = tag_file_cache.begin();
+		     i != tag_file_cache.end(); ++i) {
+			if (i->path != path)
+				continue;
+
+			if (i->mtime != mtime) {
+				/* modified: reload */
+				tag_file_cache.erase(i);
+				break;
+			}
+
+			tag_file_cache.splice(tag_file_cache.begin(),
+					      tag_file_cache, i);
+			return i->file;
+		}
+	}
+
+	std::shared_ptr<const VgmstreamTagFile> file;
+
+	try {
+		file = std::make_shared<const VgmstreamTagFile>(path);
+	} catch (...) {
+		LogError(std::current_exception());
+		return nullptr;
+	}
+
+	const std::scoped_lock lock{tag_file_cache_mutex};
+
+	std::erase_if(tag_file_cache, [&path](const auto &i){
+		return i.path == path;
+	});
+
+	tag_file_cache.push_front({std::move(path), mtime, file});
+	if (tag_file_cache.size() > MAX_CACHED_TAG_FILES)
+		tag_file_cache.pop_back();
+
+	return file;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Path;
+
+/**
+ * The parsed contents of a vgmstream "!tags.m3u" file.
+ */
+class VgmstreamTagFile {
+public:
+	using Pair = std::pair<std::string, std::string>;
+	using PairList = std::vector<Pair>;
+
+private:
+	/**
+	 * Maps the lower-case file name to all tags which apply to
+	 * it (global and local ones, in file order).
+	 */
+	std::map<std::string, PairList, std::less<>> files;
+
+public:
+	/**
+	 * Throws on I/O error.
+	 */
+	explicit VgmstreamTagFile(Path path_fs);
+
+	/**
+	 * Look up the tags of the given file (base name only).
+	 * Comparison is case-insensitive, just like vgmstream does
+	 * it.
+	 *
+	 * @return the list of tags or nullptr if there are none
+	 */
+	[[gnu::pure]]
+	const PairList *Find(std::string_view filename) const noexcept;
+};
+
+/**
+ * Obtain the parsed "!tags.m3u" file in the given directory.  The
+ * result is cached (keyed by path and modification time), so all
+ * songs in one directory share one parsed instance.  This function
+ * is thread-safe.
+ *
+ * @return the parsed file or nullptr if there is no such file or if
+ * it could not be read
+ */
+std::shared_ptr<const VgmstreamTagFile>
+VgmstreamLoadTagFile(Path directory_fs) noexcept;
@@ -3,6 +3,7 @@
 
 #include "WildmidiDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../LazyInit.hxx"
 #include "tag/Handler.hxx"
 #include "util/ScopeExit.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -155,7 +156,12 @@ static constexpr const char *wildmidi_suffixes[] = {
 	nullptr
 };
 
+/* WildMidi_Init() loads all GUS patches */
+static DecoderLazyInit wildmidi_lazy_init;
+
 constexpr DecoderPlugin wildmidi_decoder_plugin =
 	DecoderPlugin("wildmidi", wildmidi_file_decode, wildmidi_scan_file)
 	.WithInit(wildmidi_init, wildmidi_finish)
-	.WithSuffixes(wildmidi_suffixes);
+	.WithLazyInit(wildmidi_lazy_init)
+	.WithSuffixes(wildmidi_suffixes)
+	.WithSerialScan();
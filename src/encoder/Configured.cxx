@@ -4,10 +4,14 @@
 #include "Configured.hxx"
 #include "EncoderList.hxx"
 #include "EncoderPlugin.hxx"
+#include "EncoderInterface.hxx"
+#include "SharedEncoder.hxx"
 #include "config/Block.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/StringAPI.hxx"
 
+#include <memory>
+
 static const EncoderPlugin &
 GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 {
@@ -35,6 +39,12 @@ GetConfiguredEncoderPlugin(const ConfigBlock &block, bool shout_legacy)
 PreparedEncoder *
 CreateConfiguredEncoder(const ConfigBlock &block, bool shout_legacy)
 {
-	return encoder_init(GetConfiguredEncoderPlugin(block, shout_legacy),
-			    block);
+	const auto &plugin = GetConfiguredEncoderPlugin(block, shout_legacy);
+	std::unique_ptr<PreparedEncoder> prepared{encoder_init(plugin, block)};
+
+	if (const char *group = block.GetBlockValue("encoder_group"))
+		return CreateSharedEncoder(group, plugin.name,
+					   std::move(prepared));
+
+	return prepared.release();
 }
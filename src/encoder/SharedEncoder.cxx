@@ -0,0 +1,543 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "SharedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "thread/Mutex.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/**
+ * Members which lag behind the encoder by more than this duration of
+ * PCM data are detached, and encoded pages older than that are
+ * discarded even if not all members have read them.  This happens
+ * when a member stops submitting data, e.g. an "httpd" output
+ * without clients.
+ */
+static constexpr unsigned SHARED_ENCODER_MAX_LAG_S = 30;
+
+/**
+ * The state shared by all members of an encoder group.
+ */
+class SharedEncoderGroup {
+	friend class SharedEncoder;
+	friend class PreparedSharedEncoder;
+
+	const std::string plugin_name;
+
+	const std::unique_ptr<PreparedEncoder> prepared;
+
+	Mutex mutex;
+
+	/**
+	 * The shared encoder; it exists while at least one member is
+	 * open.
+	 */
+	std::unique_ptr<Encoder> encoder;
+
+	/**
+	 * The input audio format of #encoder.
+	 */
+	AudioFormat audio_format;
+
+	/**
+	 * The number of open members (#SharedEncoder instances).
+	 */
+	unsigned n_open = 0;
+
+	/**
+	 * The number of PCM bytes submitted to #encoder.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The number of PCM bytes corresponding to
+	 * #SHARED_ENCODER_MAX_LAG_S.
+	 */
+	uint_least64_t max_lag;
+
+	/**
+	 * The stream header to be sent first to members which join.
+	 * It is generated by Open() and replaced by each new
+	 * (chained) Ogg stream started by SendTag().
+	 */
+	std::vector<std::byte> header;
+
+	/**
+	 * The value of #position when the last tag was sent; this
+	 * avoids sending the same tag again for other members at
+	 * the same position.
+	 */
+	uint_least64_t tag_position;
+	bool tag_sent;
+
+	struct Page {
+		/**
+		 * The value of #position after this page was
+		 * generated.  Members may read it only after they
+		 * have submitted that much PCM data.
+		 */
+		uint_least64_t pcm_end;
+
+		/**
+		 * The number of open members which have not yet read
+		 * this page.
+		 */
+		unsigned readers;
+
+		std::vector<std::byte> data;
+	};
+
+	/**
+	 * Encoded data which has not yet been read by all members.
+	 */
+	std::deque<Page> pages;
+
+	/**
+	 * The absolute number of pages.front().
+	 */
+	uint_least64_t first_page;
+
+public:
+	SharedEncoderGroup(const char *_plugin_name,
+			   std::unique_ptr<PreparedEncoder> &&_prepared) noexcept
+		:plugin_name(_plugin_name), prepared(std::move(_prepared)) {}
+
+	const char *GetPluginName() const noexcept {
+		return plugin_name.c_str();
+	}
+
+	const char *GetMimeType() const noexcept {
+		return prepared->GetMimeType();
+	}
+
+	/**
+	 * Add an open member; open the encoder if this is the first
+	 * one.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Open(AudioFormat &_audio_format);
+
+	/**
+	 * Release a member's claim on all pages it has not yet read.
+	 * Caller must lock the mutex.
+	 *
+	 * @param next_page the absolute number of the next page the
+	 * member would have read
+	 */
+	void Release(uint_least64_t next_page) noexcept;
+
+	/**
+	 * Remove an open member.  Caller must lock the mutex.
+	 *
+	 * @param next_page the absolute number of the next page the
+	 * member would have read
+	 */
+	void Close(uint_least64_t next_page) noexcept;
+
+	/**
+	 * Read all data from #encoder.  Caller must lock the mutex.
+	 */
+	std::vector<std::byte> ReadAll();
+
+	/**
+	 * Append a new page.  Caller must lock the mutex.
+	 */
+	void Push(std::vector<std::byte> &&data) noexcept {
+		pages.push_back({position, n_open, std::move(data)});
+		DropStale();
+	}
+
+	/**
+	 * Move all data from #encoder to a new page.  Caller must
+	 * lock the mutex.
+	 */
+	void Drain();
+
+	/**
+	 * Remove pages which have been read by all members.
+	 */
+	void Trim() noexcept {
+		while (!pages.empty() && pages.front().readers == 0) {
+			pages.pop_front();
+			++first_page;
+		}
+	}
+
+	/**
+	 * Remove pages older than #max_lag, even if some members
+	 * have not read them; those members will be detached (see
+	 * SharedEncoder::IsDetached()).  This bounds the queue.
+	 */
+	void DropStale() noexcept {
+		while (!pages.empty() &&
+		       pages.front().pcm_end + max_lag < position) {
+			pages.pop_front();
+			++first_page;
+		}
+	}
+
+	uint_least64_t GetEndPage() const noexcept {
+		return first_page + pages.size();
+	}
+};
+
+void
+SharedEncoderGroup::Open(AudioFormat &_audio_format)
+{
+	if (encoder == nullptr) {
+		assert(n_open == 0);
+
+		AudioFormat f = _audio_format;
+		encoder.reset(prepared->Open(f));
+		audio_format = f;
+		position = 0;
+		max_lag = uint_least64_t{SHARED_ENCODER_MAX_LAG_S} *
+			f.sample_rate * f.channels *
+			sample_format_size(f.format);
+		tag_sent = false;
+		pages.clear();
+		first_page = 0;
+
+		try {
+			header = ReadAll();
+		} catch (...) {
+			encoder.reset();
+			throw;
+		}
+	}
+
+	/* all members must submit the same PCM data; the output
+	   converts to the format the encoder was opened with */
+	_audio_format = audio_format;
+	++n_open;
+}
+
+void
+SharedEncoderGroup::Release(uint_least64_t next_page) noexcept
+{
+	for (auto i = std::max(next_page, first_page); i < GetEndPage(); ++i) {
+		auto &page = pages[i - first_page];
+		assert(page.readers > 0);
+		--page.readers;
+	}
+
+	Trim();
+}
+
+void
+SharedEncoderGroup::Close(uint_least64_t next_page) noexcept
+{
+	assert(n_open > 0);
+
+	Release(next_page);
+
+	if (--n_open == 0) {
+		encoder.reset();
+		pages.clear();
+		header.clear();
+	}
+}
+
+std::vector<std::byte>
+SharedEncoderGroup::ReadAll()
+{
+	std::vector<std::byte> result;
+
+	while (true) {
+		std::byte buffer[8192];
+		const auto r = encoder->Read(buffer);
+		if (r.empty())
+			break;
+
+		result.insert(result.end(), r.begin(), r.end());
+	}
+
+	return result;
+}
+
+void
+SharedEncoderGroup::Drain()
+{
+	auto data = ReadAll();
+	if (!data.empty())
+		Push(std::move(data));
+}
+
+/**
+ * A member of a #SharedEncoderGroup.
+ */
+class SharedEncoder final : public Encoder {
+	const std::shared_ptr<SharedEncoderGroup> group_ptr;
+	SharedEncoderGroup &group;
+
+	/**
+	 * The number of PCM bytes submitted by this member.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The absolute number of the next page to be read.
+	 */
+	uint_least64_t next_page;
+
+	/**
+	 * The number of bytes of the next page which have already
+	 * been read.
+	 */
+	std::size_t page_offset = 0;
+
+	/**
+	 * A copy of SharedEncoderGroup::header which was not yet
+	 * read.
+	 */
+	std::vector<std::byte> header;
+	std::size_t header_offset = 0;
+
+public:
+	/**
+	 * Caller must lock the group's mutex and must have called
+	 * SharedEncoderGroup::Open().
+	 */
+	explicit SharedEncoder(std::shared_ptr<SharedEncoderGroup> _group) noexcept
+		:Encoder(_group->encoder->ImplementsTag()),
+		 group_ptr(std::move(_group)), group(*group_ptr),
+		 position(group.position),
+		 next_page(group.GetEndPage()),
+		 header(group.header) {}
+
+	~SharedEncoder() noexcept override {
+		const std::scoped_lock lock{group.mutex};
+		group.Close(next_page);
+	}
+
+	SharedEncoder(const SharedEncoder &) = delete;
+	SharedEncoder &operator=(const SharedEncoder &) = delete;
+
+	/* virtual methods from class Encoder */
+	void End() override;
+	void Flush() override;
+	void SendTag(const Tag &tag) override;
+	void Write(std::span<const std::byte> src) override;
+	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override;
+
+private:
+	/**
+	 * Has this member submitted as much data as the encoder has
+	 * received?  Commands affecting the encoder are executed
+	 * only by this "leading" member; the others will read the
+	 * result.
+	 */
+	bool IsLeading() const noexcept {
+		return position == group.position;
+	}
+
+	/**
+	 * Has this member fallen behind so far that pages it has not
+	 * read were discarded, or that its PCM data cannot be
+	 * matched with the encoded stream anymore?  This happens if
+	 * it has stopped submitting data for a while.  Caller must
+	 * lock the group's mutex.
+	 */
+	bool IsDetached() const noexcept {
+		return next_page < group.first_page ||
+			position + group.max_lag < group.position;
+	}
+
+	/**
+	 * Skip everything this member has missed and continue at the
+	 * current end of the stream, beginning with the stream
+	 * header.  Caller must lock the group's mutex.
+	 */
+	void Rejoin() noexcept;
+};
+
+void
+SharedEncoder::Rejoin() noexcept
+{
+	group.Release(next_page);
+
+	position = group.position;
+	next_page = group.GetEndPage();
+	page_offset = 0;
+	header = group.header;
+	header_offset = 0;
+}
+
+void
+SharedEncoder::End()
+{
+	const std::scoped_lock lock{group.mutex};
+
+	/* the stream continues for the other members; only the last
+	   one ends it */
+	if (group.n_open == 1) {
+		group.encoder->End();
+		group.Drain();
+	}
+}
+
+void
+SharedEncoder::Flush()
+{
+	const std::scoped_lock lock{group.mutex};
+
+	if (IsLeading()) {
+		group.encoder->Flush();
+		group.Drain();
+	}
+}
+
+void
+SharedEncoder::SendTag(const Tag &tag)
+{
+	const std::scoped_lock lock{group.mutex};
+
+	if (!IsLeading() ||
+	    (group.tag_sent && group.tag_position == group.position))
+		/* another member has already sent this tag */
+		return;
+
+	group.tag_sent = true;
+	group.tag_position = group.position;
+
+	group.encoder->PreTag();
+	group.Drain();
+
+	group.encoder->SendTag(tag);
+	auto data = group.ReadAll();
+	if (data.empty())
+		return;
+
+	/* for Ogg based encoders, this begins a new (chained)
+	   stream; members joining later need its headers */
+	group.header = data;
+	group.Push(std::move(data));
+}
+
+void
+SharedEncoder::Write(std::span<const std::byte> src)
+{
+	const std::scoped_lock lock{group.mutex};
+
+	if (IsDetached())
+		Rejoin();
+
+	assert(position <= group.position);
+
+	const uint_least64_t end = position + src.size();
+	if (end > group.position) {
+		/* encode the portion which no other member has
+		   submitted yet */
+		const auto tail = src.last(end - group.position);
+		group.encoder->Write(tail);
+		group.position = end;
+		group.Drain();
+	}
+
+	position = end;
+}
+
+std::span<const std::byte>
+SharedEncoder::Read(std::span<std::byte> buffer) noexcept
+{
+	const std::scoped_lock lock{group.mutex};
+
+	if (IsDetached())
+		Rejoin();
+
+	if (header_offset < header.size()) {
+		const std::size_t n = std::min(buffer.size(),
+					       header.size() - header_offset);
+		std::copy_n(header.begin() + header_offset, n, buffer.begin());
+		header_offset += n;
+		if (header_offset == header.size()) {
+			header = {};
+			header_offset = 0;
+		}
+
+		return buffer.first(n);
+	}
+
+	assert(next_page >= group.first_page);
+
+	if (next_page == group.GetEndPage())
+		return {};
+
+	auto &page = group.pages[next_page - group.first_page];
+	if (page.pcm_end > position)
+		/* this member has not yet submitted the PCM data
+		   this page was generated from */
+		return {};
+
+	const std::size_t n = std::min(buffer.size(),
+				       page.data.size() - page_offset);
+	std::copy_n(page.data.begin() + page_offset, n, buffer.begin());
+	page_offset += n;
+
+	if (page_offset == page.data.size()) {
+		page_offset = 0;
+		++next_page;
+
+		assert(page.readers > 0);
+		--page.readers;
+		group.Trim();
+	}
+
+	return buffer.first(n);
+}
+
+class PreparedSharedEncoder final : public PreparedEncoder {
+	const std::shared_ptr<SharedEncoderGroup> group;
+
+public:
+	explicit PreparedSharedEncoder(std::shared_ptr<SharedEncoderGroup> _group) noexcept
+		:group(std::move(_group)) {}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format) override {
+		const std::scoped_lock lock{group->mutex};
+		group->Open(audio_format);
+		return new SharedEncoder(group);
+	}
+
+	const char *GetMimeType() const noexcept override {
+		return group->GetMimeType();
+	}
+};
+
+} // anonymous namespace
+
+static Mutex shared_encoder_groups_mutex;
+static std::map<std::string, std::weak_ptr<SharedEncoderGroup>, std::less<>> shared_encoder_groups;
+
+PreparedEncoder *
+CreateSharedEncoder(const char *name, const char *plugin_name,
+		    std::unique_ptr<PreparedEncoder> prepared)
+{
+	const std::scoped_lock lock{shared_encoder_groups_mutex};
+
+	auto &slot = shared_encoder_groups[name];
+	auto group = slot.lock();
+	if (group == nullptr) {
+		group = std::make_shared<SharedEncoderGroup>(plugin_name,
+							     std::move(prepared));
+		slot = group;
+	} else if (std::string_view{group->GetPluginName()} != plugin_name)
+		throw FmtRuntimeError("Encoder group {:?} uses encoder {:?}",
+				      name, group->GetPluginName());
+
+	return new PreparedSharedEncoder(std::move(group));
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <memory>
+
+class PreparedEncoder;
+
+/**
+ * Create a #PreparedEncoder which joins the named encoder group.  All
+ * members of a group share one #Encoder instance: the first member
+ * which submits a portion of PCM data encodes it, and all members
+ * read the same encoded data.  The PCM data submitted by all members
+ * must be identical (e.g. outputs without filters playing the same
+ * stream).  A member which stops submitting data (e.g. an "httpd"
+ * output without clients) is detached after a while; when it
+ * resumes, it continues at the current end of the encoded stream,
+ * beginning with the stream header.
+ *
+ * The first member creates the group, and its #PreparedEncoder is
+ * used for opening the shared #Encoder; the #PreparedEncoder passed
+ * by later members is discarded.
+ *
+ * Throws on error (e.g. if the group uses a different encoder
+ * plugin).
+ *
+ * @param group the name of the group
+ * @param plugin_name the name of the encoder plugin
+ */
+PreparedEncoder *
+CreateSharedEncoder(const char *group, const char *plugin_name,
+		    std::unique_ptr<PreparedEncoder> prepared);
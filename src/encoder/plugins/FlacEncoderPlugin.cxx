@@ -23,6 +23,7 @@ class FlacEncoder final : public Encoder {
 
 	FLAC__StreamEncoder *const fse;
 	const unsigned compression;
+	const unsigned threads;
 	const bool oggflac;
 
 	PcmBuffer expand_buffer;
@@ -34,7 +35,9 @@ class FlacEncoder final : public Encoder {
 	DynamicFifoBuffer<std::byte> output_buffer{8192};
 
 public:
-	FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse, unsigned _compression, bool _oggflac, bool _oggchaining);
+	FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse,
+		    unsigned _compression, unsigned _threads,
+		    bool _oggflac, bool _oggchaining);
 
 	~FlacEncoder() noexcept override {
 		FLAC__stream_encoder_delete(fse);
@@ -80,6 +83,13 @@ private:
 
 class PreparedFlacEncoder final : public PreparedEncoder {
 	const unsigned compression;
+
+	/**
+	 * The number of libFLAC encoder threads (requires libFLAC
+	 * 1.5); 1 encodes on the calling thread.
+	 */
+	const unsigned threads;
+
 	const bool oggchaining;
 	const bool oggflac;
 
@@ -98,6 +108,7 @@ public:
 
 PreparedFlacEncoder::PreparedFlacEncoder(const ConfigBlock &block)
 	:compression(block.GetBlockValue("compression", 5U)),
+	threads(block.GetPositiveValue("threads", 1U)),
 	oggchaining(block.GetBlockValue("oggchaining",false)),
 	oggflac(block.GetBlockValue("oggflac",false) || oggchaining)
 {
@@ -110,7 +121,8 @@ flac_encoder_init(const ConfigBlock &block)
 }
 
 static void
-flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
+flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
+		   unsigned threads, bool oggflac,
 		   const AudioFormat &audio_format)
 {
 	unsigned bits_per_sample;
@@ -132,6 +144,17 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
 		throw FmtRuntimeError("error setting flac compression to {}",
 				      compression);
 
+#if FLAC_API_VERSION_CURRENT >= 14
+	/* libFLAC 1.5 can encode frames in worker threads */
+	if (FLAC__stream_encoder_set_num_threads(fse, threads) !=
+	    FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK)
+		throw FmtRuntimeError("error setting flac threads to {}",
+				      threads);
+#else
+	if (threads > 1)
+		throw std::runtime_error{"libFLAC 1.5 is required for the \"threads\" setting"};
+#endif
+
 	if (!FLAC__stream_encoder_set_channels(fse, audio_format.channels))
 		throw FmtRuntimeError("error setting flac channels num to {}",
 				      audio_format.channels);
@@ -150,10 +173,12 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression, bool oggflac,
 		throw std::runtime_error{"error setting ogg serial number"};
 }
 
-FlacEncoder::FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse, unsigned _compression, bool _oggflac, bool _oggchaining)
+FlacEncoder::FlacEncoder(AudioFormat _audio_format, FLAC__StreamEncoder *_fse,
+			 unsigned _compression, unsigned _threads,
+			 bool _oggflac, bool _oggchaining)
 	:Encoder(_oggchaining),
 	 audio_format(_audio_format), fse(_fse),
-	 compression(_compression),
+	 compression(_compression), threads(_threads),
 	 oggflac(_oggflac)
 {
 	/* this immediately outputs data through callback */
@@ -197,20 +222,22 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format)
 		throw std::runtime_error("FLAC__stream_encoder_new() failed");
 
 	try {
-		flac_encoder_setup(fse, compression, oggflac, audio_format);
+		flac_encoder_setup(fse, compression, threads, oggflac,
+				   audio_format);
 	} catch (...) {
 		FLAC__stream_encoder_delete(fse);
 		throw;
 	}
 
-	return new FlacEncoder(audio_format, fse, compression, oggflac, oggchaining);
+	return new FlacEncoder(audio_format, fse, compression, threads,
+			       oggflac, oggchaining);
 }
 
 void
 FlacEncoder::SendTag(const Tag &tag)
 {
 	/* re-initialize encoder since flac_encoder_finish resets everything */
-	flac_encoder_setup(fse, compression, oggflac, audio_format);
+	flac_encoder_setup(fse, compression, threads, oggflac, audio_format);
 
 	FLAC__StreamMetadata *metadata = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
 	FLAC__StreamMetadata_VorbisComment_Entry entry;
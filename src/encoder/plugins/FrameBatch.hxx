@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * Helper for encoders whose codec works on frames of a fixed number
+ * of samples (e.g. 1152 for MPEG-1 Layer II/III).  It passes input to
+ * the codec only in whole multiples of that size; the remainder is
+ * kept until the next call.  Large inputs are passed without
+ * copying.
+ */
+class FrameBatch {
+	/**
+	 * The number of (interleaved) samples in one codec frame.
+	 */
+	const std::size_t frame_samples;
+
+	/**
+	 * Input which does not fill a whole codec frame yet.
+	 */
+	std::vector<int16_t> pending;
+
+public:
+	explicit FrameBatch(std::size_t _frame_samples)
+		:frame_samples(_frame_samples)
+	{
+		pending.reserve(frame_samples);
+	}
+
+	/**
+	 * Pass whole codec frames from the pending input and #src to
+	 * the given function.
+	 *
+	 * @param f a function accepting a std::span<const int16_t>
+	 */
+	template<typename F>
+	void Feed(std::span<const int16_t> src, F &&f) {
+		if (!pending.empty()) {
+			const std::size_t n = std::min(src.size(),
+						       frame_samples - pending.size());
+			pending.insert(pending.end(), src.begin(), src.begin() + n);
+			src = src.subspan(n);
+
+			if (pending.size() < frame_samples)
+				return;
+
+			f(std::span<const int16_t>{pending});
+			pending.clear();
+		}
+
+		const std::size_t whole = src.size() / frame_samples * frame_samples;
+		if (whole > 0) {
+			f(src.first(whole));
+			src = src.subspan(whole);
+		}
+
+		pending.assign(src.begin(), src.end());
+	}
+
+	/**
+	 * Pass the pending partial frame (if any) to the given
+	 * function.
+	 */
+	template<typename F>
+	void Flush(F &&f) {
+		if (pending.empty())
+			return;
+
+		f(std::span<const int16_t>{pending});
+		pending.clear();
+	}
+};
@@ -2,11 +2,12 @@
 // Copyright The Music Player Daemon Project
 
 #include "LameEncoderPlugin.hxx"
+#include "FrameBatch.hxx"
 #include "../EncoderAPI.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/CNumberParser.hxx"
-#include "util/ReusableArray.hxx"
+#include "util/DynamicFifoBuffer.hxx"
 #include "util/SpanCast.hxx"
 
 #include <lame/lame.h>
@@ -17,14 +18,23 @@
 class LameEncoder final : public Encoder {
 	lame_global_flags *const gfp;
 
-	ReusableArray<std::byte, 32768> output_buffer;
-	std::span<const std::byte> output{};
+	/**
+	 * Collects input until it fills whole MP3 frames.
+	 */
+	FrameBatch input;
+
+	/**
+	 * LAME writes directly into this buffer, and Read() returns
+	 * spans of it.
+	 */
+	DynamicFifoBuffer<std::byte> output{32768};
 
 public:
 	static constexpr unsigned CHANNELS = 2;
 
-	explicit LameEncoder(lame_global_flags *_gfp) noexcept
-		:Encoder(false), gfp(_gfp) {}
+	explicit LameEncoder(lame_global_flags *_gfp)
+		:Encoder(false), gfp(_gfp),
+		 input(lame_get_framesize(gfp) * CHANNELS) {}
 
 	~LameEncoder() noexcept override;
 
@@ -32,8 +42,13 @@ public:
 	LameEncoder &operator=(const LameEncoder &) = delete;
 
 	/* virtual methods from class Encoder */
+	void End() override;
+	void Flush() override;
 	void Write(std::span<const std::byte> src) override;
 	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override;
+
+private:
+	void Encode(std::span<const int16_t> src);
 };
 
 class PreparedLameEncoder final : public PreparedEncoder {
@@ -134,12 +149,11 @@ PreparedLameEncoder::Open(AudioFormat &audio_format)
 
 	try {
 		lame_encoder_setup(gfp, quality, bitrate, audio_format);
+		return new LameEncoder(gfp);
 	} catch (...) {
 		lame_close(gfp);
 		throw;
 	}
-
-	return new LameEncoder(gfp);
 }
 
 LameEncoder::~LameEncoder() noexcept
@@ -148,18 +162,14 @@ LameEncoder::~LameEncoder() noexcept
 }
 
 void
-LameEncoder::Write(std::span<const std::byte> _src)
+LameEncoder::Encode(std::span<const int16_t> src)
 {
-	const auto src = FromBytesStrict<const int16_t>(_src);
-
-	assert(output.empty());
-
 	const std::size_t num_samples = src.size();
 	const std::size_t num_frames = num_samples / CHANNELS;
 
 	/* worst-case formula according to LAME documentation */
-	const std::size_t output_buffer_size = 5 * num_samples / 4 + 7200;
-	const auto dest = output_buffer.Get(output_buffer_size);
+	const std::size_t max_size = 5 * num_samples / 4 + 7200;
+	const auto dest = output.Write(max_size);
 
 	/* this is for only 16-bit audio */
 
@@ -167,18 +177,53 @@ LameEncoder::Write(std::span<const std::byte> _src)
 						       const_cast<short *>(src.data()),
 						       num_frames,
 						       (unsigned char *)dest,
-						       output_buffer_size);
+						       max_size);
 
 	if (bytes_out < 0)
 		throw std::runtime_error("lame encoder failed");
 
-	output = {dest, std::size_t(bytes_out)};
+	output.Append(bytes_out);
+}
+
+void
+LameEncoder::End()
+{
+	Flush();
+
+	/* the LAME documentation requires at least 7200 bytes */
+	static constexpr std::size_t max_size = 7200;
+	const auto dest = output.Write(max_size);
+
+	int bytes_out = lame_encode_flush(gfp, (unsigned char *)dest,
+					  max_size);
+	if (bytes_out < 0)
+		throw std::runtime_error("lame encoder failed");
+
+	output.Append(bytes_out);
+}
+
+void
+LameEncoder::Flush()
+{
+	input.Flush([this](auto src){ Encode(src); });
+}
+
+void
+LameEncoder::Write(std::span<const std::byte> _src)
+{
+	const auto src = FromBytesStrict<const int16_t>(_src);
+
+	input.Feed(src, [this](auto s){ Encode(s); });
 }
 
 std::span<const std::byte>
 LameEncoder::Read(std::span<std::byte>) noexcept
 {
-	return std::exchange(output, std::span<const std::byte>{});
+	/* return a span of the output buffer; it remains valid
+	   until the next Write() */
+	const auto r = output.Read();
+	output.Consume(r.size());
+	return r;
 }
 
 const EncoderPlugin lame_encoder_plugin = {
@@ -11,13 +11,47 @@
 #include <opus.h>
 #include <ogg/ogg.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <stdexcept>
 
 #include <stdlib.h>
 
 namespace {
 
+/**
+ * The frame durations supported by libopus, in frames at 48 kHz.
+ */
+static constexpr unsigned opus_frame_sizes[] = {
+	120, 240, 480, 960, 1920, 2880,
+};
+
+struct OpusEncoderSettings {
+	/**
+	 * The number of frames encoded into one Opus packet.
+	 */
+	unsigned frame_size;
+
+	/**
+	 * Flush the Ogg page after this number of packets; 0 lets
+	 * libogg decide.
+	 */
+	unsigned packets_per_page;
+
+	/**
+	 * The configured (and maximum) complexity.
+	 */
+	int complexity;
+
+	/**
+	 * Lower the complexity if encoding takes too much CPU time?
+	 */
+	bool adaptive_complexity;
+
+	bool chaining;
+};
+
 class OpusEncoder final : public OggEncoder {
 	const AudioFormat audio_format;
 
@@ -37,8 +71,23 @@ class OpusEncoder final : public OggEncoder {
 
 	ogg_int64_t granulepos = 0;
 
+	const unsigned packets_per_page;
+	unsigned page_packets = 0;
+
+	const int max_complexity;
+	int complexity;
+	const bool adaptive_complexity;
+
+	/**
+	 * Statistics for adaptive complexity: the time spent in
+	 * libopus and the number of frames it encoded meanwhile.
+	 */
+	std::chrono::steady_clock::duration encode_time{};
+	unsigned encode_frames = 0;
+
 public:
-	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining);
+	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+		    const OpusEncoderSettings &settings);
 	~OpusEncoder() noexcept override;
 
 	OpusEncoder(const OpusEncoder &) = delete;
@@ -55,6 +104,12 @@ private:
 	void DoEncode(bool eos);
 	void WriteSilence(unsigned fill_frames);
 
+	/**
+	 * Adjust the complexity after the encoder has spent the
+	 * given time on one packet.
+	 */
+	void AdaptComplexity(std::chrono::steady_clock::duration duration) noexcept;
+
 	void GenerateHeaders(const Tag *tag) noexcept;
 	void GenerateHead() noexcept;
 	void GenerateTags(const Tag *tag) noexcept;
@@ -62,12 +117,12 @@ private:
 
 class PreparedOpusEncoder final : public PreparedEncoder {
 	opus_int32 bitrate;
-	int complexity;
 	int signal;
 	int packet_loss;
 	int vbr;
 	int vbr_constraint;
-	const bool chaining;
+
+	OpusEncoderSettings settings;
 
 public:
 	explicit PreparedOpusEncoder(const ConfigBlock &block);
@@ -80,9 +135,31 @@ public:
 	}
 };
 
+/**
+ * Parse the "frame_duration" setting (milliseconds).
+ *
+ * @return the number of frames at 48 kHz
+ */
+static unsigned
+ParseOpusFrameDuration(const char *value)
+{
+	char *endptr;
+	const double ms = strtod(value, &endptr);
+	if (endptr == value || *endptr != 0)
+		throw std::runtime_error("Invalid frame duration");
+
+	const double frames = ms * 48;
+	for (const unsigned i : opus_frame_sizes)
+		if (frames == i)
+			return i;
+
+	throw std::runtime_error("Invalid frame duration; valid values are 2.5, 5, 10, 20, 40, 60");
+}
+
 PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
-	:chaining(block.GetBlockValue("opustags", false))
 {
+	settings.chaining = block.GetBlockValue("opustags", false);
+
 	const char *value = block.GetBlockValue("bitrate", "auto");
 	if (strcmp(value, "auto") == 0)
 		bitrate = OPUS_AUTO;
@@ -96,10 +173,18 @@ PreparedOpusEncoder::PreparedOpusEncoder(const ConfigBlock &block)
 			throw std::runtime_error("Invalid bit rate");
 	}
 
-	complexity = block.GetBlockValue("complexity", 10U);
-	if (complexity > 10)
+	settings.complexity = block.GetBlockValue("complexity", 10U);
+	if (settings.complexity > 10)
 		throw std::runtime_error("Invalid complexity");
 
+	settings.adaptive_complexity =
+		block.GetBlockValue("adaptive_complexity", false);
+
+	settings.frame_size =
+		ParseOpusFrameDuration(block.GetBlockValue("frame_duration", "20"));
+
+	settings.packets_per_page = block.GetBlockValue("packets_per_page", 0U);
+
 	value = block.GetBlockValue("signal", "auto");
 	if (strcmp(value, "auto") == 0)
 		signal = OPUS_AUTO;
@@ -134,14 +219,19 @@ opus_encoder_init(const ConfigBlock &block)
 	return new PreparedOpusEncoder(block);
 }
 
-OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc, bool _chaining)
-	:OggEncoder(_chaining),
+OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+			 const OpusEncoderSettings &settings)
+	:OggEncoder(settings.chaining),
 	 audio_format(_audio_format),
 	 frame_size(_audio_format.GetFrameSize()),
-	 buffer_frames(_audio_format.sample_rate / 50),
+	 buffer_frames(settings.frame_size),
 	 buffer_size(frame_size * buffer_frames),
 	 buffer(new std::byte[buffer_size]),
-	 enc(_enc)
+	 enc(_enc),
+	 packets_per_page(settings.packets_per_page),
+	 max_complexity(settings.complexity),
+	 complexity(settings.complexity),
+	 adaptive_complexity(settings.adaptive_complexity)
 {
 	opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
 	GenerateHeaders(nullptr);
@@ -179,13 +269,13 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format)
 		throw std::runtime_error(opus_strerror(error_code));
 
 	opus_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
-	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
+	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(settings.complexity));
 	opus_encoder_ctl(enc, OPUS_SET_SIGNAL(signal));
 	opus_encoder_ctl(enc, OPUS_SET_VBR(vbr));
 	opus_encoder_ctl(enc, OPUS_SET_VBR_CONSTRAINT(vbr_constraint));
 	opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(packet_loss));
 
-	return new OpusEncoder(audio_format, enc, chaining);
+	return new OpusEncoder(audio_format, enc, settings);
 }
 
 OpusEncoder::~OpusEncoder() noexcept
@@ -199,6 +289,10 @@ OpusEncoder::DoEncode(bool eos)
 {
 	assert(buffer_position == buffer_size || eos);
 
+	const auto start = adaptive_complexity
+		? std::chrono::steady_clock::now()
+		: std::chrono::steady_clock::time_point{};
+
 	opus_int32 result =
 		audio_format.format == SampleFormat::S16
 		? opus_encode(enc,
@@ -214,6 +308,9 @@ OpusEncoder::DoEncode(bool eos)
 	if (result < 0)
 		throw std::runtime_error("Opus encoder error");
 
+	if (adaptive_complexity)
+		AdaptComplexity(std::chrono::steady_clock::now() - start);
+
 	granulepos += buffer_position / frame_size;
 
 	ogg_packet packet;
@@ -225,9 +322,46 @@ OpusEncoder::DoEncode(bool eos)
 	packet.packetno = packetno++;
 	stream.PacketIn(packet);
 
+	if (packets_per_page > 0 && ++page_packets >= packets_per_page) {
+		/* emit the page now instead of letting libogg
+		   collect up to 4 kB */
+		page_packets = 0;
+		Flush();
+	}
+
 	buffer_position = 0;
 }
 
+void
+OpusEncoder::AdaptComplexity(std::chrono::steady_clock::duration duration) noexcept
+{
+	encode_time += duration;
+	encode_frames += buffer_frames;
+
+	/* evaluate once per second of audio */
+	if (encode_frames < audio_format.sample_rate)
+		return;
+
+	const auto audio_time = audio_format.FramesToTime<std::chrono::steady_clock::duration>(encode_frames);
+
+	int new_complexity = complexity;
+	if (encode_time * 2 > audio_time)
+		/* more than half of the real time was spent
+		   encoding; the output may not keep up */
+		--new_complexity;
+	else if (encode_time * 8 < audio_time)
+		++new_complexity;
+
+	new_complexity = std::clamp(new_complexity, 0, max_complexity);
+	if (new_complexity != complexity) {
+		complexity = new_complexity;
+		opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
+	}
+
+	encode_time = {};
+	encode_frames = 0;
+}
+
 void
 OpusEncoder::End()
 {
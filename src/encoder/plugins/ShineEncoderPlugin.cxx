@@ -62,8 +62,12 @@ public:
 
 	void Write(std::span<const std::byte> src) override;
 
-	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override {
-		return buffer.first(output_buffer.Read(buffer.data(), buffer.size()));
+	std::span<const std::byte> Read(std::span<std::byte>) noexcept override {
+		/* return a span of the output buffer; it remains
+		   valid until the next Write() */
+		const auto r = output_buffer.Read();
+		output_buffer.Consume(r.size());
+		return r;
 	}
 };
 
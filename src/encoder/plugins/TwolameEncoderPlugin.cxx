@@ -2,10 +2,12 @@
 // Copyright The Music Player Daemon Project
 
 #include "TwolameEncoderPlugin.hxx"
+#include "FrameBatch.hxx"
 #include "../EncoderAPI.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/CNumberParser.hxx"
+#include "util/DynamicFifoBuffer.hxx"
 #include "util/SpanCast.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
@@ -15,23 +17,31 @@
 #include <cassert>
 #include <stdexcept>
 
+/**
+ * An upper bound for the size of one MPEG Layer II frame.
+ */
+static constexpr std::size_t TWOLAME_MAX_FRAME_SIZE = 2048;
+
 class TwolameEncoder final : public Encoder {
 	twolame_options *options;
 
-	std::byte output_buffer[32768];
-	std::size_t fill = 0;
+	/**
+	 * Collects input until it fills whole MPEG frames.
+	 */
+	FrameBatch input;
 
 	/**
-	 * Call libtwolame's flush function when the output_buffer is
-	 * empty?
+	 * libtwolame writes directly into this buffer, and Read()
+	 * returns spans of it.
 	 */
-	bool flush = false;
+	DynamicFifoBuffer<std::byte> output{32768};
 
 public:
 	static constexpr unsigned CHANNELS = 2;
 
-	explicit TwolameEncoder(twolame_options *_options) noexcept
-		:Encoder(false), options(_options) {}
+	explicit TwolameEncoder(twolame_options *_options)
+		:Encoder(false), options(_options),
+		 input(TWOLAME_SAMPLES_PER_FRAME * CHANNELS) {}
 	~TwolameEncoder() noexcept override;
 
 	TwolameEncoder(const TwolameEncoder &) = delete;
@@ -40,15 +50,15 @@ public:
 	/* virtual methods from class Encoder */
 
 	void End() override {
-		flush = true;
-	}
-
-	void Flush() override {
-		flush = true;
+		Flush();
 	}
 
+	void Flush() override;
 	void Write(std::span<const std::byte> src) override;
 	std::span<const std::byte> Read(std::span<std::byte> buffer) noexcept override;
+
+private:
+	void Encode(std::span<const int16_t> src);
 };
 
 class PreparedTwolameEncoder final : public PreparedEncoder {
@@ -153,12 +163,11 @@ PreparedTwolameEncoder::Open(AudioFormat &audio_format)
 	try {
 		twolame_encoder_setup(options, quality, bitrate,
 				      audio_format);
+		return new TwolameEncoder(options);
 	} catch (...) {
 		twolame_close(&options);
 		throw;
 	}
-
-	return new TwolameEncoder(options);
 }
 
 TwolameEncoder::~TwolameEncoder() noexcept
@@ -167,40 +176,54 @@ TwolameEncoder::~TwolameEncoder() noexcept
 }
 
 void
-TwolameEncoder::Write(std::span<const std::byte> _src)
+TwolameEncoder::Encode(std::span<const int16_t> src)
 {
-	const auto src = FromBytesStrict<const int16_t>(_src);
-
-	assert(fill == 0);
-
 	const std::size_t num_frames = src.size() / CHANNELS;
 
+	/* libtwolame may emit one more frame than the input fills,
+	   due to its internal buffer */
+	const std::size_t max_size =
+		(num_frames / TWOLAME_SAMPLES_PER_FRAME + 1) * TWOLAME_MAX_FRAME_SIZE;
+	const auto dest = output.Write(max_size);
+
 	int bytes_out = twolame_encode_buffer_interleaved(options,
 							  src.data(), num_frames,
-							  (unsigned char *)output_buffer,
-							  sizeof(output_buffer));
+							  (unsigned char *)dest,
+							  max_size);
 	if (bytes_out < 0)
 		throw std::runtime_error("twolame encoder failed");
 
-	fill = (std::size_t)bytes_out;
+	output.Append(bytes_out);
 }
 
-std::span<const std::byte>
-TwolameEncoder::Read(std::span<std::byte>) noexcept
+void
+TwolameEncoder::Flush()
 {
-	assert(fill <= sizeof(output_buffer));
+	input.Flush([this](auto src){ Encode(src); });
 
-	if (fill == 0 && flush) {
-		int ret = twolame_encode_flush(options,
-					       (unsigned char *)output_buffer,
-					       sizeof(output_buffer));
-		if (ret > 0)
-			fill = (std::size_t)ret;
+	const auto dest = output.Write(TWOLAME_MAX_FRAME_SIZE);
+	int ret = twolame_encode_flush(options, (unsigned char *)dest,
+				       TWOLAME_MAX_FRAME_SIZE);
+	if (ret > 0)
+		output.Append(ret);
+}
 
-		flush = false;
-	}
+void
+TwolameEncoder::Write(std::span<const std::byte> _src)
+{
+	const auto src = FromBytesStrict<const int16_t>(_src);
+
+	input.Feed(src, [this](auto s){ Encode(s); });
+}
 
-	return std::span{output_buffer}.first(std::exchange(fill, 0));
+std::span<const std::byte>
+TwolameEncoder::Read(std::span<std::byte>) noexcept
+{
+	/* return a span of the output buffer; it remains valid
+	   until the next Write() */
+	const auto r = output.Read();
+	output.Consume(r.size());
+	return r;
 }
 
 const EncoderPlugin twolame_encoder_plugin = {
@@ -2,13 +2,87 @@
 // Copyright The Music Player Daemon Project
 
 #include "BufferedSocket.hxx"
+#include "Loop.hxx"
 #include "net/SocketError.hxx"
 
 #include <stdexcept>
 
+BufferedSocket::BufferedSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept
+	:event(_loop, BIND_THIS_METHOD(OnSocketReady), _fd)
+{
+#ifdef HAVE_URING
+	if (auto *queue = _loop.GetUring()) {
+		try {
+			uring_receive = Uring::MultiReceiveOperation::Start(*queue,
+									  _fd.ToFileDescriptor(),
+									  *this);
+			want_input = true;
+			return;
+		} catch (...) {
+			/* no buffer ring support in this kernel: fall
+			   back to SocketEvent::READ */
+		}
+	}
+#endif
+
+	event.ScheduleRead();
+}
+
+inline void
+BufferedSocket::ScheduleInput() noexcept
+{
+#ifdef HAVE_URING
+	if (uring_receive != nullptr) {
+		want_input = true;
+		return;
+	}
+#endif
+
+	event.ScheduleRead();
+}
+
+inline void
+BufferedSocket::CancelInput() noexcept
+{
+#ifdef HAVE_URING
+	if (uring_receive != nullptr) {
+		want_input = false;
+		return;
+	}
+#endif
+
+	event.CancelRead();
+}
+
 inline BufferedSocket::ssize_t
 BufferedSocket::DirectRead(std::span<std::byte> dest) noexcept
 {
+#ifdef HAVE_URING
+	if (uring_receive != nullptr) {
+		const auto nbytes = uring_receive->Read(dest);
+		if (nbytes >= 0) [[likely]]
+			return nbytes;
+
+		const int code = uring_receive->GetError();
+		if (uring_receive->IsUnsupported()) {
+			/* this kernel has buffer rings, but no
+			   multishot receive: fall back to
+			   SocketEvent::READ */
+			CancelUringReceive();
+			event.ScheduleRead();
+			return 0;
+		}
+
+		CancelUringReceive();
+
+		if (code == 0 || IsSocketErrorClosed(code))
+			OnSocketClosed();
+		else
+			OnSocketError(std::make_exception_ptr(MakeSocketError(code, "Failed to receive from socket")));
+		return -1;
+	}
+#endif
+
 	const auto nbytes = GetSocket().ReadNoWait(dest);
 	if (nbytes > 0) [[likely]]
 		return nbytes;
@@ -52,7 +126,17 @@ BufferedSocket::ResumeInput() noexcept
 	while (true) {
 		const auto buffer = input.Read();
 		if (buffer.empty()) {
-			event.ScheduleRead();
+#ifdef HAVE_URING
+			if (IsUringReady()) {
+				/* copy data which has already been
+				   received */
+				if (!ReadToBuffer())
+					return false;
+				continue;
+			}
+#endif
+
+			ScheduleInput();
 			return true;
 		}
 
@@ -64,11 +148,19 @@ BufferedSocket::ResumeInput() noexcept
 				return false;
 			}
 
-			event.ScheduleRead();
+#ifdef HAVE_URING
+			if (IsUringReady()) {
+				if (!ReadToBuffer())
+					return false;
+				continue;
+			}
+#endif
+
+			ScheduleInput();
 			return true;
 
 		case InputResult::PAUSE:
-			event.CancelRead();
+			CancelInput();
 			return true;
 
 		case InputResult::AGAIN:
@@ -100,3 +192,23 @@ BufferedSocket::OnSocketReady(unsigned flags) noexcept
 			event.ScheduleRead();
 	}
 }
+
+#ifdef HAVE_URING
+
+void
+BufferedSocket::OnUringReceive() noexcept
+{
+	assert(IsDefined());
+
+	if (!want_input)
+		/* paused; the data remains in #uring_receive until
+		   ResumeInput() is called */
+		return;
+
+	assert(!input.IsFull());
+
+	if (ReadToBuffer())
+		ResumeInput();
+}
+
+#endif // HAVE_URING
@@ -5,31 +5,59 @@
 
 #include "SocketEvent.hxx"
 #include "util/StaticFifoBuffer.hxx"
+#include "io/uring/Features.h"
+
+#ifdef HAVE_URING
+#include "io/uring/MultiReceiveOperation.hxx"
+#endif
 
 #include <cassert>
 #include <cstddef>
 #include <exception>
 #include <span>
 #include <type_traits>
+#include <utility>
 
 class EventLoop;
 
 /**
  * A #SocketEvent specialization that adds an input buffer.
+ *
+ * If the #EventLoop has an io_uring, data is received with a
+ * multishot receive instead of waiting for #SocketEvent::READ and
+ * calling recv(); the #SocketEvent is then only used for writing.
  */
-class BufferedSocket {
+class BufferedSocket
+#ifdef HAVE_URING
+	: Uring::ReceiveHandler
+#endif
+{
 	StaticFifoBuffer<std::byte, 8192> input;
 
+#ifdef HAVE_URING
+	Uring::MultiReceiveOperation *uring_receive = nullptr;
+
+	/**
+	 * Does this object want to receive data from
+	 * #uring_receive?  This is the equivalent of
+	 * SocketEvent::ScheduleRead().
+	 */
+	bool want_input = false;
+#endif
+
 protected:
 	SocketEvent event;
 
 public:
 	using ssize_t = std::make_signed<size_t>::type;
 
-	BufferedSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept
-		:event(_loop, BIND_THIS_METHOD(OnSocketReady), _fd) {
-		event.ScheduleRead();
+	BufferedSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept;
+
+#ifdef HAVE_URING
+	~BufferedSocket() noexcept {
+		CancelUringReceive();
 	}
+#endif
 
 	auto &GetEventLoop() const noexcept {
 		return event.GetEventLoop();
@@ -44,10 +72,32 @@ public:
 	}
 
 	void Close() noexcept {
+#ifdef HAVE_URING
+		CancelUringReceive();
+#endif
 		event.Close();
 	}
 
 private:
+#ifdef HAVE_URING
+	void CancelUringReceive() noexcept {
+		if (uring_receive != nullptr)
+			std::exchange(uring_receive, nullptr)->Cancel();
+	}
+
+	/**
+	 * Is there received data which has not yet been copied to
+	 * the input buffer?
+	 */
+	[[gnu::pure]]
+	bool IsUringReady() const noexcept {
+		return uring_receive != nullptr && uring_receive->IsReady();
+	}
+#endif
+
+	void ScheduleInput() noexcept;
+	void CancelInput() noexcept;
+
 	/**
 	 * @return the number of bytes read from the socket, 0 if the
 	 * socket isn't ready for reading, -1 on error (the socket has
@@ -119,4 +169,10 @@ protected:
 	virtual void OnSocketClosed() noexcept = 0;
 
 	virtual void OnSocketReady(unsigned flags) noexcept;
+
+private:
+#ifdef HAVE_URING
+	/* virtual methods from class Uring::ReceiveHandler */
+	void OnUringReceive() noexcept final;
+#endif
 };
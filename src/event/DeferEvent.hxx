@@ -67,4 +67,8 @@ private:
 	void Run() noexcept {
 		callback();
 	}
+
+	const void *GetCallbackAddress() const noexcept {
+		return callback.GetFunctionAddress();
+	}
 };
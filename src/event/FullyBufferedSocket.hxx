@@ -37,6 +37,11 @@ public:
 		return output.max_size();
 	}
 
+	[[gnu::pure]]
+	bool IsOutputEmpty() const noexcept {
+		return output.empty();
+	}
+
 private:
 	/**
 	 * @return the number of bytes written to the socket, 0 if the
@@ -60,6 +65,14 @@ protected:
 
 	void OnIdle() noexcept;
 
+	/**
+	 * The output buffer has been sent to the socket completely.
+	 * The implementation must not write to or close the socket
+	 * from inside this method (but may schedule an event which
+	 * does that).
+	 */
+	virtual void OnSocketOutputEmpty() noexcept {}
+
 	/* virtual methods from class BufferedSocket */
 	void OnSocketReady(unsigned flags) noexcept override;
 };
@@ -45,4 +45,8 @@ private:
 	void Run() noexcept {
 		callback();
 	}
+
+	const void *GetCallbackAddress() const noexcept {
+		return callback.GetFunctionAddress();
+	}
 };
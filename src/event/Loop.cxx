@@ -311,14 +311,36 @@ EventLoop::AddNext(DeferEvent &e) noexcept
 	next.push_back(e);
 }
 
-void
+/**
+ * RunDeferred() yields to socket events after this much time, so a
+ * burst of #DeferEvents (e.g. "idle" notifications to many clients)
+ * doesn't delay client commands and streaming.
+ */
+static constexpr Event::Duration DEFER_BUDGET = std::chrono::milliseconds{2};
+
+bool
 EventLoop::RunDeferred() noexcept
 {
+	auto t = Event::Clock::now();
+	const auto deadline = t + DEFER_BUDGET;
+
 	while (!defer.empty() && !quit) {
-		defer.pop_front_and_dispose([](DeferEvent *e){
+		if (t >= deadline) {
+			++stats.defer_yields;
+			return false;
+		}
+
+		defer.pop_front_and_dispose([this, &t](DeferEvent *e){
+			/* obtain the address now, because the
+			   callback may destroy the object */
+			const void *source = e->GetCallbackAddress();
 			e->Run();
+			t = AccountCallback(EventLoopStats::Category::DEFER,
+					    source, t);
 		});
 	}
+
+	return true;
 }
 
 bool
@@ -327,8 +349,11 @@ EventLoop::RunOneIdle() noexcept
 	if (idle.empty())
 		return false;
 
-	idle.pop_front_and_dispose([](DeferEvent *e){
+	idle.pop_front_and_dispose([this](DeferEvent *e){
+		const auto start = Event::Clock::now();
+		const void *source = e->GetCallbackAddress();
 		e->Run();
+		AccountCallback(EventLoopStats::Category::IDLE, source, start);
 	});
 
 	return true;
@@ -474,20 +499,27 @@ EventLoop::Run() noexcept
 
 	FlushClockCaches();
 
+	auto iteration_start = Event::Clock::now();
+
 	while (!quit) {
 		again = false;
 
 		/* invoke timers */
 
+		const auto timers_start = Event::Clock::now();
 		Event::Duration timeout = HandleTimers();
+		AccountCallback(EventLoopStats::Category::TIMER, nullptr,
+				timers_start);
 		if (quit)
 			break;
 
-		RunDeferred();
+		/* if the DeferEvents exceed their time budget, poll
+		   the sockets before continuing with them */
+		const bool defer_pending = !RunDeferred();
 		if (quit)
 			break;
 
-		if (RunOneIdle())
+		if (!defer_pending && RunOneIdle())
 			/* check for other new events after each
 			   "idle" invocation to ensure that the other
 			   "idle" events are really invoked at the
@@ -502,7 +534,7 @@ EventLoop::Run() noexcept
 			HandleInject();
 #endif
 
-			if (again)
+			if (again && !defer_pending)
 				/* re-evaluate timers because one of
 				   the DeferEvents may have added a
 				   new timeout */
@@ -515,11 +547,15 @@ EventLoop::Run() noexcept
 
 		/* wait for new event */
 
-		if (!next.empty())
+		if (!next.empty() || defer_pending)
 			timeout = Event::Duration{0};
 
+		stats.AddIteration(Event::Clock::now() - iteration_start);
+
 		Wait(timeout);
 
+		iteration_start = Event::Clock::now();
+
 		idle.splice(std::next(idle.begin()), next);
 
 		FlushClockCaches();
@@ -539,7 +575,13 @@ EventLoop::Run() noexcept
 			socket_event.unlink();
 			sockets.push_back(socket_event);
 
+			/* obtain the address now, because the
+			   callback may destroy the object */
+			const void *source = socket_event.GetCallbackAddress();
+			const auto start = Event::Clock::now();
 			socket_event.Dispatch();
+			AccountCallback(EventLoopStats::Category::SOCKET,
+					source, start);
 		}
 	}
 
@@ -593,7 +635,11 @@ EventLoop::HandleInject() noexcept
 		inject.pop_front();
 
 		const ScopeUnlock unlock(mutex);
+		const void *source = m.GetCallbackAddress();
+		const auto start = Event::Clock::now();
 		m.Run();
+		AccountCallback(EventLoopStats::Category::INJECT,
+				source, start);
 	}
 }
 
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "Chrono.hxx"
+#include "LoopStats.hxx"
 #include "TimerWheel.hxx"
 #include "Backend.hxx"
 #include "time/ClockCache.hxx"
@@ -83,6 +84,8 @@ class EventLoop final
 
 	using SocketList = IntrusiveList<SocketEvent>;
 
+	EventLoopStats stats;
+
 	/**
 	 * A list of scheduled #SocketEvent instances, without those
 	 * which are ready (these are in #ready_sockets).
@@ -299,8 +302,43 @@ public:
 	 */
 	void Run() noexcept;
 
+	/**
+	 * Obtain the performance counters.  Must be called from
+	 * inside the loop's thread.
+	 */
+	const EventLoopStats &GetStats() const noexcept {
+		assert(IsInside());
+		return stats;
+	}
+
+	void ResetStats() noexcept {
+		assert(IsInside());
+		stats = {};
+	}
+
 private:
-	void RunDeferred() noexcept;
+	/**
+	 * Account a callback which was started at the given time
+	 * point in #stats.
+	 *
+	 * @return the current time
+	 */
+	Event::TimePoint AccountCallback(EventLoopStats::Category category,
+					 const void *source,
+					 Event::TimePoint start) noexcept {
+		const auto now = Event::Clock::now();
+		stats.AddCallback(category, now - start, source);
+		return now;
+	}
+
+	/**
+	 * Invoke the pending #DeferEvent instances until the queue is
+	 * empty or its time budget is exhausted.
+	 *
+	 * @return false if events are still pending because the
+	 * time budget was exhausted
+	 */
+	bool RunDeferred() noexcept;
 
 	/**
 	 * Invoke one "idle" #DeferEvent.
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Chrono.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Performance counters of an #EventLoop.  They help finding out
+ * which kind of event (and which callback) delays the others.
+ */
+struct EventLoopStats {
+	enum class Category : uint_least8_t {
+		/**
+		 * Checking and invoking expired timers (all timers
+		 * of one iteration are one "callback").
+		 */
+		TIMER,
+
+		DEFER,
+		IDLE,
+		INJECT,
+		SOCKET,
+	};
+
+	static constexpr std::size_t N_CATEGORIES = 5;
+
+	struct CategoryStats {
+		uint_least64_t count = 0;
+		Event::Duration time{};
+	};
+
+	std::array<CategoryStats, N_CATEGORIES> categories{};
+
+	/**
+	 * The number of loop iterations, i.e. the number of times
+	 * the loop waited for new events.
+	 */
+	uint_least64_t iterations = 0;
+
+	/**
+	 * The total time spent handling events (i.e. not waiting).
+	 */
+	Event::Duration busy_time{};
+
+	/**
+	 * The longest time between two waits; this is the worst
+	 * latency a socket event has seen.
+	 */
+	Event::Duration max_iteration_time{};
+
+	/**
+	 * How often the #DeferEvent queue exceeded its time budget
+	 * and yielded to socket events.
+	 */
+	uint_least64_t defer_yields = 0;
+
+	Event::Duration max_callback_time{};
+	Category max_callback_category = Category::TIMER;
+
+	/**
+	 * The address of the slowest callback function (nullptr for
+	 * timers); it can be resolved with a debugger, e.g. "info
+	 * symbol" in GDB.
+	 */
+	const void *max_callback = nullptr;
+
+	static constexpr const char *GetCategoryName(Category category) noexcept {
+		constexpr const char *names[N_CATEGORIES] = {
+			"timer",
+			"defer",
+			"idle",
+			"inject",
+			"socket",
+		};
+
+		return names[static_cast<std::size_t>(category)];
+	}
+
+	void AddCallback(Category category, Event::Duration duration,
+			 const void *source) noexcept {
+		auto &c = categories[static_cast<std::size_t>(category)];
+		++c.count;
+		c.time += duration;
+
+		if (duration > max_callback_time) {
+			max_callback_time = duration;
+			max_callback_category = category;
+			max_callback = source;
+		}
+	}
+
+	void AddIteration(Event::Duration duration) noexcept {
+		++iterations;
+		busy_time += duration;
+		if (duration > max_iteration_time)
+			max_iteration_time = duration;
+	}
+};
@@ -209,4 +209,8 @@ private:
 	 * Dispatch the events that were passed to SetReadyFlags().
 	 */
 	void Dispatch() noexcept;
+
+	const void *GetCallbackAddress() const noexcept {
+		return callback.GetFunctionAddress();
+	}
 };
@@ -12,12 +12,18 @@ extern "C" {
 
 #include <string.h>
 
-FfmpegFilter::FfmpegFilter(const AudioFormat &in_audio_format,
+FfmpegFilter::FfmpegFilter(FfmpegFilterCache *_cache,
+			   const AudioFormat &_requested_audio_format,
+			   const AudioFormat &_in_audio_format,
 			   const AudioFormat &_out_audio_format,
 			   Ffmpeg::FilterGraph &&_graph,
 			   AVFilterContext &_buffer_src,
-			   AVFilterContext &_buffer_sink) noexcept
+			   AVFilterContext &_buffer_sink,
+			   int_least64_t _pts) noexcept
 	:Filter(_out_audio_format),
+	 cache(_cache),
+	 requested_audio_format(_requested_audio_format),
+	 in_audio_format(_in_audio_format),
 	 graph(std::move(_graph)),
 	 buffer_src(_buffer_src),
 	 buffer_sink(_buffer_sink),
@@ -27,13 +33,40 @@ FfmpegFilter::FfmpegFilter(const AudioFormat &in_audio_format,
 	 in_channels(in_audio_format.channels),
 #endif
 	 in_audio_frame_size(in_audio_format.GetFrameSize()),
-	 out_audio_frame_size(_out_audio_format.GetFrameSize())
+	 out_audio_frame_size(_out_audio_format.GetFrameSize()),
+	 pts(_pts)
 {
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 25, 100)
 	av_channel_layout_default(&in_ch_layout, in_audio_format.channels);
 #endif
 }
 
+FfmpegFilter::~FfmpegFilter() noexcept
+{
+	if (cache == nullptr || flushed)
+		return;
+
+	/* the output of the previous song must not leak into the
+	   next one */
+	DiscardOutput();
+
+	cache->Put({
+		requested_audio_format,
+		in_audio_format, out_audio_format,
+		std::move(graph),
+		&buffer_src, &buffer_sink,
+		pts,
+	});
+}
+
+void
+FfmpegFilter::DiscardOutput() noexcept
+{
+	do {
+		frame.Unref();
+	} while (av_buffersink_get_frame(&buffer_sink, frame.get()) >= 0);
+}
+
 inline std::span<const std::byte>
 FfmpegFilter::ReadOutput()
 {
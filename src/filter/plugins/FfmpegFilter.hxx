@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "FfmpegFilterCache.hxx"
 #include "filter/Filter.hxx"
 #include "lib/ffmpeg/Buffer.hxx"
 #include "lib/ffmpeg/Filter.hxx"
@@ -14,6 +15,19 @@
  * A #Filter implementation using FFmpeg's libavfilter.
  */
 class FfmpegFilter final : public Filter {
+	/**
+	 * Receives #graph when this object gets destroyed (unless
+	 * it has been flushed).  May be nullptr.
+	 */
+	FfmpegFilterCache *const cache;
+
+	/**
+	 * See FfmpegFilterCache::Item::requested_audio_format.
+	 */
+	const AudioFormat requested_audio_format;
+
+	const AudioFormat in_audio_format;
+
 	Ffmpeg::FilterGraph graph;
 	AVFilterContext &buffer_src, &buffer_sink;
 	Ffmpeg::Frame frame;
@@ -34,23 +48,44 @@ class FfmpegFilter final : public Filter {
 	/**
 	 * Presentation timestamp.  A counter for `AVFrame::pts`.
 	 */
-	int_least64_t pts = 0;
+	int_least64_t pts;
 
 	bool flushed = false;
 
 public:
 	/**
+	 * @param _cache receives the graph on destruction (may be
+	 * nullptr); it must outlive this object
+	 * @param _requested_audio_format the #AudioFormat passed to
+	 * PreparedFilter::Open()
 	 * @param _graph a checked and configured AVFilterGraph
 	 * @param _buffer_src an "abuffer" filter which serves as
 	 * input
 	 * @param _buffer_sink an "abuffersink" filter which serves as
 	 * output
 	 */
-	FfmpegFilter(const AudioFormat &in_audio_format,
+	FfmpegFilter(FfmpegFilterCache *_cache,
+		     const AudioFormat &_requested_audio_format,
+		     const AudioFormat &_in_audio_format,
 		     const AudioFormat &_out_audio_format,
 		     Ffmpeg::FilterGraph &&_graph,
 		     AVFilterContext &_buffer_src,
-		     AVFilterContext &_buffer_sink) noexcept;
+		     AVFilterContext &_buffer_sink,
+		     int_least64_t _pts=0) noexcept;
+
+	/**
+	 * Construct an object from a graph taken from the
+	 * #FfmpegFilterCache.
+	 */
+	FfmpegFilter(FfmpegFilterCache &_cache,
+		     FfmpegFilterCache::Item &&item) noexcept
+		:FfmpegFilter(&_cache, item.requested_audio_format,
+			      item.in_audio_format, item.out_audio_format,
+			      std::move(item.graph),
+			      *item.buffer_src, *item.buffer_sink,
+			      item.pts) {}
+
+	~FfmpegFilter() noexcept override;
 
 	/* virtual methods from class Filter */
 	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
@@ -59,4 +94,9 @@ public:
 
 private:
 	std::span<const std::byte> ReadOutput();
+
+	/**
+	 * Discard all output which is pending in #buffer_sink.
+	 */
+	void DiscardOutput() noexcept;
 };
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FfmpegFilterCache.hxx"
+
+#include <algorithm>
+
+std::optional<FfmpegFilterCache::Item>
+FfmpegFilterCache::Take(const AudioFormat &audio_format) noexcept
+{
+	auto i = std::find_if(items.begin(), items.end(), [&audio_format](const auto &item){
+		return item.requested_audio_format == audio_format;
+	});
+	if (i == items.end())
+		return std::nullopt;
+
+	std::optional<Item> result{std::move(*i)};
+	items.erase(i);
+	return result;
+}
+
+void
+FfmpegFilterCache::Put(Item &&item) noexcept
+{
+	items.emplace_front(std::move(item));
+
+	if (items.size() > MAX_ITEMS)
+		items.pop_back();
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "lib/ffmpeg/Filter.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <cstdint>
+#include <list>
+#include <optional>
+
+/**
+ * Keeps the configured filter graphs of destroyed #FfmpegFilter
+ * instances, so the next #FfmpegFilter with the same input format
+ * can reuse one instead of parsing and configuring the graph again
+ * (which can take tens of milliseconds).
+ *
+ * Graphs which have been flushed (i.e. have received end-of-stream)
+ * cannot be reused, because libavfilter has no way to restart them.
+ *
+ * This class is not thread-safe; it is owned by a
+ * #PreparedFfmpegFilter, which is only used by one output thread.
+ */
+class FfmpegFilterCache {
+public:
+	struct Item {
+		/**
+		 * The #AudioFormat passed to PreparedFilter::Open()
+		 * (the lookup key).
+		 */
+		AudioFormat requested_audio_format;
+
+		/**
+		 * The input format accepted by the "abuffer" filter
+		 * (may differ from #requested_audio_format) and the
+		 * output format.
+		 */
+		AudioFormat in_audio_format, out_audio_format;
+
+		Ffmpeg::FilterGraph graph;
+		AVFilterContext *buffer_src, *buffer_sink;
+
+		/**
+		 * The next presentation timestamp; it must not go
+		 * backwards in a graph.
+		 */
+		int_least64_t pts;
+	};
+
+private:
+	/**
+	 * Chiptune playlists switch between a handful of formats; a
+	 * small number of graphs is enough.
+	 */
+	static constexpr std::size_t MAX_ITEMS = 4;
+
+	/**
+	 * The most recently used item is at the front.
+	 */
+	std::list<Item> items;
+
+public:
+	/**
+	 * Remove a graph for the given input format from the cache
+	 * and return it.
+	 */
+	std::optional<Item> Take(const AudioFormat &audio_format) noexcept;
+
+	/**
+	 * Add a graph to the cache, possibly evicting the least
+	 * recently used one.
+	 */
+	void Put(Item &&item) noexcept;
+};
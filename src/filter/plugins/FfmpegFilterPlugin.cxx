@@ -3,6 +3,7 @@
 
 #include "FfmpegFilterPlugin.hxx"
 #include "FfmpegFilter.hxx"
+#include "FfmpegFilterCache.hxx"
 #include "filter/FilterPlugin.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
@@ -13,6 +14,13 @@
 class PreparedFfmpegFilter final : public PreparedFilter {
 	const char *const graph_string;
 
+	/**
+	 * Configured graphs of previous #FfmpegFilter instances, to
+	 * be reused on the next format change instead of building a
+	 * new one.
+	 */
+	FfmpegFilterCache cache;
+
 public:
 	explicit PreparedFfmpegFilter(const char *_graph) noexcept
 		:graph_string(_graph) {}
@@ -29,7 +37,9 @@ public:
  * format later, and eliminate this kludge
  */
 static auto
-OpenWithAformat(const char *graph_string, AudioFormat &in_audio_format)
+OpenWithAformat(FfmpegFilterCache &cache, const char *graph_string,
+		const AudioFormat requested_audio_format,
+		AudioFormat &in_audio_format)
 {
 	Ffmpeg::FilterGraph graph;
 
@@ -47,7 +57,8 @@ OpenWithAformat(const char *graph_string, AudioFormat &in_audio_format)
 	graph.ParseSingleInOut(graph_string, aformat, buffer_src);
 	graph.CheckAndConfigure();
 
-	return std::make_unique<FfmpegFilter>(in_audio_format,
+	return std::make_unique<FfmpegFilter>(&cache, requested_audio_format,
+					      in_audio_format,
 					      out_audio_format,
 					      std::move(graph),
 					      buffer_src,
@@ -57,6 +68,15 @@ OpenWithAformat(const char *graph_string, AudioFormat &in_audio_format)
 std::unique_ptr<Filter>
 PreparedFfmpegFilter::Open(AudioFormat &in_audio_format)
 {
+	if (auto item = cache.Take(in_audio_format)) {
+		/* this graph has been configured for the same format
+		   already */
+		in_audio_format = item->in_audio_format;
+		return std::make_unique<FfmpegFilter>(cache, std::move(*item));
+	}
+
+	const AudioFormat requested_audio_format = in_audio_format;
+
 	Ffmpeg::FilterGraph graph;
 
 	auto &buffer_src =
@@ -85,9 +105,12 @@ PreparedFfmpegFilter::Open(AudioFormat &in_audio_format)
 		   workaround for this MPD API deficiency, try again
 		   with an "aformat" filter which forces a specific
 		   output format */
-		return OpenWithAformat(graph_string, in_audio_format);
+		return OpenWithAformat(cache, graph_string,
+				       requested_audio_format,
+				       in_audio_format);
 
-	return std::make_unique<FfmpegFilter>(in_audio_format,
+	return std::make_unique<FfmpegFilter>(&cache, requested_audio_format,
+					      in_audio_format,
 					      out_audio_format,
 					      std::move(graph),
 					      buffer_src,
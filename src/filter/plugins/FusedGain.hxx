@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "pcm/Volume.hxx"
+
+/**
+ * Passes the ReplayGain scale from the ReplayGainFilter to the
+ * VolumeFilter of the same output.  The ReplayGainFilter then leaves
+ * the PCM data alone, and the VolumeFilter applies both levels with
+ * one PcmVolume pass (and one dither) at the end of the filter
+ * chain.
+ *
+ * This is only correct if all filters between the two are linear,
+ * i.e. if there is nothing but the ConvertFilter (see
+ * FilteredAudioOutput::share_filter).
+ *
+ * Both filters are used only by the output thread, therefore this
+ * needs no locking.
+ */
+class FusedGain {
+	/**
+	 * The ReplayGain volume level; #PCM_VOLUME_1 means no
+	 * change.
+	 */
+	unsigned replay_gain = PCM_VOLUME_1;
+
+public:
+	unsigned GetReplayGain() const noexcept {
+		return replay_gain;
+	}
+
+	void SetReplayGain(unsigned _replay_gain) noexcept {
+		replay_gain = _replay_gain;
+	}
+};
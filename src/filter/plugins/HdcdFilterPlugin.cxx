@@ -39,7 +39,8 @@ OpenHdcdFilter(AudioFormat &in_audio_format)
 	// TODO: convert to 32 bit only if HDCD actually detected
 	out_audio_format.format = SampleFormat::S32;
 
-	return std::make_unique<FfmpegFilter>(in_audio_format,
+	return std::make_unique<FfmpegFilter>(nullptr, in_audio_format,
+					      in_audio_format,
 					      out_audio_format,
 					      std::move(graph),
 					      buffer_src,
@@ -8,8 +8,13 @@
 #include "pcm/Buffer.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "pcm/Normalizer.hxx"
+#include "pcm/LookaheadNormalizer.hxx"
+#include "config/Block.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 #include "util/SpanCast.hxx"
 
+#include <string.h>
+
 class NormalizeFilter final : public Filter {
 	PcmNormalizer normalizer;
 
@@ -31,21 +36,85 @@ public:
 	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
 };
 
+/**
+ * The "lookahead" mode: see #PcmLookaheadNormalizer.
+ */
+class LookaheadNormalizeFilter final : public Filter {
+	PcmLookaheadNormalizer normalizer;
+
+public:
+	LookaheadNormalizeFilter(const AudioFormat &audio_format,
+				 std::chrono::milliseconds window,
+				 float max_gain) noexcept
+		:Filter(audio_format),
+		 normalizer(audio_format.sample_rate, audio_format.channels,
+			    window, max_gain) {}
+
+	/* virtual methods from class Filter */
+	void Reset() noexcept override {
+		normalizer.Reset();
+	}
+
+	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override {
+		return std::as_bytes(normalizer.Process(FromBytesStrict<const float>(src)));
+	}
+
+	std::span<const std::byte> Flush() override {
+		return std::as_bytes(normalizer.Flush());
+	}
+};
+
 class PreparedNormalizeFilter final : public PreparedFilter {
+	/**
+	 * The look-ahead window; zero selects the classic
+	 * (AudioCompress) implementation.
+	 */
+	const std::chrono::milliseconds window;
+
+	const float max_gain;
+
 public:
+	explicit PreparedNormalizeFilter(std::chrono::milliseconds _window={},
+					 float _max_gain=32) noexcept
+		:window(_window), max_gain(_max_gain) {}
+
 	/* virtual methods from class PreparedFilter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
 static std::unique_ptr<PreparedFilter>
-normalize_filter_init([[maybe_unused]] const ConfigBlock &block)
+normalize_filter_init(const ConfigBlock &block)
 {
-	return std::make_unique<PreparedNormalizeFilter>();
+	const char *mode = block.GetBlockValue("mode", "classic");
+	if (strcmp(mode, "classic") == 0)
+		return std::make_unique<PreparedNormalizeFilter>();
+
+	if (strcmp(mode, "lookahead") != 0)
+		throw FmtRuntimeError("Invalid normalize mode {:?} in line {}",
+				      mode, block.line);
+
+	const std::chrono::milliseconds window{block.GetPositiveValue("window", 500U)};
+
+	const double max_gain = block.GetBlockValue("max_gain", 32.0);
+	if (max_gain < 1 || max_gain > 1000)
+		throw FmtRuntimeError("Invalid max_gain in line {}",
+				      block.line);
+
+	return std::make_unique<PreparedNormalizeFilter>(window,
+							 float(max_gain));
 }
 
 std::unique_ptr<Filter>
 PreparedNormalizeFilter::Open(AudioFormat &audio_format)
 {
+	if (window.count() > 0) {
+		audio_format.format = SampleFormat::FLOAT;
+
+		return std::make_unique<LookaheadNormalizeFilter>(audio_format,
+								  window,
+								  max_gain);
+	}
+
 	audio_format.format = SampleFormat::S16;
 
 	return std::make_unique<NormalizeFilter>(audio_format);
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "ReplayGainFilterPlugin.hxx"
+#include "FusedGain.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "tag/ReplayGainInfo.hxx"
@@ -28,6 +29,13 @@ class ReplayGainFilter final : public Filter {
 	 */
 	Mixer *const mixer;
 
+	/**
+	 * If set, then the replay gain is passed to the
+	 * #VolumeFilter instead of being applied here (unless
+	 * #fused is cleared).
+	 */
+	FusedGain *const fused_gain;
+
 	/**
 	 * The base volume level for scale=1.0, between 1 and 100
 	 * (including).
@@ -36,6 +44,13 @@ class ReplayGainFilter final : public Filter {
 
 	ReplayGainMode mode = ReplayGainMode::OFF;
 
+	/**
+	 * Use #fused_gain?  This is cleared temporarily while
+	 * cross-fading, because then each song needs its own replay
+	 * gain before mixing.
+	 */
+	bool fused = true;
+
 	ReplayGainInfo info;
 
 	/**
@@ -55,10 +70,11 @@ class ReplayGainFilter final : public Filter {
 public:
 	ReplayGainFilter(const ReplayGainConfig &_config, bool allow_convert,
 			 const AudioFormat &audio_format,
-			 Mixer *_mixer, unsigned _base)
+			 Mixer *_mixer, FusedGain *_fused_gain,
+			 unsigned _base)
 		:Filter(audio_format),
 		 config(_config),
-		 mixer(_mixer), base(_base) {
+		 mixer(_mixer), fused_gain(_fused_gain), base(_base) {
 		info.Clear();
 
 		out_audio_format.format = pv.Open(out_audio_format.format,
@@ -87,6 +103,27 @@ public:
 		Update();
 	}
 
+	void SetFused(bool _fused) {
+		if (fused_gain == nullptr || _fused == fused)
+			/* no change */
+			return;
+
+		fused = _fused;
+		Update();
+	}
+
+	bool IsFused() const noexcept {
+		return fused_gain != nullptr && fused;
+	}
+
+	bool IsSoftware() const noexcept {
+		return mixer == nullptr && !IsFused();
+	}
+
+	bool IsIdentity() const noexcept {
+		return !IsSoftware() || pv.IsIdentity();
+	}
+
 	/**
 	 * Recalculates the new volume after a property was changed.
 	 */
@@ -105,6 +142,12 @@ class PreparedReplayGainFilter final : public PreparedFilter {
 	 */
 	Mixer *mixer = nullptr;
 
+	/**
+	 * If set, then the replay gain is passed to the
+	 * #VolumeFilter instead of being applied by this filter.
+	 */
+	FusedGain *fused_gain = nullptr;
+
 	/**
 	 * Allow the class to convert to a different #SampleFormat to
 	 * preserve quality?
@@ -129,6 +172,12 @@ public:
 		base = _base;
 	}
 
+	void SetFusedGain(FusedGain *_fused_gain) noexcept {
+		assert(_fused_gain == nullptr || mixer == nullptr);
+
+		fused_gain = _fused_gain;
+	}
+
 	/* virtual methods from class Filter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
@@ -164,8 +213,16 @@ ReplayGainFilter::Update()
 			LogError(std::current_exception(),
 				 "Failed to update hardware mixer");
 		}
-	} else
+	} else if (IsFused()) {
+		/* let the VolumeFilter apply it */
+		fused_gain->SetReplayGain(volume);
+		pv.SetVolume(PCM_VOLUME_1);
+	} else {
+		if (fused_gain != nullptr)
+			fused_gain->SetReplayGain(PCM_VOLUME_1);
+
 		pv.SetVolume(volume);
+	}
 }
 
 std::unique_ptr<PreparedFilter>
@@ -180,15 +237,16 @@ std::unique_ptr<Filter>
 PreparedReplayGainFilter::Open(AudioFormat &af)
 {
 	return std::make_unique<ReplayGainFilter>(config, allow_convert,
-						  af, mixer, base);
+						  af, mixer, fused_gain,
+						  base);
 }
 
 std::span<const std::byte>
 ReplayGainFilter::FilterPCM(std::span<const std::byte> src)
 {
-	return mixer != nullptr
-		? std::span<const std::byte>{src}
-		: pv.Apply(src);
+	return IsSoftware()
+		? pv.Apply(src)
+		: std::span<const std::byte>{src};
 }
 
 void
@@ -200,6 +258,15 @@ replay_gain_filter_set_mixer(PreparedFilter &_filter, Mixer *mixer,
 	filter.SetMixer(mixer, base);
 }
 
+void
+replay_gain_filter_set_fused_gain(PreparedFilter &_filter,
+				  FusedGain *fused_gain) noexcept
+{
+	auto &filter = (PreparedReplayGainFilter &)_filter;
+
+	filter.SetFusedGain(fused_gain);
+}
+
 void
 replay_gain_filter_set_info(Filter &_filter, const ReplayGainInfo *info)
 {
@@ -215,3 +282,27 @@ replay_gain_filter_set_mode(Filter &_filter, ReplayGainMode mode)
 
 	filter.SetMode(mode);
 }
+
+void
+replay_gain_filter_set_fused(Filter &_filter, bool fused)
+{
+	auto &filter = (ReplayGainFilter &)_filter;
+
+	filter.SetFused(fused);
+}
+
+bool
+replay_gain_filter_is_software(const Filter &_filter) noexcept
+{
+	const auto &filter = (const ReplayGainFilter &)_filter;
+
+	return filter.IsSoftware();
+}
+
+bool
+replay_gain_filter_is_identity(const Filter &_filter) noexcept
+{
+	const auto &filter = (const ReplayGainFilter &)_filter;
+
+	return filter.IsIdentity();
+}
@@ -11,6 +11,7 @@
 class Filter;
 class PreparedFilter;
 class Mixer;
+class FusedGain;
 struct ReplayGainConfig;
 struct ReplayGainInfo;
 
@@ -34,6 +35,18 @@ void
 replay_gain_filter_set_mixer(PreparedFilter &_filter, Mixer *mixer,
 			     unsigned base);
 
+/**
+ * Pass the replay gain to the #VolumeFilter (which shares the given
+ * #FusedGain object) instead of applying it in this filter.  Must not
+ * be combined with replay_gain_filter_set_mixer().
+ *
+ * @param fused_gain the #FusedGain object, or nullptr to apply the
+ * replay gain here
+ */
+void
+replay_gain_filter_set_fused_gain(PreparedFilter &filter,
+				  FusedGain *fused_gain) noexcept;
+
 /**
  * Sets a new #ReplayGainInfo at the beginning of a new song.
  *
@@ -46,4 +59,33 @@ replay_gain_filter_set_info(Filter &filter, const ReplayGainInfo *info);
 void
 replay_gain_filter_set_mode(Filter &filter, ReplayGainMode mode);
 
+/**
+ * Temporarily apply the replay gain in this filter even though a
+ * #FusedGain was configured (or switch back to passing it to the
+ * #VolumeFilter).  This is necessary while cross-fading, because
+ * then the two songs need different levels before they get mixed.
+ * No-op if replay_gain_filter_set_fused_gain() was not used.
+ */
+void
+replay_gain_filter_set_fused(Filter &filter, bool fused);
+
+/**
+ * Does this filter apply replay gain to the PCM data?  Returns false
+ * if a hardware mixer or the #VolumeFilter (see
+ * replay_gain_filter_set_fused()) is used instead (and the PCM data
+ * passes unmodified).
+ */
+[[gnu::pure]]
+bool
+replay_gain_filter_is_software(const Filter &filter) noexcept;
+
+/**
+ * Does this filter currently pass the PCM data unmodified, i.e. is
+ * the replay gain not applied in software or is its level 100%
+ * (e.g. with #ReplayGainMode::OFF)?
+ */
+[[gnu::pure]]
+bool
+replay_gain_filter_is_identity(const Filter &filter) noexcept;
+
 #endif
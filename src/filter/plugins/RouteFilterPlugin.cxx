@@ -29,8 +29,7 @@
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "pcm/AudioFormat.hxx"
-#include "pcm/Buffer.hxx"
-#include "pcm/Silence.hxx"
+#include "pcm/ChannelRouter.hxx"
 #include "lib/fmt/RuntimeError.hxx"
 #include "util/StringStrip.hxx"
 
@@ -38,46 +37,23 @@
 #include <cstdint>
 #include <stdexcept>
 
-#include <string.h>
 #include <stdlib.h>
 
 class RouteFilter final : public Filter {
 	/**
-	 * The set of copy operations to perform on each sample
-	 * The index is an output channel to use, the value is
-	 * a corresponding input channel from which to take the
-	 * data. A -1 means "no source"
-	 */
-	const std::array<int8_t, MAX_CHANNELS> sources;
-
-	/**
-	 * The actual input format of our signal, once opened
-	 */
-	const AudioFormat input_format;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * input buffer
-	 */
-	const size_t input_frame_size;
-
-	/**
-	 * The size, in bytes, of each multichannel frame in the
-	 * output buffer
-	 */
-	size_t output_frame_size;
-
-	/**
-	 * The output buffer used last time around, can be reused if the size doesn't differ.
+	 * Performs the copy operations; it has been compiled from
+	 * the "sources" table.
 	 */
-	PcmBuffer output_buffer;
+	PcmChannelRouter router;
 
 public:
 	RouteFilter(const AudioFormat &audio_format, unsigned out_channels,
-		    const std::array<int8_t, MAX_CHANNELS> &_sources);
+		    const PcmChannelRoute &sources) noexcept;
 
 	/* virtual methods from class Filter */
-	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
+	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override {
+		return router.Convert(src);
+	}
 };
 
 class PreparedRouteFilter final : public PreparedFilter {
@@ -101,7 +77,7 @@ class PreparedRouteFilter final : public PreparedFilter {
 	 * a corresponding input channel from which to take the
 	 * data. A -1 means "no source"
 	 */
-	std::array<int8_t, MAX_CHANNELS> sources;
+	PcmChannelRoute sources;
 
 public:
 	/**
@@ -185,16 +161,15 @@ route_filter_init(const ConfigBlock &block)
 
 RouteFilter::RouteFilter(const AudioFormat &audio_format,
 			 unsigned out_channels,
-			 const std::array<int8_t, MAX_CHANNELS> &_sources)
-	:Filter(audio_format), sources(_sources), input_format(audio_format),
-	 input_frame_size(input_format.GetFrameSize())
+			 const PcmChannelRoute &sources) noexcept
+	:Filter(audio_format)
 {
 	// Decide on an output format which has enough channels,
 	// and is otherwise identical
 	out_audio_format.channels = out_channels;
 
-	// Precalculate this simple value, to speed up allocation later
-	output_frame_size = out_audio_format.GetFrameSize();
+	router.Open(audio_format.format, audio_format.channels, out_channels,
+		    sources);
 }
 
 std::unique_ptr<Filter>
@@ -204,56 +179,6 @@ PreparedRouteFilter::Open(AudioFormat &audio_format)
 					     sources);
 }
 
-std::span<const std::byte>
-RouteFilter::FilterPCM(std::span<const std::byte> src)
-{
-	size_t number_of_frames = src.size() / input_frame_size;
-
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
-
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const auto *base_source = (const uint8_t *)src.data();
-
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	const size_t result_size = number_of_frames * output_frame_size;
-	void *const result = output_buffer.Get(result_size);
-
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	auto *chan_destination = (std::byte *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned c = 0; c < out_audio_format.channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				PcmSilence({chan_destination, bytes_per_frame_per_channel},
-					   input_format.format);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
-		}
-
-
-		// Go on to the next N input samples
-		base_source += input_frame_size;
-	}
-
-	// Here it is, ladies and gentlemen! Rerouted data!
-	return { (const std::byte *)result, result_size };
-}
-
 const FilterPlugin route_filter_plugin = {
 	"route",
 	route_filter_init,
@@ -2,35 +2,82 @@
 // Copyright The Music Player Daemon Project
 
 #include "VolumeFilterPlugin.hxx"
+#include "FusedGain.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
 #include "pcm/Volume.hxx"
 #include "pcm/AudioFormat.hxx"
 
+#include <cstdint>
+
 class VolumeFilter final : public Filter {
 	PcmVolume pv;
 
+	/**
+	 * If set, then the replay gain from this object is applied
+	 * together with the software volume.
+	 */
+	const FusedGain *const fused_gain;
+
+	/**
+	 * The software volume level set by the #SoftwareMixer.
+	 */
+	unsigned volume = PCM_VOLUME_1;
+
+	/**
+	 * The replay gain level (from #fused_gain) which is currently
+	 * applied.
+	 */
+	unsigned replay_gain = PCM_VOLUME_1;
+
 public:
-	explicit VolumeFilter(const AudioFormat &audio_format)
-		:Filter(audio_format) {
+	VolumeFilter(const AudioFormat &audio_format, bool allow_convert,
+		     const FusedGain *_fused_gain)
+		:Filter(audio_format), fused_gain(_fused_gain) {
 		out_audio_format.format = pv.Open(out_audio_format.format,
-						  true);
+						  allow_convert);
+
+		if (fused_gain != nullptr) {
+			replay_gain = fused_gain->GetReplayGain();
+			pv.SetVolume(GetCombinedVolume());
+		}
+
+		/* fade volume changes over 20 ms */
+		pv.EnableRamp(audio_format.channels,
+			      audio_format.sample_rate / 50);
 	}
 
 	[[nodiscard]] unsigned GetVolume() const noexcept {
-		return pv.GetVolume();
+		return volume;
 	}
 
 	void SetVolume(unsigned _volume) noexcept {
-		pv.SetVolume(_volume);
+		volume = _volume;
+		pv.SetVolume(GetCombinedVolume());
+	}
+
+private:
+	[[gnu::pure]]
+	unsigned GetCombinedVolume() const noexcept {
+		return uint_least64_t(volume) * replay_gain / PCM_VOLUME_1;
 	}
 
+public:
+
 	/* virtual methods from class Filter */
 	std::span<const std::byte> FilterPCM(std::span<const std::byte> src) override;
 };
 
 class PreparedVolumeFilter final : public PreparedFilter {
+	const FusedGain *const fused_gain;
+
+	const bool allow_convert;
+
 public:
+	constexpr PreparedVolumeFilter(bool _allow_convert,
+				       const FusedGain *_fused_gain) noexcept
+		:fused_gain(_fused_gain), allow_convert(_allow_convert) {}
+
 	/* virtual methods from class Filter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
@@ -38,19 +85,31 @@ public:
 std::unique_ptr<Filter>
 PreparedVolumeFilter::Open(AudioFormat &audio_format)
 {
-	return std::make_unique<VolumeFilter>(audio_format);
+	return std::make_unique<VolumeFilter>(audio_format, allow_convert,
+					      fused_gain);
 }
 
 std::span<const std::byte>
 VolumeFilter::FilterPCM(std::span<const std::byte> src)
 {
+	if (fused_gain != nullptr &&
+	    fused_gain->GetReplayGain() != replay_gain) {
+		/* a new song with a different replay gain has
+		   started; switch abruptly, just like the
+		   #ReplayGainFilter would */
+		replay_gain = fused_gain->GetReplayGain();
+		pv.JumpVolume(GetCombinedVolume());
+	}
+
 	return pv.Apply(src);
 }
 
 std::unique_ptr<PreparedFilter>
-volume_filter_prepare() noexcept
+volume_filter_prepare(bool allow_convert,
+		      const FusedGain *fused_gain) noexcept
 {
-	return std::make_unique<PreparedVolumeFilter>();
+	return std::make_unique<PreparedVolumeFilter>(allow_convert,
+						      fused_gain);
 }
 
 unsigned
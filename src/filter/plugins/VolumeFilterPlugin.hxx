@@ -8,9 +8,19 @@
 
 class PreparedFilter;
 class Filter;
+class FusedGain;
 
+/**
+ * @param allow_convert allow the filter to convert S16 to S24 to
+ * preserve precision; must be false if the filter is the last one
+ * in the chain, because its output is sent to the device as-is
+ * @param fused_gain if not nullptr, then the replay gain from this
+ * object is applied together with the software volume (see
+ * replay_gain_filter_set_fused_gain())
+ */
 std::unique_ptr<PreparedFilter>
-volume_filter_prepare() noexcept;
+volume_filter_prepare(bool allow_convert=true,
+		      const FusedGain *fused_gain=nullptr) noexcept;
 
 unsigned
 volume_filter_get(const Filter *filter) noexcept;
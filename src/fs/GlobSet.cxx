@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "GlobSet.hxx"
+
+#ifdef HAVE_CLASS_GLOB
+
+#include <algorithm>
+
+#ifdef HAVE_FNMATCH
+
+/**
+ * Split a pattern at each unescaped "*" and resolve backslash
+ * escapes.
+ *
+ * @return false if the pattern contains other wildcards (or a
+ * trailing backslash) and needs to be passed to fnmatch()
+ */
+static bool
+SplitStarPattern(const char *pattern, std::vector<std::string> &segments)
+{
+	segments.emplace_back();
+
+	for (const char *p = pattern; *p != 0; ++p) {
+		switch (*p) {
+		case '*':
+			segments.emplace_back();
+			break;
+
+		case '?':
+		case '[':
+			return false;
+
+		case '\\':
+			if (*++p == 0)
+				return false;
+
+			[[fallthrough]];
+
+		default:
+			segments.back().push_back(*p);
+			break;
+		}
+	}
+
+	return true;
+}
+
+static void
+AddLength(std::vector<std::size_t> &lengths, std::size_t length) noexcept
+{
+	if (std::find(lengths.begin(), lengths.end(), length) == lengths.end())
+		lengths.push_back(length);
+}
+
+void
+GlobSet::Add(const char *pattern)
+{
+	std::vector<std::string> segments;
+	if (!SplitStarPattern(pattern, segments)) {
+		others.emplace_back(pattern);
+		return;
+	}
+
+	if (segments.size() == 1) {
+		/* no wildcard */
+		literals.emplace(std::move(segments.front()));
+		return;
+	}
+
+	StarPattern sp{
+		std::move(segments.front()),
+		std::move(segments.back()),
+		{},
+	};
+
+	for (auto i = std::next(segments.begin()),
+		     end = std::prev(segments.end());
+	     i != end; ++i)
+		if (!i->empty())
+			sp.middle.emplace_back(std::move(*i));
+
+	if (!sp.middle.empty()) {
+		star_patterns.emplace_back(std::move(sp));
+	} else if (sp.prefix.empty() && sp.suffix.empty()) {
+		match_all = true;
+	} else if (sp.prefix.empty()) {
+		AddLength(suffix_lengths, sp.suffix.size());
+		suffixes.emplace(std::move(sp.suffix));
+	} else if (sp.suffix.empty()) {
+		AddLength(prefix_lengths, sp.prefix.size());
+		prefixes.emplace(std::move(sp.prefix));
+	} else {
+		star_patterns.emplace_back(std::move(sp));
+	}
+}
+
+inline bool
+GlobSet::StarPattern::Check(std::string_view name) const noexcept
+{
+	if (name.size() < prefix.size() + suffix.size() ||
+	    !name.starts_with(prefix) || !name.ends_with(suffix))
+		return false;
+
+	/* the part between prefix and suffix must contain all middle
+	   segments in this order; matching each one as early as
+	   possible leaves the most room for the following ones */
+	name = name.substr(prefix.size(),
+			   name.size() - prefix.size() - suffix.size());
+
+	for (const auto &i : middle) {
+		const auto p = name.find(i);
+		if (p == name.npos)
+			return false;
+
+		name = name.substr(p + i.size());
+	}
+
+	return true;
+}
+
+bool
+GlobSet::Check(const char *name_fs) const noexcept
+{
+	if (match_all)
+		return true;
+
+	const std::string_view name{name_fs};
+
+	if (literals.contains(name))
+		return true;
+
+	for (const std::size_t length : suffix_lengths)
+		if (length <= name.size() &&
+		    suffixes.contains(name.substr(name.size() - length)))
+			return true;
+
+	for (const std::size_t length : prefix_lengths)
+		if (length <= name.size() &&
+		    prefixes.contains(name.substr(0, length)))
+			return true;
+
+	for (const auto &i : star_patterns)
+		if (i.Check(name))
+			return true;
+
+	return std::any_of(others.begin(), others.end(), [name_fs](const auto &i){
+		return i.Check(name_fs);
+	});
+}
+
+#else
+
+void
+GlobSet::Add(const char *pattern)
+{
+	others.emplace_back(pattern);
+}
+
+bool
+GlobSet::Check(const char *name_fs) const noexcept
+{
+	return std::any_of(others.begin(), others.end(), [name_fs](const auto &i){
+		return i.Check(name_fs);
+	});
+}
+
+#endif /* !HAVE_FNMATCH */
+
+#endif /* HAVE_CLASS_GLOB */
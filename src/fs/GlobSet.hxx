@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Glob.hxx"
+
+#ifdef HAVE_CLASS_GLOB
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * A set of #Glob patterns, compiled for checking a file name against
+ * all of them at once:
+ *
+ * - patterns without wildcards are looked up in a hash set
+ * - "*suffix" and "prefix*" patterns are looked up in hash sets, one
+ *   lookup per distinct suffix/prefix length
+ * - other patterns which use only "*" are matched by searching their
+ *   literal segments
+ * - only the remaining patterns (with "?" or bracket expressions) are
+ *   passed to Glob::Check()
+ *
+ * Without fnmatch() (i.e. on Windows), the wildcard semantics are
+ * different, and all patterns are passed to Glob::Check().
+ */
+class GlobSet {
+	struct StringHash {
+		using is_transparent = void;
+
+		[[gnu::pure]]
+		std::size_t operator()(std::string_view s) const noexcept {
+			return std::hash<std::string_view>{}(s);
+		}
+	};
+
+	using StringSet = std::unordered_set<std::string, StringHash,
+					     std::equal_to<>>;
+
+	/**
+	 * A pattern with at least one "*", split at each "*".
+	 */
+	struct StarPattern {
+		std::string prefix, suffix;
+
+		/**
+		 * The non-empty segments between the first and the
+		 * last "*".
+		 */
+		std::vector<std::string> middle;
+
+		[[gnu::pure]]
+		bool Check(std::string_view name) const noexcept;
+	};
+
+	StringSet literals, prefixes, suffixes;
+
+	/**
+	 * The distinct lengths of all #prefixes and #suffixes.
+	 */
+	std::vector<std::size_t> prefix_lengths, suffix_lengths;
+
+	std::vector<StarPattern> star_patterns;
+
+	std::vector<Glob> others;
+
+	/**
+	 * Was the pattern "*" added?
+	 */
+	bool match_all = false;
+
+public:
+	bool empty() const noexcept {
+		return !match_all && literals.empty() &&
+			prefixes.empty() && suffixes.empty() &&
+			star_patterns.empty() && others.empty();
+	}
+
+	/**
+	 * Add a pattern which shall match in addition to all patterns
+	 * added before.
+	 */
+	void Add(const char *pattern);
+
+	/**
+	 * Does one of the patterns match the specified file name?
+	 */
+
+	[[gnu::pure]]
+	bool Check(const char *name_fs) const noexcept;
+};
+
+#endif /* HAVE_CLASS_GLOB */
@@ -22,6 +22,15 @@ BufferingInputStream::BufferingInputStream(InputStreamPtr _input)
 
 BufferingInputStream::~BufferingInputStream() noexcept
 {
+	StopThread();
+}
+
+void
+BufferingInputStream::StopThread() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
 	{
 		const std::lock_guard lock{mutex};
 		stop = true;
@@ -168,8 +177,11 @@ BufferingInputStream::RunThread() noexcept
 
 	std::unique_lock lock{mutex};
 
+	bool complete = false;
+
 	try {
 		RunThreadLocked(lock);
+		complete = FindFirstHole() == INVALID_OFFSET;
 	} catch (...) {
 		error = std::current_exception();
 		client_cond.notify_all();
@@ -185,4 +197,9 @@ BufferingInputStream::RunThread() noexcept
 
 	/* and now actually destruct the InputStream */
 	_input.reset();
+
+	if (complete)
+		/* no more writes can happen, so the buffer may be
+		   accessed without holding the mutex */
+		OnBufferComplete(buffer.Read(0).defined_buffer);
 }
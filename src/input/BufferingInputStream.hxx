@@ -84,12 +84,31 @@ public:
 	 */
 	void Check();
 
+	/**
+	 * Has reading from the #InputStream failed?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	bool HasError() const noexcept {
+		return error != nullptr;
+	}
+
 	/**
 	 * Check whether data is available in the buffer at the given
 	 * offset..
 	 */
 	bool IsAvailable(size_t offset) const noexcept;
 
+	/**
+	 * Has the whole file been read into the buffer?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	[[gnu::pure]]
+	bool IsComplete() const noexcept {
+		return FindFirstHole() == INVALID_OFFSET;
+	}
+
 	/**
 	 * Copy data from the buffer into the given pointer.
 	 *
@@ -106,6 +125,21 @@ protected:
 	 */
 	virtual void OnBufferAvailable() noexcept {}
 
+	/**
+	 * This virtual method gets called by the buffering thread
+	 * after the whole file has been read successfully.  The mutex
+	 * is not locked, and the buffer will not be modified anymore.
+	 */
+	virtual void OnBufferComplete([[maybe_unused]] std::span<const std::byte> data) noexcept {}
+
+	/**
+	 * Stop the buffering thread and wait for it to exit.  A
+	 * derived class which overrides one of the virtual methods
+	 * must call this in its destructor, because the thread may
+	 * still be calling it.
+	 */
+	void StopThread() noexcept;
+
 private:
 	size_t FindFirstHole() const noexcept;
 
@@ -7,6 +7,8 @@
 #include "util/UriExtract.hxx"
 #include "util/UriQueryParser.hxx"
 
+#include <algorithm> // for std::min()
+#include <array>
 #include <string>
 
 IcyInputStream::IcyInputStream(InputStreamPtr _input,
@@ -74,18 +76,46 @@ IcyInputStream::Read(std::unique_lock<Mutex> &lock,
 		return ProxyInputStream::Read(lock, dest);
 
 	while (true) {
-		size_t nbytes = ProxyInputStream::Read(lock, dest);
+		const std::size_t data_rest = parser->GetDataRest();
+		if (data_rest > 0) {
+			/* read normal data up to the next metadata
+			   block directly into the caller's buffer,
+			   plus the length byte of that block (if
+			   there is room); this byte is at the end, so
+			   nothing needs to be moved */
+			if (dest.size() > data_rest)
+				dest = dest.first(data_rest + 1);
+
+			std::size_t nbytes = ProxyInputStream::Read(lock, dest);
+			if (nbytes == 0) {
+				assert(IsEOF());
+				offset = override_offset;
+				return 0;
+			}
+
+			if (nbytes > data_rest) {
+				parser->Data(data_rest);
+				parser->Meta(dest.subspan(data_rest, 1));
+				nbytes = data_rest;
+			} else
+				parser->Data(nbytes);
+
+			override_offset += nbytes;
+			offset = override_offset;
+			return nbytes;
+		}
+
+		/* read the metadata block into a separate buffer */
+		std::array<std::byte, 1024> buffer;
+		const auto b = std::span{buffer}.first(std::min(buffer.size(),
+								parser->GetMetaRest()));
+		const std::size_t nbytes = ProxyInputStream::Read(lock, b);
 		if (nbytes == 0) {
 			assert(IsEOF());
 			offset = override_offset;
 			return 0;
 		}
 
-		size_t result = parser->ParseInPlace(dest.first(nbytes));
-		if (result > 0) {
-			override_offset += result;
-			offset = override_offset;
-			return result;
-		}
+		parser->Meta(b.first(nbytes));
 	}
 }
@@ -66,6 +66,14 @@ struct InputPlugin {
 	std::unique_ptr<RemoteTagScanner> (*scan_tags)(std::string_view uri,
 						       RemoteTagHandler &handler) = nullptr;
 
+	/**
+	 * Optional hint that the given URI is likely to be opened
+	 * soon, e.g. because it is the next song in the queue.  The
+	 * plugin may use this to resolve it in the background.  Must
+	 * not block.
+	 */
+	void (*prefetch)(std::string_view uri) noexcept = nullptr;
+
 	[[gnu::pure]]
 	bool SupportsUri(std::string_view uri) const noexcept;
 
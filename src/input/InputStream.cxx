@@ -4,6 +4,7 @@
 #include "InputStream.hxx"
 #include "Handler.hxx"
 #include "tag/Tag.hxx"
+#include "system/Probe.hxx"
 #include "util/StringCompare.hxx"
 
 #include <cassert>
@@ -97,7 +98,9 @@ InputStream::LockRead(std::span<std::byte> dest)
 	assert(!dest.empty());
 
 	std::unique_lock lock{mutex};
-	return Read(lock, dest);
+	const std::size_t nbytes = Read(lock, dest);
+	MPD_PROBE(input_read, GetURI(), dest.size(), nbytes);
+	return nbytes;
 }
 
 void
@@ -107,6 +110,7 @@ InputStream::ReadFull(std::unique_lock<Mutex> &lock, std::span<std::byte> dest)
 
 	do {
 		std::size_t nbytes = Read(lock, dest);
+		MPD_PROBE(input_read, GetURI(), dest.size(), nbytes);
 		if (nbytes == 0)
 			throw std::runtime_error("Unexpected end of file");
 
@@ -391,6 +391,32 @@ public:
 	 */
 	void LockReadFull(std::span<std::byte> dest);
 
+	/**
+	 * Returns the whole contents of this stream if they are
+	 * available in memory, allowing the caller to access them
+	 * without copying.  The returned span is independent of (and
+	 * does not modify) the current offset, and it remains valid
+	 * as long as this object exists.
+	 *
+	 * The default implementation returns an empty span.
+	 *
+	 * The caller must lock the mutex.
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	virtual std::span<const std::byte> GetContiguous() const noexcept {
+		return {};
+	}
+
+	/**
+	 * Wrapper for GetContiguous() which locks and unlocks the
+	 * mutex; the caller must not be holding it already.
+	 */
+	[[nodiscard]] [[gnu::pure]]
+	std::span<const std::byte> LockGetContiguous() const noexcept {
+		const std::lock_guard protect{mutex};
+		return GetContiguous();
+	}
+
 protected:
 	void InvokeOnReady() noexcept;
 	void InvokeOnAvailable() noexcept;
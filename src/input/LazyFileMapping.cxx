@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "LazyFileMapping.hxx"
+
+#include <sys/mman.h>
+
+/**
+ * Files up to this size may be mapped into memory.  This covers
+ * modules and chiptunes, which are loaded completely by their
+ * decoders; larger files are only read with read() (or io_uring),
+ * which needs less address space.
+ */
+static constexpr offset_type FILE_MMAP_MAX_SIZE = 8 * 1024 * 1024;
+
+LazyFileMapping::~LazyFileMapping() noexcept
+{
+	if (mapping != nullptr)
+		munmap(mapping, mapping_size);
+}
+
+std::span<const std::byte>
+LazyFileMapping::Get(FileDescriptor fd, offset_type size) const noexcept
+{
+	if (!tried) {
+		tried = true;
+
+		if (size == 0 || size > FILE_MMAP_MAX_SIZE)
+			return {};
+
+		void *const p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+				     fd.Get(), 0);
+		if (p == MAP_FAILED)
+			return {};
+
+		mapping = p;
+		mapping_size = size;
+	}
+
+	return {static_cast<const std::byte *>(mapping), mapping_size};
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Offset.hxx"
+#include "io/FileDescriptor.hxx"
+
+#include <cstddef>
+#include <span>
+
+/**
+ * A read-only memory mapping of a small local file which is only
+ * created when a consumer asks for the whole file (see
+ * InputStream::GetContiguous()), e.g. a module loader.  All other
+ * readers keep using read(), so truncating a file while it is being
+ * scanned or played does not crash MPD with SIGBUS.
+ *
+ * This class is not thread-safe; it is protected by the
+ * #InputStream's mutex.
+ */
+class LazyFileMapping {
+	mutable void *mapping = nullptr;
+	mutable std::size_t mapping_size = 0;
+
+	/**
+	 * Was mapping the file attempted already?  It is not retried
+	 * after a failure.
+	 */
+	mutable bool tried = false;
+
+public:
+	LazyFileMapping() noexcept = default;
+	~LazyFileMapping() noexcept;
+
+	LazyFileMapping(const LazyFileMapping &) = delete;
+	LazyFileMapping &operator=(const LazyFileMapping &) = delete;
+
+	/**
+	 * Map the file (if not already done) and return its
+	 * contents.
+	 *
+	 * @param fd the file; it may be closed after this call
+	 * @param size the size of the file
+	 * @return the contents or an empty span if the file is too
+	 * large or cannot be mapped
+	 */
+	std::span<const std::byte> Get(FileDescriptor fd,
+				       offset_type size) const noexcept;
+};
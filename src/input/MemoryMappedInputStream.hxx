@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "InputStream.hxx"
+
+/**
+ * An #InputStream reading from a read-only memory mapping of a file.
+ * Reading from it does not need any system calls, and
+ * GetContiguous() provides access to the whole file without copying.
+ */
+class MemoryMappedInputStream final : public InputStream {
+	void *const mapping;
+	const std::size_t mapping_size;
+
+	const std::span<const std::byte> src;
+
+public:
+	/**
+	 * @param _mapping the return value of mmap(), which will be
+	 * unmapped by the destructor
+	 * @param _src the part of the mapping which is the contents
+	 * of this stream
+	 */
+	MemoryMappedInputStream(const char *_uri, Mutex &_mutex,
+				void *_mapping, std::size_t _mapping_size,
+				std::span<const std::byte> _src) noexcept
+		:InputStream(_uri, _mutex),
+		 mapping(_mapping), mapping_size(_mapping_size),
+		 src(_src)
+	{
+		size = src.size();
+		seekable = true;
+		SetReady();
+	}
+
+	~MemoryMappedInputStream() noexcept override;
+
+	/* virtual methods from InputStream */
+
+	[[nodiscard]] bool IsEOF() const noexcept override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    std::span<std::byte> dest) override;
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type offset) override;
+
+	std::span<const std::byte> GetContiguous() const noexcept override {
+		return src;
+	}
+};
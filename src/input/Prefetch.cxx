@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Prefetch.hxx"
+#include "InputPlugin.hxx"
+#include "Registry.hxx"
+
+void
+InputPrefetch(std::string_view uri) noexcept
+{
+	for (const auto &plugin : GetEnabledInputPlugins()) {
+		if (plugin.prefetch == nullptr || !plugin.SupportsUri(uri))
+			continue;
+
+		plugin.prefetch(uri);
+		break;
+	}
+}
@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <string_view>
+
+/**
+ * Tell all #InputPlugin instances which support the given URI that it
+ * is likely to be opened soon (see InputPlugin::prefetch).  Does not
+ * block.
+ */
+void
+InputPrefetch(std::string_view uri) noexcept;
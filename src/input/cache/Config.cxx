@@ -7,6 +7,7 @@
 
 static constexpr size_t KILOBYTE = 1024;
 static constexpr size_t MEGABYTE = 1024 * KILOBYTE;
+static constexpr uint_least64_t GIGABYTE = 1024 * MEGABYTE;
 
 InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 {
@@ -16,4 +17,24 @@ InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 		size = size_param->With([](const char *s){
 			return ParseSize(s);
 		});
+
+	prefetch_songs = block.GetPositiveValue("prefetch_songs", 1U);
+
+	prefetch_size = size;
+	const auto *prefetch_size_param = block.GetBlockParam("prefetch_size");
+	if (prefetch_size_param != nullptr)
+		prefetch_size = prefetch_size_param->With([](const char *s){
+			return ParseSize(s);
+		});
+
+	remote = block.GetBlockValue("remote", false);
+
+	directory = block.GetPath("directory");
+
+	directory_size = 4 * GIGABYTE;
+	const auto *directory_size_param = block.GetBlockParam("directory_size");
+	if (directory_size_param != nullptr)
+		directory_size = directory_size_param->With([](const char *s){
+			return ParseSize(s);
+		});
 }
@@ -4,13 +4,44 @@
 #ifndef MPD_INPUT_CACHE_CONFIG_HXX
 #define MPD_INPUT_CACHE_CONFIG_HXX
 
+#include "fs/AllocatedPath.hxx"
+
 #include <cstddef>
+#include <cstdint>
 
 struct ConfigBlock;
 
 struct InputCacheConfig {
 	size_t size;
 
+	/**
+	 * The number of queued songs to be prefetched.
+	 */
+	unsigned prefetch_songs;
+
+	/**
+	 * The maximum total size of the songs prefetched (ahead of
+	 * the current one) by one partition.
+	 */
+	size_t prefetch_size;
+
+	/**
+	 * Cache remote files (e.g. NFS, SMB, HTTP) in addition to
+	 * local files?
+	 */
+	bool remote;
+
+	/**
+	 * The directory of the persistent (on-disk) cache; null if
+	 * that is disabled.
+	 */
+	AllocatedPath directory = nullptr;
+
+	/**
+	 * The maximum total size of all files in #directory.
+	 */
+	uint_least64_t directory_size;
+
 	explicit InputCacheConfig(const ConfigBlock &block);
 };
 
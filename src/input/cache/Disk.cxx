@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Disk.hxx"
+#include "input/MemoryMappedInputStream.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "io/FileOutputStream.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "lib/fmt/PathFormatter.hxx"
+#include "lib/fmt/SystemError.hxx"
+#include "util/Domain.hxx"
+#include "util/SpanCast.hxx"
+#include "Log.hxx"
+
+#include <fmt/format.h>
+
+#include <algorithm> // for std::sort()
+#include <string>
+#include <vector>
+
+#include <string.h> // for memcpy()
+#include <sys/mman.h>
+#include <sys/stat.h> // for futimens()
+
+static constexpr Domain cache_domain("cache");
+
+namespace {
+
+/**
+ * The beginning of each file in the cache directory.  It is followed
+ * by the URI (without null terminator) and then the file contents.
+ */
+struct DiskHeader {
+	static constexpr std::array<char, 8> MAGIC{'M', 'P', 'D', 'C', 'A', 'C', 'H', '1'};
+
+	std::array<char, 8> magic;
+
+	uint64_t uri_length;
+
+	uint64_t data_size;
+
+	uint64_t source_size;
+
+	int64_t source_mtime;
+};
+
+} // anonymous namespace
+
+/**
+ * The 64 bit FNV-1a hash function.
+ */
+[[gnu::pure]]
+static uint_least64_t
+HashUri(std::string_view uri) noexcept
+{
+	uint_least64_t hash = 0xcbf29ce484222325ULL;
+	for (const char ch : uri) {
+		hash ^= static_cast<unsigned char>(ch);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+InputCacheDisk::InputCacheDisk(AllocatedPath &&_directory,
+			       uint_least64_t _max_size)
+	:directory(std::move(_directory)), max_size(_max_size)
+{
+	if (!DirectoryExists(directory) &&
+	    !CreateDirectoryNoThrow(directory))
+		throw FmtErrno("Failed to create directory {}", directory);
+
+	/* enforce the size limit (which may have been lowered since
+	   the last run) */
+	const std::lock_guard lock{mutex};
+	MakeRoom(0);
+}
+
+AllocatedPath
+InputCacheDisk::MakePath(std::string_view uri) const noexcept
+{
+	const auto name = fmt::format("{:016x}", HashUri(uri));
+	return AllocatedPath::Build(directory, std::string_view{name});
+}
+
+InputStreamPtr
+InputCacheDisk::Open(std::string_view uri,
+		     const InputCacheValidator &validator,
+		     Mutex &_mutex) noexcept
+try {
+	const auto path = MakePath(uri);
+
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path.c_str()))
+		return nullptr;
+
+	const off_t file_size = fd.GetSize();
+	if (file_size < off_t(sizeof(DiskHeader)))
+		return nullptr;
+
+	void *const p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED,
+			     fd.Get(), 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	const std::span<const std::byte> mapped{static_cast<const std::byte *>(p),
+			std::size_t(file_size)};
+
+	DiskHeader header;
+	memcpy(&header, mapped.data(), sizeof(header));
+
+	const auto rest = mapped.subspan(sizeof(header));
+
+	if (header.magic != DiskHeader::MAGIC ||
+	    header.uri_length > rest.size() ||
+	    ToStringView(rest.first(header.uri_length)) != uri) {
+		/* a different file or a hash collision */
+		munmap(p, file_size);
+		return nullptr;
+	}
+
+	const auto data = rest.subspan(header.uri_length);
+	if (data.size() != header.data_size ||
+	    header.source_size != validator.size ||
+	    header.source_mtime != validator.mtime) {
+		/* truncated or stale */
+		munmap(p, file_size);
+
+		FmtDebug(cache_domain, "Discarding stale copy of {:?}", uri);
+
+		const std::lock_guard lock{mutex};
+		unlink(path.c_str());
+		return nullptr;
+	}
+
+	madvise(p, file_size, MADV_SEQUENTIAL);
+
+	/* mark as recently used for MakeRoom() */
+	futimens(fd.Get(), nullptr);
+
+	FmtDebug(cache_domain, "Loading {:?} from {}", uri, path);
+
+	return std::make_unique<MemoryMappedInputStream>(std::string{uri}.c_str(),
+							 _mutex, p, file_size, data);
+} catch (...) {
+	LogError(std::current_exception());
+	return nullptr;
+}
+
+void
+InputCacheDisk::Store(std::string_view uri,
+		      const InputCacheValidator &validator,
+		      std::span<const std::byte> data) noexcept
+try {
+	const uint_least64_t total_size = sizeof(DiskHeader) + uri.size() + data.size();
+	if (total_size > max_size)
+		return;
+
+	{
+		const std::lock_guard lock{mutex};
+		MakeRoom(total_size);
+	}
+
+	const DiskHeader header{
+		DiskHeader::MAGIC,
+		uri.size(),
+		data.size(),
+		validator.size,
+		validator.mtime,
+	};
+
+	FileOutputStream os{MakePath(uri)};
+	os.Write(ReferenceAsBytes(header));
+	os.Write(AsBytes(uri));
+	os.Write(data);
+	os.Commit();
+
+	FmtDebug(cache_domain, "Stored {:?}", uri);
+} catch (...) {
+	FmtError(cache_domain, "Failed to store {:?}: {}",
+		 uri, std::current_exception());
+}
+
+void
+InputCacheDisk::MakeRoom(uint_least64_t size)
+{
+	struct Entry {
+		AllocatedPath path;
+		uint_least64_t size;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	std::vector<Entry> entries;
+	uint_least64_t total_size = 0;
+
+	DirectoryReader reader{directory};
+	while (reader.ReadEntry()) {
+		const auto name = reader.GetEntry();
+		if (name.c_str()[0] == '.')
+			/* skip special and temporary files */
+			continue;
+
+		auto path = AllocatedPath::Build(directory, name);
+
+		FileInfo fi;
+		if (!GetFileInfo(path, fi, false) || !fi.IsRegular())
+			continue;
+
+		total_size += fi.GetSize();
+		entries.push_back({std::move(path), fi.GetSize(),
+				   fi.GetModificationTime()});
+	}
+
+	if (total_size + size <= max_size)
+		return;
+
+	/* oldest first */
+	std::sort(entries.begin(), entries.end(),
+		  [](const Entry &a, const Entry &b){
+			  return a.mtime < b.mtime;
+		  });
+
+	for (const auto &i : entries) {
+		if (total_size + size <= max_size)
+			break;
+
+		if (unlink(i.path.c_str()) < 0)
+			continue;
+
+		FmtDebug(cache_domain, "Evicted {}", i.path);
+		total_size -= i.size;
+	}
+}
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "input/Ptr.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/**
+ * Describes the version of a source file.  A cached copy is only
+ * used if it was made from a source file with the same attributes.
+ */
+struct InputCacheValidator {
+	uint_least64_t size;
+
+	/**
+	 * The modification time of the source file [nanoseconds since
+	 * the epoch]; 0 if unknown (remote files).
+	 */
+	int_least64_t mtime;
+
+	constexpr bool operator==(const InputCacheValidator &) const noexcept = default;
+};
+
+/**
+ * The persistent tier of the #InputCacheManager: complete copies of
+ * files are stored in a directory and survive MPD restarts.  Files
+ * are named after a hash of their URI; each one begins with a header
+ * containing the URI and the #InputCacheValidator.
+ *
+ * The least recently used files are deleted when the total size
+ * exceeds the configured limit; "use" is recorded by updating the
+ * file's modification time.
+ *
+ * This class is thread-safe.
+ */
+class InputCacheDisk {
+	const AllocatedPath directory;
+
+	const uint_least64_t max_size;
+
+	/**
+	 * Serializes eviction.
+	 */
+	Mutex mutex;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	InputCacheDisk(AllocatedPath &&_directory, uint_least64_t _max_size);
+
+	/**
+	 * Open the cached copy of the given file.
+	 *
+	 * @param mutex the #Mutex for the new #InputStream
+	 * @return a (ready) #InputStream reading from a memory mapping
+	 * of the cached copy or nullptr if there is no (valid) copy
+	 */
+	InputStreamPtr Open(std::string_view uri,
+			    const InputCacheValidator &validator,
+			    Mutex &mutex) noexcept;
+
+	/**
+	 * Store a copy of the given file.  This may take a while; it
+	 * is called by the thread which has loaded the file.  Errors
+	 * are logged.
+	 */
+	void Store(std::string_view uri, const InputCacheValidator &validator,
+		   std::span<const std::byte> data) noexcept;
+
+private:
+	[[gnu::pure]]
+	AllocatedPath MakePath(std::string_view uri) const noexcept;
+
+	/**
+	 * Delete the least recently used files until there is room
+	 * for the given number of bytes.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void MakeRoom(uint_least64_t size);
+};
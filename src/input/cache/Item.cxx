@@ -7,15 +7,28 @@
 
 #include <cassert>
 
-InputCacheItem::InputCacheItem(InputStreamPtr _input) noexcept
+InputCacheItem::InputCacheItem(InputStreamPtr _input,
+			       InputCacheDisk *_disk,
+			       const InputCacheValidator &_validator) noexcept
 	:BufferingInputStream(std::move(_input)),
-	 uri(GetInput().GetURI())
+	 uri(GetInput().GetURI()),
+	 disk(_disk), validator(_validator)
 {
 }
 
 InputCacheItem::~InputCacheItem() noexcept
 {
 	assert(leases.empty());
+
+	/* our OnBufferComplete() override may be running */
+	StopThread();
+}
+
+bool
+InputCacheItem::LockIsDone() const noexcept
+{
+	const std::lock_guard lock{mutex};
+	return IsComplete() || HasError();
 }
 
 void
@@ -45,3 +58,10 @@ InputCacheItem::OnBufferAvailable() noexcept
 		i->OnInputCacheAvailable();
 	}
 }
+
+void
+InputCacheItem::OnBufferComplete(std::span<const std::byte> data) noexcept
+{
+	if (disk != nullptr)
+		disk->Store(uri, validator, data);
+}
@@ -4,6 +4,7 @@
 #ifndef MPD_INPUT_CACHE_ITEM_HXX
 #define MPD_INPUT_CACHE_ITEM_HXX
 
+#include "Disk.hxx"
 #include "input/BufferingInputStream.hxx"
 #include "thread/Mutex.hxx"
 #include "util/IntrusiveList.hxx"
@@ -27,13 +28,27 @@ class InputCacheItem final
 {
 	const std::string uri;
 
+	/**
+	 * If not nullptr, then the complete file will be stored in
+	 * this persistent cache.
+	 */
+	InputCacheDisk *const disk;
+
+	const InputCacheValidator validator;
+
 	using LeaseList = IntrusiveList<InputCacheLease>;
 
 	LeaseList leases;
 	LeaseList::iterator next_lease = leases.end();
 
 public:
-	explicit InputCacheItem(InputStreamPtr _input) noexcept;
+	/**
+	 * @param _disk if not nullptr, then the file will be stored
+	 * there after it has been read completely
+	 */
+	InputCacheItem(InputStreamPtr _input,
+		       InputCacheDisk *_disk,
+		       const InputCacheValidator &_validator) noexcept;
 	~InputCacheItem() noexcept;
 
 	const std::string &GetUri() const noexcept {
@@ -47,12 +62,19 @@ public:
 		return !leases.empty();
 	}
 
+	/**
+	 * Has loading this item finished (successfully or not)?
+	 */
+	[[gnu::pure]]
+	bool LockIsDone() const noexcept;
+
 	void AddLease(InputCacheLease &lease) noexcept;
 	void RemoveLease(InputCacheLease &lease) noexcept;
 
 private:
 	/* virtual methods from class BufferingInputStream */
 	void OnBufferAvailable() noexcept override;
+	void OnBufferComplete(std::span<const std::byte> data) noexcept override;
 };
 
 #endif
@@ -3,9 +3,12 @@
 
 #include "Manager.hxx"
 #include "Config.hxx"
+#include "Disk.hxx"
 #include "Item.hxx"
 #include "Lease.hxx"
 #include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
 #include "fs/Traits.hxx"
 #include "util/DeleteDisposer.hxx"
 
@@ -17,9 +20,17 @@ InputCacheManager::ItemGetUri::operator()(const InputCacheItem &item) const noex
 	return item.GetUri();
 }
 
-InputCacheManager::InputCacheManager(const InputCacheConfig &config) noexcept
-	:max_total_size(config.size)
+InputCacheManager::InputCacheManager(const InputCacheConfig &config)
+	:max_total_size(config.size),
+	 prefetch_songs(config.prefetch_songs),
+	 prefetch_size(config.prefetch_size),
+	 remote(config.remote)
 {
+#ifndef _WIN32
+	if (!config.directory.IsNull())
+		disk = std::make_unique<InputCacheDisk>(AllocatedPath{config.directory},
+							config.directory_size);
+#endif
 }
 
 InputCacheManager::~InputCacheManager() noexcept
@@ -53,17 +64,51 @@ InputCacheManager::IsEligible(const InputStream &input) const noexcept
 		input.GetSize() <= max_total_size / 2;
 }
 
+InputCacheManager::Stats
+InputCacheManager::GetStats() const noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return {
+		items_by_uri.size(), total_size, max_total_size,
+		hits.load(std::memory_order_relaxed),
+		misses.load(std::memory_order_relaxed),
+	};
+}
+
 bool
 InputCacheManager::Contains(const char *uri) noexcept
 {
 	return Get(uri, false);
 }
 
+/**
+ * Determine the #InputCacheValidator of the given (ready)
+ * #InputStream.  For local files, this includes the modification
+ * time; remote files are only validated by their size, because the
+ * #InputStream API does not expose ETags or modification times.
+ */
+static InputCacheValidator
+MakeValidator(const char *uri, const InputStream &is) noexcept
+{
+	InputCacheValidator validator{is.GetSize(), 0};
+
+	if (PathTraitsUTF8::IsAbsolute(uri)) {
+		const auto path = AllocatedPath::FromUTF8(uri);
+		FileInfo fi;
+		if (!path.IsNull() && GetFileInfo(path, fi)) {
+			using namespace std::chrono;
+			const auto t = fi.GetModificationTime().time_since_epoch();
+			validator.mtime = duration_cast<nanoseconds>(t).count();
+		}
+	}
+
+	return validator;
+}
+
 InputCacheLease
 InputCacheManager::Get(const char *uri, bool create)
 {
-	// TODO: allow caching remote files
-	if (!PathTraitsUTF8::IsAbsolute(uri))
+	if (!remote && !PathTraitsUTF8::IsAbsolute(uri))
 		return {};
 
 	if (auto iter = items_by_uri.find(uri); iter != items_by_uri.end()) {
@@ -76,6 +121,9 @@ InputCacheManager::Get(const char *uri, bool create)
 		// TODO revalidate the cache item using the file's mtime?
 		// TODO if cache item contains error, retry now?
 
+		if (create)
+			hits.fetch_add(1, std::memory_order_relaxed);
+
 		return InputCacheLease(item);
 	}
 
@@ -89,11 +137,28 @@ InputCacheManager::Get(const char *uri, bool create)
 		return {};
 
 	const size_t size = is->GetSize();
+
+	const auto validator = MakeValidator(uri, *is);
+	InputCacheDisk *store_disk = nullptr;
+
+#ifndef _WIN32
+	if (disk) {
+		if (auto mapped = disk->Open(uri, validator, mutex)) {
+			/* load the RAM item from the persistent copy
+			   instead of the (possibly slow) source */
+			is = std::move(mapped);
+		} else
+			store_disk = disk.get();
+	}
+#endif
+
 	total_size += size;
 
 	while (total_size > max_total_size && EvictOldestUnused()) {}
 
-	auto *item = new InputCacheItem(std::move(is));
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	auto *item = new InputCacheItem(std::move(is), store_disk, validator);
 	items_by_uri.insert(*item);
 	items_by_time.push_back(*item);
 
@@ -106,6 +171,22 @@ InputCacheManager::Prefetch(const char *uri)
 	Get(uri, true);
 }
 
+void
+InputCacheManager::CancelPrefetch(InputCacheLease &&lease) noexcept
+{
+	assert(lease);
+
+	auto &item = lease.GetCacheItem();
+
+	{
+		/* release the lease */
+		const InputCacheLease tmp{std::move(lease)};
+	}
+
+	if (!item.IsInUse() && !item.LockIsDone())
+		Delete(&item);
+}
+
 void
 InputCacheManager::Remove(InputCacheItem &item) noexcept
 {
@@ -7,9 +7,13 @@
 #include "util/IntrusiveHashSet.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string_view>
 
 class InputStream;
+class InputCacheDisk;
 class InputCacheItem;
 class InputCacheLease;
 struct InputCacheConfig;
@@ -21,6 +25,15 @@ struct InputCacheConfig;
 class InputCacheManager {
 	const size_t max_total_size;
 
+	const unsigned prefetch_songs;
+
+	const size_t prefetch_size;
+
+	/**
+	 * Cache files which are not local?
+	 */
+	const bool remote;
+
 	mutable Mutex mutex;
 
 	size_t total_size = 0;
@@ -37,15 +50,78 @@ class InputCacheManager {
 						   std::hash<std::string_view>,
 						   std::equal_to<std::string_view>>> items_by_uri;
 
+	/**
+	 * The persistent tier; nullptr if not configured.
+	 */
+	std::unique_ptr<InputCacheDisk> disk;
+
+	/**
+	 * Counters for Get() calls with create=true which found an
+	 * existing item or which had to create a new one.
+	 */
+	std::atomic<uint_least64_t> hits{0}, misses{0};
+
 public:
-	explicit InputCacheManager(const InputCacheConfig &config) noexcept;
+	/**
+	 * Throws on error.
+	 */
+	explicit InputCacheManager(const InputCacheConfig &config);
 	~InputCacheManager() noexcept;
 
 	void Flush() noexcept;
 
+	/**
+	 * Returns the number of queued songs which shall be
+	 * prefetched.
+	 */
+	unsigned GetPrefetchSongs() const noexcept {
+		return prefetch_songs;
+	}
+
+	/**
+	 * Returns the maximum total size of the songs prefetched by
+	 * one #InputCachePrefetcher.
+	 */
+	size_t GetPrefetchSize() const noexcept {
+		return prefetch_size;
+	}
+
+	/**
+	 * Is there room for another file without evicting older
+	 * ones?
+	 */
+	[[gnu::pure]]
+	bool HasSpace() const noexcept {
+		return total_size < max_total_size;
+	}
+
 	[[gnu::pure]]
 	bool Contains(const char *uri) noexcept;
 
+	struct Stats {
+		std::size_t items;
+
+		/**
+		 * The memory reserved for all items (#total_size).
+		 */
+		std::size_t bytes;
+
+		/**
+		 * The configured maximum size.
+		 */
+		std::size_t max_bytes;
+
+		/**
+		 * The number of lookups which were served by an
+		 * existing item and the number of lookups which
+		 * created a new item (including prefetches).
+		 */
+		uint_least64_t hits, misses;
+	};
+
+	[[gnu::pure]]
+	Stats GetStats() const noexcept;
+
 	/**
 	 * Throws if opening the #InputStream fails.
 	 *
@@ -62,6 +138,15 @@ public:
 	 */
 	void Prefetch(const char *uri);
 
+	/**
+	 * Release a lease obtained for prefetching.  If the item is
+	 * not used by anybody else and has not been loaded
+	 * completely, it is deleted, which stops the transfer and
+	 * leaves the I/O bandwidth to songs which are still about to
+	 * be played.
+	 */
+	void CancelPrefetch(InputCacheLease &&lease) noexcept;
+
 private:
 	/**
 	 * Check whether the given #InputStream can be stored in this
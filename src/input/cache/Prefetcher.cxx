@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Prefetcher.hxx"
+#include "Manager.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "util/Domain.hxx"
+#include "util/UriExtract.hxx"
+#include "Log.hxx"
+
+#include <algorithm> // for std::stable_partition()
+
+static constexpr Domain cache_domain("cache");
+
+/**
+ * Is this song on storage which is too slow to be loaded on demand?
+ */
+[[gnu::pure]]
+static bool
+IsSlowStorage(const char *uri) noexcept
+{
+	/* everything which is not a local file: NFS, SMB, HTTP, ... */
+	return uri_has_scheme(uri);
+}
+
+inline std::size_t
+InputCachePrefetcher::Add(std::vector<InputCacheLease> &window,
+			  const char *uri) noexcept
+{
+	for (const auto &i : window)
+		if (i->GetUri() == uri)
+			/* duplicate in the queue */
+			return 0;
+
+	const bool cached = cache.Contains(uri);
+	if (!cached)
+		FmtDebug(cache_domain, "Prefetch {:?}", uri);
+
+	try {
+		auto lease = cache.Get(uri, true);
+		if (!lease)
+			/* not eligible */
+			return 0;
+
+		const std::size_t size = lease->size();
+		window.emplace_back(std::move(lease));
+
+		/* items which were already here don't consume
+		   bandwidth, but they do occupy memory */
+		return size;
+	} catch (...) {
+		FmtError(cache_domain,
+			 "Prefetch {:?} failed: {}",
+			 uri, std::current_exception());
+		return 0;
+	}
+}
+
+void
+InputCachePrefetcher::Update(std::span<const char *const> uris) noexcept
+{
+	std::vector<InputCacheLease> window;
+	window.reserve(uris.size());
+
+	if (!uris.empty()) {
+		/* the next song is always prefetched */
+		std::size_t total_size = Add(window, uris.front());
+
+		std::vector<const char *> more{std::next(uris.begin()), uris.end()};
+		std::stable_partition(more.begin(), more.end(), IsSlowStorage);
+
+		const std::size_t max_size = cache.GetPrefetchSize();
+		for (const char *uri : more) {
+			if (total_size >= max_size || !cache.HasSpace())
+				break;
+
+			total_size += Add(window, uri);
+		}
+	}
+
+	/* the new leases have been obtained before releasing the old
+	   ones, so items which are still in the window stay
+	   untouched */
+	Clear();
+	leases = std::move(window);
+}
+
+void
+InputCachePrefetcher::Clear() noexcept
+{
+	for (auto &i : leases)
+		cache.CancelPrefetch(std::move(i));
+	leases.clear();
+}
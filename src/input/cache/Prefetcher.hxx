@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Lease.hxx"
+
+#include <span>
+#include <vector>
+
+class InputCacheManager;
+
+/**
+ * Schedules prefetching the songs which are going to be played soon
+ * by one partition.  It holds a lease on each item in its lookahead
+ * window, so they don't get evicted by other prefetches; when the
+ * window changes (because the queue was edited or the user skipped
+ * songs), items which have dropped out of it are released, and
+ * unfinished transfers are cancelled.
+ */
+class InputCachePrefetcher {
+	InputCacheManager &cache;
+
+	/**
+	 * The items in the current lookahead window.
+	 */
+	std::vector<InputCacheLease> leases;
+
+public:
+	explicit InputCachePrefetcher(InputCacheManager &_cache) noexcept
+		:cache(_cache) {}
+
+	~InputCachePrefetcher() noexcept {
+		Clear();
+	}
+
+	InputCachePrefetcher(const InputCachePrefetcher &) = delete;
+	InputCachePrefetcher &operator=(const InputCachePrefetcher &) = delete;
+
+	/**
+	 * Replace the lookahead window.
+	 *
+	 * The first URI (the song which will be played next) is
+	 * always prefetched.  The others are prefetched within
+	 * InputCacheManager::GetPrefetchSize(), and songs on slow
+	 * (remote) storage are preferred, because local files can
+	 * still be loaded quickly when they are actually played.
+	 *
+	 * Errors will be logged.
+	 *
+	 * @param uris the "real" URIs of the songs in the order they
+	 * are going to be played
+	 */
+	void Update(std::span<const char *const> uris) noexcept;
+
+	/**
+	 * Release all items.
+	 */
+	void Clear() noexcept;
+
+private:
+	/**
+	 * Obtain a lease on the given song and add it to the given
+	 * window.
+	 *
+	 * @return the size of the item or 0 on error
+	 */
+	std::size_t Add(std::vector<InputCacheLease> &window,
+			const char *uri) noexcept;
+};
@@ -3,8 +3,7 @@
 
 #include "ArchiveInputPlugin.hxx"
 #include "archive/ArchiveList.hxx"
-#include "archive/ArchivePlugin.hxx"
-#include "archive/ArchiveFile.hxx"
+#include "archive/ArchiveCache.hxx"
 #include "../InputStream.hxx"
 #include "fs/LookupFile.hxx"
 #include "fs/Path.hxx"
@@ -43,6 +42,6 @@ OpenArchiveInputStream(Path path, Mutex &mutex)
 		return nullptr;
 	}
 
-	return archive_file_open(arplug, l.archive)
-		->OpenStream(l.inside.c_str(), mutex);
+	return archive_cache_open_stream(*arplug, l.archive,
+					 l.inside.c_str(), mutex);
 }
@@ -19,7 +19,10 @@
 #include "lib/fmt/ToBuffer.hxx"
 #include "thread/ScopeUnlock.hxx"
 #include "event/Call.hxx"
+#include "event/DeferEvent.hxx"
 #include "event/Loop.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/CNumberParser.hxx"
 #include "util/Domain.hxx"
 #include "util/StringCompare.hxx"
@@ -36,8 +39,10 @@
 
 #include <fmt/format.h>
 
+#include <algorithm> // for std::copy_n()
 #include <cassert>
 #include <cinttypes>
+#include <memory>
 
 #include <string.h>
 
@@ -57,6 +62,109 @@ static const size_t CURL_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t CURL_RESUME_AT = 384 * 1024;
 
+/**
+ * Keep a copy of this number of bytes at the beginning of the
+ * resource, to be able to seek back there without a new request.
+ */
+static constexpr size_t CURL_HEAD_SIZE = 64 * 1024;
+
+/**
+ * Fetch this number of bytes at the end of the resource with a
+ * second request, in parallel to the main transfer.  Many tag
+ * formats (ID3v1, APE, some MP4 "moov" atoms) and seek tables live
+ * there.
+ */
+static constexpr size_t CURL_TAIL_SIZE = 128 * 1024;
+
+/**
+ * Head and tail are only kept for resources at least this large;
+ * smaller ones will soon be in the #AsyncInputStream buffer
+ * anyway.
+ */
+static constexpr InputStream::offset_type CURL_SEGMENT_MIN_SIZE = 1024 * 1024;
+
+/**
+ * A copy of a range of the resource, used to serve seeks without
+ * waiting for a new request.  It is only accessed in the I/O
+ * thread.
+ */
+struct CurlSegment {
+	const InputStream::offset_type offset;
+
+	AllocatedArray<std::byte> buffer;
+
+	/**
+	 * The number of bytes received so far.
+	 */
+	std::size_t fill = 0;
+
+	CurlSegment(InputStream::offset_type _offset, std::size_t size) noexcept
+		:offset(_offset), buffer(size) {}
+
+	[[gnu::pure]]
+	bool Contains(InputStream::offset_type o) const noexcept {
+		return o >= offset && o - offset < fill;
+	}
+
+	/**
+	 * Returns the received data starting at the given offset,
+	 * which must be inside this segment.
+	 */
+	[[gnu::pure]]
+	std::span<const std::byte> From(InputStream::offset_type o) const noexcept {
+		assert(Contains(o));
+
+		return std::span<const std::byte>{buffer.data(), fill}.subspan(o - offset);
+	}
+
+	/**
+	 * Append data (as much as fits).
+	 */
+	void Append(std::span<const std::byte> src) noexcept {
+		const std::size_t n = std::min(src.size(), buffer.size() - fill);
+		std::copy_n(src.begin(), n, buffer.begin() + fill);
+		fill += n;
+	}
+};
+
+/**
+ * A "Range" request which fills a #CurlSegment.  With HTTP/2, it is
+ * multiplexed over the connection of the main transfer.
+ */
+class CurlSegmentRequest final : CurlResponseHandler {
+	CurlSegment &segment;
+
+	CurlRequest request;
+
+public:
+	CurlSegmentRequest(CurlGlobal &global, CurlEasy &&easy,
+			   CurlSegment &_segment)
+		:segment(_segment),
+		 request(global, std::move(easy), *this) {}
+
+	void Start() {
+		request.Start();
+	}
+
+private:
+	/* virtual methods from CurlResponseHandler */
+	void OnHeaders(unsigned status, Curl::Headers &&) override {
+		if (status != 206)
+			/* the server has ignored our "Range" header */
+			throw HttpStatusError(status,
+					      FmtBuffer<40>("got HTTP status {}",
+							    status).c_str());
+	}
+
+	void OnData(std::span<const std::byte> data) override {
+		segment.Append(data);
+	}
+
+	void OnEnd() override {}
+
+	void OnError(std::exception_ptr e) noexcept override;
+};
+
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
 	   to free */
@@ -67,6 +175,26 @@ class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/** parser for icy-metadata */
 	std::shared_ptr<IcyMetaDataParser> icy;
 
+	/**
+	 * Starts the #tail_request.  This cannot be done from inside
+	 * a CURL callback.
+	 */
+	DeferEvent defer_start_tail;
+
+	/**
+	 * The offset of the next byte to be received by the main
+	 * transfer.  Only accessed in the I/O thread.
+	 */
+	offset_type write_offset = 0;
+
+	/**
+	 * Copies of the beginning and the end of the resource;
+	 * nullptr if the resource is not seekable or too small.
+	 */
+	std::unique_ptr<CurlSegment> head, tail;
+
+	std::unique_ptr<CurlSegmentRequest> tail_request;
+
 public:
 	template<typename I>
 	CurlInputStream(EventLoop &event_loop, std::string_view _url,
@@ -113,6 +241,29 @@ private:
 	 */
 	void FreeEasyIndirect() noexcept;
 
+	/**
+	 * Allocate #head and schedule fetching #tail.  Called after
+	 * the response headers of the first request have been
+	 * received.
+	 *
+	 * Runs in the I/O thread.
+	 */
+	void InitSegments() noexcept;
+
+	/* DeferEvent callback */
+	void StartTail() noexcept;
+
+	[[gnu::pure]]
+	const CurlSegment *FindSegment(offset_type o) const noexcept;
+
+	/**
+	 * Seek by copying data from a #CurlSegment into the buffer,
+	 * and then start a new request after that.
+	 *
+	 * The mutex must not be locked.
+	 */
+	void SeekToSegment(const CurlSegment &segment);
+
 	/**
 	 * The DoSeek() implementation invoked in the IOThread.
 	 */
@@ -215,9 +366,20 @@ CurlInputStream::FreeEasyIndirect() noexcept
 {
 	BlockingCall(GetEventLoop(), [this](){
 			FreeEasy();
+
+			defer_start_tail.Cancel();
+			tail_request.reset();
 		});
 }
 
+void
+CurlSegmentRequest::OnError(std::exception_ptr e) noexcept
+{
+	/* this is not fatal: the main transfer will deliver this
+	   range if it is needed */
+	FmtDebug(curl_domain, "Range request failed: {}", e);
+}
+
 #ifdef HAVE_ICU_CONVERTER
 
 static std::unique_ptr<IcuConverter>
@@ -271,9 +433,11 @@ CurlInputStream::OnHeaders(unsigned status,
 
 	const std::lock_guard protect{mutex};
 
-	if (IsSeekPending()) {
-		/* don't update metadata while seeking */
-		SeekDone();
+	if (IsReady()) {
+		/* this is the response to a "Range" request after
+		   seeking; don't update metadata */
+		if (IsSeekPending())
+			SeekDone();
 		return;
 	}
 
@@ -324,6 +488,8 @@ CurlInputStream::OnHeaders(unsigned status,
 		}
 	}
 
+	InitSegments();
+
 	SetReady();
 }
 
@@ -343,6 +509,11 @@ CurlInputStream::OnData(std::span<const std::byte> data)
 	}
 
 	AppendToBuffer(data);
+
+	if (head != nullptr && write_offset == head->offset + head->fill)
+		head->Append(data);
+
+	write_offset += data.size();
 }
 
 void
@@ -472,7 +643,8 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, std::string_view _url,
 	:AsyncInputStream(event_loop, _url, _mutex,
 			  CURL_MAX_BUFFERED,
 			  CURL_RESUME_AT),
-	 icy(std::forward<I>(_icy))
+	 icy(std::forward<I>(_icy)),
+	 defer_start_tail(event_loop, BIND_THIS_METHOD(StartTail))
 {
 	request_headers.Append("Icy-Metadata: 1");
 
@@ -558,6 +730,82 @@ CurlInputStream::StartRequest()
 	request->Start();
 }
 
+inline void
+CurlInputStream::InitSegments() noexcept
+{
+	assert(GetEventLoop().IsInside());
+
+	if (!seekable || !KnownSize() || size < CURL_SEGMENT_MIN_SIZE)
+		return;
+
+	head = std::make_unique<CurlSegment>(0, CURL_HEAD_SIZE);
+	defer_start_tail.Schedule();
+}
+
+void
+CurlInputStream::StartTail() noexcept
+try {
+	assert(tail_request == nullptr);
+
+	const offset_type tail_offset = size - CURL_TAIL_SIZE;
+	auto easy = CreateEasy(GetURI(), request_headers.Get());
+	easy.SetOption(CURLOPT_RANGE,
+		       FmtBuffer<64>("{}-{}"sv, tail_offset, size - 1).c_str());
+
+	tail = std::make_unique<CurlSegment>(tail_offset, CURL_TAIL_SIZE);
+	tail_request = std::make_unique<CurlSegmentRequest>(**curl_init,
+							    std::move(easy),
+							    *tail);
+	tail_request->Start();
+} catch (...) {
+	tail_request.reset();
+	tail.reset();
+	FmtDebug(curl_domain, "Failed to request the tail: {}",
+		 std::current_exception());
+}
+
+const CurlSegment *
+CurlInputStream::FindSegment(offset_type o) const noexcept
+{
+	if (head != nullptr && head->Contains(o))
+		return head.get();
+
+	if (tail != nullptr && tail->Contains(o))
+		return tail.get();
+
+	return nullptr;
+}
+
+inline void
+CurlInputStream::SeekToSegment(const CurlSegment &segment)
+{
+	{
+		const std::lock_guard protect{mutex};
+
+		/* the buffer has been cleared by
+		   AsyncInputStream::DeferredSeek() */
+		auto src = segment.From(offset);
+		if (src.size() > GetBufferSpace())
+			src = src.first(GetBufferSpace());
+
+		AppendToBuffer(src);
+		write_offset += src.size();
+
+		/* the caller can go on reading while the rest is
+		   being requested */
+		SeekDone();
+	}
+
+	if (write_offset == size)
+		/* the segment goes until the end of the resource */
+		return;
+
+	InitEasy();
+	request->GetEasy().SetOption(CURLOPT_RANGE,
+				     FmtBuffer<40>("{}-"sv, write_offset).c_str());
+	StartRequest();
+}
+
 void
 CurlInputStream::SeekInternal(offset_type new_offset)
 {
@@ -565,7 +813,13 @@ CurlInputStream::SeekInternal(offset_type new_offset)
 
 	FreeEasy();
 
-	offset = new_offset;
+	offset = write_offset = new_offset;
+
+	if (const auto *segment = FindSegment(offset)) {
+		SeekToSegment(*segment);
+		return;
+	}
+
 	if (offset == size) {
 		/* seek to EOF: simulate empty result; avoid
 		   triggering a "416 Requested Range Not Satisfiable"
@@ -14,9 +14,17 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifndef _WIN32
+#include "../LazyFileMapping.hxx"
+#endif
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
+#ifndef _WIN32
+	LazyFileMapping mapping;
+#endif
+
 public:
 	FileInputStream(const char *path, FileReader &&_reader, off_t _size,
 			Mutex &_mutex)
@@ -37,6 +45,12 @@ public:
 		    std::span<std::byte> dest) override;
 	void Seek(std::unique_lock<Mutex> &lock,
 		  offset_type offset) override;
+
+#ifndef _WIN32
+	std::span<const std::byte> GetContiguous() const noexcept override {
+		return mapping.Get(reader.GetFD(), GetSize());
+	}
+#endif
 };
 
 InputStreamPtr
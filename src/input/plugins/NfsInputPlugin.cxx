@@ -20,7 +20,17 @@ static const size_t NFS_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t NFS_RESUME_AT = 384 * 1024;
 
+/**
+ * The size of each READ call.  Up to NfsFileReader::MAX_READS of them
+ * are in flight at a time.
+ */
+static constexpr size_t NFS_READ_SIZE = 32768;
+
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
+	/**
+	 * The offset of the next byte which will be passed to
+	 * OnNfsFileRead().  Pending READ calls continue from there.
+	 */
 	uint64_t next_offset;
 
 	bool reconnect_on_resume = false, reconnecting = false;
@@ -55,6 +65,10 @@ public:
 	}
 
 private:
+	/**
+	 * Submit as many READ calls as the buffer space and
+	 * NfsFileReader::MAX_READS allow.
+	 */
 	void DoRead();
 
 protected:
@@ -72,27 +86,34 @@ private:
 void
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return;
-	}
-
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
-
-	try {
-		const ScopeUnlock unlock(mutex);
-		NfsFileReader::Read(next_offset, nbytes);
-	} catch (...) {
-		postponed_exception = std::current_exception();
-		InvokeOnAvailable();
+	while (NfsFileReader::CanRead()) {
+		/* the buffer must have room for the data of all
+		   pending READs */
+		const uint64_t pending = NfsFileReader::GetPendingReadSize();
+		const uint64_t read_offset = next_offset + pending;
+
+		int64_t remaining = size - read_offset;
+		if (remaining <= 0)
+			return;
+
+		const size_t buffer_space = GetBufferSpace();
+		if (buffer_space <= pending) {
+			if (pending == 0)
+				Pause();
+			return;
+		}
+
+		size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, NFS_READ_SIZE),
+						 buffer_space - pending);
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			NfsFileReader::Read(read_offset, nbytes);
+		} catch (...) {
+			postponed_exception = std::current_exception();
+			InvokeOnAvailable();
+			return;
+		}
 	}
 }
 
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "QobuzAlbumRequest.hxx"
+#include "QobuzErrorParser.hxx"
+#include "QobuzClient.hxx"
+#include "QobuzTag.hxx"
+
+#include <nlohmann/json.hpp>
+
+using std::string_view_literals::operator""sv;
+
+static std::string
+MakeAlbumUrl(QobuzClient &client, std::string_view album_id)
+{
+	return client.MakeUrl("album", "get",
+			      {
+				      {"album_id", std::string{album_id}},
+			      });
+}
+
+QobuzAlbumRequest::QobuzAlbumRequest(QobuzClient &client,
+				     std::string_view album_id,
+				     QobuzAlbumHandler &_handler)
+	:request(client.GetCurl(),
+		 MakeAlbumUrl(client, album_id).c_str(),
+		 *this),
+	 handler(_handler)
+{
+}
+
+QobuzAlbumRequest::~QobuzAlbumRequest() noexcept
+{
+	request.StopIndirect();
+}
+
+/**
+ * Convert a JSON id (which may be a number or a string) to a string.
+ */
+static std::string
+IdToString(const nlohmann::json &id)
+{
+	return id.is_string()
+		? id.get<std::string>()
+		: id.dump();
+}
+
+void
+QobuzAlbumRequest::OnEnd()
+{
+	const auto &r = GetResponse();
+	if (r.status != 200)
+		ThrowQobuzError(r);
+
+	if (auto i = r.headers.find("content-type");
+	    i == r.headers.end() || i->second.find("/json") == i->second.npos)
+		throw std::runtime_error("Not a JSON response from Qobuz");
+
+	const auto album = nlohmann::json::parse(r.body);
+
+	std::vector<std::pair<std::string, Tag>> tracks;
+
+	if (auto t = album.find("tracks"sv); t != album.end()) {
+		const auto &items = t->at("items"sv);
+		tracks.reserve(items.size());
+
+		for (const auto &track : items)
+			tracks.emplace_back(IdToString(track.at("id"sv)),
+					    QobuzParseTrackTag(track, &album));
+	}
+
+	handler.OnQobuzAlbumSuccess(std::move(tracks));
+}
+
+void
+QobuzAlbumRequest::OnError(std::exception_ptr e) noexcept
+{
+	handler.OnQobuzAlbumError(e);
+}
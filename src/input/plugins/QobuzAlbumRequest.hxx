@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "lib/curl/Request.hxx"
+#include "lib/curl/StringHandler.hxx"
+#include "tag/Tag.hxx"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class QobuzClient;
+
+class QobuzAlbumHandler {
+public:
+	/**
+	 * @param tracks pairs of track id and #Tag
+	 */
+	virtual void OnQobuzAlbumSuccess(std::vector<std::pair<std::string, Tag>> &&tracks) noexcept = 0;
+	virtual void OnQobuzAlbumError(std::exception_ptr error) noexcept = 0;
+};
+
+/**
+ * Requests the metadata of all tracks of an album with one
+ * "album/get" call.
+ */
+class QobuzAlbumRequest final : StringCurlResponseHandler {
+	CurlRequest request;
+
+	QobuzAlbumHandler &handler;
+
+public:
+	QobuzAlbumRequest(QobuzClient &client, std::string_view album_id,
+			  QobuzAlbumHandler &_handler);
+
+	~QobuzAlbumRequest() noexcept;
+
+	void Start() noexcept {
+		request.StartIndirect();
+	}
+
+private:
+	/* virtual methods from CurlResponseHandler */
+	void OnEnd() override;
+	void OnError(std::exception_ptr e) noexcept override;
+};
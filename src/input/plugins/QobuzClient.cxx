@@ -2,16 +2,46 @@
 // Copyright The Music Player Daemon Project
 
 #include "QobuzClient.hxx"
+#include "QobuzTrackRequest.hxx"
 #include "lib/crypto/MD5.hxx"
 #include "thread/ScopeUnlock.hxx"
+#include "util/UriQueryParser.hxx"
+#include "Log.hxx"
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <cassert>
+#include <charconv>
 #include <stdexcept>
 
 using std::string_view_literals::operator""sv;
 
+/**
+ * How long is cached track metadata used?
+ */
+static constexpr std::chrono::steady_clock::duration QOBUZ_TAG_TTL =
+	std::chrono::hours{1};
+
+/**
+ * The maximum number of entries in QobuzClient::tag_cache.
+ */
+static constexpr std::size_t QOBUZ_MAX_CACHED_TAGS = 4096;
+
+/**
+ * How long is a file URL assumed to be valid if it does not
+ * announce its expiry?
+ */
+static constexpr std::chrono::system_clock::duration QOBUZ_FILE_URL_TTL =
+	std::chrono::minutes{5};
+
+/**
+ * A cached file URL is not used if it expires within this duration,
+ * to leave enough time for opening the stream.
+ */
+static constexpr std::chrono::system_clock::duration QOBUZ_FILE_URL_MARGIN =
+	std::chrono::minutes{1};
+
 namespace {
 
 class QueryStringBuilder {
@@ -46,7 +76,8 @@ QobuzClient::QobuzClient(EventLoop &event_loop,
 	 username(_username), email(_email), password(_password),
 	 format_id(_format_id),
 	 curl(event_loop),
-	 defer_invoke_handlers(event_loop, BIND_THIS_METHOD(InvokeHandlers))
+	 defer_invoke_handlers(event_loop, BIND_THIS_METHOD(InvokeHandlers)),
+	 inject_prefetch(event_loop, BIND_THIS_METHOD(OnInjectPrefetch))
 {
 }
 
@@ -121,6 +152,9 @@ QobuzClient::OnQobuzLoginSuccess(QobuzSession &&_session) noexcept
 		const std::lock_guard protect{mutex};
 		session = std::move(_session);
 		login_request.reset();
+
+		/* URLs signed for the old session are useless now */
+		file_url_cache.clear();
 	}
 
 	ScheduleInvokeHandlers();
@@ -199,3 +233,271 @@ QobuzClient::MakeSignedUrl(const char *object, const char *method,
 
 	return uri;
 }
+
+std::optional<Tag>
+QobuzClient::GetCachedTag(std::string_view track_id) noexcept
+{
+	const std::lock_guard protect{mutex};
+
+	auto i = tag_cache.find(track_id);
+	if (i == tag_cache.end())
+		return std::nullopt;
+
+	if (i->second.expires <= std::chrono::steady_clock::now()) {
+		tag_cache.erase(i);
+		return std::nullopt;
+	}
+
+	return i->second.tag;
+}
+
+void
+QobuzClient::PutTag(std::string_view track_id, const Tag &tag) noexcept
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	const std::lock_guard protect{mutex};
+
+	if (tag_cache.size() >= QOBUZ_MAX_CACHED_TAGS) {
+		std::erase_if(tag_cache, [now](const auto &i){
+			return i.second.expires <= now;
+		});
+
+		if (tag_cache.size() >= QOBUZ_MAX_CACHED_TAGS)
+			tag_cache.erase(tag_cache.begin());
+	}
+
+	tag_cache.insert_or_assign(std::string{track_id},
+				   CachedTag{tag, now + QOBUZ_TAG_TTL});
+}
+
+void
+QobuzClient::PrefetchAlbum(std::string_view album_id) noexcept
+{
+	if (requested_albums.size() >= QOBUZ_MAX_CACHED_TAGS)
+		/* the tag cache has probably forgotten most of
+		   them anyway */
+		requested_albums.clear();
+
+	if (!requested_albums.emplace(album_id).second)
+		return;
+
+	if (album_request)
+		album_queue.emplace_back(album_id);
+	else
+		StartAlbumRequest(album_id);
+}
+
+void
+QobuzClient::StartAlbumRequest(std::string_view album_id) noexcept
+{
+	assert(!album_request);
+
+	try {
+		QobuzAlbumHandler &handler = *this;
+		album_request = std::make_unique<QobuzAlbumRequest>(*this,
+								    album_id,
+								    handler);
+		album_request->Start();
+	} catch (...) {
+		album_request.reset();
+		LogError(std::current_exception(),
+			 "Failed to request Qobuz album");
+	}
+}
+
+void
+QobuzClient::OnQobuzAlbumSuccess(std::vector<std::pair<std::string, Tag>> &&tracks) noexcept
+{
+	for (const auto &[track_id, tag] : tracks)
+		PutTag(track_id, tag);
+
+	OnQobuzAlbumError({});
+}
+
+void
+QobuzClient::OnQobuzAlbumError(std::exception_ptr _error) noexcept
+{
+	if (_error)
+		LogError(_error, "Qobuz album request failed");
+
+	album_request.reset();
+
+	while (!album_request && !album_queue.empty()) {
+		const auto album_id = std::move(album_queue.front());
+		album_queue.erase(album_queue.begin());
+		StartAlbumRequest(album_id);
+	}
+}
+
+/**
+ * Parse the "etsp" query parameter (a UNIX time stamp) which
+ * specifies when a signed file URL expires.
+ */
+static std::chrono::system_clock::time_point
+GetFileUrlExpiry(std::string_view url) noexcept
+{
+	const auto now = std::chrono::system_clock::now();
+
+	const auto q = url.find('?');
+	if (q == url.npos)
+		return now + QOBUZ_FILE_URL_TTL;
+
+	const auto etsp = UriFindRawQueryParameter(url.substr(q + 1), "etsp"sv);
+	if (etsp.data() == nullptr)
+		return now + QOBUZ_FILE_URL_TTL;
+
+	std::int64_t value;
+	const auto [ptr, ec] = std::from_chars(etsp.data(),
+					       etsp.data() + etsp.size(),
+					       value);
+	if (ec != std::errc{} || ptr != etsp.data() + etsp.size())
+		return now + QOBUZ_FILE_URL_TTL;
+
+	return std::chrono::system_clock::time_point{std::chrono::seconds{value}};
+}
+
+std::string
+QobuzClient::GetCachedFileUrl(std::string_view track_id,
+			      const QobuzSession &_session) noexcept
+{
+	const std::lock_guard protect{mutex};
+
+	auto i = file_url_cache.find(track_id);
+	if (i == file_url_cache.end())
+		return {};
+
+	if (i->second.user_auth_token != _session.user_auth_token ||
+	    i->second.expires <= std::chrono::system_clock::now() + QOBUZ_FILE_URL_MARGIN) {
+		file_url_cache.erase(i);
+		return {};
+	}
+
+	return i->second.url;
+}
+
+void
+QobuzClient::PutFileUrl(std::string_view track_id,
+			const QobuzSession &_session,
+			std::string_view url) noexcept
+{
+	const auto expires = GetFileUrlExpiry(url);
+	const auto now = std::chrono::system_clock::now();
+
+	const std::lock_guard protect{mutex};
+
+	std::erase_if(file_url_cache, [now](const auto &i){
+		return i.second.expires <= now;
+	});
+
+	file_url_cache.insert_or_assign(std::string{track_id},
+					CachedFileUrl{
+						std::string{url},
+						_session.user_auth_token,
+						expires,
+					});
+}
+
+/**
+ * A "getFileUrl" request started by QobuzClient::PrefetchFileUrl().
+ * Its result is only added to the cache.
+ */
+class QobuzClient::FileUrlPrefetch final : QobuzTrackHandler {
+	QobuzClient &client;
+
+	const std::string track_id;
+
+	const QobuzSession session;
+
+	QobuzTrackRequest request;
+
+public:
+	FileUrlPrefetch(QobuzClient &_client, std::string &&_track_id,
+			const QobuzSession &_session)
+		:client(_client), track_id(std::move(_track_id)),
+		 session(_session),
+		 request(client, session, track_id.c_str(), *this) {}
+
+	const std::string &GetTrackId() const noexcept {
+		return track_id;
+	}
+
+	void Start() noexcept {
+		request.Start();
+	}
+
+private:
+	/* virtual methods from QobuzTrackHandler */
+	void OnQobuzTrackSuccess(std::string url) noexcept override {
+		client.PutFileUrl(track_id, session, url);
+		client.OnFileUrlPrefetchDone(*this);
+	}
+
+	void OnQobuzTrackError(std::exception_ptr e) noexcept override {
+		LogError(e, "Failed to prefetch Qobuz file URL");
+		client.OnFileUrlPrefetchDone(*this);
+	}
+};
+
+QobuzClient::~QobuzClient() noexcept = default;
+
+void
+QobuzClient::PrefetchFileUrl(std::string_view track_id) noexcept
+try {
+	{
+		const std::lock_guard protect{mutex};
+		prefetch_queue.emplace_back(track_id);
+	}
+
+	inject_prefetch.Schedule();
+} catch (...) {
+	/* out of memory - ignore, this is only an optimization */
+}
+
+void
+QobuzClient::OnInjectPrefetch() noexcept
+{
+	std::vector<std::string> queue;
+	QobuzSession s;
+
+	{
+		const std::lock_guard protect{mutex};
+		queue = std::exchange(prefetch_queue, {});
+
+		if (!session.IsDefined())
+			/* not logged in yet; the URL will be
+			   requested when the track gets opened */
+			return;
+
+		s = session;
+	}
+
+	for (auto &track_id : queue) {
+		if (!GetCachedFileUrl(track_id, s).empty())
+			continue;
+
+		if (std::any_of(file_url_prefetches.begin(),
+				file_url_prefetches.end(),
+				[&track_id](const auto &i){
+					return i->GetTrackId() == track_id;
+				}))
+			/* already pending */
+			continue;
+
+		try {
+			auto &p = *file_url_prefetches.emplace_back(std::make_unique<FileUrlPrefetch>(*this, std::move(track_id), s));
+			p.Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to prefetch Qobuz file URL");
+		}
+	}
+}
+
+void
+QobuzClient::OnFileUrlPrefetchDone(FileUrlPrefetch &prefetch) noexcept
+{
+	file_url_prefetches.remove_if([&prefetch](const auto &i){
+		return i.get() == &prefetch;
+	});
+}
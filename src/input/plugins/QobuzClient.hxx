@@ -5,14 +5,24 @@
 
 #include "QobuzSession.hxx"
 #include "QobuzLoginRequest.hxx"
+#include "QobuzAlbumRequest.hxx"
 #include "lib/curl/Init.hxx"
 #include "lib/curl/Headers.hxx"
+#include "tag/Tag.hxx"
 #include "thread/Mutex.hxx"
 #include "event/DeferEvent.hxx"
+#include "event/InjectEvent.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <chrono>
+#include <list>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class QobuzSessionHandler
 	: public SafeLinkIntrusiveListHook
@@ -21,7 +31,7 @@ public:
 	virtual void OnQobuzSession() noexcept = 0;
 };
 
-class QobuzClient final : QobuzLoginHandler {
+class QobuzClient final : QobuzLoginHandler, QobuzAlbumHandler {
 	const char *const base_url;
 	const char *const app_id, *const app_secret;
 	const char *const device_manufacturer_id;
@@ -33,7 +43,13 @@ class QobuzClient final : QobuzLoginHandler {
 	DeferEvent defer_invoke_handlers;
 
 	/**
-	 * Protects #session, #error, #login_request, #handlers.
+	 * Starts the "getFileUrl" requests for #prefetch_queue.
+	 */
+	InjectEvent inject_prefetch;
+
+	/**
+	 * Protects #session, #error, #login_request, #handlers,
+	 * #tag_cache, #file_url_cache and #prefetch_queue.
 	 */
 	mutable Mutex mutex;
 
@@ -47,6 +63,65 @@ class QobuzClient final : QobuzLoginHandler {
 
 	std::unique_ptr<QobuzLoginRequest> login_request;
 
+	struct CachedTag {
+		Tag tag;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	/**
+	 * Track metadata by track id, obtained from "track/get" or
+	 * "album/get".
+	 */
+	std::map<std::string, CachedTag, std::less<>> tag_cache;
+
+	struct CachedFileUrl {
+		std::string url;
+
+		/**
+		 * The QobuzSession::user_auth_token this URL was
+		 * signed for.
+		 */
+		std::string user_auth_token;
+
+		std::chrono::system_clock::time_point expires;
+	};
+
+	/**
+	 * Signed file URLs by track id, obtained from
+	 * "track/getFileUrl".
+	 */
+	std::map<std::string, CachedFileUrl, std::less<>> file_url_cache;
+
+	/**
+	 * Track ids whose file URLs shall be resolved in advance.
+	 */
+	std::vector<std::string> prefetch_queue;
+
+	/**
+	 * The albums whose tracks have been requested with
+	 * #album_request already (or are being requested).  Only
+	 * accessed in the I/O thread (like the following fields).
+	 */
+	std::set<std::string, std::less<>> requested_albums;
+
+	/**
+	 * Album ids waiting for #album_request.
+	 */
+	std::vector<std::string> album_queue;
+
+	/**
+	 * The pending "album/get" request (only one at a time).
+	 */
+	std::unique_ptr<QobuzAlbumRequest> album_request;
+
+	class FileUrlPrefetch;
+
+	/**
+	 * The pending "getFileUrl" requests started by
+	 * PrefetchFileUrl().
+	 */
+	std::list<std::unique_ptr<FileUrlPrefetch>> file_url_prefetches;
+
 public:
 	QobuzClient(EventLoop &event_loop,
 		    const char *_base_url,
@@ -56,6 +131,8 @@ public:
 		    const char *_password,
 		    const char *_format_id);
 
+	~QobuzClient() noexcept;
+
 	const char *GetFormatId() const noexcept {
 		return format_id;
 	}
@@ -82,6 +159,41 @@ public:
 	std::string MakeSignedUrl(const char *object, const char *method,
 				  const Curl::Headers &query) const noexcept;
 
+	/**
+	 * Look up cached metadata of a track.
+	 */
+	std::optional<Tag> GetCachedTag(std::string_view track_id) noexcept;
+
+	void PutTag(std::string_view track_id, const Tag &tag) noexcept;
+
+	/**
+	 * Fetch the metadata of all tracks of the given album in the
+	 * background (with one request) and add it to the cache,
+	 * unless this has been done already.  Must be called in the
+	 * I/O thread.
+	 */
+	void PrefetchAlbum(std::string_view album_id) noexcept;
+
+	/**
+	 * Look up a cached file URL which was signed for the given
+	 * session and has not expired yet.
+	 *
+	 * @return the URL or an empty string
+	 */
+	std::string GetCachedFileUrl(std::string_view track_id,
+				     const QobuzSession &session) noexcept;
+
+	void PutFileUrl(std::string_view track_id,
+			const QobuzSession &session,
+			std::string_view url) noexcept;
+
+	/**
+	 * Resolve the file URL of the given track in the background,
+	 * so opening it later does not need an API round trip.  This
+	 * method is thread-safe and does not block.
+	 */
+	void PrefetchFileUrl(std::string_view track_id) noexcept;
+
 private:
 	void StartLogin();
 
@@ -91,7 +203,18 @@ private:
 		defer_invoke_handlers.Schedule();
 	}
 
+	void StartAlbumRequest(std::string_view album_id) noexcept;
+
+	/* InjectEvent callback */
+	void OnInjectPrefetch() noexcept;
+
+	void OnFileUrlPrefetchDone(FileUrlPrefetch &prefetch) noexcept;
+
 	/* virtual methods from QobuzLoginHandler */
 	void OnQobuzLoginSuccess(QobuzSession &&session) noexcept override;
 	void OnQobuzLoginError(std::exception_ptr error) noexcept override;
+
+	/* virtual methods from QobuzAlbumHandler */
+	void OnQobuzAlbumSuccess(std::vector<std::pair<std::string, Tag>> &&tracks) noexcept override;
+	void OnQobuzAlbumError(std::exception_ptr error) noexcept override;
 };
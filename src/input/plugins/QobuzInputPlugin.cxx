@@ -75,6 +75,14 @@ QobuzInputStream::OnQobuzSession() noexcept
 	try {
 		const auto session = qobuz_client->GetSession();
 
+		if (const auto url = qobuz_client->GetCachedFileUrl(track_id,
+								    session);
+		    !url.empty()) {
+			SetInput(OpenCurlInputStream(url.c_str(), {},
+						     mutex));
+			return;
+		}
+
 		QobuzTrackHandler &h = *this;
 		track_request = std::make_unique<QobuzTrackRequest>(*qobuz_client,
 								    session,
@@ -92,6 +100,13 @@ QobuzInputStream::OnQobuzTrackSuccess(std::string url) noexcept
 	const std::lock_guard protect{mutex};
 	track_request.reset();
 
+	try {
+		qobuz_client->PutFileUrl(track_id,
+					 qobuz_client->GetSession(), url);
+	} catch (...) {
+		/* logged out meanwhile; don't cache this URL */
+	}
+
 	try {
 		SetInput(OpenCurlInputStream(url.c_str(), {},
 					     mutex));
@@ -190,6 +205,16 @@ ScanQobuzTags(std::string_view uri, RemoteTagHandler &handler)
 						 handler);
 }
 
+static void
+PrefetchQobuzInput(std::string_view uri) noexcept
+{
+	assert(qobuz_client != nullptr);
+
+	const auto track_id = ExtractQobuzTrackId(uri);
+	if (!track_id.empty())
+		qobuz_client->PrefetchFileUrl(track_id);
+}
+
 static constexpr const char *qobuz_prefixes[] = {
 	"qobuz://",
 	nullptr
@@ -203,4 +228,5 @@ const InputPlugin qobuz_input_plugin = {
 	OpenQobuzInput,
 	nullptr,
 	ScanQobuzTags,
+	PrefetchQobuzInput,
 };
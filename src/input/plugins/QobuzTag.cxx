@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "QobuzTag.hxx"
+#include "tag/Builder.hxx"
+
+#include <nlohmann/json.hpp>
+
+using std::string_view_literals::operator""sv;
+
+Tag
+QobuzParseTrackTag(const nlohmann::json &j, const nlohmann::json *album)
+{
+	TagBuilder b;
+
+	if (auto i = j.find("duration"sv); i != j.end())
+		b.SetDuration(SignedSongTime::FromS(i->get<unsigned>()));
+
+	if (auto i = j.find("title"sv); i != j.end())
+		b.AddItem(TAG_TITLE, i->get<std::string_view>());
+
+	if (album == nullptr) {
+		if (const auto a = j.find("album"sv); a != j.end())
+			album = &*a;
+	}
+
+	if (album != nullptr) {
+		if (auto i = album->find("title"sv); i != album->end())
+			b.AddItem(TAG_ALBUM, i->get<std::string_view>());
+
+		if (auto i = album->find("artist"sv); i != album->end())
+			b.AddItem(TAG_ALBUM_ARTIST, i->at("name"sv).get<std::string_view>());
+	}
+
+	if (auto i = j.find("composer"sv); i != j.end())
+		b.AddItem(TAG_COMPOSER, i->at("name"sv).get<std::string_view>());
+
+	if (auto i = j.find("performer"sv); i != j.end())
+		b.AddItem(TAG_PERFORMER, i->at("name"sv).get<std::string_view>());
+
+	return b.Commit();
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "tag/Tag.hxx"
+
+#include <nlohmann/json_fwd.hpp>
+
+/**
+ * Build a #Tag from a Qobuz track object (returned by "track/get" or
+ * contained in the "tracks" list returned by "album/get").
+ *
+ * @param album the album object the track belongs to; nullptr to use
+ * the track's "album" attribute
+ */
+Tag
+QobuzParseTrackTag(const nlohmann::json &track,
+		   const nlohmann::json *album=nullptr);
@@ -4,8 +4,8 @@
 #include "QobuzTagScanner.hxx"
 #include "QobuzErrorParser.hxx"
 #include "QobuzClient.hxx"
-#include "tag/Builder.hxx"
-#include "tag/Tag.hxx"
+#include "QobuzTag.hxx"
+#include "lib/curl/Global.hxx"
 
 #include <nlohmann/json.hpp>
 
@@ -20,12 +20,15 @@ MakeTrackUrl(QobuzClient &client, std::string_view track_id)
 			      });
 }
 
-QobuzTagScanner::QobuzTagScanner(QobuzClient &client,
-				 std::string_view track_id,
+QobuzTagScanner::QobuzTagScanner(QobuzClient &_client,
+				 std::string_view _track_id,
 				 RemoteTagHandler &_handler)
-	:request(client.GetCurl(),
+	:client(_client), track_id(_track_id),
+	 request(client.GetCurl(),
 		 MakeTrackUrl(client, track_id).c_str(),
 		 *this),
+	 inject_cached(client.GetCurl().GetEventLoop(),
+		       BIND_THIS_METHOD(OnInjectCached)),
 	 handler(_handler)
 {
 }
@@ -35,32 +38,42 @@ QobuzTagScanner::~QobuzTagScanner() noexcept
 	request.StopIndirect();
 }
 
-static void
-from_json(const nlohmann::json &j, Tag &tag)
+void
+QobuzTagScanner::Start() noexcept
 {
-	TagBuilder b;
-
-	if (auto i = j.find("duration"sv); i != j.end())
-		b.SetDuration(SignedSongTime::FromS(i->get<unsigned>()));
-
-	if (auto i = j.find("title"sv); i != j.end())
-		b.AddItem(TAG_TITLE, i->get<std::string_view>());
-
-	if (const auto a = j.find("album"sv); a != j.end()) {
-		if (auto i = a->find("title"sv); i != a->end())
-			b.AddItem(TAG_ALBUM, i->get<std::string_view>());
-
-		if (auto i = a->find("artist"sv); i != a->end())
-			b.AddItem(TAG_ALBUM_ARTIST, i->at("name"sv).get<std::string_view>());
-	}
-
-	if (auto i = j.find("composer"sv); i != j.end())
-		b.AddItem(TAG_COMPOSER, i->at("name"sv).get<std::string_view>());
+	cached_tag = client.GetCachedTag(track_id);
+	if (cached_tag)
+		inject_cached.Schedule();
+	else
+		request.StartIndirect();
+}
 
-	if (auto i = j.find("performer"sv); i != j.end())
-		b.AddItem(TAG_PERFORMER, i->at("name"sv).get<std::string_view>());
+void
+QobuzTagScanner::OnInjectCached() noexcept
+{
+	handler.OnRemoteTag(std::move(*cached_tag));
+}
 
-	b.Commit(tag);
+/**
+ * If the given track belongs to an album with more tracks, fetch the
+ * metadata of all of them with one request, because it is likely
+ * that they will be scanned next.
+ */
+static void
+PrefetchAlbum(QobuzClient &client, const nlohmann::json &track)
+{
+	const auto a = track.find("album"sv);
+	if (a == track.end())
+		return;
+
+	const auto id = a->find("id"sv);
+	const auto tracks_count = a->find("tracks_count"sv);
+	if (id == a->end() || !id->is_string() ||
+	    tracks_count == a->end() || !tracks_count->is_number_unsigned() ||
+	    tracks_count->get<unsigned>() < 2)
+		return;
+
+	client.PrefetchAlbum(id->get<std::string_view>());
 }
 
 void
@@ -74,7 +87,12 @@ QobuzTagScanner::OnEnd()
 	    i == r.headers.end() || i->second.find("/json") == i->second.npos)
 		throw std::runtime_error("Not a JSON response from Qobuz");
 
-	handler.OnRemoteTag(nlohmann::json::parse(r.body));
+	const auto track = nlohmann::json::parse(r.body);
+	auto tag = QobuzParseTrackTag(track);
+	client.PutTag(track_id, tag);
+	PrefetchAlbum(client, track);
+
+	handler.OnRemoteTag(std::move(tag));
 }
 
 void
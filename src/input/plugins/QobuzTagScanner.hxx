@@ -6,14 +6,31 @@
 #include "lib/curl/Request.hxx"
 #include "lib/curl/StringHandler.hxx"
 #include "input/RemoteTagScanner.hxx"
+#include "event/InjectEvent.hxx"
+#include "tag/Tag.hxx"
+
+#include <optional>
+#include <string>
 
 class QobuzClient;
 
 class QobuzTagScanner final
 	: public RemoteTagScanner, StringCurlResponseHandler
 {
+	QobuzClient &client;
+
+	const std::string track_id;
+
 	CurlRequest request;
 
+	/**
+	 * Delivers #cached_tag (if the track was found in the
+	 * cache) in the I/O thread.
+	 */
+	InjectEvent inject_cached;
+
+	std::optional<Tag> cached_tag;
+
 	RemoteTagHandler &handler;
 
 public:
@@ -25,11 +42,11 @@ public:
 
 	~QobuzTagScanner() noexcept override;
 
-	void Start() noexcept override {
-		request.StartIndirect();
-	}
+	void Start() noexcept override;
 
 private:
+	void OnInjectCached() noexcept;
+
 	/* virtual methods from CurlResponseHandler */
 	void OnEnd() override;
 	void OnError(std::exception_ptr e) noexcept override;
@@ -3,7 +3,7 @@
 
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "../MaybeBufferedInputStream.hxx"
@@ -13,14 +13,22 @@
 
 #include <libsmbclient.h>
 
+#include <memory>
+
+/**
+ * Contexts are shared by all streams (one at a time), so the server
+ * connections survive from one song to the next.
+ */
+static std::unique_ptr<SmbclientContextPool> smbclient_pool;
+
 class SmbclientInputStream final : public InputStream {
-	SmbclientContext ctx;
+	SmbclientContextPool::Lease ctx;
 	SMBCFILE *const handle;
 
 public:
 	SmbclientInputStream(std::string &&_uri,
 			     Mutex &_mutex,
-			     SmbclientContext &&_ctx,
+			     SmbclientContextPool::Lease &&_ctx,
 			     SMBCFILE *_handle, const struct stat &st)
 		:InputStream(_uri, _mutex),
 		 ctx(std::move(_ctx)), handle(_handle)
@@ -31,7 +39,7 @@ public:
 	}
 
 	~SmbclientInputStream() override {
-		ctx.Close(handle);
+		ctx->Close(handle);
 	}
 
 	/* virtual methods from InputStream */
@@ -59,26 +67,32 @@ input_smbclient_init(EventLoop &, const ConfigBlock &)
 		std::throw_with_nested(PluginUnavailable("libsmbclient initialization failed"));
 	}
 
-	// TODO: create one global SMBCCTX here?
+	smbclient_pool = std::make_unique<SmbclientContextPool>();
 
 	// TODO: evaluate ConfigBlock, call smbc_setOption*()
 }
 
+static void
+input_smbclient_finish() noexcept
+{
+	smbclient_pool.reset();
+}
+
 static InputStreamPtr
 input_smbclient_open(std::string_view _uri,
 		     Mutex &mutex)
 {
-	auto ctx = SmbclientContext::New();
+	auto ctx = smbclient_pool->Get();
 
 	std::string uri{_uri};
-	SMBCFILE *handle = ctx.OpenReadOnly(uri.c_str());
+	SMBCFILE *handle = ctx->OpenReadOnly(uri.c_str());
 	if (handle == nullptr)
 		throw MakeErrno("smbc_open() failed");
 
 	struct stat st;
-	if (ctx.Stat(handle, st) < 0) {
+	if (ctx->Stat(handle, st) < 0) {
 		const int e = errno;
-		ctx.Close(handle);
+		ctx->Close(handle);
 		throw MakeErrno(e, "smbc_fstat() failed");
 	}
 
@@ -98,7 +112,7 @@ SmbclientInputStream::Read(std::unique_lock<Mutex> &lock,
 
 	{
 		const ScopeUnlock unlock{lock};
-		nbytes = ctx.Read(handle, dest.data(), dest.size());
+		nbytes = ctx->Read(handle, dest.data(), dest.size());
 	}
 
 	if (nbytes < 0)
@@ -118,7 +132,7 @@ SmbclientInputStream::Seek(std::unique_lock<Mutex> &lock,
 
 	{
 		const ScopeUnlock unlock{lock};
-		result = ctx.Seek(handle, new_offset);
+		result = ctx->Seek(handle, new_offset);
 	}
 
 	if (result < 0)
@@ -136,7 +150,7 @@ const InputPlugin input_plugin_smbclient = {
 	"smbclient",
 	smbclient_prefixes,
 	input_smbclient_init,
-	nullptr,
+	input_smbclient_finish,
 	input_smbclient_open,
 	nullptr
 };
@@ -3,6 +3,7 @@
 
 #include "UringInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../LazyFileMapping.hxx"
 #include "event/Call.hxx"
 #include "event/Loop.hxx"
 #include "lib/fmt/RuntimeError.hxx"
@@ -12,37 +13,136 @@
 #include "io/uring/ReadOperation.hxx"
 #include "io/uring/Queue.hxx"
 
+#include <algorithm> // for std::min()
+#include <forward_list>
+#include <list>
+
 #include <sys/stat.h>
 
 /**
  * Read at most this number of bytes in each read request.
  */
-static const size_t URING_MAX_READ = 256 * 1024;
+static constexpr size_t URING_MAX_READ = 128 * 1024;
+
+/**
+ * Keep at most this number of read requests in flight.  Submitting
+ * the following reads before the current one completes keeps the
+ * disk busy (especially rotating disks and network file systems with
+ * high latency), instead of waiting a full round trip per request.
+ */
+static constexpr unsigned URING_MAX_IN_FLIGHT = 4;
 
 /**
  * Do not buffer more than this number of bytes.  It should be a
  * reasonable limit that doesn't make low-end machines suffer too
  * much, but doesn't cause stuttering on high-latency lines.
  */
-static const size_t URING_MAX_BUFFERED = 512 * 1024;
+static constexpr size_t URING_MAX_BUFFERED = 512 * 1024;
 
 /**
  * Resume the stream at this number of bytes after it has been paused.
  */
-static const size_t URING_RESUME_AT = 384 * 1024;
+static constexpr size_t URING_RESUME_AT = 384 * 1024;
 
 static EventLoop *uring_input_event_loop;
 static Uring::Queue *uring_input_queue;
 static bool uring_input_initialized = false;
 
-class UringInputStream final : public AsyncInputStream, Uring::ReadHandler {
+class UringInputStream final : public AsyncInputStream {
 	Uring::Queue &uring;
 
 	UniqueFileDescriptor fd;
 
+	LazyFileMapping mapping;
+
+	/**
+	 * One read request submitted to the kernel.
+	 */
+	struct PendingRead final : Uring::ReadHandler {
+		UringInputStream &stream;
+
+		/**
+		 * The operation; nullptr after it has completed.
+		 */
+		std::unique_ptr<Uring::ReadOperation> operation;
+
+		/**
+		 * The buffer which was filled by the kernel.
+		 */
+		std::unique_ptr<std::byte[]> buffer;
+
+		const uint64_t offset;
+
+		/**
+		 * The requested number of bytes.
+		 */
+		const std::size_t size;
+
+		/**
+		 * The number of bytes which were read.
+		 */
+		std::size_t nbytes = 0;
+
+		/**
+		 * An errno value or 0 on success.
+		 */
+		int error = 0;
+
+		PendingRead(UringInputStream &_stream,
+			    uint64_t _offset, std::size_t _size) noexcept
+			:stream(_stream),
+			 operation(std::make_unique<Uring::ReadOperation>()),
+			 offset(_offset), size(_size) {}
+
+		bool IsDone() const noexcept {
+			return !operation;
+		}
+
+		void Cancel() noexcept {
+			if (operation)
+				operation.release()->Cancel();
+		}
+
+		/* virtual methods from class Uring::ReadHandler */
+		void OnRead(std::unique_ptr<std::byte[]> _buffer,
+			    std::size_t _nbytes) noexcept override {
+			operation.reset();
+			buffer = std::move(_buffer);
+			nbytes = _nbytes;
+			stream.OnReadDone();
+		}
+
+		void OnReadError(int _error) noexcept override {
+			operation.reset();
+			error = _error;
+			stream.OnReadDone();
+		}
+	};
+
+	/**
+	 * All reads which have been submitted but not yet been
+	 * appended to the buffer, ordered by offset.  They may
+	 * complete in any order; their data is appended in order.
+	 */
+	std::list<PendingRead> reads;
+
+	/**
+	 * The offset of the next read to be submitted.
+	 */
 	uint64_t next_offset = 0;
 
-	std::unique_ptr<Uring::ReadOperation> read_operation;
+	/**
+	 * The sum of PendingRead::size of all #reads; this much
+	 * buffer space is reserved for them.
+	 */
+	std::size_t reserved = 0;
+
+	/**
+	 * Buffers (of #URING_MAX_READ bytes) returned by completed
+	 * reads, to be reused by the next ones instead of allocating
+	 * new ones each time.
+	 */
+	std::forward_list<std::unique_ptr<std::byte[]>> spare_buffers;
 
 public:
 	UringInputStream(EventLoop &event_loop, Uring::Queue &_uring,
@@ -61,104 +161,147 @@ public:
 		SetReady();
 
 		BlockingCall(GetEventLoop(), [this](){
-			SubmitRead();
+			SubmitReads();
 		});
 	}
 
 	~UringInputStream() noexcept override {
 		BlockingCall(GetEventLoop(), [this](){
-			CancelRead();
+			CancelReads();
 		});
 	}
 
+	/* virtual methods from InputStream */
+	std::span<const std::byte> GetContiguous() const noexcept override {
+		return mapping.Get(fd, GetSize());
+	}
+
 private:
-	void SubmitRead() noexcept;
+	/**
+	 * Submit as many reads as the buffer has room for.
+	 */
+	void SubmitReads() noexcept;
+
+	/**
+	 * Cancel all pending reads.  Their buffers are freed after
+	 * the kernel has finished, because the kernel may still
+	 * write to them.
+	 */
+	void CancelReads() noexcept {
+		for (auto &i : reads)
+			i.Cancel();
+		reads.clear();
+		reserved = 0;
+	}
+
+	std::unique_ptr<std::byte[]> AllocateBuffer() noexcept {
+		if (spare_buffers.empty())
+			return std::make_unique_for_overwrite<std::byte[]>(URING_MAX_READ);
 
-	void CancelRead() noexcept {
-		if (read_operation)
-			read_operation.release()->Cancel();
+		auto buffer = std::move(spare_buffers.front());
+		spare_buffers.pop_front();
+		return buffer;
 	}
 
+	/**
+	 * Called by #PendingRead after it has completed; appends all
+	 * completed reads at the front of #reads to the buffer.
+	 */
+	void OnReadDone() noexcept;
+
 protected:
 	/* virtual methods from AsyncInputStream */
 	void DoResume() override;
 	void DoSeek(offset_type new_offset) override;
-
-private:
-	/* virtual methods from class Uring::Operation */
-	void OnRead(std::unique_ptr<std::byte[]> buffer,
-		    std::size_t size) noexcept override;
-	void OnReadError(int error) noexcept override;
 };
 
 void
-UringInputStream::SubmitRead() noexcept
+UringInputStream::SubmitReads() noexcept
 {
-	assert(!read_operation);
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return;
-
-	auto w = PrepareWriteBuffer();
-	if (w.empty()) {
-		Pause();
-		return;
+	while (reads.size() < URING_MAX_IN_FLIGHT) {
+		const int64_t remaining = size - next_offset;
+		if (remaining <= 0)
+			return;
+
+		const std::size_t space = GetBufferSpace() - reserved;
+		if (space == 0) {
+			if (reads.empty())
+				Pause();
+			return;
+		}
+
+		const std::size_t nbytes = std::min({space, URING_MAX_READ,
+						      (std::size_t)remaining});
+
+		auto &r = reads.emplace_back(*this, next_offset, nbytes);
+		r.operation->Start(uring, fd, next_offset,
+				   AllocateBuffer(), nbytes, r);
+
+		next_offset += nbytes;
+		reserved += nbytes;
 	}
-
-	read_operation = std::make_unique<Uring::ReadOperation>();
-	read_operation->Start(uring, fd, next_offset,
-			      std::min(w.size(), URING_MAX_READ),
-			      *this);
 }
 
 void
 UringInputStream::DoResume()
 {
-	SubmitRead();
+	SubmitReads();
 }
 
 void
 UringInputStream::DoSeek(offset_type new_offset)
 {
-	CancelRead();
+	CancelReads();
 
 	next_offset = offset = new_offset;
 	SeekDone();
-	SubmitRead();
+	SubmitReads();
 }
 
 void
-UringInputStream::OnRead(std::unique_ptr<std::byte[]> data,
-			 std::size_t nbytes) noexcept
+UringInputStream::OnReadDone() noexcept
 {
-	read_operation.reset();
-
 	const std::lock_guard protect{mutex};
 
-	if (nbytes == 0) {
-		postponed_exception = std::make_exception_ptr(std::runtime_error("Premature end of file"));
-		InvokeOnAvailable();
-		return;
+	while (!reads.empty() && reads.front().IsDone()) {
+		auto &r = reads.front();
+
+		if (r.error != 0) {
+			postponed_exception = std::make_exception_ptr(MakeErrno(r.error, "Read failed"));
+			CancelReads();
+			InvokeOnAvailable();
+			return;
+		}
+
+		if (r.nbytes == 0) {
+			postponed_exception = std::make_exception_ptr(std::runtime_error("Premature end of file"));
+			CancelReads();
+			InvokeOnAvailable();
+			return;
+		}
+
+		assert(r.nbytes <= r.size);
+		assert(r.nbytes <= GetBufferSpace());
+
+		AppendToBuffer({r.buffer.get(), r.nbytes});
+		reserved -= r.size;
+
+		if (r.nbytes < r.size) {
+			/* short read: the following reads are at the
+			   wrong offsets; discard them and continue
+			   right after this one */
+			next_offset = r.offset + r.nbytes;
+			spare_buffers.emplace_front(std::move(r.buffer));
+			reads.pop_front();
+			CancelReads();
+			break;
+		}
+
+		spare_buffers.emplace_front(std::move(r.buffer));
+		reads.pop_front();
 	}
 
-	auto w = PrepareWriteBuffer();
-	assert(w.size() >= nbytes);
-	memcpy(w.data(), data.get(), nbytes);
-	CommitWriteBuffer(nbytes);
-	next_offset += nbytes;
-	SubmitRead();
-}
-
-void
-UringInputStream::OnReadError(int error) noexcept
-{
-	read_operation.reset();
-
-	const std::lock_guard protect{mutex};
-
-	postponed_exception = std::make_exception_ptr(MakeErrno(error, "Read failed"));
-	InvokeOnAvailable();
+	SubmitReads();
 }
 
 InputStreamPtr
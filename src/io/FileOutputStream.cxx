@@ -138,6 +138,11 @@ FileOutputStream::Sync()
 		throw FmtLastError("Failed to sync {}", GetPath());
 }
 
+void
+FileOutputStream::Preallocate(uint64_t, uint64_t) noexcept
+{
+}
+
 void
 FileOutputStream::Commit()
 try {
@@ -285,11 +290,30 @@ FileOutputStream::Sync()
 		throw FmtErrno("Failed to sync {}", GetPath());
 }
 
+void
+FileOutputStream::Preallocate([[maybe_unused]] uint64_t offset,
+			      [[maybe_unused]] uint64_t length) noexcept
+{
+	assert(IsDefined());
+
+#ifdef __linux__
+	if (fallocate(fd.Get(), FALLOC_FL_KEEP_SIZE, offset, length) == 0)
+		preallocated = true;
+#endif
+}
+
 void
 FileOutputStream::Commit()
 try {
 	assert(IsDefined());
 
+#ifdef __linux__
+	if (preallocated)
+		/* release the preallocated space beyond the end of
+		   the file */
+		(void)ftruncate(fd.Get(), fd.Tell());
+#endif
+
 #ifdef HAVE_O_TMPFILE
 	if (is_tmpfile) {
 		unlinkat(directory_fd.Get(), GetPath().c_str(), 0);
@@ -66,6 +66,14 @@ class FileOutputStream final : public OutputStream {
 	bool is_tmpfile = false;
 #endif
 
+#ifdef __linux__
+	/**
+	 * Was Preallocate() successful?  If yes, then Commit()
+	 * truncates the file to release unused space.
+	 */
+	bool preallocated = false;
+#endif
+
 public:
 	enum class Mode : uint8_t {
 		/**
@@ -137,6 +145,17 @@ public:
 	 */
 	void Sync();
 
+	/**
+	 * Reserve disk space for data which is going to be written,
+	 * without changing the file size.  This reduces
+	 * fragmentation and lets later writes fail early if the disk
+	 * is full.  Unused space is released by Commit().
+	 *
+	 * This is only a hint; errors are ignored, and it is a no-op
+	 * if the operating system does not support it.
+	 */
+	void Preallocate(uint64_t offset, uint64_t length) noexcept;
+
 	/**
 	 * Commit all data written to the file and make the file
 	 * visible on the specified path.
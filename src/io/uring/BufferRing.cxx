@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "BufferRing.hxx"
+#include "Queue.hxx"
+#include "system/Error.hxx"
+
+#include <atomic>
+#include <cassert>
+
+#include <sys/mman.h>
+
+namespace Uring {
+
+/**
+ * The next buffer group id to try.  Groups are registered with
+ * each io_uring, and a collision with a long-lived group (after the
+ * counter has wrapped around) is resolved by trying the next one.
+ */
+static std::atomic<uint16_t> next_group;
+
+std::size_t
+BufferRing::GetRingSize() const noexcept
+{
+	return n_buffers * sizeof(struct io_uring_buf);
+}
+
+BufferRing::BufferRing(Queue &_queue, unsigned _n_buffers,
+		       std::size_t _buffer_size)
+	:queue(_queue),
+	 buffers(std::make_unique_for_overwrite<std::byte[]>(_n_buffers * _buffer_size)),
+	 n_buffers(_n_buffers), buffer_size(_buffer_size)
+{
+	assert(n_buffers > 0);
+	assert((n_buffers & (n_buffers - 1)) == 0);
+
+	/* the ring must be page-aligned; anonymous mappings are
+	   zero-filled, which initializes its tail */
+	void *p = mmap(nullptr, GetRingSize(), PROT_READ|PROT_WRITE,
+		       MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("mmap() failed");
+
+	ring = static_cast<struct io_uring_buf_ring *>(p);
+
+	struct io_uring_buf_reg reg{};
+	reg.ring_addr = reinterpret_cast<uintptr_t>(ring);
+	reg.ring_entries = n_buffers;
+
+	int error;
+	for (unsigned i = 0; i < 16; ++i) {
+		reg.bgid = group = next_group.fetch_add(1, std::memory_order_relaxed);
+		error = queue.RegisterBufferRing(reg);
+		if (error != -EEXIST)
+			break;
+	}
+
+	if (error < 0) {
+		munmap(ring, GetRingSize());
+		throw MakeErrno(-error, "io_uring_register_buf_ring() failed");
+	}
+
+	const int mask = io_uring_buf_ring_mask(n_buffers);
+	for (unsigned i = 0; i < n_buffers; ++i)
+		io_uring_buf_ring_add(ring, buffers.get() + i * buffer_size,
+				      buffer_size, i, mask, i);
+	io_uring_buf_ring_advance(ring, n_buffers);
+}
+
+BufferRing::~BufferRing() noexcept
+{
+	waiters.clear();
+	queue.UnregisterBufferRing(group);
+	munmap(ring, GetRingSize());
+}
+
+void
+BufferRing::Recycle(unsigned id) noexcept
+{
+	assert(id < n_buffers);
+
+	io_uring_buf_ring_add(ring, buffers.get() + id * buffer_size,
+			      buffer_size, id,
+			      io_uring_buf_ring_mask(n_buffers), 0);
+	io_uring_buf_ring_advance(ring, 1);
+
+	if (!waiters.empty())
+		waiters.pop_front().OnBufferRecycled();
+}
+
+} // namespace Uring
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "util/IntrusiveList.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+struct io_uring_buf_ring;
+
+namespace Uring {
+
+class Queue;
+
+/**
+ * An operation which has stopped because all buffers of a
+ * #BufferRing were in use; see BufferRing::AddWaiter().
+ */
+class BufferRingWaiter : public AutoUnlinkIntrusiveListHook {
+public:
+	/**
+	 * A buffer has been given back to the kernel.
+	 */
+	virtual void OnBufferRecycled() noexcept = 0;
+};
+
+/**
+ * A ring of buffers provided to the kernel (a "buffer group") for
+ * operations with IOSQE_BUFFER_SELECT.  The kernel picks a free
+ * buffer for each completion and reports its id in the completion
+ * flags; the buffer belongs to the caller until it is returned with
+ * Recycle().
+ */
+class BufferRing {
+	Queue &queue;
+
+	struct io_uring_buf_ring *ring;
+
+	std::unique_ptr<std::byte[]> buffers;
+
+	const unsigned n_buffers;
+
+	const std::size_t buffer_size;
+
+	uint16_t group;
+
+	IntrusiveList<BufferRingWaiter> waiters;
+
+public:
+	/**
+	 * Throws on error (e.g. if the kernel does not support
+	 * provided buffer rings, which requires Linux 5.19).
+	 *
+	 * @param n_buffers the number of buffers; must be a power of
+	 * two
+	 */
+	BufferRing(Queue &_queue, unsigned _n_buffers,
+		   std::size_t _buffer_size);
+
+	~BufferRing() noexcept;
+
+	BufferRing(const BufferRing &) = delete;
+	BufferRing &operator=(const BufferRing &) = delete;
+
+	/**
+	 * The buffer group id to be stored in io_uring_sqe::buf_group.
+	 */
+	uint16_t GetGroup() const noexcept {
+		return group;
+	}
+
+	unsigned size() const noexcept {
+		return n_buffers;
+	}
+
+	/**
+	 * Returns the first @a size bytes of the buffer with the
+	 * given id.
+	 */
+	std::span<const std::byte> Get(unsigned id,
+				       std::size_t size) const noexcept {
+		return {buffers.get() + id * buffer_size, size};
+	}
+
+	/**
+	 * Give the buffer with the given id back to the kernel.  This
+	 * notifies the oldest waiter (if any).
+	 */
+	void Recycle(unsigned id) noexcept;
+
+	/**
+	 * Notify the given object when a buffer is recycled.  This is
+	 * for operations which share this ring with others and have
+	 * run out of buffers while holding none of them; they cannot
+	 * resubmit until someone else gives one back.
+	 */
+	void AddWaiter(BufferRingWaiter &waiter) noexcept {
+		if (!waiter.is_linked())
+			waiters.push_back(waiter);
+	}
+
+private:
+	std::size_t GetRingSize() const noexcept;
+};
+
+} // namespace Uring
@@ -19,6 +19,12 @@ class CancellableOperation
 {
 	Operation *operation;
 
+	/**
+	 * Has Queue::CancelOperation() been called while the submit
+	 * queue was full?  The cancellation will be submitted later.
+	 */
+	bool cancel_deferred = false;
+
 public:
 	CancellableOperation(Operation &_operation) noexcept
 		:operation(&_operation)
@@ -41,6 +47,14 @@ public:
 		// TODO: io_uring_prep_cancel()
 	}
 
+	bool IsCancelDeferred() const noexcept {
+		return cancel_deferred;
+	}
+
+	void SetCancelDeferred(bool value) noexcept {
+		cancel_deferred = value;
+	}
+
 	void Replace(Operation &old_operation,
 		     Operation &new_operation) noexcept {
 		assert(operation == &old_operation);
@@ -51,18 +65,18 @@ public:
 		new_operation.cancellable = this;
 	}
 
-	void OnUringCompletion(int res, bool more) noexcept {
+	void OnUringCompletion(int res, unsigned flags, bool more) noexcept {
 		if (operation == nullptr)
 			return;
 
 		assert(operation->cancellable == this);
 
 		if (more) {
-			operation->OnUringCompletion(res);
+			operation->OnUringCompletionFlags(res, flags);
 		} else {
 			operation->cancellable = nullptr;
 
-			std::exchange(operation, nullptr)->OnUringCompletion(res);
+			std::exchange(operation, nullptr)->OnUringCompletionFlags(res, flags);
 		}
 	}
 };
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#include "MultiReceiveOperation.hxx"
+#include "Queue.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+#include <string.h>
+
+namespace Uring {
+
+MultiReceiveOperation::MultiReceiveOperation(Queue &_queue, FileDescriptor _fd,
+					     ReceiveHandler &_handler)
+	:queue(_queue), handler(&_handler), fd(_fd),
+	 buffers(_queue.GetReceiveBuffers())
+{
+}
+
+MultiReceiveOperation *
+MultiReceiveOperation::Start(Queue &queue, FileDescriptor fd,
+			     ReceiveHandler &handler)
+{
+	auto *operation = new MultiReceiveOperation(queue, fd, handler);
+
+	try {
+		operation->Submit();
+	} catch (...) {
+		delete operation;
+		throw;
+	}
+
+	return operation;
+}
+
+void
+MultiReceiveOperation::Submit()
+{
+	assert(!IsUringPending());
+
+	auto &s = queue.RequireSubmitEntry();
+	io_uring_prep_recv_multishot(&s, fd.Get(), nullptr, 0, 0);
+	s.flags |= IOSQE_BUFFER_SELECT;
+	s.buf_group = buffers.GetGroup();
+	queue.Push(s, *this);
+}
+
+void
+MultiReceiveOperation::MaybeResubmit() noexcept
+{
+	if (IsUringPending() || end || error != 0 || n_chunks >= MAX_CHUNKS)
+		return;
+
+	if (n_chunks == 0 && is_linked())
+		/* the ring is still exhausted; OnBufferRecycled()
+		   will resubmit */
+		return;
+
+	try {
+		Submit();
+	} catch (...) {
+		/* the submit queue is full */
+		error = ENOBUFS;
+	}
+}
+
+void
+MultiReceiveOperation::Cancel() noexcept
+{
+	assert(handler != nullptr);
+
+	handler = nullptr;
+
+	if (is_linked())
+		BufferRingWaiter::unlink();
+
+	/* give back the buffers which were not consumed */
+	while (n_chunks > 0) {
+		buffers.Recycle(chunks[chunks_head].id);
+		chunks_head = (chunks_head + 1) % chunks.size();
+		--n_chunks;
+	}
+
+	if (!IsUringPending()) {
+		delete this;
+		return;
+	}
+
+	if (!stopping)
+		/* the final completion will delete this object */
+		queue.CancelOperation(*this);
+}
+
+ssize_t
+MultiReceiveOperation::Read(std::span<std::byte> dest) noexcept
+{
+	assert(handler != nullptr);
+
+	std::size_t nbytes = 0;
+
+	while (n_chunks > 0 && nbytes < dest.size()) {
+		auto &chunk = chunks[chunks_head];
+		const auto src = buffers.Get(chunk.id, chunk.size)
+			.subspan(chunk.position);
+
+		const std::size_t n = std::min(src.size(), dest.size() - nbytes);
+		memcpy(dest.data() + nbytes, src.data(), n);
+		nbytes += n;
+		chunk.position += n;
+
+		if (chunk.position == chunk.size) {
+			buffers.Recycle(chunk.id);
+			chunks_head = (chunks_head + 1) % chunks.size();
+			--n_chunks;
+		}
+	}
+
+	MaybeResubmit();
+
+	if (nbytes == 0 && (end || error != 0))
+		return -1;
+
+	return nbytes;
+}
+
+void
+MultiReceiveOperation::OnUringCompletion(int res) noexcept
+{
+	OnUringCompletionFlags(res, 0);
+}
+
+void
+MultiReceiveOperation::OnUringCompletionFlags(int res, unsigned flags) noexcept
+{
+	const bool queue_destroyed = res == -ECANCELED && IsUringPending();
+	if (queue_destroyed)
+		/* the #Queue is being destroyed; detach from its
+		   #CancellableOperation */
+		CancelUring();
+
+	/* without IORING_CQE_F_MORE, this is the last completion of
+	   this submission */
+	const bool last = !IsUringPending();
+
+	if (handler == nullptr) {
+		/* operation was canceled; the buffer (if any) is not
+		   needed anymore */
+		if (res > 0 && (flags & IORING_CQE_F_BUFFER))
+			buffers.Recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+
+		if (last)
+			delete this;
+		return;
+	}
+
+	if (res > 0) {
+		assert(flags & IORING_CQE_F_BUFFER);
+		assert(n_chunks < chunks.size());
+
+		chunks[(chunks_head + n_chunks++) % chunks.size()] = {
+			static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT),
+			0, static_cast<uint16_t>(res),
+		};
+
+		received = true;
+
+		if (n_chunks >= MAX_CHUNKS && !last && !stopping) {
+			/* don't let this socket occupy the shared
+			   ring; Read() will resubmit */
+			stopping = true;
+			queue.CancelOperation(*this);
+		}
+	} else if (res == 0)
+		end = true;
+	else if (res == -ENOBUFS) {
+		/* the shared ring has run out of buffers; if we hold
+		   some, Read() will resubmit, else wait for someone
+		   else to recycle one */
+		if (n_chunks == 0)
+			buffers.AddWaiter(*this);
+	} else if (res != -ECANCELED || queue_destroyed)
+		error = -res;
+
+	if (last) {
+		stopping = false;
+		MaybeResubmit();
+	}
+
+	handler->OnUringReceive();
+}
+
+void
+MultiReceiveOperation::OnBufferRecycled() noexcept
+{
+	assert(handler != nullptr);
+
+	MaybeResubmit();
+}
+
+} // namespace Uring
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Operation.hxx"
+#include "BufferRing.hxx"
+#include "Queue.hxx"
+#include "io/FileDescriptor.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <errno.h> // for EINVAL
+#include <sys/types.h> // for ssize_t
+
+namespace Uring {
+
+class ReceiveHandler {
+public:
+	/**
+	 * Data has been received (or the peer has closed the
+	 * connection, or an error has occurred); call
+	 * MultiReceiveOperation::Read() to obtain it.
+	 */
+	virtual void OnUringReceive() noexcept = 0;
+};
+
+/**
+ * Receive from a socket with a multishot receive
+ * (IORING_RECV_MULTISHOT) into the #BufferRing shared by all
+ * receive operations on the #Queue.  One submission keeps
+ * delivering data until this object holds #MAX_CHUNKS unread
+ * buffers (then it cancels the receive) or the ring runs out of
+ * buffers; they are recycled by Read() and then the receive is
+ * resubmitted.
+ *
+ * Instances of this class must be allocated with `new`, because
+ * cancellation will require this object to persist until the
+ * kernel completes the operation.
+ */
+class MultiReceiveOperation final : Operation, BufferRingWaiter {
+	/**
+	 * Stop receiving when this many buffers have not yet been
+	 * consumed by Read(), so one stalled socket cannot occupy
+	 * the whole shared ring.
+	 */
+	static constexpr unsigned MAX_CHUNKS = 4;
+
+	Queue &queue;
+
+	ReceiveHandler *handler;
+
+	const FileDescriptor fd;
+
+	BufferRing &buffers;
+
+	/**
+	 * A buffer which has been filled by the kernel but not yet
+	 * consumed by Read().
+	 */
+	struct Chunk {
+		uint16_t id;
+		uint16_t position, size;
+	};
+
+	/**
+	 * A FIFO of received chunks.  Completions which were already
+	 * queued when the receive was canceled may exceed
+	 * #MAX_CHUNKS, but never the size of the ring.
+	 */
+	std::array<Chunk, Queue::RECEIVE_BUFFERS> chunks;
+	unsigned chunks_head = 0, n_chunks = 0;
+
+	/**
+	 * An errno value reported by the kernel or 0.
+	 */
+	int error = 0;
+
+	/**
+	 * Has the peer closed the connection?
+	 */
+	bool end = false;
+
+	/**
+	 * Has the receive been canceled because this object holds
+	 * #MAX_CHUNKS buffers?  Cleared by its final completion.
+	 */
+	bool stopping = false;
+
+	/**
+	 * Has any data been received?  This is used to detect kernels
+	 * which support buffer rings, but not multishot receive.
+	 */
+	bool received = false;
+
+	MultiReceiveOperation(Queue &_queue, FileDescriptor _fd,
+			      ReceiveHandler &_handler);
+
+public:
+	/**
+	 * Allocate a new instance and submit the receive.
+	 *
+	 * Throws on error.
+	 */
+	static MultiReceiveOperation *Start(Queue &queue, FileDescriptor fd,
+					    ReceiveHandler &handler);
+
+	/**
+	 * Cancel this operation.  This instance will be freed using
+	 * `delete` after the kernel has finished cancellation,
+	 * i.e. the caller resigns ownership.  The socket must not be
+	 * read from afterwards; it may be closed right away (the
+	 * kernel holds its own reference until the receive is
+	 * canceled).
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Is there something for Read() (data, end of stream or an
+	 * error)?
+	 */
+	bool IsReady() const noexcept {
+		return n_chunks > 0 || end || error != 0;
+	}
+
+	/**
+	 * Did the kernel reject the multishot receive before any data
+	 * was received?  The caller should cancel this object and
+	 * fall back to readiness notifications.
+	 */
+	bool IsUnsupported() const noexcept {
+		return error == EINVAL && !received;
+	}
+
+	/**
+	 * An errno value if Read() has returned -1 because of an
+	 * error, or 0 if the peer has closed the connection.
+	 */
+	int GetError() const noexcept {
+		return error;
+	}
+
+	/**
+	 * Copy received data to the given buffer, like recv() on a
+	 * non-blocking socket.
+	 *
+	 * @return the number of bytes copied, 0 if nothing has been
+	 * received yet, -1 at the end of the stream or on error (see
+	 * GetError())
+	 */
+	ssize_t Read(std::span<std::byte> dest) noexcept;
+
+private:
+	void Submit();
+
+	/**
+	 * Resubmit the receive after it has been stopped because this
+	 * object had #MAX_CHUNKS unread buffers or the ring ran out
+	 * of buffers.
+	 */
+	void MaybeResubmit() noexcept;
+
+	/* virtual methods from class Operation */
+	void OnUringCompletion(int res) noexcept override;
+	void OnUringCompletionFlags(int res, unsigned flags) noexcept override;
+
+	/* virtual methods from class BufferRingWaiter */
+	void OnBufferRecycled() noexcept override;
+};
+
+} // namespace Uring
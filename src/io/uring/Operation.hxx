@@ -65,6 +65,17 @@ public:
 	 * occurred
 	 */
 	virtual void OnUringCompletion(int res) noexcept = 0;
+
+	/**
+	 * Like OnUringCompletion(int), but also passes the completion
+	 * flags (e.g. the buffer id selected with
+	 * IOSQE_BUFFER_SELECT).  The default implementation discards
+	 * them.
+	 */
+	virtual void OnUringCompletionFlags(int res, unsigned flags) noexcept {
+		(void)flags;
+		OnUringCompletion(res);
+	}
 };
 
 } // namespace Uring
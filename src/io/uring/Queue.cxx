@@ -3,6 +3,7 @@
 // author: Max Kellermann <max.kellermann@ionos.com>
 
 #include "Queue.hxx"
+#include "BufferRing.hxx"
 #include "CancellableOperation.hxx"
 #include "util/DeleteDisposer.hxx"
 
@@ -25,6 +26,17 @@ Queue::~Queue() noexcept
 	operations.clear_and_dispose(DeleteDisposer{});
 }
 
+BufferRing &
+Queue::GetReceiveBuffers()
+{
+	if (!receive_buffers)
+		receive_buffers = std::make_unique<BufferRing>(*this,
+							       RECEIVE_BUFFERS,
+							       RECEIVE_BUFFER_SIZE);
+
+	return *receive_buffers;
+}
+
 struct io_uring_sqe &
 Queue::RequireSubmitEntry()
 {
@@ -51,6 +63,54 @@ Queue::AddPending(struct io_uring_sqe &sqe,
 	io_uring_sqe_set_data(&sqe, c);
 }
 
+bool
+Queue::SubmitCancel(CancellableOperation &c) noexcept
+{
+	struct io_uring_sqe *s;
+	try {
+		/* this submits the queue to the kernel if it is
+		   full */
+		s = &RequireSubmitEntry();
+	} catch (...) {
+		return false;
+	}
+
+	io_uring_prep_cancel(s, &c, 0);
+	io_uring_sqe_set_data(s, nullptr);
+	io_uring_sqe_set_flags(s, IOSQE_CQE_SKIP_SUCCESS);
+	Submit();
+	return true;
+}
+
+void
+Queue::CancelOperation(Operation &operation) noexcept
+{
+	auto &c = *static_cast<CancellableOperation *>(operation.GetUringData());
+	if (c.IsCancelDeferred() || SubmitCancel(c))
+		return;
+
+	c.SetCancelDeferred(true);
+	++n_deferred_cancels;
+}
+
+void
+Queue::SubmitDeferredCancels() noexcept
+{
+	for (auto &c : operations) {
+		if (n_deferred_cancels == 0)
+			break;
+
+		if (!c.IsCancelDeferred())
+			continue;
+
+		if (!SubmitCancel(c))
+			break;
+
+		c.SetCancelDeferred(false);
+		--n_deferred_cancels;
+	}
+}
+
 inline void
 Queue::_DispatchOneCompletion(const struct io_uring_cqe &cqe) noexcept
 {
@@ -58,8 +118,11 @@ Queue::_DispatchOneCompletion(const struct io_uring_cqe &cqe) noexcept
 	if (data != nullptr) {
 		auto *c = (CancellableOperation *)data;
 		const bool more = cqe.flags & IORING_CQE_F_MORE;
-		c->OnUringCompletion(cqe.res, more);
+		c->OnUringCompletion(cqe.res, cqe.flags, more);
 		if (!more) {
+			if (c->IsCancelDeferred())
+				--n_deferred_cancels;
+
 			c->unlink();
 			delete c;
 		}
@@ -81,15 +144,22 @@ Queue::DispatchOneCompletion()
 		return false;
 
 	DispatchOneCompletion(*cqe);
+	if (n_deferred_cancels > 0) [[unlikely]]
+		SubmitDeferredCancels();
 	return true;
 }
 
 inline unsigned
 Queue::DispatchCompletions(struct io_uring_cqe &_cqe) noexcept
 {
-	return ring.VisitCompletions(&_cqe, [](const struct io_uring_cqe &cqe){
+	const unsigned n = ring.VisitCompletions(&_cqe, [this](const struct io_uring_cqe &cqe){
 		_DispatchOneCompletion(cqe);
 	});
+
+	if (n_deferred_cancels > 0) [[unlikely]]
+		SubmitDeferredCancels();
+
+	return n;
 }
 
 bool
@@ -100,6 +170,8 @@ Queue::WaitDispatchOneCompletion()
 		return false;
 
 	DispatchOneCompletion(*cqe);
+	if (n_deferred_cancels > 0) [[unlikely]]
+		SubmitDeferredCancels();
 	return true;
 }
 
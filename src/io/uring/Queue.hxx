@@ -7,10 +7,13 @@
 #include "Ring.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <memory>
+
 namespace Uring {
 
 class Operation;
 class CancellableOperation;
+class BufferRing;
 
 /**
  * High-level C++ wrapper for a `struct io_uring`.  It supports a
@@ -21,7 +24,26 @@ class Queue {
 
 	IntrusiveList<CancellableOperation> operations;
 
+	/**
+	 * The number of #operations whose cancellation is deferred
+	 * because the submit queue was full.
+	 */
+	std::size_t n_deferred_cancels = 0;
+
+	/**
+	 * See GetReceiveBuffers().
+	 */
+	std::unique_ptr<BufferRing> receive_buffers;
+
 public:
+	/**
+	 * The number of buffers in the ring returned by
+	 * GetReceiveBuffers(); must be a power of two.
+	 */
+	static constexpr unsigned RECEIVE_BUFFERS = 128;
+
+	static constexpr std::size_t RECEIVE_BUFFER_SIZE = 4096;
+
 	Queue(unsigned entries, unsigned flags);
 	Queue(unsigned entries, struct io_uring_params &params);
 	~Queue() noexcept;
@@ -38,6 +60,23 @@ public:
 		ring.SetMaxWorkers(bounded, unbounded);
 	}
 
+	int RegisterBufferRing(struct io_uring_buf_reg &reg) noexcept {
+		return ring.RegisterBufferRing(reg);
+	}
+
+	void UnregisterBufferRing(unsigned group) noexcept {
+		ring.UnregisterBufferRing(group);
+	}
+
+	/**
+	 * Obtain the #BufferRing shared by all receive operations on
+	 * this queue (see #MultiReceiveOperation).  It is created by
+	 * the first call.
+	 *
+	 * Throws on error.
+	 */
+	BufferRing &GetReceiveBuffers();
+
 	[[gnu::pure]]
 	bool HasOverflow() const noexcept {
 		return ring.HasOverflow();
@@ -55,6 +94,15 @@ public:
 	 */
 	struct io_uring_sqe &RequireSubmitEntry();
 
+	/**
+	 * Ask the kernel to cancel the given pending operation (with
+	 * io_uring_prep_cancel()); unlike Operation::CancelUring(),
+	 * the operation will still receive its final completion.  If
+	 * the submit queue is full, the request is submitted after
+	 * the next completions have been dispatched.
+	 */
+	void CancelOperation(Operation &operation) noexcept;
+
 	bool HasPending() const noexcept {
 		return !operations.empty();
 	}
@@ -125,7 +173,14 @@ public:
 	bool SubmitAndWaitDispatchCompletions(struct __kernel_timespec *timeout);
 
 private:
-	static void _DispatchOneCompletion(const struct io_uring_cqe &cqe) noexcept;
+	/**
+	 * @return false if the submit queue is full
+	 */
+	bool SubmitCancel(CancellableOperation &c) noexcept;
+
+	void SubmitDeferredCancels() noexcept;
+
+	void _DispatchOneCompletion(const struct io_uring_cqe &cqe) noexcept;
 	void DispatchOneCompletion(struct io_uring_cqe &cqe) noexcept;
 
 	/**
@@ -12,12 +12,23 @@ namespace Uring {
 void
 ReadOperation::Start(Queue &queue, FileDescriptor fd, off_t offset,
 		     std::size_t size, ReadHandler &_handler) noexcept
+{
+	Start(queue, fd, offset,
+	      std::make_unique_for_overwrite<std::byte[]>(size), size,
+	      _handler);
+}
+
+void
+ReadOperation::Start(Queue &queue, FileDescriptor fd, off_t offset,
+		     std::unique_ptr<std::byte[]> &&_buffer, std::size_t size,
+		     ReadHandler &_handler) noexcept
 {
 	assert(!buffer);
+	assert(_buffer);
 
 	handler = &_handler;
 
-	buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+	buffer = std::move(_buffer);
 
 	auto &s = queue.RequireSubmitEntry();
 
@@ -45,6 +45,16 @@ public:
 	void Start(Queue &queue, FileDescriptor fd, off_t offset,
 		   std::size_t size, ReadHandler &_handler) noexcept;
 
+	/**
+	 * Like Start(), but read into the given buffer (which must
+	 * be at least @a size bytes large) instead of allocating a new
+	 * one.  This allows recycling buffers which were passed to
+	 * ReadHandler::OnRead().
+	 */
+	void Start(Queue &queue, FileDescriptor fd, off_t offset,
+		   std::unique_ptr<std::byte[]> &&_buffer, std::size_t size,
+		   ReadHandler &_handler) noexcept;
+
 	/**
 	 * Cancel this operation.  This instance will be freed using
 	 * `delete` after the kernel has finished cancellation,
@@ -67,6 +67,22 @@ public:
 		SetMaxWorkers(values);
 	}
 
+	/**
+	 * Wrapper for io_uring_register_buf_ring().
+	 *
+	 * @return 0 on success or a negative errno value
+	 */
+	int RegisterBufferRing(struct io_uring_buf_reg &reg) noexcept {
+		return io_uring_register_buf_ring(&ring, &reg, 0);
+	}
+
+	/**
+	 * Wrapper for io_uring_unregister_buf_ring().
+	 */
+	void UnregisterBufferRing(unsigned group) noexcept {
+		io_uring_unregister_buf_ring(&ring, group);
+	}
+
 	/**
 	 * @return true if there are overflow entries waiting to be
 	 * flushed onto the CQ ring
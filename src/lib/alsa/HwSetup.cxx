@@ -160,7 +160,7 @@ SetupSampleFormat(snd_pcm_t *pcm, snd_pcm_hw_params_t *hwparams,
 
 HwResult
 SetupHw(snd_pcm_t *pcm,
-	unsigned buffer_time, unsigned period_time,
+	unsigned buffer_time, unsigned period_time, bool mmap,
 	AudioFormat &audio_format, PcmExport::Params &params)
 {
 	snd_pcm_hw_params_t *hwparams;
@@ -174,10 +174,23 @@ SetupHw(snd_pcm_t *pcm,
 	if (err < 0)
 		throw Alsa::MakeError(err, "snd_pcm_hw_params_any() failed");
 
-	err = snd_pcm_hw_params_set_access(pcm, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
-	if (err < 0)
-		throw Alsa::MakeError(err, "snd_pcm_hw_params_set_access() failed");
+	if (mmap) {
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+		if (err < 0) {
+			FmtDebug(alsa_output_domain,
+				 "mmap access not supported: {}",
+				 snd_strerror(-err));
+			mmap = false;
+		}
+	}
+
+	if (!mmap) {
+		err = snd_pcm_hw_params_set_access(pcm, hwparams,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
+		if (err < 0)
+			throw Alsa::MakeError(err, "snd_pcm_hw_params_set_access() failed");
+	}
 
 	err = SetupSampleFormat(pcm, hwparams,
 				audio_format.format, params);
@@ -267,6 +280,7 @@ SetupHw(snd_pcm_t *pcm,
 		throw Alsa::MakeError(err, "snd_pcm_hw_params() failed");
 
 	HwResult result;
+	result.mmap = mmap;
 
 	err = snd_pcm_hw_params_get_format(hwparams, &result.format);
 	if (err < 0)
@@ -15,6 +15,11 @@ namespace Alsa {
 struct HwResult {
 	snd_pcm_format_t format;
 	snd_pcm_uframes_t buffer_size, period_size;
+
+	/**
+	 * Was SND_PCM_ACCESS_MMAP_INTERLEAVED configured?
+	 */
+	bool mmap;
 };
 
 /**
@@ -22,13 +27,15 @@ struct HwResult {
  *
  * @param buffer_time the configured buffer time, or 0 if not configured
  * @param period_time the configured period time, or 0 if not configured
+ * @param mmap try SND_PCM_ACCESS_MMAP_INTERLEAVED (falls back to
+ * SND_PCM_ACCESS_RW_INTERLEAVED if the device doesn't support it)
  * @param audio_format an #AudioFormat to be configured (or modified)
  * by this function
  * @param params to be modified by this function
  */
 HwResult
 SetupHw(snd_pcm_t *pcm,
-	unsigned buffer_time, unsigned period_time,
+	unsigned buffer_time, unsigned period_time, bool mmap,
 	AudioFormat &audio_format, PcmExport::Params &params);
 
 } // namespace Alsa
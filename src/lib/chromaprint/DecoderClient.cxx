@@ -6,7 +6,15 @@
 #include "input/InputStream.hxx"
 #include "util/SpanCast.hxx"
 
-ChromaprintDecoderClient::ChromaprintDecoderClient() = default;
+/**
+ * libchromaprint downmixes and resamples all input to this format
+ * before calculating the fingerprint.
+ */
+static constexpr unsigned CHROMAPRINT_SAMPLE_RATE = 11025;
+
+ChromaprintDecoderClient::ChromaprintDecoderClient(bool _low_rate) noexcept
+	:low_rate(_low_rate) {}
+
 ChromaprintDecoderClient::~ChromaprintDecoderClient() noexcept = default;
 
 void
@@ -33,17 +41,30 @@ ChromaprintDecoderClient::Ready(AudioFormat audio_format, bool,
 	/* feed the first two minutes into libchromaprint */
 	remaining_bytes = audio_format.TimeToSize(std::chrono::minutes(2));
 
-	if (audio_format.format != SampleFormat::S16) {
-		const AudioFormat src_audio_format = audio_format;
-		audio_format.format = SampleFormat::S16;
+	const AudioFormat src_audio_format = audio_format;
+	audio_format.format = SampleFormat::S16;
 
-		convert = std::make_unique<PcmConvert>(src_audio_format,
-						       audio_format);
+	if (low_rate) {
+		/* do libchromaprint's downmixing and resampling
+		   in MPD's (faster) PCM library, so it has less
+		   data to process */
+		audio_format.channels = 1;
+		if (audio_format.sample_rate > CHROMAPRINT_SAMPLE_RATE)
+			audio_format.sample_rate = CHROMAPRINT_SAMPLE_RATE;
 	}
 
-	chromaprint.Start(audio_format.sample_rate, audio_format.channels);
-
 	ready = true;
+
+	try {
+		if (audio_format != src_audio_format)
+			convert = std::make_unique<PcmConvert>(src_audio_format,
+							       audio_format);
+
+		chromaprint.Start(audio_format.sample_rate,
+				  audio_format.channels);
+	} catch (...) {
+		error = std::current_exception();
+	}
 }
 
 DecoderCommand
@@ -53,6 +74,9 @@ ChromaprintDecoderClient::SubmitAudio(InputStream *,
 {
 	assert(ready);
 
+	if (error)
+		return DecoderCommand::STOP;
+
 	if (audio.size() > remaining_bytes)
 		remaining_bytes = 0;
 	else
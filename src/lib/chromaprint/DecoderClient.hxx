@@ -15,6 +15,13 @@
 class PcmConvert;
 
 class ChromaprintDecoderClient : public DecoderClient {
+	/**
+	 * Convert to mono at the sample rate libchromaprint works
+	 * with internally?  This makes decoding and feeding cheaper;
+	 * see Ready().
+	 */
+	const bool low_rate;
+
 	bool ready = false;
 
 	std::unique_ptr<PcmConvert> convert;
@@ -33,7 +40,7 @@ protected:
 public:
 	Mutex mutex;
 
-	ChromaprintDecoderClient();
+	explicit ChromaprintDecoderClient(bool _low_rate=false) noexcept;
 	~ChromaprintDecoderClient() noexcept;
 
 	bool IsReady() const noexcept {
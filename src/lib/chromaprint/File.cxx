@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "File.hxx"
+#include "DecoderClient.hxx"
+#include "decoder/DecoderAPI.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "fs/Path.hxx"
+
+namespace {
+
+class FileChromaprintDecoderClient final : public ChromaprintDecoderClient {
+	const std::atomic_bool &cancel;
+
+public:
+	explicit FileChromaprintDecoderClient(const std::atomic_bool &_cancel) noexcept
+		:ChromaprintDecoderClient(true), cancel(_cancel) {}
+
+	/* virtual methods from DecoderClient */
+	DecoderCommand GetCommand() noexcept override {
+		return cancel
+			? DecoderCommand::STOP
+			: ChromaprintDecoderClient::GetCommand();
+	}
+
+	InputStreamPtr OpenUri(std::string_view uri) override {
+		return InputStream::OpenReady(uri, mutex);
+	}
+};
+
+} // anonymous namespace
+
+std::string
+ChromaprintSongFile(Path path_fs, std::string_view suffix,
+		    const std::atomic_bool &cancel)
+{
+	FileChromaprintDecoderClient client{cancel};
+
+	/* this may fail for songs inside a container file; those
+	   are only supported by plugins implementing
+	   file_decode */
+	InputStreamPtr is;
+	try {
+		is = OpenLocalInputStream(path_fs, client.mutex);
+	} catch (...) {
+	}
+
+	try {
+		for (const auto *plugin : decoder_plugins_for_suffix(suffix)) {
+			if (cancel)
+				return {};
+
+			if (!plugin->SupportsSuffix(suffix))
+				continue;
+
+			if (plugin->file_decode != nullptr) {
+				plugin->FileDecode(client, path_fs);
+			} else if (plugin->stream_decode != nullptr && is) {
+				/* rewind the stream, so each plugin
+				   gets a fresh start */
+				try {
+					is->LockRewind();
+				} catch (...) {
+				}
+
+				plugin->StreamDecode(client, *is);
+			} else
+				continue;
+
+			if (client.IsReady())
+				break;
+		}
+	} catch (StopDecoder) {
+	}
+
+	if (cancel || !client.IsReady())
+		return {};
+
+	client.Finish();
+	return client.GetFingerprint();
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+class Path;
+
+/**
+ * Decode the first two minutes of the given local file and calculate
+ * its Chromaprint fingerprint.  The audio is converted to mono at a
+ * reduced sample rate first, which is cheaper than letting
+ * libchromaprint do it.  This is meant to be called from a
+ * low-priority background thread.
+ *
+ * Throws on error.
+ *
+ * @param suffix the filename suffix used to select the decoder plugin
+ * @param cancel if this becomes true, decoding is stopped as soon as
+ * possible
+ * @return the fingerprint or an empty string if the file could not
+ * be decoded (or decoding was canceled)
+ */
+std::string
+ChromaprintSongFile(Path path_fs, std::string_view suffix,
+		    const std::atomic_bool &cancel);
@@ -85,6 +85,18 @@ CurlGlobal::CurlGlobal(EventLoop &_loop)
 {
 	multi.SetSocketFunction(CurlSocket::SocketFunction, this);
 	multi.SetTimerFunction(TimerFunction, this);
+
+	/* allow concurrent requests to the same host to share one
+	   HTTP/2 connection (this is the default since CURL 7.62) */
+	multi.SetOption(CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+	/* all easy handles share this multi handle's connection
+	   cache (and DNS and TLS session caches); by default, its
+	   size depends on the number of easy handles, which is
+	   small for a sequence of short requests (e.g. WebDAV
+	   PROPFIND during database update), so idle connections
+	   would be closed too early */
+	multi.SetOption(CURLMOPT_MAXCONNECTS, 16L);
 }
 
 int
@@ -140,6 +152,22 @@ CurlGlobal::Remove(CurlRequest &r) noexcept
 	multi.Remove(r.Get());
 }
 
+/**
+ * Returns the number of new connections which were established for
+ * the given (finished) transfer; 0 means an existing connection was
+ * reused.
+ */
+[[gnu::pure]]
+static long
+GetNumConnects(CURL *easy) noexcept
+{
+	long n;
+	if (curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &n) != CURLE_OK)
+		return 0;
+
+	return n;
+}
+
 /**
  * Find a request by its CURL "easy" handle.
  */
@@ -164,6 +192,10 @@ CurlGlobal::ReadInfo() noexcept
 
 	while ((msg = multi.InfoRead()) != nullptr) {
 		if (msg->msg == CURLMSG_DONE) {
+			n_requests.fetch_add(1, std::memory_order_relaxed);
+			n_connections.fetch_add(GetNumConnects(msg->easy_handle),
+						std::memory_order_relaxed);
+
 			auto *request = ToRequest(msg->easy_handle);
 			if (request != nullptr)
 				request->Done(msg->data.result);
@@ -7,9 +7,26 @@
 #include "event/CoarseTimerEvent.hxx"
 #include "event/DeferEvent.hxx"
 
+#include <atomic>
+#include <cstdint>
+
 class CurlSocket;
 class CurlRequest;
 
+struct CurlStats {
+	/**
+	 * The number of finished requests.
+	 */
+	uint_least64_t requests;
+
+	/**
+	 * The number of connections which were established for
+	 * these requests; the difference to #requests is the number
+	 * of requests which have reused an existing connection.
+	 */
+	uint_least64_t connections;
+};
+
 /**
  * Manager for the global CURLM object.
  */
@@ -19,6 +36,12 @@ class CurlGlobal final {
 	DeferEvent defer_read_info;
 	CoarseTimerEvent timeout_event;
 
+	/**
+	 * Counters for GetStats().  They are updated by the I/O
+	 * thread and may be read by any thread.
+	 */
+	std::atomic<uint_least64_t> n_requests{0}, n_connections{0};
+
 public:
 	explicit CurlGlobal(EventLoop &_loop);
 
@@ -39,6 +62,16 @@ public:
 		SocketAction(CURL_SOCKET_TIMEOUT, 0);
 	}
 
+	/**
+	 * This method is thread-safe.
+	 */
+	CurlStats GetStats() const noexcept {
+		return {
+			n_requests.load(std::memory_order_relaxed),
+			n_connections.load(std::memory_order_relaxed),
+		};
+	}
+
 private:
 	/**
 	 * Check for finished HTTP responses.
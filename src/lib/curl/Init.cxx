@@ -29,6 +29,17 @@ CurlInit::CurlInit(EventLoop &event_loop)
 	instance = new CurlGlobal(event_loop);
 }
 
+bool
+CurlInit::GetStats(CurlStats &stats) noexcept
+{
+	const std::lock_guard protect{mutex};
+	if (instance == nullptr)
+		return false;
+
+	stats = instance->GetStats();
+	return true;
+}
+
 CurlInit::~CurlInit() noexcept
 {
 	const std::lock_guard protect{mutex};
@@ -8,6 +8,7 @@
 
 class EventLoop;
 class CurlGlobal;
+struct CurlStats;
 
 /**
  * This class performs one-time initialization of libCURL and creates
@@ -40,6 +41,14 @@ public:
 	const CurlGlobal *operator->() const noexcept {
 		return instance;
 	}
+
+	/**
+	 * Obtain the statistics of the #CurlGlobal instance (if one
+	 * exists).  This method is thread-safe.
+	 *
+	 * @return false if libCURL is not initialized
+	 */
+	static bool GetStats(CurlStats &stats) noexcept;
 };
 
 #endif
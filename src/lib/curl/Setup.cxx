@@ -18,6 +18,11 @@ Setup(CurlEasy &easy)
 	easy.SetNoSignal();
 	easy.SetConnectTimeout(std::chrono::seconds{10});
 	easy.SetOption(CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
+
+	/* if there is a pending connection to the same host, wait
+	   for it to find out whether it can be multiplexed (HTTP/2)
+	   instead of opening another one */
+	easy.TrySetOption(CURLOPT_PIPEWAIT, 1L);
 }
 
 } // namespace Curl
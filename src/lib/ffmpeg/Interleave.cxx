@@ -5,11 +5,13 @@
 #include "Buffer.hxx"
 #include "Error.hxx"
 #include "pcm/Interleave.hxx"
+#include "pcm/ChannelDefs.hxx"
 
 extern "C" {
 #include <libavutil/frame.h>
 }
 
+#include <algorithm>
 #include <cassert>
 #include <new> // for std::bad_alloc
 
@@ -54,4 +56,32 @@ InterleaveFrame(const AVFrame &frame, FfmpegBuffer &buffer)
 	return { output_buffer, (size_t)data_size };
 }
 
+std::size_t
+InterleavePlanarFrameTo(const AVFrame &frame, std::size_t offset,
+			std::span<std::byte> dest) noexcept
+{
+	const auto format = AVSampleFormat(frame.format);
+	assert(av_sample_fmt_is_planar(format));
+
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 25, 100)
+	const unsigned channels = frame.ch_layout.nb_channels;
+#else
+	const unsigned channels = frame.channels;
+#endif
+	assert(channels <= MAX_CHANNELS);
+	assert(offset <= std::size_t(frame.nb_samples));
+
+	const std::size_t sample_size = av_get_bytes_per_sample(format);
+	const std::size_t n_frames =
+		std::min(std::size_t(frame.nb_samples) - offset,
+			 dest.size() / (sample_size * channels));
+
+	const void *planes[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c)
+		planes[c] = frame.extended_data[c] + offset * sample_size;
+
+	PcmInterleave(dest.data(), {planes, channels}, n_frames, sample_size);
+	return n_frames;
+}
+
 } // namespace Ffmpeg
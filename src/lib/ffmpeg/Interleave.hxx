@@ -4,6 +4,7 @@
 #ifndef MPD_FFMPEG_INTERLEAVE_HXX
 #define MPD_FFMPEG_INTERLEAVE_HXX
 
+#include <cstddef>
 #include <span>
 
 struct AVFrame;
@@ -20,6 +21,20 @@ namespace Ffmpeg {
 std::span<const std::byte>
 InterleaveFrame(const AVFrame &frame, FfmpegBuffer &buffer);
 
+/**
+ * Interleave frames of the given non-empty planar #AVFrame directly
+ * into the given (caller-owned) buffer, e.g. memory obtained from
+ * DecoderClient::GetAudioBuffer().  This avoids the intermediate
+ * copy of InterleaveFrame().
+ *
+ * @param offset the number of PCM frames to skip at the beginning
+ * of the #AVFrame
+ * @return the number of PCM frames which were written
+ */
+std::size_t
+InterleavePlanarFrameTo(const AVFrame &frame, std::size_t offset,
+			std::span<std::byte> dest) noexcept;
+
 } // namespace Ffmpeg
 
 #endif
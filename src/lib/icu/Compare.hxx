@@ -4,6 +4,7 @@
 #ifndef MPD_ICU_COMPARE_HXX
 #define MPD_ICU_COMPARE_HXX
 
+#include "Canonicalize.hxx"
 #include "util/AllocatedString.hxx"
 
 #include <string_view>
@@ -69,6 +70,21 @@ public:
 	bool GetFoldCase() const noexcept {
 		return needle != nullptr && fold_case;
 	}
+
+	bool GetStripDiacritics() const noexcept {
+		return needle != nullptr && strip_diacritics;
+	}
+
+#ifdef HAVE_ICU_CANONICALIZE
+	/**
+	 * Returns the needle in canonical form, i.e. the result of
+	 * IcuCanonicalize().  Haystacks in the same form can be
+	 * compared with it byte by byte.
+	 */
+	const char *GetCanonicalNeedle() const noexcept {
+		return needle.c_str();
+	}
+#endif
 };
 
 #endif
@@ -140,6 +140,12 @@ public:
 		for (CT &i : list)
 			f(i);
 	}
+
+	template<typename P>
+	[[gnu::pure]]
+	bool AnyOf(P &&p) const noexcept {
+		return std::any_of(list.begin(), list.end(), std::forward<P>(p));
+	}
 };
 
 #endif
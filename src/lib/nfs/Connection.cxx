@@ -25,6 +25,19 @@ extern "C" {
 static constexpr Event::Duration NFS_MOUNT_TIMEOUT =
 	std::chrono::minutes(1);
 
+/**
+ * The maximum size of the directory information in one READDIRPLUS
+ * reply.  The libnfs default (8 kB) means that a listing with
+ * attributes needs one round trip for every few dozen entries.
+ */
+static constexpr uint32_t NFS_READDIR_DIRCOUNT = 64 * 1024;
+
+/**
+ * The maximum size of one READDIRPLUS reply including the
+ * attributes.  The server may reduce this.
+ */
+static constexpr uint32_t NFS_READDIR_MAXCOUNT = 1024 * 1024;
+
 inline void
 NfsConnection::CancellableCallback::Stat(nfs_context *ctx,
 					 const char *path)
@@ -127,7 +140,8 @@ NfsConnection::CancellableCallback::PrepareDestroyContext() noexcept
 	assert(IsCancelled());
 
 	if (close_fh != nullptr) {
-		connection.InternalClose(close_fh);
+		if (!connection.IsCloseScheduled(*this, close_fh))
+			connection.InternalClose(close_fh);
 		close_fh = nullptr;
 	}
 }
@@ -175,7 +189,10 @@ NfsConnection::CancellableCallback::Callback(int err, void *data) noexcept
 				auto *fh = (struct nfsfh *)data;
 				connection.Close(fh);
 			}
-		} else if (close_fh != nullptr)
+		} else if (close_fh != nullptr &&
+			   !connection.IsCloseScheduled(*this, close_fh))
+			/* this was the last pending operation on
+			   this file handle */
 			connection.DeferClose(close_fh);
 
 		connection.callbacks.Remove(*this);
@@ -223,6 +240,9 @@ NfsConnection::NfsConnection(EventLoop &_loop,
 	 server(_server), export_name(_export_name),
 	 context(_context)
 {
+	nfs_set_readdir_max_buffer_size(context,
+					NFS_READDIR_DIRCOUNT,
+					NFS_READDIR_MAXCOUNT);
 }
 
 NfsConnection::~NfsConnection() noexcept
@@ -447,6 +467,15 @@ NfsConnection::PrepareDestroyContext() noexcept
 		});
 }
 
+bool
+NfsConnection::IsCloseScheduled(const CancellableCallback &except,
+				 const struct nfsfh *fh) const noexcept
+{
+	return callbacks.AnyOf([&except, fh](const CancellableCallback &c){
+		return &c != &except && c.IsCancelled() && c.WillClose(fh);
+	});
+}
+
 inline void
 NfsConnection::DeferClose(struct nfsfh *fh) noexcept
 {
@@ -77,6 +77,14 @@ class NfsConnection {
 		void CancelAndScheduleClose(struct nfsfh *fh,
 					    DisposablePointer &&_dispose_value) noexcept;
 
+		/**
+		 * Will this (cancelled) operation close the given
+		 * file handle?
+		 */
+		bool WillClose(const struct nfsfh *fh) const noexcept {
+			return close_fh == fh;
+		}
+
 		/**
 		 * Called by NfsConnection::DestroyContext() right
 		 * before nfs_destroy_context().  This object is given
@@ -234,7 +242,9 @@ public:
 	 * Not thread-safe.
 	 *
 	 * @param fh if not nullptr, then close this NFS file handle
-	 * after cancellation completes
+	 * after cancellation completes; if several operations on the
+	 * same file handle are cancelled this way, it is closed after
+	 * the last one has completed
 	 * @param dispose_value an arbitrary value that will be
 	 * disposed of after cancellation completes
 	 */
@@ -254,6 +264,14 @@ protected:
 private:
 	void PrepareDestroyContext() noexcept;
 
+	/**
+	 * Is there another cancelled operation (other than the given
+	 * one) which will close the given file handle?
+	 */
+	[[gnu::pure]]
+	bool IsCloseScheduled(const CancellableCallback &except,
+			      const struct nfsfh *fh) const noexcept;
+
 	/**
 	 * Wrapper for nfs_close_async().
 	 */
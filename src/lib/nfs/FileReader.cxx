@@ -12,6 +12,7 @@
 
 #include <fmt/core.h>
 
+#include <algorithm> // for std::copy_n()
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
@@ -40,6 +41,7 @@ NfsFileReader::NfsFileReader(NfsConnection &_connection,
 NfsFileReader::~NfsFileReader() noexcept
 {
 	assert(state == State::INITIAL);
+	assert(reads.empty());
 }
 
 std::string
@@ -75,20 +77,16 @@ NfsFileReader::CancelOrClose() noexcept
 	assert(state != State::INITIAL &&
 	       state != State::DEFER);
 
-	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
-	else if (state > State::OPEN) {
+	if (state == State::IDLE) {
+		/* cancel all READ operations and defer the
+		   nfs_close_async() call until they have completed;
+		   if there are none, close immediately */
+		if (!CancelReads(fh))
+			connection->Close(fh);
+	} else if (state > State::OPEN) {
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
-		DisposablePointer dispose_value{};
-
-#ifdef LIBNFS_API_2
-		dispose_value = ToDeleteArray(read_buffer.release());
-#endif
-
-		connection->Cancel(*this, fh, std::move(dispose_value));
+		connection->Cancel(*this, fh, {});
 	} else if (state > State::MOUNT)
 		/* we don't have a file handle yet - just cancel the
 		   async operation */
@@ -143,34 +141,62 @@ NfsFileReader::Open(const char *uri)
 void
 NfsFileReader::Read(uint64_t offset, size_t size)
 {
-	assert(state == State::IDLE);
+	assert(CanRead());
 
+	auto &op = reads.emplace_back(*this, offset, size);
+
+	try {
 #ifdef LIBNFS_API_2
-	assert(!read_buffer);
-	// TOOD read into caller-provided buffer
-	read_buffer = std::make_unique_for_overwrite<std::byte[]>(size);
-	connection->Read(fh, offset, {read_buffer.get(), size}, *this);
+		// TOOD read into caller-provided buffer
+		op.buffer = std::make_unique_for_overwrite<std::byte[]>(size);
+		connection->Read(fh, offset, {op.buffer.get(), size}, op);
 #else
-	connection->Read(fh, offset, size, *this);
+		connection->Read(fh, offset, size, op);
 #endif
-
-	state = State::READ;
+	} catch (...) {
+		reads.pop_back();
+		throw;
+	}
 }
 
-void
-NfsFileReader::CancelRead() noexcept
+bool
+NfsFileReader::CancelReads(struct nfsfh *close_fh) noexcept
 {
-	if (state == State::READ) {
+	bool pending = false;
+
+	for (auto &op : reads) {
+		if (op.done)
+			/* already completed, nothing to cancel */
+			continue;
+
 		DisposablePointer dispose_value{};
 
 #ifdef LIBNFS_API_2
-		assert(read_buffer);
-		dispose_value = ToDeleteArray(read_buffer.release());
+		assert(op.buffer);
+		dispose_value = ToDeleteArray(op.buffer.release());
 #endif
 
-		connection->Cancel(*this, nullptr, std::move(dispose_value));
-		state = State::IDLE;
+		connection->Cancel(op, close_fh, std::move(dispose_value));
+		pending = true;
 	}
+
+	reads.clear();
+	return pending;
+}
+
+void
+NfsFileReader::CancelRead() noexcept
+{
+	CancelReads(nullptr);
+}
+
+uint64_t
+NfsFileReader::GetPendingReadSize() const noexcept
+{
+	uint64_t result = 0;
+	for (const auto &op : reads)
+		result += op.size;
+	return result;
 }
 
 void
@@ -242,22 +268,89 @@ NfsFileReader::StatCallback(const struct nfs_stat_64 *st) noexcept
 }
 
 inline void
-NfsFileReader::ReadCallback(std::size_t nbytes, const void *data) noexcept
+NfsFileReader::ReadCallback(ReadOperation &op, std::size_t nbytes,
+			    [[maybe_unused]] const void *data) noexcept
 {
-#ifdef LIBNFS_API_2
-	(void)data;
-
-	assert(read_buffer);
-	const auto buffer = std::move(read_buffer);
+	assert(!reads.empty());
+	assert(op.done);
+
+	op.nbytes = nbytes;
+
+	if (&op != &reads.front()) {
+		/* an earlier READ is still pending; keep the data
+		   until that one has completed */
+#ifndef LIBNFS_API_2
+		op.buffer = std::make_unique_for_overwrite<std::byte[]>(nbytes);
+		std::copy_n(static_cast<const std::byte *>(data), nbytes,
+			    op.buffer.get());
+#endif
+		return;
+	}
 
-	OnNfsFileRead({buffer.get(), nbytes});
+#ifdef LIBNFS_API_2
+	assert(op.buffer);
+	const auto buffer = std::move(op.buffer);
+	const std::span<const std::byte> src{buffer.get(), nbytes};
 #else
-	OnNfsFileRead({static_cast<const std::byte *>(data), nbytes});
+	const std::span<const std::byte> src{static_cast<const std::byte *>(data), nbytes};
 #endif
+
+	const bool short_read = nbytes < op.size;
+	reads.pop_front();
+
+	if (short_read)
+		/* the following READs would leave a gap */
+		CancelReads(nullptr);
+
+	OnNfsFileRead(src);
+
+	FlushReads();
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
+NfsFileReader::FlushReads() noexcept
+{
+	while (!reads.empty() && reads.front().done) {
+		auto &op = reads.front();
+		const bool short_read = op.nbytes < op.size;
+		const auto buffer = std::move(op.buffer);
+		const std::span<const std::byte> src{buffer.get(), op.nbytes};
+		reads.pop_front();
+
+		if (short_read)
+			CancelReads(nullptr);
+
+		OnNfsFileRead(src);
+	}
+}
+
+inline void
+NfsFileReader::ReadError(std::exception_ptr &&e) noexcept
+{
+	/* the other READs are useless now */
+	CancelReads(nullptr);
+
+	OnNfsFileError(std::move(e));
+}
+
+void
+NfsFileReader::ReadOperation::OnNfsCallback(unsigned status,
+					    void *data) noexcept
+{
+	done = true;
+	reader.ReadCallback(*this, static_cast<std::size_t>(status), data);
+}
+
+void
+NfsFileReader::ReadOperation::OnNfsError(std::exception_ptr &&e) noexcept
+{
+	done = true;
+	reader.ReadError(std::move(e));
+}
+
+void
+NfsFileReader::OnNfsCallback([[maybe_unused]] unsigned status,
+			     void *data) noexcept
 {
 	switch (std::exchange(state, State::IDLE)) {
 	case State::INITIAL:
@@ -273,10 +366,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data) noexcept
 	case State::STAT:
 		StatCallback((const struct nfs_stat_64 *)data);
 		break;
-
-	case State::READ:
-		ReadCallback(static_cast<std::size_t>(status), data);
-		break;
 	}
 }
 
@@ -300,10 +389,6 @@ NfsFileReader::OnNfsError(std::exception_ptr &&e) noexcept
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(e));
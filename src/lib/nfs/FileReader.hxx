@@ -11,13 +11,11 @@
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <list>
+#include <memory>
 #include <span>
 #include <string>
 
-#ifdef LIBNFS_API_2
-#include <memory>
-#endif
-
 struct nfsfh;
 struct nfs_stat_64;
 class NfsConnection;
@@ -37,10 +35,48 @@ class NfsFileReader : NfsLease, NfsCallback {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
+	/**
+	 * One READ call.  Each one is a separate #NfsCallback, so
+	 * several can be in flight at a time.
+	 */
+	class ReadOperation final : public NfsCallback {
+		NfsFileReader &reader;
+
+	public:
+		const uint64_t offset;
+		const std::size_t size;
+
+		/**
+		 * The destination buffer (libnfs API 2) or a copy of
+		 * the data of a READ which has completed before an
+		 * earlier one.
+		 */
+		std::unique_ptr<std::byte[]> buffer;
+
+		/**
+		 * The number of bytes received; only valid if
+		 * #done is set.
+		 */
+		std::size_t nbytes;
+
+		/**
+		 * Has this READ completed, waiting for earlier ones
+		 * to complete?
+		 */
+		bool done = false;
+
+		ReadOperation(NfsFileReader &_reader,
+			      uint64_t _offset, std::size_t _size) noexcept
+			:reader(_reader), offset(_offset), size(_size) {}
+
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) noexcept override;
+		void OnNfsError(std::exception_ptr &&e) noexcept override;
+	};
+
 	State state = State::INITIAL;
 
 	std::string server, export_name, path;
@@ -54,11 +90,17 @@ class NfsFileReader : NfsLease, NfsCallback {
 	 */
 	InjectEvent defer_open;
 
-#ifdef LIBNFS_API_2
-	std::unique_ptr<std::byte[]> read_buffer;
-#endif
+	/**
+	 * The pending READ calls, ordered by their offsets.
+	 */
+	std::list<ReadOperation> reads;
 
 public:
+	/**
+	 * The maximum number of concurrent Read() calls.
+	 */
+	static constexpr std::size_t MAX_READS = 8;
+
 	NfsFileReader() noexcept;
 	explicit NfsFileReader(NfsConnection &_connection,
 			       std::string_view _path) noexcept;
@@ -83,8 +125,12 @@ public:
 
 	/**
 	 * Attempt to read from the file.  This may only be done after
-	 * OnNfsFileOpen() has been called.  Only one read operation
-	 * may be performed at a time.
+	 * OnNfsFileOpen() has been called.  Up to #MAX_READS read
+	 * operations may be in flight at a time (see CanRead()), and
+	 * OnNfsFileRead() is invoked for them in the order of the
+	 * Read() calls.  If a read returns less than was requested,
+	 * all subsequent ones are cancelled (because they would leave
+	 * a gap).
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
@@ -94,17 +140,34 @@ public:
 	void Read(uint64_t offset, size_t size);
 
 	/**
-	 * Cancel the most recent Read() call.
+	 * Cancel all pending Read() calls.
 	 *
 	 * This method is not thread-safe and must be called from
 	 * within the I/O thread.
 	 */
 	void CancelRead() noexcept;
 
+	/**
+	 * Is the file open, with no Read() in flight?
+	 */
 	bool IsIdle() const noexcept {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
+	}
+
+	/**
+	 * May Read() be called now?
+	 */
+	bool CanRead() const noexcept {
+		return state == State::IDLE && reads.size() < MAX_READS;
 	}
 
+	/**
+	 * Returns the total number of bytes requested by pending
+	 * Read() calls.
+	 */
+	[[gnu::pure]]
+	uint64_t GetPendingReadSize() const noexcept;
+
 protected:
 	/**
 	 * The file has been opened successfully.  It is a regular
@@ -116,7 +179,8 @@ protected:
 	virtual void OnNfsFileOpen(uint64_t size) noexcept = 0;
 
 	/**
-	 * A Read() has completed successfully.
+	 * A Read() has completed successfully.  This method may call
+	 * Read() and CancelRead().
 	 *
 	 * This method will be called from within the I/O thread.
 	 */
@@ -136,9 +200,26 @@ private:
 	 */
 	void CancelOrClose() noexcept;
 
+	/**
+	 * Cancel and delete all #reads.
+	 *
+	 * @param close_fh if not nullptr, then close this file handle
+	 * after all of them have completed
+	 * @return true if at least one READ was still pending
+	 */
+	bool CancelReads(struct nfsfh *close_fh) noexcept;
+
 	void OpenCallback(nfsfh *_fh) noexcept;
 	void StatCallback(const struct nfs_stat_64 *st) noexcept;
-	void ReadCallback(std::size_t nbytes, const void *data) noexcept;
+	void ReadCallback(ReadOperation &op, std::size_t nbytes,
+			  const void *data) noexcept;
+	void ReadError(std::exception_ptr &&e) noexcept;
+
+	/**
+	 * Submit all completed #reads at the front of the list to
+	 * OnNfsFileRead().
+	 */
+	void FlushReads() noexcept;
 
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() noexcept final;
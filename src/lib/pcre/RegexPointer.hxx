@@ -46,4 +46,32 @@ public:
 
 		return match_data;
 	}
+
+	/**
+	 * Check whether the subject matches, without obtaining the
+	 * match positions.  Unlike Match(), this does not allocate a
+	 * match data block for each call; it reuses one per thread.
+	 */
+	[[gnu::pure]]
+	bool Test(std::string_view s) const noexcept {
+		/* a match data block for one pair of offsets is
+		   enough; pcre2_match() returns 0 if there are more
+		   captures than fit, which still means "match" */
+		struct ThreadMatchData {
+			pcre2_match_data_8 *const md =
+				pcre2_match_data_create_8(1, nullptr);
+
+			~ThreadMatchData() noexcept {
+				pcre2_match_data_free_8(md);
+			}
+		};
+
+		static thread_local ThreadMatchData tmd;
+		if (tmd.md == nullptr)
+			/* out of memory */
+			return Match(s);
+
+		return pcre2_match_8(re, (PCRE2_SPTR8)s.data(), s.size(),
+				     0, 0, tmd.md, nullptr) >= 0;
+	}
 };
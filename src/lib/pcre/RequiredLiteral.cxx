@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#include "RequiredLiteral.hxx"
+#include "util/CharUtil.hxx"
+
+namespace Pcre {
+
+/**
+ * Skip a character class.
+ *
+ * @param i the position after the opening bracket
+ * @return the position after the closing bracket or
+ * std::string_view::npos if there is none
+ */
+[[gnu::pure]]
+static std::size_t
+SkipCharacterClass(std::string_view pattern, std::size_t i) noexcept
+{
+	if (i < pattern.size() && pattern[i] == '^')
+		++i;
+
+	/* a closing bracket at the beginning is a literal */
+	if (i < pattern.size() && pattern[i] == ']')
+		++i;
+
+	while (i < pattern.size()) {
+		switch (pattern[i]) {
+		case '\\':
+			i += 2;
+			break;
+
+		case '[':
+			/* POSIX class like "[:alpha:]" */
+			if (i + 1 < pattern.size() && pattern[i + 1] == ':') {
+				const auto end = pattern.find(":]", i + 2);
+				if (end == pattern.npos)
+					return pattern.npos;
+				i = end + 2;
+			} else
+				++i;
+			break;
+
+		case ']':
+			return i + 1;
+
+		default:
+			++i;
+		}
+	}
+
+	return pattern.npos;
+}
+
+std::string
+FindRequiredLiteral(std::string_view pattern) noexcept
+{
+	/* alternatives make every literal optional, and inline
+	   options/verbs may change how literals match */
+	if (pattern.find('|') != pattern.npos ||
+	    pattern.find("(?") != pattern.npos ||
+	    pattern.find("(*") != pattern.npos)
+		return {};
+
+	std::string best, current;
+
+	const auto flush = [&best, &current]{
+		if (current.size() > best.size())
+			best = current;
+		current.clear();
+	};
+
+	/* every token which is not a literal flushes #current, so if
+	   it is not empty, the previous token was its last
+	   character */
+
+	for (std::size_t i = 0; i < pattern.size();) {
+		const char ch = pattern[i];
+
+		switch (ch) {
+		case '\\':
+			if (i + 1 >= pattern.size() ||
+			    IsAlphaNumericASCII(pattern[i + 1]) ||
+			    !IsASCII(pattern[i + 1])) {
+				/* an escape sequence with a special
+				   meaning; give up */
+				flush();
+				return best;
+			}
+
+			/* escaped punctuation is a literal */
+			current.push_back(pattern[i + 1]);
+			i += 2;
+			break;
+
+		case '?':
+		case '*':
+			/* the previous character is optional */
+			if (!current.empty())
+				current.pop_back();
+			flush();
+			++i;
+			break;
+
+		case '{':
+			/* a counted repetition; treat the previous
+			   character as optional */
+			if (!current.empty())
+				current.pop_back();
+			flush();
+
+			i = pattern.find('}', i);
+			if (i == pattern.npos)
+				return best;
+			++i;
+			break;
+
+		case '+':
+			/* the previous character is required, but
+			   what follows is not adjacent */
+			flush();
+			++i;
+			break;
+
+		case '[':
+			flush();
+			i = SkipCharacterClass(pattern, i + 1);
+			if (i == pattern.npos)
+				return best;
+			break;
+
+		case '.':
+		case '^':
+		case '$':
+			flush();
+			++i;
+			break;
+
+		case '(':
+		case ')':
+			/* groups may be optional; give up */
+			flush();
+			return best;
+
+		default:
+			if (!IsASCII(ch)) {
+				/* a quantifier may apply to a whole
+				   multi-byte character; give up */
+				flush();
+				return best;
+			}
+
+			current.push_back(ch);
+			++i;
+		}
+	}
+
+	flush();
+	return best;
+}
+
+} // namespace Pcre
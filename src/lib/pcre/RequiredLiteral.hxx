@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// Copyright CM4all GmbH
+// author: Max Kellermann <max.kellermann@ionos.com>
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Pcre {
+
+/**
+ * Find a literal string which is contained in every subject matched
+ * by the given (case-sensitive) pattern.  Searching this string
+ * (e.g. with memmem()) is a cheap way to reject most subjects before
+ * running the regular expression.
+ *
+ * The pattern is analyzed conservatively: it gives up on
+ * alternatives, inline options, groups and escape sequences.
+ *
+ * @return the longest literal found, or an empty string if none
+ */
+[[gnu::pure]]
+std::string
+FindRequiredLiteral(std::string_view pattern) noexcept;
+
+} // namespace Pcre
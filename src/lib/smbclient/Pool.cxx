@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Pool.hxx"
+
+SmbclientContextPool::~SmbclientContextPool() noexcept = default;
+
+SmbclientContextPool::Lease
+SmbclientContextPool::Get()
+{
+	{
+		const std::scoped_lock lock{mutex};
+		if (!idle.empty()) {
+			auto ctx = std::move(idle.front());
+			idle.pop_front();
+			--n_idle;
+			return {*this, std::move(ctx)};
+		}
+	}
+
+	/* creating a context may block; don't hold the mutex
+	   meanwhile */
+	return {*this, SmbclientContext::New()};
+}
+
+void
+SmbclientContextPool::Put(SmbclientContext &&ctx) noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		if (n_idle < MAX_IDLE) {
+			idle.emplace_front(std::move(ctx));
+			++n_idle;
+			return;
+		}
+	}
+
+	/* too many idle contexts: the Lease destructor frees this
+	   one */
+}
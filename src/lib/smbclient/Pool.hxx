@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Context.hxx"
+#include "thread/Mutex.hxx"
+
+#include <cstddef>
+#include <forward_list>
+
+/**
+ * A pool of #SmbclientContext instances.  A context may be used by
+ * only one thread at a time; this class hands out idle ones and
+ * creates new ones on demand, so libsmbclient calls from different
+ * threads can run in parallel, while the server connections (which
+ * libsmbclient caches per context) get reused.
+ *
+ * This class is thread-safe.
+ */
+class SmbclientContextPool {
+	/**
+	 * Keep no more than this number of idle contexts.
+	 */
+	static constexpr std::size_t MAX_IDLE = 8;
+
+	Mutex mutex;
+
+	std::forward_list<SmbclientContext> idle;
+
+	std::size_t n_idle = 0;
+
+public:
+	/**
+	 * Exclusive access to one #SmbclientContext, which is
+	 * returned to the pool by the destructor.
+	 */
+	class Lease {
+		SmbclientContextPool *pool;
+
+		SmbclientContext ctx;
+
+	public:
+		Lease(SmbclientContextPool &_pool,
+		      SmbclientContext &&_ctx) noexcept
+			:pool(&_pool), ctx(std::move(_ctx)) {}
+
+		~Lease() noexcept {
+			if (pool != nullptr)
+				pool->Put(std::move(ctx));
+		}
+
+		Lease(Lease &&src) noexcept
+			:pool(std::exchange(src.pool, nullptr)),
+			 ctx(std::move(src.ctx)) {}
+
+		Lease &operator=(const Lease &) = delete;
+
+		SmbclientContext &operator*() noexcept {
+			return ctx;
+		}
+
+		SmbclientContext *operator->() noexcept {
+			return &ctx;
+		}
+	};
+
+	SmbclientContextPool() noexcept = default;
+	~SmbclientContextPool() noexcept;
+
+	SmbclientContextPool(const SmbclientContextPool &) = delete;
+	SmbclientContextPool &operator=(const SmbclientContextPool &) = delete;
+
+	/**
+	 * Obtain an idle context or create a new one.
+	 *
+	 * Throws on error.
+	 */
+	Lease Get();
+
+private:
+	void Put(SmbclientContext &&ctx) noexcept;
+};
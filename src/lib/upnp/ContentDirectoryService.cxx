@@ -4,11 +4,14 @@
 #include "ContentDirectoryService.hxx"
 #include "Action.hxx"
 #include "Device.hxx"
+#include "util/CNumberParser.hxx"
 #include "util/IterableSplitString.hxx"
 #include "util/UriRelative.hxx"
 #include "util/UriUtil.hxx"
 #include "config.h"
 
+#include <stdexcept>
+
 using std::string_view_literals::operator""sv;
 
 ContentDirectoryService::ContentDirectoryService(const UPnPDevice &device,
@@ -45,3 +48,17 @@ ContentDirectoryService::getSearchCapabilities(UpnpClient_Handle hdl) const
 		result.emplace_front(i);
 	return result;
 }
+
+unsigned
+ContentDirectoryService::getSystemUpdateID(UpnpClient_Handle hdl) const
+{
+	const auto response = UpnpSendAction(hdl, m_actionURL.c_str(),
+					     "GetSystemUpdateID", m_serviceType.c_str(),
+					     {});
+
+	const char *s = response.GetValue("Id");
+	if (s == nullptr)
+		throw std::runtime_error("No Id in GetSystemUpdateID response");
+
+	return ParseUnsigned(s);
+}
@@ -92,6 +92,15 @@ public:
 	 */
 	std::forward_list<std::string> getSearchCapabilities(UpnpClient_Handle handle) const;
 
+	/**
+	 * Retrieve the "SystemUpdateID" state variable, which the
+	 * server increments whenever any object changes.
+	 *
+	 * Throws on error (e.g. if the server does not implement
+	 * this action).
+	 */
+	unsigned getSystemUpdateID(UpnpClient_Handle handle) const;
+
 	[[gnu::pure]]
 	std::string GetURI() const noexcept {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
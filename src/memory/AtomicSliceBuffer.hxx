@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "HugeArray.hxx"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/**
+ * A lock-free variant of #SliceBuffer.  Free() may be called by any
+ * number of threads concurrently, but Allocate() must only be called
+ * by one thread at a time.  This restriction makes the "available"
+ * list (a Treiber stack) immune to the ABA problem: no other thread
+ * can pop and re-push the first slice while Allocate() is trying to
+ * pop it.
+ */
+template<typename T>
+class AtomicSliceBuffer {
+	union Slice {
+		Slice *next;
+
+		T value;
+	};
+
+	HugeArray<Slice> buffer;
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.
+	 *
+	 * Only accessed by Allocate() and DiscardMemory().
+	 */
+	unsigned n_initialized = 0;
+
+	/**
+	 * The number of slices currently allocated.
+	 */
+	std::atomic<unsigned> n_allocated{0};
+
+	/**
+	 * Pointer to the first free element in the chain.
+	 */
+	std::atomic<Slice *> available{nullptr};
+
+public:
+	explicit AtomicSliceBuffer(unsigned _count)
+		:buffer(_count) {
+		buffer.ForkCow(false);
+	}
+
+	~AtomicSliceBuffer() noexcept {
+		/* all slices must be freed explicitly, and this
+		   assertion checks for leaks */
+		assert(n_allocated == 0);
+	}
+
+	AtomicSliceBuffer(const AtomicSliceBuffer &other) = delete;
+	AtomicSliceBuffer &operator=(const AtomicSliceBuffer &other) = delete;
+
+	unsigned GetCapacity() const noexcept {
+		return buffer.size();
+	}
+
+	unsigned GetAllocatedCount() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed) == 0;
+	}
+
+	bool IsFull() const noexcept {
+		return n_allocated.load(std::memory_order_relaxed) == buffer.size();
+	}
+
+	/**
+	 * Returns the number of slices which have been touched since
+	 * the last DiscardMemory() call, i.e. the number of slices
+	 * which (may) occupy physical memory.
+	 *
+	 * Only the thread which calls Allocate() may call this.
+	 */
+	unsigned GetInitializedCount() const noexcept {
+		return n_initialized;
+	}
+
+	/**
+	 * Are there freed slices which Allocate() can reuse without
+	 * initializing a new one?
+	 */
+	bool HasAvailable() const noexcept {
+		return available.load(std::memory_order_relaxed) != nullptr;
+	}
+
+	/**
+	 * Returns the position of the given (allocated) object within
+	 * this buffer.
+	 */
+	[[gnu::pure]]
+	std::size_t GetIndex(const T *value) const noexcept {
+		const Slice *slice = reinterpret_cast<const Slice *>(value);
+		assert(slice >= &buffer.front() && slice <= &buffer.back());
+
+		return slice - &buffer.front();
+	}
+
+	void SetName(const char *name) noexcept {
+		buffer.SetName(name);
+	}
+
+	void PopulateMemory() noexcept {
+		buffer.Populate();
+	}
+
+	bool LockMemory() noexcept {
+		return buffer.Lock();
+	}
+
+	void UnlockMemory() noexcept {
+		buffer.Unlock();
+	}
+
+	/**
+	 * This method is not thread-safe; it may only be called
+	 * while no other thread accesses this object.
+	 */
+	void DiscardMemory() noexcept {
+		assert(empty());
+
+		n_initialized = 0;
+		buffer.Discard();
+		available.store(nullptr, std::memory_order_relaxed);
+	}
+
+	template<typename... Args>
+	T *Allocate(Args&&... args) {
+		assert(n_initialized <= buffer.size());
+
+		/* pop a slice from the "available" list; its "next"
+		   field cannot change meanwhile, because only
+		   Allocate() removes slices from the list */
+		Slice *slice = available.load(std::memory_order_acquire);
+		while (slice != nullptr &&
+		       !available.compare_exchange_weak(slice, slice->next,
+							std::memory_order_acquire,
+							std::memory_order_acquire)) {}
+
+		if (slice == nullptr) {
+			if (n_initialized == buffer.size())
+				/* out of (internal) memory, buffer is
+				   full */
+				return nullptr;
+
+			slice = &buffer[n_initialized++];
+		}
+
+		++n_allocated;
+
+		/* construct the object */
+		return ::new((void *)&slice->value) T(std::forward<Args>(args)...);
+	}
+
+	void Free(T *value) noexcept {
+		assert(n_allocated > 0);
+
+		Slice *slice = reinterpret_cast<Slice *>(value);
+		assert(slice >= &buffer.front() && slice <= &buffer.back());
+
+		/* destruct the object */
+		value->~T();
+
+		/* push the slice to the "available" list; the release
+		   makes the destructor's writes visible to the next
+		   Allocate() call */
+		slice->next = available.load(std::memory_order_relaxed);
+		while (!available.compare_exchange_weak(slice->next, slice,
+							std::memory_order_release,
+							std::memory_order_relaxed)) {}
+
+		--n_allocated;
+	}
+};
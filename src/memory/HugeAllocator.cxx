@@ -16,8 +16,14 @@ AlignToPageSize(std::span<std::byte> p) noexcept
 }
 
 std::span<std::byte>
-HugeAllocate(size_t size)
+HugeAllocate(size_t size, bool hugetlb)
 {
+	if (hugetlb) {
+		const std::size_t huge_size = AlignToHugePageSize(size);
+		if (auto *p = AllocateHugeTlbPages(huge_size))
+			return {p, huge_size};
+	}
+
 	size = AlignToPageSize(size);
 
 	const std::span<std::byte> p{AllocatePages(size), size};
@@ -56,10 +62,22 @@ HugeDiscard(std::span<std::byte> p) noexcept
 	DiscardPages(AlignToPageSize(p));
 }
 
+bool
+HugeLock(std::span<std::byte> p) noexcept
+{
+	return LockPages(AlignToPageSize(p));
+}
+
+void
+HugeUnlock(std::span<std::byte> p) noexcept
+{
+	UnlockPages(AlignToPageSize(p));
+}
+
 #elif defined(_WIN32)
 
 std::span<std::byte>
-HugeAllocate(size_t size)
+HugeAllocate(size_t size, bool)
 {
 	// TODO: use MEM_LARGE_PAGES
 	void *p = VirtualAlloc(nullptr, size,
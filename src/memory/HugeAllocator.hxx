@@ -15,12 +15,16 @@
  *
  * Throws std::bad_alloc on error
  *
+ * @param hugetlb try to allocate explicit (pre-reserved) huge pages
+ * first; if there are not enough, falls back to regular pages with
+ * transparent huge pages enabled
  * @returns the allocated buffer with a size which may be rounded up
- * (to the next page size), so callers can take advantage of this
- * allocation overhead
+ * (to the next page size or huge page size), so callers can take
+ * advantage of this allocation overhead; the whole buffer must be
+ * passed to HugeFree()
  */
 std::span<std::byte>
-HugeAllocate(size_t size);
+HugeAllocate(size_t size, bool hugetlb=false);
 
 /**
  * @param p an allocation returned by HugeAllocate()
@@ -60,11 +64,24 @@ HugePopulate(std::span<std::byte> p) noexcept;
 void
 HugeDiscard(std::span<std::byte> p) noexcept;
 
+/**
+ * Lock the allocation into RAM so it never gets paged out.  This
+ * faults in all pages.  Before calling HugeDiscard(), the allocation
+ * must be unlocked with HugeUnlock().
+ *
+ * @return true on success, false on error (with errno set)
+ */
+bool
+HugeLock(std::span<std::byte> p) noexcept;
+
+void
+HugeUnlock(std::span<std::byte> p) noexcept;
+
 #elif defined(_WIN32)
 #include <memoryapi.h>
 
 std::span<std::byte>
-HugeAllocate(size_t size);
+HugeAllocate(size_t size, bool hugetlb=false);
 
 static inline void
 HugeFree(std::span<std::byte> p) noexcept
@@ -94,6 +111,18 @@ HugeDiscard(std::span<std::byte> p) noexcept
 	VirtualAlloc(p.data(), p.size(), MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline bool
+HugeLock(std::span<std::byte> p) noexcept
+{
+	return VirtualLock(p.data(), p.size());
+}
+
+static inline void
+HugeUnlock(std::span<std::byte> p) noexcept
+{
+	VirtualUnlock(p.data(), p.size());
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -101,7 +130,7 @@ HugeDiscard(std::span<std::byte> p) noexcept
 #include <cstdint>
 
 static inline std::span<std::byte>
-HugeAllocate(size_t size)
+HugeAllocate(size_t size, bool=false)
 {
 	return {new std::byte[size], size};
 }
@@ -132,4 +161,15 @@ HugeDiscard(std::span<std::byte>) noexcept
 {
 }
 
+static inline bool
+HugeLock(std::span<std::byte>) noexcept
+{
+	return false;
+}
+
+static inline void
+HugeUnlock(std::span<std::byte>) noexcept
+{
+}
+
 #endif
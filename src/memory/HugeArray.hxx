@@ -29,8 +29,13 @@ public:
 
 	constexpr HugeArray() noexcept = default;
 
-	explicit HugeArray(size_type _size)
-		:buffer(FromBytesFloor<value_type>(HugeAllocate(sizeof(value_type) * _size))) {}
+	/**
+	 * @param hugetlb try to use explicit huge pages, see
+	 * HugeAllocate()
+	 */
+	explicit HugeArray(size_type _size, bool hugetlb=false)
+		:buffer(FromBytesFloor<value_type>(HugeAllocate(sizeof(value_type) * _size,
+								hugetlb))) {}
 
 	constexpr HugeArray(HugeArray &&other) noexcept
 		:buffer(std::exchange(other.buffer, nullptr)) {}
@@ -63,6 +68,14 @@ public:
 		HugeDiscard(std::as_writable_bytes(buffer));
 	}
 
+	bool Lock() noexcept {
+		return HugeLock(std::as_writable_bytes(buffer));
+	}
+
+	void Unlock() noexcept {
+		HugeUnlock(std::as_writable_bytes(buffer));
+	}
+
 	constexpr bool operator==(std::nullptr_t) const noexcept {
 		return buffer == nullptr;
 	}
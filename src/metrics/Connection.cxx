@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Connection.hxx"
+#include "Server.hxx"
+#include "Export.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/Domain.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringSplit.hxx"
+#include "Log.hxx"
+
+#include <fmt/core.h>
+
+#include <cassert>
+
+using std::string_view_literals::operator""sv;
+
+static constexpr Domain metrics_domain("metrics");
+
+/**
+ * Clients which have not sent a complete request after this
+ * duration (or have not received the whole response) are
+ * disconnected.
+ */
+static constexpr Event::Duration METRICS_TIMEOUT = std::chrono::seconds{10};
+
+MetricsConnection::MetricsConnection(MetricsServer &_server,
+				     UniqueSocketDescriptor fd) noexcept
+	:FullyBufferedSocket(fd.Release(), _server.GetEventLoop(),
+			     16384, 4 * 1024 * 1024),
+	 server(_server),
+	 close_event(_server.GetEventLoop(), BIND_THIS_METHOD(Close)),
+	 timeout_event(_server.GetEventLoop(), BIND_THIS_METHOD(OnTimeout))
+{
+	timeout_event.Schedule(METRICS_TIMEOUT);
+}
+
+MetricsConnection::~MetricsConnection() noexcept
+{
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+void
+MetricsConnection::Close() noexcept
+{
+	server.Remove(*this);
+}
+
+inline bool
+MetricsConnection::HandleLine(std::string_view line) noexcept
+{
+	assert(state != State::RESPONSE);
+
+	if (state == State::REQUEST) {
+		if (!SkipPrefix(line, "GET "sv))
+			/* only GET is supported */
+			return false;
+
+		const auto [uri, rest] = Split(line, ' ');
+		const auto path = Split(uri, '?').first;
+		found = path == "/metrics"sv || path == "/"sv;
+
+		if (!rest.starts_with("HTTP/"sv))
+			/* HTTP/0.9 without request headers is not
+			   supported */
+			return false;
+
+		state = State::HEADERS;
+	} else if (line.empty()) {
+		/* empty line: request is finished */
+		state = State::RESPONSE;
+	}
+
+	return true;
+}
+
+bool
+MetricsConnection::SendResponse() noexcept
+{
+	assert(state == State::RESPONSE);
+
+	std::string body;
+	const char *status;
+
+	if (found) {
+		body = ExportMetrics(server.GetInstance());
+		status = "200 OK";
+	} else {
+		body = "Not Found\n";
+		status = "404 Not Found";
+	}
+
+	const auto header =
+		fmt::format("HTTP/1.1 {}\r\n"
+			    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			    "Content-Length: {}\r\n"
+			    "Connection: close\r\n"
+			    "\r\n",
+			    status, body.size());
+
+	return Write(header.data(), header.size()) &&
+		Write(body.data(), body.size());
+}
+
+void
+MetricsConnection::OnTimeout() noexcept
+{
+	Close();
+}
+
+BufferedSocket::InputResult
+MetricsConnection::OnSocketInput(std::span<std::byte> _src) noexcept
+{
+	if (state == State::RESPONSE)
+		/* ignore pipelined requests */
+		return InputResult::PAUSE;
+
+	const auto src = ToStringView(_src);
+	auto [line, rest] = Split(src, '\n');
+	if (rest.data() == nullptr)
+		return InputResult::MORE;
+
+	ConsumeInput(line.size() + 1);
+
+	if (line.ends_with('\r'))
+		line.remove_suffix(1);
+
+	if (!HandleLine(line)) {
+		LogDebug(metrics_domain, "malformed request");
+		Close();
+		return InputResult::CLOSED;
+	}
+
+	if (state == State::RESPONSE) {
+		if (!SendResponse())
+			return InputResult::CLOSED;
+
+		return InputResult::PAUSE;
+	}
+
+	return InputResult::AGAIN;
+}
+
+void
+MetricsConnection::OnSocketError(std::exception_ptr ep) noexcept
+{
+	FmtError(metrics_domain, "Metrics connection failed: {}", ep);
+	Close();
+}
+
+void
+MetricsConnection::OnSocketClosed() noexcept
+{
+	Close();
+}
+
+void
+MetricsConnection::OnSocketOutputEmpty() noexcept
+{
+	if (state == State::RESPONSE)
+		close_event.Schedule();
+}
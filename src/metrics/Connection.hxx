@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/FullyBufferedSocket.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <string_view>
+
+class UniqueSocketDescriptor;
+class MetricsServer;
+
+/**
+ * One HTTP connection to the #MetricsServer.  It reads one request,
+ * sends the response and closes the connection.
+ */
+class MetricsConnection final
+	: FullyBufferedSocket,
+	  public IntrusiveListHook<>
+{
+	MetricsServer &server;
+
+	/**
+	 * Closes the connection after the response has been sent
+	 * (OnSocketOutputEmpty() must not do that by itself).
+	 */
+	DeferEvent close_event;
+
+	/**
+	 * Closes the connection if the client does not send a
+	 * complete request in time.
+	 */
+	CoarseTimerEvent timeout_event;
+
+	enum class State {
+		/** reading the request line */
+		REQUEST,
+
+		/** reading the request headers */
+		HEADERS,
+
+		/** sending the HTTP response */
+		RESPONSE,
+	} state = State::REQUEST;
+
+	/**
+	 * Was the "/metrics" page requested?  If not, a "404 Not
+	 * Found" response is sent.
+	 */
+	bool found;
+
+public:
+	MetricsConnection(MetricsServer &_server,
+			  UniqueSocketDescriptor fd) noexcept;
+	~MetricsConnection() noexcept;
+
+private:
+	/**
+	 * Close the socket and delete this object.
+	 */
+	void Close() noexcept;
+
+	/**
+	 * @return false if the request is malformed
+	 */
+	bool HandleLine(std::string_view line) noexcept;
+
+	/**
+	 * @return false if the connection has been closed
+	 */
+	bool SendResponse() noexcept;
+
+	void OnTimeout() noexcept;
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(std::span<std::byte> src) noexcept override;
+	void OnSocketError(std::exception_ptr ep) noexcept override;
+	void OnSocketClosed() noexcept override;
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputEmpty() noexcept override;
+};
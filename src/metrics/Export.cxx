@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Export.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "client/List.hxx"
+#include "command/CommandStats.hxx"
+#include "decoder/Stats.hxx"
+#include "input/cache/Manager.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Control.hxx"
+#include "output/Stats.hxx"
+#include "player/Control.hxx"
+#include "db/Features.hxx" // for ENABLE_DATABASE
+
+#ifdef ENABLE_DATABASE
+#include "db/update/Service.hxx"
+#endif
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+using Buffer = fmt::memory_buffer;
+using FloatSeconds = std::chrono::duration<double>;
+
+/**
+ * Escape a label value: backslash, double quote and line feed must
+ * be escaped with a backslash.
+ */
+static std::string
+EscapeLabel(std::string_view value) noexcept
+{
+	std::string result;
+	result.reserve(value.size());
+
+	for (const char ch : value) {
+		switch (ch) {
+		case '\\':
+		case '"':
+			result.push_back('\\');
+			result.push_back(ch);
+			break;
+
+		case '\n':
+			result.append("\\n");
+			break;
+
+		default:
+			result.push_back(ch);
+		}
+	}
+
+	return result;
+}
+
+static void
+Family(Buffer &b, std::string_view name, std::string_view type,
+       std::string_view help) noexcept
+{
+	fmt::format_to(std::back_inserter(b),
+		       "# HELP {} {}\n"
+		       "# TYPE {} {}\n",
+		       name, help, name, type);
+}
+
+/**
+ * Format a #DurationHistogram as a Prometheus histogram (with
+ * cumulative buckets and seconds as unit).
+ *
+ * @param labels a comma-separated list of labels (without braces)
+ * or an empty string
+ */
+template<std::size_t N, const std::array<std::chrono::microseconds, N> &LIMITS>
+static void
+Histogram(Buffer &b, std::string_view name, std::string_view labels,
+	  const DurationHistogram<N, LIMITS> &histogram) noexcept
+{
+	const std::string_view comma = labels.empty() ? "" : ",";
+
+	uint_least64_t count = 0;
+	for (std::size_t i = 0; i < LIMITS.size(); ++i) {
+		count += histogram.counts[i];
+		fmt::format_to(std::back_inserter(b),
+			       "{}_bucket{{{}{}le=\"{}\"}} {}\n",
+			       name, labels, comma,
+			       FloatSeconds{LIMITS[i]}.count(), count);
+	}
+
+	fmt::format_to(std::back_inserter(b),
+		       "{}_bucket{{{}{}le=\"+Inf\"}} {}\n",
+		       name, labels, comma, histogram.calls);
+
+	const std::string braced = labels.empty()
+		? std::string{}
+		: fmt::format("{{{}}}", labels);
+
+	fmt::format_to(std::back_inserter(b),
+		       "{}_sum{} {}\n"
+		       "{}_count{} {}\n",
+		       name, braced, FloatSeconds{histogram.total}.count(),
+		       name, braced, histogram.calls);
+}
+
+struct PartitionSnapshot {
+	std::string label;
+	DecoderStats decoder;
+	PlayerBufferStats buffer;
+};
+
+struct OutputSnapshot {
+	std::string label;
+	AudioOutputStats stats;
+};
+
+static void
+ExportPartitions(Buffer &b, Instance &instance)
+{
+	std::vector<PartitionSnapshot> partitions;
+	std::vector<OutputSnapshot> outputs;
+
+	for (const auto &partition : instance.partitions) {
+		const auto partition_label = EscapeLabel(partition.name);
+
+		partitions.push_back({
+			fmt::format("partition=\"{}\"", partition_label),
+			partition.pc.LockGetDecoderStats(),
+			partition.pc.LockGetBufferStats(),
+		});
+
+		for (unsigned i = 0, n = partition.outputs.Size(); i != n; ++i) {
+			const auto &ao = partition.outputs.Get(i);
+			outputs.push_back({
+				fmt::format("partition=\"{}\",output=\"{}\"",
+					    partition_label,
+					    EscapeLabel(ao.GetName())),
+				ao.LockGetStats(),
+			});
+		}
+	}
+
+	Family(b, "mpd_decoder_realtime_factor", "gauge",
+	       "Duration of the decoded audio divided by the decoding time for the current song (0 if unknown)");
+	for (const auto &p : partitions)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_decoder_realtime_factor{{{}}} {}\n",
+			       p.label, p.decoder.GetRealtimeFactor());
+
+	Family(b, "mpd_decoder_underruns", "gauge",
+	       "Chunks pushed to an empty pipe during the current song");
+	for (const auto &p : partitions)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_decoder_underruns{{{}}} {}\n",
+			       p.label, p.decoder.underruns);
+
+	Family(b, "mpd_buffer_chunks", "gauge",
+	       "Total number of audio buffer chunks");
+	for (const auto &p : partitions)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_buffer_chunks{{{}}} {}\n",
+			       p.label, p.buffer.chunks);
+
+	Family(b, "mpd_buffer_chunks_used", "gauge",
+	       "Audio buffer chunks which are currently in use");
+	for (const auto &p : partitions)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_buffer_chunks_used{{{}}} {}\n",
+			       p.label, p.buffer.chunks_used);
+
+	Family(b, "mpd_buffer_chunks_borrowed", "gauge",
+	       "Audio buffer chunks borrowed from the shared pool");
+	for (const auto &p : partitions)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_buffer_chunks_borrowed{{{}}} {}\n",
+			       p.label, p.buffer.chunks_borrowed);
+
+	Family(b, "mpd_output_xruns_total", "counter",
+	       "Buffer underruns reported by the output device");
+	for (const auto &o : outputs)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_output_xruns_total{{{}}} {}\n",
+			       o.label, o.stats.xruns);
+
+	Family(b, "mpd_output_recoveries_total", "counter",
+	       "Recoveries from output device errors");
+	for (const auto &o : outputs)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_output_recoveries_total{{{}}} {}\n",
+			       o.label, o.stats.recoveries);
+
+	Family(b, "mpd_output_delay_seconds", "gauge",
+	       "The most recent delay reported by the output");
+	for (const auto &o : outputs)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_output_delay_seconds{{{}}} {}\n",
+			       o.label, FloatSeconds{o.stats.delay}.count());
+
+	Family(b, "mpd_output_pipe_lag_seconds", "gauge",
+	       "Duration of the audio data in the pipe which the output has not played yet");
+	for (const auto &o : outputs)
+		fmt::format_to(std::back_inserter(b),
+			       "mpd_output_pipe_lag_seconds{{{}}} {}\n",
+			       o.label, FloatSeconds{o.stats.pipe_lag}.count());
+
+	Family(b, "mpd_output_play_duration_seconds", "histogram",
+	       "Duration of AudioOutput::Play() calls");
+	for (const auto &o : outputs)
+		Histogram(b, "mpd_output_play_duration_seconds", o.label,
+			  o.stats.play);
+
+	Family(b, "mpd_output_filter_duration_seconds", "histogram",
+	       "Duration of filter chain runs");
+	for (const auto &o : outputs)
+		Histogram(b, "mpd_output_filter_duration_seconds", o.label,
+			  o.stats.filter);
+
+	Family(b, "mpd_output_pipe_latency_seconds", "histogram",
+	       "Time from the decoder's submission of a chunk until it is played");
+	for (const auto &o : outputs)
+		Histogram(b, "mpd_output_pipe_latency_seconds", o.label,
+			  o.stats.residency);
+}
+
+static void
+ExportCommands(Buffer &b)
+{
+	Family(b, "mpd_command_duration_seconds", "histogram",
+	       "Duration of protocol command handlers");
+	ForEachCommandStats([&b](const char *name,
+				 const CommandDurationHistogram &duration){
+		Histogram(b, "mpd_command_duration_seconds",
+			  fmt::format("command=\"{}\"", name),
+			  duration);
+	});
+}
+
+static void
+ExportInputCache(Buffer &b, const InputCacheManager &cache)
+{
+	const auto stats = cache.GetStats();
+
+	fmt::format_to(std::back_inserter(b),
+		       "# HELP mpd_input_cache_items Files in the input cache\n"
+		       "# TYPE mpd_input_cache_items gauge\n"
+		       "mpd_input_cache_items {}\n"
+		       "# HELP mpd_input_cache_bytes Size of the files in the input cache\n"
+		       "# TYPE mpd_input_cache_bytes gauge\n"
+		       "mpd_input_cache_bytes {}\n"
+		       "# HELP mpd_input_cache_max_bytes Configured size of the input cache\n"
+		       "# TYPE mpd_input_cache_max_bytes gauge\n"
+		       "mpd_input_cache_max_bytes {}\n"
+		       "# HELP mpd_input_cache_hits_total Lookups served by a cached file\n"
+		       "# TYPE mpd_input_cache_hits_total counter\n"
+		       "mpd_input_cache_hits_total {}\n"
+		       "# HELP mpd_input_cache_misses_total Lookups which added a new file to the cache\n"
+		       "# TYPE mpd_input_cache_misses_total counter\n"
+		       "mpd_input_cache_misses_total {}\n",
+		       stats.items, stats.bytes, stats.max_bytes,
+		       stats.hits, stats.misses);
+}
+
+#ifdef ENABLE_DATABASE
+
+static void
+ExportUpdate(Buffer &b, const UpdateService &update)
+{
+	const auto &stats = update.GetStats();
+
+	fmt::format_to(std::back_inserter(b),
+		       "# HELP mpd_update_running Is a database update running?\n"
+		       "# TYPE mpd_update_running gauge\n"
+		       "mpd_update_running {}\n"
+		       "# HELP mpd_update_jobs_total Finished database update jobs\n"
+		       "# TYPE mpd_update_jobs_total counter\n"
+		       "mpd_update_jobs_total {}\n"
+		       "# HELP mpd_update_duration_seconds_total Time spent in database updates\n"
+		       "# TYPE mpd_update_duration_seconds_total counter\n"
+		       "mpd_update_duration_seconds_total {}\n"
+		       "# HELP mpd_update_last_duration_seconds Duration of the most recent database update\n"
+		       "# TYPE mpd_update_last_duration_seconds gauge\n"
+		       "mpd_update_last_duration_seconds {}\n",
+		       unsigned(update.GetId() != 0),
+		       stats.jobs,
+		       FloatSeconds{stats.total_duration}.count(),
+		       FloatSeconds{stats.last_duration}.count());
+}
+
+#endif
+
+std::string
+ExportMetrics(Instance &instance)
+{
+	Buffer b;
+
+	Family(b, "mpd_clients", "gauge", "Connected clients");
+	fmt::format_to(std::back_inserter(b), "mpd_clients {}\n",
+		       instance.client_list->size());
+
+	ExportPartitions(b, instance);
+	ExportCommands(b);
+
+	if (instance.input_cache)
+		ExportInputCache(b, *instance.input_cache);
+
+#ifdef ENABLE_DATABASE
+	if (instance.update != nullptr)
+		ExportUpdate(b, *instance.update);
+#endif
+
+	return fmt::to_string(b);
+}
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <string>
+
+struct Instance;
+
+/**
+ * Collect the performance counters of all subsystems and format
+ * them in the Prometheus text exposition format (version 0.0.4),
+ * which is also understood by OpenMetrics scrapers.
+ *
+ * This must be called from the main thread.
+ */
+std::string
+ExportMetrics(Instance &instance);
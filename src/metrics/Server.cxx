@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Server.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "config/Param.hxx"
+#include "config/Net.hxx"
+#include "lib/fmt/RuntimeError.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/DeleteDisposer.hxx"
+
+MetricsServer::~MetricsServer() noexcept
+{
+	connections.clear_and_dispose(DeleteDisposer{});
+}
+
+void
+MetricsServer::Remove(MetricsConnection &connection) noexcept
+{
+	connections.erase_and_dispose(connections.iterator_to(connection),
+				      DeleteDisposer{});
+}
+
+void
+MetricsServer::OnAccept(UniqueSocketDescriptor fd, SocketAddress) noexcept
+{
+	if (connections.size() >= MAX_CONNECTIONS)
+		/* too many connections; the socket gets closed by
+		   the UniqueSocketDescriptor destructor */
+		return;
+
+	connections.push_back(*new MetricsConnection(*this, std::move(fd)));
+}
+
+std::unique_ptr<MetricsServer>
+CreateMetricsServer(const ConfigData &config, EventLoop &event_loop,
+		    Instance &instance)
+{
+	const unsigned port = config.GetUnsigned(ConfigOption::METRICS_PORT, 0);
+	if (port == 0)
+		return nullptr;
+
+	auto server = std::make_unique<MetricsServer>(event_loop, instance);
+
+	for (const auto &param : config.GetParamList(ConfigOption::METRICS_BIND_TO_ADDRESS)) {
+		try {
+			ServerSocketAddGeneric(*server, param.value.c_str(),
+					       port);
+		} catch (...) {
+			std::throw_with_nested(FmtRuntimeError("Failed to listen on {} (line {})",
+							       param.value,
+							       param.line));
+		}
+	}
+
+	if (server->IsEmpty()) {
+		try {
+			server->AddPort(port);
+		} catch (...) {
+			std::throw_with_nested(FmtRuntimeError("Failed to listen on *:{}",
+							       port));
+		}
+	}
+
+	server->Open();
+	return server;
+}
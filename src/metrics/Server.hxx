@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Connection.hxx"
+#include "event/ServerSocket.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <memory>
+
+struct ConfigData;
+struct Instance;
+
+/**
+ * A minimal HTTP server which exports performance counters to
+ * Prometheus (see ExportMetrics()).
+ */
+class MetricsServer final : public ServerSocket {
+	/**
+	 * Connections which exceed this limit are refused.
+	 */
+	static constexpr std::size_t MAX_CONNECTIONS = 16;
+
+	Instance &instance;
+
+	IntrusiveList<MetricsConnection,
+		      IntrusiveListBaseHookTraits<MetricsConnection>,
+		      IntrusiveListOptions{.constant_time_size = true}> connections;
+
+public:
+	MetricsServer(EventLoop &_loop, Instance &_instance) noexcept
+		:ServerSocket(_loop), instance(_instance) {}
+
+	~MetricsServer() noexcept;
+
+	Instance &GetInstance() const noexcept {
+		return instance;
+	}
+
+	/**
+	 * Remove the connection from the list and delete it.
+	 */
+	void Remove(MetricsConnection &connection) noexcept;
+
+private:
+	void OnAccept(UniqueSocketDescriptor fd,
+		      SocketAddress address) noexcept override;
+};
+
+/**
+ * Create a #MetricsServer listening on the configured
+ * "metrics_bind_to_address" addresses (or on all interfaces) and
+ * "metrics_port".
+ *
+ * Throws on error.
+ *
+ * @return the new #MetricsServer or nullptr if "metrics_port" is
+ * not configured
+ */
+std::unique_ptr<MetricsServer>
+CreateMetricsServer(const ConfigData &config, EventLoop &event_loop,
+		    Instance &instance);
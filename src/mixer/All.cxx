@@ -40,12 +40,15 @@ output_mixer_get_volume(const AudioOutputControl &ao) noexcept
 }
 
 int
-MultipleOutputs::GetVolume() const noexcept
+MultipleOutputs::GetVolume(std::string_view link_partition) const noexcept
 {
 	unsigned ok = 0;
 	int total = 0;
 
 	for (const auto &ao : outputs) {
+		if (ao->GetLinkPartition() != link_partition)
+			continue;
+
 		int volume = output_mixer_get_volume(*ao);
 		if (volume >= 0) {
 			total += volume;
@@ -96,7 +99,7 @@ output_mixer_set_volume(AudioOutputControl &ao, unsigned volume)
 }
 
 void
-MultipleOutputs::SetVolume(unsigned volume)
+MultipleOutputs::SetVolume(unsigned volume, std::string_view link_partition)
 {
 	assert(volume <= 100);
 
@@ -104,6 +107,9 @@ MultipleOutputs::SetVolume(unsigned volume)
 	std::exception_ptr error;
 
 	for (const auto &ao : outputs) {
+		if (ao->GetLinkPartition() != link_partition)
+			continue;
+
 		try {
 			auto r = output_mixer_set_volume(*ao, volume);
 			if (r > result)
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChunkFilterCache.hxx"
+
+ChunkFilterCache::ChunkFilterCache() noexcept = default;
+ChunkFilterCache::~ChunkFilterCache() noexcept = default;
+
+std::shared_ptr<const ChunkFilterCache::Entry>
+ChunkFilterCache::Get(const MusicChunk &chunk, const Key &key) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto [begin, end] = entries.equal_range(&chunk);
+	for (auto i = begin; i != end; ++i)
+		if (i->second->key == key)
+			return i->second;
+
+	return nullptr;
+}
+
+std::shared_ptr<const ChunkFilterCache::Entry>
+ChunkFilterCache::Put(const MusicChunk &chunk, const Key &key,
+		      std::span<const std::byte> data) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto [begin, end] = entries.equal_range(&chunk);
+	for (auto i = begin; i != end; ++i)
+		if (i->second->key == key)
+			return i->second;
+
+	if (total_bytes + data.size() > MAX_BYTES)
+		return nullptr;
+
+	auto entry = std::make_shared<const Entry>(key, data);
+	total_bytes += data.size();
+	entries.emplace(&chunk, entry);
+	return entry;
+}
+
+void
+ChunkFilterCache::Remove(const MusicChunk &chunk) noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	const auto [begin, end] = entries.equal_range(&chunk);
+	for (auto i = begin; i != end; ++i)
+		total_bytes -= i->second->data.size();
+
+	entries.erase(begin, end);
+}
+
+void
+ChunkFilterCache::Clear() noexcept
+{
+	const std::scoped_lock lock{mutex};
+
+	entries.clear();
+	total_bytes = 0;
+}
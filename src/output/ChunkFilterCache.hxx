@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "ReplayGainMode.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "thread/Mutex.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
+struct MusicChunk;
+
+/**
+ * Caches the result of the first stage of #AudioOutputSource
+ * (ReplayGain and cross-fading), shared by all outputs which are fed
+ * by the same #MusicPipe.  Outputs with identical settings then do
+ * this work only once per chunk; the first one to process a chunk
+ * stores its result, the others reuse it.
+ *
+ * For outputs whose filter chain does nothing but convert to the
+ * output format (see FilteredAudioOutput::share_filter), the result
+ * of that conversion is cached as well.
+ *
+ * Entries are removed with Remove() when their #MusicChunk leaves
+ * the #MusicPipe, so a (recycled) chunk pointer never refers to a
+ * stale entry.
+ *
+ * This class is thread-safe.
+ */
+class ChunkFilterCache {
+public:
+	/**
+	 * All output settings which affect the result.
+	 */
+	struct Key {
+		/**
+		 * The #AudioFormat returned by the ReplayGain
+		 * filter.
+		 */
+		AudioFormat audio_format;
+
+		/**
+		 * The #ReplayGainMode applied to the PCM data;
+		 * #ReplayGainMode::OFF if the output has no software
+		 * ReplayGain filter.
+		 */
+		ReplayGainMode replay_gain_mode;
+
+		/**
+		 * The #AudioFormat the data was converted to by the
+		 * output's filter chain; undefined for the result
+		 * of the first stage.
+		 */
+		AudioFormat out_audio_format = AudioFormat::Undefined();
+
+		constexpr bool operator==(const Key &) const noexcept = default;
+	};
+
+	struct Entry {
+		Key key;
+
+		AllocatedArray<std::byte> data;
+
+		Entry(const Key &_key, std::span<const std::byte> _data) noexcept
+			:key(_key), data(_data) {}
+	};
+
+	/**
+	 * The maximum amount of PCM data kept in this object.  If an
+	 * output lags far behind the others, it computes its data on
+	 * its own instead of growing the cache without bounds.
+	 */
+	static constexpr std::size_t MAX_BYTES = 1024 * 1024;
+
+private:
+	Mutex mutex;
+
+	std::unordered_multimap<const MusicChunk *,
+				std::shared_ptr<const Entry>> entries;
+
+	std::size_t total_bytes = 0;
+
+public:
+	ChunkFilterCache() noexcept;
+	~ChunkFilterCache() noexcept;
+
+	ChunkFilterCache(const ChunkFilterCache &) = delete;
+	ChunkFilterCache &operator=(const ChunkFilterCache &) = delete;
+
+	/**
+	 * Look up the data for the given chunk.
+	 *
+	 * @return the entry or nullptr if there is none
+	 */
+	std::shared_ptr<const Entry> Get(const MusicChunk &chunk,
+					 const Key &key) noexcept;
+
+	/**
+	 * Store a copy of the data for the given chunk.  If another
+	 * output has added an entry meanwhile, that one is returned.
+	 *
+	 * @return the entry or nullptr if the cache is full
+	 */
+	std::shared_ptr<const Entry> Put(const MusicChunk &chunk,
+					 const Key &key,
+					 std::span<const std::byte> data) noexcept;
+
+	/**
+	 * Remove all entries of the given chunk.  To be called before
+	 * the chunk is removed from the #MusicPipe.
+	 */
+	void Remove(const MusicChunk &chunk) noexcept;
+
+	void Clear() noexcept;
+};
@@ -3,6 +3,7 @@
 
 #include "Control.hxx"
 #include "Filtered.hxx"
+#include "Interface.hxx"
 #include "Client.hxx"
 #include "Domain.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
@@ -16,6 +17,18 @@
     automatically reopening the device */
 static constexpr PeriodClock::Duration REOPEN_AFTER = std::chrono::seconds(10);
 
+static CpuAffinity
+ParseCpuAffinity(const ConfigBlock &block)
+{
+	const auto *param = block.GetBlockParam("cpu_affinity");
+	if (param == nullptr)
+		return {};
+
+	return param->With([](const char *s){
+		return CpuAffinity::Parse(s);
+	});
+}
+
 AudioOutputControl::AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _output,
 				       AudioOutputClient &_client,
 				       const ConfigBlock &block)
@@ -26,6 +39,7 @@ AudioOutputControl::AudioOutputControl(std::unique_ptr<FilteredAudioOutput> _out
 	 tags(block.GetBlockValue("tags", true)),
 	 always_on(block.GetBlockValue("always_on", false)),
 	 always_off(block.GetBlockValue("always_off", false)),
+	 cpu_affinity(ParseCpuAffinity(block)),
 	 enabled(block.GetBlockValue("enabled", true))
 {
 }
@@ -38,7 +52,8 @@ AudioOutputControl::AudioOutputControl(AudioOutputControl &&src,
 	 thread(BIND_THIS_METHOD(Task)),
 	 tags(src.tags),
 	 always_on(src.always_on),
-	 always_off(src.always_off)
+	 always_off(src.always_off),
+	 cpu_affinity(src.cpu_affinity)
 {
 }
 
@@ -105,6 +120,53 @@ AudioOutputControl::GetMixer() const noexcept
 	return output ? output->mixer : nullptr;
 }
 
+AudioFormat
+AudioOutputControl::LockGetEnabledConfiguredFormat() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	return output && enabled
+		? output->config_audio_format
+		: AudioFormat::Undefined();
+}
+
+AudioFormat
+AudioOutputControl::LockGetEnabledOutAudioFormat() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	return output && enabled && open
+		? output->out_audio_format
+		: AudioFormat::Undefined();
+}
+
+AudioOutputStats
+AudioOutputControl::LockGetStats() const noexcept
+{
+	AudioOutputStats result;
+
+	{
+		const std::lock_guard protect{mutex};
+		result = stats;
+
+		if (source.IsOpen())
+			result.pipe_lag = source.GetPipeLag();
+	}
+
+	if (output) {
+		const auto device = output->GetDeviceStats();
+		result.xruns = device.xruns;
+		result.recoveries = device.recoveries;
+	}
+
+	return result;
+}
+
+bool
+AudioOutputControl::LockIsBitPerfect() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	return source_state == SourceState::OPEN && bit_perfect;
+}
+
 std::map<std::string, std::string, std::less<>>
 AudioOutputControl::GetAttributes() const noexcept
 {
@@ -154,6 +216,7 @@ AudioOutputControl::CommandAsync(Command cmd) noexcept
 	assert(IsCommandFinished());
 
 	command = cmd;
+	command_pending.store(true, std::memory_order_relaxed);
 	wake_cond.notify_one();
 }
 
@@ -231,7 +294,8 @@ AudioOutputControl::EnableDisableAsync()
 inline bool
 AudioOutputControl::Open(std::unique_lock<Mutex> &&lock,
 			 const AudioFormat audio_format,
-			 const MusicPipe &mp) noexcept
+			 const MusicPipe &mp,
+			 ChunkFilterCache *filter_cache) noexcept
 {
 	assert(allow_play);
 	assert(audio_format.IsValid());
@@ -249,6 +313,7 @@ AudioOutputControl::Open(std::unique_lock<Mutex> &&lock,
 
 	request.audio_format = audio_format;
 	request.pipe = &mp;
+	request.filter_cache = filter_cache;
 
 	if (!thread.IsDefined()) {
 		try {
@@ -299,6 +364,7 @@ AudioOutputControl::CloseWait(std::unique_lock<Mutex> &lock) noexcept
 bool
 AudioOutputControl::LockUpdate(const AudioFormat audio_format,
 			       const MusicPipe &mp,
+			       ChunkFilterCache *filter_cache,
 			       bool force) noexcept
 {
 	std::unique_lock lock{mutex};
@@ -306,7 +372,8 @@ AudioOutputControl::LockUpdate(const AudioFormat audio_format,
 	if (enabled && really_enabled) {
 		if (force || !fail_timer.IsDefined() ||
 		    fail_timer.Check(REOPEN_AFTER)) {
-			return Open(std::move(lock), audio_format, mp);
+			return Open(std::move(lock), audio_format, mp,
+				    filter_cache);
 		}
 	} else if (IsOpen())
 		CloseWait(lock);
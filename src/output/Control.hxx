@@ -5,23 +5,30 @@
 #define MPD_OUTPUT_CONTROL_HXX
 
 #include "Source.hxx"
+#include "Stats.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "thread/Thread.hxx"
+#include "thread/Affinity.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "time/PeriodClock.hxx"
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <map>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 
 enum class ReplayGainMode : uint8_t;
 struct FilteredAudioOutput;
 struct MusicChunk;
 struct ConfigBlock;
 class MusicPipe;
+class ChunkFilterCache;
 class Mixer;
 class AudioOutputClient;
 
@@ -38,6 +45,15 @@ class AudioOutputControl {
 	 */
 	const std::string name;
 
+	/**
+	 * The name of the partition which has linked this output to
+	 * the partition which owns it now (see Partition::Link());
+	 * empty if the output is not linked.  Its volume is then
+	 * controlled by that partition.  Only accessed by the main
+	 * thread.
+	 */
+	std::string link_partition;
+
 	/**
 	 * The PlayerControl object which "owns" this output.  This
 	 * object is needed to signal command completion.
@@ -95,6 +111,12 @@ class AudioOutputControl {
 		 * The #MusicPipe passed to #Command::OPEN.
 		 */
 		const MusicPipe *pipe;
+
+		/**
+		 * The #ChunkFilterCache passed to #Command::OPEN
+		 * (may be nullptr).
+		 */
+		ChunkFilterCache *filter_cache;
 	} request;
 
 	/**
@@ -130,6 +152,14 @@ class AudioOutputControl {
 		KILL
 	} command = Command::NONE;
 
+	/**
+	 * A copy of "#command != Command::NONE" which may be read
+	 * without holding the mutex.  It allows the output thread to
+	 * play a whole buffer without locking the mutex after each
+	 * Play() call.
+	 */
+	std::atomic_bool command_pending{false};
+
 	/**
 	 * The current state of #source (an #AudioOutputSource
 	 * object).  This is used to keep track of whether it needs to
@@ -174,6 +204,11 @@ class AudioOutputControl {
 	 */
 	const bool always_off;
 
+	/**
+	 * The CPUs the output thread may run on ("cpu_affinity").
+	 */
+	const CpuAffinity cpu_affinity;
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -267,6 +302,21 @@ class AudioOutputControl {
 	 */
 	bool killed;
 
+	/**
+	 * Counters for the "outputstats" command.
+	 *
+	 * Protected by #mutex.
+	 */
+	AudioOutputStats stats;
+
+	/**
+	 * A copy of AudioOutputSource::IsBitPerfect() after the last
+	 * Fill() call; only valid while #source_state is OPEN.
+	 *
+	 * Protected by #mutex.
+	 */
+	bool bit_perfect = false;
+
 public:
 	/**
 	 * This mutex protects #open, #fail_timer, #pipe.
@@ -303,6 +353,14 @@ public:
 	[[gnu::pure]]
 	const char *GetLogName() const noexcept;
 
+	const std::string &GetLinkPartition() const noexcept {
+		return link_partition;
+	}
+
+	void SetLinkPartition(std::string_view _link_partition) noexcept {
+		link_partition = _link_partition;
+	}
+
 	AudioOutputClient &GetClient() noexcept {
 		return client;
 	}
@@ -310,6 +368,36 @@ public:
 	[[gnu::pure]]
 	Mixer *GetMixer() const noexcept;
 
+	/**
+	 * Returns the "format" setting of this output (a mask which
+	 * may be partially undefined), but only if it is enabled;
+	 * an undefined #AudioFormat otherwise.
+	 */
+	[[gnu::pure]]
+	AudioFormat LockGetEnabledConfiguredFormat() const noexcept;
+
+	/**
+	 * Returns the #AudioFormat which is really sent to the
+	 * device, but only if this output is enabled and open; an
+	 * undefined #AudioFormat otherwise.
+	 */
+	[[gnu::pure]]
+	AudioFormat LockGetEnabledOutAudioFormat() const noexcept;
+
+	/**
+	 * Returns a snapshot of the performance counters, including
+	 * the current #MusicPipe lag and the device statistics.
+	 */
+	[[gnu::pure]]
+	AudioOutputStats LockGetStats() const noexcept;
+
+	/**
+	 * Is this output currently playing bit-perfect, i.e. does it
+	 * pass the decoded data to the device unmodified?
+	 */
+	[[gnu::pure]]
+	bool LockIsBitPerfect() const noexcept;
+
 	bool IsDummy() const noexcept {
 		return !output;
 	}
@@ -472,17 +560,21 @@ public:
 	 * Caller must lock the mutex.
 	 */
 	bool Open(std::unique_lock<Mutex> &&lock,
-		  AudioFormat audio_format, const MusicPipe &mp) noexcept;
+		  AudioFormat audio_format, const MusicPipe &mp,
+		  ChunkFilterCache *filter_cache) noexcept;
 
 	/**
 	 * Opens or closes the device, depending on the "enabled"
 	 * flag.
 	 *
+	 * @param filter_cache shares the ReplayGain and cross-fading
+	 * results with other outputs (may be nullptr)
 	 * @param force true to ignore the #fail_timer
 	 * @return true if the device is open
 	 */
 	bool LockUpdate(AudioFormat audio_format,
 			const MusicPipe &mp,
+			ChunkFilterCache *filter_cache,
 			bool force) noexcept;
 
 	/**
@@ -569,7 +661,8 @@ private:
 	 * Handles exceptions.
 	 */
 	void InternalOpen(AudioFormat audio_format,
-			  const MusicPipe &pipe) noexcept;
+			  const MusicPipe &pipe,
+			  ChunkFilterCache *filter_cache) noexcept;
 
 	/**
 	 * Runs inside the OutputThread.
@@ -610,6 +703,27 @@ private:
 	 */
 	bool FillSourceOrClose() noexcept;
 
+	/**
+	 * Play the given buffer, calling AudioOutput::Play() until
+	 * it has been consumed completely, a command is pending or
+	 * the output requests a delay.
+	 *
+	 * Caller must not lock the mutex.
+	 *
+	 * Throws on error.
+	 *
+	 * @param histogram the duration of each AudioOutput::Play()
+	 * call is added here; the caller merges it into #stats after
+	 * locking the mutex again
+	 * @param interrupted set to true if AudioOutput::Play() threw
+	 * #AudioOutputInterrupted after some data had been written;
+	 * if nothing was written, the exception is rethrown instead
+	 * @return the number of bytes consumed
+	 */
+	std::size_t PlayUnlocked(std::span<const std::byte> buffer,
+				 AudioOutputPlayHistogram &histogram,
+				 bool &interrupted);
+
 	/**
 	 * Caller must lock the mutex.
 	 */
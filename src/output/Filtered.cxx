@@ -159,6 +159,12 @@ FilteredAudioOutput::Delay() noexcept
 	return output->Delay();
 }
 
+AudioOutputDeviceStats
+FilteredAudioOutput::GetDeviceStats() const noexcept
+{
+	return output->GetDeviceStats();
+}
+
 void
 FilteredAudioOutput::SendTag(const Tag &tag)
 {
@@ -6,6 +6,7 @@
 
 #include "pcm/AudioFormat.hxx"
 #include "filter/Observer.hxx"
+#include "filter/plugins/FusedGain.hxx"
 
 #include <chrono>
 #include <map>
@@ -21,6 +22,7 @@ class MixerListener;
 struct MixerPlugin;
 struct ConfigBlock;
 class AudioOutput;
+struct AudioOutputDeviceStats;
 struct AudioOutputDefaults;
 struct ReplayGainConfig;
 struct Tag;
@@ -80,12 +82,35 @@ public:
 	 */
 	std::unique_ptr<PreparedFilter> prepared_filter;
 
+	/**
+	 * An optional filter which is applied after #prepared_filter,
+	 * i.e. after the conversion to #out_audio_format.  This is
+	 * the #VolumeFilter if #share_filter is set.
+	 */
+	std::unique_ptr<PreparedFilter> prepared_post_filter;
+
+	/**
+	 * Does #prepared_filter consist of nothing but the
+	 * #ConvertFilter?  Then its output is the same for all
+	 * outputs with the same #out_audio_format, and it may be
+	 * shared with them (see #ChunkFilterCache).  In this mode,
+	 * the software volume is applied last, by
+	 * #prepared_post_filter.
+	 */
+	bool share_filter = false;
+
 	/**
 	 * The #VolumeFilter instance of this audio output.  It is
 	 * used by the #SoftwareMixer.
 	 */
 	FilterObserver volume_filter;
 
+	/**
+	 * Passes the replay gain to the #VolumeFilter if both can be
+	 * applied in one pass (see replay_gain_filter_set_fused_gain()).
+	 */
+	FusedGain fused_gain;
+
 	/**
 	 * The replay_gain_filter_plugin instance of this audio
 	 * output.
@@ -219,6 +244,13 @@ public:
 
 	void EndPause() noexcept{
 	}
+
+	/**
+	 * Wrapper for AudioOutput::GetDeviceStats().  May be called
+	 * from any thread.
+	 */
+	[[gnu::pure]]
+	AudioOutputDeviceStats GetDeviceStats() const noexcept;
 };
 
 /**
@@ -97,6 +97,8 @@ audio_output_load_mixer(EventLoop &event_loop, FilteredAudioOutput &ao,
 			const MixerType mixer_type,
 			const MixerPlugin *plugin,
 			std::unique_ptr<PreparedFilter> &filter_chain,
+			bool volume_allow_convert,
+			const FusedGain *fused_gain,
 			MixerListener &listener)
 {
 	Mixer *mixer;
@@ -125,7 +127,8 @@ audio_output_load_mixer(EventLoop &event_loop, FilteredAudioOutput &ao,
 		assert(mixer != nullptr);
 
 		filter_chain = ChainFilters(std::move(filter_chain),
-					    ao.volume_filter.Set(volume_filter_prepare()),
+					    ao.volume_filter.Set(volume_filter_prepare(volume_allow_convert,
+											       fused_gain)),
 					    "software_mixer");
 		return mixer;
 	}
@@ -192,17 +195,32 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 
 	const auto mixer_type = audio_output_mixer_type(block, defaults);
 
+	/* without normalization and configured filters, the filter
+	   chain only converts to the output format, and its result
+	   can be shared with other outputs; the software volume is
+	   then applied after the conversion */
+	share_filter = !prepared_filter;
+
 	/* create the replay_gain filter */
 
 	const char *replay_gain_handler =
 		block.GetBlockValue("replay_gain_handler", "software");
 
+	/* if nothing but the conversion runs between the
+	   ReplayGainFilter and the VolumeFilter, then the
+	   VolumeFilter can apply both levels in one pass, dithering
+	   only once */
+	const bool fuse_gain = share_filter &&
+		mixer_type == MixerType::SOFTWARE &&
+		StringIsEqual(replay_gain_handler, "software");
+
 	if (!StringIsEqual(replay_gain_handler, "none")) {
-		/* when using software volume, we lose quality by
-		   invoking PcmVolume::Apply() twice; to avoid losing
-		   too much precision, we allow the ReplayGainFilter
-		   to convert 16 bit to 24 bit */
-		const bool allow_convert = mixer_type == MixerType::SOFTWARE;
+		/* when using software volume (without fusing), we
+		   lose quality by invoking PcmVolume::Apply() twice;
+		   to avoid losing too much precision, we allow the
+		   ReplayGainFilter to convert 16 bit to 24 bit */
+		const bool allow_convert = mixer_type == MixerType::SOFTWARE &&
+			!fuse_gain;
 
 		prepared_replay_gain_filter =
 			NewReplayGainFilter(replay_gain_config, allow_convert);
@@ -219,7 +237,11 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		mixer = audio_output_load_mixer(event_loop, *this, block,
 						mixer_type,
 						mixer_plugin,
-						prepared_filter,
+						share_filter
+						? prepared_post_filter
+						: prepared_filter,
+						!share_filter,
+						fuse_gain ? &fused_gain : nullptr,
 						mixer_listener);
 	} catch (...) {
 		FmtError(output_domain,
@@ -241,6 +263,10 @@ FilteredAudioOutput::Setup(EventLoop &event_loop,
 		throw std::runtime_error("Invalid \"replay_gain_handler\" value");
 	}
 
+	if (fuse_gain && mixer != nullptr)
+		replay_gain_filter_set_fused_gain(*prepared_replay_gain_filter,
+						  &fused_gain);
+
 	/* the "convert" filter must be the last one in the chain */
 
 	prepared_filter = ChainFilters(std::move(prepared_filter),
@@ -12,6 +12,22 @@
 struct AudioFormat;
 struct Tag;
 
+/**
+ * Device level counters returned by AudioOutput::GetDeviceStats().
+ */
+struct AudioOutputDeviceStats {
+	/**
+	 * The number of buffer underruns reported by the device.
+	 */
+	unsigned xruns = 0;
+
+	/**
+	 * The number of times the plugin has recovered from an
+	 * error (e.g. an underrun or a suspended device).
+	 */
+	unsigned recoveries = 0;
+};
+
 class AudioOutput {
 	const unsigned flags;
 
@@ -205,6 +221,16 @@ public:
 		/* fail because this method is not implemented */
 		return false;
 	}
+
+	/**
+	 * Returns device level counters for the "outputstats"
+	 * command.  Optional method.  It may be called from any
+	 * thread while the output is being used, therefore
+	 * implementations must use atomic variables or similar.
+	 */
+	virtual AudioOutputDeviceStats GetDeviceStats() const noexcept {
+		return {};
+	}
 };
 
 #endif
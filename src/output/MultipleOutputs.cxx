@@ -100,6 +100,8 @@ MultipleOutputs::Configure(EventLoop &event_loop, EventLoop &rt_event_loop,
 						       client, empty, defaults,
 						       nullptr));
 	}
+
+	UpdatePreferredAudioFormat();
 }
 
 AudioOutputControl *
@@ -134,6 +136,34 @@ MultipleOutputs::EnableDisable()
 		ao->LockEnableDisableAsync();
 
 	WaitAll();
+
+	UpdatePreferredAudioFormat();
+}
+
+void
+MultipleOutputs::UpdatePreferredAudioFormat() noexcept
+{
+	preferred_audio_format = AudioFormat::Undefined();
+
+	for (const auto &ao : outputs) {
+		const auto af = ao->LockGetEnabledConfiguredFormat();
+		if (af.IsMaskDefined()) {
+			preferred_audio_format = af;
+			return;
+		}
+	}
+
+	/* no output has a "format" setting: use the format the
+	   first open device is really playing, which may differ
+	   from the song's format if the device doesn't support
+	   that */
+	for (const auto &ao : outputs) {
+		const auto af = ao->LockGetEnabledOutAudioFormat();
+		if (af.IsDefined()) {
+			preferred_audio_format = af;
+			return;
+		}
+	}
 }
 
 void
@@ -158,8 +188,14 @@ MultipleOutputs::Update(bool force) noexcept
 	if (!IsOpen())
 		return false;
 
+	/* with only one output, there is nobody to share the
+	   filter results with */
+	ChunkFilterCache *const cache = outputs.size() > 1
+		? &filter_cache
+		: nullptr;
+
 	for (const auto &ao : outputs)
-		ret = ao->LockUpdate(input_audio_format, *pipe, force)
+		ret = ao->LockUpdate(input_audio_format, *pipe, cache, force)
 			|| ret;
 
 	return ret;
@@ -210,6 +246,10 @@ MultipleOutputs::Open(const AudioFormat audio_format)
 	EnableDisable();
 	Update(true);
 
+	/* now that the devices are open, their real formats are
+	   known */
+	UpdatePreferredAudioFormat();
+
 	std::exception_ptr first_error;
 
 	for (const auto &ao : outputs) {
@@ -271,15 +311,17 @@ MultipleOutputs::CheckPipe() noexcept
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
-		const bool is_tail = chunk->next == nullptr;
+		const bool is_tail = chunk->GetNext() == nullptr;
 		if (is_tail)
 			/* this is the tail of the pipe - clear the
 			   chunk reference in all outputs */
 			for (const auto &ao : outputs)
 				ao->LockClearTailChunk(*chunk);
 
+		filter_cache.Remove(*chunk);
+
 		/* remove the chunk from the pipe */
-		const auto shifted = pipe->Shift();
+		auto shifted = pipe->Shift();
 		assert(shifted.get() == chunk);
 
 		if (is_tail)
@@ -288,8 +330,10 @@ MultipleOutputs::CheckPipe() noexcept
 			for (const auto &ao : outputs)
 				ao->LockAllowPlay();
 
-		/* chunk is automatically returned to the buffer by
+		/* the chunk is either kept for seeking backwards or
+		   automatically returned to the buffer by
 		   ~MusicChunkPtr() */
+		AddHistory(std::move(shifted));
 	}
 
 	return 0;
@@ -315,8 +359,52 @@ MultipleOutputs::Drain() noexcept
 	WaitAll();
 }
 
+void
+MultipleOutputs::AddHistory(MusicChunkPtr chunk) noexcept
+{
+	if (history_skip > 0) {
+		/* this chunk belongs to the previous song */
+		--history_skip;
+		return;
+	}
+
+	if (history_size == 0 || chunk->length == 0)
+		return;
+
+	if (chunk->other != nullptr || chunk->time.IsNegative()) {
+		/* a cross-faded chunk cannot be played again, and
+		   without a time stamp, the history is useless */
+		history.Clear();
+		return;
+	}
+
+	history.Push(std::move(chunk));
+
+	while (history.GetSize() > history_size)
+		history.Shift();
+}
+
+void
+MultipleOutputs::ClearHistory() noexcept
+{
+	history.Clear();
+	history_skip = pipe != nullptr ? pipe->GetSize() : 0;
+}
+
 void
 MultipleOutputs::Cancel() noexcept
+{
+	DoCancel(false);
+}
+
+void
+MultipleOutputs::CancelToHistory() noexcept
+{
+	DoCancel(true);
+}
+
+void
+MultipleOutputs::DoCancel(bool keep) noexcept
 {
 	/* send the cancel() command to all audio outputs */
 
@@ -325,10 +413,23 @@ MultipleOutputs::Cancel() noexcept
 
 	WaitAll();
 
-	/* clear the music pipe and return all chunks to the buffer */
+	/* clear the music pipe and return all chunks to the buffer
+	   (or to the history) */
+
+	if (!keep)
+		history.Clear();
 
-	if (pipe != nullptr)
-		pipe->Clear();
+	if (pipe != nullptr) {
+		if (keep)
+			while (auto chunk = pipe->Shift())
+				AddHistory(std::move(chunk));
+		else
+			pipe->Clear();
+	}
+
+	history_skip = 0;
+
+	filter_cache.Clear();
 
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
@@ -346,7 +447,10 @@ MultipleOutputs::Close() noexcept
 	for (const auto &ao : outputs)
 		ao->LockCloseWait();
 
+	history.Clear();
+	history_skip = 0;
 	pipe.reset();
+	filter_cache.Clear();
 
 	input_audio_format.Clear();
 
@@ -359,7 +463,10 @@ MultipleOutputs::Release() noexcept
 	for (const auto &ao : outputs)
 		ao->LockRelease();
 
+	history.Clear();
+	history_skip = 0;
 	pipe.reset();
+	filter_cache.Clear();
 
 	input_audio_format.Clear();
 
@@ -372,4 +479,7 @@ MultipleOutputs::SongBorder() noexcept
 	/* clear the elapsed_time pointer at the beginning of a new
 	   song */
 	elapsed_time = SignedSongTime::zero();
+
+	/* the history must not mix chunks of different songs */
+	ClearHistory();
 }
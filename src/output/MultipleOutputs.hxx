@@ -5,7 +5,9 @@
 #define OUTPUT_ALL_H
 
 #include "Control.hxx"
+#include "ChunkFilterCache.hxx"
 #include "MusicChunkPtr.hxx"
+#include "MusicPipe.hxx"
 #include "player/Outputs.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "ReplayGainMode.hxx"
@@ -14,9 +16,9 @@
 #include <algorithm>
 #include <cassert>
 #include <memory>
+#include <string_view>
 #include <vector>
 
-class MusicPipe;
 class EventLoop;
 class MixerListener;
 class AudioOutputClient;
@@ -42,12 +44,42 @@ class MultipleOutputs final : public PlayerOutputs {
 	 */
 	std::unique_ptr<MusicPipe> pipe;
 
+	/**
+	 * Shares the ReplayGain and cross-fading results of #pipe
+	 * chunks between the outputs.
+	 */
+	ChunkFilterCache filter_cache;
+
+	/**
+	 * Chunks of the current song which have been played by all
+	 * outputs; see PlayerOutputs::GetHistory().
+	 */
+	MusicPipe history;
+
+	/**
+	 * The maximum number of chunks in #history.
+	 */
+	unsigned history_size = 0;
+
+	/**
+	 * The number of chunks at the head of #pipe which belong to
+	 * the previous song and must not be added to #history.
+	 */
+	unsigned history_skip = 0;
+
 	/**
 	 * The "elapsed_time" stamp of the most recently finished
 	 * chunk.
 	 */
 	SignedSongTime elapsed_time = SignedSongTime::Negative();
 
+	/**
+	 * The "format" setting of the first enabled output which has
+	 * one, or else the format the first open output is really
+	 * playing.  Updated by UpdatePreferredAudioFormat().
+	 */
+	AudioFormat preferred_audio_format = AudioFormat::Undefined();
+
 public:
 	/**
 	 * Load audio outputs from the configuration file and
@@ -117,9 +149,13 @@ public:
 	/**
 	 * Returns the average volume of all available mixers (range
 	 * 0..100).  Returns -1 if no mixer can be queried.
+	 *
+	 * @param link_partition consider only outputs linked by this
+	 * partition (see AudioOutputControl::GetLinkPartition()); by
+	 * default, only outputs which are not linked
 	 */
 	[[gnu::pure]]
-	int GetVolume() const noexcept;
+	int GetVolume(std::string_view link_partition={}) const noexcept;
 
 	/**
 	 * Sets the volume on all available mixers.
@@ -127,8 +163,9 @@ public:
 	 * Throws on error.
 	 *
 	 * @param volume the volume (range 0..100)
+	 * @param link_partition see GetVolume()
 	 */
-	void SetVolume(unsigned volume);
+	void SetVolume(unsigned volume, std::string_view link_partition={});
 
 	/**
 	 * Similar to GetVolume(), but gets the volume only for
@@ -180,6 +217,20 @@ private:
 	 */
 	bool IsChunkConsumed(const MusicChunk *chunk) const noexcept;
 
+	void UpdatePreferredAudioFormat() noexcept;
+
+	/**
+	 * A chunk has been removed from #pipe; move it to #history
+	 * (or free it).
+	 */
+	void AddHistory(MusicChunkPtr chunk) noexcept;
+
+	/**
+	 * Cancel all outputs and remove all chunks from #pipe, moving
+	 * them to #history if @a keep is true.
+	 */
+	void DoCancel(bool keep) noexcept;
+
 	/* virtual methods from class PlayerOutputs */
 	void EnableDisable() override;
 	void Open(AudioFormat audio_format) override;
@@ -190,10 +241,25 @@ private:
 	void Pause() noexcept override;
 	void Drain() noexcept override;
 	void Cancel() noexcept override;
+	void CancelToHistory() noexcept override;
+
+	void SetHistorySize(unsigned max_chunks) noexcept override {
+		history_size = max_chunks;
+	}
+
+	MusicPipe &GetHistory() noexcept override {
+		return history;
+	}
+
+	void ClearHistory() noexcept override;
 	void SongBorder() noexcept override;
 	SignedSongTime GetElapsedTime() const noexcept override {
 		return elapsed_time;
 	}
+
+	AudioFormat GetPreferredAudioFormat() const noexcept override {
+		return preferred_audio_format;
+	}
 };
 
 #endif
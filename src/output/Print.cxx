@@ -9,6 +9,7 @@
 #include "Print.hxx"
 #include "MultipleOutputs.hxx"
 #include "client/Response.hxx"
+#include "Chrono.hxx"
 
 #include <fmt/format.h>
 
@@ -21,13 +22,65 @@ printAudioDevices(Response &r, const MultipleOutputs &outputs)
 		r.Fmt("outputid: {}\n"
 		       "outputname: {}\n"
 		       "plugin: {}\n"
-		       "outputenabled: {}\n",
+		       "outputenabled: {}\n"
+		       "bitperfect: {}\n",
 		      i,
 		      ao.GetName(), ao.GetPluginName(),
-		      (unsigned)ao.IsEnabled());
+		      (unsigned)ao.IsEnabled(),
+		      (unsigned)ao.LockIsBitPerfect());
 
 		for (const auto &[attribute, value] : ao.GetAttributes())
 			r.Fmt("attribute: {}={}\n",
 			      attribute, value);
 	}
 }
+
+template<std::size_t N, const std::array<std::chrono::microseconds, N> &LIMITS>
+static void
+PrintHistogram(Response &r, const char *name,
+	       const DurationHistogram<N, LIMITS> &histogram) noexcept
+{
+	using FloatMilliseconds = std::chrono::duration<double, std::milli>;
+
+	for (std::size_t i = 0; i < LIMITS.size(); ++i)
+		r.Fmt("{}: {} {}\n", name,
+		      FloatMilliseconds{LIMITS[i]}.count(),
+		      histogram.counts[i]);
+	r.Fmt("{}: inf {}\n", name, histogram.counts.back());
+}
+
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs)
+{
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		const auto &ao = outputs.Get(i);
+		const auto stats = ao.LockGetStats();
+
+		r.Fmt("outputid: {}\n"
+		      "outputname: {}\n"
+		      "delay: {:1.3f}\n"
+		      "pipelag: {:1.3f}\n"
+		      "filtertime: {:1.3f}\n"
+		      "filtercalls: {}\n"
+		      "playtime: {:1.3f}\n"
+		      "playcalls: {}\n"
+		      "xruns: {}\n"
+		      "recoveries: {}\n",
+		      i, ao.GetName(),
+		      FloatDuration{stats.delay}.count(),
+		      FloatDuration{stats.pipe_lag}.count(),
+		      FloatDuration{stats.filter.total}.count(),
+		      stats.filter.calls,
+		      FloatDuration{stats.play.total}.count(),
+		      stats.play.calls,
+		      stats.xruns, stats.recoveries);
+
+		if (stats.residency.calls > 0)
+			r.Fmt("pipelatencyavg: {:1.3f}\n",
+			      FloatDuration{stats.residency.total}.count() / stats.residency.calls);
+
+		PrintHistogram(r, "playduration", stats.play);
+		PrintHistogram(r, "filterduration", stats.filter);
+		PrintHistogram(r, "pipelatency", stats.residency);
+	}
+}
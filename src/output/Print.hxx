@@ -15,4 +15,11 @@ class MultipleOutputs;
 void
 printAudioDevices(Response &r, const MultipleOutputs &outputs);
 
+/**
+ * Print the performance counters of all outputs (the
+ * "outputstats" command).
+ */
+void
+printAudioOutputStats(Response &r, const MultipleOutputs &outputs);
+
 #endif
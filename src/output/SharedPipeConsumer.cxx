@@ -12,11 +12,12 @@ SharedPipeConsumer::Get() noexcept
 		if (!consumed)
 			return chunk;
 
-		if (chunk->next == nullptr)
+		const MusicChunk *next = chunk->GetNext();
+		if (next == nullptr)
 			return nullptr;
 
 		consumed = false;
-		return chunk = chunk->next.get();
+		return chunk = next;
 	} else {
 		/* get the first chunk from the pipe */
 		consumed = false;
@@ -24,6 +25,25 @@ SharedPipeConsumer::Get() noexcept
 	}
 }
 
+std::size_t
+SharedPipeConsumer::GetPendingBytes() const noexcept
+{
+	if (pipe == nullptr)
+		return 0;
+
+	const MusicChunk *i = chunk;
+	if (i == nullptr)
+		i = pipe->Peek();
+	else if (consumed)
+		i = i->GetNext();
+
+	std::size_t result = 0;
+	for (; i != nullptr; i = i->GetNext())
+		result += i->length;
+
+	return result;
+}
+
 bool
 SharedPipeConsumer::IsConsumed(const MusicChunk &_chunk) const noexcept
 {
@@ -33,9 +53,9 @@ SharedPipeConsumer::IsConsumed(const MusicChunk &_chunk) const noexcept
 	assert(&_chunk == chunk || pipe->Contains(chunk));
 
 	if (&_chunk != chunk) {
-		assert(_chunk.next != nullptr);
+		assert(_chunk.GetNext() != nullptr);
 		return true;
 	}
 
-	return consumed && _chunk.next == nullptr;
+	return consumed && _chunk.GetNext() == nullptr;
 }
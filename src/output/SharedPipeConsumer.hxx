@@ -5,6 +5,7 @@
 #define SHARED_PIPE_CONSUMER_HXX
 
 #include <cassert>
+#include <cstddef>
 
 struct MusicChunk;
 class MusicPipe;
@@ -68,6 +69,15 @@ public:
 	[[gnu::pure]]
 	bool IsConsumed(const MusicChunk &_chunk) const noexcept;
 
+	/**
+	 * Returns the number of bytes in all chunks which have not
+	 * been consumed yet (including the current one).  This is an
+	 * estimate, because the pipe's tail chunk may still be
+	 * growing.
+	 */
+	[[gnu::pure]]
+	std::size_t GetPendingBytes() const noexcept;
+
 	constexpr void ClearTail([[maybe_unused]] const MusicChunk &_chunk) noexcept {
 		assert(chunk == &_chunk);
 		assert(consumed);
@@ -19,6 +19,7 @@ AudioOutputSource::~AudioOutputSource() noexcept = default;
 
 AudioFormat
 AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
+			ChunkFilterCache *_filter_cache,
 			PreparedFilter *prepared_replay_gain_filter,
 			PreparedFilter *prepared_other_replay_gain_filter,
 			PreparedFilter &prepared_filter)
@@ -27,9 +28,12 @@ AudioOutputSource::Open(const AudioFormat audio_format, const MusicPipe &_pipe,
 
 	if (!IsOpen() || &_pipe != &pipe.GetPipe()) {
 		current_chunk = nullptr;
+		cached_data.reset();
 		pipe.Init(_pipe);
 	}
 
+	filter_cache = _filter_cache;
+
 	/* (re)open the filter */
 
 	if (filter && (filter_flushed || audio_format != in_audio_format))
@@ -59,10 +63,20 @@ AudioOutputSource::Close() noexcept
 	Cancel();
 }
 
+std::chrono::steady_clock::duration
+AudioOutputSource::GetPipeLag() const noexcept
+{
+	assert(IsOpen());
+
+	using Duration = std::chrono::steady_clock::duration;
+	return in_audio_format.SizeToTime<Duration>(pipe.GetPendingBytes());
+}
+
 void
 AudioOutputSource::Cancel() noexcept
 {
 	current_chunk = nullptr;
+	cached_data.reset();
 	pipe.Cancel();
 
 	if (replay_gain_filter)
@@ -71,8 +85,53 @@ AudioOutputSource::Cancel() noexcept
 	if (other_replay_gain_filter)
 		other_replay_gain_filter->Reset();
 
-	if (filter && !filter_flushed)
+	if (filter && !filter_flushed) {
 		filter->Reset();
+
+		if (post_filter)
+			post_filter->Reset();
+	}
+}
+
+void
+AudioOutputSource::OpenPostFilter(PreparedFilter *prepared_post_filter,
+				  const AudioFormat filter_out_format,
+				  const AudioFormat _out_audio_format,
+				  bool may_share)
+{
+	assert(filter);
+	assert(!filter_flushed);
+
+	/* the conversion can only be shared if it is stateless;
+	   resampling and DSD conversion keep state from one chunk
+	   to the next, so each output has to do it on its own */
+	share_filter = may_share &&
+		filter_out_format.sample_rate == _out_audio_format.sample_rate &&
+		filter_out_format.format != SampleFormat::DSD &&
+		_out_audio_format.format != SampleFormat::DSD;
+
+	if (post_filter && _out_audio_format != out_audio_format)
+		post_filter.reset();
+
+	/* without configured filters and without software volume,
+	   the filter chain is an identity if neither the
+	   ReplayGainFilter nor the ConvertFilter changes the
+	   format */
+	identity_filter = may_share && prepared_post_filter == nullptr &&
+		in_audio_format == _out_audio_format;
+
+	out_audio_format = _out_audio_format;
+
+	if (prepared_post_filter != nullptr && !post_filter) {
+		AudioFormat audio_format = out_audio_format;
+		post_filter = prepared_post_filter->Open(audio_format);
+
+		if (audio_format != out_audio_format) {
+			post_filter.reset();
+			throw FmtRuntimeError("Filter changes format {} to {}",
+					      out_audio_format, audio_format);
+		}
+	}
 }
 
 inline void
@@ -114,6 +173,27 @@ AudioOutputSource::CloseFilter() noexcept
 	replay_gain_filter.reset();
 	other_replay_gain_filter.reset();
 	filter.reset();
+	post_filter.reset();
+	share_filter = false;
+	identity_filter = false;
+	bit_perfect = false;
+}
+
+inline void
+AudioOutputSource::UpdateReplayGain(const MusicChunk &chunk,
+				    Filter &current_replay_gain_filter,
+				    unsigned *replay_gain_serial_p) noexcept
+{
+	replay_gain_filter_set_mode(current_replay_gain_filter,
+				    replay_gain_mode);
+
+	if (chunk.replay_gain_serial != *replay_gain_serial_p) {
+		replay_gain_filter_set_info(current_replay_gain_filter,
+					    chunk.replay_gain_serial != 0
+					    ? &chunk.replay_gain_info
+					    : nullptr);
+		*replay_gain_serial_p = chunk.replay_gain_serial;
+	}
 }
 
 std::span<const std::byte>
@@ -129,16 +209,8 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 	assert(data.size() % in_audio_format.GetFrameSize() == 0);
 
 	if (!data.empty() && current_replay_gain_filter != nullptr) {
-		replay_gain_filter_set_mode(*current_replay_gain_filter,
-					    replay_gain_mode);
-
-		if (chunk.replay_gain_serial != *replay_gain_serial_p) {
-			replay_gain_filter_set_info(*current_replay_gain_filter,
-						    chunk.replay_gain_serial != 0
-						    ? &chunk.replay_gain_info
-						    : nullptr);
-			*replay_gain_serial_p = chunk.replay_gain_serial;
-		}
+		UpdateReplayGain(chunk, *current_replay_gain_filter,
+				 replay_gain_serial_p);
 
 		/* note: the ReplayGainFilter doesn't have a
 		   ReadMore() method */
@@ -148,12 +220,9 @@ AudioOutputSource::GetChunkData(const MusicChunk &chunk,
 	return data;
 }
 
-inline std::span<const std::byte>
-AudioOutputSource::FilterChunk(const MusicChunk &chunk)
+std::span<const std::byte>
+AudioOutputSource::PreFilterChunk(const MusicChunk &chunk)
 {
-	assert(filter);
-	assert(!filter_flushed);
-
 	auto data = GetChunkData(chunk, replay_gain_filter.get(),
 				 &replay_gain_serial);
 	if (data.empty())
@@ -196,9 +265,179 @@ AudioOutputSource::FilterChunk(const MusicChunk &chunk)
 		data = {(const std::byte *)dest, other_data.size()};
 	}
 
-	/* apply filter chain */
+	return data;
+}
+
+inline bool
+AudioOutputSource::NeedsPreFilter(const MusicChunk &chunk) const noexcept
+{
+	return chunk.other != nullptr ||
+		(replay_gain_filter &&
+		 replay_gain_filter_is_software(*replay_gain_filter));
+}
+
+inline bool
+AudioOutputSource::CanBypassFilter(const MusicChunk &chunk) const noexcept
+{
+	return identity_filter && chunk.other == nullptr &&
+		(!replay_gain_filter ||
+		 replay_gain_filter_is_identity(*replay_gain_filter));
+}
+
+inline ChunkFilterCache::Key
+AudioOutputSource::GetPreFilterKey() const noexcept
+{
+	const bool software_replay_gain = replay_gain_filter &&
+		replay_gain_filter_is_software(*replay_gain_filter);
+
+	return {
+		software_replay_gain
+		? replay_gain_filter->GetOutAudioFormat()
+		: in_audio_format,
+		software_replay_gain
+		? replay_gain_mode
+		: ReplayGainMode::OFF,
+	};
+}
+
+inline void
+AudioOutputSource::SkipReplayGain(const MusicChunk &chunk) noexcept
+{
+	if (replay_gain_filter)
+		UpdateReplayGain(chunk, *replay_gain_filter,
+				 &replay_gain_serial);
 
-	return filter->FilterPCM(data);
+	if (chunk.other != nullptr && other_replay_gain_filter)
+		UpdateReplayGain(*chunk.other,
+				 *other_replay_gain_filter,
+				 &other_replay_gain_serial);
+}
+
+inline std::span<const std::byte>
+AudioOutputSource::CachedPreFilterChunk(const MusicChunk &chunk)
+{
+	assert(filter_cache != nullptr);
+
+	const auto key = GetPreFilterKey();
+
+	cached_data = filter_cache->Get(chunk, key);
+	if (cached_data == nullptr) {
+		const auto data = PreFilterChunk(chunk);
+		if (data.empty())
+			return data;
+
+		cached_data = filter_cache->Put(chunk, key, data);
+		if (cached_data == nullptr)
+			/* the cache is full */
+			return data;
+	} else {
+		/* another output has already done the work; just
+		   keep our ReplayGain filters (and their hardware
+		   mixers) up to date */
+		SkipReplayGain(chunk);
+	}
+
+	return cached_data->data;
+}
+
+inline std::span<const std::byte>
+AudioOutputSource::CachedFilterChunk(const MusicChunk &chunk)
+{
+	assert(filter_cache != nullptr);
+	assert(share_filter);
+
+	auto key = GetPreFilterKey();
+	key.out_audio_format = out_audio_format;
+
+	if (auto entry = filter_cache->Get(chunk, key)) {
+		/* another output with the same format has already
+		   converted this chunk */
+		SkipReplayGain(chunk);
+		cached_data = std::move(entry);
+		return cached_data->data;
+	}
+
+	const auto src = NeedsPreFilter(chunk)
+		? CachedPreFilterChunk(chunk)
+		: PreFilterChunk(chunk);
+	if (src.empty())
+		return src;
+
+	const auto data = filter->FilterPCM(src);
+	if (data.empty())
+		return data;
+
+	if (auto entry = filter_cache->Put(chunk, key, data)) {
+		cached_data = std::move(entry);
+		return cached_data->data;
+	}
+
+	/* the cache is full */
+	return data;
+}
+
+inline std::span<const std::byte>
+AudioOutputSource::FilterChunk(const MusicChunk &chunk)
+{
+	assert(filter);
+	assert(!filter_flushed);
+
+	if (replay_gain_filter)
+		/* while cross-fading, each song needs its own replay
+		   gain before they get mixed, so it cannot be left to
+		   the VolumeFilter */
+		replay_gain_filter_set_fused(*replay_gain_filter,
+					     chunk.other == nullptr);
+
+	if (identity_filter) {
+		/* apply the chunk's ReplayGain settings first,
+		   because they decide whether the ReplayGainFilter
+		   is an identity */
+		SkipReplayGain(chunk);
+
+		bit_perfect = CanBypassFilter(chunk);
+		if (bit_perfect)
+			/* zero-copy: pass the chunk data straight to
+			   the device */
+			return chunk.ReadData();
+	} else
+		bit_perfect = false;
+
+	std::span<const std::byte> data;
+
+	if (filter_cache != nullptr && share_filter) {
+		data = CachedFilterChunk(chunk);
+	} else {
+		data = filter_cache != nullptr && NeedsPreFilter(chunk)
+			? CachedPreFilterChunk(chunk)
+			: PreFilterChunk(chunk);
+		if (data.empty())
+			return data;
+
+		/* apply filter chain */
+
+		data = filter->FilterPCM(data);
+	}
+
+	if (post_filter && !data.empty())
+		data = post_filter->FilterPCM(data);
+
+	return data;
+}
+
+inline std::span<const std::byte>
+AudioOutputSource::ReadMore()
+{
+	if (post_filter) {
+		if (auto result = post_filter->ReadMore(); !result.empty())
+			return result;
+	}
+
+	auto result = filter->ReadMore();
+	if (post_filter && !result.empty())
+		result = post_filter->FilterPCM(result);
+
+	return result;
 }
 
 bool
@@ -219,6 +458,7 @@ AudioOutputSource::Fill(Mutex &mutex)
 		return false;
 
 	pending_tag = current_chunk->tag.get();
+	pending_submit_time = current_chunk->submit_time;
 
 	try {
 		/* release the mutex while the filter runs, because
@@ -228,6 +468,7 @@ AudioOutputSource::Fill(Mutex &mutex)
 		pending_data = FilterChunk(*current_chunk);
 	} catch (...) {
 		current_chunk = nullptr;
+		cached_data.reset();
 		throw;
 	}
 
@@ -245,7 +486,7 @@ AudioOutputSource::ConsumeData(size_t nbytes) noexcept
 	if (pending_data.empty()) {
 		/* give the filter a chance to return more data in
 		   another buffer */
-		pending_data = filter->ReadMore();
+		pending_data = ReadMore();
 
 		if (pending_data.empty())
 			DropCurrentChunk();
@@ -258,5 +499,15 @@ AudioOutputSource::Flush()
 	assert(filter);
 
 	filter_flushed = true;
-	return filter->Flush();
+
+	if (!post_filter)
+		return filter->Flush();
+
+	if (auto result = post_filter->ReadMore(); !result.empty())
+		return result;
+
+	if (auto result = filter->Flush(); !result.empty())
+		return post_filter->FilterPCM(result);
+
+	return post_filter->Flush();
 }
@@ -5,6 +5,7 @@
 #define AUDIO_OUTPUT_SOURCE_HXX
 
 #include "SharedPipeConsumer.hxx"
+#include "ChunkFilterCache.hxx"
 #include "ReplayGainMode.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "pcm/Buffer.hxx"
@@ -12,6 +13,7 @@
 #include "thread/Mutex.hxx"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <span>
@@ -67,6 +69,18 @@ class AudioOutputSource {
 	 */
 	std::unique_ptr<Filter> other_replay_gain_filter;
 
+	/**
+	 * Shares the ReplayGain and cross-fading results with other
+	 * outputs fed by the same #MusicPipe.  May be nullptr.
+	 */
+	ChunkFilterCache *filter_cache = nullptr;
+
+	/**
+	 * The #filter_cache entry of #current_chunk which is
+	 * referenced by #pending_data (or by the #filter output).
+	 */
+	std::shared_ptr<const ChunkFilterCache::Entry> cached_data;
+
 	/**
 	 * The buffer used to allocate the cross-fading result.
 	 */
@@ -83,12 +97,52 @@ class AudioOutputSource {
 	 */
 	std::unique_ptr<Filter> filter;
 
+	/**
+	 * An optional filter applied to the output of #filter (see
+	 * FilteredAudioOutput::prepared_post_filter).
+	 */
+	std::unique_ptr<Filter> post_filter;
+
+	/**
+	 * The #AudioFormat emitted by #filter after it has been
+	 * configured for the device.  Only valid if #share_filter is
+	 * set.
+	 */
+	AudioFormat out_audio_format = AudioFormat::Undefined();
+
+	/**
+	 * Look up the output of #filter in #filter_cache?  This is
+	 * only possible if it is a plain (stateless) conversion, see
+	 * OpenPostFilter().
+	 */
+	bool share_filter = false;
+
+	/**
+	 * Is the whole filter chain an identity, i.e. does it pass
+	 * #MusicChunk data unmodified to the device (as long as no
+	 * software ReplayGain and no cross-fading applies)?  See
+	 * OpenPostFilter().
+	 */
+	bool identity_filter = false;
+
+	/**
+	 * Was the data of the last #MusicChunk passed to the device
+	 * unmodified?  See IsBitPerfect().
+	 */
+	bool bit_perfect = false;
+
 	/**
 	 * The #MusicChunk currently being processed (see
 	 * #pending_tag, #pending_data).
 	 */
 	const MusicChunk *current_chunk = nullptr;
 
+	/**
+	 * A copy of MusicChunkInfo::submit_time of #current_chunk
+	 * until TakeSubmitTime() is called.
+	 */
+	std::chrono::steady_clock::time_point pending_submit_time;
+
 	/**
 	 * The #Tag to be processed by the #AudioOutput.  It is owned
 	 * by #current_chunk (MusicChunk::tag).
@@ -128,7 +182,21 @@ public:
 		return in_audio_format;
 	}
 
+	/**
+	 * Was the data of the last chunk returned by Fill() passed
+	 * to the device unmodified, i.e. without conversion,
+	 * software volume, ReplayGain, cross-fading or other
+	 * filters?
+	 */
+	bool IsBitPerfect() const noexcept {
+		return bit_perfect;
+	}
+
+	/**
+	 * @param _filter_cache see #filter_cache
+	 */
 	AudioFormat Open(AudioFormat audio_format, const MusicPipe &_pipe,
+			 ChunkFilterCache *_filter_cache,
 			 PreparedFilter *prepared_replay_gain_filter,
 			 PreparedFilter *prepared_other_replay_gain_filter,
 			 PreparedFilter &prepared_filter);
@@ -136,6 +204,36 @@ public:
 	void Close() noexcept;
 	void Cancel() noexcept;
 
+	/**
+	 * To be called after the device has been opened and the
+	 * #ConvertFilter has been configured.
+	 *
+	 * Throws on error.
+	 *
+	 * @param prepared_post_filter see
+	 * FilteredAudioOutput::prepared_post_filter (may be nullptr)
+	 * @param filter_out_format the #AudioFormat returned by
+	 * Open()
+	 * @param _out_audio_format the #AudioFormat of the device
+	 * @param may_share true if the filter chain consists of
+	 * nothing but the #ConvertFilter (see
+	 * FilteredAudioOutput::share_filter)
+	 */
+	void OpenPostFilter(PreparedFilter *prepared_post_filter,
+			    AudioFormat filter_out_format,
+			    AudioFormat _out_audio_format,
+			    bool may_share);
+
+	/**
+	 * Returns the duration of the audio data in the #MusicPipe
+	 * which has not been played by this output yet.
+	 *
+	 * Caller must lock the mutex which protects the
+	 * #SharedPipeConsumer.
+	 */
+	[[gnu::pure]]
+	std::chrono::steady_clock::duration GetPipeLag() const noexcept;
+
 	/**
 	 * Ensure that ReadTag() or PeekData() return any input.
 	 *
@@ -176,6 +274,16 @@ public:
 	 */
 	void ConsumeData(size_t nbytes) noexcept;
 
+	/**
+	 * Returns the time when the decoder has submitted the current
+	 * chunk (see MusicChunkInfo::submit_time), but only once per
+	 * chunk; all further calls return a default-constructed
+	 * value.
+	 */
+	std::chrono::steady_clock::time_point TakeSubmitTime() noexcept {
+		return std::exchange(pending_submit_time, {});
+	}
+
 	bool IsChunkConsumed(const MusicChunk &chunk) const  noexcept {
 		assert(IsOpen());
 
@@ -199,15 +307,73 @@ private:
 
 	void CloseFilter() noexcept;
 
+	/**
+	 * Pass the ReplayGain settings of the chunk to the filter.
+	 */
+	void UpdateReplayGain(const MusicChunk &chunk,
+			      Filter &replay_gain_filter,
+			      unsigned *replay_gain_serial_p) noexcept;
+
 	std::span<const std::byte> GetChunkData(const MusicChunk &chunk,
 						Filter *replay_gain_filter,
 						unsigned *replay_gain_serial_p);
 
+	/**
+	 * Apply ReplayGain and cross-fading to the chunk (the part
+	 * which can be shared with other outputs).
+	 */
+	std::span<const std::byte> PreFilterChunk(const MusicChunk &chunk);
+
+	/**
+	 * Does PreFilterChunk() modify the chunk data, i.e. is it
+	 * worth looking it up in #filter_cache?
+	 */
+	[[gnu::pure]]
+	bool NeedsPreFilter(const MusicChunk &chunk) const noexcept;
+
+	/**
+	 * Can the chunk data be passed to the device as-is, without
+	 * invoking any filter?
+	 */
+	[[gnu::pure]]
+	bool CanBypassFilter(const MusicChunk &chunk) const noexcept;
+
+	/**
+	 * Returns the #filter_cache key for the result of
+	 * PreFilterChunk().
+	 */
+	[[gnu::pure]]
+	ChunkFilterCache::Key GetPreFilterKey() const noexcept;
+
+	/**
+	 * Keep the ReplayGain filters (and their hardware mixers) up
+	 * to date if another output has done the work.
+	 */
+	void SkipReplayGain(const MusicChunk &chunk) noexcept;
+
+	/**
+	 * Like PreFilterChunk(), but use #filter_cache.
+	 */
+	std::span<const std::byte> CachedPreFilterChunk(const MusicChunk &chunk);
+
+	/**
+	 * Apply PreFilterChunk() and #filter, using #filter_cache
+	 * for the result of #filter (see #share_filter).
+	 */
+	std::span<const std::byte> CachedFilterChunk(const MusicChunk &chunk);
+
 	std::span<const std::byte> FilterChunk(const MusicChunk &chunk);
 
+	/**
+	 * Wrapper for Filter::ReadMore() which passes the result
+	 * through #post_filter.
+	 */
+	std::span<const std::byte> ReadMore();
+
 	void DropCurrentChunk() noexcept {
 		assert(current_chunk != nullptr);
 
+		cached_data.reset();
 		pipe.Consume(*std::exchange(current_chunk, nullptr));
 	}
 };
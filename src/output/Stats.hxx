@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "time/DurationHistogram.hxx"
+
+#include <array>
+#include <chrono>
+
+inline constexpr std::array<std::chrono::microseconds, 7> audio_output_play_limits{
+	std::chrono::milliseconds{1},
+	std::chrono::milliseconds{2},
+	std::chrono::milliseconds{5},
+	std::chrono::milliseconds{10},
+	std::chrono::milliseconds{20},
+	std::chrono::milliseconds{50},
+	std::chrono::milliseconds{100},
+};
+
+/**
+ * A histogram of AudioOutput::Play() durations.  For devices which
+ * block until the hardware has made room, this shows how regularly
+ * the output thread gets woken up, i.e. the scheduling jitter.
+ */
+using AudioOutputPlayHistogram =
+	DurationHistogram<audio_output_play_limits.size(),
+			  audio_output_play_limits>;
+
+inline constexpr std::array<std::chrono::microseconds, 8> audio_output_filter_limits{
+	std::chrono::microseconds{100},
+	std::chrono::microseconds{200},
+	std::chrono::microseconds{500},
+	std::chrono::milliseconds{1},
+	std::chrono::milliseconds{2},
+	std::chrono::milliseconds{5},
+	std::chrono::milliseconds{10},
+	std::chrono::milliseconds{20},
+};
+
+/**
+ * A histogram of the durations of the filter chain runs (one per
+ * #MusicChunk).
+ */
+using AudioOutputFilterHistogram =
+	DurationHistogram<audio_output_filter_limits.size(),
+			  audio_output_filter_limits>;
+
+inline constexpr std::array<std::chrono::microseconds, 10> audio_output_residency_limits{
+	std::chrono::milliseconds{10},
+	std::chrono::milliseconds{50},
+	std::chrono::milliseconds{100},
+	std::chrono::milliseconds{200},
+	std::chrono::milliseconds{500},
+	std::chrono::seconds{1},
+	std::chrono::seconds{2},
+	std::chrono::seconds{5},
+	std::chrono::seconds{10},
+	std::chrono::seconds{30},
+};
+
+/**
+ * A histogram of the time from the decoder's submission of a
+ * #MusicChunk (see MusicChunkInfo::submit_time) until its audio data
+ * is passed to AudioOutput::Play().  This is the latency of the
+ * whole audio path: the decoder's and the player's #MusicPipe,
+ * cross-fading and the filter chain.
+ */
+using AudioOutputResidencyHistogram =
+	DurationHistogram<audio_output_residency_limits.size(),
+			  audio_output_residency_limits>;
+
+/**
+ * Performance counters of one #AudioOutputControl, reported by the
+ * "outputstats" command.  They describe how close the output is to
+ * an underrun and where the output thread spends its time.
+ */
+struct AudioOutputStats {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The most recent value returned by AudioOutput::Delay().
+	 */
+	Duration delay{};
+
+	/**
+	 * The time spent in the filter chain (including waiting for
+	 * the #MusicPipe lock).
+	 */
+	AudioOutputFilterHistogram filter;
+
+	AudioOutputPlayHistogram play;
+
+	AudioOutputResidencyHistogram residency;
+
+	/**
+	 * The duration of the audio data in the #MusicPipe which
+	 * this output has not played yet.  This is only filled by
+	 * AudioOutputControl::LockGetStats().
+	 */
+	Duration pipe_lag{};
+
+	/**
+	 * Counters from AudioOutput::GetDeviceStats().
+	 */
+	unsigned xruns = 0, recoveries = 0;
+};
@@ -13,6 +13,7 @@
 #include "thread/ScopeUnlock.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
+#include "system/Probe.hxx"
 #include "util/StringBuffer.hxx"
 #include "util/ScopeExit.hxx"
 #include "Log.hxx"
@@ -26,6 +27,7 @@ AudioOutputControl::CommandFinished() noexcept
 {
 	assert(command != Command::NONE);
 	command = Command::NONE;
+	command_pending.store(false, std::memory_order_relaxed);
 
 	client_cond.notify_one();
 }
@@ -64,6 +66,16 @@ AudioOutputControl::InternalOpen2(const AudioFormat in_audio_format)
 		}
 	}
 
+	try {
+		source.OpenPostFilter(output->prepared_post_filter.get(),
+				      in_audio_format,
+				      output->out_audio_format,
+				      output->share_filter);
+	} catch (...) {
+		InternalCloseOutput(false);
+		throw;
+	}
+
 	{
 		const ScopeUnlock unlock(mutex);
 		output->OpenSoftwareMixer();
@@ -110,7 +122,8 @@ AudioOutputControl::InternalDisable() noexcept
 
 inline void
 AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
-				 const MusicPipe &pipe) noexcept
+				 const MusicPipe &pipe,
+				 ChunkFilterCache *filter_cache) noexcept
 {
 	should_reopen = false;
 
@@ -127,7 +140,7 @@ AudioOutputControl::InternalOpen(const AudioFormat in_audio_format,
 
 	try {
 		try {
-			f = source.Open(in_audio_format, pipe,
+			f = source.Open(in_audio_format, pipe, filter_cache,
 					output->prepared_replay_gain_filter.get(),
 					output->prepared_other_replay_gain_filter.get(),
 					*output->prepared_filter);
@@ -201,6 +214,7 @@ AudioOutputControl::WaitForDelay(std::unique_lock<Mutex> &lock) noexcept
 {
 	while (true) {
 		const auto delay = output->Delay();
+		stats.delay = delay;
 		if (delay <= std::chrono::steady_clock::duration::zero())
 			return true;
 
@@ -219,7 +233,13 @@ AudioOutputControl::FillSourceOrClose() noexcept
 try {
 	assert(source_state == SourceState::OPEN);
 
-	return source.Fill(mutex);
+	const auto start = std::chrono::steady_clock::now();
+	if (!source.Fill(mutex))
+		return false;
+
+	stats.filter.Add(std::chrono::steady_clock::now() - start);
+	bit_perfect = source.IsBitPerfect();
+	return true;
 } catch (...) {
 	FmtError(output_domain,
 		 "Failed to filter for {}: {}",
@@ -228,6 +248,45 @@ try {
 	return false;
 }
 
+inline std::size_t
+AudioOutputControl::PlayUnlocked(std::span<const std::byte> buffer,
+				 AudioOutputPlayHistogram &histogram,
+				 bool &interrupted)
+{
+	/* with small device periods, Play() returns after each
+	   period; keep writing without the mutex (which would
+	   otherwise be locked and unlocked for each period) until
+	   the whole filtered buffer is consumed */
+	std::size_t consumed = 0;
+
+	do {
+		const auto start = std::chrono::steady_clock::now();
+		std::size_t nbytes;
+		try {
+			nbytes = output->Play(buffer.subspan(consumed));
+		} catch (AudioOutputInterrupted) {
+			if (consumed == 0)
+				throw;
+
+			/* the bytes written by earlier iterations
+			   must still be consumed, or the device
+			   would play them again after resuming */
+			interrupted = true;
+			break;
+		}
+
+		histogram.Add(std::chrono::steady_clock::now() - start);
+
+		assert(nbytes > 0);
+		assert(nbytes <= buffer.size() - consumed);
+		consumed += nbytes;
+	} while (consumed < buffer.size() &&
+		 !command_pending.load(std::memory_order_relaxed) &&
+		 output->Delay() <= std::chrono::steady_clock::duration::zero());
+
+	return consumed;
+}
+
 inline bool
 AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 {
@@ -261,13 +320,22 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 		else if (!WaitForDelay(lock))
 			break;
 
+		/* the first data of a new chunk is about to be
+		   written to the device */
+		if (const auto submit_time = source.TakeSubmitTime();
+		    submit_time != std::chrono::steady_clock::time_point{})
+			stats.residency.Add(std::chrono::steady_clock::now() - submit_time);
+
 		size_t nbytes;
+		bool interrupted = false;
+		AudioOutputPlayHistogram histogram;
+		AtScopeExit(this, &histogram) {
+			stats.play.Add(histogram);
+		};
 
 		try {
 			const ScopeUnlock unlock{lock};
-			nbytes = output->Play(data);
-			assert(nbytes > 0);
-			assert(nbytes <= data.size());
+			nbytes = PlayUnlocked(data, histogram, interrupted);
 		} catch (AudioOutputInterrupted) {
 			caught_interrupted = true;
 			return false;
@@ -281,10 +349,18 @@ AudioOutputControl::PlayChunk(std::unique_lock<Mutex> &lock) noexcept
 
 		assert(nbytes % output->out_audio_format.GetFrameSize() == 0);
 
+		MPD_PROBE(output_play_chunk, GetName().c_str(),
+			  data.size(), nbytes);
+
 		source.ConsumeData(nbytes);
 
 		/* there's data to be drained from now on */
 		playing = true;
+
+		if (interrupted) {
+			caught_interrupted = true;
+			return false;
+		}
 	}
 
 	return true;
@@ -436,6 +512,14 @@ AudioOutputControl::Task() noexcept
 {
 	FmtThreadName("output:{}", GetName());
 
+	try {
+		cpu_affinity.Apply();
+	} catch (...) {
+		FmtError(output_domain,
+			 "Failed to set the CPU affinity of {}: {}",
+			 GetLogName(), std::current_exception());
+	}
+
 	try {
 		SetThreadRealtime();
 	} catch (...) {
@@ -476,7 +560,8 @@ AudioOutputControl::Task() noexcept
 			break;
 
 		case Command::OPEN:
-			InternalOpen(request.audio_format, *request.pipe);
+			InternalOpen(request.audio_format, *request.pipe,
+				     request.filter_cache);
 			CommandFinished();
 			break;
 
@@ -140,6 +140,26 @@ class AlsaOutput final
 	/** the mode flags passed to snd_pcm_open */
 	const int mode;
 
+	/**
+	 * The "mmap" setting: try to use SND_PCM_ACCESS_MMAP_INTERLEAVED.
+	 */
+	const bool mmap_setting;
+
+	/**
+	 * Is the PCM currently configured for mmap access?  In this
+	 * mode, DispatchSockets() copies from #ring_buffer directly
+	 * into the ALSA buffer, skipping the #period_buffer and the
+	 * copy in snd_pcm_writei().
+	 */
+	bool use_mmap;
+
+	/**
+	 * In mmap mode, the PCM has to be started explicitly as soon
+	 * as snd_pcm_avail() drops to this value, i.e. when the start
+	 * threshold configured with snd_pcm_sw_params() is reached.
+	 */
+	snd_pcm_uframes_t start_avail_frames;
+
 #ifdef ENABLE_DSD
 	/**
 	 * Enable DSD over PCM according to the DoP standard?
@@ -233,6 +253,12 @@ class AlsaOutput final
 
 	std::atomic_bool paused;
 
+	/**
+	 * Counters for GetDeviceStats(), updated by Recover() in the
+	 * #EventLoop thread.
+	 */
+	std::atomic_uint n_xruns{0}, n_recoveries{0};
+
 public:
 	AlsaOutput(EventLoop &loop, const ConfigBlock &block);
 
@@ -279,6 +305,13 @@ private:
 	void Cancel() noexcept override;
 	bool Pause() noexcept override;
 
+	AudioOutputDeviceStats GetDeviceStats() const noexcept override {
+		return {
+			.xruns = n_xruns.load(std::memory_order_relaxed),
+			.recoveries = n_recoveries.load(std::memory_order_relaxed),
+		};
+	}
+
 	/**
 	 * Set up the snd_pcm_t object which was opened by the caller.
 	 * Set up the configured settings and the audio format.
@@ -369,6 +402,16 @@ private:
 
 	snd_pcm_sframes_t WriteFromPeriodBuffer() noexcept;
 
+	/**
+	 * In mmap mode: copy as many whole frames as possible from
+	 * #ring_buffer directly into the ALSA buffer.
+	 *
+	 * @return the number of frames written, 0 if the
+	 * #ring_buffer is empty, -EAGAIN if the ALSA buffer is full
+	 * or a negative error code
+	 */
+	snd_pcm_sframes_t WriteFromRingMmap() noexcept;
+
 	void LockCaughtError() noexcept {
 		period_buffer.Clear();
 
@@ -435,6 +478,7 @@ AlsaOutput::AlsaOutput(EventLoop &_loop, const ConfigBlock &block)
 					    MPD_ALSA_BUFFER_TIME_US)),
 	 period_time(block.GetPositiveValue("period_time", 0U)),
 	 mode(GetAlsaOpenMode(block)),
+	 mmap_setting(block.GetBlockValue("mmap", false)),
 #ifdef ENABLE_DSD
 	 dop_setting(block.GetBlockValue("dop", false) ||
 		     /* legacy name from MPD 0.18 and older: */
@@ -548,20 +592,26 @@ AlsaOutput::Setup(AudioFormat &audio_format,
 {
 	const auto hw_result = Alsa::SetupHw(pcm,
 					     buffer_time, period_time,
+					     mmap_setting,
 					     audio_format, params);
 
 	FmtDebug(alsa_output_domain, "format={} ({})",
 		 snd_pcm_format_name(hw_result.format),
 		 snd_pcm_format_description(hw_result.format));
 
-	FmtDebug(alsa_output_domain, "buffer_size={} period_size={}",
+	FmtDebug(alsa_output_domain, "buffer_size={} period_size={} mmap={}",
 		 hw_result.buffer_size,
-		 hw_result.period_size);
+		 hw_result.period_size,
+		 hw_result.mmap);
 
 	Alsa::SetupChannelMap(pcm, audio_format.channels, params);
 
-	AlsaSetupSw(pcm, hw_result.buffer_size - hw_result.period_size,
-		    hw_result.period_size);
+	const snd_pcm_uframes_t start_threshold =
+		hw_result.buffer_size - hw_result.period_size;
+	AlsaSetupSw(pcm, start_threshold, hw_result.period_size);
+
+	use_mmap = hw_result.mmap;
+	start_avail_frames = hw_result.buffer_size - start_threshold;
 
 	auto alsa_period_size = hw_result.period_size;
 	if (alsa_period_size == 0)
@@ -893,6 +943,7 @@ inline int
 AlsaOutput::Recover(int err) noexcept
 {
 	if (err == -EPIPE) {
+		n_xruns.fetch_add(1, std::memory_order_relaxed);
 		FmtDebug(alsa_output_domain,
 			 "Underrun on ALSA device {:?}",
 			 GetDevice());
@@ -939,6 +990,9 @@ AlsaOutput::Recover(int err) noexcept
 		break;
 	}
 
+	if (err >= 0)
+		n_recoveries.fetch_add(1, std::memory_order_relaxed);
+
 	return err;
 }
 
@@ -968,8 +1022,11 @@ AlsaOutput::WriteFromPeriodBuffer() noexcept
 	assert(period_buffer.IsFull());
 	assert(period_buffer.GetFrames(out_frame_size) > 0);
 
-	auto frames_written = snd_pcm_writei(pcm, period_buffer.GetHead(),
-					     period_buffer.GetFrames(out_frame_size));
+	auto frames_written = use_mmap
+		? snd_pcm_mmap_writei(pcm, period_buffer.GetHead(),
+				      period_buffer.GetFrames(out_frame_size))
+		: snd_pcm_writei(pcm, period_buffer.GetHead(),
+				 period_buffer.GetFrames(out_frame_size));
 	if (frames_written > 0) {
 		written = true;
 		period_buffer.ConsumeFrames(frames_written,
@@ -979,6 +1036,78 @@ AlsaOutput::WriteFromPeriodBuffer() noexcept
 	return frames_written;
 }
 
+snd_pcm_sframes_t
+AlsaOutput::WriteFromRingMmap() noexcept
+{
+	assert(use_mmap);
+	assert(period_buffer.IsCleared());
+
+	snd_pcm_uframes_t ring_frames = ring_buffer.ReadAvailable() / out_frame_size;
+	if (ring_frames == 0)
+		return 0;
+
+	const snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return avail;
+
+	if (avail == 0)
+		return -EAGAIN;
+
+	snd_pcm_sframes_t total = 0;
+
+	/* the mmap area may wrap around, so this may need two
+	   snd_pcm_mmap_begin() calls */
+	snd_pcm_uframes_t remaining = std::min<snd_pcm_uframes_t>(ring_frames,
+								   avail);
+	while (remaining > 0) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, frames = remaining;
+		int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+		if (err < 0)
+			return err;
+
+		if (frames == 0)
+			break;
+
+		/* interleaved: all channels share one area, and
+		   "step" is the frame size in bits */
+		auto *dest = static_cast<std::byte *>(areas[0].addr) +
+			(areas[0].first + offset * areas[0].step) / 8;
+
+		const std::size_t nbytes = ring_buffer.ReadTo({dest, frames * out_frame_size});
+		assert(nbytes == frames * out_frame_size);
+		(void)nbytes;
+
+		const auto committed = snd_pcm_mmap_commit(pcm, offset, frames);
+		if (committed < 0)
+			return committed;
+
+		total += committed;
+		remaining -= frames;
+	}
+
+	if (total > 0) {
+		written = true;
+
+		{
+			const std::lock_guard lock{mutex};
+			/* notify the OutputThread that there is now
+			   room in ring_buffer */
+			cond.notify_one();
+		}
+
+		/* unlike snd_pcm_writei(), committing doesn't start
+		   the PCM automatically */
+		if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED &&
+		    snd_pcm_uframes_t(avail - total) <= start_avail_frames) {
+			if (int err = snd_pcm_start(pcm); err < 0)
+				return err;
+		}
+	}
+
+	return total;
+}
+
 inline bool
 AlsaOutput::DrainInternal()
 {
@@ -1284,6 +1413,27 @@ try {
 		}
 	}
 
+	if (use_mmap && period_buffer.IsCleared()) {
+		/* zero-copy fast path: copy from the ring buffer
+		   straight into the ALSA buffer */
+		const auto frames_written = WriteFromRingMmap();
+		if (frames_written > 0 || frames_written == -EAGAIN ||
+		    frames_written == -EINTR)
+			return;
+
+		if (frames_written < 0) {
+			if (Recover(frames_written) < 0)
+				throw Alsa::MakeError(frames_written,
+						      "snd_pcm_mmap_commit() failed");
+
+			return;
+		}
+
+		/* the ring buffer is empty: fall back to the code
+		   below, which decides whether to wait or to
+		   generate silence */
+	}
+
 	CopyRingToPeriodBuffer();
 
 	if (!period_buffer.IsFull()) {
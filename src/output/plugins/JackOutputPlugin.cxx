@@ -8,9 +8,11 @@
 #include "output/Features.h"
 #include "lib/fmt/RuntimeError.hxx"
 #include "thread/Mutex.hxx"
+#include "util/Compiler.h"
 #include "util/ScopeExit.hxx"
 #include "util/IterableSplitString.hxx"
 #include "util/SpanCast.hxx"
+#include "util/RingBuffer.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -20,7 +22,6 @@
 
 #include <jack/jack.h>
 #include <jack/types.h>
-#include <jack/ringbuffer.h>
 
 #include <unistd.h> /* for usleep() */
 #include <stdlib.h>
@@ -57,7 +58,15 @@ class JackOutput final : public AudioOutput {
 	/* jack library stuff */
 	jack_port_t *ports[MAX_PORTS];
 	jack_client_t *client;
-	jack_ringbuffer_t *ringbuffer[MAX_PORTS];
+
+	/**
+	 * Interleaved samples of all channels.  Play() copies the
+	 * input into it as-is, and the "process" callback
+	 * deinterleaves directly into the port buffers; this needs
+	 * only one pass over the data and one pair of atomic
+	 * operations per period for all ports.
+	 */
+	RingBuffer<float> ring;
 
 	/**
 	 * While this flag is set, the "process" callback generates
@@ -120,13 +129,6 @@ private:
 	void Start();
 	void Stop() noexcept;
 
-	/**
-	 * Determine the number of frames guaranteed to be available
-	 * on all channels.
-	 */
-	[[gnu::pure]]
-	jack_nframes_t GetAvailable() const noexcept;
-
 	void Process(jack_nframes_t nframes);
 	static int Process(jack_nframes_t nframes, void *arg) noexcept {
 		auto &j = *(JackOutput *)arg;
@@ -135,9 +137,13 @@ private:
 	}
 
 	/**
-	 * @return the number of frames that were written
+	 * Copy samples from the ring buffer to the given port
+	 * buffers.
+	 *
+	 * @return the number of frames that were copied
 	 */
-	size_t WriteSamples(const float *src, size_t n_frames);
+	jack_nframes_t ReadSamples(float *const*dest,
+				   jack_nframes_t nframes) noexcept;
 
 public:
 	/* virtual methods from class AudioOutput */
@@ -248,31 +254,41 @@ JackOutput::JackOutput(const ConfigBlock &block)
 	ringbuffer_size = block.GetPositiveValue("ringbuffer_size", 32768U);
 }
 
-inline jack_nframes_t
-JackOutput::GetAvailable() const noexcept
-{
-	size_t min = jack_ringbuffer_read_space(ringbuffer[0]);
-
-	for (unsigned i = 1; i < audio_format.channels; ++i) {
-		size_t current = jack_ringbuffer_read_space(ringbuffer[i]);
-		if (current < min)
-			min = current;
-	}
-
-	assert(min % jack_sample_size == 0);
-
-	return min / jack_sample_size;
-}
-
 /**
- * Call jack_ringbuffer_read_advance() on all buffers in the list.
+ * Copy interleaved frames to separate (planar) port buffers.  Each
+ * destination buffer is written sequentially.
+ *
+ * @param offset the number of frames to skip in each destination
+ * buffer
  */
 static void
-MultiReadAdvance(std::span<jack_ringbuffer_t *const> buffers,
-		 size_t size)
+Deinterleave(float *const*dest, std::size_t offset,
+	     const float *src, std::size_t n_frames,
+	     unsigned n_channels) noexcept
 {
-	for (auto *i : buffers)
-		jack_ringbuffer_read_advance(i, size);
+	switch (n_channels) {
+	case 1:
+		std::copy_n(src, n_frames, dest[0] + offset);
+		return;
+
+	case 2: {
+		float *gcc_restrict left = dest[0] + offset;
+		float *gcc_restrict right = dest[1] + offset;
+		for (std::size_t i = 0; i < n_frames; ++i) {
+			left[i] = src[2 * i];
+			right[i] = src[2 * i + 1];
+		}
+
+		return;
+	}
+	}
+
+	for (unsigned c = 0; c < n_channels; ++c) {
+		float *gcc_restrict d = dest[c] + offset;
+		const float *s = src + c;
+		for (std::size_t i = 0; i < n_frames; ++i)
+			d[i] = s[i * n_channels];
+	}
 }
 
 /**
@@ -303,30 +319,39 @@ MultiWriteSilence(std::span<jack_port_t *const> ports, jack_nframes_t nframes)
 		WriteSilence(*i, nframes);
 }
 
-/**
- * Copy data from the buffer to the port.  If the buffer underruns,
- * fill with silence.
- */
-static void
-Copy(jack_port_t &dest, jack_nframes_t nframes,
-     jack_ringbuffer_t &src, jack_nframes_t available)
+inline jack_nframes_t
+JackOutput::ReadSamples(float *const*dest, jack_nframes_t nframes) noexcept
 {
-	auto *out =
-		(jack_default_audio_sample_t *)
-		jack_port_get_buffer(&dest, nframes);
-	if (out == nullptr)
-		/* workaround for libjack1 bug: if the server
-		   connection fails, the process callback is
-		   invoked anyway, but unable to get a
+	const unsigned n_channels = audio_format.channels;
+
+	jack_nframes_t n = 0;
+	while (n < nframes) {
+		const auto r = ring.Read();
+		const std::size_t n_frames =
+			std::min<std::size_t>(r.size() / n_channels,
+					      nframes - n);
+		if (n_frames > 0) {
+			Deinterleave(dest, n, r.data(), n_frames, n_channels);
+			ring.Consume(n_frames * n_channels);
+			n += n_frames;
+			continue;
+		}
+
+		if (r.empty())
+			/* underrun */
+			break;
+
+		/* the next frame wraps around the end of the ring
 		   buffer */
-		return;
+		float frame[MAX_CHANNELS];
+		if (ring.ReadFramesTo({frame, n_channels}, n_channels) == 0)
+			break;
 
-	/* copy from buffer to port */
-	jack_ringbuffer_read(&src, (char *)out,
-			     available * jack_sample_size);
+		Deinterleave(dest, n, frame, 1, n_channels);
+		++n;
+	}
 
-	/* ringbuffer underrun, fill with silence */
-	std::fill(out + available, out + nframes, 0.0);
+	return n;
 }
 
 inline void
@@ -335,15 +360,12 @@ JackOutput::Process(jack_nframes_t nframes)
 	if (nframes <= 0)
 		return;
 
-	jack_nframes_t available = GetAvailable();
-
 	const unsigned n_channels = audio_format.channels;
 
 	if (pause) {
-		/* empty the ring buffers */
+		/* empty the ring buffer */
 
-		MultiReadAdvance({ringbuffer, n_channels},
-				 available * jack_sample_size);
+		ring.Discard();
 
 		/* generate silence while MPD is paused */
 
@@ -352,11 +374,23 @@ JackOutput::Process(jack_nframes_t nframes)
 		return;
 	}
 
-	if (available > nframes)
-		available = nframes;
+	float *out[MAX_CHANNELS];
+	for (unsigned i = 0; i < n_channels; ++i) {
+		out[i] = (jack_default_audio_sample_t *)
+			jack_port_get_buffer(ports[i], nframes);
+		if (out[i] == nullptr)
+			/* workaround for libjack1 bug: if the server
+			   connection fails, the process callback is
+			   invoked anyway, but unable to get a
+			   buffer */
+			return;
+	}
+
+	const jack_nframes_t available = ReadSamples(out, nframes);
 
+	/* ring buffer underrun, fill with silence */
 	for (unsigned i = 0; i < n_channels; ++i)
-		Copy(*ports[i], nframes, *ringbuffer[i], available);
+		std::fill(out[i] + available, out[i] + nframes, 0.0f);
 
 	/* generate silence for the unused source ports */
 
@@ -425,9 +459,6 @@ mpd_jack_test_default_device()
 inline void
 JackOutput::Enable()
 {
-	for (unsigned i = 0; i < num_source_ports; ++i)
-		ringbuffer[i] = nullptr;
-
 	Connect();
 }
 
@@ -437,12 +468,7 @@ JackOutput::Disable() noexcept
 	if (client != nullptr)
 		Disconnect();
 
-	for (unsigned i = 0; i < num_source_ports; ++i) {
-		if (ringbuffer[i] != nullptr) {
-			jack_ringbuffer_free(ringbuffer[i]);
-			ringbuffer[i] = nullptr;
-		}
-	}
+	ring = {};
 }
 
 static AudioOutput *
@@ -480,19 +506,17 @@ JackOutput::Start()
 	assert(client != nullptr);
 	assert(audio_format.channels <= num_source_ports);
 
-	/* allocate the ring buffers on the first open(); these
-	   persist until MPD exits.  It's too unsafe to delete them
-	   because we can never know when mpd_jack_process() gets
+	/* allocate the ring buffer on the first open(); it persists
+	   until the output is disabled.  It's too unsafe to delete
+	   it because we can never know when mpd_jack_process() gets
 	   called */
-	for (unsigned i = 0; i < num_source_ports; ++i) {
-		if (ringbuffer[i] == nullptr)
-			ringbuffer[i] =
-				jack_ringbuffer_create(ringbuffer_size);
+	if (!ring.IsDefined())
+		ring = RingBuffer<float>{ringbuffer_size / jack_sample_size
+					 * num_source_ports};
 
-		/* clear the ring buffer to be sure that data from
-		   previous playbacks are gone */
-		jack_ringbuffer_reset(ringbuffer[i]);
-	}
+	/* clear the ring buffer to be sure that data from
+	   previous playbacks are gone */
+	ring.Clear();
 
 	if ( jack_activate(client) ) {
 		Stop();
@@ -625,59 +649,15 @@ JackOutput::Interrupt() noexcept
 	interrupted = true;
 }
 
-inline size_t
-JackOutput::WriteSamples(const float *src, size_t n_frames)
-{
-	assert(n_frames > 0);
-
-	const unsigned n_channels = audio_format.channels;
-
-	float *dest[MAX_CHANNELS];
-	size_t space = SIZE_MAX;
-	for (unsigned i = 0; i < n_channels; ++i) {
-		jack_ringbuffer_data_t d[2];
-		jack_ringbuffer_get_write_vector(ringbuffer[i], d);
-
-		/* choose the first non-empty writable area */
-		const jack_ringbuffer_data_t &e = d[d[0].len == 0];
-
-		if (e.len < space)
-			/* send data symmetrically */
-			space = e.len;
-
-		dest[i] = (float *)e.buf;
-	}
-
-	space /= jack_sample_size;
-	if (space == 0)
-		return 0;
-
-	const size_t result = n_frames = std::min(space, n_frames);
-
-	while (n_frames-- > 0)
-		for (unsigned i = 0; i < n_channels; ++i)
-			*dest[i]++ = *src++;
-
-	const size_t per_channel_advance = result * jack_sample_size;
-	for (unsigned i = 0; i < n_channels; ++i)
-		jack_ringbuffer_write_advance(ringbuffer[i],
-					      per_channel_advance);
-
-	return result;
-}
-
 std::size_t
 JackOutput::Play(std::span<const std::byte> _src)
 {
-	const size_t frame_size = audio_format.GetFrameSize();
-	assert(_src.size() % frame_size == 0);
+	assert(_src.size() % audio_format.GetFrameSize() == 0);
 
 	const auto src = FromBytesStrict<const float>(_src);
 
 	pause = false;
 
-	const std::size_t n_frames = src.size() / audio_format.channels;
-
 	while (true) {
 		{
 			const std::lock_guard lock{mutex};
@@ -688,10 +668,10 @@ JackOutput::Play(std::span<const std::byte> _src)
 				throw AudioOutputInterrupted{};
 		}
 
-		size_t frames_written =
-			WriteSamples(src.data(), n_frames);
-		if (frames_written > 0)
-			return frames_written * frame_size;
+		const std::size_t n =
+			ring.WriteFramesFrom(src, audio_format.channels);
+		if (n > 0)
+			return n * jack_sample_size;
 
 		/* XXX do something more intelligent to
 		   synchronize */
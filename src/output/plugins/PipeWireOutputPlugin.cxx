@@ -9,9 +9,9 @@
 #include "mixer/plugins/PipeWireMixerPlugin.hxx"
 #include "pcm/Features.h" // for ENABLE_DSD
 #include "pcm/Silence.hxx"
+#include "pcm/DsdKernels.hxx"
 #include "lib/fmt/ExceptionFormatter.hxx"
 #include "system/Error.hxx"
-#include "util/BitReverse.hxx"
 #include "util/Domain.hxx"
 #include "util/RingBuffer.hxx"
 #include "util/ScopeExit.hxx"
@@ -61,11 +61,31 @@ class PipeWireOutput final : AudioOutput {
 	std::size_t frame_size;
 
 	/**
-	 * This buffer passes PCM data from Play() to Process().
+	 * This buffer passes PCM data from Play() to Process().  It
+	 * is not used in #direct mode.
 	 */
 	using RingBuffer = ::RingBuffer<std::byte>;
 	RingBuffer ring_buffer;
 
+	/**
+	 * In "direct" mode, this is the PipeWire buffer which was
+	 * dequeued by Play() and is being filled; nullptr if there is
+	 * none.
+	 */
+	struct pw_buffer *direct_buffer = nullptr;
+
+	/**
+	 * The number of bytes already written to #direct_buffer.
+	 */
+	std::size_t direct_fill;
+
+	/**
+	 * The number of bytes to be written to #direct_buffer before
+	 * it gets queued.  This is the quantum requested by
+	 * PipeWire (if known), or else the size of the buffer.
+	 */
+	std::size_t direct_size;
+
 	uint32_t target_id = PW_ID_ANY;
 
 	/**
@@ -116,6 +136,15 @@ class PipeWireOutput final : AudioOutput {
 	 */
 	const bool reconnect_stream;
 
+	/**
+	 * Configuration setting "direct": Play() writes into PipeWire
+	 * buffers instead of #ring_buffer, and the "process" callback
+	 * only wakes it up.  This saves one copy, and the latency is
+	 * determined by PipeWire's buffers instead of a 0.5 second
+	 * ring buffer.
+	 */
+	const bool direct;
+
 	bool disconnected;
 
 	/**
@@ -198,6 +227,20 @@ private:
 
 	void Process() noexcept;
 
+	/**
+	 * Dequeue a buffer for #direct_buffer.
+	 *
+	 * @return false if PipeWire has no free buffer right now
+	 */
+	bool DequeueDirect() noexcept;
+
+	/**
+	 * Pass #direct_buffer (with #direct_fill bytes) to PipeWire.
+	 */
+	void QueueDirect() noexcept;
+
+	std::size_t PlayDirect(std::span<const std::byte> src);
+
 	static void Process(void *data) noexcept {
 		auto &o = *(PipeWireOutput *)data;
 		o.Process();
@@ -298,7 +341,8 @@ PipeWireOutput::PipeWireOutput(const ConfigBlock &block)
 #if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
 	 enable_dsd(block.GetBlockValue("dsd", false)),
 #endif
-	 reconnect_stream(block.GetBlockValue("reconnect_stream", true))
+	 reconnect_stream(block.GetBlockValue("reconnect_stream", true)),
+	 direct(block.GetBlockValue("direct", false))
 {
 	if (target != nullptr) {
 		if (StringIsEmpty(target))
@@ -556,8 +600,11 @@ PipeWireOutput::Open(AudioFormat &audio_format)
 	channels = audio_format.channels;
 	interrupted = false;
 
-	/* allocate a ring buffer of 0.5 seconds */
-	ring_buffer = RingBuffer{frame_size * (audio_format.sample_rate / 2)};
+	direct_buffer = nullptr;
+
+	if (!direct)
+		/* allocate a ring buffer of 0.5 seconds */
+		ring_buffer = RingBuffer{frame_size * (audio_format.sample_rate / 2)};
 
 	const struct spa_pod *params[1];
 
@@ -589,8 +636,13 @@ PipeWireOutput::Open(AudioFormat &audio_format)
 
 	unsigned stream_flags = PW_STREAM_FLAG_AUTOCONNECT |
 		PW_STREAM_FLAG_INACTIVE |
-		PW_STREAM_FLAG_MAP_BUFFERS |
-		PW_STREAM_FLAG_RT_PROCESS;
+		PW_STREAM_FLAG_MAP_BUFFERS;
+
+	if (!direct)
+		stream_flags |= PW_STREAM_FLAG_RT_PROCESS;
+	/* else: Play() dequeues and queues buffers while holding the
+	   thread loop lock, which is only allowed if the "process"
+	   callback runs in the thread loop */
 
 	if (!reconnect_stream)
 		stream_flags |= PW_STREAM_FLAG_DONT_RECONNECT;
@@ -610,6 +662,7 @@ PipeWireOutput::Close() noexcept
 {
 	{
 		const PipeWire::ThreadLoopLock lock(thread_loop);
+		direct_buffer = nullptr;
 		pw_stream_destroy(stream);
 		stream = nullptr;
 	}
@@ -714,13 +767,6 @@ Interleave(std::byte *data, std::byte *end,
 	}
 }
 
-static void
-BitReverse(std::byte *data, std::size_t n) noexcept
-{
-	while (n-- > 0)
-		*data = BitReverse(*data);
-}
-
 static void
 PostProcessDsd(std::byte *data, struct spa_chunk &chunk, unsigned channels,
 	       bool reverse_bits, unsigned interleave) noexcept
@@ -735,7 +781,7 @@ PostProcessDsd(std::byte *data, struct spa_chunk &chunk, unsigned channels,
 	}
 
 	if (reverse_bits)
-		BitReverse(data, chunk.size);
+		GetPcmDsdKernels().bit_reverse(data, chunk.size);
 }
 
 #endif
@@ -743,6 +789,16 @@ PostProcessDsd(std::byte *data, struct spa_chunk &chunk, unsigned channels,
 inline void
 PipeWireOutput::Process() noexcept
 {
+	if (direct) {
+		/* Play() produces the buffers; just wake it up, a
+		   buffer may have been recycled */
+		if (drain_requested && direct_buffer == nullptr)
+			pw_stream_flush(stream, true);
+
+		pw_thread_loop_signal(thread_loop, false);
+		return;
+	}
+
 	if (drain_requested && ring_buffer.IsEmptyRelaxed()) {
 		/* draining was requested and our ring buffer is
 		   empty: tell PipeWire to drain (instead of queueing
@@ -813,6 +869,113 @@ PipeWireOutput::Delay() const noexcept
 	return result;
 }
 
+inline bool
+PipeWireOutput::DequeueDirect() noexcept
+{
+	assert(direct);
+	assert(direct_buffer == nullptr);
+
+	auto *b = pw_stream_dequeue_buffer(stream);
+	if (b == nullptr)
+		return false;
+
+	const auto &d = b->buffer->datas[0];
+	if (d.data == nullptr) {
+		/* not mapped; give it back */
+		d.chunk->size = 0;
+		pw_stream_queue_buffer(stream, b);
+		return false;
+	}
+
+	std::size_t chunk_size = frame_size;
+
+#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
+	if (use_dsd && dsd_interleave > 1)
+		/* make sure we don't get partial interleave frames */
+		chunk_size *= dsd_interleave;
+#endif
+
+	std::size_t size = d.maxsize;
+
+#if PW_CHECK_VERSION(0, 3, 49)
+	/* fill only as much as the graph consumes per cycle; this
+	   keeps the latency at the negotiated quantum instead of the
+	   (larger) buffer size */
+	if (b->requested > 0)
+		size = std::min<std::size_t>(size, b->requested * frame_size);
+#endif
+
+	size -= size % chunk_size;
+	if (size == 0) {
+		d.chunk->size = 0;
+		pw_stream_queue_buffer(stream, b);
+		return false;
+	}
+
+	direct_buffer = b;
+	direct_fill = 0;
+	direct_size = size;
+	return true;
+}
+
+inline void
+PipeWireOutput::QueueDirect() noexcept
+{
+	assert(direct_buffer != nullptr);
+	assert(direct_fill % frame_size == 0);
+
+	auto &d = direct_buffer->buffer->datas[0];
+
+	auto &chunk = *d.chunk;
+	chunk.offset = 0;
+	chunk.stride = frame_size;
+	chunk.size = direct_fill;
+
+#if defined(ENABLE_DSD) && defined(SPA_AUDIO_DSD_FLAG_NONE)
+	if (use_dsd)
+		PostProcessDsd(reinterpret_cast<std::byte *>(d.data), chunk,
+			       channels, dsd_reverse_bits, dsd_interleave);
+#endif
+
+	pw_stream_queue_buffer(stream, direct_buffer);
+	direct_buffer = nullptr;
+}
+
+inline std::size_t
+PipeWireOutput::PlayDirect(std::span<const std::byte> src)
+{
+	while (true) {
+		CheckThrowError();
+
+		if (direct_buffer != nullptr || DequeueDirect()) {
+			auto &d = direct_buffer->buffer->datas[0];
+			const std::size_t nbytes = std::min(src.size(),
+							    direct_size - direct_fill);
+			std::copy_n(src.data(), nbytes,
+				    reinterpret_cast<std::byte *>(d.data) + direct_fill);
+			direct_fill += nbytes;
+			drained = false;
+
+			if (direct_fill >= direct_size)
+				QueueDirect();
+
+			return nbytes;
+		}
+
+		if (!active) {
+			/* all buffers are filled, so let's resume
+			   the stream now */
+			active = true;
+			pw_stream_set_active(stream, true);
+		}
+
+		if (interrupted)
+			throw AudioOutputInterrupted{};
+
+		pw_thread_loop_wait(thread_loop);
+	}
+}
+
 std::size_t
 PipeWireOutput::Play(std::span<const std::byte> src)
 {
@@ -820,6 +983,9 @@ PipeWireOutput::Play(std::span<const std::byte> src)
 
 	paused = false;
 
+	if (direct)
+		return PlayDirect(src);
+
 	while (true) {
 		CheckThrowError();
 
@@ -853,6 +1019,12 @@ PipeWireOutput::Drain()
 	if (drained)
 		return;
 
+	if (direct_buffer != nullptr) {
+		/* submit the partially filled buffer */
+		direct_fill -= direct_fill % frame_size;
+		QueueDirect();
+	}
+
 	if (!active) {
 		/* there is data in the ring_buffer, but the stream is
 		   not yet active; activate it now to ensure it is
@@ -882,6 +1054,10 @@ PipeWireOutput::Cancel() noexcept
 	/* clear MPD's ring buffer */
 	ring_buffer.Clear();
 
+	/* discard the contents of the buffer being filled, but keep
+	   it for the next Play() call */
+	direct_fill = 0;
+
 	/* clear libpipewire's buffer */
 	pw_stream_flush(stream, false);
 	drained = true;
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "RecorderOutputPlugin.hxx"
+#include "RecorderWriter.hxx"
 #include "../OutputAPI.hxx"
 #include "lib/fmt/PathFormatter.hxx"
 #include "tag/Format.hxx"
@@ -11,7 +12,6 @@
 #include "config/Path.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
-#include "io/FileOutputStream.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
 
@@ -48,9 +48,15 @@ class RecorderOutput final : AudioOutput {
 	AudioFormat effective_audio_format;
 
 	/**
-	 * The destination file.
+	 * Writes the destination files in a separate thread.  It
+	 * exists while this output is open.
 	 */
-	FileOutputStream *file;
+	std::unique_ptr<RecorderWriter> writer;
+
+	/**
+	 * Is a destination file open, i.e. is the #encoder open?
+	 */
+	bool recording;
 
 	explicit RecorderOutput(const ConfigBlock &block);
 
@@ -110,26 +116,39 @@ RecorderOutput::RecorderOutput(const ConfigBlock &block)
 inline void
 RecorderOutput::EncoderToFile()
 {
-	assert(file != nullptr);
+	assert(recording);
 
-	EncoderToOutputStream(*file, *encoder);
+	EncoderToOutputStream(*writer, *encoder);
 }
 
 void
 RecorderOutput::Open(AudioFormat &audio_format)
 {
+	writer = std::make_unique<RecorderWriter>();
+
 	/* create the output file */
 
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
-		file = new FileOutputStream(path);
+		writer->Open(AllocatedPath{path});
+
+		try {
+			/* wait for the file to be created, to report
+			   errors right now */
+			writer->Drain();
+		} catch (...) {
+			writer.reset();
+			throw;
+		}
+
+		recording = true;
 	} else {
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
 		assert(path.IsNull());
 
-		file = nullptr;
+		recording = false;
 	}
 
 	/* open the encoder */
@@ -137,7 +156,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 	try {
 		encoder = prepared_encoder->Open(audio_format);
 	} catch (...) {
-		delete file;
+		writer.reset();
 		throw;
 	}
 
@@ -146,6 +165,7 @@ RecorderOutput::Open(AudioFormat &audio_format)
 			EncoderToFile();
 		} catch (...) {
 			delete encoder;
+			writer.reset();
 			throw;
 		}
 	} else {
@@ -176,21 +196,17 @@ RecorderOutput::Commit()
 	/* now really close everything */
 
 	delete encoder;
+	recording = false;
 
-	try {
-		file->Commit();
-	} catch (...) {
-		delete file;
-		throw;
-	}
-
-	delete file;
+	writer->Commit();
 }
 
 void
 RecorderOutput::Close() noexcept
 {
-	if (file == nullptr) {
+	AtScopeExit(this) { writer.reset(); };
+
+	if (!recording) {
 		/* not currently encoding to a file; nothing needs to
 		   be done now */
 		assert(HasDynamicPath());
@@ -200,6 +216,9 @@ RecorderOutput::Close() noexcept
 
 	try {
 		Commit();
+
+		/* wait until the file is complete */
+		writer->Drain();
 	} catch (...) {
 		LogError(std::current_exception());
 	}
@@ -215,16 +234,18 @@ RecorderOutput::FinishFormat()
 {
 	assert(HasDynamicPath());
 
-	if (file == nullptr)
+	if (!recording)
 		return;
 
+	/* the file is committed asynchronously by the writer
+	   thread */
 	try {
 		Commit();
 	} catch (...) {
 		LogError(std::current_exception());
 	}
 
-	file = nullptr;
+	recording = false;
 	path.SetNull();
 }
 
@@ -233,33 +254,28 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path)
 {
 	assert(HasDynamicPath());
 	assert(path.IsNull());
-	assert(file == nullptr);
-
-	auto *new_file = new FileOutputStream(new_path);
+	assert(!recording);
 
 	AudioFormat new_audio_format = effective_audio_format;
-
-	try {
-		encoder = prepared_encoder->Open(new_audio_format);
-	} catch (...) {
-		delete new_file;
-		throw;
-	}
+	encoder = prepared_encoder->Open(new_audio_format);
 
 	/* reopening the encoder must always result in the same
 	   AudioFormat as before */
 	assert(new_audio_format == effective_audio_format);
 
+	/* the file is created by the writer thread while this
+	   thread continues */
+	writer->Open(AllocatedPath{new_path});
+
 	try {
-		EncoderToOutputStream(*new_file, *encoder);
+		EncoderToOutputStream(*writer, *encoder);
 	} catch (...) {
 		delete encoder;
-		delete new_file;
 		throw;
 	}
 
 	path = std::move(new_path);
-	file = new_file;
+	recording = true;
 
 	FmtDebug(recorder_domain, "Recording to {:?}", path);
 }
@@ -309,7 +325,7 @@ RecorderOutput::SendTag(const Tag &tag)
 std::size_t
 RecorderOutput::Play(std::span<const std::byte> src)
 {
-	if (file == nullptr) {
+	if (!recording) {
 		/* not currently encoding to a file; discard incoming
 		   data */
 		assert(HasDynamicPath());
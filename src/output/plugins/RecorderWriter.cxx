@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "RecorderWriter.hxx"
+#include "io/FileOutputStream.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+/**
+ * The maximum amount of data in the queue; Write() blocks when it is
+ * full.
+ */
+static constexpr std::size_t RECORDER_QUEUE_SIZE = 4 * 1024 * 1024;
+
+/**
+ * Data is written to the file in multiples of this size.
+ */
+static constexpr std::size_t RECORDER_CHUNK_SIZE = 256 * 1024;
+
+/**
+ * Disk space is preallocated in steps of this size.
+ */
+static constexpr uint_least64_t RECORDER_PREALLOCATE_SIZE = 16 * 1024 * 1024;
+
+RecorderWriter::RecorderWriter()
+{
+	thread.Start();
+}
+
+RecorderWriter::~RecorderWriter() noexcept
+{
+	{
+		const std::scoped_lock lock{mutex};
+		queue.clear();
+		queued_bytes = 0;
+		quit = true;
+	}
+
+	work_cond.notify_one();
+	thread.Join();
+
+	/* cancel the uncommitted file */
+	file.reset();
+}
+
+inline void
+RecorderWriter::CheckError()
+{
+	if (error)
+		std::rethrow_exception(std::exchange(error, {}));
+}
+
+inline void
+RecorderWriter::Push(Item &&item) noexcept
+{
+	queued_bytes += item.data.size();
+	queue.emplace_back(std::move(item));
+	work_cond.notify_one();
+}
+
+void
+RecorderWriter::Open(AllocatedPath &&path)
+{
+	const std::scoped_lock lock{mutex};
+	Push({Item::Type::OPEN, std::move(path), {}});
+}
+
+void
+RecorderWriter::Commit()
+{
+	const std::scoped_lock lock{mutex};
+	CheckError();
+	Push({Item::Type::COMMIT, nullptr, {}});
+}
+
+void
+RecorderWriter::Drain()
+{
+	std::unique_lock lock{mutex};
+	client_cond.wait(lock, [this]{
+		return (queue.empty() && !busy) || error;
+	});
+
+	CheckError();
+}
+
+void
+RecorderWriter::Write(std::span<const std::byte> src)
+{
+	std::unique_lock lock{mutex};
+
+	/* block while the queue is full (but always accept data if
+	   it is empty, even if the chunk is larger than the limit) */
+	client_cond.wait(lock, [this, &src]{
+		return queued_bytes == 0 ||
+			queued_bytes + src.size() <= RECORDER_QUEUE_SIZE ||
+			error;
+	});
+
+	CheckError();
+
+	if (!queue.empty() && queue.back().type == Item::Type::DATA) {
+		/* append to the last item; the writer thread has not
+		   yet removed it from the queue */
+		auto &data = queue.back().data;
+		data.insert(data.end(), src.begin(), src.end());
+		queued_bytes += src.size();
+		return;
+	}
+
+	Push({Item::Type::DATA, nullptr, {src.begin(), src.end()}});
+}
+
+void
+RecorderWriter::WritePending(bool flush)
+{
+	assert(file != nullptr);
+
+	const std::size_t size = flush
+		? pending.size()
+		: pending.size() / RECORDER_CHUNK_SIZE * RECORDER_CHUNK_SIZE;
+	if (size == 0)
+		return;
+
+	if (position + size > preallocated) {
+		const uint_least64_t end = std::max(position + size,
+						    preallocated + RECORDER_PREALLOCATE_SIZE);
+		file->Preallocate(preallocated, end - preallocated);
+		preallocated = end;
+	}
+
+	file->Write(std::span{pending}.first(size));
+	position += size;
+
+	pending.erase(pending.begin(), pending.begin() + size);
+}
+
+void
+RecorderWriter::Process(Item &item)
+{
+	switch (item.type) {
+	case Item::Type::OPEN:
+		file.reset();
+		pending.clear();
+		position = preallocated = 0;
+
+		file = std::make_unique<FileOutputStream>(item.path);
+		break;
+
+	case Item::Type::DATA:
+		if (file == nullptr)
+			/* the file could not be created; discard */
+			break;
+
+		if (pending.empty() && item.data.size() >= RECORDER_CHUNK_SIZE)
+			pending = std::move(item.data);
+		else
+			pending.insert(pending.end(),
+				       item.data.begin(), item.data.end());
+
+		WritePending(false);
+		break;
+
+	case Item::Type::COMMIT:
+		if (file == nullptr)
+			break;
+
+		WritePending(true);
+		file->Commit();
+		file.reset();
+		break;
+	}
+}
+
+void
+RecorderWriter::Run() noexcept
+{
+	SetThreadName("recorder");
+
+	std::unique_lock lock{mutex};
+
+	while (true) {
+		work_cond.wait(lock, [this]{
+			return quit || !queue.empty();
+		});
+
+		if (quit)
+			break;
+
+		Item item = std::move(queue.front());
+		queue.pop_front();
+		queued_bytes -= item.data.size();
+		busy = true;
+		client_cond.notify_all();
+
+		lock.unlock();
+
+		std::exception_ptr e;
+
+		try {
+			Process(item);
+		} catch (...) {
+			e = std::current_exception();
+
+			/* roll back this file; data is discarded until
+			   the next Open() */
+			file.reset();
+			pending.clear();
+		}
+
+		lock.lock();
+
+		busy = false;
+		if (e)
+			error = std::move(e);
+
+		client_cond.notify_all();
+	}
+}
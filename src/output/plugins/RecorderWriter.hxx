@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "io/OutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+
+class FileOutputStream;
+
+/**
+ * Writes the files of the recorder output plugin in a separate
+ * thread, so a slow disk (e.g. an SD card or NFS) does not block
+ * the output thread.
+ *
+ * Write() appends to a bounded queue; it blocks only if the queue is
+ * full.  The writer thread writes in large chunks at aligned file
+ * offsets and preallocates disk space.  Open() and Commit() are
+ * asynchronous, too: the next file is created by the writer thread
+ * while the output thread continues encoding into the queue.
+ *
+ * Errors (including failure to create a file) are rethrown by the
+ * next call to Write(), Commit() or Drain(); data is discarded until
+ * the next Open().
+ */
+class RecorderWriter final : public OutputStream {
+	Thread thread{BIND_THIS_METHOD(Run)};
+
+	Mutex mutex;
+
+	/**
+	 * Signals the writer thread that there is new work.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signals the client that the queue has shrunk.
+	 */
+	Cond client_cond;
+
+	struct Item {
+		enum class Type : uint8_t {
+			OPEN,
+			DATA,
+			COMMIT,
+		} type;
+
+		/**
+		 * The path to be created (only #OPEN).
+		 */
+		AllocatedPath path;
+
+		/**
+		 * The data to be written (only #DATA).
+		 */
+		std::vector<std::byte> data;
+	};
+
+	/**
+	 * Protected by #mutex.
+	 */
+	std::deque<Item> queue;
+
+	/**
+	 * The total size of all #DATA items in the #queue.
+	 * Protected by #mutex.
+	 */
+	std::size_t queued_bytes = 0;
+
+	/**
+	 * Is the writer thread currently processing an item it has
+	 * removed from the #queue?  Protected by #mutex.
+	 */
+	bool busy = false;
+
+	/**
+	 * Shall the writer thread exit?  Protected by #mutex.
+	 */
+	bool quit = false;
+
+	/**
+	 * An error which occurred in the writer thread and has not
+	 * yet been reported.  Protected by #mutex.
+	 */
+	std::exception_ptr error;
+
+	/* the following attributes are only used by the writer
+	   thread */
+
+	std::unique_ptr<FileOutputStream> file;
+
+	/**
+	 * Data which has not yet been written because it does not
+	 * fill a whole chunk.
+	 */
+	std::vector<std::byte> pending;
+
+	/**
+	 * The number of bytes written to #file.
+	 */
+	uint_least64_t position;
+
+	/**
+	 * The end of the preallocated range of #file.
+	 */
+	uint_least64_t preallocated;
+
+public:
+	/**
+	 * Throws on error (if the thread cannot be created).
+	 */
+	RecorderWriter();
+
+	/**
+	 * Discards all queued operations and cancels the current
+	 * file (unless it was already committed).
+	 */
+	~RecorderWriter() noexcept;
+
+	RecorderWriter(const RecorderWriter &) = delete;
+	RecorderWriter &operator=(const RecorderWriter &) = delete;
+
+	/**
+	 * Create a new file.  If the previous one was not committed,
+	 * it is cancelled.  This does not wait for completion.
+	 */
+	void Open(AllocatedPath &&path);
+
+	/**
+	 * Write all data to the current file and make it visible.
+	 * This does not wait for completion.
+	 *
+	 * Throws on (earlier) error.
+	 */
+	void Commit();
+
+	/**
+	 * Wait until all queued operations have been finished.
+	 *
+	 * Throws on error.
+	 */
+	void Drain();
+
+	/* virtual methods from class OutputStream */
+	void Write(std::span<const std::byte> src) override;
+
+private:
+	/**
+	 * Rethrow the #error.  Caller must lock the #mutex.
+	 */
+	void CheckError();
+
+	void Push(Item &&item) noexcept;
+
+	void Run() noexcept;
+
+	/**
+	 * Execute one #Item in the writer thread.
+	 */
+	void Process(Item &item);
+
+	/**
+	 * Write whole chunks from #pending to the #file.
+	 *
+	 * @param flush write everything, including the last partial
+	 * chunk
+	 */
+	void WritePending(bool flush);
+};
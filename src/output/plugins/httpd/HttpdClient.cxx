@@ -3,19 +3,37 @@
 
 #include "HttpdClient.hxx"
 #include "HttpdInternal.hxx"
+#include "HttpdShard.hxx"
+#include "HttpdStream.hxx"
 #include "util/AllocatedString.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "net/SocketError.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "util/SpanCast.hxx"
+#include "util/StaticVector.hxx"
 #include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "Log.hxx"
 
 #include <fmt/core.h>
 
+#include <algorithm> // for std::min()
 #include <cassert>
+#include <cstdint>
+
+#include <string.h> // for memcpy()
+
+#ifndef _WIN32
+#include <limits.h> // for IOV_MAX
+#include <sys/socket.h> // for MSG_DONTWAIT
+#include <sys/uio.h> // for struct iovec
+#endif
+
+#ifdef __linux__
+#include <linux/errqueue.h> // for struct sock_extended_err
+#include <netinet/in.h> // for IP_RECVERR
+#endif
 
 using std::string_view_literals::operator""sv;
 
@@ -28,13 +46,13 @@ HttpdClient::~HttpdClient() noexcept
 void
 HttpdClient::Close() noexcept
 {
-	httpd.RemoveClient(*this);
+	shard.RemoveClient(*this);
 }
 
 void
 HttpdClient::LockClose() noexcept
 {
-	const std::lock_guard protect{httpd.mutex};
+	const std::lock_guard protect{shard.mutex};
 	Close();
 }
 
@@ -47,7 +65,7 @@ HttpdClient::BeginResponse() noexcept
 	current_page = nullptr;
 
 	if (!head_method)
-		httpd.SendHeader(*this);
+		shard.SendHeader(*this);
 }
 
 bool
@@ -67,6 +85,12 @@ HttpdClient::HandleLine(std::string_view line) noexcept
 
 		const auto [uri, rest] = Split(line, ' ');
 
+		/* the path (without query string) selects the
+		   stream */
+		const auto &s = httpd.FindStream(Split(uri, '?').first);
+		stream = &s;
+		metadata_supported = !s.ImplementsTag();
+
 		/* blacklist some well-known request paths */
 		if (uri == "favicon.ico"sv ||
 		    uri == "robots.txt"sv ||
@@ -127,7 +151,7 @@ HttpdClient::SendResponse() noexcept
 		allocated =
 			icy_server_metadata_header(httpd.name, httpd.genre,
 						   httpd.website,
-						   httpd.content_type,
+						   stream->GetContentType(),
 						   metaint);
 		response = allocated;
 	} else { /* revert to a normal HTTP request */
@@ -138,7 +162,7 @@ HttpdClient::SendResponse() noexcept
 					"Cache-Control: no-cache, no-store\r\n"
 					"Access-Control-Allow-Origin: *\r\n"
 					"\r\n",
-					httpd.content_type);
+					stream->GetContentType());
 		response = allocated;
 	}
 
@@ -155,15 +179,96 @@ HttpdClient::SendResponse() noexcept
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, UniqueSocketDescriptor _fd,
-			 EventLoop &_loop,
-			 bool _metadata_supported)
+HttpdClient::HttpdClient(HttpdOutput &_httpd, HttpdShard &_shard,
+			 UniqueSocketDescriptor _fd, EventLoop &_loop)
 	:BufferedSocket(_fd.Release(), _loop),
-	 httpd(_httpd),
-	 metadata_supported(_metadata_supported)
+	 httpd(_httpd), shard(_shard)
 {
+#ifdef __linux__
+	if (httpd.zerocopy)
+		zerocopy = GetSocket().SetBoolOption(SOL_SOCKET, SO_ZEROCOPY,
+						     true);
+#endif
 }
 
+/**
+ * The buffers collected by HttpdClient::PrepareWrite() to be sent by
+ * one sendmsg() call.
+ */
+struct HttpdClient::WriteVector {
+	/**
+	 * The maximum number of buffers per call.
+	 */
+	static constexpr std::size_t MAX_ITEMS = 256;
+
+#ifdef IOV_MAX
+	static_assert(MAX_ITEMS <= IOV_MAX);
+#endif
+
+	enum class Kind : uint_least8_t {
+		/**
+		 * A portion of #current_page or of a page in
+		 * #pages.
+		 */
+		PAGE,
+
+		/**
+		 * A portion of #metadata.
+		 */
+		METADATA,
+
+		/**
+		 * The zero byte which announces that there is no new
+		 * ICY metadata.
+		 */
+		EMPTY_METADATA,
+	};
+
+	struct Item {
+		std::span<const std::byte> data;
+
+		/**
+		 * The page which owns #data (nullptr for
+		 * #Kind::EMPTY_METADATA); it is only valid until
+		 * ConsumeWrite() is called.
+		 */
+		const PagePtr *page;
+
+		Kind kind;
+	};
+
+	StaticVector<Item, MAX_ITEMS> items;
+
+	/**
+	 * Returns the total number of bytes.
+	 */
+	[[gnu::pure]]
+	std::size_t GetSize() const noexcept {
+		std::size_t size = 0;
+		for (const auto &i : items)
+			size += i.data.size();
+		return size;
+	}
+
+	ssize_t Send(SocketDescriptor s, [[maybe_unused]] int flags=0) const noexcept {
+		assert(!items.empty());
+
+#ifdef _WIN32
+		/* no sendmsg() on Windows */
+		return s.WriteNoWait(items.front().data);
+#else
+		StaticVector<struct iovec, MAX_ITEMS> iov;
+		for (const auto &i : items)
+			iov.push_back({
+				.iov_base = const_cast<std::byte *>(i.data.data()),
+				.iov_len = i.data.size(),
+			});
+
+		return s.Send(iov, MSG_DONTWAIT|flags);
+#endif
+	}
+};
+
 void
 HttpdClient::ClearQueue() noexcept
 {
@@ -176,7 +281,7 @@ HttpdClient::ClearQueue() noexcept
 		queue_size -= page->size();
 #endif
 
-		pages.pop();
+		pages.pop_front();
 	}
 
 	assert(queue_size == 0);
@@ -194,37 +299,226 @@ HttpdClient::CancelQueue() noexcept
 		event.CancelWrite();
 }
 
-ssize_t
-HttpdClient::TryWritePage(const Page &page, size_t position) noexcept
+void
+HttpdClient::PrepareWrite(WriteVector &v) const noexcept
 {
-	assert(position < page.size());
+	static constexpr std::byte empty_data[1]{};
+
+	assert(current_page != nullptr);
+	assert(current_position < current_page->size());
+
+	/* simulate the ICY state while walking the queue */
+	std::size_t fill = metadata_fill;
+	bool sent = metadata_sent;
+
+	const PagePtr *page = &current_page;
+	std::size_t position = current_position;
+	std::size_t next_page = 0;
+
+	while (!v.items.full()) {
+		if (metadata_requested && fill == metaint) {
+			/* the next metadata block is due before more
+			   stream data */
+			if (!sent) {
+				v.items.push_back({
+					std::span<const std::byte>{*metadata}.subspan(metadata_current_position),
+					&metadata,
+					WriteVector::Kind::METADATA,
+				});
+				sent = true;
+			} else
+				v.items.push_back({
+					empty_data,
+					nullptr,
+					WriteVector::Kind::EMPTY_METADATA,
+				});
+
+			fill = 0;
+			continue;
+		}
+
+		auto data = std::span<const std::byte>{**page}.subspan(position);
+		if (metadata_requested && data.size() > metaint - fill)
+			data = data.first(metaint - fill);
 
-	return GetSocket().WriteNoWait(std::span<const std::byte>{page}.subspan(position));
+		v.items.push_back({data, page, WriteVector::Kind::PAGE});
+		position += data.size();
+		if (metadata_requested)
+			fill += data.size();
+
+		if (position == (*page)->size()) {
+			if (next_page == pages.size())
+				break;
+
+			page = &pages[next_page++];
+			position = 0;
+		}
+	}
 }
 
-ssize_t
-HttpdClient::TryWritePageN(const Page &page,
-			   size_t position, ssize_t n) noexcept
+void
+HttpdClient::ConsumeWrite(const WriteVector &v, std::size_t nbytes) noexcept
 {
-	return n >= 0
-		? GetSocket().WriteNoWait({page.data() + position, (std::size_t)n})
-		: TryWritePage(page, position);
+	for (const auto &i : v.items) {
+		const std::size_t n = std::min(nbytes, i.data.size());
+		nbytes -= n;
+
+		switch (i.kind) {
+		case WriteVector::Kind::PAGE:
+			if (current_page == nullptr) {
+				if (n == 0)
+					break;
+
+				assert(!pages.empty());
+				current_page = pages.pop_front();
+				current_position = 0;
+
+				assert(queue_size >= current_page->size());
+				queue_size -= current_page->size();
+			}
+
+			current_position += n;
+			assert(current_position <= current_page->size());
+
+			if (metadata_requested)
+				metadata_fill += n;
+
+			if (current_position >= current_page->size())
+				current_page.reset();
+			break;
+
+		case WriteVector::Kind::METADATA:
+			metadata_current_position += n;
+
+			if (metadata->size() - metadata_current_position == 0) {
+				metadata_fill = 0;
+				metadata_current_position = 0;
+				metadata_sent = true;
+			}
+			break;
+
+		case WriteVector::Kind::EMPTY_METADATA:
+			if (n > 0) {
+				metadata_fill = 0;
+				metadata_current_position = 0;
+			}
+			break;
+		}
+
+		if (n < i.data.size())
+			break;
+	}
+
+	if (current_page == nullptr && pages.empty())
+		/* all pages are sent: remove the event source */
+		event.CancelWrite();
 }
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const noexcept
+#ifdef __linux__
+
+void
+HttpdClient::PinWrite(const WriteVector &v, std::size_t nbytes,
+		      uint32_t id) noexcept
 {
-	if (metadata_requested &&
-	    current_page->size() - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+	for (const auto &i : v.items) {
+		if (nbytes == 0)
+			break;
+
+		nbytes -= std::min(nbytes, i.data.size());
+
+		if (i.page == nullptr)
+			continue;
+
+		if (!zerocopy_pinned.empty() &&
+		    zerocopy_pinned.back().page == *i.page) {
+			auto &pin = zerocopy_pinned.back();
+			if (pin.last_id == id)
+				/* same page as in the previous item */
+				continue;
+
+			if (pin.last_id + 1 == id) {
+				/* the previous send ended in this
+				   page */
+				pin.last_id = id;
+				++pin.pending;
+				continue;
+			}
+		}
+
+		zerocopy_pinned.push_back({id, id, 1, *i.page});
+	}
+}
+
+void
+HttpdClient::ReleaseZeroCopy(uint32_t lo, uint32_t hi) noexcept
+{
+	/* the ids wrap around; compare them with serial number
+	   arithmetic */
+	for (auto &pin : zerocopy_pinned) {
+		const uint32_t begin = int32_t(lo - pin.first_id) > 0
+			? lo : pin.first_id;
+		const uint32_t end = int32_t(hi - pin.last_id) < 0
+			? hi : pin.last_id;
+		const int32_t n = int32_t(end - begin) + 1;
+		if (n > 0) {
+			assert(uint32_t(n) <= pin.pending);
+			pin.pending -= n;
+		}
+	}
 
-	return -1;
+	std::erase_if(zerocopy_pinned, [](const PinnedPage &pin){
+		return pin.pending == 0;
+	});
 }
 
+void
+HttpdClient::ReadZeroCopyCompletions() noexcept
+{
+	while (true) {
+		alignas(struct cmsghdr) std::byte control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+
+		struct msghdr msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (GetSocket().Receive(msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0)
+			break;
+
+		for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!(cmsg->cmsg_level == SOL_IP &&
+			      cmsg->cmsg_type == IP_RECVERR) &&
+			    !(cmsg->cmsg_level == SOL_IPV6 &&
+			      cmsg->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			struct sock_extended_err serr;
+			memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+			if (serr.ee_errno != 0 ||
+			    serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				/* the kernel had to copy the data
+				   anyway; MSG_ZEROCOPY only adds
+				   overhead for this socket */
+				zerocopy = false;
+
+			/* sends [ee_info..ee_data] have completed;
+			   they may be reported out of order, so
+			   release only the pages whose sends are all
+			   done */
+			ReleaseZeroCopy(serr.ee_info, serr.ee_data);
+		}
+	}
+}
+
+#endif // __linux__
+
 inline bool
 HttpdClient::TryWrite() noexcept
 {
-	const std::lock_guard protect{httpd.mutex};
+	const std::lock_guard protect{shard.mutex};
 
 	assert(state == State::RESPONSE);
 
@@ -232,106 +526,52 @@ HttpdClient::TryWrite() noexcept
 		if (pages.empty()) {
 			/* another thread has removed the event source
 			   while this thread was waiting for
-			   httpd.mutex */
+			   the shard's mutex */
 			event.CancelWrite();
 			return true;
 		}
 
-		current_page = pages.front();
-		pages.pop();
+		current_page = pages.pop_front();
 		current_position = 0;
 
 		assert(queue_size >= current_page->size());
 		queue_size -= current_page->size();
 	}
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
-	if (bytes_to_write == 0) {
-		if (!metadata_sent) {
-			ssize_t nbytes = TryWritePage(*metadata,
-						      metadata_current_position);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorSendWouldBlock(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FmtWarning(httpd_output_domain,
-						   "failed to write to client: {}",
-						   (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
-
-			metadata_current_position += nbytes;
-
-			if (metadata->size() - metadata_current_position == 0) {
-				metadata_fill = 0;
-				metadata_current_position = 0;
-				metadata_sent = true;
-			}
-		} else {
-			static constexpr std::byte empty_data[1]{};
-
-			ssize_t nbytes = GetSocket().Write(empty_data);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorSendWouldBlock(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FmtWarning(httpd_output_domain,
-						   "failed to write to client: {}",
-						   (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
-
-			metadata_fill = 0;
-			metadata_current_position = 0;
-		}
-	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
-		if (nbytes < 0) {
-			auto e = GetSocketError();
-			if (IsSocketErrorSendWouldBlock(e))
-				return true;
-
-			if (!IsSocketErrorClosed(e)) {
-				SocketErrorMessage msg(e);
-				FmtWarning(httpd_output_domain,
-					   "failed to write to client: {}",
-					   (const char *)msg);
-			}
+	WriteVector v;
+	PrepareWrite(v);
+
+#ifdef __linux__
+	/* zero-copy pays off only for large writes */
+	static constexpr std::size_t ZEROCOPY_THRESHOLD = 16384;
+	const bool use_zerocopy = zerocopy && v.GetSize() >= ZEROCOPY_THRESHOLD;
+	const ssize_t nbytes = v.Send(GetSocket(),
+				      use_zerocopy ? MSG_ZEROCOPY : 0);
+#else
+	const ssize_t nbytes = v.Send(GetSocket());
+#endif
+	if (nbytes < 0) {
+		auto e = GetSocketError();
+		if (IsSocketErrorSendWouldBlock(e))
+			return true;
 
-			Close();
-			return false;
+		if (!IsSocketErrorClosed(e)) {
+			SocketErrorMessage msg(e);
+			FmtWarning(httpd_output_domain,
+				   "failed to write to client: {}",
+				   (const char *)msg);
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size());
-
-		if (metadata_requested)
-			metadata_fill += nbytes;
-
-		if (current_position >= current_page->size()) {
-			current_page.reset();
-
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				event.CancelWrite();
-		}
+		Close();
+		return false;
 	}
 
+#ifdef __linux__
+	if (use_zerocopy)
+		PinWrite(v, nbytes, zerocopy_next_id++);
+#endif
+
+	ConsumeWrite(v, nbytes);
 	return true;
 }
 
@@ -349,7 +589,7 @@ HttpdClient::PushPage(PagePtr page) noexcept
 	}
 
 	queue_size += page->size();
-	pages.emplace(std::move(page));
+	pages.push_back(std::move(page));
 
 	event.ScheduleWrite();
 }
@@ -366,6 +606,17 @@ HttpdClient::PushMetaData(PagePtr page) noexcept
 void
 HttpdClient::OnSocketReady(unsigned flags) noexcept
 {
+#ifdef __linux__
+	if ((flags & SocketEvent::ERROR) && !zerocopy_pinned.empty()) {
+		/* EPOLLERR may just announce MSG_ZEROCOPY
+		   completions */
+		ReadZeroCopyCompletions();
+
+		if (GetSocket().GetError() == 0)
+			flags &= ~SocketEvent::ERROR;
+	}
+#endif
+
 	if (flags & SocketEvent::WRITE)
 		if (!TryWrite())
 			return;
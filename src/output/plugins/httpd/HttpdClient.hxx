@@ -4,16 +4,22 @@
 #pragma once
 
 #include "Page.hxx"
+#include "PageQueue.hxx"
 #include "event/BufferedSocket.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <cstddef>
-#include <list>
-#include <queue>
 #include <string_view>
 
+#ifdef __linux__
+#include <cstdint>
+#include <deque>
+#endif
+
 class UniqueSocketDescriptor;
 class HttpdOutput;
+class HttpdShard;
+class HttpdStream;
 
 class HttpdClient final
 	: BufferedSocket,
@@ -24,6 +30,18 @@ class HttpdClient final
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The shard which owns this client; its mutex protects the
+	 * page queue.
+	 */
+	HttpdShard &shard;
+
+	/**
+	 * The stream requested by this client; nullptr until the
+	 * request line has been received.
+	 */
+	const HttpdStream *stream = nullptr;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -41,7 +59,7 @@ class HttpdClient final
 	/**
 	 * A queue of #Page objects to be sent to the client.
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
+	PageQueue pages;
 
 	/**
 	 * The sum of all page sizes in #pages.
@@ -73,9 +91,9 @@ class HttpdClient final
 
 	/**
 	 * Do we support sending Icy-Metadata to the client?  This is
-	 * disabled if the httpd audio output uses encoder tags.
+	 * disabled if the #stream uses encoder tags.
 	 */
-	bool metadata_supported;
+	bool metadata_supported = false;
 
 	/**
 	 * If we should sent icy metadata.
@@ -111,14 +129,54 @@ class HttpdClient final
 	 */
 	unsigned metadata_fill = 0;
 
+#ifdef __linux__
+	/* MSG_ZEROCOPY */
+
+	/**
+	 * Send large writes with MSG_ZEROCOPY?  This gets disabled
+	 * if the kernel reports that it had to copy the data anyway
+	 * (e.g. on the loopback device).
+	 */
+	bool zerocopy = false;
+
+	/**
+	 * The kernel's counter of MSG_ZEROCOPY sends on this socket,
+	 * i.e. the id of the next one.
+	 */
+	uint32_t zerocopy_next_id = 0;
+
+	struct PinnedPage {
+		/**
+		 * The ids of the (consecutive) sends which
+		 * referenced this page.
+		 */
+		uint32_t first_id, last_id;
+
+		/**
+		 * The number of these sends which the kernel has not
+		 * yet reported as completed.
+		 */
+		uint32_t pending;
+
+		PagePtr page;
+	};
+
+	/**
+	 * Pages referenced by MSG_ZEROCOPY sends which the kernel has
+	 * not yet completed; they must not be freed (or reused) until
+	 * then.
+	 */
+	std::deque<PinnedPage> zerocopy_pinned;
+#endif
+
 public:
 	/**
 	 * @param httpd the HTTP output device
+	 * @param _shard the shard which owns this client
 	 * @param _fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, UniqueSocketDescriptor _fd,
-		    EventLoop &_loop,
-		    bool _metadata_supported);
+	HttpdClient(HttpdOutput &httpd, HttpdShard &_shard,
+		    UniqueSocketDescriptor _fd, EventLoop &_loop);
 
 	/**
 	 * Note: this does not remove the client from the
@@ -135,6 +193,14 @@ public:
 
 	void LockClose() noexcept;
 
+	/**
+	 * Returns the stream requested by this client or nullptr if
+	 * the request has not been received yet.
+	 */
+	const HttpdStream *GetStream() const noexcept {
+		return stream;
+	}
+
 	/**
 	 * Clears the page queue.
 	 */
@@ -155,13 +221,6 @@ public:
 	 */
 	bool SendResponse() noexcept;
 
-	[[gnu::pure]]
-	ssize_t GetBytesTillMetaData() const noexcept;
-
-	ssize_t TryWritePage(const Page &page, size_t position) noexcept;
-	ssize_t TryWritePageN(const Page &page,
-			      size_t position, ssize_t n) noexcept;
-
 	bool TryWrite() noexcept;
 
 	/**
@@ -177,6 +236,43 @@ public:
 private:
 	void ClearQueue() noexcept;
 
+	struct WriteVector;
+
+	/**
+	 * Collect as much pending data (pages and interleaved ICY
+	 * metadata) as fits into one sendmsg() call.
+	 */
+	void PrepareWrite(WriteVector &v) const noexcept;
+
+	/**
+	 * Update the queue and the ICY state after @nbytes of the
+	 * given #WriteVector have been sent.
+	 */
+	void ConsumeWrite(const WriteVector &v, std::size_t nbytes) noexcept;
+
+#ifdef __linux__
+	/**
+	 * Keep references to all pages of the given #WriteVector
+	 * (which were sent with MSG_ZEROCOPY) until the kernel
+	 * completes the send.  Must be called before ConsumeWrite().
+	 */
+	void PinWrite(const WriteVector &v, std::size_t nbytes,
+		      uint32_t id) noexcept;
+
+	/**
+	 * Read MSG_ZEROCOPY completion notifications from the socket's
+	 * error queue and release the pinned pages.
+	 */
+	void ReadZeroCopyCompletions() noexcept;
+
+	/**
+	 * The kernel has completed the MSG_ZEROCOPY sends with ids
+	 * [lo, hi]; release the pages which are no longer
+	 * referenced by pending sends.
+	 */
+	void ReleaseZeroCopy(uint32_t lo, uint32_t hi) noexcept;
+#endif
+
 protected:
 	/* virtual methods from class BufferedSocket */
 	void OnSocketReady(unsigned flags) noexcept override;
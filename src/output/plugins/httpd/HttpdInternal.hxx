@@ -8,27 +8,24 @@
 
 #pragma once
 
-#include "HttpdClient.hxx"
+#include "HttpdShard.hxx"
+#include "HttpdStream.hxx"
 #include "output/Interface.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "event/ServerSocket.hxx"
-#include "event/InjectEvent.hxx"
 #include "util/Cast.hxx"
-#include "util/IntrusiveList.hxx"
 
-#include <queue>
 #include <list>
 #include <memory>
 #include <span>
+#include <string_view>
 
 struct ConfigBlock;
 class EventLoop;
 class ServerSocket;
 class HttpdClient;
-class PreparedEncoder;
-class Encoder;
 struct Tag;
 
 class HttpdOutput final : AudioOutput, ServerSocket {
@@ -41,37 +38,19 @@ class HttpdOutput final : AudioOutput, ServerSocket {
 	bool pause;
 
 	/**
-	 * The configured encoder plugin.
+	 * The encoder profiles.  The first one is the default stream
+	 * configured by the settings of the "audio_output" block,
+	 * followed by the "stream" settings.
 	 */
-	std::unique_ptr<PreparedEncoder> prepared_encoder;
-	Encoder *encoder = nullptr;
-
-	/**
-	 * Number of bytes which were fed into the encoder, without
-	 * ever receiving new output.  This is used to estimate
-	 * whether MPD should manually flush the encoder, to avoid
-	 * buffer underruns in the client.
-	 */
-	size_t unflushed_input = 0;
+	std::list<HttpdStream> streams;
 
 public:
 	/**
-	 * The MIME type produced by the #encoder.
-	 */
-	const char *content_type;
-
-	/**
-	 * This mutex protects the listener socket and the client
-	 * list.
+	 * This mutex protects the listener socket and #metadata.  It
+	 * must not be held while locking HttpdShard::mutex.
 	 */
 	mutable Mutex mutex;
 
-	/**
-	 * This condition gets signalled when an item is removed from
-	 * #pages.
-	 */
-	Cond cond;
-
 private:
 	/**
 	 * A #Timer object to synchronize this output with the
@@ -79,25 +58,16 @@ private:
 	 */
 	Timer *timer;
 
-	/**
-	 * The header page, which is sent to every client on connect.
-	 */
-	PagePtr header;
-
 	/**
 	 * The metadata, which is sent to every client.
 	 */
 	PagePtr metadata;
 
 	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
+	 * The client groups; each one runs in its own #EventLoop (or
+	 * all in the output's #EventLoop if there is only one).
 	 */
-	std::queue<PagePtr, std::list<PagePtr>> pages;
-
-	InjectEvent defer_broadcast;
+	std::list<HttpdShard> shards;
 
  public:
 	/**
@@ -117,17 +87,18 @@ private:
 
 private:
 	/**
-	 * A linked list containing all clients which are currently
-	 * connected.
+	 * The maximum number of clients connected at the same time.
 	 */
-	IntrusiveList<
-		HttpdClient, IntrusiveListBaseHookTraits<HttpdClient>,
-		IntrusiveListOptions{.constant_time_size = true}> clients;
+	const unsigned clients_max;
 
+public:
 	/**
-	 * The maximum number of clients connected at the same time.
+	 * Send large pages with MSG_ZEROCOPY (the "zerocopy"
+	 * setting)?  Only supported on Linux.
 	 */
-	const unsigned clients_max;
+	const bool zerocopy;
+
+private:
 
 public:
 	HttpdOutput(EventLoop &_loop, const ConfigBlock &block);
@@ -151,11 +122,20 @@ public:
 	}
 
 	/**
-	 * Caller must lock the mutex.
+	 * Find the stream for the given request path (without the
+	 * leading slash).  Falls back to the default stream.
+	 */
+	[[gnu::pure]]
+	HttpdStream &FindStream(std::string_view path) noexcept;
+
+	/**
+	 * Open all encoders and publish their header pages.
+	 *
+	 * Mutex must not be locked.
 	 *
 	 * Throws on error.
 	 */
-	void OpenEncoder(AudioFormat &audio_format);
+	void OpenEncoders(AudioFormat &audio_format);
 
 	/**
 	 * Caller must lock the mutex.
@@ -168,64 +148,47 @@ public:
 	void Close() noexcept override;
 
 	/**
-	 * Check whether there is at least one client.
-	 *
-	 * Caller must lock the mutex.
+	 * Returns the number of clients in all shards.
 	 */
 	[[gnu::pure]]
-	bool HasClients() const noexcept {
-		return !clients.empty();
-	}
+	std::size_t LockGetClientCount() const noexcept;
 
 	/**
 	 * Check whether there is at least one client.
 	 */
 	[[gnu::pure]]
 	bool LockHasClients() const noexcept {
+		return LockGetClientCount() > 0;
+	}
+
+	PagePtr LockGetMetaData() const noexcept {
 		const std::lock_guard protect{mutex};
-		return HasClients();
+		return metadata;
 	}
 
 	/**
-	 * Caller must lock the mutex.
+	 * Pass the connection to the shard with the fewest clients.
 	 */
 	void AddClient(UniqueSocketDescriptor fd) noexcept;
 
-	/**
-	 * Removes a client from the httpd_output.clients linked list.
-	 *
-	 * Caller must lock the mutex.
-	 */
-	void RemoveClient(HttpdClient &client) noexcept;
-
-	/**
-	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
-	 */
-	void SendHeader(HttpdClient &client) const noexcept;
-
 	[[gnu::pure]]
 	std::chrono::steady_clock::duration Delay() const noexcept override;
 
 	/**
-	 * Reads data from the encoder (as much as available) and
-	 * returns it as a new #page object.
-	 */
-	PagePtr ReadPage() noexcept;
-
-	/**
-	 * Broadcasts a page struct to all clients.
+	 * Broadcasts pages to all clients of the given stream.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastPage(PagePtr page) noexcept;
+	void BroadcastPages(HttpdStream &stream,
+			    std::span<const PagePtr> pages) noexcept;
 
 	/**
-	 * Broadcasts data from the encoder to all clients.
+	 * Broadcasts data from the encoder to all clients of the
+	 * given stream.
 	 *
 	 * Mutext must not be locked.
 	 */
-	void BroadcastFromEncoder() noexcept;
+	void BroadcastFromEncoder(HttpdStream &stream) noexcept;
 
 	/**
 	 * Mutext must not be locked.
@@ -238,18 +201,10 @@ public:
 
 	std::size_t Play(std::span<const std::byte> src) override;
 
-	/**
-	 * Mutext must not be locked.
-	 */
-	void CancelAllClients() noexcept;
-
 	void Cancel() noexcept override;
 	bool Pause() override;
 
 private:
-	/* InjectEvent callback */
-	void OnDeferredBroadcast() noexcept;
-
 	void OnAccept(UniqueSocketDescriptor fd,
 		      SocketAddress address) noexcept override;
 };
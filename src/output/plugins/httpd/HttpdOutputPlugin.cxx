@@ -5,8 +5,6 @@
 #include "HttpdInternal.hxx"
 #include "HttpdClient.hxx"
 #include "output/OutputAPI.hxx"
-#include "encoder/EncoderInterface.hxx"
-#include "encoder/Configured.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "net/SocketAddress.hxx"
 #include "Page.hxx"
@@ -14,8 +12,12 @@
 #include "event/Call.hxx"
 #include "net/DscpParser.hxx"
 #include "util/Domain.hxx"
-#include "util/DeleteDisposer.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/StaticVector.hxx"
+#include "util/StringSplit.hxx"
+#include "config/Block.hxx"
 #include "config/Net.hxx"
+#include "lib/fmt/RuntimeError.hxx"
 
 #include <cassert>
 #include <stdexcept>
@@ -24,16 +26,60 @@
 
 const Domain httpd_output_domain("httpd_output");
 
+/**
+ * Parse the value of a "stream" setting, i.e. a request path
+ * followed by encoder settings, e.g. "/low.opus encoder=opus
+ * bitrate=96000".
+ *
+ * Throws on error.
+ *
+ * @param block receives the encoder settings
+ * @return the path without the leading slash
+ */
+static std::string_view
+ParseStream(std::string_view s, int line, ConfigBlock &block)
+{
+	bool first = true;
+	std::string_view path;
+
+	for (const std::string_view i : IterableSplitString(s, ' ')) {
+		if (i.empty())
+			continue;
+
+		if (first) {
+			path = i;
+			if (path.starts_with('/'))
+				path.remove_prefix(1);
+
+			if (path.empty())
+				throw std::runtime_error("Stream path must not be empty");
+
+			first = false;
+			continue;
+		}
+
+		const auto [name, value] = Split(i, '=');
+		if (name.empty() || value.data() == nullptr)
+			throw FmtRuntimeError("Malformed stream setting: {:?}", i);
+
+		block.AddBlockParam(std::string{name}, std::string{value}, line);
+	}
+
+	if (first)
+		throw std::runtime_error("Stream path missing");
+
+	return path;
+}
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 	:AudioOutput(FLAG_ENABLE_DISABLE|FLAG_PAUSE),
 	 ServerSocket(_loop),
-	 prepared_encoder(CreateConfiguredEncoder(block)),
-	 defer_broadcast(_loop, BIND_THIS_METHOD(OnDeferredBroadcast)),
 	 name(block.GetBlockValue("name", "Set name in config")),
 	 genre(block.GetBlockValue("genre", "Set genre in config")),
 	 website(block.GetBlockValue("website", "Set website in config")),
-	 clients_max(block.GetBlockValue("max_clients", 0U))
+	 clients_max(block.GetBlockValue("max_clients", 0U)),
+	 zerocopy(block.GetBlockValue("zerocopy", false))
 {
 	if (const auto *p = block.GetBlockParam("dscp_class"))
 		p->With([this](const char *s){
@@ -48,10 +94,40 @@ HttpdOutput::HttpdOutput(EventLoop &_loop, const ConfigBlock &block)
 
 	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"), block.GetBlockValue("port", 8000U));
 
-	/* determine content type */
-	content_type = prepared_encoder->GetMimeType();
-	if (content_type == nullptr)
-		content_type = "application/octet-stream";
+	/* with io_threads=0 (the default), all clients are handled
+	   by the output's EventLoop */
+	const unsigned io_threads = block.GetBlockValue("io_threads", 0U);
+	if (io_threads > 64)
+		throw std::runtime_error("Too many io_threads");
+
+	if (io_threads == 0)
+		shards.emplace_back(*this, _loop, false);
+	else
+		for (unsigned i = 0; i < io_threads; ++i)
+			shards.emplace_back(*this, _loop, true);
+
+	/* the default stream uses the settings of this block */
+	streams.emplace_back(std::string_view{}, block);
+
+	for (const auto &i : block.block_params) {
+		if (i.name != "stream")
+			continue;
+
+		i.used = true;
+
+		i.With([this, &i](const char *value){
+			ConfigBlock stream_block(i.line);
+			const auto path = ParseStream(value, i.line,
+						      stream_block);
+
+			for (const auto &s : streams)
+				if (s.GetPath() == path)
+					throw FmtRuntimeError("Duplicate stream path: {:?}",
+							      path);
+
+			streams.emplace_back(path, stream_block);
+		});
+	}
 }
 
 inline void
@@ -74,41 +150,32 @@ HttpdOutput::Unbind() noexcept
 		});
 }
 
-/**
- * Creates a new #HttpdClient object and adds it into the
- * HttpdOutput.clients linked list.
- */
-inline void
-HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
+std::size_t
+HttpdOutput::LockGetClientCount() const noexcept
 {
-	auto *client = new HttpdClient(*this, std::move(fd), GetEventLoop(),
-				       !encoder->ImplementsTag());
-	clients.push_front(*client);
-
-	/* pass metadata to client */
-	if (metadata != nullptr)
-		clients.front().PushMetaData(metadata);
+	std::size_t n = 0;
+	for (const auto &shard : shards)
+		n += shard.LockGetClientCount();
+	return n;
 }
 
-void
-HttpdOutput::OnDeferredBroadcast() noexcept
+inline void
+HttpdOutput::AddClient(UniqueSocketDescriptor fd) noexcept
 {
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
+	assert(!shards.empty());
 
-	const std::lock_guard protect{mutex};
+	auto *best = &shards.front();
+	std::size_t best_count = best->LockGetClientCount();
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
-
-		for (auto &client : clients)
-			client.PushPage(page);
+	for (auto &shard : shards) {
+		const std::size_t count = shard.LockGetClientCount();
+		if (count < best_count) {
+			best = &shard;
+			best_count = count;
+		}
 	}
 
-	/* wake up the client that may be waiting for the queue to be
-	   flushed */
-	cond.notify_all();
+	best->AddClient(std::move(fd));
 }
 
 void
@@ -118,95 +185,75 @@ HttpdOutput::OnAccept(UniqueSocketDescriptor fd,
 	/* the listener socket has become readable - a client has
 	   connected */
 
-	const std::lock_guard protect{mutex};
+	{
+		const std::lock_guard protect{mutex};
+		if (!open)
+			return;
+	}
 
 	/* can we allow additional client */
-	if (open && (clients_max == 0 || clients.size() < clients_max))
+	if (clients_max == 0 || LockGetClientCount() < clients_max)
 		AddClient(std::move(fd));
 }
 
-PagePtr
-HttpdOutput::ReadPage() noexcept
+HttpdStream &
+HttpdOutput::FindStream(std::string_view path) noexcept
 {
-	if (unflushed_input >= 65536) {
-		/* we have fed a lot of input into the encoder, but it
-		   didn't give anything back yet - flush now to avoid
-		   buffer underruns */
-		try {
-			encoder->Flush();
-		} catch (...) {
-			/* ignore */
-		}
-
-		unflushed_input = 0;
-	}
-
-	std::byte buffer[32768];
-
-	size_t size = 0;
-	do {
-		const auto b = std::span{buffer}.subspan(size);
-		const auto r = encoder->Read(b);
-		if (r.empty())
-			break;
-
-		unflushed_input = 0;
-
-		if (r.data() != b.data()) {
-			if (size == 0 && r.size() >= sizeof(buffer) / 2)
-				/* if the returned memory area is
-				   large (and nothing has been written
-				   to the stack buffer yet), copy
-				   right from the returned memory
-				   area, avoiding the copy into the
-				   buffer*/
-				return std::make_shared<Page>(r);
-
-			/* if the encoder did not write to the given
-			   buffer but instead returned its own buffer,
-			   we need to copy it so we have a contiguous
-			   buffer */
-			std::copy(r.begin(), r.end(), b.begin());
-		}
-
-		size += r.size();
-	} while (size < sizeof(buffer));
+	assert(!streams.empty());
 
-	if (size == 0)
-		return nullptr;
+	for (auto &stream : streams)
+		if (!stream.GetPath().empty() && stream.GetPath() == path)
+			return stream;
 
-	return std::make_shared<Page>(std::span{buffer, size});
+	return streams.front();
 }
 
 inline void
-HttpdOutput::OpenEncoder(AudioFormat &audio_format)
+HttpdOutput::OpenEncoders(AudioFormat &audio_format)
 {
-	encoder = prepared_encoder->Open(audio_format);
+	/* the default stream determines the audio format; all other
+	   encoders convert it if they need to */
+	bool first = true;
+	for (auto &stream : streams) {
+		try {
+			stream.Open(audio_format, first);
+		} catch (...) {
+			for (auto &i : streams) {
+				if (&i == &stream)
+					break;
+
+				i.Close();
+			}
 
-	/* we have to remember the encoder header, i.e. the first
-	   bytes of encoder output after opening it, because it has to
-	   be sent to every new client */
-	header = ReadPage();
+			throw;
+		}
+
+		first = false;
 
-	unflushed_input = 0;
+		/* we have to remember the encoder header, i.e. the
+		   first bytes of encoder output after opening it,
+		   because it has to be sent to every new client */
+		if (auto header = stream.ReadPage(); header != nullptr)
+			for (auto &shard : shards)
+				shard.PublishHeader(stream, header);
+	}
 }
 
 void
 HttpdOutput::Open(AudioFormat &audio_format)
 {
 	assert(!open);
-	assert(clients.empty());
+	assert(!LockHasClients());
 
-	const std::lock_guard protect{mutex};
-
-	OpenEncoder(audio_format);
+	OpenEncoders(audio_format);
 
 	/* initialize other attributes */
 
 	timer = new Timer(audio_format);
+	pause = false;
 
+	const std::lock_guard protect{mutex};
 	open = true;
-	pause = false;
 }
 
 void
@@ -217,32 +264,17 @@ HttpdOutput::Close() noexcept
 	delete timer;
 
 	BlockingCall(GetEventLoop(), [this](){
-			defer_broadcast.Cancel();
-
 			const std::lock_guard protect{mutex};
 			open = false;
-			clients.clear_and_dispose(DeleteDisposer());
 		});
 
-	header.reset();
-
-	delete encoder;
-}
-
-void
-HttpdOutput::RemoveClient(HttpdClient &client) noexcept
-{
-	assert(!clients.empty());
-
-	clients.erase_and_dispose(clients.iterator_to(client),
-				  DeleteDisposer());
-}
+	for (auto &shard : shards)
+		BlockingCall(shard.GetEventLoop(), [&shard](){
+			shard.CloseClients();
+		});
 
-void
-HttpdOutput::SendHeader(HttpdClient &client) const noexcept
-{
-	if (header != nullptr)
-		client.PushPage(header);
+	for (auto &stream : streams)
+		stream.Close();
 }
 
 std::chrono::steady_clock::duration
@@ -267,48 +299,48 @@ HttpdOutput::Delay() const noexcept
 }
 
 void
-HttpdOutput::BroadcastPage(PagePtr page) noexcept
+HttpdOutput::BroadcastPages(HttpdStream &stream,
+			    std::span<const PagePtr> src) noexcept
 {
-	assert(page != nullptr);
+	assert(!src.empty());
 
-	{
-		const std::lock_guard lock{mutex};
-		pages.emplace(std::move(page));
-	}
-
-	defer_broadcast.Schedule();
+	/* each shard gets each page once */
+	for (auto &shard : shards)
+		shard.Publish(stream, src);
 }
 
 void
-HttpdOutput::BroadcastFromEncoder() noexcept
+HttpdOutput::BroadcastFromEncoder(HttpdStream &stream) noexcept
 {
-	/* synchronize with the IOThread */
-	{
-		std::unique_lock lock{mutex};
-		cond.wait(lock, [this]{ return pages.empty(); });
-	}
+	/* synchronize with the shard threads */
+	for (auto &shard : shards)
+		shard.WaitPublished();
 
-	bool empty = true;
+	StaticVector<PagePtr, 16> src;
 
 	PagePtr page;
-	while ((page = ReadPage()) != nullptr) {
-		const std::lock_guard lock{mutex};
-		pages.emplace(std::move(page));
-		empty = false;
+	while ((page = stream.ReadPage()) != nullptr) {
+		src.push_back(std::move(page));
+
+		if (src.full()) {
+			BroadcastPages(stream, src);
+			src.clear();
+		}
 	}
 
-	if (!empty)
-		defer_broadcast.Schedule();
+	if (!src.empty())
+		BroadcastPages(stream, src);
 }
 
 inline void
 HttpdOutput::EncodeAndPlay(std::span<const std::byte> src)
 {
-	encoder->Write(src);
-
-	unflushed_input += src.size();
-
-	BroadcastFromEncoder();
+	/* the PCM data (after all filters) is shared by all
+	   streams; only the encoder runs once per stream */
+	for (auto &stream : streams) {
+		stream.Write(src);
+		BroadcastFromEncoder(stream);
+	}
 }
 
 std::size_t
@@ -342,39 +374,30 @@ HttpdOutput::Pause()
 void
 HttpdOutput::SendTag(const Tag &tag)
 {
-	if (encoder->ImplementsTag()) {
-		/* embed encoder tags */
-
-		/* flush the current stream, and end it */
+	bool icy = false;
 
-		try {
-			encoder->PreTag();
-		} catch (...) {
-			/* ignore */
+	for (auto &stream : streams) {
+		if (!stream.ImplementsTag()) {
+			icy = true;
+			continue;
 		}
 
-		BroadcastFromEncoder();
+		/* embed encoder tags */
 
-		/* send the tag to the encoder - which starts a new
-		   stream now */
-
-		try {
-			encoder->SendTag(tag);
-			encoder->Flush();
-		} catch (...) {
-			/* ignore */
-		}
+		stream.PreTag();
+		BroadcastFromEncoder(stream);
+		stream.SendTag(tag);
 
 		/* the first page generated by the encoder will now be
 		   used as the new "header" page, which is sent to all
 		   new clients */
 
-		auto page = ReadPage();
-		if (page != nullptr) {
-			header = page;
-			BroadcastPage(page);
-		}
-	} else {
+		if (auto page = stream.ReadPage(); page != nullptr)
+			for (auto &shard : shards)
+				shard.PublishHeader(stream, page);
+	}
+
+	if (icy) {
 		/* use Icy-Metadata */
 
 		static constexpr TagType types[] = {
@@ -382,36 +405,25 @@ HttpdOutput::SendTag(const Tag &tag)
 			TAG_NUM_OF_ITEM_TYPES
 		};
 
-		metadata = icy_server_metadata_page(tag, &types[0]);
-		if (metadata != nullptr) {
-			const std::lock_guard protect{mutex};
-			for (auto &client : clients)
-				client.PushMetaData(metadata);
-		}
-	}
-}
-
-inline void
-HttpdOutput::CancelAllClients() noexcept
-{
-	const std::lock_guard protect{mutex};
+		auto page = icy_server_metadata_page(tag, &types[0]);
+		if (page != nullptr) {
+			{
+				const std::lock_guard protect{mutex};
+				metadata = page;
+			}
 
-	while (!pages.empty()) {
-		PagePtr page = std::move(pages.front());
-		pages.pop();
+			for (auto &shard : shards)
+				shard.PushMetaData(page);
+		}
 	}
-
-	for (auto &client : clients)
-		client.CancelQueue();
-
-	cond.notify_all();
 }
 
 void
 HttpdOutput::Cancel() noexcept
 {
-	BlockingCall(GetEventLoop(), [this](){
-			CancelAllClients();
+	for (auto &shard : shards)
+		BlockingCall(shard.GetEventLoop(), [&shard](){
+			shard.Cancel();
 		});
 }
 
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "HttpdShard.hxx"
+#include "HttpdInternal.hxx"
+#include "HttpdStream.hxx"
+#include "event/Thread.hxx"
+#include "util/DeleteDisposer.hxx"
+
+#include <cassert>
+
+static EventLoop &
+GetShardEventLoop(EventThread *thread, EventLoop &output_loop) noexcept
+{
+	return thread != nullptr
+		? thread->GetEventLoop()
+		: output_loop;
+}
+
+HttpdShard::HttpdShard(HttpdOutput &_httpd, EventLoop &output_loop,
+		       bool own_thread)
+	:httpd(_httpd),
+	 thread(own_thread ? std::make_unique<EventThread>() : nullptr),
+	 loop(GetShardEventLoop(thread.get(), output_loop)),
+	 inject_event(loop, BIND_THIS_METHOD(OnInject))
+{
+	if (thread != nullptr)
+		thread->Start();
+}
+
+HttpdShard::~HttpdShard() noexcept
+{
+	assert(clients.empty());
+
+	if (thread != nullptr)
+		thread->Stop();
+}
+
+std::size_t
+HttpdShard::LockGetClientCount() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	return clients.size() + new_sockets.size();
+}
+
+inline void
+HttpdShard::CreateClient(UniqueSocketDescriptor &&fd) noexcept
+{
+	auto *client = new HttpdClient(httpd, *this, std::move(fd), loop);
+	clients.push_front(*client);
+
+	/* pass metadata to client */
+	if (auto metadata = httpd.LockGetMetaData(); metadata != nullptr)
+		client->PushMetaData(std::move(metadata));
+}
+
+void
+HttpdShard::AddClient(UniqueSocketDescriptor fd) noexcept
+{
+	const std::lock_guard protect{mutex};
+
+	if (loop.IsInside()) {
+		CreateClient(std::move(fd));
+	} else {
+		/* the socket must be registered in this shard's
+		   thread */
+		new_sockets.emplace_back(std::move(fd));
+		inject_event.Schedule();
+	}
+}
+
+void
+HttpdShard::RemoveClient(HttpdClient &client) noexcept
+{
+	assert(!clients.empty());
+
+	clients.erase_and_dispose(clients.iterator_to(client),
+				  DeleteDisposer());
+}
+
+void
+HttpdShard::Publish(const HttpdStream &stream,
+		    std::span<const PagePtr> src) noexcept
+{
+	assert(!src.empty());
+
+	{
+		const std::lock_guard protect{mutex};
+		for (const auto &page : src)
+			pages.push_back({&stream, page, false});
+	}
+
+	inject_event.Schedule();
+}
+
+void
+HttpdShard::PublishHeader(const HttpdStream &stream,
+			  PagePtr header) noexcept
+{
+	assert(header != nullptr);
+
+	{
+		const std::lock_guard protect{mutex};
+		pages.push_back({&stream, std::move(header), true});
+	}
+
+	inject_event.Schedule();
+}
+
+void
+HttpdShard::WaitPublished() noexcept
+{
+	std::unique_lock lock{mutex};
+	cond.wait(lock, [this]{ return pages.empty(); });
+}
+
+void
+HttpdShard::PushMetaData(const PagePtr &metadata) noexcept
+{
+	const std::lock_guard protect{mutex};
+	for (auto &client : clients)
+		client.PushMetaData(metadata);
+}
+
+void
+HttpdShard::SendHeader(HttpdClient &client) noexcept
+{
+	assert(loop.IsInside());
+
+	const auto *stream = client.GetStream();
+	if (stream == nullptr)
+		return;
+
+	const std::lock_guard protect{mutex};
+
+	const auto i = streams.find(stream);
+	if (i == streams.end())
+		return;
+
+	const auto &state = i->second;
+	if (state.header != nullptr)
+		client.PushPage(state.header);
+
+	for (std::size_t j = 0; j < state.burst.size(); ++j)
+		client.PushPage(state.burst[j]);
+}
+
+void
+HttpdShard::Cancel() noexcept
+{
+	assert(loop.IsInside());
+
+	const std::lock_guard protect{mutex};
+
+	/* keep header pages which have not been processed yet; they
+	   are still needed for new clients */
+	for (auto &i : pages)
+		if (i.header)
+			streams[i.stream].header = std::move(i.page);
+
+	pages.clear();
+
+	for (auto &[stream, state] : streams)
+		state.ClearBurst();
+
+	for (auto &client : clients)
+		client.CancelQueue();
+
+	cond.notify_all();
+}
+
+void
+HttpdShard::CloseClients() noexcept
+{
+	assert(loop.IsInside());
+
+	inject_event.Cancel();
+
+	const std::lock_guard protect{mutex};
+	clients.clear_and_dispose(DeleteDisposer());
+	new_sockets.clear();
+	pages.clear();
+	streams.clear();
+	cond.notify_all();
+}
+
+inline void
+HttpdShard::StreamState::AppendBurst(const HttpdStream &stream,
+				     PagePtr page) noexcept
+{
+	const std::size_t max_size = stream.GetBurstSize();
+	if (max_size == 0)
+		return;
+
+	burst_bytes += page->size();
+	burst.push_back(std::move(page));
+
+	/* drop whole pages from the front until it fits, and then
+	   until it starts at a frame boundary */
+	while (!burst.empty() &&
+	       (burst_bytes > max_size || !stream.IsSyncPoint(*burst.front())))
+		burst_bytes -= burst.pop_front()->size();
+}
+
+void
+HttpdShard::OnInject() noexcept
+{
+	/* this method runs in the shard's thread; it adds new
+	   clients and broadcasts pages to all clients */
+
+	const std::lock_guard protect{mutex};
+
+	for (auto &fd : new_sockets)
+		CreateClient(std::move(fd));
+	new_sockets.clear();
+
+	for (auto &i : pages) {
+		for (auto &client : clients)
+			if (client.GetStream() == i.stream)
+				client.PushPage(i.page);
+
+		auto &state = streams[i.stream];
+		if (i.header) {
+			state.header = std::move(i.page);
+			state.ClearBurst();
+		} else
+			state.AppendBurst(*i.stream, std::move(i.page));
+	}
+
+	pages.clear();
+
+	/* wake up the output thread that may be waiting for the
+	   queue to be flushed */
+	cond.notify_all();
+}
@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "HttpdClient.hxx"
+#include "Page.hxx"
+#include "PageQueue.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "event/InjectEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <span>
+#include <vector>
+
+class EventLoop;
+class EventThread;
+class HttpdOutput;
+class HttpdStream;
+
+/**
+ * A group of #HttpdClient instances of one #HttpdOutput which are
+ * driven by one #EventLoop.  By default, an output has only one
+ * shard which runs in the output's (i.e. MPD's I/O) #EventLoop;
+ * with the "io_threads" setting, each shard gets its own
+ * #EventThread, so a large number of listeners does not delay other
+ * users of the main loop.
+ *
+ * The output thread publishes each page to each shard once;
+ * distributing it to the clients is done in the shard's thread.
+ */
+class HttpdShard final {
+	HttpdOutput &httpd;
+
+	/**
+	 * The thread running #loop; nullptr if this shard uses the
+	 * output's #EventLoop.
+	 */
+	const std::unique_ptr<EventThread> thread;
+
+	EventLoop &loop;
+
+public:
+	/**
+	 * This mutex protects the client list, the page queue of
+	 * this shard and the page queues of all of its clients.
+	 */
+	mutable Mutex mutex;
+
+	/**
+	 * This condition gets signalled when #pages becomes empty.
+	 */
+	Cond cond;
+
+private:
+	/**
+	 * A linked list containing all clients of this shard.
+	 */
+	IntrusiveList<
+		HttpdClient, IntrusiveListBaseHookTraits<HttpdClient>,
+		IntrusiveListOptions{.constant_time_size = true}> clients;
+
+	struct PendingPage {
+		const HttpdStream *stream;
+
+		PagePtr page;
+
+		/**
+		 * Is this the new header page of the stream (i.e. the
+		 * first page after opening the encoder or after a tag
+		 * change)?
+		 */
+		bool header;
+	};
+
+	/**
+	 * What this shard remembers about each stream to be sent to
+	 * new clients.
+	 */
+	struct StreamState {
+		/**
+		 * The header page, which is sent to every client on
+		 * connect.
+		 */
+		PagePtr header;
+
+		/**
+		 * The most recent pages following the #header (see
+		 * HttpdStream::GetBurstSize()).  They are sent to new
+		 * clients right after the header, so players which
+		 * buffer several seconds before starting playback
+		 * don't need to wait for that much real-time data.
+		 */
+		PageQueue burst;
+
+		/**
+		 * The total size of all #burst pages [bytes].
+		 */
+		std::size_t burst_bytes = 0;
+
+		void ClearBurst() noexcept {
+			burst.clear();
+			burst_bytes = 0;
+		}
+
+		void AppendBurst(const HttpdStream &stream,
+				 PagePtr page) noexcept;
+	};
+
+	/**
+	 * Protected by #mutex.  This is kept per shard (and not in
+	 * #HttpdStream) and updated in the shard's thread while
+	 * pages are delivered, so a new client gets exactly the pages
+	 * it would otherwise miss, without gaps or duplicates.
+	 */
+	std::map<const HttpdStream *, StreamState> streams;
+
+	/**
+	 * Pages published by the output thread, to be passed to the
+	 * clients by OnInject().  Protected by #mutex.
+	 */
+	std::vector<PendingPage> pages;
+
+	/**
+	 * Connections accepted by the output's #EventLoop which are
+	 * waiting to be added in this shard's thread.  Protected by
+	 * #mutex.
+	 */
+	std::vector<UniqueSocketDescriptor> new_sockets;
+
+	InjectEvent inject_event;
+
+public:
+	/**
+	 * @param own_thread true to create a dedicated
+	 * #EventThread, false to use the given #EventLoop
+	 */
+	HttpdShard(HttpdOutput &_httpd, EventLoop &output_loop,
+		   bool own_thread);
+	~HttpdShard() noexcept;
+
+	HttpdShard(const HttpdShard &) = delete;
+	HttpdShard &operator=(const HttpdShard &) = delete;
+
+	EventLoop &GetEventLoop() const noexcept {
+		return loop;
+	}
+
+	/**
+	 * Returns the number of clients in this shard (including
+	 * accepted connections which have not been added yet).
+	 */
+	[[gnu::pure]]
+	std::size_t LockGetClientCount() const noexcept;
+
+	/**
+	 * Add a new connection to this shard.  May be called from any
+	 * thread.
+	 */
+	void AddClient(UniqueSocketDescriptor fd) noexcept;
+
+	/**
+	 * Removes a client from the list and deletes it.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void RemoveClient(HttpdClient &client) noexcept;
+
+	/**
+	 * Pass pages of one stream to all of its clients in this
+	 * shard.  Called by the output thread.
+	 */
+	void Publish(const HttpdStream &stream,
+		     std::span<const PagePtr> src) noexcept;
+
+	/**
+	 * Pass the new header page of a stream to this shard; it
+	 * replaces the old one for new clients and discards the back
+	 * buffer.  Called by the output thread.
+	 */
+	void PublishHeader(const HttpdStream &stream,
+			   PagePtr header) noexcept;
+
+	/**
+	 * Wait until this shard has passed all pages to its
+	 * clients.  Called by the output thread.
+	 */
+	void WaitPublished() noexcept;
+
+	/**
+	 * Pass ICY metadata to all clients.  Called by the output
+	 * thread.
+	 */
+	void PushMetaData(const PagePtr &metadata) noexcept;
+
+	/**
+	 * Sends the encoder header of the client's stream and the
+	 * back buffer to the client.  This is called right after the
+	 * response headers have been sent.  Must be called in this
+	 * shard's thread.
+	 */
+	void SendHeader(HttpdClient &client) noexcept;
+
+	/**
+	 * Discard all pending pages and the back buffers.  Must be
+	 * called in this shard's thread.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Disconnect all clients.  Must be called in this shard's
+	 * thread.
+	 */
+	void CloseClients() noexcept;
+
+private:
+	/**
+	 * Create a #HttpdClient for the given connection.  Must be
+	 * called in this shard's thread with the mutex locked.
+	 */
+	void CreateClient(UniqueSocketDescriptor &&fd) noexcept;
+
+	/* InjectEvent callback */
+	void OnInject() noexcept;
+};
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "HttpdStream.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/Configured.hxx"
+#include "pcm/Convert.hxx"
+#include "config/Block.hxx"
+#include "config/Parser.hxx"
+
+#include <fmt/core.h>
+
+#include <algorithm> // for std::copy()
+#include <cassert>
+#include <stdexcept>
+
+using std::string_view_literals::operator""sv;
+
+HttpdStream::HttpdStream(std::string_view _path, const ConfigBlock &block)
+	:path(_path),
+	 prepared_encoder(CreateConfiguredEncoder(block))
+{
+	/* determine content type */
+	content_type = prepared_encoder->GetMimeType();
+	if (content_type == nullptr)
+		content_type = "application/octet-stream";
+
+	if (const auto *param = block.GetBlockParam("burst_size"))
+		burst_size = param->With([](const char *s){
+			const std::size_t value = ParseSize(s);
+			if (value > MAX_BURST_SIZE)
+				throw std::invalid_argument{fmt::format("burst_size must not exceed {} bytes",
+									MAX_BURST_SIZE)};
+			return value;
+		});
+}
+
+HttpdStream::~HttpdStream() noexcept
+{
+	assert(encoder == nullptr);
+}
+
+bool
+HttpdStream::ImplementsTag() const noexcept
+{
+	assert(encoder != nullptr);
+
+	return encoder->ImplementsTag();
+}
+
+bool
+HttpdStream::IsSyncPoint(std::span<const std::byte> page) const noexcept
+{
+	const std::string_view mime{content_type};
+
+	if (mime == "audio/ogg"sv || mime == "application/ogg"sv)
+		/* "OggS" capture pattern */
+		return page.size() >= 4 &&
+			page[0] == std::byte{'O'} && page[1] == std::byte{'g'} &&
+			page[2] == std::byte{'g'} && page[3] == std::byte{'S'};
+
+	if (mime == "audio/mpeg"sv)
+		/* MPEG audio frame sync: 11 bits set */
+		return page.size() >= 2 && page[0] == std::byte{0xff} &&
+			(page[1] & std::byte{0xe0}) == std::byte{0xe0};
+
+	if (mime == "audio/flac"sv)
+		/* FLAC frame sync code 0x3ffe (14 bits) */
+		return page.size() >= 2 && page[0] == std::byte{0xff} &&
+			(page[1] & std::byte{0xfe}) == std::byte{0xf8};
+
+	/* no framing known (e.g. raw PCM) */
+	return true;
+}
+
+void
+HttpdStream::Open(AudioFormat &audio_format, bool may_modify)
+{
+	assert(encoder == nullptr);
+
+	AudioFormat encoder_format = audio_format;
+	encoder = prepared_encoder->Open(encoder_format);
+
+	if (may_modify)
+		audio_format = encoder_format;
+	else if (encoder_format != audio_format) {
+		try {
+			convert = std::make_unique<PcmConvert>(audio_format,
+							       encoder_format);
+		} catch (...) {
+			delete encoder;
+			encoder = nullptr;
+			throw;
+		}
+	}
+
+	unflushed_input = 0;
+}
+
+void
+HttpdStream::Close() noexcept
+{
+	assert(encoder != nullptr);
+
+	convert.reset();
+
+	delete encoder;
+	encoder = nullptr;
+}
+
+PagePtr
+HttpdStream::ReadPage() noexcept
+{
+	if (unflushed_input >= 65536) {
+		/* we have fed a lot of input into the encoder, but it
+		   didn't give anything back yet - flush now to avoid
+		   buffer underruns */
+		try {
+			encoder->Flush();
+		} catch (...) {
+			/* ignore */
+		}
+
+		unflushed_input = 0;
+	}
+
+	std::byte buffer[32768];
+
+	size_t size = 0;
+	do {
+		const auto b = std::span{buffer}.subspan(size);
+		const auto r = encoder->Read(b);
+		if (r.empty())
+			break;
+
+		unflushed_input = 0;
+
+		if (r.data() != b.data()) {
+			if (size == 0 && r.size() >= sizeof(buffer) / 2)
+				/* if the returned memory area is
+				   large (and nothing has been written
+				   to the stack buffer yet), copy
+				   right from the returned memory
+				   area, avoiding the copy into the
+				   buffer*/
+				return std::make_shared<Page>(r);
+
+			/* if the encoder did not write to the given
+			   buffer but instead returned its own buffer,
+			   we need to copy it so we have a contiguous
+			   buffer */
+			std::copy(r.begin(), r.end(), b.begin());
+		}
+
+		size += r.size();
+	} while (size < sizeof(buffer));
+
+	if (size == 0)
+		return nullptr;
+
+	return std::make_shared<Page>(std::span{buffer, size});
+}
+
+void
+HttpdStream::Write(std::span<const std::byte> src)
+{
+	if (convert != nullptr)
+		src = convert->Convert(src);
+
+	encoder->Write(src);
+
+	unflushed_input += src.size();
+}
+
+void
+HttpdStream::PreTag() noexcept
+{
+	/* flush the current stream, and end it */
+
+	try {
+		encoder->PreTag();
+	} catch (...) {
+		/* ignore */
+	}
+}
+
+void
+HttpdStream::SendTag(const Tag &tag) noexcept
+{
+	/* send the tag to the encoder - which starts a new stream
+	   now */
+
+	try {
+		encoder->SendTag(tag);
+		encoder->Flush();
+	} catch (...) {
+		/* ignore */
+	}
+}
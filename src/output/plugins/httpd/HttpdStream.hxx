@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Page.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+
+struct ConfigBlock;
+class PreparedEncoder;
+class Encoder;
+class PcmConvert;
+struct Tag;
+
+/**
+ * One encoder profile of a #HttpdOutput.  All streams of an output
+ * are fed with the same (filtered and converted) PCM data, and each
+ * one encodes it with its own encoder; clients choose a stream by
+ * the request path.
+ *
+ * Unless noted otherwise, all methods must be called from the
+ * output thread, with HttpdOutput::mutex unlocked.
+ */
+class HttpdStream {
+	/**
+	 * The request path (without the leading slash) which selects
+	 * this stream.  The default stream has an empty path; it is
+	 * used for all requests which do not match another stream.
+	 */
+	const std::string path;
+
+	/**
+	 * The configured encoder plugin.
+	 */
+	const std::unique_ptr<PreparedEncoder> prepared_encoder;
+	Encoder *encoder = nullptr;
+
+	/**
+	 * Converts the output's audio format to the one this encoder
+	 * requested; nullptr if the encoder accepts it as-is.  This
+	 * is only needed if different encoders have different
+	 * requirements (e.g. Opus which supports only a few sample
+	 * rates).
+	 */
+	std::unique_ptr<PcmConvert> convert;
+
+	/**
+	 * Number of bytes which were fed into the encoder, without
+	 * ever receiving new output.  This is used to estimate
+	 * whether MPD should manually flush the encoder, to avoid
+	 * buffer underruns in the client.
+	 */
+	std::size_t unflushed_input = 0;
+
+	/**
+	 * The MIME type produced by the #encoder.
+	 */
+	const char *content_type;
+
+	/**
+	 * The configured "burst_size": the maximum number of bytes of
+	 * recent encoder output which is sent to new clients right
+	 * after the #header; 0 disables the back buffer.
+	 */
+	std::size_t burst_size = 0;
+
+public:
+	/**
+	 * The upper limit for "burst_size"; it must be well below the
+	 * queue size at which HttpdClient::PushPage() considers a
+	 * client too slow.
+	 */
+	static constexpr std::size_t MAX_BURST_SIZE = 128 * 1024;
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param block the configuration of the encoder
+	 */
+	HttpdStream(std::string_view _path, const ConfigBlock &block);
+	~HttpdStream() noexcept;
+
+	HttpdStream(const HttpdStream &) = delete;
+	HttpdStream &operator=(const HttpdStream &) = delete;
+
+	const std::string &GetPath() const noexcept {
+		return path;
+	}
+
+	const char *GetContentType() const noexcept {
+		return content_type;
+	}
+
+	std::size_t GetBurstSize() const noexcept {
+		return burst_size;
+	}
+
+	/**
+	 * Can a client start decoding at the beginning of this
+	 * (encoded) page?  This checks for the frame or page sync
+	 * code of the container format, so the back buffer never
+	 * starts in the middle of a frame.
+	 */
+	[[gnu::pure]]
+	bool IsSyncPoint(std::span<const std::byte> page) const noexcept;
+
+	/**
+	 * Does this encoder embed tags into the stream?  If not, the
+	 * stream supports ICY metadata.  May only be called while
+	 * the stream is open.
+	 */
+	[[gnu::pure]]
+	bool ImplementsTag() const noexcept;
+
+	/**
+	 * Open the encoder.  The header page (sent to every new
+	 * client) must be read by the caller with ReadPage()
+	 * afterwards.
+	 *
+	 * Throws on error.
+	 *
+	 * @param audio_format the format of the PCM data passed to
+	 * Write(); the first stream may modify it (because there is
+	 * no conversion yet), all others get a #PcmConvert instance
+	 * if their encoder needs a different format
+	 * @param may_modify true if this stream determines the
+	 * output's audio format
+	 */
+	void Open(AudioFormat &audio_format, bool may_modify);
+
+	void Close() noexcept;
+
+	/**
+	 * Reads data from the encoder (as much as available) and
+	 * returns it as a new #Page object.
+	 */
+	PagePtr ReadPage() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Write(std::span<const std::byte> src);
+
+	/**
+	 * End the current stream; the caller must then read the
+	 * remaining pages with ReadPage() before calling SendTag().
+	 */
+	void PreTag() noexcept;
+
+	/**
+	 * Send a tag to the encoder and flush it; the following
+	 * ReadPage() call returns the new header page.
+	 */
+	void SendTag(const Tag &tag) noexcept;
+};
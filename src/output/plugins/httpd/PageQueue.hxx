@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Page.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <algorithm> // for std::move()
+#include <cassert>
+#include <cstddef>
+
+/**
+ * A FIFO of #PagePtr instances, implemented as a ring buffer.  Unlike
+ * a std::list, it does not allocate memory for each page; the buffer
+ * grows (to the next power of two) when it is full and is never
+ * shrunk, so a client which has reached its typical queue length
+ * does not allocate at all.
+ */
+class PageQueue {
+	static constexpr std::size_t INITIAL_CAPACITY = 16;
+
+	/**
+	 * The ring buffer; its size is always a power of two (or
+	 * zero).
+	 */
+	AllocatedArray<PagePtr> buffer;
+
+	/**
+	 * The index of the first page.
+	 */
+	std::size_t head = 0;
+
+	/**
+	 * The number of pages in the queue.
+	 */
+	std::size_t n = 0;
+
+public:
+	bool empty() const noexcept {
+		return n == 0;
+	}
+
+	std::size_t size() const noexcept {
+		return n;
+	}
+
+	/**
+	 * Returns the page at the given position, 0 being the front.
+	 */
+	const PagePtr &operator[](std::size_t i) const noexcept {
+		assert(i < n);
+
+		return buffer[(head + i) & (buffer.size() - 1)];
+	}
+
+	const PagePtr &front() const noexcept {
+		return (*this)[0];
+	}
+
+	void push_back(PagePtr page) noexcept {
+		if (n == buffer.size())
+			Grow();
+
+		buffer[(head + n) & (buffer.size() - 1)] = std::move(page);
+		++n;
+	}
+
+	/**
+	 * Remove the first page and return it.
+	 */
+	PagePtr pop_front() noexcept {
+		assert(!empty());
+
+		PagePtr page = std::move(buffer[head]);
+		head = (head + 1) & (buffer.size() - 1);
+		--n;
+		return page;
+	}
+
+	/**
+	 * Remove all pages (but keep the buffer allocated).
+	 */
+	void clear() noexcept {
+		while (!empty())
+			pop_front();
+
+		head = 0;
+	}
+
+private:
+	void Grow() noexcept {
+		AllocatedArray<PagePtr> new_buffer(std::max(buffer.size() * 2,
+							    INITIAL_CAPACITY));
+
+		for (std::size_t i = 0; i < n; ++i)
+			new_buffer[i] = std::move(buffer[(head + i) & (buffer.size() - 1)]);
+
+		buffer = std::move(new_buffer);
+		head = 0;
+	}
+};
@@ -14,10 +14,17 @@
 #include "util/SpanCast.hxx"
 #include "Log.hxx"
 
+#include <algorithm> // for std::copy()
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <string_view>
 
+#ifndef _WIN32
+#include <sys/socket.h> // for MSG_DONTWAIT
+#include <sys/uio.h> // for struct iovec
+#endif
+
 SnapcastClient::SnapcastClient(SnapcastOutput &_output,
 			       UniqueSocketDescriptor _fd) noexcept
 	:BufferedSocket(_fd.Release(), _output.GetEventLoop()),
@@ -54,43 +61,57 @@ SnapcastClient::Push(SnapcastChunkPtr chunk) noexcept
 	event.ScheduleWrite();
 }
 
-SnapcastChunkPtr
-SnapcastClient::LockPopQueue() noexcept
+void
+SnapcastClient::LockPopQueue(ChunkBatch &batch) noexcept
 {
 	const std::lock_guard protect{output.mutex};
 	if (chunks.empty())
-		return nullptr;
+		return;
 
-	auto chunk = std::move(chunks.front());
-	chunks.pop();
+	while (!chunks.empty() && !batch.full()) {
+		batch.push_back(std::move(chunks.front()));
+		chunks.pop();
+	}
 
 	if (chunks.empty())
 		output.drain_cond.notify_one();
-
-	return chunk;
 }
 
 void
 SnapcastClient::OnSocketReady(unsigned flags) noexcept
 {
 	if (flags & SocketEvent::WRITE) {
+		if (!SendUnsent()) {
+			LockClose();
+			return;
+		}
+
 		constexpr auto max_age = std::chrono::milliseconds(500);
 		const auto min_time = GetEventLoop().SteadyNow() - max_age;
 
-		while (auto chunk = LockPopQueue()) {
-			if (chunk->time < min_time)
-				/* discard old chunks */
-				continue;
+		while (!HasUnsent()) {
+			ChunkBatch batch;
+			LockPopQueue(batch);
+			if (batch.empty()) {
+				event.CancelWrite();
+				break;
+			}
+
+			/* discard old chunks */
+			const auto old_end = std::find_if(batch.begin(), batch.end(),
+							  [min_time](const auto &chunk){
+								  return chunk->time >= min_time;
+							  });
+			const std::span<const SnapcastChunkPtr> fresh{old_end, batch.end()};
 
-			const std::span payload = chunk->payload;
-			if (!SendWireChunk(payload, chunk->time)) {
-				// TODO: handle EAGAIN
+			if (!fresh.empty() && !SendWireChunks(fresh)) {
 				LockClose();
 				return;
 			}
 		}
 
-		event.CancelWrite();
+		/* if there is still unsent data, the WRITE event
+		   remains scheduled */
 	}
 
 	BufferedSocket::OnSocketReady(flags);
@@ -193,34 +214,136 @@ bool
 SnapcastClient::SendTime(const SnapcastBase &request_header,
 			 const SnapcastTime &request_payload) noexcept
 {
+	if (HasUnsent() && (!SendUnsent() || HasUnsent()))
+		/* the socket is congested and the rest of a wire
+		   chunk needs to be sent first; skip this reply, the
+		   client will ask again */
+		return true;
+
 	return ::SendTime(GetSocket(), next_id++,
 			  request_header, request_payload);
 }
 
-static bool
-SendWireChunk(SocketDescriptor s, const PackedBE16 id,
-	      const std::span<const std::byte> payload,
-	      std::chrono::steady_clock::time_point t) noexcept
+/**
+ * The headers preceding the payload of a wire chunk.
+ */
+struct SnapcastWireChunkHeader {
+	SnapcastBase base;
+	SnapcastWireChunk chunk;
+};
+
+static_assert(sizeof(SnapcastWireChunkHeader) == sizeof(SnapcastBase) + sizeof(SnapcastWireChunk));
+
+static void
+FillWireChunkHeader(SnapcastWireChunkHeader &h, const PackedBE16 id,
+		    const SnapcastChunk &chunk,
+		    SnapcastTimestamp sent) noexcept
 {
-	SnapcastWireChunk hdr{};
-	hdr.timestamp = ToSnapcastTimestamp(t);
-	hdr.size = payload.size();
+	h = {};
+	h.chunk.timestamp = ToSnapcastTimestamp(chunk.time);
+	h.chunk.size = chunk.payload.size();
+
+	h.base.type = uint16_t(SnapcastMessageType::WIRE_CHUNK);
+	h.base.id = id;
+	h.base.sent = sent;
+	h.base.size = sizeof(h.chunk) + chunk.payload.size();
+}
 
-	SnapcastBase base{};
-	base.type = uint16_t(SnapcastMessageType::WIRE_CHUNK);
-	base.id = id;
-	base.sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
-	base.size = sizeof(hdr) + payload.size();
+bool
+SnapcastClient::SendUnsent() noexcept
+{
+	if (!HasUnsent())
+		return true;
 
-	// TODO: no blocking send()
-	return SendT(s, base) && SendT(s, hdr) && Send(s, payload);
+	const auto nbytes = GetSocket().WriteNoWait(std::span{unsent}.subspan(unsent_position));
+	if (nbytes < 0) {
+		const auto e = GetSocketError();
+		return IsSocketErrorSendWouldBlock(e);
+	}
+
+	unsent_position += nbytes;
+	if (!HasUnsent()) {
+		unsent = {};
+		unsent_position = 0;
+	}
+
+	return true;
 }
 
 bool
-SnapcastClient::SendWireChunk(std::span<const std::byte> payload,
-			      std::chrono::steady_clock::time_point t) noexcept
+SnapcastClient::SendWireChunks(std::span<const SnapcastChunkPtr> batch) noexcept
 {
-	return ::SendWireChunk(GetSocket(), next_id++, payload, t);
+	assert(!batch.empty());
+	assert(batch.size() <= MAX_BATCH);
+	assert(!HasUnsent());
+
+	const auto sent = ToSnapcastTimestamp(std::chrono::steady_clock::now());
+
+	std::array<SnapcastWireChunkHeader, MAX_BATCH> headers;
+	StaticVector<std::span<const std::byte>, MAX_BATCH * 2> buffers;
+	std::size_t total = 0;
+
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		const auto &chunk = *batch[i];
+		FillWireChunkHeader(headers[i], next_id++, chunk, sent);
+
+		buffers.push_back(ReferenceAsBytes(headers[i]));
+		buffers.push_back(chunk.payload);
+		total += sizeof(headers[i]) + chunk.payload.size();
+	}
+
+#ifdef _WIN32
+	/* no sendmsg() on Windows: concatenate all buffers */
+	AllocatedArray<std::byte> concat{total};
+	std::size_t fill = 0;
+	for (const auto &b : buffers) {
+		std::copy(b.begin(), b.end(), concat.begin() + fill);
+		fill += b.size();
+	}
+
+	ssize_t nbytes = GetSocket().WriteNoWait(concat);
+#else
+	StaticVector<struct iovec, MAX_BATCH * 2> iov;
+	for (const auto &b : buffers)
+		iov.push_back({
+			.iov_base = const_cast<std::byte *>(b.data()),
+			.iov_len = b.size(),
+		});
+
+	ssize_t nbytes = GetSocket().Send(iov, MSG_DONTWAIT);
+#endif
+
+	if (nbytes < 0) {
+		const auto e = GetSocketError();
+		if (!IsSocketErrorSendWouldBlock(e))
+			return false;
+
+		nbytes = 0;
+	}
+
+	if (std::size_t(nbytes) == total)
+		return true;
+
+	/* copy the rest to the #unsent buffer, so the framing stays
+	   intact */
+	unsent = AllocatedArray<std::byte>{total - nbytes};
+	unsent_position = 0;
+
+	std::size_t skip = nbytes, fill = 0;
+	for (auto b : buffers) {
+		if (skip >= b.size()) {
+			skip -= b.size();
+			continue;
+		}
+
+		b = b.subspan(skip);
+		skip = 0;
+		std::copy(b.begin(), b.end(), unsent.begin() + fill);
+		fill += b.size();
+	}
+
+	assert(fill == unsent.size());
+	return true;
 }
 
 static bool
@@ -241,6 +364,10 @@ SendStreamTags(SocketDescriptor s, const PackedBE16 id,
 void
 SnapcastClient::SendStreamTags(std::span<const std::byte> payload) noexcept
 {
+	if (HasUnsent() && (!SendUnsent() || HasUnsent()))
+		/* can't interrupt a partially sent wire chunk */
+		return;
+
 	::SendStreamTags(GetSocket(), next_id++, payload);
 }
 
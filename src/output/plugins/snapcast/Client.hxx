@@ -6,9 +6,12 @@
 
 #include "Chunk.hxx"
 #include "event/BufferedSocket.hxx"
+#include "util/AllocatedArray.hxx"
 #include "util/IntrusiveList.hxx"
+#include "util/StaticVector.hxx"
 
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <span>
 
@@ -26,6 +29,19 @@ class SnapcastClient final : BufferedSocket, public IntrusiveListHook<>
 	 */
 	SnapcastChunkQueue chunks;
 
+	/**
+	 * The tail of a batch of wire chunks which the socket did not
+	 * accept completely.  It must be sent before any other
+	 * message.
+	 */
+	AllocatedArray<std::byte> unsent;
+
+	/**
+	 * The number of bytes of #unsent which have already been
+	 * sent.
+	 */
+	std::size_t unsent_position = 0;
+
 	uint16_t next_id = 1;
 
 	bool active = false;
@@ -67,10 +83,39 @@ public:
 	}
 
 private:
-	SnapcastChunkPtr LockPopQueue() noexcept;
+	/**
+	 * The maximum number of wire chunks sent with one sendmsg()
+	 * call.
+	 */
+	static constexpr std::size_t MAX_BATCH = 32;
+
+	using ChunkBatch = StaticVector<SnapcastChunkPtr, MAX_BATCH>;
 
-	bool SendWireChunk(std::span<const std::byte> payload,
-			   std::chrono::steady_clock::time_point t) noexcept;
+	/**
+	 * Move chunks from the queue to the given batch (as many as
+	 * fit).
+	 */
+	void LockPopQueue(ChunkBatch &batch) noexcept;
+
+	bool HasUnsent() const noexcept {
+		return unsent_position < unsent.size();
+	}
+
+	/**
+	 * Try to send the rest of #unsent.
+	 *
+	 * @return false on error
+	 */
+	bool SendUnsent() noexcept;
+
+	/**
+	 * Send all chunks of the batch (with one system call, if
+	 * possible).  If the socket accepts only a part, the rest is
+	 * copied to #unsent.
+	 *
+	 * @return false on error
+	 */
+	bool SendWireChunks(std::span<const SnapcastChunkPtr> batch) noexcept;
 
 	bool SendServerSettings(const SnapcastBase &request) noexcept;
 	bool SendCodecHeader(const SnapcastBase &request) noexcept;
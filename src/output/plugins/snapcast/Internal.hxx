@@ -16,6 +16,7 @@
 
 #include "config.h" // for HAVE_ZEROCONF
 
+#include <chrono>
 #include <memory>
 
 struct ConfigBlock;
@@ -63,6 +64,35 @@ class SnapcastOutput final : AudioOutput, ServerSocket {
 	 */
 	size_t unflushed_input = 0;
 
+	/**
+	 * The configured "chunk_ms" setting: the duration of each
+	 * wire chunk.  Zero means each encoder output becomes one
+	 * chunk.
+	 */
+	const std::chrono::milliseconds chunk_duration;
+
+	/**
+	 * The size of a wire chunk in bytes, calculated from
+	 * #chunk_duration by Open(); zero if disabled.
+	 */
+	std::size_t chunk_size = 0;
+
+	/**
+	 * Encoder output collected for the next wire chunk (only if
+	 * #chunk_size is non-zero).
+	 */
+	AllocatedArray<std::byte> chunk_buffer;
+
+	/**
+	 * The number of bytes in #chunk_buffer.
+	 */
+	std::size_t chunk_fill = 0;
+
+	/**
+	 * The time stamp of the first data in #chunk_buffer.
+	 */
+	std::chrono::steady_clock::time_point chunk_time;
+
 	/**
 	 * A #Timer object to synchronize this output with the
 	 * wallclock.
@@ -176,6 +206,30 @@ public:
 private:
 	void OnInject() noexcept;
 
+	/**
+	 * Enqueue a new chunk for all clients.
+	 *
+	 * Mutex must not be locked.
+	 */
+	void PushChunk(std::chrono::steady_clock::time_point time,
+		       std::span<const std::byte> payload);
+
+	/**
+	 * Pass encoder output to the clients, collecting it in
+	 * #chunk_buffer first if "chunk_ms" is enabled.
+	 *
+	 * Mutex must not be locked.
+	 */
+	void AppendChunkData(std::chrono::steady_clock::time_point time,
+			     std::span<const std::byte> payload);
+
+	/**
+	 * Enqueue the partial chunk in #chunk_buffer.
+	 *
+	 * Mutex must not be locked.
+	 */
+	void FlushChunk();
+
 	/**
 	 * Caller must lock the mutex.
 	 */
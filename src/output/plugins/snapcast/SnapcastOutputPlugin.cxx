@@ -26,7 +26,9 @@
 #include <nlohmann/json.hpp>
 #endif
 
+#include <algorithm> // for std::copy_n()
 #include <cassert>
+#include <stdexcept>
 
 #include <string.h>
 
@@ -37,8 +39,12 @@ SnapcastOutput::SnapcastOutput(EventLoop &_loop, const ConfigBlock &block)
 	 ServerSocket(_loop),
 	 inject_event(_loop, BIND_THIS_METHOD(OnInject)),
 	 // TODO: support other encoder plugins?
-	 prepared_encoder(encoder_init(wave_encoder_plugin, block))
+	 prepared_encoder(encoder_init(wave_encoder_plugin, block)),
+	 chunk_duration(block.GetBlockValue("chunk_ms", 0U))
 {
+	if (chunk_duration > std::chrono::seconds(1))
+		throw std::runtime_error("chunk_ms is too large");
+
 	const unsigned port = block.GetBlockValue("port", 1704U);
 	ServerSocketAddGeneric(*this, block.GetBlockValue("bind_to_address"),
 			       port);
@@ -136,6 +142,11 @@ SnapcastOutput::Open(AudioFormat &audio_format)
 
 	/* initialize other attributes */
 
+	chunk_size = audio_format.TimeToSize(chunk_duration);
+	if (chunk_size > 0)
+		chunk_buffer = AllocatedArray<std::byte>{chunk_size};
+	chunk_fill = 0;
+
 	timer = new Timer(audio_format);
 
 	open = true;
@@ -159,6 +170,9 @@ SnapcastOutput::Close() noexcept
 
 	ClearQueue(chunks);
 
+	chunk_buffer = {};
+	chunk_fill = 0;
+
 	codec_header = std::span<const std::byte>{};
 	delete encoder;
 }
@@ -271,6 +285,53 @@ SnapcastOutput::SendTag(const Tag &tag)
 #endif
 }
 
+void
+SnapcastOutput::PushChunk(std::chrono::steady_clock::time_point time,
+			  std::span<const std::byte> payload)
+{
+	auto chunk = std::make_shared<SnapcastChunk>(time, AllocatedArray{payload});
+
+	const std::lock_guard protect{mutex};
+	if (chunks.empty())
+		inject_event.Schedule();
+
+	chunks.push(std::move(chunk));
+}
+
+void
+SnapcastOutput::AppendChunkData(std::chrono::steady_clock::time_point time,
+				std::span<const std::byte> payload)
+{
+	if (chunk_size == 0) {
+		PushChunk(time, payload);
+		return;
+	}
+
+	while (!payload.empty()) {
+		if (chunk_fill == 0)
+			chunk_time = time;
+
+		const std::size_t n = std::min(payload.size(),
+					       chunk_size - chunk_fill);
+		std::copy_n(payload.begin(), n, chunk_buffer.begin() + chunk_fill);
+		chunk_fill += n;
+		payload = payload.subspan(n);
+
+		if (chunk_fill == chunk_size)
+			FlushChunk();
+	}
+}
+
+void
+SnapcastOutput::FlushChunk()
+{
+	if (chunk_fill == 0)
+		return;
+
+	PushChunk(chunk_time, std::span{chunk_buffer}.first(chunk_fill));
+	chunk_fill = 0;
+}
+
 std::size_t
 SnapcastOutput::Play(std::span<const std::byte> src)
 {
@@ -310,11 +371,7 @@ SnapcastOutput::Play(std::span<const std::byte> src)
 
 		unflushed_input = 0;
 
-		const std::lock_guard protect{mutex};
-		if (chunks.empty())
-			inject_event.Schedule();
-
-		chunks.push(std::make_shared<SnapcastChunk>(now, AllocatedArray{payload}));
+		AppendChunkData(now, payload);
 	}
 
 	return src.size();
@@ -340,6 +397,8 @@ SnapcastOutput::IsDrained() const noexcept
 void
 SnapcastOutput::Drain()
 {
+	FlushChunk();
+
 	std::unique_lock protect{mutex};
 	drain_cond.wait(protect, [this]{ return IsDrained(); });
 }
@@ -347,6 +406,8 @@ SnapcastOutput::Drain()
 void
 SnapcastOutput::Cancel() noexcept
 {
+	chunk_fill = 0;
+
 	const std::lock_guard protect{mutex};
 
 	ClearQueue(chunks);
@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ChannelRouter.hxx"
+#include "Traits.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator> // for std::size()
+#include <utility> // for std::index_sequence
+
+/**
+ * A routing pattern which gets its own kernel.  This is a structural
+ * type, so it can be used as a template argument and the compiler
+ * sees all indices as constants.
+ */
+struct FixedRoute {
+	unsigned src_channels, dest_channels;
+
+	PcmChannelRoute sources;
+};
+
+/**
+ * A helper for writing #FixedRoute constants: the given indices,
+ * padded with -1.
+ */
+template<typename... Args>
+static consteval PcmChannelRoute
+MakeRoute(Args... args) noexcept
+{
+	PcmChannelRoute route;
+	route.fill(-1);
+
+	std::size_t i = 0;
+	((route[i++] = args), ...);
+	return route;
+}
+
+/**
+ * The table-driven fallback for all routes which have no
+ * #FixedRoute.  The number of output channels is a template
+ * parameter, so the inner loop gets unrolled.
+ *
+ * To avoid a branch per sample, outputs without a source read
+ * channel 0 and replace the value using a bit mask.
+ */
+template<typename T, unsigned DEST>
+static void
+GenericRoute(const PcmChannelRouter::Table &table,
+	     void *_dest, const void *_src, std::size_t n_frames) noexcept
+{
+	auto *__restrict dest = static_cast<T *>(_dest);
+	const auto *__restrict src = static_cast<const T *>(_src);
+	const unsigned src_channels = table.src_channels;
+
+	std::array<uint8_t, DEST> indices;
+	std::array<T, DEST> masks, fills;
+	for (unsigned c = 0; c < DEST; ++c) {
+		const bool silent = table.sources[c] < 0;
+		indices[c] = silent ? 0 : table.sources[c];
+		masks[c] = silent ? T(0) : T(~T(0));
+		fills[c] = silent ? T(table.silence) : T(0);
+	}
+
+	for (; n_frames > 0; --n_frames, src += src_channels, dest += DEST)
+		for (unsigned c = 0; c < DEST; ++c)
+			dest[c] = (src[indices[c]] & masks[c]) | fills[c];
+}
+
+template<typename T, std::size_t... I>
+static constexpr auto
+MakeGenericRouteKernels(std::index_sequence<I...>) noexcept
+{
+	using Function = void (*)(const PcmChannelRouter::Table &,
+				  void *, const void *, std::size_t) noexcept;
+
+	return std::array<Function, sizeof...(I)>{
+		GenericRoute<T, I + 1>...
+	};
+}
+
+/**
+ * The #GenericRoute kernels for all numbers of output channels.
+ */
+template<typename T>
+static constexpr auto generic_route_kernels =
+	MakeGenericRouteKernels<T>(std::make_index_sequence<MAX_CHANNELS>());
+
+/**
+ * Copy one frame according to a #FixedRoute.  This is a fold
+ * expression over all output channels (and not a loop), so each
+ * index is a constant and there is no branch left.
+ */
+template<typename T, FixedRoute R, std::size_t... C>
+[[gnu::always_inline]]
+static inline void
+FixedRouteFrame(T *__restrict dest, const T *__restrict src, T silence,
+		std::index_sequence<C...>) noexcept
+{
+	((dest[C] = R.sources[C] >= 0 ? src[R.sources[C]] : silence), ...);
+}
+
+/**
+ * A kernel for one #FixedRoute.
+ */
+template<typename T, FixedRoute R>
+static void
+FixedRouteKernel(const PcmChannelRouter::Table &table,
+		 void *_dest, const void *_src, std::size_t n_frames) noexcept
+{
+	auto *__restrict dest = static_cast<T *>(_dest);
+	const auto *__restrict src = static_cast<const T *>(_src);
+	const T silence(table.silence);
+
+	for (; n_frames > 0; --n_frames) {
+		FixedRouteFrame<T, R>(dest, src, silence,
+				      std::make_index_sequence<R.dest_channels>());
+
+		src += R.src_channels;
+		dest += R.dest_channels;
+	}
+}
+
+/**
+ * The routes which have a specialized kernel.
+ */
+static constexpr FixedRoute fixed_routes[] = {
+	/* duplicate mono */
+	{ 1, 2, MakeRoute(0, 0) },
+	{ 1, 6, MakeRoute(0, 0, 0, 0, 0, 0) },
+	{ 1, 8, MakeRoute(0, 0, 0, 0, 0, 0, 0, 0) },
+
+	/* swap left and right */
+	{ 2, 2, MakeRoute(1, 0) },
+
+	/* pick one channel of stereo */
+	{ 2, 1, MakeRoute(0) },
+	{ 2, 1, MakeRoute(1) },
+
+	/* stereo to the front channels of 5.1/7.1 */
+	{ 2, 6, MakeRoute(0, 1) },
+	{ 2, 8, MakeRoute(0, 1) },
+
+	/* stereo to front and rear (and side) of 5.1/7.1, with
+	   silent center and LFE */
+	{ 2, 6, MakeRoute(0, 1, -1, -1, 0, 1) },
+	{ 2, 8, MakeRoute(0, 1, -1, -1, 0, 1, 0, 1) },
+
+	/* stereo fanned out to all channels */
+	{ 2, 4, MakeRoute(0, 1, 0, 1) },
+	{ 2, 6, MakeRoute(0, 1, 0, 1, 0, 1) },
+	{ 2, 8, MakeRoute(0, 1, 0, 1, 0, 1, 0, 1) },
+
+	/* the front channels of 5.1/7.1 */
+	{ 6, 2, MakeRoute(0, 1) },
+	{ 8, 2, MakeRoute(0, 1) },
+};
+
+static constexpr std::size_t n_fixed_routes = std::size(fixed_routes);
+
+/**
+ * Generate the array of kernels for all #fixed_routes for one sample
+ * type.
+ */
+template<typename T, std::size_t... I>
+static constexpr auto
+MakeFixedRouteKernels(std::index_sequence<I...>) noexcept
+{
+	using Function = void (*)(const PcmChannelRouter::Table &,
+				  void *, const void *, std::size_t) noexcept;
+
+	return std::array<Function, sizeof...(I)>{
+		FixedRouteKernel<T, fixed_routes[I]>...
+	};
+}
+
+template<typename T>
+static constexpr auto fixed_route_kernels =
+	MakeFixedRouteKernels<T>(std::make_index_sequence<n_fixed_routes>());
+
+/**
+ * Are the first #dest_channels elements of both routes equal?
+ */
+[[gnu::pure]]
+static bool
+IsSameRoute(const PcmChannelRoute &a, const PcmChannelRoute &b,
+	    unsigned dest_channels) noexcept
+{
+	return std::equal(a.begin(), a.begin() + dest_channels, b.begin());
+}
+
+/**
+ * @param generic_r set to true if the generic kernel was chosen
+ */
+template<typename T>
+static auto
+FindKernel(const PcmChannelRouter::Table &table, bool &generic_r) noexcept
+{
+	generic_r = false;
+
+	for (std::size_t i = 0; i < n_fixed_routes; ++i) {
+		const auto &r = fixed_routes[i];
+		if (r.src_channels == table.src_channels &&
+		    r.dest_channels == table.dest_channels &&
+		    IsSameRoute(r.sources, table.sources, table.dest_channels))
+			return fixed_route_kernels<T>[i];
+	}
+
+	generic_r = true;
+	return generic_route_kernels<T>[table.dest_channels - 1];
+}
+
+[[gnu::pure]]
+static bool
+IsIdentity(const PcmChannelRouter::Table &table) noexcept
+{
+	if (table.src_channels != table.dest_channels)
+		return false;
+
+	for (unsigned c = 0; c < table.dest_channels; ++c)
+		if (table.sources[c] != int(c))
+			return false;
+
+	return true;
+}
+
+void
+PcmChannelRouter::Open(SampleFormat format,
+		       unsigned src_channels, unsigned dest_channels,
+		       const PcmChannelRoute &sources) noexcept
+{
+	assert(audio_valid_sample_format(format));
+	assert(audio_valid_channel_count(src_channels));
+	assert(audio_valid_channel_count(dest_channels));
+
+	const unsigned sample_size = sample_format_size(format);
+
+	table.src_channels = src_channels;
+	table.dest_channels = dest_channels;
+
+	/* DSD is the only format whose silence is not zero */
+	table.silence = format == SampleFormat::DSD
+		? uint32_t(SampleTraits<SampleFormat::DSD>::SILENCE)
+		: 0;
+
+	table.sources.fill(-1);
+	for (unsigned c = 0; c < dest_channels; ++c)
+		if (sources[c] >= 0 && unsigned(sources[c]) < src_channels)
+			table.sources[c] = sources[c];
+
+	src_frame_size = sample_size * src_channels;
+	dest_frame_size = sample_size * dest_channels;
+
+	if (IsIdentity(table)) {
+		function = nullptr;
+		kernel_name = "identity";
+		return;
+	}
+
+	bool generic;
+	switch (sample_size) {
+	case 1:
+		function = FindKernel<uint8_t>(table, generic);
+		break;
+
+	case 2:
+		function = FindKernel<uint16_t>(table, generic);
+		break;
+
+	default:
+		function = FindKernel<uint32_t>(table, generic);
+		break;
+	}
+
+	kernel_name = generic ? "generic" : "fixed";
+}
+
+std::span<const std::byte>
+PcmChannelRouter::Convert(std::span<const std::byte> src) noexcept
+{
+	assert(src.size() % src_frame_size == 0);
+
+	if (function == nullptr)
+		return src;
+
+	const std::size_t n_frames = src.size() / src_frame_size;
+	const std::size_t dest_size = n_frames * dest_frame_size;
+	void *dest = buffer.Get(dest_size);
+
+	function(table, dest, src.data(), n_frames);
+	return { static_cast<const std::byte *>(dest), dest_size };
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "SampleFormat.hxx"
+#include "Buffer.hxx"
+#include "ChannelDefs.hxx"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * A routing table: for each output channel, the input channel it is
+ * copied from, or -1 for silence.
+ */
+using PcmChannelRoute = std::array<int8_t, MAX_CHANNELS>;
+
+/**
+ * Copies input channels to output channels according to a
+ * #PcmChannelRoute.  Open() compiles the table: common patterns
+ * (duplicating mono, swapping stereo, fanning stereo out to 5.1/7.1
+ * and picking the front channels) have kernels with the table known
+ * at compile time, which the compiler turns into stores of constant
+ * shuffles; all others use a generic loop.
+ */
+class PcmChannelRouter {
+public:
+	struct Table {
+		unsigned src_channels, dest_channels;
+
+		/**
+		 * The value of a silent sample.
+		 */
+		uint32_t silence;
+
+		/**
+		 * The routing table passed to Open(), with references
+		 * to nonexistent input channels replaced by -1.
+		 */
+		PcmChannelRoute sources;
+	};
+
+private:
+	using Function = void (*)(const Table &table,
+				  void *dest, const void *src,
+				  std::size_t n_frames) noexcept;
+
+	/**
+	 * The kernel; nullptr if the table is the identity, i.e. the
+	 * input is returned as-is.
+	 */
+	Function function;
+
+	const char *kernel_name;
+
+	Table table;
+
+	/**
+	 * The size of one input frame in bytes.
+	 */
+	std::size_t src_frame_size;
+
+	/**
+	 * The size of one output frame in bytes.
+	 */
+	std::size_t dest_frame_size;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * Opens the object, prepare for Convert().
+	 *
+	 * @param sources the routing table; only the first
+	 * #dest_channels elements are used, and references to input
+	 * channels which do not exist produce silence
+	 */
+	void Open(SampleFormat format,
+		  unsigned src_channels, unsigned dest_channels,
+		  const PcmChannelRoute &sources) noexcept;
+
+	/**
+	 * Returns the name of the kernel chosen by Open() (for
+	 * debugging and for the unit test).
+	 */
+	const char *GetKernelName() const noexcept {
+		return kernel_name;
+	}
+
+	/**
+	 * Convert a block of PCM data.
+	 *
+	 * @param src the input buffer
+	 * @return the destination buffer
+	 */
+	[[gnu::pure]]
+	std::span<const std::byte> Convert(std::span<const std::byte> src) noexcept;
+};
@@ -3,6 +3,9 @@
 
 #include "Convert.hxx"
 #include "ConfiguredResampler.hxx"
+#include "PcmFormat.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
 #include "util/SpanCast.hxx"
 
 #include <cassert>
@@ -12,6 +15,9 @@ void
 pcm_convert_global_init(const ConfigData &config)
 {
 	pcm_resampler_global_init(config);
+
+	pcm_set_float_dither(config.GetBool(ConfigOption::FLOAT_DITHER,
+					    false));
 }
 
 PcmConvert::PcmConvert(const AudioFormat _src_format,
@@ -37,13 +43,25 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 
 	enable_resampler = format.sample_rate != dest_format.sample_rate;
 	if (enable_resampler) {
-		resampler.Open(format, dest_format.sample_rate);
+		resampler.Open(format, dest_format.sample_rate,
+			       dest_format.format);
 
 		format.format = resampler.GetOutputSampleFormat();
 		format.sample_rate = dest_format.sample_rate;
 	}
 
 	enable_format = format.format != dest_format.format;
+	enable_channels = format.channels != dest_format.channels;
+
+	/* try to do both in one pass */
+	enable_fused = enable_format && enable_channels &&
+		fused_converter.Open(format.format, dest_format.format,
+				     format.channels, dest_format.channels);
+	if (enable_fused) {
+		enable_format = enable_channels = false;
+		return;
+	}
+
 	if (enable_format) {
 		try {
 			format_converter.Open(format.format,
@@ -57,7 +75,6 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 
 	format.format = dest_format.format;
 
-	enable_channels = format.channels != dest_format.channels;
 	if (enable_channels) {
 		try {
 			channels_converter.Open(format.format, format.channels,
@@ -74,6 +91,8 @@ PcmConvert::PcmConvert(const AudioFormat _src_format,
 
 PcmConvert::~PcmConvert() noexcept
 {
+	if (enable_fused)
+		fused_converter.Close();
 	if (enable_channels)
 		channels_converter.Close();
 	if (enable_format)
@@ -121,6 +140,9 @@ PcmConvert::Convert(std::span<const std::byte> buffer)
 	if (enable_channels)
 		buffer = channels_converter.Convert(buffer);
 
+	if (enable_fused)
+		buffer = fused_converter.Convert(buffer);
+
 	return buffer;
 }
 
@@ -136,6 +158,9 @@ PcmConvert::Flush()
 			if (enable_channels)
 				buffer = channels_converter.Convert(buffer);
 
+			if (enable_fused)
+				buffer = fused_converter.Convert(buffer);
+
 			return buffer;
 		}
 	}
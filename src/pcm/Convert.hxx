@@ -5,6 +5,7 @@
 
 #include "FormatConverter.hxx"
 #include "ChannelsConverter.hxx"
+#include "FusedConverter.hxx"
 #include "GlueResampler.hxx"
 #include "AudioFormat.hxx"
 #include "pcm/Features.h" // for ENABLE_DSD
@@ -32,10 +33,18 @@ class PcmConvert {
 	PcmFormatConverter format_converter;
 	PcmChannelsConverter channels_converter;
 
+	/**
+	 * Replaces #format_converter and #channels_converter if both
+	 * are needed and the combination is implemented.
+	 */
+	PcmFusedConverter fused_converter;
+
 	const AudioFormat src_format;
 
 	bool enable_resampler, enable_format, enable_channels;
 
+	bool enable_fused;
+
 #ifdef ENABLE_DSD
 	bool dsd2pcm_float;
 #endif
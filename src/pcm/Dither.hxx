@@ -5,18 +5,51 @@
 
 #include "Traits.hxx"
 
+#include <cstddef>
 #include <cstdint>
 
 enum class SampleFormat : uint8_t;
 
+/**
+ * The dithering state of the vectorized kernels (see
+ * VolumeKernels.cxx).  Each lane has its own error feedback and PRNG
+ * state, which makes consecutive samples independent of each
+ * other, so they can be processed by one SIMD instruction.
+ */
+struct PcmDitherLanes {
+	static constexpr std::size_t MAX = 8;
+
+	int32_t error[3][MAX]{};
+
+	/**
+	 * Different seeds, so the lanes do not generate the same
+	 * noise.
+	 */
+	uint32_t random[MAX]{
+		0x00000000, 0x9e3779b9, 0x3c6ef372, 0xdaa66d2b,
+		0x78dde6e4, 0x1715609d, 0xb54cda56, 0x5384540f,
+	};
+};
+
 class PcmDither {
 	int32_t error[3];
 	int32_t random;
 
+	PcmDitherLanes lanes;
+
 public:
 	constexpr PcmDither() noexcept
 		:error{0, 0, 0}, random(0) {}
 
+	/**
+	 * Access the state used by the vectorized kernels.  They load
+	 * it into vector registers before their loop and store it
+	 * afterwards.
+	 */
+	PcmDitherLanes &GetLanes() noexcept {
+		return lanes;
+	}
+
 	/**
 	 * Shift the given sample by #SBITS-#DBITS to the right, and
 	 * apply dithering.
@@ -36,8 +36,19 @@ or implied, of Sebastian Gesemann.
 #include "util/Compiler.h"
 #include "util/GenerateArray.hxx"
 
+#include <algorithm> // for std::copy_n()
 #include <cassert>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DSD2PCM_AVX2
+#elif defined(__ARM_NEON)
+/* there is no NEON gather instruction, but the batched scalar
+   kernel still saves the per-sample FIFO bit reversal and its
+   independent accumulators are vectorized by the compiler */
+#define DSD2PCM_BATCHED_SCALAR
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -169,6 +180,36 @@ GenerateCtableS24(size_t i) noexcept
 
 static constexpr auto ctables_s24 = GenerateArray<CTABLES>(GenerateCtableS24);
 
+static_assert(MultiDsd2Pcm::HISTORY == CTABLES * 2 - 1);
+
+/*
+ * The batched implementation reads the older half of the input
+ * bytes directly from the input buffer, instead of bit-reversing
+ * them in a FIFO.  These tables have the bit reversal folded in.
+ */
+
+template<typename T, std::size_t N>
+struct GenerateReversedCtable {
+	const std::array<std::array<T, 256>, N> &tables;
+	size_t i;
+
+	constexpr T operator()(size_t j) const noexcept {
+		return tables[i][static_cast<std::size_t>(BitReverseMultiplyModulus(static_cast<std::byte>(j)))];
+	}
+};
+
+template<typename T, std::size_t N>
+static constexpr auto
+GenerateReversedCtables(const std::array<std::array<T, 256>, N> &tables) noexcept
+{
+	return GenerateArray<N>([&tables](size_t i){
+		return GenerateArray<256>(GenerateReversedCtable<T, N>{tables, i});
+	});
+}
+
+static constexpr auto ctables_reversed = GenerateReversedCtables(ctables);
+static constexpr auto ctables_s24_reversed = GenerateReversedCtables(ctables_s24);
+
 void
 Dsd2Pcm::Reset() noexcept
 {
@@ -258,12 +299,206 @@ Dsd2Pcm::TranslateS24(size_t samples,
 	fifopos = ffp;
 }
 
+#if defined(DSD2PCM_AVX2) || defined(DSD2PCM_BATCHED_SCALAR)
+
+/**
+ * Calculate #n interleaved output samples from the input buffer (see
+ * TranslateAvx2() for the memory layout).  This is the portable
+ * batched kernel; it computes #BATCH consecutive output samples at a
+ * time so the additions are independent of each other.
+ */
+template<typename T, std::size_t N>
+static void
+TranslateBatchedScalar(const std::array<std::array<T, 256>, N> &tables,
+		       const std::array<std::array<T, 256>, N> &tables_reversed,
+		       const std::byte *src, size_t stride, size_t n,
+		       T *dest) noexcept
+{
+	constexpr size_t HISTORY = MultiDsd2Pcm::HISTORY;
+	constexpr size_t BATCH = 4;
+
+	size_t o = 0;
+	for (; o + BATCH <= n; o += BATCH) {
+		std::array<T, BATCH> acc{};
+		for (size_t i = 0; i < N; ++i) {
+			const std::byte *bite1 = src + o + (HISTORY - i) * stride;
+			const std::byte *bite2 = src + o + i * stride;
+			for (size_t j = 0; j < BATCH; ++j)
+				acc[j] += tables[i][static_cast<std::size_t>(bite1[j])] +
+					tables_reversed[i][static_cast<std::size_t>(bite2[j])];
+		}
+
+		std::copy_n(acc.data(), BATCH, dest + o);
+	}
+
+	for (; o < n; ++o) {
+		T acc{};
+		for (size_t i = 0; i < N; ++i) {
+			const auto bite1 = static_cast<std::size_t>(src[o + (HISTORY - i) * stride]);
+			const auto bite2 = static_cast<std::size_t>(src[o + i * stride]);
+			acc += tables[i][bite1] + tables_reversed[i][bite2];
+		}
+
+		dest[o] = acc;
+	}
+}
+
+static void
+TranslateScalar(const std::byte *src, size_t stride, size_t n,
+		float *dest) noexcept
+{
+	TranslateBatchedScalar(ctables, ctables_reversed,
+			       src, stride, n, dest);
+}
+
+static void
+TranslateScalarS24(const std::byte *src, size_t stride, size_t n,
+		   int32_t *dest) noexcept
+{
+	TranslateBatchedScalar(ctables_s24, ctables_s24_reversed,
+			       src, stride, n, dest);
+}
+
+#endif
+
+#ifdef DSD2PCM_AVX2
+
+static bool
+HaveAvx2() noexcept
+{
+	static const bool have_avx2 = [](){
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}();
+
+	return have_avx2;
+}
+
+/**
+ * Load 8 bytes and zero-extend them to 32 bit table indices.
+ */
+[[gnu::target("avx2")]] [[gnu::always_inline]]
+static inline __m256i
+LoadIndices(const std::byte *p) noexcept
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+}
+
+/**
+ * Calculate #n interleaved output samples.  Output sample #o uses
+ * the input bytes at src[o + k * stride] for k = 0..#HISTORY, where
+ * "stride" is the number of channels; this makes the table indices
+ * for 8 consecutive output samples (of any channel) 8 consecutive
+ * input bytes, which are fed to a gather instruction.
+ */
+[[gnu::target("avx2")]]
+static void
+TranslateAvx2(const std::byte *src, size_t stride, size_t n,
+	      float *dest) noexcept
+{
+	constexpr size_t HISTORY = MultiDsd2Pcm::HISTORY;
+
+	size_t o = 0;
+	for (; o + 8 <= n; o += 8) {
+		__m256 acc = _mm256_setzero_ps();
+		for (size_t i = 0; i < CTABLES; ++i) {
+			const __m256i bite1 = LoadIndices(src + o + (HISTORY - i) * stride);
+			const __m256i bite2 = LoadIndices(src + o + i * stride);
+			acc = _mm256_add_ps(acc, _mm256_i32gather_ps(ctables[i].data(), bite1, 4));
+			acc = _mm256_add_ps(acc, _mm256_i32gather_ps(ctables_reversed[i].data(), bite2, 4));
+		}
+
+		_mm256_storeu_ps(dest + o, acc);
+	}
+
+	TranslateScalar(src + o, stride, n - o, dest + o);
+}
+
+[[gnu::target("avx2")]]
+static void
+TranslateAvx2S24(const std::byte *src, size_t stride, size_t n,
+		 int32_t *dest) noexcept
+{
+	constexpr size_t HISTORY = MultiDsd2Pcm::HISTORY;
+
+	size_t o = 0;
+	for (; o + 8 <= n; o += 8) {
+		__m256i acc = _mm256_setzero_si256();
+		for (size_t i = 0; i < CTABLES; ++i) {
+			const __m256i bite1 = LoadIndices(src + o + (HISTORY - i) * stride);
+			const __m256i bite2 = LoadIndices(src + o + i * stride);
+			acc = _mm256_add_epi32(acc, _mm256_i32gather_epi32((const int *)ctables_s24[i].data(), bite1, 4));
+			acc = _mm256_add_epi32(acc, _mm256_i32gather_epi32((const int *)ctables_s24_reversed[i].data(), bite2, 4));
+		}
+
+		_mm256_storeu_si256((__m256i *)(dest + o), acc);
+	}
+
+	TranslateScalarS24(src + o, stride, n - o, dest + o);
+}
+
+#endif // DSD2PCM_AVX2
+
+void
+MultiDsd2Pcm::Reset() noexcept
+{
+	for (auto &i : per_channel)
+		i.Reset();
+	fifopos = 0;
+
+	history.fill(SampleTraits<SampleFormat::DSD>::SILENCE);
+}
+
+template<typename T, typename K>
+inline void
+MultiDsd2Pcm::TranslateBatched(unsigned channels, size_t n_frames,
+			       const std::byte *src, T *dest,
+			       K kernel) noexcept
+{
+	const size_t history_size = HISTORY * channels;
+
+	/* the first #HISTORY output frames need bytes from the
+	   history buffer; concatenate it with the beginning of the
+	   input in a small buffer */
+	const size_t head_frames = std::min(n_frames, HISTORY);
+	std::array<std::byte, 2 * HISTORY * MAX_CHANNELS> head;
+	std::copy_n(history.data(), history_size, head.data());
+	std::copy_n(src, head_frames * channels, head.data() + history_size);
+	kernel(head.data(), channels, head_frames * channels, dest);
+
+	/* all following output frames can be calculated directly
+	   from the input buffer */
+	if (n_frames > head_frames)
+		kernel(src, channels, (n_frames - head_frames) * channels,
+		       dest + head_frames * channels);
+
+	/* save the last #HISTORY input frames for the next call */
+	if (n_frames >= HISTORY)
+		std::copy_n(src + (n_frames - HISTORY) * channels,
+			    history_size, history.data());
+	else
+		std::copy_n(head.data() + n_frames * channels,
+			    history_size, history.data());
+}
+
 void
 MultiDsd2Pcm::Translate(unsigned channels, size_t n_frames,
 			const std::byte *src, float *dest) noexcept
 {
 	assert(channels <= per_channel.max_size());
 
+#ifdef DSD2PCM_AVX2
+	if (HaveAvx2()) {
+		TranslateBatched(channels, n_frames, src, dest,
+				 TranslateAvx2);
+		return;
+	}
+#elif defined(DSD2PCM_BATCHED_SCALAR)
+	TranslateBatched(channels, n_frames, src, dest,
+			 TranslateScalar);
+	return;
+#endif
+
 	if (channels == 2) {
 		TranslateStereo(n_frames, src, dest);
 		return;
@@ -295,6 +530,18 @@ MultiDsd2Pcm::TranslateS24(unsigned channels, size_t n_frames,
 {
 	assert(channels <= per_channel.max_size());
 
+#ifdef DSD2PCM_AVX2
+	if (HaveAvx2()) {
+		TranslateBatched(channels, n_frames, src, dest,
+				 TranslateAvx2S24);
+		return;
+	}
+#elif defined(DSD2PCM_BATCHED_SCALAR)
+	TranslateBatched(channels, n_frames, src, dest,
+			 TranslateScalarS24);
+	return;
+#endif
+
 	if (channels == 2) {
 		TranslateStereoS24(n_frames, src, dest);
 		return;
@@ -92,17 +92,31 @@ private:
 };
 
 class MultiDsd2Pcm {
+public:
+	/**
+	 * The number of previous input frames needed to calculate
+	 * one output frame.
+	 */
+	static constexpr size_t HISTORY = 11;
+
+private:
 	std::array<Dsd2Pcm, MAX_CHANNELS> per_channel;
 
 	size_t fifopos = 0;
 
+	/**
+	 * The last #HISTORY input frames (interleaved), used by the
+	 * batched implementation instead of the per-channel FIFOs.
+	 */
+	std::array<std::byte, HISTORY * MAX_CHANNELS> history;
+
 public:
-	void Reset() noexcept {
-		for (auto &i : per_channel)
-			i.Reset();
-		fifopos = 0;
+	MultiDsd2Pcm() noexcept {
+		Reset();
 	}
 
+	void Reset() noexcept;
+
 	void Translate(unsigned channels, size_t n_frames,
 		       const std::byte *src, float *dest) noexcept;
 
@@ -118,6 +132,17 @@ private:
 
 	void TranslateStereoS24(size_t n_frames,
 				const std::byte *src, int32_t *dest) noexcept;
+
+	/**
+	 * Convert all channels of a frame at once, with SIMD table
+	 * lookups (if the CPU supports them).  The kernel is invoked
+	 * with a pointer to the oldest input byte needed by the
+	 * first output sample.
+	 */
+	template<typename T, typename K>
+	void TranslateBatched(unsigned channels, size_t n_frames,
+			      const std::byte *src, T *dest,
+			      K kernel) noexcept;
 };
 
 #endif /* include guard DSD2PCM_H_INCLUDED */
@@ -0,0 +1,356 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "DsdKernels.hxx"
+#include "util/BitReverse.hxx"
+
+#include <array>
+#include <bit> // for std::endian
+
+#include <string.h> // for memcpy()
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM_KERNELS_X86
+#endif
+
+/*
+ * The scalar kernels; they process one byte at a time.
+ */
+
+static constexpr uint32_t
+pcm_two_dsd_to_dop_marker1(std::byte a, std::byte b) noexcept
+{
+	return 0xff050000 | (static_cast<uint32_t>(a) << 8) | static_cast<uint32_t>(b);
+}
+
+static constexpr uint32_t
+pcm_two_dsd_to_dop_marker2(std::byte a, std::byte b) noexcept
+{
+	return 0xfffa0000 | (static_cast<uint32_t>(a) << 8) | static_cast<uint32_t>(b);
+}
+
+static void
+ScalarDsdToDop(uint32_t *dest, const std::byte *src,
+	       std::size_t num_dop_quads, unsigned channels) noexcept
+{
+	for (std::size_t i = num_dop_quads; i > 0; --i) {
+		for (unsigned c = channels; c > 0; --c) {
+			/* each 24 bit sample has 16 DSD sample bits
+			   plus the magic 0x05 marker */
+
+			*dest++ = pcm_two_dsd_to_dop_marker1(src[0], src[channels]);
+
+			/* seek the source pointer to the next
+			   channel */
+			++src;
+		}
+
+		/* skip the second byte of each channel, because we
+		   have already copied it */
+		src += channels;
+
+		for (unsigned c = channels; c > 0; --c) {
+			/* each 24 bit sample has 16 DSD sample bits
+			   plus the magic 0xfa marker */
+
+			*dest++ = pcm_two_dsd_to_dop_marker2(src[0], src[channels]);
+
+			/* seek the source pointer to the next
+			   channel */
+			++src;
+		}
+
+		/* skip the second byte of each channel, because we
+		   have already copied it */
+		src += channels;
+	}
+}
+
+/**
+ * Construct a 16 bit integer from two bytes.
+ */
+static constexpr uint16_t
+Construct16(std::byte a, std::byte b) noexcept
+{
+	/* "a" is the oldest byte, which must be in the most
+	   significant byte */
+
+	return uint16_t(b) | (uint16_t(a) << 8);
+}
+
+static void
+ScalarDsd8To16(uint16_t *dest, const std::byte *src,
+	       std::size_t out_frames, unsigned channels) noexcept
+{
+	for (std::size_t i = 0; i < out_frames; ++i) {
+		for (std::size_t c = 0; c < channels; ++c, ++src)
+			*dest++ = Construct16(src[0], src[channels]);
+
+		src += channels;
+	}
+}
+
+/**
+ * Construct a 32 bit integer from four bytes.
+ */
+static constexpr uint32_t
+Construct32(std::byte a, std::byte b, std::byte c, std::byte d) noexcept
+{
+	/* "a" is the oldest byte, which must be in the most
+	   significant byte */
+
+	return uint32_t(d) | (uint32_t(c) << 8) |
+		(uint32_t(b) << 16) | (uint32_t(a) << 24);
+}
+
+static void
+ScalarDsd8To32(uint32_t *dest, const std::byte *src,
+	       std::size_t out_frames, unsigned channels) noexcept
+{
+	for (std::size_t i = 0; i < out_frames; ++i) {
+		for (std::size_t c = 0; c < channels; ++c, ++src)
+			*dest++ = Construct32(src[0], src[channels],
+					      src[2 * channels],
+					      src[3 * channels]);
+
+		src += 3 * channels;
+	}
+}
+
+static void
+ScalarBitReverse(std::byte *p, std::size_t n) noexcept
+{
+	for (std::byte *end = p + n; p != end; ++p)
+		*p = BitReverse(*p);
+}
+
+static constexpr PcmDsdKernels scalar_kernels{
+	"scalar",
+	ScalarDsdToDop,
+	ScalarDsd8To16,
+	ScalarDsd8To32,
+	ScalarBitReverse,
+};
+
+/*
+ * The vectorized kernels, written with GCC vector extensions (see
+ * VolumeKernels.cxx).  The packing kernels are byte shuffles with
+ * constant indices, which the compiler translates to PSHUFB or TBL.
+ * The shuffle indices assume a little-endian CPU; on big-endian
+ * CPUs, the scalar code is used.
+ */
+
+typedef uint8_t Bytes16 [[gnu::vector_size(16)]];
+
+/**
+ * Can the vectorized packing kernels be used for this channel
+ * count?
+ */
+static constexpr bool
+CanShuffle(unsigned channels) noexcept
+{
+	return std::endian::native == std::endian::little && channels == 2;
+}
+
+[[gnu::always_inline]]
+static inline void
+VectorDsdToDop(uint32_t *dest, const std::byte *src,
+	       std::size_t num_dop_quads, unsigned channels) noexcept
+{
+	if (CanShuffle(channels)) {
+		/* the second operand of each shuffle: the marker
+		   bytes at indices 16 (0x05), 17 (0xfa) and 18
+		   (0xff) */
+		constexpr Bytes16 markers{0x05, 0xfa, 0xff};
+
+		/* 16 source bytes are two stereo "quads", which
+		   become eight 32 bit samples */
+		for (; num_dop_quads >= 2;
+		     num_dop_quads -= 2, src += 16, dest += 8) {
+			Bytes16 x;
+			memcpy(&x, src, sizeof(x));
+
+			const Bytes16 a = __builtin_shufflevector(x, markers,
+								  2, 0, 16, 18,
+								  3, 1, 16, 18,
+								  6, 4, 17, 18,
+								  7, 5, 17, 18);
+			const Bytes16 b = __builtin_shufflevector(x, markers,
+								  10, 8, 16, 18,
+								  11, 9, 16, 18,
+								  14, 12, 17, 18,
+								  15, 13, 17, 18);
+
+			memcpy(dest, &a, sizeof(a));
+			memcpy(dest + 4, &b, sizeof(b));
+		}
+	}
+
+	ScalarDsdToDop(dest, src, num_dop_quads, channels);
+}
+
+[[gnu::always_inline]]
+static inline void
+VectorDsd8To16(uint16_t *dest, const std::byte *src,
+	       std::size_t out_frames, unsigned channels) noexcept
+{
+	if (CanShuffle(channels)) {
+		/* 16 source bytes become four stereo frames */
+		for (; out_frames >= 4; out_frames -= 4, src += 16, dest += 8) {
+			Bytes16 x;
+			memcpy(&x, src, sizeof(x));
+
+			x = __builtin_shufflevector(x, x,
+						    2, 0, 3, 1,
+						    6, 4, 7, 5,
+						    10, 8, 11, 9,
+						    14, 12, 15, 13);
+
+			memcpy(dest, &x, sizeof(x));
+		}
+	}
+
+	ScalarDsd8To16(dest, src, out_frames, channels);
+}
+
+[[gnu::always_inline]]
+static inline void
+VectorDsd8To32(uint32_t *dest, const std::byte *src,
+	       std::size_t out_frames, unsigned channels) noexcept
+{
+	if (CanShuffle(channels)) {
+		/* 16 source bytes become two stereo frames */
+		for (; out_frames >= 2; out_frames -= 2, src += 16, dest += 4) {
+			Bytes16 x;
+			memcpy(&x, src, sizeof(x));
+
+			x = __builtin_shufflevector(x, x,
+						    6, 4, 2, 0,
+						    7, 5, 3, 1,
+						    14, 12, 10, 8,
+						    15, 13, 11, 9);
+
+			memcpy(dest, &x, sizeof(x));
+		}
+	}
+
+	ScalarDsd8To32(dest, src, out_frames, channels);
+}
+
+/**
+ * Reverse the bits of each byte without a lookup table, by swapping
+ * neighboring bits, then bit pairs, then nibbles.
+ *
+ * @tparam L the number of bytes per vector
+ */
+template<std::size_t L>
+[[gnu::always_inline]]
+static inline void
+VectorBitReverse(std::byte *p, std::size_t n) noexcept
+{
+	typedef uint8_t Bytes [[gnu::vector_size(L)]];
+
+	for (; n >= L; n -= L, p += L) {
+		Bytes x;
+		memcpy(&x, p, sizeof(x));
+
+		x = ((x >> 1) & 0x55) | ((x & 0x55) << 1);
+		x = ((x >> 2) & 0x33) | ((x & 0x33) << 2);
+		x = (x >> 4) | (x << 4);
+
+		memcpy(p, &x, sizeof(x));
+	}
+
+	ScalarBitReverse(p, n);
+}
+
+/**
+ * Generate the functions of a #PcmDsdKernels instance, all compiled
+ * with the given function attributes.  L is the number of bytes per
+ * vector for VectorBitReverse().
+ */
+#define PCM_DSD_KERNELS(NAME, ATTRIBUTES, L) \
+	ATTRIBUTES static void \
+	NAME ## DsdToDop(uint32_t *dest, const std::byte *src, \
+			 std::size_t num_dop_quads, unsigned channels) noexcept \
+	{ \
+		VectorDsdToDop(dest, src, num_dop_quads, channels); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Dsd8To16(uint16_t *dest, const std::byte *src, \
+			 std::size_t out_frames, unsigned channels) noexcept \
+	{ \
+		VectorDsd8To16(dest, src, out_frames, channels); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Dsd8To32(uint32_t *dest, const std::byte *src, \
+			 std::size_t out_frames, unsigned channels) noexcept \
+	{ \
+		VectorDsd8To32(dest, src, out_frames, channels); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## BitReverse(std::byte *p, std::size_t n) noexcept \
+	{ \
+		VectorBitReverse<L>(p, n); \
+	} \
+	static constexpr PcmDsdKernels NAME ## _kernels{ \
+		#NAME, \
+		NAME ## DsdToDop, NAME ## Dsd8To16, NAME ## Dsd8To32, \
+		NAME ## BitReverse, \
+	};
+
+#ifdef PCM_KERNELS_X86
+/* SSE2 has no byte shuffle (PSHUFB) */
+PCM_DSD_KERNELS(ssse3, [[gnu::target("ssse3")]], 16)
+PCM_DSD_KERNELS(avx2, [[gnu::target("avx2")]], 32)
+#endif
+
+#ifdef __ARM_NEON
+PCM_DSD_KERNELS(neon, , 16)
+#endif
+
+namespace {
+
+struct AvailablePcmDsdKernels {
+	std::array<const PcmDsdKernels *, 3> kernels;
+	std::size_t n = 0;
+
+	AvailablePcmDsdKernels() noexcept {
+		kernels[n++] = &scalar_kernels;
+
+#ifdef PCM_KERNELS_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("ssse3"))
+			kernels[n++] = &ssse3_kernels;
+		if (__builtin_cpu_supports("avx2"))
+			kernels[n++] = &avx2_kernels;
+#endif
+
+#ifdef __ARM_NEON
+		kernels[n++] = &neon_kernels;
+#endif
+	}
+};
+
+} // anonymous namespace
+
+static const AvailablePcmDsdKernels &
+GetAvailable() noexcept
+{
+	static const AvailablePcmDsdKernels available;
+	return available;
+}
+
+const PcmDsdKernels &
+GetPcmDsdKernels() noexcept
+{
+	const auto &available = GetAvailable();
+	return *available.kernels[available.n - 1];
+}
+
+std::span<const PcmDsdKernels *const>
+GetAvailablePcmDsdKernels() noexcept
+{
+	const auto &available = GetAvailable();
+	return {available.kernels.data(), available.n};
+}
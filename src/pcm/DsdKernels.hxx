@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * A set of implementations of the inner loops which pack DSD_U8 data
+ * for the output devices (see #DsdToDopConverter, #Dsd16Converter and
+ * #Dsd32Converter) and reverse the bit order of DSD data.  There is
+ * one set for each instruction set supported by this build; the best
+ * one is chosen at runtime by GetPcmDsdKernels().
+ *
+ * The vectorized packing kernels handle only stereo (the common
+ * case); other channel counts fall back to the scalar code.
+ */
+struct PcmDsdKernels {
+	/**
+	 * A short name describing the instruction set, e.g. "ssse3".
+	 */
+	const char *name;
+
+	/**
+	 * Convert DSD_U8 to DoP (see #DsdToDopConverter).
+	 *
+	 * @param num_dop_quads the number of "quad" bytes per channel
+	 * in the source buffer; each "quad" will be converted to two
+	 * 24 bit samples in the destination buffer, one for each
+	 * marker
+	 */
+	void (*dsd_to_dop)(uint32_t *dest, const std::byte *src,
+			   std::size_t num_dop_quads,
+			   unsigned channels) noexcept;
+
+	/**
+	 * Convert DSD_U8 to DSD_U16 (native endian, oldest bits in
+	 * MSB).
+	 *
+	 * @param out_frames the number of destination frames
+	 */
+	void (*dsd8_to_16)(uint16_t *dest, const std::byte *src,
+			   std::size_t out_frames,
+			   unsigned channels) noexcept;
+
+	/**
+	 * Convert DSD_U8 to DSD_U32 (native endian, oldest bits in
+	 * MSB).
+	 *
+	 * @param out_frames the number of destination frames
+	 */
+	void (*dsd8_to_32)(uint32_t *dest, const std::byte *src,
+			   std::size_t out_frames,
+			   unsigned channels) noexcept;
+
+	/**
+	 * Reverse the bit order of each byte (in-place), i.e. convert
+	 * between LSB-first and MSB-first DSD.
+	 */
+	void (*bit_reverse)(std::byte *p, std::size_t n) noexcept;
+};
+
+/**
+ * Returns the fastest #PcmDsdKernels supported by this CPU.  The CPU
+ * features are detected on the first call.
+ */
+const PcmDsdKernels &
+GetPcmDsdKernels() noexcept;
+
+/**
+ * Returns all #PcmDsdKernels supported by this CPU, starting with the
+ * (slowest) scalar implementation.  This is useful for tests and
+ * benchmarks.
+ */
+std::span<const PcmDsdKernels *const>
+GetAvailablePcmDsdKernels() noexcept;
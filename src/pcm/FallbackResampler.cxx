@@ -8,7 +8,8 @@
 #include <utility> // for std::unreachable()
 
 AudioFormat
-FallbackPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+FallbackPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+			   SampleFormat)
 {
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
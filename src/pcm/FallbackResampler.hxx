@@ -22,7 +22,8 @@ class FallbackPcmResampler final : public PcmResampler {
 	PcmBuffer buffer;
 
 public:
-	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+			 SampleFormat dest_format) override;
 	void Close() noexcept override;
 	std::span<const std::byte> Resample(std::span<const std::byte> src) override;
 };
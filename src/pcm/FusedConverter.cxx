@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FusedConverter.hxx"
+#include "PcmFormat.hxx"
+#include "Traits.hxx"
+#include "FloatConvert.hxx"
+#include "ShiftConvert.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cassert>
+
+/**
+ * @param C a class which converts one sample, e.g.
+ * #LeftShiftSampleConvert
+ */
+template<typename C>
+static std::span<const std::byte>
+FusedMonoToStereo(PcmBuffer &buffer, std::span<const std::byte> _src) noexcept
+{
+	using DV = typename C::DstTraits::value_type;
+
+	const auto src = FromBytesStrict<const typename C::SrcTraits::value_type>(_src);
+	DV *const dest = buffer.GetT<DV>(src.size() * 2);
+
+	DV *d = dest;
+	for (const auto i : src) {
+		const DV value = C::Convert(i);
+		*d++ = value;
+		*d++ = value;
+	}
+
+	return std::as_bytes(std::span{dest, src.size() * 2});
+}
+
+template<typename C>
+static std::span<const std::byte>
+FusedStereoToMono(PcmBuffer &buffer, std::span<const std::byte> _src) noexcept
+{
+	using DstTraits = typename C::DstTraits;
+	using DV = typename DstTraits::value_type;
+	using DS = typename DstTraits::sum_type;
+
+	const auto src = FromBytesStrict<const typename C::SrcTraits::value_type>(_src);
+	assert(src.size() % 2 == 0);
+
+	const std::size_t n_frames = src.size() / 2;
+	DV *const dest = buffer.GetT<DV>(n_frames);
+
+	/* the same formula as StereoToMono() in PcmChannels.cxx,
+	   applied after converting the sample format */
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		const DS a(C::Convert(src[2 * i]));
+		const DS b(C::Convert(src[2 * i + 1]));
+		dest[i] = DV((a + b) / 2);
+	}
+
+	return std::as_bytes(std::span{dest, n_frames});
+}
+
+template<typename C>
+static auto
+FindFusedFunction(unsigned src_channels, unsigned dest_channels) noexcept
+{
+	decltype(&FusedMonoToStereo<C>) function = nullptr;
+
+	if (src_channels == 1 && dest_channels == 2)
+		function = FusedMonoToStereo<C>;
+	else if (src_channels == 2 && dest_channels == 1)
+		function = FusedStereoToMono<C>;
+
+	return function;
+}
+
+template<SampleFormat F>
+static auto
+FindFromInteger(SampleFormat dest_format,
+		unsigned src_channels, unsigned dest_channels) noexcept
+{
+	decltype(&FusedMonoToStereo<IntegerToFloatSampleConvert<F>>) function = nullptr;
+
+	switch (dest_format) {
+	case SampleFormat::S24_P32:
+		if constexpr (SampleTraits<F>::BITS < SampleTraits<SampleFormat::S24_P32>::BITS)
+			function = FindFusedFunction<LeftShiftSampleConvert<F, SampleFormat::S24_P32>>(src_channels, dest_channels);
+		else if constexpr (F == SampleFormat::S32)
+			function = FindFusedFunction<RightShiftSampleConvert<F, SampleFormat::S24_P32>>(src_channels, dest_channels);
+		break;
+
+	case SampleFormat::S32:
+		if constexpr (F != SampleFormat::S32)
+			function = FindFusedFunction<LeftShiftSampleConvert<F, SampleFormat::S32>>(src_channels, dest_channels);
+		break;
+
+	case SampleFormat::FLOAT:
+		function = FindFusedFunction<IntegerToFloatSampleConvert<F>>(src_channels, dest_channels);
+		break;
+
+	default:
+		/* conversion to S16 needs dithering, which is
+		   not implemented here */
+		break;
+	}
+
+	return function;
+}
+
+bool
+PcmFusedConverter::Open(SampleFormat src_format, SampleFormat dest_format,
+			unsigned src_channels, unsigned dest_channels) noexcept
+{
+	assert(function == nullptr);
+
+	switch (src_format) {
+	case SampleFormat::S16:
+		function = FindFromInteger<SampleFormat::S16>(dest_format,
+							       src_channels,
+							       dest_channels);
+		break;
+
+	case SampleFormat::S24_P32:
+		function = FindFromInteger<SampleFormat::S24_P32>(dest_format,
+								   src_channels,
+								   dest_channels);
+		break;
+
+	case SampleFormat::S32:
+		function = FindFromInteger<SampleFormat::S32>(dest_format,
+							       src_channels,
+							       dest_channels);
+		break;
+
+	case SampleFormat::FLOAT:
+		switch (dest_format) {
+		case SampleFormat::S16:
+			/* dithering is not implemented here */
+			if (!pcm_get_float_dither())
+				function = FindFusedFunction<FloatToIntegerSampleConvert<SampleFormat::S16>>(src_channels, dest_channels);
+			break;
+
+		case SampleFormat::S24_P32:
+			function = FindFusedFunction<FloatToIntegerSampleConvert<SampleFormat::S24_P32>>(src_channels, dest_channels);
+			break;
+
+		case SampleFormat::S32:
+			function = FindFusedFunction<FloatToIntegerSampleConvert<SampleFormat::S32>>(src_channels, dest_channels);
+			break;
+
+		default:
+			break;
+		}
+
+		break;
+
+	default:
+		break;
+	}
+
+	return function != nullptr;
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "SampleFormat.hxx"
+#include "Buffer.hxx"
+
+#include <span>
+
+/**
+ * Converts the sample format and the number of channels in one pass,
+ * the same way #PcmFormatConverter followed by #PcmChannelsConverter
+ * would, but without an intermediate buffer.  This is only
+ * implemented for the common cases (mono to stereo and stereo to
+ * mono, and sample format conversions which do not need dithering);
+ * Open() returns false for all others.
+ */
+class PcmFusedConverter {
+	using Function = std::span<const std::byte> (*)(PcmBuffer &buffer,
+							std::span<const std::byte> src) noexcept;
+
+	Function function = nullptr;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * Opens the object, prepare for Convert().
+	 *
+	 * @return true on success, false if this combination is not
+	 * implemented
+	 */
+	bool Open(SampleFormat src_format, SampleFormat dest_format,
+		  unsigned src_channels, unsigned dest_channels) noexcept;
+
+	/**
+	 * Closes the object.  After that, you may call Open() again.
+	 */
+	void Close() noexcept {
+		function = nullptr;
+	}
+
+	/**
+	 * Convert a block of PCM data.
+	 *
+	 * @param src the input buffer
+	 * @return the destination buffer
+	 */
+	[[gnu::pure]]
+	std::span<const std::byte> Convert(std::span<const std::byte> src) noexcept {
+		return function(buffer, src);
+	}
+};
@@ -2,42 +2,46 @@
 // Copyright The Music Player Daemon Project
 
 #include "GlueResampler.hxx"
-#include "ConfiguredResampler.hxx"
 #include "Resampler.hxx"
 #include "AudioFormat.hxx"
 
 #include <cassert>
 
-GluePcmResampler::GluePcmResampler()
-	:resampler(pcm_resampler_create()) {}
-
-GluePcmResampler::~GluePcmResampler() noexcept
-{
-	delete resampler;
-}
+GluePcmResampler::GluePcmResampler() = default;
+GluePcmResampler::~GluePcmResampler() noexcept = default;
 
 void
-GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate)
+GluePcmResampler::Open(AudioFormat src_format, unsigned new_sample_rate,
+		       SampleFormat dest_sample_format)
 {
 	assert(src_format.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
-	AudioFormat requested_format = src_format;
-	AudioFormat dest_format = resampler->Open(requested_format,
-						  new_sample_rate);
+	assert(item.resampler == nullptr);
+
+	item = PcmResamplerCache::GetThreadInstance()
+		.Open({src_format, new_sample_rate, dest_sample_format});
+
+	const AudioFormat requested_format = item.requested_format;
+	const AudioFormat dest_format = item.output_format;
 	assert(dest_format.IsValid());
 
 	assert(requested_format.channels == src_format.channels);
 	assert(dest_format.channels == src_format.channels);
 	assert(dest_format.sample_rate == new_sample_rate);
 
-	if (requested_format.format != src_format.format)
-		format_converter.Open(src_format.format,
-				      requested_format.format);
+	if (requested_format.format != src_format.format) {
+		try {
+			format_converter.Open(src_format.format,
+					      requested_format.format);
+		} catch (...) {
+			PcmResamplerCache::GetThreadInstance().Put(std::move(item));
+			throw;
+		}
+	}
 
 	src_sample_format = src_format.format;
 	requested_sample_format = requested_format.format;
-	output_sample_format = dest_format.format;
 }
 
 void
@@ -46,13 +50,13 @@ GluePcmResampler::Close() noexcept
 	if (requested_sample_format != src_sample_format)
 		format_converter.Close();
 
-	resampler->Close();
+	PcmResamplerCache::GetThreadInstance().Put(std::move(item));
 }
 
 void
 GluePcmResampler::Reset() noexcept
 {
-	resampler->Reset();
+	item.resampler->Reset();
 }
 
 std::span<const std::byte>
@@ -61,11 +65,11 @@ GluePcmResampler::Resample(std::span<const std::byte> src)
 	if (requested_sample_format != src_sample_format)
 		src = format_converter.Convert(src);
 
-	return resampler->Resample(src);
+	return item.resampler->Resample(src);
 }
 
 std::span<const std::byte>
 GluePcmResampler::Flush()
 {
-	return resampler->Flush();
+	return item.resampler->Flush();
 }
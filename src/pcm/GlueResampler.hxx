@@ -6,23 +6,28 @@
 
 #include "SampleFormat.hxx"
 #include "FormatConverter.hxx"
+#include "ResamplerCache.hxx"
 
 #include <cstddef>
 #include <span>
 
-struct AudioFormat;
-class PcmResampler;
-
 /**
  * A glue class that integrates a #PcmResampler and automatically
  * converts source data to the sample format required by the
  * #PcmResampler instance.
+ *
+ * The #PcmResampler is obtained from the #PcmResamplerCache of the
+ * calling thread and given back to it by Close(), so the next song
+ * with the same format can reuse it.
  */
 class GluePcmResampler {
-	PcmResampler *const resampler;
+	/**
+	 * The opened #PcmResampler; only valid between Open() and
+	 * Close().
+	 */
+	PcmResamplerCache::Item item;
 
 	SampleFormat src_sample_format, requested_sample_format;
-	SampleFormat output_sample_format;
 
 	/**
 	 * This object converts input data to the sample format
@@ -34,11 +39,16 @@ public:
 	GluePcmResampler();
 	~GluePcmResampler() noexcept;
 
-	void Open(AudioFormat src_format, unsigned new_sample_rate);
+	/**
+	 * @param dest_format the sample format the caller will
+	 * eventually convert to (see PcmResampler::Open())
+	 */
+	void Open(AudioFormat src_format, unsigned new_sample_rate,
+		  SampleFormat dest_format);
 	void Close() noexcept;
 
 	SampleFormat GetOutputSampleFormat() const noexcept {
-		return output_sample_format;
+		return item.output_format.format;
 	}
 
 	/**
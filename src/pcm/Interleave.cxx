@@ -3,8 +3,14 @@
 
 #include "Interleave.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 static void
 GenericPcmInterleave(std::byte *gcc_restrict dest,
 		     std::span<const std::byte *const> src,
@@ -32,6 +38,121 @@ PcmInterleaveStereo(T *gcc_restrict dest,
 	}
 }
 
+/**
+ * Interleave a fixed number of channels.  With the channel count
+ * known at compile time, the compiler can unroll the inner loop and
+ * vectorize the outer one.
+ */
+template<std::size_t channels, typename T>
+static void
+PcmInterleaveFixed(T *gcc_restrict dest,
+		   const std::span<const T *const> src,
+		   size_t n_frames) noexcept
+{
+	const T *s[channels];
+	std::copy_n(src.begin(), channels, s);
+
+	for (size_t i = 0; i != n_frames; ++i)
+		for (size_t c = 0; c != channels; ++c)
+			*dest++ = s[c][i];
+}
+
+#ifdef __SSE2__
+
+/**
+ * An SSE2 implementation of PcmInterleaveStereo() for 32 bit
+ * samples.
+ */
+static void
+PcmInterleaveStereo32(int32_t *gcc_restrict dest,
+		      const int32_t *gcc_restrict src1,
+		      const int32_t *gcc_restrict src2,
+		      size_t n_frames) noexcept
+{
+	for (; n_frames >= 4; n_frames -= 4, src1 += 4, src2 += 4, dest += 8) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)src1);
+		const __m128i r = _mm_loadu_si128((const __m128i *)src2);
+
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi32(l, r));
+		_mm_storeu_si128((__m128i *)(dest + 4), _mm_unpackhi_epi32(l, r));
+	}
+
+	PcmInterleaveStereo(dest, src1, src2, n_frames);
+}
+
+/**
+ * An SSE2 implementation of PcmInterleaveStereo() for 16 bit
+ * samples.
+ */
+static void
+PcmInterleaveStereo16(int16_t *gcc_restrict dest,
+		      const int16_t *gcc_restrict src1,
+		      const int16_t *gcc_restrict src2,
+		      size_t n_frames) noexcept
+{
+	for (; n_frames >= 8; n_frames -= 8, src1 += 8, src2 += 8, dest += 16) {
+		const __m128i l = _mm_loadu_si128((const __m128i *)src1);
+		const __m128i r = _mm_loadu_si128((const __m128i *)src2);
+
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i *)(dest + 8), _mm_unpackhi_epi16(l, r));
+	}
+
+	PcmInterleaveStereo(dest, src1, src2, n_frames);
+}
+
+/**
+ * Transpose a 4x4 matrix of 32 bit samples: four samples of four
+ * channels each become four frames of four channels each.
+ */
+static inline void
+Transpose4x4(__m128i &a, __m128i &b, __m128i &c, __m128i &d) noexcept
+{
+	const __m128i ab_lo = _mm_unpacklo_epi32(a, b);
+	const __m128i ab_hi = _mm_unpackhi_epi32(a, b);
+	const __m128i cd_lo = _mm_unpacklo_epi32(c, d);
+	const __m128i cd_hi = _mm_unpackhi_epi32(c, d);
+
+	a = _mm_unpacklo_epi64(ab_lo, cd_lo);
+	b = _mm_unpackhi_epi64(ab_lo, cd_lo);
+	c = _mm_unpacklo_epi64(ab_hi, cd_hi);
+	d = _mm_unpackhi_epi64(ab_hi, cd_hi);
+}
+
+/**
+ * An SSE2 implementation of PcmInterleaveFixed<8> for 32 bit
+ * samples (7.1 surround).
+ */
+static void
+PcmInterleave8x32(int32_t *gcc_restrict dest,
+		  const std::span<const int32_t *const> src,
+		  size_t n_frames) noexcept
+{
+	const int32_t *s[8];
+	std::copy_n(src.begin(), 8, s);
+
+	size_t i = 0;
+	for (; i + 4 <= n_frames; i += 4, dest += 32) {
+		__m128i v[8];
+		for (unsigned c = 0; c < 8; ++c)
+			v[c] = _mm_loadu_si128((const __m128i *)(s[c] + i));
+
+		Transpose4x4(v[0], v[1], v[2], v[3]);
+		Transpose4x4(v[4], v[5], v[6], v[7]);
+
+		for (unsigned f = 0; f < 4; ++f) {
+			_mm_storeu_si128((__m128i *)(dest + 8 * f), v[f]);
+			_mm_storeu_si128((__m128i *)(dest + 8 * f + 4), v[4 + f]);
+		}
+	}
+
+	for (; i != n_frames; ++i)
+		for (unsigned c = 0; c < 8; ++c)
+			*dest++ = s[c][i];
+}
+
+#endif
+
 template<typename T>
 static void
 PcmInterleaveT(T *gcc_restrict dest,
@@ -40,8 +161,41 @@ PcmInterleaveT(T *gcc_restrict dest,
 {
 	switch (src.size()) {
 	case 2:
+#ifdef __SSE2__
+		if constexpr (sizeof(T) == 4) {
+			PcmInterleaveStereo32((int32_t *)dest,
+					      (const int32_t *)src[0],
+					      (const int32_t *)src[1],
+					      n_frames);
+			return;
+		} else if constexpr (sizeof(T) == 2) {
+			PcmInterleaveStereo16((int16_t *)dest,
+					      (const int16_t *)src[0],
+					      (const int16_t *)src[1],
+					      n_frames);
+			return;
+		}
+#endif
+
 		PcmInterleaveStereo(dest, src[0], src[1], n_frames);
 		return;
+
+	case 6:
+		PcmInterleaveFixed<6>(dest, src, n_frames);
+		return;
+
+	case 8:
+#ifdef __SSE2__
+		if constexpr (sizeof(T) == 4) {
+			PcmInterleave8x32((int32_t *)dest,
+					  {(const int32_t *const*)src.data(), src.size()},
+					  n_frames);
+			return;
+		}
+#endif
+
+		PcmInterleaveFixed<8>(dest, src, n_frames);
+		return;
 	}
 
 	for (const auto *s : src) {
@@ -62,7 +62,8 @@ pcm_resample_lsr_global_init(const ConfigBlock &block)
 }
 
 AudioFormat
-LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+				SampleFormat)
 {
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
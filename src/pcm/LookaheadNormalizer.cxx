@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "LookaheadNormalizer.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+/**
+ * The duration of one block; the gain is calculated once per block.
+ */
+static constexpr std::chrono::milliseconds block_duration{10};
+
+/**
+ * How fast may the gain grow (in dB per second)?
+ */
+static constexpr float release_db_per_second = 6;
+
+/**
+ * Find the largest absolute sample value.
+ */
+[[gnu::pure]]
+static float
+FindPeak(const float *src, std::size_t n) noexcept
+{
+	/* using vectors explicitly, because without -ffast-math,
+	   the compiler would not vectorize this loop */
+	constexpr std::size_t L = 4;
+	typedef float Vector [[gnu::vector_size(sizeof(float) * L)]];
+
+	Vector peak{};
+	for (; n >= L; n -= L, src += L) {
+		Vector v;
+		std::copy_n(src, L, &v[0]);
+
+		v = v < 0 ? -v : v;
+		peak = v > peak ? v : peak;
+	}
+
+	float result = 0;
+	for (std::size_t i = 0; i < L; ++i)
+		result = std::max(result, peak[i]);
+
+	for (; n > 0; --n)
+		result = std::max(result, std::fabs(*src++));
+
+	return result;
+}
+
+/**
+ * Multiply samples with a constant gain.
+ */
+static void
+ApplyGain(float *dest, const float *src, std::size_t n, float gain) noexcept
+{
+	std::transform(src, src + n, dest, [gain](float x){
+		return x * gain;
+	});
+}
+
+/**
+ * Multiply samples with a gain which changes linearly from "from" to
+ * "to".  For simplicity (and to allow the compiler to vectorize the
+ * loop), the gain changes per sample, not per frame; the difference
+ * between two channels of a frame is inaudible.
+ */
+static void
+ApplyRamp(float *dest, const float *src, std::size_t n,
+	  float from, float to) noexcept
+{
+	const float step = (to - from) / float(n);
+
+	for (std::size_t i = 0; i < n; ++i)
+		dest[i] = src[i] * (from + step * float(i));
+}
+
+PcmLookaheadNormalizer::PcmLookaheadNormalizer(unsigned sample_rate,
+					       unsigned channels,
+					       std::chrono::milliseconds window,
+					       float _max_gain) noexcept
+	:block_samples(std::max<std::size_t>(sample_rate * block_duration.count() / 1000, 1)
+		       * channels),
+	 n_lookahead(std::max<std::size_t>(window / block_duration, 1)),
+	 max_gain(std::max(_max_gain, 1.0f)),
+	 release(std::pow(10.0f, release_db_per_second / 20.0f
+			  * block_duration.count() / 1000.0f)),
+	 ring((n_lookahead + 1) * block_samples),
+	 peaks(n_lookahead + 1),
+	 gain(1)
+{
+	assert(channels > 0);
+}
+
+void
+PcmLookaheadNormalizer::Reset() noexcept
+{
+	head = n_queued = fill = 0;
+	gain = 1;
+	first = true;
+}
+
+float *
+PcmLookaheadNormalizer::Emit(float *dest, std::size_t n) noexcept
+{
+	assert(n_queued > 0);
+
+	/* the loudest block in the look-ahead window determines the
+	   gain */
+	float peak = 0;
+	for (std::size_t i = 0; i < n_queued; ++i)
+		peak = std::max(peak, peaks[(head + i) % peaks.size()]);
+
+	float new_gain = peak > 0 ? TARGET / peak : max_gain;
+	new_gain = std::clamp(new_gain, 1.0f, max_gain);
+
+	if (first)
+		/* jump to the desired gain right away */
+		gain = new_gain;
+	else if (new_gain > gain)
+		/* raise the gain slowly; lowering it is always
+		   done in one block, because the look-ahead
+		   guarantees that this happens before the loud
+		   passage */
+		new_gain = std::min(new_gain, gain * release);
+
+	first = false;
+
+	const float *src = GetBlock(head);
+	if (new_gain == gain)
+		ApplyGain(dest, src, n, new_gain);
+	else
+		ApplyRamp(dest, src, n, gain, new_gain);
+
+	gain = new_gain;
+
+	head = (head + 1) % peaks.size();
+	--n_queued;
+
+	return dest + n;
+}
+
+std::span<const float>
+PcmLookaheadNormalizer::Process(std::span<const float> src) noexcept
+{
+	float *const dest = buffer.GetT<float>(src.size() + block_samples);
+	float *p = dest;
+
+	while (!src.empty()) {
+		const std::size_t tail = head + n_queued;
+		float *block = GetBlock(tail);
+
+		const std::size_t n = std::min(src.size(), block_samples - fill);
+		std::copy_n(src.data(), n, block + fill);
+		fill += n;
+		src = src.subspan(n);
+
+		if (fill == block_samples) {
+			peaks[tail % peaks.size()] = FindPeak(block, block_samples);
+			++n_queued;
+			fill = 0;
+
+			if (n_queued > n_lookahead)
+				p = Emit(p, block_samples);
+		}
+	}
+
+	return {dest, p};
+}
+
+std::span<const float>
+PcmLookaheadNormalizer::Flush() noexcept
+{
+	float *const dest = buffer.GetT<float>((n_queued + 1) * block_samples);
+	float *p = dest;
+
+	const std::size_t partial = fill;
+	if (partial > 0) {
+		/* enqueue the incomplete block */
+		const std::size_t tail = head + n_queued;
+		peaks[tail % peaks.size()] = FindPeak(GetBlock(tail), partial);
+		++n_queued;
+		fill = 0;
+	}
+
+	while (n_queued > 0)
+		p = Emit(p, n_queued == 1 && partial > 0
+			 ? partial
+			 : block_samples);
+
+	return {dest, p};
+}
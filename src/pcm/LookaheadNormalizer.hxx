@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Buffer.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <chrono>
+#include <cstddef>
+#include <span>
+
+/**
+ * A volume normalizer for floating point samples which delays its
+ * output by a configurable look-ahead window.  The gain is computed
+ * once per block (of 10 ms) from the peaks of all blocks in the
+ * window, so it can be lowered before a loud passage arrives, and is
+ * raised slowly afterwards.
+ *
+ * Unlike #PcmNormalizer, this class works on interleaved float
+ * samples and does no per-sample gain arithmetic except a linear ramp
+ * within blocks where the gain changes.
+ */
+class PcmLookaheadNormalizer {
+	/**
+	 * The desired peak level.
+	 */
+	static constexpr float TARGET = 0.5f;
+
+	/**
+	 * The number of samples per block.
+	 */
+	const std::size_t block_samples;
+
+	/**
+	 * The number of blocks which are delayed for the look-ahead.
+	 */
+	const std::size_t n_lookahead;
+
+	/**
+	 * The maximum gain factor.
+	 */
+	const float max_gain;
+
+	/**
+	 * The factor by which the gain may grow per block.
+	 */
+	const float release;
+
+	/**
+	 * A ring buffer of (n_lookahead + 1) blocks.
+	 */
+	AllocatedArray<float> ring;
+
+	/**
+	 * The peak value of each block in #ring.
+	 */
+	AllocatedArray<float> peaks;
+
+	/**
+	 * The index of the oldest block in #ring.
+	 */
+	std::size_t head = 0;
+
+	/**
+	 * The number of complete blocks in #ring.
+	 */
+	std::size_t n_queued = 0;
+
+	/**
+	 * The number of samples in the (incomplete) block after the
+	 * queued ones.
+	 */
+	std::size_t fill = 0;
+
+	/**
+	 * The gain at the end of the last block which was emitted.
+	 */
+	float gain;
+
+	/**
+	 * True if no block has been emitted since construction or
+	 * Reset(); the first block uses its desired gain immediately
+	 * instead of ramping to it slowly.
+	 */
+	bool first = true;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * @param window the duration of the look-ahead (which is also
+	 * the latency added by this object)
+	 * @param max_gain the maximum gain factor
+	 */
+	PcmLookaheadNormalizer(unsigned sample_rate, unsigned channels,
+			       std::chrono::milliseconds window,
+			       float max_gain) noexcept;
+
+	void Reset() noexcept;
+
+	/**
+	 * Process interleaved float samples.  The result is delayed
+	 * by the look-ahead window, so it may be smaller than the
+	 * input or even empty.
+	 *
+	 * @return the output; it is invalidated by the next call
+	 */
+	std::span<const float> Process(std::span<const float> src) noexcept;
+
+	/**
+	 * Return all samples which are still being delayed.  After
+	 * that, the object is empty, but the gain is kept.
+	 */
+	std::span<const float> Flush() noexcept;
+
+private:
+	float *GetBlock(std::size_t i) noexcept {
+		return ring.data() + (i % peaks.size()) * block_samples;
+	}
+
+	/**
+	 * Apply the gain to the oldest queued block, copy it to the
+	 * given buffer and remove it from the queue.
+	 *
+	 * @param n the number of samples in this block
+	 * @return the end of the destination buffer
+	 */
+	float *Emit(float *dest, std::size_t n) noexcept;
+};
@@ -3,6 +3,7 @@
 
 #include "Mix.hxx"
 #include "Volume.hxx"
+#include "VolumeKernels.hxx"
 #include "Clamp.hxx"
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
@@ -55,25 +56,13 @@ PcmAddVolumeVoid(PcmDither &dither,
 				volume1, volume2);
 }
 
-static void
-pcm_add_vol_float(float *buffer1, const float *buffer2,
-		  unsigned num_samples, float volume1, float volume2) noexcept
-{
-	while (num_samples > 0) {
-		float sample1 = *buffer1;
-		float sample2 = *buffer2++;
-
-		sample1 = (sample1 * volume1 + sample2 * volume2);
-		*buffer1++ = sample1;
-		--num_samples;
-	}
-}
-
 static bool
 pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	    int vol1, int vol2,
 	    SampleFormat format) noexcept
 {
+	const auto &kernels = GetPcmVolumeKernels();
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
 	case SampleFormat::DSD:
@@ -87,28 +76,35 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
-		PcmAddVolumeVoid<SampleFormat::S16>(dither,
-						    buffer1, buffer2, size,
-						    vol1, vol2);
+		assert(size % sizeof(int16_t) == 0);
+		kernels.add_volume_16(dither, (int16_t *)buffer1,
+				      (const int16_t *)buffer2,
+				      size / sizeof(int16_t),
+				      vol1, vol2);
 		return true;
 
 	case SampleFormat::S24_P32:
-		PcmAddVolumeVoid<SampleFormat::S24_P32>(dither,
-							buffer1, buffer2, size,
-							vol1, vol2);
+		assert(size % sizeof(int32_t) == 0);
+		kernels.add_volume_24(dither, (int32_t *)buffer1,
+				      (const int32_t *)buffer2,
+				      size / sizeof(int32_t),
+				      vol1, vol2);
 		return true;
 
 	case SampleFormat::S32:
-		PcmAddVolumeVoid<SampleFormat::S32>(dither,
-						    buffer1, buffer2, size,
-						    vol1, vol2);
+		assert(size % sizeof(int32_t) == 0);
+		kernels.add_volume_32(dither, (int32_t *)buffer1,
+				      (const int32_t *)buffer2,
+				      size / sizeof(int32_t),
+				      vol1, vol2);
 		return true;
 
 	case SampleFormat::FLOAT:
-		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
-				  size / 4,
-				  pcm_volume_to_float(vol1),
-				  pcm_volume_to_float(vol2));
+		kernels.add_volume_float((float *)buffer1,
+					 (const float *)buffer2,
+					 size / sizeof(float),
+					 pcm_volume_to_float(vol1),
+					 pcm_volume_to_float(vol2));
 		return true;
 	}
 
@@ -53,9 +53,9 @@ EndToString(const MixRampArray &a, FloatDuration total_time) noexcept
 	return s;
 }
 
-static std::string
-ToString(const MixRampData &mr, FloatDuration total_time,
-	 MixRampDirection direction) noexcept
+std::string
+MixRampToString(const MixRampData &mr, FloatDuration total_time,
+		MixRampDirection direction) noexcept
 {
 	switch (direction) {
 	case MixRampDirection::START:
@@ -84,8 +84,8 @@ AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
 
 	MixRampAnalyzer a;
 	do {
-		a.Process(FromBytesStrict<const ReplayGainAnalyzer::Frame>({chunk->data, chunk->length}));
-	} while ((chunk = chunk->next.get()) != nullptr);
+		a.Process(FromBytesStrict<const ReplayGainAnalyzer::Frame>(chunk->ReadData()));
+	} while ((chunk = chunk->GetNext()) != nullptr);
 
-	return ToString(a.GetResult(), a.GetTime(), direction);
+	return MixRampToString(a.GetResult(), a.GetTime(), direction);
 }
@@ -3,15 +3,28 @@
 
 #pragma once
 
+#include "Chrono.hxx"
+
 #include <string>
 
 struct AudioFormat;
+struct MixRampData;
 class MusicPipe;
 
 enum class MixRampDirection {
 	START, END
 };
 
+/**
+ * Format the result of a #MixRampAnalyzer as a MixRamp tag value.
+ *
+ * @param total_time the duration of the analyzed audio
+ */
+[[gnu::pure]]
+std::string
+MixRampToString(const MixRampData &mr, FloatDuration total_time,
+		MixRampDirection direction) noexcept;
+
 [[gnu::pure]]
 std::string
 AnalyzeMixRamp(const MusicPipe &pipe, const AudioFormat &audio_format,
@@ -6,12 +6,31 @@
 #include "Traits.hxx"
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
+#include "VolumeKernels.hxx"
 #include "util/Compiler.h"
 #include "util/SpanCast.hxx"
 #include "util/TransformN.hxx"
 
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+/**
+ * Apply dithering to conversions from floating point to 16 bit?  See
+ * pcm_set_float_dither().
+ */
+static bool float_dither = false;
+
+void
+pcm_set_float_dither(bool enable) noexcept
+{
+	float_dither = enable;
+}
+
+bool
+pcm_get_float_dither() noexcept
+{
+	return float_dither;
+}
+
 /**
  * Wrapper for a class that converts one sample at a time into one
  * that converts a buffer at a time.
@@ -41,7 +60,7 @@ struct Convert24To16 {
 	explicit Convert24To16(PcmDither &_dither):dither(_dither) {}
 
 	void Convert(int16_t *out, const int32_t *in, size_t n) {
-		dither.Dither24To16(out, in, in + n);
+		GetPcmVolumeKernels().dither_24_to_16(dither, out, in, n);
 	}
 };
 
@@ -54,7 +73,7 @@ struct Convert32To16 {
 	explicit Convert32To16(PcmDither &_dither):dither(_dither) {}
 
 	void Convert(int16_t *out, const int32_t *in, size_t n) {
-		dither.Dither32To16(out, in, in + n);
+		GetPcmVolumeKernels().dither_32_to_16(dither, out, in, n);
 	}
 };
 
@@ -137,8 +156,17 @@ pcm_allocate_32_to_16(PcmBuffer &buffer, PcmDither &dither,
 }
 
 static std::span<const int16_t>
-pcm_allocate_float_to_16(PcmBuffer &buffer, std::span<const float> src)
+pcm_allocate_float_to_16(PcmBuffer &buffer, PcmDither &dither,
+			 std::span<const float> src)
 {
+	if (float_dither) {
+		auto dest = buffer.GetT<int16_t>(src.size());
+		GetPcmVolumeKernels().dither_float_to_16(dither, dest,
+							 src.data(),
+							 src.size());
+		return { dest, src.size() };
+	}
+
 	return AllocateFromFloat<SampleFormat::S16>(buffer, src);
 }
 
@@ -167,7 +195,7 @@ pcm_convert_to_16(PcmBuffer &buffer, PcmDither &dither,
 					     FromBytesStrict<const int32_t>(src));
 
 	case SampleFormat::FLOAT:
-		return pcm_allocate_float_to_16(buffer,
+		return pcm_allocate_float_to_16(buffer, dither,
 						FromBytesStrict<const float>(src));
 	}
 
@@ -13,8 +13,22 @@ class PcmBuffer;
 class PcmDither;
 
 /**
- * Converts PCM samples to 16 bit.  If the source format is 24 bit,
- * then dithering is applied.
+ * Enable or disable dithering for conversions from floating point to
+ * 16 bit.  It is disabled by default, which means the samples are
+ * just rounded.  This is a global setting, initialized by
+ * pcm_convert_global_init().
+ */
+void
+pcm_set_float_dither(bool enable) noexcept;
+
+[[gnu::pure]]
+bool
+pcm_get_float_dither() noexcept;
+
+/**
+ * Converts PCM samples to 16 bit.  If the source format is 24 or 32
+ * bit (or floating point, see pcm_set_float_dither()), then dithering
+ * is applied.
  *
  * @param buffer a #PcmBuffer object
  * @param dither a #PcmDither object for 24-to-16 conversion
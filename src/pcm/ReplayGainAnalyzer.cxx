@@ -164,13 +164,25 @@ ApplyFilter(ReplayGainAnalyzer::Frame src, std::size_t i,
 	    const std::array<double, ORDER + 1> &coeff_a,
 	    const std::array<double, ORDER + 1> &coeff_b) noexcept
 {
+	/* the feed-forward part does not depend on previous
+	   results, so it can be calculated while the previous frame
+	   is still being computed */
 	ReplayGainAnalyzer::DoubleFrame frame = (hist_b[i] = src) * coeff_b[0];
 
 #if defined(__GNUC__) && !defined(__clang__)
 #pragma GCC unroll 100
 #endif
 	for (std::size_t j = 1; j <= ORDER; ++j)
-		frame += hist_b[i - j] * coeff_b[j] - hist_a[i - j] * coeff_a[j];
+		frame += hist_b[i - j] * coeff_b[j];
+
+	/* the feedback part, with the most recent results last to
+	   keep the chain of dependent operations from one frame to
+	   the next short */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 100
+#endif
+	for (std::size_t j = ORDER; j >= 1; --j)
+		frame -= hist_a[i - j] * coeff_a[j];
 
 	return hist_a[i] = ToSingle(frame);
 }
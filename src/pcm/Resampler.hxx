@@ -5,9 +5,11 @@
 #define MPD_PCM_RESAMPLER_HXX
 
 #include <cstddef>
+#include <cstdint>
 #include <span>
 
 struct AudioFormat;
+enum class SampleFormat : uint8_t;
 
 /**
  * This is an interface for plugins that convert PCM data to a
@@ -26,10 +28,14 @@ public:
 	 * modify the object to enforce another input format (however,
 	 * it may not request a different input sample rate)
 	 * @param new_sample_rate the requested output sample rate
+	 * @param dest_format the sample format the caller will
+	 * eventually convert to; the plugin may choose to emit it
+	 * directly to save a conversion step
 	 * @return the format of outgoing data
 	 */
 	virtual AudioFormat Open(AudioFormat &af,
-				 unsigned new_sample_rate) = 0;
+				 unsigned new_sample_rate,
+				 SampleFormat dest_format) = 0;
 
 	/**
 	 * Closes the resampler.  After that, you may call Open()
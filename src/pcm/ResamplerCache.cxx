@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "ResamplerCache.hxx"
+#include "ConfiguredResampler.hxx"
+#include "Resampler.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+PcmResamplerCache::Item::Item() noexcept = default;
+PcmResamplerCache::Item::Item(Item &&) noexcept = default;
+
+PcmResamplerCache::Item &
+PcmResamplerCache::Item::operator=(Item &&src) noexcept
+{
+	if (resampler != nullptr)
+		resampler->Close();
+
+	key = src.key;
+	resampler = std::move(src.resampler);
+	requested_format = src.requested_format;
+	output_format = src.output_format;
+	return *this;
+}
+
+PcmResamplerCache::Item::~Item() noexcept
+{
+	if (resampler != nullptr)
+		resampler->Close();
+}
+
+PcmResamplerCache::PcmResamplerCache() noexcept
+{
+	/* reserve one more than needed so Put() never needs to
+	   allocate */
+	items.reserve(MAX_ITEMS + 1);
+}
+
+PcmResamplerCache::~PcmResamplerCache() noexcept = default;
+
+PcmResamplerCache &
+PcmResamplerCache::GetThreadInstance() noexcept
+{
+	static thread_local PcmResamplerCache instance;
+	return instance;
+}
+
+PcmResamplerCache::Item
+PcmResamplerCache::Open(const Key &key)
+{
+	assert(key.src_format.IsValid());
+	assert(audio_valid_sample_rate(key.new_sample_rate));
+
+	auto i = std::find_if(items.begin(), items.end(),
+			      [&key](const Item &item){
+				      return item.key == key;
+			      });
+	if (i != items.end()) {
+		Item item = std::move(*i);
+		items.erase(i);
+
+		item.resampler->Reset();
+		return item;
+	}
+
+	Item item;
+	item.key = key;
+	item.resampler.reset(pcm_resampler_create());
+
+	AudioFormat requested_format = key.src_format;
+	item.output_format = item.resampler->Open(requested_format,
+						  key.new_sample_rate,
+						  key.dest_format);
+	item.requested_format = requested_format;
+	return item;
+}
+
+void
+PcmResamplerCache::Put(Item &&item) noexcept
+{
+	assert(item.resampler != nullptr);
+	assert(items.capacity() > MAX_ITEMS);
+
+	items.insert(items.begin(), std::move(item));
+	if (items.size() > MAX_ITEMS)
+		items.pop_back();
+}
+
+void
+PcmResamplerCache::Clear() noexcept
+{
+	items.clear();
+}
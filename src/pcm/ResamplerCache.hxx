@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "AudioFormat.hxx"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class PcmResampler;
+
+/**
+ * A small cache of opened #PcmResampler instances.  Setting up a
+ * resampler can be expensive (e.g. libsoxr designs its filters in
+ * soxr_create()), and playlists which alternate between a few
+ * sample rates would otherwise pay for it on every song change.
+ *
+ * The resampler implementation and its quality settings are
+ * configured globally, therefore the input format, the output
+ * sample rate and the desired output sample format describe a
+ * resampler completely.
+ *
+ * Each thread has its own instance (see GetThreadInstance()), so no
+ * locking is needed.
+ */
+class PcmResamplerCache {
+public:
+	struct Key {
+		AudioFormat src_format;
+
+		unsigned new_sample_rate;
+
+		SampleFormat dest_format;
+
+		constexpr bool operator==(const Key &) const noexcept = default;
+	};
+
+	struct Item {
+		Key key;
+
+		std::unique_ptr<PcmResampler> resampler;
+
+		/**
+		 * The input format requested by the resampler (see
+		 * PcmResampler::Open()).
+		 */
+		AudioFormat requested_format;
+
+		/**
+		 * The format of outgoing data.
+		 */
+		AudioFormat output_format;
+
+		Item() noexcept;
+		Item(Item &&) noexcept;
+		Item &operator=(Item &&) noexcept;
+		~Item() noexcept;
+	};
+
+	/**
+	 * The maximum number of idle resamplers kept by each thread.
+	 */
+	static constexpr std::size_t MAX_ITEMS = 4;
+
+private:
+	/**
+	 * Idle (opened) resamplers, the most recently used one first.
+	 */
+	std::vector<Item> items;
+
+public:
+	PcmResamplerCache() noexcept;
+	~PcmResamplerCache() noexcept;
+
+	PcmResamplerCache(const PcmResamplerCache &) = delete;
+	PcmResamplerCache &operator=(const PcmResamplerCache &) = delete;
+
+	/**
+	 * Returns the cache instance of the current thread.
+	 */
+	static PcmResamplerCache &GetThreadInstance() noexcept;
+
+	std::size_t size() const noexcept {
+		return items.size();
+	}
+
+	/**
+	 * Obtain an opened resampler, either from the cache (after
+	 * resetting it) or a new one.
+	 *
+	 * Throws on error.
+	 */
+	Item Open(const Key &key);
+
+	/**
+	 * Give an opened resampler (obtained by Open()) back to the
+	 * cache.  If the cache is full, the least recently used one
+	 * is closed.
+	 */
+	void Put(Item &&item) noexcept;
+
+	/**
+	 * Close all cached resamplers.
+	 */
+	void Clear() noexcept;
+};
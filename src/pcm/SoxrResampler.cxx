@@ -144,6 +144,20 @@ SoxrParseAttenuation(const char *svalue) {
 	return 1 / std::pow(10, value / 10.0);
 }
 
+static unsigned long
+SoxrParseCoefInterpolation(const char *svalue)
+{
+	if (svalue == nullptr || strcmp(svalue, "auto") == 0)
+		return SOXR_COEF_INTERP_AUTO;
+	else if (strcmp(svalue, "low") == 0)
+		return SOXR_COEF_INTERP_LOW;
+	else if (strcmp(svalue, "high") == 0)
+		return SOXR_COEF_INTERP_HIGH;
+	else
+		throw FmtInvalidArgument("soxr converter invalid coef_interpolation: {} [auto|low|high]",
+					 svalue);
+}
+
 void
 pcm_resample_soxr_global_init(const ConfigBlock &block)
 {
@@ -182,22 +196,84 @@ pcm_resample_soxr_global_init(const ConfigBlock &block)
 
 	const unsigned n_threads = block.GetBlockValue("threads", 1);
 	soxr_runtime = soxr_runtime_spec(n_threads);
+
+	/* bits 0-1 of the runtime flags select the coefficient
+	   interpolation (see soxr.h soxr_runtime_spec.flags) */
+	soxr_runtime.flags = (soxr_runtime.flags & ~3UL) |
+		SoxrParseCoefInterpolation(block.GetBlockValue("coef_interpolation"));
+
+	if (const unsigned coef_size = block.GetBlockValue("coef_size", 0U);
+	    coef_size > 0)
+		soxr_runtime.coef_size_kbytes = coef_size;
+
+	FmtDebug(soxr_domain, "soxr threads={} coef_size={}kB",
+		 n_threads, soxr_runtime.coef_size_kbytes);
+}
+
+/**
+ * Determine the libsoxr input data type for the given sample format.
+ * Formats which are not supported natively are converted to float by
+ * #GluePcmResampler.
+ *
+ * @param format the sample format; set to FLOAT if it is not
+ * supported natively
+ * @param scale multiplied with the gain needed for this data type
+ */
+static soxr_datatype_t
+SoxrInputType(SampleFormat &format, double &scale) noexcept
+{
+	switch (format) {
+	case SampleFormat::S16:
+		return SOXR_INT16_I;
+
+	case SampleFormat::S24_P32:
+		/* libsoxr interprets the data as 32 bit samples,
+		   which are 8 bits too quiet */
+		scale *= 256;
+		return SOXR_INT32_I;
+
+	case SampleFormat::S32:
+		return SOXR_INT32_I;
+
+	default:
+		format = SampleFormat::FLOAT;
+		return SOXR_FLOAT32_I;
+	}
+}
+
+/**
+ * Determine the libsoxr output data type (and update the given
+ * format to what will be produced).  Only S32 is produced
+ * natively (libsoxr clips just like MPD's own float conversion);
+ * for everything else, MPD converts the float output.
+ */
+static soxr_datatype_t
+SoxrOutputType(SampleFormat &format) noexcept
+{
+	if (format == SampleFormat::S32)
+		return SOXR_INT32_I;
+
+	format = SampleFormat::FLOAT;
+	return SOXR_FLOAT32_I;
 }
 
 AudioFormat
-SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
+		       SampleFormat dest_format)
 {
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
+	soxr_io_spec_t io = soxr_use_custom_recipe
+		? soxr_io_custom_recipe
+		: soxr_io_spec(SOXR_FLOAT32_I, SOXR_FLOAT32_I);
+	io.itype = SoxrInputType(af.format, io.scale);
+	io.otype = SoxrOutputType(dest_format);
+
 	soxr_error_t e;
-	soxr_io_spec_t* p_soxr_io = nullptr;
-	if(soxr_use_custom_recipe) {
-		p_soxr_io = & soxr_io_custom_recipe;
-	}
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   p_soxr_io, &soxr_quality, &soxr_runtime);
+			   &io, &soxr_quality, &soxr_runtime);
 	if (soxr == nullptr)
 		throw FmtRuntimeError("soxr initialization has failed: {}",
 				      e);
@@ -222,11 +298,13 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
 	ratio = float(new_sample_rate) / float(af.sample_rate);
 	FmtDebug(soxr_domain, "samplerate conversion ratio to {:0.2f}", ratio);
 
-	/* libsoxr works with floating point samples */
-	af.format = SampleFormat::FLOAT;
-
 	AudioFormat result = af;
+	result.format = dest_format;
 	result.sample_rate = new_sample_rate;
+
+	input_frame_size = af.GetFrameSize();
+	output_frame_size = result.GetFrameSize();
+
 	return result;
 }
 
@@ -245,15 +323,14 @@ SoxrPcmResampler::Reset() noexcept
 std::span<const std::byte>
 SoxrPcmResampler::Resample(std::span<const std::byte> src)
 {
-	const size_t frame_size = channels * sizeof(float);
-	assert(src.size() % frame_size == 0);
+	assert(src.size() % input_frame_size == 0);
 
-	const size_t n_frames = src.size() / frame_size;
+	const size_t n_frames = src.size() / input_frame_size;
 
 	/* always round up: worst case output buffer size */
 	const size_t o_frames = size_t(n_frames * ratio) + 1;
 
-	auto *output_buffer = (float *)buffer.Get(o_frames * frame_size);
+	auto *output_buffer = buffer.Get(o_frames * output_frame_size);
 
 	size_t i_done, o_done;
 	soxr_error_t e = soxr_process(soxr, src.data(), n_frames, &i_done,
@@ -261,16 +338,15 @@ SoxrPcmResampler::Resample(std::span<const std::byte> src)
 	if (e != nullptr)
 		throw FmtRuntimeError("soxr error: {}", e);
 
-	return { (const std::byte *)output_buffer, o_done * frame_size };
+	return { (const std::byte *)output_buffer, o_done * output_frame_size };
 }
 
 std::span<const std::byte>
 SoxrPcmResampler::Flush()
 {
-	const size_t frame_size = channels * sizeof(float);
 	const size_t o_frames = 1024;
 
-	auto *output_buffer = (float *)buffer.Get(o_frames * frame_size);
+	auto *output_buffer = buffer.Get(o_frames * output_frame_size);
 
 	size_t o_done;
 	soxr_error_t e = soxr_process(soxr, nullptr, 0, nullptr,
@@ -282,5 +358,5 @@ SoxrPcmResampler::Flush()
 		/* flush complete */
 		output_buffer = nullptr;
 
-	return { (const std::byte *)output_buffer, o_done * frame_size };
+	return { (const std::byte *)output_buffer, o_done * output_frame_size };
 }
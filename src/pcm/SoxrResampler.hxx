@@ -19,10 +19,18 @@ class SoxrPcmResampler final : public PcmResampler {
 	unsigned channels;
 	float ratio;
 
+	/**
+	 * The size of one input/output frame in bytes.  libsoxr
+	 * converts some integer sample formats on the fly, which saves
+	 * a separate conversion pass.
+	 */
+	size_t input_frame_size, output_frame_size;
+
 	PcmBuffer buffer;
 
 public:
-	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate,
+			 SampleFormat dest_format) override;
 	void Close() noexcept override;
 	void Reset() noexcept override;
 	std::span<const std::byte> Resample(std::span<const std::byte> src) override;
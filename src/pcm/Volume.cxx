@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "Volume.hxx"
+#include "VolumeKernels.hxx"
 #include "Silence.hxx"
 #include "Traits.hxx"
 #include "lib/fmt/AudioFormatFormatter.hxx"
@@ -10,6 +11,7 @@
 
 #include "Dither.cxx" // including the .cxx file to get inlined templates
 
+#include <algorithm> // for std::min()
 #include <cassert>
 #include <cstdint>
 #include <utility> // for std::unreachable()
@@ -86,14 +88,6 @@ pcm_volume_change_8(PcmDither &dither,
 	pcm_volume_change<SampleFormat::S8>(dither, dest, src, n, volume);
 }
 
-static void
-pcm_volume_change_16(PcmDither &dither,
-		     int16_t *dest, const int16_t *src, size_t n,
-		     int volume) noexcept
-{
-	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume);
-}
-
 static void
 PcmVolumeChange16to32(int32_t *dest, const int16_t *src, size_t n,
 		      int volume) noexcept
@@ -106,37 +100,14 @@ PcmVolumeChange16to32(int32_t *dest, const int16_t *src, size_t n,
 		    });
 }
 
-static void
-pcm_volume_change_24(PcmDither &dither,
-		     int32_t *dest, const int32_t *src, size_t n,
-		     int volume) noexcept
-{
-	pcm_volume_change<SampleFormat::S24_P32>(dither, dest, src, n,
-						 volume);
-}
-
-static void
-pcm_volume_change_32(PcmDither &dither,
-		     int32_t *dest, const int32_t *src, size_t n,
-		     int volume) noexcept
-{
-	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
-}
-
-static void
-pcm_volume_change_float(float *dest, const float *src, size_t n,
-			float volume) noexcept
-{
-	transform_n(src, n, dest,
-		    [volume](float x){ return x * volume; });
-}
-
 SampleFormat
 PcmVolume::Open(SampleFormat _format, bool allow_convert)
 {
 	assert(format == SampleFormat::UNDEFINED);
 
 	convert = false;
+	started = false;
+	ramp_position = ramp_length;
 
 	switch (_format) {
 	case SampleFormat::UNDEFINED:
@@ -170,78 +141,201 @@ PcmVolume::Open(SampleFormat _format, bool allow_convert)
 	return format = _format;
 }
 
-std::span<const std::byte>
-PcmVolume::Apply(std::span<const std::byte> src) noexcept
+/**
+ * Apply a linear volume ramp to a number of frames.  All samples of
+ * one frame get the same volume level, so the stereo image stays
+ * intact.
+ *
+ * @param f a function returning the destination sample for the
+ * given source sample and volume level
+ */
+template<typename D, typename S, typename F>
+static void
+PcmVolumeRamp(D *dest, const S *src, size_t n_frames, unsigned channels,
+	      int from, int to, unsigned position, unsigned length,
+	      F &&f) noexcept
 {
-	if (volume == PCM_VOLUME_1 && !convert)
-		return src;
+	for (size_t i = 0; i < n_frames; ++i, ++position) {
+		const int volume = from +
+			int((int64_t(to) - from) * position / length);
 
-	size_t dest_size = src.size();
-	if (convert) {
-		assert(format == SampleFormat::S16);
+		for (unsigned c = 0; c < channels; ++c)
+			*dest++ = f(*src++, volume);
+	}
+}
 
-		/* converting to S24_P32 */
-		dest_size *= 2;
+void
+PcmVolume::ApplyRamp(std::byte *dest, const std::byte *src,
+		     std::size_t n_frames) noexcept
+{
+	assert(ramp_position + n_frames <= ramp_length);
+
+	const int from = ramp_from, to = volume;
+	const unsigned channels = ramp_channels;
+	const unsigned position = ramp_position, length = ramp_length;
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		std::unreachable();
+
+	case SampleFormat::S8:
+		PcmVolumeRamp((int8_t *)dest, (const int8_t *)src,
+			      n_frames, channels, from, to, position, length,
+			      [this](auto x, int v){
+				      return pcm_volume_sample<SampleFormat::S8>(dither, x, v);
+			      });
+		break;
+
+	case SampleFormat::S16:
+		if (convert)
+			PcmVolumeRamp((int32_t *)dest, (const int16_t *)src,
+				      n_frames, channels, from, to, position, length,
+				      [](auto x, int v){
+					      return PcmVolumeConvert<SampleFormat::S16,
+								      SampleFormat::S24_P32>(x, v);
+				      });
+		else
+			PcmVolumeRamp((int16_t *)dest, (const int16_t *)src,
+				      n_frames, channels, from, to, position, length,
+				      [this](auto x, int v){
+					      return pcm_volume_sample<SampleFormat::S16>(dither, x, v);
+				      });
+		break;
+
+	case SampleFormat::S24_P32:
+		PcmVolumeRamp((int32_t *)dest, (const int32_t *)src,
+			      n_frames, channels, from, to, position, length,
+			      [this](auto x, int v){
+				      return pcm_volume_sample<SampleFormat::S24_P32>(dither, x, v);
+			      });
+		break;
+
+	case SampleFormat::S32:
+		PcmVolumeRamp((int32_t *)dest, (const int32_t *)src,
+			      n_frames, channels, from, to, position, length,
+			      [this](auto x, int v){
+				      return pcm_volume_sample<SampleFormat::S32>(dither, x, v);
+			      });
+		break;
+
+	case SampleFormat::FLOAT:
+		PcmVolumeRamp((float *)dest, (const float *)src,
+			      n_frames, channels, from, to, position, length,
+			      [](float x, int v){
+				      return x * pcm_volume_to_float(v);
+			      });
+		break;
 	}
 
-	void *data = buffer.Get(dest_size);
+	ramp_position += n_frames;
+}
+
+void
+PcmVolume::ApplyConstant(std::byte *dest, const std::byte *src,
+			 std::size_t n) noexcept
+{
+	const std::size_t dest_size = n * sample_format_size(format)
+		* (convert ? 2 : 1);
 
 	if (volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
-		PcmSilence(std::span{(std::byte *)data, dest_size},
-			   format);
-		return { (const std::byte *)data, dest_size };
+		PcmSilence(std::span{dest, dest_size},
+			   convert ? SampleFormat::S24_P32 : format);
+		return;
+	}
+
+	if (volume == PCM_VOLUME_1 && !convert) {
+		memcpy(dest, src, dest_size);
+		return;
 	}
 
+	const auto &kernels = GetPcmVolumeKernels();
+
 	switch (format) {
 	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
 		std::unreachable();
 
 	case SampleFormat::S8:
-		pcm_volume_change_8(dither, (int8_t *)data,
-				    (const int8_t *)src.data(),
-				    src.size() / sizeof(int8_t),
+		pcm_volume_change_8(dither, (int8_t *)dest,
+				    (const int8_t *)src, n,
 				    volume);
 		break;
 
 	case SampleFormat::S16:
 		if (convert)
-			PcmVolumeChange16to32((int32_t *)data,
-					      (const int16_t *)src.data(),
-					      src.size() / sizeof(int16_t),
+			PcmVolumeChange16to32((int32_t *)dest,
+					      (const int16_t *)src, n,
 					      volume);
 		else
-			pcm_volume_change_16(dither, (int16_t *)data,
-					     (const int16_t *)src.data(),
-					     src.size() / sizeof(int16_t),
-					     volume);
+			kernels.volume_16(dither, (int16_t *)dest,
+					  (const int16_t *)src, n,
+					  volume);
 		break;
 
 	case SampleFormat::S24_P32:
-		pcm_volume_change_24(dither, (int32_t *)data,
-				     (const int32_t *)src.data(),
-				     src.size() / sizeof(int32_t),
-				     volume);
+		kernels.volume_24(dither, (int32_t *)dest,
+				  (const int32_t *)src, n,
+				  volume);
 		break;
 
 	case SampleFormat::S32:
-		pcm_volume_change_32(dither, (int32_t *)data,
-				     (const int32_t *)src.data(),
-				     src.size() / sizeof(int32_t),
-				     volume);
+		kernels.volume_32(dither, (int32_t *)dest,
+				  (const int32_t *)src, n,
+				  volume);
 		break;
 
 	case SampleFormat::FLOAT:
-		pcm_volume_change_float((float *)data,
-					(const float *)src.data(),
-					src.size() / sizeof(float),
-					pcm_volume_to_float(volume));
+		kernels.volume_float((float *)dest,
+				     (const float *)src, n,
+				     pcm_volume_to_float(volume));
 		break;
+	}
+}
 
-	case SampleFormat::DSD:
+std::span<const std::byte>
+PcmVolume::Apply(std::span<const std::byte> src) noexcept
+{
+	if (format == SampleFormat::DSD)
 		// TODO: implement this; currently, it's a no-op
 		return src;
+
+	started = true;
+
+	const bool ramping = ramp_position < ramp_length;
+	if (volume == PCM_VOLUME_1 && !convert && !ramping)
+		return src;
+
+	const std::size_t sample_size = sample_format_size(format);
+	std::size_t n = src.size() / sample_size;
+
+	size_t dest_size = src.size();
+	if (convert) {
+		assert(format == SampleFormat::S16);
+
+		/* converting to S24_P32 */
+		dest_size *= 2;
+	}
+
+	auto *const data = (std::byte *)buffer.Get(dest_size);
+	std::byte *dest = data;
+
+	if (ramping) {
+		assert(n % ramp_channels == 0);
+
+		const std::size_t n_frames =
+			std::min<std::size_t>(n / ramp_channels,
+					      ramp_length - ramp_position);
+		ApplyRamp(dest, src.data(), n_frames);
+
+		const std::size_t n_samples = n_frames * ramp_channels;
+		src = src.subspan(n_samples * sample_size);
+		dest += n_samples * sample_size * (convert ? 2 : 1);
+		n -= n_samples;
 	}
 
-	return { (const std::byte *)data, dest_size };
+	ApplyConstant(dest, src.data(), n);
+
+	return { data, dest_size };
 }
@@ -8,13 +8,11 @@
 #include "Buffer.hxx"
 #include "Dither.hxx"
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <span>
 
-#ifndef NDEBUG
-#include <cassert>
-#endif
-
 /**
  * Number of fractional bits for a fixed-point volume value.
  */
@@ -54,8 +52,35 @@ class PcmVolume {
 	 */
 	bool convert;
 
+	/**
+	 * Has Apply() been called since Open()?  Before that, volume
+	 * changes take effect immediately, even if ramping is
+	 * enabled.
+	 */
+	bool started;
+
 	unsigned volume;
 
+	/**
+	 * The number of channels per frame and the length of a volume
+	 * ramp in frames; see EnableRamp().  A #ramp_length of 0
+	 * disables ramping.
+	 */
+	unsigned ramp_channels = 0, ramp_length = 0;
+
+	/**
+	 * The volume level at the beginning of the current ramp
+	 * (which ends at #volume).
+	 */
+	unsigned ramp_from;
+
+	/**
+	 * The number of frames of the current ramp which have already
+	 * been processed.  If this equals #ramp_length, then there is
+	 * no ramp in progress.
+	 */
+	unsigned ramp_position = 0;
+
 	PcmBuffer buffer;
 	PcmDither dither;
 
@@ -77,7 +102,41 @@ public:
 	 * then it will most likely clip a lot
 	 */
 	void SetVolume(unsigned _volume) noexcept {
+		if (ramp_length > 0 && started && _volume != volume) {
+			/* start a new ramp at the current level,
+			   which may be in the middle of another
+			   ramp */
+			ramp_from = GetRampVolume(ramp_position);
+			ramp_position = 0;
+		}
+
+		volume = _volume;
+	}
+
+	/**
+	 * Like SetVolume(), but change the level abruptly even if
+	 * ramping is enabled (this finishes a ramp which may be in
+	 * progress).
+	 */
+	void JumpVolume(unsigned _volume) noexcept {
 		volume = _volume;
+		ramp_position = ramp_length;
+	}
+
+	/**
+	 * Fade smoothly between the old and the new level when
+	 * SetVolume() is called while playing, instead of changing
+	 * abruptly (which can be heard as a click).  Must be called
+	 * after Open().
+	 *
+	 * @param channels the number of channels per frame
+	 * @param frames the length of the ramp in frames
+	 */
+	void EnableRamp(unsigned channels, unsigned frames) noexcept {
+		assert(channels > 0);
+
+		ramp_channels = channels;
+		ramp_length = ramp_position = frames;
 	}
 
 	/**
@@ -103,10 +162,45 @@ public:
 	}
 
 	/**
-	 * Apply the volume level.
+	 * Would Apply() return its input unmodified?  This is the
+	 * case at 100% volume without conversion and without a ramp
+	 * in progress.
 	 */
 	[[gnu::pure]]
+	bool IsIdentity() const noexcept {
+		return format == SampleFormat::DSD ||
+			(volume == PCM_VOLUME_1 && !convert &&
+			 ramp_position >= ramp_length);
+	}
+
+	/**
+	 * Apply the volume level.
+	 */
 	std::span<const std::byte> Apply(std::span<const std::byte> src) noexcept;
+
+private:
+	/**
+	 * Returns the volume level at the given frame of the current
+	 * ramp.
+	 */
+	[[gnu::pure]]
+	unsigned GetRampVolume(unsigned position) const noexcept {
+		if (position >= ramp_length)
+			return volume;
+
+		return ramp_from + int((int64_t(volume) - int64_t(ramp_from))
+				       * position / ramp_length);
+	}
+
+	void ApplyRamp(std::byte *dest, const std::byte *src,
+		       std::size_t n_frames) noexcept;
+
+	/**
+	 * Apply #volume to a number of samples, writing to the given
+	 * destination buffer.
+	 */
+	void ApplyConstant(std::byte *dest, const std::byte *src,
+			   std::size_t n_samples) noexcept;
 };
 
 #endif
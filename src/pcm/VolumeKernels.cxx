@@ -0,0 +1,538 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "VolumeKernels.hxx"
+#include "Volume.hxx"
+#include "Traits.hxx"
+#include "FloatConvert.hxx"
+
+#include "Dither.cxx" // including the .cxx file to get inlined templates
+
+#include <array>
+
+#include <string.h> // for memcpy()
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PCM_KERNELS_X86
+#endif
+
+/*
+ * The scalar kernels; they process one sample at a time, with the
+ * serial #PcmDither state.
+ */
+
+template<SampleFormat F, IntegerSampleTraits Traits=SampleTraits<F>>
+static void
+ScalarVolume(PcmDither &dither,
+	     typename Traits::pointer dest,
+	     typename Traits::const_pointer src,
+	     std::size_t n, int volume) noexcept
+{
+	using long_type = typename Traits::long_type;
+
+	for (std::size_t i = 0; i != n; ++i)
+		dest[i] = dither.DitherShift<long_type,
+					     Traits::BITS + PCM_VOLUME_BITS,
+					     Traits::BITS>(long_type(src[i]) * volume);
+}
+
+template<SampleFormat F, IntegerSampleTraits Traits=SampleTraits<F>>
+static void
+ScalarAddVolume(PcmDither &dither,
+		typename Traits::pointer a,
+		typename Traits::const_pointer b,
+		std::size_t n, int volume1, int volume2) noexcept
+{
+	using long_type = typename Traits::long_type;
+
+	for (std::size_t i = 0; i != n; ++i)
+		a[i] = dither.DitherShift<long_type,
+					  Traits::BITS + PCM_VOLUME_BITS,
+					  Traits::BITS>(long_type(a[i]) * volume1 +
+							long_type(b[i]) * volume2);
+}
+
+static void
+ScalarVolumeFloat(float *dest, const float *src, std::size_t n,
+		  float volume) noexcept
+{
+	for (std::size_t i = 0; i != n; ++i)
+		dest[i] = src[i] * volume;
+}
+
+static void
+ScalarAddVolumeFloat(float *a, const float *b, std::size_t n,
+		     float volume1, float volume2) noexcept
+{
+	for (std::size_t i = 0; i != n; ++i)
+		a[i] = a[i] * volume1 + b[i] * volume2;
+}
+
+static void
+ScalarDither24To16(PcmDither &dither, int16_t *dest, const int32_t *src,
+		   std::size_t n) noexcept
+{
+	dither.Dither24To16(dest, src, src + n);
+}
+
+static void
+ScalarDither32To16(PcmDither &dither, int16_t *dest, const int32_t *src,
+		   std::size_t n) noexcept
+{
+	dither.Dither32To16(dest, src, src + n);
+}
+
+/**
+ * Convert float to 16 bit by converting to 24 bit first (which is
+ * cheap and precise enough) and then dithering.
+ */
+static void
+ScalarDitherFloatTo16(PcmDither &dither, int16_t *dest, const float *src,
+		      std::size_t n) noexcept
+{
+	using Convert = FloatToIntegerSampleConvert<SampleFormat::S24_P32>;
+
+	for (std::size_t i = 0; i != n; ++i)
+		dest[i] = dither.DitherShift<int32_t, 24, 16>(Convert::Convert(src[i]));
+}
+
+static constexpr PcmVolumeKernels scalar_kernels{
+	"scalar",
+	ScalarVolume<SampleFormat::S16>,
+	ScalarVolume<SampleFormat::S24_P32>,
+	ScalarVolume<SampleFormat::S32>,
+	ScalarVolumeFloat,
+	ScalarAddVolume<SampleFormat::S16>,
+	ScalarAddVolume<SampleFormat::S24_P32>,
+	ScalarAddVolume<SampleFormat::S32>,
+	ScalarAddVolumeFloat,
+	ScalarDither24To16,
+	ScalarDither32To16,
+	ScalarDitherFloatTo16,
+};
+
+/*
+ * The vectorized kernels, written with GCC vector extensions.  The
+ * compiler translates them to the instruction set of the
+ * (non-inline) wrapper function they are inlined into.  L is the
+ * number of lanes; it must be chosen so one vector fills exactly one
+ * register, or else the compiler generates slow code.  The remaining
+ * samples at the end are processed by the scalar code.
+ */
+
+/**
+ * The vector version of PcmDither::DitherShift(), with one
+ * independent state per lane.
+ *
+ * @tparam ST the input sample type
+ * @tparam L the number of lanes
+ */
+template<typename ST, std::size_t L>
+class DitherVector {
+	static_assert(L <= PcmDitherLanes::MAX);
+
+public:
+	typedef ST Vector [[gnu::vector_size(sizeof(ST) * L)]];
+
+private:
+	typedef int32_t Error [[gnu::vector_size(sizeof(int32_t) * L)]];
+	typedef uint32_t Random [[gnu::vector_size(sizeof(uint32_t) * L)]];
+
+	Error error[3];
+	Random random;
+
+public:
+	[[gnu::always_inline]]
+	explicit DitherVector(const PcmDitherLanes &lanes) noexcept {
+		for (unsigned i = 0; i < 3; ++i)
+			memcpy(&error[i], lanes.error[i], sizeof(error[i]));
+		memcpy(&random, lanes.random, sizeof(random));
+	}
+
+	[[gnu::always_inline]]
+	void Store(PcmDitherLanes &lanes) const noexcept {
+		for (unsigned i = 0; i < 3; ++i)
+			memcpy(lanes.error[i], &error[i], sizeof(error[i]));
+		memcpy(lanes.random, &random, sizeof(random));
+	}
+
+	/**
+	 * Shift the given samples (in-place) by #SBITS-#DBITS to the
+	 * right, and apply dithering.  This is the same algorithm as
+	 * PcmDither::Dither(), but with masks instead of branches.
+	 */
+	template<unsigned SBITS, unsigned DBITS>
+	[[gnu::always_inline]]
+	void Shift(Vector &_sample) noexcept {
+		static_assert(sizeof(ST) * 8 > SBITS, "Source type too small");
+		static_assert(SBITS > DBITS, "Non-positive scale_bits");
+
+		constexpr unsigned scale_bits = SBITS - DBITS;
+		constexpr ST MIN = -(ST(1) << (SBITS - 1));
+		constexpr ST MAX = (ST(1) << (SBITS - 1)) - 1;
+		constexpr ST round = ST(1) << (scale_bits - 1);
+		constexpr ST mask = (ST(1) << scale_bits) - 1;
+
+		Vector sample = _sample;
+		sample += __builtin_convertvector(error[0] - error[1] + error[2],
+						  Vector);
+
+		error[2] = error[1];
+		error[1] = error[0] / 2;
+
+		/* round */
+		Vector output = sample + round;
+
+		const Random rnd = random * 0x0019660dU + 0x3c6ef35fU;
+		output += __builtin_convertvector(rnd & uint32_t(mask), Vector) -
+			__builtin_convertvector(random & uint32_t(mask), Vector);
+		random = rnd;
+
+		/* clip */
+		const Vector above = output > MAX, below = output < MIN;
+		const Vector clip_max = above & (sample > MAX);
+		const Vector clip_min = below & (sample < MIN);
+		sample = (sample & ~(clip_max | clip_min)) |
+			(clip_max & MAX) | (clip_min & MIN);
+		output = (output & ~(above | below)) |
+			(above & MAX) | (below & MIN);
+
+		output &= ~mask;
+
+		error[0] = __builtin_convertvector(sample - output, Error);
+
+		_sample = output >> scale_bits;
+	}
+};
+
+template<SampleFormat F, std::size_t L,
+	 IntegerSampleTraits Traits=SampleTraits<F>>
+[[gnu::always_inline]]
+static inline void
+VectorVolume(PcmDither &dither,
+	     typename Traits::pointer dest,
+	     typename Traits::const_pointer src,
+	     std::size_t n, int volume) noexcept
+{
+	using long_type = typename Traits::long_type;
+	using D = DitherVector<long_type, L>;
+	typedef typename Traits::value_type Samples
+		[[gnu::vector_size(Traits::SAMPLE_SIZE * L)]];
+
+	D d{dither.GetLanes()};
+
+	for (; n >= L; n -= L, src += L, dest += L) {
+		Samples x;
+		memcpy(&x, src, sizeof(x));
+
+		auto y = __builtin_convertvector(x, typename D::Vector) * volume;
+		d.template Shift<Traits::BITS + PCM_VOLUME_BITS,
+				 Traits::BITS>(y);
+
+		x = __builtin_convertvector(y, Samples);
+		memcpy(dest, &x, sizeof(x));
+	}
+
+	d.Store(dither.GetLanes());
+
+	ScalarVolume<F, Traits>(dither, dest, src, n, volume);
+}
+
+template<SampleFormat F, std::size_t L,
+	 IntegerSampleTraits Traits=SampleTraits<F>>
+[[gnu::always_inline]]
+static inline void
+VectorAddVolume(PcmDither &dither,
+		typename Traits::pointer a,
+		typename Traits::const_pointer b,
+		std::size_t n, int volume1, int volume2) noexcept
+{
+	using long_type = typename Traits::long_type;
+	using D = DitherVector<long_type, L>;
+	typedef typename Traits::value_type Samples
+		[[gnu::vector_size(Traits::SAMPLE_SIZE * L)]];
+
+	D d{dither.GetLanes()};
+
+	for (; n >= L; n -= L, a += L, b += L) {
+		Samples x, y;
+		memcpy(&x, a, sizeof(x));
+		memcpy(&y, b, sizeof(y));
+
+		auto z = __builtin_convertvector(x, typename D::Vector) * volume1 +
+			__builtin_convertvector(y, typename D::Vector) * volume2;
+		d.template Shift<Traits::BITS + PCM_VOLUME_BITS,
+				 Traits::BITS>(z);
+
+		x = __builtin_convertvector(z, Samples);
+		memcpy(a, &x, sizeof(x));
+	}
+
+	d.Store(dither.GetLanes());
+
+	ScalarAddVolume<F, Traits>(dither, a, b, n, volume1, volume2);
+}
+
+[[gnu::always_inline]]
+static inline void
+VectorVolumeFloat(float *__restrict dest, const float *__restrict src,
+		  std::size_t n, float volume) noexcept
+{
+	/* this simple loop is vectorized by the compiler */
+	for (std::size_t i = 0; i != n; ++i)
+		dest[i] = src[i] * volume;
+}
+
+[[gnu::always_inline]]
+static inline void
+VectorAddVolumeFloat(float *__restrict a, const float *__restrict b,
+		     std::size_t n, float volume1, float volume2) noexcept
+{
+	for (std::size_t i = 0; i != n; ++i)
+		a[i] = a[i] * volume1 + b[i] * volume2;
+}
+
+/**
+ * Convert to 16 bit with dithering.
+ *
+ * @tparam ST the #SampleTraits class of the source (24 or 32 bit)
+ * @tparam L the number of lanes
+ */
+template<IntegerSampleTraits ST, std::size_t L>
+[[gnu::always_inline]]
+static inline void
+VectorDitherTo16(PcmDither &dither, int16_t *dest, const int32_t *src,
+		 std::size_t n) noexcept
+{
+	/* like PcmDither::DitherConvert(), this uses sum_type,
+	   which is 32 bit for S24_P32 */
+	using D = DitherVector<typename ST::sum_type, L>;
+	typedef int32_t Samples [[gnu::vector_size(sizeof(int32_t) * L)]];
+	typedef int16_t Output [[gnu::vector_size(sizeof(int16_t) * L)]];
+
+	D d{dither.GetLanes()};
+
+	for (; n >= L; n -= L, src += L, dest += L) {
+		Samples x;
+		memcpy(&x, src, sizeof(x));
+
+		auto y = __builtin_convertvector(x, typename D::Vector);
+		d.template Shift<ST::BITS, 16>(y);
+
+		const Output z = __builtin_convertvector(y, Output);
+		memcpy(dest, &z, sizeof(z));
+	}
+
+	d.Store(dither.GetLanes());
+
+	if constexpr (ST::BITS == 24)
+		ScalarDither24To16(dither, dest, src, n);
+	else
+		ScalarDither32To16(dither, dest, src, n);
+}
+
+template<std::size_t L>
+[[gnu::always_inline]]
+static inline void
+VectorDitherFloatTo16(PcmDither &dither, int16_t *dest, const float *src,
+		      std::size_t n) noexcept
+{
+	using D = DitherVector<int32_t, L>;
+	typedef float Samples [[gnu::vector_size(sizeof(float) * L)]];
+	typedef int16_t Output [[gnu::vector_size(sizeof(int16_t) * L)]];
+
+	/* see FloatToIntegerSampleConvert; clamp before converting
+	   to integer, because out-of-range floats would overflow */
+	constexpr float factor = 1 << 23;
+	constexpr float max = float((1 << 23) - 1);
+	constexpr float min = -factor;
+
+	D d{dither.GetLanes()};
+
+	for (; n >= L; n -= L, src += L, dest += L) {
+		Samples x;
+		memcpy(&x, src, sizeof(x));
+
+		x *= factor;
+		x = x > max ? max : x;
+		x = x < min ? min : x;
+
+		auto y = __builtin_convertvector(x, typename D::Vector);
+		d.template Shift<24, 16>(y);
+
+		const Output z = __builtin_convertvector(y, Output);
+		memcpy(dest, &z, sizeof(z));
+	}
+
+	d.Store(dither.GetLanes());
+
+	ScalarDitherFloatTo16(dither, dest, src, n);
+}
+
+/**
+ * Generate the functions of a #PcmVolumeKernels instance, all
+ * compiled with the given function attributes.  L16 is the number
+ * of lanes for 16 bit samples (32 bit arithmetic), L32 the number of
+ * lanes for 24/32 bit samples (64 bit arithmetic); 0 means the
+ * scalar code is used because the instruction set lacks the
+ * necessary 64 bit operations.
+ */
+#define PCM_VOLUME_KERNELS(NAME, ATTRIBUTES, L16, L32) \
+	ATTRIBUTES static void \
+	NAME ## Volume16(PcmDither &dither, int16_t *dest, const int16_t *src, \
+			 std::size_t n, int volume) noexcept \
+	{ \
+		VectorVolume<SampleFormat::S16, L16>(dither, dest, src, n, volume); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Volume24(PcmDither &dither, int32_t *dest, const int32_t *src, \
+			 std::size_t n, int volume) noexcept \
+	{ \
+		if constexpr (L32 > 0) \
+			VectorVolume<SampleFormat::S24_P32, L32>(dither, dest, src, \
+								 n, volume); \
+		else \
+			ScalarVolume<SampleFormat::S24_P32>(dither, dest, src, \
+							    n, volume); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Volume32(PcmDither &dither, int32_t *dest, const int32_t *src, \
+			 std::size_t n, int volume) noexcept \
+	{ \
+		if constexpr (L32 > 0) \
+			VectorVolume<SampleFormat::S32, L32>(dither, dest, src, \
+							     n, volume); \
+		else \
+			ScalarVolume<SampleFormat::S32>(dither, dest, src, \
+							n, volume); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## VolumeFloat(float *dest, const float *src, std::size_t n, \
+			    float volume) noexcept \
+	{ \
+		VectorVolumeFloat(dest, src, n, volume); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## AddVolume16(PcmDither &dither, int16_t *a, const int16_t *b, \
+			    std::size_t n, int volume1, int volume2) noexcept \
+	{ \
+		VectorAddVolume<SampleFormat::S16, L16>(dither, a, b, n, \
+							volume1, volume2); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## AddVolume24(PcmDither &dither, int32_t *a, const int32_t *b, \
+			    std::size_t n, int volume1, int volume2) noexcept \
+	{ \
+		if constexpr (L32 > 0) \
+			VectorAddVolume<SampleFormat::S24_P32, L32>(dither, a, b, n, \
+								    volume1, volume2); \
+		else \
+			ScalarAddVolume<SampleFormat::S24_P32>(dither, a, b, n, \
+							       volume1, volume2); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## AddVolume32(PcmDither &dither, int32_t *a, const int32_t *b, \
+			    std::size_t n, int volume1, int volume2) noexcept \
+	{ \
+		if constexpr (L32 > 0) \
+			VectorAddVolume<SampleFormat::S32, L32>(dither, a, b, n, \
+								volume1, volume2); \
+		else \
+			ScalarAddVolume<SampleFormat::S32>(dither, a, b, n, \
+							   volume1, volume2); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## AddVolumeFloat(float *a, const float *b, std::size_t n, \
+			       float volume1, float volume2) noexcept \
+	{ \
+		VectorAddVolumeFloat(a, b, n, volume1, volume2); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Dither24To16(PcmDither &dither, int16_t *dest, \
+			     const int32_t *src, std::size_t n) noexcept \
+	{ \
+		VectorDitherTo16<SampleTraits<SampleFormat::S24_P32>, L16>(dither, dest, \
+									   src, n); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## Dither32To16(PcmDither &dither, int16_t *dest, \
+			     const int32_t *src, std::size_t n) noexcept \
+	{ \
+		if constexpr (L32 > 0) \
+			VectorDitherTo16<SampleTraits<SampleFormat::S32>, L32>(dither, dest, \
+									       src, n); \
+		else \
+			ScalarDither32To16(dither, dest, src, n); \
+	} \
+	ATTRIBUTES static void \
+	NAME ## DitherFloatTo16(PcmDither &dither, int16_t *dest, \
+				const float *src, std::size_t n) noexcept \
+	{ \
+		VectorDitherFloatTo16<L16>(dither, dest, src, n); \
+	} \
+	static constexpr PcmVolumeKernels NAME ## _kernels{ \
+		#NAME, \
+		NAME ## Volume16, NAME ## Volume24, NAME ## Volume32, \
+		NAME ## VolumeFloat, \
+		NAME ## AddVolume16, NAME ## AddVolume24, NAME ## AddVolume32, \
+		NAME ## AddVolumeFloat, \
+		NAME ## Dither24To16, NAME ## Dither32To16, \
+		NAME ## DitherFloatTo16, \
+	};
+
+#ifdef PCM_KERNELS_X86
+/* SSE2 has neither 64 bit multiplication nor 64 bit comparison */
+PCM_VOLUME_KERNELS(sse2, [[gnu::target("sse2")]], 4, 0)
+PCM_VOLUME_KERNELS(avx2, [[gnu::target("avx2")]], 8, 4)
+#endif
+
+#ifdef __ARM_NEON
+/* NEON has no 64 bit multiplication */
+PCM_VOLUME_KERNELS(neon, , 4, 0)
+#endif
+
+namespace {
+
+struct AvailablePcmVolumeKernels {
+	std::array<const PcmVolumeKernels *, 3> kernels;
+	std::size_t n = 0;
+
+	AvailablePcmVolumeKernels() noexcept {
+		kernels[n++] = &scalar_kernels;
+
+#ifdef PCM_KERNELS_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			kernels[n++] = &sse2_kernels;
+		if (__builtin_cpu_supports("avx2"))
+			kernels[n++] = &avx2_kernels;
+#endif
+
+#ifdef __ARM_NEON
+		kernels[n++] = &neon_kernels;
+#endif
+	}
+};
+
+} // anonymous namespace
+
+static const AvailablePcmVolumeKernels &
+GetAvailable() noexcept
+{
+	static const AvailablePcmVolumeKernels available;
+	return available;
+}
+
+const PcmVolumeKernels &
+GetPcmVolumeKernels() noexcept
+{
+	const auto &available = GetAvailable();
+	return *available.kernels[available.n - 1];
+}
+
+std::span<const PcmVolumeKernels *const>
+GetAvailablePcmVolumeKernels() noexcept
+{
+	const auto &available = GetAvailable();
+	return {available.kernels.data(), available.n};
+}
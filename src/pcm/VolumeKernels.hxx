@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+class PcmDither;
+
+/**
+ * A set of implementations of the inner loops of #PcmVolume,
+ * pcm_mix() and the dithering conversions to 16 bit (see
+ * PcmFormat.hxx).  There is one set for each instruction set supported by
+ * this build; the best one is chosen at runtime by
+ * GetPcmVolumeKernels().
+ *
+ * The integer kernels apply dithering.  The vectorized ones use
+ * #PcmDitherLanes instead of the (serial) #PcmDither state, so their
+ * output differs from the scalar kernels in the least significant
+ * bits.
+ */
+struct PcmVolumeKernels {
+	/**
+	 * A short name describing the instruction set, e.g. "avx2".
+	 */
+	const char *name;
+
+	/**
+	 * Multiply each sample in "src" with "volume" (a fixed-point
+	 * value, see #PCM_VOLUME_1) and write the result to "dest".
+	 */
+	void (*volume_16)(PcmDither &dither,
+			  int16_t *dest, const int16_t *src, std::size_t n,
+			  int volume) noexcept;
+	void (*volume_24)(PcmDither &dither,
+			  int32_t *dest, const int32_t *src, std::size_t n,
+			  int volume) noexcept;
+	void (*volume_32)(PcmDither &dither,
+			  int32_t *dest, const int32_t *src, std::size_t n,
+			  int volume) noexcept;
+	void (*volume_float)(float *dest, const float *src, std::size_t n,
+			     float volume) noexcept;
+
+	/**
+	 * Calculate a := a * volume1 + b * volume2.
+	 */
+	void (*add_volume_16)(PcmDither &dither,
+			      int16_t *a, const int16_t *b, std::size_t n,
+			      int volume1, int volume2) noexcept;
+	void (*add_volume_24)(PcmDither &dither,
+			      int32_t *a, const int32_t *b, std::size_t n,
+			      int volume1, int volume2) noexcept;
+	void (*add_volume_32)(PcmDither &dither,
+			      int32_t *a, const int32_t *b, std::size_t n,
+			      int volume1, int volume2) noexcept;
+	void (*add_volume_float)(float *a, const float *b, std::size_t n,
+				 float volume1, float volume2) noexcept;
+
+	/**
+	 * Convert to 16 bit with dithering and noise shaping.
+	 */
+	void (*dither_24_to_16)(PcmDither &dither,
+				int16_t *dest, const int32_t *src,
+				std::size_t n) noexcept;
+	void (*dither_32_to_16)(PcmDither &dither,
+				int16_t *dest, const int32_t *src,
+				std::size_t n) noexcept;
+	void (*dither_float_to_16)(PcmDither &dither,
+				   int16_t *dest, const float *src,
+				   std::size_t n) noexcept;
+};
+
+/**
+ * Returns the fastest #PcmVolumeKernels supported by this CPU.  The
+ * CPU features are detected on the first call.
+ */
+const PcmVolumeKernels &
+GetPcmVolumeKernels() noexcept;
+
+/**
+ * Returns all #PcmVolumeKernels supported by this CPU, starting with
+ * the (slowest) scalar implementation.  This is useful for tests and
+ * benchmarks.
+ */
+std::span<const PcmVolumeKernels *const>
+GetAvailablePcmVolumeKernels() noexcept;
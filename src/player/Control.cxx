@@ -4,21 +4,30 @@
 #include "Control.hxx"
 #include "Outputs.hxx"
 #include "Listener.hxx"
+#include "decoder/Control.hxx"
+#include "MusicBuffer.hxx"
 #include "song/DetachedSong.hxx"
 
 #include <algorithm>
 #include <cassert>
+#include <utility> // for std::exchange()
 
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     PlayerOutputs &_outputs,
 			     InputCacheManager *_input_cache,
+			     const SongAnalysisStore *_song_analysis,
+			     MusicBufferPool *_buffer_pool,
 			     const PlayerConfig &_config) noexcept
 	:listener(_listener), outputs(_outputs),
 	 input_cache(_input_cache),
+	 song_analysis(_song_analysis),
+	 buffer_pool(_buffer_pool),
 	 config(_config),
 	 thread(BIND_THIS_METHOD(RunThread))
 
 {
+	/* the player is stopped until the thread is started */
+	PublishStatus();
 }
 
 PlayerControl::~PlayerControl() noexcept
@@ -145,9 +154,52 @@ PlayerControl::LockSetBorderPause(bool _border_pause) noexcept
 	border_pause = _border_pause;
 }
 
+void
+PlayerControl::PublishStatus(bool advancing) noexcept
+{
+	StatusSnapshot s{};
+	s.status.state = state;
+
+	if (state != PlayerState::STOP) {
+		s.status.bit_rate = bit_rate;
+		s.status.audio_format = audio_format;
+		s.status.total_time = total_time;
+		s.status.elapsed_time = elapsed_time;
+		s.status.buffer_before_play = buffer_before_play;
+		s.status.fill_rate = fill_rate;
+	}
+
+	s.status.error = error_type != PlayerError::NONE;
+	s.time = std::chrono::steady_clock::now();
+	s.advancing = advancing && state == PlayerState::PLAY;
+	s.valid = true;
+
+	status_snapshot.Store(s);
+}
+
 PlayerStatus
-PlayerControl::LockGetStatus() noexcept
+PlayerControl::GetStatus() noexcept
 {
+	if (auto s = status_snapshot.Load(); s.valid) {
+		if (!s.advancing)
+			/* nothing changes without invalidating the
+			   snapshot */
+			return s.status;
+
+		const auto age = std::chrono::steady_clock::now() - s.time;
+		if (age < STATUS_MAX_AGE) {
+			/* the song has been playing since the
+			   snapshot was taken */
+			auto &status = s.status;
+			status.elapsed_time = status.elapsed_time +
+				SongTime::Cast(age);
+			if (!status.total_time.IsNegative() &&
+			    status.elapsed_time > SongTime(status.total_time))
+				status.elapsed_time = SongTime(status.total_time);
+			return status;
+		}
+	}
+
 	PlayerStatus status;
 
 	std::unique_lock lock{mutex};
@@ -161,11 +213,39 @@ PlayerControl::LockGetStatus() noexcept
 		status.audio_format = audio_format;
 		status.total_time = total_time;
 		status.elapsed_time = elapsed_time;
+		status.buffer_before_play = buffer_before_play;
+		status.fill_rate = fill_rate;
 	}
 
+	status.error = error_type != PlayerError::NONE;
+
 	return status;
 }
 
+DecoderStats
+PlayerControl::LockGetDecoderStats() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	return decoder_control != nullptr
+		? decoder_control->stats
+		: DecoderStats{};
+}
+
+PlayerBufferStats
+PlayerControl::LockGetBufferStats() const noexcept
+{
+	const std::lock_guard protect{mutex};
+	if (music_buffer == nullptr)
+		return {};
+
+	return {
+		music_buffer->GetSize(),
+		music_buffer->GetAllocatedCount(),
+		music_buffer->GetBorrowedCount(),
+		music_buffer->GetChunkSize(),
+	};
+}
+
 void
 PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 {
@@ -174,6 +254,7 @@ PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 
 	error_type = type;
 	error = std::move(_error);
+	InvalidateStatus();
 
 	// TODO: is it ok to call this while holding mutex lock?
 	listener.OnPlayerError();
@@ -213,6 +294,13 @@ PlayerControl::LockReadTaggedSong() noexcept
 	return ReadTaggedSong();
 }
 
+std::string
+PlayerControl::LockReadDurationDetectedURI() noexcept
+{
+	const std::lock_guard protect{mutex};
+	return std::exchange(duration_detected_uri, std::string{});
+}
+
 void
 PlayerControl::LockEnqueueSong(std::unique_ptr<DetachedSong> song) noexcept
 {
@@ -10,11 +10,14 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
+#include "thread/SeqLock.hxx"
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
 #include "ReplayGainMode.hxx"
 #include "MusicChunkPtr.hxx"
+#include "decoder/Stats.hxx"
 
+#include <chrono>
 #include <cstdint>
 #include <exception>
 #include <memory>
@@ -24,7 +27,11 @@ struct PlayerConfig;
 class PlayerListener;
 class PlayerOutputs;
 class InputCacheManager;
+class SongAnalysisStore;
+class MusicBufferPool;
 class DetachedSong;
+class DecoderControl;
+class MusicBuffer;
 
 enum class PlayerState : uint8_t {
 	STOP,
@@ -86,12 +93,53 @@ enum class PlayerError : uint8_t {
 	OUTPUT,
 };
 
+struct PlayerBufferStats {
+	/**
+	 * The total number of chunks; 0 if the player thread is not
+	 * running.
+	 */
+	unsigned chunks;
+
+	/**
+	 * The number of chunks which are currently in use.
+	 */
+	unsigned chunks_used;
+
+	/**
+	 * The number of chunks borrowed from the instance-wide
+	 * #MusicBufferPool.
+	 */
+	unsigned chunks_borrowed;
+
+	/**
+	 * The PCM capacity of each chunk in bytes.
+	 */
+	std::size_t chunk_size;
+};
+
 struct PlayerStatus {
 	PlayerState state;
 	uint16_t bit_rate;
 	AudioFormat audio_format;
 	SignedSongTime total_time;
 	SongTime elapsed_time;
+
+	/**
+	 * The amount of data buffered before playback started, see
+	 * PlayerControl::buffer_before_play.
+	 */
+	FloatDuration buffer_before_play;
+
+	/**
+	 * See PlayerControl::fill_rate.
+	 */
+	double fill_rate;
+
+	/**
+	 * Is there an error condition?  If yes, the caller may
+	 * obtain it with PlayerControl::LockCheckRethrowError().
+	 */
+	bool error;
 };
 
 class PlayerControl final : public AudioOutputClient {
@@ -103,6 +151,14 @@ class PlayerControl final : public AudioOutputClient {
 
 	InputCacheManager *const input_cache;
 
+	const SongAnalysisStore *const song_analysis;
+
+	/**
+	 * The instance-wide pool which the #MusicBuffer borrows
+	 * chunks from; nullptr if there is none.
+	 */
+	MusicBufferPool *const buffer_pool;
+
 	const PlayerConfig config;
 
 	/**
@@ -155,6 +211,27 @@ class PlayerControl final : public AudioOutputClient {
 	 */
 	std::unique_ptr<DetachedSong> tagged_song;
 
+	/**
+	 * The URI of a database song whose duration was detected by
+	 * the decoder (see PlayerListener::OnPlayerDurationDetected()).
+	 *
+	 * Protected by #mutex.  Set by the PlayerThread and consumed
+	 * by the main thread.
+	 */
+	std::string duration_detected_uri;
+
+	/**
+	 * The #DecoderControl owned by the player thread; nullptr if
+	 * the thread is not running.  It shares #mutex.
+	 */
+	const DecoderControl *decoder_control = nullptr;
+
+	/**
+	 * The #MusicBuffer owned by the player thread; nullptr if the
+	 * thread is not running.  Protected by #mutex.
+	 */
+	const MusicBuffer *music_buffer = nullptr;
+
 	PlayerCommand command = PlayerCommand::NONE;
 	PlayerState state = PlayerState::STOP;
 
@@ -205,16 +282,77 @@ class PlayerControl final : public AudioOutputClient {
 	SignedSongTime total_time;
 	SongTime elapsed_time;
 
+	/**
+	 * The amount of data which the player decided to buffer
+	 * before starting playback of the current song.
+	 */
+	FloatDuration buffer_before_play = FloatDuration::zero();
+
+	/**
+	 * The speed of the decoder (relative to realtime) measured
+	 * while buffering; 0 if unknown.
+	 */
+	double fill_rate = 0;
+
 	SongTime seek_time;
 
 	CrossFadeSettings cross_fade;
 
 	FloatDuration total_play_time = FloatDuration::zero();
 
+	/**
+	 * A copy of the #PlayerStatus published by the player thread,
+	 * see PublishStatus().
+	 */
+	struct StatusSnapshot {
+		PlayerStatus status;
+
+		/**
+		 * When was #status.elapsed_time determined?
+		 */
+		std::chrono::steady_clock::time_point time;
+
+		/**
+		 * Is the elapsed time advancing, i.e. is audio being
+		 * played right now?
+		 */
+		bool advancing;
+
+		/**
+		 * False if the status may have been modified since
+		 * the snapshot was taken.
+		 */
+		bool valid;
+	};
+
+	/**
+	 * Allows GetStatus() to obtain the status without locking
+	 * #mutex and without a #PlayerCommand::REFRESH round trip.
+	 * Writers must lock #mutex.
+	 */
+	SeqLock<StatusSnapshot> status_snapshot;
+
+	/**
+	 * While playing, a snapshot older than this is not used by
+	 * GetStatus().  The player thread refreshes it more often
+	 * than that.
+	 */
+	static constexpr std::chrono::steady_clock::duration STATUS_MAX_AGE =
+		std::chrono::milliseconds{500};
+
 public:
+	/**
+	 * While playing, the player thread publishes a new status
+	 * snapshot at least this often.
+	 */
+	static constexpr std::chrono::steady_clock::duration STATUS_PUBLISH_INTERVAL =
+		std::chrono::milliseconds{100};
+
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
 		      InputCacheManager *_input_cache,
+		      const SongAnalysisStore *_song_analysis,
+		      MusicBufferPool *_buffer_pool,
 		      const PlayerConfig &_config) noexcept;
 	~PlayerControl() noexcept;
 
@@ -302,8 +440,66 @@ public:
 	 */
 	std::unique_ptr<DetachedSong> LockReadTaggedSong() noexcept;
 
+	/**
+	 * Read and clear the #duration_detected_uri attribute.
+	 */
+	std::string LockReadDurationDetectedURI() noexcept;
+
+	/**
+	 * Obtain the current status.  Most of the time, this is a
+	 * copy of the snapshot published by the player thread (see
+	 * PublishStatus()), which does not lock the object; only if
+	 * the snapshot is outdated, this asks the player thread for
+	 * an update.
+	 */
+	PlayerStatus GetStatus() noexcept;
+
+	/**
+	 * Copy the current status to #status_snapshot.
+	 *
+	 * To be called from the player thread.  Caller must lock the
+	 * object and must have updated #elapsed_time.
+	 *
+	 * @param advancing is audio being played right now, i.e. may
+	 * GetStatus() add the time since this call to the elapsed
+	 * time?
+	 */
+	void PublishStatus(bool advancing=false) noexcept;
+
+	/**
+	 * Mark #status_snapshot as outdated, because the status is
+	 * about to change.  GetStatus() will not use it until the
+	 * next PublishStatus() call.
+	 *
+	 * Caller must lock the object.
+	 */
+	void InvalidateStatus() noexcept {
+		status_snapshot.Store({});
+	}
+
+	/**
+	 * Is #status_snapshot valid and recent enough?  Caller must
+	 * lock the object.
+	 */
 	[[gnu::pure]]
-	PlayerStatus LockGetStatus() noexcept;
+	bool IsStatusFresh(std::chrono::steady_clock::time_point now) const noexcept {
+		const auto s = status_snapshot.Load();
+		return s.valid && now - s.time < STATUS_PUBLISH_INTERVAL;
+	}
+
+	/**
+	 * Returns a copy of the performance counters of the decoder
+	 * plugin which is currently running (or which has run
+	 * last).
+	 */
+	[[gnu::pure]]
+	DecoderStats LockGetDecoderStats() const noexcept;
+
+	/**
+	 * Returns the usage of the player's #MusicBuffer.
+	 */
+	[[gnu::pure]]
+	PlayerBufferStats LockGetBufferStats() const noexcept;
 
 	PlayerState GetState() const noexcept {
 		return state;
@@ -435,6 +631,9 @@ private:
 				PlayerCommand cmd) noexcept {
 		assert(command == PlayerCommand::NONE);
 
+		if (cmd != PlayerCommand::REFRESH)
+			InvalidateStatus();
+
 		command = cmd;
 		Signal();
 		WaitCommandLocked(lock);
@@ -457,11 +656,15 @@ private:
 	void ClearError() noexcept {
 		error_type = PlayerError::NONE;
 		error = std::exception_ptr();
+		InvalidateStatus();
 	}
 
 	bool ApplyBorderPause() noexcept {
-		if (border_pause)
+		if (border_pause) {
 			state = PlayerState::PAUSE;
+			InvalidateStatus();
+		}
+
 		return border_pause;
 	}
 
@@ -483,6 +686,7 @@ private:
 		/* pause: the user may resume playback as soon as an
 		   audio output becomes available */
 		state = PlayerState::PAUSE;
+		InvalidateStatus();
 	}
 
 	void LockSetOutputError(std::exception_ptr &&_error) noexcept {
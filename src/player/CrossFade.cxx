@@ -3,7 +3,6 @@
 
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
-#include "MusicChunk.hxx"
 #include "pcm/AudioFormat.hxx"
 #include "util/CNumberParser.hxx"
 #include "util/Domain.hxx"
@@ -95,6 +94,7 @@ unsigned
 CrossFadeSettings::Calculate(float replay_gain_db, float replay_gain_prev_db,
 			     const char *mixramp_start, const char *mixramp_prev_end,
 			     const AudioFormat af,
+			     std::size_t chunk_size,
 			     unsigned max_chunks) const noexcept
 {
 	assert(IsEnabled());
@@ -105,7 +105,7 @@ CrossFadeSettings::Calculate(float replay_gain_db, float replay_gain_prev_db,
 	assert(af.IsValid());
 
 	const auto chunk_duration =
-		af.SizeToTime<FloatDuration>(sizeof(MusicChunk::data));
+		af.SizeToTime<FloatDuration>(chunk_size);
 
 	if (!IsMixRampEnabled() ||
 	    !mixramp_start || !mixramp_prev_end) {
@@ -34,6 +34,14 @@ public:
 	 */
 	virtual void OnPlayerTagModified() noexcept = 0;
 
+	/**
+	 * The decoder has found out the real duration of the current
+	 * song, which is a database song, and
+	 * PlayerControl::LockReadDurationDetectedURI() returns its
+	 * URI.
+	 */
+	virtual void OnPlayerDurationDetected() noexcept {}
+
 	/**
 	 * Playback went into border pause.
 	 */
@@ -9,6 +9,7 @@
 
 struct AudioFormat;
 struct MusicChunk;
+class MusicPipe;
 
 /**
  * An interface for the player thread to control all outputs.  This
@@ -80,6 +81,35 @@ public:
 	 */
 	virtual void Cancel() noexcept = 0;
 
+	/**
+	 * Like Cancel(), but the chunks which were not played yet are
+	 * moved to the history (see GetHistory()) instead of being
+	 * freed.
+	 */
+	virtual void CancelToHistory() noexcept = 0;
+
+	/**
+	 * Keep up to this number of played chunks of the current
+	 * song, to allow seeking backwards without the decoder.  0
+	 * disables the history.
+	 */
+	virtual void SetHistorySize(unsigned max_chunks) noexcept = 0;
+
+	/**
+	 * Returns the most recently played chunks of the current song
+	 * in playback order.  Only the player thread may access
+	 * this object.
+	 */
+	virtual MusicPipe &GetHistory() noexcept = 0;
+
+	/**
+	 * Free all chunks in the history, e.g. because the decoder
+	 * seeks and the history is not contiguous with the new
+	 * chunks.  Chunks which are still queued are not added to
+	 * the history.
+	 */
+	virtual void ClearHistory() noexcept = 0;
+
 	/**
 	 * Indicate that a new song will begin now.
 	 */
@@ -92,6 +122,15 @@ public:
 	 */
 	[[gnu::pure]]
 	virtual SignedSongTime GetElapsedTime() const noexcept = 0;
+
+	/**
+	 * Returns the configured "format" of the first enabled
+	 * output (a mask which may be partially or completely
+	 * undefined).  Decoders which synthesize audio may use this
+	 * to avoid resampling.
+	 */
+	[[gnu::pure]]
+	virtual AudioFormat GetPreferredAudioFormat() const noexcept = 0;
 };
 
 #endif
@@ -31,10 +31,15 @@
 #include "pcm/MixRampGlue.hxx"
 #include "tag/Tag.hxx"
 #include "util/Domain.hxx"
+#include "system/Error.hxx"
+#include "system/Probe.hxx"
 #include "thread/Name.hxx"
 #include "thread/ScopeUnlock.hxx"
+#include "util/ScopeExit.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <memory>
 
@@ -42,10 +47,30 @@ static constexpr Domain player_domain("player");
 
 /**
  * Start playback as soon as enough data for this duration has been
- * pushed to the decoder pipe.
+ * pushed to the decoder pipe.  This is the default which gets
+ * adjusted by Player::CheckBuffering() after the decoder's fill rate
+ * has been measured.
  */
 static constexpr auto buffer_before_play_duration = std::chrono::seconds(1);
 
+/**
+ * The minimum and maximum for the adjusted buffer_before_play.
+ */
+static constexpr auto min_buffer_before_play_duration = std::chrono::milliseconds(200);
+static constexpr auto max_buffer_before_play_duration = std::chrono::seconds(5);
+
+/**
+ * Measure the fill rate for at least this duration before trusting
+ * it.
+ */
+static constexpr auto fill_rate_measure_duration = std::chrono::milliseconds(50);
+
+/**
+ * If the decoder fills the pipe faster than this factor (relative to
+ * realtime), playback starts after #min_buffer_before_play_duration.
+ */
+static constexpr double fast_fill_rate = 2;
+
 class Player {
 	PlayerControl &pc;
 
@@ -89,6 +114,19 @@ class Player {
 	 */
 	bool buffering = true;
 
+	/**
+	 * The number of chunks in the pipe when CheckBuffering() was
+	 * called first after #buffering was set.
+	 */
+	unsigned buffering_start_chunks;
+
+	/**
+	 * The time when CheckBuffering() was called first after
+	 * #buffering was set; the default value means it has not been
+	 * called yet.
+	 */
+	std::chrono::steady_clock::time_point buffering_start{};
+
 	/**
 	 * true if the decoder is starting and did not provide data
 	 * yet
@@ -186,6 +224,14 @@ public:
 	}
 
 private:
+	/**
+	 * Change the #PlayerState.  Caller must lock the mutex.
+	 */
+	void SetState(PlayerState state) noexcept {
+		pc.state = state;
+		MPD_PROBE(player_state, unsigned(state));
+	}
+
 	/**
 	 * Reset cross-fading to the initial state.  A check to
 	 * re-enable it at an appropriate time will be scheduled.
@@ -194,6 +240,26 @@ private:
 		xfade_state = CrossFadeState::UNKNOWN;
 	}
 
+	/**
+	 * Wait for #buffer_before_play again (e.g. after seeking).
+	 * CheckBuffering() starts measuring the fill rate anew.
+	 */
+	void StartBuffering() noexcept {
+		buffering = true;
+		buffering_start = {};
+	}
+
+	/**
+	 * Convert a duration to a number of pipe chunks in
+	 * #play_audio_format, rounding up.
+	 */
+	template<typename D>
+	unsigned DurationToChunks(D duration) const noexcept {
+		const std::size_t size = play_audio_format.TimeToSize(duration);
+		return (size + buffer.GetChunkSize() - 1)
+			/ buffer.GetChunkSize();
+	}
+
 	template<typename P>
 	void ReplacePipe(P &&_pipe) noexcept {
 		ResetCrossFade();
@@ -222,6 +288,27 @@ private:
 	 */
 	bool CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept;
 
+	/**
+	 * Measure how fast the decoder fills the pipe (relative to
+	 * realtime) and adjust #buffer_before_play: if the decoder is
+	 * fast, the pipe will never run empty and playback can start
+	 * early; if it is slower than realtime, wait for more data.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * @return true if buffering is complete
+	 */
+	bool CheckBuffering() noexcept;
+
+	/**
+	 * The decoder has reported the real duration of the current
+	 * song (DecoderControl::detected_duration); update the
+	 * song's tag.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void ApplyDetectedDuration() noexcept;
+
 	/**
 	 * Stop the decoder and clears (and frees) its music pipe.
 	 *
@@ -263,6 +350,30 @@ private:
 	bool SeekDecoder(std::unique_lock<Mutex> &lock,
 			 SongTime seek_time) noexcept;
 
+	/**
+	 * Can a seek to #PlayerControl::next_song be served from
+	 * chunks which are already decoded?  That is possible if it
+	 * is the current song and the decoder is still at it.
+	 */
+	[[gnu::pure]]
+	bool CanSeekInBuffer() const noexcept {
+		return song != nullptr && song->IsSame(*pc.next_song) &&
+			!decoder_starting && IsDecoderAtCurrentSong() &&
+			play_audio_format.IsDefined();
+	}
+
+	/**
+	 * Try to seek by repositioning within the chunks of the
+	 * current song which are still in the #MusicPipe or in the
+	 * history of played chunks (see PlayerOutputs::GetHistory()),
+	 * without restarting the decoder.  Must be called after
+	 * PlayerOutputs::CancelToHistory().
+	 *
+	 * @return true on success, false if the position is not
+	 * buffered
+	 */
+	bool SeekInBuffer(SongTime seek_time) noexcept;
+
 	/**
 	 * This is the handler for the #PlayerCommand::SEEK command.
 	 *
@@ -343,6 +454,29 @@ private:
 	 */
 	bool ProcessCommand(std::unique_lock<Mutex> &lock) noexcept;
 
+	/**
+	 * Copy the current elapsed time to PlayerControl::elapsed_time.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	void UpdateElapsedTime() noexcept {
+		if (const auto outputs_time = pc.outputs.GetElapsedTime();
+		    !outputs_time.IsNegative())
+			pc.elapsed_time = static_cast<SongTime>(outputs_time);
+		else
+			pc.elapsed_time = elapsed_time;
+	}
+
+	/**
+	 * Is audio being played right now, i.e. is the elapsed time
+	 * advancing?
+	 */
+	[[gnu::pure]]
+	bool IsAdvancing() const noexcept {
+		return output_open && !paused && !buffering &&
+			!decoder_starting;
+	}
+
 	/**
 	 * This is called at the border between two songs: the audio output
 	 * has consumed all chunks of the current song, and we should start
@@ -373,6 +507,8 @@ Player::StartDecoder(std::unique_lock<Mutex> &lock,
 	/* copy ReplayGain parameters to the decoder */
 	dc.replay_gain_mode = pc.replay_gain_mode;
 
+	dc.output_audio_format = pc.outputs.GetPreferredAudioFormat();
+
 	SongTime start_time = pc.next_song->GetStartTime() + pc.seek_time;
 
 	dc.Start(lock, std::make_unique<DetachedSong>(*pc.next_song),
@@ -437,6 +573,7 @@ Player::ActivateDecoder() noexcept
 	pc.total_time = song->GetDuration();
 	pc.bit_rate = 0;
 	pc.audio_format.Clear();
+	pc.InvalidateStatus();
 
 	{
 		/* call playlist::SyncWithPlayer() in the main thread */
@@ -510,8 +647,8 @@ Player::MixRampScannerReady() noexcept
 		const std::size_t want_pipe_bytes =
 			dc.out_audio_format.TimeToSize(std::chrono::seconds{20});
 		const std::size_t want_pipe_chunks =
-			std::min((want_pipe_bytes + sizeof(MusicChunk::data) - 1)
-				 / sizeof(MusicChunk::data),
+			std::min((want_pipe_bytes + buffer.GetChunkSize() - 1)
+				 / buffer.GetChunkSize(),
 				 buffer.GetSize() / std::size_t{3});
 
 		if (dc.pipe->GetSize() < want_pipe_chunks) {
@@ -564,7 +701,8 @@ Player::OpenOutput() noexcept
 	output_open = true;
 	paused = false;
 
-	pc.state = PlayerState::PLAY;
+	SetState(PlayerState::PLAY);
+	pc.InvalidateStatus();
 	pc.listener.OnPlayerStateChanged();
 
 	return true;
@@ -590,6 +728,7 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 		pc.total_time = real_song_duration(*dc.song,
 						   dc.total_time);
 		pc.audio_format = dc.in_audio_format;
+		pc.InvalidateStatus();
 		play_audio_format = dc.out_audio_format;
 		decoder_starting = false;
 
@@ -603,11 +742,9 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 			pc.listener.OnPlayerTagModified();
 		}
 
-		const size_t buffer_before_play_size =
-			play_audio_format.TimeToSize(buffer_before_play_duration);
-		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+		buffer_before_play = DurationToChunks(buffer_before_play_duration);
+		pc.buffer_before_play = buffer_before_play_duration;
+		pc.fill_rate = 0;
 
 		pc.listener.OnPlayerStateChanged();
 
@@ -621,13 +758,13 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 				return false;
 
 			/* re-fill the buffer after seeking */
-			buffering = true;
+			StartBuffering();
 		} else if (pc.seeking) {
 			pc.seeking = false;
 			pc.ClientSignal();
 
 			/* re-fill the buffer after seeking */
-			buffering = true;
+			StartBuffering();
 		}
 
 		if (!paused && !OpenOutput()) {
@@ -648,6 +785,59 @@ Player::CheckDecoderStartup(std::unique_lock<Mutex> &lock) noexcept
 	}
 }
 
+
+bool
+Player::CheckBuffering() noexcept
+{
+	if (dc.IsIdle() || buffer.IsFull())
+		return true;
+
+	const unsigned n_chunks = pipe->GetSize();
+	if (n_chunks >= buffer_before_play)
+		return true;
+
+	const auto now = std::chrono::steady_clock::now();
+	if (buffering_start == std::chrono::steady_clock::time_point{}) {
+		buffering_start = now;
+		buffering_start_chunks = n_chunks;
+		return false;
+	}
+
+	const FloatDuration wall_time = now - buffering_start;
+	if (wall_time < fill_rate_measure_duration ||
+	    n_chunks <= buffering_start_chunks)
+		return false;
+
+	const FloatDuration chunk_duration =
+		play_audio_format.SizeToTime<FloatDuration>(buffer.GetChunkSize());
+	const double fill_rate =
+		chunk_duration * (n_chunks - buffering_start_chunks) / wall_time;
+
+	FloatDuration target = buffer_before_play_duration;
+	if (fill_rate >= fast_fill_rate) {
+		target = min_buffer_before_play_duration;
+	} else if (fill_rate < 1) {
+		/* the decoder is slower than realtime; to avoid an
+		   underrun, the buffer needs to cover the deficit
+		   for the rest of the song */
+		target = max_buffer_before_play_duration;
+
+		if (!dc.total_time.IsNegative()) {
+			const FloatDuration remaining{dc.total_time.ToDoubleS() -
+						      pc.elapsed_time.ToDoubleS()};
+			target = std::clamp(remaining * (1 - fill_rate),
+					    FloatDuration{buffer_before_play_duration},
+					    FloatDuration{max_buffer_before_play_duration});
+		}
+	}
+
+	buffer_before_play = DurationToChunks(target);
+	pc.buffer_before_play = target;
+	pc.fill_rate = fill_rate;
+
+	return n_chunks >= buffer_before_play;
+}
+
 bool
 Player::SeekDecoder(std::unique_lock<Mutex> &lock, SongTime seek_time) noexcept
 {
@@ -674,6 +864,87 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock, SongTime seek_time) noexcept
 	return true;
 }
 
+/**
+ * Find the chunk which contains the given time stamp, starting at
+ * the given chunk.  Returns nullptr if the chunks end before this
+ * time stamp, or if a chunk without time stamp is found.
+ */
+[[gnu::pure]]
+static const MusicChunk *
+FindChunk(const MusicChunk *chunk, SignedSongTime t,
+	  AudioFormat audio_format) noexcept
+{
+	for (; chunk != nullptr; chunk = chunk->GetNext()) {
+		if (chunk->time.IsNegative() || chunk->time > t)
+			return nullptr;
+
+		if (t < chunk->time + audio_format.SizeToTime<SignedSongTime>(chunk->length))
+			return chunk;
+	}
+
+	return nullptr;
+}
+
+/**
+ * Remove the beginning of a chunk's PCM data, so it starts at the
+ * given time stamp.
+ */
+static void
+TrimChunk(MusicChunk &chunk, SignedSongTime t,
+	  AudioFormat audio_format) noexcept
+{
+	assert(t >= chunk.time);
+
+	const std::size_t offset = audio_format.TimeToSize(t - chunk.time);
+	if (offset == 0 || offset >= chunk.length)
+		return;
+
+	const auto data = chunk.data.first(chunk.length);
+	std::copy(data.begin() + offset, data.end(), data.begin());
+	chunk.length -= offset;
+	chunk.time = t;
+}
+
+bool
+Player::SeekInBuffer(SongTime seek_time) noexcept
+{
+	const SignedSongTime t{seek_time};
+	auto &history = pc.outputs.GetHistory();
+
+	if (const auto *found = FindChunk(history.Peek(), t, play_audio_format)) {
+		/* seeking backwards: play the history again */
+		while (history.Peek() != found)
+			history.Shift();
+
+		auto chunk = history.Shift();
+		TrimChunk(*chunk, t, play_audio_format);
+		history.PushFront(std::move(chunk));
+
+		pipe->PushFront(history);
+	} else if ((found = FindChunk(pipe->Peek(), t, play_audio_format)) != nullptr) {
+		/* seeking forward: skip the decoded chunks before
+		   the new position, but keep them in the history */
+		const unsigned max_history = pc.config.history_chunks;
+		while (pipe->Peek() != found) {
+			auto chunk = pipe->Shift();
+			if (max_history > 0 && chunk->length > 0) {
+				history.Push(std::move(chunk));
+				while (history.GetSize() > max_history)
+					history.Shift();
+			}
+		}
+
+		auto chunk = pipe->Shift();
+		TrimChunk(*chunk, t, play_audio_format);
+		pipe->PushFront(std::move(chunk));
+	} else
+		return false;
+
+	FmtDebug(player_domain, "seek to {:.3f}s within the buffer",
+		 seek_time.ToDoubleS());
+	return true;
+}
+
 inline bool
 Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 {
@@ -695,13 +966,41 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 
 	CancelPendingSeek();
 
+	const bool try_seek_in_buffer = CanSeekInBuffer();
+
 	{
 		const ScopeUnlock unlock{lock};
-		pc.outputs.Cancel();
+		if (try_seek_in_buffer)
+			pc.outputs.CancelToHistory();
+		else
+			pc.outputs.Cancel();
 	}
 
 	pc.listener.OnPlayerStateChanged();
 
+	if (try_seek_in_buffer) {
+		if (SeekInBuffer(pc.seek_time)) {
+			pc.next_song.reset();
+			queued = false;
+
+			elapsed_time = pc.seek_time;
+			pc.CommandFinished();
+
+			{
+				/* call syncPlaylistWithQueue() in the
+				   main thread */
+				const ScopeUnlock unlock{lock};
+				pc.listener.OnPlayerSync();
+			}
+
+			return true;
+		}
+
+		/* the decoder will seek; the history is not
+		   contiguous with its new chunks */
+		pc.outputs.ClearHistory();
+	}
+
 	if (!dc.IsSeekableCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
@@ -756,7 +1055,7 @@ Player::SeekDecoder(std::unique_lock<Mutex> &lock) noexcept
 	assert(xfade_state == CrossFadeState::UNKNOWN);
 
 	/* re-fill the buffer after seeking */
-	buffering = true;
+	StartBuffering();
 
 	{
 		/* call syncPlaylistWithQueue() in the main thread */
@@ -801,20 +1100,26 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 		if (!decoder_starting && dc.IsIdle())
 			StartDecoder(lock, std::make_shared<MusicPipe>(),
 				     false);
+		else
+			/* the decoder is still busy with the current
+			   song; let the plugin prepare the next one
+			   meanwhile */
+			dc.prefetch.Schedule(*pc.next_song,
+					     dc.GetPreferredAudioFormat());
 
 		break;
 
 	case PlayerCommand::PAUSE:
 		paused = !paused;
 		if (paused) {
-			pc.state = PlayerState::PAUSE;
+			SetState(PlayerState::PAUSE);
 
 			const ScopeUnlock unlock{lock};
 			pc.outputs.Pause();
 		} else if (!play_audio_format.IsDefined()) {
 			/* the decoder hasn't provided an audio format
 			   yet - don't open the audio device yet */
-			pc.state = PlayerState::PLAY;
+			SetState(PlayerState::PLAY);
 		} else {
 			OpenOutput();
 		}
@@ -848,12 +1153,8 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 			pc.outputs.CheckPipe();
 		}
 
-		if (const auto outputs_time = pc.outputs.GetElapsedTime();
-		    !outputs_time.IsNegative())
-			pc.elapsed_time = static_cast<SongTime>(outputs_time);
-		else
-			pc.elapsed_time = elapsed_time;
-
+		UpdateElapsedTime();
+		pc.PublishStatus(IsAdvancing());
 		pc.CommandFinished();
 		break;
 	}
@@ -861,6 +1162,32 @@ Player::ProcessCommand(std::unique_lock<Mutex> &lock) noexcept
 	return true;
 }
 
+inline void
+Player::ApplyDetectedDuration() noexcept
+{
+	const SongTime duration{std::exchange(dc.detected_duration,
+					      SignedSongTime::Negative())};
+
+	if (song->GetEndTime().IsPositive())
+		/* the song is a range of a file (e.g. from a CUE
+		   sheet) with its own duration */
+		return;
+
+	auto tag = song->GetTag();
+	tag.duration = SignedSongTime{duration};
+	song->SetTag(std::move(tag));
+
+	pc.total_time = song->GetDuration();
+	pc.InvalidateStatus();
+	pc.tagged_song = std::make_unique<DetachedSong>(*song);
+	if (song->IsInDatabase())
+		pc.duration_detected_uri = song->GetURI();
+
+	const ScopeUnlock unlock(pc.mutex);
+	pc.listener.OnPlayerTagModified();
+	pc.listener.OnPlayerDurationDetected();
+}
+
 inline void
 Player::CheckCrossFade() noexcept
 {
@@ -903,6 +1230,7 @@ Player::CheckCrossFade() noexcept
 					dc.GetMixRampStart(),
 					dc.GetMixRampPreviousEnd(),
 					play_audio_format,
+					buffer.GetChunkSize(),
 					buffer.GetSize() -
 					buffer_before_play);
 	if (cross_fade_chunks > 0)
@@ -1120,6 +1448,10 @@ Player::SongBorder() noexcept
 inline void
 Player::Run() noexcept
 {
+	/* chunks of the previous playback must not be played
+	   again */
+	pc.outputs.ClearHistory();
+
 	pipe = std::make_shared<MusicPipe>();
 
 	std::unique_lock lock{pc.mutex};
@@ -1127,11 +1459,19 @@ Player::Run() noexcept
 	StartDecoder(lock, pipe, true);
 	ActivateDecoder();
 
-	pc.state = PlayerState::PLAY;
+	SetState(PlayerState::PLAY);
 
 	pc.CommandFinished();
 
 	while (ProcessCommand(lock)) {
+		if (pc.command == PlayerCommand::NONE && !pc.seeking &&
+		    !pc.IsStatusFresh(std::chrono::steady_clock::now())) {
+			/* let GetStatus() see the current elapsed
+			   time without a REFRESH round trip */
+			UpdateElapsedTime();
+			pc.PublishStatus(IsAdvancing());
+		}
+
 		if (decoder_starting) {
 			/* wait until the decoder is initialized completely */
 
@@ -1146,8 +1486,7 @@ Player::Run() noexcept
 			   until the buffer is large enough, to
 			   prevent stuttering on slow machines */
 
-			if (pipe->GetSize() < buffer_before_play &&
-			    !dc.IsIdle() && !buffer.IsFull()) {
+			if (!CheckBuffering()) {
 				/* not enough decoded buffer space yet */
 
 				dc.WaitForDecoder(lock);
@@ -1155,9 +1494,14 @@ Player::Run() noexcept
 			} else {
 				/* buffering is complete */
 				buffering = false;
+				buffering_start = {};
 			}
 		}
 
+		if (!dc.detected_duration.IsNegative() &&
+		    IsDecoderAtCurrentSong())
+			ApplyDetectedDuration();
+
 		if (dc.IsIdle() && queued && IsDecoderAtCurrentSong()) {
 			/* the decoder has finished the current song;
 			   make it decode the next song */
@@ -1250,7 +1594,8 @@ Player::Run() noexcept
 		pc.next_song.reset();
 	}
 
-	pc.state = PlayerState::STOP;
+	SetState(PlayerState::STOP);
+	pc.InvalidateStatus();
 }
 
 static void
@@ -1266,16 +1611,40 @@ PlayerControl::RunThread() noexcept
 try {
 	SetThreadName("player");
 
+	try {
+		config.player_cpus.Apply();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to set the player thread's CPU affinity");
+	}
+
 	DecoderControl dc(mutex, cond,
-			  input_cache,
+			  input_cache, song_analysis,
 			  config.audio_format,
-			  config.replay_gain);
+			  config.replay_gain,
+			  config.decoder_cpus,
+			  config.decoder_realtime);
 	dc.StartThread();
 
-	MusicBuffer buffer{config.buffer_chunks};
+	/* the buffer is allocated and populated by this thread, so
+	   with "player_cpu_affinity", the kernel's first-touch policy
+	   places it on the NUMA node next to the player (and usually
+	   the decoder and the outputs) */
+	MusicBuffer buffer{config.buffer_chunks, config.chunk_size,
+			   config.buffer_hugetlb,
+			   buffer_pool, config.base_chunks};
+	bool lock_failed = false;
+	outputs.SetHistorySize(config.history_chunks);
 
 	std::unique_lock lock{mutex};
 
+	decoder_control = &dc;
+	music_buffer = &buffer;
+	AtScopeExit(this) {
+		decoder_control = nullptr;
+		music_buffer = nullptr;
+	};
+
 	while (true) {
 		switch (command) {
 		case PlayerCommand::SEEK:
@@ -1290,6 +1659,13 @@ try {
 				   later */
 				buffer.PopulateMemory();
 
+				if (config.buffer_lock && !lock_failed &&
+				    !buffer.LockMemory()) {
+					/* don't try again */
+					lock_failed = true;
+					LogError(std::make_exception_ptr(MakeErrno("Failed to lock the audio buffer into RAM")));
+				}
+
 				do_play(*this, dc, buffer);
 
 				/* give the main thread a chance to
@@ -1356,10 +1732,14 @@ try {
 
 		case PlayerCommand::REFRESH:
 			/* no-op when not playing */
+			PublishStatus();
 			CommandFinished();
 			break;
 
 		case PlayerCommand::NONE:
+			/* the status will not change while waiting
+			   for the next command */
+			PublishStatus();
 			Wait(lock);
 			break;
 		}
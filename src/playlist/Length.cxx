@@ -6,43 +6,314 @@
 #include "PlaylistAny.hxx"
 #include "PlaylistSong.hxx"
 #include "SongEnumerator.hxx"
+#include "SongLoader.hxx"
 #include "SongPrint.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #include "input/Error.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
 #include "fs/Traits.hxx"
 #include "thread/Mutex.hxx"
+#include "Mapper.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "PlaylistError.hxx"
+#include "PlaylistFile.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "storage/StorageInterface.hxx"
+#include "util/UriUtil.hxx"
+#endif
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+/**
+ * The maximum number of playlists in the length cache.
+ */
+static constexpr std::size_t LENGTH_CACHE_SIZE = 16;
+
+namespace {
+
+struct PlaylistLength {
+	unsigned songs = 0;
+
+	std::chrono::milliseconds playtime{};
+};
+
+/**
+ * The cached length of a playlist file.  It is valid as long as the
+ * file and the database remain unmodified.
+ */
+struct LengthCacheItem {
+	std::string uri;
+
+	std::chrono::system_clock::time_point mtime;
+
+	uint_least64_t size;
+
+	std::chrono::system_clock::time_point db_stamp;
+
+	PlaylistLength length;
+};
+
+} // anonymous namespace
+
+/**
+ * The most recently used item comes first.  This is only accessed
+ * by the main thread.
+ */
+static std::list<LengthCacheItem> length_cache;
+
 static SignedSongTime get_duration(const DetachedSong &song) {
 	const auto duration = song.GetDuration();
 	return duration.IsNegative() ? (SignedSongTime)0 : duration;
 }
 
-static void
-playlist_provider_length(Response &r,
-			 const SongLoader &loader,
+#ifdef ENABLE_DATABASE
+
+namespace {
+
+/**
+ * A playlist entry which refers to a song in the database.  Its
+ * duration is determined by ResolveDatabaseDurations().
+ */
+struct DatabaseEntry {
+	std::string uri;
+
+	/**
+	 * The length of the directory part of #uri.
+	 */
+	std::size_t directory_length;
+
+	SongTime start_time, end_time;
+
+	/**
+	 * The duration specified by the playlist (e.g. "#EXTINF").
+	 */
+	SignedSongTime duration;
+
+	explicit DatabaseEntry(const DetachedSong &song) noexcept
+		:uri(song.GetURI()),
+		 start_time(song.GetStartTime()),
+		 end_time(song.GetEndTime()),
+		 duration(song.GetTag().duration)
+	{
+		const auto parent = PathTraitsUTF8::GetParent(uri);
+		directory_length = parent.compare(".") == 0
+			? 0
+			: parent.size();
+	}
+
+	std::string_view GetDirectory() const noexcept {
+		return std::string_view{uri}.substr(0, directory_length);
+	}
+
+	bool operator<(const DatabaseEntry &other) const noexcept {
+		if (const auto c = GetDirectory().compare(other.GetDirectory());
+		    c != 0)
+			return c < 0;
+
+		return uri < other.uri;
+	}
+
+	/**
+	 * Combine this entry with the song from the database, just
+	 * like playlist_check_translate_song() followed by
+	 * DetachedSong::GetDuration() would do.
+	 */
+	[[gnu::pure]]
+	SignedSongTime GetDuration(const LightSong &song) const noexcept {
+		const SongTime a = start_time.IsZero()
+			? song.start_time
+			: start_time;
+		SongTime b = end_time.IsZero()
+			? song.end_time
+			: end_time;
+
+		if (!b.IsPositive()) {
+			const auto d = duration.IsNegative()
+				? song.tag.duration
+				: duration;
+			if (d.IsNegative())
+				return SignedSongTime::zero();
+
+			b = SongTime(d);
+		}
+
+		return {b - a};
+	}
+};
+
+} // anonymous namespace
+
+/**
+ * Look up all (sorted) entries in the database and sum their
+ * durations.  All entries in one directory are resolved with a single
+ * (non-recursive) visit instead of looking up each song on its own;
+ * the visitor gets #LightSong references, without copying anything.
+ * Entries which are not in the database are ignored.
+ */
+static std::chrono::milliseconds
+ResolveDatabaseDurations(const Database &db,
+			 const std::vector<DatabaseEntry> &entries) noexcept
+{
+	std::chrono::milliseconds total{};
+
+	for (auto i = entries.begin(); i != entries.end();) {
+		const auto directory = i->GetDirectory();
+		const auto end = std::find_if(std::next(i), entries.end(),
+					      [directory](const DatabaseEntry &e){
+						      return e.GetDirectory() != directory;
+					      });
+
+		try {
+			if (std::next(i) == end) {
+				/* only a single entry in this
+				   directory */
+				const auto *song = db.GetSong(i->uri);
+				total += i->GetDuration(*song);
+				db.ReturnSong(song);
+			} else {
+				const DatabaseSelection selection{directory, false};
+				db.Visit(selection, [i, end, &total](const LightSong &song){
+					/* the entries of this directory
+					   are sorted by URI */
+					const auto range = std::ranges::equal_range(i, end,
+										    song.GetURI(),
+										    {},
+										    &DatabaseEntry::uri);
+					for (const auto &j : range)
+						total += j.GetDuration(song);
+				});
+			}
+		} catch (...) {
+			/* this directory (or song) does not exist;
+			   ignore these entries */
+		}
+
+		i = end;
+	}
+
+	return total;
+}
+
+#endif
+
+/**
+ * @param cacheable set to false if the result depends on something
+ * else than the playlist file and the database
+ */
+static PlaylistLength
+playlist_provider_length(const SongLoader &loader,
 			 const std::string_view uri,
-			 SongEnumerator &e) noexcept
+			 SongEnumerator &e,
+			 bool &cacheable) noexcept
 {
 	const auto base_uri = PathTraitsUTF8::GetParent(uri);
 
+#ifdef ENABLE_DATABASE
+	const Database *const db = loader.GetDatabase();
+	std::vector<DatabaseEntry> db_entries;
+#endif
+
+	PlaylistLength length;
+
 	std::unique_ptr<DetachedSong> song;
-	unsigned i = 0;
-	std::chrono::milliseconds playtime = (std::chrono::milliseconds)0;
 	while ((song = e.NextSong()) != nullptr) {
-		if (playlist_check_translate_song(*song, base_uri,
-						  loader))
-			playtime += get_duration(*song);
-		i++;
+		++length.songs;
+
+		playlist_translate_song_uri(*song, base_uri);
+
+#ifdef ENABLE_DATABASE
+		if (db != nullptr) {
+			try {
+				const auto located = loader.Locate(song->GetURI());
+				if (located.type == LocatedUri::Type::RELATIVE) {
+					/* postpone the database lookup,
+					   see ResolveDatabaseDurations() */
+					db_entries.emplace_back(*song);
+					continue;
+				}
+
+				if (located.type == LocatedUri::Type::PATH)
+					/* depends on the song file and
+					   on the client's permissions */
+					cacheable = false;
+			} catch (...) {
+				/* not allowed */
+				continue;
+			}
+		}
+#endif
+
+		if (playlist_check_load_song(*song, loader))
+			length.playtime += get_duration(*song);
 	}
-	r.Fmt("songs: {}\n", i);
-	const auto seconds = std::chrono::round<std::chrono::seconds>(playtime);
+
+#ifdef ENABLE_DATABASE
+	if (!db_entries.empty()) {
+		std::sort(db_entries.begin(), db_entries.end());
+		length.playtime += ResolveDatabaseDurations(*db, db_entries);
+	}
+#else
+	/* without a database, the results of local files depend on
+	   the song files */
+	cacheable = false;
+#endif
+
+	return length;
+}
+
+/**
+ * Determine the local file which playlist_open_any() will most
+ * likely open.  Returns nullptr if it is not a local file.
+ */
+static AllocatedPath
+GetPlaylistFile(const LocatedUri &uri,
+#ifdef ENABLE_DATABASE
+		const Storage *storage
+#endif
+		) noexcept
+{
+	switch (uri.type) {
+	case LocatedUri::Type::ABSOLUTE:
+		break;
+
+	case LocatedUri::Type::PATH:
+		return uri.path;
+
+	case LocatedUri::Type::RELATIVE:
+		if (spl_valid_name(uri.canonical_uri)) {
+			auto path = map_spl_utf8_to_fs(uri.canonical_uri);
+			if (!path.IsNull() && FileExists(path))
+				return path;
+		}
+
+#ifdef ENABLE_DATABASE
+		if (storage != nullptr && uri_safe_local(uri.canonical_uri))
+			return storage->MapFS(uri.canonical_uri);
+#endif
+		break;
+	}
+
+	return nullptr;
+}
+
+static void
+PrintLength(Response &r, const PlaylistLength &length) noexcept
+{
+	r.Fmt("songs: {}\n", length.songs);
+	const auto seconds = std::chrono::round<std::chrono::seconds>(length.playtime);
 	r.Fmt("playtime: {}\n", seconds.count());
 }
 
@@ -57,6 +328,44 @@ try {
 	(void)partition;
 #endif
 
+	const auto file = GetPlaylistFile(uri
+#ifdef ENABLE_DATABASE
+					  , partition.instance.storage
+#endif
+					  );
+
+	FileInfo info;
+	const bool have_info = !file.IsNull() &&
+		GetFileInfo(file, info) && info.IsRegular();
+
+#ifdef ENABLE_DATABASE
+	const Database *const db = loader.GetDatabase();
+	const auto db_stamp = db != nullptr
+		? db->GetUpdateStamp()
+		: std::chrono::system_clock::time_point{};
+#else
+	const std::chrono::system_clock::time_point db_stamp{};
+#endif
+
+	if (have_info) {
+		for (auto i = length_cache.begin(); i != length_cache.end(); ++i) {
+			if (i->uri != uri.canonical_uri)
+				continue;
+
+			if (i->mtime != info.GetModificationTime() ||
+			    i->size != info.GetSize() ||
+			    i->db_stamp != db_stamp) {
+				/* modified */
+				length_cache.erase(i);
+				break;
+			}
+
+			length_cache.splice(length_cache.begin(), length_cache, i);
+			PrintLength(r, i->length);
+			return;
+		}
+	}
+
 	auto playlist = playlist_open_any(uri,
 #ifdef ENABLE_DATABASE
 					  partition.instance.storage,
@@ -65,7 +374,19 @@ try {
 	if (playlist == nullptr)
 		throw PlaylistError::NoSuchList();
 
-	playlist_provider_length(r, loader, uri.canonical_uri, *playlist);
+	bool cacheable = have_info;
+	const auto length = playlist_provider_length(loader, uri.canonical_uri,
+						     *playlist, cacheable);
+	PrintLength(r, length);
+
+	if (cacheable) {
+		if (length_cache.size() >= LENGTH_CACHE_SIZE)
+			length_cache.pop_back();
+
+		length_cache.push_front({std::string{uri.canonical_uri},
+				info.GetModificationTime(), info.GetSize(),
+				db_stamp, length});
+	}
 } catch (...) {
 	if (IsFileNotFound(std::current_exception()))
 		throw PlaylistError::NoSuchList();
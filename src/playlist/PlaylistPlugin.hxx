@@ -75,6 +75,18 @@ struct PlaylistPlugin {
 		return copy;
 	}
 
+	/**
+	 * Add an open_uri() method to a plugin which was constructed
+	 * with open_stream(), e.g. for a faster code path with local
+	 * files.
+	 */
+	constexpr auto WithOpenUri(std::unique_ptr<SongEnumerator> (*_open_uri)(std::string_view uri,
+										 Mutex &mutex)) const noexcept {
+		auto copy = *this;
+		copy.open_uri = _open_uri;
+		return copy;
+	}
+
 	constexpr auto WithSchemes(const char *const*_schemes) const noexcept {
 		auto copy = *this;
 		copy.schemes = _schemes;
@@ -38,7 +38,7 @@ merge_song_metadata(DetachedSong &add, const DetachedSong &base) noexcept
 		add.SetAudioFormat(base.GetAudioFormat());
 }
 
-static bool
+bool
 playlist_check_load_song(DetachedSong &song, const SongLoader &loader) noexcept
 try {
 	DetachedSong tmp = loader.LoadSong(song.GetURI());
@@ -53,9 +53,9 @@ try {
 	return false;
 }
 
-bool
-playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
-			      const SongLoader &loader) noexcept
+void
+playlist_translate_song_uri(DetachedSong &song,
+			    std::string_view base_uri) noexcept
 {
 	if (base_uri.compare(".") == 0)
 		/* PathTraitsUTF8::GetParent() returns "." when there
@@ -90,6 +90,12 @@ playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
 	/* Remove dot segments */
 	std::string new_uri = uri_squash_dot_segments(uri);
 	song.SetURI(std::move(new_uri));
+}
 
+bool
+playlist_check_translate_song(DetachedSong &song, std::string_view base_uri,
+			      const SongLoader &loader) noexcept
+{
+	playlist_translate_song_uri(song, base_uri);
 	return playlist_check_load_song(song, loader);
 }
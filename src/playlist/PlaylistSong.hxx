@@ -9,6 +9,26 @@
 class SongLoader;
 class DetachedSong;
 
+/**
+ * Make the URI of a song loaded from a playlist absolute (relative
+ * to the given base URI) and remove dot segments.  This is the first
+ * part of playlist_check_translate_song().
+ */
+void
+playlist_translate_song_uri(DetachedSong &song,
+			    std::string_view base_uri) noexcept;
+
+/**
+ * Load the song (which was already passed to
+ * playlist_translate_song_uri()) and merge its metadata.  This is
+ * the second part of playlist_check_translate_song().
+ *
+ * @return true on success, false if the song should not be used
+ */
+bool
+playlist_check_load_song(DetachedSong &song,
+			 const SongLoader &loader) noexcept;
+
 /**
  * Verifies the song, returns false if it is unsafe.  Translate the
  * song to a song within the database, if it is a local file.
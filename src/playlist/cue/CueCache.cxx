@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "CueCache.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <chrono>
+#include <list>
+
+/**
+ * The maximum number of CUE sheets in the cache.
+ */
+static constexpr std::size_t CUE_CACHE_SIZE = 32;
+
+namespace {
+
+struct CueCacheItem {
+	AllocatedPath path;
+
+	std::chrono::system_clock::time_point mtime;
+
+	uint_least64_t size;
+
+	bool embedded;
+
+	std::shared_ptr<const CueSongList> songs;
+};
+
+} // anonymous namespace
+
+static Mutex cue_cache_mutex;
+
+/**
+ * The most recently used item comes first.  Protected by
+ * #cue_cache_mutex.
+ */
+static std::list<CueCacheItem> cue_cache;
+
+std::shared_ptr<const CueSongList>
+CueCacheLoad(Path path, bool embedded,
+	     const std::function<CueSongList()> &load)
+{
+	FileInfo info;
+	if (!GetFileInfo(path, info) || !info.IsRegular())
+		/* let the function report the error */
+		return std::make_shared<const CueSongList>(load());
+
+	AllocatedPath key{path};
+	const auto mtime = info.GetModificationTime();
+	const auto size = info.GetSize();
+
+	{
+		const std::scoped_lock lock{cue_cache_mutex};
+
+		for (auto i = cue_cache.begin(); i != cue_cache.end(); ++i) {
+			if (i->embedded != embedded || i->path != key)
+				continue;
+
+			if (i->mtime != mtime || i->size != size) {
+				/* modified */
+				cue_cache.erase(i);
+				break;
+			}
+
+			cue_cache.splice(cue_cache.begin(), cue_cache, i);
+			return i->songs;
+		}
+	}
+
+	/* parse without holding the lock */
+	auto songs = std::make_shared<const CueSongList>(load());
+
+	const std::scoped_lock lock{cue_cache_mutex};
+
+	/* another thread may have parsed it meanwhile */
+	cue_cache.remove_if([&key, embedded](const CueCacheItem &i){
+		return i.embedded == embedded && i.path == key;
+	});
+
+	if (cue_cache.size() >= CUE_CACHE_SIZE)
+		cue_cache.pop_back();
+
+	cue_cache.push_front({std::move(key), mtime, size, embedded, songs});
+	return songs;
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "../SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Path;
+
+/**
+ * All songs parsed from one CUE sheet.
+ */
+using CueSongList = std::vector<DetachedSong>;
+
+/**
+ * Look up the parsed CUE sheet of the given local file in the cache.
+ * If it is not there (or if the file has been modified since), call
+ * the given function and store its result.
+ *
+ * This avoids parsing the same CUE sheet over and over, for example
+ * when it is loaded into the queue, listed and measured by
+ * "playlistlength".
+ *
+ * Throws on error (exceptions from the function are passed through
+ * and nothing is stored).
+ *
+ * @param path the file which contains the CUE sheet (the ".cue" file
+ * or the music file with an embedded "CUESHEET" tag)
+ * @param embedded true if the CUE sheet is embedded in the file;
+ * this keeps the two kinds apart
+ * @param load a function which parses the file
+ */
+std::shared_ptr<const CueSongList>
+CueCacheLoad(Path path, bool embedded,
+	     const std::function<CueSongList()> &load);
+
+/**
+ * A #SongEnumerator which returns copies of the songs of a (cached)
+ * #CueSongList.
+ */
+class CueSongListEnumerator final : public SongEnumerator {
+	const std::shared_ptr<const CueSongList> songs;
+
+	std::size_t next = 0;
+
+public:
+	explicit CueSongListEnumerator(std::shared_ptr<const CueSongList> &&_songs) noexcept
+		:songs(std::move(_songs)) {}
+
+	std::unique_ptr<DetachedSong> NextSong() override {
+		if (next >= songs->size())
+			return nullptr;
+
+		return std::make_unique<DetachedSong>((*songs)[next++]);
+	}
+};
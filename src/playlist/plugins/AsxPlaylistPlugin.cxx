@@ -3,7 +3,7 @@
 
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "ExpatSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "tag/Table.hxx"
 #include "util/ASCII.hxx"
@@ -14,10 +14,10 @@
  */
 struct AsxParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * Songs which have been parsed, but not yet returned by
+	 * ExpatSongEnumerator::NextSong().
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::deque<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -100,8 +100,8 @@ asx_end_element(void *user_data, const XML_Char *element_name)
 	case AsxParser::ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = AsxParser::ROOT;
 		}
@@ -143,17 +143,10 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 asx_open_stream(InputStreamPtr &&is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<AsxParser>>(std::move(is),
+								 asx_start_element,
+								 asx_end_element,
+								 asx_char_data);
 }
 
 static const char *const asx_suffixes[] = {
@@ -5,7 +5,12 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "input/TextInputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/Traits.hxx"
 
 class CuePlaylist final : public SongEnumerator {
 	TextInputStream tis;
@@ -44,6 +49,48 @@ CuePlaylist::NextSong()
 	return parser.Get();
 }
 
+/**
+ * Parse the whole CUE sheet file.
+ */
+static CueSongList
+ParseCueFile(Path path, Mutex &mutex)
+{
+	TextInputStream tis(OpenLocalInputStream(path, mutex));
+	CueParser parser;
+	CueSongList songs;
+
+	const char *line;
+	while ((line = tis.ReadLine()) != nullptr) {
+		parser.Feed(line);
+		while (auto song = parser.Get())
+			songs.emplace_back(std::move(*song));
+	}
+
+	parser.Finish();
+	while (auto song = parser.Get())
+		songs.emplace_back(std::move(*song));
+
+	return songs;
+}
+
+/**
+ * The code path for local files: the parsed CUE sheet is cached.
+ */
+static std::unique_ptr<SongEnumerator>
+cue_playlist_open_uri(std::string_view uri, Mutex &mutex)
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files here; everything else is read by
+		   cue_playlist_open_stream() */
+		return nullptr;
+
+	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
+
+	return std::make_unique<CueSongListEnumerator>(CueCacheLoad(path_fs, false, [&]{
+		return ParseCueFile(path_fs, mutex);
+	}));
+}
+
 static const char *const cue_playlist_suffixes[] = {
 	"cue",
 	nullptr
@@ -56,6 +103,7 @@ static const char *const cue_playlist_mime_types[] = {
 
 const PlaylistPlugin cue_playlist_plugin =
 	PlaylistPlugin("cue", cue_playlist_open_stream)
+	.WithOpenUri(cue_playlist_open_uri)
 	.WithAsFolder()
 	.WithSuffixes(cue_playlist_suffixes)
 	.WithMimeTypes(cue_playlist_mime_types);
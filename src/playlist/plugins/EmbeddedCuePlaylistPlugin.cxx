@@ -11,6 +11,7 @@
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "tag/Handler.hxx"
 #include "tag/Generic.hxx"
 #include "song/DetachedSong.hxx"
@@ -21,34 +22,8 @@
 
 #include <memory>
 
-#include <string.h>
-
 using std::string_view_literals::operator""sv;
 
-class EmbeddedCuePlaylist final : public SongEnumerator {
-public:
-	/**
-	 * This is an override for the CUE's "FILE".  An embedded CUE
-	 * sheet must always point to the song file it is contained
-	 * in.
-	 */
-	std::string filename;
-
-	/**
-	 * The value of the file's "CUESHEET" tag.
-	 */
-	std::string cuesheet;
-
-	/**
-	 * The offset of the next line within "cuesheet".
-	 */
-	char *next;
-
-	std::unique_ptr<CueParser> parser;
-
-	std::unique_ptr<DetachedSong> NextSong() override;
-};
-
 class ExtractCuesheetTagHandler final : public NullTagHandler {
 public:
 	std::string cuesheet;
@@ -65,71 +40,68 @@ ExtractCuesheetTagHandler::OnPair(std::string_view name, std::string_view value)
 		cuesheet = value;
 }
 
-static std::unique_ptr<SongEnumerator>
-embcue_playlist_open_uri(std::string_view uri,
-			 [[maybe_unused]] Mutex &mutex)
+/**
+ * Parse the "CUESHEET" tag of the given music file.
+ *
+ * @param filename an override for the CUE's "FILE"; an embedded CUE
+ * sheet must always point to the song file it is contained in
+ */
+static CueSongList
+ParseEmbeddedCue(Path path_fs, std::string_view filename)
 {
-	if (!PathTraitsUTF8::IsAbsolute(uri))
-		/* only local files supported */
-		return nullptr;
-
-	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
-
 	ExtractCuesheetTagHandler extract_cuesheet;
 	ScanFileTagsNoGeneric(path_fs, extract_cuesheet);
 	if (extract_cuesheet.cuesheet.empty())
 		ScanGenericTags(path_fs, extract_cuesheet);
 
-	if (extract_cuesheet.cuesheet.empty())
-		/* no "CUESHEET" tag found */
-		return nullptr;
+	CueParser parser;
+	CueSongList songs;
 
-	auto playlist = std::make_unique<EmbeddedCuePlaylist>();
+	const auto add = [&songs, filename](std::unique_ptr<DetachedSong> &&song){
+		song->SetURI(filename);
+		songs.emplace_back(std::move(*song));
+	};
 
-	playlist->filename = PathTraitsUTF8::GetBase(uri);
+	std::string_view src = extract_cuesheet.cuesheet;
+	while (!src.empty()) {
+		const auto eol = src.find_first_of("\r\n");
+		parser.Feed(src.substr(0, eol));
+		while (auto song = parser.Get())
+			add(std::move(song));
 
-	playlist->cuesheet = std::move(extract_cuesheet.cuesheet);
+		if (eol == src.npos)
+			break;
+
+		src = src.substr(eol + 1);
+	}
 
-	playlist->next = playlist->cuesheet.data();
-	playlist->parser = std::make_unique<CueParser>();
+	parser.Finish();
+	while (auto song = parser.Get())
+		add(std::move(song));
 
-	return playlist;
+	return songs;
 }
 
-std::unique_ptr<DetachedSong>
-EmbeddedCuePlaylist::NextSong()
+static std::unique_ptr<SongEnumerator>
+embcue_playlist_open_uri(std::string_view uri,
+			 [[maybe_unused]] Mutex &mutex)
 {
-	auto song = parser->Get();
-	if (song != nullptr) {
-		song->SetURI(filename);
-		return song;
-	}
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		/* only local files supported */
+		return nullptr;
 
-	while (*next != 0) {
-		const char *line = next;
-		char *eol = strpbrk(next, "\r\n");
-		if (eol != nullptr) {
-			/* null-terminate the line */
-			*eol = 0;
-			next = eol + 1;
-		} else
-			/* last line; put the "next" pointer to the
-			   end of the buffer */
-			next += strlen(line);
-
-		parser->Feed(line);
-		song = parser->Get();
-		if (song != nullptr) {
-			song->SetURI(filename);
-			return song;
-		}
-	}
+	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
 
-	parser->Finish();
-	song = parser->Get();
-	if (song != nullptr)
-		song->SetURI(filename);
-	return song;
+	/* a file without "CUESHEET" tag is cached as an empty list,
+	   so its tags are not scanned again */
+	auto songs = CueCacheLoad(path_fs, true, [&]{
+		return ParseEmbeddedCue(path_fs, PathTraitsUTF8::GetBase(uri));
+	});
+
+	if (songs->empty())
+		return nullptr;
+
+	return std::make_unique<CueSongListEnumerator>(std::move(songs));
 }
 
 static const char *const embcue_playlist_suffixes[] = {
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "../SongEnumerator.hxx"
+#include "song/DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "lib/expat/ExpatParser.hxx"
+#include "util/SpanCast.hxx"
+
+#include <cassert>
+#include <deque>
+#include <memory>
+
+/**
+ * A #SongEnumerator for XML playlist formats.  It feeds the
+ * #InputStream to an Expat parser only as far as needed for the next
+ * song, so the caller can start processing songs while a large
+ * (remote) document is still being received, and only a few songs
+ * are in memory at a time.
+ *
+ * @param P the parser state; its Expat handlers append finished
+ * songs to its attribute "songs" (a std::deque<DetachedSong>)
+ */
+template<typename P>
+class ExpatSongEnumerator final : public SongEnumerator {
+	InputStreamPtr is;
+
+	P parser;
+
+	ExpatParser expat{&parser};
+
+public:
+	ExpatSongEnumerator(InputStreamPtr &&_is,
+			    XML_StartElementHandler start,
+			    XML_EndElementHandler end,
+			    XML_CharacterDataHandler char_data)
+		:is(std::move(_is))
+	{
+		assert(is->IsReady());
+
+		expat.SetElementHandler(start, end);
+		expat.SetCharacterDataHandler(char_data);
+	}
+
+	std::unique_ptr<DetachedSong> NextSong() override {
+		while (parser.songs.empty()) {
+			if (is == nullptr)
+				/* end of document */
+				return nullptr;
+
+			Feed();
+		}
+
+		auto song = std::make_unique<DetachedSong>(std::move(parser.songs.front()));
+		parser.songs.pop_front();
+		return song;
+	}
+
+private:
+	void Feed() {
+		std::byte buffer[4096];
+		const std::size_t nbytes = is->LockRead(buffer);
+		if (nbytes == 0) {
+			is.reset();
+			expat.CompleteParse();
+			return;
+		}
+
+		expat.Parse(ToStringView(std::span{buffer}.first(nbytes)));
+	}
+};
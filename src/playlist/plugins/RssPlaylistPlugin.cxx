@@ -3,7 +3,7 @@
 
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "ExpatSongEnumerator.hxx"
 #include "tag/Builder.hxx"
 #include "util/ASCII.hxx"
 #include "lib/expat/ExpatParser.hxx"
@@ -13,10 +13,10 @@
  */
 struct RssParser {
 	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
+	 * Songs which have been parsed, but not yet returned by
+	 * ExpatSongEnumerator::NextSong().
 	 */
-	std::forward_list<DetachedSong> songs;
+	std::deque<DetachedSong> songs;
 
 	/**
 	 * The current position in the XML file.
@@ -86,8 +86,8 @@ rss_end_element(void *user_data, const XML_Char *element_name)
 	case RssParser::ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
 			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+				parser->songs.emplace_back(std::move(parser->location),
+							   parser->tag_builder.Commit());
 
 			parser->state = RssParser::ROOT;
 		} else
@@ -123,17 +123,10 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
 static std::unique_ptr<SongEnumerator>
 rss_open_stream(InputStreamPtr &&is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-		expat.Parse(*is);
-	}
-
-	parser.songs.reverse();
-	return std::make_unique<MemorySongEnumerator>(std::move(parser.songs));
+	return std::make_unique<ExpatSongEnumerator<RssParser>>(std::move(is),
+								 rss_start_element,
+								 rss_end_element,
+								 rss_char_data);
 }
 
 static constexpr const char *rss_suffixes[] = {
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "CompactEncoder.hxx"
+#include "util/StringSplit.hxx"
+
+using std::string_view_literals::operator""sv;
+
+void
+CompactEncoder::AppendVarint(std::string &dest, std::size_t value) noexcept
+{
+	while (value >= 0x80) {
+		dest.push_back(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+
+	dest.push_back(static_cast<char>(value));
+}
+
+inline void
+CompactEncoder::EncodeLine(std::string_view line, std::string &dest)
+{
+	std::string_view key = line, value{};
+	if (const auto colon = line.find(": "sv);
+	    colon != line.npos) {
+		key = line.substr(0, colon);
+		value = line.substr(colon + 2);
+	}
+
+	if (auto i = keys.find(key); i != keys.end()) {
+		AppendVarint(dest, i->second);
+	} else {
+		keys.emplace(key, keys.size() + 1);
+
+		AppendVarint(dest, 0);
+		AppendVarint(dest, key.size());
+		dest.append(key);
+	}
+
+	AppendVarint(dest, value.size());
+	dest.append(value);
+}
+
+void
+CompactEncoder::Encode(std::string_view text, std::string &dest)
+{
+	while (!text.empty()) {
+		auto [line, rest] = Split(text, '\n');
+		EncodeLine(line, dest);
+		text = rest;
+	}
+}
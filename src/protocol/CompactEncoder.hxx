@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+
+/**
+ * Converts text protocol response lines ("Key: value") to the
+ * "compact" encoding: each line becomes a field consisting of a
+ * varint key id and a length-prefixed value.  Key names are
+ * transmitted only once per response; the first occurrence is
+ * encoded as key id 0 followed by the length-prefixed name, which
+ * assigns the next id (starting at 1).
+ *
+ * All integers are unsigned LEB128 varints.
+ */
+class CompactEncoder {
+	std::map<std::string, unsigned, std::less<>> keys;
+
+public:
+	/**
+	 * Encode the given text (a sequence of complete lines) and
+	 * append the result to the given buffer.
+	 */
+	void Encode(std::string_view text, std::string &dest);
+
+	static void AppendVarint(std::string &dest, std::size_t value) noexcept;
+
+private:
+	void EncodeLine(std::string_view line, std::string &dest);
+};
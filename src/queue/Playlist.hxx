@@ -8,6 +8,10 @@
 #include "db/Features.hxx" // for ENABLE_DATABASE
 #include "queue/Queue.hxx"
 
+#include <span>
+#include <string>
+#include <utility>
+
 enum TagType : uint8_t;
 struct Tag;
 struct RangeArg;
@@ -248,6 +252,15 @@ public:
 	 */
 	void StaleSong(PlayerControl &pc, std::string_view uri) noexcept;
 
+	/**
+	 * Song files have been moved or renamed.  Relink all
+	 * instances of these songs in the queue to their new URIs.
+	 *
+	 * @param moved pairs of old and new URI
+	 */
+	void SongsMoved(PlayerControl &pc,
+			std::span<const std::pair<std::string, std::string>> moved) noexcept;
+
 	void Shuffle(PlayerControl &pc, RangeArg range);
 
 	void MoveRange(PlayerControl &pc, RangeArg range, unsigned to);
@@ -15,6 +15,9 @@
 #include "song/DetachedSong.hxx"
 #include "SongLoader.hxx"
 
+#include <functional> // for std::less
+#include <map>
+
 #include <stdlib.h>
 
 void
@@ -298,6 +301,51 @@ playlist::StaleSong(PlayerControl &pc, const std::string_view uri) noexcept
 			DeletePosition(pc, i);
 }
 
+void
+playlist::SongsMoved(PlayerControl &pc,
+		     std::span<const std::pair<std::string, std::string>> moved) noexcept
+{
+	std::map<std::string_view, std::string_view, std::less<>> map;
+	for (const auto &[from, to] : moved)
+		map.emplace(from, to);
+
+	const int queued_position = queued >= 0
+		? int(queue.OrderToPosition(queued))
+		: -1;
+
+	bool modified = false, was_queued = false;
+
+	for (unsigned i = 0; i < queue.length; ++i) {
+		auto &song = *queue.items[i].song;
+		if (song.HasRealURI())
+			continue;
+
+		const auto j = map.find(std::string_view{song.GetURI()});
+		if (j == map.end())
+			continue;
+
+		song.SetURI(j->second);
+		queue.ModifyAtPosition(i);
+		modified = true;
+
+		if (int(i) == queued_position)
+			was_queued = true;
+	}
+
+	if (!modified)
+		return;
+
+	if (was_queued) {
+		/* the decoder thread may be about to open the old
+		   URI; re-queue the song */
+		pc.LockCancel();
+		queued = -1;
+		UpdateQueuedSong(pc, nullptr);
+	}
+
+	OnModified();
+}
+
 void
 playlist::MoveRange(PlayerControl &pc, RangeArg range, unsigned to)
 {
@@ -46,9 +46,9 @@
 
 void
 playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
-		    PlayerControl &pc)
+		    PlayerControl &pc, QueueSaveCache &queue_cache)
 {
-	const auto player_status = pc.LockGetStatus();
+	const auto player_status = pc.GetStatus();
 
 	os.Write(PLAYLIST_STATE_FILE_STATE);
 
@@ -89,7 +89,7 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Fmt(PLAYLIST_STATE_FILE_LOADED_PLAYLIST "{}\n",
 	       playlist.GetLastLoadedPlaylist());
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
-	queue_save(os, playlist.queue);
+	queue_cache.Save(os, playlist.queue);
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
@@ -217,7 +217,7 @@ unsigned
 playlist_state_get_hash(const playlist &playlist,
 			PlayerControl &pc)
 {
-	const auto player_status = pc.LockGetStatus();
+	const auto player_status = pc.GetStatus();
 
 	return playlist.queue.version ^
 		(player_status.state != PlayerState::STOP
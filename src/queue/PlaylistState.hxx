@@ -15,10 +15,15 @@ class PlayerControl;
 class LineReader;
 class BufferedOutputStream;
 class SongLoader;
+class QueueSaveCache;
 
+/**
+ * @param queue_cache the songs are written from this cache if the
+ * queue has not been modified since the last call
+ */
 void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
-		    PlayerControl &pc);
+		    PlayerControl &pc, QueueSaveCache &queue_cache);
 
 bool
 playlist_state_restore(const StateFileConfig &config,
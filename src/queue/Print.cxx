@@ -69,6 +69,14 @@ queue_print_changes_info(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
+	if (std::vector<unsigned> positions;
+	    queue.CollectChanges(version, positions)) {
+		for (const unsigned i : positions)
+			if (i >= start && i < end)
+				queue_print_song_info(r, queue, i);
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
 			queue_print_song_info(r, queue, i);
@@ -82,6 +90,15 @@ queue_print_changes_position(Response &r, const Queue &queue,
 	assert(start <= end);
 	assert(end <= queue.GetLength());
 
+	if (std::vector<unsigned> positions;
+	    queue.CollectChanges(version, positions)) {
+		for (const unsigned i : positions)
+			if (i >= start && i < end)
+				r.Fmt("cpos: {}\nId: {}\n",
+				      i, queue.PositionToId(i));
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
 			r.Fmt("cpos: {}\nId: {}\n",
@@ -147,18 +164,29 @@ PrintSortedQueue(Response &r, const Queue &queue,
 					 return queue.GetPriorityAtPosition(a_pos) <
 						 queue.GetPriorityAtPosition(b_pos);
 				 });
-	else
-		std::stable_sort(v.begin(), v.end(),
-				 [&queue, sort, descending](unsigned a_pos,
-							    unsigned b_pos){
-					 const auto &a = queue.Get(a_pos);
-					 const auto &b = queue.Get(b_pos);
-
-					 return CompareTags(sort, descending,
-							    a.GetTag(),
-							    b.GetTag());
+	else {
+		/* determine the sort value of each song only once, not
+		   in each comparison */
+		struct Item {
+			TagSortKey key;
+			unsigned position;
+		};
+
+		std::vector<Item> items;
+		items.reserve(v.size());
+		for (const unsigned i : v)
+			items.push_back({{sort, queue.Get(i).GetTag()}, i});
+
+		std::stable_sort(items.begin(), items.end(),
+				 [descending](const Item &a, const Item &b){
+					 return CompareTagSortKeys(descending,
+								   a.key, b.key);
 				 });
 
+		std::transform(items.begin(), items.end(), v.begin(),
+			       [](const Item &i){ return i.position; });
+	}
+
 	for (unsigned i = window.start; i < window.end; ++i)
 		queue_print_song_info(r, queue, v[i]);
 }
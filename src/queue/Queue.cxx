@@ -6,13 +6,16 @@
 #include "song/LightSong.hxx"
 
 #include <algorithm>
+#include <array>
 
 Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
 	 items(new Item[max_length]),
 	 order(new unsigned[max_length]),
+	 position_order(new unsigned[max_length]),
 	 id_table(max_length * HASH_MULT)
 {
+	changes.reserve(MAX_CHANGES);
 }
 
 Queue::~Queue() noexcept
@@ -21,6 +24,25 @@ Queue::~Queue() noexcept
 
 	delete[] items;
 	delete[] order;
+	delete[] position_order;
+}
+
+std::size_t
+Queue::GetTableSize() const noexcept
+{
+	return std::size_t{max_length} *
+		(sizeof(*items) + sizeof(*order) + sizeof(*position_order) +
+		 HASH_MULT * sizeof(int)) +
+		changes.capacity() * sizeof(Change);
+}
+
+std::size_t
+Queue::GetSongMemoryUsage() const noexcept
+{
+	std::size_t result = 0;
+	for (unsigned i = 0; i < length; ++i)
+		result += items[i].song->GetMemoryUsage();
+	return result;
 }
 
 LightSong
@@ -62,7 +84,52 @@ Queue::IncrementVersion() noexcept
 			items[i].version = 0;
 
 		version = 1;
+
+		/* items with version 0 are newer than all versions,
+		   which the log cannot represent; from now on, the
+		   log is never used */
+		changes.clear();
+		changes_version = ~uint32_t{};
+	}
+}
+
+void
+Queue::LogChange(unsigned id) noexcept
+{
+	if (changes.size() >= MAX_CHANGES) {
+		/* discard the oldest half; the log is now incomplete
+		   for the version of the last discarded entry */
+		const auto middle = std::next(changes.begin(), MAX_CHANGES / 2);
+		changes_version = std::prev(middle)->version + 1;
+		changes.erase(changes.begin(), middle);
 	}
+
+	/* this doesn't allocate, because the capacity was reserved
+	   by the constructor */
+	changes.push_back({version, id});
+}
+
+bool
+Queue::CollectChanges(uint32_t _version,
+		      std::vector<unsigned> &positions) const
+{
+	if (_version > version || _version < changes_version)
+		return false;
+
+	const auto begin = std::ranges::lower_bound(changes, _version, {},
+						    &Change::version);
+	for (auto i = begin; i != changes.end(); ++i) {
+		/* the item may have been deleted (or its id reused
+		   by a newer item) meanwhile */
+		const int position = IdToPosition(i->id);
+		if (position >= 0 && IsNewerAtPosition(position, _version))
+			positions.push_back(position);
+	}
+
+	std::ranges::sort(positions);
+	const auto [first, last] = std::ranges::unique(positions);
+	positions.erase(first, last);
+	return true;
 }
 
 void
@@ -87,8 +154,9 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 	item.id = id;
 	item.version = version;
 	item.priority = priority;
+	LogChange(id);
 
-	order[position] = position;
+	order[position] = position_order[position] = position;
 
 	return id;
 }
@@ -101,8 +169,8 @@ Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	MarkModified(items[position1]);
+	MarkModified(items[position2]);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
@@ -127,19 +195,23 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 
 	id_table.Move(tmp.id, to);
 	items[to] = tmp;
-	items[to].version = version;
+	MarkModified(items[to]);
 
 	/* now deal with order */
 
 	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
+		/* the order numbers of the moved positions move
+		   along with them */
+		if (from < to) {
+			std::rotate(position_order + from,
+				    position_order + from + 1,
+				    position_order + to + 1);
+			UpdateOrder(from, to + 1);
+		} else if (from > to) {
+			std::rotate(position_order + to,
+				    position_order + from,
+				    position_order + from + 1);
+			UpdateOrder(to, from + 1);
 		}
 	}
 }
@@ -168,21 +240,22 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 	{
 		id_table.Move(tmp[i - start].id, to + i - start);
 		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
+		MarkModified(items[to + i - start]);
 	}
 
 	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
+		// Move the order numbers along with the items; the
+		// ranges are the same as the ranges of the loops above.
+		if (to > start) {
+			std::rotate(position_order + start,
+				    position_order + end,
+				    position_order + end + to - start);
+			UpdateOrder(start, end + to - start);
+		} else if (to < start) {
+			std::rotate(position_order + to,
+				    position_order + start,
+				    position_order + end);
+			UpdateOrder(to, end);
 		}
 	}
 }
@@ -204,6 +277,12 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 	}
 
 	order[to_order] = from_position;
+
+	if (from_order < to_order)
+		UpdatePositionOrder(from_order, to_order + 1);
+	else
+		UpdatePositionOrder(to_order, from_order + 1);
+
 	return to_order;
 }
 
@@ -246,16 +325,20 @@ Queue::DeletePosition(unsigned position) noexcept
 	for (unsigned i = position; i < length; i++)
 		MoveItemTo(i + 1, i);
 
-	/* delete the entry from the order array */
+	/* delete the entry from the order array and readjust its
+	   values */
 
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
+	for (unsigned i = 0; i < length; i++) {
+		const unsigned p = order[i + (i >= _order)];
+		order[i] = p - (p > position);
+	}
 
-	/* readjust values in the order array */
+	/* the same for its inverse */
 
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	for (unsigned i = 0; i < length; i++) {
+		const unsigned o = position_order[i + (i >= position)];
+		position_order[i] = o - (o > _order);
+	}
 }
 
 void
@@ -273,25 +356,6 @@ Queue::Clear() noexcept
 	last_loaded_playlist.clear();
 }
 
-static void
-queue_sort_order_by_priority(Queue *queue,
-			     unsigned start, unsigned end) noexcept
-{
-	assert(queue != nullptr);
-	assert(queue->random);
-	assert(start <= end);
-	assert(end <= queue->length);
-
-	auto cmp = [queue](unsigned a_pos, unsigned b_pos){
-		const Queue::Item &a = queue->items[a_pos];
-		const Queue::Item &b = queue->items[b_pos];
-
-		return a.priority > b.priority;
-	};
-
-	std::stable_sort(queue->order + start, queue->order + end, cmp);
-}
-
 void
 Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 {
@@ -301,10 +365,11 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+	UpdatePositionOrder(start, end);
 }
 
 /**
- * Sort the "order" of items by priority, and then shuffle each
+ * Group the "order" of items by priority, and then shuffle each
  * priority group.
  */
 void
@@ -317,28 +382,48 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end) noexcept
 	if (start == end)
 		return;
 
-	/* first group the range by priority */
-	queue_sort_order_by_priority(this, start, end);
+	/* count the items of each priority and determine the
+	   (descending) group boundaries */
+
+	std::array<unsigned, 256> group_end{};
+	for (unsigned i = start; i < end; ++i)
+		++group_end[GetOrderPriority(i)];
+
+	std::array<unsigned, 256> group_fill;
+	unsigned offset = start;
+	for (unsigned p = group_end.size(); p-- > 0;) {
+		group_fill[p] = offset;
+		offset += group_end[p];
+		group_end[p] = offset;
+	}
+
+	/* move each item into its group with an in-place bucket sort
+	   in O(n); unlike a (stable) comparison sort, the order
+	   within a group gets lost, but that doesn't matter, because
+	   the groups are shuffled below */
+
+	for (unsigned p = group_end.size(); p-- > 0;) {
+		while (group_fill[p] < group_end[p]) {
+			const uint8_t priority = GetOrderPriority(group_fill[p]);
+			if (priority == p)
+				++group_fill[p];
+			else
+				std::swap(order[group_fill[p]],
+					  order[group_fill[priority]++]);
+		}
+	}
 
 	/* now shuffle each priority group */
+
 	unsigned group_start = start;
-	uint8_t group_priority = GetOrderPriority(start);
-
-	for (unsigned i = start + 1; i < end; ++i) {
-		const uint8_t priority = GetOrderPriority(i);
-		assert(priority <= group_priority);
-
-		if (priority != group_priority) {
-			/* start of a new group - shuffle the one that
-			   has just ended */
-			ShuffleOrderRange(group_start, i);
-			group_start = i;
-			group_priority = priority;
+	for (unsigned p = group_end.size(); p-- > 0;) {
+		if (group_end[p] > group_start) {
+			ShuffleOrderRange(group_start, group_end[p]);
+			group_start = group_end[p];
 		}
 	}
 
-	/* shuffle the last group */
-	ShuffleOrderRange(group_start, end);
+	assert(group_start == end);
 }
 
 void
@@ -437,7 +522,7 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
+	MarkModified(*item);
 	item->priority = priority;
 
 	if (!random || !reorder)
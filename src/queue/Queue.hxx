@@ -12,6 +12,7 @@
 #include <cassert>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 struct LightSong;
 class DetachedSong;
@@ -69,9 +70,44 @@ struct Queue {
 	/** map order numbers to positions */
 	unsigned *const order;
 
+	/**
+	 * Map positions to order numbers; the inverse of #order,
+	 * which is updated together with it.
+	 */
+	unsigned *const position_order;
+
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/**
+	 * One entry of the #changes log: the item with this id was
+	 * modified (i.e. its Item::version was set) at this version.
+	 */
+	struct Change {
+		uint32_t version;
+		unsigned id;
+	};
+
+	/**
+	 * The maximum number of entries in #changes; the oldest half
+	 * is discarded when it is full.
+	 */
+	static constexpr std::size_t MAX_CHANGES = 4096;
+
+	/**
+	 * The most recent item modifications, ordered by version.
+	 * This allows CollectChanges() to find the songs which were
+	 * modified since a client's version without walking the
+	 * whole queue.
+	 */
+	std::vector<Change> changes;
+
+	/**
+	 * The #changes log contains all modifications with a version
+	 * number equal to or larger than this one.
+	 */
+	uint32_t changes_version = 0;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat = false;
@@ -110,6 +146,21 @@ struct Queue {
 		return length == 0;
 	}
 
+	/**
+	 * Returns the memory occupied by the tables which are
+	 * allocated for "max_playlist_length" songs, regardless of
+	 * how many songs are in the queue.
+	 */
+	[[gnu::pure]]
+	std::size_t GetTableSize() const noexcept;
+
+	/**
+	 * Returns the approximate memory occupied by all songs in the
+	 * queue.
+	 */
+	[[gnu::pure]]
+	std::size_t GetSongMemoryUsage() const noexcept;
+
 	/**
 	 * Determine if the maximum number of songs has been reached.
 	 */
@@ -153,13 +204,9 @@ struct Queue {
 	[[gnu::pure]]
 	unsigned PositionToOrder(unsigned position) const noexcept {
 		assert(position < length);
+		assert(order[position_order[position]] == position);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return position_order[position];
 	}
 
 	[[gnu::pure]]
@@ -236,7 +283,7 @@ struct Queue {
 	void ModifyAtPosition(unsigned position) noexcept {
 		assert(position < length);
 
-		items[position].version = version;
+		MarkModified(items[position]);
 	}
 
 	/**
@@ -268,6 +315,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) noexcept {
 		std::swap(order[order1], order[order2]);
+		position_order[order[order1]] = order1;
+		position_order[order[order2]] = order2;
 	}
 
 	/**
@@ -320,7 +369,7 @@ struct Queue {
 	 */
 	void RestoreOrder() noexcept {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			order[i] = position_order[i] = i;
 	}
 
 	/**
@@ -364,12 +413,59 @@ struct Queue {
 	bool SetPriorityRange(unsigned start_position, unsigned end_position,
 			      uint8_t priority, int after_order) noexcept;
 
+	/**
+	 * Collect the positions of all songs which are newer than
+	 * the specified version (see IsNewerAtPosition()) from the
+	 * #changes log, sorted by position.
+	 *
+	 * @return false if the log does not reach back to the
+	 * specified version; the caller must then check all
+	 * positions
+	 */
+	bool CollectChanges(uint32_t _version,
+			    std::vector<unsigned> &positions) const;
+
 private:
+	void LogChange(unsigned id) noexcept;
+
+	/**
+	 * Set the item's version to the current one and record this
+	 * in the #changes log.
+	 */
+	void MarkModified(Item &item) noexcept {
+		if (item.version == version)
+			/* already logged */
+			return;
+
+		item.version = version;
+		LogChange(item.id);
+	}
+
+	/**
+	 * Update #position_order after the given range of #order has
+	 * been modified.
+	 */
+	void UpdatePositionOrder(unsigned start_order,
+				 unsigned end_order) noexcept {
+		for (unsigned i = start_order; i < end_order; ++i)
+			position_order[order[i]] = i;
+	}
+
+	/**
+	 * Update #order after the given range of #position_order has
+	 * been modified.
+	 */
+	void UpdateOrder(unsigned start_position,
+			 unsigned end_position) noexcept {
+		for (unsigned i = start_position; i < end_position; ++i)
+			order[position_order[i]] = i;
+	}
+
 	void MoveItemTo(unsigned from, unsigned to) noexcept {
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		MarkModified(items[to]);
 		id_table.Move(from_id, to);
 	}
 
@@ -9,6 +9,7 @@
 #include "playlist/PlaylistSong.hxx"
 #include "io/LineReader.hxx"
 #include "io/BufferedOutputStream.hxx"
+#include "io/StringOutputStream.hxx"
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
 
@@ -59,6 +60,25 @@ queue_save(BufferedOutputStream &os, const Queue &queue)
 	}
 }
 
+void
+QueueSaveCache::Save(BufferedOutputStream &os, const Queue &queue)
+{
+	/* the length is checked, too, in case the version number
+	   has wrapped around (see Queue::IncrementVersion()) */
+	if (queue.version != version || queue.GetLength() != length) {
+		StringOutputStream sos;
+		BufferedOutputStream bos{sos};
+		queue_save(bos, queue);
+		bos.Flush();
+
+		text = std::move(sos).GetValue();
+		version = queue.version;
+		length = queue.GetLength();
+	}
+
+	os.Write(text);
+}
+
 static DetachedSong
 LoadQueueSong(LineReader &file, const char *line)
 {
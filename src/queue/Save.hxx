@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <cstdint>
+#include <string>
+
 struct Queue;
 class BufferedOutputStream;
 class LineReader;
@@ -16,6 +19,26 @@ class SongLoader;
 void
 queue_save(BufferedOutputStream &os, const Queue &queue);
 
+/**
+ * Remembers the output of queue_save() for one queue version, so the
+ * state file can be saved without formatting all songs again when
+ * only the playback state has changed.
+ */
+class QueueSaveCache {
+	std::string text;
+
+	uint32_t version = 0;
+
+	unsigned length = 0;
+
+public:
+	/**
+	 * Like queue_save(), but format only if the queue was
+	 * modified since the last call.
+	 */
+	void Save(BufferedOutputStream &os, const Queue &queue);
+};
+
 /**
  * Loads one song from the state file and appends it to the queue.
  *
@@ -4,6 +4,7 @@
 #include "AndSongFilter.hxx"
 
 #include <algorithm>
+#include <numeric>
 
 ISongFilterPtr
 AndSongFilter::Clone() const noexcept
@@ -37,6 +38,15 @@ AndSongFilter::ToExpression() const noexcept
 	return e;
 }
 
+unsigned
+AndSongFilter::GetCost() const noexcept
+{
+	return std::accumulate(items.begin(), items.end(), 0U,
+			       [](unsigned sum, const auto &i){
+				       return sum + i->GetCost();
+			       });
+}
+
 bool
 AndSongFilter::Match(const LightSong &song) const noexcept
 {
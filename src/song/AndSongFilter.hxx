@@ -36,6 +36,7 @@ public:
 	ISongFilterPtr Clone() const noexcept override;
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
+	unsigned GetCost() const noexcept override;
 };
 
 #endif
@@ -28,6 +28,13 @@ DetachedSong::operator LightSong() const noexcept
 	return result;
 }
 
+std::size_t
+DetachedSong::GetMemoryUsage() const noexcept
+{
+	return sizeof(*this) + uri.capacity() + real_uri.capacity() +
+		tag.GetItemsSize();
+}
+
 bool
 DetachedSong::IsRemote() const noexcept
 {
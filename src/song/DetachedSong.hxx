@@ -173,6 +173,13 @@ public:
 	[[gnu::pure]]
 	bool IsRemote() const noexcept;
 
+	/**
+	 * Returns the approximate amount of memory occupied by this
+	 * object (not counting the strings in the tag pool).
+	 */
+	[[gnu::pure]]
+	std::size_t GetMemoryUsage() const noexcept;
+
 	[[gnu::pure]]
 	bool IsFile() const noexcept {
 		return !IsRemote();
@@ -11,6 +11,7 @@
 #include "AddedSinceSongFilter.hxx"
 #include "AudioFormatSongFilter.hxx"
 #include "PrioritySongFilter.hxx"
+#include "StickerSongFilter.hxx"
 #include "pcm/AudioParser.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Type.hxx"
@@ -43,6 +44,7 @@ enum {
 	LOCATE_TAG_FILE_TYPE,
 	LOCATE_TAG_ANY_TYPE,
 	LOCATE_TAG_ADDED_SINCE,
+	LOCATE_TAG_STICKER,
 };
 
 /**
@@ -74,6 +76,9 @@ locate_parse_type(const char *str) noexcept
 	if (StringEqualsCaseASCII(str, "prio"))
 		return LOCATE_TAG_PRIORITY;
 
+	if (strcmp(str, "sticker") == 0)
+		return LOCATE_TAG_STICKER;
+
 	return tag_name_parse_i(str);
 }
 
@@ -425,6 +430,34 @@ SongFilter::ParseExpression(const char *&s, bool fold_case, bool strip_diacritic
 		s = StripLeft(endptr + 1);
 
 		return std::make_unique<PrioritySongFilter>(value);
+	} else if (type == LOCATE_TAG_STICKER) {
+		auto name = ExpectQuoted(s);
+		if (name.empty())
+			throw std::runtime_error("Empty sticker name");
+
+		const char *end = s;
+		if (IsTagNameChar(*s))
+			end = FirstNonTagNameChar(s);
+		else
+			while (*end == '=' || *end == '<' || *end == '>')
+				++end;
+
+		StickerOperator op;
+		if (!ParseStickerOperator({s, end}, op))
+			throw std::runtime_error("Unknown sticker operator");
+
+		s = StripLeft(end);
+
+		std::string value;
+		if (op != StickerOperator::EXISTS)
+			value = ExpectQuoted(s);
+
+		if (*s != ')')
+			throw std::runtime_error("')' expected");
+		s = StripLeft(s + 1);
+
+		return std::make_unique<StickerSongFilter>(std::move(name), op,
+							   std::move(value));
 	} else {
 		auto string_filter = ParseStringFilter(s, fold_case, strip_diacritics);
 		if (*s != ')')
@@ -452,6 +485,9 @@ SongFilter::Parse(const char *tag_string, const char *value, bool fold_case, boo
 	case TAG_NUM_OF_ITEM_TYPES:
 		throw std::runtime_error("Unknown filter type");
 
+	case LOCATE_TAG_STICKER:
+		throw std::runtime_error("Sticker filters require the expression syntax");
+
 	case LOCATE_TAG_BASE_TYPE:
 		if (!uri_safe_local(value))
 			throw std::runtime_error("Bad URI");
@@ -557,6 +593,27 @@ SongFilter::HasFoldCase() const noexcept
 		});
 }
 
+static void
+CollectStickerFilters(ISongFilter &f,
+		      std::vector<StickerSongFilter *> &result) noexcept
+{
+	if (auto *sf = dynamic_cast<StickerSongFilter *>(&f))
+		result.push_back(sf);
+	else if (auto *af = dynamic_cast<AndSongFilter *>(&f))
+		for (const auto &i : af->GetItems())
+			CollectStickerFilters(*i, result);
+	else if (auto *nf = dynamic_cast<NotSongFilter *>(&f))
+		CollectStickerFilters(nf->GetChild(), result);
+}
+
+std::vector<StickerSongFilter *>
+SongFilter::GetStickerFilters() noexcept
+{
+	std::vector<StickerSongFilter *> result;
+	CollectStickerFilters(and_filter, result);
+	return result;
+}
+
 const char *
 SongFilter::GetBase() const noexcept
 {
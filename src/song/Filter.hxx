@@ -10,6 +10,7 @@
 #include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 /**
  * Special value for the db_selection_print() sort parameter.
@@ -28,6 +29,7 @@
 
 enum TagType : uint8_t;
 struct LightSong;
+class StickerSongFilter;
 
 class SongFilter {
 	AndSongFilter and_filter;
@@ -79,6 +81,13 @@ public:
 	[[gnu::pure]]
 	bool HasFoldCase() const noexcept;
 
+	/**
+	 * Returns all sticker items (recursively).  Their URIs need
+	 * to be loaded from the sticker database before Match() is
+	 * called.
+	 */
+	std::vector<StickerSongFilter *> GetStickerFilters() noexcept;
+
 	/**
 	 * Returns the "base" specification (if there is one) or
 	 * nullptr.
@@ -25,6 +25,16 @@ public:
 
 	[[gnu::pure]]
 	virtual bool Match(const LightSong &song) const noexcept = 0;
+
+	/**
+	 * Returns a rough estimate of the cost of Match() relative to
+	 * a simple attribute comparison (1).  OptimizeSongFilter()
+	 * uses it to evaluate cheap filters first.
+	 */
+	[[gnu::pure]]
+	virtual unsigned GetCost() const noexcept {
+		return 1;
+	}
 };
 
 #endif
@@ -15,6 +15,10 @@ public:
 	explicit ModifiedSinceSongFilter(std::chrono::system_clock::time_point _value) noexcept
 		:value(_value) {}
 
+	std::chrono::system_clock::time_point GetValue() const noexcept {
+		return value;
+	}
+
 	ISongFilterPtr Clone() const noexcept override {
 		return std::make_unique<ModifiedSinceSongFilter>(*this);
 	}
@@ -19,6 +19,10 @@ public:
 	explicit NotSongFilter(C &&_child) noexcept
 		:child(std::forward<C>(_child)) {}
 
+	ISongFilter &GetChild() const noexcept {
+		return *child;
+	}
+
 	/* virtual methods from ISongFilter */
 	ISongFilterPtr Clone() const noexcept override {
 		return std::make_unique<NotSongFilter>(child->Clone());
@@ -31,6 +35,10 @@ public:
 	bool Match(const LightSong &song) const noexcept override {
 		return !child->Match(song);
 	}
+
+	unsigned GetCost() const noexcept override {
+		return child->GetCost();
+	}
 };
 
 #endif
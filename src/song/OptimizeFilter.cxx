@@ -21,6 +21,13 @@ OptimizeSongFilter(AndSongFilter &af) noexcept
 			++i;
 		}
 	}
+
+	/* evaluate cheap filters first, because the first mismatch
+	   ends the evaluation (std::list::sort() is stable, so equal
+	   costs keep the order given by the client) */
+	af.items.sort([](const auto &a, const auto &b){
+		return a->GetCost() < b->GetCost();
+	});
 }
 
 ISongFilterPtr
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "StickerSongFilter.hxx"
+#include "Escape.hxx"
+#include "LightSong.hxx"
+
+#include <array>
+#include <utility> // for std::pair
+
+using std::string_view_literals::operator""sv;
+
+static constexpr std::array sticker_operator_names{
+	std::pair{StickerOperator::EXISTS, "exists"sv},
+	std::pair{StickerOperator::EQUALS, "=="sv},
+	std::pair{StickerOperator::LESS_THAN, "<"sv},
+	std::pair{StickerOperator::GREATER_THAN, ">"sv},
+	std::pair{StickerOperator::EQUALS_INT, "eq"sv},
+	std::pair{StickerOperator::LESS_THAN_INT, "lt"sv},
+	std::pair{StickerOperator::GREATER_THAN_INT, "gt"sv},
+	std::pair{StickerOperator::CONTAINS, "contains"sv},
+	std::pair{StickerOperator::STARTS_WITH, "starts_with"sv},
+};
+
+bool
+ParseStickerOperator(std::string_view s, StickerOperator &op) noexcept
+{
+	for (const auto &[o, name] : sticker_operator_names) {
+		if (s == name) {
+			op = o;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+[[gnu::const]]
+static std::string_view
+GetStickerOperatorName(StickerOperator op) noexcept
+{
+	for (const auto &[o, name] : sticker_operator_names)
+		if (o == op)
+			return name;
+
+	return {};
+}
+
+std::string
+StickerSongFilter::ToExpression() const noexcept
+{
+	std::string result = "(sticker \"" + EscapeFilterString(name) + "\" ";
+	result += GetStickerOperatorName(op);
+	if (op != StickerOperator::EXISTS)
+		result += " \"" + EscapeFilterString(value) + "\"";
+	result += ')';
+	return result;
+}
+
+bool
+StickerSongFilter::Match(const LightSong &song) const noexcept
+{
+	return uris != nullptr && uris->contains(song.GetURI());
+}
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "ISongFilter.hxx"
+#include "sticker/Match.hxx"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+/**
+ * Matches songs which have a sticker with the given name (and a
+ * value matching the given operator).
+ *
+ * This library has no access to the sticker database: the caller
+ * needs to look up the matching songs with one SQL query and pass
+ * them to SetUris() before Match() is called.  Without that, no song
+ * matches.
+ */
+class StickerSongFilter final : public ISongFilter {
+	std::string name;
+
+	StickerOperator op;
+
+	/**
+	 * The operand; ignored for StickerOperator::EXISTS.
+	 */
+	std::string value;
+
+	/**
+	 * The URIs of all songs with a matching sticker.  Shared
+	 * between copies created by Clone().
+	 */
+	std::shared_ptr<const std::unordered_set<std::string>> uris;
+
+public:
+	StickerSongFilter(std::string &&_name, StickerOperator _op,
+			  std::string &&_value) noexcept
+		:name(std::move(_name)), op(_op), value(std::move(_value)) {}
+
+	const char *GetName() const noexcept {
+		return name.c_str();
+	}
+
+	StickerOperator GetOperator() const noexcept {
+		return op;
+	}
+
+	/**
+	 * @return the operand or nullptr for StickerOperator::EXISTS
+	 */
+	const char *GetValue() const noexcept {
+		return op == StickerOperator::EXISTS ? nullptr : value.c_str();
+	}
+
+	void SetUris(std::unordered_set<std::string> &&_uris) noexcept {
+		uris = std::make_shared<const std::unordered_set<std::string>>(std::move(_uris));
+	}
+
+	ISongFilterPtr Clone() const noexcept override {
+		return std::make_unique<StickerSongFilter>(*this);
+	}
+
+	std::string ToExpression() const noexcept override;
+	bool Match(const LightSong &song) const noexcept override;
+
+	unsigned GetCost() const noexcept override {
+		/* LightSong::GetURI() allocates a string */
+		return 4;
+	}
+};
+
+/**
+ * Parse the operator of a "sticker" filter expression.
+ *
+ * @return true on success
+ */
+bool
+ParseStickerOperator(std::string_view s, StickerOperator &op) noexcept;
@@ -12,8 +12,13 @@ StringFilter::MatchWithoutNegation(const char *s) const noexcept
 	assert(s != nullptr);
 
 #ifdef HAVE_PCRE
-	if (regex)
-		return regex->Match(s);
+	if (regex) {
+		if (!regex_literal.empty() &&
+		    StringFind(s, regex_literal.c_str()) == nullptr)
+			return false;
+
+		return regex->Test(s);
+	}
 #endif
 
 	if (icu_compare) {
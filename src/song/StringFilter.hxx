@@ -9,6 +9,7 @@
 
 #ifdef HAVE_PCRE
 #include "lib/pcre/UniqueRegex.hxx"
+#include "lib/pcre/RequiredLiteral.hxx"
 #endif
 
 #include <cstdint>
@@ -38,6 +39,14 @@ private:
 
 #ifdef HAVE_PCRE
 	std::shared_ptr<UniqueRegex> regex;
+
+	/**
+	 * A literal which every match of #regex contains (see
+	 * Pcre::FindRequiredLiteral()); subjects without it are
+	 * rejected without running the regex.  Empty if there is
+	 * none.
+	 */
+	std::string regex_literal;
 #endif
 
 	Position position;
@@ -67,9 +76,16 @@ public:
 	}
 
 #ifdef HAVE_PCRE
+	/**
+	 * @param _regex the compiled #value
+	 */
 	template<typename R>
 	void SetRegex(R &&_regex) noexcept {
 		regex = std::forward<R>(_regex);
+
+		/* the literal search is case-sensitive */
+		if (!GetFoldCase())
+			regex_literal = Pcre::FindRequiredLiteral(value);
 	}
 #endif
 
@@ -81,6 +97,26 @@ public:
 		return icu_compare.GetFoldCase();
 	}
 
+	/**
+	 * Returns the #IcuCompare object; it evaluates to false if
+	 * neither case folding nor diacritics stripping is enabled.
+	 */
+	const IcuCompare &GetIcuCompare() const noexcept {
+		return icu_compare;
+	}
+
+	Position GetPosition() const noexcept {
+		return position;
+	}
+
+	/**
+	 * Does this filter compare the raw bytes, i.e. without regular
+	 * expression, case folding or diacritics stripping?
+	 */
+	bool IsBinary() const noexcept {
+		return !icu_compare && !IsRegex();
+	}
+
 	bool IsNegated() const noexcept {
 		return negated;
 	}
@@ -107,6 +143,21 @@ public:
 		return negated ? "!=" : "==";
 	}
 
+	/**
+	 * Returns a rough estimate of the cost of Match(), see
+	 * ISongFilter::GetCost().
+	 */
+	[[gnu::pure]]
+	unsigned GetCost() const noexcept {
+		if (IsRegex())
+			return 32;
+
+		if (icu_compare)
+			return 8;
+
+		return position == Position::FULL ? 2 : 3;
+	}
+
 	[[gnu::pure]]
 	bool Match(const char *s) const noexcept;
 
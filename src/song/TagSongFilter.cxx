@@ -19,53 +19,82 @@ TagSongFilter::ToExpression() const noexcept
 		+ " \"" + EscapeFilterString(filter.GetValue()) + "\")";
 }
 
+enum class TypeMatch {
+	ABSENT,
+	MISMATCH,
+	MATCH,
+};
+
+/**
+ * Compare the values of all items of the given type.  This scans
+ * only the type table of the #Tag and dereferences only items of the
+ * given type.
+ */
+[[gnu::pure]]
+static TypeMatch
+MatchType(const Tag &tag, TagType type, const StringFilter &filter) noexcept
+{
+	TypeMatch result = TypeMatch::ABSENT;
+
+	const uint8_t *const types = tag.GetTypes();
+	for (std::size_t i = 0; i < tag.num_items; ++i) {
+		if (types[i] != type)
+			continue;
+
+		if (filter.MatchWithoutNegation(tag_pool_item_at(tag.items[i]).value))
+			return TypeMatch::MATCH;
+
+		result = TypeMatch::MISMATCH;
+	}
+
+	return result;
+}
+
 bool
 TagSongFilter::Match(const Tag &tag) const noexcept
 {
-	bool visited_types[TAG_NUM_OF_ITEM_TYPES]{};
-
-	for (const auto &i : tag) {
-		visited_types[i.type] = true;
+	if (type == TAG_NUM_OF_ITEM_TYPES) {
+		for (const auto &i : tag)
+			if (filter.MatchWithoutNegation(i.value))
+				return !filter.IsNegated();
 
-		if ((type == TAG_NUM_OF_ITEM_TYPES || i.type == type) &&
-		    filter.MatchWithoutNegation(i.value))
-			return !filter.IsNegated();
+		return filter.IsNegated();
 	}
 
-	if (type < TAG_NUM_OF_ITEM_TYPES && !visited_types[type]) {
-		/* if the specified tag is not present, try the
-		   fallback tags */
-
-		bool result = false;
-		if (ApplyTagFallback(type, [&](TagType tag2) {
-			if (!visited_types[tag2])
-				/* we already know that this tag type
-				   isn't present, so let's bail out
-				   without checking again */
-				return false;
-
-			for (const auto &item : tag) {
-				if (item.type == tag2 &&
-				    filter.MatchWithoutNegation(item.value)) {
-					result = true;
-					break;
-				}
-			}
-
-			return true;
-		}))
-			return result != filter.IsNegated();
-
-		/* If the search critieron was not visited during the
-		   sweep through the song's tag, it means this field
-		   is absent from the tag or empty. Thus, if the
-		   searched string is also empty
-		   then it's a match as well and we should return
-		   true. */
-		if (filter.empty())
-			return !filter.IsNegated();
+	switch (MatchType(tag, type, filter)) {
+	case TypeMatch::MATCH:
+		return !filter.IsNegated();
+
+	case TypeMatch::MISMATCH:
+		return filter.IsNegated();
+
+	case TypeMatch::ABSENT:
+		break;
 	}
 
+	/* if the specified tag is not present, try the fallback
+	   tags */
+
+	bool result = false;
+	if (ApplyTagFallback(type, [&](TagType tag2) {
+		const auto m = MatchType(tag, tag2, filter);
+		if (m == TypeMatch::ABSENT)
+			/* try the next fallback */
+			return false;
+
+		result = m == TypeMatch::MATCH;
+		return true;
+	}))
+		return result != filter.IsNegated();
+
+	/* If the search critieron was not visited during the sweep
+	   through the song's tag, it means this field is absent from
+	   the tag or empty. Thus, if the searched string is also
+	   empty then it's a match as well and we should return
+	   true. */
+	if (filter.empty())
+		return !filter.IsNegated();
+
 	return filter.IsNegated();
 }
 
@@ -6,10 +6,10 @@
 
 #include "ISongFilter.hxx"
 #include "StringFilter.hxx"
+#include "tag/Type.hxx"
 
 #include <cstdint>
 
-enum TagType : uint8_t;
 struct Tag;
 struct LightSong;
 
@@ -30,6 +30,10 @@ public:
 		return filter.GetValue();
 	}
 
+	const StringFilter &GetFilter() const noexcept {
+		return filter;
+	}
+
 	bool GetFoldCase() const {
 		return filter.GetFoldCase();
 	}
@@ -49,6 +53,11 @@ public:
 	std::string ToExpression() const noexcept override;
 	bool Match(const LightSong &song) const noexcept override;
 
+	unsigned GetCost() const noexcept override {
+		/* "any" compares all items, not just one type */
+		return filter.GetCost() * (type == TAG_NUM_OF_ITEM_TYPES ? 8 : 1);
+	}
+
 private:
 	bool Match(const Tag &tag) const noexcept;
 };
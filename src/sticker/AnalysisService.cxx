@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "AnalysisService.hxx"
+#include "Database.hxx"
+#include "Sticker.hxx"
+#include "decoder/Analyze.hxx"
+#include "decoder/SongAnalysis.hxx"
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "song/LightSong.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/UriExtract.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+#include "Instance.hxx"
+
+#include <fmt/format.h>
+
+#include <cstdlib>
+#include <list>
+#include <string>
+
+using std::string_view_literals::operator""sv;
+
+static constexpr Domain analysis_domain{"analysis"};
+
+static constexpr const char *STICKER_MIXRAMP_START = "mixramp_start";
+static constexpr const char *STICKER_MIXRAMP_END = "mixramp_end";
+static constexpr const char *STICKER_TRACK_GAIN = "replaygain_track_gain";
+static constexpr const char *STICKER_TRACK_PEAK = "replaygain_track_peak";
+
+/**
+ * The modification time (UNIX time stamp) of the file the other
+ * values were calculated from.
+ */
+static constexpr const char *STICKER_ANALYSIS_MTIME = "analysis_mtime";
+
+static constexpr bool
+IsMTimeKnown(std::chrono::system_clock::time_point mtime) noexcept
+{
+	return mtime != std::chrono::system_clock::time_point::min();
+}
+
+static std::string
+FormatMTime(std::chrono::system_clock::time_point mtime) noexcept
+{
+	return fmt::format("{}"sv, std::chrono::system_clock::to_time_t(mtime));
+}
+
+SongAnalysisService::SongAnalysisService(Instance &_instance,
+					 StickerDatabase &_sticker_db,
+					 const Database &_db,
+					 Storage &_storage,
+					 SongAnalysisStore &_store)
+	:instance(_instance),
+	 sticker_db(_sticker_db.Reopen()),
+	 music_db(_db), storage(_storage), store(_store),
+	 defer(_instance.event_loop, BIND_THIS_METHOD(RunDeferred))
+{
+}
+
+SongAnalysisService::~SongAnalysisService() noexcept
+{
+	// call only by the owning instance
+	assert(GetEventLoop().IsInside());
+
+	CancelAndJoin();
+}
+
+void
+SongAnalysisService::Start()
+{
+	// call only by the owning instance
+	assert(GetEventLoop().IsInside());
+
+	thread.Start();
+
+	FmtDebug(analysis_domain,
+		 "spawned thread for analysis job");
+}
+
+void
+SongAnalysisService::RunDeferred() noexcept
+{
+	instance.OnSongAnalysisDone();
+}
+
+[[gnu::pure]]
+static const char *
+FindValue(const Sticker &sticker, const char *name) noexcept
+{
+	const auto i = sticker.table.find(name);
+	return i != sticker.table.end() ? i->second.c_str() : nullptr;
+}
+
+bool
+SongAnalysisService::LoadSticker(const char *uri,
+				 std::chrono::system_clock::time_point mtime)
+{
+	const Sticker sticker = sticker_db.Load("song", uri);
+
+	const char *gain = FindValue(sticker, STICKER_TRACK_GAIN);
+	const char *peak = FindValue(sticker, STICKER_TRACK_PEAK);
+	if (gain == nullptr || peak == nullptr)
+		return false;
+
+	if (IsMTimeKnown(mtime)) {
+		/* the file has been replaced or modified since it
+		   was analyzed (or it was analyzed by an older MPD
+		   version which didn't record the time stamp) */
+		const char *analysis_mtime = FindValue(sticker, STICKER_ANALYSIS_MTIME);
+		if (analysis_mtime == nullptr || FormatMTime(mtime) != analysis_mtime)
+			return false;
+	}
+
+	SongAnalysis analysis;
+	analysis.mix_ramp.SetStart(FindValue(sticker, STICKER_MIXRAMP_START));
+	analysis.mix_ramp.SetEnd(FindValue(sticker, STICKER_MIXRAMP_END));
+	analysis.track.gain = std::strtof(gain, nullptr);
+	analysis.track.peak = std::strtof(peak, nullptr);
+	store.Put(uri, mtime, std::move(analysis));
+	return true;
+}
+
+void
+SongAnalysisService::AnalyzeSong(const char *uri,
+				 std::chrono::system_clock::time_point mtime)
+{
+	const auto path_fs = storage.MapFS(uri);
+	if (path_fs.IsNull()) {
+		/* not a local file; don't try again */
+		store.Put(uri, mtime, {});
+		return;
+	}
+
+	std::optional<SongAnalysis> analysis;
+	try {
+		analysis = AnalyzeSongFile(path_fs, uri_get_suffix(uri),
+					  cancel_flag);
+	} catch (...) {
+		FmtDebug(analysis_domain, "Failed to analyze {:?}: {}",
+			 uri, std::current_exception());
+	}
+
+	if (cancel_flag)
+		return;
+
+	if (!analysis) {
+		store.Put(uri, mtime, {});
+		return;
+	}
+
+	/* remove values calculated from an older version of this
+	   file which may not be overwritten below */
+	sticker_db.DeleteValue("song", uri, STICKER_MIXRAMP_START);
+	sticker_db.DeleteValue("song", uri, STICKER_MIXRAMP_END);
+
+	if (const char *s = analysis->mix_ramp.GetStart())
+		sticker_db.StoreValue("song", uri, STICKER_MIXRAMP_START, s);
+	if (const char *s = analysis->mix_ramp.GetEnd())
+		sticker_db.StoreValue("song", uri, STICKER_MIXRAMP_END, s);
+	sticker_db.StoreValue("song", uri, STICKER_TRACK_GAIN,
+			      fmt::format("{:.2f}", analysis->track.gain).c_str());
+	sticker_db.StoreValue("song", uri, STICKER_TRACK_PEAK,
+			      fmt::format("{:.6f}", analysis->track.peak).c_str());
+	if (IsMTimeKnown(mtime))
+		sticker_db.StoreValue("song", uri, STICKER_ANALYSIS_MTIME,
+				      FormatMTime(mtime).c_str());
+
+	FmtDebug(analysis_domain, "Analyzed {:?}: gain={:.2f} peak={:.6f}",
+		 uri, analysis->track.gain, analysis->track.peak);
+
+	store.Put(uri, mtime, std::move(*analysis));
+	++analyzed_count;
+}
+
+void
+SongAnalysisService::Task() noexcept
+{
+	SetThreadName("analysis");
+	SetThreadIdlePriority();
+
+	FmtDebug(analysis_domain, "begin analysis");
+
+	try {
+		std::list<std::pair<std::string, std::chrono::system_clock::time_point>> songs;
+		music_db.Visit(DatabaseSelection{""sv, true},
+			       [this, &songs](const LightSong &song){
+				       /* skip CUE tracks; they are
+					  only a part of a file */
+				       if (song.start_time.IsPositive() ||
+					   song.end_time.IsPositive())
+					       return;
+
+				       auto uri = song.GetURI();
+				       if (!store.Contains(uri, song.mtime))
+					       songs.emplace_back(std::move(uri),
+								  song.mtime);
+			       });
+
+		for (const auto &[uri, mtime] : songs) {
+			if (cancel_flag)
+				break;
+
+			if (!LoadSticker(uri.c_str(), mtime))
+				AnalyzeSong(uri.c_str(), mtime);
+		}
+	} catch (...) {
+		FmtError(analysis_domain, "analysis failed: {}",
+			 std::current_exception());
+	}
+
+	defer.Schedule();
+
+	FmtDebug(analysis_domain, "end analysis: {} songs analyzed",
+		 analyzed_count);
+}
+
+void
+SongAnalysisService::CancelAndJoin() noexcept
+{
+	if (thread.IsDefined()) {
+		cancel_flag = true;
+		thread.Join();
+	}
+}
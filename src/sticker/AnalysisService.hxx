@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "Database.hxx"
+#include "event/InjectEvent.hxx"
+#include "thread/Thread.hxx"
+
+#include <atomic>
+#include <chrono>
+
+class Database;
+class Storage;
+class SongAnalysisStore;
+struct Instance;
+
+/**
+ * Decode all songs of the music database in a low-priority thread
+ * and calculate MixRamp and ReplayGain values for them.  The results
+ * are stored as song stickers (so they survive a restart) and in the
+ * #SongAnalysisStore which is consulted by the decoder thread.
+ *
+ * When done calls Instance::OnSongAnalysisDone() in the instance
+ * event loop.
+ */
+class SongAnalysisService {
+	Instance &instance;
+	StickerDatabase sticker_db;
+	const Database &music_db;
+	Storage &storage;
+	SongAnalysisStore &store;
+	Thread thread{BIND_THIS_METHOD(Task)};
+	InjectEvent defer;
+	std::size_t analyzed_count{0};
+	std::atomic_bool cancel_flag{false};
+
+public:
+	SongAnalysisService(Instance &_instance,
+			    StickerDatabase &_sticker_db,
+			    const Database &_db, Storage &_storage,
+			    SongAnalysisStore &_store);
+
+	~SongAnalysisService() noexcept;
+
+	auto &GetEventLoop() const noexcept {
+		return defer.GetEventLoop();
+	}
+
+	void Start();
+
+private:
+	void Task() noexcept;
+
+	void RunDeferred() noexcept;
+
+	void CancelAndJoin() noexcept;
+
+	/**
+	 * Load the song's values from the sticker database into the
+	 * #SongAnalysisStore.
+	 *
+	 * @param mtime the modification time of the song in the music
+	 * database
+	 * @return true if this version of the song has been analyzed
+	 * already
+	 */
+	bool LoadSticker(const char *uri,
+			 std::chrono::system_clock::time_point mtime);
+
+	void AnalyzeSong(const char *uri,
+			 std::chrono::system_clock::time_point mtime);
+};
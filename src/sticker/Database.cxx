@@ -11,6 +11,7 @@
 #include "util/ScopeExit.hxx"
 
 #include <fmt/format.h>
+#include <algorithm> // for std::min()
 #include <cassert>
 #include <exception> // for std::throw_with_nested()
 #include <iterator>
@@ -51,6 +52,7 @@ enum sticker_sql {
 	STICKER_SQL_NAMES_TYPES_BY_TYPE,
 	STICKER_SQL_INC,
 	STICKER_SQL_DEC,
+	STICKER_SQL_MOVE,
 
 	STICKER_SQL_COUNT
 };
@@ -128,6 +130,9 @@ static constexpr auto sticker_sql = std::array {
 	"INSERT INTO sticker (type, uri, name, value) VALUES (?, ?, ?, ?) "
 	"ON CONFLICT(type, uri, name) DO "
 	"UPDATE set value = value - ?",
+
+	//[STICKER_SQL_MOVE] =
+	"UPDATE OR REPLACE sticker SET uri=? WHERE type=? AND uri=?",
 };
 
 static constexpr const char sticker_sql_create[] =
@@ -141,12 +146,35 @@ static constexpr const char sticker_sql_create[] =
 	" sticker_value ON sticker(type, uri, name);"
 	"";
 
+/**
+ * With a write-ahead log, readers don't block the writer, and
+ * "synchronous=NORMAL" does not need a fsync() for each committed
+ * transaction; the database stays consistent, only the last
+ * transactions may be lost on power failure.
+ */
+static constexpr const char sticker_sql_pragmas[] =
+	"PRAGMA journal_mode=WAL;"
+	"PRAGMA synchronous=NORMAL;";
+
+/**
+ * The maximum number of URIs in one "uri IN (...)" query by
+ * StickerDatabase::LoadValues(); well below the smallest
+ * SQLITE_MAX_VARIABLE_NUMBER default (999).
+ */
+static constexpr std::size_t STICKER_MAX_URIS_PER_QUERY = 256;
+
 StickerDatabase::StickerDatabase(const char *_path)
 	:path(_path),
 	 db(path.c_str())
 {
 	int ret;
 
+	ret = sqlite3_exec(db, sticker_sql_pragmas,
+			   nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK)
+		throw SqliteError(db, ret,
+				  "Failed to configure sticker database");
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(db, sticker_sql_create,
@@ -251,6 +279,88 @@ StickerDatabase::StoreValue(const char *type, const char *uri,
 	idle_add(IDLE_STICKER);
 }
 
+void
+StickerDatabase::StoreValues(const char *type,
+			     std::span<const StoreItem> items)
+{
+	assert(type != nullptr);
+
+	if (items.empty())
+		return;
+
+	sqlite3_stmt *const s = stmt[STICKER_SQL_SET];
+
+	sqlite3_stmt *const begin = stmt[STICKER_SQL_TRANSACTION_BEGIN];
+	sqlite3_stmt *const rollback = stmt[STICKER_SQL_TRANSACTION_ROLLBACK];
+	sqlite3_stmt *const commit = stmt[STICKER_SQL_TRANSACTION_COMMIT];
+
+	try {
+		ExecuteBusy(begin);
+
+		for (const auto &i : items) {
+			assert(i.name != nullptr);
+			assert(*i.name != 0);
+			assert(i.value != nullptr);
+
+			AtScopeExit(s) {
+				sqlite3_reset(s);
+				sqlite3_clear_bindings(s);
+			};
+
+			BindAll(s, type, i.uri.c_str(), i.name,
+				i.value, i.value);
+
+			ExecuteCommand(s);
+		}
+
+		ExecuteBusy(commit);
+	} catch (...) {
+		ExecuteBusy(rollback);
+		std::throw_with_nested(std::runtime_error{"failed to store stickers"});
+	}
+
+	idle_add(IDLE_STICKER);
+}
+
+void
+StickerDatabase::LoadValues(const char *type, const char *name,
+			    std::span<const char *const> uris,
+			    void (*func)(const char *uri, const char *value,
+					 void *user_data),
+			    void *user_data)
+{
+	assert(type != nullptr);
+	assert(name != nullptr);
+	assert(func != nullptr);
+
+	while (!uris.empty()) {
+		const auto chunk = uris.first(std::min(uris.size(),
+						       STICKER_MAX_URIS_PER_QUERY));
+		uris = uris.subspan(chunk.size());
+
+		std::string sql_str = "SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri IN (?";
+		for (std::size_t i = 1; i < chunk.size(); ++i)
+			sql_str += ",?";
+		sql_str += ')';
+
+		sqlite3_stmt *const s = Prepare(db, sql_str.c_str());
+		AtScopeExit(s) {
+			sqlite3_finalize(s);
+		};
+
+		Bind(s, 1, type);
+		Bind(s, 2, name);
+		for (std::size_t i = 0; i < chunk.size(); ++i)
+			Bind(s, i + 3, chunk[i]);
+
+		ExecuteForEach(s, [s, func, user_data](){
+				func((const char*)sqlite3_column_text(s, 0),
+				     (const char*)sqlite3_column_text(s, 1),
+				     user_data);
+			});
+	}
+}
+
 void
 StickerDatabase::IncValue(const char *type, const char *uri,
 			  const char *name, const char *value)
@@ -318,6 +428,44 @@ StickerDatabase::Delete(const char *type, const char *uri)
 	return modified;
 }
 
+void
+StickerDatabase::Move(const char *type,
+		      std::span<const std::pair<std::string, std::string>> moved)
+{
+	sqlite3_stmt *const s = stmt[STICKER_SQL_MOVE];
+
+	sqlite3_stmt *const begin = stmt[STICKER_SQL_TRANSACTION_BEGIN];
+	sqlite3_stmt *const rollback = stmt[STICKER_SQL_TRANSACTION_ROLLBACK];
+	sqlite3_stmt *const commit = stmt[STICKER_SQL_TRANSACTION_COMMIT];
+
+	assert(type != nullptr);
+
+	bool modified = false;
+
+	try {
+		ExecuteBusy(begin);
+
+		for (const auto &[from, to] : moved) {
+			AtScopeExit(s) {
+				sqlite3_reset(s);
+				sqlite3_clear_bindings(s);
+			};
+
+			BindAll(s, to.c_str(), type, from.c_str());
+
+			modified |= ExecuteModified(s);
+		}
+
+		ExecuteBusy(commit);
+	} catch (...) {
+		ExecuteBusy(rollback);
+		std::throw_with_nested(std::runtime_error{"failed to move stickers"});
+	}
+
+	if (modified)
+		idle_add(IDLE_STICKER);
+}
+
 bool
 StickerDatabase::DeleteValue(const char *type, const char *uri,
 			     const char *name)
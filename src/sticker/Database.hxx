@@ -33,6 +33,7 @@
 #include <sqlite3.h>
 
 #include <map>
+#include <span>
 #include <string>
 #include <list>
 
@@ -102,6 +103,15 @@ public:
 		return StickerDatabase{path.c_str()};
 	}
 
+	/**
+	 * Returns the memory allocated by SQLite for all connections
+	 * (mostly their page caches).
+	 */
+	[[gnu::pure]]
+	static std::size_t GetMemoryUsage() noexcept {
+		return sqlite3_memory_used();
+	}
+
 	/**
 	 * Returns one value from an object's sticker record.  Returns an
 	 * empty string if the value doesn't exist.
@@ -119,7 +129,35 @@ public:
 	 */
 	void StoreValue(const char *type, const char *uri,
 			const char *name, const char *value);
-	
+
+	struct StoreItem {
+		std::string uri;
+		const char *name;
+		const char *value;
+	};
+
+	/**
+	 * Like StoreValue(), but sets many values in one transaction:
+	 * either all of them are stored or none.
+	 *
+	 * Throws on error.
+	 */
+	void StoreValues(const char *type, std::span<const StoreItem> items);
+
+	/**
+	 * Look up the value of one sticker for many objects with as
+	 * few SQL queries as possible.  Objects which do not have
+	 * this sticker are omitted.  The order of the results is
+	 * unspecified.
+	 *
+	 * Throws #SqliteError on error.
+	 */
+	void LoadValues(const char *type, const char *name,
+			std::span<const char *const> uris,
+			void (*func)(const char *uri, const char *value,
+				     void *user_data),
+			void *user_data);
+
 	/**
 	 * Increments a sticker by value in the specified object.  Inserts
 	 * the value if object does not exist.
@@ -146,6 +184,17 @@ public:
 	 */
 	bool Delete(const char *type, const char *uri);
 
+	/**
+	 * Changes the URI of stickers, all in one transaction.
+	 * Existing stickers at the new URIs are replaced.
+	 *
+	 * Throws on error.
+	 *
+	 * @param moved pairs of old and new URI
+	 */
+	void Move(const char *type,
+		  std::span<const std::pair<std::string, std::string>> moved);
+
 	/**
 	 * Deletes a sticker value.  Fails if no sticker with this name
 	 * exists.
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "FingerprintService.hxx"
+#include "Database.hxx"
+#include "lib/chromaprint/File.hxx"
+#include "db/Interface.hxx"
+#include "db/Selection.hxx"
+#include "song/LightSong.hxx"
+#include "storage/StorageInterface.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "lib/fmt/ExceptionFormatter.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/UriExtract.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+#include "Instance.hxx"
+
+#include <algorithm>
+#include <set>
+
+using std::string_view_literals::operator""sv;
+
+static constexpr Domain fingerprint_domain{"fingerprint"};
+
+static constexpr const char *STICKER_CHROMAPRINT = "chromaprint";
+
+/**
+ * The number of songs a worker picks up at a time.  Their existing
+ * fingerprints are looked up with one query.
+ */
+static constexpr std::size_t BATCH_SIZE = 64;
+
+SongFingerprintService::SongFingerprintService(Instance &_instance,
+					       const StickerDatabase &_sticker_db,
+					       const Database &_db,
+					       Storage &_storage,
+					       unsigned _n_threads) noexcept
+	:instance(_instance), sticker_db(_sticker_db),
+	 music_db(_db), storage(_storage),
+	 n_threads(std::max(_n_threads, 1U)),
+	 defer(_instance.event_loop, BIND_THIS_METHOD(RunDeferred))
+{
+}
+
+SongFingerprintService::~SongFingerprintService() noexcept
+{
+	// call only by the owning instance
+	assert(GetEventLoop().IsInside());
+
+	CancelAndJoin();
+}
+
+void
+SongFingerprintService::Start()
+{
+	// call only by the owning instance
+	assert(GetEventLoop().IsInside());
+
+	thread.Start();
+
+	FmtDebug(fingerprint_domain,
+		 "spawned thread for fingerprint job");
+}
+
+void
+SongFingerprintService::RunDeferred() noexcept
+{
+	instance.OnSongFingerprintDone();
+}
+
+void
+SongFingerprintService::FingerprintSong(StickerDatabase &db, const char *uri)
+{
+	const auto path_fs = storage.MapFS(uri);
+	if (path_fs.IsNull())
+		/* not a local file */
+		return;
+
+	std::string fingerprint;
+	try {
+		fingerprint = ChromaprintSongFile(path_fs, uri_get_suffix(uri),
+						  cancel_flag);
+	} catch (...) {
+		FmtDebug(fingerprint_domain, "Failed to fingerprint {:?}: {}",
+			 uri, std::current_exception());
+	}
+
+	if (cancel_flag || fingerprint.empty())
+		return;
+
+	db.StoreValue("song", uri, STICKER_CHROMAPRINT, fingerprint.c_str());
+	++fingerprinted_count;
+}
+
+void
+SongFingerprintService::FingerprintBatch(StickerDatabase &db,
+					 std::span<const std::string> batch)
+{
+	std::vector<const char *> batch_uris;
+	batch_uris.reserve(batch.size());
+	for (const auto &i : batch)
+		batch_uris.push_back(i.c_str());
+
+	std::set<std::string, std::less<>> done;
+	db.LoadValues("song", STICKER_CHROMAPRINT, batch_uris,
+		      [](const char *uri, const char *, void *user_data){
+			      auto &d = *(std::set<std::string, std::less<>> *)user_data;
+			      d.emplace(uri);
+		      }, &done);
+
+	for (const auto &uri : batch) {
+		if (cancel_flag)
+			break;
+
+		if (!done.contains(uri))
+			FingerprintSong(db, uri.c_str());
+	}
+}
+
+void
+SongFingerprintService::Work()
+{
+	/* each worker needs its own SQLite connection */
+	auto db = sticker_db.Reopen();
+
+	while (!cancel_flag) {
+		const std::size_t begin = next.fetch_add(BATCH_SIZE);
+		if (begin >= uris.size())
+			break;
+
+		const std::span<const std::string> batch{uris};
+		FingerprintBatch(db, batch.subspan(begin,
+						   std::min(BATCH_SIZE,
+							    uris.size() - begin)));
+	}
+}
+
+void
+SongFingerprintService::RunWorker() noexcept
+{
+	SetThreadName("fingerprint");
+	SetThreadIdlePriority();
+
+	try {
+		Work();
+	} catch (...) {
+		FmtError(fingerprint_domain, "fingerprint job failed: {}",
+			 std::current_exception());
+	}
+}
+
+void
+SongFingerprintService::Task() noexcept
+{
+	SetThreadName("fingerprint");
+	SetThreadIdlePriority();
+
+	FmtDebug(fingerprint_domain, "begin fingerprint job");
+
+	try {
+		music_db.Visit(DatabaseSelection{""sv, true},
+			       [this](const LightSong &song){
+				       /* skip CUE tracks; they are
+					  only a part of a file */
+				       if (song.start_time.IsPositive() ||
+					   song.end_time.IsPositive())
+					       return;
+
+				       uris.emplace_back(song.GetURI());
+			       });
+
+		for (unsigned i = 1; i < n_threads; ++i)
+			workers.emplace_front(BIND_THIS_METHOD(RunWorker)).Start();
+
+		Work();
+	} catch (...) {
+		FmtError(fingerprint_domain, "fingerprint job failed: {}",
+			 std::current_exception());
+		cancel_flag = true;
+	}
+
+	for (auto &i : workers)
+		if (i.IsDefined())
+			i.Join();
+
+	defer.Schedule();
+
+	FmtDebug(fingerprint_domain, "end fingerprint job: {} songs fingerprinted",
+		 fingerprinted_count.load());
+}
+
+void
+SongFingerprintService::CancelAndJoin() noexcept
+{
+	if (thread.IsDefined()) {
+		cancel_flag = true;
+		thread.Join();
+	}
+}
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include "event/InjectEvent.hxx"
+#include "thread/Thread.hxx"
+
+#include <atomic>
+#include <forward_list>
+#include <span>
+#include <string>
+#include <vector>
+
+class Database;
+class Storage;
+class StickerDatabase;
+struct Instance;
+
+/**
+ * Calculate the Chromaprint fingerprints of all songs of the music
+ * database on a pool of low-priority threads.  Only the first two
+ * minutes of each song are decoded, at a reduced sample rate.  The
+ * results are stored as song stickers named "chromaprint"; songs
+ * which already have one are skipped, so an interrupted job
+ * continues where it stopped after a restart.
+ *
+ * When done calls Instance::OnSongFingerprintDone() in the instance
+ * event loop.
+ */
+class SongFingerprintService {
+	Instance &instance;
+	const StickerDatabase &sticker_db;
+	const Database &music_db;
+	Storage &storage;
+
+	const unsigned n_threads;
+
+	/**
+	 * This thread collects the song list and then works as one
+	 * of the #n_threads workers.
+	 */
+	Thread thread{BIND_THIS_METHOD(Task)};
+
+	/**
+	 * The other workers; only accessed by #thread.
+	 */
+	std::forward_list<Thread> workers;
+
+	InjectEvent defer;
+
+	/**
+	 * All songs of the music database.  Filled by #thread before
+	 * the workers are started, and not modified afterwards.
+	 */
+	std::vector<std::string> uris;
+
+	/**
+	 * The index of the next batch in #uris to be picked up by a
+	 * worker.
+	 */
+	std::atomic_size_t next{0};
+
+	std::atomic_size_t fingerprinted_count{0};
+	std::atomic_bool cancel_flag{false};
+
+public:
+	SongFingerprintService(Instance &_instance,
+			       const StickerDatabase &_sticker_db,
+			       const Database &_db, Storage &_storage,
+			       unsigned _n_threads) noexcept;
+
+	~SongFingerprintService() noexcept;
+
+	auto &GetEventLoop() const noexcept {
+		return defer.GetEventLoop();
+	}
+
+	void Start();
+
+private:
+	void Task() noexcept;
+	void RunWorker() noexcept;
+	void Work();
+
+	void RunDeferred() noexcept;
+
+	void CancelAndJoin() noexcept;
+
+	/**
+	 * Fingerprint all songs in the given batch which don't
+	 * have a fingerprint sticker yet.
+	 */
+	void FingerprintBatch(StickerDatabase &db,
+			      std::span<const std::string> batch);
+
+	void FingerprintSong(StickerDatabase &db, const char *uri);
+};
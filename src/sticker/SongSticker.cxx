@@ -5,9 +5,13 @@
 #include "Sticker.hxx"
 #include "Database.hxx"
 #include "song/LightSong.hxx"
+#include "song/Filter.hxx"
+#include "song/StickerSongFilter.hxx"
 #include "db/Interface.hxx"
 #include "util/AllocatedString.hxx"
 
+#include <unordered_set>
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -60,6 +64,13 @@ sticker_song_delete(StickerDatabase &db, const LightSong &song)
 	return sticker_song_delete(db, song.GetURI().c_str());
 }
 
+void
+sticker_song_move(StickerDatabase &db,
+		  std::span<const std::pair<std::string, std::string>> moved)
+{
+	db.Move("song", moved);
+}
+
 bool
 sticker_song_delete_value(StickerDatabase &db,
 			  const LightSong &song, const char *name)
@@ -136,3 +147,23 @@ sticker_song_find(StickerDatabase &sticker_database, const Database &db,
 				  sort, descending, window,
 			      sticker_song_find_cb, &data);
 }
+
+void
+sticker_song_load_filter(StickerDatabase &sticker_database,
+			 SongFilter &filter)
+{
+	for (auto *f : filter.GetStickerFilters()) {
+		std::unordered_set<std::string> uris;
+
+		sticker_database.Find("song", "", f->GetName(),
+				      f->GetOperator(), f->GetValue(),
+				      "", false, RangeArg::All(),
+				      [](const char *uri, const char *,
+					 void *user_data){
+					      auto &u = *(std::unordered_set<std::string> *)user_data;
+					      u.emplace(uri);
+				      }, &uris);
+
+		f->SetUris(std::move(uris));
+	}
+}
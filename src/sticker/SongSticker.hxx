@@ -7,10 +7,13 @@
 #include "Match.hxx"
 #include "protocol/RangeArg.hxx"
 
+#include <span>
 #include <string>
+#include <utility>
 
 struct LightSong;
 struct Sticker;
+class SongFilter;
 class Database;
 class StickerDatabase;
 
@@ -67,6 +70,17 @@ sticker_song_delete(StickerDatabase &db, const char *uri);
 bool
 sticker_song_delete(StickerDatabase &db, const LightSong &song);
 
+/**
+ * Relinks the stickers of moved songs to their new URIs.
+ *
+ * Throws on error.
+ *
+ * @param moved pairs of old and new URI
+ */
+void
+sticker_song_move(StickerDatabase &db,
+		  std::span<const std::pair<std::string, std::string>> moved);
+
 /**
  * Deletes a sticker value.  Does nothing if the sticker did not
  * exist.
@@ -108,4 +122,14 @@ sticker_song_find(StickerDatabase &sticker_database, const Database &db,
 			       void *user_data),
 		  void *user_data);
 
+/**
+ * Look up the songs matching the sticker items of the filter (see
+ * SongFilter::GetStickerFilters()), with one SQL query per item.
+ *
+ * Throws #SqliteError on error.
+ */
+void
+sticker_song_load_filter(StickerDatabase &sticker_database,
+			 SongFilter &filter);
+
 #endif
@@ -7,6 +7,7 @@
 #include <chrono>
 
 #include <cstdint>
+#include <initializer_list>
 
 struct StorageFileInfo {
 	enum class Type : uint8_t {
@@ -49,6 +50,22 @@ struct StorageFileInfo {
 	constexpr bool IsDirectory() const {
 		return type == Type::DIRECTORY;
 	}
+
+	/**
+	 * Returns a number which identifies this file, derived from
+	 * its device id, inode number and size.  It survives renames
+	 * and moves within the same file system.  0 means unknown.
+	 */
+	constexpr uint64_t GetFileId() const noexcept {
+		if (inode == 0)
+			return 0;
+
+		uint64_t id = 0;
+		for (const uint64_t i : {device, inode, size})
+			id = (id ^ i) * 0x100000001b3ULL + (id >> 29);
+
+		return id != 0 ? id : 1;
+	}
 };
 
 #endif
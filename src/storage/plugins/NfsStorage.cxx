@@ -63,7 +63,13 @@ class NfsStorage final
 
 	Mutex mutex;
 	Cond cond;
-	State state = State::CONNECTING;
+
+	/**
+	 * The connection is established on the first access (see
+	 * WaitConnected()), so restoring many mounts (or mounts of
+	 * unreachable servers) at startup costs nothing.
+	 */
+	State state = State::INITIAL;
 	std::exception_ptr last_exception;
 
 public:
@@ -74,9 +80,6 @@ public:
 		 defer_connect(_connection.GetEventLoop(), BIND_THIS_METHOD(OnDeferredConnect)),
 		 reconnect_timer(_connection.GetEventLoop(), BIND_THIS_METHOD(OnReconnectTimer))
 	{
-		BlockingCall(GetEventLoop(), [this](){
-			connection->AddLease(*this);
-		});
 	}
 
 	~NfsStorage() override {
@@ -7,9 +7,8 @@
 #include "storage/FileInfo.hxx"
 #include "input/InputStream.hxx"
 #include "lib/smbclient/Init.hxx"
-#include "lib/smbclient/Context.hxx"
+#include "lib/smbclient/Pool.hxx"
 #include "fs/Traits.hxx"
-#include "thread/Mutex.hxx"
 #include "system/Error.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringCompare.hxx"
@@ -17,20 +16,25 @@
 
 #include <libsmbclient.h>
 
-class SmbclientStorage;
-
 class SmbclientDirectoryReader final : public StorageDirectoryReader {
-	SmbclientStorage &storage;
 	const std::string base;
+
+	/**
+	 * The context which owns the #handle; it is reserved for
+	 * this object until it gets destroyed.
+	 */
+	SmbclientContextPool::Lease ctx;
+
 	SMBCFILE *const handle;
 
 	const char *name;
 
 public:
-	SmbclientDirectoryReader(SmbclientStorage &_storage,
-				 std::string &&_base,
+	SmbclientDirectoryReader(std::string &&_base,
+				 SmbclientContextPool::Lease &&_ctx,
 				 SMBCFILE *_handle) noexcept
-		:storage(_storage), base(std::move(_base)), handle(_handle) {}
+		:base(std::move(_base)), ctx(std::move(_ctx)),
+		 handle(_handle) {}
 
 	~SmbclientDirectoryReader() override;
 
@@ -40,21 +44,25 @@ public:
 };
 
 class SmbclientStorage final : public Storage {
-	friend class SmbclientDirectoryReader;
-
 	const std::string base;
 
 	/**
-	 * This mutex protects all calls into the #SmbclientContext,
-	 * which is not thread-safe.
+	 * The #SmbclientContext is not thread-safe; this pool gives
+	 * each caller its own one, so the update threads don't
+	 * serialize on one lock.
 	 */
-	Mutex mutex;
-
-	SmbclientContext ctx = SmbclientContext::New();
+	SmbclientContextPool pool;
 
 public:
-	explicit SmbclientStorage(std::string_view _base) noexcept
-		:base(_base) {}
+	/**
+	 * Throws on error.
+	 */
+	explicit SmbclientStorage(std::string_view _base)
+		:base(_base) {
+		/* create the first context right now to report
+		   errors early; it stays in the pool */
+		pool.Get();
+	}
 
 	/* virtual methods from class Storage */
 	StorageFileInfo GetInfo(std::string_view uri_utf8, bool follow) override;
@@ -84,15 +92,11 @@ SmbclientStorage::MapToRelativeUTF8(std::string_view uri_utf8) const noexcept
 }
 
 static StorageFileInfo
-GetInfo(SmbclientContext &ctx, Mutex &mutex, const char *path)
+GetInfo(SmbclientContext &ctx, const char *path)
 {
 	struct stat st;
-
-	{
-		const std::lock_guard protect{mutex};
-		if (ctx.Stat(path, st) != 0)
-			throw MakeErrno("Failed to access file");
-	}
+	if (ctx.Stat(path, st) != 0)
+		throw MakeErrno("Failed to access file");
 
 	StorageFileInfo info;
 	if (S_ISREG(st.st_mode))
@@ -113,7 +117,7 @@ StorageFileInfo
 SmbclientStorage::GetInfo(std::string_view uri_utf8, [[maybe_unused]] bool follow)
 {
 	const std::string mapped = MapUTF8(uri_utf8);
-	return ::GetInfo(ctx, mutex, mapped.c_str());
+	return ::GetInfo(*pool.Get(), mapped.c_str());
 }
 
 InputStreamPtr
@@ -127,18 +131,13 @@ SmbclientStorage::OpenDirectory(std::string_view uri_utf8)
 {
 	std::string mapped = MapUTF8(uri_utf8);
 
-	SMBCFILE *handle;
-
-	{
-		const std::lock_guard protect{mutex};
-		handle = ctx.OpenDirectory(mapped.c_str());
-	}
-
+	auto ctx = pool.Get();
+	SMBCFILE *handle = ctx->OpenDirectory(mapped.c_str());
 	if (handle == nullptr)
 		throw MakeErrno("Failed to open directory");
 
-	return std::make_unique<SmbclientDirectoryReader>(*this,
-							  std::move(mapped),
+	return std::make_unique<SmbclientDirectoryReader>(std::move(mapped),
+							  std::move(ctx),
 							  handle);
 }
 
@@ -151,16 +150,13 @@ SkipNameFS(PathTraitsFS::const_pointer name) noexcept
 
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
 {
-	const std::lock_guard lock{storage.mutex};
-	storage.ctx.CloseDirectory(handle);
+	ctx->CloseDirectory(handle);
 }
 
 const char *
 SmbclientDirectoryReader::Read() noexcept
 {
-	const std::lock_guard protect{storage.mutex};
-
-	while (auto e = storage.ctx.ReadDirectory(handle)) {
+	while (auto e = ctx->ReadDirectory(handle)) {
 		name = e->name;
 		if (!SkipNameFS(name))
 			return name;
@@ -173,7 +169,7 @@ StorageFileInfo
 SmbclientDirectoryReader::GetInfo([[maybe_unused]] bool follow)
 {
 	const std::string path = PathTraitsUTF8::Build(base, name);
-	return ::GetInfo(storage.ctx, storage.mutex, path.c_str());
+	return ::GetInfo(*ctx, path.c_str());
 }
 
 static std::unique_ptr<Storage>
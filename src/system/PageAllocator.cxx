@@ -16,3 +16,19 @@ AllocatePages(std::size_t size)
 
 	return reinterpret_cast<std::byte *>(p);
 }
+
+std::byte *
+AllocateHugeTlbPages(std::size_t size) noexcept
+{
+#ifdef MAP_HUGETLB
+	void *p = mmap(NULL, size, PROT_READ|PROT_WRITE,
+		       MAP_ANONYMOUS|MAP_PRIVATE|MAP_HUGETLB, -1, 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	return reinterpret_cast<std::byte *>(p);
+#else
+	(void)size;
+	return nullptr;
+#endif
+}
@@ -20,6 +20,20 @@
 std::byte *
 AllocatePages(std::size_t size);
 
+/**
+ * Allocate pages from the kernel's pool of explicit huge pages
+ * (MAP_HUGETLB, see "vm.nr_hugepages").  Unlike transparent huge
+ * pages, these are reserved in advance and cannot be swapped out or
+ * split.
+ *
+ * @param size the size of the allocation; must be a multiple of
+ * #HUGE_PAGE_SIZE
+ * @return the allocation or nullptr if there are not enough huge
+ * pages (or if this feature is not supported)
+ */
+std::byte *
+AllocateHugeTlbPages(std::size_t size) noexcept;
+
 static inline void
 FreePages(std::span<std::byte> p) noexcept
 {
@@ -101,6 +115,28 @@ DiscardPages(std::span<std::byte> p) noexcept
 #endif
 }
 
+/**
+ * Lock the specified pages into RAM, i.e. prevent them from being
+ * paged out.  This faults in all pages.
+ *
+ * @return true on success, false on error (with errno set,
+ * e.g. because RLIMIT_MEMLOCK is too small)
+ */
+static inline bool
+LockPages(std::span<std::byte> p) noexcept
+{
+	return mlock(p.data(), p.size()) == 0;
+}
+
+/**
+ * Undo LockPages().
+ */
+static inline void
+UnlockPages(std::span<std::byte> p) noexcept
+{
+	munlock(p.data(), p.size());
+}
+
 /**
  * Populate (prefault) page tables writable, faulting in all pages in
  * the range just as if manually writing to each each page.
@@ -109,8 +145,15 @@ static inline void
 PagesPopulateWrite(std::span<std::byte> p) noexcept
 {
 #ifdef MADV_POPULATE_WRITE
-	madvise(p.data(), p.size(), MADV_POPULATE_WRITE);
-#else
-	(void)p;
+	if (madvise(p.data(), p.size(), MADV_POPULATE_WRITE) == 0)
+		return;
 #endif
+
+	/* fallback for kernels older than 5.14: mlock() faults in
+	   all pages (writable, because this is a private writable
+	   mapping) and they stay after munlock(); unlike writing to
+	   each page, this is safe while other threads use the
+	   memory */
+	if (LockPages(p))
+		UnlockPages(p);
 }
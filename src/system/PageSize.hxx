@@ -22,3 +22,20 @@ AlignToPageSize(std::size_t size) noexcept
 
 	return RoundUpToPowerOfTwo(size, static_cast<std::size_t>(page_size));
 }
+
+/**
+ * The size of an explicit huge page (MAP_HUGETLB) on the most common
+ * architectures (x86_64 and ARM64 with 4 kB pages).  If the kernel
+ * uses a different size, allocating huge pages of this size fails
+ * and callers fall back to regular pages.
+ */
+static constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Round up the parameter to a multiple of #HUGE_PAGE_SIZE.
+ */
+constexpr std::size_t
+AlignToHugePageSize(std::size_t size) noexcept
+{
+	return RoundUpToPowerOfTwo(size, HUGE_PAGE_SIZE);
+}
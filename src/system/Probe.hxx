@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Static tracepoints (USDT) which can be attached to with bpftrace,
+ * perf or SystemTap, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/bin/mpd:mpd:command_start { printf("%s\n", str(arg0)); }'
+ *
+ * Each probe compiles to a single "nop" instruction plus a note in
+ * the ELF file; the arguments are only materialized in registers.
+ * Without the "usdt" build option, the macro expands to nothing and
+ * the arguments are not evaluated.
+ */
+
+#pragma once
+
+#include "config.h" // for HAVE_USDT
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+
+/**
+ * Declare a probe named "mpd:NAME" with up to 12 (integer or
+ * pointer) arguments.
+ */
+#define MPD_PROBE(name, ...) STAP_PROBEV(mpd, name __VA_OPT__(,) __VA_ARGS__)
+
+#else
+
+#define MPD_PROBE(name, ...) do {} while (false)
+
+#endif
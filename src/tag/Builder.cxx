@@ -20,25 +20,42 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 	const std::size_t n = other.num_items;
 	if (n > 0) {
 		items.reserve(other.num_items);
-		const std::lock_guard protect{tag_pool_lock};
 		for (std::size_t i = 0; i != n; ++i)
-			items.push_back(tag_pool_dup_item(other.items[i]));
+			items.push_back(tag_pool_dup_item(&tag_pool_item_at(other.items[i])));
 	}
 }
 
+/**
+ * Move all TagItem pointers from the Tag object.  If it is the only
+ * owner of its items block, we don't need to contact the tag pool,
+ * because all we do is move references; if the block is shared with
+ * other copies, the references are duplicated.
+ */
+static void
+StealItems(std::vector<TagItem *> &dest, Tag &src) noexcept
+{
+	const bool unique = src.HasUniqueItems();
+
+	dest.reserve(src.num_items);
+	for (std::size_t i = 0; i != src.num_items; ++i) {
+		TagItem *item = &tag_pool_item_at(src.items[i]);
+		dest.push_back(unique ? item : tag_pool_dup_item(item));
+	}
+
+	if (unique && src.items != nullptr) {
+		/* discard the pointers from the Tag object */
+		Tag::FreeItems(src.items);
+		src.items = nullptr;
+		src.num_items = 0;
+	} else
+		/* release our reference to the shared block */
+		src.Clear();
+}
+
 TagBuilder::TagBuilder(Tag &&other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist)
 {
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	StealItems(items, other);
 }
 
 TagBuilder &
@@ -54,7 +71,6 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 		items = other.items;
 
 		/* increment the tag pool refcounters */
-		const std::lock_guard protect{tag_pool_lock};
 		for (auto &i : items)
 			i = tag_pool_dup_item(i);
 	}
@@ -83,17 +99,8 @@ TagBuilder::operator=(Tag &&other) noexcept
 	duration = other.duration;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
 	RemoveAll();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	StealItems(items, other);
 
 	return *this;
 }
@@ -119,9 +126,21 @@ TagBuilder::Commit(Tag &tag) noexcept
 	   vector::clear() call is important to detach them from this
 	   object */
 	const unsigned n_items = items.size();
+	if (n_items == 0) {
+		/* an empty Tag has no items block */
+		Clear();
+		return;
+	}
+
 	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
+	tag.items = Tag::AllocateItems(n_items);
+
+	uint8_t *types = tag.GetTypes();
+	for (unsigned i = 0; i != n_items; ++i) {
+		tag.items[i] = tag_pool_item_index(*items[i]);
+		types[i] = items[i]->type;
+	}
+
 	items.clear();
 
 	/* now ensure that this object is fresh (will not delete any
@@ -170,26 +189,17 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 		items.reserve(items.size() + n);
 
-		const std::lock_guard protect{tag_pool_lock};
-		for (std::size_t i = 0; i != n; ++i) {
-			TagItem *item = other.items[i];
-			if (!present[item->type])
-				items.push_back(tag_pool_dup_item(item));
-		}
+		const uint8_t *types = other.GetTypes();
+		for (std::size_t i = 0; i != n; ++i)
+			if (!present[types[i]])
+				items.push_back(tag_pool_dup_item(&tag_pool_item_at(other.items[i])));
 	}
 }
 
 void
 TagBuilder::AddItemUnchecked(TagType type, std::string_view value) noexcept
 {
-	TagItem *i;
-
-	{
-		const std::lock_guard protect{tag_pool_lock};
-		i = tag_pool_get_item(type, value);
-	}
-
-	items.push_back(i);
+	items.push_back(tag_pool_get_item(type, value));
 }
 
 inline void
@@ -222,16 +232,8 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 void
 TagBuilder::RemoveAll() noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
-	{
-		const std::lock_guard protect{tag_pool_lock};
-		for (auto i : items)
-			tag_pool_put_item(i);
-	}
+	for (auto i : items)
+		tag_pool_put_item(i);
 
 	items.clear();
 }
@@ -239,14 +241,8 @@ TagBuilder::RemoveAll() noexcept
 void
 TagBuilder::RemoveType(TagType type) noexcept
 {
-	if (items.empty())
-		/* don't acquire the tag_pool_lock if we're not going
-		   to call tag_pool_put_item() anyway */
-		return;
-
 	const auto begin = items.begin(), end = items.end();
 
-	const std::lock_guard protect{tag_pool_lock};
 	items.erase(std::remove_if(begin, end,
 				   [type](TagItem *item) {
 					   if (item->type != type)
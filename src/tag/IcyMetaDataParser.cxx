@@ -6,7 +6,6 @@
 #include "util/AllocatedString.hxx"
 #include "util/StringSplit.hxx"
 
-#include <algorithm>
 #include <cassert>
 #include <string_view>
 
@@ -213,27 +212,3 @@ IcyMetaDataParser::Meta(std::span<const std::byte> src) noexcept
 
 	return consumed;
 }
-
-size_t
-IcyMetaDataParser::ParseInPlace(std::span<std::byte> buffer) noexcept
-{
-	const auto begin = buffer.begin();
-	auto dest = begin;
-	auto src = buffer;
-
-	while (!src.empty()) {
-		std::size_t chunk = Data(src.size());
-		if (chunk > 0) {
-			dest = std::copy_n(src.begin(), chunk, dest);
-			src = src.subspan(chunk);
-			if (src.empty())
-				break;
-		}
-
-		chunk = Meta(src);
-		if (chunk > 0)
-			src = src.subspan(chunk);
-	}
-
-	return std::distance(begin, dest);
-}
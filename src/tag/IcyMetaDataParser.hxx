@@ -7,6 +7,7 @@
 #include "lib/icu/Converter.hxx"
 #include "tag/Tag.hxx"
 
+#include <cassert>
 #include <cstddef>
 #include <memory>
 #include <span>
@@ -57,6 +58,33 @@ public:
 		return data_size > 0;
 	}
 
+	/**
+	 * Returns the number of bytes of normal data before the next
+	 * metadata block.  If this is 0, the stream is at a metadata
+	 * block, and the caller shall pass the next
+	 * GetMetaRest() bytes to Meta().
+	 */
+	std::size_t GetDataRest() const noexcept {
+		assert(IsDefined());
+
+		return data_rest;
+	}
+
+	/**
+	 * Returns the number of bytes of the current metadata block
+	 * (including its length byte) which have not yet been passed
+	 * to Meta().  This is only an upper bound, because the length
+	 * of the block is only known after its first byte.
+	 */
+	std::size_t GetMetaRest() const noexcept {
+		assert(IsDefined());
+		assert(data_rest == 0);
+
+		return meta_size == 0
+			? 1
+			: meta_size - meta_position;
+	}
+
 	/**
 	 * Evaluates data.  Returns the number of bytes of normal data which
 	 * can be read by the caller, but not more than "length".  If the
@@ -72,13 +100,6 @@ public:
 	 */
 	std::size_t Meta(std::span<const std::byte> src) noexcept;
 
-	/**
-	 * Parse data and eliminate metadata.
-	 *
-	 * @return the number of data bytes remaining in the buffer
-	 */
-	size_t ParseInPlace(std::span<std::byte> buffer) noexcept;
-
 	std::unique_ptr<Tag> ReadTag() noexcept {
 		return std::exchange(tag, nullptr);
 	}
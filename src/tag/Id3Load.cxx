@@ -10,9 +10,129 @@
 #include <id3tag.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <string.h>
 
 static constexpr size_t ID3V1_SIZE = 128;
 
+static constexpr std::size_t ID3V2_HEADER_SIZE = 10;
+static constexpr std::size_t ID3V2_FRAME_HEADER_SIZE = 10;
+
+/**
+ * Tags smaller than this are read in one piece even if pictures are
+ * not wanted.
+ */
+static constexpr std::size_t ID3V2_SKIP_PICTURES_THRESHOLD = 64 * 1024;
+
+static constexpr uint_least32_t
+ParseSyncSafe(const std::byte *p) noexcept
+{
+	return (uint_least32_t(p[0] & std::byte{0x7f}) << 21) |
+		(uint_least32_t(p[1] & std::byte{0x7f}) << 14) |
+		(uint_least32_t(p[2] & std::byte{0x7f}) << 7) |
+		uint_least32_t(p[3] & std::byte{0x7f});
+}
+
+static constexpr void
+WriteSyncSafe(std::byte *p, uint_least32_t value) noexcept
+{
+	p[0] = std::byte((value >> 21) & 0x7f);
+	p[1] = std::byte((value >> 14) & 0x7f);
+	p[2] = std::byte((value >> 7) & 0x7f);
+	p[3] = std::byte(value & 0x7f);
+}
+
+static constexpr uint_least32_t
+ParseBigEndian32(const std::byte *p) noexcept
+{
+	return (uint_least32_t(p[0]) << 24) | (uint_least32_t(p[1]) << 16) |
+		(uint_least32_t(p[2]) << 8) | uint_least32_t(p[3]);
+}
+
+/**
+ * Can ReadId3TagWithoutPictures() handle a tag with this header?
+ * Only ID3v2.3 and ID3v2.4 tags without tag-level unsynchronisation
+ * and without extended header are supported.
+ */
+[[gnu::pure]]
+static bool
+CanSkipPictures(std::span<const std::byte, ID3V2_HEADER_SIZE> header) noexcept
+{
+	const auto major = header[3];
+	const auto flags = header[5];
+
+	return (major == std::byte{3} || major == std::byte{4}) &&
+		(flags & std::byte{0xc0}) == std::byte{};
+}
+
+/**
+ * Read an ID3v2 tag frame by frame, seeking over the payload of
+ * "APIC" frames (embedded pictures are often much larger than
+ * everything else) and over the padding.  The stream is left at the
+ * end of the tag, like the full read does.
+ *
+ * @param header the tag header which has already been read
+ * @param tag_size the total size of the tag (including header and
+ * footer)
+ */
+static UniqueId3Tag
+ReadId3TagWithoutPictures(InputStream &is, std::unique_lock<Mutex> &lock,
+			  std::span<const std::byte, ID3V2_HEADER_SIZE> header,
+			  std::size_t tag_size)
+{
+	const bool v24 = header[3] == std::byte{4};
+	const bool has_footer = (header[5] & std::byte{0x10}) != std::byte{};
+
+	const offset_type end_offset = is.GetOffset() - ID3V2_HEADER_SIZE + tag_size;
+
+	std::size_t remaining = tag_size - ID3V2_HEADER_SIZE;
+	if (has_footer)
+		remaining -= std::min(remaining, ID3V2_HEADER_SIZE);
+
+	std::vector<std::byte> buffer{header.begin(), header.end()};
+
+	while (remaining >= ID3V2_FRAME_HEADER_SIZE) {
+		std::byte frame_header[ID3V2_FRAME_HEADER_SIZE];
+		is.ReadFull(lock, frame_header);
+		remaining -= sizeof(frame_header);
+
+		if (frame_header[0] == std::byte{})
+			/* padding */
+			break;
+
+		const std::size_t frame_size = v24
+			? ParseSyncSafe(frame_header + 4)
+			: ParseBigEndian32(frame_header + 4);
+		if (frame_size > remaining)
+			/* malformed */
+			break;
+
+		remaining -= frame_size;
+
+		if (memcmp(frame_header, "APIC", 4) == 0) {
+			is.Seek(lock, is.GetOffset() + frame_size);
+			continue;
+		}
+
+		buffer.insert(buffer.end(),
+			      std::begin(frame_header), std::end(frame_header));
+
+		const std::size_t position = buffer.size();
+		buffer.resize(position + frame_size);
+		is.ReadFull(lock, std::span{buffer}.subspan(position));
+	}
+
+	is.Seek(lock, end_offset);
+
+	/* fix up the header: the new size, and the footer is gone */
+	WriteSyncSafe(buffer.data() + 6, buffer.size() - ID3V2_HEADER_SIZE);
+	buffer[5] &= ~std::byte{0x10};
+
+	return id3_tag_parse(buffer);
+}
+
 [[gnu::pure]]
 static inline bool
 tag_is_id3v1(struct id3_tag *tag) noexcept
@@ -34,7 +154,7 @@ try {
 }
 
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock)
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, bool skip_pictures)
 try {
 	std::byte query_buffer[ID3_TAG_QUERYSIZE];
 	is.ReadFull(lock, query_buffer);
@@ -52,6 +172,12 @@ try {
 		/* we have enough data already */
 		return id3_tag_parse(std::span{query_buffer}.first(tag_size));
 
+	static_assert(sizeof(query_buffer) == ID3V2_HEADER_SIZE);
+	if (skip_pictures && tag_size >= ID3V2_SKIP_PICTURES_THRESHOLD &&
+	    is.CheapSeeking() && CanSkipPictures(query_buffer))
+		return ReadId3TagWithoutPictures(is, lock, query_buffer,
+						 tag_size);
+
 	auto tag_buffer = std::make_unique_for_overwrite<std::byte[]>(tag_size);
 
 	/* copy the start of the tag we already have to the allocated
@@ -69,11 +195,12 @@ try {
 }
 
 static UniqueId3Tag
-ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset)
+ReadId3Tag(InputStream &is, std::unique_lock<Mutex> &lock, offset_type offset,
+	   bool skip_pictures)
 try {
 	is.Seek(lock, offset);
 
-	return ReadId3Tag(is, lock);
+	return ReadId3Tag(is, lock, skip_pictures);
 } catch (...) {
 	return nullptr;
 }
@@ -99,9 +226,10 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_beginning(InputStream &is, std::unique_lock<Mutex> &lock,
+			    bool skip_pictures)
 try {
-	auto tag = ReadId3Tag(is, lock);
+	auto tag = ReadId3Tag(is, lock, skip_pictures);
 	if (!tag) {
 		return nullptr;
 	} else if (tag_is_id3v1(tag.get())) {
@@ -118,7 +246,8 @@ try {
 			break;
 
 		/* Get the tag specified by the SEEK frame */
-		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek);
+		auto seektag = ReadId3Tag(is, lock, is.GetOffset() + seek,
+					  skip_pictures);
 		if (!seektag || tag_is_id3v1(seektag.get()))
 			break;
 
@@ -132,7 +261,8 @@ try {
 }
 
 static UniqueId3Tag
-tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock)
+tag_id3_find_from_end(InputStream &is, std::unique_lock<Mutex> &lock,
+		      bool skip_pictures)
 try {
 	if (!is.KnownSize() || !is.CheapSeeking())
 		return nullptr;
@@ -162,7 +292,7 @@ try {
 		return v1tag;
 
 	/* Get the tag which the footer belongs to */
-	auto tag = ReadId3Tag(is, lock, offset - tag_size);
+	auto tag = ReadId3Tag(is, lock, offset - tag_size, skip_pictures);
 	if (!tag)
 		return v1tag;
 
@@ -197,15 +327,15 @@ try {
 }
 
 UniqueId3Tag
-tag_id3_load(InputStream &is)
+tag_id3_load(InputStream &is, bool skip_pictures)
 try {
 	std::unique_lock lock{is.mutex};
 
-	auto tag = tag_id3_find_from_beginning(is, lock);
+	auto tag = tag_id3_find_from_beginning(is, lock, skip_pictures);
 	if (tag == nullptr && is.CheapSeeking()) {
 		tag = tag_id3_riff_aiff_load(is, lock);
 		if (tag == nullptr)
-			tag = tag_id3_find_from_end(is, lock);
+			tag = tag_id3_find_from_end(is, lock, skip_pictures);
 	}
 
 	return tag;
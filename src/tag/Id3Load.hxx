@@ -11,9 +11,11 @@ class InputStream;
 /**
  * Loads the ID3 tags from the #InputStream into a libid3tag object.
  *
+ * @param skip_pictures omit "APIC" frames; this allows seeking over
+ * large embedded pictures instead of reading them
  * @return nullptr on error or if no ID3 tag was found in the file
  */
 UniqueId3Tag
-tag_id3_load(InputStream &is);
+tag_id3_load(InputStream &is, bool skip_pictures=false);
 
 #endif
@@ -359,7 +359,7 @@ tag_id3_import(const struct id3_tag *tag) noexcept
 bool
 tag_id3_scan(InputStream &is, TagHandler &handler)
 {
-	auto tag = tag_id3_load(is);
+	auto tag = tag_id3_load(is, !handler.WantPicture());
 	if (!tag)
 		return false;
 
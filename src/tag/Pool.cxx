@@ -8,13 +8,14 @@
 #include "util/IntrusiveHashSet.hxx"
 #include "util/SpanCast.hxx"
 #include "util/VarSize.hxx"
+#include "thread/Mutex.hxx"
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <limits>
-
-Mutex tag_pool_lock;
+#include <vector>
 
 struct TagPoolKey {
 	std::string_view value;
@@ -33,10 +34,24 @@ struct TagPoolKey {
 
 struct TagPoolItem {
 	IntrusiveHashSetHook<IntrusiveHookMode::NORMAL> hash_set_hook;
-	uint8_t ref = 1;
+
+	/**
+	 * The reference counter.  It may be incremented (if it is
+	 * already positive) and decremented (unless this is the last
+	 * reference) without holding the shard's mutex; the
+	 * transition to zero happens only with the mutex locked, so
+	 * a concurrent lookup cannot see a dying item.
+	 */
+	mutable std::atomic_uint8_t ref = 1;
+
+	/**
+	 * The index in #tag_pool_chunks, see tag_pool_item_index().
+	 */
+	uint32_t index;
+
 	TagItem item;
 
-	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
+	static constexpr unsigned MAX_REF = std::numeric_limits<uint8_t>::max();
 
 	TagPoolItem(TagType type,
 		    std::string_view value) noexcept {
@@ -47,6 +62,52 @@ struct TagPoolItem {
 	static TagPoolItem *Create(TagType type,
 				   std::string_view value) noexcept;
 
+	/**
+	 * The (approximate) size of the allocation made by Create().
+	 */
+	[[gnu::pure]]
+	std::size_t GetAllocationSize() const noexcept {
+		return sizeof(*this) + std::char_traits<char>::length(item.value);
+	}
+
+	/**
+	 * Increment the reference counter unless it has reached
+	 * #MAX_REF.
+	 */
+	bool TryIncrementRef() const noexcept {
+		auto r = ref.load(std::memory_order_relaxed);
+		do {
+			assert(r > 0);
+
+			if (r >= MAX_REF)
+				return false;
+		} while (!ref.compare_exchange_weak(r, r + 1,
+						    std::memory_order_relaxed));
+
+		return true;
+	}
+
+	/**
+	 * Decrement the reference counter unless this is the last
+	 * reference.
+	 *
+	 * @return false if this is (probably) the last reference and
+	 * the caller needs to lock the shard
+	 */
+	bool TryDecrementRef() const noexcept {
+		auto r = ref.load(std::memory_order_relaxed);
+		do {
+			assert(r > 0);
+
+			if (r == 1)
+				return false;
+		} while (!ref.compare_exchange_weak(r, r - 1,
+						    std::memory_order_release,
+						    std::memory_order_relaxed));
+
+		return true;
+	}
+
 	struct GetKey {
 		[[gnu::pure]]
 		constexpr TagPoolKey operator()(const TagItem &i) const noexcept {
@@ -59,9 +120,13 @@ struct TagPoolItem {
 		}
 	};
 
-	struct CanIncrementRef {
-		constexpr bool operator()(const TagPoolItem &i) const noexcept {
-			return i.ref < MAX_REF;
+	/**
+	 * A predicate for insert_check_if() which obtains a new
+	 * reference on success.
+	 */
+	struct IncrementRef {
+		bool operator()(const TagPoolItem &i) const noexcept {
+			return i.TryIncrementRef();
 		}
 	};
 };
@@ -77,12 +142,92 @@ TagPoolItem::Create(TagType type,
 				       value);
 }
 
-static IntrusiveHashSet<TagPoolItem, 16384,
-	IntrusiveHashSetOperators<TagPoolItem, TagPoolItem::GetKey,
-				  TagPoolKey::Hash,
-				  std::equal_to<TagPoolKey>>,
-	IntrusiveHashSetMemberHookTraits<&TagPoolItem::hash_set_hook>,
-	IntrusiveHashSetOptions{.zero_initialized = true}> tag_pool;
+TagItem **tag_pool_chunks[TAG_POOL_N_CHUNKS];
+
+/**
+ * Protects #tag_pool_free_indices and #tag_pool_next_index.  It
+ * is locked while a shard is locked, never the other way round.
+ */
+static Mutex tag_pool_index_mutex;
+
+/**
+ * Indices of deleted items which can be reused.
+ */
+static std::vector<uint32_t> tag_pool_free_indices;
+
+/**
+ * The next index which has never been used.
+ */
+static std::size_t tag_pool_next_index = 0;
+
+static void
+AllocateIndex(TagPoolItem &pool_item) noexcept
+{
+	const std::scoped_lock lock{tag_pool_index_mutex};
+
+	uint32_t index;
+	if (!tag_pool_free_indices.empty()) {
+		index = tag_pool_free_indices.back();
+		tag_pool_free_indices.pop_back();
+	} else {
+		assert(tag_pool_next_index < TAG_POOL_N_CHUNKS * TAG_POOL_CHUNK_SIZE);
+
+		index = tag_pool_next_index++;
+
+		auto &chunk = tag_pool_chunks[index >> TAG_POOL_CHUNK_BITS];
+		if (chunk == nullptr)
+			/* the new chunk gets published to other
+			   threads together with the first index
+			   pointing into it */
+			chunk = new TagItem *[TAG_POOL_CHUNK_SIZE];
+	}
+
+	pool_item.index = index;
+	tag_pool_chunks[index >> TAG_POOL_CHUNK_BITS][index & (TAG_POOL_CHUNK_SIZE - 1)] = &pool_item.item;
+}
+
+static void
+FreeIndex(uint32_t index) noexcept
+{
+	const std::scoped_lock lock{tag_pool_index_mutex};
+	tag_pool_free_indices.push_back(index);
+}
+
+/**
+ * The pool is split into shards with separate locks, so threads
+ * adding tags (e.g. the update walker and its scanner threads)
+ * rarely wait for each other.
+ */
+static constexpr std::size_t N_SHARDS = 16;
+
+struct TagPoolShard {
+	Mutex mutex;
+
+	IntrusiveHashSet<TagPoolItem, 16384 / N_SHARDS,
+		IntrusiveHashSetOperators<TagPoolItem, TagPoolItem::GetKey,
+					  TagPoolKey::Hash,
+					  std::equal_to<TagPoolKey>>,
+		IntrusiveHashSetMemberHookTraits<&TagPoolItem::hash_set_hook>,
+		IntrusiveHashSetOptions{.constant_time_size = true,
+					.zero_initialized = true}> items;
+
+	/**
+	 * The total size of all #items, see
+	 * TagPoolItem::GetAllocationSize().
+	 */
+	std::size_t n_bytes = 0;
+};
+
+static std::array<TagPoolShard, N_SHARDS> tag_pool;
+
+[[gnu::pure]]
+static TagPoolShard &
+GetShard(const TagPoolKey &key) noexcept
+{
+	/* use other bits than the hash set, which uses the lowest
+	   bits to select the bucket */
+	return tag_pool[(TagPoolKey::Hash{}(key) >> 16) % N_SHARDS];
+}
 
 static constexpr TagPoolItem *
 TagItemToPoolItem(TagItem *item) noexcept
@@ -93,16 +238,21 @@ TagItemToPoolItem(TagItem *item) noexcept
 TagItem *
 tag_pool_get_item(TagType type, std::string_view value) noexcept
 {
+	const TagPoolKey key{value, type};
+	auto &shard = GetShard(key);
+
+	const std::scoped_lock lock{shard.mutex};
+
 	const auto [position, inserted] =
-		tag_pool.insert_check_if(TagPoolKey{value, type},
-					 TagPoolItem::CanIncrementRef{});
+		shard.items.insert_check_if(key, TagPoolItem::IncrementRef{});
 
 	if (inserted) {
 		auto *pool_item = TagPoolItem::Create(type, value);
-		tag_pool.insert_commit(position, *pool_item);
+		AllocateIndex(*pool_item);
+		shard.items.insert_commit(position, *pool_item);
+		shard.n_bytes += pool_item->GetAllocationSize();
 		return &pool_item->item;
 	} else {
-		++position->ref;
 		return &position->item;
 	}
 }
@@ -112,29 +262,62 @@ tag_pool_dup_item(TagItem *item) noexcept
 {
 	TagPoolItem *pool_item = TagItemToPoolItem(item);
 
-	assert(pool_item->ref > 0);
-
-	if (pool_item->ref < TagPoolItem::MAX_REF) {
-		++pool_item->ref;
+	if (pool_item->TryIncrementRef())
 		return item;
-	} else {
-		/* the reference counter overflows above MAX_REF;
-		   obtain a reference to a different TagPoolItem which
-		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
-	}
+
+	/* the reference counter overflows above MAX_REF; obtain a
+	   reference to a different TagPoolItem which isn't yet
+	   "full" */
+	return tag_pool_get_item(item->type, item->value);
 }
 
 void
 tag_pool_put_item(TagItem *item) noexcept
 {
 	TagPoolItem *const pool_item = TagItemToPoolItem(item);
-	assert(pool_item->ref > 0);
-	--pool_item->ref;
 
-	if (pool_item->ref > 0)
+	if (pool_item->TryDecrementRef())
+		return;
+
+	/* this may be the last reference: lock the shard, so no
+	   other thread can obtain a new reference while the item is
+	   being removed */
+	auto &shard = GetShard(TagPoolItem::GetKey{}(*pool_item));
+	const std::scoped_lock lock{shard.mutex};
+
+	if (pool_item->ref.fetch_sub(1, std::memory_order_acq_rel) > 1)
+		/* tag_pool_get_item() has obtained another reference
+		   meanwhile */
 		return;
 
-	tag_pool.erase(tag_pool.iterator_to(*pool_item));
+	shard.items.erase(shard.items.iterator_to(*pool_item));
+	shard.n_bytes -= pool_item->GetAllocationSize();
+	FreeIndex(pool_item->index);
 	DeleteVarSize(pool_item);
 }
+
+uint32_t
+tag_pool_item_index(const TagItem &item) noexcept
+{
+	return ContainerCast(item, &TagPoolItem::item).index;
+}
+
+TagPoolStats
+tag_pool_get_stats() noexcept
+{
+	TagPoolStats stats{};
+
+	for (auto &shard : tag_pool) {
+		const std::scoped_lock lock{shard.mutex};
+		stats.items += shard.items.size();
+		stats.bytes += shard.n_bytes;
+	}
+
+	const std::scoped_lock lock{tag_pool_index_mutex};
+	const std::size_t n_chunks =
+		(tag_pool_next_index + TAG_POOL_CHUNK_SIZE - 1) >> TAG_POOL_CHUNK_BITS;
+	stats.bytes += n_chunks * TAG_POOL_CHUNK_SIZE * sizeof(TagItem *) +
+		tag_pool_free_indices.capacity() * sizeof(uint32_t);
+
+	return stats;
+}
@@ -4,17 +4,19 @@
 #ifndef MPD_TAG_POOL_HXX
 #define MPD_TAG_POOL_HXX
 
-#include "thread/Mutex.hxx"
-
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 
 enum TagType : uint8_t;
 
-extern Mutex tag_pool_lock;
-
 struct TagItem;
 
+/*
+ * These functions are thread-safe; they don't need any external
+ * locking.
+ */
+
 [[nodiscard]]
 TagItem *
 tag_pool_get_item(TagType type, std::string_view value) noexcept;
@@ -26,4 +28,50 @@ tag_pool_dup_item(TagItem *item) noexcept;
 void
 tag_pool_put_item(TagItem *item) noexcept;
 
+/**
+ * Each pooled #TagItem has a 32 bit index which does not change
+ * during its lifetime; #Tag stores these indices instead of
+ * pointers.  The table is split into chunks which are allocated on
+ * demand and are never freed or moved, so lookups need no lock.
+ */
+static constexpr unsigned TAG_POOL_CHUNK_BITS = 16;
+static constexpr std::size_t TAG_POOL_CHUNK_SIZE = std::size_t{1} << TAG_POOL_CHUNK_BITS;
+static constexpr std::size_t TAG_POOL_N_CHUNKS = std::size_t{1} << (32 - TAG_POOL_CHUNK_BITS);
+
+/**
+ * Internal table for tag_pool_item_at(); don't use directly.
+ */
+extern TagItem **tag_pool_chunks[TAG_POOL_N_CHUNKS];
+
+/**
+ * Look up a #TagItem by the index returned by tag_pool_item_index().
+ * The caller must own a reference.
+ */
+[[gnu::pure]]
+inline TagItem &
+tag_pool_item_at(uint32_t index) noexcept
+{
+	return *tag_pool_chunks[index >> TAG_POOL_CHUNK_BITS][index & (TAG_POOL_CHUNK_SIZE - 1)];
+}
+
+[[gnu::pure]]
+uint32_t
+tag_pool_item_index(const TagItem &item) noexcept;
+
+struct TagPoolStats {
+	/**
+	 * The number of distinct tag values in the pool.
+	 */
+	std::size_t items;
+
+	/**
+	 * The memory occupied by these items and the index table.
+	 */
+	std::size_t bytes;
+};
+
+[[gnu::pure]]
+TagPoolStats
+tag_pool_get_stats() noexcept;
+
 #endif
@@ -4,38 +4,78 @@
 #include "Sort.hxx"
 #include "Tag.hxx"
 
-#include <algorithm>
-
 #include <string.h>
 #include <stdlib.h>
 
 [[gnu::pure]]
 static bool
-CompareNumeric(const char *a, const char *b) noexcept
+IsNumericTag(TagType type) noexcept
 {
-	long a_value = strtol(a, nullptr, 10);
-	long b_value = strtol(b, nullptr, 10);
+	switch (type) {
+	case TAG_DISC:
+	case TAG_TRACK:
+		return true;
 
-	return a_value < b_value;
+	default:
+		return false;
+	}
 }
 
-bool
-CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
+[[gnu::pure]]
+static uint64_t
+NumericSortPrefix(const char *value) noexcept
 {
-	const char *a_value = a.GetSortValue(type);
-	const char *b_value = b.GetSortValue(type);
+	/* flip the sign bit, so negative numbers sort before positive
+	   ones in unsigned comparisons */
+	return uint64_t(strtoll(value, nullptr, 10)) ^ (uint64_t{1} << 63);
+}
 
-	if (descending) {
-		using std::swap;
-		swap(a_value, b_value);
+[[gnu::pure]]
+static uint64_t
+StringSortPrefix(const char *value) noexcept
+{
+	uint64_t prefix = 0;
+	for (unsigned i = 0; i < sizeof(prefix); ++i) {
+		prefix <<= 8;
+		if (*value != 0)
+			prefix |= static_cast<unsigned char>(*value++);
 	}
 
-	switch (type) {
-	case TAG_DISC:
-	case TAG_TRACK:
-		return CompareNumeric(a_value, b_value);
+	return prefix;
+}
 
-	default:
-		return strcmp(a_value, b_value) < 0;
-	}
+TagSortKey::TagSortKey(TagType type, const Tag &tag) noexcept
+	:value(tag.GetSortValue(type)),
+	 prefix(IsNumericTag(type)
+		? NumericSortPrefix(value)
+		: StringSortPrefix(value))
+{
+	/* for numeric keys, CompareTagSortKeys() must not fall back
+	   to strcmp() */
+	if (IsNumericTag(type))
+		value = nullptr;
+}
+
+bool
+CompareTagSortKeys(bool descending,
+		   const TagSortKey &a, const TagSortKey &b) noexcept
+{
+	const TagSortKey &x = descending ? b : a;
+	const TagSortKey &y = descending ? a : b;
+
+	if (x.prefix != y.prefix)
+		return x.prefix < y.prefix;
+
+	/* equal values often come from the same pooled item */
+	if (x.value == y.value)
+		return false;
+
+	return strcmp(x.value, y.value) < 0;
+}
+
+bool
+CompareTags(TagType type, bool descending, const Tag &a, const Tag &b) noexcept
+{
+	return CompareTagSortKeys(descending,
+				  TagSortKey{type, a}, TagSortKey{type, b});
 }
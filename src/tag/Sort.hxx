@@ -8,6 +8,43 @@
 enum TagType : uint8_t;
 struct Tag;
 
+/**
+ * The value of a #Tag which is used for sorting by one #TagType,
+ * determined once per tag (including the fallbacks of
+ * Tag::GetSortValue() and parsing numbers), so sorting many tags
+ * doesn't repeat this work for each comparison.
+ *
+ * It points into the tag pool and is valid as long as the #Tag is
+ * (moving the #Tag doesn't invalidate it).
+ */
+struct TagSortKey {
+	/**
+	 * The sort value; nullptr for numeric tag types, which are
+	 * compared only by #prefix.
+	 */
+	const char *value = nullptr;
+
+	/**
+	 * For numeric tag types (#TAG_TRACK, #TAG_DISC): the parsed
+	 * number; otherwise the first bytes of #value in big-endian
+	 * order (zero-padded), which orders like strcmp() and settles
+	 * most comparisons without touching the string.
+	 */
+	uint64_t prefix = 0;
+
+	TagSortKey() = default;
+	TagSortKey(TagType type, const Tag &tag) noexcept;
+};
+
+/**
+ * Compare two keys created by TagSortKey::TagSortKey() with the same
+ * #TagType.
+ */
+[[gnu::pure]]
+bool
+CompareTagSortKeys(bool descending,
+		   const TagSortKey &a, const TagSortKey &b) noexcept;
+
 [[gnu::pure]]
 bool
 CompareTags(TagType type, bool descending,
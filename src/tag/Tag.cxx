@@ -5,8 +5,11 @@
 #include "Pool.hxx"
 #include "Builder.hxx"
 
+#include <algorithm>
 #include <cassert>
 
+#include <string.h>
+
 bool
 Tag::operator==(const Tag &other) const noexcept {
 	return (this == &other) ? true :
@@ -22,29 +25,28 @@ Tag::Clear() noexcept
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	if (num_items > 0) {
-		assert(items != nullptr);
-		const std::lock_guard protect{tag_pool_lock};
+	assert(num_items == 0 || items != nullptr);
+
+	if (items != nullptr &&
+	    std::atomic_ref{items[-1]}.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		/* this was the last owner of the block */
 		for (unsigned i = 0; i < num_items; ++i)
-			tag_pool_put_item(items[i]);
-		num_items = 0;
+			tag_pool_put_item(&tag_pool_item_at(items[i]));
+		FreeItems(items);
 	}
 
-	delete[] items;
+	num_items = 0;
 	items = nullptr;
 }
 
 Tag::Tag(const Tag &other) noexcept
 	:duration(other.duration), has_playlist(other.has_playlist),
-	 num_items(other.num_items)
+	 num_items(other.num_items), items(other.items)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
-
-		const std::lock_guard protect{tag_pool_lock};
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-	}
+	/* share the (immutable) items block instead of copying it
+	   and duplicating each tag pool reference */
+	if (items != nullptr)
+		std::atomic_ref{items[-1]}.fetch_add(1, std::memory_order_relaxed);
 }
 
 Tag
@@ -96,17 +98,23 @@ Tag::GetValue(TagType type) const noexcept
 {
 	assert(type < TAG_NUM_OF_ITEM_TYPES);
 
-	for (const auto &item : *this)
-		if (item.type == type)
-			return item.value;
+	if (num_items == 0)
+		return nullptr;
 
-	return nullptr;
+	const auto *types = GetTypes();
+	const auto *p = static_cast<const uint8_t *>(memchr(types, type, num_items));
+	if (p == nullptr)
+		return nullptr;
+
+	return tag_pool_item_at(items[p - types]).value;
 }
 
 bool
 Tag::HasType(TagType type) const noexcept
 {
-	return GetValue(type) != nullptr;
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+
+	return num_items > 0 && memchr(GetTypes(), type, num_items) != nullptr;
 }
 
 static TagType
@@ -7,8 +7,12 @@
 #include "Type.hxx" // IWYU pragma: export
 #include "Item.hxx" // IWYU pragma: export
 #include "Chrono.hxx"
-#include "util/DereferenceIterator.hxx"
+#include "Pool.hxx"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <memory>
 #include <utility>
 
@@ -32,8 +36,19 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items = 0;
 
-	/** an array of tag items */
-	TagItem **items = nullptr;
+	/**
+	 * A single allocation containing #num_items tag pool indices
+	 * (see tag_pool_item_at()) followed by the #num_items
+	 * #TagType bytes of these items (see GetTypes()), which
+	 * allows finding a type without dereferencing the items.
+	 *
+	 * The block is immutable once it has been filled and is
+	 * shared by all copies of this object (e.g. the #DetachedSong
+	 * copies of a database song in the queue); it is preceded by
+	 * a reference counter (see AllocateItems()).  The block holds
+	 * one tag pool reference per item.
+	 */
+	uint32_t *items = nullptr;
 
 	/**
 	 * Create an empty tag.
@@ -67,6 +82,62 @@ struct Tag {
 
 	bool operator==(const Tag &other) const noexcept;
 
+	/**
+	 * Allocate an uninitialized #items block for the given number
+	 * of items, with a reference counter initialized to 1.  Free
+	 * it with FreeItems().
+	 */
+	static uint32_t *AllocateItems(std::size_t n) noexcept {
+		uint32_t *p = new uint32_t[1 + n + (n + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+		p[0] = 1;
+		return p + 1;
+	}
+
+	/**
+	 * Returns the size of the #items block in bytes; it may be
+	 * shared with other #Tag objects.  The strings belong to the
+	 * tag pool and are not included.
+	 */
+	[[gnu::pure]]
+	std::size_t GetItemsSize() const noexcept {
+		if (items == nullptr)
+			return 0;
+
+		const std::size_t n = num_items;
+		return (1 + n + (n + sizeof(uint32_t) - 1) / sizeof(uint32_t)) * sizeof(uint32_t);
+	}
+
+	/**
+	 * Free an #items block allocated by AllocateItems() without
+	 * looking at its reference counter and without releasing the
+	 * tag pool references.
+	 */
+	static void FreeItems(uint32_t *p) noexcept {
+		delete[] (p - 1);
+	}
+
+	/**
+	 * Is this object the only owner of its #items block, i.e. may
+	 * the caller take over its tag pool references?
+	 */
+	[[gnu::pure]]
+	bool HasUniqueItems() const noexcept {
+		return items == nullptr ||
+			std::atomic_ref{items[-1]}.load(std::memory_order_acquire) == 1;
+	}
+
+	/**
+	 * Returns the #TagType of each item (as uint8_t to allow
+	 * accessing the #items block with byte operations).
+	 */
+	const uint8_t *GetTypes() const noexcept {
+		return reinterpret_cast<const uint8_t *>(items + num_items);
+	}
+
+	uint8_t *GetTypes() noexcept {
+		return reinterpret_cast<uint8_t *>(items + num_items);
+	}
+
 	/**
 	 * Similar to the move operator, but move only the #TagItem
 	 * array.
@@ -149,8 +220,45 @@ struct Tag {
 	[[gnu::pure]] [[gnu::returns_nonnull]]
 	const char *GetSortValue(TagType type) const noexcept;
 
-	using const_iterator = DereferenceIterator<TagItem *const*,
-						   const TagItem>;
+	/**
+	 * An iterator which resolves the tag pool indices in #items.
+	 */
+	class const_iterator {
+		const uint32_t *i;
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+		using value_type = const TagItem;
+		using pointer = const TagItem *;
+		using reference = const TagItem &;
+
+		const_iterator() = default;
+
+		explicit constexpr const_iterator(const uint32_t *_i) noexcept
+			:i(_i) {}
+
+		reference operator*() const noexcept {
+			return tag_pool_item_at(*i);
+		}
+
+		pointer operator->() const noexcept {
+			return &tag_pool_item_at(*i);
+		}
+
+		constexpr auto &operator++() noexcept {
+			++i;
+			return *this;
+		}
+
+		constexpr auto operator++(int) noexcept {
+			auto old = *this;
+			++i;
+			return old;
+		}
+
+		constexpr bool operator==(const const_iterator &) const noexcept = default;
+	};
 
 	const_iterator begin() const noexcept {
 		return const_iterator{items};
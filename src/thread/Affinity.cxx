@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "Affinity.hxx"
+#include "system/Error.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static unsigned
+ParseCpuNumber(std::string_view s)
+{
+	unsigned value;
+	if (!ParseIntegerTo(Strip(s), value))
+		throw std::invalid_argument{"Malformed CPU number"};
+
+	if (value >= CpuAffinity::MAX_CPUS)
+		throw std::invalid_argument{"CPU number is too large"};
+
+	return value;
+}
+
+CpuAffinity
+CpuAffinity::Parse(std::string_view s)
+{
+	CpuAffinity result;
+
+	for (const std::string_view item : IterableSplitString(s, ',')) {
+		const auto [first_s, last_s] = Split(item, '-');
+		const unsigned first = ParseCpuNumber(first_s);
+		const unsigned last = last_s.data() != nullptr
+			? ParseCpuNumber(last_s)
+			: first;
+		if (last < first)
+			throw std::invalid_argument{"Malformed CPU range"};
+
+		for (unsigned i = first; i <= last; ++i)
+			result.mask.set(i);
+	}
+
+	if (!result.IsDefined())
+		throw std::invalid_argument{"Empty CPU list"};
+
+	return result;
+}
+
+void
+CpuAffinity::Apply() const
+{
+	if (!IsDefined())
+		return;
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned i = 0; i < MAX_CPUS && i < CPU_SETSIZE; ++i)
+		if (mask.test(i))
+			CPU_SET(i, &set);
+
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		throw MakeErrno("sched_setaffinity() failed");
+#endif
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <bitset>
+#include <string_view>
+
+/**
+ * A set of CPUs a thread is allowed to run on.
+ */
+class CpuAffinity {
+public:
+	static constexpr unsigned MAX_CPUS = 1024;
+
+private:
+	std::bitset<MAX_CPUS> mask;
+
+public:
+	/**
+	 * Is at least one CPU in the set?  An empty set means "no
+	 * restriction".
+	 */
+	bool IsDefined() const noexcept {
+		return mask.any();
+	}
+
+	/**
+	 * Parse a comma-separated list of CPU numbers and ranges,
+	 * e.g. "0-3,6".
+	 *
+	 * Throws std::invalid_argument on error.
+	 */
+	static CpuAffinity Parse(std::string_view s);
+
+	/**
+	 * Restrict the current thread to the CPUs in this set.  Does
+	 * nothing if the set is empty or if the operating system
+	 * doesn't support this.
+	 *
+	 * Throws std::system_error on error.
+	 */
+	void Apply() const;
+};
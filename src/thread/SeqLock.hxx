@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * A sequence lock: a small trivially copyable value which can be
+ * read by any number of threads without locking, while one thread at
+ * a time replaces it.  Readers never block the writer; they retry if
+ * a write was in progress while they were copying the value.
+ *
+ * The value is stored in an array of atomic words, therefore the
+ * concurrent copy is not a data race.
+ *
+ * Writers must be serialized by the caller (e.g. by holding a
+ * mutex).
+ */
+template<typename T>
+class SeqLock {
+	static_assert(std::is_trivially_copyable_v<T>);
+	static_assert(std::is_default_constructible_v<T>);
+
+	using Word = std::uintptr_t;
+	static constexpr std::size_t N = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+	/**
+	 * Odd while a write is in progress.
+	 */
+	std::atomic<unsigned> sequence{0};
+
+	std::array<std::atomic<Word>, N> data{};
+
+public:
+	void Store(const T &value) noexcept {
+		std::array<Word, N> words{};
+		std::memcpy(words.data(), &value, sizeof(value));
+
+		const unsigned s = sequence.load(std::memory_order_relaxed);
+		sequence.store(s + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (std::size_t i = 0; i < N; ++i)
+			data[i].store(words[i], std::memory_order_relaxed);
+
+		sequence.store(s + 2, std::memory_order_release);
+	}
+
+	T Load() const noexcept {
+		std::array<Word, N> words;
+		unsigned s1, s2;
+
+		do {
+			s1 = sequence.load(std::memory_order_acquire);
+
+			for (std::size_t i = 0; i < N; ++i)
+				words[i] = data[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s2 = sequence.load(std::memory_order_relaxed);
+		} while (s1 != s2 || (s1 & 1) != 0);
+
+		T value;
+		std::memcpy(static_cast<void *>(&value), words.data(),
+			    sizeof(value));
+		return value;
+	}
+};
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: BSD-2-Clause
+// author: Max Kellermann <max.kellermann@gmail.com>
+
+#pragma once
+
+#ifdef _WIN32
+
+#include <synchapi.h>
+
+/**
+ * Wrapper for a SRWLOCK, backend for the SharedMutex class.
+ */
+class SharedMutex {
+	SRWLOCK srwlock = SRWLOCK_INIT;
+
+public:
+	SharedMutex() noexcept = default;
+
+	SharedMutex(const SharedMutex &other) = delete;
+	SharedMutex &operator=(const SharedMutex &other) = delete;
+
+	void lock() noexcept {
+		::AcquireSRWLockExclusive(&srwlock);
+	}
+
+	bool try_lock() noexcept {
+		return ::TryAcquireSRWLockExclusive(&srwlock) != 0;
+	}
+
+	void unlock() noexcept {
+		::ReleaseSRWLockExclusive(&srwlock);
+	}
+
+	void lock_shared() noexcept {
+		::AcquireSRWLockShared(&srwlock);
+	}
+
+	bool try_lock_shared() noexcept {
+		return ::TryAcquireSRWLockShared(&srwlock) != 0;
+	}
+
+	void unlock_shared() noexcept {
+		::ReleaseSRWLockShared(&srwlock);
+	}
+};
+
+#else
+
+#include <shared_mutex>
+
+using SharedMutex = std::shared_mutex;
+
+#endif
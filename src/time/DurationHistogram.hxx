@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A histogram of durations.
+ *
+ * @param _LIMITS the upper limits of all buckets except for the last
+ * one, which counts everything above
+ */
+template<std::size_t N,
+	 const std::array<std::chrono::microseconds, N> &_LIMITS>
+struct DurationHistogram {
+	using Duration = std::chrono::steady_clock::duration;
+
+	static constexpr auto &LIMITS = _LIMITS;
+
+	std::array<uint_least64_t, N + 1> counts{};
+
+	/**
+	 * The sum of all durations.
+	 */
+	Duration total{};
+
+	/**
+	 * The number of durations.
+	 */
+	uint_least64_t calls = 0;
+
+	void Add(Duration d) noexcept {
+		std::size_t i = 0;
+		while (i < LIMITS.size() && d > LIMITS[i])
+			++i;
+
+		++counts[i];
+		total += d;
+		++calls;
+	}
+
+	void Add(const DurationHistogram &other) noexcept {
+		for (std::size_t i = 0; i < counts.size(); ++i)
+			counts[i] += other.counts[i];
+		total += other.total;
+		calls += other.calls;
+	}
+};
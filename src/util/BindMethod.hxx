@@ -51,6 +51,15 @@ public:
 	R operator()(Args... args) const noexcept(NoExcept) {
 		return function(instance_, std::forward<Args>(args)...);
 	}
+
+	/**
+	 * Return the address of the function which gets invoked
+	 * (for diagnostics only; it may be resolved to a symbol
+	 * name with a debugger).
+	 */
+	const void *GetFunctionAddress() const noexcept {
+		return reinterpret_cast<const void *>(function);
+	}
 };
 
 namespace BindMethodDetail {
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the throughput of parsing the most frequent command lines:
+ * tokenizing, looking up the command name and parsing the numeric
+ * arguments, as done by command_process().
+ */
+
+#include "command/HotCommands.hxx"
+#include "protocol/ArgParser.hxx"
+#include "util/Tokenizer.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr const char *lines[] = {
+	"status",
+	"currentsong",
+	"idle player mixer",
+	"ping",
+	"playid 42",
+	"setvol 75",
+	"setvol \"80\"",
+	"stats",
+};
+
+template<typename F>
+static void
+Bench(const char *name, unsigned n_iterations, F &&f) noexcept
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < n_iterations; ++i)
+		f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	const double lines_per_second =
+		double(std::size(lines)) * n_iterations / duration.count();
+	printf("%-16s %8.2f Mlines/s\n", name, lines_per_second / 1e6);
+}
+
+/**
+ * The binary search which command_lookup() falls back to, for
+ * comparison.
+ */
+[[gnu::pure]]
+static std::size_t
+BinarySearchHotCommand(std::string_view name) noexcept
+{
+	const auto i = std::lower_bound(hot_command_names.begin(),
+					hot_command_names.end(), name,
+					[](std::string_view a, std::string_view b){
+						return a < b;
+					});
+	if (i == hot_command_names.end() || name != *i)
+		return hot_command_names.size();
+
+	return std::distance(hot_command_names.begin(), i);
+}
+
+template<typename L>
+static unsigned
+ParseLine(const char *src, L &&lookup)
+{
+	char buffer[256];
+	strcpy(buffer, src);
+
+	Tokenizer tokenizer{buffer};
+	const char *name = tokenizer.NextWord();
+	const std::size_t i = lookup(name);
+
+	unsigned result = i;
+	while (const char *arg = tokenizer.NextParam())
+		if (i < hot_command_names.size() && *arg >= '0' && *arg <= '9')
+			result += ParseCommandArgUnsigned(arg);
+
+	return result;
+}
+
+int
+main(int argc, char **argv) noexcept
+try {
+	const unsigned n_iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 1000000;
+
+	/* prevent the compiler from optimizing the loops away */
+	volatile unsigned sink = 0;
+
+	Bench("hash", n_iterations, [&sink]{
+		for (const char *line : lines)
+			sink = sink + ParseLine(line, FindHotCommand);
+	});
+
+	Bench("binary search", n_iterations, [&sink]{
+		for (const char *line : lines)
+			sink = sink + ParseLine(line, BinarySearchHotCommand);
+	});
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	return EXIT_FAILURE;
+}
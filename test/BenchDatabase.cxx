@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the performance of the "simple" database plugin: loading,
+ * saving, filtered and sorted/windowed Visit() calls and
+ * CollectUniqueTags().  Usage:
+ *
+ *   BenchDatabase [OPTIONS] PATH
+ *
+ * With --songs=N, a synthetic library is generated and written to
+ * PATH (which is overwritten) first; its layout resembles a chiptune
+ * collection: a deep tree of small directories, one album each.
+ * Without --songs, PATH must be an existing database file; it is
+ * only read, and the "save" measurement is skipped.
+ *
+ * The results are printed to stdout as "name: value" lines;
+ * durations are the average of all repetitions in seconds.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/plugins/simple/DatabaseSave.hxx"
+#include "db/plugins/simple/BinaryDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/Selection.hxx"
+#include "db/Stats.hxx"
+#include "song/Filter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Type.hxx"
+#include "io/FileOutputStream.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/NarrowPath.hxx"
+#include "lib/icu/Init.hxx"
+#include "cmdline/OptionDef.hxx"
+#include "cmdline/OptionParser.hxx"
+#include "util/RecursiveMap.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/PrintException.hxx"
+#include "LogBackend.hxx"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <stdlib.h>
+
+using FloatSeconds = std::chrono::duration<double>;
+
+struct CommandLine {
+	FromNarrowPath path;
+
+	/**
+	 * The number of songs to be generated; 0 means use the
+	 * existing database file.
+	 */
+	unsigned n_songs = 0;
+
+	/**
+	 * The number of distinct "Artist" and "Genre" values.
+	 */
+	unsigned n_artists = 2000, n_genres = 20;
+
+	/**
+	 * The number of subdirectories per directory and the depth
+	 * of the generated tree; songs are only in the deepest
+	 * level.
+	 */
+	unsigned fanout = 32, depth = 3;
+
+	unsigned songs_per_directory = 12;
+
+	unsigned repeat = 10;
+
+	bool binary = false, compress = false, tag_index = true;
+};
+
+enum Option {
+	OPTION_SONGS,
+	OPTION_ARTISTS,
+	OPTION_GENRES,
+	OPTION_FANOUT,
+	OPTION_DEPTH,
+	OPTION_SONGS_PER_DIRECTORY,
+	OPTION_REPEAT,
+	OPTION_BINARY,
+	OPTION_COMPRESS,
+	OPTION_NO_TAG_INDEX,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"songs", 0, true, "Generate a database with this number of songs"},
+	{"artists", 0, true, "The number of distinct artists"},
+	{"genres", 0, true, "The number of distinct genres"},
+	{"fanout", 0, true, "The number of subdirectories per directory"},
+	{"depth", 0, true, "The depth of the directory tree"},
+	{"songs-per-directory", 0, true, "The number of songs per directory"},
+	{"repeat", 0, true, "Repeat each measurement this number of times"},
+	{"binary", 0, false, "Save in the binary format"},
+	{"compress", 0, false, "Save with gzip compression"},
+	{"no-tag-index", 0, false, "Disable the tag index"},
+};
+
+static unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const auto value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0)
+		throw std::runtime_error("Failed to parse integer");
+
+	return value;
+}
+
+static unsigned
+ParsePositive(const char *s)
+{
+	const unsigned value = ParseUnsigned(s);
+	if (value == 0)
+		throw std::runtime_error("Value must be positive");
+
+	return value;
+}
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_SONGS:
+			c.n_songs = ParseUnsigned(o.value);
+			break;
+
+		case OPTION_ARTISTS:
+			c.n_artists = ParsePositive(o.value);
+			break;
+
+		case OPTION_GENRES:
+			c.n_genres = ParsePositive(o.value);
+			break;
+
+		case OPTION_FANOUT:
+			c.fanout = ParsePositive(o.value);
+			break;
+
+		case OPTION_DEPTH:
+			c.depth = ParsePositive(o.value);
+			break;
+
+		case OPTION_SONGS_PER_DIRECTORY:
+			c.songs_per_directory = ParsePositive(o.value);
+			break;
+
+		case OPTION_REPEAT:
+			c.repeat = ParsePositive(o.value);
+			break;
+
+		case OPTION_BINARY:
+			c.binary = true;
+			break;
+
+		case OPTION_COMPRESS:
+			c.compress = true;
+			break;
+
+		case OPTION_NO_TAG_INDEX:
+			c.tag_index = false;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.size() != 1)
+		throw std::runtime_error("Usage: BenchDatabase [OPTIONS] PATH");
+
+	c.path = args.front();
+	return c;
+}
+
+/**
+ * Returns the (newly created) leaf directory for the given index.
+ * The index is split into #depth digits with base #fanout, one
+ * directory level per digit; only the top level may have more than
+ * #fanout entries.
+ */
+static Directory &
+MakeLeafDirectory(Directory &root, const CommandLine &c, unsigned i) noexcept
+{
+	Directory *directory = &root;
+
+	unsigned divisor = 1;
+	for (unsigned level = 1; level < c.depth; ++level)
+		divisor *= c.fanout;
+
+	for (unsigned level = 0; level < c.depth; ++level) {
+		unsigned digit = i / divisor;
+		if (level > 0)
+			digit %= c.fanout;
+
+		directory = directory->MakeChild(fmt::format("d{:03}", digit));
+		divisor = std::max(divisor / c.fanout, 1U);
+	}
+
+	return *directory;
+}
+
+/**
+ * Generate a synthetic library and save it to the configured path.
+ * Each leaf directory contains one album by one artist, and all
+ * songs have a shuffled "Last-Modified" and "Added" time.
+ */
+static void
+Generate(const CommandLine &c)
+{
+	std::minstd_rand rng;
+	std::uniform_int_distribution<unsigned> artist_dist(0, c.n_artists - 1);
+	std::uniform_int_distribution<unsigned> genre_dist(0, c.n_genres - 1);
+	std::uniform_int_distribution<unsigned> mtime_dist(0, 20 * 365 * 24 * 3600);
+
+	const auto epoch = std::chrono::system_clock::from_time_t(946684800);
+
+	Directory *root = Directory::NewRoot();
+	AtScopeExit(root) { delete root; };
+
+	const ScopeDatabaseLock protect;
+
+	Directory *directory = nullptr;
+	unsigned artist = 0, genre = 0;
+
+	for (unsigned i = 0; i < c.n_songs; ++i) {
+		const unsigned track = i % c.songs_per_directory;
+		const unsigned album = i / c.songs_per_directory;
+
+		if (track == 0) {
+			directory = &MakeLeafDirectory(*root, c, album);
+			artist = artist_dist(rng);
+			genre = genre_dist(rng);
+		}
+
+		auto song = std::make_unique<Song>(fmt::format("{:02} Track.vgm", track + 1),
+						   *directory);
+
+		TagBuilder tag;
+		tag.AddItem(TAG_ARTIST, fmt::format("Artist {}", artist));
+		tag.AddItem(TAG_ALBUM, fmt::format("Album {}", album));
+		tag.AddItem(TAG_TITLE, fmt::format("Title {}", i));
+		tag.AddItem(TAG_TRACK, fmt::format("{}", track + 1));
+		tag.AddItem(TAG_GENRE, fmt::format("Genre {}", genre));
+		tag.AddItem(TAG_DATE, fmt::format("{}", 1980 + album % 30));
+		tag.SetDuration(SignedSongTime::FromS(60 + i % 240));
+		song->tag = tag.Commit();
+
+		song->mtime = epoch + std::chrono::seconds(mtime_dist(rng));
+		song->added = song->mtime + std::chrono::hours(1);
+		song->audio_format = {44100, SampleFormat::S16, 2};
+
+		directory->AddSong(std::move(song));
+	}
+
+	root->Sort();
+
+	FileOutputStream fos(c.path);
+	BufferedOutputStream bos(fos);
+
+	if (c.binary)
+		db_save_binary(bos, *root);
+	else
+		db_save_internal(bos, *root);
+
+	bos.Flush();
+	fos.Commit();
+}
+
+template<typename F>
+static void
+Bench(const char *name, unsigned n, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < n; ++i)
+		f();
+	const FloatSeconds duration = std::chrono::steady_clock::now() - start;
+
+	fmt::print("{}: {:.6f}\n", name, duration.count() / n);
+}
+
+static SongFilter
+ParseFilter(const char *expression)
+{
+	SongFilter filter;
+	const char *const args[] = {expression};
+	filter.Parse(args);
+	filter.Optimize();
+	return filter;
+}
+
+static void
+BenchVisit(const Database &db, unsigned repeat, const char *name,
+	   const DatabaseSelection &selection)
+{
+	std::size_t n = 0;
+	Bench(name, repeat, [&]{
+		n = 0;
+		db.Visit(selection, [&n](const LightSong &){ ++n; });
+	});
+
+	fmt::print("{}_songs: {}\n", name, n);
+}
+
+static void
+BenchVisit(const Database &db, unsigned repeat, const char *name,
+	   const char *expression,
+	   TagType sort=TAG_NUM_OF_ITEM_TYPES,
+	   RangeArg window=RangeArg::All(),
+	   bool descending=false)
+{
+	const auto filter = expression != nullptr
+		? ParseFilter(expression)
+		: SongFilter{};
+
+	DatabaseSelection selection{"", true,
+				    expression != nullptr ? &filter : nullptr};
+	selection.sort = sort;
+	selection.descending = descending;
+	selection.window = window;
+
+	BenchVisit(db, repeat, name, selection);
+}
+
+static void
+BenchUniqueTags(const Database &db, unsigned repeat, const char *name,
+		std::span<const TagType> tag_types,
+		const char *expression=nullptr)
+{
+	const auto filter = expression != nullptr
+		? ParseFilter(expression)
+		: SongFilter{};
+
+	const DatabaseSelection selection{"", true,
+					  expression != nullptr ? &filter : nullptr};
+
+	std::size_t n = 0;
+	Bench(name, repeat, [&]{
+		n = db.CollectUniqueTags(selection, tag_types).size();
+	});
+
+	fmt::print("{}_values: {}\n", name, n);
+}
+
+int main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	SetLogThreshold(LogLevel::WARNING);
+	const ScopeIcuInit icu_init;
+
+	if (c.n_songs > 0) {
+		const auto start = std::chrono::steady_clock::now();
+		Generate(c);
+		const FloatSeconds duration = std::chrono::steady_clock::now() - start;
+		fmt::print("generate: {:.6f}\n", duration.count());
+	}
+
+	SimpleDatabase db{AllocatedPath{c.path}, c.compress, c.binary,
+			  true, c.tag_index};
+
+	db.Open();
+
+	const auto stats = db.GetStats(DatabaseSelection{"", true});
+	fmt::print("songs: {}\n"
+		   "artists: {}\n"
+		   "albums: {}\n",
+		   stats.song_count, stats.artist_count, stats.album_count);
+
+	if (c.n_songs > 0)
+		Bench("save", c.repeat, [&]{ db.Save(); });
+
+	Bench("open", c.repeat, [&]{
+		db.Close();
+		db.Open();
+	});
+
+	BenchVisit(db, c.repeat, "visit_all", nullptr);
+	BenchVisit(db, c.repeat, "visit_artist",
+		   "(Artist == \"Artist 17\")");
+	BenchVisit(db, c.repeat, "visit_artist_album",
+		   "((Artist == \"Artist 17\") AND (Album != \"Album 0\"))");
+	BenchVisit(db, c.repeat, "visit_title_contains",
+		   "(Title contains \"le 12\")");
+	BenchVisit(db, c.repeat, "visit_base",
+		   "(base \"d001\")");
+	BenchVisit(db, c.repeat, "visit_modified_since",
+		   "(modified-since \"2015-01-01T00:00:00Z\")");
+	BenchVisit(db, c.repeat, "visit_added_since",
+		   "(added-since \"2019-06-01T00:00:00Z\")");
+
+	BenchVisit(db, c.repeat, "sorted_title_window", nullptr,
+		   TAG_TITLE, RangeArg{0, 100});
+	BenchVisit(db, c.repeat, "sorted_modified_window", nullptr,
+		   TagType(SORT_TAG_LAST_MODIFIED), RangeArg{0, 100});
+	BenchVisit(db, c.repeat, "sorted_added_since_window",
+		   "(added-since \"2015-01-01T00:00:00Z\")",
+		   TagType(SORT_TAG_ADDED), RangeArg{0, 100}, true);
+	BenchVisit(db, c.repeat, "sorted_genre_artist_window",
+		   "(Genre == \"Genre 3\")",
+		   TAG_ARTIST, RangeArg{100, 200});
+
+	static constexpr TagType artist[] = {TAG_ARTIST};
+	static constexpr TagType album[] = {TAG_ALBUM};
+	static constexpr TagType genre_album[] = {TAG_GENRE, TAG_ALBUM};
+
+	BenchUniqueTags(db, c.repeat, "unique_artist", artist);
+	BenchUniqueTags(db, c.repeat, "unique_genre_album", genre_album);
+	BenchUniqueTags(db, c.repeat, "unique_album_by_genre", album,
+			"(Genre == \"Genre 3\")");
+
+	db.Close();
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,353 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the throughput of decoder plugins: decode each file
+ * completely without output, then measure the latency of seeking to
+ * 25%, 50% and 75% of its duration.  Usage:
+ *
+ *   BenchDecoder [--config=FILE] [--no-seek] DECODER URI [DECODER URI ...]
+ *
+ * The results are printed to stdout, one block of "name: value"
+ * lines per file (separated by empty lines); durations are in
+ * seconds.
+ */
+
+#include "ConfigGlue.hxx"
+#include "event/Thread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "decoder/DecoderAPI.hxx" /* for class StopDecoder */
+#include "DumpDecoderClient.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "fs/Path.hxx"
+#include "fs/NarrowPath.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "lib/fmt/AudioFormatFormatter.hxx"
+#include "cmdline/OptionDef.hxx"
+#include "cmdline/OptionParser.hxx"
+#include "util/PrintException.hxx"
+#include "LogBackend.hxx"
+
+#include <fmt/format.h>
+
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include <stdlib.h>
+#include <sys/resource.h>
+
+using FloatSeconds = std::chrono::duration<double>;
+
+struct CommandLine {
+	/**
+	 * Pairs of decoder plugin names and URIs.
+	 */
+	std::vector<std::pair<const char *, const char *>> files;
+
+	FromNarrowPath config_path;
+
+	bool seek = true;
+};
+
+enum Option {
+	OPTION_CONFIG,
+	OPTION_NO_SEEK,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"config", 0, true, "Load a MPD configuration file"},
+	{"no-seek", 0, false, "Don't measure seek latency"},
+};
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_CONFIG:
+			c.config_path = o.value;
+			break;
+
+		case OPTION_NO_SEEK:
+			c.seek = false;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.empty() || args.size() % 2 != 0)
+		throw std::runtime_error("Usage: BenchDecoder [--config=FILE] [--no-seek] DECODER URI [DECODER URI ...]");
+
+	for (std::size_t i = 0; i < args.size(); i += 2)
+		c.files.emplace_back(args[i], args[i + 1]);
+
+	return c;
+}
+
+class GlobalInit {
+	const ConfigData config;
+	EventThread io_thread;
+	const ScopeInputPluginsInit input_plugins_init;
+	const ScopeDecoderPluginsInit decoder_plugins_init;
+
+public:
+	explicit GlobalInit(Path config_path)
+		:config(AutoLoadConfigFile(config_path)),
+		 input_plugins_init(config, io_thread.GetEventLoop()),
+		 decoder_plugins_init(config)
+	{
+		io_thread.Start();
+	}
+};
+
+/**
+ * A #DumpDecoderClient which discards all data and counts the
+ * decoded audio.  Optionally, it seeks first and stops after the
+ * first chunk following the seek.
+ */
+class BenchDecoderClient final : public DumpDecoderClient {
+	using Clock = std::chrono::steady_clock;
+
+	SongTime seek_where;
+
+	bool seek_pending;
+
+	/**
+	 * Has the seek been finished, and are we waiting for the
+	 * first chunk?
+	 */
+	bool seek_finished = false;
+
+	Clock::time_point seek_start;
+
+	bool seekable = false;
+
+public:
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	SignedSongTime duration = SignedSongTime::Negative();
+
+	uint_least64_t n_submits = 0, n_bytes = 0;
+
+	/**
+	 * The time from the seek command until the first chunk
+	 * after it arrived; negative if there was no seek or if it
+	 * has failed.
+	 */
+	FloatSeconds seek_latency{-1};
+
+	explicit BenchDecoderClient(SongTime _seek_where={}) noexcept
+		:seek_where(_seek_where), seek_pending(_seek_where != SongTime{}) {}
+
+	bool IsSeekable() const noexcept {
+		return seekable;
+	}
+
+	/**
+	 * Returns the duration of the decoded audio.
+	 */
+	FloatSeconds GetDecodedDuration() const noexcept {
+		return audio_format.IsDefined()
+			? audio_format.SizeToTime<FloatSeconds>(n_bytes)
+			: FloatSeconds{};
+	}
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat _audio_format,
+		   bool _seekable, SignedSongTime _duration) noexcept override {
+		DumpDecoderClient::Ready(_audio_format, _seekable, _duration);
+		audio_format = _audio_format;
+		seekable = _seekable;
+		duration = _duration;
+	}
+
+	DecoderCommand GetCommand() noexcept override {
+		if (seek_where == SongTime{} || seek_finished)
+			return DecoderCommand::NONE;
+
+		if (!seek_pending || !seekable)
+			/* the seek has failed */
+			return DecoderCommand::STOP;
+
+		if (seek_start == Clock::time_point{})
+			seek_start = Clock::now();
+
+		return DecoderCommand::SEEK;
+	}
+
+	void CommandFinished() noexcept override {
+		assert(seek_pending);
+
+		seek_pending = false;
+		seek_finished = true;
+	}
+
+	SongTime GetSeekTime() noexcept override {
+		return seek_where;
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return seek_where.ToScale<uint64_t>(audio_format.sample_rate);
+	}
+
+	void SeekError(std::exception_ptr &&) noexcept override {
+		seek_pending = false;
+	}
+
+	DecoderCommand SubmitAudio(InputStream *,
+				   std::span<const std::byte> audio,
+				   uint16_t) noexcept override {
+		if (seek_finished) {
+			seek_latency = Clock::now() - seek_start;
+			return DecoderCommand::STOP;
+		}
+
+		if (seek_where != SongTime{})
+			/* audio before the seek is ignored */
+			return GetCommand();
+
+		++n_submits;
+		n_bytes += audio.size();
+		return DecoderCommand::NONE;
+	}
+
+	DecoderCommand SubmitTag(InputStream *, Tag &&) noexcept override {
+		return GetCommand();
+	}
+
+	void SubmitReplayGain(const ReplayGainInfo *) noexcept override {
+	}
+
+	void SubmitMixRamp(MixRampInfo &&) noexcept override {
+	}
+};
+
+static void
+Decode(const DecoderPlugin &plugin, const char *uri, BenchDecoderClient &client)
+try {
+	if (plugin.SupportsUri(uri)) {
+		plugin.UriDecode(client, uri);
+	} else if (plugin.file_decode != nullptr) {
+		plugin.FileDecode(client, FromNarrowPath(uri));
+	} else if (plugin.stream_decode != nullptr) {
+		auto is = InputStream::OpenReady(uri, client.mutex);
+		plugin.StreamDecode(client, *is);
+	} else
+		throw std::runtime_error("Decoder plugin is not usable");
+} catch (StopDecoder) {
+}
+
+/**
+ * Returns the peak resident set size of this process in kilobytes.
+ */
+static long
+GetMaxRss() noexcept
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return -1;
+
+	return usage.ru_maxrss;
+}
+
+static void
+BenchSeek(const DecoderPlugin &plugin, const char *uri,
+	  SongTime duration, unsigned percent)
+{
+	BenchDecoderClient client{SongTime::FromMS(duration.ToMS() * percent / 100)};
+	Decode(plugin, uri, client);
+
+	if (client.seek_latency.count() >= 0)
+		fmt::print("seek_{}: {:.6f}\n", percent, client.seek_latency.count());
+	else
+		fmt::print("seek_{}: error\n", percent);
+}
+
+static void
+BenchFile(const DecoderPlugin &plugin, const char *uri, bool seek)
+{
+	fmt::print("uri: {}\n"
+		   "plugin: {}\n",
+		   uri, plugin.name);
+
+	BenchDecoderClient client;
+
+	const auto start = std::chrono::steady_clock::now();
+	Decode(plugin, uri, client);
+	const FloatSeconds decode_time = std::chrono::steady_clock::now() - start;
+
+	if (!client.IsInitialized())
+		throw std::runtime_error("Unrecognized file");
+
+	const auto decoded = client.GetDecodedDuration();
+
+	fmt::print("audio_format: {}\n"
+		   "duration: {:.3f}\n"
+		   "decode_time: {:.6f}\n",
+		   client.audio_format, decoded.count(),
+		   decode_time.count());
+
+	if (decode_time.count() > 0)
+		fmt::print("realtime_factor: {:.2f}\n",
+			   decoded / decode_time);
+
+	if (client.n_submits > 0)
+		fmt::print("submits: {}\n"
+			   "bytes_per_submit: {}\n"
+			   "time_per_submit: {:.9f}\n",
+			   client.n_submits,
+			   client.n_bytes / client.n_submits,
+			   decode_time.count() / client.n_submits);
+
+	if (seek && client.IsSeekable() && !client.duration.IsNegative() &&
+	    client.duration.ToMS() > 0)
+		for (const unsigned percent : {25U, 50U, 75U})
+			BenchSeek(plugin, uri, SongTime{client.duration},
+				  percent);
+
+	fmt::print("max_rss: {}\n", GetMaxRss());
+}
+
+int main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	SetLogThreshold(LogLevel::WARNING);
+	const GlobalInit init(c.config_path);
+
+	int result = EXIT_SUCCESS;
+	bool first = true;
+
+	for (const auto &[decoder, uri] : c.files) {
+		if (!first)
+			fmt::print("\n");
+		first = false;
+
+		const DecoderPlugin *plugin = decoder_plugin_from_name(decoder);
+		if (plugin == nullptr) {
+			fmt::print(stderr, "No such decoder: {}\n", decoder);
+			result = EXIT_FAILURE;
+			continue;
+		}
+
+		try {
+			BenchFile(*plugin, uri, c.seek);
+		} catch (...) {
+			fmt::print("error: 1\n");
+			PrintException(std::current_exception());
+			result = EXIT_FAILURE;
+		}
+	}
+
+	return result;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
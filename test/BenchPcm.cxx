@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the throughput of the PCM kernels tested by test_pcm with
+ * fixed buffer sizes and formats.  The results are printed as one
+ * line per kernel: the name and the time per (input) sample in
+ * nanoseconds.
+ */
+
+#include "pcm/Features.h" // for ENABLE_DSD, ENABLE_SOXR
+#include "pcm/AudioFormat.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/Mix.hxx"
+#include "pcm/Dither.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/Export.hxx"
+#include "pcm/DsdKernels.hxx"
+#include "pcm/FallbackResampler.hxx"
+#include "config/Block.hxx"
+#include "util/PrintException.hxx"
+
+#ifdef ENABLE_DSD
+#include "pcm/Dsd2Pcm.hxx"
+#endif
+
+#ifdef ENABLE_SOXR
+#include "pcm/SoxrResampler.hxx"
+#endif
+
+#ifdef ENABLE_LIBSAMPLERATE
+#include "pcm/LibsamplerateResampler.hxx"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The number of samples (not frames) in each buffer.
+ */
+static constexpr std::size_t N_SAMPLES = 4096;
+
+static constexpr unsigned CHANNELS = 2;
+
+/**
+ * Prevent the compiler from optimizing away the result.
+ */
+static volatile std::size_t sink;
+
+template<typename F>
+static void
+Bench(const char *name, unsigned n_iterations, F &&f) noexcept
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < n_iterations; ++i)
+		f();
+	const std::chrono::duration<double, std::nano> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%-24s %8.3f ns/sample\n",
+	       name, duration.count() / (double(N_SAMPLES) * n_iterations));
+}
+
+template<typename T>
+static std::span<const std::byte>
+AsBytes(const std::vector<T> &v) noexcept
+{
+	return std::as_bytes(std::span{v});
+}
+
+static void
+BenchVolume(unsigned n_iterations, const char *name, SampleFormat format,
+	    std::span<const std::byte> src)
+{
+	PcmVolume volume;
+	volume.Open(format, false);
+	volume.SetVolume(PCM_VOLUME_1 * 3 / 4);
+
+	Bench(name, n_iterations, [&]{
+		sink = volume.Apply(src).size();
+	});
+}
+
+template<typename T>
+static void
+BenchMix(unsigned n_iterations, const char *name, SampleFormat format,
+	 const std::vector<T> &src)
+{
+	std::vector<T> dest(src.size());
+	PcmDither dither;
+
+	Bench(name, n_iterations, [&]{
+		sink = pcm_mix(dither, dest.data(), src.data(),
+			       src.size() * sizeof(T), format, 0.75f);
+	});
+}
+
+static void
+BenchConvert(unsigned n_iterations, const char *name,
+	     SampleFormat src_format, SampleFormat dest_format,
+	     std::span<const std::byte> src)
+{
+	PcmFormatConverter converter;
+	converter.Open(src_format, dest_format);
+
+	Bench(name, n_iterations, [&]{
+		sink = converter.Convert(src).size();
+	});
+
+	converter.Close();
+}
+
+static void
+BenchExport(unsigned n_iterations, const char *name,
+	    SampleFormat format, PcmExport::Params params,
+	    std::span<const std::byte> src)
+{
+	PcmExport e;
+	e.Open(format, CHANNELS, params);
+
+	Bench(name, n_iterations, [&]{
+		sink = e.Export(src).size();
+	});
+}
+
+static void
+BenchResampler(unsigned n_iterations, const char *name,
+	       PcmResampler &resampler, std::span<const std::byte> src)
+{
+	AudioFormat af{44100, SampleFormat::FLOAT, CHANNELS};
+	resampler.Open(af, 48000, SampleFormat::FLOAT);
+
+	Bench(name, n_iterations, [&]{
+		sink = resampler.Resample(src).size();
+	});
+
+	resampler.Close();
+}
+
+int
+main(int argc, char **argv)
+try {
+	const unsigned n_iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 10000;
+
+	std::vector<int16_t> src16(N_SAMPLES);
+	std::vector<int32_t> src24(N_SAMPLES), src32(N_SAMPLES);
+	std::vector<float> src_float(N_SAMPLES);
+
+	for (std::size_t i = 0; i < N_SAMPLES; ++i) {
+		src16[i] = int16_t(rand());
+		src24[i] = int32_t(rand()) >> 8;
+		src32[i] = int32_t(rand());
+		src_float[i] = float(rand()) / float(RAND_MAX) * 2 - 1;
+	}
+
+	BenchVolume(n_iterations, "volume_16", SampleFormat::S16,
+		    AsBytes(src16));
+	BenchVolume(n_iterations, "volume_24", SampleFormat::S24_P32,
+		    AsBytes(src24));
+	BenchVolume(n_iterations, "volume_32", SampleFormat::S32,
+		    AsBytes(src32));
+	BenchVolume(n_iterations, "volume_float", SampleFormat::FLOAT,
+		    AsBytes(src_float));
+
+	BenchMix(n_iterations, "mix_16", SampleFormat::S16, src16);
+	BenchMix(n_iterations, "mix_24", SampleFormat::S24_P32, src24);
+	BenchMix(n_iterations, "mix_32", SampleFormat::S32, src32);
+	BenchMix(n_iterations, "mix_float", SampleFormat::FLOAT, src_float);
+
+	BenchConvert(n_iterations, "convert_16_to_24",
+		     SampleFormat::S16, SampleFormat::S24_P32,
+		     AsBytes(src16));
+	BenchConvert(n_iterations, "convert_16_to_float",
+		     SampleFormat::S16, SampleFormat::FLOAT,
+		     AsBytes(src16));
+	BenchConvert(n_iterations, "convert_24_to_16",
+		     SampleFormat::S24_P32, SampleFormat::S16,
+		     AsBytes(src24));
+	BenchConvert(n_iterations, "convert_32_to_16",
+		     SampleFormat::S32, SampleFormat::S16,
+		     AsBytes(src32));
+	BenchConvert(n_iterations, "convert_float_to_16",
+		     SampleFormat::FLOAT, SampleFormat::S16,
+		     AsBytes(src_float));
+	BenchConvert(n_iterations, "convert_float_to_32",
+		     SampleFormat::FLOAT, SampleFormat::S32,
+		     AsBytes(src_float));
+
+	{
+		PcmExport::Params params;
+		params.pack24 = true;
+		BenchExport(n_iterations, "export_pack24",
+			    SampleFormat::S24_P32, params, AsBytes(src24));
+	}
+
+	{
+		PcmExport::Params params;
+		params.shift8 = true;
+		BenchExport(n_iterations, "export_shift8",
+			    SampleFormat::S24_P32, params, AsBytes(src24));
+	}
+
+	{
+		PcmExport::Params params;
+		params.reverse_endian = true;
+		BenchExport(n_iterations, "export_reverse_endian_16",
+			    SampleFormat::S16, params, AsBytes(src16));
+	}
+
+#ifdef ENABLE_DSD
+	/* one DSD "sample" is one byte, i.e. 8 bits of one
+	   channel */
+	std::vector<std::byte> src_dsd(N_SAMPLES);
+	for (auto &i : src_dsd)
+		i = std::byte(rand());
+
+	{
+		PcmExport::Params params;
+		params.dsd_mode = PcmExport::DsdMode::DOP;
+		BenchExport(n_iterations, "export_dop",
+			    SampleFormat::DSD, params, src_dsd);
+	}
+
+	{
+		PcmExport::Params params;
+		params.dsd_mode = PcmExport::DsdMode::U16;
+		BenchExport(n_iterations, "export_dsd_u16",
+			    SampleFormat::DSD, params, src_dsd);
+	}
+
+	{
+		PcmExport::Params params;
+		params.dsd_mode = PcmExport::DsdMode::U32;
+		BenchExport(n_iterations, "export_dsd_u32",
+			    SampleFormat::DSD, params, src_dsd);
+	}
+
+	/* each DSD kernel with each instruction set */
+	for (const auto *k : GetAvailablePcmDsdKernels()) {
+		std::vector<uint32_t> dest32(N_SAMPLES / 2);
+		Bench(("dop_" + std::string{k->name}).c_str(), n_iterations, [&]{
+			k->dsd_to_dop(dest32.data(), src_dsd.data(),
+				      N_SAMPLES / (4 * CHANNELS), CHANNELS);
+		});
+
+		std::vector<uint16_t> dest16(N_SAMPLES / 2);
+		Bench(("dsd_u16_" + std::string{k->name}).c_str(), n_iterations, [&]{
+			k->dsd8_to_16(dest16.data(), src_dsd.data(),
+				      N_SAMPLES / (2 * CHANNELS), CHANNELS);
+		});
+
+		Bench(("dsd_u32_" + std::string{k->name}).c_str(), n_iterations, [&]{
+			k->dsd8_to_32(dest32.data(), src_dsd.data(),
+				      N_SAMPLES / (4 * CHANNELS), CHANNELS);
+		});
+
+		auto reversed = src_dsd;
+		Bench(("bit_reverse_" + std::string{k->name}).c_str(), n_iterations, [&]{
+			k->bit_reverse(reversed.data(), reversed.size());
+		});
+	}
+
+	{
+		MultiDsd2Pcm dsd2pcm;
+		std::vector<float> dest(N_SAMPLES);
+		Bench("dsd2pcm_float", n_iterations, [&]{
+			dsd2pcm.Translate(CHANNELS, N_SAMPLES / CHANNELS,
+					  src_dsd.data(), dest.data());
+		});
+
+		std::vector<int32_t> dest24(N_SAMPLES);
+		Bench("dsd2pcm_24", n_iterations, [&]{
+			dsd2pcm.TranslateS24(CHANNELS, N_SAMPLES / CHANNELS,
+					     src_dsd.data(), dest24.data());
+		});
+	}
+#endif
+
+	{
+		FallbackPcmResampler resampler;
+		BenchResampler(n_iterations, "resample_fallback",
+			       resampler, AsBytes(src_float));
+	}
+
+#ifdef ENABLE_SOXR
+	{
+		pcm_resample_soxr_global_init(ConfigBlock{});
+		SoxrPcmResampler resampler;
+		BenchResampler(n_iterations, "resample_soxr",
+			       resampler, AsBytes(src_float));
+	}
+#endif
+
+#ifdef ENABLE_LIBSAMPLERATE
+	{
+		pcm_resample_lsr_global_init(ConfigBlock{});
+		LibsampleratePcmResampler resampler;
+		BenchResampler(n_iterations, "resample_libsamplerate",
+			       resampler, AsBytes(src_float));
+	}
+#endif
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
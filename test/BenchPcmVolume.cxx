@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * Measure the throughput of all #PcmVolumeKernels supported by this
+ * CPU.
+ */
+
+#include "pcm/VolumeKernels.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/Dither.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr std::size_t N_SAMPLES = 4096;
+
+template<typename F>
+static void
+Bench(const char *kernel_name, const char *function_name,
+      unsigned n_iterations, F &&f) noexcept
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < n_iterations; ++i)
+		f();
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	const double samples_per_second =
+		double(N_SAMPLES) * n_iterations / duration.count();
+	printf("%-8s %-16s %8.1f Msamples/s\n",
+	       kernel_name, function_name, samples_per_second / 1e6);
+}
+
+int
+main(int argc, char **argv) noexcept
+{
+	const unsigned n_iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 10000;
+
+	std::vector<int16_t> src16(N_SAMPLES), dest16(N_SAMPLES);
+	std::vector<int32_t> src32(N_SAMPLES), dest32(N_SAMPLES);
+	std::vector<float> src_float(N_SAMPLES), dest_float(N_SAMPLES);
+
+	for (std::size_t i = 0; i < N_SAMPLES; ++i) {
+		src16[i] = int16_t(rand());
+		src32[i] = int32_t(rand());
+		src_float[i] = float(rand()) / float(RAND_MAX) * 2 - 1;
+	}
+
+	constexpr int volume = PCM_VOLUME_1 * 3 / 4;
+	constexpr float volume_float = pcm_volume_to_float(volume);
+
+	for (const auto *k : GetAvailablePcmVolumeKernels()) {
+		PcmDither dither;
+
+		Bench(k->name, "volume_16", n_iterations, [&]{
+			k->volume_16(dither, dest16.data(), src16.data(),
+				     N_SAMPLES, volume);
+		});
+
+		Bench(k->name, "volume_24", n_iterations, [&]{
+			k->volume_24(dither, dest32.data(), src32.data(),
+				     N_SAMPLES, volume);
+		});
+
+		Bench(k->name, "volume_32", n_iterations, [&]{
+			k->volume_32(dither, dest32.data(), src32.data(),
+				     N_SAMPLES, volume);
+		});
+
+		Bench(k->name, "volume_float", n_iterations, [&]{
+			k->volume_float(dest_float.data(), src_float.data(),
+					N_SAMPLES, volume_float);
+		});
+
+		Bench(k->name, "add_volume_16", n_iterations, [&]{
+			k->add_volume_16(dither, dest16.data(), src16.data(),
+					 N_SAMPLES,
+					 volume, PCM_VOLUME_1S - volume);
+		});
+
+		Bench(k->name, "add_volume_24", n_iterations, [&]{
+			k->add_volume_24(dither, dest32.data(), src32.data(),
+					 N_SAMPLES,
+					 volume, PCM_VOLUME_1S - volume);
+		});
+
+		Bench(k->name, "add_volume_32", n_iterations, [&]{
+			k->add_volume_32(dither, dest32.data(), src32.data(),
+					 N_SAMPLES,
+					 volume, PCM_VOLUME_1S - volume);
+		});
+
+		Bench(k->name, "add_volume_float", n_iterations, [&]{
+			k->add_volume_float(dest_float.data(),
+					    src_float.data(), N_SAMPLES,
+					    volume_float,
+					    1 - volume_float);
+		});
+	}
+
+	return EXIT_SUCCESS;
+}
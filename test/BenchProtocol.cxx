@@ -0,0 +1,507 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+/*
+ * A protocol load generator: open many client connections to a
+ * running MPD, let each of them send a weighted random mix of
+ * commands as fast as possible and record the latency of each
+ * command.  Usage:
+ *
+ *   BenchProtocol [OPTIONS] HOST[:PORT]|/PATH
+ *
+ * For reproducible numbers, run MPD with a "null" audio output and
+ * a database of known size (see BenchDatabase).
+ *
+ * The results are printed to stdout, one block of "name: value"
+ * lines per command (separated by empty lines); latencies are in
+ * seconds.
+ */
+
+#include "net/Resolver.hxx"
+#include "net/AddressInfo.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/SocketError.hxx"
+#include "cmdline/OptionDef.hxx"
+#include "cmdline/OptionParser.hxx"
+#include "util/IterableSplitString.hxx"
+#include "util/NumberParser.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringCompare.hxx"
+#include "util/PrintException.hxx"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <stdlib.h>
+
+using std::string_view_literals::operator""sv;
+
+using FloatSeconds = std::chrono::duration<double>;
+
+enum class Command : uint_least8_t {
+	STATUS,
+	CURRENTSONG,
+	IDLE,
+	PLAYLISTINFO,
+	SEARCH,
+	ALBUMART,
+};
+
+static constexpr std::size_t N_COMMANDS = std::size_t(Command::ALBUMART) + 1;
+
+static constexpr std::array<const char *, N_COMMANDS> command_names{
+	"status",
+	"currentsong",
+	"idle",
+	"playlistinfo",
+	"search",
+	"albumart",
+};
+
+struct CommandLine {
+	const char *address;
+
+	unsigned n_clients = 16;
+
+	std::chrono::seconds duration{10};
+
+	/**
+	 * The relative frequency of each #Command.
+	 */
+	std::array<unsigned, N_COMMANDS> weights{40, 20, 10, 10, 15, 5};
+
+	const char *search = "(Artist contains \"a\")";
+
+	/**
+	 * The song URI for "albumart"; if this is not set, the
+	 * command is not used.
+	 */
+	const char *albumart = nullptr;
+};
+
+enum Option {
+	OPTION_CLIENTS,
+	OPTION_DURATION,
+	OPTION_MIX,
+	OPTION_SEARCH,
+	OPTION_ALBUMART,
+};
+
+static constexpr OptionDef option_defs[] = {
+	{"clients", 0, true, "The number of concurrent clients"},
+	{"duration", 0, true, "The number of seconds to run"},
+	{"mix", 0, true, "Command weights, e.g. \"status:40,idle:10\""},
+	{"search", 0, true, "The filter expression for \"search\""},
+	{"albumart", 0, true, "The song URI for \"albumart\""},
+};
+
+static unsigned
+ParsePositive(std::string_view s)
+{
+	const auto value = ParseInteger<unsigned>(s);
+	if (!value || *value == 0)
+		throw std::runtime_error("Failed to parse positive integer");
+
+	return *value;
+}
+
+static Command
+ParseCommand(std::string_view name)
+{
+	for (std::size_t i = 0; i < N_COMMANDS; ++i)
+		if (name == command_names[i])
+			return Command(i);
+
+	throw std::runtime_error(fmt::format("Unsupported command: {:?}",
+					     name));
+}
+
+/**
+ * Parse a comma-separated list of "COMMAND:WEIGHT" pairs.  Commands
+ * which are not listed are not used.
+ */
+static std::array<unsigned, N_COMMANDS>
+ParseMix(std::string_view s)
+{
+	std::array<unsigned, N_COMMANDS> weights{};
+
+	for (const std::string_view i : IterableSplitString(s, ',')) {
+		const auto [name, weight] = Split(i, ':');
+		weights[std::size_t(ParseCommand(name))] = weight.data() != nullptr
+			? ParseInteger<unsigned>(weight).value_or(0)
+			: 1;
+	}
+
+	return weights;
+}
+
+static CommandLine
+ParseCommandLine(int argc, char **argv)
+{
+	CommandLine c;
+
+	OptionParser option_parser(option_defs, argc, argv);
+	while (auto o = option_parser.Next()) {
+		switch (Option(o.index)) {
+		case OPTION_CLIENTS:
+			c.n_clients = ParsePositive(o.value);
+			break;
+
+		case OPTION_DURATION:
+			c.duration = std::chrono::seconds(ParsePositive(o.value));
+			break;
+
+		case OPTION_MIX:
+			c.weights = ParseMix(o.value);
+			break;
+
+		case OPTION_SEARCH:
+			c.search = o.value;
+			break;
+
+		case OPTION_ALBUMART:
+			c.albumart = o.value;
+			break;
+		}
+	}
+
+	auto args = option_parser.GetRemaining();
+	if (args.size() != 1)
+		throw std::runtime_error("Usage: BenchProtocol [OPTIONS] HOST[:PORT]|/PATH");
+
+	c.address = args.front();
+
+	if (c.albumart == nullptr)
+		c.weights[std::size_t(Command::ALBUMART)] = 0;
+
+	if (std::all_of(c.weights.begin(), c.weights.end(),
+			[](unsigned w){ return w == 0; }))
+		throw std::runtime_error("No commands selected");
+
+	return c;
+}
+
+/**
+ * Quote a string as one MPD protocol argument.
+ */
+static std::string
+QuoteArgument(std::string_view s) noexcept
+{
+	std::string result;
+	result.reserve(s.size() + 2);
+	result.push_back('"');
+
+	for (const char ch : s) {
+		if (ch == '"' || ch == '\\')
+			result.push_back('\\');
+		result.push_back(ch);
+	}
+
+	result.push_back('"');
+	return result;
+}
+
+static UniqueSocketDescriptor
+Connect(const char *address)
+{
+	if (*address == '/' || *address == '@') {
+		AllocatedSocketAddress local;
+		local.SetLocal(address);
+
+		UniqueSocketDescriptor fd;
+		if (!fd.Create(AF_LOCAL, SOCK_STREAM, 0))
+			throw MakeSocketError("Failed to create socket");
+
+		if (!fd.Connect(local))
+			throw MakeSocketError("Failed to connect");
+
+		return fd;
+	}
+
+	std::exception_ptr error;
+
+	for (const auto &i : Resolve(address, 6600, 0, SOCK_STREAM)) {
+		UniqueSocketDescriptor fd;
+		if (!fd.Create(i.GetFamily(), i.GetType(), i.GetProtocol())) {
+			error = std::make_exception_ptr(MakeSocketError("Failed to create socket"));
+			continue;
+		}
+
+		if (!fd.Connect(i)) {
+			error = std::make_exception_ptr(MakeSocketError("Failed to connect"));
+			continue;
+		}
+
+		return fd;
+	}
+
+	std::rethrow_exception(error);
+}
+
+/**
+ * A blocking MPD protocol connection which only understands enough
+ * of the responses to find their end.
+ */
+class Connection {
+	UniqueSocketDescriptor fd;
+
+	std::string buffer;
+
+	/**
+	 * The beginning of the unconsumed data in #buffer.
+	 */
+	std::size_t position = 0;
+
+public:
+	explicit Connection(const char *address)
+		:fd(Connect(address))
+	{
+		if (!ReadLine().starts_with("OK MPD "sv))
+			throw std::runtime_error("Not a MPD server");
+	}
+
+	void Send(std::string_view request) {
+		fd.FullWrite(AsBytes(request));
+	}
+
+	/**
+	 * Read the response to one command.
+	 *
+	 * @return false if the server has responded with "ACK"
+	 */
+	bool ReadResponse() {
+		while (true) {
+			const std::string_view line = ReadLine();
+			if (line == "OK"sv)
+				return true;
+
+			if (line.starts_with("ACK "sv))
+				return false;
+
+			if (const auto value = StringAfterPrefix(line, "binary: "sv);
+			    value.data() != nullptr) {
+				const auto size = ParseInteger<std::size_t>(value);
+				if (!size)
+					throw std::runtime_error("Malformed binary response");
+
+				/* the binary data and its trailing newline */
+				Skip(*size + 1);
+			}
+		}
+	}
+
+private:
+	void Fill() {
+		if (position > 0) {
+			buffer.erase(0, position);
+			position = 0;
+		}
+
+		const std::size_t old_size = buffer.size();
+		buffer.resize(old_size + 16384);
+
+		const auto nbytes = fd.Read(std::as_writable_bytes(std::span{buffer}.subspan(old_size)));
+		if (nbytes < 0)
+			throw MakeSocketError("Failed to receive");
+
+		if (nbytes == 0)
+			throw std::runtime_error("Connection closed by server");
+
+		buffer.resize(old_size + nbytes);
+	}
+
+	std::string_view ReadLine() {
+		while (true) {
+			const auto newline = buffer.find('\n', position);
+			if (newline != buffer.npos) {
+				const std::string_view line{buffer.data() + position,
+							    newline - position};
+				position = newline + 1;
+				return line;
+			}
+
+			Fill();
+		}
+	}
+
+	void Skip(std::size_t size) {
+		while (buffer.size() - position < size) {
+			size -= buffer.size() - position;
+			position = buffer.size();
+			Fill();
+		}
+
+		position += size;
+	}
+};
+
+struct Results {
+	std::array<std::vector<double>, N_COMMANDS> latencies;
+
+	std::array<uint_least64_t, N_COMMANDS> errors{};
+
+	void Merge(Results &&other) noexcept {
+		for (std::size_t i = 0; i < N_COMMANDS; ++i) {
+			latencies[i].insert(latencies[i].end(),
+					    other.latencies[i].begin(),
+					    other.latencies[i].end());
+			errors[i] += other.errors[i];
+		}
+	}
+};
+
+static void
+RunClient(const CommandLine &c, unsigned seed,
+	  std::chrono::steady_clock::time_point deadline,
+	  Results &results)
+{
+	Connection connection{c.address};
+
+	const std::array<std::string, N_COMMANDS> requests{
+		"status\n",
+		"currentsong\n",
+		/* "noidle" makes the server respond immediately
+		   unless "idle" has already been answered with an
+		   event, in which case it is ignored */
+		"idle\nnoidle\n",
+		"playlistinfo\n",
+		fmt::format("search {}\n", QuoteArgument(c.search)),
+		c.albumart != nullptr
+		? fmt::format("albumart {} 0\n", QuoteArgument(c.albumart))
+		: std::string{},
+	};
+
+	std::minstd_rand rng{seed};
+	std::discrete_distribution<std::size_t> dist(c.weights.begin(),
+						     c.weights.end());
+
+	while (std::chrono::steady_clock::now() < deadline) {
+		const std::size_t i = dist(rng);
+
+		const auto start = std::chrono::steady_clock::now();
+		connection.Send(requests[i]);
+		const bool success = connection.ReadResponse();
+		const FloatSeconds latency = std::chrono::steady_clock::now() - start;
+
+		results.latencies[i].push_back(latency.count());
+		if (!success)
+			++results.errors[i];
+	}
+}
+
+/**
+ * Returns the value at the given fraction of the sorted vector.
+ */
+[[gnu::pure]]
+static double
+Percentile(const std::vector<double> &v, double fraction) noexcept
+{
+	const std::size_t i = std::min(std::size_t(fraction * v.size()),
+				       v.size() - 1);
+	return v[i];
+}
+
+static void
+PrintResults(Results &results, FloatSeconds duration) noexcept
+{
+	uint_least64_t total = 0;
+	bool first = true;
+
+	for (std::size_t i = 0; i < N_COMMANDS; ++i) {
+		auto &v = results.latencies[i];
+		if (v.empty())
+			continue;
+
+		std::sort(v.begin(), v.end());
+		total += v.size();
+
+		double sum = 0;
+		for (const double j : v)
+			sum += j;
+
+		if (!first)
+			fmt::print("\n");
+		first = false;
+
+		fmt::print("command: {}\n"
+			   "count: {}\n"
+			   "errors: {}\n"
+			   "mean: {:.6f}\n"
+			   "p50: {:.6f}\n"
+			   "p90: {:.6f}\n"
+			   "p99: {:.6f}\n"
+			   "p999: {:.6f}\n"
+			   "max: {:.6f}\n",
+			   command_names[i], v.size(), results.errors[i],
+			   sum / v.size(),
+			   Percentile(v, 0.5), Percentile(v, 0.9),
+			   Percentile(v, 0.99), Percentile(v, 0.999),
+			   v.back());
+	}
+
+	fmt::print("\n"
+		   "total: {}\n"
+		   "requests_per_second: {:.1f}\n",
+		   total, total / duration.count());
+}
+
+int main(int argc, char **argv)
+try {
+	const auto c = ParseCommandLine(argc, argv);
+
+	/* a closed connection shall be reported as an error */
+	signal(SIGPIPE, SIG_IGN);
+
+	std::vector<Results> results(c.n_clients);
+	std::vector<std::exception_ptr> errors(c.n_clients);
+	std::vector<std::thread> threads;
+	threads.reserve(c.n_clients);
+
+	const auto start = std::chrono::steady_clock::now();
+	const auto deadline = start + c.duration;
+
+	for (unsigned i = 0; i < c.n_clients; ++i)
+		threads.emplace_back([&c, i, deadline, &results, &errors]{
+			try {
+				RunClient(c, i + 1, deadline, results[i]);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		});
+
+	for (auto &i : threads)
+		i.join();
+
+	const FloatSeconds duration = std::chrono::steady_clock::now() - start;
+
+	int status = EXIT_SUCCESS;
+	for (const auto &i : errors) {
+		if (i) {
+			PrintException(i);
+			status = EXIT_FAILURE;
+		}
+	}
+
+	Results total;
+	for (auto &i : results)
+		total.Merge(std::move(i));
+
+	PrintResults(total, duration);
+	return status;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
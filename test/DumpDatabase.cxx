@@ -57,6 +57,11 @@ public:
 	void OnDatabaseSongRemoved(const char *uri) noexcept override {
 		fmt::print("SongRemoved {:?}\n", uri);
 	}
+
+	void OnDatabaseSongsMoved(std::span<const std::pair<std::string, std::string>> moved) noexcept override {
+		for (const auto &[from, to] : moved)
+			fmt::print("SongMoved {:?} {:?}\n", from, to);
+	}
 };
 
 static void
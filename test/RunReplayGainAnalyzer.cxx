@@ -8,6 +8,7 @@
 #include "util/PrintException.hxx"
 
 #include <array>
+#include <chrono>
 #include <memory>
 
 #include <stdlib.h>
@@ -22,6 +23,11 @@ try {
 
 	const FileDescriptor input_fd(STDIN_FILENO);
 
+	/* measure the time spent in the analyzer (not in reading
+	   the input) for a throughput benchmark */
+	std::chrono::steady_clock::duration duration{};
+	std::size_t n_frames = 0;
+
 	while (true) {
 		std::array<ReplayGainAnalyzer::Frame, 1024> buffer;
 
@@ -31,14 +37,26 @@ try {
 		if (nbytes == 0)
 			break;
 
+		const auto start = std::chrono::steady_clock::now();
 		a.Process({buffer.data(), nbytes / frame_size});
+		duration += std::chrono::steady_clock::now() - start;
+		n_frames += nbytes / frame_size;
 	}
 
+	const auto start = std::chrono::steady_clock::now();
 	a.Flush();
+	duration += std::chrono::steady_clock::now() - start;
 
 	printf("gain = %+.2f dB\n", (double)a.GetGain());
 	printf("peak = %.6f\n", (double)a.GetPeak());
 
+	const double seconds = std::chrono::duration<double>(duration).count();
+	if (seconds > 0)
+		fprintf(stderr, "analyzed %.1f s of audio in %.3f s (%.1fx realtime)\n",
+			double(n_frames) / ReplayGainAnalyzer::SAMPLE_RATE,
+			seconds,
+			double(n_frames) / ReplayGainAnalyzer::SAMPLE_RATE / seconds);
+
 	return EXIT_SUCCESS;
 } catch (...) {
 	PrintException(std::current_exception());
@@ -0,0 +1,232 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "memory/AtomicSliceBuffer.hxx"
+#include "thread/Mutex.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Item {
+	unsigned value;
+
+	explicit Item(unsigned _value) noexcept
+		:value(_value) {}
+
+	~Item() noexcept {
+		/* detect use after Free() */
+		value = ~0U;
+	}
+};
+
+} // anonymous namespace
+
+static std::vector<Item *>
+AllocateAll(AtomicSliceBuffer<Item> &buffer)
+{
+	std::vector<Item *> items;
+	for (unsigned i = 0;; ++i) {
+		Item *item = buffer.Allocate(i);
+		if (item == nullptr)
+			break;
+
+		items.push_back(item);
+	}
+
+	return items;
+}
+
+TEST(AtomicSliceBuffer, Basic)
+{
+	AtomicSliceBuffer<Item> buffer{16};
+
+	/* the capacity may be rounded up to the page size */
+	EXPECT_GE(buffer.GetCapacity(), 16u);
+	EXPECT_TRUE(buffer.empty());
+
+	auto items = AllocateAll(buffer);
+	EXPECT_EQ(items.size(), buffer.GetCapacity());
+	EXPECT_EQ(buffer.GetAllocatedCount(), buffer.GetCapacity());
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_FALSE(buffer.HasAvailable());
+
+	for (unsigned i = 0; i < items.size(); ++i) {
+		EXPECT_EQ(items[i]->value, i);
+		EXPECT_EQ(buffer.GetIndex(items[i]), i);
+	}
+
+	for (auto *item : items)
+		buffer.Free(item);
+
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_TRUE(buffer.HasAvailable());
+}
+
+TEST(AtomicSliceBuffer, FreeOrder)
+{
+	AtomicSliceBuffer<Item> buffer{16};
+
+	Item *a = buffer.Allocate(1);
+	Item *b = buffer.Allocate(2);
+	Item *c = buffer.Allocate(3);
+	ASSERT_NE(a, nullptr);
+	ASSERT_NE(b, nullptr);
+	ASSERT_NE(c, nullptr);
+	EXPECT_EQ(buffer.GetInitializedCount(), 3u);
+
+	/* the "available" list is a stack: the most recently freed
+	   slice is reused first, before touching new memory */
+	buffer.Free(a);
+	buffer.Free(c);
+
+	Item *d = buffer.Allocate(4);
+	EXPECT_EQ(d, c);
+	Item *e = buffer.Allocate(5);
+	EXPECT_EQ(e, a);
+	EXPECT_FALSE(buffer.HasAvailable());
+	EXPECT_EQ(buffer.GetInitializedCount(), 3u);
+
+	Item *f = buffer.Allocate(6);
+	EXPECT_EQ(buffer.GetIndex(f), 3u);
+	EXPECT_EQ(buffer.GetInitializedCount(), 4u);
+
+	EXPECT_EQ(b->value, 2u);
+	EXPECT_EQ(d->value, 4u);
+	EXPECT_EQ(e->value, 5u);
+
+	for (auto *i : {b, d, e, f})
+		buffer.Free(i);
+
+	EXPECT_TRUE(buffer.empty());
+
+	buffer.DiscardMemory();
+	EXPECT_EQ(buffer.GetInitializedCount(), 0u);
+	EXPECT_FALSE(buffer.HasAvailable());
+}
+
+/**
+ * Several threads free slices at the same time; afterwards, each
+ * slice must be on the "available" list exactly once.
+ */
+TEST(AtomicSliceBuffer, ConcurrentFree)
+{
+	static constexpr unsigned N_THREADS = 4;
+
+	AtomicSliceBuffer<Item> buffer{4096};
+
+	for (unsigned round = 0; round < 8; ++round) {
+		auto items = AllocateAll(buffer);
+		ASSERT_EQ(items.size(), buffer.GetCapacity());
+
+		std::atomic_bool go{false};
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < N_THREADS; ++t)
+			threads.emplace_back([&buffer, &items, &go, t]{
+				while (!go) {}
+
+				for (std::size_t i = t; i < items.size(); i += N_THREADS)
+					buffer.Free(items[i]);
+			});
+
+		go = true;
+		for (auto &t : threads)
+			t.join();
+
+		EXPECT_TRUE(buffer.empty());
+
+		/* the slices are reused without initializing new
+		   ones, and none is handed out twice */
+		items = AllocateAll(buffer);
+		EXPECT_EQ(items.size(), buffer.GetCapacity());
+		EXPECT_EQ(buffer.GetInitializedCount(), buffer.GetCapacity());
+		EXPECT_EQ(std::set<Item *>(items.begin(), items.end()).size(),
+			  items.size());
+
+		for (auto *item : items)
+			buffer.Free(item);
+	}
+}
+
+/**
+ * One thread allocates while others free concurrently (the way
+ * #MusicBuffer is used); each object must arrive intact and the
+ * buffer must not leak slices.
+ */
+TEST(AtomicSliceBuffer, ConcurrentAllocateFree)
+{
+	static constexpr unsigned N_THREADS = 3;
+	static constexpr unsigned N_ITEMS = 200000;
+
+	AtomicSliceBuffer<Item> buffer{64};
+
+	Mutex mutex;
+	std::condition_variable_any cond;
+	std::deque<Item *> queue;
+	bool done = false;
+	std::atomic<unsigned> n_freed{0}, n_errors{0};
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < N_THREADS; ++t)
+		threads.emplace_back([&]{
+			std::unique_lock lock{mutex};
+			while (true) {
+				cond.wait(lock, [&]{ return done || !queue.empty(); });
+				if (queue.empty())
+					break;
+
+				Item *item = queue.front();
+				queue.pop_front();
+				lock.unlock();
+
+				if (item->value >= N_ITEMS)
+					++n_errors;
+
+				buffer.Free(item);
+				++n_freed;
+
+				lock.lock();
+			}
+		});
+
+	for (unsigned i = 0; i < N_ITEMS;) {
+		Item *item = buffer.Allocate(i);
+		if (item == nullptr) {
+			/* full; wait for the other threads */
+			std::this_thread::yield();
+			continue;
+		}
+
+		EXPECT_EQ(item->value, i);
+
+		{
+			const std::scoped_lock lock{mutex};
+			queue.push_back(item);
+		}
+
+		cond.notify_one();
+		++i;
+	}
+
+	{
+		const std::scoped_lock lock{mutex};
+		done = true;
+	}
+
+	cond.notify_all();
+	for (auto &t : threads)
+		t.join();
+
+	EXPECT_EQ(n_freed, N_ITEMS);
+	EXPECT_EQ(n_errors, 0u);
+	EXPECT_TRUE(buffer.empty());
+	EXPECT_LE(buffer.GetInitializedCount(), buffer.GetCapacity());
+}
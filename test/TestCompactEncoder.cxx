@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "protocol/CompactEncoder.hxx"
+
+#include <gtest/gtest.h>
+
+using std::string_view_literals::operator""sv;
+
+TEST(CompactEncoder, Varint)
+{
+	std::string s;
+	CompactEncoder::AppendVarint(s, 0);
+	EXPECT_EQ(s, "\x00"sv);
+
+	s.clear();
+	CompactEncoder::AppendVarint(s, 0x7f);
+	EXPECT_EQ(s, "\x7f"sv);
+
+	s.clear();
+	CompactEncoder::AppendVarint(s, 0x80);
+	EXPECT_EQ(s, "\x80\x01"sv);
+
+	s.clear();
+	CompactEncoder::AppendVarint(s, 300);
+	EXPECT_EQ(s, "\xac\x02"sv);
+}
+
+TEST(CompactEncoder, InternKeys)
+{
+	CompactEncoder encoder;
+	std::string s;
+
+	encoder.Encode("file: a.ogg\nTitle: A\n", s);
+	EXPECT_EQ(s, "\x00\x04" "file" "\x05" "a.ogg"
+		  "\x00\x05" "Title" "\x01" "A"sv);
+
+	/* known keys are sent as ids, also in later calls */
+	s.clear();
+	encoder.Encode("file: b.ogg\nTitle: \nArtist: C\n", s);
+	EXPECT_EQ(s, "\x01\x05" "b.ogg"
+		  "\x02\x00"
+		  "\x00\x06" "Artist" "\x01" "C"sv);
+}
+
+TEST(CompactEncoder, NoValue)
+{
+	CompactEncoder encoder;
+	std::string s;
+
+	encoder.Encode("foo\n", s);
+	EXPECT_EQ(s, "\x00\x03" "foo" "\x00"sv);
+}
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "decoder/EmuSilence.hxx"
+#include "fs/Path.hxx"
+
+#include <gtest/gtest.h>
+
+#include <fmt/core.h>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h> // for mkstemp()
+#include <unistd.h>
+
+using std::chrono_literals::operator""s;
+
+static constexpr unsigned SAMPLE_RATE = 1000;
+static constexpr unsigned CHANNELS = 2;
+
+static EmuSilenceConfig
+MakeConfig() noexcept
+{
+	EmuSilenceConfig config;
+	config.threshold = 32;
+	config.duration = 2s;
+	return config;
+}
+
+/**
+ * Generate the given number of frames; all samples are either loud
+ * or below the threshold.
+ */
+static std::vector<int16_t>
+Generate(unsigned n_frames, bool loud) noexcept
+{
+	return std::vector<int16_t>(n_frames * CHANNELS,
+				    int16_t(loud ? -1000 : 20));
+}
+
+TEST(EmuSilence, LeadingSilence)
+{
+	EmuSilenceDetector d{MakeConfig(), SAMPLE_RATE, CHANNELS};
+
+	/* silence before the first sound doesn't end the song */
+	for (unsigned i = 0; i < 10; ++i)
+		EXPECT_FALSE(d.Feed(Generate(1000, false)));
+}
+
+TEST(EmuSilence, Basic)
+{
+	EmuSilenceDetector d{MakeConfig(), SAMPLE_RATE, CHANNELS};
+
+	EXPECT_FALSE(d.Feed(Generate(1500, true)));
+
+	/* a loud frame in the middle of the chunk */
+	auto buffer = Generate(1000, false);
+	buffer[499 * CHANNELS + 1] = 1000;
+	EXPECT_FALSE(d.Feed(buffer));
+
+	EXPECT_FALSE(d.Feed(Generate(1000, false)));
+	EXPECT_TRUE(d.Feed(Generate(1000, false)));
+
+	EXPECT_EQ(d.GetSilenceStart(), 2000U);
+	EXPECT_EQ(d.GetLength().ToMS(), 2000U);
+}
+
+TEST(EmuSilence, Reset)
+{
+	EmuSilenceDetector d{MakeConfig(), SAMPLE_RATE, CHANNELS};
+
+	EXPECT_FALSE(d.Feed(Generate(1000, true)));
+	EXPECT_FALSE(d.Feed(Generate(1000, false)));
+
+	/* after seeking, the silence must be heard again after
+	   sound */
+	d.Reset(10000);
+	EXPECT_FALSE(d.Feed(Generate(3000, false)));
+	EXPECT_FALSE(d.Feed(Generate(1000, true)));
+	EXPECT_TRUE(d.Feed(Generate(2000, false)));
+	EXPECT_EQ(d.GetSilenceStart(), 14000U);
+}
+
+TEST(EmuSilence, Disabled)
+{
+	auto config = MakeConfig();
+	config.duration = {};
+	EXPECT_FALSE(config.IsEnabled());
+
+	EmuSilenceDetector d{config, SAMPLE_RATE, CHANNELS};
+	EXPECT_FALSE(d.Feed(Generate(1000, true)));
+	EXPECT_FALSE(d.Feed(Generate(10000, false)));
+}
+
+TEST(EmuSilence, Cache)
+{
+	const auto a = Path::FromFS("/music/a.gsf");
+	const auto b = Path::FromFS("/music/b.sid/tune_002.sid");
+
+	EXPECT_TRUE(LookupEmuLength(a).IsNegative());
+
+	RememberEmuLength(a, SongTime::FromMS(42000));
+	RememberEmuLength(b, SongTime::FromMS(1234));
+	EXPECT_EQ(LookupEmuLength(a).ToMS(), 42000);
+	EXPECT_EQ(LookupEmuLength(b).ToMS(), 1234);
+
+	RememberEmuLength(a, SongTime::FromMS(43000));
+	EXPECT_EQ(LookupEmuLength(a).ToMS(), 43000);
+}
+
+TEST(EmuSilence, CacheModified)
+{
+	char name[] = "/tmp/TestEmuSilence.XXXXXX";
+	const int fd = mkstemp(name);
+	ASSERT_GE(fd, 0);
+
+	const auto subtune_name = fmt::format("{}/tune_001.psf", name);
+	const auto path = Path::FromFS(name);
+	const auto subtune = Path::FromFS(subtune_name.c_str());
+
+	RememberEmuLength(path, SongTime::FromMS(5000));
+	RememberEmuLength(subtune, SongTime::FromMS(6000));
+	EXPECT_EQ(LookupEmuLength(path).ToMS(), 5000);
+	EXPECT_EQ(LookupEmuLength(subtune).ToMS(), 6000);
+
+	/* changing the file (or the container) discards the
+	   lengths */
+	ASSERT_EQ(write(fd, "x", 1), 1);
+	close(fd);
+
+	EXPECT_TRUE(LookupEmuLength(path).IsNegative());
+	EXPECT_TRUE(LookupEmuLength(subtune).IsNegative());
+
+	unlink(name);
+}
+
+TEST(EmuSilence, CacheEviction)
+{
+	const auto keep = Path::FromFS("/music/keep.gsf");
+	RememberEmuLength(keep, SongTime::FromMS(1000));
+
+	const auto evict = Path::FromFS("/music/evict.gsf");
+	RememberEmuLength(evict, SongTime::FromMS(2000));
+
+	/* the cache holds 4096 items; fill it while using "keep" */
+	for (unsigned i = 0; i < 4096; ++i) {
+		const auto name = fmt::format("/music/{}.gsf", i);
+		RememberEmuLength(Path::FromFS(name.c_str()),
+				  SongTime::FromMS(i));
+
+		if (i % 1024 == 0)
+			EXPECT_EQ(LookupEmuLength(keep).ToMS(), 1000);
+	}
+
+	EXPECT_EQ(LookupEmuLength(keep).ToMS(), 1000);
+	EXPECT_TRUE(LookupEmuLength(evict).IsNegative());
+	EXPECT_EQ(LookupEmuLength(Path::FromFS("/music/4095.gsf")).ToMS(), 4095);
+}
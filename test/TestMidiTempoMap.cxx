@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "decoder/plugins/MidiTempoMap.hxx"
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+#include <vector>
+
+static std::vector<std::byte>
+MakeBytes(std::initializer_list<int> l)
+{
+	std::vector<std::byte> result;
+	for (int i : l)
+		result.push_back(std::byte(i));
+	return result;
+}
+
+static void
+AppendTrack(std::vector<std::byte> &file, const std::vector<std::byte> &events)
+{
+	const auto size = events.size();
+	const auto header = MakeBytes({'M', 'T', 'r', 'k',
+			int(size >> 24) & 0xff, int(size >> 16) & 0xff,
+			int(size >> 8) & 0xff, int(size) & 0xff});
+	file.insert(file.end(), header.begin(), header.end());
+	file.insert(file.end(), events.begin(), events.end());
+}
+
+TEST(MidiTempoMap, DefaultTempo)
+{
+	/* format 0, 1 track, 96 ticks per quarter note */
+	auto file = MakeBytes({'M', 'T', 'h', 'd', 0, 0, 0, 6,
+			0, 0, 0, 1, 0, 96});
+
+	AppendTrack(file, MakeBytes({
+		/* note on, then note off with running status
+		   after 2 * 96 ticks (delta 0x81 0x40 = 192) */
+		0x00, 0x90, 60, 100,
+		0x81, 0x40, 60, 0,
+		/* program change (one data byte) */
+		0x00, 0xc0, 1,
+		/* end of track after another 96 ticks */
+		0x60, 0xff, 0x2f, 0x00,
+	}));
+
+	const MidiTempoMap map{file};
+
+	/* 120 BPM: 3 quarter notes = 1.5 s */
+	EXPECT_DOUBLE_EQ(map.GetDuration(), 1.5);
+	EXPECT_EQ(map.TimeToTick(1.0), 192U);
+	EXPECT_DOUBLE_EQ(map.TickToTime(96), 0.5);
+}
+
+TEST(MidiTempoMap, TempoChange)
+{
+	/* format 1, 2 tracks, 100 ticks per quarter note */
+	auto file = MakeBytes({'M', 'T', 'h', 'd', 0, 0, 0, 6,
+			0, 1, 0, 2, 0, 100});
+
+	/* tempo track: 60 BPM at tick 0, 240 BPM at tick 200 */
+	AppendTrack(file, MakeBytes({
+		0x00, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40,
+		0x81, 0x48, 0xff, 0x51, 0x03, 0x03, 0xd0, 0x90,
+		0x00, 0xff, 0x2f, 0x00,
+	}));
+
+	/* the longest track ends at tick 600 */
+	AppendTrack(file, MakeBytes({
+		0x00, 0xf0, 0x02, 0x7e, 0xf7,
+		0x84, 0x58, 0x80, 60, 0,
+		0x00, 0xff, 0x2f, 0x00,
+	}));
+
+	const MidiTempoMap map{file};
+
+	/* 200 ticks at 1 s per quarter note, 400 ticks at 0.25 s */
+	EXPECT_DOUBLE_EQ(map.GetDuration(), 3.0);
+	EXPECT_DOUBLE_EQ(map.TickToTime(200), 2.0);
+	EXPECT_EQ(map.TimeToTick(2.5), 400U);
+	EXPECT_EQ(map.TimeToTick(1.0), 100U);
+}
+
+TEST(MidiTempoMap, Malformed)
+{
+	EXPECT_ANY_THROW(MidiTempoMap{MakeBytes({'R', 'I', 'F', 'F'})});
+
+	auto file = MakeBytes({'M', 'T', 'h', 'd', 0, 0, 0, 6,
+			0, 0, 0, 1, 0, 96});
+	AppendTrack(file, MakeBytes({0x00, 0x90, 60}));
+	EXPECT_ANY_THROW(MidiTempoMap{file});
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MusicBuffer.hxx"
+#include "MusicBufferPool.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+static std::vector<MusicChunkPtr>
+AllocateAll(MusicBuffer &buffer)
+{
+	std::vector<MusicChunkPtr> chunks;
+	while (auto chunk = buffer.Allocate())
+		chunks.emplace_back(std::move(chunk));
+	return chunks;
+}
+
+TEST(MusicBuffer, NoPool)
+{
+	MusicBuffer buffer{8};
+
+	/* the capacity may be rounded up to the page size */
+	EXPECT_GE(buffer.GetSize(), 8u);
+
+	auto chunks = AllocateAll(buffer);
+	EXPECT_EQ(chunks.size(), buffer.GetSize());
+	EXPECT_TRUE(buffer.IsFull());
+	EXPECT_EQ(buffer.GetBorrowedCount(), 0u);
+
+	chunks.pop_back();
+	EXPECT_FALSE(buffer.IsFull());
+}
+
+TEST(MusicBuffer, Pool)
+{
+	MusicBufferPool pool{4};
+
+	{
+		MusicBuffer a{8, CHUNK_SIZE, false, &pool, 2};
+		MusicBuffer b{8, CHUNK_SIZE, false, &pool, 2};
+
+		/* "a" gets its base quota and half of the pool */
+		auto a_chunks = AllocateAll(a);
+		EXPECT_EQ(a_chunks.size(), 4u);
+		EXPECT_EQ(a.GetBorrowedCount(), 2u);
+		EXPECT_TRUE(a.IsFull());
+		EXPECT_FALSE(pool.IsExhausted());
+
+		/* "b" gets the same; now the pool is exhausted */
+		auto b_chunks = AllocateAll(b);
+		EXPECT_EQ(b_chunks.size(), 4u);
+		EXPECT_EQ(b.GetBorrowedCount(), 2u);
+		EXPECT_TRUE(b.IsFull());
+		EXPECT_TRUE(pool.IsExhausted());
+
+		/* "c" still gets its base quota */
+		MusicBuffer c{8, CHUNK_SIZE, false, &pool, 2};
+		auto c_chunks = AllocateAll(c);
+		EXPECT_EQ(c_chunks.size(), 2u);
+		EXPECT_EQ(c.GetBorrowedCount(), 0u);
+		EXPECT_TRUE(c.IsFull());
+
+		/* freed chunks are reused without borrowing */
+		a_chunks.pop_back();
+		EXPECT_FALSE(a.IsFull());
+		a_chunks.emplace_back(a.Allocate());
+		EXPECT_TRUE(a_chunks.back());
+		EXPECT_EQ(pool.GetBorrowedCount(), 4u);
+
+		/* discarding the memory of an idle buffer returns
+		   the borrowed chunks to the pool */
+		a_chunks.clear();
+		a.DiscardMemory();
+		EXPECT_EQ(a.GetBorrowedCount(), 0u);
+		EXPECT_EQ(pool.GetBorrowedCount(), 2u);
+
+		c_chunks.emplace_back(c.Allocate());
+		EXPECT_TRUE(c_chunks.back());
+		EXPECT_EQ(c.GetBorrowedCount(), 1u);
+
+		/* "b" is at its limit although the pool is not
+		   exhausted */
+		EXPECT_TRUE(b.IsFull());
+		EXPECT_FALSE(b.Allocate());
+	}
+
+	/* the destructor returns the rest */
+	EXPECT_EQ(pool.GetBorrowedCount(), 0u);
+}
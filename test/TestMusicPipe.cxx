@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static constexpr AudioFormat audio_format{44100, SampleFormat::S16, 2};
+
+/**
+ * Allocate a chunk containing the given number.
+ */
+static MusicChunkPtr
+MakeChunk(MusicBuffer &buffer, uint32_t number)
+{
+	auto chunk = buffer.Allocate();
+	if (!chunk)
+		return chunk;
+
+	const auto w = chunk->Write(audio_format, SongTime::zero(), 0);
+	EXPECT_GE(w.size(), sizeof(number));
+	memcpy(w.data(), &number, sizeof(number));
+	chunk->Expand(audio_format, sizeof(number));
+	return chunk;
+}
+
+[[gnu::pure]]
+static uint32_t
+GetNumber(const MusicChunk &chunk) noexcept
+{
+	uint32_t number;
+	EXPECT_EQ(chunk.length, sizeof(number));
+	memcpy(&number, chunk.data.data(), sizeof(number));
+	return number;
+}
+
+TEST(MusicPipe, Basic)
+{
+	MusicBuffer buffer{16};
+	MusicPipe pipe;
+
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_EQ(pipe.Peek(), nullptr);
+
+	for (uint32_t i = 0; i < 4; ++i)
+		pipe.Push(MakeChunk(buffer, i));
+
+	EXPECT_EQ(pipe.GetSize(), 4u);
+
+	/* walk the list without locking */
+	uint32_t expected = 0;
+	for (const auto *chunk = pipe.Peek(); chunk != nullptr;
+	     chunk = chunk->GetNext())
+		EXPECT_EQ(GetNumber(*chunk), expected++);
+	EXPECT_EQ(expected, 4u);
+
+	auto first = pipe.Shift();
+	ASSERT_TRUE(first);
+	EXPECT_EQ(GetNumber(*first), 0u);
+	EXPECT_EQ(first->GetNext(), nullptr);
+	EXPECT_EQ(GetNumber(*pipe.Peek()), 1u);
+
+	/* put it back */
+	pipe.PushFront(std::move(first));
+	EXPECT_EQ(pipe.GetSize(), 4u);
+	EXPECT_EQ(GetNumber(*pipe.Peek()), 0u);
+	EXPECT_EQ(GetNumber(*pipe.Peek()->GetNext()), 1u);
+
+	pipe.Clear();
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_EQ(pipe.Peek(), nullptr);
+	EXPECT_EQ(buffer.GetAllocatedCount(), 0u);
+}
+
+TEST(MusicPipe, PushFrontPipe)
+{
+	MusicBuffer buffer{16};
+	MusicPipe a, b;
+
+	a.Push(MakeChunk(buffer, 2));
+	a.Push(MakeChunk(buffer, 3));
+	b.Push(MakeChunk(buffer, 0));
+	b.Push(MakeChunk(buffer, 1));
+
+	a.PushFront(b);
+	EXPECT_TRUE(b.IsEmpty());
+	EXPECT_EQ(b.Peek(), nullptr);
+	EXPECT_EQ(a.GetSize(), 4u);
+
+	/* the published list must be consistent with the owning
+	   one, including the former tail of "b" */
+	uint32_t expected = 0;
+	for (const auto *chunk = a.Peek(); chunk != nullptr;
+	     chunk = chunk->GetNext())
+		EXPECT_EQ(GetNumber(*chunk), expected++);
+	EXPECT_EQ(expected, 4u);
+
+	/* appending after PushFront() still works */
+	a.Push(MakeChunk(buffer, 4));
+
+	for (uint32_t i = 0; i < 5; ++i) {
+		auto chunk = a.Shift();
+		ASSERT_TRUE(chunk);
+		EXPECT_EQ(GetNumber(*chunk), i);
+	}
+
+	EXPECT_TRUE(a.IsEmpty());
+}
+
+/**
+ * A producer pushes chunks while a lock-free reader follows the
+ * list with Peek() and GetNext(), and the consumer removes the
+ * chunks already seen by the reader and returns them to the buffer
+ * (like the player thread does).
+ */
+TEST(MusicPipe, Concurrent)
+{
+	static constexpr uint32_t N_CHUNKS = 50000;
+
+	MusicBuffer buffer{64};
+	MusicPipe pipe;
+
+	/* the number of chunks the reader has verified */
+	std::atomic<uint32_t> n_read{0};
+	std::atomic<unsigned> n_errors{0};
+
+	std::thread producer([&]{
+		for (uint32_t i = 0; i < N_CHUNKS;) {
+			auto chunk = MakeChunk(buffer, i);
+			if (!chunk) {
+				/* buffer is full */
+				std::this_thread::yield();
+				continue;
+			}
+
+			pipe.Push(std::move(chunk));
+			++i;
+		}
+	});
+
+	std::thread reader([&]{
+		const MusicChunk *chunk = nullptr;
+		uint32_t expected = 0;
+
+		while (expected < N_CHUNKS) {
+			const MusicChunk *next = chunk == nullptr
+				? pipe.Peek()
+				: chunk->GetNext();
+			if (next == nullptr) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			if (GetNumber(*next) != expected)
+				++n_errors;
+
+			chunk = next;
+			++expected;
+
+			/* the consumer may remove all chunks before
+			   this one; it is still needed to find the
+			   next one */
+			n_read.store(expected - 1, std::memory_order_release);
+		}
+
+		n_read.store(N_CHUNKS, std::memory_order_release);
+	});
+
+	for (uint32_t i = 0; i < N_CHUNKS;) {
+		if (i >= n_read.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto chunk = pipe.Shift();
+		EXPECT_TRUE(chunk);
+		if (!chunk)
+			break;
+
+		EXPECT_EQ(GetNumber(*chunk), i);
+		++i;
+	}
+
+	producer.join();
+	reader.join();
+
+	EXPECT_EQ(n_errors, 0u);
+	EXPECT_TRUE(pipe.IsEmpty());
+	EXPECT_EQ(buffer.GetAllocatedCount(), 0u);
+}
@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "pcm/AudioFormat.hxx"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+using std::string_view_literals::operator""sv;
+
+namespace {
+
+/**
+ * A fake encoder which generates a header "H" and copies all PCM
+ * data.
+ */
+class CopyEncoder final : public Encoder {
+	unsigned &n_writes;
+	std::string buffer = "H";
+
+public:
+	explicit CopyEncoder(unsigned &_n_writes) noexcept
+		:Encoder(false), n_writes(_n_writes) {}
+
+	void Write(std::span<const std::byte> src) override {
+		++n_writes;
+		buffer.append(reinterpret_cast<const char *>(src.data()),
+			      src.size());
+	}
+
+	std::span<const std::byte> Read(std::span<std::byte> b) noexcept override {
+		const std::size_t n = std::min(b.size(), buffer.size());
+		std::copy_n(reinterpret_cast<const std::byte *>(buffer.data()),
+			    n, b.begin());
+		buffer.erase(0, n);
+		return b.first(n);
+	}
+};
+
+class PreparedCopyEncoder final : public PreparedEncoder {
+	unsigned &n_writes;
+
+public:
+	explicit PreparedCopyEncoder(unsigned &_n_writes) noexcept
+		:n_writes(_n_writes) {}
+
+	Encoder *Open(AudioFormat &) override {
+		return new CopyEncoder(n_writes);
+	}
+};
+
+void
+Write(Encoder &encoder, std::string_view s)
+{
+	encoder.Write(std::as_bytes(std::span{s}));
+}
+
+std::string
+ReadAll(Encoder &encoder)
+{
+	std::string result;
+
+	while (true) {
+		/* a small buffer to test partial reads */
+		std::byte buffer[3];
+		const auto r = encoder.Read(buffer);
+		if (r.empty())
+			break;
+
+		result.append(reinterpret_cast<const char *>(r.data()),
+			      r.size());
+	}
+
+	return result;
+}
+
+} // anonymous namespace
+
+TEST(SharedEncoder, EncodeOnce)
+{
+	unsigned n_writes = 0;
+	const std::unique_ptr<PreparedEncoder> a{
+		CreateSharedEncoder("once", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+	const std::unique_ptr<PreparedEncoder> b{
+		CreateSharedEncoder("once", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+
+	AudioFormat audio_format{44100, SampleFormat::S16, 2};
+	const std::unique_ptr<Encoder> ea{a->Open(audio_format)};
+	const std::unique_ptr<Encoder> eb{b->Open(audio_format)};
+
+	EXPECT_EQ(ReadAll(*ea), "H"sv);
+
+	Write(*ea, "hello");
+	EXPECT_EQ(ReadAll(*ea), "hello"sv);
+
+	/* "b" has not yet submitted this data */
+	EXPECT_EQ(ReadAll(*eb), "H"sv);
+
+	/* the encoded page can only be read after all of its PCM
+	   data was submitted */
+	Write(*eb, "hel");
+	EXPECT_EQ(ReadAll(*eb), ""sv);
+
+	/* "b" leads now */
+	Write(*eb, "lo world");
+	EXPECT_EQ(ReadAll(*eb), "hello world"sv);
+	Write(*ea, " world");
+	EXPECT_EQ(ReadAll(*ea), " world"sv);
+
+	EXPECT_EQ(n_writes, 2u);
+}
+
+TEST(SharedEncoder, Join)
+{
+	unsigned n_writes = 0;
+	const std::unique_ptr<PreparedEncoder> a{
+		CreateSharedEncoder("join", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+	const std::unique_ptr<PreparedEncoder> b{
+		CreateSharedEncoder("join", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+
+	AudioFormat audio_format{44100, SampleFormat::S16, 2};
+	std::unique_ptr<Encoder> ea{a->Open(audio_format)};
+	Write(*ea, "abc");
+	EXPECT_EQ(ReadAll(*ea), "Habc"sv);
+
+	/* a member joining later receives the header and new data
+	   only */
+	const std::unique_ptr<Encoder> eb{b->Open(audio_format)};
+	Write(*ea, "def");
+	Write(*eb, "def");
+	EXPECT_EQ(ReadAll(*eb), "Hdef"sv);
+
+	/* "a" leaves without reading; its pages must not block the
+	   others */
+	ea.reset();
+	Write(*eb, "ghi");
+	EXPECT_EQ(ReadAll(*eb), "ghi"sv);
+
+	EXPECT_EQ(n_writes, 3u);
+}
+
+TEST(SharedEncoder, Idle)
+{
+	unsigned n_writes = 0;
+	const std::unique_ptr<PreparedEncoder> a{
+		CreateSharedEncoder("idle", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+	const std::unique_ptr<PreparedEncoder> b{
+		CreateSharedEncoder("idle", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+
+	AudioFormat audio_format{8000, SampleFormat::S8, 1};
+	const std::unique_ptr<Encoder> ea{a->Open(audio_format)};
+	const std::unique_ptr<Encoder> eb{b->Open(audio_format)};
+	EXPECT_EQ(ReadAll(*ea), "H"sv);
+
+	/* "b" stops submitting data while "a" keeps going for more
+	   than a minute */
+	const std::string second(audio_format.sample_rate, 'x');
+	for (unsigned i = 0; i < 90; ++i) {
+		Write(*ea, second);
+		EXPECT_EQ(ReadAll(*ea), second);
+	}
+
+	/* when "b" resumes, it does not get the old pages, and its
+	   new data is encoded at the end of the stream */
+	Write(*eb, "new");
+	EXPECT_EQ(ReadAll(*eb), "Hnew"sv);
+
+	Write(*ea, "new");
+	EXPECT_EQ(ReadAll(*ea), "new"sv);
+
+	EXPECT_EQ(n_writes, 91u);
+}
+
+TEST(SharedEncoder, WrongPlugin)
+{
+	unsigned n_writes = 0;
+	const std::unique_ptr<PreparedEncoder> a{
+		CreateSharedEncoder("wrong", "copy",
+				    std::make_unique<PreparedCopyEncoder>(n_writes)),
+	};
+
+	EXPECT_ANY_THROW(CreateSharedEncoder("wrong", "other",
+					     std::make_unique<PreparedCopyEncoder>(n_writes)));
+}
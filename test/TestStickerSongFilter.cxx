@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "song/Filter.hxx"
+#include "song/StickerSongFilter.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Tag.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(StickerSongFilter, Parse)
+{
+	SongFilter filter;
+	const char *const args[] = {
+		"((sticker 'rating' gt '3') AND (!(sticker \"played\" exists)))",
+	};
+	filter.Parse(args);
+	filter.Optimize();
+
+	EXPECT_EQ(filter.ToExpression(),
+		  "((sticker \"rating\" gt \"3\") AND (!(sticker \"played\" exists)))");
+
+	SongFilter filter2;
+	const char *const args2[] = {
+		"(sticker 'rating' == 'x')",
+		"(sticker 'played' exists)",
+	};
+	filter2.Parse(args2);
+	EXPECT_EQ(filter2.GetStickerFilters().size(), 2U);
+
+	const char *const bad_op[] = { "(sticker 'rating' ~= 'x')" };
+	EXPECT_ANY_THROW(SongFilter{}.Parse(bad_op));
+
+	const char *const no_name[] = { "(sticker '' exists)" };
+	EXPECT_ANY_THROW(SongFilter{}.Parse(no_name));
+}
+
+TEST(StickerSongFilter, Match)
+{
+	SongFilter filter;
+	const char *const args[] = {
+		"(sticker 'rating' gt '3')",
+		"(!(sticker 'skip' exists))",
+	};
+	filter.Parse(args);
+	filter.Optimize();
+
+	const auto stickers = filter.GetStickerFilters();
+	ASSERT_EQ(stickers.size(), 2U);
+	ASSERT_STREQ(stickers[0]->GetName(), "rating");
+	EXPECT_EQ(stickers[0]->GetOperator(), StickerOperator::GREATER_THAN_INT);
+	EXPECT_STREQ(stickers[0]->GetValue(), "3");
+	ASSERT_STREQ(stickers[1]->GetName(), "skip");
+	EXPECT_EQ(stickers[1]->GetValue(), nullptr);
+
+	const Tag tag;
+	const LightSong a{"a.ogg", tag}, b{"b.ogg", tag}, c{"c.ogg", tag};
+
+	/* not loaded yet: nothing matches */
+	EXPECT_FALSE(filter.Match(a));
+
+	stickers[0]->SetUris({"a.ogg", "b.ogg"});
+	stickers[1]->SetUris({"b.ogg"});
+
+	EXPECT_TRUE(filter.Match(a));
+	EXPECT_FALSE(filter.Match(b));
+	EXPECT_FALSE(filter.Match(c));
+}
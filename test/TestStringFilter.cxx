@@ -166,3 +166,45 @@ TEST_F(StringFilterTest, FoldCase)
 	EXPECT_FALSE(f.Match("foo"));
 	EXPECT_FALSE(f.Match("FOOnëedleBAR"));
 }
+
+#ifdef HAVE_PCRE
+
+static StringFilter
+MakeRegexFilter(const char *pattern, bool fold_case=false)
+{
+	StringFilter f{pattern, fold_case, false, StringFilter::Position::FULL, false};
+	f.SetRegex(std::make_shared<UniqueRegex>(f.GetValue().c_str(),
+						 Pcre::CompileOptions{.caseless=fold_case}));
+	return f;
+}
+
+TEST_F(StringFilterTest, Regex)
+{
+	const auto f = MakeRegexFilter("^The .*s$");
+
+	EXPECT_TRUE(f.Match("The Beatles"));
+	EXPECT_TRUE(f.Match("The Doors"));
+	EXPECT_FALSE(f.Match("The Who"));
+	EXPECT_FALSE(f.Match("Beatles"));
+	EXPECT_FALSE(f.Match(""));
+
+	/* the required literal must not reject matches */
+	const auto g = MakeRegexFilter("ab*c\\.d+e");
+	EXPECT_TRUE(g.Match("ac.de"));
+	EXPECT_TRUE(g.Match("xabbbc.dddex"));
+	EXPECT_FALSE(g.Match("ab.de"));
+
+	EXPECT_TRUE(MakeRegexFilter("foo|bar").Match("bar"));
+	EXPECT_TRUE(MakeRegexFilter("a(b)?c").Match("ac"));
+}
+
+TEST_F(StringFilterTest, RegexFoldCase)
+{
+	const auto f = MakeRegexFilter("beatles", true);
+
+	EXPECT_TRUE(f.Match("The Beatles"));
+	EXPECT_TRUE(f.Match("BEATLES"));
+	EXPECT_FALSE(f.Match("Beat"));
+}
+
+#endif
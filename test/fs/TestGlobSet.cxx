@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "config.h"
+#include "fs/GlobSet.hxx"
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CLASS_GLOB
+
+static constexpr const char *patterns[] = {
+	"foo",
+	"*.log",
+	"*.cue",
+	"tmp*",
+	"a*b*c",
+	"x**y",
+	"*mid*",
+	"f?o",
+	"[0-9]*",
+	"\\*lit",
+	"esc\\?",
+};
+
+static constexpr const char *names[] = {
+	"", "foo", "fooo", "_foo", "fo", "f_o",
+	"x.log", ".log", "log", "x.logx", "a.cue",
+	"tmp", "tmp.mp3", "atmp",
+	"abc", "aXbYc", "acb", "abcb", "ab", "a*b*c",
+	"xy", "x_y", "xyz",
+	"mid", "amidb", "mi",
+	"0", "9abc", "abc9",
+	"*lit", "xlit", "esc?", "escx",
+};
+
+TEST(GlobSet, Empty)
+{
+	const GlobSet set;
+	EXPECT_TRUE(set.empty());
+	EXPECT_FALSE(set.Check(""));
+	EXPECT_FALSE(set.Check("foo"));
+}
+
+TEST(GlobSet, Asterisk)
+{
+	GlobSet set;
+	set.Add("*");
+	EXPECT_FALSE(set.empty());
+	EXPECT_TRUE(set.Check(""));
+	EXPECT_TRUE(set.Check("foo"));
+}
+
+/**
+ * Compare each pattern with #Glob.
+ */
+TEST(GlobSet, Single)
+{
+	for (const char *pattern : patterns) {
+		const Glob glob{pattern};
+		GlobSet set;
+		set.Add(pattern);
+		EXPECT_FALSE(set.empty());
+
+		for (const char *name : names)
+			EXPECT_EQ(set.Check(name), glob.Check(name))
+				<< "pattern=" << pattern << " name=" << name;
+	}
+}
+
+/**
+ * Compare all patterns with a list of #Glob instances.
+ */
+TEST(GlobSet, Multiple)
+{
+	GlobSet set;
+	for (const char *pattern : patterns)
+		set.Add(pattern);
+
+	for (const char *name : names) {
+		bool expected = false;
+		for (const char *pattern : patterns)
+			expected = expected || Glob{pattern}.Check(name);
+
+		EXPECT_EQ(set.Check(name), expected) << "name=" << name;
+	}
+}
+
+TEST(GlobSet, Copy)
+{
+	GlobSet parent;
+	parent.Add("*.log");
+
+	GlobSet child{parent};
+	child.Add("foo");
+
+	EXPECT_TRUE(child.Check("x.log"));
+	EXPECT_TRUE(child.Check("foo"));
+	EXPECT_TRUE(parent.Check("x.log"));
+	EXPECT_FALSE(parent.Check("foo"));
+}
+
+#endif
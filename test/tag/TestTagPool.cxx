@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "tag/Pool.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Item.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Type.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(TagPool, Basic)
+{
+	TagItem *a = tag_pool_get_item(TAG_ARTIST, "foo");
+	ASSERT_NE(a, nullptr);
+	EXPECT_EQ(a->type, TAG_ARTIST);
+	EXPECT_STREQ(a->value, "foo");
+
+	/* same type and value: same item */
+	TagItem *b = tag_pool_get_item(TAG_ARTIST, "foo");
+	EXPECT_EQ(b, a);
+
+	/* different type or value: different item */
+	TagItem *c = tag_pool_get_item(TAG_ALBUM, "foo");
+	EXPECT_NE(c, a);
+	EXPECT_EQ(c->type, TAG_ALBUM);
+
+	TagItem *d = tag_pool_get_item(TAG_ARTIST, "bar");
+	EXPECT_NE(d, a);
+	EXPECT_STREQ(d->value, "bar");
+
+	EXPECT_EQ(tag_pool_dup_item(a), a);
+
+	tag_pool_put_item(a);
+	tag_pool_put_item(a);
+	tag_pool_put_item(b);
+	tag_pool_put_item(c);
+	tag_pool_put_item(d);
+}
+
+TEST(TagPool, Overflow)
+{
+	/* more references than the counter can hold */
+	std::vector<TagItem *> items;
+	for (unsigned i = 0; i < 1000; ++i)
+		items.push_back(tag_pool_get_item(TAG_GENRE, "Rock"));
+
+	for (unsigned i = 0; i < 1000; ++i)
+		items.push_back(tag_pool_dup_item(items[i]));
+
+	for (TagItem *i : items) {
+		EXPECT_EQ(i->type, TAG_GENRE);
+		EXPECT_STREQ(i->value, "Rock");
+		tag_pool_put_item(i);
+	}
+}
+
+TEST(TagPool, Index)
+{
+	TagItem *a = tag_pool_get_item(TAG_ARTIST, "foo");
+	TagItem *b = tag_pool_get_item(TAG_ALBUM, "bar");
+
+	EXPECT_NE(tag_pool_item_index(*a), tag_pool_item_index(*b));
+	EXPECT_EQ(&tag_pool_item_at(tag_pool_item_index(*a)), a);
+	EXPECT_EQ(&tag_pool_item_at(tag_pool_item_index(*b)), b);
+
+	tag_pool_put_item(a);
+	tag_pool_put_item(b);
+}
+
+TEST(TagPool, Stats)
+{
+	const auto before = tag_pool_get_stats();
+
+	TagItem *a = tag_pool_get_item(TAG_COMMENT, "stats");
+	const auto with_a = tag_pool_get_stats();
+	EXPECT_EQ(with_a.items, before.items + 1);
+	EXPECT_GT(with_a.bytes, before.bytes);
+
+	/* another reference doesn't allocate anything */
+	TagItem *b = tag_pool_dup_item(a);
+	EXPECT_EQ(tag_pool_get_stats().items, with_a.items);
+	EXPECT_EQ(tag_pool_get_stats().bytes, with_a.bytes);
+
+	tag_pool_put_item(b);
+	tag_pool_put_item(a);
+
+	const auto after = tag_pool_get_stats();
+	EXPECT_EQ(after.items, before.items);
+	EXPECT_LE(after.bytes, with_a.bytes);
+}
+
+TEST(TagPool, Tag)
+{
+	TagBuilder builder;
+	builder.AddItem(TAG_ARTIST, "a");
+	builder.AddItem(TAG_TITLE, "t");
+	builder.AddItem(TAG_ARTIST, "b");
+
+	const Tag tag = builder.Commit();
+	EXPECT_EQ(tag.num_items, 3);
+	EXPECT_STREQ(tag.GetValue(TAG_ARTIST), "a");
+	EXPECT_STREQ(tag.GetValue(TAG_TITLE), "t");
+	EXPECT_EQ(tag.GetValue(TAG_ALBUM), nullptr);
+	EXPECT_TRUE(tag.HasType(TAG_TITLE));
+	EXPECT_FALSE(tag.HasType(TAG_ALBUM));
+
+	const Tag copy{tag};
+	EXPECT_EQ(copy, tag);
+
+	TagBuilder b2{copy};
+	b2.AddItem(TAG_ALBUM, "x");
+	b2.Complement(tag);
+	const Tag merged = b2.Commit();
+	EXPECT_EQ(merged.num_items, 4);
+	EXPECT_STREQ(merged.GetValue(TAG_ALBUM), "x");
+
+	unsigned n = 0;
+	for (const auto &i : merged) {
+		EXPECT_EQ(merged.GetTypes()[n], i.type);
+		++n;
+	}
+	EXPECT_EQ(n, 4U);
+
+	EXPECT_FALSE(Tag{}.HasType(TAG_ARTIST));
+	EXPECT_EQ(Tag{}.GetValue(TAG_ARTIST), nullptr);
+}
+
+TEST(TagPool, Threads)
+{
+	std::vector<std::thread> threads;
+
+	for (unsigned t = 0; t < 8; ++t) {
+		threads.emplace_back([]{
+			std::vector<TagItem *> items;
+
+			for (unsigned n = 0; n < 200; ++n) {
+				for (unsigned i = 0; i < 50; ++i) {
+					const auto value = std::to_string(i);
+					TagItem *item = tag_pool_get_item(TAG_TITLE, value);
+					EXPECT_EQ(item->value, value);
+					items.push_back(item);
+					items.push_back(tag_pool_dup_item(item));
+				}
+
+				for (TagItem *i : items)
+					tag_pool_put_item(i);
+				items.clear();
+			}
+		});
+	}
+
+	for (auto &i : threads)
+		i.join();
+}
+
+TEST(TagPool, SharedItems)
+{
+	TagBuilder builder;
+	builder.AddItem(TAG_ARTIST, "shared");
+	builder.AddItem(TAG_TITLE, "t");
+
+	Tag tag = builder.Commit();
+	EXPECT_TRUE(tag.HasUniqueItems());
+
+	{
+		/* a copy shares the items block */
+		const Tag copy{tag};
+		EXPECT_EQ(copy.items, tag.items);
+		EXPECT_FALSE(tag.HasUniqueItems());
+		EXPECT_STREQ(copy.GetValue(TAG_ARTIST), "shared");
+
+		/* moving a shared block into a builder duplicates the
+		   references */
+		TagBuilder b2{Tag{copy}};
+		b2.AddItem(TAG_ALBUM, "x");
+		const Tag merged = b2.Commit();
+		EXPECT_EQ(merged.num_items, 3);
+		EXPECT_NE(merged.items, tag.items);
+		EXPECT_STREQ(merged.GetValue(TAG_ARTIST), "shared");
+	}
+
+	EXPECT_TRUE(tag.HasUniqueItems());
+	EXPECT_STREQ(tag.GetValue(TAG_ARTIST), "shared");
+	EXPECT_STREQ(tag.GetValue(TAG_TITLE), "t");
+
+	/* the last owner may move its references */
+	TagBuilder b3{std::move(tag)};
+	EXPECT_EQ(tag.items, nullptr);
+	const Tag moved = b3.Commit();
+	EXPECT_STREQ(moved.GetValue(TAG_ARTIST), "shared");
+
+	EXPECT_EQ(TagBuilder{}.Commit().items, nullptr);
+}
@@ -27,7 +27,7 @@ CompareTagTitle(const Tag &tag, const std::string &title)
 {
 	EXPECT_EQ(uint16_t(1), tag.num_items);
 
-	const TagItem &item = *tag.items[0];
+	const TagItem &item = *tag.begin();
 	EXPECT_EQ(TAG_TITLE, item.type);
 	EXPECT_EQ(title, std::string(item.value));
 }
@@ -61,3 +61,44 @@ TEST(IcyMetadataParserTest, Basic)
 	TestIcyParserTitle("a='b'c';StreamTitle='foo'bar'", "foo'bar");
 	TestIcyParserTitle("StreamTitle='fo'o'b'ar';a='b'c'd'", "fo'o'b'ar");
 }
+
+/**
+ * Feed a stream to the parser the way #IcyInputStream does: normal
+ * data up to GetDataRest(), metadata up to GetMetaRest().
+ */
+TEST(IcyMetadataParserTest, Stream)
+{
+	const std::string_view title = "StreamTitle='foo';";
+
+	std::string stream = "abcd";
+	stream.push_back(2); // 2*16 bytes of metadata
+	stream.append(title);
+	stream.append(32 - title.size(), '\0');
+	stream.append("efgh");
+	stream.push_back(0); // no metadata
+	stream.append("ij");
+
+	IcyMetaDataParser parser;
+	parser.Start(4);
+
+	std::string data;
+	std::span<const std::byte> src = std::as_bytes(std::span{stream});
+	while (!src.empty()) {
+		if (const std::size_t data_rest = parser.GetDataRest(); data_rest > 0) {
+			const std::size_t n = parser.Data(std::min(src.size(), data_rest));
+			data.append(reinterpret_cast<const char *>(src.data()), n);
+			src = src.subspan(n);
+		} else {
+			const std::size_t n = std::min(src.size(), parser.GetMetaRest());
+			EXPECT_EQ(parser.Meta(src.first(n)), n);
+			src = src.subspan(n);
+		}
+	}
+
+	EXPECT_EQ(data, "abcdefghij");
+
+	const auto tag = parser.ReadTag();
+	ASSERT_TRUE(tag);
+	CompareTagTitle(*tag, "foo");
+	EXPECT_FALSE(parser.ReadTag());
+}
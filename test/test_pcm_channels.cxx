@@ -3,7 +3,12 @@
 
 #include "test_pcm_util.hxx"
 #include "pcm/PcmChannels.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/ChannelsConverter.hxx"
+#include "pcm/FusedConverter.hxx"
+#include "pcm/ChannelRouter.hxx"
 #include "pcm/Buffer.hxx"
+#include "util/SpanCast.hxx"
 
 #include <gtest/gtest.h>
 
@@ -90,3 +95,129 @@ TEST(PcmTest, Channels32)
 		EXPECT_EQ(silence, dest[i * 6 + 5]);
 	}
 }
+
+/**
+ * Compare #PcmFusedConverter with #PcmFormatConverter followed by
+ * #PcmChannelsConverter; the results must be identical.
+ */
+static void
+TestFused(SampleFormat src_format, SampleFormat dest_format,
+	  unsigned src_channels, unsigned dest_channels,
+	  std::span<const std::byte> src)
+{
+	PcmFusedConverter fused;
+	ASSERT_TRUE(fused.Open(src_format, dest_format,
+			       src_channels, dest_channels));
+
+	PcmFormatConverter format_converter;
+	format_converter.Open(src_format, dest_format);
+
+	PcmChannelsConverter channels_converter;
+	channels_converter.Open(dest_format, src_channels, dest_channels);
+
+	const auto expected =
+		channels_converter.Convert(format_converter.Convert(src));
+	const auto result = fused.Convert(src);
+	EXPECT_EQ(expected.size(), result.size());
+	EXPECT_EQ(0, memcmp(expected.data(), result.data(), result.size()));
+
+	channels_converter.Close();
+	format_converter.Close();
+	fused.Close();
+}
+
+TEST(PcmTest, FusedConverter)
+{
+	constexpr size_t N = 510;
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src32 = TestDataBuffer<int32_t, N>();
+	const auto src_float = TestDataBuffer<float, N>(RandomFloat());
+
+	for (const auto &[src_channels, dest_channels] :
+		     {std::pair{1u, 2u}, std::pair{2u, 1u}}) {
+		TestFused(SampleFormat::S16, SampleFormat::S32,
+			  src_channels, dest_channels, src16);
+		TestFused(SampleFormat::S16, SampleFormat::FLOAT,
+			  src_channels, dest_channels, src16);
+		TestFused(SampleFormat::S32, SampleFormat::S24_P32,
+			  src_channels, dest_channels, src32);
+		TestFused(SampleFormat::S32, SampleFormat::FLOAT,
+			  src_channels, dest_channels, src32);
+		TestFused(SampleFormat::FLOAT, SampleFormat::S16,
+			  src_channels, dest_channels, src_float);
+		TestFused(SampleFormat::FLOAT, SampleFormat::S32,
+			  src_channels, dest_channels, src_float);
+	}
+
+	/* conversion to S16 needs dithering, which is not
+	   implemented by PcmFusedConverter */
+	PcmFusedConverter fused;
+	EXPECT_FALSE(fused.Open(SampleFormat::S32, SampleFormat::S16, 2, 1));
+}
+
+/**
+ * Route #src through a #PcmChannelRouter and compare the result with
+ * a naive implementation.
+ */
+template<typename T, size_t N>
+static void
+TestRoute(SampleFormat format, unsigned src_channels, unsigned dest_channels,
+	  std::initializer_list<int> _sources,
+	  const TestDataBuffer<T, N> &src, const char *expected_kernel,
+	  T silence=T(0))
+{
+	PcmChannelRoute sources;
+	sources.fill(-1);
+	std::copy(_sources.begin(), _sources.end(), sources.begin());
+
+	PcmChannelRouter router;
+	router.Open(format, src_channels, dest_channels, sources);
+	EXPECT_STREQ(router.GetKernelName(), expected_kernel);
+
+	const auto result = FromBytesStrict<const T>(router.Convert(src));
+	const size_t n_frames = N / src_channels;
+	ASSERT_EQ(result.size(), n_frames * dest_channels);
+
+	for (size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < dest_channels; ++c) {
+			const int s = sources[c];
+			const T expected = s >= 0 && unsigned(s) < src_channels
+				? src[i * src_channels + s]
+				: silence;
+			EXPECT_EQ(result[i * dest_channels + c], expected);
+		}
+	}
+}
+
+TEST(PcmTest, ChannelRouter)
+{
+	constexpr size_t N = 8 * 3 * 17;
+	const auto src16 = TestDataBuffer<int16_t, N>();
+	const auto src32 = TestDataBuffer<int32_t, N>();
+	const auto src_float = TestDataBuffer<float, N>(RandomFloat());
+
+	TestRoute(SampleFormat::S16, 2, 2, {0, 1}, src16, "identity");
+	TestRoute(SampleFormat::S16, 2, 2, {1, 0}, src16, "fixed");
+	TestRoute(SampleFormat::S16, 1, 2, {0, 0}, src16, "fixed");
+	TestRoute(SampleFormat::S32, 2, 8, {0, 1, -1, -1, 0, 1, 0, 1},
+		  src32, "fixed");
+	TestRoute(SampleFormat::FLOAT, 2, 8, {0, 1, 0, 1, 0, 1, 0, 1},
+		  src_float, "fixed");
+	TestRoute(SampleFormat::FLOAT, 8, 2, {0, 1}, src_float, "fixed");
+
+	/* no specialized kernel for these */
+	TestRoute(SampleFormat::S16, 2, 8, {1, 0, 1, 0, 1, 0, 1, 0},
+		  src16, "generic");
+	TestRoute(SampleFormat::S32, 6, 3, {5, -1, 2}, src32, "generic");
+	TestRoute(SampleFormat::FLOAT, 3, 4, {2, 1, 0}, src_float, "generic");
+
+	/* a nonexistent input channel gives silence */
+	TestRoute(SampleFormat::S16, 2, 2, {0, 5}, src16, "generic");
+
+	/* DSD silence is not zero */
+	const auto src_dsd = TestDataBuffer<uint8_t, N>();
+	TestRoute(SampleFormat::DSD, 2, 6, {0, 1}, src_dsd, "fixed",
+		  uint8_t(0x69));
+	TestRoute(SampleFormat::DSD, 2, 3, {1, -1, 0}, src_dsd, "generic",
+		  uint8_t(0x69));
+}
@@ -3,9 +3,12 @@
 
 #include "test_pcm_util.hxx"
 #include "pcm/Dither.cxx"
+#include "pcm/VolumeKernels.hxx"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 TEST(PcmTest, Dither24)
 {
 	constexpr unsigned N = 509;
@@ -35,3 +38,45 @@ TEST(PcmTest, Dither32)
 		EXPECT_LT(dest[i], (src[i] >> 16) + 8);
 	}
 }
+
+/**
+ * Check the dithering conversions of all #PcmVolumeKernels supported
+ * by this CPU.  The vectorized kernels use different random numbers,
+ * so this allows the same tolerance as the tests above.
+ */
+TEST(PcmTest, DitherKernels)
+{
+	constexpr unsigned N = 509;
+	const auto src24 = TestDataBuffer<int32_t, N>(RandomInt24());
+	const auto src32 = TestDataBuffer<int32_t, N>();
+	const auto src_float = TestDataBuffer<float, N>(RandomFloat());
+
+	for (const auto *k : GetAvailablePcmVolumeKernels()) {
+		int16_t dest[N];
+
+		/* each conversion needs its own PcmDither, because
+		   the error feedback depends on the source format */
+		PcmDither dither;
+		k->dither_24_to_16(dither, dest, src24.begin(), N);
+		for (unsigned i = 0; i < N; ++i) {
+			EXPECT_GE(dest[i], (src24[i] >> 8) - 8) << k->name;
+			EXPECT_LT(dest[i], (src24[i] >> 8) + 8) << k->name;
+		}
+
+		dither = {};
+		k->dither_32_to_16(dither, dest, src32.begin(), N);
+		for (unsigned i = 0; i < N; ++i) {
+			EXPECT_GE(dest[i], (src32[i] >> 16) - 8) << k->name;
+			EXPECT_LT(dest[i], (src32[i] >> 16) + 8) << k->name;
+		}
+
+		dither = {};
+		k->dither_float_to_16(dither, dest, src_float.begin(), N);
+		for (unsigned i = 0; i < N; ++i) {
+			const int expected = std::clamp(int(src_float[i] * 32768.f),
+							-32768, 32767);
+			EXPECT_GE(dest[i], expected - 8) << k->name;
+			EXPECT_LE(dest[i], expected + 8) << k->name;
+		}
+	}
+}
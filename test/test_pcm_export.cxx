@@ -2,12 +2,17 @@
 // Copyright The Music Player Daemon Project
 
 #include "pcm/Export.hxx"
+#include "pcm/DsdKernels.hxx"
 #include "pcm/Features.h" // for ENABLE_DSD
 #include "pcm/Traits.hxx"
+#include "util/BitReverse.hxx"
 #include "util/ByteOrder.hxx"
 
 #include <gtest/gtest.h>
 
+#include <random>
+#include <vector>
+
 #include <string.h>
 
 TEST(PcmTest, ExportShift8)
@@ -415,3 +420,80 @@ TEST(PcmTest, ExportAlsaChannelOrder)
 	TestAlsaChannelOrder51<SampleFormat::S32>();
 	TestAlsaChannelOrder71<SampleFormat::S32>();
 }
+
+/**
+ * Compare all #PcmDsdKernels supported by this CPU with the scalar
+ * implementation.  The odd number of quads leaves a rest for the
+ * scalar code after the vectorized loop.
+ */
+TEST(PcmTest, DsdKernels)
+{
+	constexpr std::size_t N_QUADS = 37;
+
+	const auto all = GetAvailablePcmDsdKernels();
+	const auto &scalar = *all.front();
+
+	std::minstd_rand engine;
+
+	for (const unsigned channels : {1U, 2U, 6U}) {
+		std::vector<std::byte> src(N_QUADS * 4 * channels);
+		for (auto &i : src)
+			i = std::byte(engine());
+
+		std::vector<uint32_t> expected_dop(N_QUADS * 2 * channels);
+		scalar.dsd_to_dop(expected_dop.data(), src.data(),
+				  N_QUADS, channels);
+
+		std::vector<uint16_t> expected16(N_QUADS * 2 * channels);
+		scalar.dsd8_to_16(expected16.data(), src.data(),
+				  N_QUADS * 2, channels);
+
+		std::vector<uint32_t> expected32(N_QUADS * channels);
+		scalar.dsd8_to_32(expected32.data(), src.data(),
+				  N_QUADS, channels);
+
+		for (const auto *k : all) {
+			std::vector<uint32_t> dop(expected_dop.size());
+			k->dsd_to_dop(dop.data(), src.data(),
+				      N_QUADS, channels);
+			EXPECT_EQ(dop, expected_dop) << k->name;
+
+			std::vector<uint16_t> dsd16(expected16.size());
+			k->dsd8_to_16(dsd16.data(), src.data(),
+				      N_QUADS * 2, channels);
+			EXPECT_EQ(dsd16, expected16) << k->name;
+
+			std::vector<uint32_t> dsd32(expected32.size());
+			k->dsd8_to_32(dsd32.data(), src.data(),
+				      N_QUADS, channels);
+			EXPECT_EQ(dsd32, expected32) << k->name;
+		}
+	}
+
+	/* the first quad of the stereo DoP test above */
+	static constexpr uint8_t dop_src[16] = {
+		0x01, 0x23, 0x45, 0x67,
+		0x89, 0xab, 0xcd, 0xef,
+	};
+
+	for (const auto *k : all) {
+		uint32_t dest[8];
+		k->dsd_to_dop(dest, (const std::byte *)dop_src, 2, 2);
+		EXPECT_EQ(dest[0], 0xff050145u) << k->name;
+		EXPECT_EQ(dest[1], 0xff052367u) << k->name;
+		EXPECT_EQ(dest[2], 0xfffa89cdu) << k->name;
+		EXPECT_EQ(dest[3], 0xfffaabefu) << k->name;
+	}
+
+	std::vector<std::byte> reverse_src(509);
+	for (auto &i : reverse_src)
+		i = std::byte(engine());
+
+	for (const auto *k : all) {
+		auto data = reverse_src;
+		k->bit_reverse(data.data(), data.size());
+
+		for (std::size_t i = 0; i < data.size(); ++i)
+			EXPECT_EQ(data[i], BitReverse(reverse_src[i])) << k->name;
+	}
+}
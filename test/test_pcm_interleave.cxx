@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <vector>
 
 template<typename T>
 static void
@@ -106,3 +107,40 @@ TEST(PcmTest, Interleave64)
 {
 	TestInterleaveN<uint64_t>();
 }
+
+/**
+ * Test a channel count which has a specialized (vectorized)
+ * implementation, with a frame count which is not a multiple of the
+ * vector size.
+ */
+template<typename T>
+static void
+TestInterleaveChannels(unsigned channels)
+{
+	static constexpr size_t n_frames = 19;
+
+	std::vector<std::vector<T>> planes(channels);
+	std::vector<const void *> src;
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < n_frames; ++i)
+			planes[c].push_back(T(i * channels + c));
+		src.push_back(planes[c].data());
+	}
+
+	static constexpr T poison = T(0xdeadbeef);
+	std::vector<T> dest(n_frames * channels + 1, poison);
+
+	PcmInterleave(dest.data(), src, n_frames, sizeof(T));
+
+	for (size_t i = 0; i < n_frames * channels; ++i)
+		EXPECT_EQ(T(i), dest[i]);
+	EXPECT_EQ(poison, dest.back());
+}
+
+TEST(PcmTest, InterleaveMultiChannel)
+{
+	for (unsigned channels : {2, 6, 8}) {
+		TestInterleaveChannels<uint16_t>(channels);
+		TestInterleaveChannels<uint32_t>(channels);
+	}
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright The Music Player Daemon Project
+
+#include "pcm/ResamplerCache.hxx"
+#include "pcm/Resampler.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(PcmTest, ResamplerCache)
+{
+	PcmResamplerCache cache;
+
+	const PcmResamplerCache::Key a{
+		AudioFormat{44100, SampleFormat::S16, 2},
+		48000, SampleFormat::S16,
+	};
+
+	auto item = cache.Open(a);
+	ASSERT_NE(item.resampler, nullptr);
+	EXPECT_EQ(item.output_format.sample_rate, 48000u);
+	EXPECT_EQ(cache.size(), 0u);
+
+	const PcmResampler *const resampler = item.resampler.get();
+	cache.Put(std::move(item));
+	EXPECT_EQ(cache.size(), 1u);
+
+	/* the same key returns the same instance */
+	item = cache.Open(a);
+	EXPECT_EQ(item.resampler.get(), resampler);
+	EXPECT_EQ(cache.size(), 0u);
+	cache.Put(std::move(item));
+
+	/* a different key returns a new instance */
+	auto b = a;
+	b.src_format.sample_rate = 32000;
+	item = cache.Open(b);
+	EXPECT_NE(item.resampler.get(), resampler);
+	cache.Put(std::move(item));
+	EXPECT_EQ(cache.size(), 2u);
+
+	/* the least recently used one is evicted */
+	for (unsigned i = 0; i < PcmResamplerCache::MAX_ITEMS - 1; ++i) {
+		auto c = a;
+		c.src_format.sample_rate = 8000 + i;
+		cache.Put(cache.Open(c));
+	}
+
+	EXPECT_EQ(cache.size(), PcmResamplerCache::MAX_ITEMS);
+	item = cache.Open(a);
+	EXPECT_EQ(cache.size(), PcmResamplerCache::MAX_ITEMS);
+	cache.Put(std::move(item));
+
+	cache.Clear();
+	EXPECT_EQ(cache.size(), 0u);
+}
@@ -2,6 +2,7 @@
 // Copyright The Music Player Daemon Project
 
 #include "pcm/Volume.hxx"
+#include "pcm/VolumeKernels.hxx"
 #include "pcm/Traits.hxx"
 #include "util/SpanCast.hxx"
 #include "test_pcm_util.hxx"
@@ -9,6 +10,8 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <array>
+#include <vector>
 
 #include <string.h>
 
@@ -142,3 +145,117 @@ TEST(PcmTest, VolumeFloat)
 
 	pv.Close();
 }
+
+TEST(PcmTest, VolumeRamp)
+{
+	constexpr unsigned CHANNELS = 2, RAMP_FRAMES = 100, N_FRAMES = 300;
+
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S16, true), SampleFormat::S24_P32);
+	pv.EnableRamp(CHANNELS, RAMP_FRAMES);
+
+	std::array<int16_t, N_FRAMES * CHANNELS> src;
+	src.fill(10000);
+
+	/* before the first Apply() call, volume changes are
+	   immediate */
+	pv.SetVolume(PCM_VOLUME_1 / 2);
+	auto d = FromBytesStrict<const int32_t>(pv.Apply(std::as_bytes(std::span{src})));
+	ASSERT_EQ(d.size(), src.size());
+	for (const auto i : d)
+		EXPECT_EQ(i, (10000 << 8) / 2);
+
+	/* fade out, split over two Apply() calls */
+	pv.SetVolume(0);
+	d = FromBytesStrict<const int32_t>(pv.Apply(std::as_bytes(std::span{src}.first(60 * CHANNELS))));
+	std::vector<int32_t> result{d.begin(), d.end()};
+	d = FromBytesStrict<const int32_t>(pv.Apply(std::as_bytes(std::span{src}.subspan(60 * CHANNELS))));
+	result.insert(result.end(), d.begin(), d.end());
+	ASSERT_EQ(result.size(), src.size());
+
+	EXPECT_EQ(result[0], (10000 << 8) / 2);
+	for (unsigned i = 0; i < N_FRAMES; ++i) {
+		/* both channels of a frame have the same level */
+		EXPECT_EQ(result[i * CHANNELS], result[i * CHANNELS + 1]);
+
+		if (i > 0) {
+			EXPECT_LE(result[i * CHANNELS],
+				  result[(i - 1) * CHANNELS]);
+		}
+
+		if (i >= RAMP_FRAMES) {
+			EXPECT_EQ(result[i * CHANNELS], 0);
+		} else {
+			EXPECT_GT(result[i * CHANNELS], 0);
+		}
+	}
+
+	pv.Close();
+}
+
+TEST(PcmTest, VolumeJump)
+{
+	constexpr unsigned CHANNELS = 2, RAMP_FRAMES = 100, N_FRAMES = 300;
+
+	PcmVolume pv;
+	EXPECT_EQ(pv.Open(SampleFormat::S16, true), SampleFormat::S24_P32);
+	pv.EnableRamp(CHANNELS, RAMP_FRAMES);
+
+	std::array<int16_t, N_FRAMES * CHANNELS> src;
+	src.fill(10000);
+
+	pv.Apply(std::as_bytes(std::span{src}));
+
+	/* start a ramp, then interrupt it with JumpVolume() */
+	pv.SetVolume(0);
+	pv.Apply(std::as_bytes(std::span{src}.first(10 * CHANNELS)));
+
+	pv.JumpVolume(PCM_VOLUME_1 / 2);
+	const auto d = FromBytesStrict<const int32_t>(pv.Apply(std::as_bytes(std::span{src})));
+	ASSERT_EQ(d.size(), src.size());
+	for (const auto i : d)
+		EXPECT_EQ(i, (10000 << 8) / 2);
+
+	pv.Close();
+}
+
+/**
+ * Compare all #PcmVolumeKernels supported by this CPU with the
+ * expected result.  The vectorized kernels dither differently, so
+ * this allows a small tolerance.
+ */
+template<typename T, typename F, typename G=RandomInt<T>>
+static void
+TestVolumeKernels(F f, G g=G())
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<T, N>(g);
+
+	for (const auto *k : GetAvailablePcmVolumeKernels()) {
+		PcmDither dither;
+		T dest[N];
+
+		f(*k, dither, dest, (const T *)src, N, PCM_VOLUME_1S / 2);
+
+		for (unsigned i = 0; i < N; ++i) {
+			const auto expected = (int64_t(src[i]) + 1) / 2;
+			EXPECT_GE(dest[i], expected - 4) << k->name;
+			EXPECT_LE(dest[i], expected + 4) << k->name;
+		}
+	}
+}
+
+TEST(PcmTest, VolumeKernels)
+{
+	TestVolumeKernels<int16_t>([](const PcmVolumeKernels &k, auto &&...args){
+		k.volume_16(args...);
+	});
+
+	TestVolumeKernels<int32_t>([](const PcmVolumeKernels &k, auto &&...args){
+		k.volume_24(args...);
+	}, RandomInt24());
+
+	TestVolumeKernels<int32_t>([](const PcmVolumeKernels &k, auto &&...args){
+		k.volume_32(args...);
+	});
+}
@@ -5,6 +5,7 @@
 #include <gtest/gtest.h>
 
 #include <iterator>
+#include <vector>
 
 Tag::Tag(const Tag &) noexcept {}
 void Tag::Clear() noexcept {}
@@ -170,3 +171,125 @@ TEST(QueuePriority, Priority)
 	a_order = queue.PositionToOrder(a_position);
 	EXPECT_EQ(6u, a_order);
 }
+
+static void
+check_inverse_order(const Queue &queue)
+{
+	for (unsigned order = 0; order < queue.GetLength(); ++order)
+		EXPECT_EQ(order,
+			  queue.PositionToOrder(queue.OrderToPosition(order)));
+}
+
+TEST(QueuePriority, InverseOrder)
+{
+	Queue queue(64);
+
+	for (unsigned i = 0; i < 48; ++i)
+		queue.Append(DetachedSong("x.ogg"), i % 3);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	check_inverse_order(queue);
+
+	queue.MovePostion(3, 40);
+	check_inverse_order(queue);
+
+	queue.MovePostion(30, 2);
+	check_inverse_order(queue);
+
+	queue.MoveRange(5, 10, 20);
+	check_inverse_order(queue);
+
+	queue.MoveRange(30, 35, 1);
+	check_inverse_order(queue);
+
+	queue.MoveOrder(7, 33);
+	check_inverse_order(queue);
+
+	queue.MoveOrder(40, 0);
+	check_inverse_order(queue);
+
+	queue.SwapOrders(4, 17);
+	check_inverse_order(queue);
+
+	queue.DeletePosition(queue.OrderToPosition(0));
+	queue.DeletePosition(21);
+	queue.DeletePosition(queue.GetLength() - 1);
+	EXPECT_EQ(45u, queue.GetLength());
+	check_inverse_order(queue);
+
+	queue.ShuffleOrderRange(10, 30);
+	check_inverse_order(queue);
+
+	queue.SetPriorityRange(0, 20, 200, -1);
+	check_inverse_order(queue);
+
+	queue.RestoreOrder();
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		EXPECT_EQ(i, queue.PositionToOrder(i));
+}
+
+/**
+ * Determine the positions newer than the given version by checking
+ * all of them, which is what Queue::CollectChanges() optimizes.
+ */
+static std::vector<unsigned>
+ScanChanges(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			result.push_back(i);
+	return result;
+}
+
+TEST(QueuePriority, Changes)
+{
+	Queue queue(8192);
+
+	for (unsigned i = 0; i < 32; ++i)
+		queue.Append(DetachedSong("x.ogg"), 0);
+	queue.IncrementVersion();
+
+	queue.MovePostion(3, 20);
+	queue.IncrementVersion();
+
+	queue.ModifyAtPosition(7);
+	queue.DeletePosition(10);
+	queue.IncrementVersion();
+
+	const uint32_t v3 = queue.version;
+	queue.SwapPositions(0, 1);
+	queue.Append(DetachedSong("y.ogg"), 0);
+	queue.IncrementVersion();
+
+	for (uint32_t v = 0; v <= queue.version + 1; ++v) {
+		std::vector<unsigned> positions;
+		ASSERT_TRUE(queue.CollectChanges(v, positions) ||
+			    v > queue.version);
+		if (v <= queue.version) {
+			EXPECT_EQ(positions, ScanChanges(queue, v));
+		}
+	}
+
+	std::vector<unsigned> positions;
+	ASSERT_TRUE(queue.CollectChanges(v3, positions));
+	EXPECT_EQ(positions, (std::vector<unsigned>{0, 1, 31}));
+
+	/* overflow the log: old versions are no longer available */
+	for (unsigned i = 0; i < 5000; ++i)
+		queue.Append(DetachedSong("z.ogg"), 0);
+	queue.IncrementVersion();
+
+	positions.clear();
+	EXPECT_FALSE(queue.CollectChanges(v3, positions));
+
+	/* but newer ones are */
+	queue.ModifyAtPosition(5);
+	queue.IncrementVersion();
+
+	positions.clear();
+	ASSERT_TRUE(queue.CollectChanges(queue.version - 1, positions));
+	EXPECT_EQ(positions, (std::vector<unsigned>{5}));
+	EXPECT_EQ(positions, ScanChanges(queue, queue.version - 1));
+}